@@ -179,6 +179,10 @@ static const std::unordered_map<std::string, OpcodeChar> Ampere_OpcodeMap = {
     {"TXD", OpcodeChar(OP_TXD, LOAD_OP)},
     {"TXQ", OpcodeChar(OP_TXQ, LOAD_OP)},
 
+    // Ray Tracing Instructions
+    // traverse the BVH on the RT unit (SPECIALIZED_UNIT_5 named RT)
+    {"TRACE_RAY", OpcodeChar(OP_TRACE_RAY, SPECIALIZED_UNIT_5_OP)},
+
     // Surface Instructions //
     {"SUATOM", OpcodeChar(OP_SUATOM, ALU_OP)},
     {"SULD", OpcodeChar(OP_SULD, ALU_OP)},
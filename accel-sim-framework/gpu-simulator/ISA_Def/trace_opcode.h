@@ -225,6 +225,8 @@ enum TraceInstrOpcode {
   OP_REDUX,
   OP_UF2FP,
   OP_SUQUERY,
+  // ray tracing, emitted by the vulkan-sim tracer for traceRayEXT
+  OP_TRACE_RAY,
   SASS_NUM_OPCODES /* The total number of opcodes. */
 };
 typedef enum TraceInstrOpcode sass_op_type;
@@ -170,6 +170,10 @@ static const std::unordered_map<std::string, OpcodeChar> Turing_OpcodeMap = {
     {"TXD", OpcodeChar(OP_TXD, SPECIALIZED_UNIT_2_OP)},
     {"TXQ", OpcodeChar(OP_TXQ, SPECIALIZED_UNIT_2_OP)},
 
+    // Ray Tracing Instructions
+    // traverse the BVH on the RT unit (SPECIALIZED_UNIT_5 named RT)
+    {"TRACE_RAY", OpcodeChar(OP_TRACE_RAY, SPECIALIZED_UNIT_5_OP)},
+
     // Surface Instructions //
     {"SUATOM", OpcodeChar(OP_SUATOM, ALU_OP)},
     {"SULD", OpcodeChar(OP_SULD, ALU_OP)},
@@ -0,0 +1,168 @@
+// Shared setup of the memory hierarchy micro-benchmarks
+//
+// A harness builds the simulator from the usual -config files without
+// traces, drives one component with a synthetic address stream and prints
+// the ns per operation of each stream. The streams are:
+//   streaming  consecutive 32B sectors
+//   strided    -micro_stride bytes apart, wrapping inside the footprint
+//   tex_tile   a 2D texture of 4B texels stored in 8x8 texel tiles, read
+//              in scanline order so every 8 texels jump to the next tile
+//   random     32B aligned, uniform over the footprint
+// -micro_pattern picks one, -micro_ops and -micro_footprint size the run.
+// A harness binary runs as accel-sim.out would, from a job directory with
+// gpgpusim.config: micro-tag-array.out -config ./gpgpusim.config
+
+#ifndef MICRO_BENCH_H
+#define MICRO_BENCH_H
+
+#include <assert.h>
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "gpgpu_context.h"
+#include "abstract_hardware_model.h"
+#include "cuda-sim/cuda-sim.h"
+#include "gpgpu-sim/gpu-sim.h"
+#include "gpgpu-sim/icnt_wrapper.h"
+#include "gpgpu-sim/mem_fetch.h"
+#include "gpgpusim_entrypoint.h"
+#include "option_parser.h"
+#include "trace_driven.h"
+
+// gives the harnesses the members a component is built from
+class micro_gpu : public trace_gpgpu_sim {
+ public:
+  micro_gpu(const gpgpu_sim_config &config, gpgpu_context *ctx)
+      : trace_gpgpu_sim(config, ctx) {}
+  memory_stats_t *memory_stats() { return m_memory_stats; }
+};
+
+struct micro_options {
+  char *pattern;
+  unsigned ops;
+  unsigned footprint_mb;
+  unsigned stride;
+  char *cache;  // micro_tag_array only
+};
+
+static micro_gpu *micro_init(int argc, const char *argv[],
+                             micro_options &opts) {
+  srand(1);
+  gpgpu_context *ctx = new gpgpu_context();
+  trace_config *tconfig = new trace_config();
+  option_parser_t opp = option_parser_create();
+  ctx->ptx_reg_options(opp);
+  ctx->func_sim->ptx_opcocde_latency_options(opp);
+  icnt_reg_options(opp);
+  ctx->the_gpgpusim->g_the_gpu_config = new gpgpu_sim_config(ctx);
+  ctx->the_gpgpusim->g_the_gpu_config->reg_options(opp);
+  tconfig->reg_options(opp);
+  option_parser_register(opp, "-micro_pattern", OPT_CSTR, &opts.pattern,
+                         "streaming, strided, tex_tile, random or all",
+                         "all");
+  option_parser_register(opp, "-micro_ops", OPT_UINT32, &opts.ops,
+                         "operations timed per pattern", "1000000");
+  option_parser_register(opp, "-micro_footprint", OPT_UINT32,
+                         &opts.footprint_mb, "MB the addresses fall in", "64");
+  option_parser_register(opp, "-micro_stride", OPT_UINT32, &opts.stride,
+                         "bytes between strided addresses", "4096");
+  option_parser_register(opp, "-micro_cache", OPT_CSTR, &opts.cache,
+                         "tag array to drive, l1 or l2", "l2");
+  option_parser_cmdline(opp, argc, argv);
+  assert(setlocale(LC_NUMERIC, "C"));
+  ctx->the_gpgpusim->g_the_gpu_config->init();
+  micro_gpu *gpu = new micro_gpu(*ctx->the_gpgpusim->g_the_gpu_config, ctx);
+  ctx->the_gpgpusim->g_the_gpu = gpu;
+  gpu->init();
+  return gpu;
+}
+
+class address_stream {
+ public:
+  address_stream(const std::string &pattern, const micro_options &opts)
+      : m_pattern(pattern),
+        m_footprint((unsigned long long)opts.footprint_mb << 20),
+        m_stride(opts.stride),
+        m_next(0),
+        m_rng(0x9e3779b97f4a7c15ull) {
+    assert(m_footprint && m_stride);
+  }
+
+  new_addr_type next() {
+    unsigned long long a;
+    if (m_pattern == "streaming") {
+      a = (m_next++ * SECTOR_SIZE) % m_footprint;
+    } else if (m_pattern == "strided") {
+      // shift by a sector on every wrap so all sectors get touched
+      unsigned long long per_pass = m_footprint / m_stride;
+      unsigned long long pass = m_next / per_pass;
+      a = ((m_next % per_pass) * m_stride + pass * SECTOR_SIZE) % m_footprint;
+      m_next++;
+    } else if (m_pattern == "tex_tile") {
+      // a square texture filling the footprint
+      const unsigned tile = 8, texel = 4;
+      unsigned long long width = 1;
+      while (width * width * 4 * texel <= m_footprint) width *= 2;
+      unsigned long long x = m_next % width, y = (m_next / width) % width;
+      unsigned long long tiles_x = width / tile;
+      a = (((y / tile) * tiles_x + x / tile) * tile * tile +
+           (y % tile) * tile + x % tile) *
+          texel;
+      m_next++;
+    } else {
+      assert(m_pattern == "random");
+      m_rng ^= m_rng << 13;
+      m_rng ^= m_rng >> 7;
+      m_rng ^= m_rng << 17;
+      a = (m_rng % (m_footprint / SECTOR_SIZE)) * SECTOR_SIZE;
+    }
+    return a;
+  }
+
+ private:
+  std::string m_pattern;
+  unsigned long long m_footprint;
+  unsigned long long m_stride;
+  unsigned long long m_next;
+  unsigned long long m_rng;
+};
+
+static std::vector<std::string> micro_patterns(const micro_options &opts) {
+  std::vector<std::string> all = {"streaming", "strided", "tex_tile",
+                                  "random"};
+  if (!strcmp(opts.pattern, "all")) return all;
+  return std::vector<std::string>(1, opts.pattern);
+}
+
+// a 32B read of addr as the L1 of cluster tpc would send it
+static mem_fetch *micro_fetch(micro_gpu *gpu, new_addr_type addr,
+                              unsigned tpc = 0) {
+  mem_access_sector_mask_t sectors;
+  sectors.set((addr / SECTOR_SIZE) % SECTOR_CHUNCK_SIZE);
+  mem_access_byte_mask_t bytes;
+  unsigned first = (addr % MAX_MEMORY_ACCESS_SIZE) / SECTOR_SIZE * SECTOR_SIZE;
+  for (unsigned b = 0; b < SECTOR_SIZE; b++) bytes.set(first + b);
+  active_mask_t warp;
+  warp.set(0);
+  mem_access_t access(GLOBAL_ACC_R, addr, SECTOR_SIZE, false, warp, bytes,
+                      sectors, gpu->gpgpu_ctx);
+  return new mem_fetch(access, NULL, READ_PACKET_SIZE, 0, 0, tpc,
+                       gpu->getMemoryConfig(), 0, 0);
+}
+
+typedef std::chrono::steady_clock micro_clock;
+
+static void micro_report(const char *bench, const std::string &pattern,
+                         unsigned long long ops, micro_clock::duration t,
+                         const char *extra = "") {
+  double ns = std::chrono::duration<double, std::nano>(t).count();
+  printf("%s %-10s %12llu ops %10.2f ns/op %s\n", bench, pattern.c_str(), ops,
+         ops ? ns / ops : 0.0, extra);
+  fflush(stdout);
+}
+
+#endif
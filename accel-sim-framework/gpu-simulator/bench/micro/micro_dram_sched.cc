@@ -0,0 +1,74 @@
+// frfcfs_scheduler add_req and schedule on one channel
+//
+// The queue is kept full: once it holds -gpgpu_frfcfs_dram_sched_queue_size
+// requests (64 when unlimited) every request added is matched by a schedule
+// call on the next bank in turn that has one, the way a channel that issues
+// a column command per cycle would drain it. An operation is one add_req
+// and one schedule. All the addresses go to the one channel, mapped to
+// their bank and row as the configured address decoder places them.
+
+#include "micro_bench.h"
+
+#include "gpgpu-sim/dram.h"
+#include "gpgpu-sim/dram_sched.h"
+
+static const unsigned BATCH = 4096;
+
+int main(int argc, const char *argv[]) {
+  micro_options opts;
+  micro_gpu *gpu = micro_init(argc, argv, opts);
+  const memory_config *config = gpu->getMemoryConfig();
+  unsigned depth = config->gpgpu_frfcfs_dram_sched_queue_size
+                       ? config->gpgpu_frfcfs_dram_sched_queue_size
+                       : 64;
+
+  for (const std::string &pattern : micro_patterns(opts)) {
+    dram_t dram(0, config, gpu->memory_stats(), NULL, gpu);
+    frfcfs_scheduler sched(config, &dram, gpu->memory_stats());
+    std::vector<unsigned> open_row(config->nbk, 0);
+    unsigned next_bank = 0;
+    address_stream stream(pattern, opts);
+    std::vector<dram_req_t *> batch(BATCH);
+    std::vector<dram_req_t *> served;
+    micro_clock::duration t(0);
+    unsigned long long row_hits = 0;
+    for (unsigned done = 0; done < opts.ops; done += BATCH) {
+      unsigned n = std::min(BATCH, opts.ops - done);
+      for (unsigned i = 0; i < n; i++)
+        batch[i] = new dram_req_t(micro_fetch(gpu, stream.next()), config->nbk,
+                                  config->dram_bnk_indexing_policy, gpu);
+      micro_clock::time_point start = micro_clock::now();
+      for (unsigned i = 0; i < n; i++) {
+        sched.add_req(batch[i]);
+        if (sched.num_pending() < depth) continue;
+        for (unsigned b = 0; b < config->nbk; b++) {
+          unsigned bank = next_bank;
+          next_bank = (next_bank + 1) % config->nbk;
+          dram_req_t *req = sched.schedule(bank, open_row[bank]);
+          if (!req) continue;
+          row_hits += req->row == open_row[bank];
+          open_row[bank] = req->row;
+          served.push_back(req);
+          break;
+        }
+      }
+      t += micro_clock::now() - start;
+      for (dram_req_t *req : served) {
+        delete req->data;
+        delete req;
+      }
+      served.clear();
+    }
+    // the requests still queued are not timed
+    for (unsigned b = 0; b < config->nbk; b++)
+      while (dram_req_t *req = sched.schedule(b, open_row[b])) {
+        delete req->data;
+        delete req;
+      }
+    char extra[64];
+    snprintf(extra, sizeof(extra), "row hit rate %.3f",
+             opts.ops ? (double)row_hits / opts.ops : 0.0);
+    micro_report("frfcfs", pattern, opts.ops, t, extra);
+  }
+  return 0;
+}
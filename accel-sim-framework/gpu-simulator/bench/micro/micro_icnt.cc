@@ -0,0 +1,66 @@
+// Interconnect push and pop through icnt_wrapper
+//
+// Runs whichever network -network_mode configures: intersim2, the local
+// crossbar or the analytical model. Every cycle each cluster pushes a read
+// of the next address to the sub partition it maps to, each sub partition
+// pops one request and pushes its reply back, each cluster pops one reply,
+// and the network advances. An operation is one request delivered and
+// replied to; the cycles it took are reported alongside.
+
+#include "micro_bench.h"
+
+int main(int argc, const char *argv[]) {
+  micro_options opts;
+  micro_gpu *gpu = micro_init(argc, argv, opts);
+  const shader_core_config *shader = gpu->getShaderCoreConfig();
+  const memory_config *config = gpu->getMemoryConfig();
+  unsigned clusters = shader->n_simt_clusters;
+  unsigned subs = config->m_n_mem_sub_partition;
+
+  for (const std::string &pattern : micro_patterns(opts)) {
+    address_stream stream(pattern, opts);
+    unsigned long long sent = 0, replied = 0, cycles = 0;
+    // a request the network had no room for waits for the next cycle
+    std::vector<mem_fetch *> waiting(clusters, (mem_fetch *)NULL);
+    std::vector<mem_fetch *> replies(subs, (mem_fetch *)NULL);
+    micro_clock::time_point start = micro_clock::now();
+    while (replied < opts.ops) {
+      for (unsigned c = 0; c < clusters; c++) {
+        if (!waiting[c] && sent < opts.ops) {
+          waiting[c] = micro_fetch(gpu, stream.next(), c);
+          sent++;
+        }
+        mem_fetch *mf = waiting[c];
+        if (!mf || !::icnt_has_buffer(c, mf->get_ctrl_size())) continue;
+        ::icnt_push(c, shader->mem2device(mf->get_sub_partition_id()), mf,
+                    mf->get_ctrl_size());
+        waiting[c] = NULL;
+      }
+      for (unsigned s = 0; s < subs; s++) {
+        if (!replies[s]) {
+          replies[s] = (mem_fetch *)::icnt_pop(shader->mem2device(s));
+          if (replies[s]) replies[s]->set_reply();
+        }
+        mem_fetch *mf = replies[s];
+        if (!mf || !::icnt_has_buffer(shader->mem2device(s), mf->size()))
+          continue;
+        ::icnt_push(shader->mem2device(s), mf->get_tpc(), mf, mf->size());
+        replies[s] = NULL;
+      }
+      for (unsigned c = 0; c < clusters; c++) {
+        mem_fetch *mf = (mem_fetch *)::icnt_pop(c);
+        if (!mf) continue;
+        delete mf;
+        replied++;
+      }
+      ::icnt_transfer();
+      cycles++;
+    }
+    micro_clock::duration t = micro_clock::now() - start;
+    char extra[64];
+    snprintf(extra, sizeof(extra), "%.2f cycles/op",
+             opts.ops ? (double)cycles / opts.ops : 0.0);
+    micro_report("icnt", pattern, opts.ops, t, extra);
+  }
+  return 0;
+}
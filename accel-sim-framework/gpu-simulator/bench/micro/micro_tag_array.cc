@@ -0,0 +1,56 @@
+// tag_array probe, access and fill on the configured L1D or L2
+//
+// Every operation probes the block of the next address, updates the
+// replacement state by accessing it and fills the line right away on a
+// miss, as a cache whose misses return at once would. -micro_cache picks
+// the L1D of a core or one L2 sub partition bank.
+
+#include "micro_bench.h"
+
+static const unsigned BATCH = 4096;
+
+int main(int argc, const char *argv[]) {
+  micro_options opts;
+  micro_gpu *gpu = micro_init(argc, argv, opts);
+  const char *cache = opts.cache;
+
+  cache_config config =
+      !strcmp(cache, "l1")
+          ? (cache_config)gpu->getShaderCoreConfig()->m_L1D_config
+          : (cache_config)gpu->getMemoryConfig()->m_L2_config;
+  for (const std::string &pattern : micro_patterns(opts)) {
+    tag_array tags(config, -1, -1, gpu);
+    address_stream stream(pattern, opts);
+    std::vector<mem_fetch *> batch(BATCH);
+    micro_clock::duration t(0);
+    unsigned long long hits = 0;
+    for (unsigned done = 0; done < opts.ops; done += BATCH) {
+      unsigned n = std::min(BATCH, opts.ops - done);
+      for (unsigned i = 0; i < n; i++)
+        batch[i] = micro_fetch(gpu, stream.next());
+      micro_clock::time_point start = micro_clock::now();
+      for (unsigned i = 0; i < n; i++) {
+        mem_fetch *mf = batch[i];
+        new_addr_type block = config.block_addr(mf->get_addr());
+        unsigned idx;
+        bool wb;
+        evicted_block_info evicted;
+        enum cache_request_status status =
+            tags.probe(block, idx, mf, false);
+        if (status == RESERVATION_FAIL) continue;
+        tags.access(block, done + i, idx, wb, evicted, mf);
+        if (status == MISS || status == SECTOR_MISS)
+          tags.fill(idx, done + i, mf);
+        else
+          hits++;
+      }
+      t += micro_clock::now() - start;
+      for (unsigned i = 0; i < n; i++) delete batch[i];
+    }
+    char extra[64];
+    snprintf(extra, sizeof(extra), "hit rate %.3f",
+             opts.ops ? (double)hits / opts.ops : 0.0);
+    micro_report(cache, pattern, opts.ops, t, extra);
+  }
+  return 0;
+}
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+
+# Throughput of the simulator itself on small fixed trace slices.
+#
+# Every slice runs under every pinned config and the run reports simulated
+# cycles and instructions per wall second and the peak RSS of the simulator
+# process. The slices are cut from the Vulkan and compute traces under
+# hw_run/traces/vulkan (see util/graphics/setup_concurrent.py):
+#   vertex_frag  the first VERTEX and FRAG kernels of render_passes_2k
+#   vio          the first kernel of vpi_sample_03_harris_corners
+#   concurrent   both of them, run with -gpgpu_concurrent_kernel_sm
+# The results are written as JSON to compare a change against a baseline
+# run of the same slices; `make bench` in gpu-simulator runs this script.
+# -p adds options to every run, e.g. -p "-network_mode 3" to set the
+# analytical interconnect against the config's own.
+
+from optparse import OptionParser
+import glob
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+this_dir = os.path.dirname(os.path.realpath(__file__))
+gpu_sim_dir = os.path.join(this_dir, "..")
+
+CONFIGS = ["SM75_RTX2060", "SM86_RTX3070"]
+GRAPHICS = "render_passes_2k"
+COMPUTE = "vpi_sample_03_harris_corners"
+SLICES = {
+    "vertex_frag": {"graphics": True, "compute": False, "params": ""},
+    "vio": {"graphics": False, "compute": True, "params": ""},
+    "concurrent": {"graphics": True, "compute": True,
+                   "params": "-gpgpu_concurrent_kernel_sm 1"},
+}
+
+
+def kernelslist(app_dir):
+    lists = glob.glob(os.path.join(app_dir, "*", "traces", "kernelslist.g"))
+    if not lists:
+        sys.exit("ERROR - no kernelslist.g under " + app_dir)
+    return sorted(lists)[0]
+
+
+# the commands up to and including the kernels wanted, memcpys included
+def cut(list_file, graphics):
+    lines = [l.strip() for l in open(list_file) if l.strip()]
+    out = []
+    kernels = []
+    for line in lines:
+        out.append(line)
+        if "kernel" not in line or line.startswith("Memcpy"):
+            continue
+        kernels.append(line)
+        if not graphics:
+            break
+        # a draw is a vertex kernel and the fragment kernel after it
+        if "FRAG" in line or len(kernels) == 2:
+            break
+    return out, kernels
+
+
+def make_slice(name, spec, trace_root, work_dir):
+    slice_dir = os.path.join(work_dir, "traces", name)
+    if os.path.exists(slice_dir):
+        shutil.rmtree(slice_dir)
+    os.makedirs(slice_dir)
+    commands = []
+    srcs = []
+    if spec["graphics"]:
+        srcs.append((kernelslist(os.path.join(trace_root, GRAPHICS)), True, ""))
+    if spec["compute"]:
+        srcs.append((kernelslist(os.path.join(trace_root, COMPUTE)), False,
+                     "c-" if spec["graphics"] else ""))
+    for list_file, graphics, prefix in srcs:
+        lines, kernels = cut(list_file, graphics)
+        for line in lines:
+            if line in kernels:
+                os.symlink(os.path.join(os.path.dirname(list_file), line),
+                           os.path.join(slice_dir, prefix + line))
+                line = prefix + line
+            commands.append(line)
+    open(os.path.join(slice_dir, "kernelslist.g"), "w").write(
+        "\n".join(commands) + "\n")
+    return os.path.join(slice_dir, "kernelslist.g")
+
+
+def make_config(config, params, run_dir):
+    gpgpu_cfg = os.path.join(gpu_sim_dir, "gpgpu-sim", "configs",
+                             "tested-cfgs", config)
+    text = open(os.path.join(gpgpu_cfg, "gpgpusim.config")).read()
+    text += "\n# Accel-Sim Parameters\n"
+    text += open(os.path.join(gpu_sim_dir, "configs", "tested-cfgs", config,
+                              "trace.config")).read()
+    text += "\n" + params + "\n"
+    for icnt in glob.glob(os.path.join(gpgpu_cfg, "*.icnt")):
+        shutil.copy(icnt, run_dir)
+    open(os.path.join(run_dir, "gpgpusim.config"), "w").write(text)
+
+
+def run(binary, list_file, run_dir):
+    log = open(os.path.join(run_dir, "sim.log"), "w")
+    start = time.time()
+    proc = subprocess.Popen([binary, "-config", "./gpgpusim.config",
+                             "-trace", list_file],
+                            cwd=run_dir, stdout=log, stderr=subprocess.STDOUT)
+    # the rusage of this child alone, in KB on Linux
+    pid, status, usage = os.wait4(proc.pid, 0)
+    wall = time.time() - start
+    log.close()
+    text = open(os.path.join(run_dir, "sim.log")).read()
+    cycles = re.findall(r"gpu_tot_sim_cycle = (\d+)", text)
+    insn = re.findall(r"gpu_tot_sim_insn = (\d+)", text)
+    cycles = int(cycles[-1]) if cycles else 0
+    insn = int(insn[-1]) if insn else 0
+    return {
+        "exit_status": os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1,
+        "wall_sec": round(wall, 3),
+        "sim_cycles": cycles,
+        "sim_insn": insn,
+        "cycles_per_sec": round(cycles / wall, 1) if wall else 0,
+        "insn_per_sec": round(insn / wall, 1) if wall else 0,
+        "peak_rss_kb": usage.ru_maxrss,
+    }
+
+
+if __name__ == "__main__":
+    parser = OptionParser()
+    parser.add_option("-b", "--binary", dest="binary",
+                      default=os.path.join(gpu_sim_dir, "bin", "release",
+                                           "accel-sim.out"),
+                      help="the accel-sim.out to time")
+    parser.add_option("-T", "--trace_root", dest="trace_root",
+                      default=os.path.join(gpu_sim_dir, "..", "hw_run",
+                                           "traces", "vulkan"),
+                      help="directory holding the " + GRAPHICS + " and " +
+                      COMPUTE + " traces")
+    parser.add_option("-w", "--work_dir", dest="work_dir",
+                      default=os.path.join(gpu_sim_dir, "bench", "runs"),
+                      help="where the slices and run directories go")
+    parser.add_option("-o", "--output", dest="output",
+                      default="bench-results.json",
+                      help="JSON file the results are written to")
+    parser.add_option("-B", "--build", dest="build",
+                      default=os.getenv("ACCELSIM_BUILD", ""),
+                      help="build string recorded with the results")
+    parser.add_option("-C", "--configs", dest="configs",
+                      default=",".join(CONFIGS),
+                      help="comma separated tested-cfgs to run")
+    parser.add_option("-S", "--slices", dest="slices",
+                      default=",".join(sorted(SLICES)),
+                      help="comma separated slices to run")
+    parser.add_option("-p", "--params", dest="params", default="",
+                      help="extra simulator options for every run")
+    (options, args) = parser.parse_args()
+    # the simulator runs inside the run directories
+    options.binary = os.path.abspath(options.binary)
+    options.work_dir = os.path.abspath(options.work_dir)
+
+    if not os.access(options.binary, os.X_OK):
+        sys.exit("ERROR - cannot run " + options.binary)
+    results = []
+    for name in options.slices.split(","):
+        list_file = make_slice(name, SLICES[name], options.trace_root,
+                               options.work_dir)
+        for config in options.configs.split(","):
+            run_dir = os.path.join(options.work_dir, name + "." + config)
+            if os.path.exists(run_dir):
+                shutil.rmtree(run_dir)
+            os.makedirs(run_dir)
+            make_config(config, SLICES[name]["params"] + "\n" +
+                        options.params, run_dir)
+            result = run(options.binary, list_file, run_dir)
+            result["slice"] = name
+            result["config"] = config
+            print("%-12s %-14s %10.1f cycles/s %12.1f insn/s %8d KB" %
+                  (name, config, result["cycles_per_sec"],
+                   result["insn_per_sec"], result["peak_rss_kb"]))
+            results.append(result)
+
+    json.dump({"build": options.build,
+               "params": options.params,
+               "date": time.strftime("%Y-%m-%d %H:%M:%S"),
+               "results": results},
+              open(options.output, "w"), indent=1)
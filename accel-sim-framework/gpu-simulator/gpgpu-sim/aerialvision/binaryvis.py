@@ -0,0 +1,176 @@
+#!/usr/bin/env python
+
+# Reads the -visualizer_binary log (see src/gpgpu-sim/visualizer_binary.h)
+# into the AerialVision stat variables. The columns are cumulative counters,
+# so every stat below is the rate over the interval since the previous
+# sample: the IPC, warp occupancy, L2 and DRAM bandwidth and issue slot
+# stall breakdown of the compute and graphics class, and the IPC and CTA
+# progress of each kernel. A log of a running simulation is read up to its
+# last complete block. Run on its own it prints the columns of a log.
+
+import struct
+import sys
+import zlib
+
+MAGIC = b"GSVISBN1"
+CLASSES = ["compute", "graphics"]
+STALLS = ["idle", "barrier", "scoreboard", "exec_pipe", "mem_pipe",
+          "other_issued", "issued"]
+
+
+def isBinaryLog(filename):
+    try:
+        f = open(filename, "rb")
+        head = f.read(64)
+        f.close()
+        return zlib.decompressobj(31).decompress(head)[:8] == MAGIC
+    except (IOError, zlib.error):
+        return False
+
+
+class reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def left(self):
+        return len(self.data) - self.pos
+
+    def unpack(self, fmt):
+        size = struct.calcsize(fmt)
+        if self.left() < size:
+            raise EOFError
+        v = struct.unpack_from(fmt, self.data, self.pos)
+        self.pos += size
+        return v
+
+    def name(self):
+        (n,) = self.unpack("<H")
+        if self.left() < n:
+            raise EOFError
+        s = self.data[self.pos:self.pos + n].decode("ascii")
+        self.pos += n
+        return s
+
+
+# (constants, columns) of a log, both dicts by name, a column holds a value
+# for every sample
+def readLog(filename):
+    f = open(filename, "rb")
+    # a running simulation has not written the gzip trailer yet
+    data = zlib.decompressobj(31).decompress(f.read())
+    f.close()
+    r = reader(data)
+    if r.unpack("<8s")[0] != MAGIC:
+        raise ValueError("%s is not a binary visualizer log" % filename)
+    (version, n) = r.unpack("<II")
+    if version != 1:
+        raise ValueError("unknown binary visualizer log version %d" % version)
+    constants = {}
+    for i in range(n):
+        name = r.name()
+        constants[name] = r.unpack("<d")[0]
+    columns = {}
+    samples = 0
+    while r.left():
+        start = r.pos
+        try:
+            (rows, ncols) = r.unpack("<II")
+            block = {}
+            for c in range(ncols):
+                name = r.name()
+                block[name] = list(r.unpack("<%dd" % rows))
+        except EOFError:
+            r.pos = start
+            break
+        # a column missing from a block kept its last value
+        for name in block:
+            if name not in columns:
+                columns[name] = [0.0] * samples
+        for name in columns:
+            if name in block:
+                columns[name] += block[name]
+            else:
+                last = columns[name][-1] if columns[name] else 0.0
+                columns[name] += [last] * rows
+        samples += rows
+    return constants, columns
+
+
+def deltas(values):
+    return [values[i] - (values[i - 1] if i else 0)
+            for i in range(len(values))]
+
+
+def ratio(num, den):
+    return [float(n) / d if d else 0.0 for n, d in zip(num, den)]
+
+
+def scalar(data, datatype=float):
+    import variableclasses as vc
+    v = vc.variable('', 1, 0, 'scalar', datatype)
+    v.data = [datatype(x) for x in data]
+    return v
+
+
+def stackbar(rows):
+    import variableclasses as vc
+    v = vc.variable('', 3, 0, 'stackbar', int)
+    for sample in zip(*rows):
+        v.data += [int(x) for x in sample] + ["NULL"]
+    return v
+
+
+# the stat variables of a log, for lexyacc.parseMe
+def parseMe(filename):
+    constants, columns = readLog(filename)
+    print("Read %d samples of %d columns from the binary log %s" %
+          (len(columns.get("cycle", [])), len(columns), filename))
+    cycles = deltas(columns["cycle"])
+    warps = constants["num_sms"] * constants["max_warps_per_sm"]
+    variables = {
+        'globalCycle': scalar(columns["cycle"], int),
+        'globalInsn': scalar(columns["insn"], int),
+        'globalIPC': scalar(ratio(deltas(columns["insn"]), cycles)),
+        'warpOccupancy': scalar(ratio(deltas(columns["warp_slots_filled"]),
+                                      deltas(columns["warp_slots_total"]))),
+        'activeSMs': scalar(columns["active_sms"], int),
+        'graphicsSMs': scalar(columns["graphics_sms"], int),
+        'CFLOG': {}
+    }
+    for c in CLASSES:
+        col = lambda name: columns[c + "_" + name]
+        variables[c + 'IPC'] = scalar(ratio(deltas(col("thread_insts")),
+                                            cycles))
+        threads = col("occupied_threads")
+        variables[c + 'WarpOccupancy'] = scalar(
+            [t / constants["warp_size"] / warps if warps else 0.0
+             for t in threads])
+        l2 = deltas(col("l2_accesses"))
+        variables[c + 'L2AccessesPerCycle'] = scalar(ratio(l2, cycles))
+        variables[c + 'L2HitRate'] = scalar(ratio(deltas(col("l2_hits")), l2))
+        variables[c + 'DRAMAccessesPerCycle'] = scalar(
+            ratio(deltas(col("dram_accesses")), cycles))
+        variables[c + 'DRAMBytesPerCycle'] = scalar(
+            ratio(deltas(col("dram_bytes")), cycles))
+        variables[c + 'StallBreakdown'] = stackbar(
+            [deltas(col("stall_" + s)) for s in STALLS])
+    kernels = sorted(set(int(name[6:name.index("_")]) for name in columns
+                         if name.startswith("kernel")))
+    for k in kernels:
+        col = lambda name: columns["kernel%d_%s" % (k, name)]
+        variables['kernel%dIPC' % k] = scalar(ratio(deltas(col("insn")),
+                                                    cycles))
+        variables['kernel%dIssuedCTAs' % k] = scalar(col("issued_ctas"), int)
+    return variables
+
+
+if __name__ == "__main__":
+    for filename in sys.argv[1:]:
+        constants, columns = readLog(filename)
+        for name in sorted(constants):
+            print("%s = %g" % (name, constants[name]))
+        for name in sorted(columns):
+            values = columns[name]
+            print("%s: %d samples, last %g" %
+                  (name, len(values), values[-1] if values else 0))
@@ -61,6 +61,7 @@ import gzip
 import gc
 
 import variableclasses as vc
+import binaryvis
 
 global skipCFLOGParsing
 skipCFLOGParsing = 0
@@ -109,6 +110,10 @@ def import_user_defined_variables(variables):
 
 # Parses through a given log file for data
 def parseMe(filename):
+
+    # the -visualizer_binary log has its own reader
+    if binaryvis.isBinaryLog(filename):
+        return binaryvis.parseMe(filename)
     
     #The lexer
         
@@ -39,13 +39,15 @@
 #include "cuda-sim/memory.h"
 #include "cuda-sim/ptx-stats.h"
 #include "cuda-sim/ptx_ir.h"
+#include "gpgpu-sim/core_stage_log.h"
 #include "gpgpu-sim/gpu-sim.h"
+#include "gpgpu-sim/shmem_banks.h"
 #include "gpgpusim_entrypoint.h"
 #include "option_parser.h"
 
 void mem_access_t::init(gpgpu_context *ctx) {
   gpgpu_ctx = ctx;
-  m_uid = ++(gpgpu_ctx->sm_next_access_uid);
+  m_uid = core_stage_take_uid(gpgpu_ctx->sm_next_access_uid) + 1;
   m_addr = 0;
   m_req_size = 0;
 }
@@ -54,7 +56,7 @@ void warp_inst_t::issue(const active_mask_t &mask, unsigned warp_id,
                         int sch_id) {
   m_warp_active_mask = mask;
   m_warp_issued_mask = mask;
-  m_uid = ++(m_config->gpgpu_ctx->warp_inst_sm_next_uid);
+  core_stage_number(m_uid, m_config->gpgpu_ctx->warp_inst_sm_next_uid);
   m_warp_id = warp_id;
   m_dynamic_warp_id = dynamic_warp_id;
   issue_cycle = cycle;
@@ -337,89 +339,11 @@ void warp_inst_t::generate_mem_accesses() {
   switch (space.get_type()) {
     case shared_space:
     case sstarr_space: {
-      unsigned subwarp_size = m_config->warp_size / m_config->mem_warp_parts;
-      unsigned total_accesses = 0;
-      for (unsigned subwarp = 0; subwarp < m_config->mem_warp_parts;
-           subwarp++) {
-        // data structures used per part warp
-        std::map<unsigned, std::map<new_addr_type, unsigned> >
-            bank_accs;  // bank -> word address -> access count
-
-        // step 1: compute accesses to words in banks
-        for (unsigned thread = subwarp * subwarp_size;
-             thread < (subwarp + 1) * subwarp_size; thread++) {
-          if (!active(thread)) continue;
-          new_addr_type addr = m_per_scalar_thread[thread].memreqaddr[0];
-          // FIXME: deferred allocation of shared memory should not accumulate
-          // across kernel launches assert( addr < m_config->gpgpu_shmem_size );
-          unsigned bank = m_config->shmem_bank_func(addr);
-          new_addr_type word =
-              line_size_based_tag_func(addr, m_config->WORD_SIZE);
-          bank_accs[bank][word]++;
-        }
-
-        if (m_config->shmem_limited_broadcast) {
-          // step 2: look for and select a broadcast bank/word if one occurs
-          bool broadcast_detected = false;
-          new_addr_type broadcast_word = (new_addr_type)-1;
-          unsigned broadcast_bank = (unsigned)-1;
-          std::map<unsigned, std::map<new_addr_type, unsigned> >::iterator b;
-          for (b = bank_accs.begin(); b != bank_accs.end(); b++) {
-            unsigned bank = b->first;
-            std::map<new_addr_type, unsigned> &access_set = b->second;
-            std::map<new_addr_type, unsigned>::iterator w;
-            for (w = access_set.begin(); w != access_set.end(); ++w) {
-              if (w->second > 1) {
-                // found a broadcast
-                broadcast_detected = true;
-                broadcast_bank = bank;
-                broadcast_word = w->first;
-                break;
-              }
-            }
-            if (broadcast_detected) break;
-          }
-
-          // step 3: figure out max bank accesses performed, taking account of
-          // broadcast case
-          unsigned max_bank_accesses = 0;
-          for (b = bank_accs.begin(); b != bank_accs.end(); b++) {
-            unsigned bank_accesses = 0;
-            std::map<new_addr_type, unsigned> &access_set = b->second;
-            std::map<new_addr_type, unsigned>::iterator w;
-            for (w = access_set.begin(); w != access_set.end(); ++w)
-              bank_accesses += w->second;
-            if (broadcast_detected && broadcast_bank == b->first) {
-              for (w = access_set.begin(); w != access_set.end(); ++w) {
-                if (w->first == broadcast_word) {
-                  unsigned n = w->second;
-                  assert(n > 1);  // or this wasn't a broadcast
-                  assert(bank_accesses >= (n - 1));
-                  bank_accesses -= (n - 1);
-                  break;
-                }
-              }
-            }
-            if (bank_accesses > max_bank_accesses)
-              max_bank_accesses = bank_accesses;
-          }
-
-          // step 4: accumulate
-          total_accesses += max_bank_accesses;
-        } else {
-          // step 2: look for the bank with the maximum number of access to
-          // different words
-          unsigned max_bank_accesses = 0;
-          std::map<unsigned, std::map<new_addr_type, unsigned> >::iterator b;
-          for (b = bank_accs.begin(); b != bank_accs.end(); b++) {
-            max_bank_accesses =
-                std::max(max_bank_accesses, (unsigned)b->second.size());
-          }
-
-          // step 3: accumulate
-          total_accesses += max_bank_accesses;
-        }
-      }
+      new_addr_type addrs[MAX_WARP_SIZE];
+      for (unsigned thread = 0; thread < m_config->warp_size; thread++)
+        addrs[thread] = m_per_scalar_thread[thread].memreqaddr[0];
+      unsigned total_accesses =
+          shmem_bank_accesses(m_config, addrs, get_active_mask());
       assert(total_accesses > 0 && total_accesses <= m_config->warp_size);
       cycles = total_accesses;  // shared memory conflicts modeled as larger
                                 // initiation interval
@@ -439,7 +363,9 @@ void warp_inst_t::generate_mem_accesses() {
     case global_space:
     case local_space:
     case param_space_local:
-      if (m_config->gpgpu_coalesce_arch >= 13) {
+      if (is_l1t_tex()) {
+        memory_coalescing_tex(TEXTURE_ACC_R);
+      } else if (m_config->gpgpu_coalesce_arch >= 13) {
         if (isatomic())
           memory_coalescing_arch_atomic(is_write, access_type);
         else
@@ -491,6 +417,61 @@ void warp_inst_t::generate_mem_accesses() {
   m_mem_accesses_created = true;
 }
 
+void warp_inst_t::memory_coalescing_tex(mem_access_type access_type) {
+  // the trace lists every texel address a thread's filter footprint samples,
+  // and the footprints of the threads of a quad mostly overlap, so each
+  // texture line is requested once for all the threads that sample it
+  unsigned line_size = m_config->gpgpu_cache_texl1_linesize;
+  assert(line_size <= MAX_MEMORY_ACCESS_SIZE);
+  static thread_local std::vector<std::pair<new_addr_type, transaction_info> >
+      lines;
+  lines.clear();
+  unsigned last = 0;
+  for (unsigned thread = 0; thread < m_config->warp_size; thread++) {
+    if (!active(thread)) continue;
+    for (unsigned access = 0;
+         (access < MAX_ACCESSES_PER_INSN_PER_THREAD) &&
+         (m_per_scalar_thread[thread].memreqaddr[access] != 0);
+         access++) {
+      new_addr_type addr = m_per_scalar_thread[thread].memreqaddr[access];
+      unsigned size = data_size;
+      while (size) {
+        new_addr_type block_address = line_size_based_tag_func(addr, line_size);
+        unsigned idx = addr - block_address;
+        unsigned n = std::min(size, line_size - idx);
+        if (lines.empty() || lines[last].first != block_address) {
+          last = 0;
+          while (last < lines.size() && lines[last].first != block_address)
+            last++;
+          if (last == lines.size())
+            lines.push_back(std::make_pair(block_address, transaction_info()));
+        }
+        transaction_info &info = lines[last].second;
+        info.active.set(thread);
+        mem_access_byte_mask_t bytes;
+        bytes.set();
+        bytes >>= MAX_MEMORY_ACCESS_SIZE - n;
+        info.bytes |= bytes << idx;
+        addr += n;
+        size -= n;
+      }
+    }
+  }
+
+  if (lines.size() > 1)
+    std::sort(lines.begin(), lines.end(),
+              [](const std::pair<new_addr_type, transaction_info> &a,
+                 const std::pair<new_addr_type, transaction_info> &b) {
+                return a.first < b.first;
+              });
+  for (unsigned l = 0; l < lines.size(); l++)
+    m_accessq.push_back(mem_access_t(access_type, lines[l].first, line_size,
+                                     false, lines[l].second.active,
+                                     lines[l].second.bytes,
+                                     mem_access_sector_mask_t(),
+                                     m_config->gpgpu_ctx));
+}
+
 void warp_inst_t::memory_coalescing_arch(bool is_write,
                                          mem_access_type access_type) {
   // see the CUDA manual where it discusses coalescing rules before reading this
@@ -526,8 +507,14 @@ void warp_inst_t::memory_coalescing_arch(bool is_write,
   }
   unsigned subwarp_size = m_config->warp_size / warp_parts;
 
+  // transactions of the current subwarp in first-touch order, sorted by block
+  // address before they are sent; neighbouring threads nearly always share
+  // the block touched last, which is checked before searching
+  static thread_local std::vector<std::pair<new_addr_type, transaction_info> >
+      subwarp_transactions;
   for (unsigned subwarp = 0; subwarp < warp_parts; subwarp++) {
-    std::map<new_addr_type, transaction_info> subwarp_transactions;
+    subwarp_transactions.clear();
+    unsigned last = 0;
 
     // step 1: find all transactions generated by this subwarp
     for (unsigned thread = subwarp * subwarp_size;
@@ -557,53 +544,64 @@ void warp_inst_t::memory_coalescing_arch(bool is_write,
         new_addr_type addr = m_per_scalar_thread[thread].memreqaddr[access];
         new_addr_type block_address =
             line_size_based_tag_func(addr, segment_size);
-        unsigned chunk =
-            (addr & 127) / 32;  // which 32-byte chunk within in a 128-byte
-                                // chunk does this thread access?
-        transaction_info &info = subwarp_transactions[block_address];
-
         // can only write to one segment
         // it seems like in trace driven, a thread can write to more than one
         // segment assert(block_address ==
         // line_size_based_tag_func(addr+data_size_coales-1,segment_size));
-
-        info.chunks.set(chunk);
-        info.active.set(thread);
-        unsigned idx = (addr & 127);
-        for (unsigned i = 0; i < data_size_coales; i++)
-          if ((idx + i) < MAX_MEMORY_ACCESS_SIZE) info.bytes.set(idx + i);
+        coalesce_thread_access(subwarp_transactions, last, block_address, addr,
+                               thread, data_size_coales);
 
         // it seems like in trace driven, a thread can write to more than one
         // segment handle this special case
         if (block_address != line_size_based_tag_func(
                                  addr + data_size_coales - 1, segment_size)) {
           addr = addr + data_size_coales - 1;
-          new_addr_type block_address =
-              line_size_based_tag_func(addr, segment_size);
-          unsigned chunk = (addr & 127) / 32;
-          transaction_info &info = subwarp_transactions[block_address];
-          info.chunks.set(chunk);
-          info.active.set(thread);
-          unsigned idx = (addr & 127);
-          for (unsigned i = 0; i < data_size_coales; i++)
-            if ((idx + i) < MAX_MEMORY_ACCESS_SIZE) info.bytes.set(idx + i);
+          coalesce_thread_access(subwarp_transactions, last,
+                                 line_size_based_tag_func(addr, segment_size),
+                                 addr, thread, data_size_coales);
         }
       }
     }
 
     // step 2: reduce each transaction size, if possible
-    std::map<new_addr_type, transaction_info>::iterator t;
-    for (t = subwarp_transactions.begin(); t != subwarp_transactions.end();
-         t++) {
-      new_addr_type addr = t->first;
-      const transaction_info &info = t->second;
-
-      memory_coalescing_arch_reduce_and_send(is_write, access_type, info, addr,
-                                             segment_size);
+    if (subwarp_transactions.size() > 1)
+      std::sort(subwarp_transactions.begin(), subwarp_transactions.end(),
+                [](const std::pair<new_addr_type, transaction_info> &a,
+                   const std::pair<new_addr_type, transaction_info> &b) {
+                  return a.first < b.first;
+                });
+    for (unsigned t = 0; t < subwarp_transactions.size(); t++) {
+      memory_coalescing_arch_reduce_and_send(
+          is_write, access_type, subwarp_transactions[t].second,
+          subwarp_transactions[t].first, segment_size);
     }
   }
 }
 
+void warp_inst_t::coalesce_thread_access(
+    std::vector<std::pair<new_addr_type, transaction_info> > &transactions,
+    unsigned &last, new_addr_type block_address, new_addr_type addr,
+    unsigned thread, unsigned size) {
+  if (transactions.empty() || transactions[last].first != block_address) {
+    unsigned n = 0;
+    while (n < transactions.size() && transactions[n].first != block_address)
+      n++;
+    if (n == transactions.size())
+      transactions.push_back(std::make_pair(block_address, transaction_info()));
+    last = n;
+  }
+  transaction_info &info = transactions[last].second;
+  // which 32-byte chunk within in a 128-byte chunk does this thread access?
+  unsigned idx = (addr & 127);
+  info.chunks.set(idx / 32);
+  info.active.set(thread);
+  // bytes idx .. idx+size-1, dropping those past the 128-byte chunk
+  mem_access_byte_mask_t bytes;
+  bytes.set();
+  bytes >>= MAX_MEMORY_ACCESS_SIZE - size;
+  info.bytes |= bytes << idx;
+}
+
 void warp_inst_t::memory_coalescing_arch_atomic(bool is_write,
                                                 mem_access_type access_type) {
   assert(space.get_type() ==
@@ -798,6 +796,7 @@ kernel_info_t::kernel_info_t(dim3 gridDim, dim3 blockDim,
 
   cache_config_set = false;
   is_graphic_kernel = false;
+  tenant = 1;
 }
 
 /*A snapshot of the texture mappings needs to be stored in the kernel's info as
@@ -832,6 +831,7 @@ kernel_info_t::kernel_info_t(
   m_NameToCudaArray = nameToCudaArray;
   m_NameToTextureInfo = nameToTextureInfo;
   is_graphic_kernel = false;
+  tenant = 1;
 }
 
 kernel_info_t::~kernel_info_t() {
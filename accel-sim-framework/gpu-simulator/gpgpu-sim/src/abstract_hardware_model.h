@@ -39,6 +39,10 @@ class gpgpu_context;
 // Set a hard limit of 32 CTAs per shader [cuda only has 8]
 #define MAX_CTA_PER_SHADER 32
 #define MAX_BARRIERS_PER_CTA 16
+// kernels, warps and memory requests carry the tenant they run for. Tenant 0
+// is graphics, compute kernels are tenant 1 unless -trace_tenants groups
+// them further
+#define MAX_TENANTS 4
 
 // After expanding the vector input and output operands
 #define MAX_INPUT_VALUES 24
@@ -375,6 +379,7 @@ class kernel_info_t {
   unsigned m_kernel_TB_latency;  // this used for any CPU-GPU kernel latency and
                                  // counted in the gpu_cycle
   bool is_graphic_kernel;
+  unsigned tenant;  // < MAX_TENANTS
   unsigned prerequisite_kernel;
 };
 
@@ -384,6 +389,7 @@ class core_config {
     gpgpu_ctx = ctx;
     m_valid = false;
     num_shmem_bank = 16;
+    shmem_bank_width = WORD_SIZE;
     shmem_limited_broadcast = false;
     gpgpu_shmem_sizeDefault = (unsigned)-1;
     gpgpu_shmem_sizePrefL1 = (unsigned)-1;
@@ -403,8 +409,9 @@ class core_config {
   bool shmem_limited_broadcast;
   static const address_type WORD_SIZE = 4;
   unsigned num_shmem_bank;
+  unsigned shmem_bank_width;  // bytes
   unsigned shmem_bank_func(address_type addr) const {
-    return ((addr / WORD_SIZE) % num_shmem_bank);
+    return ((addr / shmem_bank_width) % num_shmem_bank);
   }
   unsigned mem_warp_parts;
   mutable unsigned gpgpu_shmem_size;
@@ -419,6 +426,8 @@ class core_config {
   // accesses)
   unsigned gpgpu_cache_texl1_linesize;
   unsigned gpgpu_cache_constl1_linesize;
+  // TEX loads of traces go through the texture L1 instead of the L1D
+  bool gpgpu_tex_l1t;
 
   unsigned gpgpu_max_insn_issue_per_warp;
   bool gmem_skip_L1D;  // on = global memory access always skip the L1 cache
@@ -901,11 +910,15 @@ class mem_fetch;
 class mem_fetch_interface {
  public:
   virtual bool full(unsigned size, bool write) const = 0;
+  // whether the boundary holds a request of the class back for now, asked
+  // once full() has room; see mem_throttle.h
+  virtual bool class_blocked(bool graphics, unsigned size) { return false; }
   virtual void push(mem_fetch *mf) = 0;
 };
 
 class mem_fetch_allocator {
  public:
+  virtual ~mem_fetch_allocator() {}
   virtual mem_fetch *alloc(new_addr_type addr, mem_access_type type,
                            unsigned size, bool wr,
                            unsigned long long cycle) const = 0;
@@ -967,6 +980,7 @@ class inst_t {
       arch_reg.src[i] = -1;
       arch_reg.dst[i] = -1;
     }
+    reuse_mask = 0;
     isize = 0;
   }
   bool valid() const { return m_decoded; }
@@ -1040,6 +1054,9 @@ class inst_t {
     int dst[MAX_REG_OPERANDS];
     int src[MAX_REG_OPERANDS];
   } arch_reg;
+  // bit i: the source in slot i is kept in the operand reuse cache for the
+  // warp's next instruction, the SASS .reuse flag
+  unsigned reuse_mask;
   // int arch_reg[MAX_REG_OPERANDS]; // register number for bank conflict
   // evaluation
   unsigned latency;  // operation latency
@@ -1068,6 +1085,7 @@ class warp_inst_t : public inst_t {
     m_kernel_uid =-1;
     m_is_vertex = false;
     m_is_fragment = false;
+    m_tenant = 1;
   }
   warp_inst_t(const core_config *config) {
     m_uid = 0;
@@ -1084,6 +1102,7 @@ class warp_inst_t : public inst_t {
     m_kernel_uid = -1;
     m_is_vertex = false;
     m_is_fragment = false;
+    m_tenant = 1;
   }
   virtual ~warp_inst_t() {}
 
@@ -1142,9 +1161,18 @@ class warp_inst_t : public inst_t {
   };
 
   void generate_mem_accesses();
+  // TEX load handled by the texture L1 (-gpgpu_tex_l1t)
+  bool is_l1t_tex() const { return is_tex() && m_config->gpgpu_tex_l1t; }
+  void memory_coalescing_tex(mem_access_type access_type);
   void memory_coalescing_arch(bool is_write, mem_access_type access_type);
   void memory_coalescing_arch_atomic(bool is_write,
                                      mem_access_type access_type);
+  // adds one thread's access to the transaction on block_address, last is
+  // the index of the transaction touched most recently
+  void coalesce_thread_access(
+      std::vector<std::pair<new_addr_type, transaction_info> > &transactions,
+      unsigned &last, new_addr_type block_address, new_addr_type addr,
+      unsigned thread, unsigned size);
   void memory_coalescing_arch_reduce_and_send(bool is_write,
                                               mem_access_type access_type,
                                               const transaction_info &info,
@@ -1227,6 +1255,9 @@ class warp_inst_t : public inst_t {
   unsigned get_kernel_uid() const {return m_kernel_uid;}
   bool is_vertex() const { return m_is_vertex; }
   bool is_fragment() const { return m_is_fragment; }
+  // set at issue from the warp, the decoded copy is shared by the warps
+  void set_tenant(unsigned tenant) { m_tenant = tenant; }
+  unsigned get_tenant() const { return m_tenant; }
 
  protected:
   unsigned m_kernel_uid;
@@ -1268,6 +1299,7 @@ class warp_inst_t : public inst_t {
   unsigned m_scheduler_id;  // the scheduler that issues this inst
   bool m_is_vertex;
   bool m_is_fragment;
+  unsigned m_tenant;
 
   // Jin: cdp support
  public:
@@ -76,6 +76,36 @@ enum pwr_cmp_t {
   NUM_COMPONENTS_MODELLED
 };
 
+// the counters each component's McPAT power is linear in, for the fast power
+// path; constant and static power are left to the regression models
+static const struct {
+  pwr_cmp_t cmp;
+  perf_count_t counter;
+} fast_power_terms[] = {
+    {IBP, TOT_INST},           {ICP, IC_H},
+    {ICP, IC_M},               {DCP, DC_RH},
+    {DCP, DC_RM},              {DCP, DC_WH},
+    {DCP, DC_WM},              {TCP, TC_H},
+    {TCP, TC_M},               {CCP, CC_H},
+    {CCP, CC_M},               {SHRDP, SHRD_ACC},
+    {RFP, REG_RD},             {RFP, REG_WR},
+    {RFP, NON_REG_OPs},        {INTP, INT_ACC},
+    {FPUP, FP_ACC},            {DPUP, DP_ACC},
+    {INT_MUL24P, INT_MUL24_ACC}, {INT_MUL32P, INT_MUL32_ACC},
+    {INT_MULP, INT_MUL_ACC},   {INT_DIVP, INT_DIV_ACC},
+    {FP_MULP, FP_MUL_ACC},     {FP_DIVP, FP_DIV_ACC},
+    {FP_SQRTP, FP_SQRT_ACC},   {FP_LGP, FP_LG_ACC},
+    {FP_SINP, FP_SIN_ACC},     {FP_EXP, FP_EXP_ACC},
+    {DP_MULP, DP_MUL_ACC},     {DP_DIVP, DP_DIV_ACC},
+    {TENSORP, TENSOR_ACC},     {TEXP, TEX_ACC},
+    {SCHEDP, FP_INT},          {L2CP, L2_RH},
+    {L2CP, L2_RM},             {L2CP, L2_WH},
+    {L2CP, L2_WM},             {MCP, MEM_RD},
+    {MCP, MEM_WR},             {MCP, MEM_PRE},
+    {NOCP, NOC_A},             {DRAMP, MEM_RD},
+    {DRAMP, MEM_WR},           {DRAMP, MEM_PRE},
+    {PIPEP, PIPE_A},           {IDLE_COREP, IDLE_CORE_N}};
+
 gpgpu_sim_wrapper::gpgpu_sim_wrapper(bool power_simulation_enabled,
                                      char* xmlfile, int power_simulation_mode, bool dvfs_enabled) {
   kernel_sample_count = 0;
@@ -99,9 +129,27 @@ gpgpu_sim_wrapper::gpgpu_sim_wrapper(bool power_simulation_enabled,
   sample_perf_counters.resize(NUM_PERFORMANCE_COUNTERS, 0);
   initpower_coeff.resize(NUM_PERFORMANCE_COUNTERS, 0);
   effpower_coeff.resize(NUM_PERFORMANCE_COUNTERS, 0);
+  fpu_access_coeff = 0;
+  sfu_access_coeff = 0;
+  dynamic_power = 0;
+
+  fast_power_coeff.resize(NUM_COMPONENTS_MODELLED * NUM_PERFORMANCE_COUNTERS,
+                          0);
+  fast_power_interval = 0;
+  samples_since_mcpat = 0;
+  fast_sample = false;
+  fast_power_calibrated = false;
+  fast_power_checks = 0;
+  fast_power_error_sum = 0;
+  fast_power_max_error = 0;
 
   const_dynamic_power = 0;
   proc_power = 0;
+  num_gated_cores = 0;
+  sample_wake_energy = 0;
+  power_gating_used = false;
+  kernel_gated_cores = 0;
+  kernel_wake_energy = 0;
 
   g_power_filename = NULL;
   g_power_trace_filename = NULL;
@@ -263,6 +311,8 @@ void gpgpu_sim_wrapper::reset_counters() {
   kernel_tot_power = 0;
   kernel_power = init;
   avg_threads_per_warp_tot = 0;
+  kernel_gated_cores = 0;
+  kernel_wake_energy = 0;
   return;
 }
 
@@ -393,6 +443,13 @@ void gpgpu_sim_wrapper::set_idle_core_power(double num_idle_core) {
   num_idle_cores = num_idle_core;
 }
 
+void gpgpu_sim_wrapper::set_power_gating(double gated_cores,
+                                         double wake_energy) {
+  num_gated_cores = gated_cores;
+  sample_wake_energy = wake_energy;
+  power_gating_used = true;
+}
+
 void gpgpu_sim_wrapper::set_duty_cycle_power(double duty_cycle) {
   p->sys.core[0].pipeline_duty_cycle =
       duty_cycle * p->sys.scaling_coefficients[PIPE_A];
@@ -536,7 +593,7 @@ void gpgpu_sim_wrapper::power_metrics_calculations() {
   kernel_sample_count++;
 
   // Current sample power
-  double sample_power = proc->rt_power.readOp.dynamic + sample_cmp_pwr[CONSTP] + sample_cmp_pwr[STATICP];
+  double sample_power = dynamic_power + sample_cmp_pwr[CONSTP] + sample_cmp_pwr[STATICP];
   // double sample_power;
   // for(unsigned i=0; i<num_pwr_cmps; i++){
   //   sample_power+=sample_cmp_pwr[i]; //fix for dvfs
@@ -546,6 +603,8 @@ void gpgpu_sim_wrapper::power_metrics_calculations() {
   // Previous + new + constant dynamic power (e.g., dynamic clocking power)
   kernel_tot_power += sample_power;
   kernel_power.avg = kernel_tot_power / kernel_sample_count;
+  kernel_gated_cores += num_gated_cores;
+  kernel_wake_energy += sample_wake_energy;
   for (unsigned ind = 0; ind < num_pwr_cmps; ++ind) {
     kernel_cmp_pwr[ind].avg += (double)sample_cmp_pwr[ind];
   }
@@ -741,6 +800,8 @@ void gpgpu_sim_wrapper::update_coefficients()
     initpower_coeff[i]/=(proc->cores[0]->executionTime);
     effpower_coeff[i]/=(proc->cores[0]->executionTime);
   }
+  fpu_access_coeff = fp_coeff / proc->cores[0]->executionTime;
+  sfu_access_coeff = sfu_coeff / proc->cores[0]->executionTime;
 }
 
 double gpgpu_sim_wrapper::calculate_static_power(){ 
@@ -755,7 +816,7 @@ double gpgpu_sim_wrapper::calculate_static_power(){
 	double total_static_power = 0.0;
 	double base_static_power = 0.0; 
 	double lane_static_power = 0.0;
-	double per_active_core = (num_cores - num_idle_cores)/num_cores;
+	double per_active_core = (num_cores - num_idle_cores - num_gated_cores)/num_cores;
 
 
 	double l1_accesses = initpower_coeff[DC_RH] + initpower_coeff[DC_RM] + initpower_coeff[DC_WH] + initpower_coeff[DC_WM];
@@ -845,12 +906,13 @@ double gpgpu_sim_wrapper::calculate_static_power(){
 	return (total_static_power*per_active_core);
 }
 
-void gpgpu_sim_wrapper::update_components_power()
-{
-
-  update_coefficients();
+void gpgpu_sim_wrapper::set_fast_power(unsigned interval) {
+  fast_power_interval = interval;
+}
 
-  proc_power=proc->rt_power.readOp.dynamic;
+void gpgpu_sim_wrapper::mcpat_components_power()
+{
+  dynamic_power=proc->rt_power.readOp.dynamic;
   sample_cmp_pwr[IBP]=(proc->cores[0]->ifu->IB->rt_power.readOp.dynamic
           +proc->cores[0]->ifu->IB->rt_power.writeOp.dynamic
           +proc->cores[0]->ifu->ID_misc->rt_power.readOp.dynamic
@@ -932,6 +994,71 @@ void gpgpu_sim_wrapper::update_components_power()
   sample_cmp_pwr[PIPEP]=proc->cores[0]->Pipeline_energy/(proc->cores[0]->executionTime);
 
   sample_cmp_pwr[IDLE_COREP]=proc->cores[0]->IdleCoreEnergy/(proc->cores[0]->executionTime);
+}
+
+// W per event of a counter at the McPAT per access energies; the execution
+// units split their power by each counter's share of their accesses
+double gpgpu_sim_wrapper::fast_power_base(unsigned counter) const {
+  if (counter == FP_ACC || counter == DP_ACC) return fpu_access_coeff;
+  if (counter >= INT_MUL24_ACC && counter <= TEX_ACC) return sfu_access_coeff;
+  return effpower_coeff[counter];
+}
+
+// Scale each component's row so the table reproduces the McPAT sample. The
+// error of the table before the update is what the fast samples can be
+// expected to show.
+void gpgpu_sim_wrapper::calibrate_fast_power() {
+  double linear[NUM_COMPONENTS_MODELLED] = {0};
+  double estimate = 0;
+  for (const auto &t : fast_power_terms) {
+    linear[t.cmp] += fast_power_base(t.counter) * sample_perf_counters[t.counter];
+    estimate += fast_power_coeff[t.cmp * num_perf_counters + t.counter] *
+                sample_perf_counters[t.counter];
+  }
+  if (fast_power_calibrated && dynamic_power > 0) {
+    double error = fabs(estimate - dynamic_power) / dynamic_power;
+    fast_power_checks++;
+    fast_power_error_sum += error;
+    fast_power_max_error = std::max(fast_power_max_error, error);
+  }
+  // a component idle in this sample keeps its previous scale, or the McPAT
+  // energies until it is first seen
+  for (const auto &t : fast_power_terms) {
+    double scale = 1;
+    if (linear[t.cmp] > 0)
+      scale = sample_cmp_pwr[t.cmp] / linear[t.cmp];
+    else if (fast_power_calibrated)
+      continue;
+    fast_power_coeff[t.cmp * num_perf_counters + t.counter] =
+        scale * fast_power_base(t.counter);
+  }
+  fast_power_calibrated = true;
+}
+
+void gpgpu_sim_wrapper::fast_components_power() {
+  dynamic_power = 0;
+  for (unsigned i = 0; i < num_pwr_cmps; i++) {
+    if (i == CONSTP || i == STATICP) continue;
+    const double *coeff = &fast_power_coeff[i * num_perf_counters];
+    double power = 0;
+    for (unsigned c = 0; c < num_perf_counters; c++)
+      power += coeff[c] * sample_perf_counters[c];
+    sample_cmp_pwr[i] = power;
+    dynamic_power += power;
+  }
+}
+
+void gpgpu_sim_wrapper::update_components_power()
+{
+
+  update_coefficients();
+
+  if (fast_sample) {
+    fast_components_power();
+  } else {
+    mcpat_components_power();
+    if (fast_power_interval) calibrate_fast_power();
+  }
 
   // This constant dynamic power (e.g., clock power) part is estimated via regression model.
   sample_cmp_pwr[CONSTP]=0;
@@ -955,8 +1082,15 @@ void gpgpu_sim_wrapper::update_components_power()
     	}
   	}
   }
+
+  // the wake-ups of gated SMs over the sample, an idle core power
+  if (sample_wake_energy > 0) {
+    double wake_power = sample_wake_energy / proc->cores[0]->executionTime;
+    sample_cmp_pwr[IDLE_COREP] += wake_power;
+    dynamic_power += wake_power;
+  }
   
-  proc_power+=sample_cmp_pwr[CONSTP]+sample_cmp_pwr[STATICP];
+  proc_power=dynamic_power+sample_cmp_pwr[CONSTP]+sample_cmp_pwr[STATICP];
   if(!g_dvfs_enabled){ // sanity check will fail when voltage scaling is applied, fix later
 	  double sum_pwr_cmp=0;
 	  for(unsigned i=0; i<num_pwr_cmps; i++){
@@ -970,7 +1104,57 @@ void gpgpu_sim_wrapper::update_components_power()
   }
 }
 
-void gpgpu_sim_wrapper::compute() { proc->compute(); }
+void gpgpu_sim_wrapper::get_domain_power(
+    double power[NUM_POWER_DOMAINS]) const {
+  for (unsigned d = 0; d < NUM_POWER_DOMAINS; d++) power[d] = 0;
+  for (unsigned i = 0; i < num_pwr_cmps; i++) {
+    power_domain d = CORE_DOMAIN;
+    switch (i) {
+      case L2CP:
+        d = L2_DOMAIN;
+        break;
+      case MCP:
+      case DRAMP:
+        d = MEM_DOMAIN;
+        break;
+      case NOCP:
+        d = NOC_DOMAIN;
+        break;
+      case IDLE_COREP:
+      case CONSTP:
+      case STATICP:
+        d = SHARED_DOMAIN;
+        break;
+    }
+    power[d] += sample_cmp_pwr[i];
+  }
+}
+
+static std::string trace_column(const char *label) {
+  std::string name(label);
+  if (!name.empty() && name[name.size() - 1] == ',')
+    name.erase(name.size() - 1);
+  return name;
+}
+
+std::string gpgpu_sim_wrapper::get_pwr_cmp_name(unsigned i) {
+  return trace_column(pwr_cmp_label[i]);
+}
+
+std::string gpgpu_sim_wrapper::get_perf_counter_name(unsigned i) {
+  return trace_column(perf_count_label[i]);
+}
+
+void gpgpu_sim_wrapper::compute() {
+  // McPAT runs on the first sample, to calibrate the table, and then once
+  // every fast_power_interval samples
+  fast_sample = fast_power_interval && fast_power_calibrated &&
+                g_power_simulation_mode == 0 &&
+                ++samples_since_mcpat < fast_power_interval;
+  if (fast_sample) return;
+  samples_since_mcpat = 0;
+  proc->compute();
+}
 void gpgpu_sim_wrapper::print_power_kernel_stats(
     double gpu_sim_cycle, double gpu_tot_sim_cycle, double init_value,
     const std::string& kernel_info_string, bool print_trace) {
@@ -995,6 +1179,12 @@ void gpgpu_sim_wrapper::print_power_kernel_stats(
     powerfile << "gpu_avg_threads_per_warp = "
                 << avg_threads_per_warp_tot / (double)kernel_sample_count
                 << std::endl;
+    if (power_gating_used) {
+      // IDLE_CORE_N above are the clock gated idle SMs only
+      powerfile << "gpu_avg_gated_cores = "
+                << kernel_gated_cores / kernel_sample_count << std::endl;
+      powerfile << "kernel_wake_energy = " << kernel_wake_energy << std::endl;
+    }
 
     for (unsigned i = 0; i < num_perf_counters; ++i) {
       powerfile << "gpu_tot_" << perf_count_label[i] << " = "
@@ -1031,6 +1221,14 @@ void gpgpu_sim_wrapper::print_power_kernel_stats(
               << gpu_tot_power.avg / total_sample_count << std::endl;
     powerfile << "gpu_tot_max_power = " << gpu_tot_power.max << std::endl;
     powerfile << "gpu_tot_min_power = " << gpu_tot_power.min << std::endl;
+    if (fast_power_checks) {
+      powerfile << "fast_power_checked_samples = " << fast_power_checks
+                << std::endl;
+      powerfile << "fast_power_avg_error = "
+                << fast_power_error_sum / fast_power_checks << std::endl;
+      powerfile << "fast_power_max_error = " << fast_power_max_error
+                << std::endl;
+    }
     powerfile << std::endl << std::endl;
     powerfile.flush();
 
@@ -1040,7 +1238,8 @@ void gpgpu_sim_wrapper::print_power_kernel_stats(
   }
 }
 void gpgpu_sim_wrapper::dump() {
-  if (g_power_per_cycle_dump) proc->displayEnergy(2, 5);
+  // the McPAT tree is stale on the samples the table evaluates
+  if (g_power_per_cycle_dump && !fast_sample) proc->displayEnergy(2, 5);
 }
 
 void gpgpu_sim_wrapper::print_steady_state(int position, double init_val) {
@@ -1083,9 +1282,9 @@ void gpgpu_sim_wrapper::detect_print_steady_state(int position,
       if (samples.size() == 0) {
         // First sample
         sample_start = total_sample_count;
-        sample_val = proc->rt_power.readOp.dynamic;
+        sample_val = dynamic_power;
         init_inst_val = init_val;
-        samples.push_back(proc->rt_power.readOp.dynamic);
+        samples.push_back(dynamic_power);
         assert(samples_counter.size() == 0);
         assert(pwr_counter.size() == 0);
 
@@ -1102,10 +1301,10 @@ void gpgpu_sim_wrapper::detect_print_steady_state(int position,
         // Get current average
         double temp_avg = sample_val / (double)samples.size();
 
-        if (abs(proc->rt_power.readOp.dynamic - temp_avg) <
+        if (abs(dynamic_power - temp_avg) <
             gpu_steady_power_deviation) {  // Value is within threshold
-          sample_val += proc->rt_power.readOp.dynamic;
-          samples.push_back(proc->rt_power.readOp.dynamic);
+          sample_val += dynamic_power;
+          samples.push_back(dynamic_power);
           for (unsigned i = 0; i < (num_perf_counters); ++i) {
             samples_counter.at(i) += sample_perf_counters[i];
           }
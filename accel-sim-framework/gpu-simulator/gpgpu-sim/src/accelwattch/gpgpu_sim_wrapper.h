@@ -100,6 +100,9 @@ class gpgpu_sim_wrapper {
   void dump();
   void print_trace_files();
   void update_components_power();
+  // evaluate all but one in interval samples from the coefficient table
+  // instead of McPAT, 0 runs McPAT on every sample
+  void set_fast_power(unsigned interval);
   double calculate_static_power();
   void update_coefficients();
   void reset_counters();
@@ -124,6 +127,9 @@ class gpgpu_sim_wrapper {
                          double write_accesses, double write_misses);
   void set_num_cores(double num_core);
   void set_idle_core_power(double num_idle_core);
+  // of the sample, the mean number of power gated SMs, taken out of the
+  // idle ones, and the J their wake-ups spent, see sm_power_gating.h
+  void set_power_gating(double gated_cores, double wake_energy);
   void set_duty_cycle_power(double duty_cycle);
   void set_mem_ctrl_power(double reads, double writes, double dram_precharge);
   void set_exec_unit_power(double fpu_accesses, double ialu_accesses,
@@ -147,8 +153,36 @@ class gpgpu_sim_wrapper {
 
   PowerscalingCoefficients * get_scaling_coeffs();
 
+  // where the component powers of a sample are spent, idle core, constant
+  // and static power being shared by the whole chip
+  enum power_domain {
+    CORE_DOMAIN = 0,
+    L2_DOMAIN,
+    MEM_DOMAIN,
+    NOC_DOMAIN,
+    SHARED_DOMAIN,
+    NUM_POWER_DOMAINS
+  };
+  void get_domain_power(double power[NUM_POWER_DOMAINS]) const;
+
+  // the current sample, for the binary power trace
+  double get_sample_power() const { return proc_power; }
+  const std::vector<double> &get_sample_cmp_pwr() const {
+    return sample_cmp_pwr;
+  }
+  const std::vector<double> &get_sample_perf_counters() const {
+    return sample_perf_counters;
+  }
+  // the power and metric trace column names, without the separator
+  static std::string get_pwr_cmp_name(unsigned i);
+  static std::string get_perf_counter_name(unsigned i);
+
  private:
   void print_steady_state(int position, double init_val);
+  void mcpat_components_power();
+  void fast_components_power();
+  double fast_power_base(unsigned counter) const;
+  void calibrate_fast_power();
 
   Processor* proc;
   ParseXML* p;
@@ -158,6 +192,12 @@ class gpgpu_sim_wrapper {
   double proc_power;
   double num_cores;
   double num_idle_cores;
+  double num_gated_cores;
+  double sample_wake_energy;
+  // -gpgpu_sm_gating_threshold, the kernel's sums of the samples
+  bool power_gating_used;
+  double kernel_gated_cores;
+  double kernel_wake_energy;
   unsigned num_perf_counters;  // # of performance counters
   unsigned num_pwr_cmps;       // # of components modelled
   int kernel_sample_count;     // # of samples per kernel
@@ -182,6 +222,22 @@ class gpgpu_sim_wrapper {
       sample_perf_counters;  // Current sample component perf. counts
   std::vector<double> initpower_coeff;
   std::vector<double> effpower_coeff;
+  double fpu_access_coeff;
+  double sfu_access_coeff;
+  double dynamic_power;  // of the current sample, without constant and static
+
+  // Fast power path: W per event of each counter in each component,
+  // [component * num_perf_counters + counter], from the per access energies
+  // of McPAT scaled to the component powers of the last McPAT sample
+  std::vector<double> fast_power_coeff;
+  unsigned fast_power_interval;
+  unsigned samples_since_mcpat;
+  bool fast_sample;
+  bool fast_power_calibrated;
+  // error of the table against the McPAT samples it is checked on
+  unsigned fast_power_checks;
+  double fast_power_error_sum;
+  double fast_power_max_error;
 
   // For calculating steady-state average
   unsigned sample_start;
@@ -29,6 +29,7 @@
 #include "addrdec.h"
 #include <math.h>
 #include <string.h>
+#include <algorithm>
 #include "../option_parser.h"
 #include "gpu-sim.h"
 #include "hashing.h"
@@ -44,6 +45,7 @@ static void addrdec_getmasklimit(new_addr_type mask, unsigned char *high,
 
 linear_to_raw_address_translation::linear_to_raw_address_translation() {
   addrdec_option = NULL;
+  m_ipoly_polynomial = 0;
   ADDR_CHIP_S = 10;
   memset(addrdec_mklow, 0, N_ADDRDEC);
   memset(addrdec_mkhigh, 64, N_ADDRDEC);
@@ -52,6 +54,10 @@ linear_to_raw_address_translation::linear_to_raw_address_translation() {
   addrdec_mask[2] = 0x000000000FFF0000;
   addrdec_mask[3] = 0x000000000000E0FF;
   addrdec_mask[4] = 0x000000000000000F;
+  m_mig_sub_partitions_option = NULL;
+  m_fixed_tenants = false;
+  m_gpus = 1;
+  m_clusters_per_gpu = 1;
 }
 
 void linear_to_raw_address_translation::addrdec_setoption(option_parser_t opp) {
@@ -73,6 +79,17 @@ void linear_to_raw_address_translation::addrdec_setoption(option_parser_t opp) {
       &memory_partition_indexing,
       "0 = no indexing, 1 = bitwise xoring, 2 = IPoly, 3 = custom indexing",
       "0");
+  option_parser_register(
+      opp, "-gpgpu_memory_partition_ipoly", OPT_UINT64, &m_ipoly_polynomial,
+      "IPoly polynomial of the memory partition indexing, of the degree "
+      "log2 of the sub partitions and its bits as a number, e.g. 37 for "
+      "x^5 + x^2 + 1 (0 = the default of the degree)",
+      "0");
+  option_parser_register(
+      opp, "-gpgpu_mig_sub_partitions", OPT_CSTR, &m_mig_sub_partitions_option,
+      "memory sub partitions of each MIG tenant, graphics first, e.g. "
+      "0-7;8-15 or 0,2,4,6;1,3,5,7 (empty = follow the SM split)",
+      "");
 }
 
 new_addr_type linear_to_raw_address_translation::partition_address(
@@ -146,9 +163,7 @@ void linear_to_raw_address_translation::addrdec_tlx(new_addr_type addr,
       unsigned sub_partition_addr_mask = m_n_sub_partition_in_channel - 1;
       unsigned sub_partition = tlx->chip * m_n_sub_partition_in_channel +
                                (tlx->bk & sub_partition_addr_mask);
-      sub_partition = ipoly_hash_function(
-          rest_of_addr_high_bits, sub_partition,
-          nextPowerOf2_m_n_channel * m_n_sub_partition_in_channel);
+      sub_partition = m_ipoly.hash(rest_of_addr_high_bits, sub_partition);
 
       if (gap)  // if it is not 2^n partitions, then take modular
         sub_partition =
@@ -396,6 +411,18 @@ void linear_to_raw_address_translation::init(
 
   if (addrdec_option != NULL) addrdec_parseoption(addrdec_option);
 
+  if (memory_partition_indexing == IPOLY &&
+      !m_ipoly.init(nextPowerOf2_m_n_channel * n_sub_partition_in_channel,
+                    m_ipoly_polynomial)) {
+    printf("GPGPU-Sim: IPoly memory partition indexing needs a power of two "
+           "up to 2^16 of sub partitions over the next power of two of "
+           "channels, %u, and -gpgpu_memory_partition_ipoly %llu of its "
+           "degree\n",
+           nextPowerOf2_m_n_channel * n_sub_partition_in_channel,
+           m_ipoly_polynomial);
+    exit(1);
+  }
+
   if (ADDR_CHIP_S != -1) {
     if (!gap) {
       // number of chip is power of two:
@@ -459,11 +486,87 @@ void linear_to_raw_address_translation::init(
   }
   printf("sub_partition_id_mask = %016llx\n", sub_partition_id_mask);
 
+  // address bits that reach tlx->chip or tlx->sub_partition in addrdec_tlx
+  new_addr_type chip_bits = addrdec_mask[CHIP] | sub_partition_id_mask;
+  int high_bits_start = 64;
+  if (gap) high_bits_start = ADDR_CHIP_S;
+  if (memory_partition_indexing == BITWISE_PERMUTATION ||
+      memory_partition_indexing == IPOLY)
+    high_bits_start = std::min(
+        high_bits_start,
+        std::max(0, ADDR_CHIP_S + (int)(log2channel + log2sub_partition)));
+  if (memory_partition_indexing == RANDOM)
+    high_bits_start = std::max(0, ADDR_CHIP_S - (int)log2sub_partition);
+  if (high_bits_start < 64) chip_bits |= ~0ULL << high_bits_start;
+  m_sub_partition_granule = chip_bits ? chip_bits & (~chip_bits + 1) : 1ULL << 63;
+
   if (run_test) {
     sweep_test();
   }
 
   if (memory_partition_indexing == RANDOM) srand(1);
+
+  m_tenant_map.clear();
+  m_fixed_tenants = false;
+  if (m_mig_sub_partitions_option && m_mig_sub_partitions_option[0])
+    parse_tenant_sub_partitions(m_mig_sub_partitions_option);
+}
+
+void linear_to_raw_address_translation::parse_tenant_sub_partitions(
+    const char *option) {
+  unsigned tenant = 0;
+  std::vector<unsigned> subs;
+  for (const char *p = option;; p++) {
+    if (*p == ';' || !*p) {
+      if (tenant == MAX_TENANTS) {
+        fprintf(stderr,
+                "GPGPU-Sim: -gpgpu_mig_sub_partitions %s has more than %d "
+                "tenants\n",
+                option, MAX_TENANTS);
+        exit(1);
+      }
+      set_tenant_sub_partitions(tenant++, subs);
+      subs.clear();
+      if (!*p) break;
+      continue;
+    }
+    unsigned first, last;
+    int n;
+    if (sscanf(p, "%u%n", &first, &n) != 1) {
+      fprintf(stderr, "GPGPU-Sim: bad -gpgpu_mig_sub_partitions %s\n", option);
+      exit(1);
+    }
+    p += n;
+    last = first;
+    if (*p == '-') {
+      if (sscanf(p + 1, "%u%n", &last, &n) != 1) {
+        fprintf(stderr, "GPGPU-Sim: bad -gpgpu_mig_sub_partitions %s\n",
+                option);
+        exit(1);
+      }
+      p += n + 1;
+    }
+    if (last < first || last >= (unsigned)m_n_sub_partition_total) {
+      fprintf(stderr,
+              "GPGPU-Sim: -gpgpu_mig_sub_partitions %s names sub partitions "
+              "outside 0-%d\n",
+              option, m_n_sub_partition_total - 1);
+      exit(1);
+    }
+    for (unsigned s = first; s <= last; s++) subs.push_back(s);
+    // the loop steps over the ',' or stops at the ';' or the end
+    if (*p != ',') p--;
+  }
+  m_fixed_tenants = true;
+}
+
+void linear_to_raw_address_translation::set_tenant_sub_partitions(
+    unsigned tenant, const std::vector<unsigned> &subs) {
+  if (m_tenant_map.size() <= tenant) m_tenant_map.resize(tenant + 1);
+  std::vector<unsigned> &map = m_tenant_map[tenant];
+  map.resize(m_n_sub_partition_total);
+  for (int s = 0; s < m_n_sub_partition_total; s++)
+    map[s] = subs.empty() ? s : subs[s % subs.size()];
 }
 
 #include "../tr1_hash_map.h"
@@ -29,12 +29,14 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 #include "../option_parser.h"
 
 #ifndef ADDRDEC_H
 #define ADDRDEC_H
 
 #include "../abstract_hardware_model.h"
+#include "hashing.h"
 
 enum partition_index_function {
   CONSECUTIVE = 0,
@@ -45,6 +47,9 @@ enum partition_index_function {
   CUSTOM
 };
 
+// MIG tenants of linear_to_raw_address_translation
+enum { MIG_GRAPHICS_TENANT = 0, MIG_COMPUTE_TENANT = 1 };
+
 struct addrdec_t {
   void print(FILE *fp) const;
 
@@ -66,9 +71,43 @@ class linear_to_raw_address_translation {
   // accessors
   void addrdec_tlx(new_addr_type addr, addrdec_t *tlx) const;
   new_addr_type partition_address(new_addr_type addr) const;
+  // first address after addr that may decode to another chip or sub
+  // partition: the aligned block around addr shares both, so a caller walking
+  // a range only needs to decode again there
+  new_addr_type sub_partition_run_end(new_addr_type addr) const {
+    return (addr | (m_sub_partition_granule - 1)) + 1;
+  }
+
+  // MIG: tenant 0 is graphics, the compute tenants follow. A tenant's table
+  // folds every decoded sub partition into the tenant's set, evenly when the
+  // set size does not divide the sub partition count; a tenant without a set
+  // keeps the decoded one
+  void set_tenant_sub_partitions(unsigned tenant,
+                                 const std::vector<unsigned> &subs);
+  // the sets came from -gpgpu_mig_sub_partitions
+  bool fixed_tenants() const { return m_fixed_tenants; }
+  unsigned tenant_sub_partition(unsigned tenant, unsigned sub_partition) const {
+    return tenant < m_tenant_map.size() ? m_tenant_map[tenant][sub_partition]
+                                        : sub_partition;
+  }
+  unsigned sub_partition_chip(unsigned sub_partition) const {
+    return sub_partition / m_n_sub_partition_in_channel;
+  }
+  // -gpgpu_multi_gpu: the accesses of the SMs of a GPU fold into its even
+  // share of the sub partitions, in order, see multi_gpu.h
+  void set_gpus(unsigned gpus, unsigned clusters_per_gpu) {
+    m_gpus = gpus;
+    m_clusters_per_gpu = clusters_per_gpu;
+  }
+  unsigned gpus() const { return m_gpus; }
+  unsigned gpu_sub_partition(unsigned cluster, unsigned sub_partition) const {
+    unsigned per_gpu = m_n_sub_partition_total / m_gpus;
+    return cluster / m_clusters_per_gpu * per_gpu + sub_partition % per_gpu;
+  }
 
  private:
   void addrdec_parseoption(const char *option);
+  void parse_tenant_sub_partitions(const char *option);
   void sweep_test() const;  // sanity check to ensure no overlapping
 
   enum { CHIP = 0, BK = 1, ROW = 2, COL = 3, BURST = 4, N_ADDRDEC };
@@ -76,6 +115,9 @@ class linear_to_raw_address_translation {
   const char *addrdec_option;
   int gpgpu_mem_address_mask;
   partition_index_function memory_partition_indexing;
+  unsigned long long m_ipoly_polynomial;
+  // IPOLY over the sub partitions of the next power of two of channels
+  ipoly_hash m_ipoly;
   bool run_test;
 
   int ADDR_CHIP_S;
@@ -91,6 +133,14 @@ class linear_to_raw_address_translation {
   unsigned log2channel;
   unsigned log2sub_partition;
   unsigned nextPowerOf2_m_n_channel;
+  // lowest address bit chip or sub partition depend on, as a power of two
+  new_addr_type m_sub_partition_granule;
+
+  char *m_mig_sub_partitions_option;
+  bool m_fixed_tenants;
+  std::vector<std::vector<unsigned> > m_tenant_map;
+  unsigned m_gpus;
+  unsigned m_clusters_per_gpu;
 };
 
 #endif
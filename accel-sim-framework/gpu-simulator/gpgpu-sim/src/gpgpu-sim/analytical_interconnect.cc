@@ -0,0 +1,194 @@
+#include "analytical_interconnect.h"
+#include <assert.h>
+#include "core_stage_log.h"
+
+analytical_router::analytical_router(unsigned n_shader, unsigned n_mem,
+                                     const struct inct_config& m_inct_config) {
+  total_nodes = n_shader + n_mem;
+  in_buffer_limit = m_inct_config.in_buffer_limit;
+  out_buffer_limit = m_inct_config.out_buffer_limit;
+  latency = m_inct_config.analytical_latency;
+  port_bw = m_inct_config.analytical_port_bw;
+  assert(port_bw);
+  in_buffers.resize(total_nodes);
+  out_buffers.resize(total_nodes);
+  in_free.resize(total_nodes, 0);
+  out_free.resize(total_nodes, 0);
+  in_packets = out_packets = 0;
+  next_node_id = 0;
+
+  cycles = packets_num = bytes_num = latency_sum = 0;
+  in_buffer_full = out_buffer_full = port_busy = 0;
+}
+
+void analytical_router::Push(unsigned input_deviceID, unsigned output_deviceID,
+                             void* data, unsigned int size) {
+  assert(input_deviceID < total_nodes && output_deviceID < total_nodes);
+  Packet packet = {data, output_deviceID, size, cycles};
+  in_buffers[input_deviceID].push_back(packet);
+  in_packets++;
+  packets_num++;
+  bytes_num += size;
+}
+
+void* analytical_router::Pop(unsigned ouput_deviceID) {
+  assert(ouput_deviceID < total_nodes);
+  deque<Packet>& buffer = out_buffers[ouput_deviceID];
+  if (buffer.empty() || buffer.front().time > cycles) return NULL;
+  void* data = buffer.front().data;
+  buffer.pop_front();
+  out_packets--;
+  return data;
+}
+
+bool analytical_router::Has_Buffer_In(unsigned input_deviceID,
+                                      bool update_counter, unsigned staged) {
+  assert(input_deviceID < total_nodes);
+  bool has_buffer =
+      in_buffers[input_deviceID].size() + 1 + staged <= in_buffer_limit;
+  if (update_counter && !has_buffer) core_stage_add(in_buffer_full, 1ull);
+  return has_buffer;
+}
+
+void analytical_router::Advance() {
+  if (in_packets) {
+    for (unsigned i = 0; i < total_nodes; ++i) {
+      unsigned node_id = (i + next_node_id) % total_nodes;
+      deque<Packet>& in = in_buffers[node_id];
+      if (in.empty()) continue;
+      Packet packet = in.front();
+      unsigned out = packet.output_deviceID;
+      if (in_free[node_id] > cycles || out_free[out] > cycles) {
+        port_busy++;
+        continue;
+      }
+      if (out_buffers[out].size() >= out_buffer_limit) {
+        out_buffer_full++;
+        continue;
+      }
+      // an output is busy for each packet in turn, so its packets arrive
+      // in the order they were sent
+      unsigned serial = (packet.size + port_bw - 1) / port_bw;
+      if (!serial) serial = 1;
+      in_free[node_id] = out_free[out] = cycles + serial;
+      unsigned long long arrival = cycles + serial + latency;
+      latency_sum += arrival - packet.time;
+      packet.time = arrival;
+      in.pop_front();
+      in_packets--;
+      out_buffers[out].push_back(packet);
+      out_packets++;
+    }
+    next_node_id = (next_node_id + 1) % total_nodes;
+  }
+  cycles++;
+}
+
+////////////////////////////////////////////////////
+
+AnalyticalInterconnect* AnalyticalInterconnect::New(
+    const struct inct_config& m_inct_config) {
+  AnalyticalInterconnect* icnt_interface =
+      new AnalyticalInterconnect(m_inct_config);
+
+  return icnt_interface;
+}
+
+AnalyticalInterconnect::AnalyticalInterconnect(
+    const struct inct_config& m_inct_config)
+    : m_inct_config(m_inct_config) {
+  n_shader = 0;
+  n_mem = 0;
+  n_subnets = m_inct_config.subnets;
+}
+
+AnalyticalInterconnect::~AnalyticalInterconnect() {
+  for (unsigned i = 0; i < net.size(); ++i) {
+    delete net[i];
+  }
+}
+
+void AnalyticalInterconnect::CreateInterconnect(unsigned m_n_shader,
+                                                unsigned m_n_mem) {
+  n_shader = m_n_shader;
+  n_mem = m_n_mem;
+
+  net.resize(n_subnets);
+  for (unsigned i = 0; i < n_subnets; ++i) {
+    net[i] = new analytical_router(m_n_shader, m_n_mem, m_inct_config);
+  }
+}
+
+void AnalyticalInterconnect::Init() {}
+
+void AnalyticalInterconnect::Push(unsigned input_deviceID,
+                                  unsigned output_deviceID, void* data,
+                                  unsigned int size) {
+  unsigned subnet = (n_subnets > 1 && input_deviceID >= n_shader) ? 1 : 0;
+
+  // it should have free buffer
+  assert(net[subnet]->Has_Buffer_In(input_deviceID));
+
+  net[subnet]->Push(input_deviceID, output_deviceID, data, size);
+}
+
+void* AnalyticalInterconnect::Pop(unsigned ouput_deviceID) {
+  // 0-_n_shader-1 indicates reply(network 1), otherwise request(network 0)
+  unsigned subnet = (n_subnets > 1 && ouput_deviceID < n_shader) ? 1 : 0;
+
+  return net[subnet]->Pop(ouput_deviceID);
+}
+
+void AnalyticalInterconnect::Advance() {
+  for (unsigned i = 0; i < n_subnets; ++i) {
+    net[i]->Advance();
+  }
+}
+
+bool AnalyticalInterconnect::Busy() const {
+  for (unsigned i = 0; i < n_subnets; ++i) {
+    if (net[i]->Busy()) return true;
+  }
+  return false;
+}
+
+bool AnalyticalInterconnect::HasBuffer(unsigned deviceID, unsigned int size,
+                                       unsigned staged) const {
+  if ((n_subnets > 1) && deviceID >= n_shader)  // deviceID is memory node
+    return net[REPLY_NET]->Has_Buffer_In(deviceID, true, staged);
+  return net[REQ_NET]->Has_Buffer_In(deviceID, true, staged);
+}
+
+void AnalyticalInterconnect::DisplayStats() const {
+  static const char* names[2] = {"Req", "Reply"};
+  for (unsigned i = 0; i < n_subnets; ++i) {
+    const analytical_router* n = net[i];
+    double cycles = n->cycles ? n->cycles : 1;
+    if (i) printf("\n");
+    printf("%s_Network_injected_packets_num = %lld\n", names[i],
+           n->packets_num);
+    printf("%s_Network_cycles = %lld\n", names[i], n->cycles);
+    printf("%s_Network_injected_packets_per_cycle = %12.4f\n", names[i],
+           n->packets_num / cycles);
+    printf("%s_Network_bytes_per_cycle = %12.4f\n", names[i],
+           n->bytes_num / cycles);
+    printf("%s_Network_avg_latency = %12.4f\n", names[i],
+           n->packets_num ? (double)n->latency_sum / n->packets_num : 0.0);
+    printf("%s_Network_port_busy_per_cycle = %12.4f\n", names[i],
+           n->port_busy / cycles);
+    printf("%s_Network_in_buffer_full_per_cycle = %12.4f\n", names[i],
+           n->in_buffer_full / cycles);
+    printf("%s_Network_out_buffer_full_per_cycle = %12.4f\n", names[i],
+           n->out_buffer_full / cycles);
+  }
+}
+
+void AnalyticalInterconnect::DisplayOverallStats() const {}
+
+unsigned AnalyticalInterconnect::GetFlitSize() const {
+  return m_inct_config.analytical_port_bw;
+}
+
+void AnalyticalInterconnect::DisplayState(FILE* fp) const {
+  fprintf(fp, "GPGPU-Sim uArch: ICNT:Display State: Under implementation\n");
+}
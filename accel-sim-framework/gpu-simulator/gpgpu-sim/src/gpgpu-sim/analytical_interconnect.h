@@ -0,0 +1,95 @@
+// Latency/bandwidth model of the interconnect, -network_mode 3
+//
+// Every port moves -icnt_analytical_port_bw bytes a cycle, so a packet holds
+// its input and its output port for size / port_bw cycles, rounded up, and
+// arrives -icnt_analytical_latency cycles after its last byte left. An input
+// sends its oldest packet once both ports are free and the output has room
+// for it; there is no topology and no arbitration beyond a round robin over
+// the inputs. Buffer limits and node numbering are the local xbar's.
+//
+// There are no flits or routers to step, so icnt_transfer is one pass over
+// the inputs. simulator_bench.py -p "-network_mode 3" times a run of it to
+// compare against one of the config's own network.
+
+#ifndef _ANALYTICAL_INTERCONNECT_H_
+#define _ANALYTICAL_INTERCONNECT_H_
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include "local_interconnect.h"
+
+class analytical_router {
+ public:
+  analytical_router(unsigned n_shader, unsigned n_mem,
+                    const struct inct_config& m_inct_config);
+  void Push(unsigned input_deviceID, unsigned output_deviceID, void* data,
+            unsigned int size);
+  void* Pop(unsigned ouput_deviceID);
+  void Advance();
+
+  bool Busy() const { return in_packets || out_packets; }
+  bool Has_Buffer_In(unsigned input_deviceID, bool update_counter = false,
+                     unsigned staged = 0);
+
+  // some stats
+  unsigned long long cycles;
+  unsigned long long packets_num;
+  unsigned long long bytes_num;
+  unsigned long long latency_sum;  // injection to arrival, queueing included
+  unsigned long long in_buffer_full;
+  unsigned long long out_buffer_full;
+  unsigned long long port_busy;  // head packets waiting on a busy port
+
+ private:
+  struct Packet {
+    void* data;
+    unsigned output_deviceID;
+    unsigned size;
+    unsigned long long time;  // injection, then arrival once sent
+  };
+
+  unsigned total_nodes;
+  unsigned in_buffer_limit, out_buffer_limit;
+  unsigned latency, port_bw;
+  vector<deque<Packet> > in_buffers;
+  // packets sent to an output, in arrival order, that it has not popped
+  vector<deque<Packet> > out_buffers;
+  // the cycle each port is free from
+  vector<unsigned long long> in_free, out_free;
+  unsigned long long in_packets, out_packets;
+  unsigned next_node_id;
+};
+
+class AnalyticalInterconnect {
+ public:
+  AnalyticalInterconnect(const struct inct_config& m_inct_config);
+  ~AnalyticalInterconnect();
+  static AnalyticalInterconnect* New(const struct inct_config& m_inct_config);
+  void CreateInterconnect(unsigned n_shader, unsigned n_mem);
+
+  // node side functions
+  void Init();
+  void Push(unsigned input_deviceID, unsigned output_deviceID, void* data,
+            unsigned int size);
+  void* Pop(unsigned ouput_deviceID);
+  void Advance();
+  bool Busy() const;
+  // staged packets are about to be pushed at deviceID
+  bool HasBuffer(unsigned deviceID, unsigned int size,
+                 unsigned staged = 0) const;
+  void DisplayStats() const;
+  void DisplayOverallStats() const;
+  unsigned GetFlitSize() const;
+
+  void DisplayState(FILE* fp) const;
+
+ protected:
+  const inct_config& m_inct_config;
+
+  unsigned n_shader, n_mem;
+  unsigned n_subnets;
+  vector<analytical_router*> net;
+};
+
+#endif
@@ -0,0 +1,74 @@
+// Clock domain scheduler
+
+#include "clock_domains.h"
+
+#include <assert.h>
+
+unsigned clock_domain_engine::add_domain(double period, double first_edge) {
+  assert(period > 0 && first_edge >= m_now);
+  unsigned d = m_period.size();
+  m_period.push_back(period);
+  m_time.push_back(first_edge);
+  push(d);
+  return d;
+}
+
+void clock_domain_engine::set_period(unsigned d, double period) {
+  assert(d < size() && period > 0);
+  m_period[d] = period;
+}
+
+void clock_domain_engine::push(unsigned d) {
+  // sift up
+  unsigned i = m_heap.size();
+  m_heap.push_back(d);
+  while (i) {
+    unsigned parent = (i - 1) / 2;
+    if (!later(m_heap[parent], d)) break;
+    m_heap[i] = m_heap[parent];
+    i = parent;
+  }
+  m_heap[i] = d;
+}
+
+unsigned clock_domain_engine::pop() {
+  unsigned top = m_heap[0];
+  unsigned last = m_heap.back();
+  m_heap.pop_back();
+  unsigned n = m_heap.size();
+  if (!n) return top;
+  // sift the last one down from the root
+  unsigned i = 0;
+  while (true) {
+    unsigned child = 2 * i + 1;
+    if (child >= n) break;
+    if (child + 1 < n && later(m_heap[child], m_heap[child + 1])) child++;
+    if (!later(last, m_heap[child])) break;
+    m_heap[i] = m_heap[child];
+    i = child;
+  }
+  m_heap[i] = last;
+  return top;
+}
+
+const std::vector<unsigned> &clock_domain_engine::next() {
+  assert(!m_heap.empty());
+  m_fired.clear();
+  m_now = m_time[m_heap[0]];
+  while (!m_heap.empty() && m_time[m_heap[0]] == m_now)
+    m_fired.push_back(pop());
+  for (unsigned d : m_fired) {
+    m_time[d] += m_period[d];
+    push(d);
+  }
+  return m_fired;
+}
+
+void clock_domain_engine::reset() {
+  m_now = 0;
+  m_heap.clear();
+  for (unsigned d = 0; d < size(); d++) {
+    m_time[d] = 0;
+    push(d);
+  }
+}
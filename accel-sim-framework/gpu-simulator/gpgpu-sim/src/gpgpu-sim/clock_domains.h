@@ -0,0 +1,53 @@
+// Clock domain scheduler
+//
+// Every domain has a period and the time of its next rising edge. The edges
+// are kept in a binary min-heap, so a step pops the domains of the earliest
+// edge and pushes them back one period later in O(log n) for n domains.
+// Domains whose edges fall at exactly the same time fire in the same step,
+// which is what the fixed core/icnt/L2/DRAM comparison did. The edge times
+// are accumulated sums of the periods, as before, so the edges of the fixed
+// domains do not move.
+//
+// A period can be changed while the simulation runs. The edge already
+// scheduled stays and the new period applies from there on.
+
+#ifndef CLOCK_DOMAINS_H
+#define CLOCK_DOMAINS_H
+
+#include <vector>
+
+class clock_domain_engine {
+ public:
+  clock_domain_engine() : m_now(0) {}
+
+  // a domain with its first edge at first_edge, returns its id
+  unsigned add_domain(double period, double first_edge);
+  unsigned size() const { return m_period.size(); }
+  double period(unsigned d) const { return m_period[d]; }
+  // time of the domain's next edge
+  double next_edge(unsigned d) const { return m_time[d]; }
+  void set_period(unsigned d, double period);
+
+  // the domains of the earliest pending edge, in no particular order, each
+  // moved one period ahead
+  const std::vector<unsigned> &next();
+  // time of the last step
+  double now() const { return m_now; }
+  // every domain back to an edge at time 0
+  void reset();
+
+ private:
+  bool later(unsigned a, unsigned b) const {
+    return m_time[a] > m_time[b] || (m_time[a] == m_time[b] && a > b);
+  }
+  void push(unsigned d);
+  unsigned pop();
+
+  std::vector<double> m_period;
+  std::vector<double> m_time;
+  std::vector<unsigned> m_heap;
+  std::vector<unsigned> m_fired;
+  double m_now;
+};
+
+#endif
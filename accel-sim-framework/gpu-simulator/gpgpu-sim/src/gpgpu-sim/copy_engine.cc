@@ -0,0 +1,131 @@
+// Copy engine of the host to device copies, see copy_engine.h
+
+#include "copy_engine.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpu-sim.h"
+#include "l2cache.h"
+#include "mem_fetch.h"
+
+copy_engine::copy_engine() {
+  m_enabled = false;
+  m_config = NULL;
+  m_allocator = NULL;
+  m_credit = 0;
+  for (unsigned c = 0; c < 2; c++) {
+    m_queued[c] = 0;
+    m_bytes[c] = m_write_count[c] = 0;
+    m_copies_done[c] = m_copy_cycles[c] = 0;
+  }
+}
+
+copy_engine::~copy_engine() { delete m_allocator; }
+
+void copy_engine::configure(const memory_config *config,
+                            unsigned n_sub_partitions) {
+  m_enabled = strcmp(config->gpgpu_copy_engine, "none") != 0;
+  if (!m_enabled) return;
+  m_line_size = config->m_L2_config.get_line_sz();
+  m_sectored = config->m_L2_config.m_cache_type == SECTOR;
+  // a line has to fit in flight at once
+  unsigned line_writes = m_sectored ? m_line_size / SECTOR_SIZE : 1;
+  if (sscanf(config->gpgpu_copy_engine, "%u:%u", &m_bandwidth,
+             &m_max_inflight) != 2 ||
+      !m_bandwidth || m_max_inflight < line_writes) {
+    printf("GPGPU-Sim: -gpgpu_copy_engine \'%s\' is not <bytes per cycle>:"
+           "<writes in flight, at least %u>\n",
+           config->gpgpu_copy_engine, line_writes);
+    exit(1);
+  }
+  m_config = config;
+  m_allocator = new partition_mf_allocator(config);
+  m_sub_writes.resize(n_sub_partitions);
+}
+
+void copy_engine::copy(new_addr_type addr, size_t size, bool graphics,
+                       unsigned tenant, unsigned long long cycle) {
+  if (!size) return;
+  transfer t = {++m_queued[graphics], addr, addr + size, graphics, tenant};
+  progress p = {cycle, 0, false};
+  m_pending[graphics][t.id] = p;
+  m_transfers.push_back(t);
+  m_bytes[graphics] += size;
+}
+
+void copy_engine::cycle(unsigned long long cycle) {
+  // an idle link does not save up for a burst, a slow one saves up for a
+  // line
+  unsigned long long cap = m_bandwidth > m_line_size ? m_bandwidth : m_line_size;
+  m_credit = m_transfers.empty() ? 0 : m_credit + m_bandwidth;
+  if (m_credit > cap) m_credit = cap;
+  while (!m_transfers.empty()) {
+    transfer &t = m_transfers.front();
+    new_addr_type line = t.next - t.next % m_line_size;
+    new_addr_type end = t.end < line + m_line_size ? t.end : line + m_line_size;
+    unsigned first = (t.next - line) / SECTOR_SIZE;
+    unsigned last = (end - 1 - line) / SECTOR_SIZE;
+    unsigned writes = m_sectored ? last - first + 1 : 1;
+    if (m_credit < end - t.next || m_writes.size() + writes > m_max_inflight)
+      break;
+    m_credit -= end - t.next;
+    for (unsigned w = 0; w < writes; w++) {
+      unsigned s = first + w;
+      new_addr_type addr = m_sectored ? line + s * SECTOR_SIZE : line;
+      unsigned size = m_sectored ? SECTOR_SIZE : m_line_size;
+      mem_access_byte_mask_t byte_mask;
+      mem_access_sector_mask_t sector_mask;
+      for (new_addr_type b = addr > t.next ? addr : t.next;
+           b < addr + size && b < end; b++)
+        byte_mask.set(b - line);
+      if (m_sectored)
+        sector_mask.set(s);
+      else
+        sector_mask.set();
+      // no SM waits for it, the per SM stats leave it out like the L2
+      // writebacks
+      mem_fetch *mf = m_allocator->alloc(
+          addr, GLOBAL_ACC_W, active_mask_t().set(0), byte_mask, sector_mask,
+          size, true, cycle, 0, -1, -1, -1, NULL);
+      mf->set_replay_source(t.graphics, t.tenant, false, false);
+      m_writes[mf] = std::make_pair(t.graphics, t.id);
+      m_sub_writes[mf->get_sub_partition_id()].push_back(mf);
+    }
+    m_write_count[t.graphics] += writes;
+    m_pending[t.graphics][t.id].acks_left += writes;
+    t.next = end;
+    if (t.next == t.end) {
+      m_pending[t.graphics][t.id].issued = true;
+      m_transfers.pop_front();
+    }
+  }
+}
+
+void copy_engine::write_done(const mem_fetch *mf, unsigned long long cycle) {
+  std::unordered_map<const mem_fetch *,
+                     std::pair<bool, unsigned long long> >::iterator w =
+      m_writes.find(mf);
+  assert(w != m_writes.end());
+  bool graphics = w->second.first;
+  std::map<unsigned long long, progress>::iterator p =
+      m_pending[graphics].find(w->second.second);
+  m_writes.erase(w);
+  assert(p != m_pending[graphics].end() && p->second.acks_left);
+  if (--p->second.acks_left || !p->second.issued) return;
+  m_copies_done[graphics]++;
+  m_copy_cycles[graphics] += cycle - p->second.start;
+  m_pending[graphics].erase(p);
+}
+
+void copy_engine::print(FILE *fp) const {
+  static const char *cls[2] = {"compute", "graphics"};
+  for (unsigned c = 0; c < 2; c++)
+    fprintf(fp,
+            "gpu_copy_engine_%s = %llu copies, %llu bytes, %llu writes, "
+            "avg_latency = %.2f\n",
+            cls[c], m_copies_done[c], m_bytes[c], m_write_count[c],
+            m_copies_done[c] ? (double)m_copy_cycles[c] / m_copies_done[c]
+                             : 0.0);
+}
@@ -0,0 +1,109 @@
+// Copy engine of the host to device copies
+//
+// With -gpgpu_copy_engine <bytes per cycle>:<writes in flight> (none by
+// default, where perf_memcpy_to_gpu updates the L2 tags at once) the copies
+// of perf_memcpy_to_gpu, those of the traces, the vertex buffer lines of the
+// CTAs and the functional memcpys, queue in the order they come on a DMA
+// engine. It takes them apart cache line by cache line, at most the bytes
+// per core cycle of its link, and issues the writes of a line, one per
+// sector of it into a sectored L2, as mem_fetches into the L2 sub partition
+// of the line, of the class and tenant of the copy. They take the L2 and
+// DRAM bandwidth of the kernels running by then like their own writes do,
+// and their acks stop at the sub partition. No more than the writes in
+// flight wait for their ack, a copy that would go over waits for the ones
+// ahead. A copy is done once all its writes are acked. The kernels of the
+// traces that come after a copy of their class are held until it is done,
+// the way a copy on the stream ahead of them would hold them. Bytes,
+// writes and the latency of the copies from queued to done are counted per
+// class.
+
+#ifndef COPY_ENGINE_H
+#define COPY_ENGINE_H
+
+#include <stdio.h>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+
+class mem_fetch;
+class memory_config;
+class partition_mf_allocator;
+
+class copy_engine {
+ public:
+  copy_engine();
+  ~copy_engine();
+
+  void configure(const memory_config *config, unsigned n_sub_partitions);
+  bool enabled() const { return m_enabled; }
+
+  // queues the copy of size bytes to addr, of the class graphics
+  void copy(new_addr_type addr, size_t size, bool graphics, unsigned tenant,
+            unsigned long long cycle);
+  // the number of copies of the class queued so far, a kernel waits for the
+  // copies up to it with done
+  unsigned long long queued(bool graphics) const { return m_queued[graphics]; }
+  bool done(bool graphics, unsigned long long copies) const {
+    return m_pending[graphics].empty() ||
+           m_pending[graphics].begin()->first > copies;
+  }
+  bool busy() const {
+    return !m_pending[0].empty() || !m_pending[1].empty();
+  }
+  // issues the writes of the link's bytes of the cycle
+  void cycle(unsigned long long cycle);
+
+  // the next write for sub partition sub, NULL when none waits
+  mem_fetch *write_top(unsigned sub) const {
+    return m_sub_writes[sub].empty() ? NULL : m_sub_writes[sub].front();
+  }
+  void write_pop(unsigned sub) { m_sub_writes[sub].pop_front(); }
+  // whether mf is a write of a copy
+  bool owns(const mem_fetch *mf) const { return m_writes.count(mf) > 0; }
+  // the ack of write mf left the L2
+  void write_done(const mem_fetch *mf, unsigned long long cycle);
+
+  void print(FILE *fp) const;
+
+ private:
+  struct transfer {
+    unsigned long long id;  // of its class, from 1
+    new_addr_type next;     // the first byte left to issue
+    new_addr_type end;
+    bool graphics;
+    unsigned tenant;
+  };
+  struct progress {
+    unsigned long long start;
+    unsigned acks_left;
+    bool issued;  // all of its writes
+  };
+
+  bool m_enabled;
+  const memory_config *m_config;
+  partition_mf_allocator *m_allocator;
+  unsigned m_bandwidth;  // bytes per cycle
+  unsigned m_max_inflight;
+  unsigned m_line_size;
+  bool m_sectored;
+
+  unsigned long long m_credit;  // bytes the link may still issue
+  std::deque<transfer> m_transfers;
+  // [0] compute, [1] graphics; by id the copies not done yet
+  std::map<unsigned long long, progress> m_pending[2];
+  unsigned long long m_queued[2];
+  // the writes waiting for their ack, with the class and id of their copy
+  std::unordered_map<const mem_fetch *, std::pair<bool, unsigned long long> >
+      m_writes;
+  std::vector<std::deque<mem_fetch *> > m_sub_writes;  // by sub partition
+
+  unsigned long long m_bytes[2];
+  unsigned long long m_write_count[2];
+  unsigned long long m_copies_done[2];
+  unsigned long long m_copy_cycles[2];
+};
+
+#endif
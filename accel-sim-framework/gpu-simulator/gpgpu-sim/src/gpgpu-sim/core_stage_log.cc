@@ -0,0 +1,65 @@
+// Effects of one SIMT cluster's core cycle on state the clusters share
+
+#include "core_stage_log.h"
+
+#include <algorithm>
+
+thread_local core_stage_log *core_stage_log::t_current = NULL;
+
+core_stage_log::core_stage_log(unsigned cluster_id, unsigned n_clusters)
+    : m_cluster_id(cluster_id), m_n_clusters(n_clusters) {}
+
+void core_stage_log::number(unsigned &uid, unsigned &next) {
+  push(NUMBER, &uid, m_uid_counters.size());
+  m_uid_counters.push_back(&next);
+}
+
+unsigned core_stage_log::take_uid(unsigned &next) {
+  // next does not move while the clusters cycle, every cluster takes the
+  // ids of its own residue above it
+  uid_range *range = NULL;
+  for (unsigned i = 0; i < m_uid_ranges.size(); i++)
+    if (m_uid_ranges[i].next == &next) range = &m_uid_ranges[i];
+  if (!range) {
+    uid_range r = {&next, next, 0};
+    m_uid_ranges.push_back(r);
+    range = &m_uid_ranges.back();
+  }
+  return range->base + range->taken++ * m_n_clusters + m_cluster_id;
+}
+
+void core_stage_log::flush() {
+  for (unsigned i = 0; i < m_entries.size(); i++) {
+    const entry &e = m_entries[i];
+    switch (e.type) {
+      case ADD_U32:
+        *(unsigned *)e.target += e.value;
+        break;
+      case ADD_U64:
+        *(unsigned long long *)e.target += e.value;
+        break;
+      case SET_U32:
+        *(unsigned *)e.target = e.value;
+        break;
+      case SET_U64:
+        *(unsigned long long *)e.target = e.value;
+        break;
+      case NUMBER:
+        *(unsigned *)e.target = ++*m_uid_counters[e.value];
+        break;
+      case CALL:
+        m_effects[e.value]();
+        break;
+    }
+  }
+  m_entries.clear();
+  m_uid_counters.clear();
+  m_effects.clear();
+  // past the last id any cluster took, whichever cluster flushes last
+  for (unsigned i = 0; i < m_uid_ranges.size(); i++) {
+    const uid_range &r = m_uid_ranges[i];
+    unsigned last = r.base + (r.taken - 1) * m_n_clusters + m_cluster_id;
+    *r.next = std::max(*r.next, last + 1);
+  }
+  m_uid_ranges.clear();
+}
@@ -0,0 +1,131 @@
+// Effects of one SIMT cluster's core cycle on state the clusters share
+//
+// With -gpgpu_core_cluster_threads the clusters of the core clock cycle on
+// a thread pool. While a cluster cycles on the pool, its updates of the
+// shared counters, its interconnect pushes and the gpu level events it
+// causes are appended to the cluster's log instead of being applied, and
+// once every cluster is done the logs are replayed one cluster after the
+// other, in the order the serial loop applies them. A cluster sees the shared
+// state as it was at the start of the cycle, so the result does not depend
+// on the number of threads. Outside the pool there is no current log and the
+// core_stage_* helpers apply at once.
+
+#ifndef CORE_STAGE_LOG_H
+#define CORE_STAGE_LOG_H
+
+#include <functional>
+#include <vector>
+
+class core_stage_log {
+ public:
+  core_stage_log(unsigned cluster_id, unsigned n_clusters);
+
+  // the log of the cluster cycling on this thread, NULL outside the pool
+  static core_stage_log *current() { return t_current; }
+  static void set_current(core_stage_log *log) { t_current = log; }
+
+  void add(unsigned &counter, unsigned delta) {
+    push(ADD_U32, &counter, delta);
+  }
+  void add(unsigned long long &counter, unsigned long long delta) {
+    push(ADD_U64, &counter, delta);
+  }
+  void set(unsigned &var, unsigned value) { push(SET_U32, &var, value); }
+  void set(unsigned long long &var, unsigned long long value) {
+    push(SET_U64, &var, value);
+  }
+  // uid = ++next at the replay, so the uids come out in serial order
+  void number(unsigned &uid, unsigned &next);
+  void defer(const std::function<void()> &effect) {
+    push(CALL, NULL, m_effects.size());
+    m_effects.push_back(effect);
+  }
+  // next++ for ids that are only printed: unique and the same in every run,
+  // but interleaved between the clusters rather than in serial order
+  unsigned take_uid(unsigned &next);
+
+  // replay and clear the log
+  void flush();
+
+ private:
+  enum kind { ADD_U32, ADD_U64, SET_U32, SET_U64, NUMBER, CALL };
+  struct entry {
+    kind type;
+    void *target;
+    unsigned long long value;
+  };
+  struct uid_range {
+    unsigned *next;
+    unsigned base;
+    unsigned taken;
+  };
+
+  void push(kind type, void *target, unsigned long long value) {
+    entry e = {type, target, value};
+    m_entries.push_back(e);
+  }
+
+  unsigned m_cluster_id;
+  unsigned m_n_clusters;
+  std::vector<entry> m_entries;
+  std::vector<unsigned *> m_uid_counters;  // by NUMBER entry value
+  std::vector<std::function<void()> > m_effects;
+  std::vector<uid_range> m_uid_ranges;
+
+  static thread_local core_stage_log *t_current;
+};
+
+inline void core_stage_add(unsigned &counter, unsigned delta) {
+  if (core_stage_log *log = core_stage_log::current())
+    log->add(counter, delta);
+  else
+    counter += delta;
+}
+
+inline void core_stage_add(unsigned long long &counter,
+                           unsigned long long delta) {
+  if (core_stage_log *log = core_stage_log::current())
+    log->add(counter, delta);
+  else
+    counter += delta;
+}
+
+inline void core_stage_set(unsigned &var, unsigned value) {
+  if (core_stage_log *log = core_stage_log::current())
+    log->set(var, value);
+  else
+    var = value;
+}
+
+inline void core_stage_set(unsigned long long &var, unsigned long long value) {
+  if (core_stage_log *log = core_stage_log::current())
+    log->set(var, value);
+  else
+    var = value;
+}
+
+// uid is 0 until the replay numbers it
+inline void core_stage_number(unsigned &uid, unsigned &next) {
+  if (core_stage_log *log = core_stage_log::current()) {
+    uid = 0;
+    log->number(uid, next);
+  } else {
+    uid = ++next;
+  }
+}
+
+inline unsigned core_stage_take_uid(unsigned &next) {
+  if (core_stage_log *log = core_stage_log::current())
+    return log->take_uid(next);
+  return next++;
+}
+
+template <class F>
+inline void core_stage_defer(const F &effect) {
+  if (core_stage_log *log = core_stage_log::current())
+    log->defer(effect);
+  else
+    effect();
+}
+
+#endif
@@ -0,0 +1,138 @@
+// Time series of simulator counters
+
+#include "counter_sampler.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+counter_sampler::counter_sampler() {
+  m_file = NULL;
+  m_period = 0;
+  m_next_sample = 0;
+  m_row_size = 1;
+  m_rows_per_chunk = 0;
+  m_fill = 0;
+  m_written = 0;
+  m_stop = false;
+}
+
+counter_sampler::~counter_sampler() { close(); }
+
+void counter_sampler::add_counter(const char *name, const source &read) {
+  assert(!enabled());
+  m_names.push_back(name);
+  m_sources.push_back(read);
+  m_kinds.push_back(0);
+  m_row_size = m_sources.size() + 1;
+}
+
+void counter_sampler::add_gauge(const char *name,
+                                const std::function<double()> &read) {
+  add_counter(name, [read]() -> unsigned long long {
+    double v = read();
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+  });
+  m_kinds.back() = 1;
+}
+
+static void write_u32(gzFile f, uint32_t v) {
+  unsigned char b[4];
+  for (unsigned i = 0; i < 4; i++) b[i] = v >> (8 * i);
+  gzwrite(f, b, sizeof(b));
+}
+
+static void write_u64(gzFile f, uint64_t v) {
+  unsigned char b[8];
+  for (unsigned i = 0; i < 8; i++) b[i] = v >> (8 * i);
+  gzwrite(f, b, sizeof(b));
+}
+
+bool counter_sampler::open(const char *path, unsigned long long period,
+                           unsigned rows_per_chunk, unsigned n_chunks,
+                           int zlevel) {
+  assert(!enabled() && period && rows_per_chunk && n_chunks >= 2);
+  char mode[8] = "wb";
+  if (zlevel >= 0 && zlevel <= 9) snprintf(mode, sizeof(mode), "wb%d", zlevel);
+  m_file = gzopen(path, mode);
+  if (!m_file) return false;
+  gzwrite(m_file, "GSMP", 4);
+  write_u32(m_file, 2);
+  write_u64(m_file, period);
+  write_u32(m_file, m_names.size());
+  for (unsigned i = 0; i < m_names.size(); i++) {
+    write_u32(m_file, m_names[i].size());
+    gzwrite(m_file, m_names[i].data(), m_names[i].size());
+    gzwrite(m_file, &m_kinds[i], 1);
+  }
+  m_period = period;
+  m_next_sample = period;
+  m_rows_per_chunk = rows_per_chunk;
+  m_ring.resize(n_chunks);
+  for (unsigned c = 0; c < n_chunks; c++) {
+    m_ring[c].data.resize((size_t)rows_per_chunk * m_row_size);
+    m_ring[c].rows = 0;
+  }
+  m_stop = false;
+  m_writer = std::thread(&counter_sampler::writer, this);
+  return true;
+}
+
+void counter_sampler::sample(unsigned long long now) {
+  chunk &c = m_ring[m_fill % m_ring.size()];
+  unsigned long long *row = &c.data[(size_t)c.rows * m_row_size];
+  row[0] = now;
+  for (unsigned i = 0; i < m_sources.size(); i++) row[i + 1] = m_sources[i]();
+  if (++c.rows == m_rows_per_chunk) submit();
+  // a cycle skipped while idle does not shift the later samples
+  m_next_sample = (now / m_period + 1) * m_period;
+}
+
+void counter_sampler::submit() {
+  std::unique_lock<std::mutex> lock(m_lock);
+  m_fill++;
+  m_ready.notify_one();
+  // the next chunk has to be written out before it is refilled
+  m_drained.wait(lock, [this] { return m_fill - m_written < m_ring.size(); });
+  m_ring[m_fill % m_ring.size()].rows = 0;
+}
+
+void counter_sampler::writer() {
+  std::vector<unsigned char> bytes;
+  std::unique_lock<std::mutex> lock(m_lock);
+  while (true) {
+    m_ready.wait(lock, [this] { return m_stop || m_written < m_fill; });
+    if (m_written == m_fill) break;
+    chunk &c = m_ring[m_written % m_ring.size()];
+    lock.unlock();
+    // the rows are written as little-endian 64 bit values
+    size_t n = (size_t)c.rows * m_row_size;
+    bytes.resize(n * 8);
+    for (size_t i = 0; i < n; i++)
+      for (unsigned b = 0; b < 8; b++) bytes[i * 8 + b] = c.data[i] >> (8 * b);
+    gzwrite(m_file, bytes.data(), bytes.size());
+    lock.lock();
+    m_written++;
+    m_drained.notify_one();
+  }
+}
+
+void counter_sampler::close() {
+  if (!enabled()) return;
+  // the partly filled chunk goes out last
+  if (m_ring[m_fill % m_ring.size()].rows) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_fill++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_stop = true;
+  }
+  m_ready.notify_one();
+  m_writer.join();
+  gzclose(m_file);
+  m_file = NULL;
+}
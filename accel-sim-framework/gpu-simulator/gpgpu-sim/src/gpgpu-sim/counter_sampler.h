@@ -0,0 +1,84 @@
+// Time series of simulator counters
+//
+// Every -gpgpu_counter_sample_period cycles the registered counters are
+// copied into the next row of a preallocated ring of chunks. A full chunk
+// goes to a writer thread that appends it to the gzip file of
+// -gpgpu_counter_sample_file, so all the simulation pays per sample is the
+// copy; it only waits when every chunk of the ring is still being written.
+// The file is a header (magic "GSMP", version, period, counter count and
+// the name and kind of each) followed by rows of the cycle and the counter
+// values, all little-endian 64 bit except the 32 bit version, count and
+// name lengths and the 8 bit kinds. A counter is either cumulative, kind 0,
+// or a gauge holding a double, kind 1. Version 1 files have no kinds and
+// only cumulative counters. util/plotting/counter_samples.py reads both.
+
+#ifndef COUNTER_SAMPLER_H
+#define COUNTER_SAMPLER_H
+
+#include <zlib.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class counter_sampler {
+ public:
+  typedef std::function<unsigned long long()> source;
+
+  counter_sampler();
+  ~counter_sampler();
+
+  // counters are cumulative, the reader takes the differences. All of them
+  // are added before open
+  void add_counter(const char *name, const source &read);
+  // a value recorded as it is, such as a power
+  void add_gauge(const char *name, const std::function<double()> &read);
+  // rows_per_chunk rows in each of n_chunks chunks, false when path cannot
+  // be written. zlevel is the gzip level, 0 stores the rows uncompressed
+  bool open(const char *path, unsigned long long period,
+            unsigned rows_per_chunk, unsigned n_chunks,
+            int zlevel = Z_DEFAULT_COMPRESSION);
+  bool enabled() const { return m_file != NULL; }
+  void tick(unsigned long long now) {
+    if (now >= m_next_sample) sample(now);
+  }
+  // a row now, for a caller that picks the cycles itself
+  void record(unsigned long long now) { sample(now); }
+  // writes the rows sampled so far and closes the file
+  void close();
+
+ private:
+  void sample(unsigned long long now);
+  // hands the chunk being filled to the writer
+  void submit();
+  void writer();
+
+  std::vector<std::string> m_names;
+  std::vector<source> m_sources;
+  std::vector<unsigned char> m_kinds;
+  gzFile m_file;
+  unsigned long long m_period;
+  unsigned long long m_next_sample;
+
+  // a cycle and one value per counter for each row
+  unsigned m_row_size;
+  unsigned m_rows_per_chunk;
+  struct chunk {
+    std::vector<unsigned long long> data;
+    unsigned rows;
+  };
+  std::vector<chunk> m_ring;
+  // the chunk being filled and the oldest one not written yet, indices grow
+  // without wrapping and are taken modulo the ring size
+  unsigned long long m_fill;
+  unsigned long long m_written;
+  std::mutex m_lock;
+  std::condition_variable m_ready;
+  std::condition_variable m_drained;
+  bool m_stop;
+  std::thread m_writer;
+};
+
+#endif
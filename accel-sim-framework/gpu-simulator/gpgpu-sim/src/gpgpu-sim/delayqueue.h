@@ -29,6 +29,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 #ifndef DELAYQUEUE_H
 #define DELAYQUEUE_H
@@ -36,72 +37,93 @@
 #include "../statwrapper.h"
 #include "gpu-misc.h"
 
+// FIFO over a power of two array, grows by doubling when full so a queue
+// sized for its bound never allocates once running
 template <class T>
-struct fifo_data {
-  T* m_data;
-  fifo_data* m_next;
+class ring_buffer {
+ public:
+  ring_buffer(unsigned capacity = 1) : m_head(0), m_size(0) {
+    unsigned n = 1;
+    while (n < capacity) n <<= 1;
+    m_slots.resize(n);
+  }
+
+  bool empty() const { return m_size == 0; }
+  unsigned size() const { return m_size; }
+  // i-th element from the front
+  T &operator[](unsigned i) { return m_slots[(m_head + i) & mask()]; }
+  const T &operator[](unsigned i) const {
+    return m_slots[(m_head + i) & mask()];
+  }
+  T &front() { return (*this)[0]; }
+  const T &front() const { return (*this)[0]; }
+  T &back() { return (*this)[m_size - 1]; }
+
+  void push_back(const T &v) {
+    if (m_size == m_slots.size()) grow();
+    m_slots[(m_head + m_size) & mask()] = v;
+    m_size++;
+  }
+  void pop_front() {
+    assert(m_size);
+    m_head = (m_head + 1) & mask();
+    m_size--;
+  }
+  void pop_back() {
+    assert(m_size);
+    m_size--;
+  }
+
+ private:
+  unsigned mask() const { return m_slots.size() - 1; }
+  void grow() {
+    std::vector<T> slots(2 * m_slots.size());
+    for (unsigned i = 0; i < m_size; i++) slots[i] = (*this)[i];
+    m_slots.swap(slots);
+    m_head = 0;
+  }
+
+  std::vector<T> m_slots;
+  unsigned m_head;
+  unsigned m_size;
 };
 
+// bounded FIFO that may hold NULL entries: keeping at least minlen entries
+// delays every element by minlen pops. Entries are a ring buffer of maxlen
+// slots so pushing and popping allocate nothing
 template <class T>
 class fifo_pipeline {
  public:
-  fifo_pipeline(const char* nm, unsigned int minlen, unsigned int maxlen) {
+  fifo_pipeline(const char* nm, unsigned int minlen, unsigned int maxlen)
+      : m_entries(maxlen) {
     assert(maxlen);
     m_name = nm;
     m_min_len = minlen;
     m_max_len = maxlen;
-    m_length = 0;
     m_n_element = 0;
-    m_head = NULL;
-    m_tail = NULL;
     for (unsigned i = 0; i < m_min_len; i++) push(NULL);
   }
 
-  ~fifo_pipeline() {
-    while (m_head) {
-      m_tail = m_head;
-      m_head = m_head->m_next;
-      delete m_tail;
-    }
-  }
-
   void push(T* data) {
-    assert(m_length < m_max_len);
-    if (m_head) {
-      if (m_tail->m_data || m_length < m_min_len) {
-        m_tail->m_next = new fifo_data<T>();
-        m_tail = m_tail->m_next;
-        m_length++;
-        m_n_element++;
-      }
-    } else {
-      m_head = m_tail = new fifo_data<T>();
-      m_length++;
+    assert(m_entries.size() < m_max_len);
+    // a trailing delay entry takes the data unless the minimum length still
+    // needs it
+    if (m_entries.empty() || m_entries.back() ||
+        m_entries.size() < m_min_len) {
+      m_entries.push_back(data);
       m_n_element++;
+    } else {
+      m_entries.back() = data;
     }
-    m_tail->m_next = NULL;
-    m_tail->m_data = data;
   }
 
   T* pop() {
-    fifo_data<T>* next;
     T* data;
-    if (m_head) {
-      next = m_head->m_next;
-      data = m_head->m_data;
-      if (m_head == m_tail) {
-        assert(next == NULL);
-        m_tail = NULL;
-      }
-      delete m_head;
-      m_head = next;
-      m_length--;
-      if (m_length == 0) {
-        assert(m_head == NULL);
-        m_tail = m_head;
-      }
+    if (!m_entries.empty()) {
+      data = m_entries.front();
+      m_entries.pop_front();
       m_n_element--;
-      if (m_min_len && m_length < m_min_len) {
+      if (m_min_len && m_entries.size() < m_min_len) {
         push(NULL);
         m_n_element--;  // uncount NULL elements inserted to create delays
       }
@@ -111,64 +133,47 @@ class fifo_pipeline {
     return data;
   }
 
-  T* top() const {
-    if (m_head) {
-      return m_head->m_data;
-    } else {
-      return NULL;
-    }
-  }
+  T* top() const { return m_entries.empty() ? NULL : m_entries.front(); }
 
   void set_min_length(unsigned int new_min_len) {
     if (new_min_len == m_min_len) return;
 
     if (new_min_len > m_min_len) {
       m_min_len = new_min_len;
-      while (m_length < m_min_len) {
+      while (m_entries.size() < m_min_len) {
         push(NULL);
         m_n_element--;  // uncount NULL elements inserted to create delays
       }
     } else {
       // in this branch imply that the original min_len is larger then 0
       // ie. head != 0
-      assert(m_head);
+      assert(!m_entries.empty());
       m_min_len = new_min_len;
-      while ((m_length > m_min_len) && (m_tail->m_data == 0)) {
-        fifo_data<T>* iter;
-        iter = m_head;
-        while (iter && (iter->m_next != m_tail)) iter = iter->m_next;
-        if (!iter) {
-          // there is only one node, and that node is empty
-          assert(m_head->m_data == 0);
+      while ((m_entries.size() > m_min_len) && (m_entries.back() == 0)) {
+        if (m_entries.size() == 1) {
+          // there is only one entry, and that entry is empty
           pop();
         } else {
-          // there are more than one node, and tail node is empty
-          assert(iter->m_next == m_tail);
-          delete m_tail;
-          m_tail = iter;
-          m_tail->m_next = 0;
-          m_length--;
+          // there are more than one entry, and tail entry is empty
+          m_entries.pop_back();
         }
       }
     }
   }
 
-  bool full() const { return (m_max_len && m_length >= m_max_len); }
+  bool full() const { return (m_max_len && m_entries.size() >= m_max_len); }
   bool is_avilable_size(unsigned size) const {
-    return (m_max_len && m_length + size - 1 >= m_max_len);
+    return (m_max_len && m_entries.size() + size - 1 >= m_max_len);
   }
-  bool empty() const { return m_head == NULL; }
+  bool empty() const { return m_entries.empty(); }
   unsigned get_n_element() const { return m_n_element; }
-  unsigned get_length() const { return m_length; }
+  unsigned get_length() const { return m_entries.size(); }
   unsigned get_max_len() const { return m_max_len; }
 
   void print() const {
-    fifo_data<T>* ddp = m_head;
-    printf("%s(%d): ", m_name, m_length);
-    while (ddp) {
-      printf("%p ", ddp->m_data);
-      ddp = ddp->m_next;
-    }
+    printf("%s(%d): ", m_name, m_entries.size());
+    for (unsigned i = 0; i < m_entries.size(); i++)
+      printf("%p ", m_entries[i]);
     printf("\n");
   }
 
@@ -177,11 +182,9 @@ class fifo_pipeline {
 
   unsigned int m_min_len;
   unsigned int m_max_len;
-  unsigned int m_length;
   unsigned int m_n_element;
 
-  fifo_data<T>* m_head;
-  fifo_data<T>* m_tail;
+  ring_buffer<T*> m_entries;
 };
 
 #endif
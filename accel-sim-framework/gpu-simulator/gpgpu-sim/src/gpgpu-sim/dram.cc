@@ -31,6 +31,7 @@
 
 #include "dram.h"
 #include "dram_sched.h"
+#include "dram_traffic.h"
 #include "gpu-misc.h"
 #include "gpu-sim.h"
 #include "hashing.h"
@@ -53,6 +54,16 @@ dram_t::dram_t(unsigned int partition_id, const memory_config *config,
   m_stats = stats;
   m_config = config;
   m_gpu = gpu;
+  m_defer_stats = false;
+  m_deferred_access = 0;
+  m_deferred_reads = 0;
+  m_deferred_writes = 0;
+  for (unsigned c = 0; c < 2; c++) {
+    m_deferred_class_accesses[c] = 0;
+    m_deferred_class_row_hits[c] = 0;
+    m_deferred_class_bytes[c] = 0;
+    m_deferred_class_queue_latency[c] = 0;
+  }
 
   // rowblp
   access_num = 0;
@@ -103,7 +114,23 @@ dram_t::dram_t(unsigned int partition_id, const memory_config *config,
   for (unsigned i = 0; i < m_config->nbkgrp; i++) {
     bkgrp[i]->CCDLc = 0;
     bkgrp[i]->RTPLc = 0;
+    bkgrp[i]->RRDLc = 0;
+  }
+  m_refresh_countdown = m_config->tREFIpb;
+  m_refresh_owed = 0;
+  m_refresh_bank = 0;
+  for (unsigned i = 0; i < 4; i++) m_act_cycles[i] = 0;
+  m_act_oldest = 0;
+
+  if (m_config->nbk > 64) {
+    printf("GPGPU-Sim: the DRAM bank bitmaps hold 64 banks, %u configured\n",
+           m_config->nbk);
+    exit(1);
   }
+  m_all_banks = bank_run(0, m_config->nbk);
+  m_pending_banks = m_hit_banks = m_write_banks = 0;
+  m_busy_banks = m_timing_banks = 0;
+  m_idle_visits.assign(m_config->nbk + 1, 0);
 
   bk = (bank_t **)calloc(sizeof(bank_t *), m_config->nbk);
   bk[0] = (bank_t *)calloc(sizeof(bank_t), m_config->nbk);
@@ -129,6 +156,7 @@ dram_t::dram_t(unsigned int partition_id, const memory_config *config,
   n_nop = 0;
   n_act = 0;
   n_pre = 0;
+  n_ref = 0;
   n_rd = 0;
   n_wr = 0;
   n_wr_WB = 0;
@@ -235,7 +263,7 @@ dram_req_t::dram_req_t(class mem_fetch *mf, unsigned banks,
 
   row = tlx.row;
   col = tlx.col;
-  nbytes = mf->get_data_size();
+  nbytes = mf->get_dram_size();
 
   timestamp = m_gpu->gpu_tot_sim_cycle + m_gpu->gpu_sim_cycle;
   addr = mf->get_addr();
@@ -247,9 +275,16 @@ void dram_t::push(class mem_fetch *data) {
   assert(id == data->get_tlx_addr()
                    .chip);  // Ensure request is in correct memory partition
 
-  dram_req_t *mrq =
-      new dram_req_t(data, m_config->nbk, m_config->dram_bnk_indexing_policy,
-                     m_memory_partition_unit->get_mgpu());
+  dram_req_t req(data, m_config->nbk, m_config->dram_bnk_indexing_policy,
+                 m_memory_partition_unit->get_mgpu());
+  dram_req_t *mrq;
+  if (m_free_reqs.empty()) {
+    mrq = new dram_req_t(req);
+  } else {
+    mrq = m_free_reqs.back();
+    m_free_reqs.pop_back();
+    *mrq = req;
+  }
 
   data->set_status(IN_PARTITION_MC_INTERFACE_QUEUE,
                    m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
@@ -265,7 +300,94 @@ void dram_t::push(class mem_fetch *data) {
     max_mrqs_temp = (max_mrqs_temp > mrqq->get_length()) ? max_mrqs_temp
                                                          : mrqq->get_length();
   }
-  m_stats->memlatstat_dram_access(data);
+  if (!background(data)) record_dram_access(data);
+}
+
+bool dram_t::background(const mem_fetch *data) const {
+  const dram_traffic *traffic = m_memory_partition_unit->traffic();
+  return traffic && traffic->owns(data);
+}
+
+void dram_t::count_request(const mem_fetch *data) {
+  bool write = data->get_type() == WRITE_REQUEST;
+  bool read = data->get_type() == READ_REQUEST;
+  if (m_defer_stats) {
+    m_deferred_access++;
+    m_deferred_writes += write;
+    m_deferred_reads += read;
+    return;
+  }
+  m_stats->total_n_access++;
+  m_stats->total_n_writes += write;
+  m_stats->total_n_reads += read;
+}
+
+void dram_t::record_mrq_latency(unsigned mrq_latency) {
+  if (m_defer_stats) {
+    m_deferred_mrq_latency.push_back(mrq_latency);
+    return;
+  }
+  m_stats->tot_mrq_latency += mrq_latency;
+  m_stats->tot_mrq_num++;
+  m_stats->mrq_lat_table[LOGB2(mrq_latency)]++;
+  if (mrq_latency > m_stats->max_mrq_latency) {
+    m_stats->max_mrq_latency = mrq_latency;
+  }
+}
+
+void dram_t::record_dram_access(mem_fetch *data) {
+  if (m_defer_stats)
+    m_deferred_dram_access.push_back(data);
+  else
+    m_stats->memlatstat_dram_access(data);
+}
+
+void dram_t::record_class_access(bool graphics, bool rowhit, unsigned bytes,
+                                 unsigned long long queue_latency) {
+  unsigned long long *accesses = m_stats->dram_class_accesses;
+  unsigned long long *row_hits = m_stats->dram_class_row_hits;
+  unsigned long long *class_bytes = m_stats->dram_class_bytes;
+  unsigned long long *latency = m_stats->dram_class_queue_latency;
+  if (m_defer_stats) {
+    accesses = m_deferred_class_accesses;
+    row_hits = m_deferred_class_row_hits;
+    class_bytes = m_deferred_class_bytes;
+    latency = m_deferred_class_queue_latency;
+  }
+  accesses[graphics]++;
+  if (rowhit) row_hits[graphics]++;
+  class_bytes[graphics] += bytes;
+  latency[graphics] += queue_latency;
+}
+
+void dram_t::flush_deferred_stats() {
+  m_stats->total_n_access += m_deferred_access;
+  m_stats->total_n_reads += m_deferred_reads;
+  m_stats->total_n_writes += m_deferred_writes;
+  m_deferred_access = 0;
+  m_deferred_reads = 0;
+  m_deferred_writes = 0;
+  for (unsigned c = 0; c < 2; c++) {
+    m_stats->dram_class_accesses[c] += m_deferred_class_accesses[c];
+    m_stats->dram_class_row_hits[c] += m_deferred_class_row_hits[c];
+    m_stats->dram_class_bytes[c] += m_deferred_class_bytes[c];
+    m_stats->dram_class_queue_latency[c] += m_deferred_class_queue_latency[c];
+    m_deferred_class_accesses[c] = 0;
+    m_deferred_class_row_hits[c] = 0;
+    m_deferred_class_bytes[c] = 0;
+    m_deferred_class_queue_latency[c] = 0;
+  }
+
+  bool defer = m_defer_stats;
+  m_defer_stats = false;
+  for (unsigned i = 0; i < m_deferred_mrq_latency.size(); i++)
+    record_mrq_latency(m_deferred_mrq_latency[i]);
+  // pushed requests stay queued in the DRAM until a later cycle
+  for (unsigned i = 0; i < m_deferred_dram_access.size(); i++)
+    record_dram_access(m_deferred_dram_access[i]);
+  m_deferred_mrq_latency.clear();
+  m_deferred_dram_access.clear();
+  m_defer_stats = defer;
 }
 
 void dram_t::scheduler_fifo() {
@@ -276,10 +398,64 @@ void dram_t::scheduler_fifo() {
         IN_PARTITION_MC_BANK_ARB_QUEUE,
         m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
     bkn = head_mrqq->bk;
-    if (!bk[bkn]->mrq) bk[bkn]->mrq = mrqq->pop();
+    if (!bk[bkn]->mrq) {
+      bk[bkn]->mrq = mrqq->pop();
+      bank_changed(bkn);
+    }
+  }
+}
+
+void dram_t::bank_changed(unsigned j) {
+  unsigned long long bit = 1ULL << j;
+  m_pending_banks &= ~bit;
+  m_hit_banks &= ~bit;
+  m_write_banks &= ~bit;
+  const dram_req_t *mrq = bk[j]->mrq;
+  if (!mrq) return;
+  m_pending_banks |= bit;
+  if (mrq->rw == WRITE) m_write_banks |= bit;
+  if (bk[j]->state == BANK_ACTIVE && bk[j]->curr_row == mrq->row)
+    m_hit_banks |= bit;
+}
+
+void dram_t::bank_timing_changed(unsigned j) {
+  unsigned long long bit = 1ULL << j;
+  const bank_t *b = bk[j];
+  m_busy_banks &= ~bit;
+  m_timing_banks &= ~bit;
+  if (b->RCDc || b->RCDWRc || b->RASc || b->RCc || b->RPc)
+    m_busy_banks |= bit;
+  if ((m_busy_banks & bit) || b->WTPc || b->RTPc) m_timing_banks |= bit;
+}
+
+unsigned long long dram_t::bank_run(unsigned first, unsigned n) const {
+  unsigned nbk = m_config->nbk;
+  unsigned long long run = n >= 64 ? ~0ULL : (1ULL << n) - 1;
+  if (!first) return run;
+  unsigned long long all = nbk >= 64 ? ~0ULL : (1ULL << nbk) - 1;
+  return ((run << first) | (run >> (nbk - first))) & all;
+}
+
+void dram_t::idle_visits(unsigned first, unsigned n, long long times) {
+  if (!n) return;
+  unsigned nbk = m_config->nbk;
+  unsigned end = first + n;
+  m_idle_visits[first] += times;
+  if (end <= nbk) {
+    m_idle_visits[end] -= times;
+  } else {
+    m_idle_visits[nbk] -= times;
+    m_idle_visits[0] += times;
+    m_idle_visits[end - nbk] -= times;
   }
 }
 
+unsigned dram_t::bank_idle(unsigned j) const {
+  long long idle = 0;
+  for (unsigned i = 0; i <= j; i++) idle += m_idle_visits[i];
+  return idle;
+}
+
 #define DEC2ZERO(x) x = (x) ? (x - 1) : 0;
 #define SWAP(a, b) \
   a ^= b;          \
@@ -308,7 +484,7 @@ void dram_t::cycle() {
           m_memory_partition_unit->set_done(data);
           delete data;
         }
-        delete cmd;
+        m_free_reqs.push_back(cmd);
       }
 #ifdef DRAM_VIEWCMD
       printf("\n");
@@ -345,39 +521,23 @@ void dram_t::cycle() {
     ave_mrqs_partial += mrqq->get_length();
   }
 
-  unsigned k = m_config->nbk;
+  unsigned nbk = m_config->nbk;
+  unsigned k = nbk;
   bool issued = false;
 
   // collect row buffer locality, BLP and other statistics
   /////////////////////////////////////////////////////////////////////////
-  unsigned int memory_pending = 0;
-  for (unsigned i = 0; i < m_config->nbk; i++) {
-    if (bk[i]->mrq) memory_pending++;
-  }
+  unsigned int memory_pending = __builtin_popcountll(m_pending_banks);
   banks_1time += memory_pending;
   if (memory_pending > 0) banks_acess_total++;
 
-  unsigned int memory_pending_rw = 0;
-  unsigned read_blp_rw = 0;
-  unsigned write_blp_rw = 0;
+  unsigned read_blp_rw = __builtin_popcountll(m_hit_banks & ~m_write_banks);
+  unsigned write_blp_rw = __builtin_popcountll(m_hit_banks & m_write_banks);
+  unsigned int memory_pending_rw = read_blp_rw + write_blp_rw;
   std::bitset<8> bnkgrp_rw_found;  // assume max we have 8 bank groups
 
-  for (unsigned j = 0; j < m_config->nbk; j++) {
-    unsigned grp = get_bankgrp_number(j);
-    if (bk[j]->mrq &&
-        (((bk[j]->curr_row == bk[j]->mrq->row) && (bk[j]->mrq->rw == READ) &&
-          (bk[j]->state == BANK_ACTIVE)))) {
-      memory_pending_rw++;
-      read_blp_rw++;
-      bnkgrp_rw_found.set(grp);
-    } else if (bk[j]->mrq &&
-               (((bk[j]->curr_row == bk[j]->mrq->row) &&
-                 (bk[j]->mrq->rw == WRITE) && (bk[j]->state == BANK_ACTIVE)))) {
-      memory_pending_rw++;
-      write_blp_rw++;
-      bnkgrp_rw_found.set(grp);
-    }
-  }
+  for (unsigned long long b = m_hit_banks; b; b &= b - 1)
+    bnkgrp_rw_found.set(get_bankgrp_number(__builtin_ctzll(b)));
   banks_time_rw += memory_pending_rw;
   bkgrp_parallsim_rw += bnkgrp_rw_found.count();
   if (memory_pending_rw > 0) {
@@ -387,16 +547,13 @@ void dram_t::cycle() {
   }
 
   unsigned int memory_Pending_ready = 0;
-  for (unsigned j = 0; j < m_config->nbk; j++) {
-    unsigned grp = get_bankgrp_number(j);
-    if (bk[j]->mrq &&
-        ((!CCDc && !bk[j]->RCDc && !(bkgrp[grp]->CCDLc) &&
-          (bk[j]->curr_row == bk[j]->mrq->row) && (bk[j]->mrq->rw == READ) &&
-          (WTRc == 0) && (bk[j]->state == BANK_ACTIVE) && !rwq->full()) ||
-         (!CCDc && !bk[j]->RCDWRc && !(bkgrp[grp]->CCDLc) &&
-          (bk[j]->curr_row == bk[j]->mrq->row) && (bk[j]->mrq->rw == WRITE) &&
-          (RTWc == 0) && (bk[j]->state == BANK_ACTIVE) && !rwq->full()))) {
-      memory_Pending_ready++;
+  if (!CCDc && !rwq->full()) {
+    for (unsigned long long b = m_hit_banks; b; b &= b - 1) {
+      unsigned j = __builtin_ctzll(b);
+      if (bkgrp[get_bankgrp_number(j)]->CCDLc) continue;
+      if ((m_write_banks >> j) & 1 ? !bk[j]->RCDWRc && RTWc == 0
+                                   : !bk[j]->RCDc && WTRc == 0)
+        memory_Pending_ready++;
     }
   }
   banks_time_ready += memory_Pending_ready;
@@ -405,45 +562,60 @@ void dram_t::cycle() {
 
   bool issued_col_cmd = false;
   bool issued_row_cmd = false;
+  if (m_refresh_owed) issued_row_cmd = issue_refresh();
 
+  // only banks with an mrq can issue, the walks go from one to the next in
+  // the (i + prio) % nbk order. A bank without one counts as idle, and
+  // takes k down when neither it nor the bus has a timing counter set
   if (m_config->dual_bus_interface) {
     // dual bus interface
     // issue one row command and one column command
-    for (unsigned i = 0; i < m_config->nbk; i++) {
-      unsigned j = (i + prio) % m_config->nbk;
+    for (unsigned long long b = m_pending_banks; b;) {
+      unsigned j = first_bank(b, prio);
+      b &= ~(1ULL << j);
       issued_col_cmd = issue_col_command(j);
       if (issued_col_cmd) break;
     }
-    for (unsigned i = 0; i < m_config->nbk; i++) {
-      unsigned j = (i + prio) % m_config->nbk;
+    for (unsigned long long b = issued_row_cmd ? 0 : m_pending_banks; b;) {
+      unsigned j = first_bank(b, prio);
+      b &= ~(1ULL << j);
       issued_row_cmd = issue_row_command(j);
       if (issued_row_cmd) break;
     }
-    for (unsigned i = 0; i < m_config->nbk; i++) {
-      unsigned j = (i + prio) % m_config->nbk;
-      if (!bk[j]->mrq) {
-        if (!CCDc && !RRDc && !RTWc && !WTRc && !bk[j]->RCDc && !bk[j]->RASc &&
-            !bk[j]->RCc && !bk[j]->RPc && !bk[j]->RCDWRc)
-          k--;
-        bk[j]->n_idle++;
-      }
-    }
+    // every bank once, then the ones with an mrq taken back out
+    idle_visits(0, nbk, 1);
+    for (unsigned long long b = m_pending_banks; b; b &= b - 1)
+      idle_visits(__builtin_ctzll(b), 1, -1);
+    if (bus_free())
+      k -= __builtin_popcountll(m_all_banks & ~m_pending_banks &
+                                ~m_busy_banks);
   } else {
     // single bus interface
-    // issue only one row/column command
-    for (unsigned i = 0; i < m_config->nbk; i++) {
-      unsigned j = (i + prio) % m_config->nbk;
+    // issue only one row/column command. A row command moves prio, the
+    // rest of the walk follows it from the same i
+    unsigned i = 0;
+    while (i < nbk) {
+      unsigned first = (i + prio) % nbk;
+      unsigned long long ahead = bank_run(first, nbk - i) & m_pending_banks;
+      unsigned next =
+          ahead ? i + (first_bank(ahead, first) + nbk - first) % nbk : nbk;
+      // the banks walked past on the way have no mrq
+      idle_visits(first, next - i, 1);
+      if (bus_free())
+        k -= __builtin_popcountll(bank_run(first, next - i) & ~m_busy_banks);
+      if (next == nbk) break;
+
+      unsigned j = (next + prio) % nbk;
       if (!issued_col_cmd) issued_col_cmd = issue_col_command(j);
 
       if (!issued_col_cmd && !issued_row_cmd)
         issued_row_cmd = issue_row_command(j);
 
       if (!bk[j]->mrq) {
-        if (!CCDc && !RRDc && !RTWc && !WTRc && !bk[j]->RCDc && !bk[j]->RASc &&
-            !bk[j]->RCc && !bk[j]->RPc && !bk[j]->RCDWRc)
-          k--;
-        bk[j]->n_idle++;
+        if (bus_free() && !((m_busy_banks >> j) & 1)) k--;
+        idle_visits(j, 1, 1);
       }
+      i = next + 1;
     }
   }
 
@@ -471,32 +643,20 @@ void dram_t::cycle() {
   // Collect some statistics
   // check the limitation, see where BW is wasted?
   /////////////////////////////////////////////////////////
-  unsigned int memory_pending_found = 0;
-  for (unsigned i = 0; i < m_config->nbk; i++) {
-    if (bk[i]->mrq) memory_pending_found++;
-  }
+  unsigned int memory_pending_found = __builtin_popcountll(m_pending_banks);
   if (memory_pending_found > 0) banks_acess_total_after++;
 
-  bool memory_pending_rw_found = false;
-  for (unsigned j = 0; j < m_config->nbk; j++) {
-    if (bk[j]->mrq &&
-        (((bk[j]->curr_row == bk[j]->mrq->row) && (bk[j]->mrq->rw == READ) &&
-          (bk[j]->state == BANK_ACTIVE)) ||
-         ((bk[j]->curr_row == bk[j]->mrq->row) && (bk[j]->mrq->rw == WRITE) &&
-          (bk[j]->state == BANK_ACTIVE))))
-      memory_pending_rw_found = true;
-  }
+  bool memory_pending_rw_found = m_hit_banks != 0;
 
   if (issued_col_cmd || CCDc)
     util_bw++;
   else if (memory_pending_rw_found) {
     wasted_bw_col++;
-    for (unsigned j = 0; j < m_config->nbk; j++) {
+    for (unsigned long long b = m_hit_banks; b; b &= b - 1) {
+      unsigned j = __builtin_ctzll(b);
       unsigned grp = get_bankgrp_number(j);
       // read
-      if (bk[j]->mrq &&
-          (((bk[j]->curr_row == bk[j]->mrq->row) && (bk[j]->mrq->rw == READ) &&
-            (bk[j]->state == BANK_ACTIVE)))) {
+      if (!((m_write_banks >> j) & 1)) {
         if (bk[j]->RCDc) RCDc_limit++;
         if (bkgrp[grp]->CCDLc) CCDLc_limit++;
         if (WTRc) WTRc_limit++;
@@ -506,9 +666,7 @@ void dram_t::cycle() {
         if (!bkgrp[grp]->CCDLc && WTRc) WTRc_limit_alone++;
       }
       // write
-      else if (bk[j]->mrq &&
-               ((bk[j]->curr_row == bk[j]->mrq->row) &&
-                (bk[j]->mrq->rw == WRITE) && (bk[j]->state == BANK_ACTIVE))) {
+      else {
         if (bk[j]->RCDWRc) RCDWRc_limit++;
         if (bkgrp[grp]->CCDLc) CCDLc_limit++;
         if (RTWc) RTWc_limit++;
@@ -532,7 +690,9 @@ void dram_t::cycle() {
   DEC2ZERO(CCDc);
   DEC2ZERO(RTWc);
   DEC2ZERO(WTRc);
-  for (unsigned j = 0; j < m_config->nbk; j++) {
+  // the other banks have every counter at zero already
+  for (unsigned long long b = m_timing_banks; b; b &= b - 1) {
+    unsigned j = __builtin_ctzll(b);
     DEC2ZERO(bk[j]->RCDc);
     DEC2ZERO(bk[j]->RASc);
     DEC2ZERO(bk[j]->RCc);
@@ -540,12 +700,17 @@ void dram_t::cycle() {
     DEC2ZERO(bk[j]->RCDWRc);
     DEC2ZERO(bk[j]->WTPc);
     DEC2ZERO(bk[j]->RTPc);
+    bank_timing_changed(j);
   }
   for (unsigned j = 0; j < m_config->nbkgrp; j++) {
     DEC2ZERO(bkgrp[j]->CCDLc);
     DEC2ZERO(bkgrp[j]->RTPLc);
+    DEC2ZERO(bkgrp[j]->RRDLc);
+  }
+  if (m_config->tREFIpb && !--m_refresh_countdown) {
+    m_refresh_countdown = m_config->tREFIpb;
+    m_refresh_owed++;
   }
-
 #ifdef DRAM_VISUALIZE
   visualize();
 #endif
@@ -626,6 +791,10 @@ bool dram_t::issue_col_command(int j) {
       }
     }
   }
+  if (issued) {
+    bank_changed(j);
+    bank_timing_changed(j);
+  }
 
   return issued;
 }
@@ -639,7 +808,7 @@ bool dram_t::issue_row_command(int j) {
     //     bank is idle
     // else
     if (!issued && !RRDc && (bk[j]->state == BANK_IDLE) && !bk[j]->RPc &&
-        !bk[j]->RCc) {  //
+        !bk[j]->RCc && act_allowed(j, grp)) {  //
 #ifdef DRAM_VERIFY
       PRINT_CYCLE = 1;
       printf("\tACT BK:%d NewRow:%03x From:%03x \n", j, bk[j]->mrq->row,
@@ -653,6 +822,9 @@ bool dram_t::issue_row_command(int j) {
       bk[j]->RCDWRc = m_config->tRCDWR;
       bk[j]->RASc = m_config->tRAS;
       bk[j]->RCc = m_config->tRC;
+      bkgrp[grp]->RRDLc = m_config->tRRDL;
+      m_act_cycles[m_act_oldest] = n_cmd;
+      m_act_oldest = (m_act_oldest + 1) % 4;
       prio = (j + 1) % m_config->nbk;
       issued = true;
       n_act_partial++;
@@ -678,9 +850,47 @@ bool dram_t::issue_row_command(int j) {
 #endif
     }
   }
+  if (issued) {
+    bank_changed(j);
+    bank_timing_changed(j);
+  }
   return issued;
 }
 
+bool dram_t::act_allowed(unsigned j, unsigned grp) const {
+  if (bkgrp[grp]->RRDLc) return false;
+  // the fourth activation back has to be tFAW old; n_act counts them all
+  if (m_config->tFAW && n_act >= 4 &&
+      n_cmd < m_act_cycles[m_act_oldest] + m_config->tFAW)
+    return false;
+  return !m_refresh_owed || j != m_refresh_bank;
+}
+
+bool dram_t::issue_refresh() {
+  unsigned j = m_refresh_bank;
+  bank_t *b = bk[j];
+  if (b->state == BANK_ACTIVE) {
+    // the row stays open while its mrq still hits it
+    if (b->mrq && b->curr_row == b->mrq->row) return false;
+    if (b->RASc || b->WTPc || b->RTPc || bkgrp[get_bankgrp_number(j)]->RTPLc)
+      return false;
+    b->state = BANK_IDLE;
+    b->RPc = m_config->tRP;
+    n_pre++;
+    n_pre_partial++;
+  } else {
+    if (b->RPc || b->RCc) return false;
+    // the bank may not activate before tRFCpb is over
+    b->RCc = m_config->tRFCpb;
+    n_ref++;
+    m_refresh_owed--;
+    m_refresh_bank = (j + 1) % m_config->nbk;
+  }
+  bank_changed(j);
+  bank_timing_changed(j);
+  return true;
+}
+
 // if mrq is being serviced by dram, gets popped after CL latency fulfilled
 class mem_fetch *dram_t::return_queue_pop() {
   return returnq->pop();
@@ -706,7 +916,7 @@ void dram_t::print(FILE *simFile) const {
   fprintf(simFile, "n_activity=%llu dram_eff=%.4g\n", n_activity,
           (float)bwutil / n_activity);
   for (i = 0; i < m_config->nbk; i++) {
-    fprintf(simFile, "bk%d: %da %di ", i, bk[i]->n_access, bk[i]->n_idle);
+    fprintf(simFile, "bk%d: %da %di ", i, bk[i]->n_access, bank_idle(i));
   }
   fprintf(simFile, "\n");
   fprintf(simFile,
@@ -67,11 +67,17 @@ class dram_req_t {
   unsigned int insertion_time;
   class mem_fetch *data;
   class gpgpu_sim *m_gpu;
+
+  // links of the FR-FCFS bank queue (arrival order) and row bin
+  dram_req_t *sched_older;
+  dram_req_t *sched_newer;
+  dram_req_t *row_newer;
 };
 
 struct bankgrp_t {
   unsigned int CCDLc;
   unsigned int RTPLc;
+  unsigned int RRDLc;  // activate to activate in the group
 };
 
 struct bank_t {
@@ -91,7 +97,6 @@ struct bank_t {
 
   unsigned int n_access;
   unsigned int n_writes;
-  unsigned int n_idle;
 
   unsigned int bkgrpindex;
 };
@@ -130,6 +135,15 @@ class dram_t {
   void cycle();
   void dram_log(int task);
 
+  // while partitions cycle in parallel, the m_stats updates shared with
+  // other partitions are held here and applied by flush_deferred_stats() in
+  // partition order, as the serial loop would
+  void set_defer_stats(bool defer) { m_defer_stats = defer; }
+  void flush_deferred_stats();
+  // the scheduler served a request of its class
+  void record_class_access(bool graphics, bool rowhit, unsigned bytes,
+                           unsigned long long queue_latency);
+
   class memory_partition_unit *m_memory_partition_unit;
   class gpgpu_sim *m_gpu;
   unsigned int id;
@@ -149,12 +163,74 @@ class dram_t {
 
   unsigned get_bankgrp_number(unsigned i);
 
+  // a request of the background traffic, kept out of the GPU's stats
+  bool background(const class mem_fetch *data) const;
+  void count_request(const class mem_fetch *data);
+  void record_mrq_latency(unsigned mrq_latency);
+  void record_dram_access(class mem_fetch *data);
+
+  bool m_defer_stats;
+  unsigned m_deferred_access;
+  unsigned m_deferred_reads;
+  unsigned m_deferred_writes;
+  std::vector<unsigned> m_deferred_mrq_latency;
+  std::vector<class mem_fetch *> m_deferred_dram_access;
+  // by class, graphics second
+  unsigned long long m_deferred_class_accesses[2];
+  unsigned long long m_deferred_class_row_hits[2];
+  unsigned long long m_deferred_class_bytes[2];
+  unsigned long long m_deferred_class_queue_latency[2];
+
   void scheduler_fifo();
   void scheduler_frfcfs();
 
   bool issue_col_command(int j);
   bool issue_row_command(int j);
 
+  // the tRRDL, tFAW and refresh rules an activation of bank j in group grp
+  // has to meet on top of the GDDR ones
+  bool act_allowed(unsigned j, unsigned grp) const;
+  // REFpb: the owed refresh of m_refresh_bank, or the precharge it waits
+  // for. Takes the row command slot of the cycle when it issues
+  bool issue_refresh();
+
+  // the banks as bitmaps, bit j for bank j, so that cycle() only looks at
+  // the banks that can issue. bank_changed follows the mrq, state and row
+  // of bank j, bank_timing_changed its counters
+  void bank_changed(unsigned j);
+  void bank_timing_changed(unsigned j);
+  // n banks from bank first on, wrapping around after the last one
+  unsigned long long bank_run(unsigned first, unsigned n) const;
+  // the first bank of banks at or after bank from, wrapping around
+  unsigned first_bank(unsigned long long banks, unsigned from) const {
+    unsigned long long after = banks & (~0ULL << from);
+    return __builtin_ctzll(after ? after : banks);
+  }
+  // times more idle visits of the n banks from first on, see m_idle_visits
+  void idle_visits(unsigned first, unsigned n, long long times);
+  unsigned bank_idle(unsigned j) const;
+  bool bus_free() const { return !CCDc && !RRDc && !RTWc && !WTRc; }
+
+  unsigned long long m_all_banks;
+  unsigned long long m_pending_banks;  // with an mrq
+  unsigned long long m_hit_banks;      // active on the row of their mrq
+  unsigned long long m_write_banks;    // their mrq is a write
+  unsigned long long m_busy_banks;     // RCDc, RCDWRc, RASc, RCc or RPc set
+  unsigned long long m_timing_banks;   // any counter of the bank set
+  // cycles each bank was seen without an mrq by the issue walks, as a
+  // difference array: a run of idle banks is two updates, not one per bank
+  std::vector<long long> m_idle_visits;
+
+  // per-bank refreshes, one bank after the other every tREFIpb cycles.
+  // Owed ones wait for their bank to close its row, the bank activates
+  // nothing meanwhile
+  unsigned m_refresh_countdown;
+  unsigned m_refresh_owed;
+  unsigned m_refresh_bank;
+  // the n_cmd of the last four activations, for tFAW
+  unsigned long long m_act_cycles[4];
+  unsigned m_act_oldest;
+
   unsigned int RRDc;
   unsigned int CCDc;
   unsigned int RTWc;  // read to write penalty applies across banks
@@ -167,6 +243,8 @@ class dram_t {
 
   fifo_pipeline<dram_req_t> *rwq;
   fifo_pipeline<dram_req_t> *mrqq;
+  // retired requests reused by push, only this partition touches them
+  std::vector<dram_req_t *> m_free_reqs;
   // buffer to hold packets when DRAM processing is over
   // should be filled with dram clock and popped with l2or icnt clock
   fifo_pipeline<mem_fetch> *returnq;
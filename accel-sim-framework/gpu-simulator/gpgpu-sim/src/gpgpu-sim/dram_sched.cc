@@ -27,11 +27,214 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "dram_sched.h"
+#include <string.h>
 #include "../abstract_hardware_model.h"
 #include "gpu-misc.h"
 #include "gpu-sim.h"
 #include "mem_latency_stat.h"
 
+frfcfs_bank_queue::frfcfs_bank_queue()
+    : m_oldest(NULL), m_newest(NULL), m_size(0), m_num_bins(0) {
+  row_bin free_bin = {0, NULL, NULL};
+  m_bins.resize(16, free_bin);
+}
+
+unsigned frfcfs_bank_queue::find(unsigned row) const {
+  unsigned mask = m_bins.size() - 1;
+  for (unsigned i = slot_of(row); m_bins[i].oldest; i = (i + 1) & mask)
+    if (m_bins[i].row == row) return i;
+  return (unsigned)-1;
+}
+
+void frfcfs_bank_queue::push(dram_req_t *req) {
+  req->sched_older = m_newest;
+  req->sched_newer = NULL;
+  req->row_newer = NULL;
+  if (m_newest)
+    m_newest->sched_newer = req;
+  else
+    m_oldest = req;
+  m_newest = req;
+  m_size++;
+
+  unsigned slot = find(req->row);
+  if (slot != (unsigned)-1) {
+    m_bins[slot].newest->row_newer = req;
+    m_bins[slot].newest = req;
+    return;
+  }
+  if (2 * (m_num_bins + 1) > m_bins.size()) grow();
+  unsigned mask = m_bins.size() - 1;
+  for (slot = slot_of(req->row); m_bins[slot].oldest; slot = (slot + 1) & mask)
+    ;
+  m_bins[slot].row = req->row;
+  m_bins[slot].oldest = req;
+  m_bins[slot].newest = req;
+  m_num_bins++;
+}
+
+dram_req_t *frfcfs_bank_queue::pop_row(unsigned row) {
+  unsigned slot = find(row);
+  assert(slot != (unsigned)-1);  // where did the request go???
+  dram_req_t *req = m_bins[slot].oldest;
+  m_bins[slot].oldest = req->row_newer;
+  if (!m_bins[slot].oldest) erase_bin(slot);
+
+  if (req->sched_older)
+    req->sched_older->sched_newer = req->sched_newer;
+  else
+    m_oldest = req->sched_newer;
+  if (req->sched_newer)
+    req->sched_newer->sched_older = req->sched_older;
+  else
+    m_newest = req->sched_older;
+  m_size--;
+  return req;
+}
+
+void frfcfs_bank_queue::erase_bin(unsigned slot) {
+  // shift later bins of the probe run back so lookups need no tombstones
+  unsigned mask = m_bins.size() - 1;
+  unsigned hole = slot;
+  for (unsigned i = (slot + 1) & mask; m_bins[i].oldest; i = (i + 1) & mask) {
+    unsigned home = slot_of(m_bins[i].row);
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      m_bins[hole] = m_bins[i];
+      hole = i;
+    }
+  }
+  m_bins[hole].oldest = NULL;
+  m_num_bins--;
+}
+
+void frfcfs_bank_queue::grow() {
+  std::vector<row_bin> old;
+  old.swap(m_bins);
+  row_bin free_bin = {0, NULL, NULL};
+  m_bins.resize(2 * old.size(), free_bin);
+  unsigned mask = m_bins.size() - 1;
+  for (unsigned i = 0; i < old.size(); i++) {
+    if (!old[i].oldest) continue;
+    unsigned slot = slot_of(old[i].row);
+    while (m_bins[slot].oldest) slot = (slot + 1) & mask;
+    m_bins[slot] = old[i];
+  }
+}
+
+dram_sched_policy *dram_sched_policy::create(const char *name,
+                                             const memory_config *config) {
+  if (!strcmp(name, "frfcfs")) return new frfcfs_sched_policy();
+  if (!strcmp(name, "priority"))
+    return new priority_sched_policy(config->dram_sched_graphics_first);
+  if (!strcmp(name, "bliss"))
+    return new bliss_sched_policy(config->dram_bliss_threshold,
+                                  config->dram_bliss_clear_period);
+  if (!strcmp(name, "atlas"))
+    return new atlas_sched_policy(config->dram_atlas_quantum,
+                                  config->dram_atlas_age);
+  return NULL;
+}
+
+unsigned frfcfs_sched_policy::pick_row(const frfcfs_bank_queue &queue,
+                                       unsigned open_row,
+                                       unsigned long long now) {
+  return queue.has_row(open_row) ? open_row : queue.oldest()->row;
+}
+
+unsigned priority_sched_policy::pick_row(const frfcfs_bank_queue &queue,
+                                         unsigned open_row,
+                                         unsigned long long now) {
+  dram_req_t *hit = queue.row_oldest(open_row);
+  if (hit && hit->data->is_graphics() == m_graphics_first) return open_row;
+  for (dram_req_t *r = queue.oldest(); r; r = r->sched_newer)
+    if (r->data->is_graphics() == m_graphics_first) return r->row;
+  return hit ? open_row : queue.oldest()->row;
+}
+
+bliss_sched_policy::bliss_sched_policy(unsigned threshold,
+                                       unsigned clear_period) {
+  m_threshold = threshold;
+  m_clear_period = clear_period;
+  m_next_clear = clear_period;
+  m_last_tenant = (unsigned)-1;
+  m_streak = 0;
+  for (unsigned t = 0; t < MAX_TENANTS; t++) m_blacklisted[t] = false;
+}
+
+unsigned bliss_sched_policy::pick_row(const frfcfs_bank_queue &queue,
+                                      unsigned open_row,
+                                      unsigned long long now) {
+  if (now >= m_next_clear) {
+    for (unsigned t = 0; t < MAX_TENANTS; t++) m_blacklisted[t] = false;
+    m_next_clear = now + m_clear_period;
+  }
+  dram_req_t *hit = queue.row_oldest(open_row);
+  if (hit && !m_blacklisted[hit->data->get_tenant()]) return open_row;
+  for (dram_req_t *r = queue.oldest(); r; r = r->sched_newer)
+    if (!m_blacklisted[r->data->get_tenant()]) return r->row;
+  return hit ? open_row : queue.oldest()->row;
+}
+
+void bliss_sched_policy::served(const dram_req_t *req) {
+  unsigned t = req->data->get_tenant();
+  if (t == m_last_tenant) {
+    m_streak++;
+  } else {
+    m_last_tenant = t;
+    m_streak = 1;
+  }
+  if (m_threshold && m_streak >= m_threshold) m_blacklisted[t] = true;
+}
+
+atlas_sched_policy::atlas_sched_policy(unsigned quantum, unsigned age) {
+  m_quantum = quantum;
+  m_age = age;
+  m_next_quantum = quantum;
+  for (unsigned t = 0; t < MAX_TENANTS; t++) {
+    m_attained[t] = 0;
+    m_history[t] = 0;
+    m_rank[t] = 0;
+  }
+}
+
+void atlas_sched_policy::rank(unsigned long long now) {
+  // the weight ATLAS gives the past quanta
+  const double alpha = 0.875;
+  for (unsigned t = 0; t < MAX_TENANTS; t++) {
+    m_history[t] = alpha * m_history[t] + (1 - alpha) * m_attained[t];
+    m_attained[t] = 0;
+  }
+  for (unsigned t = 0; t < MAX_TENANTS; t++) {
+    m_rank[t] = 0;
+    for (unsigned u = 0; u < MAX_TENANTS; u++)
+      if (m_history[u] < m_history[t] ||
+          (m_history[u] == m_history[t] && u < t))
+        m_rank[t]++;
+  }
+  m_next_quantum = now + m_quantum;
+}
+
+unsigned atlas_sched_policy::pick_row(const frfcfs_bank_queue &queue,
+                                      unsigned open_row,
+                                      unsigned long long now) {
+  if (now >= m_next_quantum) rank(now);
+  dram_req_t *oldest = queue.oldest();
+  if (m_age && now - oldest->timestamp >= m_age) return oldest->row;
+  dram_req_t *best = oldest;
+  for (dram_req_t *r = oldest->sched_newer; r; r = r->sched_newer)
+    if (m_rank[r->data->get_tenant()] < m_rank[best->data->get_tenant()])
+      best = r;
+  dram_req_t *hit = queue.row_oldest(open_row);
+  if (hit &&
+      m_rank[hit->data->get_tenant()] <= m_rank[best->data->get_tenant()])
+    return open_row;
+  return best->row;
+}
+
+void atlas_sched_policy::served(const dram_req_t *req) {
+  m_attained[req->data->get_tenant()] += req->nbytes;
+}
+
 frfcfs_scheduler::frfcfs_scheduler(const memory_config *config, dram_t *dm,
                                    memory_stats_t *stats) {
   m_config = config;
@@ -39,50 +242,36 @@ frfcfs_scheduler::frfcfs_scheduler(const memory_config *config, dram_t *dm,
   m_num_pending = 0;
   m_num_write_pending = 0;
   m_dram = dm;
-  m_queue = new std::list<dram_req_t *>[m_config->nbk];
-  m_bins = new std::map<
-      unsigned, std::list<std::list<dram_req_t *>::iterator> >[m_config->nbk];
-  m_last_row =
-      new std::list<std::list<dram_req_t *>::iterator> *[m_config->nbk];
+  m_queue.resize(m_config->nbk);
+  m_last_row.resize(m_config->nbk, (unsigned)-1);
   curr_row_service_time = new unsigned[m_config->nbk];
   row_service_timestamp = new unsigned[m_config->nbk];
   for (unsigned i = 0; i < m_config->nbk; i++) {
-    m_queue[i].clear();
-    m_bins[i].clear();
-    m_last_row[i] = NULL;
     curr_row_service_time[i] = 0;
     row_service_timestamp[i] = 0;
   }
   if (m_config->seperate_write_queue_enabled) {
-    m_write_queue = new std::list<dram_req_t *>[m_config->nbk];
-    m_write_bins = new std::map<
-        unsigned, std::list<std::list<dram_req_t *>::iterator> >[m_config->nbk];
-    m_last_write_row =
-        new std::list<std::list<dram_req_t *>::iterator> *[m_config->nbk];
-
-    for (unsigned i = 0; i < m_config->nbk; i++) {
-      m_write_queue[i].clear();
-      m_write_bins[i].clear();
-      m_last_write_row[i] = NULL;
-    }
+    m_write_queue.resize(m_config->nbk);
+    m_last_write_row.resize(m_config->nbk, (unsigned)-1);
   }
   m_mode = READ_MODE;
+  m_policy = dram_sched_policy::create(m_config->dram_sched_policy, m_config);
+  if (!m_policy) {
+    fprintf(stderr, "GPGPU-Sim: unknown -dram_sched_policy %s\n",
+            m_config->dram_sched_policy);
+    exit(1);
+  }
 }
 
 void frfcfs_scheduler::add_req(dram_req_t *req) {
   if (m_config->seperate_write_queue_enabled && req->data->is_write()) {
     assert(m_num_write_pending < m_config->gpgpu_frfcfs_dram_write_queue_size);
     m_num_write_pending++;
-    m_write_queue[req->bk].push_front(req);
-    std::list<dram_req_t *>::iterator ptr = m_write_queue[req->bk].begin();
-    m_write_bins[req->bk][req->row].push_front(ptr);  // newest reqs to the
-                                                      // front
+    m_write_queue[req->bk].push(req);
   } else {
     assert(m_num_pending < m_config->gpgpu_frfcfs_dram_sched_queue_size);
     m_num_pending++;
-    m_queue[req->bk].push_front(req);
-    std::list<dram_req_t *>::iterator ptr = m_queue[req->bk].begin();
-    m_bins[req->bk][req->row].push_front(ptr);  // newest reqs to the front
+    m_queue[req->bk].push(req);
   }
 }
 
@@ -109,11 +298,8 @@ void frfcfs_scheduler::data_collection(unsigned int bank) {
 dram_req_t *frfcfs_scheduler::schedule(unsigned bank, unsigned curr_row) {
   // row
   bool rowhit = true;
-  std::list<dram_req_t *> *m_current_queue = m_queue;
-  std::map<unsigned, std::list<std::list<dram_req_t *>::iterator> >
-      *m_current_bins = m_bins;
-  std::list<std::list<dram_req_t *>::iterator> **m_current_last_row =
-      m_last_row;
+  std::vector<frfcfs_bank_queue> *m_current_queue = &m_queue;
+  std::vector<unsigned> *m_current_last_row = &m_last_row;
 
   if (m_config->seperate_write_queue_enabled) {
     if (m_mode == READ_MODE &&
@@ -130,31 +316,25 @@ dram_req_t *frfcfs_scheduler::schedule(unsigned bank, unsigned curr_row) {
   }
 
   if (m_mode == WRITE_MODE) {
-    m_current_queue = m_write_queue;
-    m_current_bins = m_write_bins;
-    m_current_last_row = m_last_write_row;
+    m_current_queue = &m_write_queue;
+    m_current_last_row = &m_last_write_row;
   }
 
-  if (m_current_last_row[bank] == NULL) {
-    if (m_current_queue[bank].empty()) return NULL;
-
-    std::map<unsigned, std::list<std::list<dram_req_t *>::iterator> >::iterator
-        bin_ptr = m_current_bins[bank].find(curr_row);
-    if (bin_ptr == m_current_bins[bank].end()) {
-      dram_req_t *req = m_current_queue[bank].back();
-      bin_ptr = m_current_bins[bank].find(req->row);
-      assert(bin_ptr !=
-             m_current_bins[bank].end());  // where did the request go???
-      m_current_last_row[bank] = &(bin_ptr->second);
-      data_collection(bank);
-      rowhit = false;
-    } else {
-      m_current_last_row[bank] = &(bin_ptr->second);
-      rowhit = true;
-    }
+  frfcfs_bank_queue &queue = (*m_current_queue)[bank];
+  unsigned &last_row = (*m_current_last_row)[bank];
+  if (queue.empty()) return NULL;
+
+  unsigned long long now =
+      m_dram->m_gpu->gpu_sim_cycle + m_dram->m_gpu->gpu_tot_sim_cycle;
+  unsigned open_row = last_row != (unsigned)-1 ? last_row : curr_row;
+  unsigned row = m_policy->pick_row(queue, open_row, now);
+  if (row != open_row) {
+    data_collection(bank);
+    rowhit = false;
   }
-  std::list<dram_req_t *>::iterator next = m_current_last_row[bank]->back();
-  dram_req_t *req = (*next);
+  dram_req_t *req = queue.pop_row(row);
+  last_row = queue.has_row(row) ? row : (unsigned)-1;
+  m_policy->served(req);
 
   // rowblp stats
   m_dram->access_num++;
@@ -174,13 +354,8 @@ dram_req_t *frfcfs_scheduler::schedule(unsigned bank, unsigned curr_row) {
 
   m_stats->concurrent_row_access[m_dram->id][bank]++;
   m_stats->row_access[m_dram->id][bank]++;
-  m_current_last_row[bank]->pop_back();
-
-  m_current_queue[bank].erase(next);
-  if (m_current_last_row[bank]->empty()) {
-    m_current_bins[bank].erase(req->row);
-    m_current_last_row[bank] = NULL;
-  }
+  m_dram->record_class_access(req->data->is_graphics(), rowhit, req->nbytes,
+                              now - req->timestamp);
 #ifdef DEBUG_FAST_IDEAL_SCHED
   if (req)
     printf("%08u : DRAM(%u) scheduling memory request to bank=%u, row=%u\n",
@@ -200,7 +375,7 @@ dram_req_t *frfcfs_scheduler::schedule(unsigned bank, unsigned curr_row) {
 
 void frfcfs_scheduler::print(FILE *fp) {
   for (unsigned b = 0; b < m_config->nbk; b++) {
-    printf(" %u: queue length = %u\n", b, (unsigned)m_queue[b].size());
+    printf(" %u: queue length = %u\n", b, m_queue[b].size());
   }
 }
 
@@ -213,13 +388,7 @@ void dram_t::scheduler_frfcfs() {
     // Power stats
     // if(req->data->get_type() != READ_REPLY && req->data->get_type() !=
     // WRITE_ACK)
-    m_stats->total_n_access++;
-
-    if (req->data->get_type() == WRITE_REQUEST) {
-      m_stats->total_n_writes++;
-    } else if (req->data->get_type() == READ_REQUEST) {
-      m_stats->total_n_reads++;
-    }
+    if (!background(req->data)) count_request(req->data);
 
     req->data->set_status(IN_PARTITION_MC_INPUT_QUEUE,
                           m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
@@ -227,32 +396,27 @@ void dram_t::scheduler_frfcfs() {
   }
 
   dram_req_t *req;
-  unsigned i;
-  for (i = 0; i < m_config->nbk; i++) {
-    unsigned b = (i + prio) % m_config->nbk;
-    if (!bk[b]->mrq) {
-      req = sched->schedule(b, bk[b]->curr_row);
-
-      if (req) {
-        req->data->set_status(IN_PARTITION_MC_BANK_ARB_QUEUE,
-                              m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
-        prio = (prio + 1) % m_config->nbk;
-        bk[b]->mrq = req;
-        if (m_config->gpgpu_memlatency_stat) {
-          mrq_latency = m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle -
-                        bk[b]->mrq->timestamp;
-          m_stats->tot_mrq_latency += mrq_latency;
-          m_stats->tot_mrq_num++;
-          bk[b]->mrq->timestamp =
-              m_gpu->gpu_tot_sim_cycle + m_gpu->gpu_sim_cycle;
-          m_stats->mrq_lat_table[LOGB2(mrq_latency)]++;
-          if (mrq_latency > m_stats->max_mrq_latency) {
-            m_stats->max_mrq_latency = mrq_latency;
-          }
-        }
-
-        break;
+  // the banks without an mrq, in the (i + prio) % nbk order
+  for (unsigned long long free = m_all_banks & ~m_pending_banks; free;) {
+    unsigned b = first_bank(free, prio);
+    free &= ~(1ULL << b);
+    req = sched->schedule(b, bk[b]->curr_row);
+
+    if (req) {
+      req->data->set_status(IN_PARTITION_MC_BANK_ARB_QUEUE,
+                            m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+      prio = (prio + 1) % m_config->nbk;
+      bk[b]->mrq = req;
+      bank_changed(b);
+      if (m_config->gpgpu_memlatency_stat && !background(req->data)) {
+        mrq_latency = m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle -
+                      bk[b]->mrq->timestamp;
+        bk[b]->mrq->timestamp =
+            m_gpu->gpu_tot_sim_cycle + m_gpu->gpu_sim_cycle;
+        record_mrq_latency(mrq_latency);
       }
+
+      break;
     }
   }
 }
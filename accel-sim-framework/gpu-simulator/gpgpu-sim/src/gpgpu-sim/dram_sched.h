@@ -29,8 +29,7 @@
 #ifndef dram_sched_h_INCLUDED
 #define dram_sched_h_INCLUDED
 
-#include <list>
-#include <map>
+#include <vector>
 #include "dram.h"
 #include "gpu-misc.h"
 #include "gpu-sim.h"
@@ -38,10 +37,136 @@
 
 enum memory_mode { READ_MODE = 0, WRITE_MODE };
 
+// pending requests of one bank, in arrival order and binned by row. Both
+// orders are intrusive lists through dram_req_t and the row bins live in an
+// open-addressed table, so adding or scheduling a request allocates nothing
+class frfcfs_bank_queue {
+ public:
+  frfcfs_bank_queue();
+
+  bool empty() const { return m_oldest == NULL; }
+  unsigned size() const { return m_size; }
+  dram_req_t *oldest() const { return m_oldest; }
+  bool has_row(unsigned row) const { return find(row) != (unsigned)-1; }
+  // oldest pending request to row, NULL for none
+  dram_req_t *row_oldest(unsigned row) const {
+    unsigned slot = find(row);
+    return slot == (unsigned)-1 ? NULL : m_bins[slot].oldest;
+  }
+
+  void push(dram_req_t *req);
+  // removes and returns the oldest request to row, which must be pending
+  dram_req_t *pop_row(unsigned row);
+
+ private:
+  struct row_bin {
+    unsigned row;
+    dram_req_t *oldest;  // NULL = free slot
+    dram_req_t *newest;
+  };
+
+  unsigned slot_of(unsigned row) const {
+    unsigned h = row * 2654435761u;
+    return (h ^ (h >> 16)) & (m_bins.size() - 1);
+  }
+  unsigned find(unsigned row) const;
+  void erase_bin(unsigned slot);
+  void grow();
+
+  dram_req_t *m_oldest;
+  dram_req_t *m_newest;
+  unsigned m_size;
+  std::vector<row_bin> m_bins;  // power of two slots
+  unsigned m_num_bins;
+};
+
+// Which row a bank of the FR-FCFS scheduler serves next. The scheduler
+// serves the oldest request of the row picked, a bank keeps its open row for
+// as long as the policy picks it. Graphics and compute requests share the
+// banks, so a policy that favours row hits alone lets a streaming class hold
+// a bank against the other; the other policies trade some row hits for
+// fairness between the classes or the tenants
+class dram_sched_policy {
+ public:
+  virtual ~dram_sched_policy() {}
+
+  // "frfcfs", "priority", "bliss" or "atlas", NULL for an unknown name
+  static dram_sched_policy *create(const char *name,
+                                   const memory_config *config);
+
+  // queue is not empty, open_row is the row the bank has open or -1
+  virtual unsigned pick_row(const frfcfs_bank_queue &queue, unsigned open_row,
+                            unsigned long long now) = 0;
+  // req left the queue of its bank
+  virtual void served(const dram_req_t *req) {}
+};
+
+// row hits first, then the oldest request
+class frfcfs_sched_policy : public dram_sched_policy {
+ public:
+  unsigned pick_row(const frfcfs_bank_queue &queue, unsigned open_row,
+                    unsigned long long now);
+};
+
+// FR-FCFS within a class, the requests of the class named by
+// -dram_sched_graphics_first before any of the other
+class priority_sched_policy : public dram_sched_policy {
+ public:
+  explicit priority_sched_policy(bool graphics_first)
+      : m_graphics_first(graphics_first) {}
+  unsigned pick_row(const frfcfs_bank_queue &queue, unsigned open_row,
+                    unsigned long long now);
+
+ private:
+  bool m_graphics_first;
+};
+
+// BLISS: a tenant the channel has served threshold requests of in a row is
+// blacklisted until the next clear, every clear_period cycles. Requests of
+// tenants off the blacklist go first, FR-FCFS among each group
+class bliss_sched_policy : public dram_sched_policy {
+ public:
+  bliss_sched_policy(unsigned threshold, unsigned clear_period);
+  unsigned pick_row(const frfcfs_bank_queue &queue, unsigned open_row,
+                    unsigned long long now);
+  void served(const dram_req_t *req);
+
+ private:
+  unsigned m_threshold;
+  unsigned m_clear_period;
+  unsigned long long m_next_clear;
+  unsigned m_last_tenant;
+  unsigned m_streak;
+  bool m_blacklisted[MAX_TENANTS];
+};
+
+// ATLAS within one channel: at the end of every quantum the tenants are
+// ranked by the bytes the channel served them, decayed over the past quanta,
+// the least served first. A request that waited age cycles goes first, then
+// the highest ranked tenant with a request, row hits first within it
+class atlas_sched_policy : public dram_sched_policy {
+ public:
+  atlas_sched_policy(unsigned quantum, unsigned age);
+  unsigned pick_row(const frfcfs_bank_queue &queue, unsigned open_row,
+                    unsigned long long now);
+  void served(const dram_req_t *req);
+
+ private:
+  void rank(unsigned long long now);
+
+  unsigned m_quantum;
+  unsigned m_age;
+  unsigned long long m_next_quantum;
+  unsigned long long m_attained[MAX_TENANTS];  // this quantum
+  double m_history[MAX_TENANTS];
+  unsigned m_rank[MAX_TENANTS];  // 0 = first
+};
+
 class frfcfs_scheduler {
  public:
   frfcfs_scheduler(const memory_config *config, dram_t *dm,
                    memory_stats_t *stats);
+  ~frfcfs_scheduler() { delete m_policy; }
   void add_req(dram_req_t *req);
   void data_collection(unsigned bank);
   dram_req_t *schedule(unsigned bank, unsigned curr_row);
@@ -54,20 +179,19 @@ class frfcfs_scheduler {
   dram_t *m_dram;
   unsigned m_num_pending;
   unsigned m_num_write_pending;
-  std::list<dram_req_t *> *m_queue;
-  std::map<unsigned, std::list<std::list<dram_req_t *>::iterator> > *m_bins;
-  std::list<std::list<dram_req_t *>::iterator> **m_last_row;
+  std::vector<frfcfs_bank_queue> m_queue;
+  // row each bank keeps serving until its bin drains, -1 = none
+  std::vector<unsigned> m_last_row;
   unsigned *curr_row_service_time;  // one set of variables for each bank.
   unsigned *row_service_timestamp;  // tracks when scheduler began servicing
                                     // current row
 
-  std::list<dram_req_t *> *m_write_queue;
-  std::map<unsigned, std::list<std::list<dram_req_t *>::iterator> >
-      *m_write_bins;
-  std::list<std::list<dram_req_t *>::iterator> **m_last_write_row;
+  std::vector<frfcfs_bank_queue> m_write_queue;
+  std::vector<unsigned> m_last_write_row;
 
   enum memory_mode m_mode;
   memory_stats_t *m_stats;
+  dram_sched_policy *m_policy;
 };
 
 #endif
@@ -0,0 +1,157 @@
+// Background DRAM traffic of the other clients of a shared memory, see
+// dram_traffic.h
+
+#include "dram_traffic.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "gpu-sim.h"
+#include "mem_fetch.h"
+
+bool dram_traffic::enabled(const memory_config *config) {
+  return config->dram_traffic_rate > 0 || config->dram_traffic_trace[0];
+}
+
+dram_traffic::dram_traffic(unsigned partition_id, const memory_config *config)
+    : m_id(partition_id), m_config(config) {
+  m_reads = 0;
+  m_writes = 0;
+  m_dropped = 0;
+  m_latency = 0;
+  m_retired = 0;
+  m_max_latency = 0;
+  m_base = 0;
+  m_size = 0;
+  if (sscanf(config->dram_traffic_region, "%llx:%llx", &m_base, &m_size) !=
+          2 ||
+      m_size < config->dram_traffic_size || !config->dram_traffic_size) {
+    printf("GPGPU-Sim: -gpgpu_dram_traffic_region %s is not a base:size "
+           "region of at least one -gpgpu_dram_traffic_size request\n",
+           config->dram_traffic_region);
+    exit(1);
+  }
+  m_stream = !strcmp(config->dram_traffic_pattern, "stream");
+  if (!m_stream && strcmp(config->dram_traffic_pattern, "random")) {
+    printf("GPGPU-Sim: unknown -gpgpu_dram_traffic_pattern %s\n",
+           config->dram_traffic_pattern);
+    exit(1);
+  }
+  m_cursor = 0;
+  // a stream of its own per channel, the same in every run
+  m_state = (partition_id + 1) * 0x9e3779b97f4a7c15ULL;
+  m_dram_cycle = 0;
+
+  m_trace = NULL;
+  m_next_valid = false;
+  if (config->dram_traffic_trace[0]) {
+    m_trace = fopen(config->dram_traffic_trace, "r");
+    if (!m_trace) {
+      printf("GPGPU-Sim: cannot open -gpgpu_dram_traffic_trace %s\n",
+             config->dram_traffic_trace);
+      exit(1);
+    }
+    m_next_valid = read_trace();
+  }
+}
+
+dram_traffic::~dram_traffic() {
+  if (m_trace) fclose(m_trace);
+  for (unsigned i = 0; i < m_queue.size(); i++) delete m_queue[i];
+}
+
+unsigned long long dram_traffic::random() {
+  // xorshift64*
+  m_state ^= m_state >> 12;
+  m_state ^= m_state << 25;
+  m_state ^= m_state >> 27;
+  return m_state * 0x2545f4914f6cdd1dULL;
+}
+
+bool dram_traffic::local(new_addr_type &offset) const {
+  const linear_to_raw_address_translation &mapping =
+      m_config->m_address_mapping;
+  new_addr_type size = m_config->dram_traffic_size;
+  for (unsigned i = 0; i < 64 * m_config->m_n_mem; i++) {
+    if (offset + size > m_size) offset = 0;
+    addrdec_t tlx;
+    mapping.addrdec_tlx(m_base + offset, &tlx);
+    if (tlx.chip == m_id) return true;
+    // the rest of the block maps to the same chip
+    new_addr_type end = mapping.sub_partition_run_end(m_base + offset) - m_base;
+    offset = (end + size - 1) / size * size;
+  }
+  return false;
+}
+
+void dram_traffic::arrive(new_addr_type addr, bool write,
+                          unsigned long long cycle) {
+  if (m_inflight.size() >= m_config->dram_traffic_inflight) {
+    m_dropped++;
+    return;
+  }
+  mem_access_t access(write ? GLOBAL_ACC_W : GLOBAL_ACC_R, addr,
+                      m_config->dram_traffic_size, write,
+                      m_config->gpgpu_ctx);
+  mem_fetch *mf =
+      new mem_fetch(access, NULL, write ? WRITE_PACKET_SIZE : READ_PACKET_SIZE,
+                    -1, -1, -1, m_config, cycle, 0);
+  m_queue.push_back(mf);
+  m_inflight.insert(mf);
+  if (write)
+    m_writes++;
+  else
+    m_reads++;
+}
+
+bool dram_traffic::read_trace() {
+  char rw;
+  while (fscanf(m_trace, "%llu %llx %c", &m_next_cycle, &m_next_addr, &rw) ==
+         3) {
+    addrdec_t tlx;
+    m_config->m_address_mapping.addrdec_tlx(m_next_addr, &tlx);
+    if (tlx.chip != m_id) continue;
+    m_next_write = rw == 'W' || rw == 'w';
+    return true;
+  }
+  return false;
+}
+
+void dram_traffic::cycle(unsigned long long cycle) {
+  unsigned long long dram_cycle = m_dram_cycle++;
+  if (m_trace) {
+    while (m_next_valid && m_next_cycle <= dram_cycle &&
+           m_inflight.size() < m_config->dram_traffic_inflight) {
+      arrive(m_next_addr, m_next_write, cycle);
+      m_next_valid = read_trace();
+    }
+    return;
+  }
+
+  unsigned burst = std::max(m_config->dram_traffic_burst, 1u);
+  double bursts = m_config->dram_traffic_rate / burst;
+  unsigned n = (unsigned)bursts;
+  if (uniform() < bursts - n) n++;
+  new_addr_type size = m_config->dram_traffic_size;
+  for (unsigned b = 0; b < n; b++) {
+    new_addr_type offset =
+        m_stream ? m_cursor : random() % (m_size / size) * size;
+    for (unsigned r = 0; r < burst; r++) {
+      if (!local(offset)) return;
+      arrive(m_base + offset, uniform() < m_config->dram_traffic_writes,
+             cycle);
+      offset += size;
+    }
+    if (m_stream) m_cursor = offset;
+  }
+}
+
+void dram_traffic::retire(mem_fetch *mf, unsigned long long cycle) {
+  unsigned latency = (unsigned)cycle - mf->get_timestamp();
+  m_latency += latency;
+  m_retired++;
+  if (latency > m_max_latency) m_max_latency = latency;
+  m_inflight.erase(mf);
+  delete mf;
+}
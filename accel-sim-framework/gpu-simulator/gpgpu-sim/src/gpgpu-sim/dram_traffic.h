@@ -0,0 +1,94 @@
+// Background DRAM traffic of the other clients of a shared memory
+//
+// On an SoC the CPU cores, ISP and DLA share the DRAM with the GPU. With
+// -gpgpu_dram_traffic_rate above 0 every memory partition gets an injector
+// of such requests: each DRAM cycle a burst of -gpgpu_dram_traffic_burst
+// requests of -gpgpu_dram_traffic_size bytes arrives with probability
+// rate / burst, so rate is the mean of requests per DRAM cycle and channel.
+// A request is a write with probability -gpgpu_dram_traffic_writes. The
+// addresses are in the -gpgpu_dram_traffic_region base:size (hex) and among
+// them the ones the address mapping gives the channel: a burst takes the
+// lines following one another from a random start under the random
+// -gpgpu_dram_traffic_pattern, from where the last one stopped under
+// stream. With -gpgpu_dram_traffic_trace the requests are instead those of
+// a file of "<DRAM cycle> <hex address> R|W" lines in cycle order, each
+// arriving in the channel its address maps to at that cycle of it.
+//
+// At most -gpgpu_dram_traffic_inflight requests of a channel are in flight.
+// Synthetic ones arriving beyond that are dropped, as a client with all of
+// its misses outstanding would not issue them, trace ones wait. The
+// requests take turns with the L2 sub partitions for the request the DRAM
+// accepts per cycle, go through -dram_latency and the DRAM scheduler like
+// GPU ones and end at the partition. They are left out of the GPU's DRAM
+// access and latency stats, the latency from arrival to reply is counted
+// here. The injector only runs with the DRAM timing model, not with
+// -gpgpu_simple_dram_model.
+
+#ifndef DRAM_TRAFFIC_H
+#define DRAM_TRAFFIC_H
+
+#include <stdio.h>
+#include <deque>
+#include <unordered_set>
+
+#include "../abstract_hardware_model.h"
+
+class mem_fetch;
+class memory_config;
+
+class dram_traffic {
+ public:
+  dram_traffic(unsigned partition_id, const memory_config *config);
+  ~dram_traffic();
+
+  static bool enabled(const memory_config *config);
+
+  // one DRAM cycle, cycle the GPU cycle the new requests arrive at
+  void cycle(unsigned long long cycle);
+
+  // the next request for the DRAM, NULL when none waits
+  mem_fetch *top() const {
+    return m_queue.empty() ? NULL : m_queue.front();
+  }
+  void pop() { m_queue.pop_front(); }
+  // whether mf is a request of this injector
+  bool owns(const mem_fetch *mf) const { return m_inflight.count(mf) > 0; }
+  // the reply of mf left the DRAM, deletes it
+  void retire(mem_fetch *mf, unsigned long long cycle);
+
+  unsigned long long m_reads;
+  unsigned long long m_writes;
+  unsigned long long m_dropped;
+  unsigned long long m_latency;  // summed over the retired requests
+  unsigned long long m_retired;
+  unsigned long long m_max_latency;
+
+ private:
+  unsigned long long random();
+  double uniform() { return (random() >> 11) * (1.0 / (1ULL << 53)); }
+  // the region offset of the first request of the channel from offset on,
+  // false when none is found within a bounded walk
+  bool local(new_addr_type &offset) const;
+  void arrive(new_addr_type addr, bool write, unsigned long long cycle);
+  bool read_trace();
+
+  unsigned m_id;
+  const memory_config *m_config;
+  new_addr_type m_base;
+  new_addr_type m_size;
+  bool m_stream;
+  new_addr_type m_cursor;  // stream offset in the region
+  unsigned long long m_state;
+  unsigned long long m_dram_cycle;
+
+  FILE *m_trace;
+  bool m_next_valid;
+  unsigned long long m_next_cycle;
+  new_addr_type m_next_addr;
+  bool m_next_write;
+
+  std::deque<mem_fetch *> m_queue;
+  std::unordered_set<const mem_fetch *> m_inflight;
+};
+
+#endif
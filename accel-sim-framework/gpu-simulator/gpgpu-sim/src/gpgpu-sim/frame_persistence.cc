@@ -0,0 +1,54 @@
+// Cache contents kept across frames, see frame_persistence.h
+
+#include "frame_persistence.h"
+
+#include <algorithm>
+
+#include "gpu-sim.h"
+#include "shader.h"
+
+frame_persistence::frame_persistence(gpgpu_sim *gpu) : m_gpu(gpu) {
+  m_mode = 0;
+  m_after_graphics = false;
+  m_kept_bytes = 0;
+  m_overwritten_bytes = 0;
+}
+
+bool frame_persistence::upload(new_addr_type addr, size_t size) {
+  if (!m_mode) return true;
+  new_addr_type end = addr + size;
+  std::map<new_addr_type, size_t>::iterator u = m_uploads.upper_bound(addr);
+  if (u != m_uploads.begin()) {
+    std::map<new_addr_type, size_t>::iterator prev = u;
+    prev--;
+    if (prev->first + prev->second >= end) {
+      m_kept_bytes += size;
+      return false;
+    }
+    if (prev->first + prev->second > addr) u = prev;
+  }
+  // the copy overwrites the overlapped bytes, the rest of those uploads
+  // stays where it is
+  while (u != m_uploads.end() && u->first < end) {
+    new_addr_type start = u->first;
+    new_addr_type stop = start + u->second;
+    new_addr_type from = std::max(start, addr);
+    new_addr_type to = std::min(stop, end);
+    invalidate(from, to - from);
+    m_uploads.erase(u++);
+    if (start < addr) m_uploads[start] = addr - start;
+    if (stop > end) m_uploads[end] = stop - end;
+  }
+  m_uploads[addr] = size;
+  return true;
+}
+
+void frame_persistence::invalidate(new_addr_type addr, size_t size) {
+  m_gpu->invalidate_l2_range(addr, size, true);
+  if (m_mode > 1) {
+    const shader_core_config *config = m_gpu->getShaderCoreConfig();
+    for (unsigned i = 0; i < config->n_simt_clusters; i++)
+      m_gpu->getSIMTCluster(i)->cache_invalidate_range(addr, size);
+  }
+  m_overwritten_bytes += size;
+}
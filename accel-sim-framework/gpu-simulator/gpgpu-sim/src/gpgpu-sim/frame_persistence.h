@@ -0,0 +1,57 @@
+// Cache contents kept across the frames of a multi-frame run
+//
+// Without it a relaunched frame finds a cold hierarchy: -gpgpu_flush_l2_cache
+// and -gpgpu_flush_l1_cache flush the caches once the last kernel drains,
+// -gpgpu_invalidate_l2 drops the slices of every retired CTA and the vertex
+// buffers are copied into L2 again for every draw. With
+// -gpgpu_frame_persistence 1 the L2 is not flushed at the idle points after
+// a graphics kernel, which include every frame boundary, and the vertex
+// buffer copies go through upload: a range inside one uploaded before holds
+// the same static data and is not copied again, one that only overlaps
+// uploaded ranges overwrites them, so their overlapped bytes are
+// invalidated before the copy. Retired CTAs leave their slices in L2. With
+// 2 the L1D invalidations at those idle points also keep the clean graphics
+// texture lines, and the overwritten bytes are dropped from the L1Ds too.
+// The idle points after a compute kernel flush as configured.
+
+#ifndef FRAME_PERSISTENCE_H
+#define FRAME_PERSISTENCE_H
+
+#include <stddef.h>
+#include <map>
+
+#include "../abstract_hardware_model.h"
+
+class gpgpu_sim;
+
+class frame_persistence {
+ public:
+  explicit frame_persistence(gpgpu_sim *gpu);
+
+  void configure(unsigned mode) { m_mode = mode; }
+  bool enabled() const { return m_mode > 0; }
+
+  // the kernel that finished last was a graphics one
+  void kernel_done(bool graphics) { m_after_graphics = graphics; }
+  // whether the idle point now keeps the L2, and the L1D texture lines
+  bool keep_l2() const { return m_mode && m_after_graphics; }
+  bool keep_l1_texture() const { return m_mode > 1 && m_after_graphics; }
+
+  // a copy of [addr, addr + size) into L2, false when it is already there
+  bool upload(new_addr_type addr, size_t size);
+
+  // bytes not copied again and bytes invalidated as overwritten so far
+  unsigned long long m_kept_bytes;
+  unsigned long long m_overwritten_bytes;
+
+ private:
+  void invalidate(new_addr_type addr, size_t size);
+
+  gpgpu_sim *m_gpu;
+  unsigned m_mode;
+  bool m_after_graphics;
+  // start to size of the uploaded ranges, disjoint
+  std::map<new_addr_type, size_t> m_uploads;
+};
+
+#endif
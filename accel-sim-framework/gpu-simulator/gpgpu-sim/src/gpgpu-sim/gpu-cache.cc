@@ -32,8 +32,11 @@
 
 #include "gpu-cache.h"
 #include <assert.h>
+#include "core_stage_log.h"
 #include "gpu-sim.h"
 #include "hashing.h"
+#include "l2_partition.h"
+#include "rrip_policy.h"
 #include "stat-tool.h"
 
 // used to allocate memory that is large enough to adapt the changes in cache
@@ -173,11 +176,13 @@ tag_array::~tag_array() {
   unsigned cache_lines_num = m_config.get_max_num_lines();
   for (unsigned i = 0; i < cache_lines_num; ++i) delete m_lines[i];
   delete[] m_lines;
+  delete m_umon;
+  delete m_rrip;
 }
 
 tag_array::tag_array(cache_config &config, int core_id, int type_id,
                      cache_block_t **new_lines, gpgpu_sim *gpu)
-    : m_config(config), m_lines(new_lines), m_gpu(gpu) {
+    : m_config(config), m_lines(new_lines), m_gpu(gpu), m_umon(NULL) {
   init(core_id, type_id);
 }
 
@@ -186,7 +191,7 @@ void tag_array::update_cache_parameters(cache_config &config) {
 }
 
 tag_array::tag_array(cache_config &config, int core_id, int type_id, gpgpu_sim *gpu)
-    : m_config(config) {
+    : m_config(config), m_umon(NULL) {
   // assert( m_config.m_write_policy == READ_ONLY ); Old assert
   unsigned cache_lines_num = config.get_max_num_lines();
   m_lines = new cache_block_t *[cache_lines_num];
@@ -219,6 +224,117 @@ void tag_array::init(int core_id, int type_id) {
   m_type_id = type_id;
   is_used = false;
   m_dirty = 0;
+  m_graphics_way_mask = 0;
+  m_class_ways = false;
+  for (unsigned t = 0; t < MAX_TENANTS; t++) m_tenant_way_mask[t] = ~0ULL;
+  unsigned cache_lines_num = m_config.get_max_num_lines();
+  m_rrip = rrip_policy::is_rrip(m_config.m_replacement_policy)
+               ? new rrip_policy(m_config.m_replacement_policy, cache_lines_num)
+               : NULL;
+  m_line_tag.resize(cache_lines_num);
+  m_line_bits.resize(cache_lines_num);
+  m_line_access_time.resize(cache_lines_num);
+  m_line_alloc_time.resize(cache_lines_num);
+  for (unsigned i = 0; i < cache_lines_num; ++i) sync_line(i);
+}
+
+void tag_array::sync_line(unsigned idx) {
+  cache_block_t *line = m_lines[idx];
+  unsigned char bits = 0;
+  if (line->is_valid_line()) bits |= LINE_VALID;
+  if (line->is_invalid_line()) bits |= LINE_INVALID;
+  if (line->is_reserved_line()) bits |= LINE_RESERVED;
+  if (line->is_graphics()) bits |= LINE_GRAPHICS;
+  if (line->is_tex()) bits |= LINE_TEX;
+  m_line_tag[idx] = line->m_tag;
+  m_line_bits[idx] = bits;
+  m_line_access_time[idx] = line->get_last_access_time();
+  m_line_alloc_time[idx] = line->get_alloc_time();
+}
+
+void tag_array::sync_stale_lines() {
+  for (unsigned i = 0; i < m_stale_lines.size(); i++)
+    sync_line(m_stale_lines[i]);
+  m_stale_lines.clear();
+}
+
+void tag_array::enable_utility_monitor(unsigned sampled_sets) {
+  delete m_umon;
+  m_umon = new utility_monitor(m_config.m_nset, m_config.m_assoc, sampled_sets);
+}
+
+void tag_array::get_utility(std::vector<unsigned> &utility_gr,
+                            std::vector<unsigned> &utility_cp) const {
+  if (m_umon) {
+    utility_gr = m_umon->get_utility(true);
+    utility_cp = m_umon->get_utility(false);
+  } else {
+    utility_gr = utility_counter_gr;
+    utility_cp = utility_counter_cp;
+  }
+}
+
+void tag_array::decay_utility() {
+  if (m_umon) m_umon->decay();
+}
+
+void tag_array::set_graphics_ways(unsigned ways) {
+  assert(m_config.m_assoc <= 64 && ways <= m_config.m_assoc);
+  m_graphics_way_mask = ways == 64 ? ~0ULL : (1ULL << ways) - 1;
+}
+
+void tag_array::set_class_ways(unsigned ways) {
+  assert(m_config.m_assoc <= 64 && ways < m_config.m_assoc);
+  m_class_ways = true;
+  m_graphics_way_mask = ways ? (1ULL << ways) - 1 : 0;
+  if (!is_used || !m_graphics_way_mask) return;
+  sync_stale_lines();
+  for (unsigned idx = 0; idx < m_config.get_num_lines(); idx++) {
+    unsigned char bits = m_line_bits[idx];
+    bool graphics_way = (m_graphics_way_mask >> idx % m_config.m_assoc) & 1;
+    if (!(bits & LINE_VALID) || (bits & LINE_RESERVED) ||
+        (bool)(bits & LINE_GRAPHICS) == graphics_way)
+      continue;
+    cache_block_t *line = m_lines[idx];
+    if (line->is_modified_line() && m_dirty) m_dirty--;
+    for (unsigned sector = 0; sector < SECTOR_CHUNCK_SIZE; sector++) {
+      if (line->is_valid_line()) {
+        if (!line->is_graphics())
+          m_cache_breakdown[2]--;
+        else
+          m_cache_breakdown[line->is_tex() ? 0 : 1]--;
+      }
+      line->set_status(INVALID, mem_access_sector_mask_t().set(sector));
+    }
+    sync_line(idx);
+  }
+}
+
+void tag_array::set_tenant_ways(const unsigned ways[], unsigned tenants) {
+  assert(m_config.m_assoc <= 64 && tenants <= MAX_TENANTS);
+  unsigned first = 0;
+  for (unsigned t = 0; t < tenants; t++) {
+    assert(ways[t] && first + ways[t] <= m_config.m_assoc);
+    unsigned long long mask =
+        ways[t] == 64 ? ~0ULL : (1ULL << ways[t]) - 1;
+    m_tenant_way_mask[t] = mask << first;
+    first += ways[t];
+  }
+}
+
+void tag_array::add_breakdown(std::vector<unsigned> &breakdown) {
+  sync_stale_lines();
+  for (unsigned idx = 0; idx < m_config.m_nset * m_config.m_assoc; idx++) {
+    unsigned char bits = m_line_bits[idx];
+    if (!(bits & LINE_VALID))
+      breakdown[3]++;  // invalid
+    else if (!(bits & LINE_GRAPHICS))
+      breakdown[2]++;  // compute
+    else if (bits & LINE_TEX)
+      breakdown[0]++;
+    else
+      breakdown[1]++;  // vertices
+  }
 }
 
 void tag_array::add_pending_line(mem_fetch *mf) {
@@ -226,7 +342,7 @@ void tag_array::add_pending_line(mem_fetch *mf) {
   new_addr_type addr = m_config.block_addr(mf->get_addr());
   line_table::const_iterator i = pending_lines.find(addr);
   if (i == pending_lines.end()) {
-    pending_lines[addr] = mf->get_inst().get_uid();
+    pending_lines[addr] = mf->get_inst_uid();
   }
 }
 
@@ -239,6 +355,19 @@ void tag_array::remove_pending_line(mem_fetch *mf) {
   }
 }
 
+unsigned tag_array::recency_rank(unsigned set_index, unsigned way) const {
+  unsigned first = set_index * m_config.m_assoc;
+  const unsigned char *bits = &m_line_bits[first];
+  const unsigned long long *access_time = &m_line_access_time[first];
+  unsigned long long time = (bits[way] & LINE_VALID) ? access_time[way] : 0;
+  unsigned rank = 0;
+  for (unsigned w = 0; w < m_config.m_assoc; w++) {
+    unsigned long long t = (bits[w] & LINE_VALID) ? access_time[w] : 0;
+    if (t > time || (t == time && w < way)) rank++;
+  }
+  return rank;
+}
+
 enum cache_request_status tag_array::probe(new_addr_type addr, unsigned &idx,
                                            mem_fetch *mf, bool is_write,
                                            bool probe_mode) {
@@ -254,50 +383,48 @@ enum cache_request_status tag_array::probe(new_addr_type addr, unsigned &idx,
   // assert( m_config.m_write_policy == READ_ONLY );
   unsigned set_index = m_config.set_index(addr);
   new_addr_type tag = m_config.tag(addr);
+  sync_stale_lines();
+  unsigned first = set_index * m_config.m_assoc;
+  const new_addr_type *tags = &m_line_tag[first];
+  const unsigned char *bits = &m_line_bits[first];
+  const unsigned char *rrpv = m_rrip ? m_rrip->rrpv() : NULL;
 
   unsigned invalid_line = (unsigned)-1;
   unsigned valid_line = (unsigned)-1;
   unsigned valid_vertex = (unsigned)-1;
   unsigned long long valid_timestamp = (unsigned)-1;
-  std::map<unsigned, unsigned long long> valid_timestamps;
+  int valid_rrpv = -1;
+
+  // graphics and compute split the cache while both run
+  bool both_run = !(m_gpu->all_compute_done || !m_gpu->start_compute);
+  bool partitioned = m_config.m_graphics_percent != 0 && both_run &&
+                     m_gpu->get_config().gpgpu_utility;
+  bool way_partition =
+      (partitioned || (m_class_ways && both_run)) && m_graphics_way_mask;
+  bool share_partition =
+      partitioned && !m_graphics_way_mask && m_gpu->l2_utility_ratio != -1;
+
+  // requests without an instruction take their class's default tenant
+  unsigned long long tenant_ways =
+      m_tenant_way_mask[mf ? mf->get_tenant() : !is_graphics];
 
   bool all_reserved = true;
   unsigned tex_lines = 0;
   unsigned vertex_lines = 0;
   unsigned valid = 0;
-  for (unsigned way = 0; way < m_config.m_assoc; way++) {
-    unsigned index = set_index * m_config.m_assoc + way;
-    cache_block_t *line = m_lines[index];
-    if (line->is_valid_line()) {
+  for (unsigned way = 0; way < m_config.m_assoc && share_partition; way++) {
+    if (bits[way] & LINE_VALID) {
       valid++;
-      if (line->is_graphics()) {
-        if (line->is_tex()) {
+      if (bits[way] & LINE_GRAPHICS) {
+        if (bits[way] & LINE_TEX) {
           tex_lines++;
         } else {
           vertex_lines++;
         }
       }
     }
-
-    if (line->is_valid_line()) {
-      valid_timestamps[way] = line->get_last_access_time();
-    } else {
-      valid_timestamps[way] = 0;
-    }
   }
 
-  // sort map
-  std::vector<std::pair<unsigned, unsigned long long>> sorted_timestamps;
-  for (auto &it : valid_timestamps) {
-    sorted_timestamps.push_back(it);
-  }
-  std::sort(sorted_timestamps.begin(), sorted_timestamps.end(),
-            [](const std::pair<unsigned, unsigned long long> &a,
-               const std::pair<unsigned, unsigned long long> &b) {
-              return a.second > b.second;
-              // return a.second < b.second;
-            });
-
   unsigned compute = valid - tex_lines - vertex_lines;
   unsigned graphics_percent = (unsigned)(100 * tex_lines / m_config.m_assoc);
   unsigned compute_percent = (unsigned)(100 * compute / m_config.m_assoc);
@@ -316,29 +443,23 @@ enum cache_request_status tag_array::probe(new_addr_type addr, unsigned &idx,
   // unsigned graphics_percent = 0;
   // check for hit or pending hit
   for (unsigned way = 0; way < m_config.m_assoc; way++) {
-    unsigned index = set_index * m_config.m_assoc + way;
-    cache_block_t *line = m_lines[index];
-    if (line->m_tag == tag) {
+    unsigned index = first + way;
+    if (tags[way] == tag) {
+      cache_block_t *line = m_lines[index];
       if (line->get_status(mask) == RESERVED) {
         idx = index;
         return HIT_RESERVED;
       } else if (line->get_status(mask) == VALID) {
         idx = index;
-        if (m_gpu->get_config().gpgpu_utility) {
-        for (unsigned i = 0; i < sorted_timestamps.size(); i++) {
-          if (sorted_timestamps[i].first == way) {
-            if (is_graphics) {
-              utility_counter_gr[i]++;
-            } else {
-              utility_counter_cp[i]++;
-            }
-            return HIT;
+        if (m_gpu->get_config().gpgpu_utility && !m_umon) {
+          unsigned rank = recency_rank(set_index, way);
+          if (is_graphics) {
+            utility_counter_gr[rank]++;
+          } else {
+            utility_counter_cp[rank]++;
           }
         }
-        assert(0);
-        } else {
-          return HIT;
-        }
+        return HIT;
       } else if (line->get_status(mask) == MODIFIED) {
         if ((!is_write && line->is_readable(mask)) || is_write) {
           idx = index;
@@ -366,7 +487,7 @@ enum cache_request_status tag_array::probe(new_addr_type addr, unsigned &idx,
         assert(line->get_status(mask) == INVALID);
       }
     }
-    if (!line->is_reserved_line()) {
+    if (!(bits[way] & LINE_RESERVED)) {
       // percentage of dirty lines in the cache
       // number of dirty lines / total lines in the cache
       unsigned dirty_line_percentage =
@@ -378,20 +499,23 @@ enum cache_request_status tag_array::probe(new_addr_type addr, unsigned &idx,
       // reach the limit.
 
       // initially, alow grpahics and compute to evict each other
-      bool eligible = true;
-      if (m_config.m_graphics_percent != 0 && line->is_valid_line() && m_gpu->l2_utility_ratio != -1 && !(m_gpu->all_compute_done || !m_gpu->start_compute) && m_gpu->get_config().gpgpu_utility) {
+      bool eligible = (tenant_ways >> way) & 1;
+      if (eligible && way_partition) {
+        eligible = ((m_graphics_way_mask >> way) & 1) == is_graphics;
+      } else if (eligible && share_partition && (bits[way] & LINE_VALID)) {
         assert(graphics_ratio <= 100);
-        assert(m_gpu->l2_utility_ratio != 0 && m_gpu->l2_utility_ratio != 16);
+        assert(m_gpu->l2_utility_ratio != 0 &&
+               m_gpu->l2_utility_ratio < m_config.m_assoc);
         /*if (!line->is_tex() && line->is_graphics() && line->is_valid_line()) {
           // whatever it is, never evict vertices
           // eligible = false;
         } else */if (is_graphics && (vertex_lines + tex_lines) > m_gpu->l2_utility_ratio) {
           // if graphics, only evict graphics
-          eligible = line->is_graphics();
+          eligible = bits[way] & LINE_GRAPHICS;
         } else if (!is_graphics && compute > (m_config.m_assoc - m_gpu->l2_utility_ratio)) {
           // if compute, only evict compute
-          assert(!mf->is_graphics());
-          eligible = !line->is_graphics();
+          assert(!is_graphics);
+          eligible = !(bits[way] & LINE_GRAPHICS);
         }
       }
 
@@ -400,23 +524,23 @@ enum cache_request_status tag_array::probe(new_addr_type addr, unsigned &idx,
       // eligible = true;
       if (eligible) {
         all_reserved = false;
-        if (line->is_invalid_line()) {
+        if (bits[way] & LINE_INVALID) {
           invalid_line = index;
         } else {
           // valid line : keep track of most appropriate replacement candidate
-          if (m_config.m_replacement_policy == LRU) {
-            if (line->get_last_access_time() < valid_timestamp) {
-              // if (!line->is_tex() && line->is_graphics()) {
-                // valid_timestamp = line->get_last_access_time();
-                // valid_vertex = index;
-              // } else {
-                valid_timestamp = line->get_last_access_time();
-                valid_line = index;
-              // }
+          if (rrpv) {
+            if (rrpv[index] > valid_rrpv) {
+              valid_rrpv = rrpv[index];
+              valid_line = index;
+            }
+          } else if (m_config.m_replacement_policy == LRU) {
+            if (m_line_access_time[index] < valid_timestamp) {
+              valid_timestamp = m_line_access_time[index];
+              valid_line = index;
             }
           } else if (m_config.m_replacement_policy == FIFO) {
-            if (line->get_alloc_time() < valid_timestamp) {
-              valid_timestamp = line->get_alloc_time();
+            if (m_line_alloc_time[index] < valid_timestamp) {
+              valid_timestamp = m_line_alloc_time[index];
               valid_line = index;
             }
           }
@@ -462,18 +586,24 @@ enum cache_request_status tag_array::access(new_addr_type addr, unsigned time,
   is_used = true;
   shader_cache_access_log(m_core_id, m_type_id, 0);  // log accesses to cache
   bool is_graphics = mf->is_graphics();
-  bool is_tex = mf->get_inst().is_tex();
+  bool is_tex = mf->is_tex();
+  if (m_umon && m_gpu->get_config().gpgpu_utility)
+    m_umon->access(m_config.set_index(addr), m_config.tag(addr), is_graphics);
   enum cache_request_status status = probe(addr, idx, mf, mf->is_write(), is_graphics);
   switch (status) {
     case HIT_RESERVED:
       m_pending_hit++;
     case HIT:
       m_lines[idx]->set_last_access_time(time, mf->get_access_sector_mask());
+      if (m_rrip) m_rrip->hit(idx);
       break;
     case MISS:
       m_miss++;
       shader_cache_access_log(m_core_id, m_type_id, 1);  // log cache misses
       if (m_config.m_alloc_policy == ON_MISS) {
+        if (m_rrip)
+          rrip_insert(addr, idx, m_lines[idx]->is_valid_line(), mf,
+                      is_graphics, is_tex);
         if (m_lines[idx]->is_modified_line()) {
           wb = true;
           // m_lines[idx]->set_byte_mask(mf);
@@ -511,6 +641,8 @@ enum cache_request_status tag_array::access(new_addr_type addr, unsigned time,
       assert(m_config.m_cache_type == SECTOR);
       m_sector_miss++;
       shader_cache_access_log(m_core_id, m_type_id, 1);  // log cache misses
+      // the block is reused, only its sector is missing
+      if (m_rrip) m_rrip->hit(idx);
       if (m_config.m_alloc_policy == ON_MISS) {
         bool before = m_lines[idx]->is_modified_line();
         ((sector_cache_block *)m_lines[idx])
@@ -531,18 +663,20 @@ enum cache_request_status tag_array::access(new_addr_type addr, unsigned time,
               status);
       abort();
   }
+  if (status != RESERVATION_FAIL) sync_line(idx);
   return status;
 }
 
 void tag_array::fill(new_addr_type addr, unsigned time, mem_fetch *mf,
                      bool is_write, bool is_graphics, bool is_tex) {
   fill(addr, time, mf->get_access_sector_mask(), mf->get_access_byte_mask(),
-       is_write, is_graphics, is_tex);
+       is_write, is_graphics, is_tex, mf);
 }
 
 void tag_array::fill(new_addr_type addr, unsigned time,
                      mem_access_sector_mask_t mask,
-                     mem_access_byte_mask_t byte_mask, bool is_write, bool is_graphics, bool is_tex) {
+                     mem_access_byte_mask_t byte_mask, bool is_write, bool is_graphics, bool is_tex,
+                     mem_fetch *mf) {
   // assert( m_config.m_alloc_policy == ON_FILL );
   unsigned idx;
   enum cache_request_status status = probe(addr, idx, mask, is_write, is_graphics);
@@ -554,6 +688,9 @@ void tag_array::fill(new_addr_type addr, unsigned time,
   // assert(status==MISS||status==SECTOR_MISS); // MSHR should have prevented
   // redundant memory request
   if (status == MISS) {
+    if (m_rrip)
+      rrip_insert(addr, idx, m_lines[idx]->is_valid_line(), mf, is_graphics,
+                  is_tex);
     if (m_lines[idx]->is_valid_line()) {
       if (m_lines[idx]->is_graphics()) {
         if (m_lines[idx]->is_tex()) {
@@ -601,6 +738,23 @@ void tag_array::fill(new_addr_type addr, unsigned time,
   if (m_lines[idx]->is_modified_line() && !before) {
     m_dirty++;
   }
+  sync_line(idx);
+}
+
+bool tag_array::warm(new_addr_type addr, unsigned time,
+                     mem_access_sector_mask_t mask, bool is_graphics) {
+  unsigned idx;
+  enum cache_request_status status =
+      probe(addr, idx, mask, false, is_graphics);
+  if (status == HIT || status == HIT_RESERVED) {
+    m_lines[idx]->set_last_access_time(time, mask);
+    if (m_rrip) m_rrip->hit(idx);
+    sync_line(idx);
+    return true;
+  }
+  mem_access_byte_mask_t byte_mask;
+  fill(addr, time, mask, byte_mask, false, is_graphics, false);
+  return false;
 }
 
 void tag_array::fill(unsigned index, unsigned time, mem_fetch *mf) {
@@ -626,6 +780,7 @@ void tag_array::fill(unsigned index, unsigned time, mem_fetch *mf) {
   if (m_lines[index]->is_modified_line() && !before) {
     m_dirty++;
   }
+  sync_line(index);
 }
 
 // TODO: we need write back the flushed data to the upper level
@@ -637,6 +792,7 @@ void tag_array::flush() {
       for (unsigned j = 0; j < SECTOR_CHUNCK_SIZE; j++) {
         m_lines[i]->set_status(INVALID, mem_access_sector_mask_t().set(j));
       }
+      sync_line(i);
     }
 
   m_dirty = 0;
@@ -648,9 +804,11 @@ void tag_array::flush() {
 void tag_array::invalidate() {
   if (!is_used) return;
 
-  for (unsigned i = 0; i < m_config.get_num_lines(); i++)
+  for (unsigned i = 0; i < m_config.get_num_lines(); i++) {
     for (unsigned j = 0; j < SECTOR_CHUNCK_SIZE; j++)
       m_lines[i]->set_status(INVALID, mem_access_sector_mask_t().set(j));
+    sync_line(i);
+  }
 
   m_dirty = 0;
   is_used = false;
@@ -658,17 +816,57 @@ void tag_array::invalidate() {
   m_cache_breakdown.resize(4, 0);
 }
 
+void tag_array::invalidate_except_texture() {
+  if (!is_used) return;
+
+  // no kernel writes textures, what a graphics kernel read stays valid
+  sync_stale_lines();
+  for (unsigned idx = 0; idx < m_config.get_num_lines(); idx++) {
+    cache_block_t *line = m_lines[idx];
+    if ((m_line_bits[idx] & (LINE_GRAPHICS | LINE_TEX)) ==
+            (LINE_GRAPHICS | LINE_TEX) &&
+        !line->is_modified_line())
+      continue;
+    if (line->is_modified_line() && m_dirty) m_dirty--;
+    for (unsigned sector = 0; sector < SECTOR_CHUNCK_SIZE; sector++) {
+      if (line->is_valid_line()) {
+        if (!line->is_graphics())
+          m_cache_breakdown[2]--;
+        else
+          m_cache_breakdown[line->is_tex() ? 0 : 1]--;
+      }
+      line->set_status(INVALID, mem_access_sector_mask_t().set(sector));
+    }
+    sync_line(idx);
+  }
+}
+
 void tag_array::invalidate_range(new_addr_type addr, unsigned size) {
   if (!is_used) return;
 
-  assert(size == 32);
-  unsigned sector = addr % 128 / 32;
-  unsigned set_index = m_config.set_index(addr + 32);
-  new_addr_type tag = m_config.tag(addr);
+  // the sectors of every 32B step from addr, one set search per line
+  sync_stale_lines();
+  new_addr_type end = addr + size;
+  while (addr < end) {
+    new_addr_type block = m_config.block_addr(addr);
+    mem_access_sector_mask_t sectors;
+    for (; addr < end && m_config.block_addr(addr) == block; addr += 32)
+      sectors.set(addr % 128 / 32);
+    invalidate_sectors(block, sectors);
+  }
+}
+
+void tag_array::invalidate_sectors(new_addr_type block_addr,
+                                   const mem_access_sector_mask_t &sectors) {
+  unsigned set_index = m_config.set_index(block_addr);
+  new_addr_type tag = m_config.tag(block_addr);
+  unsigned first = set_index * m_config.m_assoc;
   for (unsigned way = 0; way < m_config.m_assoc; way++) {
-    unsigned index = set_index * m_config.m_assoc + way;
+    unsigned index = first + way;
+    if (m_line_tag[index] != tag) continue;
     cache_block_t *line = m_lines[index];
-    if (line->m_tag == tag) {
+    for (unsigned sector = 0; sector < SECTOR_CHUNCK_SIZE; sector++) {
+      if (!sectors.test(sector)) continue;
       if (line->is_valid_line()) {
         if (line->is_graphics()) {
           if (line->is_tex()) {
@@ -681,8 +879,9 @@ void tag_array::invalidate_range(new_addr_type addr, unsigned size) {
         }
       }
       line->set_status(INVALID, mem_access_sector_mask_t().set(sector));
-      break;
     }
+    sync_line(index);
+    break;
   }
 }
 
@@ -712,10 +911,19 @@ void tag_array::print(FILE *stream, unsigned &total_access,
           m_access, m_miss, m_sector_miss, (m_miss + m_sector_miss),
           (float)(m_miss + m_sector_miss) / m_access, m_pending_hit,
           (float)m_pending_hit / m_access);
+  if (m_rrip) m_rrip->print(stream);
   total_misses += (m_miss + m_sector_miss);
   total_access += m_access;
 }
 
+void tag_array::rrip_insert(new_addr_type addr, unsigned idx, bool was_valid,
+                            mem_fetch *mf, bool is_graphics, bool is_tex) {
+  unsigned set_index = m_config.set_index(addr);
+  m_rrip->insert(set_index, m_config.m_nset, set_index * m_config.m_assoc,
+                 m_config.m_assoc, idx, was_valid,
+                 m_rrip->signature(mf, is_graphics, is_tex));
+}
+
 void tag_array::get_stats(unsigned &total_access, unsigned &total_misses,
                           unsigned &total_hit_res,
                           unsigned &total_res_fail) const {
@@ -847,50 +1055,45 @@ void mshr_table::display(FILE *fp) const {
 }
 /***************************************************************** Caches
  * *****************************************************************/
+std::vector<unsigned> cache_stats::s_block_of_uid(1, 0);
+std::vector<bool> cache_stats::s_block_used(1, true);
+
 cache_stats::cache_stats() {
-  m_stats.resize(kernel_inc_count);
-  m_stats_pw.resize(kernel_inc_count);
-  m_fail_stats.resize(kernel_inc_count);
-  for (unsigned i = 0; i < kernel_inc_count; i++) {
-    m_stats[i].resize(NUM_MEM_ACCESS_TYPE);
-    m_stats_pw[i].resize(NUM_MEM_ACCESS_TYPE);
-    m_fail_stats[i].resize(NUM_MEM_ACCESS_TYPE);
-    for (unsigned j = 0; j < NUM_MEM_ACCESS_TYPE; ++j) {
-      m_stats[i][j].resize(NUM_CACHE_REQUEST_STATUS, 0);
-      m_stats_pw[i][j].resize(NUM_CACHE_REQUEST_STATUS, 0);
-      m_fail_stats[i][j].resize(NUM_CACHE_RESERVATION_FAIL_STATUS, 0);
-    }
-  }
+  resize(1);
+  m_retired_pw.resize(STATS_STRIDE, 0);
+  m_shared = false;
   m_cache_port_available_cycles = 0;
   m_cache_data_port_busy_cycles = 0;
   m_cache_fill_port_busy_cycles = 0;
+  m_prefetch_issued = 0;
+  m_prefetch_useful = 0;
+  m_prefetch_late = 0;
+  m_prefetch_misses = 0;
 }
 
 void cache_stats::clear() {
   ///
   /// Zero out all current cache statistics
   ///
-  for (unsigned i = 0; i < m_stats.size(); i++) {
-    for (unsigned j = 0; j < NUM_MEM_ACCESS_TYPE; ++j) {
-      std::fill(m_stats[i][j].begin(), m_stats[i][j].end(), 0);
-      std::fill(m_stats_pw[i][j].begin(), m_stats_pw[i][j].end(), 0);
-      std::fill(m_fail_stats[i][j].begin(), m_fail_stats[i][j].end(), 0);
-    }
-  }
+  std::fill(m_stats.begin(), m_stats.end(), 0);
+  std::fill(m_stats_pw.begin(), m_stats_pw.end(), 0);
+  std::fill(m_fail_stats.begin(), m_fail_stats.end(), 0);
+  std::fill(m_retired_pw.begin(), m_retired_pw.end(), 0);
   m_cache_port_available_cycles = 0;
   m_cache_data_port_busy_cycles = 0;
   m_cache_fill_port_busy_cycles = 0;
+  m_prefetch_issued = 0;
+  m_prefetch_useful = 0;
+  m_prefetch_late = 0;
+  m_prefetch_misses = 0;
 }
 
 void cache_stats::clear_pw() {
   ///
   /// Zero out per-window cache statistics
   ///
-  for (unsigned j = 0; j < m_stats_pw.size(); ++j) {
-    for (unsigned i = 0; i < NUM_MEM_ACCESS_TYPE; ++i) {
-      std::fill(m_stats_pw[j][i].begin(), m_stats_pw[j][i].end(), 0);
-    }
-  }
+  std::fill(m_stats_pw.begin(), m_stats_pw.end(), 0);
+  std::fill(m_retired_pw.begin(), m_retired_pw.end(), 0);
 }
 
 void cache_stats::inc_stats(unsigned kernel_id, int access_type,
@@ -900,7 +1103,12 @@ void cache_stats::inc_stats(unsigned kernel_id, int access_type,
   ///
   if (!check_valid(access_type, access_outcome))
     assert(0 && "Unknown cache access type or access outcome");
-  m_stats[kernel_id][access_type][access_outcome]++;
+  unsigned long long &stat =
+      m_stats[stat_index(kernel_id, access_type, access_outcome)];
+  if (m_shared)
+    core_stage_add(stat, 1ull);
+  else
+    stat++;
 }
 
 void cache_stats::inc_stats_pw(unsigned kernel_id, int access_type,
@@ -910,14 +1118,24 @@ void cache_stats::inc_stats_pw(unsigned kernel_id, int access_type,
   ///
   if (!check_valid(access_type, access_outcome))
     assert(0 && "Unknown cache access type or access outcome");
-  m_stats_pw[kernel_id][access_type][access_outcome]++;
+  unsigned long long &stat =
+      m_stats_pw[stat_index(kernel_id, access_type, access_outcome)];
+  if (m_shared)
+    core_stage_add(stat, 1ull);
+  else
+    stat++;
 }
 
 void cache_stats::inc_fail_stats(unsigned kernel_id, int access_type,
                                  int fail_outcome) {
   if (!check_fail_valid(access_type, fail_outcome))
     assert(0 && "Unknown cache access type or access fail");
-  m_fail_stats[kernel_id][access_type][fail_outcome]++;
+  unsigned long long &stat =
+      m_fail_stats[fail_index(kernel_id, access_type, fail_outcome)];
+  if (m_shared)
+    core_stage_add(stat, 1ull);
+  else
+    stat++;
 }
 
 enum cache_request_status cache_stats::select_stats_status(
@@ -947,12 +1165,12 @@ unsigned long long &cache_stats::operator()(unsigned kernel_id, int access_type,
     if (!check_fail_valid(access_type, access_outcome))
       assert(0 && "Unknown cache access type or fail outcome");
 
-    return m_fail_stats[kernel_id][access_type][access_outcome];
+    return m_fail_stats[fail_index(kernel_id, access_type, access_outcome)];
   } else {
     if (!check_valid(access_type, access_outcome))
       assert(0 && "Unknown cache access type or access outcome");
 
-    return m_stats[kernel_id][access_type][access_outcome];
+    return m_stats[stat_index(kernel_id, access_type, access_outcome)];
   }
 }
 
@@ -966,12 +1184,12 @@ unsigned long long cache_stats::operator()(unsigned kernel_id, int access_type,
     if (!check_fail_valid(access_type, access_outcome))
       assert(0 && "Unknown cache access type or fail outcome");
 
-    return m_fail_stats[kernel_id][access_type][access_outcome];
+    return m_fail_stats[fail_index(kernel_id, access_type, access_outcome)];
   } else {
     if (!check_valid(access_type, access_outcome))
       assert(0 && "Unknown cache access type or access outcome");
 
-    return m_stats[kernel_id][access_type][access_outcome];
+    return m_stats[stat_index(kernel_id, access_type, access_outcome)];
   }
 }
 
@@ -980,27 +1198,22 @@ cache_stats cache_stats::operator+(const cache_stats &cs) {
   /// Overloaded + operator to allow for simple stat accumulation
   ///
   cache_stats ret;
-  assert(m_stats.size() == cs.get_size());
-  ret.expand_cache_stats(m_stats.size());
-  for (unsigned kernel = 0; kernel < m_stats.size(); ++kernel) {
-    for (unsigned type = 0; type < NUM_MEM_ACCESS_TYPE; ++type) {
-      for (unsigned status = 0; status < NUM_CACHE_REQUEST_STATUS; ++status) {
-        ret(kernel, type, status, false) =
-            m_stats[kernel][type][status] + cs(kernel, type, status, false);
-      }
-      for (unsigned status = 0; status < NUM_CACHE_RESERVATION_FAIL_STATUS;
-           ++status) {
-        ret(kernel, type, status, true) =
-            m_fail_stats[kernel][type][status] + cs(kernel, type, status, true);
-      }
-    }
-  }
+  assert(get_size() == cs.get_size());
+  ret.resize(get_size());
+  for (unsigned i = 0; i < m_stats.size(); ++i)
+    ret.m_stats[i] = m_stats[i] + cs.m_stats[i];
+  for (unsigned i = 0; i < m_fail_stats.size(); ++i)
+    ret.m_fail_stats[i] = m_fail_stats[i] + cs.m_fail_stats[i];
   ret.m_cache_port_available_cycles =
       m_cache_port_available_cycles + cs.m_cache_port_available_cycles;
   ret.m_cache_data_port_busy_cycles =
       m_cache_data_port_busy_cycles + cs.m_cache_data_port_busy_cycles;
   ret.m_cache_fill_port_busy_cycles =
       m_cache_fill_port_busy_cycles + cs.m_cache_fill_port_busy_cycles;
+  ret.m_prefetch_issued = m_prefetch_issued + cs.m_prefetch_issued;
+  ret.m_prefetch_useful = m_prefetch_useful + cs.m_prefetch_useful;
+  ret.m_prefetch_late = m_prefetch_late + cs.m_prefetch_late;
+  ret.m_prefetch_misses = m_prefetch_misses + cs.m_prefetch_misses;
   return ret;
 }
 
@@ -1008,24 +1221,21 @@ cache_stats &cache_stats::operator+=(const cache_stats &cs) {
   ///
   /// Overloaded += operator to allow for simple stat accumulation
   ///
-  assert(m_stats.size() == cs.get_size());
-  for (unsigned kernel = 0; kernel < m_stats.size(); ++kernel) {
-    for (unsigned type = 0; type < NUM_MEM_ACCESS_TYPE; ++type) {
-      for (unsigned status = 0; status < NUM_CACHE_REQUEST_STATUS; ++status) {
-        m_stats[kernel][type][status] += cs(kernel, type, status, false);
-      }
-      for (unsigned status = 0; status < NUM_CACHE_REQUEST_STATUS; ++status) {
-        m_stats_pw[kernel][type][status] += cs(kernel, type, status, false);
-      }
-      for (unsigned status = 0; status < NUM_CACHE_RESERVATION_FAIL_STATUS;
-           ++status) {
-        m_fail_stats[kernel][type][status] += cs(kernel, type, status, true);
-      }
-    }
-  }
+  // an accumulator takes on the blocks of the caches added to it
+  if (get_size() < cs.get_size()) resize(cs.get_size());
+  for (unsigned i = 0; i < cs.m_stats.size(); ++i) {
+    m_stats[i] += cs.m_stats[i];
+    m_stats_pw[i] += cs.m_stats[i];
+  }
+  for (unsigned i = 0; i < cs.m_fail_stats.size(); ++i)
+    m_fail_stats[i] += cs.m_fail_stats[i];
   m_cache_port_available_cycles += cs.m_cache_port_available_cycles;
   m_cache_data_port_busy_cycles += cs.m_cache_data_port_busy_cycles;
   m_cache_fill_port_busy_cycles += cs.m_cache_fill_port_busy_cycles;
+  m_prefetch_issued += cs.m_prefetch_issued;
+  m_prefetch_useful += cs.m_prefetch_useful;
+  m_prefetch_late += cs.m_prefetch_late;
+  m_prefetch_misses += cs.m_prefetch_misses;
   return *this;
 }
 
@@ -1045,12 +1255,12 @@ void cache_stats::print_stats(unsigned kernel_id, FILE *fout,
       fprintf(fout, "\t%s[%s][%s] = %llu\n", m_cache_name.c_str(),
               mem_access_type_str((enum mem_access_type)type),
               cache_request_status_str((enum cache_request_status)status),
-              m_stats[kernel_id][type][status]);
+              m_stats[stat_index(kernel_id, type, status)]);
 
       if (status != RESERVATION_FAIL && status != MSHR_HIT)
         // MSHR_HIT is a special type of SECTOR_MISS
         // so its already included in the SECTOR_MISS
-        total_access[type] += m_stats[kernel_id][type][status];
+        total_access[type] += m_stats[stat_index(kernel_id, type, status)];
     }
   }
   for (unsigned type = 0; type < NUM_MEM_ACCESS_TYPE; ++type) {
@@ -1066,16 +1276,30 @@ void cache_stats::print_fail_stats(unsigned kernel_id, FILE *fout,
   std::string m_cache_name = cache_name;
   for (unsigned type = 0; type < NUM_MEM_ACCESS_TYPE; ++type) {
     for (unsigned fail = 0; fail < NUM_CACHE_RESERVATION_FAIL_STATUS; ++fail) {
-      if (m_fail_stats[kernel_id][type][fail] > 0) {
+      if (m_fail_stats[fail_index(kernel_id, type, fail)] > 0) {
         fprintf(fout, "\t%s[%s][%s] = %llu\n", m_cache_name.c_str(),
                 mem_access_type_str((enum mem_access_type)type),
                 cache_fail_status_str((enum cache_reservation_fail_reason)fail),
-                m_fail_stats[kernel_id][type][fail]);
+                m_fail_stats[fail_index(kernel_id, type, fail)]);
       }
     }
   }
 }
 
+void cache_stats::print_prefetch_stats(FILE *fout,
+                                       const char *cache_name) const {
+  if (!m_prefetch_issued) return;
+  fprintf(fout, "%s_prefetch_issued = %llu\n", cache_name, m_prefetch_issued);
+  fprintf(fout, "%s_prefetch_useful = %llu\n", cache_name, m_prefetch_useful);
+  fprintf(fout, "%s_prefetch_late = %llu\n", cache_name, m_prefetch_late);
+  // useful of issued, and of the demand reads that would have missed
+  fprintf(fout, "%s_prefetch_accuracy = %.4f\n", cache_name,
+          (double)m_prefetch_useful / m_prefetch_issued);
+  fprintf(fout, "%s_prefetch_coverage = %.4f\n", cache_name,
+          (double)m_prefetch_useful /
+              std::max(m_prefetch_useful + m_prefetch_misses, 1ull));
+}
+
 void cache_sub_stats::print_port_stats(FILE *fout,
                                        const char *cache_name) const {
   float data_port_util = 0.0f;
@@ -1105,7 +1329,8 @@ unsigned long long cache_stats::get_stats(
     for (unsigned status = 0; status < num_access_status; ++status) {
       if (!check_valid((int)access_type[type], (int)access_status[status]))
         assert(0 && "Unknown cache access type or access outcome");
-      total += m_stats[kernel_id][access_type[type]][access_status[status]];
+      total += m_stats[stat_index(kernel_id, access_type[type],
+                                   access_status[status])];
     }
   }
   return total;
@@ -1123,16 +1348,16 @@ void cache_stats::get_sub_stats(unsigned kernel_id,
     for (unsigned status = 0; status < NUM_CACHE_REQUEST_STATUS; ++status) {
       if (status == HIT || status == MISS || status == SECTOR_MISS ||
           status == HIT_RESERVED)
-        t_css.accesses += m_stats[kernel_id][type][status];
+        t_css.accesses += m_stats[stat_index(kernel_id, type, status)];
 
       if (status == MISS || status == SECTOR_MISS)
-        t_css.misses += m_stats[kernel_id][type][status];
+        t_css.misses += m_stats[stat_index(kernel_id, type, status)];
 
       if (status == HIT_RESERVED)
-        t_css.pending_hits += m_stats[kernel_id][type][status];
+        t_css.pending_hits += m_stats[stat_index(kernel_id, type, status)];
 
       if (status == RESERVATION_FAIL)
-        t_css.res_fails += m_stats[kernel_id][type][status];
+        t_css.res_fails += m_stats[stat_index(kernel_id, type, status)];
     }
   }
 
@@ -1151,46 +1376,51 @@ void cache_stats::get_sub_stats_pw(unsigned kernel_id,
   struct cache_sub_stats_pw t_css;
   t_css.clear();
 
-  for (unsigned kernel = 1; kernel < m_stats_pw.size(); ++kernel) {
+  // the kernels' blocks and the finished kernels, not the accesses of no
+  // kernel in block 0
+  for (unsigned kernel = 1; kernel <= get_size(); ++kernel) {
+    const unsigned long long *pw =
+        kernel < get_size() ? &m_stats_pw[kernel * STATS_STRIDE]
+                            : &m_retired_pw[0];
     for (unsigned type = 0; type < NUM_MEM_ACCESS_TYPE; ++type) {
       for (unsigned status = 0; status < NUM_CACHE_REQUEST_STATUS; ++status) {
         if (status == HIT || status == MISS || status == SECTOR_MISS ||
             status == HIT_RESERVED)
-          t_css.accesses += m_stats_pw[kernel][type][status];
+          t_css.accesses += pw[type * NUM_CACHE_REQUEST_STATUS + status];
 
         if (status == HIT) {
           if (type == GLOBAL_ACC_R || type == CONST_ACC_R ||
               type == INST_ACC_R) {
-            t_css.read_hits += m_stats_pw[kernel][type][status];
+            t_css.read_hits += pw[type * NUM_CACHE_REQUEST_STATUS + status];
           } else if (type == GLOBAL_ACC_W) {
-            t_css.write_hits += m_stats_pw[kernel][type][status];
+            t_css.write_hits += pw[type * NUM_CACHE_REQUEST_STATUS + status];
           }
         }
 
         if (status == MISS || status == SECTOR_MISS) {
           if (type == GLOBAL_ACC_R || type == CONST_ACC_R ||
               type == INST_ACC_R) {
-            t_css.read_misses += m_stats_pw[kernel][type][status];
+            t_css.read_misses += pw[type * NUM_CACHE_REQUEST_STATUS + status];
           } else if (type == GLOBAL_ACC_W) {
-            t_css.write_misses += m_stats_pw[kernel][type][status];
+            t_css.write_misses += pw[type * NUM_CACHE_REQUEST_STATUS + status];
           }
         }
 
         if (status == HIT_RESERVED) {
           if (type == GLOBAL_ACC_R || type == CONST_ACC_R ||
               type == INST_ACC_R) {
-            t_css.read_pending_hits += m_stats_pw[kernel][type][status];
+            t_css.read_pending_hits += pw[type * NUM_CACHE_REQUEST_STATUS + status];
           } else if (type == GLOBAL_ACC_W) {
-            t_css.write_pending_hits += m_stats_pw[kernel][type][status];
+            t_css.write_pending_hits += pw[type * NUM_CACHE_REQUEST_STATUS + status];
           }
         }
 
         if (status == RESERVATION_FAIL) {
           if (type == GLOBAL_ACC_R || type == CONST_ACC_R ||
               type == INST_ACC_R) {
-            t_css.read_res_fails += m_stats_pw[kernel][type][status];
+            t_css.read_res_fails += pw[type * NUM_CACHE_REQUEST_STATUS + status];
           } else if (type == GLOBAL_ACC_W) {
-            t_css.write_res_fails += m_stats_pw[kernel][type][status];
+            t_css.write_res_fails += pw[type * NUM_CACHE_REQUEST_STATUS + status];
           }
         }
       }
@@ -1233,25 +1463,49 @@ void cache_stats::sample_cache_port_utility(bool data_port_busy,
   }
 }
 
+void cache_stats::resize(unsigned blocks) {
+  m_stats.resize(blocks * STATS_STRIDE, 0);
+  m_stats_pw.resize(blocks * STATS_STRIDE, 0);
+  m_fail_stats.resize(blocks * FAIL_STRIDE, 0);
+  m_block_uid.resize(blocks, 0);
+}
+
 void cache_stats::expand_cache_stats(unsigned kernel_id) {
-  while (kernel_id + 1 > m_stats.size()) {
-    unsigned start_point = m_stats.size();
-    m_stats.resize(m_stats.size() + kernel_inc_count);
-    m_stats_pw.resize(m_stats_pw.size() + kernel_inc_count);
-    m_fail_stats.resize(m_fail_stats.size() + kernel_inc_count);
-    for (unsigned i = start_point; i < m_stats.size(); i++) {
-      m_stats[i].resize(NUM_MEM_ACCESS_TYPE);
-      m_stats_pw[i].resize(NUM_MEM_ACCESS_TYPE);
-      m_fail_stats[i].resize(NUM_MEM_ACCESS_TYPE);
-      for (unsigned j = 0; j < NUM_MEM_ACCESS_TYPE; ++j) {
-        m_stats[i][j].resize(NUM_CACHE_REQUEST_STATUS, 0);
-        m_stats_pw[i][j].resize(NUM_CACHE_REQUEST_STATUS, 0);
-        m_fail_stats[i][j].resize(NUM_CACHE_RESERVATION_FAIL_STATUS, 0);
-      }
-    }
-  }
-  assert(m_stats.size() == m_stats_pw.size());
-  assert(m_stats.size() == m_fail_stats.size());
+  if (kernel_id >= s_block_of_uid.size())
+    s_block_of_uid.resize(kernel_id + 1, 0);
+  unsigned &block = s_block_of_uid[kernel_id];
+  if (kernel_id && !block) {
+    // the first cache asked for the kernel picks a free block for all
+    for (block = 1; block < s_block_used.size() && s_block_used[block];
+         block++)
+      ;
+    if (block == s_block_used.size()) s_block_used.push_back(false);
+    s_block_used[block] = true;
+  }
+  if (block >= get_size()) {
+    // the blocks grow a few at a time and alike in every cache_stats
+    unsigned grown = get_size();
+    while (grown <= block) grown += kernel_inc_count;
+    resize(grown);
+  }
+  if (m_block_uid[block] == kernel_id) return;
+  m_block_uid[block] = kernel_id;
+  unsigned long long *pw = &m_stats_pw[block * STATS_STRIDE];
+  for (unsigned i = 0; i < STATS_STRIDE; i++) m_retired_pw[i] += pw[i];
+  std::fill(pw, pw + STATS_STRIDE, 0);
+  std::fill(&m_stats[block * STATS_STRIDE],
+            &m_stats[block * STATS_STRIDE] + STATS_STRIDE, 0);
+  std::fill(&m_fail_stats[block * FAIL_STRIDE],
+            &m_fail_stats[block * FAIL_STRIDE] + FAIL_STRIDE, 0);
+}
+
+void cache_stats::release_kernel(unsigned kernel_id) {
+  if (!kernel_id || kernel_id >= s_block_of_uid.size()) return;
+  unsigned &block = s_block_of_uid[kernel_id];
+  if (!block) return;
+  s_block_used[block] = false;
+  // stray accesses of the kernel now count as no kernel's
+  block = 0;
 }
 
 baseline_cache::bandwidth_management::bandwidth_management(cache_config &config)
@@ -1327,7 +1581,8 @@ bool baseline_cache::bandwidth_management::fill_port_free() const {
 void baseline_cache::cycle() {
   if (!m_miss_queue.empty()) {
     mem_fetch *mf = m_miss_queue.front();
-    if (!m_memport->full(mf->size(), mf->get_is_write())) {
+    if (!m_memport->full(mf->size(), mf->get_is_write()) &&
+        !m_memport->class_blocked(mf->is_graphics(), mf->size())) {
       m_miss_queue.pop_front();
       m_memport->push(mf);
     }
@@ -1368,7 +1623,7 @@ void baseline_cache::fill(mem_fetch *mf, unsigned time) {
     m_tag_array->fill(e->second.m_cache_index, time, mf);
   else if (m_config.m_alloc_policy == ON_FILL) {
     bool is_graphics = mf->is_graphics();
-    bool is_tex = mf->get_inst().is_tex();
+    bool is_tex = mf->is_tex();
     m_tag_array->fill(e->second.m_block_addr, time, mf, mf->is_write(), is_graphics, is_tex);
   } else
     abort();
@@ -2229,6 +2484,9 @@ enum cache_request_status data_cache::access(new_addr_type addr, mem_fetch *mf,
     m_gpu->aggregated_l1_stats.inc_stats(
         mf->get_kernel_uid(), mf->get_access_type(),
         m_stats.select_stats_status(probe_status, access_status));
+    core_stage_add(m_gpu->l1_class_accesses[mf->is_graphics()], 1ull);
+    if (probe_status == HIT)
+      core_stage_add(m_gpu->l1_class_hits[mf->is_graphics()], 1ull);
   } else if (is_L2()) {
     m_gpu->aggregated_l2_stats.inc_stats(
         mf->get_kernel_uid(), mf->get_access_type(),
@@ -2239,6 +2497,8 @@ enum cache_request_status data_cache::access(new_addr_type addr, mem_fetch *mf,
     } else {
       m_gpu->l2_cp_access++;
     }
+    m_gpu->l2_class_accesses[mf->is_graphics()]++;
+    if (probe_status == HIT) m_gpu->l2_class_hits[mf->is_graphics()]++;
   }
   m_stats.inc_stats_pw(
       mf->get_kernel_uid(), mf->get_access_type(),
@@ -2344,7 +2604,8 @@ void tex_cache::cycle() {
   // send next request to lower level of memory
   if (!m_request_fifo.empty()) {
     mem_fetch *mf = m_request_fifo.peek();
-    if (!m_memport->full(mf->get_ctrl_size(), false)) {
+    if (!m_memport->full(mf->get_ctrl_size(), false) &&
+        !m_memport->class_blocked(mf->is_graphics(), mf->size())) {
       m_request_fifo.pop();
       m_memport->push(mf);
     }
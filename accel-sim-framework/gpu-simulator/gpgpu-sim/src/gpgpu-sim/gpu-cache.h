@@ -113,6 +113,7 @@ struct cache_event {
 };
 
 const char *cache_request_status_str(enum cache_request_status status);
+const char *cache_fail_status_str(enum cache_reservation_fail_reason status);
 
 struct cache_block_t {
   cache_block_t() {
@@ -297,19 +298,16 @@ struct sector_cache_block : public cache_block_t {
 
   void init() {
     for (unsigned i = 0; i < SECTOR_CHUNCK_SIZE; ++i) {
-      m_sector_alloc_time[i] = 0;
-      m_sector_fill_time[i] = 0;
-      m_last_sector_access_time[i] = 0;
-      m_status[i] = INVALID;
-      m_ignore_on_fill_status[i] = false;
-      m_set_modified_on_fill[i] = false;
-      m_set_readable_on_fill[i] = false;
-      m_readable[i] = true;
+      m_sectors[i].status = INVALID;
+      m_sectors[i].ignore_on_fill = false;
+      m_sectors[i].modified_on_fill = false;
+      m_sectors[i].readable_on_fill = false;
+      m_sectors[i].readable = true;
     }
     m_line_alloc_time = 0;
     m_line_last_access_time = 0;
-    m_line_fill_time = 0;
     m_dirty_byte_mask.reset();
+    m_set_byte_mask_on_fill = false;
     m_is_graphics = false;
     m_is_tex = false;
   }
@@ -330,19 +328,11 @@ struct sector_cache_block : public cache_block_t {
     unsigned sidx = get_sector_index(sector_mask);
 
     // set sector stats
-    m_sector_alloc_time[sidx] = time;
-    m_last_sector_access_time[sidx] = time;
-    m_sector_fill_time[sidx] = 0;
-    m_status[sidx] = RESERVED;
-    m_ignore_on_fill_status[sidx] = false;
-    m_set_modified_on_fill[sidx] = false;
-    m_set_readable_on_fill[sidx] = false;
-    m_set_byte_mask_on_fill = false;
+    m_sectors[sidx].status = RESERVED;
 
     // set line stats
     m_line_alloc_time = time;  // only set this for the first allocated sector
     m_line_last_access_time = time;
-    m_line_fill_time = 0;
     m_is_graphics = is_graphics;
     m_is_tex = is_tex;
   }
@@ -353,48 +343,37 @@ struct sector_cache_block : public cache_block_t {
     unsigned sidx = get_sector_index(sector_mask);
 
     // set sector stats
-    m_sector_alloc_time[sidx] = time;
-    m_last_sector_access_time[sidx] = time;
-    m_sector_fill_time[sidx] = 0;
-    if (m_status[sidx] == MODIFIED)  // this should be the case only for
-                                     // fetch-on-write policy //TO DO
-      m_set_modified_on_fill[sidx] = true;
-    else
-      m_set_modified_on_fill[sidx] = false;
-
-    m_set_readable_on_fill[sidx] = false;
-
-    m_status[sidx] = RESERVED;
-    m_ignore_on_fill_status[sidx] = false;
-    // m_set_modified_on_fill[sidx] = false;
-    m_readable[sidx] = true;
+    sector_state &sector = m_sectors[sidx];
+    // this should be the case only for fetch-on-write policy //TO DO
+    sector.modified_on_fill = sector.status == MODIFIED;
+    sector.readable_on_fill = false;
+    sector.status = RESERVED;
+    sector.ignore_on_fill = false;
+    sector.readable = true;
 
     // set line stats
     m_line_last_access_time = time;
-    m_line_fill_time = 0;
   }
 
   virtual void fill(unsigned time, mem_access_sector_mask_t sector_mask,
                     mem_access_byte_mask_t byte_mask) {
     unsigned sidx = get_sector_index(sector_mask);
 
-    //	if(!m_ignore_on_fill_status[sidx])
-    //	         assert( m_status[sidx] == RESERVED );
-    m_status[sidx] = m_set_modified_on_fill[sidx] ? MODIFIED : VALID;
+    sector_state &sector = m_sectors[sidx];
+    //	if(!sector.ignore_on_fill)
+    //	         assert( sector.status == RESERVED );
+    sector.status = sector.modified_on_fill ? MODIFIED : VALID;
 
-    if (m_set_readable_on_fill[sidx]) {
-      m_readable[sidx] = true;
-      m_set_readable_on_fill[sidx] = false;
+    if (sector.readable_on_fill) {
+      sector.readable = true;
+      sector.readable_on_fill = false;
     }
     if (m_set_byte_mask_on_fill) set_byte_mask(byte_mask);
-
-    m_sector_fill_time[sidx] = time;
-    m_line_fill_time = time;
   }
   virtual bool is_invalid_line() {
     // all the sectors should be invalid
     for (unsigned i = 0; i < SECTOR_CHUNCK_SIZE; ++i) {
-      if (m_status[i] != INVALID) return false;
+      if (m_sectors[i].status != INVALID) return false;
     }
     return true;
   }
@@ -402,14 +381,14 @@ struct sector_cache_block : public cache_block_t {
   virtual bool is_reserved_line() {
     // if any of the sector is reserved, then the line is reserved
     for (unsigned i = 0; i < SECTOR_CHUNCK_SIZE; ++i) {
-      if (m_status[i] == RESERVED) return true;
+      if (m_sectors[i].status == RESERVED) return true;
     }
     return false;
   }
   virtual bool is_modified_line() {
     // if any of the sector is modified, then the line is modified
     for (unsigned i = 0; i < SECTOR_CHUNCK_SIZE; ++i) {
-      if (m_status[i] == MODIFIED) return true;
+      if (m_sectors[i].status == MODIFIED) return true;
     }
     return false;
   }
@@ -418,13 +397,13 @@ struct sector_cache_block : public cache_block_t {
       mem_access_sector_mask_t sector_mask) {
     unsigned sidx = get_sector_index(sector_mask);
 
-    return m_status[sidx];
+    return (cache_block_state)m_sectors[sidx].status;
   }
 
   virtual void set_status(enum cache_block_state status,
                           mem_access_sector_mask_t sector_mask) {
     unsigned sidx = get_sector_index(sector_mask);
-    m_status[sidx] = status;
+    m_sectors[sidx].status = status;
   }
 
   virtual void set_byte_mask(mem_fetch *mf) {
@@ -439,7 +418,7 @@ struct sector_cache_block : public cache_block_t {
   virtual mem_access_sector_mask_t get_dirty_sector_mask() {
     mem_access_sector_mask_t sector_mask;
     for (unsigned i = 0; i < SECTOR_CHUNCK_SIZE; i++) {
-      if (m_status[i] == MODIFIED) sector_mask.set(i);
+      if (m_sectors[i].status == MODIFIED) sector_mask.set(i);
     }
     return sector_mask;
   }
@@ -449,9 +428,6 @@ struct sector_cache_block : public cache_block_t {
 
   virtual void set_last_access_time(unsigned long long time,
                                     mem_access_sector_mask_t sector_mask) {
-    unsigned sidx = get_sector_index(sector_mask);
-
-    m_last_sector_access_time[sidx] = time;
     m_line_last_access_time = time;
   }
 
@@ -460,13 +436,13 @@ struct sector_cache_block : public cache_block_t {
   virtual void set_ignore_on_fill(bool m_ignore,
                                   mem_access_sector_mask_t sector_mask) {
     unsigned sidx = get_sector_index(sector_mask);
-    m_ignore_on_fill_status[sidx] = m_ignore;
+    m_sectors[sidx].ignore_on_fill = m_ignore;
   }
 
   virtual void set_modified_on_fill(bool m_modified,
                                     mem_access_sector_mask_t sector_mask) {
     unsigned sidx = get_sector_index(sector_mask);
-    m_set_modified_on_fill[sidx] = m_modified;
+    m_sectors[sidx].modified_on_fill = m_modified;
   }
   virtual void set_byte_mask_on_fill(bool m_modified) {
     m_set_byte_mask_on_fill = m_modified;
@@ -475,30 +451,31 @@ struct sector_cache_block : public cache_block_t {
   virtual void set_readable_on_fill(bool readable,
                                     mem_access_sector_mask_t sector_mask) {
     unsigned sidx = get_sector_index(sector_mask);
-    m_set_readable_on_fill[sidx] = readable;
+    m_sectors[sidx].readable_on_fill = readable;
   }
   virtual void set_m_readable(bool readable,
                               mem_access_sector_mask_t sector_mask) {
     unsigned sidx = get_sector_index(sector_mask);
-    m_readable[sidx] = readable;
+    m_sectors[sidx].readable = readable;
   }
 
   virtual bool is_readable(mem_access_sector_mask_t sector_mask) {
     unsigned sidx = get_sector_index(sector_mask);
-    return m_readable[sidx];
+    return m_sectors[sidx].readable;
   }
 
   virtual unsigned get_modified_size() {
     unsigned modified = 0;
     for (unsigned i = 0; i < SECTOR_CHUNCK_SIZE; ++i) {
-      if (m_status[i] == MODIFIED) modified++;
+      if (m_sectors[i].status == MODIFIED) modified++;
     }
     return modified * SECTOR_SIZE;
   }
 
   virtual void print_status() {
     printf("m_block_addr is %llu, status = %u %u %u %u\n", m_block_addr,
-           m_status[0], m_status[1], m_status[2], m_status[3]);
+           m_sectors[0].status, m_sectors[1].status, m_sectors[2].status,
+           m_sectors[3].status);
   }
   virtual bool is_graphics() {
     return m_is_graphics;
@@ -511,20 +488,22 @@ struct sector_cache_block : public cache_block_t {
   // }
 
  private:
-  unsigned m_sector_alloc_time[SECTOR_CHUNCK_SIZE];
-  unsigned m_last_sector_access_time[SECTOR_CHUNCK_SIZE];
-  unsigned m_sector_fill_time[SECTOR_CHUNCK_SIZE];
+  // one byte of state per sector. The per-sector allocation, access and fill
+  // times were never read; the line keeps the two the replacement policies
+  // and the stats use
+  struct sector_state {
+    unsigned char status : 2;  // cache_block_state
+    bool ignore_on_fill : 1;
+    bool modified_on_fill : 1;
+    bool readable_on_fill : 1;
+    bool readable : 1;
+  };
   unsigned m_line_alloc_time;
   unsigned m_line_last_access_time;
-  unsigned m_line_fill_time;
-  cache_block_state m_status[SECTOR_CHUNCK_SIZE];
-  bool m_ignore_on_fill_status[SECTOR_CHUNCK_SIZE];
-  bool m_set_modified_on_fill[SECTOR_CHUNCK_SIZE];
-  bool m_set_readable_on_fill[SECTOR_CHUNCK_SIZE];
-  bool m_set_byte_mask_on_fill;
-  bool m_readable[SECTOR_CHUNCK_SIZE];
-  bool m_is_graphics;
-  bool m_is_tex;
+  sector_state m_sectors[SECTOR_CHUNCK_SIZE];
+  bool m_set_byte_mask_on_fill : 1;
+  bool m_is_graphics : 1;
+  bool m_is_tex : 1;
   mem_access_byte_mask_t m_dirty_byte_mask;
 
   unsigned get_sector_index(mem_access_sector_mask_t sector_mask) {
@@ -535,7 +514,16 @@ struct sector_cache_block : public cache_block_t {
   }
 };
 
-enum replacement_policy_t { LRU, FIFO };
+// SRRIP to SHIP_TYPE, see rrip_policy.h
+enum replacement_policy_t {
+  LRU,
+  FIFO,
+  SRRIP,
+  DRRIP,
+  SHIP_PC,
+  SHIP_CLASS,
+  SHIP_TYPE
+};
 
 enum write_policy_t {
   READ_ONLY,
@@ -626,6 +614,21 @@ class cache_config {
       case 'F':
         m_replacement_policy = FIFO;
         break;
+      case 'S':
+        m_replacement_policy = SRRIP;
+        break;
+      case 'D':
+        m_replacement_policy = DRRIP;
+        break;
+      case 'P':
+        m_replacement_policy = SHIP_PC;
+        break;
+      case 'C':
+        m_replacement_policy = SHIP_CLASS;
+        break;
+      case 'T':
+        m_replacement_policy = SHIP_TYPE;
+        break;
       default:
         exit_parse_error();
     }
@@ -888,7 +891,9 @@ class cache_config {
   unsigned original_m_assoc;
   bool m_is_streaming;
 
-  enum replacement_policy_t m_replacement_policy;  // 'L' = LRU, 'F' = FIFO
+  // 'L' = LRU, 'F' = FIFO, 'S' = SRRIP, 'D' = DRRIP, SHiP by 'P' = PC,
+  // 'C' = class, 'T' = access type
+  enum replacement_policy_t m_replacement_policy;
   enum write_policy_t
       m_write_policy;  // 'T' = write through, 'B' = write back, 'R' = read only
   enum allocation_policy_t
@@ -924,6 +929,9 @@ class cache_config {
   friend class l1_cache;
   friend class l2_cache;
   friend class memory_sub_partition;
+  friend class l2_prefetcher;
+  friend class gpu_mmu;
+  friend class copy_engine;
 };
 
 class l1d_cache_config : public cache_config {
@@ -987,14 +995,42 @@ class tag_array {
   void fill(new_addr_type addr, unsigned time, mem_fetch *mf, bool is_write, bool is_graphics, bool is_tex);
   void fill(unsigned idx, unsigned time, mem_fetch *mf);
   void fill(new_addr_type addr, unsigned time, mem_access_sector_mask_t mask,
-            mem_access_byte_mask_t byte_mask, bool is_write, bool is_graphics, bool is_tex);
+            mem_access_byte_mask_t byte_mask, bool is_write, bool is_graphics, bool is_tex,
+            mem_fetch *mf = NULL);
+  // functional warm-up: a hit only refreshes the line's access time, anything
+  // else fills it as a clean line. Returns whether it hit, no MSHR or stats
+  // are involved
+  bool warm(new_addr_type addr, unsigned time, mem_access_sector_mask_t mask,
+            bool is_graphics);
 
   unsigned size() const { return m_config.get_num_lines(); }
-  cache_block_t *get_block(unsigned idx) { return m_lines[idx]; }
+  cache_block_t *get_block(unsigned idx) {
+    // the caller may change the line, its summary is refreshed before the
+    // next probe
+    m_stale_lines.push_back(idx);
+    return m_lines[idx];
+  }
+  // count the lines of every class (tex, vertex, compute, invalid)
+  void add_breakdown(std::vector<unsigned> &breakdown);
+  // -gpgpu_l2_way_partition: ways [0, ways) of every set only take graphics
+  // lines while compute and graphics share the cache, the rest only compute
+  // lines. Lines left in the other class's ways go when they are replaced
+  void set_graphics_ways(unsigned ways);
+  // -gpgpu_l1_carveout_dynamic: the same split, 0 = none, but it holds
+  // without -gpgpu_utility and the lines of the other class go from the
+  // ways right away, those waiting on a fill aside
+  void set_class_ways(unsigned ways);
+  // -gpgpu_l2_tenant_ways: tenant t only allocates in its ways[t] ways,
+  // contiguous from way 0 in tenant order. Tenants past the list keep every
+  // way
+  void set_tenant_ways(const unsigned ways[], unsigned tenants);
 
   void flush();       // flush all written entries
   void invalidate();  // invalidate all entries
-  void invalidate_range(new_addr_type addr, unsigned size);  // invalidate range
+  // invalidate all entries but the clean graphics texture lines
+  void invalidate_except_texture();
+  // invalidate the sector of every 32B step of [addr, addr + size)
+  void invalidate_range(new_addr_type addr, unsigned size);
   void new_window();
 
   void print(FILE *stream, unsigned &total_access,
@@ -1002,11 +1038,13 @@ class tag_array {
   float windowed_miss_rate() const;
   void get_stats(unsigned &total_access, unsigned &total_misses,
                  unsigned &total_hit_res, unsigned &total_res_fail) const;
+  // hits per recency rank of each class, from the shadow tags once the
+  // utility monitor is enabled, else ranked in every set by probe
   void get_utility(std::vector<unsigned> &utility_gr,
-                   std::vector<unsigned> &utility_cp) const {
-    utility_gr = utility_counter_gr;
-    utility_cp = utility_counter_cp;
-  }
+                   std::vector<unsigned> &utility_cp) const;
+  // -gpgpu_l2_umon_sets: shadow sampled_sets sets instead
+  void enable_utility_monitor(unsigned sampled_sets);
+  void decay_utility();
 
   void update_cache_parameters(cache_config &config);
   void add_pending_line(mem_fetch *mf);
@@ -1030,6 +1068,27 @@ class tag_array {
   tag_array(cache_config &config, int core_id, int type_id,
             cache_block_t **new_lines, gpgpu_sim *gpu);
   void init(int core_id, int type_id);
+  // position of way in its set ordered by last access, most recent first.
+  // Invalid lines count as never accessed and ties go to the lower way
+  unsigned recency_rank(unsigned set_index, unsigned way) const;
+
+  // dense copy of the line state the way search reads, indexed like m_lines,
+  // so probe scans plain arrays instead of calling into every line.
+  // sync_line refreshes it after each change to the line
+  enum line_summary_bits {
+    LINE_VALID = 1,
+    LINE_INVALID = 2,
+    LINE_RESERVED = 4,
+    LINE_GRAPHICS = 8,
+    LINE_TEX = 16
+  };
+  void sync_line(unsigned idx);
+  void sync_stale_lines();
+  void invalidate_sectors(new_addr_type block_addr,
+                          const mem_access_sector_mask_t &sectors);
+  // line idx takes the block of addr, for the RRIP policies
+  void rrip_insert(new_addr_type addr, unsigned idx, bool was_valid,
+                   mem_fetch *mf, bool is_graphics, bool is_tex);
 
  protected:
   cache_config &m_config;
@@ -1059,6 +1118,19 @@ class tag_array {
   typedef tr1_hash_map<new_addr_type, unsigned> line_table;
   line_table pending_lines;
   gpgpu_sim *m_gpu;
+
+  unsigned long long m_graphics_way_mask;  // 0 = not way partitioned
+  bool m_class_ways;                       // the mask is set_class_ways'
+  unsigned long long m_tenant_way_mask[MAX_TENANTS];  // ~0 = every way
+  class utility_monitor *m_umon;           // NULL = rank on every hit
+  class rrip_policy *m_rrip;               // NULL = LRU or FIFO
+
+  std::vector<new_addr_type> m_line_tag;
+  std::vector<unsigned char> m_line_bits;  // line_summary_bits
+  std::vector<unsigned long long> m_line_access_time;
+  std::vector<unsigned long long> m_line_alloc_time;
+  // lines handed out by get_block since the last probe
+  std::vector<unsigned> m_stale_lines;
 };
 
 class mshr_table {
@@ -1251,6 +1323,9 @@ class cache_stats {
   // Increment AerialVision cache stats
   void inc_stats_pw(unsigned kernel_id, int access_type, int access_outcome);
   void inc_fail_stats(unsigned kernel_id, int access_type, int fail_outcome);
+  // the caches of several clusters count into shared stats, whose counts
+  // then wait for the barrier of a parallel core cycle
+  void set_shared(bool shared) { m_shared = shared; }
   enum cache_request_status select_stats_status(
       enum cache_request_status probe, enum cache_request_status access) const;
   unsigned long long &operator()(unsigned kernel_id, int access_type, int access_outcome,
@@ -1262,6 +1337,8 @@ class cache_stats {
   void print_stats(unsigned kernel_id, FILE *fout, const char *cache_name = "Cache_stats") const;
   void print_fail_stats(unsigned kernel_id, FILE *fout,
                         const char *cache_name = "Cache_fail_stats") const;
+  // nothing without prefetches
+  void print_prefetch_stats(FILE *fout, const char *cache_name) const;
 
   unsigned long long get_stats(unsigned kernel_id,
                                enum mem_access_type *access_type,
@@ -1274,24 +1351,63 @@ class cache_stats {
   void get_sub_stats_pw(unsigned kernel_id, struct cache_sub_stats_pw &css) const;
 
   void sample_cache_port_utility(bool data_port_busy, bool fill_port_busy);
+  // gives kernel_id a block of counters, zeroed unless it already had it
   void expand_cache_stats(unsigned kernel_id);
-  unsigned get_size() const {
-    return m_stats.size();
-  }
+  // the block of kernel_id may be handed to a later kernel once its stats
+  // were printed, in every cache_stats
+  static void release_kernel(unsigned kernel_id);
+  // blocks of counters, the same in every cache_stats sized by
+  // expand_cache_stats
+  unsigned get_size() const { return m_block_uid.size(); }
+  void resize(unsigned blocks);
+
+  // -gpgpu_l2_prefetch, totals since the start
+  unsigned long long m_prefetch_issued;  // lines
+  unsigned long long m_prefetch_useful;  // prefetched lines a demand read hit
+  unsigned long long m_prefetch_late;    // of them, before the fill arrived
+  unsigned long long m_prefetch_misses;  // demand misses of the trained class
 
  private:
   bool check_valid(int type, int status) const;
   bool check_fail_valid(int type, int fail) const;
 
-  std::vector<std::vector<std::vector<unsigned long long>>> m_stats;
+  static const unsigned STATS_STRIDE =
+      NUM_MEM_ACCESS_TYPE * NUM_CACHE_REQUEST_STATUS;
+  static const unsigned FAIL_STRIDE =
+      NUM_MEM_ACCESS_TYPE * NUM_CACHE_RESERVATION_FAIL_STATUS;
+  // block 0 counts the accesses of no kernel, uid 0
+  static unsigned block_of(unsigned kernel_id) {
+    return kernel_id < s_block_of_uid.size() ? s_block_of_uid[kernel_id] : 0;
+  }
+  unsigned stat_index(unsigned kernel_id, int type, int status) const {
+    return block_of(kernel_id) * STATS_STRIDE +
+           type * NUM_CACHE_REQUEST_STATUS + status;
+  }
+  unsigned fail_index(unsigned kernel_id, int type, int fail) const {
+    return block_of(kernel_id) * FAIL_STRIDE +
+           type * NUM_CACHE_RESERVATION_FAIL_STATUS + fail;
+  }
+
+  // one block of [access_type][outcome] counters per live kernel, so the
+  // storage is bounded by the kernels in flight rather than by the uids
+  // handed out over the run
+  std::vector<unsigned long long> m_stats;
   // AerialVision cache stats (per-window)
-  std::vector<std::vector<std::vector<unsigned long long>>> m_stats_pw;
-  std::vector<std::vector<std::vector<unsigned long long>>> m_fail_stats;
+  std::vector<unsigned long long> m_stats_pw;
+  std::vector<unsigned long long> m_fail_stats;
+  // per-window counts of the kernels whose blocks were handed on
+  std::vector<unsigned long long> m_retired_pw;
+  // kernel the counters of each block belong to
+  std::vector<unsigned> m_block_uid;
+  bool m_shared;
 
   unsigned long long m_cache_port_available_cycles;
   unsigned long long m_cache_data_port_busy_cycles;
   unsigned long long m_cache_fill_port_busy_cycles;
   unsigned kernel_inc_count = 32;
+
+  static std::vector<unsigned> s_block_of_uid;
+  static std::vector<bool> s_block_used;
 };
 
 class cache_t {
@@ -1370,6 +1486,9 @@ class baseline_cache : public cache_t {
   // flash invalidate all entries in cache
   void flush() { m_tag_array->flush(); }
   void invalidate() { m_tag_array->invalidate(); }
+  void invalidate_except_texture() {
+    m_tag_array->invalidate_except_texture();
+  }
   void invalidate_range(new_addr_type addr, unsigned size) {
     m_tag_array->invalidate_range(addr, size);
   }
@@ -1382,6 +1501,17 @@ class baseline_cache : public cache_t {
                    std::vector<unsigned> &utility_cp) const {
     m_tag_array->get_utility(utility_gr, utility_cp);
   }
+  void set_graphics_ways(unsigned ways) {
+    m_tag_array->set_graphics_ways(ways);
+  }
+  void set_class_ways(unsigned ways) { m_tag_array->set_class_ways(ways); }
+  void set_tenant_ways(const unsigned ways[], unsigned tenants) {
+    m_tag_array->set_tenant_ways(ways, tenants);
+  }
+  void enable_utility_monitor(unsigned sampled_sets) {
+    m_tag_array->enable_utility_monitor(sampled_sets);
+  }
+  void decay_utility() { m_tag_array->decay_utility(); }
 
   // right now it's either L1 (includes L1C, L1T, L1D etc.) or L2. So it's
   // enough to have just 1 bool. But maybe in the future this is different. Just
@@ -1397,6 +1527,8 @@ class baseline_cache : public cache_t {
 
   // Stat collection
   const cache_stats &get_stats() const { return m_stats; }
+  // for the counters of a prefetcher in front of the cache
+  cache_stats &get_stats() { return m_stats; }
   unsigned get_stats(unsigned kernel_id, enum mem_access_type *access_type,
                      unsigned num_access_type,
                      enum cache_request_status *access_status,
@@ -1432,31 +1564,15 @@ class baseline_cache : public cache_t {
     // two false: first, this is clean, second, tex does not prefetch
     m_tag_array->fill(addr, time, mask, byte_mask, false, is_graphics, false);
   }
+  // the same for functionally warming the cache up with the addresses of
+  // kernels that are not simulated in detail, returns whether it hit
+  bool warm_tag_access(new_addr_type addr, unsigned time,
+                       mem_access_sector_mask_t mask, bool is_graphics) {
+    return m_tag_array->warm(addr, time, mask, is_graphics);
+  }
   void update_breakdown(std::vector<unsigned> &breakdown) {
     assert(breakdown.size() == 4);
-    for (unsigned set = 0; set < m_config.m_nset; set++) {
-      for (unsigned way = 0; way < m_config.m_assoc; way++) {
-        unsigned idx = set * m_config.m_assoc + way;
-        cache_block_t *line = m_tag_array->get_block(idx);
-        if (line->is_valid_line()) {
-          if (line->is_graphics()) {
-            if (line->is_tex()) {
-              // TEX
-              breakdown[0]++;
-            } else {
-              // Vertices
-              breakdown[1]++;
-            }
-          } else {
-            // compute
-            breakdown[2]++;
-          }
-        } else {
-          // invalid
-          breakdown[3]++;
-        }
-      }
-    }
+    m_tag_array->add_breakdown(breakdown);
   }
   void update_breakdown_from_internal(std::vector<unsigned> &breakdown) {
     m_tag_array->update_cache_breakdown_from_internal(breakdown);
@@ -41,16 +41,23 @@
 #include "mem_fetch.h"
 #include "shader.h"
 #include "shader_trace.h"
+#include "sim_thread_pool.h"
 
 #include <time.h>
 #include "addrdec.h"
 #include "delayqueue.h"
 #include "dram.h"
+#include "dram_traffic.h"
 #include "gpu-cache.h"
 #include "gpu-misc.h"
 #include "icnt_wrapper.h"
+#include "l2_partition.h"
+#include "kernel_stats_log.h"
 #include "l2cache.h"
+#include "mem_throttle.h"
 #include "shader.h"
+#include "slicer.h"
+#include "sm_quota.h"
 #include "stat-tool.h"
 
 #include "../../libcuda/gpgpu_context.h"
@@ -92,6 +99,8 @@ tr1_hash_map<new_addr_type, unsigned> address_random_interleaving;
 #define L2 0x02
 #define DRAM 0x04
 #define ICNT 0x08
+// a cluster off the core clock, -gpgpu_cluster_clock_scale
+#define CLUSTER 0x10
 
 #define MEM_LATENCY_STAT_IMPL
 
@@ -132,6 +141,11 @@ void power_config::reg_options(class OptionParser *opp) {
   option_parser_register(opp, "-aggregate_power_stats", OPT_BOOL,
                          &g_aggregate_power_stats,
                          "Accumulate power across all kernels", "0");
+  option_parser_register(
+      opp, "-accelwattch_fast_power", OPT_UINT32, &g_fast_power_interval,
+      "Run McPAT on one power sample in N and evaluate the others from "
+      "per-component coefficients calibrated on it (0=McPAT on every sample)",
+      "0");
 
   //Accelwattch Hyrbid Configuration
 
@@ -207,6 +221,17 @@ void power_config::reg_options(class OptionParser *opp) {
       "Compression level of the power trace output log (0=no comp, 9=highest)",
       "6");
 
+  option_parser_register(
+      opp, "-power_trace_binary", OPT_BOOL, &g_power_trace_binary,
+      "write the power and metric traces as one binary time series of "
+      "fixed records from a writer thread (read by "
+      "util/plotting/counter_samples.py)",
+      "0");
+
+  option_parser_register(
+      opp, "-power_trace_window", OPT_UINT32, &g_power_trace_window,
+      "samples averaged into each row of the binary power trace", "1");
+
   option_parser_register(
       opp, "-steady_power_levels_enabled", OPT_BOOL,
       &g_steady_power_levels_enabled,
@@ -283,8 +308,138 @@ void memory_config::reg_options(class OptionParser *opp) {
       "DRAM timing parameters = "
       "{nbk:tCCD:tRRD:tRCD:tRAS:tRP:tRC:CL:WL:tCDLR:tWR:nbkgrp:tCCDL:tRTPL}",
       "4:2:8:12:21:13:34:9:4:5:13:1:0:0");
+  option_parser_register(
+      opp, "-dram_type", OPT_CSTR, &dram_type,
+      "DRAM the timing model follows, gddr or lpddr5 (checks the bank "
+      "architecture and burst length of -gpgpu_dram_timing_opt; the named "
+      "RRDL, FAW, REFI and RFC timings apply to both)",
+      "gddr");
   option_parser_register(opp, "-gpgpu_l2_rop_latency", OPT_UINT32, &rop_latency,
                          "ROP queue latency (default 85)", "85");
+  option_parser_register(opp, "-gpgpu_rop_model", OPT_BOOL, &rop_model,
+                         "framebuffer writes of fragment shaders go through "
+                         "a tiled ROP with blending, depth and compression",
+                         "0");
+  option_parser_register(opp, "-gpgpu_rop_fb", OPT_CSTR, &rop_fb,
+                         "framebuffer address range of the ROP, base:size in "
+                         "hex",
+                         "f0000000:10000000");
+  option_parser_register(opp, "-gpgpu_rop_tiles", OPT_UINT32, &rop_tiles,
+                         "open framebuffer tiles per ROP", "16");
+  option_parser_register(opp, "-gpgpu_rop_tile_size", OPT_UINT32,
+                         &rop_tile_size, "bytes of a ROP framebuffer tile",
+                         "256");
+  option_parser_register(opp, "-gpgpu_rop_tile_window", OPT_UINT32,
+                         &rop_tile_window,
+                         "cycles a ROP tile gathers writes before it closes",
+                         "32");
+  option_parser_register(opp, "-gpgpu_rop_blend_latency", OPT_UINT32,
+                         &rop_blend_latency,
+                         "cycles a closed ROP tile spends blending and depth "
+                         "testing",
+                         "0");
+  option_parser_register(opp, "-gpgpu_rop_compression", OPT_CSTR,
+                         &rop_compression,
+                         "color:depth compression ratios of the ROP", "1:1");
+  option_parser_register(opp, "-gpgpu_rop_depth_ratio", OPT_FLOAT,
+                         &rop_depth_ratio,
+                         "bytes of depth the ROP writes per byte of color, "
+                         "0 for none",
+                         "0");
+  option_parser_register(opp, "-gpgpu_compression", OPT_BOOL,
+                         &gpgpu_compression,
+                         "color and depth surfaces compressed in DRAM", "0");
+  option_parser_register(opp, "-gpgpu_compression_surfaces", OPT_CSTR,
+                         &gpgpu_compression_surfaces,
+                         "compressed surfaces besides the traced "
+                         "attachments, base:size in hex, comma separated",
+                         "");
+  option_parser_register(opp, "-gpgpu_compression_tile", OPT_UINT32,
+                         &gpgpu_compression_tile,
+                         "bytes of a compressed tile of a surface without "
+                         "traced sizes",
+                         "256");
+  option_parser_register(opp, "-gpgpu_compression_ratios", OPT_CSTR,
+                         &gpgpu_compression_ratios,
+                         "compression ratios of the tiles without traced "
+                         "sizes, ratio:fraction comma separated",
+                         "4:0.25,2:0.5,1:0.25");
+  option_parser_register(opp, "-gpgpu_compression_meta_lines", OPT_UINT32,
+                         &gpgpu_compression_meta_lines,
+                         "32 byte lines of the compression metadata cache of "
+                         "an L2 slice, 0 for no metadata",
+                         "64");
+  option_parser_register(opp, "-gpgpu_l2_prefetch", OPT_CSTR, &l2_prefetch,
+                         "demand reads that train the stream prefetcher of "
+                         "each L2 sub partition, none, texture or graphics",
+                         "none");
+  option_parser_register(opp, "-gpgpu_l2_prefetch_degree", OPT_UINT32,
+                         &l2_prefetch_degree,
+                         "lines an L2 stream prefetches at a time", "2");
+  option_parser_register(opp, "-gpgpu_l2_prefetch_distance", OPT_UINT32,
+                         &l2_prefetch_distance,
+                         "strides ahead of the demand reads an L2 stream "
+                         "prefetches",
+                         "4");
+  option_parser_register(opp, "-gpgpu_l2_prefetch_streams", OPT_UINT32,
+                         &l2_prefetch_streams,
+                         "streams tracked per L2 sub partition", "16");
+  option_parser_register(opp, "-gpgpu_l2_prefetch_inflight", OPT_UINT32,
+                         &l2_prefetch_inflight,
+                         "prefetch requests in flight per L2 sub partition",
+                         "32");
+  option_parser_register(opp, "-gpgpu_tlb", OPT_CSTR, &gpgpu_tlb,
+                         "address translation of the SMs, none or <page KB>:"
+                         "<L1 entries>:<L1 assoc>:<L2 entries>:<L2 assoc>:"
+                         "<L2 latency>:<walk cache entries>:<walkers>",
+                         "none");
+  option_parser_register(opp, "-gpgpu_copy_engine", OPT_CSTR,
+                         &gpgpu_copy_engine,
+                         "copy engine of the memcpys to the GPU, none or "
+                         "<bytes per cycle>:<writes in flight>",
+                         "none");
+  option_parser_register(opp, "-gpgpu_multi_gpu", OPT_CSTR, &gpgpu_multi_gpu,
+                         "GPUs the config is split into, none or <gpus>:<sfr "
+                         "or afr>:<link bytes per cycle>:<link latency>",
+                         "none");
+  option_parser_register(opp, "-gpgpu_hybrid_fidelity", OPT_CSTR,
+                         &gpgpu_hybrid_fidelity,
+                         "memory profile of one class, none or <record or "
+                         "model>:<graphics or compute>:<profile file>",
+                         "none");
+  option_parser_register(opp, "-gpgpu_dram_traffic_rate", OPT_FLOAT,
+                         &dram_traffic_rate,
+                         "background requests of the other DRAM clients per "
+                         "DRAM cycle and channel, 0 for none",
+                         "0");
+  option_parser_register(opp, "-gpgpu_dram_traffic_burst", OPT_UINT32,
+                         &dram_traffic_burst,
+                         "background requests arriving together", "1");
+  option_parser_register(opp, "-gpgpu_dram_traffic_writes", OPT_FLOAT,
+                         &dram_traffic_writes,
+                         "fraction of the background requests that write",
+                         "0.3");
+  option_parser_register(opp, "-gpgpu_dram_traffic_size", OPT_UINT32,
+                         &dram_traffic_size,
+                         "bytes of a background request", "64");
+  option_parser_register(opp, "-gpgpu_dram_traffic_region", OPT_CSTR,
+                         &dram_traffic_region,
+                         "base:size (hex) of the addresses of the background "
+                         "requests",
+                         "0:10000000");
+  option_parser_register(opp, "-gpgpu_dram_traffic_pattern", OPT_CSTR,
+                         &dram_traffic_pattern,
+                         "addresses of the background bursts, random or "
+                         "stream",
+                         "random");
+  option_parser_register(opp, "-gpgpu_dram_traffic_trace", OPT_CSTR,
+                         &dram_traffic_trace,
+                         "file of \"<DRAM cycle> <hex address> R|W\" lines "
+                         "replayed as the background requests instead",
+                         "");
+  option_parser_register(opp, "-gpgpu_dram_traffic_inflight", OPT_UINT32,
+                         &dram_traffic_inflight,
+                         "background requests in flight per channel", "32");
   option_parser_register(opp, "-dram_latency", OPT_UINT32, &dram_latency,
                          "DRAM latency (default 30)", "30");
   option_parser_register(opp, "-dram_dual_bus_interface", OPT_UINT32,
@@ -305,6 +460,31 @@ void memory_config::reg_options(class OptionParser *opp) {
                          "Seperate_Write_Queue_Enable", "0");
   option_parser_register(opp, "-dram_write_queue_size", OPT_CSTR,
                          &write_queue_size_opt, "Write_Queue_Size", "32:28:16");
+  option_parser_register(opp, "-dram_sched_policy", OPT_CSTR,
+                         &dram_sched_policy,
+                         "row choice of the FR-FCFS scheduler: frfcfs, "
+                         "priority, bliss or atlas",
+                         "frfcfs");
+  option_parser_register(opp, "-dram_sched_graphics_first", OPT_BOOL,
+                         &dram_sched_graphics_first,
+                         "priority policy serves graphics before compute, "
+                         "else compute before graphics",
+                         "1");
+  option_parser_register(opp, "-dram_bliss_threshold", OPT_UINT32,
+                         &dram_bliss_threshold,
+                         "requests of one tenant served in a row that "
+                         "blacklist it (bliss)",
+                         "4");
+  option_parser_register(opp, "-dram_bliss_clear_period", OPT_UINT32,
+                         &dram_bliss_clear_period,
+                         "cycles between blacklist clears (bliss)", "10000");
+  option_parser_register(opp, "-dram_atlas_quantum", OPT_UINT32,
+                         &dram_atlas_quantum,
+                         "cycles between tenant rankings (atlas)", "10000");
+  option_parser_register(opp, "-dram_atlas_age", OPT_UINT32, &dram_atlas_age,
+                         "cycles a request waits before it goes first "
+                         "regardless of rank (atlas)",
+                         "5000");
   option_parser_register(
       opp, "-dram_elimnate_rw_turnaround", OPT_BOOL, &elimnate_rw_turnaround,
       "elimnate_rw_turnaround i.e set tWTR and tRTW = 0", "0");
@@ -332,6 +512,26 @@ void shader_core_config::reg_options(class OptionParser *opp) {
       " {<nsets>:<bsize>:<assoc>,<rep>:<wr>:<alloc>:<wr_alloc>,<mshr>:<N>:<"
       "merge>,<mq>} ",
       "64:64:2,L:R:f:N,A:2:32,4");
+  option_parser_register(
+      opp, "-gpgpu_rt_l0_node_cache", OPT_CSTR,
+      &m_RT_L0_node_config.m_config_string,
+      "per-shader RT unit L0 cache for BVH nodes  (READ-ONLY) config, used "
+      "when a specialized unit is named RT "
+      " {<nsets>:<bsize>:<assoc>,<rep>:<wr>:<alloc>:<wr_alloc>,<mshr>:<N>:<"
+      "merge>,<mq>} ",
+      "16:64:4,L:R:f:N,A:32:8,8");
+  option_parser_register(
+      opp, "-gpgpu_rt_l0_prim_cache", OPT_CSTR,
+      &m_RT_L0_prim_config.m_config_string,
+      "per-shader RT unit L0 cache for BVH primitives  (READ-ONLY) config "
+      " {<nsets>:<bsize>:<assoc>,<rep>:<wr>:<alloc>:<wr_alloc>,<mshr>:<N>:<"
+      "merge>,<mq>} ",
+      "16:64:4,L:R:f:N,A:32:8,8");
+  option_parser_register(opp, "-gpgpu_rt_max_warps", OPT_UINT32,
+                         &gpgpu_rt_max_warps,
+                         "number of TRACE_RAY warps the RT unit traverses "
+                         "concurrently",
+                         "4");
   option_parser_register(opp, "-gpgpu_cache:il1", OPT_CSTR,
                          &m_L1I_config.m_config_string,
                          "shader L1 instruction cache config "
@@ -434,6 +634,12 @@ void shader_core_config::reg_options(class OptionParser *opp) {
       "Size of unified data cache(L1D + shared memory) in KB", "0");
   option_parser_register(opp, "-gpgpu_adaptive_cache_config", OPT_BOOL,
                          &adaptive_cache_config, "adaptive_cache_config", "0");
+  option_parser_register(opp, "-gpgpu_l1_carveout_dynamic", OPT_BOOL,
+                         &gpgpu_l1_carveout_dynamic,
+                         "with -gpgpu_adaptive_cache_config, pick the L1D "
+                         "carveout and its graphics/compute split again at "
+                         "every kernel launch and finish",
+                         "0");
   option_parser_register(
       opp, "-gpgpu_shmem_sizeDefault", OPT_UINT32, &gpgpu_shmem_sizeDefault,
       "Size of shared memory per shader core (default 16kB)", "16384");
@@ -448,6 +654,11 @@ void shader_core_config::reg_options(class OptionParser *opp) {
       opp, "-gpgpu_shmem_num_banks", OPT_UINT32, &num_shmem_bank,
       "Number of banks in the shared memory in each shader core (default 16)",
       "16");
+  option_parser_register(opp, "-gpgpu_shmem_bank_width", OPT_UINT32,
+                         &shmem_bank_width,
+                         "Bytes of a shared memory bank per cycle, the "
+                         "granularity of the bank conflict check",
+                         "4");
   option_parser_register(
       opp, "-gpgpu_shmem_limited_broadcast", OPT_BOOL, &shmem_limited_broadcast,
       "Limit shared memory to do one broadcast per cycle (default on)", "1");
@@ -483,6 +694,25 @@ void shader_core_config::reg_options(class OptionParser *opp) {
   option_parser_register(
       opp, "-gpgpu_reg_bank_use_warp_id", OPT_BOOL, &gpgpu_reg_bank_use_warp_id,
       "Use warp ID in mapping registers to banks (default = off)", "0");
+  option_parser_register(
+      opp, "-gpgpu_operand_reuse_slots", OPT_UINT32, &gpgpu_operand_reuse_slots,
+      "Source operand slots of the reuse cache of each collector unit, the "
+      "trace-driven core infers the reuse flags (default = 0, none)",
+      "0");
+  option_parser_register(
+      opp, "-gpgpu_sm_gating_threshold", OPT_UINT32, &gpgpu_sm_gating_threshold,
+      "Cycles an SM has to be without CTAs before it is power gated "
+      "(default = 0, no power gating)",
+      "0");
+  option_parser_register(opp, "-gpgpu_sm_gating_wake_latency", OPT_UINT32,
+                         &gpgpu_sm_gating_wake_latency,
+                         "Cycles a power gated SM takes to wake up for a CTA "
+                         "(default = 0)",
+                         "0");
+  option_parser_register(opp, "-gpgpu_sm_gating_wake_energy", OPT_DOUBLE,
+                         &gpgpu_sm_gating_wake_energy,
+                         "nJ a power gated SM spends to wake up (default = 0)",
+                         "0");
   option_parser_register(opp, "-gpgpu_sub_core_model", OPT_BOOL,
                          &sub_core_model,
                          "Sub Core Volta/Pascal model (default = off)", "0");
@@ -570,6 +800,10 @@ void shader_core_config::reg_options(class OptionParser *opp) {
   option_parser_register(opp, "-gpgpu_coalesce_arch", OPT_INT32,
                          &gpgpu_coalesce_arch,
                          "Coalescing arch (GT200 = 13, Fermi = 20)", "13");
+  option_parser_register(opp, "-gpgpu_tex_l1t", OPT_BOOL, &gpgpu_tex_l1t,
+                         "send TEX loads through the texture L1 with one "
+                         "request per footprint line (default = off, L1D)",
+                         "0");
   option_parser_register(opp, "-gpgpu_num_sched_per_core", OPT_INT32,
                          &gpgpu_num_sched_per_core,
                          "Number of warp schedulers per core", "1");
@@ -718,19 +952,298 @@ void gpgpu_sim_config::reg_options(option_parser_t opp) {
   option_parser_register(opp, "-gpgpu_flush_l2_cache", OPT_BOOL,
                          &gpgpu_flush_l2_cache,
                          "Flush L2 cache at the end of each kernel call", "0");
+  option_parser_register(opp, "-gpgpu_frame_persistence", OPT_UINT32,
+                         &gpgpu_frame_persistence,
+                         "keep the caches across the frames of a multi-frame "
+                         "run and drop only what vertex buffer uploads "
+                         "overwrite (0 = off, 1 = L2, 2 = L2 and L1D texture "
+                         "lines)",
+                         "0");
   option_parser_register(opp, "-gpgpu_slicer", OPT_BOOL, &gpgpu_slicer,
                          "warped slicer", "0");
+  option_parser_register(opp, "-gpgpu_slicer_policy", OPT_CSTR,
+                         &gpgpu_slicer_policy,
+                         "how the warped slicer picks the split from its "
+                         "samples (pairs|curve)",
+                         "pairs");
+  option_parser_register(opp, "-gpgpu_slicer_sample_cycles", OPT_UINT32,
+                         &gpgpu_slicer_sample_cycles,
+                         "cycles the warped slicer measures each sample",
+                         "10000");
+  option_parser_register(opp, "-gpgpu_slicer_warmup_cycles", OPT_UINT32,
+                         &gpgpu_slicer_warmup_cycles,
+                         "cycles at the start of a sample left out of the "
+                         "measurement, lets CTAs placed under the previous "
+                         "split drain",
+                         "0");
+  option_parser_register(opp, "-gpgpu_slicer_phase_period", OPT_UINT32,
+                         &gpgpu_slicer_phase_period,
+                         "cycles between warped slicer phase change checks, "
+                         "0 = resample only for new kernel pairs",
+                         "0");
+  option_parser_register(opp, "-gpgpu_slicer_phase_threshold", OPT_UINT32,
+                         &gpgpu_slicer_phase_threshold,
+                         "percent change of a class's IPC that counts as a "
+                         "phase change",
+                         "25");
+  option_parser_register(opp, "-gpgpu_sm_repartition", OPT_BOOL,
+                         &gpgpu_sm_repartition,
+                         "move SMs between graphics and compute at runtime "
+                         "in MPS mode to meet the frame deadline",
+                         "0");
+  option_parser_register(opp, "-gpgpu_sm_repartition_period", OPT_UINT32,
+                         &gpgpu_sm_repartition_period,
+                         "cycles between SM repartitioning decisions",
+                         "20000");
+  option_parser_register(opp, "-gpgpu_sm_migration_cycles", OPT_UINT32,
+                         &gpgpu_sm_migration_cycles,
+                         "cycles a moved SM stays idle after draining the "
+                         "CTAs of its old class",
+                         "2000");
+  option_parser_register(opp, "-gpgpu_frame_deadline", OPT_UINT32,
+                         &gpgpu_frame_deadline,
+                         "cycles graphics has to render a frame in, 0 = the "
+                         "length of the previous frame",
+                         "0");
+  option_parser_register(opp, "-gpgpu_frame_slack", OPT_UINT32,
+                         &gpgpu_frame_slack,
+                         "percent of extra graphics throughput the SM "
+                         "repartitioning and the compute CTA throttle keep "
+                         "over what the deadline needs",
+                         "10");
+  option_parser_register(opp, "-gpgpu_frame_cta_throttle", OPT_BOOL,
+                         &gpgpu_frame_cta_throttle,
+                         "cap the compute CTAs co-running with graphics while "
+                         "the frame deadline is at risk",
+                         "0");
+  option_parser_register(opp, "-gpgpu_frame_throttle_period", OPT_UINT32,
+                         &gpgpu_frame_throttle_period,
+                         "cycles between compute CTA throttle decisions",
+                         "5000");
+  option_parser_register(opp, "-gpgpu_mem_class_caps", OPT_CSTR,
+                         &gpgpu_mem_class_caps,
+                         "graphics,compute requests each SM may have in "
+                         "flight to the memory system (0 = no cap)",
+                         "0,0");
+  option_parser_register(opp, "-gpgpu_mem_class_rates", OPT_CSTR,
+                         &gpgpu_mem_class_rates,
+                         "graphics,compute bytes per cycle each SM may "
+                         "inject into the interconnect (0 = no limit)",
+                         "0,0");
+  option_parser_register(opp, "-gpgpu_dram_class_caps", OPT_CSTR,
+                         &gpgpu_dram_class_caps,
+                         "graphics,compute requests each L2 sub partition "
+                         "may have in its L2 to DRAM queue (0 = no cap)",
+                         "0,0");
+  option_parser_register(opp, "-gpgpu_dram_class_rates", OPT_CSTR,
+                         &gpgpu_dram_class_rates,
+                         "graphics,compute bytes per cycle each L2 sub "
+                         "partition may send towards DRAM (0 = no limit)",
+                         "0,0");
+  option_parser_register(opp, "-gpgpu_mem_token_depth", OPT_UINT32,
+                         &gpgpu_mem_token_depth,
+                         "bytes a class may inject in a burst under its rate",
+                         "512");
+  option_parser_register(opp, "-gpgpu_mem_throttle", OPT_BOOL,
+                         &gpgpu_mem_throttle,
+                         "scale the graphics memory limits at runtime to "
+                         "keep the compute request latency under "
+                         "-gpgpu_mem_throttle_latency",
+                         "0");
+  option_parser_register(opp, "-gpgpu_mem_throttle_period", OPT_UINT32,
+                         &gpgpu_mem_throttle_period,
+                         "cycles between memory throttle decisions", "5000");
+  option_parser_register(opp, "-gpgpu_mem_throttle_latency", OPT_UINT32,
+                         &gpgpu_mem_throttle_latency,
+                         "cycles from issue to reply the compute requests "
+                         "should average",
+                         "600");
+  option_parser_register(opp, "-gpgpu_tenant_sms", OPT_CSTR,
+                         &gpgpu_tenant_sms,
+                         "MPS: SMs of each tenant, graphics first, e.g. "
+                         "20,8,8; the last one takes the SMs left over "
+                         "(empty = the graphics/compute split)",
+                         "");
+  option_parser_register(opp, "-gpgpu_l2_tenant_ways", OPT_CSTR,
+                         &gpgpu_l2_tenant_ways,
+                         "L2 ways each tenant allocates in, graphics first, "
+                         "e.g. 8,4,4 (empty = not partitioned by tenant)",
+                         "");
   option_parser_register(opp, "-gpgpu_utility", OPT_BOOL, &gpgpu_utility,
                          "Utility-based partitioning", "0");
+  option_parser_register(opp, "-gpgpu_l2_way_partition", OPT_BOOL,
+                         &gpgpu_l2_way_partition,
+                         "enforce the utility-based L2 split as graphics and "
+                         "compute way masks in replacement",
+                         "0");
+  option_parser_register(opp, "-gpgpu_l2_partition_per_bank", OPT_BOOL,
+                         &gpgpu_l2_partition_per_bank,
+                         "with -gpgpu_l2_way_partition, pick the split of "
+                         "each L2 sub partition from its own utility",
+                         "0");
+  option_parser_register(opp, "-gpgpu_l2_partition_policy", OPT_CSTR,
+                         &gpgpu_l2_partition_policy,
+                         "how the utility-based L2 split is chosen "
+                         "(score|lookahead)",
+                         "score");
+  option_parser_register(opp, "-gpgpu_l2_partition_period", OPT_UINT32,
+                         &gpgpu_l2_partition_period,
+                         "cycles between utility-based L2 splits", "50000");
+  option_parser_register(opp, "-gpgpu_l2_umon_sets", OPT_UINT32,
+                         &gpgpu_l2_umon_sets,
+                         "L2 sets per sub partition shadowed to measure "
+                         "utility, 0 = rank the hits of every set",
+                         "0");
+  option_parser_register(opp, "-gpgpu_graphics_pipeline", OPT_BOOL,
+                         &gpgpu_graphics_pipeline,
+                         "launch the fragment kernel of a draw with its "
+                         "vertex kernel, each fragment CTA waits on the "
+                         "vertex CTAs of its tile",
+                         "0");
+  option_parser_register(opp, "-gpgpu_raster_latency", OPT_UINT32,
+                         &gpgpu_raster_latency,
+                         "cycles of primitive setup and rasterization "
+                         "between a vertex CTA retiring and the fragment "
+                         "CTAs waiting on it, with -gpgpu_graphics_pipeline",
+                         "0");
+  option_parser_register(opp, "-gpgpu_tile_binning_window", OPT_UINT32,
+                         &gpgpu_tile_binning_window,
+                         "keep the fragment CTAs of each window x window "
+                         "screen tiles on the SM the first of them issued "
+                         "on, 0 = round robin",
+                         "0");
+  option_parser_register(opp, "-gpgpu_tile_binning_tpc", OPT_BOOL,
+                         &gpgpu_tile_binning_tpc,
+                         "bind the tile windows of -gpgpu_tile_binning_window "
+                         "to a TPC (cluster) in place of an SM",
+                         "0");
   option_parser_register(opp, "-max_cta_per_kernel", OPT_UINT32,
                          &max_cta_per_kernel, "",
                          "1");
   option_parser_register(opp, "-enable_max_cta_per_kernel", OPT_BOOL,
                          &enable_max_cta_per_kernel, "",
                          "0");
+  option_parser_register(opp, "-gpgpu_kernel_select_bench", OPT_BOOL,
+                         &gpgpu_kernel_select_bench,
+                         "report the time spent selecting kernels to issue "
+                         "CTAs from",
+                         "0");
+  option_parser_register(opp, "-gpgpu_kernel_stats", OPT_CSTR,
+                         &gpgpu_kernel_stats,
+                         "stats printed for every finished kernel: full, "
+                         "summary or none (the power model reports with "
+                         "full only)",
+                         "full");
+  option_parser_register(opp, "-gpgpu_kernel_stats_file", OPT_CSTR,
+                         &gpgpu_kernel_stats_file,
+                         "append a JSON line of per-kernel stats to this file "
+                         "for every finished kernel",
+                         "");
+  option_parser_register(opp, "-gpgpu_validation_record", OPT_CSTR,
+                         &gpgpu_validation_record,
+                         "write the cycles, the per-class cache and DRAM "
+                         "counters and the warp hashes of every finished "
+                         "kernel to this file for -gpgpu_validation_check",
+                         "");
+  option_parser_register(opp, "-gpgpu_validation_check", OPT_CSTR,
+                         &gpgpu_validation_check,
+                         "compare every finished kernel with this "
+                         "-gpgpu_validation_record file and stop at the "
+                         "first divergence",
+                         "");
+  option_parser_register(opp, "-gpgpu_validation_warp_interval", OPT_UINT32,
+                         &gpgpu_validation_warp_interval,
+                         "with -gpgpu_validation_record, instructions per "
+                         "hash checkpoint of every warp, 0 for no warp "
+                         "hashes",
+                         "0");
+  option_parser_register(opp, "-gpgpu_counter_sample_file", OPT_CSTR,
+                         &gpgpu_counter_sample_file,
+                         "write a gzip time series of the per-class "
+                         "instructions, L2 hits and DRAM bytes to this file "
+                         "(read by util/plotting/counter_samples.py)",
+                         "");
+  option_parser_register(opp, "-gpgpu_live_stats_file", OPT_CSTR,
+                         &gpgpu_live_stats_file,
+                         "publish a snapshot of the kernel progress, per-class "
+                         "counters and SM partition into this shared mapped "
+                         "file (read by util/job_launching/live_stats.py)",
+                         "");
+  option_parser_register(opp, "-gpgpu_live_stats_period", OPT_UINT32,
+                         &gpgpu_live_stats_period,
+                         "cycles between two -gpgpu_live_stats_file snapshots",
+                         "10000");
+  option_parser_register(opp, "-gpgpu_counter_sample_period", OPT_UINT32,
+                         &gpgpu_counter_sample_period,
+                         "cycles between two rows of "
+                         "-gpgpu_counter_sample_file",
+                         "1000");
+  option_parser_register(opp, "-gpgpu_counter_sample_chunk", OPT_UINT32,
+                         &gpgpu_counter_sample_chunk,
+                         "rows the simulation fills before the writer thread "
+                         "compresses them, four chunks are kept",
+                         "4096");
+  option_parser_register(opp, "-gpgpu_l2_access_log", OPT_CSTR,
+                         &gpgpu_l2_access_log,
+                         "write every L2 tag access to this gzip file, for "
+                         "sweeping the way partitions offline with "
+                         "util/plotting/l2_partition_sweep.py",
+                         "");
+  option_parser_register(opp, "-gpgpu_mem_request_log", OPT_CSTR,
+                         &gpgpu_mem_request_log,
+                         "write every request the memory sub partitions take "
+                         "from the interconnect and every copy to this gzip "
+                         "file, for -gpgpu_mem_replay",
+                         "");
+  option_parser_register(opp, "-gpgpu_mem_replay", OPT_CSTR, &gpgpu_mem_replay,
+                         "replay a -gpgpu_mem_request_log file through the "
+                         "L2s and DRAM without simulating the cores",
+                         "");
+  option_parser_register(opp, "-gpgpu_self_profile", OPT_UINT32,
+                         &gpgpu_self_profile,
+                         "time the phases of every Nth simulated cycle and "
+                         "print the wall time of each at exit (0 = off)",
+                         "0");
+  option_parser_register(opp, "-gpgpu_quiet_options", OPT_BOOL,
+                         &gpgpu_quiet_options,
+                         "do not print the configuration options at startup, "
+                         "for runs of many short jobs",
+                         "0");
+  option_parser_register(opp, "-gpgpu_mem_partition_threads", OPT_UINT32,
+                         &gpgpu_mem_partition_threads,
+                         "threads that cycle the DRAM of the memory partitions "
+                         "(1 = serial)",
+                         "1");
+  option_parser_register(opp, "-gpgpu_core_cluster_threads", OPT_UINT32,
+                         &gpgpu_core_cluster_threads,
+                         "threads that cycle the SIMT clusters of the core "
+                         "clock (1 = serial)",
+                         "1");
+  option_parser_register(opp, "-gpgpu_skip_idle_core_cycles", OPT_BOOL,
+                         &gpgpu_skip_idle_core_cycles,
+                         "skip evaluating the shader cores while none holds a "
+                         "thread and no CTA can be issued",
+                         "0");
+  option_parser_register(opp, "-gpgpu_cluster_clock_scale", OPT_CSTR,
+                         &gpgpu_cluster_clock_scale,
+                         "frequency of each SIMT cluster relative to the core "
+                         "clock, comma separated, the last repeats "
+                         "(empty = all at the core clock)",
+                         "");
+  option_parser_register(opp, "-gpgpu_class_clock_scale", OPT_CSTR,
+                         &gpgpu_class_clock_scale,
+                         "<graphics>:<compute> frequency relative to the core "
+                         "clock of the clusters of each class in the MPS and "
+                         "tenant partitioned modes (empty = off)",
+                         "");
   option_parser_register(
       opp, "-gpgpu_deadlock_detect", OPT_BOOL, &gpu_deadlock_detect,
       "Stop the simulation at deadlock (1=on (default), 0=off)", "1");
+  option_parser_register(opp, "-gpgpu_deadlock_check_interval", OPT_UINT32,
+                         &gpu_deadlock_check_interval,
+                         "cycles without a committed instruction before a "
+                         "deadlock is detected (0 = never)",
+                         "100000");
   option_parser_register(
       opp, "-gpgpu_ptx_instruction_classification", OPT_INT32,
       &(gpgpu_ctx->func_sim->gpgpu_ptx_instruction_classification),
@@ -763,6 +1276,11 @@ void gpgpu_sim_config::reg_options(option_parser_t opp) {
       opp, "-visualizer_zlevel", OPT_INT32, &g_visualizer_zlevel,
       "Compression level of the visualizer output log (0=no comp, 9=highest)",
       "6");
+  option_parser_register(opp, "-visualizer_binary", OPT_BOOL,
+                         &g_visualizer_binary,
+                         "write the visualizer log as per-kernel and per-class "
+                         "binary columns (read by aerialvision/binaryvis.py)",
+                         "0");
   option_parser_register(opp, "-gpgpu_stack_size_limit", OPT_INT32,
                          &stack_size_limit, "GPU thread stack size", "1024");
   option_parser_register(opp, "-gpgpu_heap_size_limit", OPT_INT32,
@@ -811,6 +1329,29 @@ bool sort_kernel_info(kernel_info_t *d1, kernel_info_t *d2) {
   return d1->get_uid() < d2->get_uid();
 }
 
+// wall time spent choosing kernels, only sampled with
+// -gpgpu_kernel_select_bench
+class select_kernel_timer {
+ public:
+  select_kernel_timer(gpgpu_sim *gpu)
+      : m_gpu(gpu), m_enabled(gpu->get_config().kernel_select_bench()) {
+    if (m_enabled) clock_gettime(CLOCK_MONOTONIC, &m_start);
+  }
+  ~select_kernel_timer() {
+    if (!m_enabled) return;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    m_gpu->m_select_kernel_ns += (end.tv_sec - m_start.tv_sec) * 1000000000ull +
+                                 end.tv_nsec - m_start.tv_nsec;
+    m_gpu->m_select_kernel_calls++;
+  }
+
+ private:
+  gpgpu_sim *m_gpu;
+  bool m_enabled;
+  struct timespec m_start;
+};
+
 void gpgpu_sim::launch(kernel_info_t *kinfo) {
   unsigned cta_size = kinfo->threads_per_cta();
   if (cta_size > m_shader_config->n_thread_per_shader) {
@@ -830,24 +1371,83 @@ void gpgpu_sim::launch(kernel_info_t *kinfo) {
   unsigned n = 0;
   for (n = 0; n < m_running_kernels.size(); n++) {
     if ((NULL == m_running_kernels[n]) || m_running_kernels[n]->done()) {
+      if (m_running_kernels[n])
+        remove_running(m_running_kernels[n]);
       m_running_kernels[n] = kinfo;
       m_uid_to_kernel_info[kinfo->get_uid()] = kinfo;
       break;
     }
   }
   assert(n < m_running_kernels.size());
-  for (n = 0; n < m_running_kernels.size(); n++) {
-    // find the last one that is not null
-    if (m_running_kernels[n] == NULL) {
-      break;
-    }
+  m_num_running_kernels++;
+  if (kinfo->is_graphic_kernel) m_vertex_buffers.kernel_launched(*kinfo);
+  if (m_compression.enabled()) m_compression.kernel_launched(kinfo->get_uid());
+  if (!kinfo->is_graphic_kernel) m_num_running_compute++;
+#ifdef GPGPUSIM_POWER_MODEL
+  if (m_class_energy)
+    m_class_energy->kernel_started(kinfo->get_uid(), kinfo->is_graphic_kernel);
+#endif
+  if (kinfo->is_graphic_kernel) {
+    // the modeled cycles corrected by the error graphics kernels showed
+    // against the model so far
+    std::unordered_map<unsigned, unsigned long long>::const_iterator last =
+        last_frame_kernels_elapsed_time.find(kinfo->get_uid());
+    if (last != last_frame_kernels_elapsed_time.end() && last->second)
+      predicted_kernel_cycles[kinfo->get_uid()] =
+          last->second * std::max(1 + m_graphics_error_avg, 0.1);
+  }
+
+  if (m_hybrid.models(*kinfo)) {
+    // -gpgpu_hybrid_fidelity: for the modeled cycles, none of its CTAs issue
+    std::unordered_map<unsigned, unsigned long long>::const_iterator modeled =
+        last_frame_kernels_elapsed_time.find(kinfo->get_uid());
+    m_hybrid.kernel_launched(
+        kinfo,
+        modeled != last_frame_kernels_elapsed_time.end() ? modeled->second : 0,
+        gpu_sim_cycle + gpu_tot_sim_cycle);
+  } else if (!kinfo->no_more_ctas_to_run()) {
+    std::vector<kernel_info_t *> &runnable = runnable_list(kinfo);
+    runnable.insert(std::upper_bound(runnable.begin(), runnable.end(), kinfo,
+                                     sort_kernel_info),
+                    kinfo);
   }
+  if (kinfo->m_kernel_TB_latency) m_latency_kernels.push_back(kinfo);
+  m_l1_carveout.update(m_running_kernels);
+}
 
-  // only sort the part that is not null
-  std::sort(m_running_kernels.begin(), m_running_kernels.begin() + n, sort_kernel_info);
+void gpgpu_sim::remove_running(kernel_info_t *kernel) {
+  std::vector<kernel_info_t *> &runnable = runnable_list(kernel);
+  runnable.erase(std::remove(runnable.begin(), runnable.end(), kernel),
+                 runnable.end());
+  m_latency_kernels.erase(std::remove(m_latency_kernels.begin(),
+                                      m_latency_kernels.end(), kernel),
+                          m_latency_kernels.end());
+  m_num_running_kernels--;
+  if (!kernel->is_graphic_kernel) m_num_running_compute--;
+}
+
+void gpgpu_sim::cta_issued(kernel_info_t *kernel) {
+  if (!kernel->is_graphic_kernel) m_resident_compute_ctas++;
+  else if (!m_raster_pipeline.empty())
+    m_raster_pipeline.cta_issued(kernel->get_uid());
+  if (!kernel->no_more_ctas_to_run()) return;
+  std::vector<kernel_info_t *> &runnable = runnable_list(kernel);
+  std::vector<kernel_info_t *>::iterator k =
+      std::find(runnable.begin(), runnable.end(), kernel);
+  if (k != runnable.end()) runnable.erase(k);
+}
+
+void gpgpu_sim::cta_retired(kernel_info_t *kernel) {
+  if (!kernel->is_graphic_kernel && m_resident_compute_ctas)
+    m_resident_compute_ctas--;
+  if (kernel->is_graphic_kernel && m_config.gpgpu_graphics_pipeline)
+    m_raster_pipeline.cta_retired(kernel->get_uid(),
+                                  gpu_sim_cycle + gpu_tot_sim_cycle);
 }
 
 bool gpgpu_sim::can_start_kernel() {
+  if (m_num_running_kernels < m_running_kernels.size()) return true;
+  // a kernel can be done before its completion is handled
   for (unsigned n = 0; n < m_running_kernels.size(); n++) {
     if ((NULL == m_running_kernels[n]) || m_running_kernels[n]->done())
       return true;
@@ -872,6 +1472,9 @@ bool gpgpu_sim::kernel_more_cta_left(kernel_info_t *kernel) const {
     return false;
   }
 
+  // -gpgpu_hybrid_fidelity runs the kernel without its CTAs
+  if (kernel && m_hybrid.models(*kernel)) return false;
+
   if (kernel && !kernel->no_more_ctas_to_run()) return true;
 
   return false;
@@ -880,144 +1483,151 @@ bool gpgpu_sim::kernel_more_cta_left(kernel_info_t *kernel) const {
 bool gpgpu_sim::get_more_cta_left() const {
   if (hit_max_cta_count()) return false;
 
-  for (unsigned n = 0; n < m_running_kernels.size(); n++) {
-    if (m_running_kernels[n] && !m_running_kernels[n]->no_more_ctas_to_run())
-      return true;
-  }
+  // the runnable lists only hold kernels with CTAs left, the check covers
+  // CTAs issued without going through cta_issued()
+  for (unsigned n = 0; n < m_runnable_graphics.size(); n++)
+    if (!m_runnable_graphics[n]->no_more_ctas_to_run()) return true;
+  for (unsigned n = 0; n < m_runnable_compute.size(); n++)
+    if (!m_runnable_compute[n]->no_more_ctas_to_run()) return true;
   return false;
 }
 
 void gpgpu_sim::decrement_kernel_latency() {
-  for (unsigned n = 0; n < m_running_kernels.size(); n++) {
-    if (m_running_kernels[n] && m_running_kernels[n]->m_kernel_TB_latency)
-      m_running_kernels[n]->m_kernel_TB_latency--;
+  for (unsigned n = 0; n < m_latency_kernels.size();) {
+    if (--m_latency_kernels[n]->m_kernel_TB_latency) {
+      n++;
+      continue;
+    }
+    m_latency_kernels[n] = m_latency_kernels.back();
+    m_latency_kernels.pop_back();
   }
 }
 
-kernel_info_t *gpgpu_sim::select_kernel(unsigned core_id) {
-  unsigned idx = -1;
-  unsigned graphics_count =
-      m_config.num_shader() * dynamic_sm_count / concurrent_granularity;
+bool gpgpu_sim::core_domain_idle() const {
+  // kernels with CTAs left are all still counting down their launch latency
+  for (unsigned n = 0; n < m_runnable_graphics.size(); n++)
+    if (!m_runnable_graphics[n]->no_more_ctas_to_run() &&
+        !m_runnable_graphics[n]->m_kernel_TB_latency)
+      return false;
+  for (unsigned n = 0; n < m_runnable_compute.size(); n++)
+    if (!m_runnable_compute[n]->no_more_ctas_to_run() &&
+        !m_runnable_compute[n]->m_kernel_TB_latency)
+      return false;
+  return m_running_sms.empty();
+}
 
-  if (core_id < graphics_count) {
-    for (unsigned i = 0; i < m_running_kernels.size(); i++) {
-      unsigned id = i;
-      // (i + m_last_issued_kernel + 1) % m_config.max_concurrent_kernel;
-      if(!m_running_kernels[id]) {
-        continue;
-      }
-      if (!m_running_kernels[id]->is_graphic_kernel) {
-        // if not graphics
-        continue;
-      }
-      if (m_finished_kernels.find(m_running_kernels[id]->prerequisite_kernel) !=
-              m_finished_kernels.end() ||
-          m_running_kernels[id]->prerequisite_kernel == -1) {
-        idx = id;
-        m_last_issued_kernel = idx;
-        break;
-      }
-    }
+void gpgpu_sim::set_sm_running(unsigned sid, bool running) {
+  std::vector<unsigned>::iterator it =
+      std::lower_bound(m_running_sms.begin(), m_running_sms.end(), sid);
+  unsigned &cluster_count =
+      m_cluster_running_sms[m_shader_config->sid_to_cluster(sid)];
+  if (running) {
+    assert(it == m_running_sms.end() || *it != sid);
+    m_running_sms.insert(it, sid);
+    cluster_count++;
   } else {
-    for (unsigned i = 0; i < m_running_kernels.size(); i++) {
-      unsigned id = i;
-      // (i + m_last_issued_kernel + 1) % m_config.max_concurrent_kernel;
-      if(!m_running_kernels[id]) {
-        continue;
-      }
-      if (m_running_kernels[id]->is_graphic_kernel) {
-        // if this graphics
-        continue;
-      }
-      if (m_finished_kernels.find(m_running_kernels[id]->prerequisite_kernel) !=
-              m_finished_kernels.end() ||
-          m_running_kernels[id]->prerequisite_kernel == -1) {
-        idx = id;
-        m_last_issued_kernel = idx;
-        break;
-      }
-    }
+    assert(it != m_running_sms.end() && *it == sid);
+    m_running_sms.erase(it);
+    assert(cluster_count);
+    cluster_count--;
   }
+}
 
-  if (idx == (unsigned)-1) {
-    return NULL;
-  }
-  if (m_running_kernels[idx] &&
-      !m_running_kernels[idx]->no_more_ctas_to_run() &&
-      !m_running_kernels[idx]->m_kernel_TB_latency) {
-    unsigned launch_uid = m_running_kernels[idx]->get_uid();
-    if (std::find(m_executed_kernel_uids.begin(), m_executed_kernel_uids.end(),
-                  launch_uid) == m_executed_kernel_uids.end()) {
-      m_running_kernels[idx]->start_cycle = gpu_sim_cycle + gpu_tot_sim_cycle;
+kernel_info_t *gpgpu_sim::issue_selected(kernel_info_t *kernel) {
+  if (kernel && !kernel->no_more_ctas_to_run() &&
+      !kernel->m_kernel_TB_latency) {
+    unsigned launch_uid = kernel->get_uid();
+    if (m_executed_kernel_uid_set.insert(launch_uid).second) {
+      kernel->start_cycle = gpu_sim_cycle + gpu_tot_sim_cycle;
       m_executed_kernel_uids.push_back(launch_uid);
-      m_executed_kernel_names.push_back(m_running_kernels[idx]->name());
+      m_executed_kernel_names.push_back(kernel->name());
     }
-    return m_running_kernels[idx];
+    return kernel;
   }
   return NULL;
 }
-kernel_info_t *gpgpu_sim::select_kernel(shader_core_ctx *core) {
-  unsigned idx = -1;
-  unsigned graphics_count = 0;
-  unsigned graphics_done_count = 0;
-  for (unsigned i = 0; i < m_running_kernels.size(); i++) {
-    if (m_running_kernels[i] && m_running_kernels[i]->is_graphic_kernel) {
-      graphics_count++;
+
+bool gpgpu_sim::sm_runs_graphics(unsigned sid) const {
+  if (!m_sm_tenant.empty()) return m_sm_tenant[sid] == 0;
+  if (!m_sm_graphics.empty()) return m_sm_graphics[sid];
+  // no split before main sets the concurrent mode
+  return concurrent_granularity &&
+         sid < m_config.num_shader() * dynamic_sm_count / concurrent_granularity;
+}
+
+void gpgpu_sim::set_sm_quota(unsigned sid, const sm_resources quota[2]) {
+  m_cluster[m_shader_config->sid_to_cluster(sid)]
+      ->get_core(m_shader_config->sid_to_cid(sid))
+      ->pin_class_quotas(quota);
+}
+
+void gpgpu_sim::clear_sm_quota(unsigned sid) {
+  m_cluster[m_shader_config->sid_to_cluster(sid)]
+      ->get_core(m_shader_config->sid_to_cid(sid))
+      ->unpin_class_quotas();
+}
+
+kernel_info_t *gpgpu_sim::select_kernel(unsigned sid) {
+  select_kernel_timer timer(this);
+  bool graphics = sm_runs_graphics(sid);
+  if (!m_sm_graphics.empty()) {
+    unsigned long long now = gpu_sim_cycle + gpu_tot_sim_cycle;
+    if (m_sm_draining[sid]) {
+      // a moved SM takes no CTA of its new class before its old ones retire
+      shader_core_ctx *core =
+          m_cluster[m_shader_config->sid_to_cluster(sid)]->get_core(
+              m_shader_config->sid_to_cid(sid));
+      unsigned old_ctas =
+          graphics ? core->m_occupied_ctas - core->m_occupied_graphics_ctas
+                   : core->m_occupied_graphics_ctas;
+      if (old_ctas) return NULL;
+      m_sm_draining[sid] = false;
+      m_sm_ready_cycle[sid] = now + m_config.gpgpu_sm_migration_cycles;
     }
+    if (now < m_sm_ready_cycle[sid]) return NULL;
   }
-  for (unsigned i = 0; i < m_running_kernels.size(); i++) {
-    unsigned id =
-        i;
-        // (i + m_last_issued_kernel + 1) % m_config.max_concurrent_kernel;
-    if (m_running_kernels[id] && core->can_issue_1block(*m_running_kernels[id]) &&
-        (m_finished_kernels.find(m_running_kernels[id]->prerequisite_kernel) !=
-             m_finished_kernels.end() ||
-         m_running_kernels[id]->prerequisite_kernel == -1)) {
-      // kernel is graphic && (prerequisite satisfied || no prerequisite)
-      if (m_running_kernels[id]->no_more_ctas_to_run()) {
-        if (m_running_kernels[id]->is_graphic_kernel) {
-          // graphics are all done. run compute only
-          graphics_done_count++;
-        } else {
-          // computes are all done. run graphics only
-          compute_done = true;
-        }
-        continue;
-      }
-      idx = id;
-      m_last_issued_kernel = idx;
-      break;
-    }
+  if (!graphics && compute_cta_throttled()) return NULL;
+  const std::vector<kernel_info_t *> &runnable =
+      graphics ? m_runnable_graphics : m_runnable_compute;
+  // with tenant SMs, only kernels of the SM's own tenant
+  bool any_tenant = m_sm_tenant.empty();
+  unsigned tenant = any_tenant ? 0 : m_sm_tenant[sid];
+
+  for (unsigned i = 0; i < runnable.size(); i++) {
+    if ((any_tenant || runnable[i]->tenant == tenant) &&
+        !runnable[i]->no_more_ctas_to_run() &&
+        prerequisite_done(runnable[i]))
+      return issue_selected(runnable[i]);
   }
-  if (graphics_done_count == graphics_count) {
+  return NULL;
+}
+
+kernel_info_t *gpgpu_sim::select_kernel(shader_core_ctx *core) {
+  select_kernel_timer timer(this);
+  if (m_runnable_graphics.empty()) {
+    // graphics are all done. run compute only
     graphics_done = true;
   }
+  if (m_runnable_compute.size() < m_num_running_compute) {
+    // computes are all done. run graphics only
+    compute_done = true;
+  }
 
-  // for (unsigned i = 0; i < m_running_kernels.size(); i++) {
-  //   if (m_running_kernels[i] && !m_running_kernels[i]->no_more_ctas_to_run() &&
-  //       (m_finished_kernels.find(m_running_kernels[i]->prerequisite_kernel) !=
-  //            m_finished_kernels.end() ||
-  //        m_running_kernels[i]->prerequisite_kernel == -1)) {
-  //     // prerequisite satisfied || no prerequisite - eligible to issue
-  //     idx = i;
-  //     break;
-  //   }
-  // }
-  
-  if (idx == (unsigned)-1) {
-    return NULL;
-  }
-  if (m_running_kernels[idx] &&
-      !m_running_kernels[idx]->no_more_ctas_to_run() &&
-      !m_running_kernels[idx]->m_kernel_TB_latency) {
-    unsigned launch_uid = m_running_kernels[idx]->get_uid();
-    if (std::find(m_executed_kernel_uids.begin(), m_executed_kernel_uids.end(),
-                  launch_uid) == m_executed_kernel_uids.end()) {
-      m_running_kernels[idx]->start_cycle = gpu_sim_cycle + gpu_tot_sim_cycle;
-      m_executed_kernel_uids.push_back(launch_uid);
-      m_executed_kernel_names.push_back(m_running_kernels[idx]->name());
-    }
-    return m_running_kernels[idx];
+  // oldest kernel first across both classes
+  unsigned g = 0;
+  unsigned c = 0;
+  while (g < m_runnable_graphics.size() || c < m_runnable_compute.size()) {
+    kernel_info_t *k;
+    if (c == m_runnable_compute.size() ||
+        (g < m_runnable_graphics.size() &&
+         sort_kernel_info(m_runnable_graphics[g], m_runnable_compute[c])))
+      k = m_runnable_graphics[g++];
+    else
+      k = m_runnable_compute[c++];
+    if (!k->is_graphic_kernel && compute_cta_throttled()) continue;
+    if (!k->no_more_ctas_to_run() && core->can_issue_1block(*k) &&
+        prerequisite_done(k))
+      return issue_selected(k);
   }
   return NULL;
 }
@@ -1025,10 +1635,10 @@ kernel_info_t *gpgpu_sim::select_kernel(shader_core_ctx *core) {
 kernel_info_t *gpgpu_sim::select_kernel() {
   if (m_running_kernels[m_last_issued_kernel] &&
       !m_running_kernels[m_last_issued_kernel]->no_more_ctas_to_run() &&
+      !m_hybrid.models(*m_running_kernels[m_last_issued_kernel]) &&
       !m_running_kernels[m_last_issued_kernel]->m_kernel_TB_latency) {
     unsigned launch_uid = m_running_kernels[m_last_issued_kernel]->get_uid();
-    if (std::find(m_executed_kernel_uids.begin(), m_executed_kernel_uids.end(),
-                  launch_uid) == m_executed_kernel_uids.end()) {
+    if (m_executed_kernel_uid_set.insert(launch_uid).second) {
       m_running_kernels[m_last_issued_kernel]->start_cycle =
           gpu_sim_cycle + gpu_tot_sim_cycle;
       m_executed_kernel_uids.push_back(launch_uid);
@@ -1048,9 +1658,9 @@ kernel_info_t *gpgpu_sim::select_kernel() {
       // record this kernel for stat print if it is the first time this kernel
       // is selected for execution
       unsigned launch_uid = m_running_kernels[idx]->get_uid();
-      assert(std::find(m_executed_kernel_uids.begin(),
-                       m_executed_kernel_uids.end(),
-                       launch_uid) == m_executed_kernel_uids.end());
+      bool first_issue = m_executed_kernel_uid_set.insert(launch_uid).second;
+      assert(first_issue);
+      (void)first_issue;
       m_executed_kernel_uids.push_back(launch_uid);
       m_executed_kernel_names.push_back(m_running_kernels[idx]->name());
 
@@ -1084,24 +1694,48 @@ void gpgpu_sim::set_kernel_done(kernel_info_t *kernel) {
              m_finished_kernels.end());
       m_finished_kernels[kernel->get_uid()] = 1;
       if (kernel->is_graphic_kernel) {
+        m_vertex_buffers.kernel_done(*kernel);
+        m_tile_binning.kernel_done(*kernel);
+        m_multi_gpu.kernel_done(*kernel);
+        m_raster_pipeline.kernel_done(kernel->get_uid(),
+                                      kernel->end_cycle);
         frame_finished_graphics.push_back(kernel->get_uid());
       } else {
         frame_finished_computes.push_back(kernel->get_uid());
       }
       frame_kernels_elapsed_time[kernel->get_uid()] = kernel_cycle;
+      m_l1_carveout.update(m_running_kernels);
+      m_frame_persistence.kernel_done(kernel->is_graphic_kernel);
+      if (m_hybrid.enabled()) m_hybrid.kernel_done(kernel);
 
       // predict frame & compute time
       unsigned uid = kernel->get_uid();
       unsigned long long last_frame_cycle =
           last_frame_kernels_elapsed_time[uid];
-      double error = (double)kernel_cycle - (double)last_frame_cycle;
       // if error positive, current frame is slower, need to decrease
       // confident
       printf("STEP1 - kernel %u finished, cycle: %llu, last frame: %llu\n",
              kernel->get_uid(), kernel_cycle, last_frame_cycle);
-      confident = confident - error / 10000.0;
+#ifdef GPGPUSIM_POWER_MODEL
+      if (m_class_energy)
+        printf("gpu_power_kernel_energy[%u] = %.6e J\n", kernel->get_uid(),
+               m_class_energy->kernel_done(kernel->get_uid()));
+#endif
+      if (kernel->is_graphic_kernel && last_frame_cycle) {
+        double error =
+            ((double)kernel_cycle - last_frame_cycle) / last_frame_cycle;
+        grpahics_error[uid] = error;
+        m_graphics_error_avg = 0.75 * m_graphics_error_avg + 0.25 * error;
+        // confident follows how close the corrected predictions come
+        double predicted = predicted_kernel_cycles.count(uid)
+                               ? predicted_kernel_cycles[uid]
+                               : last_frame_cycle;
+        double miss = std::fabs(kernel_cycle - predicted) / predicted;
+        confident = 0.75 * confident + 0.25 * std::max(0.0, 1.0 - miss);
+      }
       // printf("STEP1 - kernel %u finished, error: %f, confident %f\n",
-      //        kernel->get_uid(), error, confident);
+      //        kernel->get_uid(), grpahics_error[uid], confident);
+      remove_running(kernel);
       *k = NULL;
       break;
     }
@@ -1120,6 +1754,12 @@ void gpgpu_sim::stop_all_running_kernels() {
 }
 
 void exec_gpgpu_sim::createSIMTCluster() {
+  // the functional model of the PTX mode is shared by all the clusters
+  if (m_config.parallel_core_clusters()) {
+    fprintf(stderr, "GPGPU-Sim: -gpgpu_core_cluster_threads needs trace "
+                    "driven simulation\n");
+    exit(1);
+  }
   m_cluster = new simt_core_cluster *[m_shader_config->n_simt_clusters];
   for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++)
     m_cluster[i] =
@@ -1127,14 +1767,46 @@ void exec_gpgpu_sim::createSIMTCluster() {
                                    m_shader_stats, m_memory_stats);
 }
 
+// a ',' separated count per tenant such as -gpgpu_tenant_sms, returns the
+// number of tenants
+static unsigned parse_tenant_counts(const char *option, const char *name,
+                                    unsigned counts[MAX_TENANTS]) {
+  unsigned tenants = 0;
+  for (const char *p = option; *p;) {
+    unsigned count;
+    int n;
+    if (tenants == MAX_TENANTS || sscanf(p, "%u%n", &count, &n) != 1) {
+      fprintf(stderr, "GPGPU-Sim: bad %s %s, at most %d tenants\n", name,
+              option, MAX_TENANTS);
+      exit(1);
+    }
+    counts[tenants++] = count;
+    p += n;
+    if (*p == ',') p++;
+  }
+  return tenants;
+}
+
 gpgpu_sim::gpgpu_sim(const gpgpu_sim_config &config, gpgpu_context *ctx)
-    : gpgpu_t(config, ctx), m_config(config) {
+    : gpgpu_t(config, ctx),
+      m_config(config),
+      m_vertex_buffers(this),
+      m_frame_persistence(this),
+      m_l1_carveout(this) {
   gpgpu_ctx = ctx;
+  m_raster_pipeline.set_latency(m_config.gpgpu_raster_latency);
+  m_tile_binning.configure(m_config.gpgpu_tile_binning_window,
+                           m_config.gpgpu_tile_binning_tpc);
+  m_frame_persistence.configure(m_config.gpgpu_frame_persistence);
   m_shader_config = &m_config.m_shader_config;
   m_memory_config = &m_config.m_memory_config;
+  m_compression.configure(m_memory_config);
+  m_sm_gating.configure(m_shader_config);
   ctx->ptx_parser->set_ptx_warp_size(m_shader_config);
   ptx_file_line_stats_create_exposed_latency_tracker(m_config.num_shader());
 
+  m_class_energy = NULL;
+  m_power_trace = NULL;
 #ifdef GPGPUSIM_POWER_MODEL
   m_gpgpusim_wrapper = new gpgpu_sim_wrapper(config.g_power_simulation_enabled,
                                              config.g_power_config_name, config.g_power_simulation_mode, config.g_dvfs_enabled);
@@ -1143,6 +1815,33 @@ gpgpu_sim::gpgpu_sim(const gpgpu_sim_config &config, gpgpu_context *ctx)
   m_shader_stats = new shader_core_stats(m_shader_config);
   m_memory_stats = new memory_stats_t(m_config.num_shader(), m_shader_config,
                                       m_memory_config, this);
+#ifdef GPGPUSIM_POWER_MODEL
+  if (config.g_power_simulation_enabled && !config.g_power_simulation_mode) {
+    m_class_energy = new class_energy([this](class_activity a[2]) {
+      for (unsigned c = 0; c < 2; c++) {
+        a[c].domain[gpgpu_sim_wrapper::CORE_DOMAIN] = class_thread_insts(c);
+        a[c].domain[gpgpu_sim_wrapper::L2_DOMAIN] = l2_class_accesses[c];
+        a[c].domain[gpgpu_sim_wrapper::MEM_DOMAIN] =
+            m_memory_stats->dram_class_accesses[c];
+        a[c].domain[gpgpu_sim_wrapper::NOC_DOMAIN] =
+            m_memory_stats->icnt_class_injected_bytes[0][c] +
+            m_memory_stats->icnt_class_injected_bytes[1][c];
+        a[c].domain[gpgpu_sim_wrapper::SHARED_DOMAIN] = 0;
+      }
+    });
+  }
+  if (config.g_power_simulation_enabled && config.g_power_trace_enabled &&
+      config.g_power_trace_binary) {
+    if (!config.g_power_trace_window) {
+      fprintf(stderr, "GPGPU-Sim: -power_trace_window must be positive\n");
+      exit(1);
+    }
+    m_power_trace = new power_trace_stream(
+        m_gpgpusim_wrapper, config.g_power_trace_filename,
+        config.gpu_stat_sample_freq, config.g_power_trace_window,
+        config.g_power_trace_zlevel);
+  }
+#endif
   average_pipeline_duty_cycle = (float *)malloc(sizeof(float));
   active_sms = (float *)malloc(sizeof(float));
   m_power_stats =
@@ -1160,6 +1859,12 @@ gpgpu_sim::gpgpu_sim(const gpgpu_sim_config &config, gpgpu_context *ctx)
 
   gpu_stall_dramfull = 0;
   gpu_stall_icnt2sh = 0;
+  gpu_skipped_core_cycles = 0;
+  m_warm_accesses[0] = m_warm_accesses[1] = 0;
+  for (unsigned c = 0; c < 2; c++)
+    m_replay_requests[c] = m_replay_replies[c] = m_replay_latency[c] = 0;
+  m_replay_has_next = false;
+  m_warm_hits[0] = m_warm_hits[1] = 0;
   partiton_reqs_in_parallel = 0;
   partiton_reqs_in_parallel_total = 0;
   partiton_reqs_in_parallel_util = 0;
@@ -1171,6 +1876,8 @@ gpgpu_sim::gpgpu_sim(const gpgpu_sim_config &config, gpgpu_context *ctx)
 
   l2_gr_access = 0;
   l2_cp_access = 0;
+  for (unsigned c = 0; c < 2; c++) l2_class_accesses[c] = l2_class_hits[c] = 0;
+  for (unsigned c = 0; c < 2; c++) l1_class_accesses[c] = l1_class_hits[c] = 0;
 
   m_memory_partition_unit =
       new memory_partition_unit *[m_memory_config->m_n_mem];
@@ -1187,6 +1894,261 @@ gpgpu_sim::gpgpu_sim(const gpgpu_sim_config &config, gpgpu_context *ctx)
           m_memory_partition_unit[i]->get_sub_partition(p);
     }
   }
+  m_mmu.configure(m_memory_config, m_shader_config->num_shader(),
+                  m_memory_config->m_n_mem_sub_partition);
+  m_copy_engine.configure(m_memory_config,
+                          m_memory_config->m_n_mem_sub_partition);
+  m_multi_gpu.configure(m_memory_config,
+                        m_shader_config->n_simt_clusters,
+                        m_memory_config->m_n_mem_sub_partition);
+  m_hybrid.configure(m_memory_config, m_memory_config->m_n_mem_sub_partition);
+  m_partition_pool = NULL;
+  if (m_config.gpgpu_mem_partition_threads > 1) {
+    m_partition_pool = new sim_thread_pool(std::min(
+        m_config.gpgpu_mem_partition_threads, m_memory_config->m_n_mem));
+    for (unsigned i = 0; i < m_memory_config->m_n_mem; i++)
+      m_memory_partition_unit[i]->set_defer_dram_stats(true);
+  }
+  m_cluster_pool = NULL;
+  if (m_config.gpgpu_core_cluster_threads > 1) {
+    // these reach into other clusters or shared state from the core cycle
+    const char *unsupported = NULL;
+    if (m_shader_config->gpgpu_l1_carveout_dynamic)
+      unsupported = "-gpgpu_l1_carveout_dynamic";
+    else if (m_shader_config->m_L1D_config.m_graphics_percent &&
+             m_config.gpgpu_utility)
+      unsupported = "L1D graphics partitioning";
+    else if (m_mmu.enabled())
+      unsupported = "-gpgpu_tlb";
+    else if (m_config.gpgpu_self_profile)
+      unsupported = "-gpgpu_self_profile";
+    if (unsupported) {
+      fprintf(stderr,
+              "GPGPU-Sim: -gpgpu_core_cluster_threads does not support %s\n",
+              unsupported);
+      exit(1);
+    }
+    m_cluster_pool = new sim_thread_pool(std::min(
+        m_config.gpgpu_core_cluster_threads, m_shader_config->n_simt_clusters));
+    m_cluster_cycled.resize(m_shader_config->n_simt_clusters, 0);
+    aggregated_l1_stats.set_shared(true);
+  }
+  m_l2_partition_policy = NULL;
+  m_l2_partition_last_sample = 0;
+  m_slicer_policy = NULL;
+  if (m_config.gpgpu_slicer) {
+    m_slicer_policy = slicer_policy::create(m_config.gpgpu_slicer_policy);
+    if (!m_slicer_policy) {
+      fprintf(stderr, "GPGPU-Sim: unknown -gpgpu_slicer_policy %s\n",
+              m_config.gpgpu_slicer_policy);
+      exit(1);
+    }
+    // half of the cores sample each class
+    assert(m_shader_config->num_shader() >= 2);
+  }
+  m_sm_quota_policy = NULL;
+  m_mig_sm_count = m_mig_granularity = -1;
+  if (m_shader_config->gpgpu_concurrent_kernel_sm)
+    m_sm_quota_policy = sm_quota_policy::create(
+        !m_shader_config->gpgpu_concurrent_finegrain
+            ? "mps"
+            : m_config.gpgpu_slicer ? "slicer" : "finegrain");
+  if (!parse_kernel_stats_level(m_config.gpgpu_kernel_stats,
+                                m_kernel_stats_level)) {
+    fprintf(stderr, "GPGPU-Sim: unknown -gpgpu_kernel_stats %s\n",
+            m_config.gpgpu_kernel_stats);
+    exit(1);
+  }
+  if (m_config.gpgpu_kernel_stats_file[0] &&
+      !m_kernel_stats_log.open(m_config.gpgpu_kernel_stats_file)) {
+    fprintf(stderr, "GPGPU-Sim: cannot write -gpgpu_kernel_stats_file %s\n",
+            m_config.gpgpu_kernel_stats_file);
+    exit(1);
+  }
+  m_validation.configure(m_config.gpgpu_validation_record,
+                         m_config.gpgpu_validation_check,
+                         m_config.gpgpu_validation_warp_interval);
+  if (m_config.gpgpu_counter_sample_file[0]) {
+    if (!m_config.gpgpu_counter_sample_period ||
+        !m_config.gpgpu_counter_sample_chunk) {
+      fprintf(stderr,
+              "GPGPU-Sim: -gpgpu_counter_sample_period and "
+              "-gpgpu_counter_sample_chunk must be positive\n");
+      exit(1);
+    }
+    add_sampled_counters();
+    if (!m_counter_sampler.open(m_config.gpgpu_counter_sample_file,
+                                m_config.gpgpu_counter_sample_period,
+                                m_config.gpgpu_counter_sample_chunk, 4)) {
+      fprintf(stderr,
+              "GPGPU-Sim: cannot write -gpgpu_counter_sample_file %s\n",
+              m_config.gpgpu_counter_sample_file);
+      exit(1);
+    }
+  }
+  if (m_config.gpgpu_live_stats_file[0] &&
+      (!m_config.gpgpu_live_stats_period ||
+       !m_live_stats.open(m_config.gpgpu_live_stats_file,
+                          m_config.gpgpu_live_stats_period))) {
+    fprintf(stderr,
+            "GPGPU-Sim: cannot map -gpgpu_live_stats_file %s with a positive "
+            "-gpgpu_live_stats_period\n",
+            m_config.gpgpu_live_stats_file);
+    exit(1);
+  }
+  if (m_config.g_visualizer_enabled && m_config.g_visualizer_binary) {
+    visualizer_binary &v = m_visualizer_binary;
+    v.add_constant("num_sms", m_shader_config->num_shader());
+    v.add_constant("warp_size", m_shader_config->warp_size);
+    v.add_constant("max_warps_per_sm", m_shader_config->max_warps_per_shader);
+    v.add_constant("num_mem_partitions", m_memory_config->m_n_mem);
+    v.add_constant("sample_freq", m_config.gpu_stat_sample_freq);
+    if (!v.open(m_config.g_visualizer_filename, m_config.g_visualizer_zlevel)) {
+      fprintf(stderr, "GPGPU-Sim: cannot write -visualizer_outputfile %s\n",
+              m_config.g_visualizer_filename);
+      exit(1);
+    }
+  }
+  if (m_config.gpgpu_l2_access_log[0] &&
+      !m_l2_access_log.open(m_config.gpgpu_l2_access_log,
+                            m_memory_config->m_n_mem_sub_partition,
+                            m_memory_config->m_L2_config.get_nset(),
+                            m_memory_config->m_L2_config.get_assoc(),
+                            m_memory_config->m_L2_config.get_line_sz())) {
+    fprintf(stderr, "GPGPU-Sim: cannot write -gpgpu_l2_access_log %s\n",
+            m_config.gpgpu_l2_access_log);
+    exit(1);
+  }
+  if (m_config.gpgpu_mem_request_log[0] &&
+      !m_mem_request_log.open(m_config.gpgpu_mem_request_log)) {
+    fprintf(stderr, "GPGPU-Sim: cannot write -gpgpu_mem_request_log %s\n",
+            m_config.gpgpu_mem_request_log);
+    exit(1);
+  }
+  if (m_config.mem_replay()) {
+    if (!m_mem_replay.open(m_config.gpgpu_mem_replay)) {
+      fprintf(stderr,
+              "GPGPU-Sim: -gpgpu_mem_replay %s is not a memory request log\n",
+              m_config.gpgpu_mem_replay);
+      exit(1);
+    }
+    m_replay_queues.resize(m_memory_config->m_n_mem_sub_partition);
+    m_replay_has_next = m_mem_replay.next(m_replay_next);
+  }
+  if (m_config.gpgpu_self_profile)
+    m_profiler.enable(m_config.gpgpu_self_profile,
+                      m_shader_config->n_simt_clusters);
+  m_num_tenants = 2;
+  if (m_config.gpgpu_tenant_sms[0]) {
+    m_num_tenants = parse_tenant_counts(m_config.gpgpu_tenant_sms,
+                                        "-gpgpu_tenant_sms", m_tenant_sms);
+    unsigned n = m_shader_config->num_shader();
+    unsigned total = 0;
+    for (unsigned t = 0; t < m_num_tenants; t++) total += m_tenant_sms[t];
+    if (m_num_tenants < 2 || total > n) {
+      fprintf(stderr,
+              "GPGPU-Sim: -gpgpu_tenant_sms %s needs graphics and at least "
+              "one compute tenant in %u SMs\n",
+              m_config.gpgpu_tenant_sms, n);
+      exit(1);
+    }
+    m_tenant_sms[m_num_tenants - 1] += n - total;
+    m_sm_tenant.resize(n);
+    unsigned sid = 0;
+    for (unsigned t = 0; t < m_num_tenants; t++)
+      for (unsigned i = 0; i < m_tenant_sms[t]; i++) m_sm_tenant[sid++] = t;
+  }
+  if (m_config.gpgpu_l2_tenant_ways[0]) {
+    unsigned ways[MAX_TENANTS];
+    unsigned tenants = parse_tenant_counts(m_config.gpgpu_l2_tenant_ways,
+                                           "-gpgpu_l2_tenant_ways", ways);
+    unsigned total = 0;
+    for (unsigned t = 0; t < tenants; t++) {
+      if (!ways[t]) total = (unsigned)-1;
+      total += ways[t];
+    }
+    if (total > m_memory_config->m_L2_config.get_assoc()) {
+      fprintf(stderr,
+              "GPGPU-Sim: -gpgpu_l2_tenant_ways %s does not give every "
+              "tenant one of the %u L2 ways\n",
+              m_config.gpgpu_l2_tenant_ways,
+              m_memory_config->m_L2_config.get_assoc());
+      exit(1);
+    }
+    for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++)
+      m_memory_sub_partition[i]->set_l2_tenant_ways(ways, tenants);
+  }
+  m_slicer_next_check = 0;
+  m_slicer_measuring = false;
+  m_slicer_graphics_uid = m_slicer_compute_uid = (unsigned)-1;
+  m_slicer_decision_cycle = 0;
+  m_slicer_phase_start = 0;
+  m_slicer_sample_cost = 0;
+  m_slicer_samples = 0;
+  m_slicer_sampling_cycles = 0;
+  m_slicer_lost_insts = 0;
+  m_repartition_next = 0;
+  m_repartition_start = 0;
+  m_frame_start_cycle = 0;
+  m_frame_start_insts = 0;
+  m_last_frame_insts = 0;
+  m_last_frame_length = 0;
+  m_sm_migrations = 0;
+  m_frames = 0;
+  m_frames_met = 0;
+  m_frame_deadline_misses = 0;
+  m_frame_start_compute_insts = 0;
+  m_resident_compute_ctas = 0;
+  m_compute_cta_cap = -1;
+  m_throttle_next = 0;
+  m_throttle_insts = 0;
+  m_throttle_start = 0;
+  m_throttled_cycles = 0;
+  m_tot_throttled_cycles = 0;
+  m_graphics_error_avg = 0;
+  if (!parse_mem_class_limits(m_config.gpgpu_mem_class_caps,
+                              m_config.gpgpu_mem_class_rates,
+                              m_mem_sm_limits) ||
+      !parse_mem_class_limits(m_config.gpgpu_dram_class_caps,
+                              m_config.gpgpu_dram_class_rates,
+                              m_mem_dram_limits)) {
+    fprintf(stderr,
+            "GPGPU-Sim: bad memory class caps or rates, expected "
+            "<graphics>,<compute>\n");
+    exit(1);
+  }
+  if (m_config.gpgpu_mem_throttle && !m_mem_sm_limits[1].cap &&
+      !m_mem_sm_limits[1].rate && !m_mem_dram_limits[1].cap &&
+      !m_mem_dram_limits[1].rate) {
+    fprintf(stderr,
+            "GPGPU-Sim: -gpgpu_mem_throttle scales the graphics memory "
+            "limits, set a graphics cap or rate\n");
+    exit(1);
+  }
+  m_mem_limited = false;
+  for (unsigned c = 0; c < 2; c++)
+    m_mem_limited = m_mem_limited || m_mem_sm_limits[c].cap ||
+                    m_mem_sm_limits[c].rate || m_mem_dram_limits[c].cap ||
+                    m_mem_dram_limits[c].rate;
+  m_mem_graphics_scale = 1;
+  m_mem_throttle_next = 0;
+  m_mem_throttle_retired = 0;
+  m_mem_throttle_latency = 0;
+  m_mem_throttle_changes = 0;
+  apply_mem_limits();
+  if (m_config.gpgpu_utility) {
+    m_l2_partition_policy =
+        cache_partition_policy::create(m_config.gpgpu_l2_partition_policy);
+    if (!m_l2_partition_policy) {
+      fprintf(stderr, "GPGPU-Sim: unknown -gpgpu_l2_partition_policy %s\n",
+              m_config.gpgpu_l2_partition_policy);
+      exit(1);
+    }
+    if (m_config.gpgpu_l2_umon_sets)
+      for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++)
+        m_memory_sub_partition[i]->enable_l2_utility_monitor(
+            m_config.gpgpu_l2_umon_sets);
+  }
 
   icnt_wrapper_init();
   icnt_create(m_shader_config->n_simt_clusters,
@@ -1198,7 +2160,13 @@ gpgpu_sim::gpgpu_sim(const gpgpu_sim_config &config, gpgpu_context *ctx)
 
   m_running_kernels.resize(64, NULL);
   // m_running_kernels.resize(config.max_concurrent_kernel, NULL);
+  m_cluster_running_sms.assign(m_shader_config->n_simt_clusters, 0);
+  init_cluster_clocks();
   m_last_issued_kernel = 0;
+  m_num_running_kernels = 0;
+  m_num_running_compute = 0;
+  m_select_kernel_ns = 0;
+  m_select_kernel_calls = 0;
   m_last_cluster_issue = m_shader_config->n_simt_clusters -
                          1;  // this causes first launch to use simt cluster 0
   *average_pipeline_duty_cycle = 0;
@@ -1288,11 +2256,94 @@ void gpgpu_sim_config::init_clock_domains(void) {
          core_period, icnt_period, l2_period, dram_period);
 }
 
-void gpgpu_sim::reinit_clock_domains(void) {
-  core_time = 0;
-  dram_time = 0;
-  icnt_time = 0;
-  l2_time = 0;
+void gpgpu_sim::reinit_clock_domains(void) { m_clocks.reset(); }
+
+void gpgpu_sim::init_cluster_clocks() {
+  m_core_domain = m_clocks.add_domain(m_config.core_period, 0);
+  m_domain_mask.push_back(CORE);
+  m_clocks.add_domain(m_config.icnt_period, 0);
+  m_domain_mask.push_back(ICNT);
+  m_clocks.add_domain(m_config.l2_period, 0);
+  m_domain_mask.push_back(L2);
+  m_clocks.add_domain(m_config.dram_period, 0);
+  m_domain_mask.push_back(DRAM);
+  m_domain_scale.assign(m_clocks.size(), 1);
+  m_domain_clusters.resize(m_clocks.size());
+  m_cluster_domain.assign(m_shader_config->n_simt_clusters, m_core_domain);
+  m_cluster_clock_changes = 0;
+  m_dvfs_voltage = 1;
+#ifdef GPGPUSIM_POWER_MODEL
+  // the voltage scales with the mean frequency, which is what the DVFS
+  // scaling of AccelWattch takes
+  add_clock_listener([this](unsigned, double) {
+    double sum = 0;
+    for (unsigned i = 0; i < m_cluster_domain.size(); i++)
+      sum += cluster_clock_scale(i);
+    m_dvfs_voltage = sum / m_cluster_domain.size();
+  });
+#endif
+
+  const char *s = m_config.gpgpu_cluster_clock_scale;
+  double scale = 1;
+  for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++) {
+    while (*s == ',' || *s == ' ') s++;
+    if (*s) {
+      char *end;
+      scale = strtod(s, &end);
+      if (end == s || scale <= 0) {
+        fprintf(stderr, "GPGPU-Sim: bad -gpgpu_cluster_clock_scale %s\n",
+                m_config.gpgpu_cluster_clock_scale);
+        exit(1);
+      }
+      s = end;
+    }
+    set_cluster_clock_scale(i, scale);
+  }
+  m_class_clock_scale[0] = m_class_clock_scale[1] = 0;
+  if (m_config.gpgpu_class_clock_scale[0] &&
+      (sscanf(m_config.gpgpu_class_clock_scale, "%lf:%lf",
+              &m_class_clock_scale[1], &m_class_clock_scale[0]) != 2 ||
+       m_class_clock_scale[0] <= 0 || m_class_clock_scale[1] <= 0)) {
+    fprintf(stderr, "GPGPU-Sim: bad -gpgpu_class_clock_scale %s\n",
+            m_config.gpgpu_class_clock_scale);
+    exit(1);
+  }
+}
+
+void gpgpu_sim::set_cluster_clock_scale(unsigned cluster, double scale) {
+  assert(scale > 0);
+  unsigned d = m_core_domain;
+  if (scale != 1) {
+    // the clusters at one scale share a domain, in phase with the core clock
+    for (d = m_core_domain + 1; d < m_clocks.size(); d++)
+      if (m_domain_mask[d] == CLUSTER && m_domain_scale[d] == scale) break;
+    if (d == m_clocks.size()) {
+      m_clocks.add_domain(m_config.core_period / scale,
+                          m_clocks.next_edge(m_core_domain));
+      m_domain_mask.push_back(CLUSTER);
+      m_domain_scale.push_back(scale);
+      m_domain_clusters.resize(m_clocks.size());
+    }
+  }
+  unsigned old = m_cluster_domain[cluster];
+  if (old == d) return;
+  std::vector<unsigned> &from = m_domain_clusters[old];
+  from.erase(std::remove(from.begin(), from.end(), cluster), from.end());
+  if (d != m_core_domain) {
+    std::vector<unsigned> &to = m_domain_clusters[d];
+    to.insert(std::lower_bound(to.begin(), to.end(), cluster), cluster);
+  }
+  m_cluster_domain[cluster] = d;
+  m_cluster_clock_changes++;
+  for (const clock_listener &l : m_clock_listeners) l(cluster, scale);
+}
+
+void gpgpu_sim::update_class_clocks() {
+  if (concurrent_mode != MPS && m_sm_tenant.empty()) return;
+  for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++) {
+    bool graphics = sm_runs_graphics(m_shader_config->cid_to_sid(0, i));
+    set_cluster_clock_scale(i, m_class_clock_scale[graphics]);
+  }
 }
 
 bool gpgpu_sim::active() {
@@ -1317,6 +2368,8 @@ bool gpgpu_sim::active() {
   ;
   if (icnt_busy()) return true;
   if (get_more_cta_left()) return true;
+  if (m_copy_engine.busy()) return true;
+  if (m_hybrid.busy()) return true;
   return false;
 }
 
@@ -1340,6 +2393,7 @@ void gpgpu_sim::init() {
   concurrent_granularity = 0;
   gpu_sim_insn = 0;
   last_gpu_sim_insn = 0;
+  reset_sample_cycles();
   m_total_cta_launched = 0;
   gpu_completed_cta = 0;
   partiton_reqs_in_parallel = 0;
@@ -1398,6 +2452,7 @@ void gpgpu_sim::update_stats() {
   gpu_tot_occupancy += gpu_occupancy;
 
   gpu_sim_cycle = 0;
+  reset_sample_cycles();
   partiton_reqs_in_parallel = 0;
   partiton_replys_in_parallel = 0;
   partiton_reqs_in_parallel_util = 0;
@@ -1414,6 +2469,15 @@ PowerscalingCoefficients *gpgpu_sim::get_scaling_coeffs()
 }
 
 void gpgpu_sim::print_stats(unsigned kernel_id) {
+  if (m_kernel_stats_log.enabled()) log_kernel_stats(kernel_id);
+  if (m_validation.enabled()) validate_kernel(kernel_id);
+  if (m_kernel_stats_level != KERNEL_STATS_FULL) {
+    if (m_kernel_stats_level == KERNEL_STATS_SUMMARY)
+      print_kernel_summary(kernel_id);
+    if (!m_shader_config->gpgpu_concurrent_kernel_sm)
+      clear_executed_kernel_info();
+    return;
+  }
   gpgpu_ctx->stats->ptx_file_line_stats_write_file();
   gpu_print_stat(kernel_id);
 
@@ -1429,49 +2493,54 @@ void gpgpu_sim::print_stats(unsigned kernel_id) {
   }
 }
 
-void gpgpu_sim::deadlock_check() {
-  if (m_config.gpu_deadlock_detect && gpu_deadlock) {
-    fflush(stdout);
-    printf(
-        "\n\nGPGPU-Sim uArch: ERROR ** deadlock detected: last writeback core "
-        "%u @ gpu_sim_cycle %u (+ gpu_tot_sim_cycle %u) (%u cycles ago)\n",
-        gpu_sim_insn_last_update_sid, (unsigned)gpu_sim_insn_last_update,
-        (unsigned)(gpu_tot_sim_cycle - gpu_sim_cycle),
-        (unsigned)(gpu_sim_cycle - gpu_sim_insn_last_update));
-    unsigned num_cores = 0;
-    for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++) {
-      unsigned not_completed = m_cluster[i]->get_not_completed();
-      if (not_completed) {
-        if (!num_cores) {
-          printf(
-              "GPGPU-Sim uArch: DEADLOCK  shader cores no longer committing "
-              "instructions [core(# threads)]:\n");
-          printf("GPGPU-Sim uArch: DEADLOCK  ");
-          m_cluster[i]->print_not_completed(stdout);
-        } else if (num_cores < 8) {
-          m_cluster[i]->print_not_completed(stdout);
-        } else if (num_cores >= 8) {
-          printf(" + others ... ");
-        }
-        num_cores += m_shader_config->n_simt_cores_per_cluster;
+void gpgpu_sim::reset_sample_cycles() {
+  m_next_stat_sample_cycle = m_config.gpu_stat_sample_freq;
+  m_next_deadlock_check_cycle = m_config.gpu_deadlock_check_interval
+                                    ? m_config.gpu_deadlock_check_interval
+                                    : (unsigned long long)-1;
+}
+
+void gpgpu_sim::report_deadlock() {
+  fflush(stdout);
+  printf(
+      "\n\nGPGPU-Sim uArch: ERROR ** deadlock detected: last writeback core "
+      "%u @ gpu_sim_cycle %u (+ gpu_tot_sim_cycle %u) (%u cycles ago)\n",
+      gpu_sim_insn_last_update_sid, (unsigned)gpu_sim_insn_last_update,
+      (unsigned)(gpu_tot_sim_cycle - gpu_sim_cycle),
+      (unsigned)(gpu_sim_cycle - gpu_sim_insn_last_update));
+  unsigned num_cores = 0;
+  for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++) {
+    unsigned not_completed = m_cluster[i]->get_not_completed();
+    if (not_completed) {
+      if (!num_cores) {
+        printf(
+            "GPGPU-Sim uArch: DEADLOCK  shader cores no longer committing "
+            "instructions [core(# threads)]:\n");
+        printf("GPGPU-Sim uArch: DEADLOCK  ");
+        m_cluster[i]->print_not_completed(stdout);
+      } else if (num_cores < 8) {
+        m_cluster[i]->print_not_completed(stdout);
+      } else if (num_cores >= 8) {
+        printf(" + others ... ");
       }
+      num_cores += m_shader_config->n_simt_cores_per_cluster;
     }
-    printf("\n");
-    for (unsigned i = 0; i < m_memory_config->m_n_mem; i++) {
-      bool busy = m_memory_partition_unit[i]->busy();
-      if (busy)
-        printf("GPGPU-Sim uArch DEADLOCK:  memory partition %u busy\n", i);
-    }
-    if (icnt_busy()) {
-      printf("GPGPU-Sim uArch DEADLOCK:  iterconnect contains traffic\n");
-      icnt_display_state(stdout);
-    }
-    printf(
-        "\nRe-run the simulator in gdb and use debug routines in .gdbinit to "
-        "debug this\n");
-    fflush(stdout);
-    abort();
   }
+  printf("\n");
+  for (unsigned i = 0; i < m_memory_config->m_n_mem; i++) {
+    bool busy = m_memory_partition_unit[i]->busy();
+    if (busy)
+      printf("GPGPU-Sim uArch DEADLOCK:  memory partition %u busy\n", i);
+  }
+  if (icnt_busy()) {
+    printf("GPGPU-Sim uArch DEADLOCK:  iterconnect contains traffic\n");
+    icnt_display_state(stdout);
+  }
+  printf(
+      "\nRe-run the simulator in gdb and use debug routines in .gdbinit to "
+      "debug this\n");
+  fflush(stdout);
+  abort();
 }
 
 /// printing the names and uids of a set of executed kernels (usually there is
@@ -1597,16 +2666,12 @@ void gpgpu_sim::change_cache_config(FuncCache cache_config) {
 void gpgpu_sim::clear_executed_kernel_info() {
   m_executed_kernel_names.clear();
   m_executed_kernel_uids.clear();
+  m_executed_kernel_uid_set.clear();
 }
-void gpgpu_sim::gpu_print_stat(unsigned kernel_id) {
-  FILE *statfout = stdout;
-
-  std::string kernel_info_str = executed_kernel_info_string();
+void gpgpu_sim::print_kernel_summary(unsigned kernel_id) {
   kernel_info_t *k = m_uid_to_kernel_info[kernel_id];
   unsigned long long kernel_cycle =
       k->end_cycle - k->start_cycle + k->m_launch_latency;
-
-  // fprintf(statfout, "%s", kernel_info_str.c_str());
   printf("kernel_name = %s\n",
          (k->get_name().substr(0, 64) + "-" + std::to_string(kernel_id)).c_str());
   printf("kernel_launch_uid = %d\n", kernel_id);
@@ -1618,11 +2683,115 @@ void gpgpu_sim::gpu_print_stat(unsigned kernel_id) {
   printf("gpu_tot_sim_insn = %lld\n", gpu_tot_sim_insn + gpu_sim_insn);
   printf("gpu_tot_ipc = %12.4f\n", (float)(gpu_tot_sim_insn + gpu_sim_insn) /
                                        (gpu_tot_sim_cycle + gpu_sim_cycle));
+}
+
+void gpgpu_sim::log_kernel_stats(unsigned kernel_id) {
+  kernel_info_t *k = m_uid_to_kernel_info[kernel_id];
+  kernel_stats_log &log = m_kernel_stats_log;
+  log.begin();
+  log.field("uid", (unsigned long long)kernel_id);
+  log.field("name", k->get_name());
+  log.field("graphics", (unsigned long long)k->is_graphic_kernel);
+  log.field("tenant", (unsigned long long)k->tenant);
+  log.field("start_cycle", k->start_cycle);
+  log.field("end_cycle", k->end_cycle);
+  log.field("cycles", k->end_cycle - k->start_cycle + k->m_launch_latency);
+  log.field("insn", gpu_sim_insn_per_kernel[kernel_id]);
+  log.field("tot_cycle", gpu_tot_sim_cycle + gpu_sim_cycle);
+  log.field("tot_insn", gpu_tot_sim_insn + gpu_sim_insn);
+  log.field("tot_issued_cta", gpu_tot_issued_cta + m_total_cta_launched);
+  log.field("occupancy", gpu_occupancy.get_occ_fraction() * 100.0);
+  log.field("tot_occupancy",
+            (gpu_occupancy + gpu_tot_occupancy).get_occ_fraction() * 100.0);
+  unsigned long long warp_insn = 0;
+  for (unsigned i = 0; i < m_config.num_shader(); i++)
+    warp_insn += m_shader_stats->m_num_sim_winsn[i];
+  log.field("tot_w_icount", warp_insn);
+  unsigned long long kernel_cycle =
+      k->end_cycle - k->start_cycle + k->m_launch_latency;
+  log.field("l2_bw", (double)partiton_replys_in_parallel_per_kernel[kernel_id] *
+                         32 / (kernel_cycle * m_config.icnt_period) / 1e9);
+  log.field("l2_bw_total",
+            (double)(partiton_replys_in_parallel +
+                     partiton_replys_in_parallel_total) *
+                32 /
+                ((gpu_tot_sim_cycle + gpu_sim_cycle) * m_config.icnt_period) /
+                1e9);
+  static const char *cls[2] = {"compute", "graphics"};
+  for (unsigned c = 0; c < 2; c++) {
+    std::string name = cls[c];
+    log.field((name + "_l2_accesses").c_str(), l2_class_accesses[c]);
+    log.field((name + "_l2_hits").c_str(), l2_class_hits[c]);
+    log.field((name + "_dram_accesses").c_str(),
+              m_memory_stats->dram_class_accesses[c]);
+    log.field((name + "_dram_bytes").c_str(),
+              m_memory_stats->dram_class_bytes[c]);
+  }
+  if (m_memory_config->gpgpu_memlatency_stat) {
+    const kernel_mem_stats &kernel = m_memory_stats->kernel_stats(kernel_id);
+    kernel_mem_stats total = m_memory_stats->total_record();
+    log.field("dram_reads", kernel.dram_reads);
+    log.field("dram_writes", kernel.dram_writes);
+    log.field("tot_dram_reads", total.dram_reads);
+    log.field("tot_dram_writes", total.dram_writes);
+  }
+  // what print_simulation_time prints after the kernel's stats
+  unsigned long long elapsed =
+      MAX(time(NULL) - gpgpu_ctx->the_gpgpusim->g_simulation_starttime, 1);
+  log.field("sim_seconds", elapsed);
+  log.field("sim_insn_rate", (gpu_tot_sim_insn + gpu_sim_insn) / elapsed);
+  log.field("sim_cycle_rate", (gpu_tot_sim_cycle + gpu_sim_cycle) / elapsed);
+  log.cache("l1", aggregated_l1_stats, kernel_id);
+  if (!m_memory_config->m_L2_config.disabled())
+    log.cache("l2", aggregated_l2_stats, kernel_id);
+  log.end();
+}
+
+void gpgpu_sim::validate_kernel(unsigned kernel_id) {
+  kernel_info_t *k = m_uid_to_kernel_info[kernel_id];
+  validation_log::counters values;
+  values.push_back(std::make_pair(
+      std::string("cycles"),
+      k->end_cycle - k->start_cycle + k->m_launch_latency));
+  values.push_back(std::make_pair(std::string("insn"),
+                                  gpu_sim_insn_per_kernel[kernel_id]));
+  values.push_back(std::make_pair(std::string("tot_cycle"),
+                                  gpu_tot_sim_cycle + gpu_sim_cycle));
+  const char *cls[2] = {"compute", "graphics"};
+  for (unsigned c = 0; c < 2; c++) {
+    std::string n(cls[c]);
+    values.push_back(std::make_pair(n + "_l1_accesses", l1_class_accesses[c]));
+    values.push_back(std::make_pair(n + "_l1_hits", l1_class_hits[c]));
+    values.push_back(std::make_pair(n + "_l2_accesses", l2_class_accesses[c]));
+    values.push_back(std::make_pair(n + "_l2_hits", l2_class_hits[c]));
+    values.push_back(std::make_pair(n + "_dram_accesses",
+                                    m_memory_stats->dram_class_accesses[c]));
+    values.push_back(std::make_pair(n + "_dram_row_hits",
+                                    m_memory_stats->dram_class_row_hits[c]));
+    values.push_back(std::make_pair(n + "_dram_bytes",
+                                    m_memory_stats->dram_class_bytes[c]));
+  }
+  m_validation.kernel_done(kernel_id, k->get_name(), values);
+}
+
+void gpgpu_sim::gpu_print_stat(unsigned kernel_id) {
+  FILE *statfout = stdout;
+
+  std::string kernel_info_str = executed_kernel_info_string();
+  kernel_info_t *k = m_uid_to_kernel_info[kernel_id];
+  unsigned long long kernel_cycle =
+      k->end_cycle - k->start_cycle + k->m_launch_latency;
+
+  // fprintf(statfout, "%s", kernel_info_str.c_str());
+  print_kernel_summary(kernel_id);
   printf("gpu_tot_issued_cta = %lld\n",
          gpu_tot_issued_cta + m_total_cta_launched);
   printf("gpu_occupancy = %.4f%% \n", gpu_occupancy.get_occ_fraction() * 100);
   printf("gpu_tot_occupancy = %.4f%% \n",
          (gpu_occupancy + gpu_tot_occupancy).get_occ_fraction() * 100);
+  if (m_config.kernel_select_bench())
+    printf("gpu_kernel_select_time = %.3f ms (%llu calls)\n",
+           m_select_kernel_ns / 1e6, m_select_kernel_calls);
 
   fprintf(statfout, "max_total_param_size = %llu\n",
           gpgpu_ctx->device_runtime->g_max_total_param_size);
@@ -1630,6 +2799,118 @@ void gpgpu_sim::gpu_print_stat(unsigned kernel_id) {
   // performance counter for stalls due to congestion.
   printf("gpu_stall_dramfull = %d\n", gpu_stall_dramfull);
   printf("gpu_stall_icnt2sh    = %d\n", gpu_stall_icnt2sh);
+  if (m_config.gpgpu_skip_idle_core_cycles)
+    printf("gpu_skipped_core_cycles = %llu\n", gpu_skipped_core_cycles);
+  if (m_cluster_clock_changes)
+    printf("gpu_cluster_clock_changes = %llu\n", m_cluster_clock_changes);
+  if (m_warm_accesses[0] || m_warm_accesses[1]) {
+    const char *level[2] = {"l1d", "l2"};
+    for (unsigned l = 0; l < 2; l++)
+      printf("gpu_warmup_%s_accesses = %llu, hits = %llu\n", level[l],
+             m_warm_accesses[l], m_warm_hits[l]);
+  }
+  if (m_config.gpgpu_slicer) {
+    printf("gpu_slicer_samples = %u\n", m_slicer_samples);
+    printf("gpu_slicer_sampling_cycles = %llu\n", m_slicer_sampling_cycles);
+    printf("gpu_slicer_lost_insn = %.0f\n", m_slicer_lost_insts);
+  }
+  if (m_config.gpgpu_sm_repartition)
+    printf("gpu_sm_migrations = %u\n", m_sm_migrations);
+  if (m_config.gpgpu_sm_repartition || m_config.gpgpu_frame_cta_throttle) {
+    printf("gpu_frames = %u\n", m_frames);
+    printf("gpu_frames_met = %u\n", m_frames_met);
+    printf("gpu_frame_deadline_misses = %u\n", m_frame_deadline_misses);
+  }
+  if (m_vertex_buffers.m_prefetched_bytes) {
+    printf("gpu_vertex_buffer_prefetch_bytes = %llu\n",
+           m_vertex_buffers.m_prefetched_bytes);
+    printf("gpu_vertex_buffer_invalidate_bytes = %llu\n",
+           m_vertex_buffers.m_invalidated_bytes);
+  }
+  if (m_frame_persistence.enabled()) {
+    printf("gpu_frame_persistence_kept_bytes = %llu\n",
+           m_frame_persistence.m_kept_bytes);
+    printf("gpu_frame_persistence_overwritten_bytes = %llu\n",
+           m_frame_persistence.m_overwritten_bytes);
+  }
+  if (dram_traffic::enabled(m_memory_config)) {
+    unsigned long long reads = 0, writes = 0, dropped = 0, retired = 0,
+                       latency = 0, max_latency = 0;
+    for (unsigned i = 0; i < m_memory_config->m_n_mem; i++) {
+      const dram_traffic *traffic = m_memory_partition_unit[i]->traffic();
+      reads += traffic->m_reads;
+      writes += traffic->m_writes;
+      dropped += traffic->m_dropped;
+      retired += traffic->m_retired;
+      latency += traffic->m_latency;
+      max_latency = std::max(max_latency, traffic->m_max_latency);
+    }
+    printf("gpu_dram_traffic_reads = %llu\n", reads);
+    printf("gpu_dram_traffic_writes = %llu\n", writes);
+    printf("gpu_dram_traffic_dropped = %llu\n", dropped);
+    printf("gpu_dram_traffic_avg_latency = %.2f\n",
+           retired ? (double)latency / retired : 0.0);
+    printf("gpu_dram_traffic_max_latency = %llu\n", max_latency);
+  }
+  if (m_compression.enabled()) {
+    unsigned long long requests = 0, raw = 0, dram = 0, bypassed = 0,
+                       meta_hits = 0, meta_misses = 0;
+    for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++) {
+      const compression_slice *c = m_memory_sub_partition[i]->compression();
+      requests += c->m_requests;
+      raw += c->m_raw_bytes;
+      dram += c->m_dram_bytes;
+      bypassed += c->m_bypassed;
+      meta_hits += c->m_meta_hits;
+      meta_misses += c->m_meta_misses;
+    }
+    printf("gpu_compression_requests = %llu\n", requests);
+    printf("gpu_compression_raw_bytes = %llu\n", raw);
+    printf("gpu_compression_dram_bytes = %llu\n", dram);
+    printf("gpu_compression_bypassed = %llu\n", bypassed);
+    printf("gpu_compression_meta_hits = %llu, misses = %llu\n", meta_hits,
+           meta_misses);
+  }
+  if (m_config.gpgpu_graphics_pipeline) {
+    printf("gpu_raster_fragment_ctas = %llu\n",
+           m_raster_pipeline.m_fragment_ctas);
+    printf("gpu_raster_overlapped_ctas = %llu\n",
+           m_raster_pipeline.m_overlapped_ctas);
+  }
+  if (m_shader_config->gpgpu_l1_carveout_dynamic) {
+    printf("gpu_l1_carveout_resizes = %llu\n", m_l1_carveout.m_resizes);
+    printf("gpu_l1_carveout_splits = %llu\n", m_l1_carveout.m_splits);
+  }
+  if (m_sm_gating.enabled())
+    m_sm_gating.print(stdout, gpu_tot_sim_cycle + gpu_sim_cycle);
+  if (m_mmu.enabled()) m_mmu.print(stdout);
+  if (m_copy_engine.enabled()) m_copy_engine.print(stdout);
+  if (m_multi_gpu.enabled()) m_multi_gpu.print(stdout);
+  if (m_hybrid.enabled()) m_hybrid.print(stdout);
+  if (m_config.gpgpu_validation_check[0])
+    printf("gpu_validation_checked_kernels = %llu\n",
+           m_validation.m_checked_kernels);
+  if (m_tile_binning.enabled()) {
+    printf("gpu_tile_binning_ctas = %llu\n", m_tile_binning.m_ctas);
+    printf("gpu_tile_binned_ctas = %llu\n", m_tile_binning.m_binned_ctas);
+  }
+  print_mem_limiter_stats();
+  print_rop_stats();
+  if (m_memory_config->scheduler_type == DRAM_FRFCFS)
+    m_memory_stats->print_dram_class_stats(gpu_tot_sim_cycle + gpu_sim_cycle);
+  m_memory_stats->print_icnt_class_stats(gpu_tot_sim_cycle + gpu_sim_cycle);
+  m_memory_stats->print_kernel_stats(kernel_id);
+  if (m_config.gpgpu_frame_cta_throttle) {
+    unsigned long long now = gpu_tot_sim_cycle + gpu_sim_cycle;
+    printf("gpu_compute_throttled_cycles = %llu\n", m_tot_throttled_cycles);
+    // one point of the frames met / compute throughput trade-off, sweep
+    // -gpgpu_frame_slack for the curve
+    printf("frame_throttle_tradeoff: slack %u%%, frames met %u of %u, "
+           "compute ipc %.2f\n",
+           m_config.gpgpu_frame_slack, m_frames_met,
+           m_frames_met + m_frame_deadline_misses,
+           (double)class_thread_insts(false) / std::max(now, 1ull));
+  }
 
   // printf("partiton_reqs_in_parallel = %lld\n", partiton_reqs_in_parallel);
   // printf("partiton_reqs_in_parallel_total    = %lld\n",
@@ -1677,7 +2958,7 @@ void gpgpu_sim::gpu_print_stat(unsigned kernel_id) {
   shader_print_cache_stats(stdout,kernel_id);
 
   cache_stats core_cache_stats;
-  core_cache_stats.expand_cache_stats(aggregated_l1_stats.get_size() - 1);
+  core_cache_stats.resize(aggregated_l1_stats.get_size());
   core_cache_stats.clear();
   // unsigned num_units = m_shader_config->gpgpu_num_sp_units +
   //                      m_shader_config->gpgpu_num_dp_units +
@@ -1704,6 +2985,7 @@ void gpgpu_sim::gpu_print_stat(unsigned kernel_id) {
   shader_print_scheduler_stat(stdout, false);
 
   m_shader_stats->print(stdout);
+  m_shader_stats->print_class_stall(stdout);
 #ifdef GPGPUSIM_POWER_MODEL
   if (m_config.g_power_simulation_enabled) {
     if(m_config.g_power_simulation_mode > 0){
@@ -1721,6 +3003,7 @@ void gpgpu_sim::gpu_print_stat(unsigned kernel_id) {
     m_gpgpusim_wrapper->print_power_kernel_stats(
         gpu_sim_cycle, gpu_tot_sim_cycle, gpu_tot_sim_insn + gpu_sim_insn,
         kernel_info_str, true);
+    if (m_class_energy) m_class_energy->print(stdout);
     //if(!m_config.g_aggregate_power_stats)
       mcpat_reset_perf_count(m_gpgpusim_wrapper);
   }
@@ -1732,68 +3015,7 @@ void gpgpu_sim::gpu_print_stat(unsigned kernel_id) {
   // for (unsigned i = 0; i < m_memory_config->m_n_mem; i++)
     // m_memory_partition_unit[i]->print(stdout);
 
-  // L2 cache stats
-  if (!m_memory_config->m_L2_config.disabled()) {
-    cache_stats l2_stats;
-    l2_stats.expand_cache_stats(aggregated_l2_stats.get_size() - 1);
-    struct cache_sub_stats l2_css;
-    struct cache_sub_stats total_l2_css;
-    l2_stats.clear();
-    l2_css.clear();
-    total_l2_css.clear();
-    std::vector<unsigned> tot_gr_utility;
-    std::vector<unsigned> tot_cp_utility;
-    tot_gr_utility.resize(m_memory_config->m_L2_config.get_assoc(), 0);
-    tot_cp_utility.resize(m_memory_config->m_L2_config.get_assoc(), 0);
-
-    printf("\n========= L2 cache stats =========\n");
-    for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++) {
-      m_memory_sub_partition[i]->accumulate_L2cache_stats(l2_stats);
-      m_memory_sub_partition[i]->get_L2cache_sub_stats(kernel_id, l2_css);
-      if (m_config.gpgpu_utility) {
-        std::vector<unsigned> gr_utility;
-        std::vector<unsigned> cp_utility;
-        m_memory_sub_partition[i]->get_utility(gr_utility, cp_utility);
-        assert(gr_utility.size() == cp_utility.size());
-        for (unsigned j = 0; j < gr_utility.size(); j++) {
-          tot_gr_utility[j] += gr_utility[j];
-          tot_cp_utility[j] += cp_utility[j];
-        }
-      }
-
-      fprintf(stdout,
-              "L2_cache_bank[%d]: Access = %llu, Miss = %llu, Miss_rate = "
-              "%.3lf, Pending_hits = %llu, Reservation_fails = %llu\n",
-              i, l2_css.accesses, l2_css.misses,
-              (double)l2_css.misses / (double)l2_css.accesses,
-              l2_css.pending_hits, l2_css.res_fails);
-
-      total_l2_css += l2_css;
-    }
-    if (m_config.gpgpu_utility) {
-      for (unsigned i = 0; i < tot_gr_utility.size(); i++) {
-        printf("L2_cache_utility[%d]: gr_utility = %u, cp_utility = %u\n", i,
-               tot_gr_utility[i], tot_cp_utility[i]);
-      }
-    }
-    if (!m_memory_config->m_L2_config.disabled() &&
-        m_memory_config->m_L2_config.get_num_lines()) {
-      // L2c_print_cache_stat();
-      printf("L2_total_cache_accesses = %llu\n", total_l2_css.accesses);
-      printf("L2_total_cache_misses = %llu\n", total_l2_css.misses);
-      if (total_l2_css.accesses > 0)
-        printf("L2_total_cache_miss_rate = %.4lf\n",
-               (double)total_l2_css.misses / (double)total_l2_css.accesses);
-      printf("L2_total_cache_pending_hits = %llu\n", total_l2_css.pending_hits);
-      printf("L2_total_cache_reservation_fails = %llu\n",
-             total_l2_css.res_fails);
-      printf("L2_total_cache_breakdown:\n");
-      l2_stats.print_stats(kernel_id, stdout, "L2_cache_stats_breakdown");
-      printf("L2_total_cache_reservation_fail_breakdown:\n");
-      l2_stats.print_fail_stats(kernel_id, stdout, "L2_cache_stats_fail_breakdown");
-      total_l2_css.print_port_stats(stdout, "L2_cache");
-    }
-  }
+  print_l2_stats(kernel_id);
 
   if (m_config.gpgpu_cflog_interval != 0) {
     spill_log_to_file(stdout, 1, gpu_sim_cycle);
@@ -1833,6 +3055,30 @@ void gpgpu_sim::gpu_print_stat(unsigned kernel_id) {
   }
 }
 
+void gpgpu_sim::release_stats(unsigned kernel_id) {
+  cache_stats::release_kernel(kernel_id);
+  m_memory_stats->release_kernel(kernel_id);
+}
+
+void gpgpu_sim::kernel_released(kernel_info_t *kernel) {
+  unsigned uid = kernel->get_uid();
+  assert(std::find(m_running_kernels.begin(), m_running_kernels.end(),
+                   kernel) == m_running_kernels.end());
+  m_uid_to_kernel_info.erase(uid);
+  if (m_executed_kernel_uid_set.erase(uid)) {
+    std::vector<unsigned>::iterator it = std::find(
+        m_executed_kernel_uids.begin(), m_executed_kernel_uids.end(), uid);
+    if (it != m_executed_kernel_uids.end()) {
+      m_executed_kernel_names.erase(m_executed_kernel_names.begin() +
+                                    (it - m_executed_kernel_uids.begin()));
+      m_executed_kernel_uids.erase(it);
+    }
+  }
+  for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++)
+    for (unsigned j = 0; j < m_shader_config->n_simt_cores_per_cluster; j++)
+      m_cluster[i]->get_core(j)->kernel_released(kernel);
+}
+
 void gpgpu_sim::update_stats_size(unsigned kernel_id) {
     for (unsigned i = 0; i < m_config.num_cluster(); i++) {
       m_cluster[i]->update_cache_stats_size(kernel_id);
@@ -1871,27 +3117,27 @@ void shader_core_ctx::mem_instruction_stats(const warp_inst_t &inst) {
     case reg_space:
       break;
     case shared_space:
-      m_stats->gpgpu_n_shmem_insn += active_count;
+      core_stage_add(m_stats->gpgpu_n_shmem_insn, active_count);
       break;
     case sstarr_space:
-      m_stats->gpgpu_n_sstarr_insn += active_count;
+      core_stage_add(m_stats->gpgpu_n_sstarr_insn, active_count);
       break;
     case const_space:
-      m_stats->gpgpu_n_const_insn += active_count;
+      core_stage_add(m_stats->gpgpu_n_const_insn, active_count);
       break;
     case param_space_kernel:
     case param_space_local:
-      m_stats->gpgpu_n_param_insn += active_count;
+      core_stage_add(m_stats->gpgpu_n_param_insn, active_count);
       break;
     case tex_space:
-      m_stats->gpgpu_n_tex_insn += active_count;
+      core_stage_add(m_stats->gpgpu_n_tex_insn, active_count);
       break;
     case global_space:
     case local_space:
       if (inst.is_store())
-        m_stats->gpgpu_n_store_insn += active_count;
+        core_stage_add(m_stats->gpgpu_n_store_insn, active_count);
       else
-        m_stats->gpgpu_n_load_insn += active_count;
+        core_stage_add(m_stats->gpgpu_n_load_insn, active_count);
       break;
     default:
       abort();
@@ -1929,14 +3175,107 @@ int shader_core_ctx::find_available_hwtid(unsigned int cta_size, bool occupy) {
   }
 }
 
+bool shader_core_ctx::cta_footprint_t::matches(const kernel_info_t &k,
+                                              const kernel_info_t *corunner,
+                                              const gpgpu_sim *gpu,
+                                              bool graphics_sm) const {
+  return valid && kernel_uid == k.get_uid() &&
+         corunner_uid == (corunner ? corunner->get_uid() : (unsigned)-1) &&
+         dynamic_sm_count == gpu->dynamic_sm_count &&
+         concurrent_granularity == gpu->concurrent_granularity &&
+         slicer_sampled == gpu->slicer_sampled &&
+         this->graphics_sm == graphics_sm;
+}
+
+sm_resources shader_core_ctx::cta_resources(kernel_info_t &k) const {
+  const struct gpgpu_ptx_sim_info *kernel_info = ptx_sim_kernel_info(k.entry());
+  unsigned int warp_size = m_config->warp_size;
+  unsigned int padded_cta_size = k.threads_per_cta();
+  if (padded_cta_size % warp_size)
+    padded_cta_size = ((padded_cta_size / warp_size) + 1) * (warp_size);
+  sm_resources r;
+  r.threads = padded_cta_size;
+  r.regs = padded_cta_size * ((kernel_info->regs + 3) & ~3);
+  r.shmem = kernel_info->smem;
+  r.ctas = 1;
+  return r;
+}
+
+void shader_core_ctx::compute_cta_footprint(cta_footprint_t &fp,
+                                            kernel_info_t &k,
+                                            kernel_info_t *corunner) {
+  sm_quota_input in;
+  in.sid = m_sid;
+  in.num_shader = m_config->num_shader();
+  in.capacity.threads = m_config->n_thread_per_shader;
+  in.capacity.regs = m_config->gpgpu_shader_registers;
+  in.capacity.shmem = m_config->gpgpu_shmem_size;
+  in.capacity.ctas = m_config->max_cta_per_core;
+  in.graphics_share = m_gpu->dynamic_sm_count;
+  in.granularity = m_gpu->concurrent_granularity;
+  in.graphics_sm = m_gpu->sm_runs_graphics(m_sid);
+  in.sampling = m_gpu->get_config().gpgpu_slicer && !m_gpu->slicer_sampled;
+  in.cta[k.is_graphic_kernel] = cta_resources(k);
+  in.cta[!k.is_graphic_kernel] =
+      corunner ? cta_resources(*corunner) : sm_resources();
+
+  fp.valid = true;
+  fp.blocked = false;
+  fp.kernel_uid = k.get_uid();
+  fp.corunner_uid = corunner ? corunner->get_uid() : (unsigned)-1;
+  fp.dynamic_sm_count = m_gpu->dynamic_sm_count;
+  fp.concurrent_granularity = m_gpu->concurrent_granularity;
+  fp.slicer_sampled = m_gpu->slicer_sampled;
+  fp.graphics_sm = in.graphics_sm;
+  fp.kernel_info = ptx_sim_kernel_info(k.entry());
+  fp.padded_cta_size = in.cta[k.is_graphic_kernel].threads;
+  fp.used_regs = in.cta[k.is_graphic_kernel].regs;
+  unsigned share = m_gpu->get_sm_quota_policy()->quotas(in, fp.quota);
+  if (share != in.graphics_share) {
+    // a compute CTA could not fit at all, the whole GPU moves to the share
+    // that fits one
+    printf("overriding %u to %u\n", m_gpu->dynamic_sm_count, share);
+    m_gpu->dynamic_sm_count = share;
+    // keep recomputing while the split has to be forced
+    fp.valid = false;
+  }
+}
+
+void shader_core_ctx::pin_class_quotas(const sm_resources quota[2]) {
+  m_quota_pinned = true;
+  m_pinned_quota[0] = quota[0];
+  m_pinned_quota[1] = quota[1];
+  clear_cta_footprint_blocks();
+}
+
+void shader_core_ctx::unpin_class_quotas() {
+  m_quota_pinned = false;
+  clear_cta_footprint_blocks();
+}
+
 bool shader_core_ctx::occupy_shader_resource_1block(kernel_info_t &k,
                                                     bool occupy) {
-  unsigned threads_per_cta = k.threads_per_cta();
-  const class function_info *kernel = k.entry();
-  const struct gpgpu_ptx_sim_info *kernel_info = ptx_sim_kernel_info(kernel);
-  unsigned int padded_cta_size = threads_per_cta;
+  cta_footprint_t &fp = m_cta_footprint[k.is_graphic_kernel];
+  kernel_info_t *corunner = NULL;
+  if (m_config->gpgpu_concurrent_finegrain)
+    corunner = k.is_graphic_kernel ? m_running_compute : m_running_graphics;
+  bool graphics_sm = m_gpu->sm_runs_graphics(m_sid);
+  bool cached = fp.matches(k, corunner, m_gpu, graphics_sm);
+  // nothing this depends on has changed since the last refusal
+  if (!occupy && cached && fp.blocked) return false;
+
+  bool ok = fits_shader_resource_1block(k, corunner, cached, occupy);
+  if (!ok && !occupy && fp.matches(k, corunner, m_gpu, graphics_sm))
+    fp.blocked = true;
+  return ok;
+}
+
+bool shader_core_ctx::fits_shader_resource_1block(kernel_info_t &k,
+                                                  kernel_info_t *corunner,
+                                                  bool cached, bool occupy) {
+  cta_footprint_t &fp = m_cta_footprint[k.is_graphic_kernel];
+  unsigned int padded_cta_size = k.threads_per_cta();
   unsigned int warp_size = m_config->warp_size;
-  bool overrided = true;
   if (padded_cta_size % warp_size)
     padded_cta_size = ((padded_cta_size / warp_size) + 1) * (warp_size);
   if (find_available_hwtid(padded_cta_size, false) == -1) return false;
@@ -1947,177 +3286,30 @@ bool shader_core_ctx::occupy_shader_resource_1block(kernel_info_t &k,
     kernel_padded_threads_per_cta = padded_cta_size;
     kernel_max_cta_per_shader = m_config->max_cta(k);
   }
-
-  unsigned used_regs = padded_cta_size * ((kernel_info->regs + 3) & ~3);
-
-  if (m_config->gpgpu_concurrent_finegrain) {
-    unsigned graphics_count = m_gpu->dynamic_sm_count;
-    if (m_gpu->get_config().gpgpu_slicer) {
-      if (m_gpu->slicer_sampled) {
-        graphics_count = m_gpu->dynamic_sm_count;
-      } else {
-        if (k.is_graphic_kernel) {
-          if (get_cluster_id() >= m_config->num_shader() / 2) {
-            return false;
-          }
-          graphics_count = (get_cluster_id() + 1) * 2;
-        } else if (!k.is_graphic_kernel) {
-          if (get_cluster_id() < m_config->num_shader() / 2) {
-            return false;
-          }
-          assert(get_cluster_id() >= m_config->num_shader() / 2);
-          graphics_count = (get_cluster_id() + 1 - m_config->num_shader() / 2) * 2;
-        }
-      }
-    }
-    // if (m_gpu->compute_done || !m_gpu->start_compute) {
-    //   // if computes are all done, run graphics only
-    //   // if compute is not started, run graphics only
-    //   graphics_count = m_gpu->concurrent_granularity;
-    // } else if (m_gpu->graphics_done) {
-    //   // if graphics are all done, run compute only
-    //   graphics_count = 0;
-    // } else {
-    //   overrided = false;
-    // }
-    overrided = false;
-    unsigned max_graphics_threads = m_config->n_thread_per_shader *
-                            graphics_count /
-                            m_gpu->concurrent_granularity;
-    unsigned max_graphcis_shmem = m_config->gpgpu_shmem_size *
-                            graphics_count /
-                            m_gpu->concurrent_granularity;
-    unsigned max_graphics_regs = m_config->gpgpu_shader_registers *
-                            graphics_count /
-                            m_gpu->concurrent_granularity;
-    unsigned max_graphics_ctas = m_config->max_cta_per_core *
-                            graphics_count /
-                            m_gpu->concurrent_granularity;
-    bool limited_reg = true;
-    bool limited_shmem = true;
-    if ((k.is_graphic_kernel && m_running_compute) ||
-        (!k.is_graphic_kernel && m_running_graphics)) {
-      unsigned graphics_cta_size = 0;
-      unsigned compute_cta_size = 0;
-      const struct gpgpu_ptx_sim_info *kernel_g = NULL;
-      const struct gpgpu_ptx_sim_info *kernel_c = NULL;
-      if (k.is_graphic_kernel && m_running_compute) {
-        graphics_cta_size = threads_per_cta;
-        compute_cta_size = m_running_compute->threads_per_cta();
-      } else if (!k.is_graphic_kernel && m_running_graphics) {
-        graphics_cta_size = m_running_graphics->threads_per_cta();
-        compute_cta_size = threads_per_cta;
-      }
-      if (graphics_cta_size % warp_size) {
-        graphics_cta_size = ((graphics_cta_size / warp_size) + 1) * (warp_size);
-      }
-      if (compute_cta_size % warp_size) {
-        compute_cta_size = ((compute_cta_size / warp_size) + 1) * (warp_size);
-      }
-
-      unsigned graphics_cta = max_graphics_threads / graphics_cta_size;
-      unsigned compute_cta =
-          (m_config->n_thread_per_shader - max_graphics_threads) /
-          compute_cta_size;
-      if (k.is_graphic_kernel && m_running_compute) {
-        kernel_g = kernel_info;
-        kernel_c = ptx_sim_kernel_info(m_running_compute->entry());
-      } else if (!k.is_graphic_kernel && m_running_graphics) {
-        kernel_g = ptx_sim_kernel_info(m_running_graphics->entry());
-        kernel_c = kernel_info;
-      }
-      unsigned used_regs_g = graphics_cta_size * ((kernel_g->regs + 3) & ~3);
-      unsigned used_regs_c = compute_cta_size * ((kernel_c->regs + 3) & ~3);
-      limited_reg = (graphics_cta * used_regs_g + compute_cta * used_regs_c) >
-                    m_config->gpgpu_shader_registers;
-      limited_shmem =
-          (graphics_cta * kernel_g->smem + compute_cta * kernel_c->smem) >
-          m_config->gpgpu_shmem_size;
-      if (!m_gpu->get_config().gpgpu_slicer) {
-        // cannot issue compute at all
-        // make at least one can run
-        if (limited_reg) {
-          while (1 * used_regs_c >
-                 m_config->gpgpu_shader_registers - max_graphics_regs) {
-            graphics_count--;
-            assert(graphics_count <= m_gpu->concurrent_granularity);
-            max_graphics_regs = m_config->gpgpu_shader_registers *
-                                graphics_count / m_gpu->concurrent_granularity;
-            if (!overrided) {
-              printf("overriding %u to %u, reg\n", m_gpu->dynamic_sm_count, graphics_count);
-              m_gpu->dynamic_sm_count = graphics_count;
-            }
-          }
-        }
-        max_graphcis_shmem = m_config->gpgpu_shmem_size * graphics_count /
-                             m_gpu->concurrent_granularity;
-        if (limited_shmem) {
-          while (1 * (unsigned) kernel_c->smem >
-                 m_config->gpgpu_shmem_size - max_graphcis_shmem) {
-            // cannot issue compute at all
-            graphics_count--;
-            assert(graphics_count <= m_gpu->concurrent_granularity);
-            max_graphcis_shmem = m_config->gpgpu_shmem_size * graphics_count /
-                                m_gpu->concurrent_granularity;
-            if (!overrided) {
-              printf("overriding %u to %u, smem\n", m_gpu->dynamic_sm_count, graphics_count);
-              m_gpu->dynamic_sm_count = graphics_count;
-            }
-          }
-        }
-        // recompute the max
-        max_graphics_threads = m_config->n_thread_per_shader * graphics_count /
-                               m_gpu->concurrent_granularity;
-        max_graphics_ctas = m_config->max_cta_per_core * graphics_count /
-                            m_gpu->concurrent_granularity;
-      }
-    }
-    if (k.is_graphic_kernel) {
-      
-      if (m_occupied_graphics_threads + padded_cta_size > max_graphics_threads)
-        return false;
-
-      if (limited_shmem) {
-        if (m_occupied_graphics_shmem + kernel_info->smem > max_graphcis_shmem)
-          return false;
-      } 
-
-      if (limited_reg) {
-        if (m_occupied_graphics_regs + used_regs > max_graphics_regs)
-          return false;
-      } 
-
-      if (m_occupied_graphics_ctas + 1 > max_graphics_ctas)
-        return false;
-    } else {
-      unsigned running_computes_threads =
-          m_occupied_n_threads - m_occupied_graphics_threads;
-      if (running_computes_threads + padded_cta_size >
-          m_config->n_thread_per_shader - max_graphics_threads)
-        return false;
-
-      unsigned running_computes_shmem =
-          m_occupied_shmem - m_occupied_graphics_shmem;
-      if (limited_shmem) {
-        if (running_computes_shmem + kernel_info->smem >
-            m_config->gpgpu_shmem_size - max_graphcis_shmem)
-          return false;
-      } 
-
-      unsigned running_computes_regs =
-          m_occupied_regs - m_occupied_graphics_regs;
-      if (limited_reg) {
-        if (running_computes_regs + used_regs >
-            m_config->gpgpu_shader_registers - max_graphics_regs)
-          return false;
-      } 
-
-      unsigned running_computes_ctas =
-          m_occupied_ctas - m_occupied_graphics_ctas;
-      if (running_computes_ctas + 1 > m_config->max_cta_per_core -
-                                           max_graphics_ctas);
-    }
+  if (!cached) compute_cta_footprint(fp, k, corunner);
+
+  const struct gpgpu_ptx_sim_info *kernel_info = fp.kernel_info;
+  unsigned used_regs = fp.used_regs;
+  // the class within its quota
+  const sm_resources &quota = m_quota_pinned
+                                  ? m_pinned_quota[k.is_graphic_kernel]
+                                  : fp.quota[k.is_graphic_kernel];
+  unsigned class_threads = m_occupied_graphics_threads;
+  unsigned class_shmem = m_occupied_graphics_shmem;
+  unsigned class_regs = m_occupied_graphics_regs;
+  unsigned class_ctas = m_occupied_graphics_ctas;
+  if (!k.is_graphic_kernel) {
+    class_threads = m_occupied_n_threads - class_threads;
+    class_shmem = m_occupied_shmem - class_shmem;
+    class_regs = m_occupied_regs - class_regs;
+    class_ctas = m_occupied_ctas - class_ctas;
   }
+  if (class_threads + padded_cta_size > quota.threads) return false;
+  if (class_shmem + kernel_info->smem > quota.shmem) return false;
+  if (class_regs + used_regs > quota.regs) return false;
+  if (class_ctas + 1 > quota.ctas) return false;
+
+  // and the SM within its capacity
   if (m_occupied_n_threads + padded_cta_size > m_config->n_thread_per_shader)
     return false;
 
@@ -2131,6 +3323,7 @@ bool shader_core_ctx::occupy_shader_resource_1block(kernel_info_t &k,
     return false;
 
   if (occupy) {
+    clear_cta_footprint_blocks();
     m_occupied_n_threads += padded_cta_size;
     m_occupied_shmem += kernel_info->smem;
     m_occupied_regs += used_regs;
@@ -2167,6 +3360,7 @@ void shader_core_ctx::release_shader_resource_1block(unsigned hw_ctaid,
     if (padded_cta_size % warp_size)
       padded_cta_size = ((padded_cta_size / warp_size) + 1) * (warp_size);
 
+    clear_cta_footprint_blocks();
     assert(m_occupied_n_threads >= padded_cta_size);
     m_occupied_n_threads -= padded_cta_size;
 
@@ -2332,6 +3526,7 @@ void shader_core_ctx::issue_block2core(kernel_info_t &kernel) {
   // initialize the SIMT stacks and fetch hardware
   init_warps(free_cta_hw_id, start_thread, end_thread, ctaid, cta_size, kernel);
   m_n_active_cta++;
+  update_running();
 
   shader_CTA_count_log(m_sid, 1);
   SHADER_DPRINTF(LIVENESS,
@@ -2352,27 +3547,18 @@ void dram_t::dram_log(int task) {
   }
 }
 
-// Find next clock domain and increment its time
+// Find the clock domains of the next edge and move them a period ahead
 int gpgpu_sim::next_clock_domain(void) {
-  double smallest = min3(core_time, icnt_time, dram_time);
   int mask = 0x00;
-  if (l2_time <= smallest) {
-    smallest = l2_time;
-    mask |= L2;
-    l2_time += m_config.l2_period;
-  }
-  if (icnt_time <= smallest) {
-    mask |= ICNT;
-    icnt_time += m_config.icnt_period;
-  }
-  if (dram_time <= smallest) {
-    mask |= DRAM;
-    dram_time += m_config.dram_period;
-  }
-  if (core_time <= smallest) {
-    mask |= CORE;
-    core_time += m_config.core_period;
+  m_ticked_clusters.clear();
+  for (unsigned d : m_clocks.next()) {
+    mask |= m_domain_mask[d];
+    const std::vector<unsigned> &clusters = m_domain_clusters[d];
+    m_ticked_clusters.insert(m_ticked_clusters.end(), clusters.begin(),
+                             clusters.end());
   }
+  if (mask & CLUSTER)
+    std::sort(m_ticked_clusters.begin(), m_ticked_clusters.end());
   return mask;
 }
 
@@ -2393,16 +3579,751 @@ void gpgpu_sim::issue_block2core() {
   }
 }
 
+void gpgpu_sim::update_l2_partition() {
+  if (gpu_tot_sim_cycle + gpu_sim_cycle - m_l2_partition_last_sample <=
+          m_config.gpgpu_l2_partition_period ||
+      all_compute_done || all_graphics_done)
+    return;
+  float cp_factor = 1;
+  float gr_factor = 1;
+  l2_cp_access = std::max(l2_cp_access, 1u);
+  l2_gr_access = std::max(l2_gr_access, 1u);
+  if (l2_gr_access / l2_cp_access > 10) {
+    gr_factor = l2_gr_access / l2_cp_access;
+  } else if (l2_cp_access / l2_gr_access > 10) {
+    cp_factor = l2_cp_access / l2_gr_access;
+  }
+  // get total utility for all L2 banks
+  std::vector<unsigned> tot_gr_utility;
+  std::vector<unsigned> tot_cp_utility;
+  tot_gr_utility.resize(m_memory_config->m_L2_config.get_assoc(), 0);
+  tot_cp_utility.resize(m_memory_config->m_L2_config.get_assoc(), 0);
+  bool per_bank =
+      m_config.gpgpu_l2_way_partition && m_config.gpgpu_l2_partition_per_bank;
+  for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++) {
+    std::vector<unsigned> gr_utility;
+    std::vector<unsigned> cp_utility;
+    m_memory_sub_partition[i]->get_utility(gr_utility, cp_utility);
+    assert(gr_utility.size() == cp_utility.size());
+    if (per_bank)
+      m_memory_sub_partition[i]->set_l2_graphics_ways(
+          m_l2_partition_policy->graphics_ways(gr_utility, cp_utility,
+                                               gr_factor, cp_factor, false));
+    for (unsigned j = 0; j < gr_utility.size(); j++) {
+      tot_gr_utility[j] += gr_utility[j];
+      tot_cp_utility[j] += cp_utility[j];
+    }
+    // shadow tag counters age so the split follows phase changes
+    m_memory_sub_partition[i]->decay_l2_utility();
+  }
+
+  printf("intermediate L2 utility: \n");
+  printf("g_factor, c_factor: %f, %f\n", gr_factor, cp_factor);
+  unsigned best_score_index = m_l2_partition_policy->graphics_ways(
+      tot_gr_utility, tot_cp_utility, gr_factor, cp_factor, true);
+  printf("best score = %d\n", best_score_index);
+  fflush(stdout);
+  l2_utility_ratio = best_score_index;
+  if (m_config.gpgpu_l2_way_partition && !per_bank)
+    for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++)
+      m_memory_sub_partition[i]->set_l2_graphics_ways(l2_utility_ratio);
+  m_l2_partition_last_sample = gpu_tot_sim_cycle + gpu_sim_cycle;
+  l2_gr_access = 0;
+  l2_cp_access = 0;
+}
+
+void gpgpu_sim::simulation_finished() {
+  m_counter_sampler.close();
+  if (m_live_stats.enabled()) publish_live_stats(true);
+  m_visualizer_binary.close();
+  m_l2_access_log.close();
+  m_mem_request_log.close();
+#ifdef GPGPUSIM_POWER_MODEL
+  if (m_power_trace) m_power_trace->close();
+#endif
+  m_profiler.print(stdout);
+}
+
+void gpgpu_sim::add_sampled_counters() {
+  static const char *cls[2] = {"compute", "graphics"};
+  counter_sampler &s = m_counter_sampler;
+  s.add_counter("insn", [this] { return gpu_tot_sim_insn + gpu_sim_insn; });
+  for (unsigned c = 0; c < 2; c++) {
+    std::string name = cls[c];
+    s.add_counter((name + "_thread_insts").c_str(),
+                  [this, c] { return class_thread_insts(c); });
+    s.add_counter((name + "_l2_accesses").c_str(),
+                  [this, c] { return l2_class_accesses[c]; });
+    s.add_counter((name + "_l2_hits").c_str(),
+                  [this, c] { return l2_class_hits[c]; });
+    // counted by the FR-FCFS scheduler only
+    s.add_counter((name + "_dram_bytes").c_str(),
+                  [this, c] { return m_memory_stats->dram_class_bytes[c]; });
+  }
+}
+
+void gpgpu_sim::publish_live_stats(bool finished) {
+  live_stats_snapshot &s = m_live_stats.begin();
+  s.finished = finished;
+  s.cycle = gpu_tot_sim_cycle + gpu_sim_cycle;
+  s.insn = gpu_tot_sim_insn + gpu_sim_insn;
+  for (unsigned c = 0; c < 2; c++) {
+    s.thread_insts[c] = class_thread_insts(c);
+    s.l2_accesses[c] = l2_class_accesses[c];
+    s.l2_hits[c] = l2_class_hits[c];
+    s.dram_accesses[c] = m_memory_stats->dram_class_accesses[c];
+    s.dram_bytes[c] = m_memory_stats->dram_class_bytes[c];
+  }
+  s.num_sms = m_shader_config->num_shader();
+  s.active_sms = 0;
+  for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++)
+    s.active_sms += m_cluster[i]->get_n_active_sms();
+  s.graphics_sms = dynamic_sm_count;
+  for (unsigned t = 0; t < MAX_TENANTS; t++)
+    s.tenant_sms[t] =
+        !m_sm_tenant.empty() && t < m_num_tenants ? m_tenant_sms[t] : 0;
+  s.num_mem_partitions = m_memory_config->m_n_mem;
+  s.running_kernels = 0;
+  for (unsigned i = 0; i < m_running_kernels.size(); i++) {
+    kernel_info_t *k = m_running_kernels[i];
+    if (!k) continue;
+    unsigned n = s.running_kernels++;
+    if (n >= LIVE_STATS_KERNELS) continue;
+    live_stats_kernel &e = s.kernels[n];
+    e.uid = k->get_uid();
+    e.graphics = k->is_graphic_kernel;
+    e.tenant = k->tenant;
+    e.start_cycle = k->start_cycle;
+    e.total_ctas = k->num_blocks();
+    e.issued_ctas = std::min((unsigned long long)k->get_next_cta_id_single(),
+                             e.total_ctas);
+    e.insn = k->get_uid() < gpu_sim_insn_per_kernel.size()
+                 ? gpu_sim_insn_per_kernel[k->get_uid()]
+                 : 0;
+  }
+  m_live_stats.end();
+}
+
+unsigned long long gpgpu_sim::class_thread_insts(bool graphics) const {
+  unsigned long long insts = 0;
+  for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++)
+    for (unsigned j = 0; j < m_shader_config->n_simt_cores_per_cluster; j++)
+      insts += m_cluster[i]->get_core(j)->shader_class_inst[graphics];
+  return insts;
+}
+
+unsigned long long gpgpu_sim::frame_budget() const {
+  if (m_config.gpgpu_frame_deadline) return m_config.gpgpu_frame_deadline;
+  return gpu_last_frame_cycle ? gpu_last_frame_cycle : m_last_frame_length;
+}
+
+static mem_class_limits scaled_mem_limits(const mem_class_limits &l,
+                                          float scale) {
+  mem_class_limits s;
+  s.cap = l.cap ? std::max((unsigned)(l.cap * scale), 1u) : 0;
+  s.rate = l.rate * scale;
+  return s;
+}
+
+void gpgpu_sim::apply_mem_limits() {
+  mem_class_limits gr_sm =
+      scaled_mem_limits(m_mem_sm_limits[1], m_mem_graphics_scale);
+  mem_class_limits gr_dram =
+      scaled_mem_limits(m_mem_dram_limits[1], m_mem_graphics_scale);
+  unsigned depth = m_config.gpgpu_mem_token_depth;
+  for (unsigned sid = 0; sid < m_shader_config->num_shader(); sid++) {
+    mem_class_limiter &l = m_cluster[m_shader_config->sid_to_cluster(sid)]
+                               ->get_core(m_shader_config->sid_to_cid(sid))
+                               ->mem_limiter();
+    l.set_limits(true, gr_sm, depth);
+    l.set_limits(false, m_mem_sm_limits[0], depth);
+  }
+  for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++) {
+    mem_class_limiter &l = m_memory_sub_partition[i]->dram_limiter();
+    l.set_limits(true, gr_dram, depth);
+    l.set_limits(false, m_mem_dram_limits[0], depth);
+  }
+}
+
+void gpgpu_sim::update_mem_throttle() {
+  unsigned long long now = gpu_tot_sim_cycle + gpu_sim_cycle;
+  if (now < m_mem_throttle_next) return;
+  m_mem_throttle_next = now + m_config.gpgpu_mem_throttle_period;
+  unsigned long long retired = 0, latency = 0;
+  for (unsigned sid = 0; sid < m_shader_config->num_shader(); sid++) {
+    const mem_class_limiter &l =
+        m_cluster[m_shader_config->sid_to_cluster(sid)]
+            ->get_core(m_shader_config->sid_to_cid(sid))
+            ->mem_limiter();
+    retired += l.m_retired[0];
+    latency += l.m_latency_sum[0];
+  }
+  unsigned long long period_retired = retired - m_mem_throttle_retired;
+  double avg = period_retired
+                   ? (double)(latency - m_mem_throttle_latency) / period_retired
+                   : 0;
+  m_mem_throttle_retired = retired;
+  m_mem_throttle_latency = latency;
+
+  double target = m_config.gpgpu_mem_throttle_latency;
+  float scale = m_mem_graphics_scale;
+  if (m_compute_cta_cap != (unsigned)-1) {
+    // the frame is at risk, graphics gets its bandwidth back first
+    scale = 1;
+  } else if (avg > target) {
+    scale = std::max(scale / 2, 1.0f / 64);
+  } else if (avg < target * 0.75) {
+    scale = std::min(scale + 0.125f, 1.0f);
+  }
+  if (scale != m_mem_graphics_scale) {
+    m_mem_graphics_scale = scale;
+    m_mem_throttle_changes++;
+    apply_mem_limits();
+  }
+}
+
+void gpgpu_sim::print_mem_limiter_stats() const {
+  if (!m_mem_limited) return;
+  // per boundary, [0] SM to interconnect and [1] L2 to DRAM, and class
+  unsigned long long passed[2][2] = {{0, 0}, {0, 0}};
+  unsigned long long blocked[2][2] = {{0, 0}, {0, 0}};
+  unsigned long long retired[2] = {0, 0};
+  unsigned long long latency[2] = {0, 0};
+  for (unsigned sid = 0; sid < m_shader_config->num_shader(); sid++) {
+    const mem_class_limiter &l =
+        m_cluster[m_shader_config->sid_to_cluster(sid)]
+            ->get_core(m_shader_config->sid_to_cid(sid))
+            ->mem_limiter();
+    for (unsigned c = 0; c < 2; c++) {
+      passed[0][c] += l.m_passed[c];
+      blocked[0][c] += l.m_blocked_cycles[c];
+      retired[c] += l.m_retired[c];
+      latency[c] += l.m_latency_sum[c];
+    }
+  }
+  for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++) {
+    const mem_class_limiter &l = m_memory_sub_partition[i]->dram_limiter();
+    for (unsigned c = 0; c < 2; c++) {
+      passed[1][c] += l.m_passed[c];
+      blocked[1][c] += l.m_blocked_cycles[c];
+    }
+  }
+  const char *cls[2] = {"compute", "graphics"};
+  for (unsigned c = 0; c < 2; c++) {
+    printf("gpu_mem_%s_sm_requests = %llu\n", cls[c], passed[0][c]);
+    printf("gpu_mem_%s_sm_blocked_cycles = %llu\n", cls[c], blocked[0][c]);
+    printf("gpu_mem_%s_dram_requests = %llu\n", cls[c], passed[1][c]);
+    printf("gpu_mem_%s_dram_blocked_cycles = %llu\n", cls[c], blocked[1][c]);
+    printf("gpu_mem_%s_latency = %.2f\n", cls[c],
+           retired[c] ? (double)latency[c] / retired[c] : 0.0);
+  }
+  if (m_config.gpgpu_mem_throttle) {
+    printf("gpu_mem_graphics_scale = %.4f\n", m_mem_graphics_scale);
+    printf("gpu_mem_throttle_changes = %u\n", m_mem_throttle_changes);
+  }
+}
+
+void gpgpu_sim::print_rop_stats() const {
+  if (!m_memory_config->rop_model) return;
+  unsigned long long writes = 0, tiles = 0, blocks = 0, color = 0, depth = 0;
+  for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++) {
+    const rop_unit *rop = m_memory_sub_partition[i]->get_rop_unit();
+    writes += rop->m_writes;
+    tiles += rop->m_tiles_closed;
+    blocks += rop->m_color_blocks;
+    color += rop->m_color_to_l2;
+    depth += rop->m_depth_to_l2;
+  }
+  printf("gpu_rop_writes = %llu\n", writes);
+  printf("gpu_rop_tiles = %llu\n", tiles);
+  printf("gpu_rop_color_blocks = %llu\n", blocks);
+  printf("gpu_rop_color_to_l2 = %llu\n", color);
+  printf("gpu_rop_depth_to_l2 = %llu\n", depth);
+}
+
+void gpgpu_sim::frame_finished() {
+  unsigned long long now = gpu_tot_sim_cycle + gpu_sim_cycle;
+  unsigned long long insts = class_thread_insts(true);
+  unsigned long long compute = class_thread_insts(false);
+  unsigned long long budget = frame_budget();
+  unsigned long long length = now - m_frame_start_cycle;
+  if (m_compute_cta_cap != (unsigned)-1) {
+    m_throttled_cycles += now - m_throttle_start;
+    m_tot_throttled_cycles += now - m_throttle_start;
+  }
+  m_frames++;
+  m_multi_gpu.frame_finished();
+#ifdef GPGPUSIM_POWER_MODEL
+  if (m_class_energy) m_class_energy->frame_finished();
+#endif
+  if (budget) {
+    if (length > budget)
+      m_frame_deadline_misses++;
+    else
+      m_frames_met++;
+  }
+  if (m_config.gpgpu_sm_repartition || m_config.gpgpu_frame_cta_throttle)
+    printf("frame %u: %llu cycles, budget %llu, %s, compute ipc %.2f, "
+           "compute throttled %.1f%% of the frame\n",
+           m_frames, length, budget,
+           !budget ? "no deadline" : length > budget ? "missed" : "met",
+           (double)(compute - m_frame_start_compute_insts) /
+               std::max(length, 1ull),
+           100.0 * m_throttled_cycles / std::max(length, 1ull));
+  m_last_frame_insts = insts - m_frame_start_insts;
+  m_last_frame_length = length;
+  m_frame_start_cycle = now;
+  m_frame_start_insts = insts;
+  m_frame_start_compute_insts = compute;
+  m_throttled_cycles = 0;
+  // size the split and the cap for the new frame right away
+  m_repartition_next = 0;
+  m_throttle_next = 0;
+}
+
+void gpgpu_sim::update_frame_throttle() {
+  unsigned long long now = gpu_tot_sim_cycle + gpu_sim_cycle;
+  if (now < m_throttle_next) return;
+  m_throttle_next = now + m_config.gpgpu_frame_throttle_period;
+  if (m_compute_cta_cap != (unsigned)-1) {
+    m_throttled_cycles += now - m_throttle_start;
+    m_tot_throttled_cycles += now - m_throttle_start;
+  }
+  unsigned long long insts = class_thread_insts(true);
+  double ipc = (insts - m_throttle_insts) /
+               (double)std::max(now - m_throttle_start, 1ull);
+  m_throttle_insts = insts;
+  m_throttle_start = now;
+
+  unsigned long long budget = frame_budget();
+  if (all_graphics_done || all_compute_done || !budget) {
+    m_compute_cta_cap = -1;
+    return;
+  }
+  // graphics cycles left: the running graphics kernel furthest from its
+  // predicted end, or the work of the last frame not done yet at the rate
+  // of the last period when that takes longer
+  double left = 0;
+  for (unsigned n = 0; n < m_running_kernels.size(); n++) {
+    kernel_info_t *k = m_running_kernels[n];
+    if (!k || !k->is_graphic_kernel || k->done()) continue;
+    std::unordered_map<unsigned, unsigned long long>::const_iterator p =
+        predicted_kernel_cycles.find(k->get_uid());
+    if (p == predicted_kernel_cycles.end()) continue;
+    unsigned long long elapsed =
+        m_executed_kernel_uid_set.count(k->get_uid()) ? now - k->start_cycle
+                                                      : 0;
+    if (p->second > elapsed) left = std::max(left, (double)p->second - elapsed);
+  }
+  if (m_last_frame_insts) {
+    unsigned long long done = insts - m_frame_start_insts;
+    double work = m_last_frame_insts > done ? m_last_frame_insts - done : 0;
+    if (work > 0) left = std::max(left, ipc > 0 ? work / ipc : (double)budget);
+  }
+  // the less the predictions held so far, the more margin
+  double margin = left * (1 + m_config.gpgpu_frame_slack / 100.0) /
+                  std::max(confident, 0.5);
+  unsigned long long deadline = m_frame_start_cycle + budget;
+  if (now + margin > deadline) {
+    // at risk: halve the compute CTAs graphics shares the GPU with
+    unsigned cap = m_compute_cta_cap == (unsigned)-1 ? m_resident_compute_ctas
+                                                     : m_compute_cta_cap;
+    m_compute_cta_cap = cap / 2;
+  } else if (now + 2 * margin <= deadline) {
+    m_compute_cta_cap = -1;
+  } else if (m_compute_cta_cap != (unsigned)-1) {
+    m_compute_cta_cap += m_shader_config->num_shader();
+  }
+}
+
+void gpgpu_sim::update_sm_partition() {
+  unsigned long long now = gpu_tot_sim_cycle + gpu_sim_cycle;
+  // the SMs of tenants stay where -gpgpu_tenant_sms put them
+  if (now < m_repartition_next || concurrent_mode != MPS ||
+      !m_sm_tenant.empty())
+    return;
+  unsigned n = m_shader_config->num_shader();
+  if (m_sm_graphics.empty()) {
+    // start from the static split
+    unsigned graphics_count = n * dynamic_sm_count / concurrent_granularity;
+    m_sm_graphics.resize(n);
+    for (unsigned sid = 0; sid < n; sid++)
+      m_sm_graphics[sid] = sid < graphics_count;
+    m_sm_draining.assign(n, false);
+    m_sm_ready_cycle.assign(n, 0);
+    m_sm_last_move.assign(n, 0);
+    m_repartition_insts = class_thread_insts(true);
+    m_repartition_start = now;
+    m_repartition_next = now + m_config.gpgpu_sm_repartition_period;
+    return;
+  }
+  m_repartition_next = now + m_config.gpgpu_sm_repartition_period;
+
+  unsigned graphics_sms = 0;
+  for (unsigned sid = 0; sid < n; sid++) graphics_sms += m_sm_graphics[sid];
+  // per SM graphics throughput of the last period
+  unsigned long long insts = class_thread_insts(true);
+  double period = std::max(now - m_repartition_start, 1ull);
+  double sm_ipc = graphics_sms
+                      ? (insts - m_repartition_insts) / period / graphics_sms
+                      : 0;
+  m_repartition_insts = insts;
+  m_repartition_start = now;
+
+  // a class keeps at least one SM until all its kernels are done, without
+  // an estimate of the frame's work the split stays
+  unsigned target = graphics_sms;
+  unsigned long long budget = frame_budget();
+  if (all_graphics_done) {
+    target = 0;
+  } else if (all_compute_done) {
+    target = n;
+  } else if (budget && m_last_frame_insts && sm_ipc > 0) {
+    // the graphics work of the last frame still left, at the rate the
+    // deadline needs plus the slack
+    unsigned long long done = insts - m_frame_start_insts;
+    double left = m_last_frame_insts > done ? m_last_frame_insts - done : 0;
+    unsigned long long deadline = m_frame_start_cycle + budget;
+    if (now >= deadline) {
+      target = n - 1;
+    } else {
+      double need = left / (deadline - now) *
+                    (1 + m_config.gpgpu_frame_slack / 100.0);
+      target = std::min(std::ceil(need / sm_ipc), (double)n);
+    }
+  }
+  if (!all_graphics_done) target = std::max(target, 1u);
+  if (!all_compute_done) target = std::min(target, n - 1);
+  if (target == graphics_sms) return;
+
+  // a move costs the SM its drain and the migration, so SMs moved in the
+  // last period stay and the SMs with the fewest CTAs of their class go first
+  bool to_graphics = target > graphics_sms;
+  unsigned moves = to_graphics ? target - graphics_sms : graphics_sms - target;
+  while (moves--) {
+    unsigned best = n;
+    unsigned best_ctas = 0;
+    for (unsigned sid = 0; sid < n; sid++) {
+      if (m_sm_graphics[sid] == to_graphics) continue;
+      if (m_sm_last_move[sid] &&
+          now - m_sm_last_move[sid] < m_config.gpgpu_sm_repartition_period)
+        continue;
+      shader_core_ctx *core =
+          m_cluster[m_shader_config->sid_to_cluster(sid)]->get_core(
+              m_shader_config->sid_to_cid(sid));
+      unsigned ctas =
+          to_graphics ? core->m_occupied_ctas - core->m_occupied_graphics_ctas
+                      : core->m_occupied_graphics_ctas;
+      if (best == n || ctas < best_ctas) {
+        best = sid;
+        best_ctas = ctas;
+      }
+    }
+    if (best == n) break;
+    m_sm_graphics[best] = to_graphics;
+    m_sm_draining[best] = true;
+    m_sm_last_move[best] = now;
+    m_sm_migrations++;
+    if (to_graphics)
+      graphics_sms++;
+    else
+      graphics_sms--;
+  }
+  // the graphics share the memory side and MIG mapping follow
+  dynamic_sm_count = graphics_sms * concurrent_granularity / n;
+  printf("sm repartition: %u graphics SMs, %u compute SMs\n", graphics_sms,
+         n - graphics_sms);
+}
+
+// how often the slicer looks for a graphics and a compute kernel running
+// together when it has nothing to measure
+#define SLICER_POLL_CYCLES 1000
+
+void gpgpu_sim::slicer_kernel_boundary() { m_slicer_next_check = 0; }
+
+void gpgpu_sim::slicer_decided(unsigned long long now) {
+  slicer_sampled = true;
+  m_slicer_decision_cycle = now;
+  m_slicer_phase_ipc[0] = m_slicer_phase_ipc[1] = -1;
+  m_slicer_phase_insts[0] = class_thread_insts(false);
+  m_slicer_phase_insts[1] = class_thread_insts(true);
+  m_slicer_phase_start = now;
+  m_slicer_next_check =
+      now + (m_config.gpgpu_slicer_phase_period
+                 ? m_config.gpgpu_slicer_phase_period
+                 : SLICER_POLL_CYCLES);
+}
+
+void gpgpu_sim::start_slicer_sample(kernel_info_t *graphics,
+                                    kernel_info_t *compute,
+                                    unsigned long long now) {
+  m_slicer_graphics_uid = graphics->get_uid();
+  m_slicer_compute_uid = compute->get_uid();
+  std::map<std::pair<std::string, std::string>, unsigned>::iterator known =
+      m_slicer_decisions.find(
+          std::make_pair(graphics->name(), compute->name()));
+  if (known != m_slicer_decisions.end()) {
+    // the same shaders ran together before, a new sample would only cost
+    dynamic_sm_count = known->second;
+    printf("slicer reused dynamic_sm_count = %d\n", dynamic_sm_count);
+    slicer_decided(now);
+    return;
+  }
+  slicer_sampled = false;
+  m_slicer_measuring = false;
+  m_slicer_measure_start = now + m_config.gpgpu_slicer_warmup_cycles;
+  m_slicer_next_check = m_slicer_measure_start;
+  m_slicer_samples++;
+}
+
+void gpgpu_sim::finish_slicer_sample(kernel_info_t *graphics,
+                                     kernel_info_t *compute,
+                                     unsigned long long now) {
+  unsigned granularity = concurrent_granularity;
+  unsigned cores = m_shader_config->num_shader();
+  unsigned half = cores / 2;
+  double cycles = now - m_slicer_measure_start;
+  std::vector<float> ipc[2];
+  std::vector<unsigned> samples[2];
+  for (unsigned c = 0; c < 2; c++) {
+    ipc[c].assign(granularity + 1, 0);
+    samples[c].assign(granularity + 1, 0);
+  }
+  double sampled_insts = 0;
+  for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++) {
+    for (unsigned j = 0; j < m_shader_config->n_simt_cores_per_cluster; j++) {
+      shader_core_ctx *core = m_cluster[i]->get_core(j);
+      unsigned sid = core->get_sid();
+      bool is_graphics = sid < half;
+      unsigned share =
+          is_graphics ? slicer_sample_share(sid, half, granularity)
+                      : slicer_sample_share(sid - half, cores - half,
+                                            granularity);
+      unsigned long long insts =
+          core->shader_class_inst[is_graphics] - m_slicer_base_insts[sid];
+      sampled_insts += insts;
+      ipc[is_graphics][share] += insts / cycles;
+      samples[is_graphics][share]++;
+    }
+  }
+  for (unsigned c = 0; c < 2; c++)
+    for (unsigned s = 0; s <= granularity; s++)
+      ipc[c][s] = samples[c][s] ? ipc[c][s] / samples[c][s] : -1;
+
+  // a graphics and a compute CTA have to fit in their shares of a core
+  unsigned int warp_size = m_shader_config->warp_size;
+  unsigned compute_cta_size = compute->threads_per_cta();
+  if (compute_cta_size % warp_size)
+    compute_cta_size = ((compute_cta_size / warp_size) + 1) * (warp_size);
+  unsigned graphics_cta_size = graphics->threads_per_cta();
+  if (graphics_cta_size % warp_size)
+    graphics_cta_size = ((graphics_cta_size / warp_size) + 1) * (warp_size);
+  const struct gpgpu_ptx_sim_info *kernel_g =
+      ptx_sim_kernel_info(graphics->entry());
+  const struct gpgpu_ptx_sim_info *kernel_c =
+      ptx_sim_kernel_info(compute->entry());
+  unsigned used_regs_g = graphics_cta_size * ((kernel_g->regs + 3) & ~3);
+  unsigned used_regs_c = compute_cta_size * ((kernel_c->regs + 3) & ~3);
+  std::vector<bool> feasible(granularity + 1, false);
+  for (unsigned g = 1; g < granularity; g++) {
+    unsigned graphics_cta = m_shader_config->n_thread_per_shader * g /
+                            granularity / graphics_cta_size;
+    unsigned compute_cta = m_shader_config->n_thread_per_shader *
+                           (granularity - g) / granularity / compute_cta_size;
+    bool limited_reg = (graphics_cta * used_regs_g +
+                        compute_cta * used_regs_c) >
+                       m_shader_config->gpgpu_shader_registers;
+    bool limited_shmem =
+        (graphics_cta * kernel_g->smem + compute_cta * kernel_c->smem) >
+        m_shader_config->gpgpu_shmem_size;
+    feasible[g] = graphics_cta && compute_cta && !limited_reg && !limited_shmem;
+  }
+
+  float score = 0;
+  unsigned share =
+      m_slicer_policy->graphics_share(ipc[1], ipc[0], feasible, &score, true);
+  m_slicer_sampling_cycles +=
+      (unsigned long long)cycles + m_config.gpgpu_slicer_warmup_cycles;
+  m_slicer_sample_cost = 0;
+  if (share) {
+    // what the cores would have committed running the chosen split instead
+    m_slicer_sample_cost =
+        std::max(0.0, (double)score * cores * cycles - sampled_insts);
+    m_slicer_lost_insts += m_slicer_sample_cost;
+    dynamic_sm_count = share;
+    m_slicer_decisions[std::make_pair(graphics->name(), compute->name())] =
+        share;
+    printf("slicer sampled, dynamic_sm_count = %d\n", dynamic_sm_count);
+  } else {
+    printf("slicer found no split for both kernels, dynamic_sm_count = %d\n",
+           dynamic_sm_count);
+  }
+  slicer_decided(now);
+}
+
+void gpgpu_sim::update_slicer() {
+  unsigned long long now = gpu_tot_sim_cycle + gpu_sim_cycle;
+  if (now < m_slicer_next_check) return;
+  kernel_info_t *graphics = NULL;
+  kernel_info_t *compute = NULL;
+  for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++) {
+    for (unsigned j = 0; j < m_shader_config->n_simt_cores_per_cluster; j++) {
+      shader_core_ctx *core = m_cluster[i]->get_core(j);
+      if (!graphics) graphics = core->m_running_graphics;
+      if (!compute) compute = core->m_running_compute;
+    }
+  }
+  if (!graphics || !compute) {
+    // nothing to split, the next pair gets a sample of its own
+    m_slicer_graphics_uid = m_slicer_compute_uid = (unsigned)-1;
+    m_slicer_next_check = now + SLICER_POLL_CYCLES;
+    return;
+  }
+  if (graphics->get_uid() != m_slicer_graphics_uid ||
+      compute->get_uid() != m_slicer_compute_uid) {
+    start_slicer_sample(graphics, compute, now);
+    return;
+  }
+
+  if (!slicer_sampled) {
+    if (m_slicer_measuring) {
+      finish_slicer_sample(graphics, compute, now);
+      return;
+    }
+    // warmup over, count what each core commits of the class it samples
+    m_slicer_base_insts.resize(m_shader_config->num_shader());
+    unsigned half = m_shader_config->num_shader() / 2;
+    for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++) {
+      for (unsigned j = 0; j < m_shader_config->n_simt_cores_per_cluster;
+           j++) {
+        shader_core_ctx *core = m_cluster[i]->get_core(j);
+        m_slicer_base_insts[core->get_sid()] =
+            core->shader_class_inst[core->get_sid() < half];
+      }
+    }
+    m_slicer_measuring = true;
+    m_slicer_measure_start = now;
+    m_slicer_next_check = now + m_config.gpgpu_slicer_sample_cycles;
+    return;
+  }
+
+  m_slicer_next_check =
+      now + (m_config.gpgpu_slicer_phase_period
+                 ? m_config.gpgpu_slicer_phase_period
+                 : SLICER_POLL_CYCLES);
+  if (!m_config.gpgpu_slicer_phase_period || now == m_slicer_phase_start)
+    return;
+  float ipc[2];
+  for (unsigned c = 0; c < 2; c++) {
+    unsigned long long insts = class_thread_insts(c);
+    ipc[c] = (float)(insts - m_slicer_phase_insts[c]) /
+             (now - m_slicer_phase_start);
+    m_slicer_phase_insts[c] = insts;
+  }
+  m_slicer_phase_start = now;
+  if (m_slicer_phase_ipc[0] < 0) {
+    // the first period after a decision is the reference
+    m_slicer_phase_ipc[0] = ipc[0];
+    m_slicer_phase_ipc[1] = ipc[1];
+    return;
+  }
+  float drift = 0;
+  for (unsigned c = 0; c < 2; c++)
+    if (m_slicer_phase_ipc[c] > 0)
+      drift = std::max(drift, std::fabs(ipc[c] - m_slicer_phase_ipc[c]) /
+                                  m_slicer_phase_ipc[c]);
+  if (drift * 100 <= m_config.gpgpu_slicer_phase_threshold) return;
+  // resample only when the drift over a phase as long as the current one
+  // is worth more than the last sample cost
+  double gain = drift * (m_slicer_phase_ipc[0] + m_slicer_phase_ipc[1]) *
+                (now - m_slicer_decision_cycle);
+  if (gain <= m_slicer_sample_cost) return;
+  printf("slicer phase change, ipc compute %.2f -> %.2f, graphics %.2f -> "
+         "%.2f, resampling\n",
+         m_slicer_phase_ipc[0], ipc[0], m_slicer_phase_ipc[1], ipc[1]);
+  m_slicer_decisions.erase(std::make_pair(graphics->name(), compute->name()));
+  start_slicer_sample(graphics, compute, now);
+}
+
+void gpgpu_sim::restart_after_fork() {
+  // the workers of the old pool only exist in the parent, so it can not be
+  // joined and is left behind
+  if (m_partition_pool)
+    m_partition_pool = new sim_thread_pool(m_partition_pool->size());
+  if (m_cluster_pool)
+    m_cluster_pool = new sim_thread_pool(m_cluster_pool->size());
+}
+
+void gpgpu_sim::dram_partition_cycle(unsigned i) {
+  if (m_memory_config->simple_dram_model)
+    m_memory_partition_unit[i]->simple_dram_model_cycle();
+  else
+    m_memory_partition_unit[i]
+        ->dram_cycle();  // Issue the dram command (scheduler + delay model)
+  // Update performance counters for DRAM
+  m_memory_partition_unit[i]->set_dram_power_stats(
+      m_power_stats->pwr_mem_stat->n_cmd[CURRENT_STAT_IDX][i],
+      m_power_stats->pwr_mem_stat->n_activity[CURRENT_STAT_IDX][i],
+      m_power_stats->pwr_mem_stat->n_nop[CURRENT_STAT_IDX][i],
+      m_power_stats->pwr_mem_stat->n_act[CURRENT_STAT_IDX][i],
+      m_power_stats->pwr_mem_stat->n_pre[CURRENT_STAT_IDX][i],
+      m_power_stats->pwr_mem_stat->n_rd[CURRENT_STAT_IDX][i],
+      m_power_stats->pwr_mem_stat->n_wr[CURRENT_STAT_IDX][i],
+      m_power_stats->pwr_mem_stat->n_wr_WB[CURRENT_STAT_IDX][i],
+      m_power_stats->pwr_mem_stat->n_req[CURRENT_STAT_IDX][i]);
+}
+
+void gpgpu_sim::cluster_core_cycle(unsigned i, bool core_idle) {
+  unsigned long long start = m_profiler.sampled() ? sim_profiler::ticks() : 0;
+  cluster_core_stats(i, cluster_core_stage(i, core_idle));
+  if (start) m_profiler.add_cluster(i, sim_profiler::ticks() - start);
+}
+
+bool gpgpu_sim::cluster_core_stage(unsigned i, bool core_idle) {
+  if (core_idle) {
+    if (get_more_cta_left()) m_cluster[i]->idle_core_cycle();
+  } else if (m_cluster_running_sms[i]) {
+    m_cluster[i]->core_cycle();
+    return true;
+  } else if (get_more_cta_left()) {
+    // every core of the cluster would return from cycle() right away
+    m_cluster[i]->idle_core_cycle();
+  }
+  return false;
+}
+
+void gpgpu_sim::cluster_core_stats(unsigned i, bool cycled) {
+  if (cycled) *active_sms += m_cluster[i]->get_n_active_sms();
+  // Update core icnt/cache stats for AccelWattch
+  if (m_config.g_power_simulation_enabled) {
+    m_cluster[i]->get_icnt_stats(
+        m_power_stats->pwr_mem_stat->n_simt_to_mem[CURRENT_STAT_IDX][i],
+        m_power_stats->pwr_mem_stat->n_mem_to_simt[CURRENT_STAT_IDX][i]);
+    // m_cluster[i]->get_cache_stats(
+    //     m_power_stats->pwr_mem_stat->core_cache_stats[CURRENT_STAT_IDX]);
+  }
+  // cores without a CTA have no active warps and add nothing
+  if (cycled)
+    m_cluster[i]->get_current_occupancy(
+        gpu_occupancy.aggregate_warp_slot_filled,
+        gpu_occupancy.aggregate_theoretical_warp_slots);
+}
+
 unsigned long long g_single_step =
     0;  // set this in gdb to single step the pipeline
 
 void gpgpu_sim::cycle() {
   int clock_mask = next_clock_domain();
-
-  if (clock_mask & CORE) {
-    // shader core loading (pop from ICNT into core) follows CORE clock
-    for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++)
-      m_cluster[i]->icnt_cycle();
+  m_profiler.begin_cycle();
+
+  if (clock_mask & (CORE | CLUSTER)) {
+    sim_phase_timer timer(m_profiler, PHASE_CORE_ICNT);
+    // shader core loading (pop from ICNT into core) follows CORE clock, or
+    // the cluster's own
+    if (clock_mask & CORE)
+      for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++)
+        if (m_cluster_domain[i] == m_core_domain) m_cluster[i]->icnt_cycle();
+    for (unsigned i : m_ticked_clusters) m_cluster[i]->icnt_cycle();
   }
   unsigned partiton_replys_in_parallel_per_cycle = 0;
   // std::vector<unsigned> L2_breakdown;
@@ -2410,8 +4331,14 @@ void gpgpu_sim::cycle() {
   // std::vector<unsigned> L2_breakdown_temp;
   // L2_breakdown_temp.resize(4, 0);
   if (clock_mask & ICNT) {
+    sim_phase_timer timer(m_profiler, PHASE_MEM_TO_ICNT);
     // pop from memory controller to interconnect
     for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++) {
+      if (m_mem_replay.enabled()) {
+        // replies of replayed requests have no core to go to
+        replay_reply(i, gpu_sim_cycle + gpu_tot_sim_cycle);
+        continue;
+      }
       mem_fetch *mf = m_memory_sub_partition[i]->top();
       if (mf) {
         unsigned response_size =
@@ -2420,6 +4347,7 @@ void gpgpu_sim::cycle() {
           // if (!mf->get_is_write())
           mf->set_return_timestamp(gpu_sim_cycle + gpu_tot_sim_cycle);
           mf->set_status(IN_ICNT_TO_SHADER, gpu_sim_cycle + gpu_tot_sim_cycle);
+          m_memory_stats->icnt_class_push(mf, response_size);
           ::icnt_push(m_shader_config->mem2device(i), mf->get_tpc(), mf,
                       response_size);
           m_memory_sub_partition[i]->pop();
@@ -2441,30 +4369,28 @@ void gpgpu_sim::cycle() {
   partiton_replys_in_parallel += partiton_replys_in_parallel_per_cycle;
 
   if (clock_mask & DRAM) {
-    for (unsigned i = 0; i < m_memory_config->m_n_mem; i++) {
-      if (m_memory_config->simple_dram_model)
-        m_memory_partition_unit[i]->simple_dram_model_cycle();
-      else
-        m_memory_partition_unit[i]
-            ->dram_cycle();  // Issue the dram command (scheduler + delay model)
-      // Update performance counters for DRAM
-      m_memory_partition_unit[i]->set_dram_power_stats(
-          m_power_stats->pwr_mem_stat->n_cmd[CURRENT_STAT_IDX][i],
-          m_power_stats->pwr_mem_stat->n_activity[CURRENT_STAT_IDX][i],
-          m_power_stats->pwr_mem_stat->n_nop[CURRENT_STAT_IDX][i],
-          m_power_stats->pwr_mem_stat->n_act[CURRENT_STAT_IDX][i],
-          m_power_stats->pwr_mem_stat->n_pre[CURRENT_STAT_IDX][i],
-          m_power_stats->pwr_mem_stat->n_rd[CURRENT_STAT_IDX][i],
-          m_power_stats->pwr_mem_stat->n_wr[CURRENT_STAT_IDX][i],
-          m_power_stats->pwr_mem_stat->n_wr_WB[CURRENT_STAT_IDX][i],
-          m_power_stats->pwr_mem_stat->n_req[CURRENT_STAT_IDX][i]);
+    sim_phase_timer timer(m_profiler, PHASE_DRAM);
+    if (m_partition_pool) {
+      // partitions only share m_memory_stats and the -gpgpu_multi_gpu links,
+      // whose updates are replayed in partition order once they are all done
+      m_partition_pool->run(m_memory_config->m_n_mem, [this](unsigned i) {
+        dram_partition_cycle(i);
+      });
+      for (unsigned i = 0; i < m_memory_config->m_n_mem; i++)
+        m_memory_partition_unit[i]->flush_dram_stats();
+    } else {
+      for (unsigned i = 0; i < m_memory_config->m_n_mem; i++)
+        dram_partition_cycle(i);
     }
   }
 
   // L2 operations follow L2 clock domain
   unsigned partiton_reqs_in_parallel_per_cycle = 0;
   if (clock_mask & L2) {
+    sim_phase_timer timer(m_profiler, PHASE_L2);
     m_power_stats->pwr_mem_stat->l2_cache_stats[CURRENT_STAT_IDX].clear();
+    if (m_mem_replay.enabled())
+      replay_arrivals(gpu_sim_cycle + gpu_tot_sim_cycle);
     for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++) {
       // move memory request from interconnect into memory partition (if not
       // backed up) Note:This needs to be called in DRAM clock domain if there
@@ -2473,7 +4399,15 @@ void gpgpu_sim::cycle() {
       if (m_memory_sub_partition[i]->full(SECTOR_CHUNCK_SIZE)) {
         gpu_stall_dramfull++;
       } else {
-        mem_fetch *mf = (mem_fetch *)icnt_pop(m_shader_config->mem2device(i));
+        mem_fetch *mf;
+        if (m_mem_replay.enabled()) {
+          mf = replay_pop(i);
+        } else {
+          mf = (mem_fetch *)icnt_pop(m_shader_config->mem2device(i));
+          if (mf) m_memory_stats->icnt_class_pop(mf);
+        }
+        if (mf && m_mem_request_log.enabled())
+          log_mem_request(mf, gpu_sim_cycle + gpu_tot_sim_cycle);
         m_memory_sub_partition[i]->push(mf, gpu_sim_cycle + gpu_tot_sim_cycle);
         if (mf) partiton_reqs_in_parallel_per_cycle++;
       }
@@ -2493,39 +4427,61 @@ void gpgpu_sim::cycle() {
   }
 
   if (clock_mask & ICNT) {
+    sim_phase_timer timer(m_profiler, PHASE_ICNT_TRANSFER);
     icnt_transfer();
   }
 
+  if (clock_mask & CLUSTER) {
+    bool core_idle =
+        m_config.gpgpu_skip_idle_core_cycles && core_domain_idle();
+    for (unsigned i : m_ticked_clusters) cluster_core_cycle(i, core_idle);
+  }
+
   if (clock_mask & CORE) {
     // L1 cache + shader core pipeline stages
     m_power_stats->pwr_mem_stat->core_cache_stats[CURRENT_STAT_IDX].clear();
-    for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++) {
-      if (m_cluster[i]->get_not_completed() || get_more_cta_left()) {
-        m_cluster[i]->core_cycle();
-        *active_sms += m_cluster[i]->get_n_active_sms();
-      }
-      // Update core icnt/cache stats for AccelWattch
-      if (m_config.g_power_simulation_enabled) {
-        m_cluster[i]->get_icnt_stats(
-            m_power_stats->pwr_mem_stat->n_simt_to_mem[CURRENT_STAT_IDX][i],
-            m_power_stats->pwr_mem_stat->n_mem_to_simt[CURRENT_STAT_IDX][i]);
-        // m_cluster[i]->get_cache_stats(
-        //     m_power_stats->pwr_mem_stat->core_cache_stats[CURRENT_STAT_IDX]);
-      }
-      m_cluster[i]->get_current_occupancy(
-          gpu_occupancy.aggregate_warp_slot_filled,
-          gpu_occupancy.aggregate_theoretical_warp_slots);
+    // idle cores neither change state nor add to the occupancy or active SM
+    // counts, and no CTA issue can happen, so only the bookkeeping is kept
+    bool core_idle =
+        m_config.gpgpu_skip_idle_core_cycles && core_domain_idle();
+    if (core_idle) gpu_skipped_core_cycles++;
+    unsigned long long core_start =
+        m_profiler.sampled() ? sim_profiler::ticks() : 0;
+    if (m_cluster_pool) {
+      // shared effects wait in the cluster's log and are replayed in cluster
+      // order once every cluster of the core clock is done
+      m_cluster_pool->run(
+          m_shader_config->n_simt_clusters, [this, core_idle](unsigned i) {
+            if (m_cluster_domain[i] != m_core_domain) return;
+            core_stage_log::set_current(&m_cluster[i]->stage_log());
+            m_cluster_cycled[i] = cluster_core_stage(i, core_idle);
+            core_stage_log::set_current(NULL);
+          });
+      for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++)
+        if (m_cluster_domain[i] == m_core_domain) {
+          m_cluster[i]->flush_core_stage();
+          cluster_core_stats(i, m_cluster_cycled[i]);
+        }
+    } else {
+      for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++)
+        if (m_cluster_domain[i] == m_core_domain)
+          cluster_core_cycle(i, core_idle);
     }
+    if (core_start)
+      m_profiler.add(PHASE_CORE_CYCLE, sim_profiler::ticks() - core_start);
     if (m_config.g_power_simulation_enabled) {
       m_power_stats->pwr_mem_stat->core_cache_stats[CURRENT_STAT_IDX] +=
           aggregated_l1_stats;
     }
-    float temp = 0;
-    for (unsigned i = 0; i < m_shader_config->num_shader(); i++) {
-      temp += m_shader_stats->m_pipeline_duty_cycle[i];
+    // only the power model reads the duty cycle
+    if (m_config.g_power_simulation_enabled) {
+      float temp = 0;
+      for (unsigned n = 0; n < m_running_sms.size(); n++) {
+        temp += m_shader_stats->m_pipeline_duty_cycle[m_running_sms[n]];
+      }
+      temp = temp / m_shader_config->num_shader();
+      *average_pipeline_duty_cycle = ((*average_pipeline_duty_cycle) + temp);
     }
-    temp = temp / m_shader_config->num_shader();
-    *average_pipeline_duty_cycle = ((*average_pipeline_duty_cycle) + temp);
     // cout<<"Average pipeline duty cycle:
     // "<<*average_pipeline_duty_cycle<<endl;
 
@@ -2534,84 +4490,32 @@ void gpgpu_sim::cycle() {
       raise(SIGTRAP);  // Debug breakpoint
     }
     gpu_sim_cycle++;
-    unsigned period = 50000;
-    static unsigned last_sample = 0;
-
-    // calculate utility ratio
-    if ((gpu_tot_sim_cycle + gpu_sim_cycle - last_sample) > period &&
-        !(all_compute_done || all_graphics_done) &&
-        m_config.gpgpu_utility) {
-      float cp_factor = 1;
-      float gr_factor = 1;
-      l2_cp_access = std::max(l2_cp_access, 1u);
-      l2_gr_access = std::max(l2_gr_access, 1u);
-      if (l2_gr_access / l2_cp_access > 10) {
-        gr_factor = l2_gr_access / l2_cp_access;
-      } else if (l2_cp_access / l2_gr_access > 10) {
-        cp_factor = l2_cp_access / l2_gr_access;
-      }
-      // get total utility for all L2 banks
-      std::vector<unsigned> tot_gr_utility;
-      std::vector<unsigned> tot_cp_utility;
-      tot_gr_utility.resize(m_memory_config->m_L2_config.get_assoc(), 0);
-      tot_cp_utility.resize(m_memory_config->m_L2_config.get_assoc(), 0);
-      for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++) {
-        std::vector<unsigned> gr_utility;
-        std::vector<unsigned> cp_utility;
-        cache_stats l2_stats;
-        m_memory_sub_partition[i]->get_utility(gr_utility, cp_utility);
-        assert(gr_utility.size() == cp_utility.size());
-        for (unsigned j = 0; j < gr_utility.size(); j++) {
-          tot_gr_utility[j] += gr_utility[j];
-          tot_cp_utility[j] += cp_utility[j];
-
-          gr_utility[j] = 0;
-          cp_utility[j] = 0;
-        }
-      }
-
-      // get score
-      std::vector<unsigned> score;
-      score.resize(m_memory_config->m_L2_config.get_assoc() + 1, 0);
-      printf("intermediate L2 utility: \n");
-      printf("g_factor, c_factor: %f, %f\n", gr_factor, cp_factor);
-      for (unsigned i = 0; i < score.size(); i++) {
-        unsigned gr = i;
-        unsigned cp = score.size() - i;
-        for (unsigned j = 0; j < tot_gr_utility.size(); j++) {
-          if (j < gr) {
-            score[i] += tot_gr_utility[j] / gr_factor;
-          }
-          if (j < cp) {
-            score[i] += tot_cp_utility[j] / cp_factor;
-          }
-        }
-        printf("i = %d, score = %d\n ", i, score[i]);
-      }
-
-      // choose best score
-      unsigned best_score = 0;
-      unsigned best_score_index = 0;
-      for (unsigned i = 0; i < score.size(); i++) {
-        // get highest score
-        if (score[i] > best_score) {
-          best_score = score[i];
-          best_score_index = i;
-        }
-      }
-      if (best_score_index == 0) {
-        best_score_index = 1;
-      }
-      if (best_score_index == 16) {
-        best_score_index = 15;
-      }
-      printf("best score = %d\n", best_score_index);
-      fflush(stdout);
-      l2_utility_ratio = best_score_index;
-      last_sample = gpu_tot_sim_cycle + gpu_sim_cycle;
-      l2_gr_access = 0;
-      l2_cp_access = 0;
+    {
+      sim_phase_timer timer(m_profiler, PHASE_CONTROLLERS);
+      if (m_config.gpgpu_utility) update_l2_partition();
+      if (m_config.gpgpu_slicer) update_slicer();
+      if (m_config.gpgpu_sm_repartition) update_sm_partition();
+      if (m_config.gpgpu_frame_cta_throttle) update_frame_throttle();
+      if (m_config.gpgpu_mem_throttle) update_mem_throttle();
+      if (m_shader_config->gpgpu_concurrent_mig) update_mig_tenants();
+      if (m_class_clock_scale[0]) update_class_clocks();
+    }
+    if (m_mmu.enabled()) m_mmu.cycle(gpu_tot_sim_cycle + gpu_sim_cycle);
+    if (m_copy_engine.enabled())
+      m_copy_engine.cycle(gpu_tot_sim_cycle + gpu_sim_cycle);
+    if (m_hybrid.enabled()) {
+      m_hybrid.cycle(gpu_tot_sim_cycle + gpu_sim_cycle,
+                     m_num_running_kernels - m_num_running_compute,
+                     m_num_running_compute);
+      while (kernel_info_t *k =
+                 m_hybrid.finished(gpu_tot_sim_cycle + gpu_sim_cycle))
+        set_kernel_done(k);
     }
+    if (m_counter_sampler.enabled())
+      m_counter_sampler.tick(gpu_tot_sim_cycle + gpu_sim_cycle);
+    if (m_live_stats.enabled() &&
+        m_live_stats.due(gpu_tot_sim_cycle + gpu_sim_cycle))
+      publish_live_stats(false);
 
     if (g_interactive_debugger_enabled) gpgpu_debug();
 
@@ -2622,21 +4526,27 @@ void gpgpu_sim::cycle() {
       mcpat_cycle(m_config, getShaderCoreConfig(), m_gpgpusim_wrapper,
                   m_power_stats, m_config.gpu_stat_sample_freq,
                   gpu_tot_sim_cycle, gpu_sim_cycle, gpu_tot_sim_insn,
-                  gpu_sim_insn, m_config.g_dvfs_enabled, 0);
+                  gpu_sim_insn, m_config.g_dvfs_enabled, 0, m_class_energy,
+                  m_power_trace, m_dvfs_voltage,
+                  m_sm_gating.enabled() ? &m_sm_gating : NULL);
       }
     }
 #endif
 
-    issue_block2core();
+    if (!core_idle) {
+      sim_phase_timer timer(m_profiler, PHASE_ISSUE_BLOCK);
+      issue_block2core();
+    }
     decrement_kernel_latency();
 
     // Depending on configuration, invalidate the caches once all of threads are
     // completed.
     int all_threads_complete = 1;
     if (m_config.gpgpu_flush_l1_cache) {
+      bool keep_texture = m_frame_persistence.keep_l1_texture();
       for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++) {
         if (m_cluster[i]->get_not_completed() == 0)
-          m_cluster[i]->cache_invalidate();
+          m_cluster[i]->cache_invalidate(keep_texture);
         else
           all_threads_complete = 0;
       }
@@ -2652,7 +4562,9 @@ void gpgpu_sim::cycle() {
         }
       }
 
-      if (all_threads_complete && !m_memory_config->m_L2_config.disabled()) {
+      // -gpgpu_frame_persistence: a draw or frame boundary keeps the L2
+      if (all_threads_complete && !m_memory_config->m_L2_config.disabled() &&
+          !m_frame_persistence.keep_l2()) {
         printf("Flushed L2 caches...\n");
         if (m_memory_config->m_L2_config.get_num_lines()) {
           int dlc = 0;
@@ -2664,89 +4576,9 @@ void gpgpu_sim::cycle() {
         }
       }
     }
-    if (m_config.gpgpu_slicer && gpu_sim_cycle == 10000 && !slicer_sampled) {
-      // warper slicer
-      float max_ipc = 0;
-      unsigned selected_core = -1;
-      kernel_info_t *graphics = m_cluster[0]->get_core(0)->m_running_graphics;
-      kernel_info_t *compute = m_cluster[m_shader_config->n_simt_clusters / 2]
-                                    ->get_core(0)
-                                    ->m_running_compute;
-      if (graphics && compute) {
-        unsigned int warp_size = m_shader_config->warp_size;
-        unsigned compute_cta_size = compute->threads_per_cta();
-        if (compute_cta_size % warp_size) {
-          compute_cta_size = ((compute_cta_size / warp_size) + 1) * (warp_size);
-        }
-        unsigned graphics_cta_size = graphics->threads_per_cta();
-        if (graphics_cta_size % warp_size) {
-          graphics_cta_size =
-              ((graphics_cta_size / warp_size) + 1) * (warp_size);
-        }
-        for (unsigned i = 0; i < m_shader_config->n_simt_clusters / 2 - 1;
-             i++) {
-          assert(m_shader_config->n_simt_cores_per_cluster == 1);
-          // formula is (get_cluster_id() + 1 - m_config->num_shader() / 2) * 2
-          // cluster[7] has ratio of 16/16, skip. Only use i = [0-6]
-          // cluster[15] has ratio of 16/16, skip. Only use j = [8-14]
-          unsigned j = m_shader_config->n_simt_clusters / 2;
-          unsigned bound = m_shader_config->n_simt_clusters - i - 1;
-          for (; j < bound; j++) {
-            assert(i + j != 0);
-            assert(i + j <= m_shader_config->n_simt_clusters);
-            unsigned graphics_ratio = (i + 1) * 2;
-            unsigned compute_ratio =
-                (j + 1 - m_shader_config->n_simt_clusters / 2) * 2;
-            unsigned max_graphics_threads =
-                m_shader_config->n_thread_per_shader * graphics_ratio /
-                concurrent_granularity;
-            unsigned max_compute_threads =
-                m_shader_config->n_thread_per_shader * compute_ratio /
-                concurrent_granularity;
-            unsigned graphics_cta = max_graphics_threads / graphics_cta_size;
-            unsigned compute_cta = max_compute_threads / compute_cta_size;
-            if (compute_cta == 0 || graphics_cta == 0) {
-              continue;
-            }
-            const struct gpgpu_ptx_sim_info *kernel_g =
-                ptx_sim_kernel_info(graphics->entry());
-            const struct gpgpu_ptx_sim_info *kernel_c =
-                ptx_sim_kernel_info(compute->entry());
-            unsigned used_regs_g =
-                graphics_cta_size * ((kernel_g->regs + 3) & ~3);
-            unsigned used_regs_c =
-                compute_cta_size * ((kernel_c->regs + 3) & ~3);
-            bool limited_reg =
-                (graphics_cta * used_regs_g + compute_cta * used_regs_c) >
-                m_shader_config->gpgpu_shader_registers;
-            bool limited_shmem =
-                (graphics_cta * kernel_g->smem + compute_cta * kernel_c->smem) >
-                m_shader_config->gpgpu_shmem_size;
-            if (limited_shmem || limited_reg) {
-              continue;
-            }
-
-            // i graphics and j compute can run together
-            float scale = 1;
-            float scaled_ipc = m_cluster[i]->get_core(0)->shader_inst * scale;
-            scaled_ipc += m_cluster[j]->get_core(0)->shader_inst * scale;
-            if (scaled_ipc > max_ipc) {
-              selected_core = i;
-              max_ipc = scaled_ipc;
-            }
-          }
-        }
-        if (selected_core != (unsigned)-1) {
-          dynamic_sm_count = (selected_core + 1) * 2;
-          slicer_sampled = true;
-          printf("slicer sampled, dynamic_sm_count = %d\n", dynamic_sm_count);
-        }
-      } else {
-        printf("slicer not sampled, graphics or compute kernel not found\n");
-      }
-    }
 
-    if (!(gpu_sim_cycle % m_config.gpu_stat_sample_freq)) {
+    if (gpu_sim_cycle >= m_next_stat_sample_cycle) {
+      m_next_stat_sample_cycle += m_config.gpu_stat_sample_freq;
       time_t days, hrs, minutes, sec;
       time_t curr_time;
       time(&curr_time);
@@ -2796,9 +4628,12 @@ void gpgpu_sim::cycle() {
       }
     }
 
-    if (!(gpu_sim_cycle % 100000)) {
+    if (gpu_sim_cycle >= m_next_deadlock_check_cycle) {
+      m_next_deadlock_check_cycle += m_config.gpu_deadlock_check_interval;
       // deadlock detection
-      if (m_config.gpu_deadlock_detect && gpu_sim_insn == last_gpu_sim_insn) {
+      // a kernel of -gpgpu_hybrid_fidelity commits none
+      if (m_config.gpu_deadlock_detect && gpu_sim_insn == last_gpu_sim_insn &&
+          !m_hybrid.busy()) {
         gpu_deadlock = true;
       } else {
         last_gpu_sim_insn = gpu_sim_insn;
@@ -2812,6 +4647,7 @@ void gpgpu_sim::cycle() {
     gpgpu_ctx->device_runtime->launch_one_device_kernel();
 #endif
   }
+  m_profiler.end_cycle();
 }
 
 void gpgpu_sim::new_frame() {
@@ -2872,6 +4708,217 @@ void shader_core_ctx::dump_warp_state(FILE *fout) const {
     m_warp[w]->print(fout);
 }
 
+void gpgpu_sim::update_mig_tenants() {
+  linear_to_raw_address_translation &mapping =
+      m_memory_config->m_address_mapping;
+  if (mapping.fixed_tenants() || !concurrent_granularity ||
+      (dynamic_sm_count == m_mig_sm_count &&
+       concurrent_granularity == m_mig_granularity))
+    return;
+  m_mig_sm_count = dynamic_sm_count;
+  m_mig_granularity = concurrent_granularity;
+  unsigned share[MAX_TENANTS];
+  unsigned tenants = m_num_tenants;
+  unsigned total = 0;
+  if (!m_sm_tenant.empty()) {
+    for (unsigned t = 0; t < tenants; t++) share[t] = m_tenant_sms[t];
+    total = m_shader_config->num_shader();
+  } else {
+    share[MIG_GRAPHICS_TENANT] = dynamic_sm_count;
+    share[MIG_COMPUTE_TENANT] = concurrent_granularity - dynamic_sm_count;
+    total = concurrent_granularity;
+  }
+  // contiguous sets in tenant order, each tenant keeps at least one sub
+  // partition while there are enough
+  unsigned n = m_memory_config->m_n_mem_sub_partition;
+  unsigned first = 0;
+  unsigned sum = 0;
+  for (unsigned t = 0; t < tenants; t++) {
+    sum += share[t];
+    unsigned last = t == tenants - 1 ? n : n * sum / total;
+    if (n >= tenants)
+      last = std::min(std::max(last, first + 1), n - (tenants - 1 - t));
+    std::vector<unsigned> subs;
+    for (unsigned s = first; s < last; s++) subs.push_back(s);
+    mapping.set_tenant_sub_partitions(t, subs);
+    first = std::max(first, last);
+  }
+}
+
+void gpgpu_sim::print_l2_stats(unsigned kernel_id) {
+  if (!m_memory_config->m_L2_config.disabled()) {
+    cache_stats l2_stats;
+    l2_stats.resize(aggregated_l2_stats.get_size());
+    struct cache_sub_stats l2_css;
+    struct cache_sub_stats total_l2_css;
+    l2_stats.clear();
+    l2_css.clear();
+    total_l2_css.clear();
+    std::vector<unsigned> tot_gr_utility;
+    std::vector<unsigned> tot_cp_utility;
+    tot_gr_utility.resize(m_memory_config->m_L2_config.get_assoc(), 0);
+    tot_cp_utility.resize(m_memory_config->m_L2_config.get_assoc(), 0);
+
+    printf("\n========= L2 cache stats =========\n");
+    for (unsigned i = 0; i < m_memory_config->m_n_mem_sub_partition; i++) {
+      m_memory_sub_partition[i]->accumulate_L2cache_stats(l2_stats);
+      m_memory_sub_partition[i]->get_L2cache_sub_stats(kernel_id, l2_css);
+      if (m_config.gpgpu_utility) {
+        std::vector<unsigned> gr_utility;
+        std::vector<unsigned> cp_utility;
+        m_memory_sub_partition[i]->get_utility(gr_utility, cp_utility);
+        assert(gr_utility.size() == cp_utility.size());
+        for (unsigned j = 0; j < gr_utility.size(); j++) {
+          tot_gr_utility[j] += gr_utility[j];
+          tot_cp_utility[j] += cp_utility[j];
+        }
+      }
+
+      fprintf(stdout,
+              "L2_cache_bank[%d]: Access = %llu, Miss = %llu, Miss_rate = "
+              "%.3lf, Pending_hits = %llu, Reservation_fails = %llu\n",
+              i, l2_css.accesses, l2_css.misses,
+              (double)l2_css.misses / (double)l2_css.accesses,
+              l2_css.pending_hits, l2_css.res_fails);
+
+      total_l2_css += l2_css;
+    }
+    if (m_config.gpgpu_utility) {
+      for (unsigned i = 0; i < tot_gr_utility.size(); i++) {
+        printf("L2_cache_utility[%d]: gr_utility = %u, cp_utility = %u\n", i,
+               tot_gr_utility[i], tot_cp_utility[i]);
+      }
+    }
+    if (!m_memory_config->m_L2_config.disabled() &&
+        m_memory_config->m_L2_config.get_num_lines()) {
+      // L2c_print_cache_stat();
+      printf("L2_total_cache_accesses = %llu\n", total_l2_css.accesses);
+      printf("L2_total_cache_misses = %llu\n", total_l2_css.misses);
+      if (total_l2_css.accesses > 0)
+        printf("L2_total_cache_miss_rate = %.4lf\n",
+               (double)total_l2_css.misses / (double)total_l2_css.accesses);
+      printf("L2_total_cache_pending_hits = %llu\n", total_l2_css.pending_hits);
+      printf("L2_total_cache_reservation_fails = %llu\n",
+             total_l2_css.res_fails);
+      printf("L2_total_cache_breakdown:\n");
+      l2_stats.print_stats(kernel_id, stdout, "L2_cache_stats_breakdown");
+      printf("L2_total_cache_reservation_fail_breakdown:\n");
+      l2_stats.print_fail_stats(kernel_id, stdout, "L2_cache_stats_fail_breakdown");
+      total_l2_css.print_port_stats(stdout, "L2_cache");
+      l2_stats.print_prefetch_stats(stdout, "L2_cache");
+    }
+  }
+}
+
+void gpgpu_sim::log_mem_request(mem_fetch *mf, unsigned long long cycle) {
+  mem_request r;
+  r.cycle = cycle;
+  r.addr = mf->get_addr();
+  r.size = mf->get_access_size();
+  r.sid = mf->get_sid();
+  r.access_type = mf->get_access_type();
+  r.sectors = mf->get_access_sector_mask().to_ulong();
+  r.flags = 0;
+  if (mf->is_graphics()) r.flags |= mem_request::REQ_GRAPHICS;
+  if (mf->get_is_write()) r.flags |= mem_request::REQ_WRITE;
+  if (mf->istexture()) r.flags |= mem_request::REQ_TEX_SPACE;
+  if (mf->is_tex()) r.flags |= mem_request::REQ_TEX_INST;
+  r.tenant = mf->get_tenant();
+  m_mem_request_log.record(r);
+}
+
+void gpgpu_sim::replay_arrivals(unsigned long long cycle) {
+  while (m_replay_has_next && m_replay_next.cycle <= cycle) {
+    const mem_request &r = m_replay_next;
+    bool is_graphics = r.flags & mem_request::REQ_GRAPHICS;
+    if (r.flags & mem_request::REQ_COPY) {
+      perf_memcpy_to_gpu(r.addr, r.size, is_graphics);
+    } else {
+      bool write = r.flags & mem_request::REQ_WRITE;
+      // the logged run may have had more SMs
+      unsigned sid = r.sid % m_shader_config->num_shader();
+      active_mask_t warp_mask;
+      warp_mask.set();
+      mem_access_byte_mask_t byte_mask;
+      for (unsigned b = r.addr % MAX_MEMORY_ACCESS_SIZE;
+           b < r.addr % MAX_MEMORY_ACCESS_SIZE + r.size &&
+           b < MAX_MEMORY_ACCESS_SIZE;
+           b++)
+        byte_mask.set(b);
+      mem_access_t access((mem_access_type)r.access_type, r.addr, r.size,
+                          write, warp_mask, byte_mask,
+                          mem_access_sector_mask_t(r.sectors), gpgpu_ctx);
+      mem_fetch *mf = new mem_fetch(
+          access, NULL, write ? WRITE_PACKET_SIZE : READ_PACKET_SIZE, 0, sid,
+          m_shader_config->sid_to_cluster(sid), m_memory_config, r.cycle, 0);
+      if (m_shader_config->gpgpu_concurrent_mig) update_mig_tenants();
+      mf->set_replay_source(is_graphics, r.tenant,
+                            r.flags & mem_request::REQ_TEX_SPACE,
+                            r.flags & mem_request::REQ_TEX_INST);
+      m_replay_queues[mf->get_sub_partition_id()].push_back(mf);
+      m_replay_requests[is_graphics]++;
+    }
+    m_replay_has_next = m_mem_replay.next(m_replay_next);
+  }
+}
+
+mem_fetch *gpgpu_sim::replay_pop(unsigned sub_partition) {
+  std::deque<mem_fetch *> &q = m_replay_queues[sub_partition];
+  if (q.empty()) return NULL;
+  mem_fetch *mf = q.front();
+  q.pop_front();
+  return mf;
+}
+
+void gpgpu_sim::replay_reply(unsigned sub_partition,
+                             unsigned long long cycle) {
+  mem_fetch *mf = m_memory_sub_partition[sub_partition]->top();
+  if (!mf) return;
+  m_memory_sub_partition[sub_partition]->pop();
+  m_replay_replies[mf->is_graphics()]++;
+  m_replay_latency[mf->is_graphics()] += cycle - mf->get_timestamp();
+  delete mf;
+}
+
+bool gpgpu_sim::mem_replay_done() const {
+  if (m_replay_has_next) return false;
+  for (unsigned i = 0; i < m_replay_queues.size(); i++)
+    if (!m_replay_queues[i].empty()) return false;
+  for (unsigned i = 0; i < m_memory_config->m_n_mem; i++)
+    if (m_memory_partition_unit[i]->busy()) return false;
+  return true;
+}
+
+void gpgpu_sim::run_mem_replay() {
+  if (m_config.gpgpu_flush_l2_cache) {
+    fprintf(stderr, "GPGPU-Sim: -gpgpu_mem_replay runs no kernels, it can "
+                    "not flush the L2 at their end\n");
+    exit(1);
+  }
+  printf("GPGPU-Sim: replaying the memory requests of %s\n",
+         m_config.gpgpu_mem_replay);
+  while (!mem_replay_done()) cycle();
+  m_mem_replay.close();
+
+  static const char *cls[2] = {"compute", "graphics"};
+  printf("mem_replay_cycles = %llu\n", gpu_sim_cycle + gpu_tot_sim_cycle);
+  for (unsigned c = 0; c < 2; c++)
+    printf("mem_replay_%s_requests = %llu, replies = %llu, avg_latency = "
+           "%.2f\n",
+           cls[c], m_replay_requests[c], m_replay_replies[c],
+           m_replay_replies[c]
+               ? (double)m_replay_latency[c] / m_replay_replies[c]
+               : 0.0);
+  printf("gpu_stall_dramfull = %d\n", gpu_stall_dramfull);
+  for (unsigned c = 0; c < 2; c++)
+    printf("mem_replay_%s_l2_accesses = %llu, hits = %llu\n", cls[c],
+           l2_class_accesses[c], l2_class_hits[c]);
+  if (m_memory_config->scheduler_type == DRAM_FRFCFS)
+    m_memory_stats->print_dram_class_stats(gpu_tot_sim_cycle + gpu_sim_cycle);
+  // replayed requests belong to no kernel, uid 0
+  print_l2_stats(0);
+}
+
 void gpgpu_sim::perf_memcpy_to_gpu(size_t dst_start_addr, size_t count, bool is_graphics) {
   if (m_memory_config->m_perf_sim_memcpy) {
     // if(!m_config.trace_driven_mode)    //in trace-driven mode, CUDA runtime
@@ -2879,69 +4926,114 @@ void gpgpu_sim::perf_memcpy_to_gpu(size_t dst_start_addr, size_t count, bool is_
     // 32
     //== 0);
 
+    if (m_mem_request_log.enabled()) {
+      mem_request r;
+      r.cycle = gpu_sim_cycle + gpu_tot_sim_cycle;
+      r.addr = dst_start_addr;
+      r.size = count;
+      r.sid = r.access_type = r.sectors = r.tenant = 0;
+      r.flags = mem_request::REQ_COPY |
+                (is_graphics ? mem_request::REQ_GRAPHICS : 0);
+      m_mem_request_log.record(r);
+    }
+    bool mig = m_shader_config->gpgpu_concurrent_mig;
+    if (mig) update_mig_tenants();
+    unsigned tenant = is_graphics ? MIG_GRAPHICS_TENANT : MIG_COMPUTE_TENANT;
+    if (m_copy_engine.enabled()) {
+      m_copy_engine.copy(dst_start_addr, count, is_graphics, tenant,
+                         gpu_sim_cycle + gpu_tot_sim_cycle);
+      return;
+    }
+    // chunks up to run_end share the decoded sub partition
+    new_addr_type run_start = 1, run_end = 0;
+    unsigned sub_partition = 0;
     for (unsigned counter = 0; counter < count; counter += 32) {
       const unsigned wr_addr = dst_start_addr + counter;
-      addrdec_t raw_addr;
       mem_access_sector_mask_t mask;
       mask.set(wr_addr % 128 / 32);
-      m_memory_config->m_address_mapping.addrdec_tlx(wr_addr, &raw_addr);
-      if (m_shader_config->gpgpu_concurrent_mig) {
-        float dynamic_ratio = (float)dynamic_sm_count / concurrent_granularity;
-        unsigned avail = m_memory_config->m_n_mem_sub_partition * dynamic_ratio;
-        unsigned sub_partition = raw_addr.sub_partition;
-        if (is_graphics) {
-          sub_partition = sub_partition * dynamic_ratio;
-        } else {
-          unsigned avail_sm =
-              m_shader_config->num_shader() * (1.0f - dynamic_ratio);
-          unsigned start =
-              m_memory_config->m_n_mem_sub_partition * dynamic_ratio;
-          sub_partition =
-              start + sub_partition * avail_sm / m_shader_config->num_shader();
-        }
-
-        assert(sub_partition < m_memory_config->m_n_mem_sub_partition);
-        raw_addr.sub_partition = sub_partition;
+      if (wr_addr < run_start || wr_addr >= run_end) {
+        addrdec_t raw_addr;
+        m_memory_config->m_address_mapping.addrdec_tlx(wr_addr, &raw_addr);
+        sub_partition = raw_addr.sub_partition;
+        if (mig)
+          sub_partition = m_memory_config->m_address_mapping
+                              .tenant_sub_partition(tenant, sub_partition);
+        run_start = wr_addr;
+        run_end =
+            m_memory_config->m_address_mapping.sub_partition_run_end(wr_addr);
       }
       const unsigned partition_id =
-          raw_addr.sub_partition /
-          m_memory_config->m_n_sub_partition_per_memory_channel;
+          sub_partition / m_memory_config->m_n_sub_partition_per_memory_channel;
       m_memory_partition_unit[partition_id]->handle_memcpy_to_gpu(
-          wr_addr, raw_addr.sub_partition, mask, is_graphics);
+          wr_addr, sub_partition, mask, is_graphics);
+    }
+  }
+}
+void gpgpu_sim::warm_access(unsigned sid, const mem_access_t &access,
+                            bool use_l1, bool is_graphics) {
+  new_addr_type addr = access.get_addr();
+  mem_access_sector_mask_t mask = access.get_sector_mask();
+  if (use_l1) {
+    shader_core_ctx *core =
+        m_cluster[m_shader_config->sid_to_cluster(sid)]->get_core(
+            m_shader_config->sid_to_cid(sid));
+    m_warm_accesses[0]++;
+    if (core->warm_l1(addr, mask, is_graphics)) {
+      m_warm_hits[0]++;
+      return;
     }
   }
+  addrdec_t raw_addr;
+  m_memory_config->m_address_mapping.addrdec_tlx(addr, &raw_addr);
+  unsigned sub_partition = raw_addr.sub_partition;
+  if (m_shader_config->gpgpu_concurrent_mig) {
+    update_mig_tenants();
+    sub_partition = m_memory_config->m_address_mapping.tenant_sub_partition(
+        is_graphics ? MIG_GRAPHICS_TENANT : MIG_COMPUTE_TENANT, sub_partition);
+  }
+  unsigned partition_id =
+      sub_partition / m_memory_config->m_n_sub_partition_per_memory_channel;
+  m_warm_accesses[1]++;
+  if (m_memory_partition_unit[partition_id]->warm_l2(addr, sub_partition, mask,
+                                                     is_graphics))
+    m_warm_hits[1]++;
 }
+
 void gpgpu_sim::invalidate_l2_range(size_t start_addr, size_t count,
                                  bool is_graphics) {
+  bool mig = m_shader_config->gpgpu_concurrent_mig;
+  if (mig) update_mig_tenants();
+  unsigned tenant = is_graphics ? MIG_GRAPHICS_TENANT : MIG_COMPUTE_TENANT;
+  // chunks of one sub partition run go to its L2 as one range
+  new_addr_type run_start = 1, run_end = 0;
+  unsigned sub_partition = 0;
+  unsigned run_bytes = 0;
   for (unsigned counter = 0; counter < count; counter += 32) {
     const unsigned wr_addr = start_addr + counter;
+    if (run_bytes && wr_addr == run_start + run_bytes && wr_addr < run_end) {
+      run_bytes += 32;
+      continue;
+    }
+    if (run_bytes)
+      m_memory_partition_unit
+          [sub_partition /
+           m_memory_config->m_n_sub_partition_per_memory_channel]
+              ->invalidate_l2_range(run_start, run_bytes, sub_partition);
     addrdec_t raw_addr;
-    mem_access_sector_mask_t mask;
-    mask.set(wr_addr % 128 / 32);
     m_memory_config->m_address_mapping.addrdec_tlx(wr_addr, &raw_addr);
-    if (m_shader_config->gpgpu_concurrent_mig) {
-        float dynamic_ratio = (float) dynamic_sm_count / concurrent_granularity;
-        unsigned avail = m_memory_config->m_n_mem_sub_partition * dynamic_ratio;
-        unsigned sub_partition = raw_addr.sub_partition;
-        if (is_graphics) {
-          sub_partition = sub_partition * dynamic_ratio;
-        } else {
-          unsigned avail_sm =
-              m_shader_config->num_shader() * (1.0f - dynamic_ratio);
-          unsigned start =
-              m_memory_config->m_n_mem_sub_partition * dynamic_ratio;
-          sub_partition =
-              start + sub_partition * avail_sm / m_shader_config->num_shader();
-        }
-
-        assert(sub_partition < m_memory_config->m_n_mem_sub_partition);
-        raw_addr.sub_partition = sub_partition;
-      }
-    const unsigned partition_id =
-        raw_addr.sub_partition /
-        m_memory_config->m_n_sub_partition_per_memory_channel;
-    m_memory_partition_unit[partition_id]->invalidate_l2_range(wr_addr, 32, raw_addr.sub_partition);
+    sub_partition = raw_addr.sub_partition;
+    if (mig)
+      sub_partition =
+          m_memory_config->m_address_mapping.tenant_sub_partition(
+              tenant, sub_partition);
+    run_start = wr_addr;
+    run_end = m_memory_config->m_address_mapping.sub_partition_run_end(wr_addr);
+    run_bytes = 32;
   }
+  if (run_bytes)
+    m_memory_partition_unit[sub_partition /
+                            m_memory_config->m_n_sub_partition_per_memory_channel]
+        ->invalidate_l2_range(run_start, run_bytes, sub_partition);
 }
 
 void gpgpu_sim::dump_pipeline(int mask, int s, int m) const {
@@ -33,15 +33,37 @@
 #define GPU_SIM_H
 
 #include <stdio.h>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <list>
+#include <unordered_set>
 #include "../abstract_hardware_model.h"
 #include "../option_parser.h"
 #include "../trace.h"
 #include "addrdec.h"
+#include "clock_domains.h"
+#include "counter_sampler.h"
+#include "frame_persistence.h"
 #include "gpu-cache.h"
+#include "copy_engine.h"
+#include "gpu_mmu.h"
+#include "kernel_stats_log.h"
+#include "l2_access_log.h"
+#include "live_stats.h"
+#include "hybrid_fidelity.h"
+#include "multi_gpu.h"
+#include "mem_request_log.h"
+#include "l1_carveout.h"
+#include "raster_pipeline.h"
+#include "surface_compression.h"
+#include "tile_binning.h"
+#include "validation_log.h"
 #include "shader.h"
+#include "sim_profiler.h"
+#include "sm_power_gating.h"
+#include "vertex_buffer.h"
+#include "visualizer_binary.h"
 
 // constants for statistics printouts
 #define GPU_RSTAT_SHD_INFO 0x1
@@ -161,6 +183,9 @@ struct power_config {
   int g_power_simulation_mode;
   bool g_dvfs_enabled;
   bool g_aggregate_power_stats;
+  bool g_power_trace_binary;
+  unsigned g_power_trace_window;
+  unsigned g_fast_power_interval;
   bool accelwattch_hybrid_configuration[hw_perf_t::HW_TOTAL_STATS];
 
   // Nonlinear power model
@@ -179,7 +204,8 @@ class memory_config {
     gpgpu_ctx = ctx;
     m_shader_config = NULL;
   }
-  void init() {
+  // quiet: do not print the parsed DRAM timing options
+  void init(bool quiet = false) {
     assert(gpgpu_dram_timing_opt);
     if (strchr(gpgpu_dram_timing_opt, '=') == NULL) {
       // dram timing option in ordered variables (legacy)
@@ -187,6 +213,7 @@ class memory_config {
       nbkgrp = 1;
       tCCDL = 0;
       tRTPL = 0;
+      tRRDL = tFAW = tREFIpb = tRFCpb = 0;
       sscanf(gpgpu_dram_timing_opt, "%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d",
              &nbk, &tCCD, &tRRD, &tRCD, &tRAS, &tRP, &tRC, &CL, &WL, &tCDLR,
              &tWR, &nbkgrp, &tCCDL, &tRTPL);
@@ -230,10 +257,25 @@ class memory_config {
           dram_opp, "RTPL", OPT_UINT32, &tRTPL,
           "read to precharge delay between accesses to different bank groups",
           "0");
+      option_parser_register(
+          dram_opp, "RRDL", OPT_UINT32, &tRRDL,
+          "minimal delay between activations in the same bank group", "0");
+      option_parser_register(dram_opp, "FAW", OPT_UINT32, &tFAW,
+                             "window holding at most four activations, 0 "
+                             "for none",
+                             "0");
+      option_parser_register(dram_opp, "REFI", OPT_UINT32, &tREFIpb,
+                             "interval between per-bank refreshes (REFpb), "
+                             "0 for none",
+                             "0");
+      option_parser_register(dram_opp, "RFC", OPT_UINT32, &tRFCpb,
+                             "cycles a per-bank refresh keeps its bank", "0");
 
       option_parser_delimited_string(dram_opp, gpgpu_dram_timing_opt, "=:;");
-      fprintf(stdout, "DRAM Timing Options:\n");
-      option_parser_print(dram_opp, stdout);
+      if (!quiet) {
+        fprintf(stdout, "DRAM Timing Options:\n");
+        option_parser_print(dram_opp, stdout);
+      }
       option_parser_destroy(dram_opp);
     }
 
@@ -244,6 +286,19 @@ class memory_config {
     }
     bk_tag_length = i - 1;
     assert(nbkgrp > 0 && "Number of bank groups cannot be zero");
+    lpddr5 = !strcmp(dram_type, "lpddr5");
+    if (!lpddr5 && strcmp(dram_type, "gddr")) {
+      printf("GPGPU-Sim: unknown -dram_type %s\n", dram_type);
+      exit(1);
+    }
+    // the 16B, 8B and BG bank architectures, BL16 or BL32
+    bool lpddr5_banks = (nbk == 16 && (nbkgrp == 1 || nbkgrp == 4)) ||
+                        (nbk == 8 && nbkgrp == 1);
+    if (lpddr5 && (!lpddr5_banks || (BL != 16 && BL != 32))) {
+      printf("GPGPU-Sim: -dram_type lpddr5 takes 16 banks in 1 or 4 bank "
+             "groups or 8 banks, and bursts of 16 or 32\n");
+      exit(1);
+    }
     tRCDWR = tRCD - (WL + 1);
     if (elimnate_rw_turnaround) {
       tRTW = 0;
@@ -296,6 +351,44 @@ class memory_config {
   unsigned gpu_n_mem_per_ctrlr;
 
   unsigned rop_latency;
+  // framebuffer writes through a rop_unit, see rop_unit.h
+  bool rop_model;
+  char *rop_fb;
+  unsigned rop_tiles;
+  unsigned rop_tile_size;
+  unsigned rop_tile_window;
+  unsigned rop_blend_latency;
+  char *rop_compression;
+  float rop_depth_ratio;
+  // compressed render targets in DRAM, see surface_compression.h
+  bool gpgpu_compression;
+  char *gpgpu_compression_surfaces;
+  unsigned gpgpu_compression_tile;
+  char *gpgpu_compression_ratios;
+  unsigned gpgpu_compression_meta_lines;
+  // stream prefetches of the L2 sub partitions, see l2_prefetcher.h
+  char *l2_prefetch;
+  unsigned l2_prefetch_degree;
+  unsigned l2_prefetch_distance;
+  unsigned l2_prefetch_streams;
+  unsigned l2_prefetch_inflight;
+  // address translation of the SMs, see gpu_mmu.h
+  char *gpgpu_tlb;
+  // host to device copies, see copy_engine.h
+  char *gpgpu_copy_engine;
+  // GPUs joined by a link, see multi_gpu.h
+  char *gpgpu_multi_gpu;
+  // one class in an analytical memory model, see hybrid_fidelity.h
+  char *gpgpu_hybrid_fidelity;
+  // background traffic of the other DRAM clients, see dram_traffic.h
+  float dram_traffic_rate;
+  unsigned dram_traffic_burst;
+  float dram_traffic_writes;
+  unsigned dram_traffic_size;
+  char *dram_traffic_region;
+  char *dram_traffic_pattern;
+  char *dram_traffic_trace;
+  unsigned dram_traffic_inflight;
   unsigned dram_latency;
 
   // DRAM parameters
@@ -305,6 +398,11 @@ class memory_config {
                    // GDDR5 this is identical to RTPS, if for other DRAM this is
                    // different, you will need to split them in two
 
+  unsigned tRRDL;    // activation to activation in the same bank group
+  unsigned tFAW;     // four activation window
+  unsigned tREFIpb;  // per-bank refresh interval, 0 = no refresh
+  unsigned tRFCpb;   // per-bank refresh cycle time
+
   unsigned tCCD;    // column to column delay
   unsigned tRRD;    // minimal time required between activation of rows in
                     // different banks
@@ -332,6 +430,9 @@ class memory_config {
       bk_tag_length;  // number of bits that define a bank inside a bank group
 
   unsigned nbk;
+  // -dram_type, gddr or lpddr5
+  char *dram_type;
+  bool lpddr5;
 
   bool elimnate_rw_turnaround;
 
@@ -341,7 +442,8 @@ class memory_config {
   unsigned
       dram_atom_size;  // number of bytes transferred per read or write command
 
-  linear_to_raw_address_translation m_address_mapping;
+  // mutable for the MIG tenant tables gpgpu_sim sets from the SM split
+  mutable linear_to_raw_address_translation m_address_mapping;
 
   unsigned icnt_flit_size;
 
@@ -354,6 +456,13 @@ class memory_config {
   unsigned gpgpu_frfcfs_dram_write_queue_size;
   unsigned write_high_watermark;
   unsigned write_low_watermark;
+  // row choice of the FR-FCFS scheduler, see dram_sched_policy
+  char *dram_sched_policy;
+  bool dram_sched_graphics_first;
+  unsigned dram_bliss_threshold;
+  unsigned dram_bliss_clear_period;
+  unsigned dram_atlas_quantum;
+  unsigned dram_atlas_age;
   bool m_perf_sim_memcpy;
   bool simple_dram_model;
 
@@ -381,7 +490,7 @@ class gpgpu_sim_config : public power_config,
            &gpu_runtime_stat_flag);
     m_shader_config.init();
     ptx_set_tex_cache_linesize(m_shader_config.m_L1T_config.get_line_sz());
-    m_memory_config.init();
+    m_memory_config.init(gpgpu_quiet_options);
     m_memory_config.set_shader_config(&m_shader_config);
     init_clock_domains();
     power_config::init();
@@ -407,6 +516,11 @@ class gpgpu_sim_config : public power_config,
   unsigned num_shader() const { return m_shader_config.num_shader(); }
   unsigned num_cluster() const { return m_shader_config.n_simt_clusters; }
   unsigned get_max_concurrent_kernel() const { return max_concurrent_kernel; }
+  bool kernel_select_bench() const { return gpgpu_kernel_select_bench; }
+  bool counter_sampling() const { return gpgpu_counter_sample_file[0]; }
+  bool quiet_options() const { return gpgpu_quiet_options; }
+  bool mem_replay() const { return gpgpu_mem_replay[0]; }
+  bool parallel_core_clusters() const { return gpgpu_core_cluster_threads > 1; }
   unsigned static_graphics_sm() const {
     return m_shader_config.gpgpu_graphics_sm_count;
   }
@@ -423,7 +537,38 @@ class gpgpu_sim_config : public power_config,
   unsigned dynamic_sm_count;
   unsigned mps_sm_count;
   bool gpgpu_slicer;
+  char *gpgpu_slicer_policy;
+  unsigned gpgpu_slicer_sample_cycles;
+  unsigned gpgpu_slicer_warmup_cycles;
+  unsigned gpgpu_slicer_phase_period;
+  unsigned gpgpu_slicer_phase_threshold;
+  bool gpgpu_sm_repartition;
+  unsigned gpgpu_sm_repartition_period;
+  unsigned gpgpu_sm_migration_cycles;
+  unsigned gpgpu_frame_deadline;
+  unsigned gpgpu_frame_slack;
+  bool gpgpu_frame_cta_throttle;
+  unsigned gpgpu_frame_throttle_period;
+  char *gpgpu_mem_class_caps;
+  char *gpgpu_mem_class_rates;
+  char *gpgpu_dram_class_caps;
+  char *gpgpu_dram_class_rates;
+  unsigned gpgpu_mem_token_depth;
+  bool gpgpu_mem_throttle;
+  unsigned gpgpu_mem_throttle_period;
+  unsigned gpgpu_mem_throttle_latency;
+  char *gpgpu_tenant_sms;
+  char *gpgpu_l2_tenant_ways;
   bool gpgpu_utility;
+  bool gpgpu_l2_way_partition;
+  bool gpgpu_l2_partition_per_bank;
+  char *gpgpu_l2_partition_policy;
+  unsigned gpgpu_l2_partition_period;
+  unsigned gpgpu_l2_umon_sets;
+  bool gpgpu_graphics_pipeline;
+  unsigned gpgpu_raster_latency;
+  unsigned gpgpu_tile_binning_window;
+  bool gpgpu_tile_binning_tpc;
 
  private:
   void init_clock_domains(void);
@@ -451,18 +596,43 @@ class gpgpu_sim_config : public power_config,
   char *gpgpu_runtime_stat;
   bool gpgpu_flush_l1_cache;
   bool gpgpu_flush_l2_cache;
+  unsigned gpgpu_frame_persistence;
   bool gpu_deadlock_detect;
+  unsigned gpu_deadlock_check_interval;
   int gpgpu_frfcfs_dram_sched_queue_size;
   int gpgpu_cflog_interval;
   char *gpgpu_clock_domains;
   unsigned max_concurrent_kernel;
   unsigned max_cta_per_kernel;
   bool enable_max_cta_per_kernel;
+  bool gpgpu_kernel_select_bench;
+  char *gpgpu_kernel_stats;
+  char *gpgpu_kernel_stats_file;
+  // equivalence check of two runs, see validation_log.h
+  char *gpgpu_validation_record;
+  char *gpgpu_validation_check;
+  unsigned gpgpu_validation_warp_interval;
+  char *gpgpu_counter_sample_file;
+  char *gpgpu_live_stats_file;
+  unsigned gpgpu_live_stats_period;
+  unsigned gpgpu_counter_sample_period;
+  unsigned gpgpu_counter_sample_chunk;
+  char *gpgpu_l2_access_log;
+  char *gpgpu_mem_request_log;
+  char *gpgpu_mem_replay;
+  unsigned gpgpu_self_profile;
+  bool gpgpu_quiet_options;
+  bool gpgpu_skip_idle_core_cycles;
+  char *gpgpu_cluster_clock_scale;
+  char *gpgpu_class_clock_scale;
+  unsigned gpgpu_mem_partition_threads;
+  unsigned gpgpu_core_cluster_threads;
 
   // visualizer
   bool g_visualizer_enabled;
   char *g_visualizer_filename;
   int g_visualizer_zlevel;
+  bool g_visualizer_binary;
 
   // statistics collection
   int gpu_stat_sample_freq;
@@ -559,7 +729,11 @@ class gpgpu_sim : public gpgpu_t {
   }
   void print_stats(unsigned kernel_id);
   void update_stats();
-  void deadlock_check();
+  // called every cycle, gpu_deadlock is only set by the instruction
+  // watermark checked every -gpgpu_deadlock_check_interval cycles
+  void deadlock_check() {
+    if (gpu_deadlock && m_config.gpu_deadlock_detect) report_deadlock();
+  }
   void inc_completed_cta() { gpu_completed_cta++; }
   void get_pdom_stack_top_info(unsigned sid, unsigned tid, unsigned *pc,
                                unsigned *rpc);
@@ -581,19 +755,114 @@ class gpgpu_sim : public gpgpu_t {
   bool get_more_cta_left() const;
   bool kernel_more_cta_left(kernel_info_t *kernel) const;
   bool hit_max_cta_count() const;
-  kernel_info_t *select_kernel(unsigned core_id);
+  // the driver only launches kernels whose dependencies are done; the
+  // prerequisite lookup is left for kernels that set one explicitly, and
+  // the fragments of a pipelined draw wait on its vertex CTAs here
+  bool prerequisite_done(const kernel_info_t *kernel) const {
+    return (kernel->prerequisite_kernel == (unsigned)-1 ||
+            m_finished_kernels.find(kernel->prerequisite_kernel) !=
+                m_finished_kernels.end()) &&
+           (m_raster_pipeline.empty() ||
+            m_raster_pipeline.cta_ready(kernel->get_uid(),
+                                        kernel->get_next_cta_id_single(),
+                                        gpu_sim_cycle + gpu_tot_sim_cycle));
+  }
+  // MPS: the kernel of the class SM `sid` belongs to
+  kernel_info_t *select_kernel(unsigned sid);
   kernel_info_t *select_kernel(shader_core_ctx *core);
   kernel_info_t *select_kernel();
+  // drops the kernel from the runnable lists once its last CTA is issued
+  void cta_issued(kernel_info_t *kernel);
+  // no core holds a thread and no CTA can be issued this cycle
+  bool core_domain_idle() const;
+  // an SM gained its first or retired its last CTA/thread
+  void set_sm_running(unsigned sid, bool running);
+  // in a child of fork(), which only inherits the calling thread
+  void restart_after_fork();
+  // -gpgpu_utility: resplit the L2 every -gpgpu_l2_partition_period cycles
+  void update_l2_partition();
+  // -gpgpu_slicer: sample the graphics/compute SM split for every new pair
+  // of kernels and on phase changes, then apply the policy's choice
+  void update_slicer();
+  // a kernel finished, look for a new pair at the next cycle
+  void slicer_kernel_boundary();
+  // -gpgpu_sm_repartition: every -gpgpu_sm_repartition_period cycles size
+  // the MPS graphics SM set to meet the frame deadline with the slack asked
+  // for and give the rest to compute; moved SMs drain before they switch
+  void update_sm_partition();
+  // -gpgpu_frame_cta_throttle: every -gpgpu_frame_throttle_period cycles
+  // cap the resident compute CTAs from the predicted end of the graphics of
+  // the frame in flight, no cap while the frame has slack
+  void update_frame_throttle();
+  bool compute_cta_throttled() const {
+    return m_resident_compute_ctas >= m_compute_cta_cap;
+  }
+  // a CTA of the kernel retired from its core
+  void cta_retired(kernel_info_t *kernel);
+  // the graphics kernels of a frame all finished
+  void frame_finished();
+  // push the memory class limits, the graphics ones scaled, to every SM and
+  // L2 sub partition
+  void apply_mem_limits();
+  // -gpgpu_mem_throttle: halve the graphics limits while compute requests
+  // take longer than the target, give them back while they are well under
+  // it or the frame is at risk
+  void update_mem_throttle();
+  void print_mem_limiter_stats() const;
+  void print_rop_stats() const;
+  // MPS: whether SM sid runs graphics under the current split or, with
+  // -gpgpu_tenant_sms, belongs to tenant 0
+  bool sm_runs_graphics(unsigned sid) const;
+  unsigned num_tenants() const { return m_num_tenants; }
+  const class sm_quota_policy *get_sm_quota_policy() const {
+    return m_sm_quota_policy;
+  }
+  // pin the per-class quotas of SM sid, [1] graphics, over the policy's
+  void set_sm_quota(unsigned sid, const struct sm_resources quota[2]);
+  // back to the policy's quotas
+  void clear_sm_quota(unsigned sid);
+  // thread instructions of one class committed by all cores
+  unsigned long long class_thread_insts(bool graphics) const;
   PowerscalingCoefficients *get_scaling_coeffs();
   void decrement_kernel_latency();
 
   const gpgpu_sim_config &get_config() const { return m_config; }
   void gpu_print_stat(unsigned kernel_id);
   void update_stats_size(unsigned kernel_id);
+  // the kernel's stats were printed, its per-kernel cache counters go to the
+  // next kernel and its memory stats into the totals
+  void release_stats(unsigned kernel_id);
+  // the finished kernel is about to be deleted, drops what still refers to
+  // it: its uid lookups and the cores' pointers to it
+  void kernel_released(kernel_info_t *kernel);
+  // the simulation is over, write out the -gpgpu_counter_sample_file rows
+  // and the -gpgpu_self_profile breakdown
+  void simulation_finished();
+  sim_profiler &profiler() { return m_profiler; }
+
+  // run the cluster at scale times the core clock from its next edge on;
+  // the listeners, AccelWattch among them, are told
+  void set_cluster_clock_scale(unsigned cluster, double scale);
+  double cluster_clock_scale(unsigned cluster) const {
+    return m_domain_scale[m_cluster_domain[cluster]];
+  }
+  typedef std::function<void(unsigned cluster, double scale)> clock_listener;
+  void add_clock_listener(const clock_listener &l) {
+    m_clock_listeners.push_back(l);
+  }
   void dump_pipeline(int mask, int s, int m) const;
 
   void perf_memcpy_to_gpu(size_t dst_start_addr, size_t count, bool is_graphics);
   void invalidate_l2_range(size_t start_addr, size_t count, bool is_graphics);
+  // functional warm-up: the access of a warp on SM sid goes through the tag
+  // arrays of its L1D (unless it bypasses it) and, on a miss there, of the
+  // L2, without MSHRs, interconnect or any timing
+  void warm_access(unsigned sid, const mem_access_t &access, bool use_l1,
+                   bool is_graphics);
+  // -gpgpu_concurrent_mig without -gpgpu_mig_sub_partitions: give each
+  // tenant the sub partitions in proportion to its SM share, the tables are
+  // only rebuilt when the split changed
+  void update_mig_tenants();
 
   // The next three functions added to be used by the functional simulation
   // function
@@ -636,6 +905,15 @@ class gpgpu_sim : public gpgpu_t {
   // clocks
   void reinit_clock_domains(void);
   int next_clock_domain(void);
+  void init_cluster_clocks();
+  // -gpgpu_class_clock_scale: the clusters follow the class of their SMs
+  void update_class_clocks();
+  // the L1 and pipeline cycle of one cluster
+  void cluster_core_cycle(unsigned i, bool core_idle);
+  // the part of it that only touches the cluster, true if core_cycle ran
+  bool cluster_core_stage(unsigned i, bool core_idle);
+  // the part that adds the cluster to the gpu level counts
+  void cluster_core_stats(unsigned i, bool cycled);
   void issue_block2core();
   void print_dram_stats(FILE *fout) const;
   void shader_print_runtime_stat(FILE *fout);
@@ -655,6 +933,29 @@ class gpgpu_sim : public gpgpu_t {
 
   std::vector<kernel_info_t *> m_running_kernels;
   unsigned m_last_issued_kernel;
+  unsigned m_num_running_kernels;
+  unsigned m_num_running_compute;
+
+  // running kernels that still have CTAs to issue, per class and in uid
+  // order, so kernel selection does not walk every running kernel slot
+  std::vector<kernel_info_t *> m_runnable_graphics;
+  std::vector<kernel_info_t *> m_runnable_compute;
+  // running kernels still counting down their launch latency
+  std::vector<kernel_info_t *> m_latency_kernels;
+  // SMs holding a CTA or an unfinished thread, in sid order, and their count
+  // per cluster; shader_core_ctx::cycle() does nothing on any other SM
+  std::vector<unsigned> m_running_sms;
+  std::vector<unsigned> m_cluster_running_sms;
+  std::vector<kernel_info_t *> &runnable_list(kernel_info_t *kernel) {
+    return kernel->is_graphic_kernel ? m_runnable_graphics : m_runnable_compute;
+  }
+  void remove_running(kernel_info_t *kernel);
+  kernel_info_t *issue_selected(kernel_info_t *kernel);
+
+  // -gpgpu_kernel_select_bench
+  unsigned long long m_select_kernel_ns;
+  unsigned long long m_select_kernel_calls;
+  friend class select_kernel_timer;
 
   std::list<unsigned> m_finished_kernel;
   // m_total_cta_launched == per-kernel count. gpu_tot_issued_cta == global
@@ -666,11 +967,23 @@ class gpgpu_sim : public gpgpu_t {
   unsigned m_last_cluster_issue;
   float *average_pipeline_duty_cycle;
   float *active_sms;
-  // time of next rising edge
-  double core_time;
-  double icnt_time;
-  double dram_time;
-  double l2_time;
+  // the core, icnt, L2 and DRAM domains, then one for each clock scale the
+  // clusters off the core clock run at
+  clock_domain_engine m_clocks;
+  unsigned m_core_domain;
+  // the clock_mask bit of each domain, the frequency ratio to the core clock
+  // and the clusters of each cluster domain
+  std::vector<int> m_domain_mask;
+  std::vector<double> m_domain_scale;
+  std::vector<std::vector<unsigned> > m_domain_clusters;
+  std::vector<unsigned> m_cluster_domain;
+  // clusters of the cluster domains with an edge in this step
+  std::vector<unsigned> m_ticked_clusters;
+  std::vector<clock_listener> m_clock_listeners;
+  double m_class_clock_scale[2];  // by is_graphics, 0 when not set
+  unsigned long long m_cluster_clock_changes;
+  // AccelWattch voltage, following the mean cluster frequency
+  double m_dvfs_voltage;
 
   // debug
   bool gpu_deadlock;
@@ -687,7 +1000,17 @@ class gpgpu_sim : public gpgpu_t {
   class memory_stats_t *m_memory_stats;
   class power_stat_t *m_power_stats;
   class gpgpu_sim_wrapper *m_gpgpusim_wrapper;
+  // per class split of the sampled power, NULL unless it is simulated
+  class class_energy *m_class_energy;
+  // -power_trace_binary, NULL when the power trace is text or off
+  class power_trace_stream *m_power_trace;
   unsigned long long last_gpu_sim_insn;
+  // gpu_sim_cycle of the next runtime stat sample and deadlock check, so
+  // cycle() compares instead of dividing
+  unsigned long long m_next_stat_sample_cycle;
+  unsigned long long m_next_deadlock_check_cycle;
+  void reset_sample_cycles();
+  void report_deadlock();
 
   unsigned long long last_liveness_message_time;
 
@@ -697,6 +1020,8 @@ class gpgpu_sim : public gpgpu_t {
       m_executed_kernel_names;  //< names of kernel for stat printout
   std::vector<unsigned>
       m_executed_kernel_uids;  //< uids of kernel launches for stat printout
+  std::unordered_set<unsigned>
+      m_executed_kernel_uid_set;  //< m_executed_kernel_uids for lookups
 
   std::map<unsigned, watchpoint_event> g_watchpoint_hits;
 
@@ -721,10 +1046,38 @@ class gpgpu_sim : public gpgpu_t {
   cache_stats aggregated_l2_stats;
   unsigned l2_gr_access;
   unsigned l2_cp_access;
-
-  std::unordered_map<unsigned,std::vector<unsigned long>> vb_addr;
-  std::unordered_map<unsigned,std::vector<unsigned long>> vb_size;
-  std::unordered_map<unsigned,std::vector<unsigned long>> vb_size_per_cta;
+  // L2 accesses and hits of each class since the start, by is_graphics
+  unsigned long long l2_class_accesses[2];
+  unsigned long long l2_class_hits[2];
+  // the same for the L1Ds
+  unsigned long long l1_class_accesses[2];
+  unsigned long long l1_class_hits[2];
+
+  vertex_buffer_manager &vertex_buffers() { return m_vertex_buffers; }
+  // -gpgpu_graphics_pipeline
+  raster_pipeline &raster() { return m_raster_pipeline; }
+  // -gpgpu_tile_binning_window
+  tile_binning &tile_bins() { return m_tile_binning; }
+  // -gpgpu_frame_persistence
+  frame_persistence &persistence() { return m_frame_persistence; }
+  // -gpgpu_compression
+  surface_compression &compression() { return m_compression; }
+  // -gpgpu_sm_gating_threshold
+  sm_power_gating &sm_gating() { return m_sm_gating; }
+  gpu_mmu &mmu() { return m_mmu; }
+  // -gpgpu_copy_engine
+  copy_engine &copies() { return m_copy_engine; }
+  // -gpgpu_multi_gpu
+  multi_gpu &multi_gpus() { return m_multi_gpu; }
+  // -gpgpu_hybrid_fidelity
+  hybrid_fidelity &hybrid() { return m_hybrid; }
+  // -gpgpu_validation_warp_interval
+  validation_log &validation() { return m_validation; }
+  // -gpgpu_l2_access_log
+  l2_access_log &l2_accesses() { return m_l2_access_log; }
+  // -gpgpu_mem_replay: cycles the memory side until every logged request
+  // was served, then prints its stats
+  void run_mem_replay();
   std::unordered_map<unsigned, kernel_info_t *>
       m_uid_to_kernel_info;  //< kernel information
   std::unordered_map<unsigned, unsigned>
@@ -766,6 +1119,152 @@ class gpgpu_sim : public gpgpu_t {
   // performance counter for stalls due to congestion.
   unsigned int gpu_stall_dramfull;
   unsigned int gpu_stall_icnt2sh;
+  // core cycles not evaluated with -gpgpu_skip_idle_core_cycles
+  unsigned long long gpu_skipped_core_cycles;
+  // functional warm-up accesses and hits of the L1Ds and the L2
+  unsigned long long m_warm_accesses[2];
+  unsigned long long m_warm_hits[2];
+
+  // runs the per-partition DRAM stage, NULL when it runs serially
+  class sim_thread_pool *m_partition_pool;
+  // runs the core cycle of the clusters, NULL when it runs serially
+  class sim_thread_pool *m_cluster_pool;
+  std::vector<unsigned char> m_cluster_cycled;  // by cluster, on the pool
+  class cache_partition_policy *m_l2_partition_policy;
+  unsigned long long m_l2_partition_last_sample;
+  void start_slicer_sample(kernel_info_t *graphics, kernel_info_t *compute,
+                           unsigned long long now);
+  void finish_slicer_sample(kernel_info_t *graphics, kernel_info_t *compute,
+                            unsigned long long now);
+  // apply the chosen split and watch it for phase changes
+  void slicer_decided(unsigned long long now);
+  class slicer_policy *m_slicer_policy;
+  // the per-class SM resource quotas of the concurrent mode
+  class sm_quota_policy *m_sm_quota_policy;
+  // the split the MIG tenant tables were built for
+  unsigned m_mig_sm_count;
+  unsigned m_mig_granularity;
+  vertex_buffer_manager m_vertex_buffers;
+  raster_pipeline m_raster_pipeline;
+  tile_binning m_tile_binning;
+  frame_persistence m_frame_persistence;
+  surface_compression m_compression;
+  // -gpgpu_l1_carveout_dynamic
+  l1_carveout m_l1_carveout;
+  sm_power_gating m_sm_gating;
+  gpu_mmu m_mmu;
+  copy_engine m_copy_engine;
+  multi_gpu m_multi_gpu;
+  hybrid_fidelity m_hybrid;
+  // -gpgpu_kernel_stats and -gpgpu_kernel_stats_file
+  kernel_stats_level m_kernel_stats_level;
+  kernel_stats_log m_kernel_stats_log;
+  // -gpgpu_validation_record and -gpgpu_validation_check
+  validation_log m_validation;
+  void validate_kernel(unsigned kernel_id);
+  void print_kernel_summary(unsigned kernel_id);
+  void log_kernel_stats(unsigned kernel_id);
+  // -gpgpu_counter_sample_file
+  counter_sampler m_counter_sampler;
+  l2_access_log m_l2_access_log;
+  // -gpgpu_mem_request_log and -gpgpu_mem_replay. Replayed requests wait in
+  // the queue of their sub partition from their cycle until it takes them
+  mem_request_log m_mem_request_log;
+  mem_request_reader m_mem_replay;
+  bool m_replay_has_next;
+  mem_request m_replay_next;
+  std::vector<std::deque<mem_fetch *> > m_replay_queues;
+  // by is_graphics, the latency from the logged cycle to the reply
+  unsigned long long m_replay_requests[2];
+  unsigned long long m_replay_replies[2];
+  unsigned long long m_replay_latency[2];
+  void log_mem_request(mem_fetch *mf, unsigned long long cycle);
+  void replay_arrivals(unsigned long long cycle);
+  mem_fetch *replay_pop(unsigned sub_partition);
+  void replay_reply(unsigned sub_partition, unsigned long long cycle);
+  bool mem_replay_done() const;
+  void print_l2_stats(unsigned kernel_id);
+  sim_profiler m_profiler;
+  void add_sampled_counters();
+  // -gpgpu_live_stats_file
+  live_stats m_live_stats;
+  void publish_live_stats(bool finished);
+  // -visualizer_binary
+  visualizer_binary m_visualizer_binary;
+  void visualizer_binary_sample();
+  // tenants: graphics and compute, or the -gpgpu_tenant_sms ones. The SMs
+  // of each and the tenant each SM runs, empty without -gpgpu_tenant_sms
+  unsigned m_num_tenants;
+  unsigned m_tenant_sms[MAX_TENANTS];
+  std::vector<unsigned char> m_sm_tenant;
+  // memory limits of each class, [1] graphics, as configured for one SM and
+  // one L2 sub partition, and the part of the graphics ones in force
+  struct mem_class_limits m_mem_sm_limits[2];
+  struct mem_class_limits m_mem_dram_limits[2];
+  bool m_mem_limited;
+  float m_mem_graphics_scale;
+  unsigned long long m_mem_throttle_next;
+  // compute requests retired at the SMs and their summed latency at the
+  // last decision
+  unsigned long long m_mem_throttle_retired;
+  unsigned long long m_mem_throttle_latency;
+  unsigned m_mem_throttle_changes;
+  unsigned long long m_slicer_next_check;
+  // the sample being taken: its measurement starts after the warmup, the
+  // per core committed instructions of the class the core samples then
+  unsigned long long m_slicer_measure_start;
+  bool m_slicer_measuring;
+  std::vector<unsigned long long> m_slicer_base_insts;
+  // the kernel pair the current split is for and the cycle it was chosen
+  unsigned m_slicer_graphics_uid;
+  unsigned m_slicer_compute_uid;
+  unsigned long long m_slicer_decision_cycle;
+  // splits chosen for pairs of kernel names, reused without sampling
+  std::map<std::pair<std::string, std::string>, unsigned> m_slicer_decisions;
+  // phase detection: per class IPC of the first period after a decision and
+  // the committed instructions at the start of the current period
+  float m_slicer_phase_ipc[2];
+  unsigned long long m_slicer_phase_insts[2];
+  unsigned long long m_slicer_phase_start;
+  // instructions the last sample lost against the split it chose
+  double m_slicer_sample_cost;
+  unsigned m_slicer_samples;
+  unsigned long long m_slicer_sampling_cycles;
+  double m_slicer_lost_insts;
+  // MPS repartitioning: the class each SM runs, whether it still drains CTAs
+  // of its old class and the cycle it may take CTAs of the new one
+  std::vector<bool> m_sm_graphics;
+  std::vector<bool> m_sm_draining;
+  std::vector<unsigned long long> m_sm_ready_cycle;
+  std::vector<unsigned long long> m_sm_last_move;
+  unsigned long long m_repartition_next;
+  unsigned long long m_repartition_insts;
+  unsigned long long m_repartition_start;
+  // graphics work and length of the frame in flight and the last one
+  unsigned long long m_frame_start_cycle;
+  unsigned long long m_frame_start_insts;
+  unsigned long long m_last_frame_insts;
+  unsigned long long m_last_frame_length;
+  unsigned m_sm_migrations;
+  unsigned m_frames;
+  unsigned m_frames_met;
+  unsigned m_frame_deadline_misses;
+  unsigned long long m_frame_start_compute_insts;
+  // compute CTA throttle: the cap on resident compute CTAs, -1 when open,
+  // and the cycles the frame in flight ran with a cap
+  unsigned m_resident_compute_ctas;
+  unsigned m_compute_cta_cap;
+  unsigned long long m_throttle_next;
+  unsigned long long m_throttle_insts;
+  unsigned long long m_throttle_start;
+  unsigned long long m_throttled_cycles;
+  unsigned long long m_tot_throttled_cycles;
+  // running average of the relative error of the graphics kernel cycles
+  // against the cycle model
+  double m_graphics_error_avg;
+  // cycles graphics has for the frame in flight, 0 when not known yet
+  unsigned long long frame_budget() const;
+  void dram_partition_cycle(unsigned i);
   unsigned long long partiton_reqs_in_parallel;
   unsigned long long partiton_reqs_in_parallel_total;
   unsigned long long partiton_reqs_in_parallel_util;
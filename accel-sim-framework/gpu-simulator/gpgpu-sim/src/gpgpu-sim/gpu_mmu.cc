@@ -0,0 +1,238 @@
+// Address translation of the SMs' memory accesses, see gpu_mmu.h
+
+#include "gpu_mmu.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpu-sim.h"
+#include "l2cache.h"
+#include "mem_fetch.h"
+
+static const unsigned VA_BITS = 49;
+static const unsigned LEVEL_BITS = 9;
+static const unsigned PTE_SIZE = 8;
+// above the 47 bit addresses of the traces, one region per level
+static const new_addr_type PAGE_TABLE_BASE = 1ULL << 48;
+static const unsigned LEVEL_REGION_SHIFT = 42;
+
+void tlb_array::configure(unsigned entries, unsigned assoc) {
+  m_assoc = assoc;
+  m_nset = entries / assoc;
+  m_key.assign(entries, 0);
+  m_time.assign(entries, 0);
+}
+
+bool tlb_array::lookup(new_addr_type key, unsigned long long time) {
+  unsigned first = (key % m_nset) * m_assoc;
+  for (unsigned i = first; i < first + m_assoc; i++) {
+    if (m_key[i] == key + 1) {
+      m_time[i] = time;
+      return true;
+    }
+  }
+  return false;
+}
+
+void tlb_array::insert(new_addr_type key, unsigned long long time) {
+  unsigned first = (key % m_nset) * m_assoc;
+  unsigned victim = first;
+  for (unsigned i = first; i < first + m_assoc; i++) {
+    if (m_key[i] == key + 1) {
+      victim = i;
+      break;
+    }
+    if (!m_key[i] || (m_key[victim] && m_time[i] < m_time[victim]))
+      victim = i;
+  }
+  m_key[victim] = key + 1;
+  m_time[victim] = time;
+}
+
+gpu_mmu::gpu_mmu() {
+  m_enabled = false;
+  m_config = NULL;
+  m_allocator = NULL;
+  m_active_walks = 0;
+  for (unsigned c = 0; c < 2; c++) {
+    m_l1_lookups[c] = m_l1_hits[c] = 0;
+    m_l2_lookups[c] = m_l2_hits[c] = 0;
+    m_walks_done[c] = m_walk_cache_hits[c] = 0;
+    m_walk_read_count[c] = m_walk_cycles[c] = 0;
+  }
+}
+
+gpu_mmu::~gpu_mmu() { delete m_allocator; }
+
+void gpu_mmu::configure(const memory_config *config, unsigned n_shader,
+                        unsigned n_sub_partitions) {
+  m_enabled = strcmp(config->gpgpu_tlb, "none") != 0;
+  if (!m_enabled) return;
+  unsigned page_kb, l1_entries, l1_assoc, l2_entries, l2_assoc, walk_entries;
+  if (sscanf(config->gpgpu_tlb, "%u:%u:%u:%u:%u:%u:%u:%u", &page_kb,
+             &l1_entries, &l1_assoc, &l2_entries, &l2_assoc, &m_l2_latency,
+             &walk_entries, &m_walkers) != 8 ||
+      (page_kb != 4 && page_kb != 64 && page_kb != 2048) || !l1_assoc ||
+      !l1_entries || l1_entries % l1_assoc || !l2_assoc || !l2_entries ||
+      l2_entries % l2_assoc || !walk_entries || !m_walkers) {
+    printf("GPGPU-Sim: -gpgpu_tlb \'%s\' is not <page KB 4, 64 or 2048>:"
+           "<L1 entries>:<L1 assoc>:<L2 entries>:<L2 assoc>:<L2 latency>:"
+           "<walk cache entries>:<walkers>, entries a multiple of assoc\n",
+           config->gpgpu_tlb);
+    exit(1);
+  }
+  m_config = config;
+  m_allocator = new partition_mf_allocator(config);
+  m_page_shift = 10 + LOGB2(page_kb);
+  m_levels = (VA_BITS - m_page_shift + LEVEL_BITS - 1) / LEVEL_BITS;
+  m_line_size = config->m_L2_config.get_line_sz();
+  m_sectored = config->m_L2_config.m_cache_type == SECTOR;
+  m_l1.resize(n_shader);
+  for (unsigned i = 0; i < n_shader; i++)
+    m_l1[i].configure(l1_entries, l1_assoc);
+  m_l2.configure(l2_entries, l2_assoc);
+  m_walk_cache.configure(walk_entries, walk_entries);
+  m_pending.resize(n_shader);
+  m_walk_reads.resize(n_sub_partitions);
+}
+
+enum tlb_request_status gpu_mmu::translate(unsigned sid, new_addr_type addr,
+                                           bool graphics, unsigned tenant,
+                                           unsigned kernel_uid,
+                                           unsigned long long cycle) {
+  new_addr_type vpn = addr >> m_page_shift;
+  std::unordered_map<new_addr_type, bool> &pending = m_pending[sid];
+  std::unordered_map<new_addr_type, bool>::iterator p = pending.find(vpn);
+  if (p != pending.end()) {
+    if (!p->second) return TLB_PENDING;
+    pending.erase(p);
+    return TLB_READY;
+  }
+  m_l1_lookups[graphics]++;
+  if (m_l1[sid].lookup(vpn, cycle)) {
+    m_l1_hits[graphics]++;
+    return TLB_HIT;
+  }
+  pending[vpn] = false;
+  l2_lookup l = {cycle + m_l2_latency, sid, vpn, graphics, tenant, kernel_uid};
+  m_l2_queue.push_back(l);
+  return TLB_MISS;
+}
+
+void gpu_mmu::cycle(unsigned long long cycle) {
+  // one latency for all, so the queue is in ready order
+  while (!m_l2_queue.empty() && m_l2_queue.front().ready <= cycle) {
+    l2_lookup l = m_l2_queue.front();
+    m_l2_queue.pop_front();
+    m_l2_lookups[l.graphics]++;
+    if (m_l2.lookup(l.vpn, cycle)) {
+      m_l2_hits[l.graphics]++;
+      finish(l.sid, l.vpn, cycle);
+      continue;
+    }
+    std::unordered_map<new_addr_type, walk>::iterator w = m_walks.find(l.vpn);
+    if (w != m_walks.end()) {
+      w->second.sids.push_back(l.sid);
+      continue;
+    }
+    walk &n = m_walks[l.vpn];
+    n.vpn = l.vpn;
+    n.graphics = l.graphics;
+    n.tenant = l.tenant;
+    n.kernel_uid = l.kernel_uid;
+    n.level = 0;
+    n.start = cycle;
+    n.sids.push_back(l.sid);
+    m_walk_queue.push_back(l.vpn);
+  }
+  while (m_active_walks < m_walkers && !m_walk_queue.empty()) {
+    walk &w = m_walks[m_walk_queue.front()];
+    m_walk_queue.pop_front();
+    m_active_walks++;
+    start_walk(w, cycle);
+  }
+}
+
+void gpu_mmu::start_walk(walk &w, unsigned long long cycle) {
+  // the walk cache holds the entries of levels 0 to m_levels - 2, keyed by
+  // the prefix of the address they translate and their level
+  w.level = 0;
+  for (unsigned l = m_levels - 1; l-- > 0;) {
+    if (m_walk_cache.lookup(prefix(w.vpn, l) * 8 + l, cycle)) {
+      m_walk_cache_hits[w.graphics]++;
+      w.level = l + 1;
+      break;
+    }
+  }
+  read_level(w, cycle);
+}
+
+void gpu_mmu::read_level(walk &w, unsigned long long cycle) {
+  new_addr_type pte = PAGE_TABLE_BASE +
+                      ((new_addr_type)w.level << LEVEL_REGION_SHIFT) +
+                      prefix(w.vpn, w.level) * PTE_SIZE;
+  unsigned size = m_sectored ? SECTOR_SIZE : m_line_size;
+  new_addr_type addr = pte - pte % size;
+  mem_access_byte_mask_t byte_mask;
+  mem_access_sector_mask_t sector_mask;
+  unsigned offset = addr % m_line_size;
+  for (unsigned b = 0; b < size; b++) byte_mask.set(offset + b);
+  if (m_sectored)
+    sector_mask.set(offset / SECTOR_SIZE);
+  else
+    sector_mask.set();
+  // from the SM that started the walk, for the per SM memory stats
+  unsigned sid = w.sids[0];
+  mem_fetch *mf = m_allocator->alloc(
+      addr, GLOBAL_ACC_R, active_mask_t().set(0), byte_mask, sector_mask, size,
+      false, cycle, w.kernel_uid, -1, sid,
+      m_config->m_shader_config->sid_to_cluster(sid), NULL);
+  mf->set_replay_source(w.graphics, w.tenant, false, false);
+  m_reads[mf] = w.vpn;
+  m_walk_reads[mf->get_sub_partition_id()].push_back(mf);
+  m_walk_read_count[w.graphics]++;
+}
+
+void gpu_mmu::walk_done(const mem_fetch *mf, unsigned long long cycle) {
+  std::unordered_map<const mem_fetch *, new_addr_type>::iterator r =
+      m_reads.find(mf);
+  assert(r != m_reads.end());
+  new_addr_type vpn = r->second;
+  m_reads.erase(r);
+  walk &w = m_walks[vpn];
+  if (w.level + 1 < m_levels) {
+    m_walk_cache.insert(prefix(vpn, w.level) * 8 + w.level, cycle);
+    w.level++;
+    read_level(w, cycle);
+    return;
+  }
+  m_l2.insert(vpn, cycle);
+  for (unsigned i = 0; i < w.sids.size(); i++) finish(w.sids[i], vpn, cycle);
+  m_walks_done[w.graphics]++;
+  m_walk_cycles[w.graphics] += cycle - w.start;
+  m_walks.erase(vpn);
+  m_active_walks--;
+}
+
+void gpu_mmu::finish(unsigned sid, new_addr_type vpn,
+                     unsigned long long cycle) {
+  m_l1[sid].insert(vpn, cycle);
+  m_pending[sid][vpn] = true;
+}
+
+void gpu_mmu::print(FILE *fp) const {
+  static const char *cls[2] = {"compute", "graphics"};
+  for (unsigned c = 0; c < 2; c++) {
+    fprintf(fp, "gpu_tlb_%s_l1 = %llu lookups, %llu hits\n", cls[c],
+            m_l1_lookups[c], m_l1_hits[c]);
+    fprintf(fp, "gpu_tlb_%s_l2 = %llu lookups, %llu hits\n", cls[c],
+            m_l2_lookups[c], m_l2_hits[c]);
+    fprintf(fp,
+            "gpu_tlb_%s_walks = %llu, walk_cache_hits = %llu, reads = %llu, "
+            "avg_latency = %.2f\n",
+            cls[c], m_walks_done[c], m_walk_cache_hits[c],
+            m_walk_read_count[c],
+            m_walks_done[c] ? (double)m_walk_cycles[c] / m_walks_done[c] : 0.0);
+  }
+}
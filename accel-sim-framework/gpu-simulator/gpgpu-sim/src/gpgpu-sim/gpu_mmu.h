@@ -0,0 +1,145 @@
+// Address translation of the SMs' memory accesses
+//
+// With -gpgpu_tlb <page KB>:<L1 entries>:<L1 assoc>:<L2 entries>:<L2 assoc>:
+// <L2 latency>:<walk cache entries>:<walkers> (none by default) every global,
+// local, texture and ray tracing access of an SM needs the translation of
+// its page, 4, 64 or 2048 KB, before it can enter its cache or the
+// interconnect. Each SM has a set associative L1 TLB that hits without
+// delay. A miss stalls the access (mem_stage_stall_type TLB_STALL) and goes
+// to the L2 TLB shared by all SMs, which answers after the L2 latency in
+// core cycles. An L2 TLB miss starts a page walk, or joins the one of its
+// page, on one of the walkers; the others wait for a walker in order. The
+// radix page table covers a 49 bit virtual address with 9 bits per level,
+// from 5 levels for 4 KB pages to 4 for 2 MB ones. The walk cache keeps the
+// entries of the upper levels, so a walk starts below the lowest level it
+// holds. Every level left is a dependent 8 byte read, issued as a mem_fetch
+// into the L2 sub partition of a page table laid out above the addresses of
+// the traces. The reads hit or miss in the L2 and DRAM like any other
+// request, of the class and tenant of the access that started the walk,
+// and their replies stop at the sub partition. A finished walk fills the L2
+// TLB and the L1 TLBs of the SMs waiting on its page. TLB entries are
+// shared by all tenants and classes and only leave by replacement, so
+// tenants on the same SMs and all of them in the L2 TLB evict each other.
+// Lookups, hits, walks and their reads are counted per class.
+
+#ifndef GPU_MMU_H
+#define GPU_MMU_H
+
+#include <stdio.h>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+#include "stats.h"
+
+class mem_fetch;
+class memory_config;
+class partition_mf_allocator;
+
+// set associative, LRU replacement
+class tlb_array {
+ public:
+  tlb_array() : m_assoc(1), m_nset(1) {}
+  void configure(unsigned entries, unsigned assoc);
+
+  // refreshes the entry of key on a hit
+  bool lookup(new_addr_type key, unsigned long long time);
+  void insert(new_addr_type key, unsigned long long time);
+
+ private:
+  unsigned m_assoc;
+  unsigned m_nset;
+  std::vector<new_addr_type> m_key;  // key + 1, 0 = invalid
+  std::vector<unsigned long long> m_time;
+};
+
+class gpu_mmu {
+ public:
+  gpu_mmu();
+  ~gpu_mmu();
+
+  void configure(const memory_config *config, unsigned n_shader,
+                 unsigned n_sub_partitions);
+  bool enabled() const { return m_enabled; }
+
+  // the translation of addr for an access of SM sid, the access goes on
+  // after TLB_HIT and TLB_READY
+  enum tlb_request_status translate(unsigned sid, new_addr_type addr, bool graphics,
+                            unsigned tenant, unsigned kernel_uid,
+                            unsigned long long cycle);
+  // the L2 TLB and the walkers, every core cycle
+  void cycle(unsigned long long cycle);
+
+  // the next page table read for sub partition sub, NULL when none waits
+  mem_fetch *walk_top(unsigned sub) const {
+    return m_walk_reads[sub].empty() ? NULL : m_walk_reads[sub].front();
+  }
+  void walk_pop(unsigned sub) { m_walk_reads[sub].pop_front(); }
+  // whether mf is a page table read
+  bool owns(const mem_fetch *mf) const { return m_reads.count(mf) > 0; }
+  // the reply of page table read mf left the L2
+  void walk_done(const mem_fetch *mf, unsigned long long cycle);
+
+  void print(FILE *fp) const;
+
+ private:
+  struct walk {
+    new_addr_type vpn;
+    bool graphics;
+    unsigned tenant;
+    unsigned kernel_uid;
+    unsigned level;  // of the next read
+    unsigned long long start;
+    std::vector<unsigned> sids;
+  };
+  struct l2_lookup {
+    unsigned long long ready;
+    unsigned sid;
+    new_addr_type vpn;
+    bool graphics;
+    unsigned tenant;
+    unsigned kernel_uid;
+  };
+
+  new_addr_type prefix(new_addr_type vpn, unsigned level) const {
+    return vpn >> (9 * (m_levels - 1 - level));
+  }
+  void start_walk(walk &w, unsigned long long cycle);
+  void read_level(walk &w, unsigned long long cycle);
+  void finish(unsigned sid, new_addr_type vpn, unsigned long long cycle);
+
+  bool m_enabled;
+  const memory_config *m_config;
+  partition_mf_allocator *m_allocator;
+  unsigned m_page_shift;
+  unsigned m_levels;
+  unsigned m_l2_latency;
+  unsigned m_walkers;
+  unsigned m_line_size;
+  bool m_sectored;
+
+  std::vector<tlb_array> m_l1;
+  tlb_array m_l2;
+  tlb_array m_walk_cache;
+  // per SM, the pages waited for: false while on the way, true once there
+  std::vector<std::unordered_map<new_addr_type, bool> > m_pending;
+  std::deque<l2_lookup> m_l2_queue;
+  std::unordered_map<new_addr_type, walk> m_walks;  // by vpn
+  std::deque<new_addr_type> m_walk_queue;           // waiting for a walker
+  unsigned m_active_walks;
+  std::unordered_map<const mem_fetch *, new_addr_type> m_reads;
+  std::vector<std::deque<mem_fetch *> > m_walk_reads;  // by sub partition
+
+  // [0] compute, [1] graphics
+  unsigned long long m_l1_lookups[2];
+  unsigned long long m_l1_hits[2];
+  unsigned long long m_l2_lookups[2];
+  unsigned long long m_l2_hits[2];
+  unsigned long long m_walks_done[2];
+  unsigned long long m_walk_cache_hits[2];
+  unsigned long long m_walk_read_count[2];
+  unsigned long long m_walk_cycles[2];
+};
+
+#endif
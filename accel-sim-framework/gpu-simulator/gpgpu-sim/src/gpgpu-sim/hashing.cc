@@ -1,10 +1,61 @@
 // author: Mahmoud Khairy, (Purdue Univ)
 // email: abdallm@purdue.edu
 
+#include "hashing.h"
+
 #include <math.h>
 #include <string.h>
+#include <bitset>
+#include <vector>
 #include "../abstract_hardware_model.h"
-#include "gpu-cache.h"
+
+// primitive polynomial of each degree, from Peterson's table
+static const unsigned long long ipoly_default_polynomial[17] = {
+    0,   3,    7,    11,   19,    37,    67,    137,  285,
+    529, 1033, 2053, 4179, 8219, 17475, 32771, 69643};
+
+ipoly_hash::ipoly_hash() {
+  m_mask = 0;
+  m_bytes = 0;
+}
+
+bool ipoly_hash::init(unsigned bank_set_num, unsigned long long polynomial) {
+  m_mask = 0;
+  m_bytes = 0;
+  unsigned degree = 0;
+  while ((1u << degree) < bank_set_num && degree < 16) degree++;
+  if (!bank_set_num || (1u << degree) != bank_set_num) return false;
+  if (!polynomial) polynomial = ipoly_default_polynomial[degree];
+  if (polynomial >> degree != 1 || !(polynomial & 1)) return false;
+
+  // the widths the equations of the degrees used so far were published with
+  unsigned width = 64;
+  if (degree == 4 && polynomial == 19) width = 13;
+  if (degree == 5 && polynomial == 37) width = 15;
+  if (degree == 6 && polynomial == 67) width = 19;
+
+  m_mask = bank_set_num - 1;
+  m_bytes = (width + 7) / 8;
+  memset(m_table, 0, sizeof(m_table));
+  // x^degree mod the polynomial, then one column per higher bit
+  unsigned long long column = polynomial & m_mask;
+  for (unsigned j = 0; j < width; j++) {
+    unsigned byte = j / 8;
+    unsigned bit = 1u << (j % 8);
+    for (unsigned v = bit; v < 256; v = (v + 1) | bit)
+      m_table[byte][v] ^= column;
+    column <<= 1;
+    if (column >> degree) column ^= polynomial;
+  }
+  return true;
+}
+
+static std::vector<ipoly_hash> ipoly_default_hashes() {
+  std::vector<ipoly_hash> hashes(17);
+  for (unsigned degree = 1; degree <= 16; degree++)
+    hashes[degree].init(1u << degree);
+  return hashes;
+}
 
 unsigned ipoly_hash_function(new_addr_type higher_bits, unsigned index,
                              unsigned bank_set_num) {
@@ -29,71 +80,32 @@ unsigned ipoly_hash_function(new_addr_type higher_bits, unsigned index,
    *
    * We go through all the strides 128 (10000000), 256 (100000000),...  and
    * do modular arithmetic in GF(2) Then, we create the H-matrix and group
-   * each bit together, for more info read the ISCA 1991 paper
+   * each bit together, for more info read the ISCA 1991 paper. ipoly_hash
+   * does the same at init: bit j of the higher bits flips the index bits
+   * of x^(degree + j) mod the polynomial
+   *
+   * equations for 16 banks use IPOLY(19), x^4 + x + 1, over the 13 lowest
+   * higher bits, for 32 banks IPOLY(37) over 15 and for 64 banks IPOLY(67)
+   * over 19 as above. The other degrees use a primitive polynomial of
+   * Peterson's table over all the higher bits
    *
    * IPOLY hashing guarantees conflict-free for all 2^n strides which widely
    * exit in GPGPU applications and also show good performance for other
    * strides.
    */
-  if (bank_set_num == 16) {
-    std::bitset<64> a(higher_bits);
-    std::bitset<4> b(index);
-    std::bitset<4> new_index(index);
-
-    new_index[0] =
-        a[11] ^ a[10] ^ a[9] ^ a[8] ^ a[6] ^ a[4] ^ a[3] ^ a[0] ^ b[0];
-    new_index[1] =
-        a[12] ^ a[8] ^ a[7] ^ a[6] ^ a[5] ^ a[3] ^ a[1] ^ a[0] ^ b[1];
-    new_index[2] = a[9] ^ a[8] ^ a[7] ^ a[6] ^ a[4] ^ a[2] ^ a[1] ^ b[2];
-    new_index[3] = a[10] ^ a[9] ^ a[8] ^ a[7] ^ a[5] ^ a[3] ^ a[2] ^ b[3];
-
-    return new_index.to_ulong();
-
-  } else if (bank_set_num == 32) {
-    std::bitset<64> a(higher_bits);
-    std::bitset<5> b(index);
-    std::bitset<5> new_index(index);
-
-    new_index[0] =
-        a[13] ^ a[12] ^ a[11] ^ a[10] ^ a[9] ^ a[6] ^ a[5] ^ a[3] ^ a[0] ^ b[0];
-    new_index[1] = a[14] ^ a[13] ^ a[12] ^ a[11] ^ a[10] ^ a[7] ^ a[6] ^ a[4] ^
-                   a[1] ^ b[1];
-    new_index[2] =
-        a[14] ^ a[10] ^ a[9] ^ a[8] ^ a[7] ^ a[6] ^ a[3] ^ a[2] ^ a[0] ^ b[2];
-    new_index[3] =
-        a[11] ^ a[10] ^ a[9] ^ a[8] ^ a[7] ^ a[4] ^ a[3] ^ a[1] ^ b[3];
-    new_index[4] =
-        a[12] ^ a[11] ^ a[10] ^ a[9] ^ a[8] ^ a[5] ^ a[4] ^ a[2] ^ b[4];
-    return new_index.to_ulong();
-
-  } else if (bank_set_num == 64) {
-    std::bitset<64> a(higher_bits);
-    std::bitset<6> b(index);
-    std::bitset<6> new_index(index);
-
-    new_index[0] = a[18] ^ a[17] ^ a[16] ^ a[15] ^ a[12] ^ a[10] ^ a[6] ^ a[5] ^
-                   a[0] ^ b[0];
-    new_index[1] = a[15] ^ a[13] ^ a[12] ^ a[11] ^ a[10] ^ a[7] ^ a[5] ^ a[1] ^
-                   a[0] ^ b[1];
-    new_index[2] = a[16] ^ a[14] ^ a[13] ^ a[12] ^ a[11] ^ a[8] ^ a[6] ^ a[2] ^
-                   a[1] ^ b[2];
-    new_index[3] = a[17] ^ a[15] ^ a[14] ^ a[13] ^ a[12] ^ a[9] ^ a[7] ^ a[3] ^
-                   a[2] ^ b[3];
-    new_index[4] = a[18] ^ a[16] ^ a[15] ^ a[14] ^ a[13] ^ a[10] ^ a[8] ^ a[4] ^
-                   a[3] ^ b[4];
-    new_index[5] =
-        a[17] ^ a[16] ^ a[15] ^ a[14] ^ a[11] ^ a[9] ^ a[5] ^ a[4] ^ b[5];
-    return new_index.to_ulong();
-  } else { /* Else incorrect number of channels for the hashing function */
+  static const std::vector<ipoly_hash> hashes = ipoly_default_hashes();
+  unsigned degree = 0;
+  while ((1u << degree) < bank_set_num && degree < 16) degree++;
+  if (!degree || (1u << degree) != bank_set_num) {
+    /* Else incorrect number of channels for the hashing function */
     assert(
         "\nmemory_partition_indexing error: The number of "
         "channels should be "
-        "16, 32 or 64 for the hashing IPOLY index function. other banks "
-        "numbers are not supported. Generate it by yourself! \n" &&
+        "a power of two up to 2^16 for the hashing IPOLY index function.\n" &&
         0);
-
     return 0;
   }
+  return hashes[degree].hash(higher_bits, index);
 }
 
 unsigned bitwise_hash_function(new_addr_type higher_bits, unsigned index,
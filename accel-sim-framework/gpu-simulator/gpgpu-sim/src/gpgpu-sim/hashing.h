@@ -10,7 +10,31 @@
 #define HASHING_H
 
 #include "../abstract_hardware_model.h"
-#include "gpu-cache.h"
+
+// IPOLY indexing of 2^degree banks, see ipoly_hash_function. init derives
+// the H-matrix of the polynomial once, hash then XORs one row of it per byte
+// of the higher bits out of a table
+class ipoly_hash {
+ public:
+  ipoly_hash();
+  // polynomial 0 takes the default one of the degree; false when
+  // bank_set_num is not a power of two up to 2^16 or the polynomial is
+  // not of its degree
+  bool init(unsigned bank_set_num, unsigned long long polynomial = 0);
+  bool valid() const { return m_bytes > 0; }
+
+  unsigned hash(new_addr_type higher_bits, unsigned index) const {
+    unsigned new_index = index & m_mask;
+    for (unsigned b = 0; b < m_bytes; b++)
+      new_index ^= m_table[b][(higher_bits >> (8 * b)) & 0xff];
+    return new_index;
+  }
+
+ private:
+  unsigned m_mask;
+  unsigned m_bytes;  // of the higher bits the H-matrix covers
+  unsigned m_table[8][256];
+};
 
 unsigned ipoly_hash_function(new_addr_type higher_bits, unsigned index,
                              unsigned bank_set_num);
@@ -0,0 +1,264 @@
+// Hybrid fidelity, the kernels of one class in an analytical memory model,
+// see hybrid_fidelity.h
+
+#include "hybrid_fidelity.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpu-sim.h"
+#include "l2cache.h"
+#include "mem_fetch.h"
+
+// the requests of a sub partition in flight at once
+static const unsigned HYBRID_INFLIGHT = 64;
+static const unsigned HYBRID_CHUNK_BITS = 16;
+
+hybrid_fidelity::hybrid_fidelity() {
+  m_mode = OFF;
+  m_graphics = false;
+  m_path = NULL;
+  m_config = NULL;
+  m_allocator = NULL;
+  m_line_size = 0;
+  for (unsigned s = 0; s < STREAMS; s++) m_streams[s] = 0;
+  m_next_stream = 0;
+  m_state = 0x9e3779b97f4a7c15ULL;
+  m_credit = 0;
+  m_cycles = m_kernels = m_kernel_cycles = 0;
+  m_reads = m_writes = m_sequential = 0;
+  m_issued = m_dropped = m_retired = m_latency = 0;
+}
+
+hybrid_fidelity::~hybrid_fidelity() { delete m_allocator; }
+
+void hybrid_fidelity::configure(const memory_config *config,
+                                unsigned n_sub_partitions) {
+  const char *option = config->gpgpu_hybrid_fidelity;
+  if (strcmp(option, "none") == 0) return;
+  char mode[8] = {0}, cls[9] = {0};
+  int path = 0;
+  if (sscanf(option, "%7[a-z]:%8[a-z]:%n", mode, cls, &path) != 2 || !path ||
+      !option[path] ||
+      (strcmp(mode, "record") != 0 && strcmp(mode, "model") != 0) ||
+      (strcmp(cls, "graphics") != 0 && strcmp(cls, "compute") != 0)) {
+    printf("GPGPU-Sim: -gpgpu_hybrid_fidelity \'%s\' is not <record or "
+           "model>:<graphics or compute>:<profile file>\n",
+           option);
+    exit(1);
+  }
+  m_mode = strcmp(mode, "record") == 0 ? RECORD : MODEL;
+  m_graphics = strcmp(cls, "graphics") == 0;
+  m_path = option + path;
+  m_config = config;
+  m_line_size = config->m_L2_config.get_line_sz();
+  if (m_mode == RECORD) return;
+  if (!load(m_path)) {
+    printf("GPGPU-Sim: -gpgpu_hybrid_fidelity profile %s holds no %s "
+           "kernel with requests\n",
+           m_path, cls);
+    exit(1);
+  }
+  m_allocator = new partition_mf_allocator(config);
+  m_sub_requests.resize(n_sub_partitions);
+  m_inflight.assign(n_sub_partitions, 0);
+}
+
+void hybrid_fidelity::l2_access(const mem_fetch *mf) {
+  if (mf->is_graphics() != m_graphics || mf->get_sid() == (unsigned)-1)
+    return;
+  new_addr_type line = mf->get_addr() - mf->get_addr() % m_line_size;
+  // the same or the next line of one of the last lines keeps to a row
+  unsigned s = 0;
+  while (s < STREAMS && m_streams[s] != line &&
+         m_streams[s] + m_line_size != line)
+    s++;
+  if (s < STREAMS) {
+    m_sequential++;
+  } else {
+    s = m_next_stream;
+    m_next_stream = (m_next_stream + 1) % STREAMS;
+  }
+  m_streams[s] = line;
+  if (mf->get_is_write())
+    m_writes++;
+  else
+    m_reads++;
+  m_sizes[mf->get_data_size()]++;
+  m_chunks[line >> HYBRID_CHUNK_BITS]++;
+}
+
+void hybrid_fidelity::kernel_launched(kernel_info_t *k,
+                                      unsigned long long cycles,
+                                      unsigned long long cycle) {
+  if (!cycles) cycles = (m_kernel_cycles + m_kernels - 1) / m_kernels;
+  k->start_cycle = cycle;
+  m_running[k] = cycle + cycles;
+}
+
+kernel_info_t *hybrid_fidelity::finished(unsigned long long cycle) const {
+  for (const auto &r : m_running)
+    if (r.second <= cycle) return r.first;
+  return NULL;
+}
+
+void hybrid_fidelity::kernel_done(kernel_info_t *k) {
+  if (m_mode == RECORD && k->is_graphic_kernel == m_graphics) {
+    m_kernels++;
+    m_kernel_cycles += k->end_cycle - k->start_cycle;
+  }
+  m_running.erase(k);
+}
+
+void hybrid_fidelity::cycle(unsigned long long cycle,
+                            unsigned graphics_kernels,
+                            unsigned compute_kernels) {
+  if (m_mode == RECORD) {
+    if (m_graphics ? graphics_kernels : compute_kernels) m_cycles++;
+    return;
+  }
+  if (m_running.empty()) {
+    m_credit = 0;
+    return;
+  }
+  m_credit += (double)(m_reads + m_writes) / m_cycles;
+  for (; m_credit >= 1; m_credit -= 1) issue(cycle);
+}
+
+void hybrid_fidelity::issue(unsigned long long cycle) {
+  unsigned long long requests = m_reads + m_writes;
+  unsigned s = random() % STREAMS;
+  new_addr_type line;
+  if (m_streams[s] && uniform() * requests < m_sequential) {
+    line = m_streams[s] + m_line_size;
+  } else {
+    new_addr_type chunk = draw(m_chunks, requests);
+    unsigned lines = (1 << HYBRID_CHUNK_BITS) / m_line_size;
+    line = (chunk << HYBRID_CHUNK_BITS) + random() % lines * m_line_size;
+  }
+  m_streams[s] = line;
+  unsigned size = draw(m_sizes, requests);
+  if (!size || size > m_line_size) size = m_line_size;
+  new_addr_type addr = line + random() % (m_line_size / size) * size;
+  bool write = uniform() * requests < m_writes;
+
+  mem_access_byte_mask_t byte_mask;
+  mem_access_sector_mask_t sector_mask;
+  for (new_addr_type b = addr; b < addr + size; b++) byte_mask.set(b - line);
+  for (unsigned sector = (addr - line) / SECTOR_SIZE;
+       sector <= (addr + size - 1 - line) / SECTOR_SIZE; sector++)
+    sector_mask.set(sector);
+  // no SM waits for it, the per SM stats leave it out like the L2
+  // writebacks
+  mem_fetch *mf = m_allocator->alloc(
+      addr, write ? GLOBAL_ACC_W : GLOBAL_ACC_R, active_mask_t().set(0),
+      byte_mask, sector_mask, size, write, cycle, 0, -1, -1, -1, NULL);
+  mf->set_replay_source(m_graphics, m_graphics ? 0 : 1, false, false);
+  unsigned sub = mf->get_sub_partition_id();
+  if (m_inflight[sub] >= HYBRID_INFLIGHT) {
+    delete mf;
+    m_dropped++;
+    return;
+  }
+  m_inflight[sub]++;
+  m_requests[mf] = cycle;
+  m_sub_requests[sub].push_back(mf);
+  m_issued++;
+}
+
+void hybrid_fidelity::retire(const mem_fetch *mf, unsigned long long cycle) {
+  std::unordered_map<const mem_fetch *, unsigned long long>::iterator r =
+      m_requests.find(mf);
+  assert(r != m_requests.end());
+  m_latency += cycle - r->second;
+  m_retired++;
+  m_inflight[mf->get_sub_partition_id()]--;
+  m_requests.erase(r);
+}
+
+unsigned long long hybrid_fidelity::random() {
+  // xorshift64*
+  m_state ^= m_state >> 12;
+  m_state ^= m_state << 25;
+  m_state ^= m_state >> 27;
+  return m_state * 0x2545f4914f6cdd1dULL;
+}
+
+unsigned long long hybrid_fidelity::draw(
+    const std::map<unsigned long long, unsigned long long> &counts,
+    unsigned long long total) {
+  unsigned long long r = random() % total;
+  for (const auto &c : counts) {
+    if (r < c.second) return c.first;
+    r -= c.second;
+  }
+  return counts.empty() ? 0 : counts.rbegin()->first;
+}
+
+bool hybrid_fidelity::load(const char *path) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) return false;
+  char key[16], cls[16] = {0};
+  unsigned long long value, count;
+  while (fscanf(fp, "%15s", key) == 1) {
+    if (strcmp(key, "class") == 0) {
+      if (fscanf(fp, "%15s", cls) != 1) break;
+    } else if (strcmp(key, "cycles") == 0) {
+      if (fscanf(fp, "%llu", &m_cycles) != 1) break;
+    } else if (strcmp(key, "kernels") == 0) {
+      if (fscanf(fp, "%llu %llu", &m_kernels, &m_kernel_cycles) != 2) break;
+    } else if (strcmp(key, "requests") == 0) {
+      if (fscanf(fp, "%llu %llu %llu", &m_reads, &m_writes, &m_sequential) !=
+          3)
+        break;
+    } else if (strcmp(key, "size") == 0) {
+      if (fscanf(fp, "%llu %llu", &value, &count) != 2) break;
+      m_sizes[value] += count;
+    } else if (strcmp(key, "chunk") == 0) {
+      if (fscanf(fp, "%llx %llu", &value, &count) != 2) break;
+      m_chunks[value] += count;
+    } else {
+      break;
+    }
+  }
+  bool complete = feof(fp);
+  fclose(fp);
+  return complete && strcmp(cls, m_graphics ? "graphics" : "compute") == 0 &&
+         m_cycles && m_kernels && m_reads + m_writes && !m_chunks.empty();
+}
+
+bool hybrid_fidelity::save(const char *path) const {
+  FILE *fp = fopen(path, "w");
+  if (!fp) return false;
+  fprintf(fp, "class %s\n", m_graphics ? "graphics" : "compute");
+  fprintf(fp, "cycles %llu\n", m_cycles);
+  fprintf(fp, "kernels %llu %llu\n", m_kernels, m_kernel_cycles);
+  fprintf(fp, "requests %llu %llu %llu\n", m_reads, m_writes, m_sequential);
+  for (const auto &s : m_sizes)
+    fprintf(fp, "size %llu %llu\n", s.first, s.second);
+  for (const auto &c : m_chunks)
+    fprintf(fp, "chunk %llx %llu\n", c.first, c.second);
+  return fclose(fp) == 0;
+}
+
+void hybrid_fidelity::print(FILE *fp) const {
+  const char *cls = m_graphics ? "graphics" : "compute";
+  if (m_mode == RECORD) {
+    if (!save(m_path)) {
+      printf("GPGPU-Sim: can not write -gpgpu_hybrid_fidelity profile %s\n",
+             m_path);
+      exit(1);
+    }
+    fprintf(fp,
+            "gpu_hybrid_fidelity_recorded_%s = %llu kernels, %llu cycles, "
+            "%llu reads, %llu writes, %llu sequential\n",
+            cls, m_kernels, m_cycles, m_reads, m_writes, m_sequential);
+    return;
+  }
+  fprintf(fp,
+          "gpu_hybrid_fidelity_modeled_%s = %llu requests, %llu dropped, "
+          "avg_latency = %.2f\n",
+          cls, m_issued, m_dropped,
+          m_retired ? (double)m_latency / m_retired : 0.0);
+}
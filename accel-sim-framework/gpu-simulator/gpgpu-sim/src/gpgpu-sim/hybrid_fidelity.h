@@ -0,0 +1,120 @@
+// Hybrid fidelity, the kernels of one class in an analytical memory model
+//
+// With -gpgpu_hybrid_fidelity record:<graphics or compute>:<file> (none by
+// default) a detailed run writes the memory profile of the class to file:
+// the cycles its kernels take, the requests its SMs send the L2 per cycle
+// one of them runs, how many are writes, their sizes, how many are the
+// line or the line after one of the last 8 lines of the class, the row
+// locality a DRAM sees, and their addresses by 64 KiB chunk. With
+// model:<class>:<file> the kernels of the class issue no CTAs. Each one
+// runs for its cycles of -trace_cycle_model, the mean of the profile
+// without them, and while one runs the model sends the L2 the requests of
+// the profile: as many per cycle on average, writes and sizes in their
+// shares, the sequential ones after the last line of one of 8 streams and
+// the others at a random line of a chunk drawn by its requests. They go
+// through the L2 and DRAM like those of the SMs, and their replies stop at
+// the sub partition. A request finding the HYBRID_INFLIGHT of its sub
+// partition in flight is dropped, as the SMs would not issue it with all
+// their misses outstanding. The other class runs on the SMs as before.
+
+#ifndef HYBRID_FIDELITY_H
+#define HYBRID_FIDELITY_H
+
+#include <stdio.h>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+
+class mem_fetch;
+class memory_config;
+class partition_mf_allocator;
+
+class hybrid_fidelity {
+ public:
+  hybrid_fidelity();
+  ~hybrid_fidelity();
+
+  void configure(const memory_config *config, unsigned n_sub_partitions);
+  bool enabled() const { return m_mode != OFF; }
+  bool recording() const { return m_mode == RECORD; }
+  // whether k runs in the model instead of on the SMs
+  bool models(const kernel_info_t &k) const {
+    return m_mode == MODEL && k.is_graphic_kernel == m_graphics;
+  }
+  bool busy() const { return !m_running.empty() || !m_requests.empty(); }
+
+  // record: mf of an SM reached the L2
+  void l2_access(const mem_fetch *mf);
+  // model: k launched and runs for cycles, 0 for the mean of the profile
+  void kernel_launched(kernel_info_t *k, unsigned long long cycles,
+                       unsigned long long cycle);
+  // a kernel of the model whose cycles are up, NULL when none is
+  kernel_info_t *finished(unsigned long long cycle) const;
+  void kernel_done(kernel_info_t *k);
+  // one cycle with the given kernels of each class running
+  void cycle(unsigned long long cycle, unsigned graphics_kernels,
+             unsigned compute_kernels);
+
+  // the next request for sub partition sub, NULL when none waits
+  mem_fetch *request_top(unsigned sub) const {
+    return m_sub_requests[sub].empty() ? NULL : m_sub_requests[sub].front();
+  }
+  void request_pop(unsigned sub) { m_sub_requests[sub].pop_front(); }
+  // whether mf is a request of the model
+  bool owns(const mem_fetch *mf) const { return m_requests.count(mf) > 0; }
+  // the reply of mf left the L2
+  void retire(const mem_fetch *mf, unsigned long long cycle);
+
+  // record: also writes the profile so far
+  void print(FILE *fp) const;
+
+ private:
+  enum mode { OFF, RECORD, MODEL };
+  static const unsigned STREAMS = 8;
+
+  bool load(const char *path);
+  bool save(const char *path) const;
+  unsigned long long random();
+  double uniform() { return (random() >> 11) * (1.0 / (1ULL << 53)); }
+  // a value of counts, drawn by its count
+  unsigned long long draw(const std::map<unsigned long long,
+                                         unsigned long long> &counts,
+                          unsigned long long total);
+  void issue(unsigned long long cycle);
+
+  mode m_mode;
+  bool m_graphics;
+  const char *m_path;
+  const memory_config *m_config;
+  partition_mf_allocator *m_allocator;
+  unsigned m_line_size;
+  new_addr_type m_streams[STREAMS];
+  unsigned m_next_stream;
+  unsigned long long m_state;
+  double m_credit;
+
+  // the profile
+  unsigned long long m_cycles;  // with a kernel of the class running
+  unsigned long long m_kernels;
+  unsigned long long m_kernel_cycles;
+  unsigned long long m_reads;
+  unsigned long long m_writes;
+  unsigned long long m_sequential;
+  std::map<unsigned long long, unsigned long long> m_sizes;   // by bytes
+  std::map<unsigned long long, unsigned long long> m_chunks;  // by chunk
+
+  // model
+  std::map<kernel_info_t *, unsigned long long> m_running;  // to end cycle
+  std::vector<std::deque<mem_fetch *> > m_sub_requests;  // by sub partition
+  std::vector<unsigned> m_inflight;                       // by sub partition
+  std::unordered_map<const mem_fetch *, unsigned long long> m_requests;
+  unsigned long long m_issued;
+  unsigned long long m_dropped;
+  unsigned long long m_retired;
+  unsigned long long m_latency;  // summed over the retired requests
+};
+
+#endif
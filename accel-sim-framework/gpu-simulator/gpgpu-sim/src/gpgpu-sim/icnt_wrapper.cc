@@ -30,11 +30,13 @@
 #include <assert.h>
 #include "../intersim2/globals.hpp"
 #include "../intersim2/interconnect_interface.hpp"
+#include "analytical_interconnect.h"
 #include "local_interconnect.h"
 
 icnt_create_p icnt_create;
 icnt_init_p icnt_init;
 icnt_has_buffer_p icnt_has_buffer;
+icnt_has_buffer_staged_p icnt_has_buffer_staged;
 icnt_push_p icnt_push;
 icnt_pop_p icnt_pop;
 icnt_transfer_p icnt_transfer;
@@ -49,6 +51,7 @@ char* g_network_config_filename;
 
 struct inct_config g_inct_config;
 LocalInterconnect* g_localicnt_interface;
+AnalyticalInterconnect* g_analytical_icnt_interface;
 
 #include "../option_parser.h"
 
@@ -65,6 +68,14 @@ static bool intersim2_has_buffer(unsigned input, unsigned int size) {
   return g_icnt_interface->HasBuffer(input, size);
 }
 
+static bool intersim2_has_buffer_staged(unsigned input, unsigned int size,
+                                        unsigned staged_packets,
+                                        unsigned staged_flits) {
+  // the input queue counts flits
+  return g_icnt_interface->HasBuffer(
+      input, staged_flits * g_icnt_interface->GetFlitSize() + size);
+}
+
 static void intersim2_push(unsigned input, unsigned output, void* data,
                            unsigned int size) {
   g_icnt_interface->Push(input, output, data, size);
@@ -105,6 +116,13 @@ static bool LocalInterconnect_has_buffer(unsigned input, unsigned int size) {
   return g_localicnt_interface->HasBuffer(input, size);
 }
 
+static bool LocalInterconnect_has_buffer_staged(unsigned input,
+                                                unsigned int size,
+                                                unsigned staged_packets,
+                                                unsigned staged_flits) {
+  return g_localicnt_interface->HasBuffer(input, size, staged_packets);
+}
+
 static void LocalInterconnect_push(unsigned input, unsigned output, void* data,
                                    unsigned int size) {
   g_localicnt_interface->Push(input, output, data, size);
@@ -134,6 +152,53 @@ static unsigned LocalInterconnect_get_flit_size() {
   return g_localicnt_interface->GetFlitSize();
 }
 
+//////////////////////////////////////////////////////
+
+static void Analytical_create(unsigned int n_shader, unsigned int n_mem) {
+  g_analytical_icnt_interface->CreateInterconnect(n_shader, n_mem);
+}
+
+static void Analytical_init() { g_analytical_icnt_interface->Init(); }
+
+static bool Analytical_has_buffer(unsigned input, unsigned int size) {
+  return g_analytical_icnt_interface->HasBuffer(input, size);
+}
+
+static bool Analytical_has_buffer_staged(unsigned input, unsigned int size,
+                                         unsigned staged_packets,
+                                         unsigned staged_flits) {
+  return g_analytical_icnt_interface->HasBuffer(input, size, staged_packets);
+}
+
+static void Analytical_push(unsigned input, unsigned output, void* data,
+                            unsigned int size) {
+  g_analytical_icnt_interface->Push(input, output, data, size);
+}
+
+static void* Analytical_pop(unsigned output) {
+  return g_analytical_icnt_interface->Pop(output);
+}
+
+static void Analytical_transfer() { g_analytical_icnt_interface->Advance(); }
+
+static bool Analytical_busy() { return g_analytical_icnt_interface->Busy(); }
+
+static void Analytical_display_stats() {
+  g_analytical_icnt_interface->DisplayStats();
+}
+
+static void Analytical_display_overall_stats() {
+  g_analytical_icnt_interface->DisplayOverallStats();
+}
+
+static void Analytical_display_state(FILE* fp) {
+  g_analytical_icnt_interface->DisplayState(fp);
+}
+
+static unsigned Analytical_get_flit_size() {
+  return g_analytical_icnt_interface->GetFlitSize();
+}
+
 ///////////////////////////
 
 void icnt_reg_options(class OptionParser* opp) {
@@ -158,6 +223,31 @@ void icnt_reg_options(class OptionParser* opp) {
                          &g_inct_config.verbose, "inct_verbose", "0");
   option_parser_register(opp, "-icnt_grant_cycles", OPT_UINT32,
                          &g_inct_config.grant_cycles, "grant_cycles", "1");
+  option_parser_register(opp, "-icnt_class_arbiter", OPT_UINT32,
+                         &g_inct_config.class_arbiter,
+                         "share iSLIP grants between graphics and compute "
+                         "by the class weights",
+                         "0");
+  option_parser_register(opp, "-icnt_class_graphics_weight", OPT_UINT32,
+                         &g_inct_config.class_graphics_weight,
+                         "graphics grants per round of class slots, 0 for "
+                         "the lower priority",
+                         "1");
+  option_parser_register(opp, "-icnt_class_compute_weight", OPT_UINT32,
+                         &g_inct_config.class_compute_weight,
+                         "compute grants per round of class slots, 0 for "
+                         "the lower priority",
+                         "1");
+
+  // parameters for the analytical model, which also takes the buffer limits
+  // and subnets above
+  option_parser_register(opp, "-icnt_analytical_latency", OPT_UINT32,
+                         &g_inct_config.analytical_latency,
+                         "cycles from a packet leaving its input to arriving",
+                         "8");
+  option_parser_register(opp, "-icnt_analytical_port_bw", OPT_UINT32,
+                         &g_inct_config.analytical_port_bw,
+                         "bytes a port moves per cycle", "40");
 }
 
 void icnt_wrapper_init() {
@@ -168,6 +258,7 @@ void icnt_wrapper_init() {
       icnt_create = intersim2_create;
       icnt_init = intersim2_init;
       icnt_has_buffer = intersim2_has_buffer;
+      icnt_has_buffer_staged = intersim2_has_buffer_staged;
       icnt_push = intersim2_push;
       icnt_pop = intersim2_pop;
       icnt_transfer = intersim2_transfer;
@@ -182,6 +273,7 @@ void icnt_wrapper_init() {
       icnt_create = LocalInterconnect_create;
       icnt_init = LocalInterconnect_init;
       icnt_has_buffer = LocalInterconnect_has_buffer;
+      icnt_has_buffer_staged = LocalInterconnect_has_buffer_staged;
       icnt_push = LocalInterconnect_push;
       icnt_pop = LocalInterconnect_pop;
       icnt_transfer = LocalInterconnect_transfer;
@@ -191,6 +283,21 @@ void icnt_wrapper_init() {
       icnt_display_state = LocalInterconnect_display_state;
       icnt_get_flit_size = LocalInterconnect_get_flit_size;
       break;
+    case ANALYTICAL:
+      g_analytical_icnt_interface = AnalyticalInterconnect::New(g_inct_config);
+      icnt_create = Analytical_create;
+      icnt_init = Analytical_init;
+      icnt_has_buffer = Analytical_has_buffer;
+      icnt_has_buffer_staged = Analytical_has_buffer_staged;
+      icnt_push = Analytical_push;
+      icnt_pop = Analytical_pop;
+      icnt_transfer = Analytical_transfer;
+      icnt_busy = Analytical_busy;
+      icnt_display_stats = Analytical_display_stats;
+      icnt_display_overall_stats = Analytical_display_overall_stats;
+      icnt_display_state = Analytical_display_state;
+      icnt_get_flit_size = Analytical_get_flit_size;
+      break;
     default:
       assert(0);
       break;
@@ -36,6 +36,11 @@
 typedef void (*icnt_create_p)(unsigned n_shader, unsigned n_mem);
 typedef void (*icnt_init_p)();
 typedef bool (*icnt_has_buffer_p)(unsigned input, unsigned int size);
+// icnt_has_buffer() once staged_packets more packets of staged_flits flits in
+// all have been pushed at input
+typedef bool (*icnt_has_buffer_staged_p)(unsigned input, unsigned int size,
+                                         unsigned staged_packets,
+                                         unsigned staged_flits);
 typedef void (*icnt_push_p)(unsigned input, unsigned output, void* data,
                             unsigned int size);
 typedef void* (*icnt_pop_p)(unsigned output);
@@ -50,6 +55,7 @@ typedef unsigned (*icnt_get_flit_size_p)();
 extern icnt_create_p icnt_create;
 extern icnt_init_p icnt_init;
 extern icnt_has_buffer_p icnt_has_buffer;
+extern icnt_has_buffer_staged_p icnt_has_buffer_staged;
 extern icnt_push_p icnt_push;
 extern icnt_pop_p icnt_pop;
 extern icnt_transfer_p icnt_transfer;
@@ -61,7 +67,12 @@ extern icnt_display_state_p icnt_display_state;
 extern icnt_get_flit_size_p icnt_get_flit_size;
 extern unsigned g_network_mode;
 
-enum network_mode { INTERSIM = 1, LOCAL_XBAR = 2, N_NETWORK_MODE };
+enum network_mode {
+  INTERSIM = 1,
+  LOCAL_XBAR = 2,
+  ANALYTICAL = 3,
+  N_NETWORK_MODE
+};
 
 void icnt_wrapper_init();
 void icnt_reg_options(class OptionParser* opp);
@@ -0,0 +1,94 @@
+// Per-kernel stats records
+
+#include "kernel_stats_log.h"
+
+#include <string.h>
+
+#include "gpu-cache.h"
+
+bool parse_kernel_stats_level(const char *name, kernel_stats_level &level) {
+  if (!strcmp(name, "none"))
+    level = KERNEL_STATS_NONE;
+  else if (!strcmp(name, "summary"))
+    level = KERNEL_STATS_SUMMARY;
+  else if (!strcmp(name, "full"))
+    level = KERNEL_STATS_FULL;
+  else
+    return false;
+  return true;
+}
+
+kernel_stats_log::~kernel_stats_log() {
+  if (m_file) fclose(m_file);
+}
+
+bool kernel_stats_log::open(const char *path) {
+  m_file = fopen(path, "w");
+  return m_file != NULL;
+}
+
+void kernel_stats_log::begin() {
+  fputc('{', m_file);
+  m_first = true;
+}
+
+void kernel_stats_log::end() { fputs("}\n", m_file); }
+
+void kernel_stats_log::key(const char *name) {
+  fprintf(m_file, m_first ? "\"%s\":" : ",\"%s\":", name);
+  m_first = false;
+}
+
+void kernel_stats_log::field(const char *name, unsigned long long value) {
+  key(name);
+  fprintf(m_file, "%llu", value);
+}
+
+void kernel_stats_log::field(const char *name, double value) {
+  key(name);
+  fprintf(m_file, "%.6g", value);
+}
+
+void kernel_stats_log::field(const char *name, const std::string &value) {
+  key(name);
+  fputc('"', m_file);
+  for (unsigned i = 0; i < value.size(); i++) {
+    char c = value[i];
+    if (c == '"' || c == '\\')
+      fputc('\\', m_file);
+    else if ((unsigned char)c < 0x20)
+      c = ' ';
+    fputc(c, m_file);
+  }
+  fputc('"', m_file);
+}
+
+void kernel_stats_log::cache(const char *name, const cache_stats &stats,
+                             unsigned kernel_id) {
+  for (unsigned fail = 0; fail < 2; fail++) {
+    key((std::string(name) + (fail ? "_fail" : "")).c_str());
+    fputc('{', m_file);
+    unsigned outcomes = fail ? (unsigned)NUM_CACHE_RESERVATION_FAIL_STATUS
+                             : (unsigned)NUM_CACHE_REQUEST_STATUS;
+    bool first_type = true;
+    for (unsigned type = 0; type < NUM_MEM_ACCESS_TYPE; type++) {
+      bool first = true;
+      for (unsigned o = 0; o < outcomes; o++) {
+        unsigned long long n = stats(kernel_id, type, o, fail);
+        if (!n) continue;
+        if (first)
+          fprintf(m_file, "%s\"%s\":{", first_type ? "" : ",",
+                  mem_access_type_str((enum mem_access_type)type));
+        fprintf(m_file, "%s\"%s\":%llu", first ? "" : ",",
+                fail ? cache_fail_status_str(
+                           (enum cache_reservation_fail_reason)o)
+                     : cache_request_status_str((enum cache_request_status)o),
+                n);
+        first = false;
+        first_type = false;
+      }
+      if (!first) fputc('}', m_file);
+    }
+    fputc('}', m_file);
+  }
+}
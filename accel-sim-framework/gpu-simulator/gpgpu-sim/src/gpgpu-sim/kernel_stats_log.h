@@ -0,0 +1,55 @@
+// Per-kernel stats records
+//
+// gpgpu_sim::print_stats runs for every finished kernel, and the full text
+// dump walks every cache, sub partition and the interconnect. With hundreds
+// of draws per frame the dump dominates the run. -gpgpu_kernel_stats picks
+// what is printed per kernel: the full dump, a few summary lines or nothing.
+// -gpgpu_kernel_stats_file appends one JSON object per kernel to a file with
+// the counters of that kernel only, and
+// util/job_launching/kernel_stats_to_text.py renders the records in the text
+// format get_stats.py reads.
+
+#ifndef KERNEL_STATS_LOG_H
+#define KERNEL_STATS_LOG_H
+
+#include <stdio.h>
+#include <string>
+
+enum kernel_stats_level {
+  KERNEL_STATS_NONE = 0,
+  KERNEL_STATS_SUMMARY,
+  KERNEL_STATS_FULL
+};
+
+// "none", "summary" or "full", false for an unknown name
+bool parse_kernel_stats_level(const char *name, kernel_stats_level &level);
+
+class cache_stats;
+
+class kernel_stats_log {
+ public:
+  kernel_stats_log() : m_file(NULL), m_first(true) {}
+  ~kernel_stats_log();
+
+  // false when path cannot be written
+  bool open(const char *path);
+  bool enabled() const { return m_file != NULL; }
+
+  // one record per line
+  void begin();
+  void end();
+  void field(const char *name, unsigned long long value);
+  void field(const char *name, double value);
+  void field(const char *name, const std::string &value);
+  // the non-zero [access type][outcome] counters, and the reservation fails
+  // under <name>_fail
+  void cache(const char *name, const cache_stats &stats, unsigned kernel_id);
+
+ private:
+  void key(const char *name);
+
+  FILE *m_file;
+  bool m_first;  // no field in the current object yet
+};
+
+#endif
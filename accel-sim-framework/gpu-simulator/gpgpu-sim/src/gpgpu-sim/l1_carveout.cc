@@ -0,0 +1,72 @@
+// L1D carveout and class split, see l1_carveout.h
+
+#include "l1_carveout.h"
+
+#include <algorithm>
+
+#include "../cuda-sim/cuda-sim.h"
+#include "gpu-sim.h"
+#include "shader.h"
+
+l1_carveout::l1_carveout(gpgpu_sim *gpu) : m_gpu(gpu) {
+  m_resizes = 0;
+  m_splits = 0;
+  m_shmem = (unsigned)-1;
+  m_graphics_ways = 0;
+  for (unsigned c = 0; c < 2; c++) m_hits[c] = 0;
+}
+
+void l1_carveout::update(const std::vector<kernel_info_t *> &running) {
+  const shader_core_config *config = m_gpu->getShaderCoreConfig();
+  if (!config->gpgpu_l1_carveout_dynamic || !config->adaptive_cache_config)
+    return;
+
+  unsigned shmem = 0;
+  bool classes[2] = {false, false};
+  for (unsigned n = 0; n < running.size(); n++) {
+    kernel_info_t *k = running[n];
+    if (!k || k->done()) continue;
+    classes[k->is_graphic_kernel] = true;
+    const struct gpgpu_ptx_sim_info *info = ptx_sim_kernel_info(k->entry());
+    shmem += info->smem * config->max_cta(*k);
+  }
+  shmem = std::min(shmem, config->shmem_opt_list.back());
+
+  unsigned long long hits[2];
+  for (unsigned c = 0; c < 2; c++) {
+    hits[c] = m_gpu->l1_class_hits[c] - m_hits[c];
+    m_hits[c] = m_gpu->l1_class_hits[c];
+  }
+
+  unsigned clusters = config->n_simt_clusters;
+  bool resized = m_shmem == (unsigned)-1 ||
+                 config->l1_assoc_for_shmem(shmem) !=
+                     config->l1_assoc_for_shmem(m_shmem);
+  if (resized) {
+    // the lines are where the old set layout put them
+    for (unsigned i = 0; i < clusters; i++)
+      m_gpu->getSIMTCluster(i)->cache_invalidate();
+    config->set_l1_carveout(shmem);
+    m_resizes++;
+  }
+  m_shmem = shmem;
+
+  unsigned assoc = config->m_L1D_config.get_assoc();
+  unsigned ways = 0;
+  if (classes[0] && classes[1] && assoc > 1) {
+    if (hits[0] + hits[1])
+      ways = (assoc * hits[1] + (hits[0] + hits[1]) / 2) / (hits[0] + hits[1]);
+    else
+      ways = m_graphics_ways ? m_graphics_ways : assoc / 2;
+    ways = std::max(1u, std::min(ways, assoc - 1));
+  }
+  if (ways != m_graphics_ways || resized) {
+    for (unsigned i = 0; i < clusters; i++)
+      m_gpu->getSIMTCluster(i)->set_l1_class_ways(ways);
+    if (ways != m_graphics_ways) {
+      printf("GPGPU-Sim: L1D graphics ways %u of %u\n", ways, assoc);
+      m_splits++;
+    }
+    m_graphics_ways = ways;
+  }
+}
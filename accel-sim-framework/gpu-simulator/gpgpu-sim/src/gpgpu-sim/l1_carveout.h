@@ -0,0 +1,43 @@
+// L1D carveout and class split that follow the running kernels
+//
+// -gpgpu_adaptive_cache_config sizes the L1D once, for the shared memory of
+// the first kernel that issues. With -gpgpu_l1_carveout_dynamic the split is
+// picked again every time a kernel launches or finishes: the carveout holds
+// the shared memory of a full SM of every running kernel, the largest one
+// of gpgpu_shmem_option when they do not fit together. While graphics and
+// compute kernels both run, the L1D ways are also split between the two
+// classes, each getting ways in proportion to the L1D hits it had since the
+// last boundary, at least one. A new carveout changes the set layout, so
+// every L1D is invalidated first; a new split drops the lines of each way
+// the other class took, see tag_array::set_class_ways. L1D configurations
+// are shared by the cores, so the split is the same on every SM.
+
+#ifndef L1_CARVEOUT_H
+#define L1_CARVEOUT_H
+
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+
+class gpgpu_sim;
+
+class l1_carveout {
+ public:
+  explicit l1_carveout(gpgpu_sim *gpu);
+
+  // a kernel launched or finished, running holds every kernel slot
+  void update(const std::vector<kernel_info_t *> &running);
+
+  // totals since the start
+  unsigned long long m_resizes;       // carveouts changed
+  unsigned long long m_splits;        // class splits changed
+
+ private:
+  gpgpu_sim *m_gpu;
+  unsigned m_shmem;           // of the applied carveout, -1 before the first
+  unsigned m_graphics_ways;   // 0 = not split
+  // the L1D hits of each class at the last boundary, by is_graphics
+  unsigned long long m_hits[2];
+};
+
+#endif
@@ -0,0 +1,63 @@
+// L2 access stream
+
+#include "l2_access_log.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// records buffered before they go to gzwrite
+static const unsigned BUFFER_RECORDS = 1 << 16;
+static const unsigned RECORD_SIZE = 24;
+
+static void put(std::vector<unsigned char> &b, uint64_t v, unsigned bytes) {
+  for (unsigned i = 0; i < bytes; i++) b.push_back(v >> (8 * i));
+}
+
+l2_access_log::l2_access_log() {
+  m_file = NULL;
+  m_records = 0;
+}
+
+l2_access_log::~l2_access_log() { close(); }
+
+bool l2_access_log::open(const char *path, unsigned sub_partitions,
+                         unsigned sets, unsigned assoc, unsigned line_size) {
+  assert(!enabled());
+  m_file = gzopen(path, "wb");
+  if (!m_file) return false;
+  m_buffer.reserve((size_t)BUFFER_RECORDS * RECORD_SIZE);
+  gzwrite(m_file, "GL2A", 4);
+  put(m_buffer, 1, 4);
+  put(m_buffer, sub_partitions, 4);
+  put(m_buffer, sets, 4);
+  put(m_buffer, assoc, 4);
+  put(m_buffer, line_size, 4);
+  flush();
+  return true;
+}
+
+void l2_access_log::record(unsigned long long cycle,
+                           unsigned long long block_addr, unsigned set,
+                           unsigned sectors, unsigned flags) {
+  put(m_buffer, cycle, 8);
+  put(m_buffer, block_addr, 8);
+  put(m_buffer, set, 4);
+  put(m_buffer, sectors, 1);
+  put(m_buffer, flags, 1);
+  put(m_buffer, 0, 2);
+  if (++m_records % BUFFER_RECORDS == 0) flush();
+}
+
+void l2_access_log::flush() {
+  if (!m_buffer.empty()) gzwrite(m_file, m_buffer.data(), m_buffer.size());
+  m_buffer.clear();
+}
+
+void l2_access_log::close() {
+  if (!m_file) return;
+  flush();
+  gzclose(m_file);
+  m_file = NULL;
+  printf("GPGPU-Sim: %llu L2 accesses logged\n", m_records);
+}
@@ -0,0 +1,52 @@
+// L2 access stream
+//
+// -gpgpu_l2_access_log records every access the L2 tag arrays take, in the
+// order they take them, so that util/plotting/l2_partition_sweep.py can
+// replay the stream offline and give the hit rates of every graphics and
+// compute way split in one pass. Accesses that fail for lack of a line to
+// reserve are retried and only recorded once they go through; the fills of
+// the copy engine are recorded too since they change the L2 as well.
+//
+// The file is gzip: a header (magic "GL2A", then the version, sub
+// partitions, sets per sub partition, ways and line size, little-endian 32
+// bit) followed by 24 byte records of the cycle and the block address
+// (64 bit), the set counted over all sub partitions, sub partition * sets +
+// set (32 bit), the sector mask and the flags (8 bit) and two bytes of
+// padding. The flags are 1 graphics, 2 write, 4 texture and 8 copy engine.
+
+#ifndef L2_ACCESS_LOG_H
+#define L2_ACCESS_LOG_H
+
+#include <zlib.h>
+#include <vector>
+
+class l2_access_log {
+ public:
+  enum flags {
+    LOG_GRAPHICS = 1,
+    LOG_WRITE = 2,
+    LOG_TEXTURE = 4,
+    LOG_COPY = 8
+  };
+
+  l2_access_log();
+  ~l2_access_log();
+
+  // false when path cannot be written
+  bool open(const char *path, unsigned sub_partitions, unsigned sets,
+            unsigned assoc, unsigned line_size);
+  bool enabled() const { return m_file != NULL; }
+  void record(unsigned long long cycle, unsigned long long block_addr,
+              unsigned set, unsigned sectors, unsigned flags);
+  // writes the records buffered so far and closes the file
+  void close();
+
+ private:
+  void flush();
+
+  gzFile m_file;
+  std::vector<unsigned char> m_buffer;
+  unsigned long long m_records;
+};
+
+#endif
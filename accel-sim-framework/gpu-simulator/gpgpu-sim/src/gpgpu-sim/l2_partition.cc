@@ -0,0 +1,121 @@
+// Utility-based partitioning of the L2 between graphics and compute
+
+#include "l2_partition.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+cache_partition_policy *cache_partition_policy::create(const char *name) {
+  if (!strcmp(name, "score")) return new score_partition_policy();
+  if (!strcmp(name, "lookahead")) return new lookahead_partition_policy();
+  return NULL;
+}
+
+unsigned score_partition_policy::graphics_ways(
+    const std::vector<unsigned> &gr_utility,
+    const std::vector<unsigned> &cp_utility, float gr_factor, float cp_factor,
+    bool verbose) const {
+  unsigned ways = gr_utility.size();
+  // get score
+  std::vector<unsigned> score;
+  score.resize(ways + 1, 0);
+  for (unsigned i = 0; i < score.size(); i++) {
+    unsigned gr = i;
+    unsigned cp = score.size() - i;
+    for (unsigned j = 0; j < ways; j++) {
+      if (j < gr) {
+        score[i] += gr_utility[j] / gr_factor;
+      }
+      if (j < cp) {
+        score[i] += cp_utility[j] / cp_factor;
+      }
+    }
+    if (verbose) printf("i = %d, score = %d\n ", i, score[i]);
+  }
+
+  // choose best score
+  unsigned best_score = 0;
+  unsigned best_score_index = 0;
+  for (unsigned i = 0; i < score.size(); i++) {
+    // get highest score
+    if (score[i] > best_score) {
+      best_score = score[i];
+      best_score_index = i;
+    }
+  }
+  // each class keeps at least one way
+  return std::min(std::max(best_score_index, 1u), ways - 1);
+}
+
+unsigned lookahead_partition_policy::graphics_ways(
+    const std::vector<unsigned> &gr_utility,
+    const std::vector<unsigned> &cp_utility, float gr_factor, float cp_factor,
+    bool verbose) const {
+  unsigned ways = gr_utility.size();
+  const std::vector<unsigned> *utility[2] = {&cp_utility, &gr_utility};
+  float factor[2] = {cp_factor, gr_factor};
+  unsigned alloc[2] = {1, 1};
+  unsigned balance = ways - 2;
+  while (balance) {
+    // best hits per way of each class over every possible extra allocation
+    float best_mu = -1;
+    unsigned best_class = 0, best_extra = 1;
+    for (unsigned c = 0; c < 2; c++) {
+      float gain = 0;
+      for (unsigned extra = 1; extra <= balance; extra++) {
+        gain += (*utility[c])[alloc[c] + extra - 1] / factor[c];
+        float mu = gain / extra;
+        if (mu > best_mu) {
+          best_mu = mu;
+          best_class = c;
+          best_extra = extra;
+        }
+      }
+    }
+    alloc[best_class] += best_extra;
+    balance -= best_extra;
+    if (verbose)
+      printf("lookahead: %s +%u ways (%.1f hits per way)\n",
+             best_class ? "graphics" : "compute", best_extra, best_mu);
+  }
+  return alloc[1];
+}
+
+utility_monitor::utility_monitor(unsigned nset, unsigned assoc,
+                                 unsigned sampled_sets) {
+  m_assoc = assoc;
+  m_sampled_sets = std::max(1u, std::min(sampled_sets, nset));
+  m_stride = nset / m_sampled_sets;
+  for (unsigned c = 0; c < 2; c++) {
+    m_tags[c].resize(m_sampled_sets * assoc, 0);
+    m_valid[c].resize(m_sampled_sets, 0);
+    m_utility[c].resize(assoc, 0);
+  }
+}
+
+void utility_monitor::access(unsigned set_index, new_addr_type tag,
+                             bool is_graphics) {
+  if (set_index % m_stride) return;
+  unsigned sample = set_index / m_stride;
+  if (sample >= m_sampled_sets) return;
+  new_addr_type *tags = &m_tags[is_graphics][sample * m_assoc];
+  unsigned &valid = m_valid[is_graphics][sample];
+  unsigned pos = 0;
+  while (pos < valid && tags[pos] != tag) pos++;
+  if (pos < valid) {
+    m_utility[is_graphics][pos]++;
+  } else if (valid < m_assoc) {
+    pos = valid++;
+  } else {
+    pos = m_assoc - 1;  // LRU tag is replaced
+  }
+  // move to the most recent position
+  for (; pos > 0; pos--) tags[pos] = tags[pos - 1];
+  tags[0] = tag;
+}
+
+void utility_monitor::decay() {
+  for (unsigned c = 0; c < 2; c++)
+    for (unsigned i = 0; i < m_assoc; i++) m_utility[c][i] /= 2;
+}
@@ -0,0 +1,75 @@
+// Utility-based partitioning of the L2 between graphics and compute
+//
+// A cache_partition_policy turns the per recency-rank hit counters of both
+// classes into the number of L2 ways graphics gets, counter i being the
+// hits that needed at least i+1 ways. The counters come from the real tags
+// of every set, or from a utility_monitor: shadow tags of a few sampled
+// sets that replay the accesses of each class as if it had the whole cache
+// (UMON-DSS in Qureshi and Patt's UCP).
+
+#ifndef L2_PARTITION_H
+#define L2_PARTITION_H
+
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+
+class cache_partition_policy {
+ public:
+  virtual ~cache_partition_policy() {}
+
+  // "score" or "lookahead", NULL for an unknown name
+  static cache_partition_policy *create(const char *name);
+
+  // graphics ways out of gr_utility.size(), in [1, ways - 1]. A class's
+  // counters are divided by its factor, which evens out a class that makes
+  // far more accesses
+  virtual unsigned graphics_ways(const std::vector<unsigned> &gr_utility,
+                                 const std::vector<unsigned> &cp_utility,
+                                 float gr_factor, float cp_factor,
+                                 bool verbose) const = 0;
+};
+
+// scores every split by the hits both classes keep and takes the best
+class score_partition_policy : public cache_partition_policy {
+ public:
+  unsigned graphics_ways(const std::vector<unsigned> &gr_utility,
+                         const std::vector<unsigned> &cp_utility,
+                         float gr_factor, float cp_factor,
+                         bool verbose) const;
+};
+
+// UCP lookahead: repeatedly gives the class with the highest hits per added
+// way the ways that reach it, handles counters that are not concave
+class lookahead_partition_policy : public cache_partition_policy {
+ public:
+  unsigned graphics_ways(const std::vector<unsigned> &gr_utility,
+                         const std::vector<unsigned> &cp_utility,
+                         float gr_factor, float cp_factor,
+                         bool verbose) const;
+};
+
+class utility_monitor {
+ public:
+  // shadows every nset / sampled_sets-th set
+  utility_monitor(unsigned nset, unsigned assoc, unsigned sampled_sets);
+
+  void access(unsigned set_index, new_addr_type tag, bool is_graphics);
+  const std::vector<unsigned> &get_utility(bool is_graphics) const {
+    return m_utility[is_graphics];
+  }
+  // halve the counters so the monitor follows phase changes
+  void decay();
+
+ private:
+  unsigned m_assoc;
+  unsigned m_stride;
+  unsigned m_sampled_sets;
+  // per class, the shadow tags of each sampled set, most recent first, and
+  // how many of them are valid
+  std::vector<new_addr_type> m_tags[2];
+  std::vector<unsigned> m_valid[2];
+  std::vector<unsigned> m_utility[2];
+};
+
+#endif
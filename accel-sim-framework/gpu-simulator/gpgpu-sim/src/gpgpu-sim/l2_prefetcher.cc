@@ -0,0 +1,151 @@
+// Stream prefetcher of an L2 sub partition, see l2_prefetcher.h
+
+#include "l2_prefetcher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpu-sim.h"
+#include "l2cache.h"
+#include "mem_fetch.h"
+
+// lines of the zone a stream trains on, log2
+static const unsigned ZONE_LINES_LOG2 = 6;
+
+l2_prefetcher::l2_prefetcher(unsigned sub_partition_id,
+                             const memory_config *config,
+                             partition_mf_allocator *allocator,
+                             cache_stats &stats)
+    : m_id(sub_partition_id),
+      m_config(config),
+      m_allocator(allocator),
+      m_stats(stats) {
+  if (!strcmp(config->l2_prefetch, "texture")) {
+    m_graphics = false;
+  } else if (!strcmp(config->l2_prefetch, "graphics")) {
+    m_graphics = true;
+  } else {
+    printf("GPGPU-Sim: -gpgpu_l2_prefetch \'%s\' is not none, texture or "
+           "graphics\n",
+           config->l2_prefetch);
+    exit(1);
+  }
+  if (!config->l2_prefetch_degree || !config->l2_prefetch_streams) {
+    printf("GPGPU-Sim: -gpgpu_l2_prefetch_degree and "
+           "-gpgpu_l2_prefetch_streams have to be at least 1\n");
+    exit(1);
+  }
+  m_line_size = config->m_L2_config.get_line_sz();
+  m_streams.resize(config->l2_prefetch_streams);
+  for (unsigned i = 0; i < m_streams.size(); i++) {
+    m_streams[i].zone = (new_addr_type)-1;
+    m_streams[i].lru = 0;
+  }
+  m_lru = 0;
+}
+
+l2_prefetcher::~l2_prefetcher() {
+  for (unsigned i = 0; i < m_queue.size(); i++) delete m_queue[i];
+}
+
+bool l2_prefetcher::trains(const mem_fetch *mf) const {
+  if (mf->get_is_write() || !mf->is_graphics() || owns(mf)) return false;
+  return m_graphics || mf->is_tex();
+}
+
+void l2_prefetcher::demand(const mem_fetch *mf,
+                           enum cache_request_status status,
+                           unsigned long long cycle) {
+  if (!trains(mf)) return;
+  long long line = mf->get_addr() / m_line_size;
+
+  std::unordered_set<long long>::iterator p = m_prefetched.find(line);
+  if (p != m_prefetched.end()) {
+    if (status == HIT || status == HIT_RESERVED) {
+      m_stats.m_prefetch_useful++;
+      if (status == HIT_RESERVED) m_stats.m_prefetch_late++;
+    }
+    m_prefetched.erase(p);
+  }
+  if (status == MISS || status == SECTOR_MISS) m_stats.m_prefetch_misses++;
+
+  new_addr_type zone = line >> ZONE_LINES_LOG2;
+  stream *s = &m_streams[0];
+  for (unsigned i = 0; i < m_streams.size(); i++) {
+    if (m_streams[i].zone == zone) {
+      s = &m_streams[i];
+      break;
+    }
+    if (m_streams[i].lru < s->lru) s = &m_streams[i];
+  }
+  s->lru = ++m_lru;
+  if (s->zone != zone) {
+    s->zone = zone;
+    s->last = line;
+    s->stride = 0;
+    s->trained = false;
+    return;
+  }
+  long long stride = line - s->last;
+  if (!stride) return;
+  if (stride != s->stride) {
+    s->stride = stride;
+    s->trained = false;
+    s->last = line;
+    return;
+  }
+  if (!s->trained) {
+    s->trained = true;
+    s->next = line + stride;
+  }
+  s->last = line;
+
+  // the window of degree lines distance strides ahead, from where the
+  // stream left off
+  long long first = line + stride * (long long)m_config->l2_prefetch_distance;
+  if ((s->next - first) * stride < 0) s->next = first;
+  long long end =
+      first + stride * (long long)m_config->l2_prefetch_degree;
+  for (; (end - s->next) * stride > 0; s->next += stride) {
+    if (m_inflight.size() >= m_config->l2_prefetch_inflight) break;
+    prefetch(mf, s->next, cycle);
+  }
+}
+
+void l2_prefetcher::prefetch(const mem_fetch *trigger, long long line,
+                             unsigned long long cycle) {
+  if (line < 0 || m_prefetched.count(line)) return;
+  new_addr_type addr = (new_addr_type)line * m_line_size;
+  bool sectored = m_config->m_L2_config.m_cache_type == SECTOR;
+  unsigned requests = sectored ? m_line_size / SECTOR_SIZE : 1;
+  for (unsigned i = 0; i < requests; i++) {
+    mem_access_byte_mask_t byte_mask;
+    mem_access_sector_mask_t sector_mask;
+    unsigned size = sectored ? SECTOR_SIZE : m_line_size;
+    for (unsigned b = 0; b < size; b++) byte_mask.set(i * size + b);
+    if (sectored)
+      sector_mask.set(i);
+    else
+      sector_mask.set();
+    mem_fetch *mf = m_allocator->alloc(
+        addr + i * size, TEXTURE_ACC_R, trigger->get_access_warp_mask(),
+        byte_mask, sector_mask, size, false, cycle, trigger->get_kernel_uid(),
+        trigger->get_wid(), trigger->get_sid(), trigger->get_tpc(), NULL);
+    // a graphics texture read, as the instruction of a demand read sets it
+    mf->set_replay_source(true, 0, true, true);
+    if (mf->get_sub_partition_id() != m_id) {
+      delete mf;
+      return;
+    }
+    m_queue.push_back(mf);
+    m_inflight.insert(mf);
+  }
+  m_stats.m_prefetch_issued++;
+  m_prefetched.insert(line);
+  m_prefetched_order.push_back(line);
+  while (m_prefetched_order.size() > m_config->m_L2_config.get_num_lines()) {
+    m_prefetched.erase(m_prefetched_order.front());
+    m_prefetched_order.pop_front();
+  }
+}
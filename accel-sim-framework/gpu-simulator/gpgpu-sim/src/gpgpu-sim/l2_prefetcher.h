@@ -0,0 +1,84 @@
+// Stream prefetcher of an L2 sub partition for graphics reads
+//
+// With -gpgpu_l2_prefetch texture (or graphics) the demand reads of that
+// class train a table of -gpgpu_l2_prefetch_streams streams, one per zone
+// of 64 lines. A read one stride of lines past the last one of its zone,
+// with the same stride as the one before, has the prefetcher fetch the
+// -gpgpu_l2_prefetch_degree lines -gpgpu_l2_prefetch_distance strides
+// ahead, those not fetched already. A sub partition only sees the lines
+// the address mapping gives it, so the strides are in those, and lines a
+// stride leads to in another sub partition are left out.
+//
+// The prefetches are graphics texture reads of the triggering request's
+// kernel, so they count in the L2 breakdown, take the graphics ways of a
+// partitioned L2 and the graphics caps of -gpgpu_mem_class_caps on their
+// way to DRAM. They only enter the L2 when no demand request waits for it,
+// at most -gpgpu_l2_prefetch_inflight of them at a time, and their replies
+// stop at the sub partition. Accuracy and coverage are counted in the
+// L2's cache_stats.
+
+#ifndef L2_PREFETCHER_H
+#define L2_PREFETCHER_H
+
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+#include "gpu-cache.h"
+
+class mem_fetch;
+class memory_config;
+class partition_mf_allocator;
+
+class l2_prefetcher {
+ public:
+  l2_prefetcher(unsigned sub_partition_id, const memory_config *config,
+                partition_mf_allocator *allocator, cache_stats &stats);
+  ~l2_prefetcher();
+
+  // a demand request of status reached the L2
+  void demand(const mem_fetch *mf, enum cache_request_status status,
+              unsigned long long cycle);
+
+  // the next prefetch for the L2, NULL when none waits
+  mem_fetch *top() const {
+    return m_queue.empty() ? NULL : m_queue.front();
+  }
+  void pop() { m_queue.pop_front(); }
+  // whether mf is a prefetch of this prefetcher
+  bool owns(const mem_fetch *mf) const { return m_inflight.count(mf) > 0; }
+  // the reply of a prefetch left the L2
+  void retire(const mem_fetch *mf) { m_inflight.erase(mf); }
+
+ private:
+  struct stream {
+    new_addr_type zone;
+    long long last;  // line
+    long long stride;
+    long long next;  // first line not prefetched yet
+    bool trained;
+    unsigned long long lru;
+  };
+
+  bool trains(const mem_fetch *mf) const;
+  void prefetch(const mem_fetch *trigger, long long line,
+                unsigned long long cycle);
+
+  unsigned m_id;
+  const memory_config *m_config;
+  partition_mf_allocator *m_allocator;
+  cache_stats &m_stats;
+  bool m_graphics;  // every graphics read trains, not only texture ones
+  unsigned m_line_size;
+  std::vector<stream> m_streams;
+  unsigned long long m_lru;
+  std::deque<mem_fetch *> m_queue;
+  std::unordered_set<const mem_fetch *> m_inflight;
+  // lines prefetched and not read since, bounded by the lines of the L2
+  std::unordered_set<long long> m_prefetched;
+  std::deque<long long> m_prefetched_order;
+};
+
+#endif
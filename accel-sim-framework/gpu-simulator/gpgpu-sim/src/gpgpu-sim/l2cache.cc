@@ -39,6 +39,7 @@
 #include "../option_parser.h"
 #include "../statwrapper.h"
 #include "dram.h"
+#include "dram_traffic.h"
 #include "gpu-cache.h"
 #include "gpu-sim.h"
 #include "histogram.h"
@@ -82,6 +83,18 @@ memory_partition_unit::memory_partition_unit(unsigned partition_id,
       m_arbitration_metadata(config),
       m_gpu(gpu) {
   m_dram = new dram_t(m_id, m_config, m_stats, this, gpu);
+  m_traffic = dram_traffic::enabled(m_config)
+                  ? new dram_traffic(m_id, m_config)
+                  : NULL;
+  m_traffic_turn = false;
+  m_defer_peer_reads = false;
+  // every request in the latency queue holds a DRAM credit, without a
+  // credit limit the queue grows as needed
+  unsigned credits = m_config->gpgpu_frfcfs_dram_sched_queue_size +
+                     m_config->gpgpu_dram_return_queue_size +
+                     m_config->gpgpu_frfcfs_dram_write_queue_size + 1;
+  m_dram_latency_queue = ring_buffer<dram_delay_t>(
+      std::max(credits, (unsigned)m_config->dram_latency));
 
   m_sub_partition = new memory_sub_partition
       *[m_config->m_n_sub_partition_per_memory_channel];
@@ -107,6 +120,48 @@ void memory_partition_unit::handle_memcpy_to_gpu(
       addr, m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle, mask, is_graphics);
 }
 
+bool memory_partition_unit::warm_l2(new_addr_type addr, unsigned subpart_id,
+                                    mem_access_sector_mask_t mask,
+                                    bool is_graphics) {
+  unsigned p = global_sub_partition_id_to_local_id(subpart_id);
+  return m_sub_partition[p]->warm_l2_tag(
+      addr, m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle, mask, is_graphics);
+}
+
+void memory_sub_partition::force_l2_tag_update(new_addr_type addr,
+                                               unsigned time,
+                                               mem_access_sector_mask_t mask,
+                                               bool is_graphics) {
+  unsigned flags = l2_access_log::LOG_COPY;
+  if (is_graphics) flags |= l2_access_log::LOG_GRAPHICS;
+  log_l2_access(addr, mask, flags);
+  m_L2cache->force_tag_access(addr, m_memcpy_cycle_offset + time, mask,
+                              is_graphics);
+  m_memcpy_cycle_offset += 1;
+}
+
+void memory_sub_partition::log_l2_access(new_addr_type addr,
+                                         mem_access_sector_mask_t mask,
+                                         unsigned flags) {
+  l2_access_log &log = m_gpu->l2_accesses();
+  if (!log.enabled()) return;
+  const l2_cache_config &l2 = m_config->m_L2_config;
+  log.record(m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle,
+             l2.block_addr(addr), m_id * l2.get_nset() + l2.set_index(addr),
+             mask.to_ulong(), flags);
+}
+
+bool memory_sub_partition::warm_l2_tag(new_addr_type addr, unsigned time,
+                                       mem_access_sector_mask_t mask,
+                                       bool is_graphics) {
+  if (m_config->m_L2_config.disabled()) return false;
+  log_l2_access(addr, mask, is_graphics ? l2_access_log::LOG_GRAPHICS : 0);
+  bool hit = m_L2cache->warm_tag_access(addr, m_memcpy_cycle_offset + time,
+                                        mask, is_graphics);
+  m_memcpy_cycle_offset += 1;
+  return hit;
+}
+
 void memory_partition_unit::invalidate_l2_range(
     size_t addr,unsigned range, unsigned global_subpart_id) {
   unsigned p = global_sub_partition_id_to_local_id(global_subpart_id);
@@ -115,6 +170,7 @@ void memory_partition_unit::invalidate_l2_range(
 
 memory_partition_unit::~memory_partition_unit() {
   delete m_dram;
+  delete m_traffic;
   for (unsigned p = 0; p < m_config->m_n_sub_partition_per_memory_channel;
        p++) {
     delete m_sub_partition[p];
@@ -239,6 +295,19 @@ int memory_partition_unit::global_sub_partition_id_to_local_id(
           m_id * m_config->m_n_sub_partition_per_memory_channel);
 }
 
+void memory_partition_unit::flush_dram_stats() {
+  m_dram->flush_deferred_stats();
+  // sent in the cycle they were issued, before the queue is looked at again
+  unsigned first = m_peer_queue.size() - m_unsent_peer_reads.size();
+  for (unsigned i = 0; i < m_unsent_peer_reads.size(); i++) {
+    dram_delay_t &d = m_peer_queue[first + i];
+    m_gpu->multi_gpus().peer_read(
+        d.req->get_addr(), m_unsent_peer_reads[i], d.req->get_data_size(),
+        m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle, d.ready_cycle);
+  }
+  m_unsent_peer_reads.clear();
+}
+
 void memory_partition_unit::simple_dram_model_cycle() {
   // pop completed memory request from dram and push it to dram-to-L2 queue
   // of the original sub partition
@@ -313,61 +382,105 @@ void memory_partition_unit::dram_cycle() {
   // pop completed memory request from dram and push it to dram-to-L2 queue
   // of the original sub partition
   mem_fetch *mf_return = m_dram->return_queue_top();
-  if (mf_return) {
-    unsigned dest_global_spid = mf_return->get_sub_partition_id();
-    int dest_spid = global_sub_partition_id_to_local_id(dest_global_spid);
-    assert(m_sub_partition[dest_spid]->get_id() == dest_global_spid);
-    if (!m_sub_partition[dest_spid]->dram_L2_queue_full()) {
-      if (mf_return->get_access_type() == L1_WRBK_ACC) {
-        m_sub_partition[dest_spid]->set_done(mf_return);
-        delete mf_return;
-      } else {
-        m_sub_partition[dest_spid]->dram_L2_queue_push(mf_return);
-        mf_return->set_status(IN_PARTITION_DRAM_TO_L2_QUEUE,
-                              m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
-        m_arbitration_metadata.return_credit(dest_spid);
-        MEMPART_DPRINTF(
-            "mem_fetch request %p return from dram to sub partition %d\n",
-            mf_return, dest_spid);
-      }
-      m_dram->return_queue_pop();
-    }
+  if (mf_return && m_traffic && m_traffic->owns(mf_return)) {
+    // background requests end here
+    m_traffic->retire(mf_return,
+                      m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+    m_dram->return_queue_pop();
+  } else if (mf_return) {
+    if (dram_return(mf_return)) m_dram->return_queue_pop();
   } else {
     m_dram->return_queue_pop();
   }
+  // the compressed requests that skipped the DRAM reply as it would
+  if (!m_dram_bypass_queue.empty() &&
+      m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle >=
+          m_dram_bypass_queue.front().ready_cycle) {
+    mem_fetch *mf = m_dram_bypass_queue.front().req;
+    if (mf->get_access_type() == L1_WRBK_ACC ||
+        mf->get_access_type() == L2_WRBK_ACC) {
+      set_done(mf);
+      delete mf;
+      m_dram_bypass_queue.pop_front();
+    } else if (dram_return(mf)) {
+      m_dram_bypass_queue.pop_front();
+    }
+  }
+  // the peer reads of -gpgpu_multi_gpu, in the order they were sent
+  if (!m_peer_queue.empty() &&
+      m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle >=
+          m_peer_queue.front().ready_cycle &&
+      dram_return(m_peer_queue.front().req))
+    m_peer_queue.pop_front();
 
   m_dram->cycle();
   m_dram->dram_log(SAMPLELOG);
+  if (m_traffic)
+    m_traffic->cycle(m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
 
   // mem_fetch *mf = m_sub_partition[spid]->L2_dram_queue_top();
   // if( !m_dram->full(mf->is_write()) ) {
   // L2->DRAM queue to DRAM latency queue
-  // Arbitrate among multiple L2 subpartitions
+  // Arbitrate among multiple L2 subpartitions, and the background traffic
+  // when it has the turn
+  bool issued = m_traffic && m_traffic_turn && issue_traffic();
   int last_issued_partition = m_arbitration_metadata.last_borrower();
-  for (unsigned p = 0; p < m_config->m_n_sub_partition_per_memory_channel;
-       p++) {
+  for (unsigned p = 0;
+       !issued && p < m_config->m_n_sub_partition_per_memory_channel; p++) {
     int spid = (p + last_issued_partition + 1) %
                m_config->m_n_sub_partition_per_memory_channel;
     if (!m_sub_partition[spid]->L2_dram_queue_empty() &&
         can_issue_to_dram(spid)) {
       mem_fetch *mf = m_sub_partition[spid]->L2_dram_queue_top();
+      dram_delay_t d;
+      d.req = mf;
+      // -gpgpu_multi_gpu: a line another GPU wrote comes over the link
+      unsigned sub = m_sub_partition[spid]->get_id();
+      if (m_gpu->multi_gpus().enabled() && !mf->is_write() &&
+          (m_defer_peer_reads
+               ? m_gpu->multi_gpus().from_peer(mf->get_addr(), sub)
+               : m_gpu->multi_gpus().peer_read(
+                     mf->get_addr(), sub, mf->get_data_size(),
+                     m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle,
+                     d.ready_cycle))) {
+        if (m_defer_peer_reads) m_unsent_peer_reads.push_back(sub);
+        m_sub_partition[spid]->L2_dram_queue_pop();
+        mf->set_reply();
+        m_peer_queue.push_back(d);
+        mf->set_status(IN_PARTITION_DRAM_LATENCY_QUEUE,
+                       m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+        m_arbitration_metadata.borrow_credit(spid);
+        continue;
+      }
       if (m_dram->full(mf->is_write())) break;
 
       m_sub_partition[spid]->L2_dram_queue_pop();
       MEMPART_DPRINTF(
           "Issue mem_fetch request %p from sub partition %d to dram\n", mf,
           spid);
-      dram_delay_t d;
-      d.req = mf;
       d.ready_cycle = m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle +
                       m_config->dram_latency;
-      m_dram_latency_queue.push_back(d);
+      compression_slice *compression = m_sub_partition[spid]->compression();
+      unsigned bytes = compression ? compression->dram_bytes(mf)
+                                   : mf->get_data_size();
+      if (bytes) {
+        mf->set_dram_size(bytes);
+        m_dram_latency_queue.push_back(d);
+      } else {
+        if (mf->get_access_type() != L1_WRBK_ACC &&
+            mf->get_access_type() != L2_WRBK_ACC)
+          mf->set_reply();
+        m_dram_bypass_queue.push_back(d);
+      }
       mf->set_status(IN_PARTITION_DRAM_LATENCY_QUEUE,
                      m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
       m_arbitration_metadata.borrow_credit(spid);
+      m_traffic_turn = true;
+      issued = true;
       break;  // the DRAM should only accept one request per cycle
     }
   }
+  if (m_traffic && !issued) issue_traffic();
   //}
 
   // DRAM latency queue
@@ -381,6 +494,41 @@ void memory_partition_unit::dram_cycle() {
   }
 }
 
+bool memory_partition_unit::dram_return(mem_fetch *mf) {
+  unsigned dest_global_spid = mf->get_sub_partition_id();
+  int dest_spid = global_sub_partition_id_to_local_id(dest_global_spid);
+  assert(m_sub_partition[dest_spid]->get_id() == dest_global_spid);
+  if (m_sub_partition[dest_spid]->dram_L2_queue_full()) return false;
+  if (mf->get_access_type() == L1_WRBK_ACC) {
+    m_sub_partition[dest_spid]->set_done(mf);
+    delete mf;
+  } else {
+    m_sub_partition[dest_spid]->dram_L2_queue_push(mf);
+    mf->set_status(IN_PARTITION_DRAM_TO_L2_QUEUE,
+                   m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+    m_arbitration_metadata.return_credit(dest_spid);
+    MEMPART_DPRINTF(
+        "mem_fetch request %p return from dram to sub partition %d\n", mf,
+        dest_spid);
+  }
+  return true;
+}
+
+bool memory_partition_unit::issue_traffic() {
+  mem_fetch *mf = m_traffic->top();
+  if (!mf || m_dram->full(mf->is_write())) return false;
+  m_traffic->pop();
+  dram_delay_t d;
+  d.req = mf;
+  d.ready_cycle = m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle +
+                  m_config->dram_latency;
+  m_dram_latency_queue.push_back(d);
+  mf->set_status(IN_PARTITION_DRAM_LATENCY_QUEUE,
+                 m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+  m_traffic_turn = false;
+  return true;
+}
+
 void memory_partition_unit::set_done(mem_fetch *mf) {
   unsigned global_spid = mf->get_sub_partition_id();
   int spid = global_sub_partition_id_to_local_id(global_spid);
@@ -408,11 +556,10 @@ void memory_partition_unit::print(FILE *fp) const {
        p++) {
     m_sub_partition[p]->print(fp);
   }
-  fprintf(fp, "In Dram Latency Queue (total = %zd): \n",
+  fprintf(fp, "In Dram Latency Queue (total = %u): \n",
           m_dram_latency_queue.size());
-  for (std::list<dram_delay_t>::const_iterator mf_dlq =
-           m_dram_latency_queue.begin();
-       mf_dlq != m_dram_latency_queue.end(); ++mf_dlq) {
+  for (unsigned i = 0; i < m_dram_latency_queue.size(); i++) {
+    const dram_delay_t *mf_dlq = &m_dram_latency_queue[i];
     mem_fetch *mf = mf_dlq->req;
     fprintf(fp, "Ready @ %llu - ", mf_dlq->ready_cycle);
     if (mf)
@@ -456,6 +603,16 @@ memory_sub_partition::memory_sub_partition(unsigned sub_partition_id,
   m_dram_L2_queue = new fifo_pipeline<mem_fetch>("dram-to-L2", 0, dram_L2);
   m_L2_icnt_queue = new fifo_pipeline<mem_fetch>("L2-to-icnt", 0, L2_icnt);
   wb_addr = -1;
+  m_rop_unit = m_config->rop_model ? new rop_unit(config, m_mf_allocator) : NULL;
+  m_prefetcher = NULL;
+  if (strcmp(m_config->l2_prefetch, "none") &&
+      !m_config->m_L2_config.disabled())
+    m_prefetcher = new l2_prefetcher(m_id, config, m_mf_allocator,
+                                     m_L2cache->get_stats());
+  m_compression =
+      m_config->gpgpu_compression
+          ? new compression_slice(m_config, gpu->compression())
+          : NULL;
 }
 
 memory_sub_partition::~memory_sub_partition() {
@@ -463,6 +620,9 @@ memory_sub_partition::~memory_sub_partition() {
   delete m_L2_dram_queue;
   delete m_dram_L2_queue;
   delete m_L2_icnt_queue;
+  delete m_rop_unit;
+  delete m_prefetcher;
+  delete m_compression;
   delete m_L2cache;
   delete m_L2interface;
 }
@@ -538,6 +698,22 @@ void memory_sub_partition::cache_cycle(unsigned cycle) {
                                          m_gpu->gpu_tot_sim_cycle +
                                          m_memcpy_cycle_offset,
                                      events);
+          if (status != RESERVATION_FAIL) {
+            if (m_prefetcher)
+              m_prefetcher->demand(mf, status, m_gpu->gpu_sim_cycle +
+                                                   m_gpu->gpu_tot_sim_cycle);
+            unsigned flags = 0;
+            if (mf->is_graphics()) flags |= l2_access_log::LOG_GRAPHICS;
+            if (mf->is_write()) flags |= l2_access_log::LOG_WRITE;
+            if (mf->is_tex()) flags |= l2_access_log::LOG_TEXTURE;
+            if (m_gpu->copies().enabled() && m_gpu->copies().owns(mf))
+              flags |= l2_access_log::LOG_COPY;
+            log_l2_access(mf->get_addr(), mf->get_access_sector_mask(), flags);
+            if (m_gpu->multi_gpus().enabled() && mf->is_write() &&
+                mf->get_sid() != (unsigned)-1)
+              m_gpu->multi_gpus().line_written(mf->get_addr(), m_id);
+            if (m_gpu->hybrid().recording()) m_gpu->hybrid().l2_access(mf);
+          }
         }
         
         bool write_sent = was_write_sent(events);
@@ -591,20 +767,91 @@ void memory_sub_partition::cache_cycle(unsigned cycle) {
       // L2 is disabled or non-texture access to texture-only L2
       mf->set_status(IN_PARTITION_L2_TO_DRAM_QUEUE,
                      m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+      m_dram_limiter.issued(mf->is_graphics(), mf->size());
       m_L2_dram_queue->push(mf);
       m_icnt_L2_queue->pop();
     }
   }
 
   // ROP delay queue
-  if (!m_rop.empty() && (cycle >= m_rop.front().ready_cycle) &&
-      !m_icnt_L2_queue->full()) {
+  if (!m_rop.empty() && (cycle >= m_rop.front().ready_cycle)) {
     mem_fetch *mf = m_rop.front().req;
-    m_rop.pop();
+    if (m_rop_unit && m_rop_unit->accepts(mf)) {
+      m_rop.pop();
+      m_rop_unit->push(mf, cycle);
+    } else if (!m_icnt_L2_queue->full()) {
+      m_rop.pop();
+      m_icnt_L2_queue->push(mf);
+      mf->set_status(IN_PARTITION_ICNT_TO_L2_QUEUE,
+                     m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+    }
+  }
+
+  // page table reads of the MMU, ahead of the prefetches
+  gpu_mmu &mmu = m_gpu->mmu();
+  if (mmu.enabled() && mmu.walk_top(m_id) && !m_icnt_L2_queue->full()) {
+    mem_fetch *mf = mmu.walk_top(m_id);
+    mmu.walk_pop(m_id);
+    m_request_tracker.insert(mf);
     m_icnt_L2_queue->push(mf);
     mf->set_status(IN_PARTITION_ICNT_TO_L2_QUEUE,
                    m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
   }
+
+  // writes of the copy engine
+  copy_engine &copies = m_gpu->copies();
+  if (copies.enabled() && copies.write_top(m_id) && !m_icnt_L2_queue->full()) {
+    mem_fetch *mf = copies.write_top(m_id);
+    copies.write_pop(m_id);
+    m_request_tracker.insert(mf);
+    m_icnt_L2_queue->push(mf);
+    mf->set_status(IN_PARTITION_ICNT_TO_L2_QUEUE,
+                   m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+  }
+
+  // requests of the kernels -gpgpu_hybrid_fidelity models
+  hybrid_fidelity &hybrid = m_gpu->hybrid();
+  if (hybrid.enabled() && !hybrid.recording() && hybrid.request_top(m_id) &&
+      !m_icnt_L2_queue->full()) {
+    mem_fetch *mf = hybrid.request_top(m_id);
+    hybrid.request_pop(m_id);
+    m_request_tracker.insert(mf);
+    m_icnt_L2_queue->push(mf);
+    mf->set_status(IN_PARTITION_ICNT_TO_L2_QUEUE,
+                   m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+  }
+
+  // prefetches only take the L2 when no demand request waits for it
+  if (m_prefetcher && m_prefetcher->top() && m_icnt_L2_queue->empty()) {
+    mem_fetch *mf = m_prefetcher->top();
+    m_prefetcher->pop();
+    m_request_tracker.insert(mf);
+    m_icnt_L2_queue->push(mf);
+    mf->set_status(IN_PARTITION_ICNT_TO_L2_QUEUE,
+                   m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+  }
+
+  // framebuffer tiles of the ROP, see rop_unit
+  if (m_rop_unit) {
+    m_rop_unit->cycle(cycle);
+    mem_fetch *mf = m_rop_unit->l2_top(cycle);
+    if (mf && !m_icnt_L2_queue->full()) {
+      m_rop_unit->l2_pop();
+      // the ROP's depth writes are its own
+      m_request_tracker.insert(mf);
+      m_icnt_L2_queue->push(mf);
+      mf->set_status(IN_PARTITION_ICNT_TO_L2_QUEUE,
+                     m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+    }
+    mf = m_rop_unit->ack_top(cycle);
+    if (mf && !m_L2_icnt_queue->full()) {
+      m_rop_unit->ack_pop();
+      mf->set_reply();
+      mf->set_status(IN_PARTITION_L2_TO_ICNT_QUEUE,
+                     m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+      m_L2_icnt_queue->push(mf);
+    }
+  }
 }
 
 bool memory_sub_partition::full() const { return m_icnt_L2_queue->full(); }
@@ -621,7 +868,16 @@ class mem_fetch *memory_sub_partition::L2_dram_queue_top() const {
   return m_L2_dram_queue->top();
 }
 
-void memory_sub_partition::L2_dram_queue_pop() { m_L2_dram_queue->pop(); }
+void memory_sub_partition::L2_dram_queue_pop() {
+  m_dram_limiter.retired(m_L2_dram_queue->top()->is_graphics());
+  m_L2_dram_queue->pop();
+}
+
+bool L2interface::class_blocked(bool graphics, unsigned size) {
+  gpgpu_sim *gpu = m_unit->m_gpu;
+  return m_unit->m_dram_limiter.blocked(
+      graphics, size, gpu->gpu_sim_cycle + gpu->gpu_tot_sim_cycle);
+}
 
 bool memory_sub_partition::dram_L2_queue_full() const {
   return m_dram_L2_queue->full();
@@ -831,11 +1087,41 @@ mem_fetch *memory_sub_partition::pop() {
     delete mf;
     mf = NULL;
   }
+  // the replies of prefetches, page table reads, copy writes and the
+  // requests of -gpgpu_hybrid_fidelity stop here
+  if (mf && m_prefetcher && m_prefetcher->owns(mf)) {
+    m_prefetcher->retire(mf);
+    delete mf;
+    mf = NULL;
+  }
+  if (mf && m_gpu->mmu().enabled() && m_gpu->mmu().owns(mf)) {
+    m_gpu->mmu().walk_done(mf, m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+    delete mf;
+    mf = NULL;
+  }
+  if (mf && m_gpu->copies().enabled() && m_gpu->copies().owns(mf)) {
+    m_gpu->copies().write_done(mf,
+                               m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+    delete mf;
+    mf = NULL;
+  }
+  if (mf && m_gpu->hybrid().enabled() && m_gpu->hybrid().owns(mf)) {
+    m_gpu->hybrid().retire(mf, m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+    delete mf;
+    mf = NULL;
+  }
   return mf;
 }
 
 mem_fetch *memory_sub_partition::top() {
   mem_fetch *mf = m_L2_icnt_queue->top();
+  // left for pop to drop
+  if (mf && m_prefetcher && m_prefetcher->owns(mf)) return NULL;
+  if (mf && m_gpu->mmu().enabled() && m_gpu->mmu().owns(mf)) return NULL;
+  if (mf && m_gpu->copies().enabled() && m_gpu->copies().owns(mf))
+    return NULL;
+  if (mf && m_gpu->hybrid().enabled() && m_gpu->hybrid().owns(mf))
+    return NULL;
   if (mf && (mf->get_access_type() == L2_WRBK_ACC ||
              mf->get_access_type() == L1_WRBK_ACC)) {
     m_L2_icnt_queue->pop();
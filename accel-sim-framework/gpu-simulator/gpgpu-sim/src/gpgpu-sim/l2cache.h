@@ -33,6 +33,10 @@
 
 #include "../abstract_hardware_model.h"
 #include "dram.h"
+#include "l2_prefetcher.h"
+#include "mem_throttle.h"
+#include "rop_unit.h"
+#include "surface_compression.h"
 
 #include <list>
 #include <queue>
@@ -80,6 +84,13 @@ class memory_partition_unit {
   void cache_cycle(unsigned cycle);
   void dram_cycle();
   void simple_dram_model_cycle();
+  // while partitions cycle in parallel, the shared DRAM stats and the peer
+  // reads of -gpgpu_multi_gpu wait for flush_dram_stats() in partition order
+  void set_defer_dram_stats(bool defer) {
+    m_dram->set_defer_stats(defer);
+    m_defer_peer_reads = defer;
+  }
+  void flush_dram_stats();
 
   void set_done(mem_fetch *mf);
 
@@ -90,6 +101,9 @@ class memory_partition_unit {
   void handle_memcpy_to_gpu(size_t dst_start_addr, unsigned subpart_id,
                             mem_access_sector_mask_t mask, bool is_graphics);
   void invalidate_l2_range(size_t addr, unsigned range, unsigned global_subpart_id);
+  // functional warm-up of the L2 of subpart_id, returns whether it hit
+  bool warm_l2(new_addr_type addr, unsigned subpart_id,
+               mem_access_sector_mask_t mask, bool is_graphics);
 
   class memory_sub_partition *get_sub_partition(int sub_partition_id) {
     return m_sub_partition[sub_partition_id];
@@ -108,6 +122,8 @@ class memory_partition_unit {
   class gpgpu_sim *get_mgpu() const {
     return m_gpu;
   }
+  // background traffic of the channel, NULL without one
+  const class dram_traffic *traffic() const { return m_traffic; }
 
  private:
   unsigned m_id;
@@ -115,6 +131,10 @@ class memory_partition_unit {
   class memory_stats_t *m_stats;
   class memory_sub_partition **m_sub_partition;
   class dram_t *m_dram;
+  class dram_traffic *m_traffic;
+  // the background traffic has the next turn for the DRAM
+  bool m_traffic_turn;
+  bool issue_traffic();
 
   class arbitration_metadata {
    public:
@@ -153,7 +173,16 @@ class memory_partition_unit {
     unsigned long long ready_cycle;
     class mem_fetch *req;
   };
-  std::list<dram_delay_t> m_dram_latency_queue;
+  ring_buffer<dram_delay_t> m_dram_latency_queue;
+  // requests to compressed tiles that need no DRAM access
+  std::deque<dram_delay_t> m_dram_bypass_queue;
+  // the L2 misses -gpgpu_multi_gpu reads from another GPU
+  std::deque<dram_delay_t> m_peer_queue;
+  // the last of m_peer_queue are not sent yet, with their sub partitions
+  bool m_defer_peer_reads;
+  std::vector<unsigned> m_unsent_peer_reads;
+  // routes a reply of the DRAM to its sub partition, false when it is full
+  bool dram_return(mem_fetch *mf);
 
   class gpgpu_sim *m_gpu;
 };
@@ -201,10 +230,11 @@ class memory_sub_partition {
   void clear_L2cache_stats_pw();
 
   void force_l2_tag_update(new_addr_type addr, unsigned time,
-                           mem_access_sector_mask_t mask, bool is_graphics) {
-    m_L2cache->force_tag_access(addr, m_memcpy_cycle_offset + time, mask, is_graphics);
-    m_memcpy_cycle_offset += 1;
-  }
+                           mem_access_sector_mask_t mask, bool is_graphics);
+  // like the copy engine, every warm-up access moves the L2's clock on one
+  // cycle so the warmed lines keep their LRU order
+  bool warm_l2_tag(new_addr_type addr, unsigned time,
+                   mem_access_sector_mask_t mask, bool is_graphics);
   void l2_invalidate_range(new_addr_type addr, unsigned range) {
     m_L2cache->invalidate_range(addr, range);
   }
@@ -221,10 +251,28 @@ class memory_sub_partition {
                    std::vector<unsigned> &utility_cp) const {
     m_L2cache->get_utility(utility_gr, utility_cp);
   }
+  void set_l2_graphics_ways(unsigned ways) {
+    m_L2cache->set_graphics_ways(ways);
+  }
+  void set_l2_tenant_ways(const unsigned ways[], unsigned tenants) {
+    m_L2cache->set_tenant_ways(ways, tenants);
+  }
+  void enable_l2_utility_monitor(unsigned sampled_sets) {
+    m_L2cache->enable_utility_monitor(sampled_sets);
+  }
+  void decay_l2_utility() { m_L2cache->decay_utility(); }
+  // graphics and compute requests in the L2 to DRAM queue
+  mem_class_limiter &dram_limiter() { return m_dram_limiter; }
+  const rop_unit *get_rop_unit() const { return m_rop_unit; }
+  // with -gpgpu_compression, NULL without
+  compression_slice *compression() const { return m_compression; }
 
  private:
   // data
   unsigned m_id;  //< the global sub partition ID
+  // -gpgpu_l2_access_log, flags as in l2_access_log
+  void log_l2_access(new_addr_type addr, mem_access_sector_mask_t mask,
+                     unsigned flags);
   const memory_config *m_config;
   class l2_cache *m_L2cache;
   class L2interface *m_L2interface;
@@ -237,12 +285,18 @@ class memory_sub_partition {
     class mem_fetch *req;
   };
   std::queue<rop_delay_t> m_rop;
+  // with -gpgpu_rop_model, for the framebuffer writes of the ROP queue
+  rop_unit *m_rop_unit;
+  // with -gpgpu_l2_prefetch
+  l2_prefetcher *m_prefetcher;
+  compression_slice *m_compression;
 
   // these are various FIFOs between units within a memory partition
   fifo_pipeline<mem_fetch> *m_icnt_L2_queue;
   fifo_pipeline<mem_fetch> *m_L2_dram_queue;
   fifo_pipeline<mem_fetch> *m_dram_L2_queue;
   fifo_pipeline<mem_fetch> *m_L2_icnt_queue;  // L2 cache hit response queue
+  mem_class_limiter m_dram_limiter;
 
   class mem_fetch *L2dramout;
   unsigned long long int wb_addr;
@@ -272,8 +326,10 @@ class L2interface : public mem_fetch_interface {
     // assume read and write packets all same size
     return m_unit->m_L2_dram_queue->full();
   }
+  virtual bool class_blocked(bool graphics, unsigned size);
   virtual void push(mem_fetch *mf) {
     mf->set_status(IN_PARTITION_L2_TO_DRAM_QUEUE, 0 /*FIXME*/);
+    m_unit->m_dram_limiter.issued(mf->is_graphics(), mf->size());
     m_unit->m_L2_dram_queue->push(mf);
   }
 
@@ -0,0 +1,46 @@
+// Live stats of a running simulation, see live_stats.h
+
+#include "live_stats.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+
+live_stats::~live_stats() {
+  if (m_snapshot) munmap(m_snapshot, sizeof(live_stats_snapshot));
+}
+
+bool live_stats::open(const char *path, unsigned long long period) {
+  int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+  if (ftruncate(fd, sizeof(live_stats_snapshot)) != 0) {
+    ::close(fd);
+    return false;
+  }
+  void *data = mmap(NULL, sizeof(live_stats_snapshot), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) return false;
+  m_snapshot = (live_stats_snapshot *)data;
+  m_period = period;
+  memset(m_snapshot, 0, sizeof(live_stats_snapshot));
+  m_snapshot->version = LIVE_STATS_VERSION;
+  m_snapshot->period = period;
+  std::atomic_thread_fence(std::memory_order_release);
+  // written last, a reader takes the file for a snapshot only from here on
+  memcpy(m_snapshot->magic, "GSLIVE\0\0", 8);
+  return true;
+}
+
+live_stats_snapshot &live_stats::begin() {
+  m_snapshot->sequence++;
+  std::atomic_thread_fence(std::memory_order_release);
+  return *m_snapshot;
+}
+
+void live_stats::end() {
+  std::atomic_thread_fence(std::memory_order_release);
+  m_snapshot->sequence++;
+}
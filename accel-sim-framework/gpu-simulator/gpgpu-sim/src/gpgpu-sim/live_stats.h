@@ -0,0 +1,78 @@
+// Live stats of a running simulation
+//
+// With -gpgpu_live_stats_file the cycle loop publishes a snapshot of the
+// run every -gpgpu_live_stats_period cycles into that file, mapped shared,
+// so a file under /dev/shm is a shared memory mailbox that other processes
+// map or read while the simulator runs. Publishing is a copy into the
+// mapping; nothing waits for a reader. The file is one live_stats_snapshot,
+// all fields little-endian 64 bit: the magic "GSLIVE\0\0", the version, a
+// sequence number that is odd while the snapshot is written and grows by
+// two with every one published, then the counters. A reader copies the
+// snapshot and takes it if the sequence number was the same even one
+// before and after the copy. Counters are cumulative, so rates are the
+// differences of two snapshots. util/job_launching/live_stats.py reads it.
+
+#ifndef LIVE_STATS_H
+#define LIVE_STATS_H
+
+#include "../abstract_hardware_model.h"
+
+static const unsigned LIVE_STATS_VERSION = 1;
+// running kernels a snapshot holds, the first of the running kernel slots
+static const unsigned LIVE_STATS_KERNELS = 16;
+
+struct live_stats_kernel {
+  unsigned long long uid;
+  unsigned long long graphics;
+  unsigned long long tenant;
+  unsigned long long start_cycle;
+  unsigned long long issued_ctas;
+  unsigned long long total_ctas;
+  unsigned long long insn;
+};
+
+struct live_stats_snapshot {
+  char magic[8];
+  unsigned long long version;
+  unsigned long long sequence;
+  unsigned long long period;
+  unsigned long long finished;  // 1 once the simulation is over
+  unsigned long long cycle;
+  unsigned long long insn;
+  // by class, [0] compute and [1] graphics
+  unsigned long long thread_insts[2];
+  unsigned long long l2_accesses[2];
+  unsigned long long l2_hits[2];
+  unsigned long long dram_accesses[2];
+  unsigned long long dram_bytes[2];  // counted by the FR-FCFS scheduler
+  // the SM partition: SMs with a CTA, the graphics SMs of MPS or the
+  // slicer, and the SMs of each -gpgpu_tenant_sms tenant
+  unsigned long long num_sms;
+  unsigned long long active_sms;
+  unsigned long long graphics_sms;
+  unsigned long long tenant_sms[MAX_TENANTS];
+  unsigned long long num_mem_partitions;
+  unsigned long long running_kernels;  // all of them, not only the listed
+  live_stats_kernel kernels[LIVE_STATS_KERNELS];
+};
+
+class live_stats {
+ public:
+  live_stats() : m_snapshot(NULL), m_period(0) {}
+  ~live_stats();
+
+  // false when path cannot be mapped
+  bool open(const char *path, unsigned long long period);
+  bool enabled() const { return m_snapshot != NULL; }
+  bool due(unsigned long long cycle) const { return cycle % m_period == 0; }
+
+  // the snapshot to fill in between the two, marked as being written
+  live_stats_snapshot &begin();
+  void end();
+
+ private:
+  live_stats_snapshot *m_snapshot;
+  unsigned long long m_period;
+};
+
+#endif
@@ -34,6 +34,7 @@
 #include <sstream>
 #include <utility>
 
+#include "core_stage_log.h"
 #include "local_interconnect.h"
 #include "mem_fetch.h"
 
@@ -53,6 +54,24 @@ xbar_router::xbar_router(unsigned router_id, enum Interconnect_type m_type,
   next_node.resize(total_nodes, 0);
   in_buffer_limit = m_localinct_config.in_buffer_limit;
   out_buffer_limit = m_localinct_config.out_buffer_limit;
+  unsigned words = (total_nodes + 63) / 64;
+  m_live_in.assign(words, 0);
+  m_requested_out.assign(words, 0);
+  m_requesters.assign(total_nodes, port_mask(words, 0));
+  m_requester_count.assign(total_nodes, 0);
+  m_graphics_requesters.assign(total_nodes, port_mask(words, 0));
+  m_graphics_count.assign(total_nodes, 0);
+  m_heads[0] = m_heads[1] = 0;
+  m_class_turn.assign(total_nodes, 0);
+  m_graphics_weight = m_localinct_config.class_graphics_weight;
+  m_class_weight_sum = 0;
+  if (m_localinct_config.class_arbiter)
+    m_class_weight_sum = m_graphics_weight +
+                         m_localinct_config.class_compute_weight;
+  m_candidates.assign(words, 0);
+  m_issued.assign(words, 0);
+  m_in_packets = m_out_packets = 0;
+  m_full_outs = out_buffer_limit ? 0 : total_nodes;
   arbit_type = m_localinct_config.arbiter_algo;
   next_node_id = 0;
   if (m_type == REQ_NET) {
@@ -73,15 +92,86 @@ xbar_router::xbar_router(unsigned router_id, enum Interconnect_type m_type,
   conflicts_util = 0;
   cycles_util = 0;
   reqs_util = 0;
+  for (unsigned c = 0; c < 2; c++) {
+    class_packets_num[c] = 0;
+    class_ejected_num[c] = 0;
+    class_blocked_heads[c] = 0;
+  }
 }
 
 xbar_router::~xbar_router() {}
 
+unsigned xbar_router::next_port(const port_mask& m, unsigned from) {
+  unsigned w = from / 64;
+  if (w >= m.size()) return from;
+  unsigned long long bits = m[w] & (~0ull << (from % 64));
+  while (!bits) {
+    if (++w == m.size()) return w * 64;
+    bits = m[w];
+  }
+  return w * 64 + __builtin_ctzll(bits);
+}
+
+void xbar_router::add_head(unsigned input, const Packet& head) {
+  unsigned out = head.output_deviceID;
+  set_port(m_requesters[out], input);
+  if (!m_requester_count[out]++) set_port(m_requested_out, out);
+  if (head.is_graphics) {
+    set_port(m_graphics_requesters[out], input);
+    m_graphics_count[out]++;
+  }
+  m_heads[head.is_graphics]++;
+}
+
+void xbar_router::remove_head(unsigned input, const Packet& head) {
+  unsigned out = head.output_deviceID;
+  clear_port(m_requesters[out], input);
+  if (!--m_requester_count[out]) clear_port(m_requested_out, out);
+  if (head.is_graphics) {
+    clear_port(m_graphics_requesters[out], input);
+    m_graphics_count[out]--;
+  }
+  m_heads[head.is_graphics]--;
+}
+
+void xbar_router::push_in(unsigned input, const Packet& packet) {
+  if (in_buffers[input].empty()) {
+    set_port(m_live_in, input);
+    add_head(input, packet);
+  }
+  in_buffers[input].push(packet);
+  m_in_packets++;
+}
+
+xbar_router::Packet xbar_router::pop_in(unsigned input) {
+  Packet packet = in_buffers[input].front();
+  in_buffers[input].pop();
+  m_in_packets--;
+  remove_head(input, packet);
+  if (in_buffers[input].empty()) {
+    clear_port(m_live_in, input);
+  } else {
+    // the next packet is now at the head
+    add_head(input, in_buffers[input].front());
+  }
+  return packet;
+}
+
+void xbar_router::push_out(const Packet& packet) {
+  unsigned out = packet.output_deviceID;
+  bool had_room = Has_Buffer_Out(out, 1);
+  out_buffers[out].push(packet);
+  m_out_packets++;
+  if (had_room && !Has_Buffer_Out(out, 1)) m_full_outs++;
+}
+
 void xbar_router::Push(unsigned input_deviceID, unsigned output_deviceID,
                        void* data, unsigned int size) {
   assert(input_deviceID < total_nodes);
-  in_buffers[input_deviceID].push(Packet(data, output_deviceID));
+  bool is_graphics = static_cast<mem_fetch*>(data)->is_graphics();
+  push_in(input_deviceID, Packet(data, output_deviceID, is_graphics));
   packets_num++;
+  class_packets_num[is_graphics]++;
 }
 
 void* xbar_router::Pop(unsigned ouput_deviceID) {
@@ -89,8 +179,12 @@ void* xbar_router::Pop(unsigned ouput_deviceID) {
   void* data = NULL;
 
   if (!out_buffers[ouput_deviceID].empty()) {
+    bool had_room = Has_Buffer_Out(ouput_deviceID, 1);
     data = out_buffers[ouput_deviceID].front().data;
+    class_ejected_num[out_buffers[ouput_deviceID].front().is_graphics]++;
     out_buffers[ouput_deviceID].pop();
+    m_out_packets--;
+    if (!had_room && Has_Buffer_Out(ouput_deviceID, 1)) m_full_outs--;
   }
 
   return data;
@@ -102,7 +196,7 @@ bool xbar_router::Has_Buffer_In(unsigned input_deviceID, unsigned size,
 
   bool has_buffer =
       (in_buffers[input_deviceID].size() + size <= in_buffer_limit);
-  if (update_counter && !has_buffer) in_buffer_full++;
+  if (update_counter && !has_buffer) core_stage_add(in_buffer_full, 1ull);
 
   return has_buffer;
 }
@@ -121,30 +215,32 @@ void xbar_router::Advance() {
 }
 
 void xbar_router::RR_Advance() {
-  bool active = false;
-  vector<bool> issued(total_nodes, false);
+  bool active = m_in_packets;
+  std::fill(m_issued.begin(), m_issued.end(), 0);
   unsigned conflict_sub = 0;
   unsigned reqs = 0;
 
-  for (unsigned i = 0; i < total_nodes; ++i) {
-    unsigned node_id = (i + next_node_id) % total_nodes;
-
-    if (!in_buffers[node_id].empty()) {
-      active = true;
-      Packet _packet = in_buffers[node_id].front();
+  // the live inputs in turn from next_node_id, an input popped this cycle
+  // has been visited already
+  for (unsigned pass = 0; pass < 2; ++pass) {
+    unsigned end = pass ? next_node_id : total_nodes;
+    for (unsigned node_id = next_port(m_live_in, pass ? 0 : next_node_id);
+         node_id < end; node_id = next_port(m_live_in, node_id + 1)) {
+      const Packet& _packet = in_buffers[node_id].front();
+      unsigned out = _packet.output_deviceID;
+      bool issued = m_issued[out / 64] >> (out % 64) & 1;
       // ensure that the outbuffer has space and not issued before in this cycle
-      if (Has_Buffer_Out(_packet.output_deviceID, 1)) {
-        if (!issued[_packet.output_deviceID]) {
-          out_buffers[_packet.output_deviceID].push(_packet);
-          in_buffers[node_id].pop();
-          issued[_packet.output_deviceID] = true;
+      if (Has_Buffer_Out(out, 1)) {
+        if (!issued) {
+          push_out(pop_in(node_id));
+          set_port(m_issued, out);
           reqs++;
         } else
           conflict_sub++;
       } else {
         out_buffer_full++;
 
-        if (issued[_packet.output_deviceID]) conflict_sub++;
+        if (issued) conflict_sub++;
       }
     }
   }
@@ -164,10 +260,10 @@ void xbar_router::RR_Advance() {
   }
 
   // collect some stats about buffer util
-  for (unsigned i = 0; i < total_nodes; ++i) {
-    in_buffer_util += in_buffers[i].size();
-    out_buffer_util += out_buffers[i].size();
-  }
+  class_blocked_heads[0] += m_heads[0];
+  class_blocked_heads[1] += m_heads[1];
+  in_buffer_util += m_in_packets;
+  out_buffer_util += m_out_packets;
 
   cycles++;
 }
@@ -177,70 +273,69 @@ void xbar_router::RR_Advance() {
 // IEEE/ACM transactions on networking 2 (1999): 188-201.
 // https://www.cs.rutgers.edu/~sn624/552-F18/papers/islip.pdf
 void xbar_router::iSLIP_Advance() {
-  vector<unsigned> node_tmp;
-  bool active = false;
+  bool active = m_in_packets;
 
   unsigned conflict_sub = 0;
   unsigned reqs = 0;
 
-  // calcaulte how many conflicts are there for stats
-  for (unsigned i = 0; i < total_nodes; ++i) {
-    if (!in_buffers[i].empty()) {
-      Packet _packet_tmp = in_buffers[i].front();
-      if (!node_tmp.empty()) {
-        if (std::find(node_tmp.begin(), node_tmp.end(),
-                      _packet_tmp.output_deviceID) != node_tmp.end()) {
-          conflict_sub++;
-        } else
-          node_tmp.push_back(_packet_tmp.output_deviceID);
-      } else {
-        node_tmp.push_back(_packet_tmp.output_deviceID);
-      }
-      active = true;
-    }
-  }
+  // calcaulte how many conflicts are there for stats: every head packet
+  // after the first for the same output
+  for (unsigned i = next_port(m_requested_out, 0); i < total_nodes;
+       i = next_port(m_requested_out, i + 1))
+    conflict_sub += m_requester_count[i] - 1;
 
   conflicts += conflict_sub;
   if (active) {
     conflicts_util += conflict_sub;
     cycles_util++;
   }
-  // do iSLIP
-  for (unsigned i = 0; i < total_nodes; ++i) {
-    if (Has_Buffer_Out(i, 1)) {
-      for (unsigned j = 0; j < total_nodes; ++j) {
-        unsigned node_id = (j + next_node[i]) % total_nodes;
-
-        if (!in_buffers[node_id].empty()) {
-          Packet _packet = in_buffers[node_id].front();
-          if (_packet.output_deviceID == i) {
-            out_buffers[_packet.output_deviceID].push(_packet);
-            in_buffers[node_id].pop();
-            if (verbose)
-              printf("%d : cycle %d : send req from %d to %d\n", m_id, cycles,
-                     node_id, i - _n_shader);
-            if (grant_cycles_count == 1)
-              next_node[i] = (++node_id % total_nodes);
-            if (verbose) {
-              for (unsigned k = j + 1; k < total_nodes; ++k) {
-                unsigned node_id2 = (k + next_node[i]) % total_nodes;
-                if (!in_buffers[node_id2].empty()) {
-                  Packet _packet2 = in_buffers[node_id2].front();
-
-                  if (_packet2.output_deviceID == i)
-                    printf("%d : cycle %d : cannot send req from %d to %d\n",
-                           m_id, cycles, node_id2, i - _n_shader);
-                }
-              }
-            }
-
-            reqs++;
-            break;
-          }
-        }
+  // an output only fills up in its own turn below, so the outputs without
+  // room are the ones full now, requested or not
+  out_buffer_full += m_full_outs;
+  // do iSLIP, over the outputs some head packet is for. A grant can bring a
+  // packet for a later output to the head, which that output still sees
+  for (unsigned i = next_port(m_requested_out, 0); i < total_nodes;
+       i = next_port(m_requested_out, i + 1)) {
+    if (!Has_Buffer_Out(i, 1)) continue;
+    const port_mask& requesters = m_requesters[i];
+    const port_mask* candidates = &requesters;
+    unsigned n_candidates = m_requester_count[i];
+    if (m_class_weight_sum) {
+      // the class whose slot it is, unless only the other one is asking
+      unsigned n_graphics = m_graphics_count[i];
+      bool graphics = m_class_turn[i] < m_graphics_weight;
+      if (graphics ? !n_graphics : n_graphics == n_candidates)
+        graphics = !graphics;
+      if (graphics) {
+        candidates = &m_graphics_requesters[i];
+        n_candidates = n_graphics;
+      } else {
+        for (unsigned w = 0; w < m_candidates.size(); w++)
+          m_candidates[w] = requesters[w] & ~m_graphics_requesters[i][w];
+        candidates = &m_candidates;
+        n_candidates -= n_graphics;
       }
-    } else
-      out_buffer_full++;
+      m_class_turn[i] = (m_class_turn[i] + 1) % m_class_weight_sum;
+    }
+    unsigned node_id = next_port(*candidates, 0);
+    // a lone requester wins, otherwise the first in turn from next_node[i]
+    if (n_candidates > 1 && next_node[i]) {
+      unsigned next = next_port(*candidates, next_node[i]);
+      if (next < total_nodes) node_id = next;
+    }
+    push_out(pop_in(node_id));
+    if (verbose)
+      printf("%d : cycle %d : send req from %d to %d\n", m_id, cycles,
+             node_id, i - _n_shader);
+    if (grant_cycles_count == 1) next_node[i] = (node_id + 1) % total_nodes;
+    if (verbose) {
+      for (unsigned k = next_port(requesters, 0); k < total_nodes;
+           k = next_port(requesters, k + 1))
+        printf("%d : cycle %d : cannot send req from %d to %d\n", m_id,
+               cycles, k, i - _n_shader);
+    }
+
+    reqs++;
   }
 
   if (active) {
@@ -261,22 +356,15 @@ void xbar_router::iSLIP_Advance() {
   }
 
   // collect some stats about buffer util
-  for (unsigned i = 0; i < total_nodes; ++i) {
-    in_buffer_util += in_buffers[i].size();
-    out_buffer_util += out_buffers[i].size();
-  }
+  class_blocked_heads[0] += m_heads[0];
+  class_blocked_heads[1] += m_heads[1];
+  in_buffer_util += m_in_packets;
+  out_buffer_util += m_out_packets;
 
   cycles++;
 }
 
-bool xbar_router::Busy() const {
-  for (unsigned i = 0; i < total_nodes; ++i) {
-    if (!in_buffers[i].empty()) return true;
-
-    if (!out_buffers[i].empty()) return true;
-  }
-  return false;
-}
+bool xbar_router::Busy() const { return m_in_packets || m_out_packets; }
 
 ////////////////////////////////////////////////////
 /////////////LocalInterconnect/////////////////////
@@ -297,6 +385,13 @@ LocalInterconnect::LocalInterconnect(
   n_shader = 0;
   n_mem = 0;
   n_subnets = m_localinct_config.subnets;
+  if (m_localinct_config.class_arbiter &&
+      !(m_localinct_config.class_graphics_weight +
+        m_localinct_config.class_compute_weight)) {
+    fprintf(stderr,
+            "GPGPU-Sim: -icnt_class_arbiter needs a non-zero class weight\n");
+    exit(1);
+  }
 }
 
 LocalInterconnect::~LocalInterconnect() {
@@ -364,17 +459,30 @@ bool LocalInterconnect::Busy() const {
   return false;
 }
 
-bool LocalInterconnect::HasBuffer(unsigned deviceID, unsigned int size) const {
+bool LocalInterconnect::HasBuffer(unsigned deviceID, unsigned int size,
+                                  unsigned staged) const {
   bool has_buffer = false;
 
   if ((n_subnets > 1) && deviceID >= n_shader)  // deviceID is memory node
-    has_buffer = net[REPLY_NET]->Has_Buffer_In(deviceID, 1, true);
+    has_buffer = net[REPLY_NET]->Has_Buffer_In(deviceID, 1 + staged, true);
   else
-    has_buffer = net[REQ_NET]->Has_Buffer_In(deviceID, 1, true);
+    has_buffer = net[REQ_NET]->Has_Buffer_In(deviceID, 1 + staged, true);
 
   return has_buffer;
 }
 
+static void display_class_stats(const char* name, const xbar_router* net) {
+  const char* cls[2] = {"compute", "graphics"};
+  for (unsigned c = 0; c < 2; c++) {
+    printf("%s_Network_%s_injected_packets_num = %lld\n", name, cls[c],
+           net->class_packets_num[c]);
+    printf("%s_Network_%s_ejected_packets_per_cycle = %12.4f\n", name, cls[c],
+           (float)(net->class_ejected_num[c]) / (net->cycles));
+    printf("%s_Network_%s_blocked_heads_per_cycle = %12.4f\n", name, cls[c],
+           (float)(net->class_blocked_heads[c]) / (net->cycles));
+  }
+}
+
 void LocalInterconnect::DisplayStats() const {
   printf("Req_Network_injected_packets_num = %lld\n",
          net[REQ_NET]->packets_num);
@@ -397,6 +505,7 @@ void LocalInterconnect::DisplayStats() const {
   printf("Req_Network_out_buffer_avg_util = %12.4f\n",
          ((float)(net[REQ_NET]->out_buffer_util) / (net[REQ_NET]->cycles) /
           net[REQ_NET]->active_out_buffers));
+  display_class_stats("Req", net[REQ_NET]);
 
   printf("\n");
   printf("Reply_Network_injected_packets_num = %lld\n",
@@ -421,6 +530,7 @@ void LocalInterconnect::DisplayStats() const {
   printf("Reply_Network_out_buffer_avg_util = %12.4f\n",
          ((float)(net[REPLY_NET]->out_buffer_util) / (net[REPLY_NET]->cycles) /
           net[REPLY_NET]->active_out_buffers));
+  display_class_stats("Reply", net[REPLY_NET]);
 }
 
 void LocalInterconnect::DisplayOverallStats() const {}
@@ -47,6 +47,15 @@ struct inct_config {
   Arbiteration_type arbiter_algo;
   unsigned verbose;
   unsigned grant_cycles;
+  // iSLIP grants at an output go to graphics for class_graphics_weight of
+  // every class_graphics_weight + class_compute_weight grants, when it has
+  // a request; a weight of 0 leaves that class the lower priority
+  unsigned class_arbiter;
+  unsigned class_graphics_weight;
+  unsigned class_compute_weight;
+  // config for the analytical model
+  unsigned analytical_latency;
+  unsigned analytical_port_bw;
 };
 
 class xbar_router {
@@ -76,21 +85,62 @@ class xbar_router {
   unsigned long long in_buffer_full;
   unsigned long long in_buffer_util;
   unsigned long long packets_num;
+  // indexed by is_graphics
+  unsigned long long class_packets_num[2];
+  unsigned long long class_ejected_num[2];
+  unsigned long long class_blocked_heads[2];  // summed at each cycle end
 
  private:
   void iSLIP_Advance();
   void RR_Advance();
 
+  // port sets are bit masks of total_nodes bits
+  typedef vector<unsigned long long> port_mask;
+  static void set_port(port_mask& m, unsigned port) {
+    m[port / 64] |= 1ull << (port % 64);
+  }
+  static void clear_port(port_mask& m, unsigned port) {
+    m[port / 64] &= ~(1ull << (port % 64));
+  }
+  // the first port from on, or a port >= total_nodes when there is none
+  static unsigned next_port(const port_mask& m, unsigned from);
+
   struct Packet {
-    Packet(void* m_data, unsigned m_output_deviceID) {
+    Packet(void* m_data, unsigned m_output_deviceID, bool m_is_graphics) {
       data = m_data;
       output_deviceID = m_output_deviceID;
+      is_graphics = m_is_graphics;
     }
     void* data;
     unsigned output_deviceID;
+    bool is_graphics;
   };
+  void add_head(unsigned input, const Packet& head);
+  void remove_head(unsigned input, const Packet& head);
+  void push_in(unsigned input, const Packet& packet);
+  Packet pop_in(unsigned input);
+  void push_out(const Packet& packet);
+
   vector<queue<Packet> > in_buffers;
   vector<queue<Packet> > out_buffers;
+  // kept on every push and pop so an Advance only visits live ports: the
+  // non-empty inputs, the outputs some input's head packet is for and, per
+  // output, those inputs
+  port_mask m_live_in;
+  port_mask m_requested_out;
+  vector<port_mask> m_requesters;
+  vector<unsigned> m_requester_count;
+  // the graphics ones among m_requesters, and the head packets per class
+  vector<port_mask> m_graphics_requesters;
+  vector<unsigned> m_graphics_count;
+  unsigned m_heads[2];
+  // class arbitration: the grant slot each output is at
+  vector<unsigned> m_class_turn;
+  unsigned m_graphics_weight, m_class_weight_sum;
+  port_mask m_candidates;
+  port_mask m_issued;  // RR_Advance, outputs granted this cycle
+  unsigned long long m_in_packets, m_out_packets;
+  unsigned m_full_outs;  // outputs without room for a packet
   unsigned _n_shader, _n_mem, total_nodes;
   unsigned in_buffer_limit, out_buffer_limit;
   vector<unsigned> next_node;  // used for iSLIP arbit
@@ -121,7 +171,9 @@ class LocalInterconnect {
   void* Pop(unsigned ouput_deviceID);
   void Advance();
   bool Busy() const;
-  bool HasBuffer(unsigned deviceID, unsigned int size) const;
+  // staged packets are about to be pushed at deviceID
+  bool HasBuffer(unsigned deviceID, unsigned int size,
+                 unsigned staged = 0) const;
   void DisplayStats() const;
   void DisplayOverallStats() const;
   unsigned GetFlitSize() const;
@@ -27,6 +27,12 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "mem_fetch.h"
+#include <string.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "core_stage_log.h"
 #include "gpu-sim.h"
 #include "mem_latency_stat.h"
 #include "shader.h"
@@ -34,6 +40,170 @@
 
 unsigned mem_fetch::sm_next_mf_request_uid = 1;
 
+namespace {
+
+// Slots are carved from chunks that are never returned to malloc. Each slot
+// starts with a header that links it into a free list while it is free; the
+// lists are per thread because DRAM partitions may free requests on the
+// partition threads, so a slot can end up on another thread's list. A thread
+// that frees more than it allocates hands full lists of CHUNK_SLOTS to a
+// shared stack, which a thread with an empty list takes from before it
+// carves a new chunk.
+// With MEM_FETCH_POOL_DEBUG freed slots are poisoned and kept in a
+// quarantine before reuse: freeing a slot twice aborts, and so does reusing
+// a slot that was written after it was freed.
+class mem_fetch_pool {
+ public:
+  void print_stats() {
+    unsigned long long live = m_live.load();
+    printf("mem_fetch pool: %llu allocations, %llu slots, peak %llu live, "
+           "%llu still live at exit\n",
+           m_allocs.load(), m_slots.load(), m_peak.load(), live);
+  }
+
+  void *allocate() {
+    slot *s = pop();
+    s->magic = SLOT_LIVE;
+    m_allocs.fetch_add(1, std::memory_order_relaxed);
+    unsigned long long live = m_live.fetch_add(1, std::memory_order_relaxed) + 1;
+    unsigned long long peak = m_peak.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !m_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+      ;
+    return s + 1;
+  }
+
+  void release(void *p) {
+    slot *s = (slot *)p - 1;
+    if (s->magic != SLOT_LIVE) {
+      fprintf(stderr, "mem_fetch %p freed twice or not from the pool\n", p);
+      abort();
+    }
+    m_live.fetch_sub(1, std::memory_order_relaxed);
+#ifdef MEM_FETCH_POOL_DEBUG
+    s->magic = SLOT_FREED;
+    memset(p, POISON, sizeof(mem_fetch));
+    std::lock_guard<std::mutex> lock(m_quarantine_lock);
+    m_quarantine.push_back(s);
+#else
+    if (t_count == CHUNK_SLOTS) {
+      std::lock_guard<std::mutex> lock(m_spilled_lock);
+      m_spilled.push_back(t_free);
+      t_free = NULL;
+      t_count = 0;
+    }
+    s->next = t_free;
+    t_free = s;
+    t_count++;
+#endif
+  }
+
+ private:
+  union slot {
+    slot *next;
+    unsigned long long magic;
+    // keeps the mem_fetch after the header aligned
+    long double align;
+  };
+  static const unsigned long long SLOT_LIVE = 0x6d656d6665746368ULL;
+  static const unsigned long long SLOT_FREED = 0x6672656564666574ULL;
+  static const unsigned CHUNK_SLOTS = 1024;
+  static const unsigned SLOT_WORDS =
+      1 + (sizeof(mem_fetch) + sizeof(slot) - 1) / sizeof(slot);
+  static const unsigned char POISON = 0xdb;
+  static const unsigned QUARANTINE_SLOTS = 4096;
+
+  slot *pop() {
+#ifdef MEM_FETCH_POOL_DEBUG
+    {
+      std::lock_guard<std::mutex> lock(m_quarantine_lock);
+      if (m_quarantine.size() > QUARANTINE_SLOTS) {
+        slot *s = m_quarantine.front();
+        m_quarantine.pop_front();
+        const unsigned char *obj = (const unsigned char *)(s + 1);
+        for (unsigned i = 0; i < sizeof(mem_fetch); i++) {
+          if (s->magic != SLOT_FREED || obj[i] != POISON) {
+            fprintf(stderr, "mem_fetch %p was written after it was freed\n",
+                    (void *)(s + 1));
+            abort();
+          }
+        }
+        return s;
+      }
+    }
+#endif
+    if (!t_free) refill();
+    slot *s = t_free;
+    t_free = s->next;
+    t_count--;
+    return s;
+  }
+
+  void refill() {
+    {
+      std::lock_guard<std::mutex> lock(m_spilled_lock);
+      if (!m_spilled.empty()) {
+        t_free = m_spilled.back();
+        t_count = CHUNK_SLOTS;
+        m_spilled.pop_back();
+        return;
+      }
+    }
+    slot *chunk = new slot[CHUNK_SLOTS * SLOT_WORDS];
+    for (unsigned i = 0; i < CHUNK_SLOTS; i++) {
+      slot *s = chunk + i * SLOT_WORDS;
+      s->next = t_free;
+      t_free = s;
+    }
+    t_count = CHUNK_SLOTS;
+    m_slots.fetch_add(CHUNK_SLOTS, std::memory_order_relaxed);
+  }
+
+  static thread_local slot *t_free;
+  static thread_local unsigned t_count;  // slots on t_free
+  std::atomic<unsigned long long> m_allocs{0};
+  std::atomic<unsigned long long> m_slots{0};
+  std::atomic<unsigned long long> m_live{0};
+  std::atomic<unsigned long long> m_peak{0};
+  // lists of CHUNK_SLOTS free slots, from threads that freed more than they
+  // allocated
+  std::mutex m_spilled_lock;
+  std::vector<slot *> m_spilled;
+#ifdef MEM_FETCH_POOL_DEBUG
+  std::mutex m_quarantine_lock;
+  std::deque<slot *> m_quarantine;
+#endif
+};
+
+thread_local mem_fetch_pool::slot *mem_fetch_pool::t_free = NULL;
+thread_local unsigned mem_fetch_pool::t_count = 0;
+
+mem_fetch_pool *new_pool();
+
+mem_fetch_pool &pool() {
+  // never destroyed, static objects may still free requests at exit
+  static mem_fetch_pool *p = new_pool();
+  return *p;
+}
+
+void print_pool_stats() { pool().print_stats(); }
+
+mem_fetch_pool *new_pool() {
+  atexit(print_pool_stats);
+  return new mem_fetch_pool;
+}
+
+}  // namespace
+
+void *mem_fetch::operator new(size_t size) {
+  assert(size == sizeof(mem_fetch));
+  return pool().allocate();
+}
+
+void mem_fetch::operator delete(void *p) {
+  if (p) pool().release(p);
+}
+
 mem_fetch::mem_fetch(const mem_access_t &access, const warp_inst_t *inst,
                      unsigned ctrl_size, unsigned wid, unsigned sid,
                      unsigned tpc, const memory_config *config,
@@ -42,13 +212,25 @@ mem_fetch::mem_fetch(const mem_access_t &access, const warp_inst_t *inst,
     : m_access(access)
 
 {
-  m_request_uid = sm_next_mf_request_uid++;
+  m_request_uid = core_stage_take_uid(sm_next_mf_request_uid);
   m_access = access;
+  m_inst = NULL;
   if (inst) {
-    m_inst = *inst;
-    assert(wid == m_inst.warp_id());
+    assert(wid == inst->warp_id());
+    m_inst_info.is_graphics = inst->is_vertex() || inst->is_fragment();
+    m_inst_info.is_tex = inst->is_tex();
+    m_inst_info.tenant = inst->get_tenant();
+    m_inst_info.uid = inst->get_uid();
+    if (!inst->empty()) {
+      m_inst_info.valid = true;
+      m_inst_info.is_atomic = inst->isatomic();
+      m_inst_info.space = inst->space.get_type();
+      m_inst_info.pc = inst->pc;
+    }
+    m_inst = new warp_inst_t(*inst);
   }
   m_data_size = access.get_size();
+  m_dram_size = 0;
   m_ctrl_size = ctrl_size;
   m_sid = sid;
   m_tpc = tpc;
@@ -57,23 +239,17 @@ mem_fetch::mem_fetch(const mem_access_t &access, const warp_inst_t *inst,
 
         
   if (config->m_shader_config->gpgpu_concurrent_mig && inst) {
-    const gpgpu_sim *gpu = config->get_gpgpu_sim();
-    float dynamic_ratio = (float)gpu->dynamic_sm_count / gpu->concurrent_granularity;
-    unsigned sub_partition = m_raw_addr.sub_partition;
-    if (is_graphics()) {
-      sub_partition = sub_partition * dynamic_ratio;
-    } else {
-      unsigned avail_sm =
-          config->m_shader_config->num_shader() * (1.0f - dynamic_ratio);
-      unsigned start = config->m_n_mem_sub_partition * dynamic_ratio;
-      sub_partition = start + sub_partition * avail_sm /
-                                  config->m_shader_config->num_shader();
-    }
-    unsigned chip =
-        sub_partition / config->m_n_sub_partition_per_memory_channel;
-    assert(chip < config->m_n_mem);
-    assert(sub_partition < config->m_n_mem_sub_partition);
-    m_raw_addr.chip = chip;
+    // one table lookup, gpgpu_sim keeps the tables in step with the split
+    unsigned sub_partition = config->m_address_mapping.tenant_sub_partition(
+        get_tenant(), m_raw_addr.sub_partition);
+    m_raw_addr.chip = config->m_address_mapping.sub_partition_chip(sub_partition);
+    m_raw_addr.sub_partition = sub_partition;
+  }
+  if (config->m_address_mapping.gpus() > 1 && sid != (unsigned)-1) {
+    // the memory of the SM's own GPU
+    unsigned sub_partition = config->m_address_mapping.gpu_sub_partition(
+        config->m_shader_config->sid_to_cluster(sid), m_raw_addr.sub_partition);
+    m_raw_addr.chip = config->m_address_mapping.sub_partition_chip(sub_partition);
     m_raw_addr.sub_partition = sub_partition;
   }
   m_partition_addr =
@@ -81,6 +257,7 @@ mem_fetch::mem_fetch(const mem_access_t &access, const warp_inst_t *inst,
   m_type = m_access.is_write() ? WRITE_REQUEST : READ_REQUEST;
   m_timestamp = cycle;
   m_timestamp2 = 0;
+  m_icnt_push_time = cycle;
   m_status = MEM_FETCH_INITIALIZED;
   m_status_change = cycle;
   m_mem_config = config;
@@ -94,7 +271,31 @@ mem_fetch::mem_fetch(const mem_access_t &access, const warp_inst_t *inst,
   }
 }
 
-mem_fetch::~mem_fetch() { m_status = MEM_FETCH_DELETED; }
+void mem_fetch::set_replay_source(bool is_graphics, unsigned tenant,
+                                  bool texture_space, bool is_tex) {
+  assert(!m_inst);
+  m_inst_info.is_graphics = is_graphics;
+  m_inst_info.tenant = tenant;
+  m_inst_info.is_tex = is_tex;
+  if (texture_space) m_inst_info.space = tex_space;
+  if (m_mem_config->m_shader_config->gpgpu_concurrent_mig) {
+    unsigned sub_partition = m_mem_config->m_address_mapping.tenant_sub_partition(
+        tenant, m_raw_addr.sub_partition);
+    m_raw_addr.chip =
+        m_mem_config->m_address_mapping.sub_partition_chip(sub_partition);
+    m_raw_addr.sub_partition = sub_partition;
+  }
+}
+
+mem_fetch::~mem_fetch() {
+  m_status = MEM_FETCH_DELETED;
+  delete m_inst;
+}
+
+const warp_inst_t &mem_fetch::get_inst() {
+  static const warp_inst_t no_inst;
+  return m_inst ? *m_inst : no_inst;
+}
 
 #define MF_TUP_BEGIN(X) static const char *Status_str[] = {
 #define MF_TUP(X) #X
@@ -118,8 +319,8 @@ void mem_fetch::print(FILE *fp, bool print_inst) const {
     fprintf(fp, " status = %s (%llu), ", Status_str[m_status], m_status_change);
   else
     fprintf(fp, " status = %u??? (%llu), ", m_status, m_status_change);
-  if (!m_inst.empty() && print_inst)
-    m_inst.print(fp);
+  if (m_inst_info.valid && print_inst)
+    m_inst->print(fp);
   else
     fprintf(fp, "\n");
 }
@@ -130,22 +331,18 @@ void mem_fetch::set_status(enum mem_fetch_status status,
   m_status_change = cycle;
 }
 
-bool mem_fetch::isatomic() const {
-  if (m_inst.empty()) return false;
-  return m_inst.isatomic();
-}
+bool mem_fetch::isatomic() const { return m_inst_info.is_atomic; }
 
-void mem_fetch::do_atomic() { m_inst.do_atomic(m_access.get_warp_mask()); }
-
-bool mem_fetch::istexture() const {
-  if (m_inst.empty()) return false;
-  return m_inst.space.get_type() == tex_space;
+void mem_fetch::do_atomic() {
+  assert(m_inst);
+  m_inst->do_atomic(m_access.get_warp_mask());
 }
 
+bool mem_fetch::istexture() const { return m_inst_info.space == tex_space; }
+
 bool mem_fetch::isconst() const {
-  if (m_inst.empty()) return false;
-  return (m_inst.space.get_type() == const_space) ||
-         (m_inst.space.get_type() == param_space_kernel);
+  return (m_inst_info.space == const_space) ||
+         (m_inst_info.space == param_space_kernel);
 }
 
 /// Returns number of flits traversing interconnect. simt_to_mem specifies the
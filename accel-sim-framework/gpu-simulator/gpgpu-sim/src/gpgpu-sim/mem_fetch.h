@@ -50,6 +50,30 @@ enum mf_type {
 #undef MF_TUP
 #undef MF_TUP_END
 
+// what the memory system needs to know about the requesting instruction,
+// taken once at creation so caches and partitions do not touch the
+// instruction copy
+struct mem_fetch_inst_info {
+  mem_fetch_inst_info()
+      : valid(false),
+        is_graphics(false),
+        is_tex(false),
+        is_atomic(false),
+        tenant(1),
+        space(undefined_space),
+        pc(-1),
+        uid(0) {}
+
+  bool valid;
+  bool is_graphics;  // vertex or fragment
+  bool is_tex;
+  bool is_atomic;
+  unsigned tenant;  // < MAX_TENANTS, 0 = graphics
+  enum _memory_space_t space;
+  address_type pc;
+  unsigned uid;
+};
+
 class memory_config;
 class mem_fetch {
  public:
@@ -60,6 +84,11 @@ class mem_fetch {
             mem_fetch *original_wr_mf = NULL);
   ~mem_fetch();
 
+  // mem_fetch storage comes from a per-thread free list of fixed slots
+  // instead of malloc, see mem_fetch_pool in mem_fetch.cc
+  static void *operator new(size_t size);
+  static void operator delete(void *p);
+
   void set_status(enum mem_fetch_status status, unsigned long long cycle);
   void set_reply() {
     assert(m_access.get_type() != L1_WRBK_ACC &&
@@ -83,6 +112,11 @@ class mem_fetch {
   }
   unsigned get_data_size() const { return m_data_size; }
   void set_data_size(unsigned size) { m_data_size = size; }
+  // bytes the DRAM moves, other than the data for a compressed surface
+  unsigned get_dram_size() const {
+    return m_dram_size ? m_dram_size : m_data_size;
+  }
+  void set_dram_size(unsigned size) { m_dram_size = size; }
   unsigned get_ctrl_size() const { return m_ctrl_size; }
   unsigned size() const { return m_data_size + m_ctrl_size; }
   bool is_write() { return m_access.is_write(); }
@@ -107,6 +141,8 @@ class mem_fetch {
   unsigned get_timestamp() const { return m_timestamp; }
   unsigned get_return_timestamp() const { return m_timestamp2; }
   unsigned get_icnt_receive_time() const { return m_icnt_receive_time; }
+  void set_icnt_push_time(unsigned long long t) { m_icnt_push_time = t; }
+  unsigned long long get_icnt_push_time() const { return m_icnt_push_time; }
 
   enum mem_access_type get_access_type() const { return m_access.get_type(); }
   const active_mask_t &get_access_warp_mask() const {
@@ -119,8 +155,11 @@ class mem_fetch {
     return m_access.get_sector_mask();
   }
 
-  address_type get_pc() const { return m_inst.empty() ? -1 : m_inst.pc; }
-  const warp_inst_t &get_inst() { return m_inst; }
+  address_type get_pc() const { return m_inst_info.pc; }
+  unsigned get_inst_uid() const { return m_inst_info.uid; }
+  // the full instruction, only kept for requests issued by a core, which
+  // needs it back to write back and to run atomics
+  const warp_inst_t &get_inst();
   enum mem_fetch_status get_status() const { return m_status; }
 
   const memory_config *get_mem_config() { return m_mem_config; }
@@ -129,9 +168,19 @@ class mem_fetch {
 
   mem_fetch *get_original_mf() { return original_mf; }
   mem_fetch *get_original_wr_mf() { return original_wr_mf; }
-  bool is_graphics() {return m_inst.is_vertex() || m_inst.is_fragment();}
+  bool is_graphics() const { return m_inst_info.is_graphics; }
+  unsigned get_tenant() const { return m_inst_info.tenant; }
+  bool is_tex() const { return m_inst_info.is_tex; }
+  // what the instruction of a request replayed without it (-gpgpu_mem_replay)
+  // would have set, and the MIG sub partition of its tenant
+  void set_replay_source(bool is_graphics, unsigned tenant,
+                         bool texture_space, bool is_tex);
 
  private:
+  // owns m_inst
+  mem_fetch(const mem_fetch &) = delete;
+  mem_fetch &operator=(const mem_fetch &) = delete;
+
   // request source information
   unsigned m_request_uid;
   unsigned m_sid;
@@ -146,6 +195,7 @@ class mem_fetch {
   // request type, address, size, mask
   mem_access_t m_access;
   unsigned m_data_size;  // how much data is being written
+  unsigned m_dram_size;  // 0 for m_data_size
   unsigned
       m_ctrl_size;  // how big would all this meta data be in hardware (does not
                     // necessarily match actual size of mem_fetch)
@@ -163,9 +213,11 @@ class mem_fetch {
                           // onto icnt to shader; only used for reads
   unsigned m_icnt_receive_time;  // set to gpu_sim_cycle + interconnect_latency
                                  // when fixed icnt latency mode is enabled
+  unsigned long long m_icnt_push_time;  // last pushed onto the interconnect
 
-  // requesting instruction (put last so mem_fetch prints nicer in gdb)
-  warp_inst_t m_inst;
+  // requesting instruction, m_inst is NULL if there is none
+  mem_fetch_inst_info m_inst_info;
+  warp_inst_t *m_inst;
 
   static unsigned sm_next_mf_request_uid;
 
@@ -46,6 +46,24 @@
 
 #include "../../libcuda/gpgpu_context.h"
 
+kernel_mem_stats::kernel_mem_stats() {
+  dram_reads = 0;
+  dram_writes = 0;
+  num_mfs = 0;
+  mf_total_lat = 0;
+  mf_max_lat = 0;
+  memset(mf_lat_table, 0, sizeof(mf_lat_table));
+}
+
+void kernel_mem_stats::merge(const kernel_mem_stats &other) {
+  dram_reads += other.dram_reads;
+  dram_writes += other.dram_writes;
+  num_mfs += other.num_mfs;
+  mf_total_lat += other.mf_total_lat;
+  if (other.mf_max_lat > mf_max_lat) mf_max_lat = other.mf_max_lat;
+  for (unsigned i = 0; i < 32; i++) mf_lat_table[i] += other.mf_lat_table[i];
+}
+
 memory_stats_t::memory_stats_t(unsigned n_shader,
                                const shader_core_config *shader_config,
                                const memory_config *mem_config,
@@ -82,6 +100,18 @@ memory_stats_t::memory_stats_t(unsigned n_shader,
   m_n_shader = n_shader;
   m_memory_config = mem_config;
   m_gpu = gpu;
+  for (unsigned c = 0; c < 2; c++) {
+    dram_class_accesses[c] = 0;
+    dram_class_row_hits[c] = 0;
+    dram_class_bytes[c] = 0;
+    dram_class_queue_latency[c] = 0;
+    for (unsigned r = 0; r < 2; r++) {
+      icnt_class_injected[r][c] = 0;
+      icnt_class_injected_bytes[r][c] = 0;
+      icnt_class_ejected[r][c] = 0;
+      icnt_class_latency[r][c] = 0;
+    }
+  }
   total_n_access = 0;
   total_n_reads = 0;
   total_n_writes = 0;
@@ -171,8 +201,6 @@ memory_stats_t::memory_stats_t(unsigned n_shader,
   L2_read_hit = 0;
   L2_write_hit = 0;
 
-  bankreads_per_kernel.resize(gpu->get_config().get_max_concurrent_kernel(), 0);
-
   L2_cbtoL2length =
       (unsigned int *)calloc(mem_config->m_n_mem, sizeof(unsigned int));
   L2_cbtoL2writelength =
@@ -201,6 +229,11 @@ unsigned memory_stats_t::memlatstat_done(mem_fetch *mf) {
   mf_total_lat_table[mf->get_tlx_addr().chip][mf->get_tlx_addr().bk] +=
       mf_latency;
   if (mf_latency > max_mf_latency) max_mf_latency = mf_latency;
+  kernel_mem_stats &kernel = kernel_record(mf->get_kernel_uid());
+  kernel.mf_lat_table[idx]++;
+  kernel.num_mfs++;
+  kernel.mf_total_lat += mf_latency;
+  if (mf_latency > kernel.mf_max_lat) kernel.mf_max_lat = mf_latency;
   return mf_latency;
 }
 
@@ -232,12 +265,14 @@ void memory_stats_t::memlatstat_dram_access(mem_fetch *mf) {
       }
       totalbankwrites[dram_id][bank] +=
           ceil(mf->get_data_size() / m_memory_config->dram_atom_size);
+      kernel_record(mf->get_kernel_uid()).dram_writes +=
+          ceil(mf->get_data_size() / m_memory_config->dram_atom_size);
     } else {
       bankreads[mf->get_sid()][dram_id][bank]++;
       shader_mem_acc_log(mf->get_sid(), dram_id, bank, 'r');
       totalbankreads[dram_id][bank] +=
           ceil(mf->get_data_size() / m_memory_config->dram_atom_size); 
-      bankreads_per_kernel[mf->get_kernel_uid()] += 
+      kernel_record(mf->get_kernel_uid()).dram_reads +=
           ceil(mf->get_data_size() / m_memory_config->dram_atom_size);
     }
     mem_access_type_stats[mf->get_access_type()][dram_id][bank] +=
@@ -419,7 +454,7 @@ void memory_stats_t::memlatstat_print(unsigned kernel_id, unsigned n_mem, unsign
       printf("\n");
     }
     printf("total dram reads = %d\n", k);
-    printf("dram reads = %d\n", bankreads_per_kernel[kernel_id]);
+    printf("dram reads = %llu\n", kernel_record(kernel_id).dram_reads);
     if (min_bank_accesses)
       printf("bank skew: %d/%d = %4.2f\n", max_bank_accesses, min_bank_accesses,
              (float)max_bank_accesses / min_bank_accesses);
@@ -530,11 +565,107 @@ void memory_stats_t::memlatstat_print(unsigned kernel_id, unsigned n_mem, unsign
   }
 }
 
-void memory_stats_t::expand_memlatstat(unsigned kernel_id) {
-    if (kernel_id + 1 > bankreads_per_kernel.size()) {
-      bankreads_per_kernel.resize(
-          bankreads_per_kernel.size() +
-              m_gpu->get_config().get_max_concurrent_kernel(),
-          0);
+void memory_stats_t::print_dram_class_stats(unsigned long long cycles) const {
+  printf("gpu_dram_sched_policy = %s\n", m_memory_config->dram_sched_policy);
+  const char *cls[2] = {"compute", "graphics"};
+  for (unsigned c = 0; c < 2; c++) {
+    unsigned long long n = dram_class_accesses[c];
+    printf("gpu_dram_%s_accesses = %llu\n", cls[c], n);
+    printf("gpu_dram_%s_row_hit_rate = %.4f\n", cls[c],
+           n ? (double)dram_class_row_hits[c] / n : 0.0);
+    printf("gpu_dram_%s_bytes_per_cycle = %.4f\n", cls[c],
+           cycles ? (double)dram_class_bytes[c] / cycles : 0.0);
+    printf("gpu_dram_%s_queue_latency = %.2f\n", cls[c],
+           n ? (double)dram_class_queue_latency[c] / n : 0.0);
+  }
+}
+
+static bool icnt_is_reply(const mem_fetch *mf) {
+  return mf->get_type() == READ_REPLY || mf->get_type() == WRITE_ACK;
+}
+
+void memory_stats_t::icnt_class_push(mem_fetch *mf, unsigned size) {
+  bool reply = icnt_is_reply(mf);
+  icnt_class_injected[reply][mf->is_graphics()]++;
+  icnt_class_injected_bytes[reply][mf->is_graphics()] += size;
+  mf->set_icnt_push_time(m_gpu->gpu_tot_sim_cycle + m_gpu->gpu_sim_cycle);
+}
+
+void memory_stats_t::icnt_class_pop(mem_fetch *mf) {
+  bool reply = icnt_is_reply(mf);
+  icnt_class_ejected[reply][mf->is_graphics()]++;
+  icnt_class_latency[reply][mf->is_graphics()] +=
+      m_gpu->gpu_tot_sim_cycle + m_gpu->gpu_sim_cycle -
+      mf->get_icnt_push_time();
+}
+
+void memory_stats_t::print_icnt_class_stats(unsigned long long cycles) const {
+  const char *cls[2] = {"compute", "graphics"};
+  const char *net[2] = {"req", "reply"};
+  for (unsigned r = 0; r < 2; r++) {
+    for (unsigned c = 0; c < 2; c++) {
+      unsigned long long n = icnt_class_ejected[r][c];
+      printf("gpu_icnt_%s_%s_packets = %llu\n", net[r], cls[c],
+             icnt_class_injected[r][c]);
+      printf("gpu_icnt_%s_%s_injected_bytes_per_cycle = %.4f\n", net[r],
+             cls[c],
+             cycles ? (double)icnt_class_injected_bytes[r][c] / cycles : 0.0);
+      printf("gpu_icnt_%s_%s_latency = %.2f\n", net[r], cls[c],
+             n ? (double)icnt_class_latency[r][c] / n : 0.0);
     }
-  }
\ No newline at end of file
+  }
+}
+
+kernel_mem_stats &memory_stats_t::kernel_record(unsigned kernel_id) {
+  std::map<unsigned, kernel_mem_stats>::iterator k = m_kernels.find(kernel_id);
+  return k != m_kernels.end() ? k->second : m_no_kernel;
+}
+
+void memory_stats_t::expand_memlatstat(unsigned kernel_id) {
+  // a zeroed record, or the one the kernel has
+  m_kernels.insert(std::make_pair(kernel_id, kernel_mem_stats()));
+}
+
+void memory_stats_t::release_kernel(unsigned kernel_id) {
+  std::map<unsigned, kernel_mem_stats>::iterator k = m_kernels.find(kernel_id);
+  if (k == m_kernels.end()) return;
+  m_retired.merge(k->second);
+  m_kernels.erase(k);
+}
+
+const kernel_mem_stats &memory_stats_t::kernel_stats(
+    unsigned kernel_id) const {
+  std::map<unsigned, kernel_mem_stats>::const_iterator k =
+      m_kernels.find(kernel_id);
+  return k != m_kernels.end() ? k->second : m_no_kernel;
+}
+
+kernel_mem_stats memory_stats_t::total_record() const {
+  kernel_mem_stats total = m_retired;
+  total.merge(m_no_kernel);
+  for (std::map<unsigned, kernel_mem_stats>::const_iterator k =
+           m_kernels.begin();
+       k != m_kernels.end(); k++)
+    total.merge(k->second);
+  return total;
+}
+
+void memory_stats_t::print_kernel_stats(unsigned kernel_id) const {
+  if (!m_memory_config->gpgpu_memlatency_stat) return;
+  const kernel_mem_stats &kernel = kernel_stats(kernel_id);
+  // this kernel is still among the running ones
+  kernel_mem_stats total = total_record();
+
+  printf("gpu_kernel_dram_reads = %llu\n", kernel.dram_reads);
+  printf("gpu_kernel_dram_writes = %llu\n", kernel.dram_writes);
+  printf("gpu_kernel_avg_mf_latency = %.2f\n",
+         kernel.num_mfs ? (double)kernel.mf_total_lat / kernel.num_mfs : 0.0);
+  printf("gpu_kernel_max_mf_latency = %u\n", kernel.mf_max_lat);
+  printf("gpu_kernel_mf_lat_table:");
+  for (unsigned i = 0; i < 32; i++) printf("%u \t", kernel.mf_lat_table[i]);
+  printf("\n");
+  printf("gpu_tot_dram_reads = %llu\n", total.dram_reads);
+  printf("gpu_tot_dram_writes = %llu\n", total.dram_writes);
+  printf("gpu_tot_avg_mf_latency = %.2f\n",
+         total.num_mfs ? (double)total.mf_total_lat / total.num_mfs : 0.0);
+}
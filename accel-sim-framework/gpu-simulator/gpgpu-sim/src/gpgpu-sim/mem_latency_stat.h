@@ -35,6 +35,21 @@
 #include <vector>
 
 class memory_config;
+
+// DRAM accesses and memory latencies of one kernel under
+// -gpgpu_memlatency_stat, kept from its launch until its stats were printed
+struct kernel_mem_stats {
+  kernel_mem_stats();
+  void merge(const kernel_mem_stats &other);
+
+  unsigned long long dram_reads;  // in -dram_atom_size accesses
+  unsigned long long dram_writes;
+  unsigned long long num_mfs;     // read replies
+  unsigned long long mf_total_lat;
+  unsigned mf_max_lat;
+  unsigned mf_lat_table[32];
+};
+
 class memory_stats_t {
  public:
   memory_stats_t(unsigned n_shader,
@@ -47,13 +62,27 @@ class memory_stats_t {
   void memlatstat_icnt2mem_pop(class mem_fetch *mf);
   void memlatstat_lat_pw();
   void memlatstat_print(unsigned kernel_id, unsigned n_mem, unsigned gpu_mem_n_bk);
+  // kernel_id launched, it gets a record of its own
   void expand_memlatstat(unsigned kernel_id);
+  // the stats of kernel_id were printed, its record goes into the retired
+  // total and is freed
+  void release_kernel(unsigned kernel_id);
+  void print_kernel_stats(unsigned kernel_id) const;
+  // the record of kernel_id, the one of no kernel after it was released
+  const kernel_mem_stats &kernel_stats(unsigned kernel_id) const;
+  // the retired kernels, those still running and the accesses of none
+  kernel_mem_stats total_record() const;
 
   void visualizer_print(gzFile visualizer_file);
 
   // Reset local L2 stats that are aggregated each sampling window
   void clear_L2_stats_pw();
 
+  void print_dram_class_stats(unsigned long long cycles) const;
+  void icnt_class_push(class mem_fetch *mf, unsigned size);
+  void icnt_class_pop(class mem_fetch *mf);
+  void print_icnt_class_stats(unsigned long long cycles) const;
+
   unsigned m_n_shader;
 
   const shader_core_config *m_shader_config;
@@ -121,11 +150,31 @@ class memory_stats_t {
   unsigned int **max_servicetime2samerow;  // max_servicetime2samerow[dram chip
                                            // id][bank id]
 
+  // requests the FR-FCFS schedulers served, indexed by is_graphics
+  unsigned long long dram_class_accesses[2];
+  unsigned long long dram_class_row_hits[2];
+  unsigned long long dram_class_bytes[2];
+  unsigned long long dram_class_queue_latency[2];  // cycles summed
+
+  // packets through the interconnect, indexed by [is reply][is_graphics]
+  unsigned long long icnt_class_injected[2][2];
+  unsigned long long icnt_class_injected_bytes[2][2];
+  unsigned long long icnt_class_ejected[2][2];
+  unsigned long long icnt_class_latency[2][2];  // push to pop, cycles summed
+
   // Power stats
   unsigned total_n_access;
   unsigned total_n_reads;
   unsigned total_n_writes;
-  std::vector<unsigned> bankreads_per_kernel;
+
+ private:
+  // the record of kernel_id, the one of no kernel once it was released
+  kernel_mem_stats &kernel_record(unsigned kernel_id);
+
+  // by uid, of the kernels launched and not released yet
+  std::map<unsigned, kernel_mem_stats> m_kernels;
+  kernel_mem_stats m_retired;
+  kernel_mem_stats m_no_kernel;  // stray accesses after a release
 };
 
 #endif /*MEM_LATENCY_STAT_H*/
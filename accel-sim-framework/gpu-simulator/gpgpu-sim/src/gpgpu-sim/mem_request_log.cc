@@ -0,0 +1,117 @@
+// Memory request stream of a run, for replaying the memory side alone
+
+#include "mem_request_log.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// records buffered before they go to gzwrite or after gzread
+static const unsigned BUFFER_RECORDS = 1 << 16;
+static const unsigned RECORD_SIZE = 32;
+static const unsigned VERSION = 1;
+
+static void put(std::vector<unsigned char> &b, uint64_t v, unsigned bytes) {
+  for (unsigned i = 0; i < bytes; i++) b.push_back(v >> (8 * i));
+}
+
+static uint64_t get(const unsigned char *p, unsigned bytes) {
+  uint64_t v = 0;
+  for (unsigned i = 0; i < bytes; i++) v |= (uint64_t)p[i] << (8 * i);
+  return v;
+}
+
+mem_request_log::mem_request_log() {
+  m_file = NULL;
+  m_records = 0;
+}
+
+mem_request_log::~mem_request_log() { close(); }
+
+bool mem_request_log::open(const char *path) {
+  assert(!enabled());
+  m_file = gzopen(path, "wb");
+  if (!m_file) return false;
+  m_buffer.reserve((size_t)BUFFER_RECORDS * RECORD_SIZE);
+  gzwrite(m_file, "GMRQ", 4);
+  put(m_buffer, VERSION, 4);
+  flush();
+  return true;
+}
+
+void mem_request_log::record(const mem_request &r) {
+  put(m_buffer, r.cycle, 8);
+  put(m_buffer, r.addr, 8);
+  put(m_buffer, r.size, 4);
+  put(m_buffer, r.sid, 2);
+  put(m_buffer, r.access_type, 1);
+  put(m_buffer, r.sectors, 1);
+  put(m_buffer, r.flags, 1);
+  put(m_buffer, r.tenant, 1);
+  put(m_buffer, 0, 6);
+  if (++m_records % BUFFER_RECORDS == 0) flush();
+}
+
+void mem_request_log::flush() {
+  if (!m_buffer.empty()) gzwrite(m_file, m_buffer.data(), m_buffer.size());
+  m_buffer.clear();
+}
+
+void mem_request_log::close() {
+  if (!m_file) return;
+  flush();
+  gzclose(m_file);
+  m_file = NULL;
+  printf("GPGPU-Sim: %llu memory requests logged\n", m_records);
+}
+
+mem_request_reader::mem_request_reader() {
+  m_file = NULL;
+  m_pos = 0;
+}
+
+mem_request_reader::~mem_request_reader() { close(); }
+
+bool mem_request_reader::open(const char *path) {
+  assert(!enabled());
+  m_file = gzopen(path, "rb");
+  if (!m_file) return false;
+  unsigned char header[8];
+  if (gzread(m_file, header, sizeof(header)) != (int)sizeof(header) ||
+      memcmp(header, "GMRQ", 4) || get(header + 4, 4) != VERSION) {
+    close();
+    return false;
+  }
+  m_buffer.clear();
+  m_pos = 0;
+  return true;
+}
+
+bool mem_request_reader::next(mem_request &r) {
+  if (!m_file) return false;
+  if (m_pos + RECORD_SIZE > m_buffer.size()) {
+    m_buffer.resize((size_t)BUFFER_RECORDS * RECORD_SIZE);
+    int n = gzread(m_file, m_buffer.data(), m_buffer.size());
+    m_buffer.resize(n > 0 ? n - n % RECORD_SIZE : 0);
+    m_pos = 0;
+    if (m_buffer.empty()) return false;
+  }
+  const unsigned char *p = m_buffer.data() + m_pos;
+  m_pos += RECORD_SIZE;
+  r.cycle = get(p, 8);
+  r.addr = get(p + 8, 8);
+  r.size = get(p + 16, 4);
+  r.sid = get(p + 20, 2);
+  r.access_type = p[22];
+  r.sectors = p[23];
+  r.flags = p[24];
+  r.tenant = p[25];
+  return true;
+}
+
+void mem_request_reader::close() {
+  if (!m_file) return;
+  gzclose(m_file);
+  m_file = NULL;
+}
@@ -0,0 +1,84 @@
+// Memory request stream of a run, for replaying the memory side alone
+//
+// -gpgpu_mem_request_log records every request the memory sub partitions
+// take from the interconnect, that is what is left once the L1s filtered
+// the accesses of the cores, along with the copy engine transfers, each
+// with the cycle it arrived and its class. -gpgpu_mem_replay feeds the
+// stream into the L2s and DRAM of another configuration without
+// simulating the cores, for L2 partitioning, MIG and DRAM scheduling
+// studies. The sub partition of a request is decoded again on replay, so
+// the address mapping and the MIG split may differ from the recorded run.
+// Requests arrive at their recorded cycles and only wait when their sub
+// partition is full: the cores do not react to the new memory timing, and
+// atomics are replayed as plain accesses.
+//
+// The file is gzip: magic "GMRQ" and a version (32 bit), then 32 byte
+// records of the cycle and the address (64 bit), the size in bytes of the
+// request or of the copy (32 bit), the sid (16 bit), the access type, the
+// sector mask, the flags and the tenant (8 bit), and 6 bytes of padding,
+// all little-endian.
+
+#ifndef MEM_REQUEST_LOG_H
+#define MEM_REQUEST_LOG_H
+
+#include <zlib.h>
+#include <vector>
+
+struct mem_request {
+  enum flags {
+    REQ_GRAPHICS = 1,
+    REQ_WRITE = 2,
+    REQ_TEX_SPACE = 4,  // goes through the texture queue of the L2
+    REQ_COPY = 8,       // a copy engine transfer of size bytes
+    REQ_TEX_INST = 16
+  };
+
+  unsigned long long cycle;
+  unsigned long long addr;
+  unsigned size;
+  unsigned sid;
+  unsigned access_type;
+  unsigned sectors;
+  unsigned flags;
+  unsigned tenant;
+};
+
+class mem_request_log {
+ public:
+  mem_request_log();
+  ~mem_request_log();
+
+  // false when path cannot be written
+  bool open(const char *path);
+  bool enabled() const { return m_file != NULL; }
+  void record(const mem_request &r);
+  // writes the records buffered so far and closes the file
+  void close();
+
+ private:
+  void flush();
+
+  gzFile m_file;
+  std::vector<unsigned char> m_buffer;
+  unsigned long long m_records;
+};
+
+class mem_request_reader {
+ public:
+  mem_request_reader();
+  ~mem_request_reader();
+
+  // false when path cannot be read or is not a request log
+  bool open(const char *path);
+  bool enabled() const { return m_file != NULL; }
+  // the next record, false at the end of the log
+  bool next(mem_request &r);
+  void close();
+
+ private:
+  gzFile m_file;
+  std::vector<unsigned char> m_buffer;
+  size_t m_pos;
+};
+
+#endif
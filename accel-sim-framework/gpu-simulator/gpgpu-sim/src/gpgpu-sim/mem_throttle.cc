@@ -0,0 +1,69 @@
+// Per-class limits on the memory requests crossing a boundary
+
+#include "mem_throttle.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+bool parse_mem_class_limits(const char *caps, const char *rates,
+                            mem_class_limits limits[2]) {
+  return sscanf(caps, "%u,%u", &limits[1].cap, &limits[0].cap) == 2 &&
+         sscanf(rates, "%f,%f", &limits[1].rate, &limits[0].rate) == 2 &&
+         limits[1].rate >= 0 && limits[0].rate >= 0;
+}
+
+mem_class_limiter::mem_class_limiter() {
+  m_enabled = false;
+  m_depth = 0;
+  for (unsigned c = 0; c < 2; c++) {
+    m_limits[c].cap = 0;
+    m_limits[c].rate = 0;
+    m_outstanding[c] = 0;
+    m_tokens[c] = 0;
+    m_refill_cycle[c] = 0;
+    m_passed[c] = 0;
+    m_blocked_cycles[c] = 0;
+    m_retired[c] = 0;
+    m_latency_sum[c] = 0;
+  }
+}
+
+void mem_class_limiter::set_limits(bool graphics,
+                                   const mem_class_limits &limits,
+                                   unsigned depth) {
+  m_limits[graphics] = limits;
+  m_depth = depth;
+  m_tokens[graphics] = std::min(m_tokens[graphics], (float)depth);
+  m_enabled = m_limits[0].cap || m_limits[0].rate || m_limits[1].cap ||
+              m_limits[1].rate;
+}
+
+bool mem_class_limiter::blocked(bool graphics, unsigned size,
+                                unsigned long long now) {
+  if (!m_enabled) return false;
+  const mem_class_limits &l = m_limits[graphics];
+  bool wait = l.cap && m_outstanding[graphics] >= l.cap;
+  if (l.rate) {
+    float &tokens = m_tokens[graphics];
+    tokens = std::min(tokens + l.rate * (now - m_refill_cycle[graphics]),
+                      (float)m_depth);
+    m_refill_cycle[graphics] = now;
+    // a full bucket lets a request larger than the burst through
+    wait = wait || (tokens < size && tokens < m_depth);
+  }
+  if (wait) m_blocked_cycles[graphics]++;
+  return wait;
+}
+
+void mem_class_limiter::issued(bool graphics, unsigned size, bool retires) {
+  m_passed[graphics]++;
+  if (retires) m_outstanding[graphics]++;
+  if (m_limits[graphics].rate) m_tokens[graphics] -= size;
+}
+
+void mem_class_limiter::retired(bool graphics, unsigned latency) {
+  // a reply whose request crossed before the limiter existed
+  if (m_outstanding[graphics]) m_outstanding[graphics]--;
+  m_retired[graphics]++;
+  m_latency_sum[graphics] += latency;
+}
@@ -0,0 +1,59 @@
+// Per-class limits on the memory requests crossing a boundary
+//
+// Graphics and compute requests leaving an SM for the interconnect and
+// leaving an L2 sub partition for DRAM each pass a mem_class_limiter. A
+// class may have at most cap requests past the boundary that have not
+// retired yet, and injects through a token bucket filled with rate bytes per
+// cycle up to depth bytes of burst. gpgpu_sim::update_mem_throttle scales
+// the graphics limits at runtime to keep compute latency in check.
+
+#ifndef MEM_THROTTLE_H
+#define MEM_THROTTLE_H
+
+// limits of one class, 0 = unlimited
+struct mem_class_limits {
+  unsigned cap;
+  float rate;
+};
+
+// parse "graphics,compute" caps and rates such as -gpgpu_mem_class_caps
+// into limits[1] and limits[0], false when either is malformed
+bool parse_mem_class_limits(const char *caps, const char *rates,
+                            mem_class_limits limits[2]);
+
+class mem_class_limiter {
+ public:
+  mem_class_limiter();
+
+  // indexed by is_graphics
+  void set_limits(bool graphics, const mem_class_limits &limits,
+                  unsigned depth);
+  bool enabled() const { return m_enabled; }
+
+  // whether a request of size bytes has to wait at cycle now, counts the
+  // cycles it waits
+  bool blocked(bool graphics, unsigned size, unsigned long long now);
+  // a request that no reply or pop retires does not count as outstanding
+  void issued(bool graphics, unsigned size, bool retires = true);
+  // latency is only summed by the boundaries that see the reply
+  void retired(bool graphics, unsigned latency = 0);
+
+  unsigned outstanding(bool graphics) const { return m_outstanding[graphics]; }
+
+  // totals since the start, per class
+  unsigned long long m_passed[2];
+  unsigned long long m_blocked_cycles[2];
+  unsigned long long m_retired[2];
+  unsigned long long m_latency_sum[2];
+
+ private:
+  bool m_enabled;
+  mem_class_limits m_limits[2];
+  unsigned m_depth;
+  unsigned m_outstanding[2];
+  // the bucket is refilled lazily, for the cycles since m_refill_cycle
+  float m_tokens[2];
+  unsigned long long m_refill_cycle[2];
+};
+
+#endif
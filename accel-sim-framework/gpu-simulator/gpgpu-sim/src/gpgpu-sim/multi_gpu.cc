@@ -0,0 +1,145 @@
+// Several GPUs joined by an inter-GPU link, see multi_gpu.h
+
+#include "multi_gpu.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "gpu-sim.h"
+
+// the request of a peer read, its address and command
+static const unsigned PEER_REQUEST_BYTES = 8;
+
+multi_gpu::multi_gpu() {
+  m_enabled = false;
+  m_gpus = 1;
+  m_policy = SPLIT_FRAME;
+  m_bandwidth = 0;
+  m_latency = 0;
+  m_clusters_per_gpu = 1;
+  m_subs_per_gpu = 1;
+  m_line_size = 0;
+  m_frame = 0;
+  m_has_tiles = false;
+  m_tile_columns = 0;
+  m_peer_reads = m_peer_cycles = 0;
+}
+
+void multi_gpu::configure(const memory_config *config,
+                          unsigned n_clusters, unsigned n_sub_partitions) {
+  m_enabled = strcmp(config->gpgpu_multi_gpu, "none") != 0;
+  if (!m_enabled) return;
+  char policy[4] = {0};
+  if (sscanf(config->gpgpu_multi_gpu, "%u:%3[a-z]:%u:%u", &m_gpus, policy,
+             &m_bandwidth, &m_latency) != 4 ||
+      m_gpus < 2 || m_gpus > 255 || !m_bandwidth ||
+      (strcmp(policy, "sfr") != 0 && strcmp(policy, "afr") != 0)) {
+    printf("GPGPU-Sim: -gpgpu_multi_gpu \'%s\' is not <gpus, 2 to 255>:<sfr "
+           "or afr>:<link bytes per cycle>:<link latency>\n",
+           config->gpgpu_multi_gpu);
+    exit(1);
+  }
+  if (n_clusters % m_gpus || config->m_n_mem % m_gpus) {
+    printf("GPGPU-Sim: -gpgpu_multi_gpu splits %u clusters and %u memory "
+           "partitions evenly among %u GPUs\n",
+           n_clusters, config->m_n_mem, m_gpus);
+    exit(1);
+  }
+  if (config->m_shader_config->gpgpu_concurrent_mig) {
+    printf("GPGPU-Sim: -gpgpu_multi_gpu does not go with MIG\n");
+    exit(1);
+  }
+  m_policy = strcmp(policy, "sfr") == 0 ? SPLIT_FRAME : ALTERNATE_FRAME;
+  m_clusters_per_gpu = n_clusters / m_gpus;
+  m_subs_per_gpu = n_sub_partitions / m_gpus;
+  m_line_size = config->m_L2_config.get_line_sz();
+  config->m_address_mapping.set_gpus(m_gpus, m_clusters_per_gpu);
+  m_link_free.assign(m_gpus * m_gpus, 0);
+  m_link_bytes.assign(m_gpus * m_gpus, 0);
+  m_ctas.assign(m_gpus, 0);
+}
+
+void multi_gpu::add_tiles(unsigned columns,
+                          const std::vector<unsigned> &tiles) {
+  m_tile_columns = columns;
+  m_tiles = tiles;
+  m_has_tiles = true;
+}
+
+void multi_gpu::bind(unsigned uid, bool fragment) {
+  if (!m_enabled) return;
+  kernel_gpus &k = m_kernels[uid];
+  k.fragment = fragment;
+  k.gpu = m_frame % m_gpus;
+  if (fragment && m_has_tiles && m_tile_columns) {
+    // a band of the tile rows the kernel covers per GPU
+    unsigned rows = 0;
+    for (unsigned t : m_tiles) rows = std::max(rows, t / m_tile_columns + 1);
+    k.cta_gpu.resize(m_tiles.size());
+    for (unsigned c = 0; c < m_tiles.size(); c++)
+      k.cta_gpu[c] = m_tiles[c] / m_tile_columns * m_gpus / rows;
+  }
+  if (fragment) {
+    m_has_tiles = false;
+    m_tiles.clear();
+  }
+}
+
+bool multi_gpu::may_issue(const kernel_info_t &k, unsigned cluster) const {
+  if (!m_enabled || !k.is_graphic_kernel) return true;
+  std::unordered_map<unsigned, kernel_gpus>::const_iterator g =
+      m_kernels.find(k.get_uid());
+  if (g == m_kernels.end()) return true;
+  unsigned gpu = gpu_of_cluster(cluster);
+  if (m_policy == ALTERNATE_FRAME) return gpu == g->second.gpu;
+  if (!g->second.fragment) return true;
+  unsigned cta = k.get_next_cta_id_single();
+  if (cta < g->second.cta_gpu.size()) return gpu == g->second.cta_gpu[cta];
+  return gpu == (unsigned long long)cta * m_gpus / k.num_blocks();
+}
+
+void multi_gpu::line_written(new_addr_type addr, unsigned sub) {
+  m_owner[addr - addr % m_line_size] = gpu_of_sub_partition(sub);
+}
+
+bool multi_gpu::from_peer(new_addr_type addr, unsigned sub) const {
+  std::unordered_map<new_addr_type, unsigned char>::const_iterator o =
+      m_owner.find(addr - addr % m_line_size);
+  return o != m_owner.end() && o->second != gpu_of_sub_partition(sub);
+}
+
+bool multi_gpu::peer_read(new_addr_type addr, unsigned sub, unsigned size,
+                          unsigned long long cycle,
+                          unsigned long long &ready) {
+  if (!from_peer(addr, sub)) return false;
+  unsigned gpu = gpu_of_sub_partition(sub);
+  unsigned owner = m_owner.find(addr - addr % m_line_size)->second;
+  unsigned long long at_owner =
+      send(gpu, owner, PEER_REQUEST_BYTES, cycle) + m_latency;
+  ready = send(owner, gpu, size, at_owner) + m_latency;
+  m_peer_reads++;
+  m_peer_cycles += ready - cycle;
+  return true;
+}
+
+unsigned long long multi_gpu::send(unsigned from, unsigned to, unsigned bytes,
+                                   unsigned long long cycle) {
+  unsigned long long &free = m_link_free[from * m_gpus + to];
+  free = std::max(free, cycle) + (bytes + m_bandwidth - 1) / m_bandwidth;
+  m_link_bytes[from * m_gpus + to] += bytes;
+  return free;
+}
+
+void multi_gpu::print(FILE *fp) const {
+  for (unsigned g = 0; g < m_gpus; g++)
+    fprintf(fp, "gpu_multi_gpu_%u_ctas = %llu\n", g, m_ctas[g]);
+  for (unsigned from = 0; from < m_gpus; from++)
+    for (unsigned to = 0; to < m_gpus; to++)
+      if (from != to)
+        fprintf(fp, "gpu_multi_gpu_link_%u_to_%u = %llu bytes\n", from, to,
+                m_link_bytes[from * m_gpus + to]);
+  fprintf(fp, "gpu_multi_gpu_peer_reads = %llu, avg_latency = %.2f\n",
+          m_peer_reads,
+          m_peer_reads ? (double)m_peer_cycles / m_peer_reads : 0.0);
+}
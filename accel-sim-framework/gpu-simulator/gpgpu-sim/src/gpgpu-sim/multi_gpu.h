@@ -0,0 +1,117 @@
+// Several GPUs joined by an inter-GPU link, -gpgpu_multi_gpu
+//
+// With -gpgpu_multi_gpu <gpus>:<sfr or afr>:<link bytes per cycle>:<link
+// latency> (none by default) the config describes the GPUs together: their
+// SM clusters and memory partitions are split evenly among them, in order.
+// Every GPU keeps a copy of the memory in its own partitions, the accesses
+// of its SMs fold into its share of them the way the MIG tenants' accesses
+// do, so its L2 and DRAM only serve its own SMs. A line an SM writes belongs
+// to the GPU of that SM from then on. An L2 miss on a line another GPU wrote
+// last reads it over the link from that GPU's memory instead of its own
+// DRAM: the request crosses the link to the owner, the line crosses it back,
+// each direction between two GPUs sends its bytes one after the other at
+// the bytes per cycle of the link, and each crossing takes the link latency.
+// The owner's L2 and DRAM are not charged for the peer reads, and L2 copies
+// of a line another GPU wrote since are served as they are, as between GPUs
+// without coherent L2s.
+//
+// The policy places the graphics CTAs. Split frame (sfr) cuts the screen
+// into one band of tile rows per GPU and issues every fragment CTA on the
+// GPU of the tile its FragmentTiles entry names, or without the command on
+// the GPU of its share of the CTAs in order, the fragments come in tile
+// order. Alternate frame (afr) issues the graphics kernels of frame f on GPU
+// f % gpus. The vertex CTAs under sfr and the compute CTAs under both issue
+// on any GPU. A concurrent split has to leave each GPU graphics SMs, a CTA
+// waits for its own GPU. All the GPUs step in the cycle loop of the one
+// gpgpu_sim, so they run in lockstep at every cycle.
+
+#ifndef MULTI_GPU_H
+#define MULTI_GPU_H
+
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+
+class memory_config;
+
+class multi_gpu {
+ public:
+  multi_gpu();
+
+  void configure(const memory_config *config, unsigned n_clusters,
+                 unsigned n_sub_partitions);
+  bool enabled() const { return m_enabled; }
+
+  unsigned gpu_of_cluster(unsigned cluster) const {
+    return cluster / m_clusters_per_gpu;
+  }
+  unsigned gpu_of_sub_partition(unsigned sub) const {
+    return sub / m_subs_per_gpu;
+  }
+
+  // the FragmentTiles command of the next fragment kernel, see tile_binning
+  void add_tiles(unsigned columns, const std::vector<unsigned> &tiles);
+  // graphics kernel uid was read, a fragment kernel takes the tiles added
+  // since
+  void bind(unsigned uid, bool fragment);
+  void frame_finished() { m_frame++; }
+
+  // whether the next CTA of k may issue on cluster
+  bool may_issue(const kernel_info_t &k, unsigned cluster) const;
+  void cta_issued(unsigned cluster) { m_ctas[gpu_of_cluster(cluster)]++; }
+  void kernel_done(const kernel_info_t &k) { m_kernels.erase(k.get_uid()); }
+
+  // an SM wrote the line of addr through sub partition sub
+  void line_written(new_addr_type addr, unsigned sub);
+  // whether the L2 miss on addr of sub partition sub reads the line from
+  // another GPU
+  bool from_peer(new_addr_type addr, unsigned sub) const;
+  // as from_peer, and sends the read over the link, then the cycle the line
+  // arrives. The links are shared by all partitions, while they cycle in
+  // parallel they check from_peer and send in partition order afterwards.
+  bool peer_read(new_addr_type addr, unsigned sub, unsigned size,
+                 unsigned long long cycle, unsigned long long &ready);
+
+  void print(FILE *fp) const;
+
+ private:
+  enum policy { SPLIT_FRAME, ALTERNATE_FRAME };
+  struct kernel_gpus {
+    bool fragment;
+    unsigned gpu;  // afr
+    // sfr: the GPU of each CTA, empty without a FragmentTiles command
+    std::vector<unsigned char> cta_gpu;
+  };
+
+  // the cycle bytes from GPU from to GPU to are all sent
+  unsigned long long send(unsigned from, unsigned to, unsigned bytes,
+                          unsigned long long cycle);
+
+  bool m_enabled;
+  unsigned m_gpus;
+  policy m_policy;
+  unsigned m_bandwidth;  // bytes per cycle and direction
+  unsigned m_latency;
+  unsigned m_clusters_per_gpu;
+  unsigned m_subs_per_gpu;
+  unsigned m_line_size;
+  unsigned m_frame;
+
+  bool m_has_tiles;
+  unsigned m_tile_columns;
+  std::vector<unsigned> m_tiles;
+  std::unordered_map<unsigned, kernel_gpus> m_kernels;  // by kernel uid
+  // by line, the GPU that wrote it last
+  std::unordered_map<new_addr_type, unsigned char> m_owner;
+  // by from * gpus + to
+  std::vector<unsigned long long> m_link_free;
+  std::vector<unsigned long long> m_link_bytes;
+
+  std::vector<unsigned long long> m_ctas;  // by GPU
+  unsigned long long m_peer_reads;
+  unsigned long long m_peer_cycles;
+};
+
+#endif
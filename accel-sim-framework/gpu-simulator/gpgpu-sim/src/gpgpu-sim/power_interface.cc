@@ -38,12 +38,14 @@ void init_mcpat(const gpgpu_sim_config &config,
       config.g_power_config_name, config.g_power_filename,
       config.g_power_trace_filename, config.g_metric_trace_filename,
       config.g_steady_state_tracking_filename,
-      config.g_power_simulation_enabled, config.g_power_trace_enabled,
+      config.g_power_simulation_enabled,
+      config.g_power_trace_enabled && !config.g_power_trace_binary,
       config.g_steady_power_levels_enabled, config.g_power_per_cycle_dump,
       config.gpu_steady_power_deviation, config.gpu_steady_min_period,
       config.g_power_trace_zlevel, tot_inst + inst, stat_sample_freq,
       config.g_power_simulation_mode, config.g_dvfs_enabled,
       config.get_core_freq() / 1000000, config.num_shader());
+  wrapper->set_fast_power(config.g_fast_power_interval);
 }
 
 void mcpat_cycle(const gpgpu_sim_config &config,
@@ -51,7 +53,9 @@ void mcpat_cycle(const gpgpu_sim_config &config,
                  class gpgpu_sim_wrapper *wrapper,
                  class power_stat_t *power_stats, unsigned stat_sample_freq,
                  unsigned tot_cycle, unsigned cycle, unsigned tot_inst,
-                 unsigned inst, bool dvfs_enabled, unsigned kernel_id) {
+                 unsigned inst, bool dvfs_enabled, unsigned kernel_id,
+                 class class_energy *energy, class power_trace_stream *trace,
+                 double dvfs_voltage, sm_power_gating *gating) {
   static bool mcpat_init = true;
 
   if (mcpat_init) {  // If first cycle, don't have any power numbers yet
@@ -61,8 +65,9 @@ void mcpat_cycle(const gpgpu_sim_config &config,
 
   if ((tot_cycle + cycle) % stat_sample_freq == 0) {
     if (dvfs_enabled) {
-      wrapper->set_model_voltage(1);  // performance model needs to support
-                                      // this.
+      // the mean frequency of the clusters relative to the core clock, the
+      // voltage taken to scale with it
+      wrapper->set_model_voltage(dvfs_voltage);
     }
 
     wrapper->set_inst_power(
@@ -103,6 +108,14 @@ void mcpat_cycle(const gpgpu_sim_config &config,
     float active_sms = (*power_stats->m_active_sms) / stat_sample_freq;
     float num_cores = shdr_config->num_shader();
     float num_idle_core = num_cores - active_sms;
+    if (gating) {
+      // gated SMs draw no idle core power
+      double gated, wake_energy;
+      gating->sample(tot_cycle + cycle, gated, wake_energy);
+      if (gated > num_idle_core) gated = num_idle_core;
+      num_idle_core -= gated;
+      wrapper->set_power_gating(gated, wake_energy);
+    }
     wrapper->set_num_cores(num_cores);
     wrapper->set_idle_core_power(num_idle_core);
 
@@ -174,7 +187,12 @@ void mcpat_cycle(const gpgpu_sim_config &config,
     wrapper->compute();
 
     wrapper->update_components_power();
-    wrapper->print_trace_files();
+    if (energy)
+      energy->sample(wrapper, stat_sample_freq / (double)config.get_core_freq());
+    if (trace)
+      trace->sample(wrapper, (unsigned long long)tot_cycle + cycle);
+    else
+      wrapper->print_trace_files();
     power_stats->save_stats();
 
     wrapper->detect_print_steady_state(0, tot_inst + inst);
@@ -186,6 +204,144 @@ void mcpat_cycle(const gpgpu_sim_config &config,
   // wrapper->close_files();
 }
 
+power_trace_stream::power_trace_stream(const gpgpu_sim_wrapper *wrapper,
+                                       const char *path,
+                                       unsigned stat_sample_freq,
+                                       unsigned window, int zlevel) {
+  m_window = window;
+  m_samples = 0;
+  m_last = 0;
+  m_n_cmps = wrapper->get_sample_cmp_pwr().size();
+  unsigned n_counters = wrapper->get_sample_perf_counters().size();
+  m_sum.assign(1 + m_n_cmps + n_counters, 0);
+  m_mean.assign(m_sum.size(), 0);
+  m_max = 0;
+  m_min = 0;
+  m_sampler.add_gauge("power", [this] { return m_mean[0]; });
+  for (unsigned i = 0; i < m_n_cmps; i++)
+    m_sampler.add_gauge(
+        ("power_" + gpgpu_sim_wrapper::get_pwr_cmp_name(i)).c_str(),
+        [this, i] { return m_mean[1 + i]; });
+  for (unsigned i = 0; i < n_counters; i++)
+    m_sampler.add_gauge(
+        ("metric_" + gpgpu_sim_wrapper::get_perf_counter_name(i)).c_str(),
+        [this, i] { return m_mean[1 + m_n_cmps + i]; });
+  if (m_window > 1) {
+    m_sampler.add_gauge("power_max", [this] { return m_max; });
+    m_sampler.add_gauge("power_min", [this] { return m_min; });
+  }
+  if (!m_sampler.open(path, (unsigned long long)stat_sample_freq * m_window,
+                      4096, 4, zlevel)) {
+    fprintf(stderr, "GPGPU-Sim: cannot write the power trace %s\n", path);
+    exit(1);
+  }
+}
+
+void power_trace_stream::sample(const gpgpu_sim_wrapper *wrapper,
+                                unsigned long long now) {
+  double power = wrapper->get_sample_power();
+  const std::vector<double> &cmps = wrapper->get_sample_cmp_pwr();
+  const std::vector<double> &counters = wrapper->get_sample_perf_counters();
+  m_sum[0] += power;
+  for (unsigned i = 0; i < cmps.size(); i++) m_sum[1 + i] += cmps[i];
+  for (unsigned i = 0; i < counters.size(); i++)
+    m_sum[1 + m_n_cmps + i] += counters[i];
+  if (!m_samples || power > m_max) m_max = power;
+  if (!m_samples || power < m_min) m_min = power;
+  m_last = now;
+  if (++m_samples == m_window) flush(now);
+}
+
+void power_trace_stream::flush(unsigned long long now) {
+  for (unsigned i = 0; i < m_sum.size(); i++) {
+    m_mean[i] = m_sum[i] / m_samples;
+    m_sum[i] = 0;
+  }
+  m_sampler.record(now);
+  m_samples = 0;
+}
+
+void power_trace_stream::close() {
+  if (m_samples) flush(m_last);
+  m_sampler.close();
+}
+
+class_energy::class_energy(std::function<void(class_activity[2])> activity)
+    : m_activity(activity) {
+  // the counters all start at zero, and the cores are not built yet
+  memset(m_last, 0, sizeof(m_last));
+  m_energy[0] = m_energy[1] = 0;
+  m_shared_energy = 0;
+  m_frame_start = 0;
+  m_frames = 0;
+  m_frame_max = 0;
+  m_compute_kernels = 0;
+  m_compute_kernel_energy = 0;
+}
+
+void class_energy::sample(const gpgpu_sim_wrapper *wrapper, double seconds) {
+  double power[gpgpu_sim_wrapper::NUM_POWER_DOMAINS];
+  wrapper->get_domain_power(power);
+  class_activity now[2];
+  m_activity(now);
+  for (unsigned d = 0; d < gpgpu_sim_wrapper::NUM_POWER_DOMAINS; d++) {
+    double energy = power[d] * seconds;
+    unsigned long long delta[2];
+    for (unsigned c = 0; c < 2; c++)
+      delta[c] = now[c].domain[d] - m_last[c].domain[d];
+    if (d == gpgpu_sim_wrapper::SHARED_DOMAIN || !(delta[0] + delta[1])) {
+      m_shared_energy += energy;
+      continue;
+    }
+    for (unsigned c = 0; c < 2; c++)
+      m_energy[c] += energy * delta[c] / (delta[0] + delta[1]);
+  }
+  m_last[0] = now[0];
+  m_last[1] = now[1];
+}
+
+void class_energy::kernel_started(unsigned uid, bool graphics) {
+  m_kernel_start[uid] = std::make_pair(graphics, m_energy[graphics]);
+}
+
+double class_energy::kernel_done(unsigned uid) {
+  std::unordered_map<unsigned, std::pair<bool, double> >::iterator k =
+      m_kernel_start.find(uid);
+  if (k == m_kernel_start.end()) return 0;
+  bool graphics = k->second.first;
+  double energy = m_energy[graphics] - k->second.second;
+  m_kernel_start.erase(k);
+  if (!graphics) {
+    m_compute_kernels++;
+    m_compute_kernel_energy += energy;
+  }
+  return energy;
+}
+
+void class_energy::frame_finished() {
+  double energy = m_energy[1] - m_frame_start;
+  m_frame_start = m_energy[1];
+  m_frames++;
+  m_frame_max = std::max(m_frame_max, energy);
+}
+
+void class_energy::print(FILE *fp) const {
+  const char *cls[2] = {"compute", "graphics"};
+  for (unsigned c = 0; c < 2; c++)
+    fprintf(fp, "gpu_power_%s_dynamic_energy = %.6e J\n", cls[c],
+            m_energy[c]);
+  fprintf(fp, "gpu_power_shared_energy = %.6e J\n", m_shared_energy);
+  if (m_frames) {
+    fprintf(fp, "gpu_power_graphics_energy_per_frame = %.6e J\n",
+            m_frame_start / m_frames);
+    fprintf(fp, "gpu_power_graphics_energy_max_frame = %.6e J\n",
+            m_frame_max);
+  }
+  if (m_compute_kernels)
+    fprintf(fp, "gpu_power_compute_energy_per_kernel = %.6e J\n",
+            m_compute_kernel_energy / m_compute_kernels);
+}
+
 void mcpat_reset_perf_count(class gpgpu_sim_wrapper *wrapper) {
   wrapper->reset_counters();
 }
@@ -35,8 +35,47 @@
 #include "power_stat.h"
 #include "shader.h"
 
+#include <functional>
+#include <unordered_map>
+#include "counter_sampler.h"
 #include "gpgpu_sim_wrapper.h"
 
+// activity of one class, graphics or compute, in each power domain
+struct class_activity {
+  unsigned long long domain[gpgpu_sim_wrapper::NUM_POWER_DOMAINS];
+};
+
+// Energy of the graphics and compute classes of a concurrent run
+//
+// Every power sample splits the dynamic power of each domain by the share
+// of the domain's activity each class had over the sample: thread
+// instructions in the cores, L2 accesses, DRAM requests (counted by the
+// FR-FCFS scheduler only) and interconnect bytes. The shared domain, and a
+// domain neither class touched, is left unattributed.
+class class_energy {
+ public:
+  // activity fills the running totals of both classes, by is_graphics
+  class_energy(std::function<void(class_activity[2])> activity);
+  void sample(const gpgpu_sim_wrapper *wrapper, double seconds);
+  void kernel_started(unsigned uid, bool graphics);
+  // J of dynamic energy its class spent while the kernel ran
+  double kernel_done(unsigned uid);
+  void frame_finished();
+  void print(FILE *fp) const;
+
+ private:
+  std::function<void(class_activity[2])> m_activity;
+  class_activity m_last[2];
+  double m_energy[2];  // J, by is_graphics
+  double m_shared_energy;
+  std::unordered_map<unsigned, std::pair<bool, double> > m_kernel_start;
+  double m_frame_start;
+  unsigned m_frames;
+  double m_frame_max;
+  unsigned m_compute_kernels;
+  double m_compute_kernel_energy;
+};
+
 void init_mcpat(const gpgpu_sim_config &config,
                 class gpgpu_sim_wrapper *wrapper, unsigned stat_sample_freq,
                 unsigned tot_inst, unsigned inst);
@@ -45,7 +84,42 @@ void mcpat_cycle(const gpgpu_sim_config &config,
                  class gpgpu_sim_wrapper *wrapper,
                  class power_stat_t *power_stats, unsigned stat_sample_freq,
                  unsigned tot_cycle, unsigned cycle, unsigned tot_inst,
-                 unsigned inst, bool dvfs_enabled, unsigned kernel_id);
+                 unsigned inst, bool dvfs_enabled, unsigned kernel_id,
+                 class class_energy *energy = NULL,
+                 class power_trace_stream *trace = NULL,
+                 double dvfs_voltage = 1,
+                 class sm_power_gating *gating = NULL);
+
+// Binary power trace, -power_trace_binary
+//
+// Replaces the text power and metric traces with one counter_sampler time
+// series of gauges: the total power, each component's power and each
+// performance counter of the samples. With -power_trace_window N a row holds
+// the means of N samples and their maximum and minimum total power, so a
+// long run keeps one row per window at a fixed record size.
+class power_trace_stream {
+ public:
+  // exits when path cannot be written
+  power_trace_stream(const gpgpu_sim_wrapper *wrapper, const char *path,
+                     unsigned stat_sample_freq, unsigned window, int zlevel);
+  void sample(const gpgpu_sim_wrapper *wrapper, unsigned long long now);
+  // writes the part of a window sampled so far and closes the file
+  void close();
+
+ private:
+  void flush(unsigned long long now);
+
+  counter_sampler m_sampler;
+  unsigned m_window;
+  unsigned m_samples;
+  unsigned m_n_cmps;
+  unsigned long long m_last;
+  // the total power, then the components, then the counters
+  std::vector<double> m_sum;
+  std::vector<double> m_mean;
+  double m_max;
+  double m_min;
+};
 
 void calculate_hw_mcpat(const gpgpu_sim_config &config,
                  const shader_core_config *shdr_config,
@@ -0,0 +1,74 @@
+// Handoff from the vertex to the fragment kernels of a draw
+// see raster_pipeline.h
+
+#include "raster_pipeline.h"
+
+raster_pipeline::raster_pipeline() {
+  m_latency = 0;
+  m_fragment_ctas = 0;
+  m_overlapped_ctas = 0;
+}
+
+void raster_pipeline::add_draw(unsigned vertex_uid, unsigned vertex_ctas,
+                               unsigned frag_uid, unsigned frag_ctas) {
+  draw &d = m_draws[vertex_uid];
+  if (!d.fragments && d.retired.empty()) {
+    d.vertex_ctas = vertex_ctas;
+    d.vertex_done = false;
+  }
+  d.fragments++;
+  fragment &f = m_fragments[frag_uid];
+  f.vertex_uid = vertex_uid;
+  f.ctas = frag_ctas;
+}
+
+void raster_pipeline::cta_retired(unsigned uid, unsigned long long cycle) {
+  std::unordered_map<unsigned, draw>::iterator d = m_draws.find(uid);
+  if (d != m_draws.end() && d->second.retired.size() < d->second.vertex_ctas)
+    d->second.retired.push_back(cycle);
+}
+
+void raster_pipeline::kernel_done(unsigned uid, unsigned long long cycle) {
+  std::unordered_map<unsigned, draw>::iterator d = m_draws.find(uid);
+  if (d != m_draws.end()) {
+    // CTAs warmed up functionally never retire
+    d->second.retired.resize(d->second.vertex_ctas, cycle);
+    d->second.vertex_done = true;
+    if (!d->second.fragments) m_draws.erase(d);
+  }
+  std::unordered_map<unsigned, fragment>::iterator f = m_fragments.find(uid);
+  if (f == m_fragments.end()) return;
+  d = m_draws.find(f->second.vertex_uid);
+  if (d != m_draws.end() && --d->second.fragments == 0 &&
+      d->second.vertex_done)
+    m_draws.erase(d);
+  m_fragments.erase(f);
+}
+
+bool raster_pipeline::cta_ready(unsigned uid, unsigned ctaid,
+                                unsigned long long cycle) const {
+  std::unordered_map<unsigned, fragment>::const_iterator f =
+      m_fragments.find(uid);
+  if (f == m_fragments.end()) return true;
+  std::unordered_map<unsigned, draw>::const_iterator d =
+      m_draws.find(f->second.vertex_uid);
+  if (d == m_draws.end() || !d->second.vertex_ctas) return true;
+  // vertex CTAs that cover the tile, rounded up
+  unsigned long long needed =
+      ((unsigned long long)(ctaid + 1) * d->second.vertex_ctas +
+       f->second.ctas - 1) /
+      f->second.ctas;
+  if (needed > d->second.vertex_ctas) needed = d->second.vertex_ctas;
+  return d->second.retired.size() >= needed &&
+         d->second.retired[needed - 1] + m_latency <= cycle;
+}
+
+void raster_pipeline::cta_issued(unsigned uid) {
+  std::unordered_map<unsigned, fragment>::const_iterator f =
+      m_fragments.find(uid);
+  if (f == m_fragments.end()) return;
+  m_fragment_ctas++;
+  std::unordered_map<unsigned, draw>::const_iterator d =
+      m_draws.find(f->second.vertex_uid);
+  if (d != m_draws.end() && !d->second.vertex_done) m_overlapped_ctas++;
+}
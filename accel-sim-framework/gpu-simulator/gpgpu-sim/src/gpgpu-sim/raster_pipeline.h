@@ -0,0 +1,69 @@
+// Handoff from the vertex to the fragment kernels of a draw
+//
+// Without -gpgpu_graphics_pipeline a fragment kernel waits on the stream of
+// its vertex kernel until every vertex CTA is done. With it the driver
+// launches the fragment kernel right away and the CTAs of the two overlap
+// the way the primitive distributor, setup and raster units pass work along
+// in hardware. The fragment CTAs come one per screen tile in tile order, and
+// the vertex CTAs in primitive order; the traces do not record which
+// primitives cover which tile, so tile i of F is taken to be covered once
+// the first (i + 1) / F of the V vertex CTAs have retired. The fragment CTA
+// may issue -gpgpu_raster_latency cycles after the last of those, the time
+// setup and rasterization take for the batch.
+
+#ifndef RASTER_PIPELINE_H
+#define RASTER_PIPELINE_H
+
+#include <unordered_map>
+#include <vector>
+
+class raster_pipeline {
+ public:
+  raster_pipeline();
+
+  void set_latency(unsigned latency) { m_latency = latency; }
+  bool empty() const { return m_fragments.empty(); }
+
+  // fragment kernel frag_uid, of frag_ctas CTAs, rasterizes the primitives of
+  // vertex kernel vertex_uid, of vertex_ctas CTAs. Added before either
+  // launches
+  void add_draw(unsigned vertex_uid, unsigned vertex_ctas, unsigned frag_uid,
+                unsigned frag_ctas);
+  // a CTA of graphics kernel uid retired at cycle
+  void cta_retired(unsigned uid, unsigned long long cycle);
+  // graphics kernel uid finished or was warmed up without the timing model.
+  // The vertex CTAs that never retired count as done at cycle
+  void kernel_done(unsigned uid, unsigned long long cycle);
+
+  // whether CTA ctaid of kernel uid can issue at cycle, true for kernels
+  // that are not the fragments of a draw
+  bool cta_ready(unsigned uid, unsigned ctaid,
+                 unsigned long long cycle) const;
+  // CTA of kernel uid issued, counts the fragment CTAs that ran alongside
+  // their vertex kernel
+  void cta_issued(unsigned uid);
+
+  // totals since the start
+  unsigned long long m_fragment_ctas;    // fragment CTAs of pipelined draws
+  unsigned long long m_overlapped_ctas;  // of them issued before the vertex
+                                         // kernel finished
+
+ private:
+  struct draw {
+    unsigned vertex_ctas;
+    // retirement cycle of the vertex CTAs so far, ascending
+    std::vector<unsigned long long> retired;
+    unsigned fragments;  // fragment kernels not finished
+    bool vertex_done;
+  };
+  struct fragment {
+    unsigned vertex_uid;
+    unsigned ctas;
+  };
+
+  unsigned m_latency;
+  std::unordered_map<unsigned, draw> m_draws;  // by vertex kernel uid
+  std::unordered_map<unsigned, fragment> m_fragments;
+};
+
+#endif
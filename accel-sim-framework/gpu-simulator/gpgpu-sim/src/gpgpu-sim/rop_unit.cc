@@ -0,0 +1,142 @@
+// Raster output unit of a memory sub partition, see rop_unit.h
+
+#include "rop_unit.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <set>
+
+#include "gpu-sim.h"
+#include "l2cache.h"
+#include "mem_fetch.h"
+
+rop_unit::rop_unit(const memory_config *config,
+                   partition_mf_allocator *allocator)
+    : m_config(config), m_allocator(allocator) {
+  m_writes = 0;
+  m_tiles_closed = 0;
+  m_color_blocks = 0;
+  m_color_to_l2 = 0;
+  m_depth_to_l2 = 0;
+
+  unsigned long long base, size;
+  if (sscanf(config->rop_fb, "%llx:%llx", &base, &size) != 2 || !size) {
+    printf("GPGPU-Sim: -gpgpu_rop_fb \'%s\' is not base:size\n",
+           config->rop_fb);
+    exit(1);
+  }
+  m_fb_base = base;
+  m_fb_size = size;
+  if (sscanf(config->rop_compression, "%f:%f", &m_color_ratio,
+             &m_depth_ratio) != 2 ||
+      m_color_ratio < 1 || m_depth_ratio < 1) {
+    printf("GPGPU-Sim: -gpgpu_rop_compression \'%s\' is not color:depth, "
+           "both at least 1\n",
+           config->rop_compression);
+    exit(1);
+  }
+  if (!config->rop_tiles || !config->rop_tile_size ||
+      config->rop_tile_size % SECTOR_SIZE) {
+    printf("GPGPU-Sim: -gpgpu_rop_tiles has to be at least 1 and "
+           "-gpgpu_rop_tile_size a multiple of %u\n",
+           SECTOR_SIZE);
+    exit(1);
+  }
+}
+
+bool rop_unit::accepts(const mem_fetch *mf) const {
+  return mf->get_is_write() && mf->is_graphics() &&
+         mf->get_access_type() == GLOBAL_ACC_W && mf->get_addr() >= m_fb_base &&
+         mf->get_addr() < m_fb_base + m_fb_size;
+}
+
+void rop_unit::push(mem_fetch *mf, unsigned long long cycle) {
+  m_writes++;
+  new_addr_type addr = mf->get_addr() / m_config->rop_tile_size *
+                       m_config->rop_tile_size;
+  for (tile &t : m_tiles) {
+    if (t.addr == addr) {
+      t.reqs.push_back(mf);
+      return;
+    }
+  }
+  if (m_tiles.size() == m_config->rop_tiles) close_front(cycle);
+  tile t;
+  t.addr = addr;
+  t.open_cycle = cycle;
+  t.reqs.push_back(mf);
+  m_tiles.push_back(t);
+}
+
+void rop_unit::cycle(unsigned long long cycle) {
+  while (!m_tiles.empty() &&
+         m_tiles.front().open_cycle + m_config->rop_tile_window <= cycle)
+    close_front(cycle);
+}
+
+void rop_unit::close_front(unsigned long long cycle) {
+  tile &t = m_tiles.front();
+  unsigned long long ready = cycle + m_config->rop_blend_latency;
+  m_tiles_closed++;
+
+  std::set<new_addr_type> blocks;
+  for (mem_fetch *mf : t.reqs) blocks.insert(mf->get_addr());
+  unsigned compressed = ceil(blocks.size() / m_color_ratio);
+  m_color_blocks += blocks.size();
+
+  // the first request of a block carries it to the L2 while the compressed
+  // tile still has room, every other one is acknowledged here
+  std::set<new_addr_type> sent;
+  for (mem_fetch *mf : t.reqs) {
+    ready_req r;
+    r.cycle = ready;
+    r.mf = mf;
+    if (sent.size() < compressed && sent.insert(mf->get_addr()).second) {
+      m_to_l2.push_back(r);
+      m_color_to_l2++;
+    } else {
+      m_acks.push_back(r);
+    }
+  }
+
+  if (m_config->rop_depth_ratio > 0) {
+    // the depth of the tile's blocks, as sectors of the depth surface
+    unsigned bytes = ceil(blocks.size() * SECTOR_SIZE *
+                          m_config->rop_depth_ratio / m_depth_ratio);
+    unsigned sectors = (bytes + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    new_addr_type depth =
+        m_fb_base + m_fb_size +
+        (new_addr_type)((t.addr - m_fb_base) * m_config->rop_depth_ratio) /
+            SECTOR_SIZE * SECTOR_SIZE;
+    const mem_fetch *first = t.reqs.front();
+    for (unsigned s = 0; s < sectors; s++) {
+      new_addr_type addr = depth + s * SECTOR_SIZE;
+      unsigned sector = addr % (SECTOR_SIZE * SECTOR_CHUNCK_SIZE) / SECTOR_SIZE;
+      mem_access_byte_mask_t byte_mask;
+      for (unsigned b = sector * SECTOR_SIZE; b < (sector + 1) * SECTOR_SIZE;
+           b++)
+        byte_mask.set(b);
+      ready_req r;
+      r.cycle = ready;
+      r.mf = m_allocator->alloc(
+          addr, L1_WRBK_ACC, first->get_access_warp_mask(), byte_mask,
+          mem_access_sector_mask_t().set(sector), SECTOR_SIZE, true, cycle,
+          first->get_kernel_uid(), first->get_wid(), first->get_sid(),
+          first->get_tpc(), NULL);
+      m_to_l2.push_back(r);
+      m_depth_to_l2++;
+    }
+  }
+  m_tiles.pop_front();
+}
+
+mem_fetch *rop_unit::l2_top(unsigned long long cycle) const {
+  if (m_to_l2.empty() || m_to_l2.front().cycle > cycle) return NULL;
+  return m_to_l2.front().mf;
+}
+
+mem_fetch *rop_unit::ack_top(unsigned long long cycle) const {
+  if (m_acks.empty() || m_acks.front().cycle > cycle) return NULL;
+  return m_acks.front().mf;
+}
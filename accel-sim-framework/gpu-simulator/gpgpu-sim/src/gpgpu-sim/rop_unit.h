@@ -0,0 +1,83 @@
+// Raster output unit of a memory sub partition for the framebuffer writes
+// of fragment shaders
+//
+// Without -gpgpu_rop_model every request only waits -gpgpu_l2_rop_latency
+// in the ROP queue. With it the graphics stores into the framebuffer range
+// (-gpgpu_rop_fb base:size) leave that queue for a rop_unit, which gathers
+// them per tile of -gpgpu_rop_tile_size bytes. A tile stays open for
+// -gpgpu_rop_tile_window cycles or until -gpgpu_rop_tiles newer tiles
+// pushed it out, then spends -gpgpu_rop_blend_latency cycles blending and
+// depth testing. Its distinct blocks shrink by the color ratio of
+// -gpgpu_rop_compression color:depth; that many of its requests go on to
+// the L2 and the others, overdraw of the same block included, are
+// acknowledged by the ROP itself. With -gpgpu_rop_depth_ratio, the bytes
+// of depth per byte of color, a tile also writes its depth through the L2,
+// shrunk by the depth ratio, to a depth surface right after the
+// framebuffer range. Depth reads are taken to hit the ROP's own z cache.
+
+#ifndef ROP_UNIT_H
+#define ROP_UNIT_H
+
+#include <deque>
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+
+class mem_fetch;
+class memory_config;
+class partition_mf_allocator;
+
+class rop_unit {
+ public:
+  rop_unit(const memory_config *config, partition_mf_allocator *allocator);
+
+  // whether mf is a framebuffer write the ROP takes
+  bool accepts(const mem_fetch *mf) const;
+  void push(mem_fetch *mf, unsigned long long cycle);
+  // closes the tiles that are due at cycle
+  void cycle(unsigned long long cycle);
+
+  // the next request for the L2, color or depth, NULL when none is ready
+  mem_fetch *l2_top(unsigned long long cycle) const;
+  void l2_pop() { m_to_l2.pop_front(); }
+  // the next write the ROP acknowledges without the L2
+  mem_fetch *ack_top(unsigned long long cycle) const;
+  void ack_pop() { m_acks.pop_front(); }
+
+  bool empty() const {
+    return m_tiles.empty() && m_to_l2.empty() && m_acks.empty();
+  }
+
+  // totals since the start
+  unsigned long long m_writes;         // framebuffer writes taken
+  unsigned long long m_tiles_closed;
+  unsigned long long m_color_blocks;   // distinct blocks of closed tiles
+  unsigned long long m_color_to_l2;    // of them written through the L2
+  unsigned long long m_depth_to_l2;    // depth writes to the L2
+
+ private:
+  struct tile {
+    new_addr_type addr;
+    unsigned long long open_cycle;
+    std::vector<mem_fetch *> reqs;
+  };
+  struct ready_req {
+    unsigned long long cycle;
+    mem_fetch *mf;
+  };
+
+  void close_front(unsigned long long cycle);
+
+  const memory_config *m_config;
+  partition_mf_allocator *m_allocator;
+  new_addr_type m_fb_base;
+  new_addr_type m_fb_size;
+  float m_color_ratio;
+  float m_depth_ratio;
+  // open tiles, oldest first
+  std::deque<tile> m_tiles;
+  std::deque<ready_req> m_to_l2;
+  std::deque<ready_req> m_acks;
+};
+
+#endif
@@ -0,0 +1,101 @@
+// Re-reference interval prediction replacement, see rrip_policy.h
+
+#include "rrip_policy.h"
+
+#include <assert.h>
+
+static const unsigned SHCT_SIZE = 1 << 14;
+static const unsigned char SHCT_MAX = 7;
+static const unsigned PSEL_MAX = 1023;
+static const unsigned LEADER_SETS = 32;
+static const unsigned BRRIP_NEAR = 32;  // one BRRIP insertion in 32 at 2
+
+rrip_policy::rrip_policy(enum replacement_policy_t policy, unsigned lines)
+    : m_policy(policy),
+      m_rrpv(lines, RRPV_MAX),
+      m_psel(PSEL_MAX / 2),
+      m_brrip_inserts(0) {
+  assert(is_rrip(policy));
+  if (policy == SHIP_PC || policy == SHIP_CLASS || policy == SHIP_TYPE) {
+    m_signature.resize(lines, 0);
+    m_reused.resize(lines, false);
+    m_shct.resize(SHCT_SIZE, 1);
+  }
+  m_inserts[0] = m_inserts[1] = 0;
+}
+
+unsigned rrip_policy::signature(const mem_fetch *mf, bool is_graphics,
+                                bool is_tex) const {
+  unsigned cls = is_graphics ? (is_tex ? 2 : 1) : 0;
+  if (!mf || m_policy == SHIP_CLASS) return cls;
+  if (m_policy == SHIP_TYPE) return mf->get_access_type() * 3 + cls;
+  unsigned long long pc = mf->get_pc() >> 2;
+  pc ^= pc >> 13;
+  return ((pc << 2) | cls) & (SHCT_SIZE - 1);
+}
+
+void rrip_policy::hit(unsigned idx) {
+  m_rrpv[idx] = 0;
+  if (m_shct.empty()) return;
+  unsigned char &c = m_shct[m_signature[idx]];
+  if (c < SHCT_MAX) c++;
+  m_reused[idx] = true;
+}
+
+rrip_policy::leader_t rrip_policy::leader(unsigned set_index,
+                                          unsigned nset) const {
+  // LEADER_SETS sets of each kind spread over the cache, fewer in caches
+  // of less than 2 x LEADER_SETS sets
+  unsigned stride = nset / LEADER_SETS;
+  if (stride < 2) stride = 2;
+  if (set_index % stride == 0) return SRRIP_LEADER;
+  if (set_index % stride == 1) return BRRIP_LEADER;
+  return FOLLOWER;
+}
+
+unsigned char rrip_policy::insertion(unsigned set_index, unsigned nset,
+                                     unsigned sig) {
+  bool brrip = false;
+  if (m_policy == DRRIP) {
+    // a miss in a leader set counts against its policy
+    leader_t l = leader(set_index, nset);
+    if (l == SRRIP_LEADER && m_psel < PSEL_MAX) m_psel++;
+    if (l == BRRIP_LEADER && m_psel > 0) m_psel--;
+    brrip = l == BRRIP_LEADER || (l == FOLLOWER && m_psel > PSEL_MAX / 2);
+  }
+  if (brrip) return ++m_brrip_inserts % BRRIP_NEAR ? RRPV_MAX : RRPV_MAX - 1;
+  if (!m_shct.empty() && !m_shct[sig]) return RRPV_MAX;
+  return RRPV_MAX - 1;
+}
+
+void rrip_policy::insert(unsigned set_index, unsigned nset, unsigned first,
+                         unsigned assoc, unsigned idx, bool was_valid,
+                         unsigned signature) {
+  if (was_valid) {
+    unsigned char age = RRPV_MAX - m_rrpv[idx];
+    for (unsigned i = first; i < first + assoc && age; i++)
+      m_rrpv[i] = m_rrpv[i] + age < RRPV_MAX ? m_rrpv[i] + age : RRPV_MAX;
+    if (!m_shct.empty() && !m_reused[idx] && m_shct[m_signature[idx]])
+      m_shct[m_signature[idx]]--;
+  }
+  m_rrpv[idx] = insertion(set_index, nset, signature);
+  m_inserts[m_rrpv[idx] == RRPV_MAX]++;
+  if (!m_shct.empty()) {
+    m_signature[idx] = signature;
+    m_reused[idx] = false;
+  }
+}
+
+void rrip_policy::print(FILE *fp) const {
+  fprintf(fp, "\t\tRRIP inserts: near = %llu, distant = %llu", m_inserts[0],
+          m_inserts[1]);
+  if (m_policy == DRRIP)
+    fprintf(fp, ", psel = %u (%s)", m_psel,
+            m_psel > PSEL_MAX / 2 ? "BRRIP" : "SRRIP");
+  if (!m_shct.empty()) {
+    unsigned dead = 0;
+    for (unsigned i = 0; i < m_shct.size(); i++) dead += !m_shct[i];
+    fprintf(fp, ", dead signatures = %u", dead);
+  }
+  fprintf(fp, "\n");
+}
@@ -0,0 +1,75 @@
+// Re-reference interval prediction replacement for tag_array
+//
+// The replacement character of a cache's config string picks the policy of
+// that cache level: 'S' SRRIP, 'D' DRRIP, and SHiP with 'P' PC, 'C' class
+// or 'T' access type signatures, next to 'L' LRU and 'F' FIFO. Every line
+// keeps a 2 bit re-reference prediction value (RRPV), 0 = reused soon and 3
+// = reused far away, in a dense array the way search reads like the rest
+// of tag_array's line summary. The victim is the eligible line with the
+// highest RRPV; the lines of its set then age by what it lacked to 3, which
+// is the same as aging them all until one reaches 3. A hit sets the RRPV to
+// 0. SRRIP inserts lines at 2, so a stream that is never reused goes before
+// the lines that were. DRRIP duels SRRIP against BRRIP (insert at 3, at 2
+// one time in 32) on two groups of leader sets and a 10 bit counter of
+// their misses, the other sets follow the one that misses less (Jaleel et
+// al., ISCA 2010). SHiP inserts at 3 the lines whose signature was evicted
+// without reuse since, by a table of 3 bit counters a reuse increments and
+// an eviction without reuse decrements (Wu et al., MICRO 2011). A PC
+// signature is that of the instruction and its class, so that graphics and
+// compute shaders do not share counters. Texture streams get the class or
+// access type signatures of their own. The eligibility of the ways (way or
+// tenant partitioning) is unchanged, so isolation by policy and by
+// partitioning can be compared on the same config.
+
+#ifndef RRIP_POLICY_H
+#define RRIP_POLICY_H
+
+#include <stdio.h>
+#include <vector>
+
+#include "gpu-cache.h"
+
+class rrip_policy {
+ public:
+  static const unsigned char RRPV_MAX = 3;
+
+  // lines is the number of lines of the cache, nset x assoc of the largest
+  // configuration
+  rrip_policy(enum replacement_policy_t policy, unsigned lines);
+  static bool is_rrip(enum replacement_policy_t policy) {
+    return policy != LRU && policy != FIFO;
+  }
+
+  // indexed like tag_array::m_lines
+  const unsigned char *rrpv() const { return &m_rrpv[0]; }
+  // the SHiP signature of an access, mf may be NULL for the functional
+  // warm-up fills, which then take the class signature
+  unsigned signature(const mem_fetch *mf, bool is_graphics, bool is_tex) const;
+
+  void hit(unsigned idx);
+  // line idx, the victim in the set of nset from first to first + assoc,
+  // takes a new block; was_valid if it held one
+  void insert(unsigned set_index, unsigned nset, unsigned first,
+              unsigned assoc, unsigned idx, bool was_valid,
+              unsigned signature);
+
+  void print(FILE *fp) const;
+
+ private:
+  enum leader_t { FOLLOWER, SRRIP_LEADER, BRRIP_LEADER };
+  leader_t leader(unsigned set_index, unsigned nset) const;
+  unsigned char insertion(unsigned set_index, unsigned nset, unsigned sig);
+
+  enum replacement_policy_t m_policy;
+  std::vector<unsigned char> m_rrpv;
+  // SHiP: the signature that inserted each line and whether it hit since
+  std::vector<unsigned short> m_signature;
+  std::vector<bool> m_reused;
+  std::vector<unsigned char> m_shct;
+  // DRRIP: > half of its range = BRRIP misses less
+  unsigned m_psel;
+  unsigned m_brrip_inserts;
+  unsigned long long m_inserts[2];  // [0] at RRPV 2, [1] at RRPV 3
+};
+
+#endif
@@ -37,6 +37,47 @@
 
 #include "../abstract_hardware_model.h"
 
+// set of register numbers of one warp. Trace registers (R0-R255 plus one)
+// are bits, the larger numbers of PTX mode go to a std::set
+class scoreboard_regs {
+ public:
+  enum { BITS = 512, WORDS = BITS / 64 };
+
+  scoreboard_regs() : m_count(0) {
+    for (unsigned w = 0; w < WORDS; w++) m_bits[w] = 0;
+  }
+
+  bool test(unsigned reg) const {
+    if (reg < BITS) return (m_bits[reg / 64] >> (reg % 64)) & 1;
+    return m_overflow.count(reg);
+  }
+  // returns false if reg was already in the set
+  bool insert(unsigned reg) {
+    if (test(reg)) return false;
+    if (reg < BITS)
+      m_bits[reg / 64] |= 1ULL << (reg % 64);
+    else
+      m_overflow.insert(reg);
+    m_count++;
+    return true;
+  }
+  void erase(unsigned reg) {
+    if (!test(reg)) return;
+    if (reg < BITS)
+      m_bits[reg / 64] &= ~(1ULL << (reg % 64));
+    else
+      m_overflow.erase(reg);
+    m_count--;
+  }
+  bool empty() const { return m_count == 0; }
+  void print() const;
+
+ private:
+  unsigned long long m_bits[WORDS];
+  std::set<unsigned> m_overflow;
+  unsigned m_count;
+};
+
 class Scoreboard {
  public:
   Scoreboard(unsigned sid, unsigned n_warps, class gpgpu_t *gpu);
@@ -58,9 +99,9 @@ class Scoreboard {
 
   // keeps track of pending writes to registers
   // indexed by warp id, reg_id => pending write count
-  std::vector<std::set<unsigned> > reg_table;
+  std::vector<scoreboard_regs> reg_table;
   // Register that depend on a long operation (global, local or tex memory)
-  std::vector<std::set<unsigned> > longopregs;
+  std::vector<scoreboard_regs> longopregs;
 
   class gpgpu_t *m_gpu;
 };
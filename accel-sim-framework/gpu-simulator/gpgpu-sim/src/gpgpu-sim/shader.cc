@@ -152,6 +152,7 @@ void shader_core_ctx::create_front_pipeline() {
   m_not_completed = 0;
   m_active_threads.reset();
   m_n_active_cta = 0;
+  m_running = false;
   for (unsigned i = 0; i < MAX_CTA_PER_SHADER; i++) m_cta_status[i] = 0;
   for (unsigned i = 0; i < m_config->n_thread_per_shader; i++) {
     m_thread[i] = NULL;
@@ -448,12 +449,22 @@ void shader_core_ctx::create_exec_pipeline() {
     m_issue_port.push_back(OC_EX_TENSOR_CORE);
   }
 
+  m_rt_unit = NULL;
   for (unsigned j = 0; j < m_config->m_specialized_unit.size(); j++) {
     for (unsigned k = 0; k < m_config->m_specialized_unit[j].num_units; k++) {
-      m_fu.push_back(new specialized_unit(
-          &m_pipeline_reg[EX_WB], m_config, this, SPEC_UNIT_START_ID + j,
-          m_config->m_specialized_unit[j].name,
-          m_config->m_specialized_unit[j].latency, k));
+      if ((int)j == m_config->m_rt_spec_unit) {
+        m_rt_unit = new rt_unit(
+            &m_pipeline_reg[EX_WB], m_config, this, m_icnt,
+            m_mem_fetch_allocator, SPEC_UNIT_START_ID + j,
+            m_config->m_specialized_unit[j].name,
+            m_config->m_specialized_unit[j].latency, k, m_sid, m_gpu);
+        m_fu.push_back(m_rt_unit);
+      } else {
+        m_fu.push_back(new specialized_unit(
+            &m_pipeline_reg[EX_WB], m_config, this, SPEC_UNIT_START_ID + j,
+            m_config->m_specialized_unit[j].name,
+            m_config->m_specialized_unit[j].latency, k));
+      }
       m_dispatch_port.push_back(m_config->m_specialized_unit[j].ID_OC_SPEC_ID);
       m_issue_port.push_back(m_config->m_specialized_unit[j].OC_EX_SPEC_ID);
     }
@@ -514,7 +525,10 @@ shader_core_ctx::shader_core_ctx(class gpgpu_sim *gpu,
   m_occupied_graphics_threads = 0;
   m_occupied_hwtid.reset();
   m_occupied_cta_to_hwtid.clear();
+  m_cta_footprint[0].valid = m_cta_footprint[1].valid = false;
+  m_quota_pinned = false;
   shader_inst = 0;
+  shader_class_inst[0] = shader_class_inst[1] = 0;
   m_running_graphics = NULL;
   m_running_compute = NULL;
 }
@@ -523,6 +537,7 @@ void shader_core_ctx::reinit(unsigned start_thread, unsigned end_thread,
                              bool reset_not_completed) {
   if (reset_not_completed) {
     m_not_completed = 0;
+    update_running();
     m_active_threads.reset();
 
     // Jin: for concurrent kernels on a SM
@@ -536,6 +551,7 @@ void shader_core_ctx::reinit(unsigned start_thread, unsigned end_thread,
     m_occupied_graphics_ctas = 0;
     m_occupied_hwtid.reset();
     m_occupied_cta_to_hwtid.clear();
+    clear_cta_footprint_blocks();
     m_active_warps = 0;
   }
   for (unsigned i = start_thread; i < end_thread; i++) {
@@ -591,7 +607,7 @@ void shader_core_ctx::init_warps(unsigned cta_id, unsigned start_thread,
         start_pc = pc;
       }
 
-      m_warp[i]->init(start_pc, cta_id, ctaid, i, active_threads, m_dynamic_warp_id, kernel.is_graphic_kernel);
+      m_warp[i]->init(start_pc, cta_id, ctaid, i, active_threads, m_dynamic_warp_id, kernel.is_graphic_kernel, kernel.tenant);
       ++m_dynamic_warp_id;
       m_not_completed += n_active;
       ++m_active_warps;
@@ -634,6 +650,72 @@ float shader_core_ctx::get_current_occupancy(unsigned long long &active,
   }
 }
 
+const char *shader_core_stats::class_stall_name(class_stall_reason_t reason) {
+  static const char *reason_str[N_CLASS_STALL_REASON] = {
+      "idle", "barrier", "scoreboard", "exec_pipe", "mem_pipe", "other_issued",
+      "issued"};
+  return reason_str[reason];
+}
+
+unsigned long long shader_core_stats::class_stall(
+    bool graphics, class_stall_reason_t reason) const {
+  unsigned long long n = 0;
+#ifndef NO_CLASS_STALL_STATS
+  for (unsigned sid = 0; sid < m_config->num_shader(); sid++)
+    n += m_class_stall[(sid * 2 + graphics) * N_CLASS_STALL_REASON + reason];
+#endif
+  return n;
+}
+
+void shader_core_stats::print_class_stall(FILE *fout) {
+#ifndef NO_CLASS_STALL_STATS
+  static const char *mem_str[N_MEM_STAGE_STALL_TYPE] = {
+      "no_rc_fail",      "bk_conf",         "mshr_rc_fail",
+      "icnt_rc_fail",    "coal_stall",      "tlb_stall",
+      "data_port_stall", "wb_icnt_rc_fail", "wb_cache_rsrv_fail"};
+  static const char *class_str[2] = {"compute", "graphics"};
+  unsigned num_sm = m_config->num_shader();
+  std::vector<unsigned> total(2 * N_CLASS_STALL_REASON, 0);
+  std::vector<unsigned> mem_total(2 * N_MEM_STAGE_STALL_TYPE, 0);
+  for (unsigned sid = 0; sid < num_sm; sid++) {
+    for (unsigned c = 0; c < 2; c++) {
+      unsigned base = (sid * 2 + c) * N_CLASS_STALL_REASON;
+      unsigned mem_base = (sid * 2 + c) * N_MEM_STAGE_STALL_TYPE;
+      unsigned long long sum = 0;
+      for (unsigned r = 0; r < N_CLASS_STALL_REASON; r++)
+        sum += m_class_stall[base + r] - m_last_class_stall[base + r];
+      if (sum == 0) continue;
+      fprintf(fout, "class_stall_sm[%u][%s]:", sid, class_str[c]);
+      for (unsigned r = 0; r < N_CLASS_STALL_REASON; r++) {
+        unsigned n = m_class_stall[base + r] - m_last_class_stall[base + r];
+        total[c * N_CLASS_STALL_REASON + r] += n;
+        fprintf(fout, " %s=%u",
+                class_stall_name((class_stall_reason_t)r), n);
+      }
+      for (unsigned r = 1; r < N_MEM_STAGE_STALL_TYPE; r++) {
+        unsigned n =
+            m_class_mem_stall[mem_base + r] - m_last_class_mem_stall[mem_base + r];
+        mem_total[c * N_MEM_STAGE_STALL_TYPE + r] += n;
+        fprintf(fout, " mem_%s=%u", mem_str[r], n);
+      }
+      fprintf(fout, "\n");
+    }
+  }
+  for (unsigned c = 0; c < 2; c++) {
+    fprintf(fout, "class_stall[%s]:", class_str[c]);
+    for (unsigned r = 0; r < N_CLASS_STALL_REASON; r++)
+      fprintf(fout, " %s=%u", class_stall_name((class_stall_reason_t)r),
+              total[c * N_CLASS_STALL_REASON + r]);
+    for (unsigned r = 1; r < N_MEM_STAGE_STALL_TYPE; r++)
+      fprintf(fout, " mem_%s=%u", mem_str[r],
+              mem_total[c * N_MEM_STAGE_STALL_TYPE + r]);
+    fprintf(fout, "\n");
+  }
+  m_last_class_stall = m_class_stall;
+  m_last_class_mem_stall = m_class_mem_stall;
+#endif
+}
+
 void shader_core_stats::print(FILE *fout) const {
   unsigned long long thread_icount_uarch = 0;
   unsigned long long warp_icount_uarch = 0;
@@ -741,6 +823,8 @@ void shader_core_stats::print(FILE *fout) const {
 
   fprintf(fout, "gpu_reg_bank_conflict_stalls = %d\n",
           gpu_reg_bank_conflict_stalls);
+  if (m_config->gpgpu_operand_reuse_slots)
+    fprintf(fout, "gpu_operand_reuse_hits = %llu\n", gpu_operand_reuse_hits);
 
   fprintf(fout, "Warp Occupancy Distribution:\n");
   fprintf(fout, "Stall:%d\t", shader_cycle_distro[2]);
@@ -971,13 +1055,16 @@ void shader_core_ctx::fetch() {
               m_threadState[tid]->m_active = false;
               unsigned cta_id = m_warp[warp_id]->get_cta_id();
               unsigned kernelcta_id = m_warp[warp_id]->get_kernelcta_id();
-              if (m_thread[tid] == NULL) {
-                register_cta_thread_exit(cta_id, kernelcta_id, m_warp[warp_id]->get_kernel_info());
-              } else {
-                register_cta_thread_exit(cta_id, kernelcta_id,
-                                         &(m_thread[tid]->get_kernel()));
-              }
-              m_not_completed -= 1;
+              kernel_info_t *kernel = m_thread[tid] == NULL
+                                          ? m_warp[warp_id]->get_kernel_info()
+                                          : &(m_thread[tid]->get_kernel());
+              // a finished CTA retires from the kernel and the gpu, which
+              // the other clusters share
+              core_stage_defer([this, cta_id, kernelcta_id, kernel]() {
+                register_cta_thread_exit(cta_id, kernelcta_id, kernel);
+                m_not_completed -= 1;
+                update_running();
+              });
               m_active_threads.reset(tid);
               did_exit = true;
             }
@@ -1000,24 +1087,27 @@ void shader_core_ctx::fetch() {
           if ((offset_in_block + nbytes) > m_config->m_L1I_config.get_line_sz())
             nbytes = (m_config->m_L1I_config.get_line_sz() - offset_in_block);
 
-          // TODO: replace with use of allocator
-          // mem_fetch *mf = m_mem_fetch_allocator->alloc()
-          mem_access_t acc(INST_ACC_R, ppc, nbytes, false, m_gpu->gpgpu_ctx);
-          mem_fetch *mf = new mem_fetch(
-              acc, NULL /*we don't have an instruction yet*/, READ_PACKET_SIZE,
-              warp_id, m_sid, m_tpc, m_memory_config,
-              m_gpu->gpu_tot_sim_cycle + m_gpu->gpu_sim_cycle,
-              m_warp[warp_id]->get_kernel_info()->get_uid());
-          std::list<cache_event> events;
+          // a perfect i-cache only needs the address, the request is built
+          // for the modelled one
+          mem_fetch *mf = NULL;
           enum cache_request_status status;
           if (m_config->perfect_inst_const_cache){
             status = HIT;
             shader_cache_access_log(m_sid, INSTRUCTION, 0);
-          }
-          else
+          } else {
+            // TODO: replace with use of allocator
+            // mem_fetch *mf = m_mem_fetch_allocator->alloc()
+            mem_access_t acc(INST_ACC_R, ppc, nbytes, false, m_gpu->gpgpu_ctx);
+            mf = new mem_fetch(
+                acc, NULL /*we don't have an instruction yet*/,
+                READ_PACKET_SIZE, warp_id, m_sid, m_tpc, m_memory_config,
+                m_gpu->gpu_tot_sim_cycle + m_gpu->gpu_sim_cycle,
+                m_warp[warp_id]->get_kernel_info()->get_uid());
+            std::list<cache_event> events;
             status = m_L1I->access(
                 (new_addr_type)ppc, mf,
                 m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle, events);
+          }
 
           if (status == MISS) {
             m_last_warp_fetched = warp_id;
@@ -1065,8 +1155,21 @@ void shader_core_ctx::issue_warp(register_set &pipe_reg_set,
                      m_gpu->gpu_tot_sim_cycle + m_gpu->gpu_sim_cycle,
                      m_warp[warp_id]->get_dynamic_warp_id(),
                      sch_id);  // dynamic instruction information
-  m_stats->shader_cycle_distro[2 + (*pipe_reg)->active_count()]++;
+  (*pipe_reg)->set_tenant(m_warp[warp_id]->tenant);
+  core_stage_add(m_stats->shader_cycle_distro[2 + (*pipe_reg)->active_count()],
+                 1u);
   func_exec_inst(**pipe_reg);
+  if (m_gpu->validation().tracks_warps()) {
+    // the hash is shared by all SMs, a copy waits for the barrier
+    validation_log *validation = &m_gpu->validation();
+    unsigned uid = m_warp[warp_id]->get_kernel_info()->get_uid();
+    unsigned sid = m_sid;
+    warp_inst_t inst = **pipe_reg;
+    unsigned long long cycle = m_gpu->gpu_tot_sim_cycle + m_gpu->gpu_sim_cycle;
+    core_stage_defer([=]() {
+      validation->warp_inst(uid, sid, warp_id, inst, cycle);
+    });
+  }
 
   if (next_inst->op == BARRIER_OP) {
     m_warp[warp_id]->store_info_of_last_inst_at_barrier(*pipe_reg);
@@ -1221,6 +1324,10 @@ void scheduler_unit::cycle() {
   bool ready_inst = false;   // of the valid instructions, there was one not
                              // waiting for pending register writes
   bool issued_inst = false;  // of these we issued one
+#ifndef NO_CLASS_STALL_STATS
+  // best class_stall_reason_t reached by a compute/graphics warp, -1 if none
+  int class_reason[2] = {-1, -1};
+#endif
 
   order_warps();
   for (std::vector<shd_warp_t *>::const_iterator iter =
@@ -1255,6 +1362,9 @@ void scheduler_unit::cycle() {
           "Warp (warp_id %u, dynamic_warp_id %u) fails as waiting for "
           "barrier\n",
           (*iter)->get_warp_id(), (*iter)->get_dynamic_warp_id());
+#ifndef NO_CLASS_STALL_STATS
+    int warp_reason = warp(warp_id).waiting() ? CS_BARRIER : CS_IDLE;
+#endif
 
     while (!warp(warp_id).waiting() && !warp(warp_id).ibuffer_empty() &&
            (checked < max_issue) && (checked <= issued) &&
@@ -1288,6 +1398,9 @@ void scheduler_unit::cycle() {
           warp(warp_id).ibuffer_flush();
         } else {
           valid_inst = true;
+#ifndef NO_CLASS_STALL_STATS
+          warp_reason = std::max(warp_reason, (int)CS_SCOREBOARD);
+#endif
           if (!m_scoreboard->checkCollision(warp_id, pI)) {
             SCHED_DPRINTF(
                 "Warp (warp_id %u, dynamic_warp_id %u) passes scoreboard\n",
@@ -1303,6 +1416,9 @@ void scheduler_unit::cycle() {
                 (pI->op == MEMORY_BARRIER_OP) ||
                 (pI->op == TENSOR_CORE_LOAD_OP) ||
                 (pI->op == TENSOR_CORE_STORE_OP)) {
+#ifndef NO_CLASS_STALL_STATS
+              warp_reason = std::max(warp_reason, (int)CS_MEM_PIPE);
+#endif
               if (m_mem_out->has_free(m_shader->m_config->sub_core_model,
                                       m_id) &&
                   (!diff_exec_units ||
@@ -1315,6 +1431,9 @@ void scheduler_unit::cycle() {
                 previous_issued_inst_exec_type = exec_unit_type_t::MEM;
               }
             } else {
+#ifndef NO_CLASS_STALL_STATS
+              warp_reason = std::max(warp_reason, (int)CS_EXEC_PIPE);
+#endif
               // This code need to be refactored
               if (pI->op != TENSOR_CORE_OP && pI->op != SFU_OP &&
                   pI->op != DP_OP && !(pI->op >= SPEC_UNIT_START_ID)) {
@@ -1480,6 +1599,9 @@ void scheduler_unit::cycle() {
         warp(warp_id).ibuffer_flush();
       }
       if (warp_inst_issued) {
+#ifndef NO_CLASS_STALL_STATS
+        warp_reason = CS_ISSUED;
+#endif
         SCHED_DPRINTF(
             "Warp (warp_id %u, dynamic_warp_id %u, kernel_uid %u) issued %u instructions\n",
             (*iter)->get_warp_id(), (*iter)->get_dynamic_warp_id(), (*iter)->get_kernel_info()->get_uid(), issued);
@@ -1487,6 +1609,10 @@ void scheduler_unit::cycle() {
       }
       checked++;
     }
+#ifndef NO_CLASS_STALL_STATS
+    bool warp_class = (*iter)->is_graphics;
+    class_reason[warp_class] = std::max(class_reason[warp_class], warp_reason);
+#endif
     if (issued) {
       // This might be a bit inefficient, but we need to maintain
       // two ordered list for proper scheduler execution.
@@ -1504,27 +1630,46 @@ void scheduler_unit::cycle() {
       m_num_issued_last_cycle = issued;
       if (!(*iter)->is_graphics) {
         // m_stats->compute_issued++;
-        m_shader->get_gpu()->gpu_compute_issued++;
+        core_stage_add(m_shader->get_gpu()->gpu_compute_issued, 1ull);
       }
       if (issued == 1)
-        m_stats->single_issue_nums[m_id]++;
+        core_stage_add(m_stats->single_issue_nums[m_id], 1u);
       else if (issued > 1)
-        m_stats->dual_issue_nums[m_id]++;
+        core_stage_add(m_stats->dual_issue_nums[m_id], 1u);
       else
         abort();  // issued should be > 0
 
+#ifndef NO_CLASS_STALL_STATS
+      // the other class lost the slot if it had a warp further down the order
+      bool other_class = !(*iter)->is_graphics;
+      if (class_reason[other_class] < 0) {
+        for (std::vector<shd_warp_t *>::const_iterator rest = iter + 1;
+             rest != m_next_cycle_prioritized_warps.end(); rest++) {
+          if ((*rest) != NULL && !(*rest)->done_exit() &&
+              (*rest)->is_graphics == other_class) {
+            class_reason[other_class] = CS_OTHER_ISSUED;
+            break;
+          }
+        }
+      }
+#endif
       break;
     }
   }
+#ifndef NO_CLASS_STALL_STATS
+  for (unsigned c = 0; c < 2; c++)
+    if (class_reason[c] >= 0)
+      m_stats->event_class_stall(m_shader->get_sid(), c,
+                                 (class_stall_reason_t)class_reason[c]);
+#endif
 
   // issue stall statistics:
-  if (!valid_inst)
-    m_stats->shader_cycle_distro[0]++;  // idle or control hazard
-  else if (!ready_inst)
-    m_stats->shader_cycle_distro[1]++;  // waiting for RAW hazards (possibly due
-                                        // to memory)
-  else if (!issued_inst)
-    m_stats->shader_cycle_distro[2]++;  // pipeline stalled
+  if (!valid_inst)  // idle or control hazard
+    core_stage_add(m_stats->shader_cycle_distro[0], 1u);
+  else if (!ready_inst)  // waiting for RAW hazards (possibly due to memory)
+    core_stage_add(m_stats->shader_cycle_distro[1], 1u);
+  else if (!issued_inst)  // pipeline stalled
+    core_stage_add(m_stats->shader_cycle_distro[2], 1u);
 }
 
 void scheduler_unit::do_on_warp_issued(
@@ -1549,38 +1694,118 @@ bool scheduler_unit::sort_warps_by_oldest_dynamic_id(shd_warp_t *lhs,
     return lhs < rhs;
   }
 }
-void best_scheduler::order_warps() {
-  unsigned num_warps_to_add = m_supervised_warps.size();
+void scheduler_unit::update_age_order() {
+  unsigned n = m_supervised_warps.size();
+  bool changed = false;
+  if (m_age_order.size() != n) {
+    m_age_order = m_supervised_warps;
+    m_age_order_ids.assign(n, (unsigned)-1);
+    m_age_order_stalled.reserve(n);
+    changed = true;
+  }
+  for (unsigned i = 0; i < n; ++i) {
+    unsigned id = m_age_order[i]->get_dynamic_warp_id();
+    if (id != m_age_order_ids[i]) {
+      m_age_order_ids[i] = id;
+      changed = true;
+    }
+  }
+  if (!changed) return;
+  // only the reinitialized warps are out of place
+  for (unsigned i = 1; i < n; ++i) {
+    shd_warp_t *w = m_age_order[i];
+    unsigned id = m_age_order_ids[i];
+    unsigned j = i;
+    for (; j > 0 && m_age_order_ids[j - 1] > id; --j) {
+      m_age_order[j] = m_age_order[j - 1];
+      m_age_order_ids[j] = m_age_order_ids[j - 1];
+    }
+    m_age_order[j] = w;
+    m_age_order_ids[j] = id;
+  }
+}
+
+void scheduler_unit::order_by_age(
+    std::vector<shd_warp_t *> &result_list,
+    const std::vector<shd_warp_t *>::const_iterator &last_issued_from_input,
+    unsigned num_warps_to_add, OrderingType ordering) {
   assert(num_warps_to_add <= m_supervised_warps.size());
+  result_list.clear();
+  update_age_order();
+
+  // sort_warps_by_oldest_dynamic_id puts the ready warps first by age and
+  // leaves the exited / waiting ones behind them; those never issue, so
+  // their relative order does not matter
+  shd_warp_t *greedy_value = NULL;
+  if (ORDERING_GREEDY_THEN_PRIORITY_FUNC == ordering) {
+    // nothing has issued yet: the greedy slot is empty and skipped by cycle()
+    if (last_issued_from_input != m_supervised_warps.end())
+      greedy_value = *last_issued_from_input;
+    result_list.push_back(greedy_value);
+  } else if (ORDERED_PRIORITY_FUNC_ONLY != ordering) {
+    fprintf(stderr, "Unknown ordering - %d\n", ordering);
+    abort();
+  }
+
   unsigned count = 0;
-  m_next_cycle_prioritized_warps.clear();
-  std::vector<shd_warp_t *>::const_iterator iter =
-      (m_last_supervised_issued == m_supervised_warps.end())
-          ? m_supervised_warps.begin()
-          : m_last_supervised_issued + 1;
-  // std::unordered_map<shd_warp_t *, unsigned> skip;
-  for (std::vector<shd_warp_t *>::const_iterator iter2 =
-           m_supervised_warps.begin();
-       iter2 != m_supervised_warps.end(); ++iter2) {
-    if (!(*iter2)->is_graphics) {
-      m_next_cycle_prioritized_warps.push_back(*iter2);
-      // skip[*iter2] = 1;
-      count++;
+  m_age_order_stalled.clear();
+  for (std::vector<shd_warp_t *>::const_iterator iter = m_age_order.begin();
+       iter != m_age_order.end(); ++iter) {
+    if ((*iter)->done_exit() || (*iter)->waiting()) {
+      m_age_order_stalled.push_back(*iter);
+    } else if (count < num_warps_to_add) {
+      if (*iter != greedy_value) result_list.push_back(*iter);
+      ++count;
     }
   }
+  for (std::vector<shd_warp_t *>::const_iterator iter =
+           m_age_order_stalled.begin();
+       iter != m_age_order_stalled.end() && count < num_warps_to_add;
+       ++iter, ++count) {
+    if (*iter != greedy_value) result_list.push_back(*iter);
+  }
+}
 
-  for (; count < num_warps_to_add; iter++) {
-    if (iter == m_supervised_warps.end()) {
-      iter = m_supervised_warps.begin();
-    }
-    if ((*iter)->is_graphics) {
-    // if (skip.find(*iter) == skip.end()) {
-      m_next_cycle_prioritized_warps.push_back(*iter);
-      count++;
+void best_scheduler::update_warp_classes() {
+  unsigned n = m_supervised_warps.size();
+  bool changed = m_class_is_graphics.size() != n;
+  if (changed) m_class_is_graphics.assign(n, false);
+  for (unsigned i = 0; i < n; ++i) {
+    if (m_supervised_warps[i]->is_graphics != m_class_is_graphics[i]) {
+      m_class_is_graphics[i] = m_supervised_warps[i]->is_graphics;
+      changed = true;
     }
   }
+  if (!changed) return;
+  m_compute_warps.clear();
+  m_graphics_pos.clear();
+  for (unsigned i = 0; i < n; ++i) {
+    if (m_class_is_graphics[i])
+      m_graphics_pos.push_back(i);
+    else
+      m_compute_warps.push_back(m_supervised_warps[i]);
+  }
 }
 
+void best_scheduler::order_warps() {
+  update_warp_classes();
+  // compute warps in supervised order, then graphics warps round robin from
+  // the one after the last issued warp
+  m_next_cycle_prioritized_warps.assign(m_compute_warps.begin(),
+                                        m_compute_warps.end());
+  if (m_graphics_pos.empty()) return;
+  unsigned start =
+      (m_last_supervised_issued == m_supervised_warps.end())
+          ? 0
+          : (m_last_supervised_issued - m_supervised_warps.begin()) + 1;
+  unsigned first = std::lower_bound(m_graphics_pos.begin(),
+                                    m_graphics_pos.end(), start) -
+                   m_graphics_pos.begin();
+  for (unsigned i = 0; i < m_graphics_pos.size(); ++i) {
+    unsigned pos = m_graphics_pos[(first + i) % m_graphics_pos.size()];
+    m_next_cycle_prioritized_warps.push_back(m_supervised_warps[pos]);
+  }
+}
 
 void lrr_scheduler::order_warps() {
   order_lrr(m_next_cycle_prioritized_warps, m_supervised_warps,
@@ -1592,17 +1817,13 @@ void rrr_scheduler::order_warps() {
 }
 
 void gto_scheduler::order_warps() {
-  order_by_priority(m_next_cycle_prioritized_warps, m_supervised_warps,
-                    m_last_supervised_issued, m_supervised_warps.size(),
-                    ORDERING_GREEDY_THEN_PRIORITY_FUNC,
-                    scheduler_unit::sort_warps_by_oldest_dynamic_id);
+  order_by_age(m_next_cycle_prioritized_warps, m_last_supervised_issued,
+               m_supervised_warps.size(), ORDERING_GREEDY_THEN_PRIORITY_FUNC);
 }
 
 void oldest_scheduler::order_warps() {
-  order_by_priority(m_next_cycle_prioritized_warps, m_supervised_warps,
-                    m_last_supervised_issued, m_supervised_warps.size(),
-                    ORDERED_PRIORITY_FUNC_ONLY,
-                    scheduler_unit::sort_warps_by_oldest_dynamic_id);
+  order_by_age(m_next_cycle_prioritized_warps, m_last_supervised_issued,
+               m_supervised_warps.size(), ORDERED_PRIORITY_FUNC_ONLY);
 }
 
 void two_level_active_scheduler::do_on_warp_issued(
@@ -1692,11 +1913,9 @@ swl_scheduler::swl_scheduler(shader_core_stats *stats, shader_core_ctx *shader,
 
 void swl_scheduler::order_warps() {
   if (SCHEDULER_PRIORITIZATION_GTO == m_prioritization) {
-    order_by_priority(m_next_cycle_prioritized_warps, m_supervised_warps,
-                      m_last_supervised_issued,
-                      MIN(m_num_warps_to_limit, m_supervised_warps.size()),
-                      ORDERING_GREEDY_THEN_PRIORITY_FUNC,
-                      scheduler_unit::sort_warps_by_oldest_dynamic_id);
+    order_by_age(m_next_cycle_prioritized_warps, m_last_supervised_issued,
+                 MIN(m_num_warps_to_limit, m_supervised_warps.size()),
+                 ORDERING_GREEDY_THEN_PRIORITY_FUNC);
   } else {
     fprintf(stderr, "swl_scheduler m_prioritization = %d\n", m_prioritization);
     abort();
@@ -1876,9 +2095,11 @@ void shader_core_ctx::warp_inst_complete(const warp_inst_t &inst) {
     m_stats->m_num_sim_insn[m_sid] += inst.active_count();
 
   m_stats->m_num_sim_winsn[m_sid]++;
-  m_gpu->gpu_sim_insn += inst.active_count();
-  m_gpu->gpu_sim_insn_per_kernel[inst.get_kernel_uid()] += inst.active_count();
+  core_stage_add(m_gpu->gpu_sim_insn, (unsigned long long)inst.active_count());
+  core_stage_add(m_gpu->gpu_sim_insn_per_kernel[inst.get_kernel_uid()],
+                 (unsigned long long)inst.active_count());
   shader_inst += inst.active_count();
+  shader_class_inst[warp_is_graphics(inst.warp_id())] += inst.active_count();
   inst.completed(m_gpu->gpu_tot_sim_cycle + m_gpu->gpu_sim_cycle);
 }
 
@@ -1919,8 +2140,8 @@ void shader_core_ctx::writeback() {
     m_scoreboard->releaseRegisters(pipe_reg);
     m_warp[warp_id]->dec_inst_in_pipeline();
     warp_inst_complete(*pipe_reg);
-    m_gpu->gpu_sim_insn_last_update_sid = m_sid;
-    m_gpu->gpu_sim_insn_last_update = m_gpu->gpu_sim_cycle;
+    core_stage_set(m_gpu->gpu_sim_insn_last_update_sid, m_sid);
+    core_stage_set(m_gpu->gpu_sim_insn_last_update, m_gpu->gpu_sim_cycle);
     m_last_inst_gpu_sim_cycle = m_gpu->gpu_sim_cycle;
     m_last_inst_gpu_tot_sim_cycle = m_gpu->gpu_tot_sim_cycle;
     pipe_reg->clear();
@@ -2016,6 +2237,10 @@ mem_stage_stall_type ldst_unit::process_memory_access_queue_l1cache(
          j++) {  // We can handle at max l1_banks reqs per cycle
 
       if (inst.accessq_empty()) return result;
+      if (!m_core->translated(inst, inst.accessq_back().get_addr())) {
+        result = TLB_STALL;
+        break;
+      }
 
       mem_fetch *mf =
           m_mf_allocator->alloc(inst, inst.accessq_back(),
@@ -2047,10 +2272,12 @@ mem_stage_stall_type ldst_unit::process_memory_access_queue_l1cache(
                 // cycle
       }
     }
-    if (!inst.accessq_empty() && result != BK_CONF) result = COAL_STALL;
+    if (!inst.accessq_empty() && result == NO_RC_FAIL) result = COAL_STALL;
 
     return result;
   } else {
+    if (!m_core->translated(inst, inst.accessq_back().get_addr()))
+      return TLB_STALL;
     mem_fetch *mf = m_mf_allocator->alloc(
         inst, inst.accessq_back(),
         m_core->get_gpu()->gpu_sim_cycle + m_core->get_gpu()->gpu_tot_sim_cycle,
@@ -2058,7 +2285,8 @@ mem_stage_stall_type ldst_unit::process_memory_access_queue_l1cache(
     std::list<cache_event> events;
     enum cache_request_status status = cache->access(
         mf->get_addr(), mf,
-        m_core->get_gpu()->gpu_sim_cycle + m_core->get_gpu()->gpu_tot_sim_cycle,
+        m_core->get_gpu()->gpu_sim_cycle +
+            m_core->get_gpu()->gpu_tot_sim_cycle + m_warm_cycle_offset,
         events);
     return process_cache_access(cache, mf->get_addr(), inst, events, mf,
                                 status);
@@ -2073,7 +2301,8 @@ void ldst_unit::L1_latency_queue_cycle() {
       enum cache_request_status status =
           m_L1D->access(mf_next->get_addr(), mf_next,
                         m_core->get_gpu()->gpu_sim_cycle +
-                            m_core->get_gpu()->gpu_tot_sim_cycle,
+                            m_core->get_gpu()->gpu_tot_sim_cycle +
+                            m_warm_cycle_offset,
                         events);
 
       bool write_sent = was_write_sent(events);
@@ -2171,9 +2400,9 @@ bool ldst_unit::constant_cycle(warp_inst_t &inst, mem_stage_stall_type &rc_fail,
     rc_fail = fail;  // keep other fails if this didn't fail.
     fail_type = C_MEM;
     if (rc_fail == BK_CONF or rc_fail == COAL_STALL) {
-      m_stats->gpgpu_n_cmem_portconflict++;  // coal stalls aren't really a bank
-                                             // conflict, but this maintains
-                                             // previous behavior.
+      // coal stalls aren't really a bank conflict, but this maintains
+      // previous behavior.
+      core_stage_add(m_stats->gpgpu_n_cmem_portconflict, 1u);
     }
   }
   return inst.accessq_empty();  // done if empty.
@@ -2181,9 +2410,14 @@ bool ldst_unit::constant_cycle(warp_inst_t &inst, mem_stage_stall_type &rc_fail,
 
 bool ldst_unit::texture_cycle(warp_inst_t &inst, mem_stage_stall_type &rc_fail,
                               mem_stage_access_type &fail_type) {
-  if (inst.empty() || inst.space.get_type() != tex_space) return true;
+  if (inst.empty() ||
+      (inst.space.get_type() != tex_space && !inst.is_l1t_tex()))
+    return true;
   if (inst.active_count() == 0) return true;
-  mem_stage_stall_type fail = process_memory_access_queue(m_L1T, inst);
+  mem_stage_stall_type fail = TLB_STALL;
+  if (inst.accessq_empty() ||
+      m_core->translated(inst, inst.accessq_back().get_addr()))
+    fail = process_memory_access_queue(m_L1T, inst);
   if (fail != NO_RC_FAIL) {
     rc_fail = fail;  // keep other fails if this didn't fail.
     fail_type = T_MEM;
@@ -2198,6 +2432,7 @@ bool ldst_unit::memory_cycle(warp_inst_t &inst,
                        (inst.space.get_type() != local_space) &&
                        (inst.space.get_type() != param_space_local)))
     return true;
+  if (inst.is_l1t_tex()) return true;  // texture_cycle()
   if (inst.active_count() == 0) return true;
   if (inst.accessq_empty()) return true;
 
@@ -2218,7 +2453,11 @@ bool ldst_unit::memory_cycle(warp_inst_t &inst,
         inst.is_store() ? WRITE_PACKET_SIZE : READ_PACKET_SIZE;
     unsigned size = access.get_size() + control_size;
     // printf("Interconnect:Addr: %x, size=%d\n",access.get_addr(),size);
-    if (m_icnt->full(size, inst.is_store() || inst.isatomic())) {
+    if (!m_core->translated(inst, access.get_addr())) {
+      stall_cond = TLB_STALL;
+    } else if (m_icnt->full(size, inst.is_store() || inst.isatomic()) ||
+        m_icnt->class_blocked(inst.is_vertex() || inst.is_fragment(),
+                              access.get_size() + control_size)) {
       stall_cond = ICNT_RC_FAIL;
     } else {
       mem_fetch *mf =
@@ -2269,6 +2508,18 @@ void ldst_unit::flush() {
   m_L1D->flush();
 }
 
+bool ldst_unit::warm_l1(new_addr_type addr, mem_access_sector_mask_t mask,
+                        bool is_graphics) {
+  if (!m_L1D) return false;
+  bool hit = m_L1D->warm_tag_access(
+      addr,
+      m_core->get_gpu()->gpu_sim_cycle + m_core->get_gpu()->gpu_tot_sim_cycle +
+          m_warm_cycle_offset,
+      mask, is_graphics);
+  m_warm_cycle_offset++;
+  return hit;
+}
+
 void ldst_unit::invalidate() {
   // Flush L1D cache
   m_L1D->invalidate();
@@ -2447,6 +2698,179 @@ void specialized_unit ::issue(register_set &source_reg) {
   pipelined_simd_unit::issue(source_reg);
 }
 
+rt_unit::rt_unit(register_set *result_port, const shader_core_config *config,
+                 shader_core_ctx *core, mem_fetch_interface *icnt,
+                 shader_core_mem_fetch_allocator *mf_allocator,
+                 unsigned supported_op, char *unit_name, unsigned latency,
+                 unsigned issue_reg_id, unsigned sid, gpgpu_sim *gpu)
+    : pipelined_simd_unit(result_port, config, latency, core, issue_reg_id) {
+  m_name = unit_name;
+  m_supported_op = supported_op;
+  m_latency = latency;
+  m_mf_allocator = mf_allocator;
+  m_slots.resize(config->gpgpu_rt_max_warps);
+  for (unsigned i = 0; i < m_slots.size(); i++)
+    m_slots[i].inst = new warp_inst_t(config);
+  m_next_slot[0] = m_next_slot[1] = 0;
+  char L0_name[32];
+  snprintf(L0_name, sizeof(L0_name), "RT_L0N_%03d", sid);
+  m_L0_node = new read_only_cache(L0_name, config->m_RT_L0_node_config, sid,
+                                  get_shader_constant_cache_id(), icnt,
+                                  IN_RT_L0_MISS_QUEUE, gpu);
+  snprintf(L0_name, sizeof(L0_name), "RT_L0P_%03d", sid);
+  m_L0_prim = new read_only_cache(L0_name, config->m_RT_L0_prim_config, sid,
+                                  get_shader_constant_cache_id(), icnt,
+                                  IN_RT_L0_MISS_QUEUE, gpu);
+}
+
+rt_unit::~rt_unit() {
+  for (unsigned i = 0; i < m_slots.size(); i++) delete m_slots[i].inst;
+  delete m_L0_node;
+  delete m_L0_prim;
+}
+
+void rt_unit::issue(register_set &source_reg) {
+  warp_inst_t **ready_reg =
+      source_reg.get_ready(m_config->sub_core_model, m_issue_reg_id);
+  (*ready_reg)->op_pipe = SPECIALIZED__OP;
+  m_core->incsp_stat(m_core->get_config()->warp_size, (*ready_reg)->latency);
+  pipelined_simd_unit::issue(source_reg);
+}
+
+void rt_unit::active_lanes_in_pipeline() {
+  active_mask_t active_lanes;
+  active_lanes.reset();
+  for (unsigned i = 0; i < m_slots.size(); i++) {
+    if (!m_slots[i].inst->empty())
+      active_lanes |= m_slots[i].inst->get_active_mask();
+  }
+  unsigned active_count = active_lanes.count();
+  m_core->incspactivelanes_stat(active_count);
+  m_core->incfuactivelanes_stat(active_count);
+  m_core->incfumemactivelanes_stat(active_count);
+}
+
+bool rt_unit::waiting_for_fill(mem_fetch *mf) {
+  return m_L0_node->waiting_for_fill(mf) || m_L0_prim->waiting_for_fill(mf);
+}
+
+void rt_unit::get_L0_sub_stats(unsigned kernel_id,
+                               struct cache_sub_stats &css) const {
+  struct cache_sub_stats prim_css;
+  m_L0_node->get_sub_stats(kernel_id, css);
+  m_L0_prim->get_sub_stats(kernel_id, prim_css);
+  css += prim_css;
+}
+
+void rt_unit::access_done(mem_fetch *mf) {
+  for (unsigned i = 0; i < m_slots.size(); i++) {
+    rt_slot &slot = m_slots[i];
+    if (!slot.inst->empty() && slot.pending &&
+        slot.inst->get_uid() == mf->get_inst_uid()) {
+      slot.pending--;
+      break;
+    }
+  }
+  delete mf;
+}
+
+// send the next fetch of one warp to `cache`; a warp may not start a new
+// traversal step before every fetch of its current step has returned
+void rt_unit::issue_access(read_only_cache *cache, bool primitive,
+                           unsigned long long time) {
+  unsigned n = m_slots.size();
+  for (unsigned c = 0; c < n; c++) {
+    unsigned s = (m_next_slot[primitive] + c) % n;
+    rt_slot &slot = m_slots[s];
+    warp_inst_t *inst = slot.inst;
+    if (inst->empty() || slot.done || inst->accessq_empty()) continue;
+    new_addr_type addr = inst->accessq_back().get_addr();
+    if (((addr & RT_ACCESS_PRIMITIVE) != 0) != primitive) continue;
+    if ((addr & RT_ACCESS_STEP) && slot.pending) continue;
+
+    mem_access_t access = inst->accessq_back();
+    access.set_addr(addr & ~(new_addr_type)RT_ACCESS_FLAGS);
+    // the slot keeps its place in the round robin until this one goes
+    if (!m_core->translated(*inst, access.get_addr())) return;
+    mem_fetch *mf = m_mf_allocator->alloc(
+        *inst, access,
+        m_core->get_gpu()->gpu_sim_cycle + m_core->get_gpu()->gpu_tot_sim_cycle,
+        inst->get_kernel_uid());
+    std::list<cache_event> events;
+    enum cache_request_status status =
+        cache->access(mf->get_addr(), mf, time, events);
+    if (status == RESERVATION_FAIL) {
+      delete mf;
+      return;
+    }
+    if (status == HIT)
+      delete mf;
+    else
+      slot.pending++;
+    inst->accessq_pop_back();
+    m_next_slot[primitive] = (s + 1) % n;
+    return;
+  }
+}
+
+void rt_unit::cycle() {
+  unsigned long long time =
+      m_core->get_gpu()->gpu_sim_cycle + m_core->get_gpu()->gpu_tot_sim_cycle;
+
+  if (!m_response_fifo.empty()) {
+    mem_fetch *mf = m_response_fifo.front();
+    read_only_cache *cache =
+        m_L0_node->waiting_for_fill(mf) ? m_L0_node : m_L0_prim;
+    if (cache->fill_port_free()) {
+      cache->fill(mf, time);
+      m_response_fifo.pop_front();
+    }
+  }
+  m_L0_node->cycle();
+  m_L0_prim->cycle();
+  while (m_L0_node->access_ready()) access_done(m_L0_node->next_access());
+  while (m_L0_prim->access_ready()) access_done(m_L0_prim->next_access());
+
+  for (unsigned i = 0; i < m_slots.size(); i++) {
+    rt_slot &slot = m_slots[i];
+    if (slot.inst->empty()) continue;
+    if (slot.done) {
+      if (time >= slot.ready_cycle && m_result_port->has_free())
+        m_result_port->move_in(slot.inst);
+    } else if (slot.inst->accessq_empty() && !slot.pending) {
+      slot.done = true;
+      slot.ready_cycle = time + m_latency;
+    }
+  }
+
+  issue_access(m_L0_node, false, time);
+  issue_access(m_L0_prim, true, time);
+
+  if (!m_dispatch_reg->empty()) {
+    for (unsigned i = 0; i < m_slots.size(); i++) {
+      rt_slot &slot = m_slots[i];
+      if (slot.inst->empty()) {
+        move_warp(slot.inst, m_dispatch_reg);
+        slot.pending = 0;
+        slot.done = false;
+        break;
+      }
+    }
+  }
+  occupied >>= 1;
+}
+
+void rt_unit::print(FILE *fp) const {
+  simd_function_unit::print(fp);
+  for (unsigned i = 0; i < m_slots.size(); i++) {
+    if (!m_slots[i].inst->empty()) {
+      fprintf(fp, "      %s[%2u] pending=%u done=%d ", m_name.c_str(), i,
+              m_slots[i].pending, m_slots[i].done);
+      m_slots[i].inst->print(fp);
+    }
+  }
+}
+
 void int_unit ::issue(register_set &source_reg) {
   warp_inst_t **ready_reg =
       source_reg.get_ready(m_config->sub_core_model, m_issue_reg_id);
@@ -2540,6 +2964,7 @@ void ldst_unit::init(mem_fetch_interface *icnt,
                               get_shader_constant_cache_id(), icnt,
                               IN_L1C_MISS_QUEUE, m_gpu);
   m_L1D = NULL;
+  m_warm_cycle_offset = 0;
   m_mem_rc = NO_RC_FAIL;
   m_num_writeback_clients =
       5;  // = shared memory, global/local (uncached), L1D, L1T, L1C
@@ -2754,13 +3179,13 @@ void ldst_unit::cycle() {
 
   if (!m_response_fifo.empty()) {
     mem_fetch *mf = m_response_fifo.front();
-    /*if (mf->get_access_type() == TEXTURE_ACC_R) {
+    if (m_config->gpgpu_tex_l1t && mf->get_access_type() == TEXTURE_ACC_R) {
       if (m_L1T->fill_port_free()) {
         m_L1T->fill(mf, m_core->get_gpu()->gpu_sim_cycle +
                             m_core->get_gpu()->gpu_tot_sim_cycle);
         m_response_fifo.pop_front();
       }
-    } else*/ if (mf->get_access_type() == CONST_ACC_R) {
+    } else if (mf->get_access_type() == CONST_ACC_R) {
       if (m_L1C->fill_port_free()) {
         mf->set_status(IN_SHADER_FETCHED,
                        m_core->get_gpu()->gpu_sim_cycle +
@@ -2799,7 +3224,8 @@ void ldst_unit::cycle() {
         } else {
           if (m_L1D->fill_port_free()) {
             m_L1D->fill(mf, m_core->get_gpu()->gpu_sim_cycle +
-                                m_core->get_gpu()->gpu_tot_sim_cycle);
+                                m_core->get_gpu()->gpu_tot_sim_cycle +
+                                m_warm_cycle_offset);
             m_response_fifo.pop_front();
           }
         }
@@ -2807,7 +3233,7 @@ void ldst_unit::cycle() {
     }
   }
 
-  // m_L1T->cycle();
+  if (m_config->gpgpu_tex_l1t) m_L1T->cycle();
   m_L1C->cycle();
   if (m_L1D) {
     m_L1D->cycle();
@@ -2820,14 +3246,16 @@ void ldst_unit::cycle() {
   bool done = true;
   done &= shared_cycle(pipe_reg, rc_fail, type);
   done &= constant_cycle(pipe_reg, rc_fail, type);
-  // done &= texture_cycle(pipe_reg, rc_fail, type);
+  if (m_config->gpgpu_tex_l1t) done &= texture_cycle(pipe_reg, rc_fail, type);
   done &= memory_cycle(pipe_reg, rc_fail, type);
   m_mem_rc = rc_fail;
 
   if (!done) {  // log stall types and return
     assert(rc_fail != NO_RC_FAIL);
-    m_stats->gpgpu_n_stall_shd_mem++;
-    m_stats->gpu_stall_shd_mem_breakdown[type][rc_fail]++;
+    core_stage_add(m_stats->gpgpu_n_stall_shd_mem, 1u);
+    core_stage_add(m_stats->gpu_stall_shd_mem_breakdown[type][rc_fail], 1u);
+    m_stats->event_class_mem_stall(
+        m_sid, m_core->warp_is_graphics(pipe_reg.warp_id()), rc_fail);
     return;
   }
 
@@ -2878,6 +3306,14 @@ void ldst_unit::cycle() {
   }
 }
 
+void shader_core_ctx::update_running() {
+  bool running = m_n_active_cta > 0 || m_not_completed > 0;
+  if (running != m_running) {
+    m_running = running;
+    m_gpu->set_sm_running(m_sid, running);
+  }
+}
+
 void shader_core_ctx::register_cta_thread_exit(unsigned cta_num, unsigned kernelcta_id, 
                                                kernel_info_t *kernel) {
   assert(m_cta_status[cta_num] > 0);
@@ -2908,6 +3344,8 @@ void shader_core_ctx::register_cta_thread_exit(unsigned cta_num, unsigned kernel
         assert(m_kernel == NULL || !m_gpu->kernel_more_cta_left(m_kernel));
       }
       m_kernel = NULL;
+      m_gpu->sm_gating().sm_idle(m_sid,
+                                 m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
     }
 
     // check if start compute
@@ -2918,25 +3356,12 @@ void shader_core_ctx::register_cta_thread_exit(unsigned cta_num, unsigned kernel
     }
     // Jin: for concurrent kernels on sm
     release_shader_resource_1block(cta_num, *kernel);
+    m_gpu->cta_retired(kernel);
     kernel->dec_running();
     // invalidate vertices
-    if (kernel->is_graphic_kernel &&
-        m_gpu->getShaderCoreConfig()->gpgpu_invalidate_l2) {
-      unsigned kernel_id = kernel->get_uid();
-      for (unsigned vb = 0; vb < m_gpu->vb_addr[kernel_id].size(); vb++) {
-        unsigned ctaid = kernelcta_id;
-        unsigned vb_size = m_gpu->vb_size[kernel_id][vb];
-        unsigned size_per_cta = m_gpu->vb_size_per_cta[kernel_id][vb];
-        if (kernel->get_name().find("VERTEX") != std::string::npos) {
-          // I forgot to multi the block dim in vulkan-sim for vertex buffers
-          size_per_cta = size_per_cta * kernel->threads_per_cta();
-        }
-        unsigned start_addr =
-            m_gpu->vb_addr[kernel_id][vb] + ctaid * size_per_cta;
-        if (((ctaid + 1) * size_per_cta < vb_size) && size_per_cta != 0) {
-          m_gpu->invalidate_l2_range(start_addr, size_per_cta, kernel->is_graphic_kernel);
-        }
-      }
+    if (kernel->is_graphic_kernel) {
+      m_gpu->vertex_buffers().cta_retired(*kernel, kernelcta_id);
+      m_gpu->tile_bins().cta_retired(*kernel, kernelcta_id);
     }
 
     if (!m_gpu->kernel_more_cta_left(kernel)) {
@@ -3113,6 +3538,27 @@ void gpgpu_sim::shader_print_cache_stats(FILE *fout, unsigned kernel_id) const {
     fprintf(fout, "\tL1T_total_cache_reservation_fails = %llu\n",
             total_css.res_fails);
   }
+
+  // RT unit L0 node and primitive caches
+  if (m_shader_config->m_rt_spec_unit >= 0) {
+    total_css.clear();
+    css.clear();
+    fprintf(fout, "RT_L0_cache:\n");
+    for (unsigned i = 0; i < m_shader_config->n_simt_clusters; ++i) {
+      m_cluster[i]->get_RT_L0_sub_stats(kernel_id, css);
+      total_css += css;
+    }
+    fprintf(fout, "\tRT_L0_total_cache_accesses = %llu\n", total_css.accesses);
+    fprintf(fout, "\tRT_L0_total_cache_misses = %llu\n", total_css.misses);
+    if (total_css.accesses > 0) {
+      fprintf(fout, "\tRT_L0_total_cache_miss_rate = %.4lf\n",
+              (double)total_css.misses / (double)total_css.accesses);
+    }
+    fprintf(fout, "\tRT_L0_total_cache_pending_hits = %llu\n",
+            total_css.pending_hits);
+    fprintf(fout, "\tRT_L0_total_cache_reservation_fails = %llu\n",
+            total_css.res_fails);
+  }
 }
 
 void gpgpu_sim::shader_print_l1_miss_stat(FILE *fout) const {
@@ -3507,54 +3953,59 @@ unsigned int shader_core_config::max_cta(const kernel_info_t &k) const {
     abort();
   }
 
-  if (adaptive_cache_config && !k.cache_config_set) {
+  // with -gpgpu_l1_carveout_dynamic the carveout is l1_carveout's
+  if (adaptive_cache_config && !k.cache_config_set &&
+      !gpgpu_l1_carveout_dynamic) {
     // For more info about adaptive cache, see
     // https://docs.nvidia.com/cuda/cuda-c-programming-guide/index.html#shared-memory-7-x
     unsigned total_shmem = kernel_info->smem * result;
     assert(total_shmem >= 0 && total_shmem <= shmem_opt_list.back());
+    set_l1_carveout(total_shmem);
+    k.cache_config_set = true;
+  }
 
-    // Unified cache config is in KB. Converting to B
-    unsigned total_unified = m_L1D_config.m_unified_cache_size * 1024;
-
-    bool l1d_configured = false;
-    unsigned max_assoc = m_L1D_config.get_max_assoc();
-
-    for (std::vector<unsigned>::const_iterator it = shmem_opt_list.begin();
-         it < shmem_opt_list.end(); it++) {
-      if (total_shmem <= *it) {
-        float l1_ratio = 1 - ((float)*(it) / total_unified);
-        // make sure the ratio is between 0 and 1
-        assert(0 <= l1_ratio && l1_ratio <= 1);
-        // round to nearest instead of round down
-        m_L1D_config.set_assoc(max_assoc * l1_ratio + 0.5f);
-        l1d_configured = true;
-        break;
-      }
-    }
+  return result;
+}
 
-    assert(l1d_configured && "no shared memory option found");
-
-    if (m_L1D_config.is_streaming()) {
-      // for streaming cache, if the whole memory is allocated
-      // to the L1 cache, then make the allocation to be on_MISS
-      // otherwise, make it ON_FILL to eliminate line allocation fails
-      // i.e. MSHR throughput is the same, independent on the L1 cache
-      // size/associativity
-      if (total_shmem == 0) {
-        m_L1D_config.set_allocation_policy(ON_MISS);
-        printf("GPGPU-Sim: Reconfigure L1 allocation to ON_MISS\n");
-      } else {
-        m_L1D_config.set_allocation_policy(ON_FILL);
-        printf("GPGPU-Sim: Reconfigure L1 allocation to ON_FILL\n");
-      }
-    }
-    printf("GPGPU-Sim: Reconfigure L1 cache to %uKB\n",
-           m_L1D_config.get_total_size_inKB());
+unsigned shader_core_config::l1_assoc_for_shmem(unsigned total_shmem) const {
+  // Unified cache config is in KB. Converting to B
+  unsigned total_unified = m_L1D_config.m_unified_cache_size * 1024;
+  unsigned max_assoc = m_L1D_config.get_max_assoc();
 
-    k.cache_config_set = true;
+  for (std::vector<unsigned>::const_iterator it = shmem_opt_list.begin();
+       it < shmem_opt_list.end(); it++) {
+    if (total_shmem <= *it) {
+      float l1_ratio = 1 - ((float)*(it) / total_unified);
+      // make sure the ratio is between 0 and 1
+      assert(0 <= l1_ratio && l1_ratio <= 1);
+      // round to nearest instead of round down
+      return max_assoc * l1_ratio + 0.5f;
+    }
   }
 
-  return result;
+  assert(0 && "no shared memory option found");
+  return max_assoc;
+}
+
+void shader_core_config::set_l1_carveout(unsigned total_shmem) const {
+  m_L1D_config.set_assoc(l1_assoc_for_shmem(total_shmem));
+
+  if (m_L1D_config.is_streaming()) {
+    // for streaming cache, if the whole memory is allocated
+    // to the L1 cache, then make the allocation to be on_MISS
+    // otherwise, make it ON_FILL to eliminate line allocation fails
+    // i.e. MSHR throughput is the same, independent on the L1 cache
+    // size/associativity
+    if (total_shmem == 0) {
+      m_L1D_config.set_allocation_policy(ON_MISS);
+      printf("GPGPU-Sim: Reconfigure L1 allocation to ON_MISS\n");
+    } else {
+      m_L1D_config.set_allocation_policy(ON_FILL);
+      printf("GPGPU-Sim: Reconfigure L1 allocation to ON_FILL\n");
+    }
+  }
+  printf("GPGPU-Sim: Reconfigure L1 cache to %uKB\n",
+         m_L1D_config.get_total_size_inKB());
 }
 
 void shader_core_config::set_pipeline_latency() {
@@ -3614,92 +4065,45 @@ void shader_core_ctx::cycle() {
 
 void shader_core_ctx::cache_flush() { m_ldst_unit->flush(); }
 
-void shader_core_ctx::cache_invalidate() { m_ldst_unit->invalidate(); }
-
-// modifiers
-std::list<opndcoll_rfu_t::op_t> opndcoll_rfu_t::arbiter_t::allocate_reads() {
-  std::list<op_t>
-      result;  // a list of registers that (a) are in different register banks,
-               // (b) do not go to the same operand collector
-
-  int input;
-  int output;
-  int _inputs = m_num_banks;
-  int _outputs = m_num_collectors;
-  int _square = (_inputs > _outputs) ? _inputs : _outputs;
-  assert(_square > 0);
-  int _pri = (int)m_last_cu;
-
-  // Clear matching
-  for (int i = 0; i < _inputs; ++i) _inmatch[i] = -1;
-  for (int j = 0; j < _outputs; ++j) _outmatch[j] = -1;
-
-  for (unsigned i = 0; i < m_num_banks; i++) {
-    for (unsigned j = 0; j < m_num_collectors; j++) {
-      assert(i < (unsigned)_inputs);
-      assert(j < (unsigned)_outputs);
-      _request[i][j] = 0;
-    }
-    if (!m_queue[i].empty()) {
-      const op_t &op = m_queue[i].front();
-      int oc_id = op.get_oc_id();
-      assert(i < (unsigned)_inputs);
-      assert(oc_id < _outputs);
-      _request[i][oc_id] = 1;
-    }
-    if (m_allocated_bank[i].is_write()) {
-      assert(i < (unsigned)_inputs);
-      _inmatch[i] = 0;  // write gets priority
-    }
-  }
-
-  ///// wavefront allocator from booksim... --->
-
-  // Loop through diagonals of request matrix
-  // printf("####\n");
-
-  for (int p = 0; p < _square; ++p) {
-    output = (_pri + p) % _outputs;
-
-    // Step through the current diagonal
-    for (input = 0; input < _inputs; ++input) {
-      assert(input < _inputs);
-      assert(output < _outputs);
-      if ((output < _outputs) && (_inmatch[input] == -1) &&
-          //( _outmatch[output] == -1 ) &&   //allow OC to read multiple reg
-          // banks at the same cycle
-          (_request[input][output] /*.label != -1*/)) {
-        // Grant!
-        _inmatch[input] = output;
-        _outmatch[output] = input;
-        // printf("Register File: granting bank %d to OC %d, schedid %d, warpid
-        // %d, Regid %d\n", input, output, (m_queue[input].front()).get_sid(),
-        // (m_queue[input].front()).get_wid(),
-        // (m_queue[input].front()).get_reg());
-      }
-
-      output = (output + 1) % _outputs;
-    }
-  }
-
-  // Round-robin the priority diagonal
-  _pri = (_pri + 1) % _outputs;
+void shader_core_ctx::cache_invalidate(bool keep_texture) {
+  if (keep_texture)
+    m_ldst_unit->invalidate_except_texture();
+  else
+    m_ldst_unit->invalidate();
+}
 
-  /// <--- end code from booksim
+bool shader_core_ctx::warm_l1(new_addr_type addr,
+                              mem_access_sector_mask_t mask,
+                              bool is_graphics) {
+  return m_ldst_unit->warm_l1(addr, mask, is_graphics);
+}
 
-  m_last_cu = _pri;
-  for (unsigned i = 0; i < m_num_banks; i++) {
-    if (_inmatch[i] != -1) {
-      if (!m_allocated_bank[i].is_write()) {
-        unsigned bank = (unsigned)i;
-        op_t &op = m_queue[bank].front();
-        result.push_back(op);
-        m_queue[bank].pop_front();
-      }
+// modifiers
+const opndcoll_rfu_t::op_t *opndcoll_rfu_t::arbiter_t::allocate_reads(
+    unsigned &num_grants) {
+  // Each bank only requests on behalf of the head of its queue, and a
+  // collector may read several banks in the same cycle, so the wavefront
+  // allocator (from booksim) this replaced granted every bank that has a
+  // request and is not taken by a writeback. That is computed directly from
+  // the bank bitmasks; the rotating diagonal priority is still advanced.
+  m_num_grants = 0;
+  for (unsigned w = 0; w < m_pending_mask.size(); w++) {
+    unsigned long long ready = m_pending_mask[w] & ~m_write_mask[w];
+    while (ready) {
+      unsigned bank = w * 64 + __builtin_ctzll(ready);
+      ready &= ready - 1;
+      assert(bank < m_num_banks);
+      assert(m_queue[bank].front().get_oc_id() < m_num_collectors);
+      m_grants[m_num_grants++] = m_queue[bank].front();
+      m_queue[bank].pop_front();
+      if (m_queue[bank].empty())
+        m_pending_mask[w] &= ~(1ULL << (bank % 64));
     }
   }
+  m_last_cu = (m_last_cu + 1) % m_num_collectors;
 
-  return result;
+  num_grants = m_num_grants;
+  return m_grants;
 }
 
 barrier_set_t::barrier_set_t(shader_core_ctx *shader,
@@ -3964,9 +4368,26 @@ bool shader_core_ctx::ldst_unit_response_buffer_full() const {
 }
 
 void shader_core_ctx::accept_ldst_unit_response(mem_fetch *mf) {
+  if (m_rt_unit && m_rt_unit->waiting_for_fill(mf)) {
+    m_rt_unit->fill(mf);
+    return;
+  }
   m_ldst_unit->fill(mf);
 }
 
+bool shader_core_ctx::translated(const warp_inst_t &inst, new_addr_type addr) {
+  gpu_mmu &mmu = m_gpu->mmu();
+  if (!mmu.enabled()) return true;
+  enum tlb_request_status lookup = mmu.translate(
+      m_sid, addr, inst.is_vertex() || inst.is_fragment(), inst.get_tenant(),
+      inst.get_kernel_uid(), m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+  if (lookup == TLB_HIT || lookup == TLB_MISS) {
+    m_stats->m_num_tlb_accesses[m_sid]++;
+    if (lookup == TLB_HIT) m_stats->m_num_tlb_hits[m_sid]++;
+  }
+  return lookup == TLB_HIT || lookup == TLB_READY;
+}
+
 void shader_core_ctx::store_ack(class mem_fetch *mf) {
   assert(mf->get_type() == WRITE_ACK ||
          (m_config->gpgpu_perfect_mem && mf->get_is_write()));
@@ -4018,6 +4439,11 @@ void shader_core_ctx::get_L1T_sub_stats(unsigned kernel_id,
                                         struct cache_sub_stats &css) const {
   m_ldst_unit->get_L1T_sub_stats(kernel_id, css);
 }
+void shader_core_ctx::get_RT_L0_sub_stats(unsigned kernel_id,
+                                          struct cache_sub_stats &css) const {
+  css.clear();
+  if (m_rt_unit) m_rt_unit->get_L0_sub_stats(kernel_id, css);
+}
 
 void shader_core_ctx::get_icnt_power_stats(long &n_simt_to_mem,
                                            long &n_mem_to_simt) const {
@@ -4146,6 +4572,12 @@ void opndcoll_rfu_t::init(unsigned num_banks, shader_core_ctx *shader) {
   }
   m_num_banks_per_sched =
       num_banks / shader->get_config()->gpgpu_num_sched_per_core;
+  if (shader->get_config()->gpgpu_operand_reuse_slots > MAX_REG_OPERANDS) {
+    printf("GPGPU-Sim: -gpgpu_operand_reuse_slots has to be at most %u\n",
+           MAX_REG_OPERANDS);
+    exit(1);
+  }
+  m_reuse_owner.assign(shader->get_config()->max_warps_per_shader, NULL);
 
   for (unsigned j = 0; j < m_cu.size(); j++) {
     if (sub_core_model) {
@@ -4288,23 +4720,20 @@ void opndcoll_rfu_t::allocate_cu(unsigned port_num) {
 }
 
 void opndcoll_rfu_t::allocate_reads() {
-  // process read requests that do not have conflicts
-  std::list<op_t> allocated = m_arbiter.allocate_reads();
-  std::map<unsigned, op_t> read_ops;
-  for (std::list<op_t>::iterator r = allocated.begin(); r != allocated.end();
-       r++) {
-    const op_t &rr = *r;
-    unsigned reg = rr.get_reg();
-    unsigned wid = rr.get_wid();
-    unsigned bank =
-        register_bank(reg, wid, m_num_banks, m_bank_warp_shift, sub_core_model,
-                      m_num_banks_per_sched, rr.get_sid());
+  // process read requests that do not have conflicts; grants come back in
+  // bank order, one per bank
+  unsigned num_grants;
+  const op_t *allocated = m_arbiter.allocate_reads(num_grants);
+  for (unsigned r = 0; r < num_grants; r++) {
+    const op_t &rr = allocated[r];
+    unsigned bank = rr.get_bank();
+    assert(bank == register_bank(rr.get_reg(), rr.get_wid(), m_num_banks,
+                                 m_bank_warp_shift, sub_core_model,
+                                 m_num_banks_per_sched, rr.get_sid()));
     m_arbiter.allocate_for_read(bank, rr);
-    read_ops[bank] = rr;
   }
-  std::map<unsigned, op_t>::iterator r;
-  for (r = read_ops.begin(); r != read_ops.end(); ++r) {
-    op_t &op = r->second;
+  for (unsigned r = 0; r < num_grants; r++) {
+    op_t op = allocated[r];
     unsigned cu = op.get_oc_id();
     unsigned operand = op.get_operand();
     m_cu[cu]->collect_operand(operand);
@@ -4328,6 +4757,26 @@ void opndcoll_rfu_t::allocate_reads() {
   }
 }
 
+void opndcoll_rfu_t::reuse_hit(const warp_inst_t &inst) {
+  // AccelWattch charges the read as an operand from outside the register
+  // file, the bank read it saves is not counted
+  unsigned active_count = m_shader->get_config()->warp_size;
+  if (m_shader->get_config()->gpgpu_clock_gated_reg_file) {
+    unsigned group = m_shader->get_config()->n_regfile_gating_group;
+    active_count = 0;
+    for (unsigned i = 0; i < m_shader->get_config()->warp_size; i += group) {
+      for (unsigned j = 0; j < group; j++) {
+        if (inst.get_active_mask().test(i + j)) {
+          active_count += group;
+          break;
+        }
+      }
+    }
+  }
+  m_shader->incnon_rf_operands(active_count);
+  m_shader->incoperand_reuse_hits();
+}
+
 bool opndcoll_rfu_t::collector_unit_t::ready() const {
   return (!m_free) && m_not_ready.none() &&
          (*m_output_register).has_free(m_sub_core_model, m_reg_id);
@@ -4361,6 +4810,8 @@ void opndcoll_rfu_t::collector_unit_t::init(
   m_sub_core_model = sub_core_model;
   m_reg_id = reg_id;
   m_num_banks_per_sched = banks_per_sched;
+  m_reuse_slots = rfu->shader_core()->get_config()->gpgpu_operand_reuse_slots;
+  for (unsigned i = 0; i < MAX_REG_OPERANDS; i++) m_reuse_reg[i] = -1;
 }
 
 bool opndcoll_rfu_t::collector_unit_t::allocate(register_set *pipeline_reg_set,
@@ -4372,6 +4823,11 @@ bool opndcoll_rfu_t::collector_unit_t::allocate(register_set *pipeline_reg_set,
   warp_inst_t **pipeline_reg = pipeline_reg_set->get_ready();
   if ((pipeline_reg) and !((*pipeline_reg)->empty())) {
     m_warp_id = (*pipeline_reg)->warp_id();
+    const warp_inst_t *inst = *pipeline_reg;
+    // the previous instruction of the warp was collected here and left
+    // the registers it flagged
+    bool reuse = m_reuse_slots && m_reuse_warp == m_warp_id &&
+                 m_rfu->m_reuse_owner[m_warp_id] == this;
     std::vector<int> prev_regs; // remove duplicate regs within same instr
     for (unsigned op = 0; op < MAX_REG_OPERANDS; op++) {
       int reg_num =
@@ -4383,7 +4839,12 @@ bool opndcoll_rfu_t::collector_unit_t::allocate(register_set *pipeline_reg_set,
         if (r == reg_num)
           new_reg = false;
       }
-      if (reg_num >= 0 && new_reg) {          // valid register
+      if (reg_num >= 0 && new_reg && reuse && op < m_reuse_slots &&
+          m_reuse_reg[op] == reg_num) {
+        prev_regs.push_back(reg_num);
+        m_src_op[op] = op_t();
+        m_rfu->reuse_hit(*inst);
+      } else if (reg_num >= 0 && new_reg) {          // valid register
         prev_regs.push_back(reg_num);
         m_src_op[op] = op_t(this, op, reg_num, m_num_banks, m_bank_warp_shift,
                             m_sub_core_model, m_num_banks_per_sched,
@@ -4392,6 +4853,13 @@ bool opndcoll_rfu_t::collector_unit_t::allocate(register_set *pipeline_reg_set,
       } else
         m_src_op[op] = op_t();
     }
+    if (m_reuse_slots) {
+      for (unsigned op = 0; op < m_reuse_slots; op++)
+        m_reuse_reg[op] =
+            (inst->reuse_mask >> op) & 1 ? inst->arch_reg.src[op] : -1;
+      m_reuse_warp = m_warp_id;
+      m_rfu->m_reuse_owner[m_warp_id] = this;
+    }
     // move_warp(m_warp,*pipeline_reg);
     pipeline_reg_set->move_out_to(m_warp);
     return true;
@@ -4421,7 +4889,8 @@ simt_core_cluster::simt_core_cluster(class gpgpu_sim *gpu, unsigned cluster_id,
                                      const shader_core_config *config,
                                      const memory_config *mem_config,
                                      shader_core_stats *stats,
-                                     class memory_stats_t *mstats) {
+                                     class memory_stats_t *mstats)
+    : m_stage_log(cluster_id, config->n_simt_clusters) {
   m_config = config;
   m_cta_issue_next_core = m_config->n_simt_cores_per_cluster -
                           1;  // this causes first launch to use hw cta 0
@@ -4430,6 +4899,14 @@ simt_core_cluster::simt_core_cluster(class gpgpu_sim *gpu, unsigned cluster_id,
   m_stats = stats;
   m_memory_stats = mstats;
   m_mem_config = mem_config;
+  m_staged_icnt_packets = 0;
+  m_staged_icnt_flits = 0;
+}
+
+void simt_core_cluster::flush_core_stage() {
+  m_stage_log.flush();
+  m_staged_icnt_packets = 0;
+  m_staged_icnt_flits = 0;
 }
 
 void simt_core_cluster::core_cycle() {
@@ -4444,6 +4921,14 @@ void simt_core_cluster::core_cycle() {
   }
 }
 
+void simt_core_cluster::idle_core_cycle() {
+  // an idle core returns from cycle() right away, only the order moves
+  if (m_config->simt_core_sim_order == 1) {
+    m_core_sim_order.splice(m_core_sim_order.end(), m_core_sim_order,
+                            m_core_sim_order.begin());
+  }
+}
+
 void simt_core_cluster::reinit() {
   for (unsigned i = 0; i < m_config->n_simt_cores_per_cluster; i++)
     m_core[i]->reinit(0, m_config->n_thread_per_shader, true);
@@ -4504,7 +4989,7 @@ unsigned simt_core_cluster::issue_block2core() {
       if (m_gpu->concurrent_mode == m_gpu->FINEGRAIN) {
         k = m_gpu->select_kernel(m_core[core]);
       } else if (m_gpu->concurrent_mode == m_gpu->MPS) {
-        k = m_gpu->select_kernel(m_cluster_id);
+        k = m_gpu->select_kernel(m_core[core]->get_sid());
       } else {
         assert(0);
       }
@@ -4529,33 +5014,30 @@ unsigned simt_core_cluster::issue_block2core() {
     if (m_gpu->kernel_more_cta_left(kernel) &&
         //            (m_core[core]->get_n_active_cta() <
         //            m_config->max_cta(*kernel)) ) {
-      m_core[core]->can_issue_1block(*kernel)) {
+      m_core[core]->can_issue_1block(*kernel) &&
+        m_gpu->tile_bins().may_issue(*kernel, m_cluster_id,
+                                     m_core[core]->get_sid()) &&
+        m_gpu->multi_gpus().may_issue(*kernel, m_cluster_id) &&
+        m_gpu->sm_gating().may_issue(
+            m_core[core]->get_sid(),
+            m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle)) {
       if (kernel->is_graphic_kernel) {
-        unsigned kernel_id = kernel->get_uid();
-
-        for (unsigned vb = 0; vb < m_gpu->vb_addr[kernel_id].size(); vb++) {
-          unsigned ctaid = kernel->get_next_cta_id_single();
-          unsigned vb_size = m_gpu->vb_size[kernel_id][vb];
-          unsigned size_per_cta = m_gpu->vb_size_per_cta[kernel_id][vb];
-          if (kernel->get_name().find("VERTEX") != std::string::npos) {
-            break;  //vertex shaders handled elsewhere
-            
-            // I forgot to multi the block dim in vulkan-sim for vertex buffers
-            size_per_cta = size_per_cta * kernel->threads_per_cta();
-          }
-          unsigned start_addr = m_gpu->vb_addr[kernel_id][vb] + ctaid * size_per_cta;
-          if (((ctaid + 1) * size_per_cta < vb_size) && size_per_cta != 0) {
-            m_gpu->perf_memcpy_to_gpu(start_addr, size_per_cta, true);
-            // printf("launching L2 prefetching at: %x , %u bytes\n",
-            // start_addr,
-            //        size_per_cta);
-          }
-        }
+        m_gpu->vertex_buffers().cta_issued(*kernel,
+                                           kernel->get_next_cta_id_single());
+        m_gpu->tile_bins().cta_issued(*kernel,
+                                      kernel->get_next_cta_id_single(),
+                                      m_cluster_id, m_core[core]->get_sid());
       }
-        m_core[core]->issue_block2core(*kernel);
-        num_blocks_issued++;
-        m_cta_issue_next_core = core;
-        break;
+      if (m_gpu->multi_gpus().enabled())
+        m_gpu->multi_gpus().cta_issued(m_cluster_id);
+      m_core[core]->issue_block2core(*kernel);
+      m_gpu->sm_gating().cta_issued(
+          m_core[core]->get_sid(),
+          m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+      m_gpu->cta_issued(kernel);
+      num_blocks_issued++;
+      m_cta_issue_next_core = core;
+      break;
       }
   }
   return num_blocks_issued;
@@ -4566,18 +5048,57 @@ void simt_core_cluster::cache_flush() {
     m_core[i]->cache_flush();
 }
 
-void simt_core_cluster::cache_invalidate() {
+void simt_core_cluster::cache_invalidate(bool keep_texture) {
   for (unsigned i = 0; i < m_config->n_simt_cores_per_cluster; i++)
-    m_core[i]->cache_invalidate();
+    m_core[i]->cache_invalidate(keep_texture);
+}
+
+void simt_core_cluster::cache_invalidate_range(new_addr_type addr,
+                                               unsigned size) {
+  for (unsigned i = 0; i < m_config->n_simt_cores_per_cluster; i++)
+    m_core[i]->cache_invalidate_range(addr, size);
+}
+
+void simt_core_cluster::set_l1_class_ways(unsigned ways) {
+  for (unsigned i = 0; i < m_config->n_simt_cores_per_cluster; i++)
+    m_core[i]->set_l1_class_ways(ways);
+}
+
+bool shader_memory_interface::class_blocked(bool graphics, unsigned size) {
+  gpgpu_sim *gpu = m_core->get_gpu();
+  return m_core->mem_limiter().blocked(graphics, size,
+                                       gpu->gpu_sim_cycle +
+                                           gpu->gpu_tot_sim_cycle);
 }
 
 bool simt_core_cluster::icnt_injection_buffer_full(unsigned size, bool write) {
   unsigned request_size = size;
   if (!write) request_size = READ_PACKET_SIZE;
+  if (m_staged_icnt_packets)
+    return !::icnt_has_buffer_staged(m_cluster_id, request_size,
+                                     m_staged_icnt_packets,
+                                     m_staged_icnt_flits);
   return !::icnt_has_buffer(m_cluster_id, request_size);
 }
 
 void simt_core_cluster::icnt_inject_request_packet(class mem_fetch *mf) {
+  core_stage_log *log = core_stage_log::current();
+  if (!log) {
+    push_request_packet(mf);
+    return;
+  }
+  // the interconnect and the stats below are shared by the clusters, so the
+  // push waits for the barrier and the packet counts as queued until then
+  unsigned size = (!mf->get_is_write() && !mf->isatomic())
+                      ? mf->get_ctrl_size()
+                      : mf->size();
+  unsigned flit_size = ::icnt_get_flit_size();
+  m_staged_icnt_packets++;
+  m_staged_icnt_flits += (size + flit_size - 1) / flit_size;
+  log->defer([this, mf]() { push_request_packet(mf); });
+}
+
+void simt_core_cluster::push_request_packet(class mem_fetch *mf) {
   // stats
   if (mf->get_is_write())
     m_stats->made_write_mfs++;
@@ -4632,6 +5153,7 @@ void simt_core_cluster::icnt_inject_request_packet(class mem_fetch *mf) {
     packet_size = mf->get_ctrl_size();
   }
   m_stats->m_outgoing_traffic_stats->record_traffic(mf, packet_size);
+  m_memory_stats->icnt_class_push(mf, packet_size);
   unsigned destination = mf->get_sub_partition_id();
   mf->set_status(IN_ICNT_TO_MEM,
                  m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
@@ -4667,6 +5189,10 @@ void simt_core_cluster::icnt_cycle() {
     if (!mf) return;
     assert(mf->get_tpc() == m_cluster_id);
     assert(mf->get_type() == READ_REPLY || mf->get_type() == WRITE_ACK);
+    m_memory_stats->icnt_class_pop(mf);
+    m_core[m_config->sid_to_cid(mf->get_sid())]->mem_limiter().retired(
+        mf->is_graphics(),
+        m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle - mf->get_timestamp());
 
     // The packet size varies depending on the type of request:
     // - For read request and atomic request, the packet contains the data
@@ -4770,6 +5296,18 @@ void simt_core_cluster::get_L1C_sub_stats(unsigned kernel_id, struct cache_sub_s
   }
   css = total_css;
 }
+void simt_core_cluster::get_RT_L0_sub_stats(
+    unsigned kernel_id, struct cache_sub_stats &css) const {
+  struct cache_sub_stats temp_css;
+  struct cache_sub_stats total_css;
+  temp_css.clear();
+  total_css.clear();
+  for (unsigned i = 0; i < m_config->n_simt_cores_per_cluster; ++i) {
+    m_core[i]->get_RT_L0_sub_stats(kernel_id, temp_css);
+    total_css += temp_css;
+  }
+  css = total_css;
+}
 void simt_core_cluster::get_L1T_sub_stats(unsigned kernel_id, struct cache_sub_stats &css) const {
   struct cache_sub_stats temp_css;
   struct cache_sub_stats total_css;
@@ -48,11 +48,14 @@
 //#include "../cuda-sim/ptx.tab.h"
 
 #include "../abstract_hardware_model.h"
+#include "core_stage_log.h"
 #include "delayqueue.h"
 #include "dram.h"
 #include "gpu-cache.h"
 #include "mem_fetch.h"
 #include "scoreboard.h"
+#include "mem_throttle.h"
+#include "sm_quota.h"
 #include "stack.h"
 #include "stats.h"
 #include "traffic_breakdown.h"
@@ -126,7 +129,7 @@ class shd_warp_t {
   }
   void init(address_type start_pc, unsigned cta_id, unsigned kernel_ctaid, unsigned wid,
             const std::bitset<MAX_WARP_SIZE> &active,
-            unsigned dynamic_warp_id, unsigned is_g) {
+            unsigned dynamic_warp_id, unsigned is_g, unsigned t) {
     m_cta_id = cta_id;
     m_kernelcta_id = kernel_ctaid;
     m_warp_id = wid;
@@ -142,6 +145,7 @@ class shd_warp_t {
     m_cdp_latency = 0;
     m_cdp_dummy = false;
     is_graphics = is_g;
+    tenant = t;
   }
 
   bool functional_done() const;
@@ -293,6 +297,7 @@ class shd_warp_t {
   unsigned int m_cdp_latency;
   bool m_cdp_dummy;
   bool is_graphics;
+  unsigned tenant;  // of the kernel the warp runs
 };
 
 inline unsigned hw_tid_from_wid(unsigned wid, unsigned warp_size, unsigned i) {
@@ -405,6 +410,12 @@ class scheduler_unit {  // this can be copied freely, so can be used in std
       unsigned num_warps_to_add, OrderingType age_ordering,
       bool (*priority_func)(U lhs, U rhs));
   static bool sort_warps_by_oldest_dynamic_id(shd_warp_t *lhs, shd_warp_t *rhs);
+  // Same ordering as order_by_priority with sort_warps_by_oldest_dynamic_id,
+  // but served from m_age_order instead of copying and sorting every cycle
+  void order_by_age(
+      std::vector<shd_warp_t *> &result_list,
+      const std::vector<shd_warp_t *>::const_iterator &last_issued_from_input,
+      unsigned num_warps_to_add, OrderingType age_ordering);
 
   // Derived classes can override this function to populate
   // m_supervised_warps with their scheduling policies
@@ -449,6 +460,14 @@ class scheduler_unit {  // this can be copied freely, so can be used in std
   unsigned m_num_issued_last_cycle;
   unsigned m_current_turn_warp;
 
+  // m_supervised_warps sorted by dynamic warp id. A warp only gets a new id
+  // when it is reinitialized for a CTA, so the order is repaired with an
+  // insertion sort when an id changes rather than rebuilt each cycle.
+  void update_age_order();
+  std::vector<shd_warp_t *> m_age_order;
+  std::vector<unsigned> m_age_order_ids;
+  std::vector<shd_warp_t *> m_age_order_stalled;  // scratch for order_by_age
+
   int m_id;
 };
 
@@ -469,6 +488,14 @@ class best_scheduler : public scheduler_unit {
   virtual void done_adding_supervised_warps() {
     m_last_supervised_issued = m_supervised_warps.end();
   }
+
+ private:
+  // compute warps in supervised order and the supervised positions of the
+  // graphics warps, rebuilt only when a warp's is_graphics flag changes
+  void update_warp_classes();
+  std::vector<bool> m_class_is_graphics;
+  std::vector<shd_warp_t *> m_compute_warps;
+  std::vector<unsigned> m_graphics_pos;
 };
 
 class lrr_scheduler : public scheduler_unit {
@@ -657,6 +684,8 @@ class opndcoll_rfu_t {  // operand collector based register file unit
 
  private:
   void process_banks() { m_arbiter.reset_alloction(); }
+  // a source operand served by the reuse cache instead of its bank
+  void reuse_hit(const warp_inst_t &inst);
 
   void dispatch_ready_cu();
   void allocate_cu(unsigned port);
@@ -811,9 +840,8 @@ class opndcoll_rfu_t {  // operand collector based register file unit
       m_queue = NULL;
       m_allocated_bank = NULL;
       m_allocator_rr_head = NULL;
-      _inmatch = NULL;
-      _outmatch = NULL;
-      _request = NULL;
+      m_grants = NULL;
+      m_num_grants = 0;
       m_last_cu = 0;
     }
     void init(unsigned num_cu, unsigned num_banks) {
@@ -821,12 +849,11 @@ class opndcoll_rfu_t {  // operand collector based register file unit
       assert(num_banks > 0);
       m_num_collectors = num_cu;
       m_num_banks = num_banks;
-      _inmatch = new int[m_num_banks];
-      _outmatch = new int[m_num_collectors];
-      _request = new int *[m_num_banks];
-      for (unsigned i = 0; i < m_num_banks; i++)
-        _request[i] = new int[m_num_collectors];
-      m_queue = new std::list<op_t>[num_banks];
+      m_queue = new ring_buffer<op_t>[num_banks];
+      m_grants = new op_t[num_banks];
+      unsigned mask_words = (num_banks + 63) / 64;
+      m_pending_mask.assign(mask_words, 0);
+      m_write_mask.assign(mask_words, 0);
       m_allocated_bank = new allocation_t[num_banks];
       m_allocator_rr_head = new unsigned[num_cu];
       for (unsigned n = 0; n < num_cu; n++)
@@ -841,9 +868,8 @@ class opndcoll_rfu_t {  // operand collector based register file unit
       fprintf(fp, "  requests:\n");
       for (unsigned b = 0; b < m_num_banks; b++) {
         fprintf(fp, "    bank %u : ", b);
-        std::list<op_t>::const_iterator o = m_queue[b].begin();
-        for (; o != m_queue[b].end(); o++) {
-          o->dump(fp);
+        for (unsigned o = 0; o < m_queue[b].size(); o++) {
+          m_queue[b][o].dump(fp);
         }
         fprintf(fp, "\n");
       }
@@ -856,7 +882,9 @@ class opndcoll_rfu_t {  // operand collector based register file unit
     }
 
     // modifiers
-    std::list<op_t> allocate_reads();
+    // returns the read grants of this cycle, at most one per bank, in bank
+    // order; valid until the next call
+    const op_t *allocate_reads(unsigned &num_grants);
 
     void add_read_requests(collector_unit_t *cu) {
       const op_t *src = cu->get_operands();
@@ -865,6 +893,7 @@ class opndcoll_rfu_t {  // operand collector based register file unit
         if (op.valid()) {
           unsigned bank = op.get_bank();
           m_queue[bank].push_back(op);
+          m_pending_mask[bank / 64] |= 1ULL << (bank % 64);
         }
       }
     }
@@ -874,6 +903,7 @@ class opndcoll_rfu_t {  // operand collector based register file unit
     void allocate_bank_for_write(unsigned bank, const op_t &op) {
       assert(bank < m_num_banks);
       m_allocated_bank[bank].alloc_write(op);
+      m_write_mask[bank / 64] |= 1ULL << (bank % 64);
     }
     void allocate_for_read(unsigned bank, const op_t &op) {
       assert(bank < m_num_banks);
@@ -881,6 +911,7 @@ class opndcoll_rfu_t {  // operand collector based register file unit
     }
     void reset_alloction() {
       for (unsigned b = 0; b < m_num_banks; b++) m_allocated_bank[b].reset();
+      std::fill(m_write_mask.begin(), m_write_mask.end(), 0);
     }
 
    private:
@@ -888,15 +919,16 @@ class opndcoll_rfu_t {  // operand collector based register file unit
     unsigned m_num_collectors;
 
     allocation_t *m_allocated_bank;  // bank # -> register that wins
-    std::list<op_t> *m_queue;
+    ring_buffer<op_t> *m_queue;
+    // one bit per bank: request queue not empty / bank taken by a write
+    std::vector<unsigned long long> m_pending_mask;
+    std::vector<unsigned long long> m_write_mask;
+    op_t *m_grants;  // allocate_reads() result, m_num_banks entries
+    unsigned m_num_grants;
 
     unsigned *
         m_allocator_rr_head;  // cu # -> next bank to check for request (rr-arb)
     unsigned m_last_cu;       // first cu to check while arb-ing banks (rr)
-
-    int *_inmatch;
-    int *_outmatch;
-    int **_request;
   };
 
   class input_port_t {
@@ -924,6 +956,8 @@ class opndcoll_rfu_t {  // operand collector based register file unit
       m_warp_id = -1;
       m_num_banks = 0;
       m_bank_warp_shift = 0;
+      m_reuse_slots = 0;
+      m_reuse_warp = -1;
     }
     // accessors
     bool ready() const;
@@ -968,6 +1002,14 @@ class opndcoll_rfu_t {  // operand collector based register file unit
     unsigned m_num_banks_per_sched;
     bool m_sub_core_model;
     unsigned m_reg_id;  // if sub_core_model enabled, limit regs this cu can r/w
+
+    // -gpgpu_operand_reuse_slots: the registers by source slot that the
+    // last instruction of m_reuse_warp this unit collected flagged for reuse,
+    // -1 for none. They only serve the warp's next instruction, and only if
+    // it is collected here too
+    unsigned m_reuse_slots;
+    unsigned m_reuse_warp;
+    int m_reuse_reg[MAX_REG_OPERANDS];
   };
 
   class dispatch_unit_t {
@@ -1022,6 +1064,8 @@ class opndcoll_rfu_t {  // operand collector based register file unit
   unsigned m_num_banks_per_sched;
   unsigned m_num_warp_scheds;
   bool sub_core_model;
+  // by warp, the collector unit that collected the warp's last instruction
+  std::vector<collector_unit_t *> m_reuse_owner;
 
   // unsigned m_num_ports;
   // std::vector<warp_inst_t**> m_input;
@@ -1331,6 +1375,69 @@ class shader_memory_interface;
 class shader_core_mem_fetch_allocator;
 class cache_t;
 
+// flags carried in the low bits of the 32B aligned addresses a TRACE_RAY puts
+// in its access queue: the access fetches a primitive (triangle/procedural
+// leaf) rather than a BVH node, and the access starts a new traversal step
+#define RT_ACCESS_PRIMITIVE 0x1
+#define RT_ACCESS_STEP 0x2
+#define RT_ACCESS_FLAGS (RT_ACCESS_PRIMITIVE | RT_ACCESS_STEP)
+
+// timing model of the ray tracing unit (a specialized unit named "RT"): up to
+// gpgpu_rt_max_warps TRACE_RAY warps traverse the BVH concurrently, each one
+// walking its access queue step by step through a node and a primitive L0
+// cache, and the warp leaves the unit `latency` cycles after its last fetch
+class rt_unit : public pipelined_simd_unit {
+ public:
+  rt_unit(register_set *result_port, const shader_core_config *config,
+          shader_core_ctx *core, mem_fetch_interface *icnt,
+          shader_core_mem_fetch_allocator *mf_allocator, unsigned supported_op,
+          char *unit_name, unsigned latency, unsigned issue_reg_id,
+          unsigned sid, gpgpu_sim *gpu);
+  ~rt_unit();
+
+  virtual bool can_issue(const warp_inst_t &inst) const {
+    if (inst.op != m_supported_op) {
+      return false;
+    }
+    return m_dispatch_reg->empty();
+  }
+  virtual void cycle();
+  virtual void issue(register_set &source_reg);
+  virtual void active_lanes_in_pipeline();
+  virtual bool stallable() const { return true; }
+  bool is_issue_partitioned() { return true; }
+  virtual void print(FILE *fp) const;
+
+  bool waiting_for_fill(mem_fetch *mf);
+  void fill(mem_fetch *mf) { m_response_fifo.push_back(mf); }
+  void get_L0_sub_stats(unsigned kernel_id, struct cache_sub_stats &css) const;
+  void update_cache_stats_size(unsigned kernel_id) {
+    m_L0_node->update_stats_size(kernel_id);
+    m_L0_prim->update_stats_size(kernel_id);
+  }
+
+ private:
+  struct rt_slot {
+    rt_slot() : inst(NULL), pending(0), done(false), ready_cycle(0) {}
+    warp_inst_t *inst;
+    unsigned pending;  // fetches of the current step still in flight
+    bool done;
+    unsigned long long ready_cycle;
+  };
+  void issue_access(read_only_cache *cache, bool primitive,
+                    unsigned long long time);
+  void access_done(mem_fetch *mf);
+
+  unsigned m_supported_op;
+  unsigned m_latency;
+  shader_core_mem_fetch_allocator *m_mf_allocator;
+  std::vector<rt_slot> m_slots;
+  unsigned m_next_slot[2];  // round robin per cache
+  read_only_cache *m_L0_node;
+  read_only_cache *m_L0_prim;
+  std::list<mem_fetch *> m_response_fifo;
+};
+
 class ldst_unit : public pipelined_simd_unit {
  public:
   ldst_unit(mem_fetch_interface *icnt,
@@ -1348,8 +1455,18 @@ class ldst_unit : public pipelined_simd_unit {
   void fill(mem_fetch *mf);
   void flush();
   void invalidate();
+  void invalidate_except_texture() {
+    if (m_L1D) m_L1D->invalidate_except_texture();
+  }
   void invalidate_range(new_addr_type addr, unsigned size);
   void writeback();
+  // see tag_array::set_class_ways
+  void set_l1_class_ways(unsigned ways) {
+    if (m_L1D) m_L1D->set_class_ways(ways);
+  }
+  // functional warm-up of the L1D, false without one or on a miss
+  bool warm_l1(new_addr_type addr, mem_access_sector_mask_t mask,
+               bool is_graphics);
 
   // accessors
   virtual unsigned clock_multiplier() const;
@@ -1438,6 +1555,9 @@ class ldst_unit : public pipelined_simd_unit {
   tex_cache *m_L1T;        // texture cache
   read_only_cache *m_L1C;  // constant cache
   l1_cache *m_L1D;         // data cache
+  // cycles the L1D's clock is ahead of the core's, one per warm-up access so
+  // the warmed lines keep their LRU order
+  unsigned m_warm_cycle_offset;
   std::map<unsigned /*warp_id*/,
            std::map<unsigned /*regnum*/, unsigned /*count*/>>
       m_pending_writes;
@@ -1551,6 +1671,10 @@ class shader_core_config : public core_config {
     m_L1T_config.init(m_L1T_config.m_config_string, FuncCachePreferNone);
     m_L1C_config.init(m_L1C_config.m_config_string, FuncCachePreferNone);
     m_L1D_config.init(m_L1D_config.m_config_string, FuncCachePreferNone);
+    m_RT_L0_node_config.init(m_RT_L0_node_config.m_config_string,
+                             FuncCachePreferNone);
+    m_RT_L0_prim_config.init(m_RT_L0_prim_config.m_config_string,
+                             FuncCachePreferNone);
     gpgpu_cache_texl1_linesize = m_L1T_config.get_line_sz();
     gpgpu_cache_constl1_linesize = m_L1C_config.get_line_sz();
     m_valid = true;
@@ -1572,6 +1696,14 @@ class shader_core_config : public core_config {
       } else
         break;  // we only accept continuous specialized_units, i.e., 1,2,3,4
     }
+    // the specialized unit named RT gets the ray tracing unit model
+    m_rt_spec_unit = -1;
+    for (unsigned j = 0; j < m_specialized_unit.size(); ++j) {
+      if (!strcmp(m_specialized_unit[j].name, "RT")) {
+        assert(m_specialized_unit[j].num_units == 1);
+        m_rt_spec_unit = j;
+      }
+    }
 
     // parse gpgpu_shmem_option for adpative cache config
     if (adaptive_cache_config) {
@@ -1586,6 +1718,11 @@ class shader_core_config : public core_config {
   }
   void reg_options(class OptionParser *opp);
   unsigned max_cta(const kernel_info_t &k) const;
+  // -gpgpu_adaptive_cache_config: the L1D ways left by the smallest shared
+  // memory carveout of gpgpu_shmem_option that holds total_shmem bytes
+  unsigned l1_assoc_for_shmem(unsigned total_shmem) const;
+  // resizes the L1D to l1_assoc_for_shmem, on every core at once
+  void set_l1_carveout(unsigned total_shmem) const;
   unsigned num_shader() const {
     return n_simt_clusters * n_simt_cores_per_cluster;
   }
@@ -1624,6 +1761,12 @@ class shader_core_config : public core_config {
   mutable cache_config m_L1T_config;
   mutable cache_config m_L1C_config;
   mutable l1d_cache_config m_L1D_config;
+  // the carveout of -gpgpu_adaptive_cache_config follows the running
+  // kernels, see l1_carveout.h
+  bool gpgpu_l1_carveout_dynamic;
+  mutable cache_config m_RT_L0_node_config;
+  mutable cache_config m_RT_L0_prim_config;
+  unsigned gpgpu_rt_max_warps;
 
   bool gpgpu_dwf_reg_bankconflict;
 
@@ -1671,6 +1814,12 @@ class shader_core_config : public core_config {
   int gpgpu_warp_issue_shader;
   unsigned gpgpu_num_reg_banks;
   bool gpgpu_reg_bank_use_warp_id;
+  // source slots of the operand reuse cache of a collector unit, 0 for none
+  unsigned gpgpu_operand_reuse_slots;
+  // power gating of idle SMs, see sm_power_gating.h
+  unsigned gpgpu_sm_gating_threshold;
+  unsigned gpgpu_sm_gating_wake_latency;
+  double gpgpu_sm_gating_wake_energy;
   bool gpgpu_local_mem_map;
   bool gpgpu_ignore_resources_limitation;
   bool sub_core_model;
@@ -1711,6 +1860,21 @@ class shader_core_config : public core_config {
   char *specialized_unit_string[SPECIALIZED_UNIT_NUM];
   mutable std::vector<specialized_unit_params> m_specialized_unit;
   unsigned m_specialized_unit_num;
+  int m_rt_spec_unit;  // index of the RT specialized unit, -1 if none
+};
+
+// what a warp class got out of a scheduler's issue slot in a cycle, in
+// increasing order of progress; the best reason of any of the class's warps
+// is counted. Build with CLASS_STALL_STATS=0 to compile the counters out.
+enum class_stall_reason_t {
+  CS_IDLE = 0,     // empty ibuffer or control hazard
+  CS_BARRIER,      // waiting at a barrier, membar or exit
+  CS_SCOREBOARD,   // RAW/WAW hazard on a pending register write
+  CS_EXEC_PIPE,    // ready, but the execution unit issue register was full
+  CS_MEM_PIPE,     // ready, but the ldst issue register was full
+  CS_OTHER_ISSUED, // not reached, a warp of the other class issued first
+  CS_ISSUED,
+  N_CLASS_STALL_REASON
 };
 
 struct shader_core_stats_pod {
@@ -1784,6 +1948,7 @@ struct shader_core_stats_pod {
   unsigned gpu_stall_shd_mem_breakdown[N_MEM_STAGE_ACCESS_TYPE]
                                       [N_MEM_STAGE_STALL_TYPE];
   unsigned gpu_reg_bank_conflict_stalls;
+  unsigned long long gpu_operand_reuse_hits;
   unsigned *shader_cycle_distro;
   unsigned compute_issued;
   unsigned *last_shader_cycle_distro;
@@ -1941,6 +2106,13 @@ class shader_core_stats : public shader_core_stats_pod {
 
     m_shader_dynamic_warp_issue_distro.resize(config->num_shader());
     m_shader_warp_slot_issue_distro.resize(config->num_shader());
+#ifndef NO_CLASS_STALL_STATS
+    m_class_stall.resize(config->num_shader() * 2 * N_CLASS_STALL_REASON, 0);
+    m_last_class_stall = m_class_stall;
+    m_class_mem_stall.resize(config->num_shader() * 2 * N_MEM_STAGE_STALL_TYPE,
+                             0);
+    m_last_class_mem_stall = m_class_mem_stall;
+#endif
   }
 
   ~shader_core_stats() {
@@ -2000,9 +2172,29 @@ class shader_core_stats : public shader_core_stats_pod {
   void event_warp_issued(unsigned s_id, unsigned warp_id, unsigned num_issued,
                          unsigned dynamic_warp_id);
 
+  void event_class_stall(unsigned sid, bool graphics,
+                         class_stall_reason_t reason) {
+#ifndef NO_CLASS_STALL_STATS
+    m_class_stall[(sid * 2 + graphics) * N_CLASS_STALL_REASON + reason]++;
+#endif
+  }
+  void event_class_mem_stall(unsigned sid, bool graphics,
+                             mem_stage_stall_type reason) {
+#ifndef NO_CLASS_STALL_STATS
+    m_class_mem_stall[(sid * 2 + graphics) * N_MEM_STAGE_STALL_TYPE + reason]++;
+#endif
+  }
+
   void visualizer_print(gzFile visualizer_file);
 
   void print(FILE *fout) const;
+  // per class stall counters accumulated since the previous call
+  void print_class_stall(FILE *fout);
+  // a class's issue slots stalled for reason over all SMs since the start,
+  // 0 without the class stall counters
+  unsigned long long class_stall(bool graphics,
+                                 class_stall_reason_t reason) const;
+  static const char *class_stall_name(class_stall_reason_t reason);
 
   const std::vector<std::vector<unsigned>> &get_dynamic_warp_issue() const {
     return m_shader_dynamic_warp_issue_distro;
@@ -2024,6 +2216,13 @@ class shader_core_stats : public shader_core_stats_pod {
   std::vector<std::vector<unsigned>> m_shader_warp_slot_issue_distro;
   std::vector<unsigned> m_last_shader_warp_slot_issue_distro;
 
+  // [sid][graphics][reason], see class_stall_reason_t
+  std::vector<unsigned> m_class_stall;
+  std::vector<unsigned> m_last_class_stall;
+  // [sid][graphics][mem_stage_stall_type] for the warp stalled in the ldst unit
+  std::vector<unsigned> m_class_mem_stall;
+  std::vector<unsigned> m_last_class_mem_stall;
+
   friend class power_stat_t;
   friend class shader_core_ctx;
   friend class ldst_unit;
@@ -2052,9 +2251,8 @@ class shader_core_mem_fetch_allocator : public mem_fetch_allocator {
                    unsigned sid, unsigned tpc, mem_fetch *original_mf) const;
   mem_fetch *alloc(const warp_inst_t &inst, const mem_access_t &access,
                    unsigned long long cycle, unsigned kernel_uid) const {
-    warp_inst_t inst_copy = inst;
     mem_fetch *mf = new mem_fetch(
-        access, &inst_copy,
+        access, &inst,
         access.is_write() ? WRITE_PACKET_SIZE : READ_PACKET_SIZE,
         inst.warp_id(), m_core_id, m_cluster_id, m_memory_config, cycle, kernel_uid);
     return mf;
@@ -2082,7 +2280,17 @@ class shader_core_ctx : public core_t {
   void issue_block2core(class kernel_info_t &kernel);
 
   void cache_flush();
-  void cache_invalidate();
+  // keep_texture leaves the clean graphics texture lines of the L1D
+  void cache_invalidate(bool keep_texture = false);
+  void cache_invalidate_range(new_addr_type addr, unsigned size) {
+    m_ldst_unit->invalidate_range(addr, size);
+  }
+  void set_l1_class_ways(unsigned ways) {
+    m_ldst_unit->set_l1_class_ways(ways);
+  }
+  // functional warm-up of the L1D, returns whether it hit
+  bool warm_l1(new_addr_type addr, mem_access_sector_mask_t mask,
+               bool is_graphics);
   void accept_fetch_response(mem_fetch *mf);
   void accept_ldst_unit_response(class mem_fetch *mf);
   void broadcast_barrier_reduction(unsigned cta_id, unsigned bar_id,
@@ -2106,7 +2314,15 @@ class shader_core_ctx : public core_t {
     else
       return 0;
   }
+  // keeps gpgpu_sim's running-SM worklist in step with this core
+  void update_running();
   kernel_info_t *get_kernel() { return m_kernel; }
+  // kernel finished on every core and is about to be deleted
+  virtual void kernel_released(const kernel_info_t *kernel) {
+    if (m_kernel == kernel) m_kernel = NULL;
+    if (m_running_graphics == kernel) m_running_graphics = NULL;
+    if (m_running_compute == kernel) m_running_compute = NULL;
+  }
   unsigned get_sid() const { return m_sid; }
 
   // used by functional simulation:
@@ -2124,10 +2340,16 @@ class shader_core_ctx : public core_t {
   void mem_instruction_stats(const warp_inst_t &inst);
   void decrement_atomic_count(unsigned wid, unsigned n);
   void inc_store_req(unsigned warp_id) { m_warp[warp_id]->inc_store_req(); }
+  bool warp_is_graphics(unsigned warp_id) const {
+    return m_warp[warp_id]->is_graphics;
+  }
   void dec_inst_in_pipeline(unsigned warp_id) {
     m_warp[warp_id]->dec_inst_in_pipeline();
   }  // also used in writeback()
   void store_ack(class mem_fetch *mf);
+  // whether the access of inst to addr may go on, after the translation of
+  // its page with -gpgpu_tlb, see gpu_mmu.h
+  bool translated(const warp_inst_t &inst, new_addr_type addr);
   bool warp_waiting_at_mem_barrier(unsigned warp_id);
   void set_max_cta(const kernel_info_t &kernel);
   void warp_inst_complete(const warp_inst_t &inst);
@@ -2145,9 +2367,12 @@ class shader_core_ctx : public core_t {
   void get_L1D_sub_stats(unsigned kernel_id, struct cache_sub_stats &css) const;
   void get_L1C_sub_stats(unsigned kernel_id, struct cache_sub_stats &css) const;
   void get_L1T_sub_stats(unsigned kernel_id, struct cache_sub_stats &css) const;
+  void get_RT_L0_sub_stats(unsigned kernel_id,
+                           struct cache_sub_stats &css) const;
   void update_cache_stats_size(unsigned kernel_id) {
     m_L1I->update_stats_size(kernel_id);
     m_ldst_unit->update_cache_stats_size(kernel_id);
+    if (m_rt_unit) m_rt_unit->update_cache_stats_size(kernel_id);
   }
 
   void get_icnt_power_stats(long &n_simt_to_mem, long &n_mem_to_simt) const;
@@ -2375,6 +2600,9 @@ class shader_core_ctx : public core_t {
     m_stats->m_non_rf_operands[m_sid] =
         m_stats->m_non_rf_operands[m_sid] + active_count;
   }
+  void incoperand_reuse_hits() {
+    core_stage_add(m_stats->gpu_operand_reuse_hits, 1ull);
+  }
 
   void incspactivelanes_stat(unsigned active_count) {
     m_stats->m_active_sp_lanes[m_sid] =
@@ -2396,6 +2624,8 @@ class shader_core_ctx : public core_t {
   void inc_simt_to_mem(unsigned n_flits) {
     m_stats->n_simt_to_mem[m_sid] += n_flits;
   }
+  // graphics and compute requests between the SM and the interconnect
+  mem_class_limiter &mem_limiter() { return m_mem_limiter; }
   bool check_if_non_released_reduction_barrier(warp_inst_t &inst);
 
  protected:
@@ -2488,6 +2718,7 @@ class shader_core_ctx : public core_t {
   unsigned m_cta_status[MAX_CTA_PER_SHADER];  // CTAs status
   unsigned m_not_completed;  // number of threads to be completed (==0 when all
                              // thread on this core completed)
+  bool m_running;  // on gpgpu_sim's running-SM worklist
   std::bitset<MAX_THREAD_PER_SM> m_active_threads;
 
   // thread contexts
@@ -2524,6 +2755,7 @@ class shader_core_ctx : public core_t {
   std::vector<simd_function_unit *>
       m_fu;  // stallable pipelines should be last in this array
   ldst_unit *m_ldst_unit;
+  rt_unit *m_rt_unit;  // NULL unless a specialized unit is named RT
   static const unsigned MAX_ALU_LATENCY = 512;
   unsigned num_result_bus;
   std::vector<std::bitset<MAX_ALU_LATENCY> *> m_result_bus;
@@ -2544,6 +2776,8 @@ class shader_core_ctx : public core_t {
   void release_shader_resource_1block(unsigned hw_ctaid, kernel_info_t &kernel);
   int find_available_hwtid(unsigned int cta_size, bool occupy);
   unsigned shader_inst;
+  // committed thread instructions per class, [1] graphics, never reset
+  unsigned long long shader_class_inst[2];
   unsigned int m_occupied_n_threads;
   unsigned int m_occupied_shmem;
   unsigned int m_occupied_regs;
@@ -2554,8 +2788,47 @@ class shader_core_ctx : public core_t {
   unsigned int m_occupied_graphics_ctas;
   kernel_info_t *m_running_graphics;
   kernel_info_t *m_running_compute;
+  // the class quotas of this SM, used over the policy's until unpinned
+  void pin_class_quotas(const sm_resources quota[2]);
+  void unpin_class_quotas();
 
  private:
+  // CTA resource limits of one kernel class given the co-running kernel of
+  // the other class and the current graphics/compute split
+  struct cta_footprint_t {
+    bool valid;
+    // the last non-occupying check failed; cleared when a CTA is issued or
+    // retires, the inputs below changing invalidates it too
+    bool blocked;
+    unsigned kernel_uid;
+    unsigned corunner_uid;
+    unsigned dynamic_sm_count;
+    unsigned concurrent_granularity;
+    bool slicer_sampled;
+    bool graphics_sm;
+
+    const struct gpgpu_ptx_sim_info *kernel_info;
+    unsigned padded_cta_size;
+    unsigned used_regs;
+    // the class quotas the policy set, indexed by is_graphic_kernel
+    sm_resources quota[2];
+
+    bool matches(const kernel_info_t &k, const kernel_info_t *corunner,
+                 const gpgpu_sim *gpu, bool graphics_sm) const;
+  };
+  cta_footprint_t m_cta_footprint[2];  // indexed by is_graphic_kernel
+  void compute_cta_footprint(cta_footprint_t &fp, kernel_info_t &k,
+                             kernel_info_t *corunner);
+  // what one CTA of the kernel occupies
+  sm_resources cta_resources(kernel_info_t &k) const;
+  bool m_quota_pinned;
+  sm_resources m_pinned_quota[2];
+  mem_class_limiter m_mem_limiter;
+  bool fits_shader_resource_1block(kernel_info_t &k, kernel_info_t *corunner,
+                                   bool cached, bool occupy);
+  void clear_cta_footprint_blocks() {
+    m_cta_footprint[0].blocked = m_cta_footprint[1].blocked = false;
+  }
   std::bitset<MAX_THREAD_PER_SM> m_occupied_hwtid;
   std::map<unsigned int, unsigned int> m_occupied_cta_to_hwtid;
   std::vector<unsigned int> m_fu_active_cycle;
@@ -2601,15 +2874,24 @@ class simt_core_cluster {
                     memory_stats_t *mstats);
 
   void core_cycle();
+  // core_cycle() while none of the cores holds a thread
+  void idle_core_cycle();
   void icnt_cycle();
 
   void reinit();
   unsigned issue_block2core();
   void cache_flush();
-  void cache_invalidate();
+  void cache_invalidate(bool keep_texture = false);
+  void cache_invalidate_range(new_addr_type addr, unsigned size);
+  void set_l1_class_ways(unsigned ways);
   bool icnt_injection_buffer_full(unsigned size, bool write);
   void icnt_inject_request_packet(class mem_fetch *mf);
 
+  // while the clusters cycle in parallel, core_cycle() records its effects
+  // on shared state here, flush_core_stage() replays them at the barrier
+  core_stage_log &stage_log() { return m_stage_log; }
+  void flush_core_stage();
+
   // for perfect memory interface
   bool response_queue_full() {
     return (m_response_fifo.size() >= m_config->n_simt_ejection_buffer_size);
@@ -2638,6 +2920,8 @@ class simt_core_cluster {
   void get_L1D_sub_stats(unsigned kernel_id, struct cache_sub_stats &css) const;
   void get_L1C_sub_stats(unsigned kernel_id, struct cache_sub_stats &css) const;
   void get_L1T_sub_stats(unsigned kernel_id, struct cache_sub_stats &css) const;
+  void get_RT_L0_sub_stats(unsigned kernel_id,
+                           struct cache_sub_stats &css) const;
   void update_cache_stats_size(unsigned kernel_id) {
     for (unsigned i = 0; i < m_config->n_simt_cores_per_cluster; ++i) {
       m_core[i]->update_cache_stats_size(kernel_id);
@@ -2663,6 +2947,14 @@ class simt_core_cluster {
   unsigned m_cta_issue_next_core;
   std::list<unsigned> m_core_sim_order;
   std::list<mem_fetch *> m_response_fifo;
+
+ private:
+  void push_request_packet(class mem_fetch *mf);
+
+  core_stage_log m_stage_log;
+  // pushes held in m_stage_log, the injection buffer counts them as queued
+  unsigned m_staged_icnt_packets;
+  unsigned m_staged_icnt_flits;
 };
 
 class exec_simt_core_cluster : public simt_core_cluster {
@@ -2688,8 +2980,12 @@ class shader_memory_interface : public mem_fetch_interface {
   virtual bool full(unsigned size, bool write) const {
     return m_cluster->icnt_injection_buffer_full(size, write);
   }
+  virtual bool class_blocked(bool graphics, unsigned size);
   virtual void push(mem_fetch *mf) {
     m_core->inc_simt_to_mem(mf->get_num_flits(true));
+    // L1 write backs get no reply to retire them
+    m_core->mem_limiter().issued(mf->is_graphics(), mf->size(),
+                                 mf->get_access_type() != L1_WRBK_ACC);
     m_cluster->icnt_inject_request_packet(mf);
   }
 
@@ -0,0 +1,76 @@
+// Bank conflicts of the shared memory accesses of a warp
+// see shmem_banks.h
+
+#include "shmem_banks.h"
+
+// cycles of one part of n active threads
+static unsigned part_accesses(const unsigned *bank, const new_addr_type *word,
+                              unsigned n, bool limited_broadcast) {
+  // first[i]: no thread before i reads the word of thread i. Threads of one
+  // word share its bank
+  bool first[MAX_WARP_SIZE];
+  for (unsigned i = 0; i < n; i++) {
+    bool seen = false;
+    for (unsigned j = 0; j < i; j++) seen |= word[j] == word[i];
+    first[i] = !seen;
+  }
+
+  unsigned max_bank_accesses = 0;
+  if (!limited_broadcast) {
+    // distinct words per bank
+    for (unsigned i = 0; i < n; i++) {
+      if (!first[i]) continue;
+      unsigned words = 0;
+      for (unsigned j = 0; j < n; j++) words += first[j] && bank[j] == bank[i];
+      if (words > max_bank_accesses) max_bank_accesses = words;
+    }
+    return max_bank_accesses;
+  }
+
+  // the broadcast word, the lowest shared one of the lowest bank, saves the
+  // accesses of the threads after its first
+  unsigned broadcast = n;
+  for (unsigned i = 0; i < n; i++) {
+    if (!first[i] &&
+        (broadcast == n || bank[i] < bank[broadcast] ||
+         (bank[i] == bank[broadcast] && word[i] < word[broadcast])))
+      broadcast = i;
+  }
+  unsigned saved = 0;
+  if (broadcast < n) {
+    for (unsigned i = 0; i < n; i++)
+      saved += !first[i] && word[i] == word[broadcast];
+  }
+  for (unsigned i = 0; i < n; i++) {
+    if (!first[i]) continue;
+    unsigned accesses = 0;
+    for (unsigned j = 0; j < n; j++) accesses += bank[j] == bank[i];
+    if (broadcast < n && bank[i] == bank[broadcast]) accesses -= saved;
+    if (accesses > max_bank_accesses) max_bank_accesses = accesses;
+  }
+  return max_bank_accesses;
+}
+
+unsigned shmem_bank_accesses(const core_config *config,
+                             const new_addr_type *addrs,
+                             const active_mask_t &active) {
+  unsigned subwarp_size = config->warp_size / config->mem_warp_parts;
+  unsigned total_accesses = 0;
+  for (unsigned subwarp = 0; subwarp < config->mem_warp_parts; subwarp++) {
+    unsigned bank[MAX_WARP_SIZE];
+    new_addr_type word[MAX_WARP_SIZE];
+    unsigned n = 0;
+    for (unsigned thread = subwarp * subwarp_size;
+         thread < (subwarp + 1) * subwarp_size; thread++) {
+      if (!active.test(thread)) continue;
+      // FIXME: deferred allocation of shared memory should not accumulate
+      // across kernel launches assert( addr < m_config->gpgpu_shmem_size );
+      bank[n] = config->shmem_bank_func(addrs[thread]);
+      word[n] = addrs[thread] / config->shmem_bank_width;
+      n++;
+    }
+    total_accesses +=
+        part_accesses(bank, word, n, config->shmem_limited_broadcast);
+  }
+  return total_accesses;
+}
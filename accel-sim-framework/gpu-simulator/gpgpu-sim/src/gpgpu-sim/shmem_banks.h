@@ -0,0 +1,27 @@
+// Bank conflicts of the shared memory accesses of a warp
+//
+// The warp is split into -gpgpu_shmem_warp_parts parts that go through the
+// banks one after the other. In a part, the addresses map to
+// -gpgpu_shmem_num_banks banks of -gpgpu_shmem_bank_width bytes, and the
+// part takes as many cycles as its busiest bank has distinct words: threads
+// reading the same word get it in one broadcast. With
+// -gpgpu_shmem_limited_broadcast only one word broadcasts per cycle, the
+// first shared word of the lowest bank, and the other threads sharing words
+// count one access each.
+//
+// The degree is computed over fixed arrays of the at most 32 addresses of a
+// part, each thread compared against the others, instead of building a map
+// of the words of every bank.
+
+#ifndef SHMEM_BANKS_H
+#define SHMEM_BANKS_H
+
+#include "../abstract_hardware_model.h"
+
+// cycles the shared memory takes for the active threads of a warp,
+// addrs[t] is the address of thread t
+unsigned shmem_bank_accesses(const core_config *config,
+                             const new_addr_type *addrs,
+                             const active_mask_t &active);
+
+#endif
@@ -0,0 +1,61 @@
+// Wall time spent in the phases of the simulation loop
+
+#include "sim_profiler.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static const char *phase_names[N_SIM_PHASES] = {
+    "core_icnt",     "mem_to_icnt",  "dram",        "l2",
+    "icnt_transfer", "core_cycle",   "controllers", "issue_block2core",
+    "trace_parse",   "trace_decode", "trace_allocate"};
+
+sim_profiler::sim_profiler() {
+  m_period = 0;
+  m_cycles = 0;
+  m_sampled = false;
+  m_cycle_start = 0;
+  m_cycle_ticks = 0;
+  for (unsigned p = 0; p < N_SIM_PHASES; p++) m_ticks[p] = 0;
+  m_start_ticks = 0;
+}
+
+void sim_profiler::enable(unsigned period, unsigned n_clusters) {
+  m_period = period;
+  m_cluster_ticks.assign(n_clusters, 0);
+  m_start_ticks = ticks();
+  m_start_time = std::chrono::steady_clock::now();
+}
+
+unsigned long long sim_profiler::ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+void sim_profiler::print(FILE *fout) const {
+  if (!m_period) return;
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - m_start_time)
+                       .count();
+  unsigned long long elapsed = ticks() - m_start_ticks;
+  double per_sec = seconds > 0 && elapsed ? elapsed / seconds : 1;
+  double cycle_ticks = (double)m_cycle_ticks * m_period;
+
+  fprintf(fout, "gpgpu_self_profile_period = %u\n", m_period);
+  fprintf(fout, "gpgpu_self_profile_wall_sec = %.3f\n", seconds);
+  fprintf(fout, "gpgpu_self_profile_cycle_sec = %.3f\n",
+          cycle_ticks / per_sec);
+  for (unsigned p = 0; p < N_SIM_PHASES; p++)
+    fprintf(fout, "gpgpu_self_profile_%s_sec = %.3f (%.1f%% of the cycles)\n",
+            phase_names[p], m_ticks[p] / per_sec,
+            cycle_ticks ? 100.0 * m_ticks[p] / cycle_ticks : 0.0);
+  for (unsigned c = 0; c < m_cluster_ticks.size(); c++)
+    fprintf(fout, "gpgpu_self_profile_core_cycle_cluster[%u]_sec = %.3f\n", c,
+            m_cluster_ticks[c] / per_sec);
+}
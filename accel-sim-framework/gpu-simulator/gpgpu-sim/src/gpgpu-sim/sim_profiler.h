@@ -0,0 +1,100 @@
+// Wall time spent in the phases of the simulation loop
+//
+// With -gpgpu_self_profile N every Nth call of gpgpu_sim::cycle is timed:
+// the time stamp counter is read around each phase of the cycle and around
+// the trace loading done within it, and those times are scaled by N, so a
+// sampled cycle costs a few counter reads per phase and the others nothing.
+// Loading kernels between cycles is timed on every call. Trace parsing and
+// decoding nest inside the core cycle and CTA issue they happen in, the
+// other phases add up to the timed part of the cycle. The breakdown is
+// printed when the simulation exits.
+
+#ifndef SIM_PROFILER_H
+#define SIM_PROFILER_H
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+enum sim_phase {
+  PHASE_CORE_ICNT = 0,  // cores popping replies from the interconnect
+  PHASE_MEM_TO_ICNT,    // L2 replies pushed into the interconnect
+  PHASE_DRAM,
+  PHASE_L2,
+  PHASE_ICNT_TRANSFER,
+  PHASE_CORE_CYCLE,
+  PHASE_CONTROLLERS,  // the utility, slicer and throttle controllers
+  PHASE_ISSUE_BLOCK,
+  PHASE_TRACE_PARSE,
+  PHASE_TRACE_DECODE,
+  PHASE_TRACE_ALLOCATE,  // the kernel_info of each launch, between cycles
+  N_SIM_PHASES
+};
+
+class sim_profiler {
+ public:
+  sim_profiler();
+
+  void enable(unsigned period, unsigned n_clusters);
+  bool enabled() const { return m_period; }
+  bool sampled() const { return m_sampled; }
+
+  void begin_cycle() {
+    if (!m_period) return;
+    m_sampled = !(m_cycles++ % m_period);
+    if (m_sampled) m_cycle_start = ticks();
+  }
+  void end_cycle() {
+    if (!m_sampled) return;
+    m_cycle_ticks += ticks() - m_cycle_start;
+    m_sampled = false;
+  }
+
+  static unsigned long long ticks();
+  // ticks of a sampled cycle are scaled by the period, ticks timed always
+  // are not
+  void add(sim_phase phase, unsigned long long t, bool always = false) {
+    m_ticks[phase] += always ? t : t * m_period;
+  }
+  void add_cluster(unsigned cluster, unsigned long long t) {
+    m_cluster_ticks[cluster] += t * m_period;
+  }
+
+  void print(FILE *fout) const;
+
+ private:
+  unsigned m_period;
+  unsigned long long m_cycles;
+  bool m_sampled;
+  unsigned long long m_cycle_start;
+  unsigned long long m_cycle_ticks;
+  unsigned long long m_ticks[N_SIM_PHASES];
+  std::vector<unsigned long long> m_cluster_ticks;
+  // to convert ticks into seconds at the end
+  unsigned long long m_start_ticks;
+  std::chrono::steady_clock::time_point m_start_time;
+};
+
+// times its scope in a sampled cycle, or on every call when always is set
+class sim_phase_timer {
+ public:
+  sim_phase_timer(sim_profiler &profiler, sim_phase phase,
+                  bool always = false)
+      : m_profiler(profiler), m_phase(phase), m_always(always) {
+    m_start = profiler.sampled() || (always && profiler.enabled())
+                  ? sim_profiler::ticks()
+                  : 0;
+  }
+  ~sim_phase_timer() {
+    if (m_start)
+      m_profiler.add(m_phase, sim_profiler::ticks() - m_start, m_always);
+  }
+
+ private:
+  sim_profiler &m_profiler;
+  sim_phase m_phase;
+  bool m_always;
+  unsigned long long m_start;
+};
+
+#endif
@@ -0,0 +1,54 @@
+// Fixed set of worker threads that run one indexed loop at a time
+
+#include "sim_thread_pool.h"
+
+namespace {
+
+// busy-wait briefly, then give the core away in case the host is
+// oversubscribed
+void spin_wait(unsigned &spins) {
+  if (++spins < 1024) return;
+  std::this_thread::yield();
+}
+
+}  // namespace
+
+sim_thread_pool::sim_thread_pool(unsigned n_threads)
+    : m_body(NULL), m_items(0), m_generation(0), m_pending(0), m_stop(false) {
+  for (unsigned t = 1; t < n_threads; t++)
+    m_workers.push_back(std::thread(&sim_thread_pool::worker, this, t));
+}
+
+sim_thread_pool::~sim_thread_pool() {
+  m_stop.store(true, std::memory_order_release);
+  for (unsigned t = 0; t < m_workers.size(); t++) m_workers[t].join();
+}
+
+void sim_thread_pool::run(unsigned n_items,
+                          const std::function<void(unsigned)> &body) {
+  m_body = &body;
+  m_items = n_items;
+  m_pending.store(m_workers.size(), std::memory_order_relaxed);
+  m_generation.fetch_add(1, std::memory_order_release);
+  run_share(0);
+  unsigned spins = 0;
+  while (m_pending.load(std::memory_order_acquire)) spin_wait(spins);
+}
+
+void sim_thread_pool::worker(unsigned id) {
+  unsigned generation = 0;
+  while (true) {
+    unsigned spins = 0;
+    while (m_generation.load(std::memory_order_acquire) == generation) {
+      if (m_stop.load(std::memory_order_acquire)) return;
+      spin_wait(spins);
+    }
+    generation++;
+    run_share(id);
+    m_pending.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+void sim_thread_pool::run_share(unsigned id) {
+  for (unsigned i = id; i < m_items; i += size()) (*m_body)(i);
+}
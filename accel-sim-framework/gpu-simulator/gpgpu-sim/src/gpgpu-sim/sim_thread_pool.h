@@ -0,0 +1,36 @@
+// Fixed set of worker threads that run one indexed loop at a time
+//
+// Item i always runs on thread i % size(), with the calling thread taking
+// share 0, and run() returns once every item is done. Workers spin between
+// loops instead of sleeping, so the pool suits loops issued every simulated
+// cycle; it is only worth creating when the host has a core per thread.
+
+#ifndef SIM_THREAD_POOL_H
+#define SIM_THREAD_POOL_H
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+class sim_thread_pool {
+ public:
+  sim_thread_pool(unsigned n_threads);
+  ~sim_thread_pool();
+
+  unsigned size() const { return m_workers.size() + 1; }
+  void run(unsigned n_items, const std::function<void(unsigned)> &body);
+
+ private:
+  void worker(unsigned id);
+  void run_share(unsigned id);
+
+  std::vector<std::thread> m_workers;
+  const std::function<void(unsigned)> *m_body;
+  unsigned m_items;
+  std::atomic<unsigned> m_generation;
+  std::atomic<unsigned> m_pending;
+  std::atomic<bool> m_stop;
+};
+
+#endif
@@ -0,0 +1,97 @@
+// Warped-Slicer partitioning of the SMs between graphics and compute
+
+#include "slicer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+unsigned slicer_sample_share(unsigned index, unsigned cores,
+                             unsigned granularity) {
+  unsigned levels = cores < granularity - 1 ? cores : granularity - 1;
+  if (levels <= 1) return granularity / 2;
+  return 1 + (index % levels) * (granularity - 2) / (levels - 1);
+}
+
+slicer_policy *slicer_policy::create(const char *name) {
+  if (!strcmp(name, "pairs")) return new pair_slicer_policy();
+  if (!strcmp(name, "curve")) return new curve_slicer_policy();
+  return NULL;
+}
+
+unsigned pair_slicer_policy::graphics_share(const std::vector<float> &gr_ipc,
+                                            const std::vector<float> &cp_ipc,
+                                            const std::vector<bool> &feasible,
+                                            float *score, bool verbose) const {
+  unsigned granularity = gr_ipc.size() - 1;
+  unsigned best = 0;
+  float best_score = 0;
+  for (unsigned g = 1; g < granularity; g++) {
+    if (gr_ipc[g] < 0 || !feasible[g]) continue;
+    // the largest sampled compute share that fits next to g
+    for (unsigned c = granularity - g; c > 0; c--) {
+      if (cp_ipc[c] < 0) continue;
+      float s = gr_ipc[g] + cp_ipc[c];
+      if (verbose)
+        printf("slicer: graphics %u + compute %u, ipc = %.2f\n", g, c, s);
+      if (s > best_score) {
+        best = g;
+        best_score = s;
+      }
+      break;
+    }
+  }
+  *score = best_score;
+  return best;
+}
+
+// least squares fit of 1 / ipc = (b / a) / s + 1 / a, false when the
+// samples do not saturate
+static bool fit_curve(const std::vector<float> &ipc, float &a, float &b) {
+  double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (unsigned s = 1; s < ipc.size(); s++) {
+    if (ipc[s] <= 0) continue;
+    double x = 1.0 / s, y = 1.0 / ipc[s];
+    n++;
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+  }
+  double den = n * sxx - sx * sx;
+  if (n < 2 || den <= 0) return false;
+  double slope = (n * sxy - sx * sy) / den;
+  double intercept = (sy - slope * sx) / n;
+  if (intercept <= 0 || slope < 0) return false;
+  a = 1.0 / intercept;
+  b = slope / intercept;
+  return true;
+}
+
+unsigned curve_slicer_policy::graphics_share(const std::vector<float> &gr_ipc,
+                                             const std::vector<float> &cp_ipc,
+                                             const std::vector<bool> &feasible,
+                                             float *score, bool verbose) const {
+  float gr_a, gr_b, cp_a, cp_b;
+  if (!fit_curve(gr_ipc, gr_a, gr_b) || !fit_curve(cp_ipc, cp_a, cp_b)) {
+    if (verbose) printf("slicer: no curve fit, searching sampled pairs\n");
+    return m_fallback.graphics_share(gr_ipc, cp_ipc, feasible, score, verbose);
+  }
+  if (verbose)
+    printf("slicer: graphics ipc = %.2f*s/(%.2f+s), compute ipc = "
+           "%.2f*s/(%.2f+s)\n",
+           gr_a, gr_b, cp_a, cp_b);
+  unsigned granularity = gr_ipc.size() - 1;
+  unsigned best = 0;
+  float best_score = 0;
+  for (unsigned g = 1; g < granularity; g++) {
+    if (!feasible[g]) continue;
+    unsigned c = granularity - g;
+    float s = gr_a * g / (gr_b + g) + cp_a * c / (cp_b + c);
+    if (s > best_score) {
+      best = g;
+      best_score = s;
+    }
+  }
+  *score = best_score;
+  return best;
+}
@@ -0,0 +1,62 @@
+// Warped-Slicer partitioning of the SMs between graphics and compute
+//
+// While sampling, the first half of the cores run only graphics CTAs and the
+// second half only compute CTAs, each core limited to its own share of the
+// core's threads, registers and shared memory (out of the concurrent
+// granularity). The per-share throughput of both classes then goes through a
+// slicer_policy, which picks the graphics share every core runs with until
+// the next sample (Xu et al., Warped-Slicer, ISCA 2016).
+
+#ifndef SLICER_H
+#define SLICER_H
+
+#include <vector>
+
+// the share core `index` of the `cores` sampling a class runs it with, the
+// sampled shares are spread evenly over [1, granularity - 1]
+unsigned slicer_sample_share(unsigned index, unsigned cores,
+                             unsigned granularity);
+
+class slicer_policy {
+ public:
+  virtual ~slicer_policy() {}
+
+  // "pairs" or "curve", NULL for an unknown name
+  static slicer_policy *create(const char *name);
+
+  // graphics share out of gr_ipc.size() - 1, 0 when no feasible split was
+  // sampled. ipc[s] is the per-core thread IPC of the class at share s,
+  // negative when s was not sampled; feasible[g] says whether a graphics
+  // CTA and a compute CTA both fit when graphics gets share g. *score gets
+  // the per-core IPC predicted for the returned split
+  virtual unsigned graphics_share(const std::vector<float> &gr_ipc,
+                                  const std::vector<float> &cp_ipc,
+                                  const std::vector<bool> &feasible,
+                                  float *score, bool verbose) const = 0;
+};
+
+// brute force over the sampled pairs whose shares add up to at most a core
+class pair_slicer_policy : public slicer_policy {
+ public:
+  unsigned graphics_share(const std::vector<float> &gr_ipc,
+                          const std::vector<float> &cp_ipc,
+                          const std::vector<bool> &feasible, float *score,
+                          bool verbose) const;
+};
+
+// fits each class's samples to a saturating scalability curve
+// ipc(s) = a * s / (b + s) and takes the split with the highest sum, so
+// splits that were not sampled as a pair are considered too. Falls back to
+// the pair search when a class has too few samples for a fit
+class curve_slicer_policy : public slicer_policy {
+ public:
+  unsigned graphics_share(const std::vector<float> &gr_ipc,
+                          const std::vector<float> &cp_ipc,
+                          const std::vector<bool> &feasible, float *score,
+                          bool verbose) const;
+
+ private:
+  pair_slicer_policy m_fallback;
+};
+
+#endif
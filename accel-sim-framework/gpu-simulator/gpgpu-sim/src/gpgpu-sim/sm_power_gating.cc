@@ -0,0 +1,104 @@
+// Power gating of idle SMs, see sm_power_gating.h
+
+#include "sm_power_gating.h"
+
+#include <algorithm>
+
+#include "shader.h"
+
+sm_power_gating::sm_power_gating() {
+  m_threshold = 0;
+  m_wake_latency = 0;
+  m_wake_energy = 0;
+  m_sample_start = 0;
+  m_sample_gated = 0;
+  m_sample_wakes = 0;
+  m_gated_cycles = 0;
+  m_idle_cycles = 0;
+  m_wakes = 0;
+}
+
+void sm_power_gating::configure(const shader_core_config *config) {
+  m_threshold = config->gpgpu_sm_gating_threshold;
+  m_wake_latency = config->gpgpu_sm_gating_wake_latency;
+  m_wake_energy = config->gpgpu_sm_gating_wake_energy * 1e-9;
+  sm_state s;
+  s.idle = true;
+  s.waking = false;
+  s.idle_start = 0;
+  s.gate_base = 0;
+  s.wake_done = 0;
+  m_sms.assign(config->num_shader(), s);
+}
+
+void sm_power_gating::idle(unsigned sid, unsigned long long now) {
+  sm_state &s = m_sms[sid];
+  s.idle = true;
+  s.waking = false;
+  s.idle_start = now;
+  s.gate_base = now;
+}
+
+bool sm_power_gating::wake(unsigned sid, unsigned long long now) {
+  sm_state &s = m_sms[sid];
+  if (!s.idle) return true;
+  if (s.waking) {
+    if (now < s.wake_done) return false;
+    // awake, gated again only after a whole idle interval
+    s.waking = false;
+    s.gate_base = s.wake_done;
+    return true;
+  }
+  if (!gated(s, now)) return true;
+  unsigned long long start = s.gate_base + m_threshold;
+  m_gated_cycles += now - start;
+  m_sample_gated += now - std::max(start, m_sample_start);
+  m_wakes++;
+  m_sample_wakes++;
+  if (!m_wake_latency) {
+    s.gate_base = now;
+    return true;
+  }
+  s.waking = true;
+  s.wake_done = now + m_wake_latency;
+  return false;
+}
+
+void sm_power_gating::busy(unsigned sid, unsigned long long now) {
+  sm_state &s = m_sms[sid];
+  if (!s.idle) return;
+  m_idle_cycles += now - s.idle_start;
+  s.idle = false;
+  s.waking = false;
+}
+
+void sm_power_gating::sample(unsigned long long now, double &gated_sms,
+                             double &wake_energy) {
+  unsigned long long cycles = m_sample_gated;
+  for (unsigned i = 0; i < m_sms.size(); i++) {
+    if (gated(m_sms[i], now))
+      cycles += now - std::max(m_sms[i].gate_base + m_threshold, m_sample_start);
+  }
+  gated_sms = now > m_sample_start ? (double)cycles / (now - m_sample_start) : 0;
+  wake_energy = m_sample_wakes * m_wake_energy;
+  m_sample_start = now;
+  m_sample_gated = 0;
+  m_sample_wakes = 0;
+}
+
+void sm_power_gating::print(FILE *fp, unsigned long long now) const {
+  // the SMs still idle count up to now
+  unsigned long long gated_cycles = m_gated_cycles;
+  unsigned long long idle_cycles = m_idle_cycles;
+  for (unsigned i = 0; i < m_sms.size(); i++) {
+    const sm_state &s = m_sms[i];
+    if (!s.idle) continue;
+    idle_cycles += now - s.idle_start;
+    if (gated(s, now)) gated_cycles += now - (s.gate_base + m_threshold);
+  }
+  fprintf(fp, "gpu_sm_gated_cycles = %llu\n", gated_cycles);
+  fprintf(fp, "gpu_sm_clock_gated_idle_cycles = %llu\n",
+          idle_cycles - gated_cycles);
+  fprintf(fp, "gpu_sm_wakes = %llu\n", m_wakes);
+  fprintf(fp, "gpu_sm_wake_energy = %.6e J\n", m_wakes * m_wake_energy);
+}
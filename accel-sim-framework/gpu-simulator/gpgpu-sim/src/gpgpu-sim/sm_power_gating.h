@@ -0,0 +1,82 @@
+// Power gating of idle SMs
+//
+// With -gpgpu_sm_gating_threshold above 0 an SM that has had no CTA for
+// that many cycles is power gated, the threshold being the break-even idle
+// interval past which gating saves more leakage than waking up costs. An
+// SM left without work by MIG, by the slicer or by -gpgpu_mps_sm_count is
+// gated the same way as one idle between kernels. A CTA for a gated SM
+// first wakes it up: the SM takes no CTA for -gpgpu_sm_gating_wake_latency
+// cycles and the wake-up spends -gpgpu_sm_gating_wake_energy nJ. An SM
+// woken up that got no CTA starts its idle interval again.
+//
+// AccelWattch charges a gated SM neither idle core nor static power and
+// adds the wake-up energy of each sample to the idle core power. SMs idle
+// for less than the threshold, or waking up, stay clock gated idle cores.
+
+#ifndef SM_POWER_GATING_H
+#define SM_POWER_GATING_H
+
+#include <stdio.h>
+#include <vector>
+
+class shader_core_config;
+
+class sm_power_gating {
+ public:
+  sm_power_gating();
+
+  void configure(const shader_core_config *config);
+  bool enabled() const { return m_threshold > 0; }
+
+  // the last CTA of SM sid retired at cycle now
+  void sm_idle(unsigned sid, unsigned long long now) {
+    if (m_threshold) idle(sid, now);
+  }
+  // whether SM sid can take a CTA at now, a gated SM starts waking up
+  bool may_issue(unsigned sid, unsigned long long now) {
+    return !m_threshold || wake(sid, now);
+  }
+  // SM sid took a CTA at now
+  void cta_issued(unsigned sid, unsigned long long now) {
+    if (m_threshold) busy(sid, now);
+  }
+
+  // the mean number of gated SMs since the last sample and the J their
+  // wake-ups spent
+  void sample(unsigned long long now, double &gated_sms, double &wake_energy);
+
+  void print(FILE *fp, unsigned long long now) const;
+
+ private:
+  struct sm_state {
+    bool idle;
+    bool waking;
+    unsigned long long idle_start;  // the last CTA retired
+    unsigned long long gate_base;   // the idle interval the threshold counts
+    unsigned long long wake_done;
+  };
+
+  void idle(unsigned sid, unsigned long long now);
+  bool wake(unsigned sid, unsigned long long now);
+  void busy(unsigned sid, unsigned long long now);
+  bool gated(const sm_state &s, unsigned long long now) const {
+    return s.idle && !s.waking && now >= s.gate_base + m_threshold;
+  }
+
+  unsigned long long m_threshold;
+  unsigned long long m_wake_latency;
+  double m_wake_energy;  // J
+  std::vector<sm_state> m_sms;
+
+  unsigned long long m_sample_start;
+  // of the sample, gated SM cycles of the intervals that ended in it
+  unsigned long long m_sample_gated;
+  unsigned long long m_sample_wakes;
+
+  // totals since the start, of the intervals that ended
+  unsigned long long m_gated_cycles;
+  unsigned long long m_idle_cycles;  // gated ones included
+  unsigned long long m_wakes;
+};
+
+#endif
@@ -0,0 +1,85 @@
+// Per-SM resource quotas of the graphics and compute kernel classes
+
+#include "sm_quota.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "slicer.h"
+
+sm_resources sm_resources_share(const sm_resources &r, unsigned share,
+                                unsigned granularity) {
+  sm_resources s;
+  s.threads = r.threads * share / granularity;
+  s.regs = r.regs * share / granularity;
+  s.shmem = r.shmem * share / granularity;
+  s.ctas = r.ctas * share / granularity;
+  return s;
+}
+
+sm_quota_policy *sm_quota_policy::create(const char *name) {
+  if (!strcmp(name, "finegrain")) return new finegrain_quota_policy();
+  if (!strcmp(name, "slicer")) return new slicer_quota_policy();
+  if (!strcmp(name, "mps")) return new mps_quota_policy();
+  return NULL;
+}
+
+unsigned finegrain_quota_policy::quotas(const sm_quota_input &in,
+                                        sm_resources quota[2]) const {
+  const sm_resources &cap = in.capacity;
+  const sm_resources &gr_cta = in.cta[1];
+  const sm_resources &cp_cta = in.cta[0];
+  unsigned share = in.graphics_share;
+  sm_resources gr = sm_resources_share(cap, share, in.granularity);
+  bool limited_regs = true;
+  bool limited_shmem = true;
+  if (gr_cta.threads && cp_cta.threads) {
+    unsigned gr_ctas = gr.threads / gr_cta.threads;
+    unsigned cp_ctas = (cap.threads - gr.threads) / cp_cta.threads;
+    limited_regs = gr_ctas * gr_cta.regs + cp_ctas * cp_cta.regs > cap.regs;
+    limited_shmem =
+        gr_ctas * gr_cta.shmem + cp_ctas * cp_cta.shmem > cap.shmem;
+    // shrink graphics until a compute CTA fits next to it
+    while (m_fit_compute &&
+           ((limited_regs && cp_cta.regs > cap.regs - gr.regs) ||
+            (limited_shmem && cp_cta.shmem > cap.shmem - gr.shmem))) {
+      assert(share > 0);
+      share--;
+      gr = sm_resources_share(cap, share, in.granularity);
+    }
+  }
+  quota[1] = gr;
+  quota[0].threads = cap.threads - gr.threads;
+  quota[0].regs = cap.regs - gr.regs;
+  quota[0].shmem = cap.shmem - gr.shmem;
+  quota[0].ctas = cap.ctas - gr.ctas;
+  if (!limited_regs) quota[0].regs = quota[1].regs = cap.regs;
+  if (!limited_shmem) quota[0].shmem = quota[1].shmem = cap.shmem;
+  return share;
+}
+
+unsigned slicer_quota_policy::quotas(const sm_quota_input &in,
+                                     sm_resources quota[2]) const {
+  if (!in.sampling) return m_split.quotas(in, quota);
+  unsigned half = in.num_shader / 2;
+  bool graphics = in.sid < half;
+  sm_quota_input sample = in;
+  if (graphics) {
+    sample.graphics_share = slicer_sample_share(in.sid, half, in.granularity);
+  } else {
+    sample.graphics_share =
+        in.granularity - slicer_sample_share(in.sid - half,
+                                             in.num_shader - half,
+                                             in.granularity);
+  }
+  m_split.quotas(sample, quota);
+  quota[!graphics] = sm_resources();
+  return in.graphics_share;
+}
+
+unsigned mps_quota_policy::quotas(const sm_quota_input &in,
+                                  sm_resources quota[2]) const {
+  quota[in.graphics_sm] = in.capacity;
+  quota[!in.graphics_sm] = sm_resources();
+  return in.graphics_share;
+}
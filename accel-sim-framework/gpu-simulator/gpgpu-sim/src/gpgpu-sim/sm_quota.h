@@ -0,0 +1,87 @@
+// Per-SM resource quotas of the graphics and compute kernel classes
+//
+// With concurrent kernels on an SM, a CTA is admitted only while its class
+// stays within the class's quota of thread slots, registers, shared memory
+// and CTA slots, and the SM within its capacity. An sm_quota_policy derives
+// the quotas from the graphics/compute split the GPU runs with: finegrain
+// shares every SM, the slicer does too once it has sampled the per-core
+// shares, and MPS gives every SM to one class. gpgpu_sim::set_sm_quota pins
+// the quotas of an SM at runtime instead.
+
+#ifndef SM_QUOTA_H
+#define SM_QUOTA_H
+
+struct sm_resources {
+  unsigned threads;
+  unsigned regs;
+  unsigned shmem;
+  unsigned ctas;
+};
+
+// share / granularity of each resource
+sm_resources sm_resources_share(const sm_resources &r, unsigned share,
+                                unsigned granularity);
+
+// what a policy sees of one SM
+struct sm_quota_input {
+  unsigned sid;
+  unsigned num_shader;
+  sm_resources capacity;
+  // graphics share out of granularity
+  unsigned graphics_share;
+  unsigned granularity;
+  // MPS: the SM belongs to graphics
+  bool graphics_sm;
+  // the slicer has not decided on a split yet
+  bool sampling;
+  // one CTA of the resident or arriving kernel of each class, indexed by
+  // is_graphic_kernel, all zero when the class has none
+  sm_resources cta[2];
+};
+
+class sm_quota_policy {
+ public:
+  virtual ~sm_quota_policy() {}
+
+  // "finegrain", "slicer" or "mps", NULL for an unknown name
+  static sm_quota_policy *create(const char *name);
+
+  // fills quota[1] for graphics and quota[0] for compute, returns the
+  // graphics share they were cut at, below in.graphics_share when it had to
+  // shrink for a compute CTA to fit next to graphics
+  virtual unsigned quotas(const sm_quota_input &in,
+                          sm_resources quota[2]) const = 0;
+};
+
+// each class gets its share of the threads and CTA slots. Registers and
+// shared memory are split only when the CTAs of both kernels at their
+// thread quotas would not fit in them together
+class finegrain_quota_policy : public sm_quota_policy {
+ public:
+  explicit finegrain_quota_policy(bool fit_compute = true)
+      : m_fit_compute(fit_compute) {}
+  unsigned quotas(const sm_quota_input &in, sm_resources quota[2]) const;
+
+ private:
+  bool m_fit_compute;
+};
+
+// while sampling, the first half of the cores runs only graphics and the
+// second half only compute, each core at its own share; the finegrain split
+// at the chosen share after that
+class slicer_quota_policy : public sm_quota_policy {
+ public:
+  slicer_quota_policy() : m_split(false) {}
+  unsigned quotas(const sm_quota_input &in, sm_resources quota[2]) const;
+
+ private:
+  finegrain_quota_policy m_split;
+};
+
+// the whole SM to the class it belongs to, nothing to the other
+class mps_quota_policy : public sm_quota_policy {
+ public:
+  unsigned quotas(const sm_quota_input &in, sm_resources quota[2]) const;
+};
+
+#endif
@@ -39,7 +39,13 @@ enum mem_stage_access_type {
   L_MEM_ST,
   N_MEM_STAGE_ACCESS_TYPE
 };
-enum tlb_request_status { TLB_HIT = 0, TLB_READY, TLB_PENDING };
+// of gpu_mmu::translate
+enum tlb_request_status {
+  TLB_HIT = 0,  // in the L1 TLB
+  TLB_READY,    // the translation the access waited for arrived
+  TLB_PENDING,  // the translation of the page is on its way
+  TLB_MISS      // not in the L1 TLB, the translation started
+};
 enum mem_stage_stall_type {
   NO_RC_FAIL = 0,
   BK_CONF,
@@ -0,0 +1,196 @@
+// Lossless compression of the render targets between the L2 and DRAM, see
+// surface_compression.h
+
+#include "surface_compression.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpu-sim.h"
+#include "mem_fetch.h"
+
+// metadata of the tiles per 32 byte line, four bits each
+static const unsigned META_TILES_PER_LINE = 64;
+
+surface_compression::surface_compression() {
+  m_enabled = false;
+  m_tile = 0;
+}
+
+void surface_compression::configure(const memory_config *config) {
+  m_enabled = config->gpgpu_compression;
+  if (!m_enabled) return;
+  m_tile = config->gpgpu_compression_tile;
+  if (!m_tile || m_tile % SECTOR_SIZE) {
+    printf("GPGPU-Sim: -gpgpu_compression_tile has to be a multiple of %u\n",
+           SECTOR_SIZE);
+    exit(1);
+  }
+
+  float total = 0;
+  for (const char *p = config->gpgpu_compression_ratios; *p;) {
+    float ratio, fraction;
+    int n = 0;
+    if (sscanf(p, "%f:%f%n", &ratio, &fraction, &n) != 2 || ratio < 1 ||
+        fraction < 0) {
+      printf("GPGPU-Sim: -gpgpu_compression_ratios \'%s\' is not a list of "
+             "ratio:fraction, ratios at least 1\n",
+             config->gpgpu_compression_ratios);
+      exit(1);
+    }
+    total += fraction;
+    m_ratios.push_back(std::make_pair(ratio, total));
+    p += n;
+    if (*p == ',') p++;
+  }
+  if (m_ratios.empty() || total <= 0) {
+    printf("GPGPU-Sim: -gpgpu_compression_ratios \'%s\' has no tiles\n",
+           config->gpgpu_compression_ratios);
+    exit(1);
+  }
+  for (unsigned i = 0; i < m_ratios.size(); i++) m_ratios[i].second /= total;
+  m_ratios.back().second = 1;
+
+  for (const char *p = config->gpgpu_compression_surfaces; *p;) {
+    unsigned long long base, size;
+    int n = 0;
+    if (sscanf(p, "%llx:%llx%n", &base, &size, &n) != 2 || !size) {
+      printf("GPGPU-Sim: -gpgpu_compression_surfaces \'%s\' is not a list of "
+             "base:size\n",
+             config->gpgpu_compression_surfaces);
+      exit(1);
+    }
+    std::vector<unsigned char> none;
+    add(base, size, m_tile, none, -1);
+    p += n;
+    if (*p == ',') p++;
+  }
+}
+
+void surface_compression::add(new_addr_type base, new_addr_type size,
+                              unsigned tile,
+                              std::vector<unsigned char> &sectors,
+                              unsigned uid) {
+  if (!tile || tile % SECTOR_SIZE) sectors.clear();
+  surface s;
+  s.base = base;
+  s.size = size;
+  s.tile = sectors.empty() ? m_tile : tile;
+  s.sectors.swap(sectors);
+  if (uid == (unsigned)-1 || m_launched.count(uid))
+    apply(s);
+  else
+    m_pending[uid].push_back(s);
+}
+
+void surface_compression::kernel_launched(unsigned uid) {
+  m_launched.insert(uid);
+  auto p = m_pending.find(uid);
+  if (p == m_pending.end()) return;
+  for (unsigned i = 0; i < p->second.size(); i++) apply(p->second[i]);
+  m_pending.erase(p);
+}
+
+void surface_compression::apply(surface &s) {
+  // the surface replaces the ones it overlaps
+  auto u = m_surfaces.upper_bound(s.base);
+  if (u != m_surfaces.begin()) {
+    auto prev = u;
+    prev--;
+    if (prev->first + prev->second.size > s.base) u = prev;
+  }
+  while (u != m_surfaces.end() && u->first < s.base + s.size)
+    m_surfaces.erase(u++);
+  surface &added = m_surfaces[s.base];
+  added.base = s.base;
+  added.size = s.size;
+  added.tile = s.tile;
+  added.sectors.swap(s.sectors);
+}
+
+unsigned surface_compression::ratio_sectors(new_addr_type tile_addr,
+                                            unsigned tile_sectors) const {
+  // the same ratio for a tile in every run
+  unsigned long long h = tile_addr;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  float u = (h >> 40) * (1.0f / (1 << 24));
+  unsigned r = 0;
+  while (m_ratios[r].second <= u && r + 1 < m_ratios.size()) r++;
+  unsigned sectors = ceil(tile_sectors / m_ratios[r].first);
+  return sectors ? sectors : 1;
+}
+
+bool surface_compression::lookup(new_addr_type addr, unsigned &sectors,
+                                 unsigned &tile_sectors,
+                                 new_addr_type &meta_line) const {
+  auto u = m_surfaces.upper_bound(addr);
+  if (u == m_surfaces.begin()) return false;
+  u--;
+  const surface &s = u->second;
+  if (addr >= s.base + s.size) return false;
+  new_addr_type tile = (addr - s.base) / s.tile;
+  tile_sectors = s.tile / SECTOR_SIZE;
+  if (tile < s.sectors.size())
+    sectors = s.sectors[tile];
+  else if (s.sectors.empty())
+    sectors = ratio_sectors(s.base + tile * s.tile, tile_sectors);
+  else
+    sectors = tile_sectors;
+  meta_line = s.base + tile / META_TILES_PER_LINE;
+  return true;
+}
+
+compression_slice::compression_slice(const memory_config *config,
+                                     const surface_compression &surfaces)
+    : m_config(config), m_surfaces(surfaces) {
+  m_requests = 0;
+  m_raw_bytes = 0;
+  m_dram_bytes = 0;
+  m_bypassed = 0;
+  m_meta_hits = 0;
+  m_meta_misses = 0;
+  m_owed[0] = 0;
+  m_owed[1] = 0;
+}
+
+bool compression_slice::meta_hit(new_addr_type line) {
+  auto m = m_meta.find(line);
+  if (m != m_meta.end()) {
+    m_meta_lru.splice(m_meta_lru.begin(), m_meta_lru, m->second);
+    m_meta_hits++;
+    return true;
+  }
+  m_meta_misses++;
+  if (m_meta.size() == m_config->gpgpu_compression_meta_lines) {
+    m_meta.erase(m_meta_lru.back());
+    m_meta_lru.pop_back();
+  }
+  m_meta_lru.push_front(line);
+  m_meta[line] = m_meta_lru.begin();
+  return false;
+}
+
+unsigned compression_slice::dram_bytes(const mem_fetch *mf) {
+  unsigned sectors, tile_sectors;
+  new_addr_type meta_line;
+  if (!m_surfaces.lookup(mf->get_addr(), sectors, tile_sectors, meta_line))
+    return mf->get_data_size();
+
+  bool write = mf->get_is_write();
+  unsigned atom = m_config->dram_atom_size;
+  m_owed[write] += (double)mf->get_data_size() * sectors / tile_sectors;
+  unsigned bursts = m_owed[write] / atom;
+  m_owed[write] -= bursts * atom;
+  if (m_config->gpgpu_compression_meta_lines && !meta_hit(meta_line))
+    bursts++;
+
+  m_requests++;
+  m_raw_bytes += mf->get_data_size();
+  m_dram_bytes += bursts * atom;
+  if (!bursts) m_bypassed++;
+  return bursts * atom;
+}
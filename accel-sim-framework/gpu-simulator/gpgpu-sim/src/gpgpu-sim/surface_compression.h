@@ -0,0 +1,111 @@
+// Lossless compression of the render targets between the L2 and DRAM
+//
+// With -gpgpu_compression the color and depth surfaces are stored in DRAM
+// as compressed tiles, the L2 keeps them uncompressed. vulkan-sim tags them
+// with an Attachment command in the command list after each fragment
+// kernel, with the compressed size of every tile of the image that kernel
+// left, which applies from the kernel's launch on. Surfaces of
+// -gpgpu_compression_surfaces (base:size in hex, comma separated) and
+// Attachment commands without sizes have tiles of -gpgpu_compression_tile
+// bytes that compress by a ratio of -gpgpu_compression_ratios, a
+// distribution of ratio:fraction pairs a hash of the tile address picks
+// from.
+//
+// A request to a tile moves its share of the tile's compressed size
+// through DRAM. The shares are summed per L2 slice, for reads and writes
+// apart, and a request moves the whole bursts the sum has reached, so one
+// that does not complete a burst needs no DRAM access and its reply comes
+// after -dram_latency from the partition, still decompressed. Writes are
+// taken to cover their tiles, as the ROP writes whole ones. Every L2 slice
+// has a metadata cache of -gpgpu_compression_meta_lines lines of 32 bytes,
+// four bits of metadata per tile, that each request looks up: a miss reads
+// the line with one more burst of the request. 0 lines leaves the metadata
+// out.
+
+#ifndef SURFACE_COMPRESSION_H
+#define SURFACE_COMPRESSION_H
+
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+
+class mem_fetch;
+class memory_config;
+
+class surface_compression {
+ public:
+  surface_compression();
+
+  void configure(const memory_config *config);
+  bool enabled() const { return m_enabled; }
+
+  // an Attachment command, the surface [base, base + size) in tiles of
+  // tile bytes compressed to sectors each, sectors empty for the ratios.
+  // uid is the fragment kernel that wrote it, -1 for none
+  void add(new_addr_type base, new_addr_type size, unsigned tile,
+           std::vector<unsigned char> &sectors, unsigned uid);
+  // kernel uid launched, the surfaces it wrote apply from now on
+  void kernel_launched(unsigned uid);
+
+  // false when addr is in no surface, otherwise the compressed and the
+  // whole size in sectors of its tile, and the metadata line of the tile
+  bool lookup(new_addr_type addr, unsigned &sectors, unsigned &tile_sectors,
+              new_addr_type &meta_line) const;
+
+ private:
+  struct surface {
+    new_addr_type base;
+    new_addr_type size;
+    unsigned tile;
+    std::vector<unsigned char> sectors;  // by tile, empty for the ratios
+  };
+
+  void apply(surface &s);
+  unsigned ratio_sectors(new_addr_type tile_addr, unsigned tile_sectors) const;
+
+  bool m_enabled;
+  unsigned m_tile;
+  // ratio and the fraction of the tiles up to it, the last one 1
+  std::vector<std::pair<float, float> > m_ratios;
+  // by base, disjoint
+  std::map<new_addr_type, surface> m_surfaces;
+  std::unordered_map<unsigned, std::vector<surface> > m_pending;
+  std::unordered_set<unsigned> m_launched;
+};
+
+// the compression of the requests of one L2 slice on their way to DRAM
+class compression_slice {
+ public:
+  compression_slice(const memory_config *config,
+                    const surface_compression &surfaces);
+
+  // bytes the DRAM moves for mf, its data outside the surfaces, 0 when it
+  // needs no DRAM access
+  unsigned dram_bytes(const mem_fetch *mf);
+
+  // totals since the start, of the requests to the surfaces
+  unsigned long long m_requests;
+  unsigned long long m_raw_bytes;
+  unsigned long long m_dram_bytes;
+  unsigned long long m_bypassed;  // with no DRAM access
+  unsigned long long m_meta_hits;
+  unsigned long long m_meta_misses;
+
+ private:
+  bool meta_hit(new_addr_type line);
+
+  const memory_config *m_config;
+  const surface_compression &m_surfaces;
+  double m_owed[2];  // bytes not moved yet, by is_write
+  // metadata lines, most recent first
+  std::list<new_addr_type> m_meta_lru;
+  std::unordered_map<new_addr_type, std::list<new_addr_type>::iterator>
+      m_meta;
+};
+
+#endif
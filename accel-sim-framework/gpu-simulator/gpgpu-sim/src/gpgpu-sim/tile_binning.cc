@@ -0,0 +1,84 @@
+// Tile binning of fragment CTAs
+// see tile_binning.h
+
+#include "tile_binning.h"
+
+tile_binning::tile_binning() {
+  m_window = 0;
+  m_per_tpc = false;
+  m_has_pending = false;
+  m_pending.columns = 0;
+  m_ctas = 0;
+  m_binned_ctas = 0;
+}
+
+void tile_binning::add(unsigned columns, const std::vector<unsigned> &tiles) {
+  m_pending.columns = columns;
+  m_pending.tiles = tiles;
+  m_has_pending = true;
+}
+
+void tile_binning::bind(unsigned uid) {
+  if (!enabled()) return;
+  kernel_tiles &k = m_kernels[uid];
+  if (m_has_pending) {
+    k.columns = m_pending.columns;
+    k.tiles.swap(m_pending.tiles);
+  } else {
+    k.columns = 0;
+  }
+  m_has_pending = false;
+  m_pending.tiles.clear();
+}
+
+unsigned tile_binning::region(const kernel_tiles &k, unsigned ctaid) const {
+  if (!k.columns || ctaid >= k.tiles.size())
+    return ctaid / (m_window * m_window);
+  unsigned x = k.tiles[ctaid] % k.columns / m_window;
+  unsigned y = k.tiles[ctaid] / k.columns / m_window;
+  unsigned regions_per_row = (k.columns + m_window - 1) / m_window;
+  return y * regions_per_row + x;
+}
+
+bool tile_binning::may_issue(const kernel_info_t &k, unsigned cluster,
+                             unsigned sid) const {
+  if (!enabled() || !k.is_graphic_kernel) return true;
+  std::unordered_map<unsigned, kernel_tiles>::const_iterator t =
+      m_kernels.find(k.get_uid());
+  if (t == m_kernels.end()) return true;
+  std::unordered_map<unsigned, binding>::const_iterator b =
+      t->second.regions.find(region(t->second, k.get_next_cta_id_single()));
+  return b == t->second.regions.end() ||
+         b->second.unit == (m_per_tpc ? cluster : sid);
+}
+
+void tile_binning::cta_issued(const kernel_info_t &k, unsigned ctaid,
+                              unsigned cluster, unsigned sid) {
+  if (!enabled() || !k.is_graphic_kernel) return;
+  std::unordered_map<unsigned, kernel_tiles>::iterator t =
+      m_kernels.find(k.get_uid());
+  if (t == m_kernels.end()) return;
+  binding &b = t->second.regions[region(t->second, ctaid)];
+  m_ctas++;
+  if (b.running) {
+    m_binned_ctas++;
+  } else {
+    b.unit = m_per_tpc ? cluster : sid;
+    b.running = 0;
+  }
+  b.running++;
+}
+
+void tile_binning::cta_retired(const kernel_info_t &k, unsigned ctaid) {
+  std::unordered_map<unsigned, kernel_tiles>::iterator t =
+      m_kernels.find(k.get_uid());
+  if (t == m_kernels.end()) return;
+  std::unordered_map<unsigned, binding>::iterator b =
+      t->second.regions.find(region(t->second, ctaid));
+  if (b != t->second.regions.end() && --b->second.running == 0)
+    t->second.regions.erase(b);
+}
+
+void tile_binning::kernel_done(const kernel_info_t &k) {
+  m_kernels.erase(k.get_uid());
+}
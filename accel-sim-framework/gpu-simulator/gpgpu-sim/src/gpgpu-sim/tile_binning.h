@@ -0,0 +1,71 @@
+// Tile binning of fragment CTAs, -gpgpu_tile_binning_window
+//
+// The raster units of a GPU hand the fragments of neighbouring screen tiles
+// to the same SM, so the texels the tiles share stay in its L1. With a
+// window of w the screen is cut into regions of w x w tiles. The tiles come
+// from the FragmentTiles command vulkan-sim writes into the command list
+// before each fragment kernel: for every CTA, the tile of its first
+// fragment. The first CTA of a region issues wherever the cluster round
+// robin puts it and binds the region to that SM, or to its TPC with
+// -gpgpu_tile_binning_tpc; the later CTAs of the region wait for a slot
+// there. A binding only lasts while CTAs of the region run on it, so an SM
+// given to compute by a repartition does not hold a region back for good.
+// Fragment kernels without a FragmentTiles command take w * w consecutive
+// CTAs as a region, the fragments are packed into CTAs in tile order.
+
+#ifndef TILE_BINNING_H
+#define TILE_BINNING_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+
+class tile_binning {
+ public:
+  tile_binning();
+
+  void configure(unsigned window, bool per_tpc) {
+    m_window = window;
+    m_per_tpc = per_tpc;
+  }
+  bool enabled() const { return m_window > 0; }
+
+  // the FragmentTiles command, tiles of the CTAs of the next fragment
+  // kernel on a screen columns tiles wide
+  void add(unsigned columns, const std::vector<unsigned> &tiles);
+  // fragment kernel uid launched, it takes the tiles added since
+  void bind(unsigned uid);
+
+  // whether the next CTA of k may issue on SM sid of cluster cluster
+  bool may_issue(const kernel_info_t &k, unsigned cluster, unsigned sid) const;
+  void cta_issued(const kernel_info_t &k, unsigned ctaid, unsigned cluster,
+                  unsigned sid);
+  void cta_retired(const kernel_info_t &k, unsigned ctaid);
+  void kernel_done(const kernel_info_t &k);
+
+  // totals since the start
+  unsigned long long m_ctas;         // fragment CTAs issued
+  unsigned long long m_binned_ctas;  // of them into an already bound region
+
+ private:
+  struct binding {
+    unsigned unit;
+    unsigned running;
+  };
+  struct kernel_tiles {
+    unsigned columns;  // 0 without a FragmentTiles command
+    std::vector<unsigned> tiles;
+    std::unordered_map<unsigned, binding> regions;
+  };
+
+  unsigned region(const kernel_tiles &k, unsigned ctaid) const;
+
+  unsigned m_window;
+  bool m_per_tpc;
+  bool m_has_pending;
+  kernel_tiles m_pending;
+  std::unordered_map<unsigned, kernel_tiles> m_kernels;  // by kernel uid
+};
+
+#endif
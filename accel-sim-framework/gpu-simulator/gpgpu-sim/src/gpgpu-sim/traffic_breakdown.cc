@@ -18,10 +18,15 @@ void traffic_breakdown::print(FILE* fout) {
     }
     fprintf(fout, "}\n");
   }
+  const char* cls[2] = {"compute", "graphics"};
+  for (unsigned c = 0; c < 2; c++)
+    fprintf(fout, "traffic_breakdown_%s_class[%s] = %llu\n",
+            m_network_name.c_str(), cls[c], m_class_bytes[c]);
 }
 
 void traffic_breakdown::record_traffic(class mem_fetch* mf, unsigned int size) {
   m_stats[classify_memfetch(mf)][size] += 1;
+  m_class_bytes[mf->is_graphics()] += size;
 }
 
 std::string traffic_breakdown::classify_memfetch(class mem_fetch* mf) {
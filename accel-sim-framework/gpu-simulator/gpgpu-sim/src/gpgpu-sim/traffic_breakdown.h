@@ -8,7 +8,9 @@
 class traffic_breakdown {
  public:
   traffic_breakdown(const std::string& network_name)
-      : m_network_name(network_name) {}
+      : m_network_name(network_name) {
+    m_class_bytes[0] = m_class_bytes[1] = 0;
+  }
 
   // print the stats
   void print(FILE* fout);
@@ -32,4 +34,5 @@ class traffic_breakdown {
   typedef std::map<mf_packet_type, traffic_class_t> traffic_stat_t;
 
   traffic_stat_t m_stats;
+  unsigned long long m_class_bytes[2];  // indexed by is_graphics
 };
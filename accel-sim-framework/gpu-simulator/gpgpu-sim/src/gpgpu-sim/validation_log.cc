@@ -0,0 +1,215 @@
+// Equivalence check of two runs, see validation_log.h
+
+#include "validation_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../abstract_hardware_model.h"
+
+validation_log::validation_log() {
+  m_checked_kernels = 0;
+  m_file = NULL;
+  m_checking = false;
+  m_interval = 0;
+}
+
+validation_log::~validation_log() {
+  if (m_file) fclose(m_file);
+}
+
+void validation_log::configure(const char *record, const char *check,
+                               unsigned interval) {
+  if (record[0] && check[0]) {
+    printf("GPGPU-Sim: -gpgpu_validation_record and -gpgpu_validation_check "
+           "are exclusive\n");
+    exit(1);
+  }
+  if (record[0]) {
+    m_file = fopen(record, "w");
+    if (!m_file) {
+      printf("GPGPU-Sim: cannot write -gpgpu_validation_record %s\n", record);
+      exit(1);
+    }
+    m_interval = interval;
+    fprintf(m_file, "interval %u\n", m_interval);
+  }
+  if (check[0]) {
+    m_checking = true;
+    read_record(check);
+  }
+}
+
+void validation_log::read_record(const char *path) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) {
+    printf("GPGPU-Sim: cannot open -gpgpu_validation_check %s\n", path);
+    exit(1);
+  }
+  char line[4096];
+  record *r = NULL;
+  bool header = false;
+  unsigned n = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    n++;
+    line[strcspn(line, "\r\n")] = 0;
+    unsigned uid;
+    int name;
+    char counter[256];
+    unsigned long long value;
+    checkpoint p;
+    if (!header && sscanf(line, "interval %u", &m_interval) == 1) {
+      header = true;
+    } else if (header && sscanf(line, "kernel %u %n", &uid, &name) == 1) {
+      r = &m_records[uid];
+      r->name = line + name;
+      r->values.clear();
+      r->points.clear();
+    } else if (r && sscanf(line, "counter %255s %llu", counter, &value) == 2) {
+      r->values.push_back(std::make_pair(std::string(counter), value));
+    } else if (r && sscanf(line, "warp %u %u %llu %llx %llu", &p.sid, &p.wid,
+                           &p.insts, &p.hash, &p.cycle) == 5) {
+      r->points[std::make_pair(p.sid, std::make_pair(p.wid, p.insts))] = p;
+    } else if (r && !strcmp(line, "end")) {
+      r = NULL;
+    } else {
+      printf("GPGPU-Sim: -gpgpu_validation_check %s line %u is not a "
+             "validation record\n",
+             path, n);
+      exit(1);
+    }
+  }
+  fclose(fp);
+}
+
+void validation_log::issued(unsigned uid, unsigned sid, unsigned wid,
+                            const warp_inst_t &inst,
+                            unsigned long long cycle) {
+  warp_state &w = m_kernels[uid].warps[sid << 16 | wid];
+  // FNV-1a over the pc, the opcode and the active mask
+  unsigned long long v[3] = {inst.pc, (unsigned long long)inst.op,
+                             inst.get_active_mask().to_ulong()};
+  if (!w.insts) w.hash = 0xcbf29ce484222325ULL;
+  for (unsigned i = 0; i < 3; i++) {
+    for (unsigned b = 0; b < 8; b++) {
+      w.hash ^= (v[i] >> (8 * b)) & 0xff;
+      w.hash *= 0x100000001b3ULL;
+    }
+  }
+  w.insts++;
+  w.cycle = cycle;
+  if (w.insts % m_interval == 0) {
+    checkpoint p = {sid, wid, w.insts, w.hash, cycle};
+    m_kernels[uid].points.push_back(p);
+  }
+}
+
+void validation_log::kernel_done(unsigned uid, const std::string &name,
+                                 const counters &values) {
+  std::vector<checkpoint> points;
+  auto k = m_kernels.find(uid);
+  if (k != m_kernels.end()) {
+    points.swap(k->second.points);
+    for (auto w = k->second.warps.begin(); w != k->second.warps.end(); w++) {
+      if (w->second.insts % m_interval == 0) continue;
+      checkpoint p = {w->first >> 16, w->first & 0xffff, w->second.insts,
+                      w->second.hash, w->second.cycle};
+      points.push_back(p);
+    }
+    m_kernels.erase(k);
+  }
+  if (m_file) write(uid, name, values, points);
+  if (m_checking) check(uid, name, values, points);
+}
+
+void validation_log::write(unsigned uid, const std::string &name,
+                           const counters &values,
+                           const std::vector<checkpoint> &points) {
+  fprintf(m_file, "kernel %u %s\n", uid, name.c_str());
+  for (unsigned i = 0; i < values.size(); i++)
+    fprintf(m_file, "counter %s %llu\n", values[i].first.c_str(),
+            values[i].second);
+  for (unsigned i = 0; i < points.size(); i++)
+    fprintf(m_file, "warp %u %u %llu %llx %llu\n", points[i].sid,
+            points[i].wid, points[i].insts, points[i].hash, points[i].cycle);
+  fprintf(m_file, "end\n");
+  fflush(m_file);
+}
+
+void validation_log::check(unsigned uid, const std::string &name,
+                           const counters &values,
+                           const std::vector<checkpoint> &points) {
+  auto r = m_records.find(uid);
+  if (r == m_records.end()) {
+    printf("GPGPU-Sim: validation: kernel %u \'%s\' is not in the "
+           "reference\n",
+           uid, name.c_str());
+    exit(1);
+  }
+  record &ref = r->second;
+
+  // the earliest checkpoint that differs, or that one run lacks
+  bool diverged = false, in_run = false, in_ref = false;
+  checkpoint run_point, ref_point;
+  unsigned long long first_cycle = 0;
+  for (unsigned i = 0; i < points.size(); i++) {
+    const checkpoint &p = points[i];
+    auto q = ref.points.find(
+        std::make_pair(p.sid, std::make_pair(p.wid, p.insts)));
+    bool found = q != ref.points.end();
+    if (!found || q->second.hash != p.hash) {
+      if (!diverged || p.cycle < first_cycle) {
+        diverged = true;
+        in_run = true;
+        in_ref = found;
+        run_point = p;
+        if (found) ref_point = q->second;
+        first_cycle = p.cycle;
+      }
+    }
+    if (found) ref.points.erase(q);
+  }
+  for (auto q = ref.points.begin(); q != ref.points.end(); q++) {
+    if (!diverged || q->second.cycle < first_cycle) {
+      diverged = true;
+      in_run = false;
+      in_ref = true;
+      ref_point = q->second;
+      first_cycle = q->second.cycle;
+    }
+  }
+  if (diverged) {
+    const checkpoint &p = in_run ? run_point : ref_point;
+    printf("GPGPU-Sim: validation: first divergence in kernel %u \'%s\', SM "
+           "%u warp %u, between its instructions %llu and %llu, ",
+           uid, name.c_str(), p.sid, p.wid,
+           (p.insts - 1) / m_interval * m_interval + 1, p.insts);
+    if (in_run && in_ref)
+      printf("at cycle %llu (reference %llu)\n", run_point.cycle,
+             ref_point.cycle);
+    else if (in_run)
+      printf("at cycle %llu, not in the reference\n", run_point.cycle);
+    else
+      printf("at reference cycle %llu, not in this run\n", ref_point.cycle);
+    exit(1);
+  }
+
+  for (unsigned i = 0; i < values.size() || i < ref.values.size(); i++) {
+    if (i < values.size() && i < ref.values.size() &&
+        values[i] == ref.values[i])
+      continue;
+    if (i < values.size() && i < ref.values.size() &&
+        values[i].first == ref.values[i].first)
+      printf("GPGPU-Sim: validation: first divergence in kernel %u \'%s\', "
+             "%s = %llu (reference %llu)\n",
+             uid, name.c_str(), values[i].first.c_str(), values[i].second,
+             ref.values[i].second);
+    else
+      printf("GPGPU-Sim: validation: kernel %u \'%s\' has counters other "
+             "than the reference\n",
+             uid, name.c_str());
+    exit(1);
+  }
+  m_records.erase(r);
+  m_checked_kernels++;
+}
@@ -0,0 +1,93 @@
+// Equivalence check of two runs
+//
+// A fast path (binary traces, skip-ahead clocking, parallel clusters, ...)
+// must not change what is simulated. The reference configuration runs with
+// -gpgpu_validation_record <file>, which writes a record of every finished
+// kernel: its cycles and instructions and the per-class L1, L2 and DRAM
+// counters, and with -gpgpu_validation_warp_interval N above 0 a hash of
+// the instructions every warp slot of every SM issued, one checkpoint per N
+// instructions and one at the kernel's end. The candidate configuration
+// runs the same workload with -gpgpu_validation_check <file> and compares
+// each kernel against the record as it finishes, taking the interval from
+// the record. The first divergence is reported with the kernel, the SM,
+// the warp and the cycle of the first checkpoint that differs, or with the
+// first counter that differs, and the run stops with exit status 1.
+
+#ifndef VALIDATION_LOG_H
+#define VALIDATION_LOG_H
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class warp_inst_t;
+
+class validation_log {
+ public:
+  typedef std::vector<std::pair<std::string, unsigned long long> > counters;
+
+  validation_log();
+  ~validation_log();
+
+  // an empty path for neither, exits on a file it cannot open or read
+  void configure(const char *record, const char *check, unsigned interval);
+  bool enabled() const { return m_file || m_checking; }
+  // warp_inst() hashes the instructions
+  bool tracks_warps() const { return m_interval != 0; }
+
+  // warp wid of SM sid issued inst of kernel uid at cycle
+  void warp_inst(unsigned uid, unsigned sid, unsigned wid,
+                 const warp_inst_t &inst, unsigned long long cycle) {
+    if (m_interval) issued(uid, sid, wid, inst, cycle);
+  }
+  // kernel uid finished with the counters, in the same order in every run
+  void kernel_done(unsigned uid, const std::string &name,
+                   const counters &values);
+
+  unsigned long long m_checked_kernels;
+
+ private:
+  struct checkpoint {
+    unsigned sid;
+    unsigned wid;
+    unsigned long long insts;  // issued by the slot up to the checkpoint
+    unsigned long long hash;
+    unsigned long long cycle;
+  };
+  struct warp_state {
+    unsigned long long insts;
+    unsigned long long hash;
+    unsigned long long cycle;  // of the last instruction
+  };
+  struct kernel_state {
+    std::unordered_map<unsigned, warp_state> warps;  // by sid << 16 | wid
+    std::vector<checkpoint> points;
+  };
+  struct record {
+    std::string name;
+    counters values;
+    // by sid, wid and instructions
+    std::map<std::pair<unsigned, std::pair<unsigned, unsigned long long> >,
+             checkpoint>
+        points;
+  };
+
+  void issued(unsigned uid, unsigned sid, unsigned wid,
+              const warp_inst_t &inst, unsigned long long cycle);
+  void read_record(const char *path);
+  void write(unsigned uid, const std::string &name, const counters &values,
+             const std::vector<checkpoint> &points);
+  void check(unsigned uid, const std::string &name, const counters &values,
+             const std::vector<checkpoint> &points);
+
+  FILE *m_file;
+  bool m_checking;
+  unsigned m_interval;
+  std::unordered_map<unsigned, kernel_state> m_kernels;  // running, by uid
+  std::unordered_map<unsigned, record> m_records;        // by uid
+};
+
+#endif
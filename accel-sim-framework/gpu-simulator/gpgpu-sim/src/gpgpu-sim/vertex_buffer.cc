@@ -0,0 +1,106 @@
+// Vertex buffers of the draws in flight
+
+#include "vertex_buffer.h"
+
+#include <string>
+
+#include "gpu-sim.h"
+
+static bool is_vertex_kernel(const kernel_info_t &k) {
+  return k.get_name().find("VERTEX") != std::string::npos;
+}
+
+vertex_buffer_manager::vertex_buffer_manager(gpgpu_sim *gpu) {
+  m_gpu = gpu;
+  m_last_vertex_uid = (unsigned)-1;
+  m_prefetched_bytes = 0;
+  m_invalidated_bytes = 0;
+}
+
+void vertex_buffer_manager::add(new_addr_type addr, size_t size,
+                                size_t per_cta) {
+  vertex_buffer_t b;
+  b.addr = addr;
+  b.size = size;
+  b.per_cta = per_cta;
+  m_pending.push_back(b);
+}
+
+void vertex_buffer_manager::bind(unsigned uid, bool vertex) {
+  if (m_kernels.size() <= uid) m_kernels.resize(uid + 1);
+  m_kernels[uid].buffers.swap(m_pending);
+  m_pending.clear();
+  if (vertex)
+    m_last_vertex_uid = uid;
+  else
+    m_kernels[uid].vertex_uid = m_last_vertex_uid;
+}
+
+bool vertex_buffer_manager::cta_slice(const kernel_info_t &k,
+                                      const vertex_buffer_t &b,
+                                      unsigned ctaid, new_addr_type &start,
+                                      size_t &size) const {
+  size = b.per_cta;
+  // I forgot to multi the block dim in vulkan-sim for vertex buffers
+  if (is_vertex_kernel(k)) size *= k.threads_per_cta();
+  start = b.addr + ctaid * size;
+  return size && (ctaid + 1) * size < b.size;
+}
+
+void vertex_buffer_manager::kernel_launched(const kernel_info_t &k) {
+  unsigned uid = k.get_uid();
+  if (!has_buffers(uid) || !is_vertex_kernel(k)) return;
+  // the draw's vertices in one go, the CTAs read all of them
+  const std::vector<vertex_buffer_t> &buffers = m_kernels[uid].buffers;
+  for (unsigned i = 0; i < buffers.size(); i++) {
+    if (!m_gpu->persistence().upload(buffers[i].addr, buffers[i].size))
+      continue;
+    m_gpu->perf_memcpy_to_gpu(buffers[i].addr, buffers[i].size, true);
+    m_prefetched_bytes += buffers[i].size;
+  }
+}
+
+void vertex_buffer_manager::cta_issued(const kernel_info_t &k,
+                                       unsigned ctaid) {
+  unsigned uid = k.get_uid();
+  if (!has_buffers(uid) || is_vertex_kernel(k)) return;
+  const std::vector<vertex_buffer_t> &buffers = m_kernels[uid].buffers;
+  for (unsigned i = 0; i < buffers.size(); i++) {
+    new_addr_type start;
+    size_t size;
+    if (cta_slice(k, buffers[i], ctaid, start, size) &&
+        m_gpu->persistence().upload(start, size)) {
+      m_gpu->perf_memcpy_to_gpu(start, size, true);
+      m_prefetched_bytes += size;
+    }
+  }
+}
+
+void vertex_buffer_manager::cta_retired(const kernel_info_t &k,
+                                        unsigned ctaid) {
+  unsigned uid = k.get_uid();
+  // under -gpgpu_frame_persistence the slices stay for the next frame
+  if (!has_buffers(uid) ||
+      !m_gpu->getShaderCoreConfig()->gpgpu_invalidate_l2 ||
+      m_gpu->persistence().enabled())
+    return;
+  const std::vector<vertex_buffer_t> &buffers = m_kernels[uid].buffers;
+  for (unsigned i = 0; i < buffers.size(); i++) {
+    new_addr_type start;
+    size_t size;
+    if (cta_slice(k, buffers[i], ctaid, start, size)) {
+      m_gpu->invalidate_l2_range(start, size, true);
+      m_invalidated_bytes += size;
+    }
+  }
+}
+
+void vertex_buffer_manager::kernel_done(const kernel_info_t &k) {
+  unsigned uid = k.get_uid();
+  if (uid >= m_kernels.size() || is_vertex_kernel(k)) return;
+  // the draw is over once its fragments are
+  kernel_buffers &frag = m_kernels[uid];
+  if (frag.vertex_uid < m_kernels.size())
+    std::vector<vertex_buffer_t>().swap(m_kernels[frag.vertex_uid].buffers);
+  std::vector<vertex_buffer_t>().swap(frag.buffers);
+}
@@ -0,0 +1,70 @@
+// Vertex buffers of the draws in flight
+//
+// The MemcpyVulkan entries before a graphics kernel in the command list name
+// the buffers it reads: an address range and the bytes of it each CTA
+// reads. A draw is a vertex kernel and the fragment kernels after it. The
+// manager prefetches the whole buffers of a vertex kernel into L2 when it
+// launches, the slice of each fragment CTA when the CTA issues, drops a
+// CTA's slices from L2 when it retires under -gpgpu_invalidate_l2 and forgets
+// the draw when its fragment kernel finishes. -gpgpu_frame_persistence skips
+// the copies of ranges already in L2 and keeps the slices of retired CTAs,
+// see frame_persistence.h.
+
+#ifndef VERTEX_BUFFER_H
+#define VERTEX_BUFFER_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+
+struct vertex_buffer_t {
+  new_addr_type addr;
+  size_t size;
+  // as recorded, see vertex_buffer_manager::cta_slice
+  size_t per_cta;
+};
+
+class gpgpu_sim;
+
+class vertex_buffer_manager {
+ public:
+  explicit vertex_buffer_manager(gpgpu_sim *gpu);
+
+  // a MemcpyVulkan entry of the next graphics kernel
+  void add(new_addr_type addr, size_t size, size_t per_cta);
+  // the entries added since the last bind belong to graphics kernel uid, a
+  // fragment kernel joins the draw of the last vertex kernel
+  void bind(unsigned uid, bool vertex);
+  bool has_buffers(unsigned uid) const {
+    return uid < m_kernels.size() && !m_kernels[uid].buffers.empty();
+  }
+
+  void kernel_launched(const kernel_info_t &k);
+  void cta_issued(const kernel_info_t &k, unsigned ctaid);
+  void cta_retired(const kernel_info_t &k, unsigned ctaid);
+  void kernel_done(const kernel_info_t &k);
+
+  // bytes moved into and dropped from L2 so far
+  unsigned long long m_prefetched_bytes;
+  unsigned long long m_invalidated_bytes;
+
+ private:
+  // [start, start + size) of b that CTA ctaid reads, false when the CTA
+  // reads none of it
+  bool cta_slice(const kernel_info_t &k, const vertex_buffer_t &b,
+                 unsigned ctaid, new_addr_type &start, size_t &size) const;
+
+  gpgpu_sim *m_gpu;
+  std::vector<vertex_buffer_t> m_pending;
+  // indexed by kernel uid
+  struct kernel_buffers {
+    kernel_buffers() : vertex_uid((unsigned)-1) {}
+    std::vector<vertex_buffer_t> buffers;
+    unsigned vertex_uid;  // of the draw, fragment kernels only
+  };
+  std::vector<kernel_buffers> m_kernels;
+  unsigned m_last_vertex_uid;
+};
+
+#endif
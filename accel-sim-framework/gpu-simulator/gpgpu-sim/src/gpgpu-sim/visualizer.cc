@@ -44,10 +44,73 @@
 
 static void time_vector_print_interval2gzfile(gzFile outfile);
 
+// one sample of the -visualizer_binary columns, see visualizer_binary.h
+void gpgpu_sim::visualizer_binary_sample() {
+  static const char *cls[2] = {"compute", "graphics"};
+  visualizer_binary &v = m_visualizer_binary;
+  v.set("cycle", gpu_tot_sim_cycle + gpu_sim_cycle);
+  v.set("insn", gpu_tot_sim_insn + gpu_sim_insn);
+  occupancy_stats occupancy = gpu_occupancy + gpu_tot_occupancy;
+  v.set("warp_slots_filled", occupancy.aggregate_warp_slot_filled);
+  v.set("warp_slots_total", occupancy.aggregate_theoretical_warp_slots);
+  unsigned active_sms = 0;
+  for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++)
+    active_sms += m_cluster[i]->get_n_active_sms();
+  v.set("active_sms", active_sms);
+  v.set("graphics_sms", dynamic_sm_count);
+
+  unsigned long long threads[2] = {0, 0};
+  for (unsigned i = 0; i < m_shader_config->n_simt_clusters; i++) {
+    for (unsigned j = 0; j < m_shader_config->n_simt_cores_per_cluster; j++) {
+      shader_core_ctx *core = m_cluster[i]->get_core(j);
+      threads[1] += core->m_occupied_graphics_threads;
+      threads[0] +=
+          core->m_occupied_n_threads - core->m_occupied_graphics_threads;
+    }
+  }
+  for (unsigned c = 0; c < 2; c++) {
+    std::string name = cls[c];
+    v.set(name + "_thread_insts", class_thread_insts(c));
+    v.set(name + "_occupied_threads", threads[c]);
+    v.set(name + "_l2_accesses", l2_class_accesses[c]);
+    v.set(name + "_l2_hits", l2_class_hits[c]);
+    v.set(name + "_dram_accesses", m_memory_stats->dram_class_accesses[c]);
+    v.set(name + "_dram_bytes", m_memory_stats->dram_class_bytes[c]);
+    for (unsigned r = 0; r < N_CLASS_STALL_REASON; r++) {
+      class_stall_reason_t reason = (class_stall_reason_t)r;
+      v.set(name + "_stall_" + shader_core_stats::class_stall_name(reason),
+            m_shader_stats->class_stall(c, reason));
+    }
+  }
+
+  // the running kernels, a kernel's columns stay at their last values
+  // after it finished
+  for (unsigned i = 0; i < m_running_kernels.size(); i++) {
+    kernel_info_t *k = m_running_kernels[i];
+    if (!k) continue;
+    char name[32];
+    snprintf(name, sizeof(name), "kernel%u_", k->get_uid());
+    std::string prefix = name;
+    v.set(prefix + "graphics", k->is_graphic_kernel);
+    v.set(prefix + "insn", k->get_uid() < gpu_sim_insn_per_kernel.size()
+                               ? gpu_sim_insn_per_kernel[k->get_uid()]
+                               : 0);
+    v.set(prefix + "issued_ctas",
+          std::min((unsigned long long)k->get_next_cta_id_single(),
+                   (unsigned long long)k->num_blocks()));
+    v.set(prefix + "total_ctas", k->num_blocks());
+  }
+  v.end_sample();
+}
+
 void gpgpu_sim::visualizer_printstat(unsigned kernel_id) {
   gzFile visualizer_file = NULL;  // gzFile is basically a pointer to a struct,
                                   // so it is fine to initialize it as NULL
   if (!m_config.g_visualizer_enabled) return;
+  if (m_visualizer_binary.enabled()) {
+    visualizer_binary_sample();
+    return;
+  }
 
   // clean the content of the visualizer log if it is the first time, otherwise
   // attach at the end
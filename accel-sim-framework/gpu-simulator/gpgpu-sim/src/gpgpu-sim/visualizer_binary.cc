@@ -0,0 +1,116 @@
+// Compact binary AerialVision log, see visualizer_binary.h
+
+#include "visualizer_binary.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static void put_u16(std::vector<unsigned char> &b, uint16_t v) {
+  for (unsigned i = 0; i < 2; i++) b.push_back(v >> (8 * i));
+}
+
+static void put_u32(std::vector<unsigned char> &b, uint32_t v) {
+  for (unsigned i = 0; i < 4; i++) b.push_back(v >> (8 * i));
+}
+
+static void put_f64(std::vector<unsigned char> &b, double v) {
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  for (unsigned i = 0; i < 8; i++) b.push_back(bits >> (8 * i));
+}
+
+static void put_name(std::vector<unsigned char> &b, const std::string &name) {
+  put_u16(b, name.size());
+  b.insert(b.end(), name.begin(), name.end());
+}
+
+void visualizer_binary::add_constant(const char *name, double value) {
+  assert(!enabled());
+  m_constants.push_back(std::make_pair(std::string(name), value));
+}
+
+bool visualizer_binary::open(const char *path, int zlevel,
+                             unsigned samples_per_block) {
+  assert(!enabled() && samples_per_block);
+  char mode[8] = "wb";
+  if (zlevel >= 0 && zlevel <= 9) snprintf(mode, sizeof(mode), "wb%d", zlevel);
+  m_file = gzopen(path, mode);
+  if (!m_file) return false;
+  m_block = samples_per_block;
+  m_bytes.clear();
+  m_bytes.insert(m_bytes.end(), "GSVISBN1", "GSVISBN1" + 8);
+  put_u32(m_bytes, VISUALIZER_BINARY_VERSION);
+  put_u32(m_bytes, m_constants.size());
+  for (unsigned i = 0; i < m_constants.size(); i++) {
+    put_name(m_bytes, m_constants[i].first);
+    put_f64(m_bytes, m_constants[i].second);
+  }
+  gzwrite(m_file, m_bytes.data(), m_bytes.size());
+  gzflush(m_file, Z_SYNC_FLUSH);
+  return true;
+}
+
+void visualizer_binary::set(const std::string &name, double value) {
+  std::map<std::string, unsigned>::iterator it = m_column_index.find(name);
+  unsigned c;
+  if (it == m_column_index.end()) {
+    c = m_names.size();
+    m_column_index[name] = c;
+    m_names.push_back(name);
+    m_columns.push_back(std::vector<double>());
+    m_set_in_block.push_back(false);
+    m_last.push_back(0);
+  } else {
+    c = it->second;
+  }
+  std::vector<double> &col = m_columns[c];
+  double prev = col.empty() ? m_last[c] : col.back();
+  col.resize(m_samples + 1, prev);
+  col[m_samples] = value;
+  m_set_in_block[c] = true;
+}
+
+void visualizer_binary::end_sample() {
+  m_samples++;
+  // the columns not set in this sample repeat their previous value
+  for (unsigned c = 0; c < m_columns.size(); c++) {
+    std::vector<double> &col = m_columns[c];
+    if (col.size() < m_samples) {
+      double prev = col.empty() ? m_last[c] : col.back();
+      col.resize(m_samples, prev);
+    }
+  }
+  if (m_samples == m_block) flush();
+}
+
+void visualizer_binary::flush() {
+  if (!m_samples) return;
+  unsigned n_columns = 0;
+  for (unsigned c = 0; c < m_columns.size(); c++)
+    n_columns += m_set_in_block[c];
+  m_bytes.clear();
+  put_u32(m_bytes, m_samples);
+  put_u32(m_bytes, n_columns);
+  for (unsigned c = 0; c < m_columns.size(); c++) {
+    if (!m_set_in_block[c]) continue;
+    put_name(m_bytes, m_names[c]);
+    for (unsigned s = 0; s < m_samples; s++) put_f64(m_bytes, m_columns[c][s]);
+  }
+  gzwrite(m_file, m_bytes.data(), m_bytes.size());
+  gzflush(m_file, Z_SYNC_FLUSH);
+  m_samples = 0;
+  for (unsigned c = 0; c < m_columns.size(); c++) {
+    m_last[c] = m_columns[c].back();
+    m_columns[c].clear();
+    m_set_in_block[c] = false;
+  }
+}
+
+void visualizer_binary::close() {
+  if (!enabled()) return;
+  flush();
+  gzclose(m_file);
+  m_file = NULL;
+}
@@ -0,0 +1,63 @@
+// Compact binary AerialVision log
+//
+// With -visualizer_binary the visualizer samples go to this columnar gzip
+// file instead of the text log. The file stays open; samples are buffered
+// in memory and every block of them is compressed in one write, so a sample
+// costs the copy of its values instead of a gzopen, a formatted line per
+// stat and a gzclose. The file is the magic "GSVISBN1", a 32 bit version,
+// a 32 bit count and that many constants of the run (a 16 bit name length,
+// the name and a double), then blocks: a 32 bit sample count, a 32 bit
+// column count and for each column its 16 bit name length, name and one
+// double per sample. All fields are little-endian. A column not set in a
+// sample repeats its previous value, or is 0 before its first one, and a
+// block leaves out the columns not set in any of its samples. Counters
+// are cumulative; the reader takes the differences. Each block ends with a
+// zlib sync flush, so the blocks up to the last flush can be read while the
+// simulation runs.
+// aerialvision/binaryvis.py reads it.
+
+#ifndef VISUALIZER_BINARY_H
+#define VISUALIZER_BINARY_H
+
+#include <zlib.h>
+#include <map>
+#include <string>
+#include <vector>
+
+static const unsigned VISUALIZER_BINARY_VERSION = 1;
+
+class visualizer_binary {
+ public:
+  visualizer_binary() : m_file(NULL), m_samples(0), m_block(1024) {}
+  ~visualizer_binary() { close(); }
+
+  // constants of the run, all of them are added before open
+  void add_constant(const char *name, double value);
+  // false when path cannot be written. zlevel is the gzip level
+  bool open(const char *path, int zlevel, unsigned samples_per_block = 1024);
+  bool enabled() const { return m_file != NULL; }
+
+  // the values of the sample being taken, then end_sample
+  void set(const std::string &name, double value);
+  void end_sample();
+  // writes the samples taken so far and closes the file
+  void close();
+
+ private:
+  void flush();
+
+  gzFile m_file;
+  std::vector<std::pair<std::string, double> > m_constants;
+  std::map<std::string, unsigned> m_column_index;
+  std::vector<std::string> m_names;
+  // [column][sample] of the block being filled
+  std::vector<std::vector<double> > m_columns;
+  std::vector<bool> m_set_in_block;
+  // the value of each column at the end of the previous block
+  std::vector<double> m_last;
+  std::vector<unsigned char> m_bytes;
+  unsigned m_samples;
+  unsigned m_block;
+};
+
+#endif
@@ -153,6 +153,7 @@ void *gpgpu_sim_thread_concurrent(void *ctx_ptr) {
     ctx->the_gpgpusim->g_sim_active = false;
     pthread_mutex_unlock(&(ctx->the_gpgpusim->g_sim_lock));
   } while (!ctx->the_gpgpusim->g_sim_done);
+  ctx->the_gpgpusim->g_the_gpu->simulation_finished();
 
   printf("GPGPU-Sim: *** simulation thread exiting ***\n");
   fflush(stdout);
@@ -211,8 +212,10 @@ gpgpu_sim *gpgpu_context::gpgpu_ptx_sim_init_perf() {
       opp);  // register GPU microrachitecture options
 
   option_parser_cmdline(opp, sg_argc, sg_argv);  // parse configuration options
-  fprintf(stdout, "GPGPU-Sim: Configuration options:\n\n");
-  option_parser_print(opp, stdout);
+  if (!the_gpgpusim->g_the_gpu_config->quiet_options()) {
+    fprintf(stdout, "GPGPU-Sim: Configuration options:\n\n");
+    option_parser_print(opp, stdout);
+  }
   // Set the Numeric locale to a standard locale where a decimal point is a
   // "dot" not a "comma" so it does the parsing correctly independent of the
   // system environment variables
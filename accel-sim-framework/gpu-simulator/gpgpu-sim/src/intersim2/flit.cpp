@@ -38,7 +38,7 @@
 #include "flit.hpp"
 
 stack<Flit *> Flit::_all;
-stack<Flit *> Flit::_free;
+stack<Flit *, vector<Flit *> > Flit::_free;
 
 ostream& operator<<( ostream& os, const Flit& f )
 {
@@ -85,8 +85,11 @@ void Flit::Reset()
 Flit * Flit::New() {
   Flit * f;
   if(_free.empty()) {
-    f = new Flit;
+    f = new Flit[_block_size];
     _all.push(f);
+    for(int i = _block_size - 1; i > 0; --i) {
+      _free.push(f + i);
+    }
   } else {
     f = _free.top();
     f->Reset();
@@ -101,7 +104,7 @@ void Flit::Free() {
 
 void Flit::FreeAll() {
   while(!_all.empty()) {
-    delete _all.top();
+    delete [] _all.top();
     _all.pop();
   }
 }
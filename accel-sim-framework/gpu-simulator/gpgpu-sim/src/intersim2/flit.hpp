@@ -30,6 +30,7 @@
 
 #include <iostream>
 #include <stack>
+#include <vector>
 
 #include "booksim.hpp"
 #include "outputset.hpp"
@@ -94,8 +95,10 @@ private:
   Flit();
   ~Flit() {}
 
+  // flits are allocated _block_size at a time, _all holds the blocks
+  const static int _block_size = 256;
   static stack<Flit *> _all;
-  static stack<Flit *> _free;
+  static stack<Flit *, vector<Flit *> > _free;
 
 };
 
@@ -264,6 +264,29 @@ void GPUTrafficManager::_GeneratePacket(int source, int stype, int cl, int time,
     << "." << endl;
   }
   
+  // every flit of the packet has the same priority
+  int pri;
+  switch( _pri_type ) {
+    case class_based:
+      pri = _class_priority[cl];
+      assert(pri >= 0);
+      break;
+    case age_based:
+      pri = numeric_limits<int>::max() - time;
+      assert(pri >= 0);
+      break;
+    case sequence_based:
+      pri = numeric_limits<int>::max() - _packet_seq_no[source];
+      assert(pri >= 0);
+      break;
+    default:
+      pri = 0;
+  }
+  // flit ids only grow, so every flit goes in at the end of the maps
+  map<unsigned long long, Flit *> & total_in_flight = _total_in_flight_flits[cl];
+  map<unsigned long long, Flit *> & measured_in_flight = _measured_in_flight_flits[cl];
+  list<Flit *> & input_queue = _input_queue[subnet][source][cl];
+  
   for ( int i = 0; i < size; ++i ) {
     Flit * f  = Flit::New();
     f->id     = _cur_id++;
@@ -277,9 +300,9 @@ void GPUTrafficManager::_GeneratePacket(int source, int stype, int cl, int time,
     f->cl     = cl;
     f->data = data;
     
-    _total_in_flight_flits[f->cl].insert(make_pair(f->id, f));
+    total_in_flight.insert(total_in_flight.end(), make_pair(f->id, f));
     if(record) {
-      _measured_in_flight_flits[f->cl].insert(make_pair(f->id, f));
+      measured_in_flight.insert(measured_in_flight.end(), make_pair(f->id, f));
     }
     
     if(gTrace){
@@ -295,22 +318,7 @@ void GPUTrafficManager::_GeneratePacket(int source, int stype, int cl, int time,
       f->head = false;
       f->dest = -1;
     }
-    switch( _pri_type ) {
-      case class_based:
-        f->pri = _class_priority[cl];
-        assert(f->pri >= 0);
-        break;
-      case age_based:
-        f->pri = numeric_limits<int>::max() - time;
-        assert(f->pri >= 0);
-        break;
-      case sequence_based:
-        f->pri = numeric_limits<int>::max() - _packet_seq_no[source];
-        assert(f->pri >= 0);
-        break;
-      default:
-        f->pri = 0;
-    }
+    f->pri = pri;
     if ( i == ( size - 1 ) ) { // Tail flit
       f->tail = true;
     } else {
@@ -328,7 +336,7 @@ void GPUTrafficManager::_GeneratePacket(int source, int stype, int cl, int time,
       << "." << endl;
     }
     
-    _input_queue[subnet][source][cl].push_back( f );
+    input_queue.push_back( f );
   }
 }
 
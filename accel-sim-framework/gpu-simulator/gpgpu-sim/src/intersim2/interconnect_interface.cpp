@@ -211,16 +211,19 @@ void* InterconnectInterface::Pop(unsigned deviceID)
   if (deviceID < _n_shader)
     subnet = 1;
 
+  if (!_boundary_packets) return NULL;
+  _BoundaryBufferItem* buffers = &_boundary_buffer[_VcIndex(subnet, icntID, 0)];
   int turn = _round_robin_turn[subnet][icntID];
   for (int vc=0;(vc<_vcs) && (data==NULL);vc++) {
-    if (_boundary_buffer[subnet][icntID][turn].HasPacket()) {
-      data = _boundary_buffer[subnet][icntID][turn].PopPacket();
+    if (buffers[turn].HasPacket()) {
+      data = buffers[turn].PopPacket();
     }
     turn++;
     if (turn == _vcs) turn = 0;
   }
   if (data) {
     _round_robin_turn[subnet][icntID] = turn;
+    _boundary_packets--;
   }
 
   return data;
@@ -245,16 +248,8 @@ bool InterconnectInterface::Busy() const
   }
   else
     return true;
-  for (int s = 0; s < _subnets; ++s) {
-    for (unsigned n=0; n < (_n_shader+_n_mem); ++n) {
-      for (int vc=0; vc<_vcs; ++vc) {
-        if (_boundary_buffer[s][n][vc].HasPacket() ) {
-          return true;
-        }
-      }
-    }
-  }
-  return false;
+  // packets only ever go to the nodes of a device
+  return _boundary_packets;
 }
 
 bool InterconnectInterface::HasBuffer(unsigned deviceID, unsigned int size) const
@@ -324,16 +319,20 @@ void InterconnectInterface::Transfer2BoundaryBuffer(int subnet, int output)
 {
   Flit* flit;
   int vc;
+  unsigned index = _VcIndex(subnet, output, 0);
+  _EjectionBufferItem* ejection = &_ejection_buffer[index];
+  _BoundaryBufferItem* boundary = &_boundary_buffer[index];
   for (vc=0; vc<_vcs;vc++) {
 
-    if ( !_ejection_buffer[subnet][output][vc].empty() && _boundary_buffer[subnet][output][vc].Size() < _boundary_buffer_capacity ) {
-      flit = _ejection_buffer[subnet][output][vc].front();
+    if ( !ejection[vc].empty() && boundary[vc].Size() < _boundary_buffer_capacity ) {
+      flit = ejection[vc].front();
       assert(flit);
 
-      _ejection_buffer[subnet][output][vc].pop();
-      _boundary_buffer[subnet][output][vc].PushFlitData( flit->data, flit->tail);
+      ejection[vc].pop();
+      boundary[vc].PushFlitData( flit->data, flit->tail);
+      if (flit->tail) _boundary_packets++;
 
-      _ejected_flit_queue[subnet][output].push(flit); //indicate this flit is already popped from ejection buffer and ready for credit return
+      _ejected_flit_queue[subnet * _buffer_nodes + output].push(flit); //indicate this flit is already popped from ejection buffer and ready for credit return
 
       if ( flit->head ) {
         assert (flit->dest == output);
@@ -344,9 +343,9 @@ void InterconnectInterface::Transfer2BoundaryBuffer(int subnet, int output)
 
 void InterconnectInterface::WriteOutBuffer(int subnet, int output_icntID, Flit*  flit )
 {
-  int vc = flit->vc;
-  assert (_ejection_buffer[subnet][output_icntID][vc].size() < _ejection_buffer_capacity);
-  _ejection_buffer[subnet][output_icntID][vc].push(flit);
+  _EjectionBufferItem& buffer = _ejection_buffer[_VcIndex(subnet, output_icntID, flit->vc)];
+  assert (buffer.size() < _ejection_buffer_capacity);
+  buffer.push(flit);
 }
 
 int InterconnectInterface::GetIcntTime() const
@@ -362,9 +361,10 @@ Stats* InterconnectInterface::GetIcntStats(const string &name) const
 Flit* InterconnectInterface::GetEjectedFlit(int subnet, int node)
 {
   Flit* flit = NULL;
-  if (!_ejected_flit_queue[subnet][node].empty()) {
-    flit = _ejected_flit_queue[subnet][node].front();
-    _ejected_flit_queue[subnet][node].pop();
+  _Ring<Flit*>& ejected = _ejected_flit_queue[subnet * _buffer_nodes + node];
+  if (!ejected.empty()) {
+    flit = ejected.front();
+    ejected.pop();
   }
   return flit;
 }
@@ -372,22 +372,26 @@ Flit* InterconnectInterface::GetEjectedFlit(int subnet, int node)
 void InterconnectInterface::_CreateBuffer()
 {
   unsigned nodes = _net[0]->NumNodes();
+  _buffer_nodes = nodes;
+  _boundary_packets = 0;
 
-  _boundary_buffer.resize(_subnets);
-  _ejection_buffer.resize(_subnets);
+  _boundary_buffer.resize(_subnets * nodes * _vcs);
+  _ejection_buffer.resize(_subnets * nodes * _vcs);
   _round_robin_turn.resize(_subnets);
-  _ejected_flit_queue.resize(_subnets);
+  _ejected_flit_queue.resize(_subnets * nodes);
 
   for (int subnet = 0; subnet < _subnets; ++subnet) {
-    _ejection_buffer[subnet].resize(nodes);
-    _boundary_buffer[subnet].resize(nodes);
     _round_robin_turn[subnet].resize(nodes);
-    _ejected_flit_queue[subnet].resize(nodes);
-
-    for (unsigned node=0;node < nodes;++node){
-      _ejection_buffer[subnet][node].resize(_vcs);
-      _boundary_buffer[subnet][node].resize(_vcs);
-    }
+  }
+  // a boundary buffer holds whole flits up to its capacity, an ejection
+  // buffer up to its own, and each cycle moves at most one flit per vc
+  // into the ejected flit queue of a node
+  for (unsigned i = 0; i < _boundary_buffer.size(); ++i) {
+    _boundary_buffer[i].Reserve(_boundary_buffer_capacity);
+    _ejection_buffer[i].Reserve(_ejection_buffer_capacity);
+  }
+  for (unsigned i = 0; i < _ejected_flit_queue.size(); ++i) {
+    _ejected_flit_queue[i].Reserve(_vcs);
   }
 }
 
@@ -508,15 +512,14 @@ void* InterconnectInterface::_BoundaryBufferItem::PopPacket()
 {
   assert (_packet_n);
   void * data = NULL;
-  void * flit_data = _buffer.front();
+  void * flit_data = _buffer.front().data;
   while (data == NULL) {
-    assert(flit_data == _buffer.front()); //all flits must belong to the same packet
-    if (_tail_flag.front()) {
-      data = _buffer.front();
+    assert(flit_data == _buffer.front().data); //all flits must belong to the same packet
+    if (_buffer.front().tail) {
+      data = _buffer.front().data;
       _packet_n--;
     }
     _buffer.pop();
-    _tail_flag.pop();
   }
   return data;
 }
@@ -525,12 +528,12 @@ void* InterconnectInterface::_BoundaryBufferItem::TopPacket() const
 {
   assert (_packet_n);
   void* data = NULL;
-  void* temp_d = _buffer.front();
+  void* temp_d = _buffer.front().data;
   while (data==NULL) {
-    if (_tail_flag.front()) {
-      data = _buffer.front();
+    if (_buffer.front().tail) {
+      data = _buffer.front().data;
     }
-    assert(temp_d == _buffer.front()); //all flits must belong to the same packet
+    assert(temp_d == _buffer.front().data); //all flits must belong to the same packet
   }
   return data;
 
@@ -538,8 +541,8 @@ void* InterconnectInterface::_BoundaryBufferItem::TopPacket() const
 
 void InterconnectInterface::_BoundaryBufferItem::PushFlitData(void* data,bool is_tail)
 {
-  _buffer.push(data);
-  _tail_flag.push(is_tail);
+  _FlitData flit = {data, is_tail};
+  _buffer.push(flit);
   if (is_tail) {
     _packet_n++;
   }
@@ -76,6 +76,44 @@ public:
   
 protected:
   
+  // FIFO in one power of two allocation, sized for the capacity the buffer
+  // is held to and doubled only if a push ever finds it full
+  template <typename T>
+  class _Ring {
+  public:
+    _Ring():_head(0), _size(0) {}
+    void Reserve(unsigned capacity) {
+      unsigned n = 1;
+      while (n < capacity) n <<= 1;
+      if (n > _data.size()) _Resize(n);
+    }
+    inline bool empty() const { return !_size; }
+    inline unsigned size() const { return _size; }
+    inline T& front() { return _data[_head]; }
+    inline const T& front() const { return _data[_head]; }
+    inline void push(const T& v) {
+      if (_size == _data.size()) _Resize(_data.empty() ? 4 : 2 * _data.size());
+      _data[(_head + _size) & (_data.size() - 1)] = v;
+      ++_size;
+    }
+    inline void pop() {
+      _head = (_head + 1) & (_data.size() - 1);
+      --_size;
+    }
+
+  private:
+    void _Resize(unsigned n) {
+      vector<T> data(n);
+      for (unsigned i = 0; i < _size; ++i)
+        data[i] = _data[(_head + i) & (_data.size() - 1)];
+      _data.swap(data);
+      _head = 0;
+    }
+    vector<T> _data;
+    unsigned _head;
+    unsigned _size;
+  };
+
   class _BoundaryBufferItem {
   public:
     _BoundaryBufferItem():_packet_n(0) {}
@@ -84,25 +122,37 @@ protected:
     void* PopPacket();
     void* TopPacket() const;
     void PushFlitData(void* data,bool is_tail);
+    inline void Reserve(unsigned capacity) { _buffer.Reserve(capacity); }
     
   private:
-    queue<void *> _buffer;
-    queue<bool> _tail_flag;
+    struct _FlitData {
+      void* data;
+      bool tail;
+    };
+    _Ring<_FlitData> _buffer;
     int _packet_n;
   };
-  typedef queue<Flit*> _EjectionBufferItem;
+  typedef _Ring<Flit*> _EjectionBufferItem;
   
   void _CreateBuffer( );
   void _CreateNodeMap(unsigned n_shader, unsigned n_mem, unsigned n_node, int use_map);
   void _DisplayMap(int dim,int count);
   
+  // index of [subnet][node][vc] in the flattened buffers
+  inline unsigned _VcIndex(int subnet, int node, int vc) const {
+    return (subnet * _buffer_nodes + node) * _vcs + vc;
+  }
+
   // size: [subnets][nodes][vcs]
-  vector<vector<vector<_BoundaryBufferItem> > > _boundary_buffer;
+  vector<_BoundaryBufferItem> _boundary_buffer;
   unsigned int _boundary_buffer_capacity;
+  // packets waiting in all the boundary buffers
+  unsigned _boundary_packets;
   // size: [subnets][nodes][vcs]
-  vector<vector<vector<_EjectionBufferItem> > > _ejection_buffer;
+  vector<_EjectionBufferItem> _ejection_buffer;
   // size:[subnets][nodes]
-  vector<vector<queue<Flit* > > > _ejected_flit_queue;
+  vector<_Ring<Flit*> > _ejected_flit_queue;
+  unsigned _buffer_nodes;
   
   unsigned int _ejection_buffer_capacity;
   unsigned int _input_buffer_capacity;
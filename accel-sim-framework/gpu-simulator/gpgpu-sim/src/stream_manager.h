@@ -31,6 +31,7 @@
 
 #include <pthread.h>
 #include <time.h>
+#include <atomic>
 #include <list>
 #include "abstract_hardware_model.h"
 
@@ -44,6 +45,79 @@
 //    unsigned m_pending_streams;
 //};
 
+// Single-producer/single-consumer queue of linked nodes. The consumer only
+// moves m_head on, the producer allocates the nodes and frees the ones the
+// consumer has passed at its next push, so front() stays valid until pop()
+// and the producer can walk the queue while the consumer pops. Several
+// producers have to serialize their pushes
+template <class T>
+class spsc_queue {
+ public:
+  spsc_queue() : m_size(0) {
+    m_first = m_tail = new node();
+    m_head.store(m_first);
+  }
+  ~spsc_queue() {
+    while (m_first) {
+      node *n = m_first;
+      m_first = n->next.load();
+      delete n;
+    }
+  }
+
+  // producer
+  void push(const T &value) {
+    node *head = m_head.load(std::memory_order_acquire);
+    while (m_first != head) {
+      node *n = m_first;
+      m_first = n->next.load(std::memory_order_relaxed);
+      delete n;
+    }
+    node *n = new node();
+    n->value = value;
+    m_tail->next.store(n, std::memory_order_release);
+    m_tail = n;
+    m_size.fetch_add(1, std::memory_order_release);
+  }
+  template <class F>
+  void for_each(F f) const {
+    for (node *n = m_head.load(std::memory_order_acquire)->next.load(
+             std::memory_order_acquire);
+         n; n = n->next.load(std::memory_order_acquire))
+      f(n->value);
+  }
+
+  // any thread
+  bool empty() const { return size() == 0; }
+  size_t size() const { return m_size.load(std::memory_order_acquire); }
+
+  // consumer, not empty
+  T &front() {
+    return m_head.load(std::memory_order_relaxed)
+        ->next.load(std::memory_order_acquire)
+        ->value;
+  }
+  void pop() {
+    node *next = m_head.load(std::memory_order_relaxed)
+                     ->next.load(std::memory_order_acquire);
+    m_head.store(next, std::memory_order_release);
+    m_size.fetch_sub(1, std::memory_order_release);
+  }
+
+ private:
+  struct node {
+    node() : next(NULL) {}
+    T value;
+    std::atomic<node *> next;
+  };
+
+  // the node before the front one, the last one popped
+  std::atomic<node *> m_head;
+  std::atomic<size_t> m_size;
+  node *m_first;  // oldest node not freed yet
+  node *m_tail;
+};
+
 struct CUevent_st {
  public:
   CUevent_st(bool blocking) {
@@ -240,11 +314,13 @@ struct CUstream_st {
   unsigned m_uid;
   static unsigned sm_next_stream_uid;
 
-  std::list<stream_operation> m_operations;
-  bool m_pending;  // front operation has started but not yet completed
+  // the host thread and the device runtime push, the gpu thread pops
+  spsc_queue<stream_operation> m_operations;
+  // front operation has started but not yet completed
+  std::atomic<bool> m_pending;
 
-  pthread_mutex_t m_lock;  // ensure only one host or gpu manipulates stream
-                           // operation at one time
+  pthread_mutex_t m_lock;  // serializes the pushes and print, the gpu thread
+                           // never takes it
 };
 
 class stream_manager {
@@ -268,15 +344,32 @@ class stream_manager {
 
  private:
   void print_impl(FILE *fp);
+  // gpu thread: takes the streams added and destroyed since the last call
+  void apply_stream_changes();
+  // gpu thread: an operation of stream left its queue
+  void retire(CUstream_st *stream);
 
   bool m_cuda_launch_blocking;
   gpgpu_sim *m_gpu;
+  // the gpu thread's streams, the host's and the changes on their way from
+  // one to the other, the host's and the changes under m_lock. A stream
+  // destroyed is deleted once it ran empty
   std::list<CUstream_st *> m_streams;
+  std::list<CUstream_st *> m_host_streams;
+  spsc_queue<std::pair<CUstream_st *, bool> > m_stream_changes;  // true: add
+  std::list<CUstream_st *> m_destroyed;
+  // operations pushed and not retired yet, of all streams and of those but
+  // stream zero
+  std::atomic<unsigned> m_queued;
+  std::atomic<unsigned> m_queued_concurrent;
   std::map<unsigned, CUstream_st *> m_grid_id_to_stream;
   CUstream_st m_stream_zero;
   bool m_service_stream_zero;
-  pthread_mutex_t m_lock;
+  pthread_mutex_t m_lock;  // host side only, the gpu thread never takes it
   std::list<struct CUstream_st *>::iterator m_last_stream;
+  // signalled at every retired operation, for the blocking pushes
+  pthread_mutex_t m_finished_lock;
+  pthread_cond_t m_finished_cond;
 };
 
 #endif
@@ -1,6 +1,8 @@
 // developed by Mahmoud Khairy, Purdue Univ
 // abdallm@purdue.edu
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <math.h>
@@ -12,6 +14,8 @@
 
 #include <execinfo.h>
 #include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "gpgpu_context.h"
 #include "abstract_hardware_model.h"
@@ -23,6 +27,7 @@
 #include "../ISA_Def/trace_opcode.h"
 #include "trace_driven.h"
 #include "../trace-parser/trace_parser.h"
+#include "../trace-parser/trace_loader_trace.h"
 #include "accelsim_version.h"
 
 /* TO DO:
@@ -63,6 +68,17 @@ gpgpu_sim *gpgpu_trace_sim_init_perf_model(int argc, const char *argv[],
                                            gpgpu_context *m_gpgpu_context,
                                            class trace_config *m_config);
 
+// wall time of the startup phases, printed before the first kernel launch
+static std::vector<std::pair<const char *, double>> startup_times;
+static std::chrono::steady_clock::time_point startup_phase_start =
+    std::chrono::steady_clock::now();
+static void startup_phase_done(const char *phase) {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  startup_times.push_back(std::make_pair(
+      phase, std::chrono::duration<double>(now - startup_phase_start).count()));
+  startup_phase_start = now;
+}
+
 trace_kernel_info_t *create_kernel_info( kernel_trace_t* kernel_trace_info,
 		                      gpgpu_context *m_gpgpu_context, class trace_config *config,
 							  trace_parser *parser);
@@ -77,10 +93,51 @@ int main(int argc, const char **argv) {
   gpgpu_sim *m_gpgpu_sim =
       gpgpu_trace_sim_init_perf_model(argc, argv, m_gpgpu_context, &tconfig);
   m_gpgpu_sim->init();
+  startup_phase_done("gpu_init");
+  if (m_gpgpu_sim->get_config().mem_replay()) {
+    // the memory side alone, no trace is read
+    m_gpgpu_sim->run_mem_replay();
+    m_gpgpu_sim->simulation_finished();
+    printf("GPGPU-Sim: *** exit detected ***\n");
+    fflush(stdout);
+    return 0;
+  }
 
   trace_parser tracer(tconfig.get_traces_filename());
 
   tconfig.parse_config();
+  startup_phase_done("trace_config");
+  // prefetching follows file order and parses whole CTAs, CTAs loaded by id
+  // or streamed in warp windows are parsed on demand
+  if (!tconfig.load_ctas_by_id() && !tconfig.get_warp_window())
+    tracer.enable_prefetch(tconfig.get_prefetch_threads(),
+                           tconfig.get_prefetch_depth());
+  bool sweep = tconfig.get_sweep_variants()[0];
+  const char *fork_option =
+      sweep ? "-trace_sweep_variants" : "-trace_fork_cycle";
+  if ((tconfig.get_fork_cycle() || sweep) && !tconfig.load_ctas_by_id() &&
+      !tconfig.get_warp_window() && tconfig.get_prefetch_threads()) {
+    printf("%s can not fork the trace prefetch threads\n", fork_option);
+    exit(1);
+  }
+  if ((tconfig.get_fork_cycle() || sweep) &&
+      m_gpgpu_sim->get_config().counter_sampling()) {
+    printf("%s can not fork the counter sampler thread\n", fork_option);
+    exit(1);
+  }
+  if (tconfig.get_fork_cycle() && sweep) {
+    printf("-trace_fork_cycle and -trace_sweep_variants both fork, use one\n");
+    exit(1);
+  }
+  if (tconfig.get_sample_intervals() && !tconfig.load_ctas_by_id()) {
+    printf("-trace_sample_intervals skips CTAs and needs -trace_tb_index\n");
+    exit(1);
+  }
+  if (tconfig.get_sample_intervals() && tconfig.get_warmup_ctas()) {
+    printf("-trace_warmup_ctas can not be combined with "
+           "-trace_sample_intervals, which has its own warm-up\n");
+    exit(1);
+  }
 
   // for each kernel
   // load file
@@ -92,10 +149,127 @@ int main(int argc, const char **argv) {
   unsigned window_size = concurrent_kernel_sm ? 1024 : 1;
   assert(window_size > 0);
   std::vector<trace_command> commandlist = tracer.parse_commandlist_file();
+  startup_phase_done("commandlist");
+  double startup_sec = 0;
+  for (auto &t : startup_times) {
+    printf("accelsim_startup_%s_sec = %.3f\n", t.first, t.second);
+    startup_sec += t.second;
+  }
+  printf("accelsim_startup_sec = %.3f\n", startup_sec);
   std::vector<trace_command> compute_commands;
   std::vector<trace_command> graphics_commands;
-  std::vector<unsigned long> busy_streams;
   std::vector<trace_kernel_info_t*> kernels_info;
+  kernel_dependency_graph kernel_graph;
+  // with -trace_frame_replay, headers of finished kernels by trace file, to
+  // be reused when the kernel is relaunched
+  std::unordered_map<std::string, std::vector<kernel_trace_t *>>
+      resident_traces;
+  auto retire_trace = [&](kernel_trace_t *trace_info) {
+    if (tconfig.frame_replay()) {
+      tracer.rewind_kernel_trace(trace_info);
+      resident_traces[trace_info->trace_file].push_back(trace_info);
+    } else {
+      tracer.kernel_finalizer(trace_info);
+    }
+  };
+  // a kernel is owned by kernels_info until it is done with: dropped from
+  // the window unlaunched, or finished and its stats printed. Only then is
+  // it deleted with its function info, the kernels left running when the
+  // simulation stops at a limit stay with the cores
+  auto delete_kernel = [&](trace_kernel_info_t *k) {
+    if (k->was_launched()) m_gpgpu_sim->kernel_released(k);
+    delete static_cast<trace_function_info *>(k->entry());
+    delete k;
+  };
+  // -trace_result_cache: baselines of the kernels of isolated runs
+  kernel_result_cache result_cache;
+  if (tconfig.get_result_cache()[0])
+    result_cache.open(tconfig.get_result_cache(), tconfig.get_options_hash());
+  regression_baseline regress;
+  if (!regress.configure(tconfig.get_regress(),
+                         tconfig.get_regress_tolerance(),
+                         g_accelsim_version)) {
+    printf("GPGPU-Sim: -trace_regress \'%s\' is not record:<file> or "
+           "check:<file>, or -trace_regress_tolerance \'%s\' is not "
+           "<cycles percent>:<wall percent>\n",
+           tconfig.get_regress(), tconfig.get_regress_tolerance());
+    exit(1);
+  }
+  bool isolated_run = !tracer.graphics_count || !tracer.compute_count;
+  // -trace_fork_cycle: every variant continues in a child process from the
+  // state reached so far, the parent continues with the base options.
+  // -trace_sweep_variants forks the same way before the first cycle
+  std::vector<pid_t> fork_children;
+  auto fork_variants = [&](const char *variant_list) {
+    std::vector<std::string> variants;
+    std::stringstream ss(variant_list);
+    std::string variant;
+    while (std::getline(ss, variant, ';'))
+      if (variant.find_first_not_of(" ") != std::string::npos)
+        variants.push_back(variant);
+    fflush(stdout);
+    for (unsigned v = 0; v < variants.size(); v++) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        perror("fork");
+        exit(1);
+      }
+      if (pid) {
+        printf("forked variant %u (pid %d) at cycle %llu: %s\n", v, pid,
+               m_gpgpu_sim->gpu_sim_cycle + m_gpgpu_sim->gpu_tot_sim_cycle,
+               variants[v].c_str());
+        fork_children.push_back(pid);
+        continue;
+      }
+      std::string log = std::string(tconfig.get_fork_log()) + "_" +
+                        std::to_string(v) + ".log";
+      if (!freopen(log.c_str(), "w", stdout)) exit(1);
+      printf("variant %u of the run forked at cycle %llu: %s\n", v,
+             m_gpgpu_sim->gpu_sim_cycle + m_gpgpu_sim->gpu_tot_sim_cycle,
+             variants[v].c_str());
+      fork_children.clear();
+      m_gpgpu_sim->restart_after_fork();
+      for (auto k : kernels_info) tracer.reopen_kernel_trace(k->get_trace_info());
+      for (auto &resident : resident_traces)
+        for (auto trace_info : resident.second)
+          tracer.reopen_kernel_trace(trace_info);
+      tconfig.apply_options(variants[v]);
+      if (result_cache.enabled())
+        result_cache.open(tconfig.get_result_cache(),
+                          tconfig.get_options_hash());
+      // SM split options are copied into the simulator at startup
+      if (m_gpgpu_sim->getShaderCoreConfig()->gpgpu_concurrent_kernel_sm &&
+          !m_gpgpu_sim->get_config().gpgpu_slicer &&
+          !m_gpgpu_sim->get_config().gpgpu_sm_repartition)
+        m_gpgpu_sim->dynamic_sm_count =
+            m_gpgpu_sim->concurrent_mode == m_gpgpu_sim->FINEGRAIN
+                ? m_gpgpu_sim->get_config().dynamic_sm_count
+                : m_gpgpu_sim->get_config().mps_sm_count;
+      return;
+    }
+  };
+  bool forked = false;
+  kernel_cycle_model cycle_model;
+  if (tconfig.get_cycle_model_file()[0] &&
+      !cycle_model.load(tconfig.get_cycle_model_file())) {
+    printf("Unable to read kernel cycle model %s\n",
+           tconfig.get_cycle_model_file());
+    exit(1);
+  }
+  if (result_cache.enabled()) {
+    unsigned cached = 0;
+    for (auto &cmd : commandlist) {
+      kernel_result result;
+      if (cmd.m_type != command_type::kernel_launch ||
+          cycle_model.get_cycles(cmd.command_string) ||
+          !result_cache.lookup(cmd.command_string, result))
+        continue;
+      cycle_model.record(cmd.command_string, result.cycles);
+      cached++;
+    }
+    printf("GPGPU-Sim: %u kernel baselines from the result cache %s\n",
+           cached, tconfig.get_result_cache());
+  }
   kernels_info.reserve(window_size);
   printf("%u MESA kernels parsed\n", tracer.graphics_count);
   /*
@@ -171,15 +345,81 @@ int main(int argc, const char **argv) {
   */
   unsigned i = 0;
   unsigned last_launched_vertex = -1;
+  unsigned last_fragment = -1;
   unsigned last_grpahics_stream_id = -1;
+  unsigned last_vertex_ctas = 0;
+  bool graphics_pipeline = m_gpgpu_sim->get_config().gpgpu_graphics_pipeline;
   unsigned launched_mesa = 0;
-  std::vector<unsigned long> kernel_vb_addr;
-  std::vector<unsigned long> kernel_vb_size;
-  std::vector<unsigned long> kernel_per_CTA;
   unsigned finished_computes = 0;
   unsigned finished_graphics = 0;
   bool computes_done = false;
   bool graphics_done = false;
+  unsigned graphics_frames = 1;
+  // -trace_sample_intervals: cycles of the skipped CTAs summed over the
+  // sampled kernels, and the sum of their squared confidence half widths
+  unsigned long long sampled_extra_cycles = 0;
+  double sampled_half_width_sq = 0;
+  // -trace_fast_forward_tail: set once the remaining kernels were skipped,
+  // their modeled cycles are added when the running ones drain
+  bool fast_forward_checked = false;
+  bool fast_forwarding = false;
+  bool fast_forward_graphics = false;  // side being skipped
+  unsigned long long fast_forward_cycles = 0;
+  // -trace_warmup_kernels: kernels warmed up functionally so far, in launch
+  // order
+  unsigned warmed_kernels = 0;
+  // set once -trace_replay_frames frames were launched
+  bool graphics_frames_over = false;
+  // -trace_steady_state_frames: isolated cycles of one iteration of each side
+  // by the cycle model, indexed by is_graphics, and of the kernels finished
+  steady_state_detector steady_state(tconfig.get_steady_state_frames(),
+                                     tconfig.get_steady_state_tolerance());
+  bool steady_state_on = tconfig.get_steady_state_frames() > 0;
+  unsigned long long modeled_cycles[2] = {0, 0};
+  unsigned long long modeled_done[2] = {0, 0};
+  // -gpgpu_copy_engine: by kernel, the copies of its class queued before it,
+  // which it waits for
+  copy_engine &copies = m_gpgpu_sim->copies();
+  std::unordered_map<unsigned, unsigned long long> copy_fence;
+  for (auto &cmd : commandlist) {
+    if (cmd.m_type != command_type::kernel_launch) continue;
+    unsigned long long c = cycle_model.get_cycles(cmd.command_string);
+    steady_state_on = steady_state_on && c;
+    modeled_cycles[cmd.command_string.find("MESA") != std::string::npos] += c;
+  }
+  if (tconfig.get_steady_state_frames() && !steady_state_on)
+    printf("GPGPU-Sim: not stopping at a steady state, kernels missing from "
+           "the cycle model\n");
+  unsigned long long run_start_cycle = m_gpgpu_sim->gpu_tot_sim_cycle;
+  unsigned long long iteration_start_cycle = run_start_cycle;
+  // the relaunched side finished an iteration, whether the run can end. Only
+  // one side is ever relaunched; the other is extrapolated at the rate it
+  // got through its isolated cycles so far
+  auto steady_state_reached = [&](bool relaunched_graphics) {
+    if (!steady_state_on) return false;
+    unsigned long long now =
+        m_gpgpu_sim->gpu_tot_sim_cycle + m_gpgpu_sim->gpu_sim_cycle;
+    bool converged = steady_state.add(now - iteration_start_cycle);
+    iteration_start_cycle = now;
+    bool other = !relaunched_graphics;
+    if (!converged || !modeled_done[other]) return false;
+    double other_slowdown =
+        (double)(now - run_start_cycle) / modeled_done[other];
+    unsigned long long other_end =
+        run_start_cycle + other_slowdown * modeled_cycles[other];
+    const char *side[2] = {"compute", "rendering"};
+    printf("GPGPU-Sim: ** break due to a steady state, %u %s iterations of "
+           "%llu cycles **\n",
+           tconfig.get_steady_state_frames(), side[relaunched_graphics],
+           steady_state.mean());
+    printf("STEP1 - extrapolated %s slowdown : %f, %s slowdown : %f, %s end "
+           "time : %llu\n",
+           side[relaunched_graphics],
+           (double)steady_state.mean() / modeled_cycles[relaunched_graphics],
+           side[other], other_slowdown, side[other], other_end);
+    m_gpgpu_context->the_gpgpusim->g_stream_manager->stop_all_running_kernels();
+    return true;
+  };
   m_gpgpu_sim->start_compute = true;
   unsigned long graphics_stream_id = 0xDEADBEEF; 
   if (finished_graphics == tracer.graphics_count) {
@@ -217,7 +457,25 @@ int main(int argc, const char **argv) {
       m_gpgpu_sim->concurrent_granularity = m_gpgpu_sim->get_config().num_shader();
       m_gpgpu_sim->dynamic_sm_count = m_gpgpu_sim->get_config().num_shader() / 2;
     }
-  while (i < commandlist.size() || !kernels_info.empty()) {
+  // -trace_sweep_variants: the headers of every launch are parsed into
+  // resident_traces before forking, so the processes share them and the
+  // binary trace indexes copy-on-write and none parses them again. Their
+  // streams are closed until the kernel is launched, one file open per
+  // header would run into the descriptor limit
+  if (sweep) {
+    sim_phase_timer timer(m_gpgpu_sim->profiler(), PHASE_TRACE_PARSE, true);
+    for (auto &cmd : commandlist) {
+      if (cmd.m_type != command_type::kernel_launch) continue;
+      kernel_trace_t *trace_info = tracer.parse_kernel_info(cmd.command_string);
+      tracer.rewind_kernel_trace(trace_info);
+      tracer.reopen_kernel_trace(trace_info);
+      resident_traces[cmd.command_string].push_back(trace_info);
+    }
+    fork_variants(tconfig.get_sweep_variants());
+  }
+  // a pending fast-forward still has to pass the done checks below
+  while (i < commandlist.size() || !kernels_info.empty() ||
+         fast_forward_cycles) {
     //gulp up as many commands as possible - either cpu_gpu_mem_copy 
     //or kernel_launch - until the vector "kernels_info" has reached
     //the window_size or we have read every command from commandlist
@@ -236,16 +494,63 @@ int main(int argc, const char **argv) {
           assert(per_CTA != -1);
           // std::cout << "Saving MemcpyVulkan for CTA launch : "
           //           << commandlist[i].command_string << std::endl;
-          kernel_vb_addr.push_back(addre);
-          kernel_vb_size.push_back(Bcount);
-          kernel_per_CTA.push_back(per_CTA);
+          m_gpgpu_sim->vertex_buffers().add(addre, Bcount, per_CTA);
           graphics_commands.push_back(commandlist[i]);
         }
         i++;
+      } else if (commandlist[i].m_type ==
+                 command_type::render_pass_barrier) {
+        kernel_graph.add_barrier();
+        graphics_commands.push_back(commandlist[i]);
+        i++;
+      } else if (commandlist[i].m_type == command_type::fragment_tiles) {
+        if (m_gpgpu_sim->tile_bins().enabled() ||
+            m_gpgpu_sim->multi_gpus().enabled()) {
+          unsigned columns;
+          std::vector<unsigned> tiles;
+          tracer.parse_fragment_tiles(commandlist[i].command_string, columns,
+                                      tiles);
+          if (m_gpgpu_sim->tile_bins().enabled())
+            m_gpgpu_sim->tile_bins().add(columns, tiles);
+          if (m_gpgpu_sim->multi_gpus().enabled())
+            m_gpgpu_sim->multi_gpus().add_tiles(columns, tiles);
+        }
+        graphics_commands.push_back(commandlist[i]);
+        i++;
+      } else if (commandlist[i].m_type == command_type::attachment) {
+        if (m_gpgpu_sim->compression().enabled()) {
+          size_t base, size;
+          unsigned tile;
+          std::vector<unsigned char> sectors;
+          tracer.parse_attachment(commandlist[i].command_string, base, size,
+                                  tile, sectors);
+          // the image the last fragment kernel left
+          m_gpgpu_sim->compression().add(base, size, tile, sectors,
+                                         last_fragment);
+        }
+        graphics_commands.push_back(commandlist[i]);
+        i++;
       } else if (commandlist[i].m_type == command_type::kernel_launch) {
         // Read trace header info for window_size number of kernels
-        kernel_trace_t* kernel_trace_info = tracer.parse_kernel_info(commandlist[i].command_string);
-        kernel_info = create_kernel_info(kernel_trace_info, m_gpgpu_context, &tconfig, &tracer);
+        kernel_trace_t *kernel_trace_info = NULL;
+        if (tconfig.frame_replay() || sweep) {
+          std::vector<kernel_trace_t *> &resident =
+              resident_traces[commandlist[i].command_string];
+          if (!resident.empty()) {
+            kernel_trace_info = resident.back();
+            resident.pop_back();
+          }
+        }
+        if (!kernel_trace_info) {
+          sim_phase_timer timer(m_gpgpu_sim->profiler(), PHASE_TRACE_PARSE,
+                                true);
+          kernel_trace_info = tracer.parse_kernel_info(commandlist[i].command_string);
+        }
+        {
+          sim_phase_timer timer(m_gpgpu_sim->profiler(), PHASE_TRACE_ALLOCATE,
+                                true);
+          kernel_info = create_kernel_info(kernel_trace_info, m_gpgpu_context, &tconfig, &tracer);
+        }
         kernel_info->prerequisite_kernel = -1;
         if (kernel_info->is_graphic_kernel) {
           graphics_commands.push_back(commandlist[i]);
@@ -253,38 +558,54 @@ int main(int argc, const char **argv) {
           if (kernel_info->get_name().find("VERTEX") != std::string::npos) {
             // is vertex shader
             last_launched_vertex = kernel_id;
+            last_vertex_ctas = kernel_info->num_blocks();
             kernel_trace_info->cuda_stream_id = graphics_stream_id;
             last_grpahics_stream_id = graphics_stream_id;
             graphics_stream_id++;
+            // -gpgpu_graphics_pipeline: the fragment kernels of the draw run
+            // in order on a stream of their own, next to the vertex kernel
+            if (graphics_pipeline) {
+              last_grpahics_stream_id = graphics_stream_id;
+              graphics_stream_id++;
+            }
           } else {
             assert(kernel_info->get_name().find("FRAG") != std::string::npos);
             kernel_trace_info->cuda_stream_id = last_grpahics_stream_id;
+            if (graphics_pipeline && last_launched_vertex != (unsigned)-1)
+              m_gpgpu_sim->raster().add_draw(last_launched_vertex,
+                                             last_vertex_ctas, kernel_id,
+                                             kernel_info->num_blocks());
+            // the FragmentTiles entry since the last fragment kernel
+            m_gpgpu_sim->tile_bins().bind(kernel_id);
+            last_fragment = kernel_id;
           }
 
-          // for (auto vb = kernel_vb_size.begin(); vb != kernel_vb_size.end();
-          //      vb++) {
-          //   unsigned byte_per_CTA = *vb / kernel_info->num_blocks();
-          //   if (byte_per_CTA != 0) {
-          //     *vb = byte_per_CTA;
-          //   }
-          // }
-          // save kernel info
-          m_gpgpu_sim->vb_addr[kernel_id] = kernel_vb_addr;
-          m_gpgpu_sim->vb_size[kernel_id] = kernel_vb_size;
-          m_gpgpu_sim->vb_size_per_cta[kernel_id] = kernel_per_CTA;
-          // clear buffers for next kernel
-          kernel_vb_addr.clear();
-          kernel_vb_size.clear();
-          kernel_per_CTA.clear();
+          // the MemcpyVulkan entries since the last graphics kernel
+          m_gpgpu_sim->vertex_buffers().bind(
+              kernel_id,
+              kernel_info->get_name().find("VERTEX") != std::string::npos);
+          // the GPUs the CTAs of the kernel go to
+          m_gpgpu_sim->multi_gpus().bind(
+              kernel_id,
+              kernel_info->get_name().find("VERTEX") == std::string::npos);
         } else {
           assert(kernel_trace_info->cuda_stream_id < 0xDEADBEEF ||
                  kernel_trace_info->cuda_stream_id > 0XDEAFBEEF + 1024);
           kernel_info->prerequisite_kernel = -1;
           compute_commands.push_back(commandlist[i]);
         }
+        if (unsigned long long modeled =
+                cycle_model.get_cycles(commandlist[i].command_string))
+          m_gpgpu_sim->last_frame_kernels_elapsed_time[kernel_info->get_uid()] =
+              modeled;
+        if (copies.enabled())
+          copy_fence[kernel_info->get_uid()] =
+              copies.queued(kernel_info->is_graphic_kernel);
         kernels_info.push_back(kernel_info);
+        kernel_graph.add_kernel(kernel_info);
         m_gpgpu_sim->update_stats_size(kernel_info->get_uid());
-        std::cout << "Header info loaded for kernel command : " << commandlist[i].command_string << std::endl;
+        LOADER_DPRINTF("Header info loaded for kernel command : %s\n",
+                       commandlist[i].command_string.c_str());
         i++;
       }
       else{
@@ -292,41 +613,94 @@ int main(int argc, const char **argv) {
         assert(0 && "Undefined Command");
       }
     }
-    // Launch all kernels within window that are on a stream that isn't already running
-    for (auto k : kernels_info) {
-      bool stream_busy = false;
-      for (auto s: busy_streams) {
-        if (s == k->get_cuda_stream_id())
-          stream_busy = true;
+    // Launch the ready kernels, i.e. those whose stream is not running an
+    // earlier kernel and whose copies are done
+    std::map<unsigned, trace_kernel_info_t *> &ready = kernel_graph.ready();
+    bool copies_held[2] = {false, false};
+    unsigned long long held_fence[2] = {0, 0};
+    for (auto it = ready.begin(); !fast_forwarding && it != ready.end() &&
+                                  m_gpgpu_sim->can_start_kernel();) {
+      trace_kernel_info_t *k = it->second;
+      if (warmed_kernels < tconfig.get_warmup_kernels()) {
+        // in place of the simulation, the kernel is done right away
+        warmed_kernels++;
+        if (k->is_graphic_kernel)
+          m_gpgpu_sim->vertex_buffers().kernel_launched(*k);
+        unsigned ctas = k->functional_warmup(m_gpgpu_sim, k->num_blocks());
+        if (k->is_graphic_kernel) {
+          m_gpgpu_sim->vertex_buffers().kernel_done(*k);
+          m_gpgpu_sim->tile_bins().kernel_done(*k);
+          m_gpgpu_sim->multi_gpus().kernel_done(*k);
+          m_gpgpu_sim->raster().kernel_done(
+              k->get_uid(),
+              m_gpgpu_sim->gpu_sim_cycle + m_gpgpu_sim->gpu_tot_sim_cycle);
+          finished_graphics++;
+        } else {
+          finished_computes++;
+        }
+        printf("GPGPU-Sim: functionally warmed up with kernel %u %s (%u "
+               "CTAs)\n",
+               k->get_uid(), k->get_name().c_str(), ctas);
+        it = ready.erase(it);
+        kernel_graph.kernel_done(k);
+        retire_trace(k->get_trace_info());
+        kernels_info.erase(
+            std::find(kernels_info.begin(), kernels_info.end(), k));
+        delete_kernel(k);
+        continue;
+      }
+      if (tconfig.get_draw_depth()
+              ? kernel_dependency_graph::starts_draw(k) &&
+                    kernel_graph.draws_in_flight() >=
+                        tconfig.get_draw_depth()
+              : launched_mesa ==
+                        m_gpgpu_sim->get_config().get_max_concurrent_kernel() *
+                            3 / 4 &&
+                    k->is_graphic_kernel) {
+        // if ((launched_mesa == 63 && k->is_graphic_kernel)) {
+        ++it;
+        continue;
       }
-      if (!stream_busy && m_gpgpu_sim->can_start_kernel() && !k->was_launched()) {
-        if ((launched_mesa ==
-                 m_gpgpu_sim->get_config().get_max_concurrent_kernel() * 3 /
-                     4 &&
-             k->is_graphic_kernel)) {
-          // if ((launched_mesa == 63 && k->is_graphic_kernel)) {
+      if (copies.enabled()) {
+        bool graphics = k->is_graphic_kernel;
+        unsigned long long fence = copy_fence[k->get_uid()];
+        if (!copies.done(graphics, fence)) {
+          if (!copies_held[graphics] || fence < held_fence[graphics])
+            held_fence[graphics] = fence;
+          copies_held[graphics] = true;
+          ++it;
           continue;
         }
-        std::cout << "launching kernel name: " << k->get_name() << " uid: " << k->get_uid() << std::endl;
-        std::string kernel_name = k->get_name();
-        if (!k->is_graphic_kernel) {
-          m_gpgpu_sim->compute_done = false;
-          m_gpgpu_sim->gipc = 0;
-        } else {
-          // graphics
-          m_gpgpu_sim->cipc = 0;
-          m_gpgpu_sim->graphics_done = false;
-          launched_mesa++;
-        }
-        
-        m_gpgpu_sim->launch(k);
-        k->set_launched();
-        busy_streams.push_back(k->get_cuda_stream_id());
+        copy_fence.erase(k->get_uid());
       }
+      LOADER_DPRINTF("launching kernel name: %s uid: %u\n",
+                     k->get_name().c_str(), k->get_uid());
+      std::string kernel_name = k->get_name();
+      if (!k->is_graphic_kernel) {
+        m_gpgpu_sim->compute_done = false;
+        m_gpgpu_sim->gipc = 0;
+      } else {
+        // graphics
+        m_gpgpu_sim->cipc = 0;
+        m_gpgpu_sim->graphics_done = false;
+        launched_mesa++;
+      }
+      
+      m_gpgpu_sim->launch(k);
+      k->set_launched();
+      if (regress.enabled()) regress.kernel_launched(k->get_uid());
+      kernel_graph.kernel_launched(k);
+      // a kernel with no CTA left to issue would never finish
+      if (tconfig.get_warmup_ctas() && k->num_blocks() > 1)
+        k->functional_warmup(
+            m_gpgpu_sim,
+            std::min<size_t>(tconfig.get_warmup_ctas(), k->num_blocks() - 1));
+      it = ready.erase(it);
     }
 
     bool active = false;
     bool sim_cycles = false;
+    bool copies_landed = false;
     unsigned finished_kernel_uid = 0;
 
     do {
@@ -338,6 +712,12 @@ int main(int argc, const char **argv) {
         m_gpgpu_sim->cycle();
         sim_cycles = true;
         m_gpgpu_sim->deadlock_check();
+        if (!forked && tconfig.get_fork_cycle() &&
+            m_gpgpu_sim->gpu_sim_cycle + m_gpgpu_sim->gpu_tot_sim_cycle >=
+                tconfig.get_fork_cycle()) {
+          forked = true;
+          fork_variants(tconfig.get_fork_variants());
+        }
       } else {
         if (m_gpgpu_sim->cycle_insn_cta_max_hit()) {
           m_gpgpu_context->the_gpgpusim->g_stream_manager
@@ -348,27 +728,70 @@ int main(int argc, const char **argv) {
 
       active = m_gpgpu_sim->active();
       finished_kernel_uid = m_gpgpu_sim->finished_kernel();
-    } while (active && !finished_kernel_uid);
+      // a held kernel launches once its copies are done
+      copies_landed =
+          (copies_held[0] && copies.done(false, held_fence[0])) ||
+          (copies_held[1] && copies.done(true, held_fence[1]));
+    } while (active && !finished_kernel_uid && !copies_landed);
 
+    // nothing left to run is no reason to stop the kernels held on copies
+    bool stopped = !m_gpgpu_sim->active() && !copies_held[0] &&
+                   !copies_held[1];
     // cleanup finished kernel
-    if (finished_kernel_uid || m_gpgpu_sim->cycle_insn_cta_max_hit()
-        || !m_gpgpu_sim->active()) {
+    if (!kernels_info.empty() &&
+        (finished_kernel_uid || m_gpgpu_sim->cycle_insn_cta_max_hit() ||
+         stopped)) {
       trace_kernel_info_t* k = NULL;
+      trace_kernel_info_t *finished = NULL;
       for (unsigned j = 0; j < kernels_info.size(); j++) {
         k = kernels_info.at(j);
         if (k->get_uid() == finished_kernel_uid || m_gpgpu_sim->cycle_insn_cta_max_hit()
-            || !m_gpgpu_sim->active()) {
-          for (int l = 0; l < busy_streams.size(); l++) {
-            if (busy_streams.at(l) == k->get_cuda_stream_id()) {
-              busy_streams.erase(busy_streams.begin()+l);
-              break;
+            || stopped) {
+          kernel_graph.kernel_done(k);
+          if (k->get_uid() == finished_kernel_uid) {
+            unsigned long long cycles = k->end_cycle - k->start_cycle;
+            unsigned long long half_width;
+            if (k->is_sampled() && k->estimate_cycles(cycles, half_width)) {
+              printf("kernel %u %s sampled %u of %zu CTAs, simulated cycles "
+                     "= %llu, estimated cycles = %llu +- %llu (95%% CI)\n",
+                     k->get_uid(), k->get_name().c_str(),
+                     k->num_sampled_ctas(), k->num_blocks(),
+                     k->end_cycle - k->start_cycle, cycles, half_width);
+              sampled_extra_cycles +=
+                  cycles - std::min(cycles, k->end_cycle - k->start_cycle);
+              sampled_half_width_sq += double(half_width) * half_width;
+            }
+            if (k->has_roi())
+              printf("kernel %u %s region of interest: %llu warp "
+                     "instructions outside it stepped over, %llu accesses "
+                     "warmed\n",
+                     k->get_uid(), k->get_name().c_str(),
+                     k->m_roi_skipped_insts, k->m_roi_warmed_accesses);
+            if (steady_state_on)
+              modeled_done[k->is_graphic_kernel] +=
+                  cycle_model.get_cycles(k->get_trace_info()->trace_file);
+            cycle_model.record(k->get_trace_info()->trace_file,
+                               cycles + k->m_launch_latency);
+            if (regress.enabled())
+              regress.kernel_done(
+                  k->get_uid(), k->get_trace_info()->trace_file,
+                  cycles + k->m_launch_latency,
+                  m_gpgpu_sim->gpu_sim_insn_per_kernel[k->get_uid()]);
+            if (isolated_run && result_cache.enabled()) {
+              kernel_result result;
+              result.cycles = cycles + k->m_launch_latency;
+              result.insts =
+                  m_gpgpu_sim->gpu_sim_insn_per_kernel[k->get_uid()];
+              result_cache.store(k->get_trace_info()->trace_file, result);
             }
           }
-          tracer.kernel_finalizer(k->get_trace_info());
-          // delete k->entry();
-          // delete k;
+          retire_trace(k->get_trace_info());
+          k->clear_decoded_insts();
+          if (k->get_uid() == finished_kernel_uid) finished = k;
           if (m_gpgpu_sim->getShaderCoreConfig()
-                    ->gpgpu_concurrent_kernel_sm) {
+                    ->gpgpu_concurrent_kernel_sm &&
+              !m_gpgpu_sim->get_config().gpgpu_slicer &&
+              !m_gpgpu_sim->get_config().gpgpu_sm_repartition) {
               if (m_gpgpu_sim->concurrent_mode == m_gpgpu_sim->FINEGRAIN) {
                 m_gpgpu_sim->dynamic_sm_count =
                     m_gpgpu_sim->get_config().dynamic_sm_count;
@@ -382,22 +805,10 @@ int main(int argc, const char **argv) {
             launched_mesa--;
           } else {
             finished_computes++;
-
-            if (m_gpgpu_sim->get_config().gpgpu_slicer) {
-            m_gpgpu_sim->slicer_sampled = false;
-            for (unsigned cluster = 0;
-                 cluster < m_gpgpu_sim->getShaderCoreConfig()->n_simt_clusters;
-                 cluster++) {
-              assert(m_gpgpu_sim->getShaderCoreConfig()
-                         ->n_simt_cores_per_cluster == 1);
-              m_gpgpu_sim->getSIMTCluster(cluster)->get_core(0)->shader_inst =
-                  0;
-            }
-            m_gpgpu_sim->dynamic_sm_count =
-                    m_gpgpu_sim->get_config().dynamic_sm_count;
-          } else {
-          }
           }
+          // the slicer samples the next pair or reuses its split
+          if (m_gpgpu_sim->get_config().gpgpu_slicer)
+            m_gpgpu_sim->slicer_kernel_boundary();
           kernels_info.erase(kernels_info.begin()+j);
           if (!m_gpgpu_sim->cycle_insn_cta_max_hit())
             break;
@@ -406,6 +817,8 @@ int main(int argc, const char **argv) {
       assert(k);
       assert(finished_kernel_uid);
       m_gpgpu_sim->print_stats(finished_kernel_uid);
+      m_gpgpu_sim->release_stats(finished_kernel_uid);
+      if (finished) delete_kernel(finished);
     }
 
     if (sim_cycles) {
@@ -438,7 +851,17 @@ int main(int argc, const char **argv) {
     //   break;
     // }
 
-    if (finished_graphics == tracer.graphics_count) {
+    if (fast_forward_cycles &&
+        (fast_forward_graphics ? finished_graphics == tracer.graphics_count
+                               : finished_computes == tracer.compute_count)) {
+      printf("GPGPU-Sim: ** fast-forwarded %llu cycles **\n",
+             fast_forward_cycles);
+      m_gpgpu_sim->gpu_tot_sim_cycle += fast_forward_cycles;
+      fast_forward_cycles = 0;
+    }
+    if (finished_graphics == tracer.graphics_count && !graphics_frames_over) {
+      // once per frame, the flag is cleared when graphics is relaunched
+      if (!m_gpgpu_sim->all_graphics_done) m_gpgpu_sim->frame_finished();
       printf("All graphics kernels finished one iteration\n");
       printf("STEP1 - rendering done at %llu\n", m_gpgpu_sim->gpu_tot_sim_cycle);
       m_gpgpu_sim->graphics_done = true;
@@ -458,10 +881,22 @@ int main(int argc, const char **argv) {
       break;
     }
 
+    if (finished_graphics == tracer.graphics_count &&
+        tracer.graphics_count > 0 && tracer.compute_count > 0 &&
+        m_gpgpu_sim->getShaderCoreConfig()->gpgpu_concurrent_kernel_sm &&
+        !computes_done && !graphics_frames_over &&
+        tconfig.get_replay_frames() &&
+        graphics_frames == tconfig.get_replay_frames()) {
+      printf("GPGPU-Sim: ** %u graphics frames done, not relaunching **\n",
+             graphics_frames);
+      graphics_frames_over = true;
+    }
     if (finished_graphics == tracer.graphics_count &&
         tracer.graphics_count > 0 && tracer.compute_count > 0 && 
         m_gpgpu_sim->getShaderCoreConfig()->gpgpu_concurrent_kernel_sm &&
-        !computes_done) {
+        !computes_done && !graphics_frames_over) {
+      if (steady_state_reached(true)) break;
+      graphics_frames++;
       for (auto cmd : graphics_commands) {
         commandlist.push_back(cmd);
       }
@@ -478,6 +913,7 @@ int main(int argc, const char **argv) {
         tracer.graphics_count > 0 && tracer.compute_count > 0 &&
         m_gpgpu_sim->getShaderCoreConfig()->gpgpu_concurrent_kernel_sm &&
         !graphics_done) {
+      if (steady_state_reached(false)) break;
       for (auto cmd : compute_commands) {
         commandlist.push_back(cmd);
       }
@@ -487,7 +923,74 @@ int main(int argc, const char **argv) {
       m_gpgpu_sim->all_compute_done = false;
       printf("relaunching compute kernels\n");
     }
+
+    // once one side will not be launched again, the rest of the other side
+    // no longer overlaps with anything: skip it with the modeled cycles and
+    // only drain the kernels already running
+    bool side_relaunched =
+        tracer.graphics_count > 0 && tracer.compute_count > 0 &&
+        m_gpgpu_sim->getShaderCoreConfig()->gpgpu_concurrent_kernel_sm;
+    if (tconfig.fast_forward_tail() && !fast_forward_checked &&
+        ((graphics_done && !computes_done && tracer.graphics_count > 0 &&
+          (graphics_frames_over || !side_relaunched)) ||
+         (computes_done && !graphics_done && tracer.compute_count > 0 &&
+          !side_relaunched))) {
+      unsigned long long cycles = 0;
+      unsigned skipped = 0;
+      bool modeled = true;
+      for (auto k : kernels_info) {
+        if (k->was_launched()) continue;
+        unsigned long long c =
+            cycle_model.get_cycles(k->get_trace_info()->trace_file);
+        modeled = modeled && c;
+        cycles += c;
+      }
+      for (unsigned j = i; j < commandlist.size(); j++) {
+        if (commandlist[j].m_type != command_type::kernel_launch) continue;
+        unsigned long long c =
+            cycle_model.get_cycles(commandlist[j].command_string);
+        modeled = modeled && c;
+        cycles += c;
+        skipped++;
+      }
+      fast_forward_checked = true;
+      if (!modeled) {
+        printf("GPGPU-Sim: not fast-forwarding, kernels missing from the "
+               "cycle model\n");
+      } else {
+        for (unsigned j = 0; j < kernels_info.size();) {
+          trace_kernel_info_t *k = kernels_info[j];
+          if (k->was_launched()) {
+            j++;
+            continue;
+          }
+          kernel_graph.kernel_done(k);
+          retire_trace(k->get_trace_info());
+          kernels_info.erase(kernels_info.begin() + j);
+          delete_kernel(k);
+          skipped++;
+        }
+        i = commandlist.size();
+        if (graphics_done)
+          finished_computes = tracer.compute_count - kernels_info.size();
+        else
+          finished_graphics = tracer.graphics_count - kernels_info.size();
+        fast_forwarding = true;
+        fast_forward_graphics = !graphics_done;
+        fast_forward_cycles = cycles;
+        printf("GPGPU-Sim: fast-forwarding %u kernels (%llu cycles) after "
+               "the last %s kernel\n",
+               skipped, cycles, graphics_done ? "graphics" : "compute");
+      }
+    }
   }
+  if (tconfig.get_cycle_model_out()[0] &&
+      !cycle_model.save(tconfig.get_cycle_model_out()))
+    printf("Unable to write kernel cycle model %s\n",
+           tconfig.get_cycle_model_out());
+  bool regressed = regress.enabled() && !regress.finish();
+  for (auto &resident : resident_traces)
+    for (auto trace_info : resident.second) tracer.kernel_finalizer(trace_info);
   unsigned long long compute_cycle = m_gpgpu_sim->gpu_compute_end_cycle - m_gpgpu_sim->gpu_compute_start_cycle;
   float compute_slowdown =
       (float)compute_cycle / m_gpgpu_sim->gpu_last_compute_cycle;
@@ -505,13 +1008,21 @@ int main(int argc, const char **argv) {
       m_gpgpu_sim->gpu_render_start_cycle, m_gpgpu_sim->gpu_tot_sim_cycle,
       m_gpgpu_sim->gpu_tot_sim_cycle - m_gpgpu_sim->gpu_render_start_cycle,
       graphics_slowdown);
+  if (tconfig.get_sample_intervals())
+    printf("sampled kernels skipped %llu estimated cycles, estimated total "
+           "cycles : %llu +- %llu (95%% CI)\n",
+           sampled_extra_cycles,
+           m_gpgpu_sim->gpu_tot_sim_cycle + sampled_extra_cycles,
+           (unsigned long long)(sqrt(sampled_half_width_sq) + 0.5));
+  for (auto pid : fork_children) waitpid(pid, NULL, 0);
+  m_gpgpu_sim->simulation_finished();
   // we print this message to inform the gpgpu-simulation stats_collect script
   // that we are done
   printf("GPGPU-Sim: *** simulation thread exiting ***\n");
   printf("GPGPU-Sim: *** exit detected ***\n");
   fflush(stdout);
 
-  return 0;
+  return regressed ? 1 : 0;
 }
 
 
@@ -533,6 +1044,9 @@ trace_kernel_info_t *create_kernel_info( kernel_trace_t* kernel_trace_info,
   if (kernel_trace_info->kernel_name.find("VERTEX") != std::string::npos ||
       kernel_trace_info->kernel_name.find("FRAG") != std::string::npos) {
     kernel_info->is_graphic_kernel = true;
+    kernel_info->tenant = 0;
+  } else {
+    kernel_info->tenant = config->get_tenant(kernel_trace_info->trace_file);
   }
 
   return kernel_info;
@@ -556,15 +1070,21 @@ gpgpu_sim *gpgpu_trace_sim_init_perf_model(int argc, const char *argv[],
   m_gpgpu_context->the_gpgpusim->g_the_gpu_config->reg_options(
       opp); // register GPU microrachitecture options
   m_config->reg_options(opp);
+  startup_phase_done("register_options");
 
   option_parser_cmdline(opp, argc, argv); // parse configuration options
-  fprintf(stdout, "GPGPU-Sim: Configuration options:\n\n");
-  option_parser_print(opp, stdout);
+  startup_phase_done("parse_options");
+  if (!m_gpgpu_context->the_gpgpusim->g_the_gpu_config->quiet_options()) {
+    fprintf(stdout, "GPGPU-Sim: Configuration options:\n\n");
+    option_parser_print(opp, stdout);
+    startup_phase_done("print_options");
+  }
   // Set the Numeric locale to a standard locale where a decimal point is a
   // "dot" not a "comma" so it does the parsing correctly independent of the
   // system environment variables
   assert(setlocale(LC_NUMERIC, "C"));
   m_gpgpu_context->the_gpgpusim->g_the_gpu_config->init();
+  startup_phase_done("config_init");
 
   m_gpgpu_context->the_gpgpusim->g_the_gpu = new trace_gpgpu_sim(
       *(m_gpgpu_context->the_gpgpusim->g_the_gpu_config), m_gpgpu_context);
@@ -572,6 +1092,7 @@ gpgpu_sim *gpgpu_trace_sim_init_perf_model(int argc, const char *argv[],
   m_gpgpu_context->the_gpgpusim->g_stream_manager =
       new stream_manager((m_gpgpu_context->the_gpgpusim->g_the_gpu),
                          m_gpgpu_context->func_sim->g_cuda_launch_blocking);
+  startup_phase_done("construct_gpu");
 
   m_gpgpu_context->the_gpgpusim->g_simulation_starttime = time((time_t *)NULL);
 
@@ -0,0 +1,282 @@
+// Converts accel-sim text kernel traces to the binary trace container
+// (see trace-parser/trace_binary.h). The trace parser detects the format by
+// its magic, so converted traces keep their original file names. With -d
+// warps that only differ in their addresses share one instruction stream
+// (format version 2).
+//
+// For bulk conversion of a trace directory as a batch job:
+//   -j N  encode the CTAs of a kernel on N threads (version 1 only, the
+//         version 2 streams depend on the CTAs before them)
+//   -v N  after converting a kernel, decode N CTAs sampled from it with the
+//         trace parser from both files and compare them instruction by
+//         instruction
+//   -r    resume: keep the kernels whose output already is a complete
+//         binary trace
+// Every kernel is written to <output>.part and renamed when it is complete,
+// so an interrupted or failed job leaves no truncated trace behind. Kernels
+// with TRACE_RAY BVH lists, which the binary records cannot hold, are copied
+// as text traces with a warning. Failed
+// kernels are listed at the end and make the exit status 1; running again
+// with -r converts only them.
+//
+// usage: trace-converter.out [-d] [-j N] [-v N] [-r] <kernelslist.g>
+//                            <output_dir>
+//        trace-converter.out [-d] [-j N] [-v N] -k <kernel.traceg>
+//                            <kernel.bin>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../trace-parser/trace_binary.h"
+#include "../trace-parser/trace_parser.h"
+
+static uint64_t file_size(const std::string &filepath) {
+  struct stat st;
+  if (stat(filepath.c_str(), &st) != 0) return 0;
+  return st.st_size;
+}
+
+// a binary trace whose footer and index read back
+static bool complete_binary_trace(const std::string &filepath) {
+  if (!binary_trace_reader::is_binary_trace(filepath)) return false;
+  trace_opcode_table opcodes;
+  binary_trace_reader reader;
+  return reader.load_index(filepath, &opcodes);
+}
+
+static bool same_inst(const inst_trace_t &a, const trace_opcode_table *a_ops,
+                      const inst_trace_t &b, const trace_opcode_table *b_ops,
+                      unsigned enable_lineinfo) {
+  if (enable_lineinfo && a.line_num != b.line_num) return false;
+  if (a.m_pc != b.m_pc || a.mask != b.mask ||
+      a.reg_dsts_num != b.reg_dsts_num || a.reg_srcs_num != b.reg_srcs_num ||
+      a_ops->get(a.opcode_id).opcode != b_ops->get(b.opcode_id).opcode)
+    return false;
+  for (unsigned i = 0; i < a.reg_dsts_num; ++i)
+    if (a.reg_dest[i] != b.reg_dest[i]) return false;
+  for (unsigned i = 0; i < a.reg_srcs_num; ++i)
+    if (a.reg_src[i] != b.reg_src[i]) return false;
+  if (!a.memadd_info != !b.memadd_info) return false;
+  if (!a.memadd_info) return true;
+  if (a.memadd_info->width != b.memadd_info->width) return false;
+  for (unsigned s = 0; s < WARP_SIZE; ++s)
+    if ((a.mask >> s & 1) &&
+        a.memadd_info->addrs[s] != b.memadd_info->addrs[s])
+      return false;
+  return true;
+}
+
+// copy the text trace in to out unchanged
+static bool copy_trace(const std::string &in, const std::string &out) {
+  std::ifstream ifs(in.c_str(), std::ios::binary);
+  std::ofstream ofs(out.c_str(), std::ios::binary | std::ios::trunc);
+  if (!ifs.is_open() || !ofs.is_open()) return false;
+  ofs << ifs.rdbuf();
+  ofs.close();
+  return !ofs.fail();
+}
+
+// decode samples CTAs of the text trace and its conversion and compare them
+static bool verify_kernel(const std::string &text, const std::string &binary,
+                          unsigned samples) {
+  trace_parser parser("");
+  kernel_trace_t *t = parser.parse_kernel_info(text);
+  kernel_trace_t *b = parser.parse_kernel_info(binary);
+  const threadblock_index_t *t_index = parser.load_threadblock_index(t);
+  const threadblock_index_t *b_index = parser.load_threadblock_index(b);
+  bool ok = t_index->tbs.size() == b_index->tbs.size();
+  if (!ok)
+    std::cout << "Verify " << binary << ": " << b_index->tbs.size() << " of "
+              << t_index->tbs.size() << " thread blocks" << std::endl;
+
+  unsigned warps =
+      (t->tb_dim_x * t->tb_dim_y * t->tb_dim_z + WARP_SIZE - 1) / WARP_SIZE;
+  std::vector<std::vector<inst_trace_t> *> t_warps, b_warps;
+  for (unsigned i = 0; i < warps; ++i) {
+    t_warps.push_back(new std::vector<inst_trace_t>);
+    b_warps.push_back(new std::vector<inst_trace_t>);
+  }
+  // seeded by the CTA count, so a rerun checks the same CTAs
+  std::mt19937 rng(t_index->tbs.size());
+  std::vector<uint64_t> memaddrs;
+  for (unsigned n = 0; ok && n < samples && !t_index->tbs.empty(); ++n) {
+    // the first and the last CTA, the others at random
+    unsigned tb = rng() % t_index->tbs.size();
+    if (n == 0) tb = 0;
+    if (n == 1) tb = t_index->tbs.size() - 1;
+    const trace_tb_entry &e = t_index->tbs[tb];
+    parser.get_threadblock_traces(t_warps, t, e.x, e.y, e.z, memaddrs);
+    if (!parser.get_threadblock_traces(b_warps, b, e.x, e.y, e.z, memaddrs)) {
+      std::cout << "Verify " << binary << ": thread block " << e.x << ","
+                << e.y << "," << e.z << " is missing" << std::endl;
+      ok = false;
+      break;
+    }
+    for (unsigned w = 0; ok && w < warps; ++w) {
+      const std::vector<inst_trace_t> &tw = *t_warps[w], &bw = *b_warps[w];
+      for (unsigned i = 0; ok && (i < tw.size() || i < bw.size()); ++i) {
+        if (i < tw.size() && i < bw.size() &&
+            same_inst(tw[i], t->opcodes, bw[i], b->opcodes,
+                      t->enable_lineinfo))
+          continue;
+        std::cout << "Verify " << binary << ": thread block " << e.x << ","
+                  << e.y << "," << e.z << " warp " << w << " differs at "
+                  << "instruction " << i << std::endl;
+        ok = false;
+      }
+    }
+  }
+  for (unsigned i = 0; i < warps; ++i) {
+    delete t_warps[i];
+    delete b_warps[i];
+  }
+  parser.open_kernel_trace(t);  // the finalizer expects the stream
+  parser.kernel_finalizer(t);
+  parser.kernel_finalizer(b);
+  return ok;
+}
+
+struct convert_options {
+  bool dedup;
+  bool resume;
+  unsigned threads;
+  unsigned samples;
+};
+
+static bool convert_kernel(const std::string &in, const std::string &out,
+                           const convert_options &opts, uint64_t &text_bytes,
+                           uint64_t &binary_bytes) {
+  if (binary_trace_reader::is_binary_trace(in)) {
+    std::cout << "Already binary, skipping: " << in << std::endl;
+    return true;
+  }
+  if (opts.resume && complete_binary_trace(out)) {
+    std::cout << "Already converted, skipping: " << out << std::endl;
+    return true;
+  }
+  std::cout << "Converting " << in << " -> " << out << std::endl;
+  std::string part = out + ".part";
+  trace_conversion result =
+      convert_text_trace_to_binary(in, part, opts.dedup, opts.threads);
+  if (result == TRACE_KEEP_TEXT) {
+    std::cout << "Warning: " << in << " has TRACE_RAY BVH lists, kept as a "
+              << "text trace" << std::endl;
+    if (!copy_trace(in, part) || rename(part.c_str(), out.c_str()) != 0) {
+      remove(part.c_str());
+      return false;
+    }
+    return true;
+  }
+  if (result != TRACE_CONVERTED ||
+      (opts.samples && !verify_kernel(in, part, opts.samples)) ||
+      rename(part.c_str(), out.c_str()) != 0) {
+    remove(part.c_str());
+    return false;
+  }
+  text_bytes += file_size(in);
+  binary_bytes += file_size(out);
+  return true;
+}
+
+static void usage(const char *name) {
+  std::cout << "usage: " << name
+            << " [-d] [-j N] [-v N] [-r] <kernelslist.g> <output_dir>\n"
+            << "       " << name
+            << " [-d] [-j N] [-v N] -k <kernel.traceg> <kernel.bin>"
+            << std::endl;
+}
+
+int main(int argc, char **argv) {
+  convert_options opts;
+  opts.dedup = false;
+  opts.resume = false;
+  opts.threads = 1;
+  opts.samples = 0;
+  bool single = false;
+  int c;
+  while ((c = getopt(argc, argv, "dj:v:rk")) != -1) {
+    switch (c) {
+      case 'd':
+        opts.dedup = true;
+        break;
+      case 'j':
+        opts.threads = atoi(optarg);
+        break;
+      case 'v':
+        opts.samples = atoi(optarg);
+        break;
+      case 'r':
+        opts.resume = true;
+        break;
+      case 'k':
+        single = true;
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (argc - optind != 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  uint64_t text_bytes = 0, binary_bytes = 0;
+  std::vector<std::string> failed;
+  if (single) {
+    if (!convert_kernel(argv[optind], argv[optind + 1], opts, text_bytes,
+                        binary_bytes))
+      failed.push_back(argv[optind]);
+  } else {
+    std::string kernellist = argv[optind];
+    std::string out_dir = argv[optind + 1];
+    mkdir(out_dir.c_str(), 0755);
+
+    std::string directory(kernellist);
+    const size_t last_slash_idx = directory.rfind('/');
+    if (std::string::npos != last_slash_idx) {
+      directory = directory.substr(0, last_slash_idx);
+    } else {
+      directory = ".";
+    }
+    std::string list_name = kernellist.substr(last_slash_idx + 1);
+
+    std::ifstream ifs(kernellist.c_str());
+    if (!ifs.is_open()) {
+      std::cout << "Unable to open file: " << kernellist << std::endl;
+      return 1;
+    }
+    std::ofstream ofs((out_dir + "/" + list_name).c_str());
+    std::string line;
+    while (std::getline(ifs, line)) {
+      // same command classification as trace_parser::parse_commandlist_file,
+      // every non kernel command is copied unchanged
+      if (!line.empty() && line.substr(0, 6) != "Memcpy" &&
+          line.find("kernel") != std::string::npos) {
+        if (!convert_kernel(directory + "/" + line, out_dir + "/" + line, opts,
+                            text_bytes, binary_bytes))
+          failed.push_back(line);
+      }
+      ofs << line << std::endl;
+    }
+  }
+
+  if (binary_bytes)
+    printf("text %llu bytes, binary %llu bytes, ratio %.2fx\n",
+           (unsigned long long)text_bytes, (unsigned long long)binary_bytes,
+           (double)text_bytes / binary_bytes);
+  if (!failed.empty()) {
+    printf("%u kernels failed:\n", (unsigned)failed.size());
+    for (unsigned i = 0; i < failed.size(); ++i)
+      printf("  %s\n", failed[i].c_str());
+    return 1;
+  }
+  return 0;
+}
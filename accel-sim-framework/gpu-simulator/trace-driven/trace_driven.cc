@@ -30,7 +30,9 @@
 #include <bits/stdc++.h>
 #include <math.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -53,24 +55,77 @@
 #include "gpgpusim_entrypoint.h"
 #include "option_parser.h"
 #include "trace_driven.h"
+#include "../trace-parser/trace_loader_trace.h"
 
-const trace_warp_inst_t *trace_shd_warp_t::get_next_trace_inst() {
-  if (trace_pc < warp_traces.size()) {
-    trace_warp_inst_t *new_inst =
-        new trace_warp_inst_t(get_shader()->get_config());
-    bool success = new_inst->parse_from_trace_struct(
-        warp_traces[trace_pc], m_kernel_info->OpcodeMap,
-        m_kernel_info->m_tconfig, m_kernel_info->m_kernel_trace_info,
-        m_kernel_info->get_uid());
+bool trace_shd_warp_t::refill_traces() {
+  if (trace_pc < warp_traces.size()) return true;
+  if (trace_cursor.remaining == 0) return false;
+
+  std::vector<uint64_t> memaddrs;
+  gpgpu_sim *gpu = get_shader()->get_gpu();
+  {
+    sim_phase_timer timer(gpu->profiler(), PHASE_TRACE_PARSE);
+    m_kernel_info->read_warp_window(trace_cursor, warp_traces, memaddrs);
+  }
+  trace_pc = 0;
+  // vertex buffer lines are copied before the window's instructions issue,
+  // unless the kernel's buffers were prefetched whole at launch
+  if (!gpu->vertex_buffers().has_buffers(m_kernel_info->get_uid())) {
+    for (auto mem : memaddrs) gpu->perf_memcpy_to_gpu(mem, 32, true);
+  }
+  return !warp_traces.empty();
+}
+
+void trace_shd_warp_t::skip_outside_roi() {
+  if (!m_kernel_info || !m_kernel_info->has_roi()) return;
+  shader_core_ctx *shader = get_shader();
+  while (refill_traces()) {
+    const inst_trace_t &trace = warp_traces[trace_pc];
+    if (m_kernel_info->in_roi(trace.m_pc) ||
+        m_kernel_info->get_decoded_inst(trace, shader->get_config())->op ==
+            EXIT_OPS)
+      return;
+    m_kernel_info->skip_inst(shader->get_gpu(), shader->get_sid(),
+                             get_warp_id(), trace);
     trace_pc++;
-    while (!success) {
+  }
+}
+
+const trace_warp_inst_t *trace_shd_warp_t::get_next_trace_inst() {
+  skip_outside_roi();
+  if (refill_traces()) {
+    trace_warp_inst_t *new_inst = &m_inst_pool[m_next_pool_inst];
+    m_next_pool_inst = (m_next_pool_inst + 1) % INST_POOL_SIZE;
+    sim_phase_timer timer(get_shader()->get_gpu()->profiler(),
+                          PHASE_TRACE_DECODE);
+    bool success;
+    do {
       // skip texture instructions that has 0 data size
-      assert(new_inst->mem_op == TEX);
-      success = new_inst->parse_from_trace_struct(
-          warp_traces[trace_pc], m_kernel_info->OpcodeMap,
-          m_kernel_info->m_tconfig, m_kernel_info->m_kernel_trace_info,
-          m_kernel_info->get_uid());
+      skip_outside_roi();
+      bool more = refill_traces();
+      assert(more);
+      const inst_trace_t &trace = warp_traces[trace_pc];
+      *new_inst = *m_kernel_info->get_decoded_inst(trace,
+                                                   get_shader()->get_config());
+      success = new_inst->fill_dynamic(trace,
+                                       m_kernel_info->m_kernel_trace_info);
       trace_pc++;
+      assert(success || new_inst->mem_op == TEX);
+    } while (!success);
+    // the traces carry no reuse flags: a source is flagged when the next
+    // instruction of the warp reads its register in the same slot and this
+    // one does not overwrite it, as the compiler sets them
+    unsigned reuse_slots = get_shader()->get_config()->gpgpu_operand_reuse_slots;
+    if (reuse_slots && trace_pc < warp_traces.size()) {
+      const inst_trace_t &next = warp_traces[trace_pc];
+      for (unsigned m = 0; m < next.reg_srcs_num && m < reuse_slots; m++) {
+        int reg = next.reg_src[m] + 1;
+        if (new_inst->arch_reg.src[m] != reg) continue;
+        bool written = false;
+        for (unsigned d = 0; d < MAX_REG_OPERANDS; d++)
+          written = written || new_inst->arch_reg.dst[d] == reg;
+        if (!written) new_inst->reuse_mask |= 1u << m;
+      }
     }
     return new_inst;
   } else
@@ -80,10 +135,13 @@ const trace_warp_inst_t *trace_shd_warp_t::get_next_trace_inst() {
 void trace_shd_warp_t::clear() {
   trace_pc = 0;
   warp_traces.clear();
+  trace_cursor.remaining = 0;
 }
 
 // functional_done
-bool trace_shd_warp_t::trace_done() { return trace_pc == (warp_traces.size()); }
+bool trace_shd_warp_t::trace_done() {
+  return trace_pc == (warp_traces.size()) && trace_cursor.remaining == 0;
+}
 
 address_type trace_shd_warp_t::get_start_trace_pc() {
   assert(warp_traces.size() > 0);
@@ -91,6 +149,8 @@ address_type trace_shd_warp_t::get_start_trace_pc() {
 }
 
 address_type trace_shd_warp_t::get_pc() {
+  skip_outside_roi();
+  refill_traces();
   assert(warp_traces.size() > 0);
   assert(trace_pc < warp_traces.size());
   return warp_traces[trace_pc].m_pc;
@@ -106,6 +166,20 @@ trace_kernel_info_t::trace_kernel_info_t(dim3 gridDim, dim3 blockDim,
   m_tconfig = config;
   m_kernel_trace_info = kernel_trace_info;
   m_was_launched = false;
+  m_last_issue = 0;
+  m_roi_skipped_insts = 0;
+  m_roi_warmed_accesses = 0;
+  plan_sample();
+
+  m_roi = config->get_roi();
+  if (!kernel_trace_info->roi_pc.empty() &&
+      !trace_config::parse_pc_ranges(kernel_trace_info->roi_pc.c_str(),
+                                     m_roi)) {
+    printf("GPGPU-Sim: malformed -roi pc = %s in %s\n",
+           kernel_trace_info->roi_pc.c_str(),
+           kernel_trace_info->trace_file.c_str());
+    exit(1);
+  }
 
   // resolve the binary version
   if (kernel_trace_info->binary_verion == AMPERE_RTX_BINART_VERSION ||
@@ -128,23 +202,669 @@ trace_kernel_info_t::trace_kernel_info_t(dim3 gridDim, dim3 blockDim,
   }
 }
 
+trace_kernel_info_t::~trace_kernel_info_t() { clear_decoded_insts(); }
+
+const trace_warp_inst_t *trace_kernel_info_t::decode_inst(
+    const inst_trace_t &trace, const class core_config *config) {
+  address_type slot = trace.m_pc / DECODED_PC_ALIGN;
+  bool in_table =
+      trace.m_pc % DECODED_PC_ALIGN == 0 && slot < DECODED_TABLE_MAX;
+  if (!in_table) {
+    // a lookup alone leaves the map untouched for the clusters on the pool
+    std::unordered_map<address_type, trace_warp_inst_t *>::const_iterator it =
+        m_decoded_insts.find(trace.m_pc);
+    if (it != m_decoded_insts.end()) return it->second;
+  }
+  if (in_table && slot >= m_decoded_table.size())
+    m_decoded_table.resize(slot + 1, NULL);
+  trace_warp_inst_t *&inst =
+      in_table ? m_decoded_table[slot] : m_decoded_insts[trace.m_pc];
+  if (!inst) {
+    inst = new trace_warp_inst_t(config);
+    inst->decode_static(trace, OpcodeMap, m_tconfig, m_kernel_trace_info,
+                        get_uid());
+  }
+  return inst;
+}
+
+void trace_kernel_info_t::clear_decoded_insts() {
+  for (unsigned i = 0; i < m_decoded_table.size(); ++i)
+    delete m_decoded_table[i];
+  std::vector<trace_warp_inst_t *>().swap(m_decoded_table);
+  for (std::unordered_map<address_type, trace_warp_inst_t *>::iterator it =
+           m_decoded_insts.begin();
+       it != m_decoded_insts.end(); ++it)
+    delete it->second;
+  m_decoded_insts.clear();
+}
+
+void trace_kernel_info_t::plan_sample() {
+  unsigned intervals = m_tconfig->get_sample_intervals();
+  unsigned size = m_tconfig->get_sample_interval_ctas();
+  unsigned warmup = m_tconfig->get_sample_warmup_ctas();
+  unsigned total = num_blocks();
+  if (!intervals || total < m_tconfig->get_sample_min_ctas() ||
+      warmup + (unsigned long long)intervals * size >= total)
+    return;
+
+  // seeded by the kernel id so reruns pick the same CTAs
+  std::mt19937 rng(m_kernel_trace_info->kernel_id);
+  unsigned stride = (total - warmup) / intervals;
+  for (unsigned i = 0; i < intervals; i++) {
+    unsigned offset = m_tconfig->sample_random()
+                          ? rng() % (stride - size + 1)
+                          : (stride - size) / 2;
+    m_sample_starts.push_back(warmup + i * stride + offset);
+  }
+  m_interval_first_issue.assign(intervals, 0);
+  m_interval_last_issue.assign(intervals, 0);
+  skip_unsampled_ctas();
+}
+
+bool trace_kernel_info_t::in_sample(unsigned ctaid) const {
+  if (ctaid < m_tconfig->get_sample_warmup_ctas()) return true;
+  std::vector<unsigned>::const_iterator it =
+      std::upper_bound(m_sample_starts.begin(), m_sample_starts.end(), ctaid);
+  if (it == m_sample_starts.begin()) return false;
+  return ctaid < *(it - 1) + m_tconfig->get_sample_interval_ctas();
+}
+
+unsigned trace_kernel_info_t::num_sampled_ctas() const {
+  if (!is_sampled()) return num_blocks();
+  return m_tconfig->get_sample_warmup_ctas() +
+         m_sample_starts.size() * m_tconfig->get_sample_interval_ctas();
+}
+
+void trace_kernel_info_t::skip_unsampled_ctas() {
+  while (!no_more_ctas_to_run() && !in_sample(get_next_cta_id_single()))
+    increment_cta_id();
+}
+
+void trace_kernel_info_t::sample_cta_issued(unsigned ctaid,
+                                            unsigned long long cycle) {
+  m_last_issue = cycle;
+  std::vector<unsigned>::const_iterator it =
+      std::upper_bound(m_sample_starts.begin(), m_sample_starts.end(), ctaid);
+  if (it == m_sample_starts.begin()) return;  // warm-up
+  unsigned i = it - m_sample_starts.begin() - 1;
+  if (!m_interval_first_issue[i]) m_interval_first_issue[i] = cycle;
+  m_interval_last_issue[i] = cycle;
+}
+
+bool trace_kernel_info_t::estimate_cycles(
+    unsigned long long &cycles, unsigned long long &half_width) const {
+  // cycles between consecutive CTA issues of each interval, CTAs issue as
+  // earlier ones retire so this is the steady state cycles per CTA
+  unsigned size = m_tconfig->get_sample_interval_ctas();
+  unsigned n = 0;
+  double sum = 0, sum_sq = 0;
+  for (unsigned i = 0; i < m_sample_starts.size(); i++) {
+    if (!m_interval_first_issue[i]) continue;
+    double per_cta =
+        double(m_interval_last_issue[i] - m_interval_first_issue[i]) /
+        (size - 1);
+    sum += per_cta;
+    sum_sq += per_cta * per_cta;
+    n++;
+  }
+  if (!n) return false;
+
+  double mean = sum / n;
+  double extrapolated =
+      double(num_blocks() - m_tconfig->get_sample_warmup_ctas());
+  unsigned long long warmup = m_interval_first_issue[0] - start_cycle;
+  unsigned long long drain = end_cycle - m_last_issue;
+  cycles = warmup + (unsigned long long)(extrapolated * mean + 0.5) + drain;
+  half_width = 0;
+  if (n > 1) {
+    double var = std::max(0.0, (sum_sq - n * mean * mean) / (n - 1));
+    half_width =
+        (unsigned long long)(1.96 * extrapolated * sqrt(var / n) + 0.5);
+  }
+  return true;
+}
+
+unsigned trace_kernel_info_t::functional_warmup(gpgpu_sim *gpu,
+                                                unsigned ctas) {
+  const shader_core_config *config = gpu->getShaderCoreConfig();
+  unsigned warps =
+      (threads_per_cta() + config->warp_size - 1) / config->warp_size;
+  std::vector<std::vector<inst_trace_t> > traces(warps);
+  std::vector<trace_warp_cursor> warp_cursors(warps);
+  std::vector<std::vector<inst_trace_t> *> threadblock_traces;
+  std::vector<trace_warp_cursor *> cursors;
+  for (unsigned w = 0; w < warps; w++) {
+    threadblock_traces.push_back(&traces[w]);
+    cursors.push_back(&warp_cursors[w]);
+  }
+  // vertex buffer lines are copied in as when the CTA is simulated
+  bool prefetched = gpu->vertex_buffers().has_buffers(get_uid());
+  std::vector<uint64_t> memaddrs;
+  unsigned warmed = 0;
+  for (; warmed < ctas && !no_more_ctas_to_run(); warmed++) {
+    unsigned ctaid = get_next_cta_id_single();
+    unsigned sid = ctaid % config->num_shader();
+    if (is_graphic_kernel) gpu->vertex_buffers().cta_issued(*this, ctaid);
+    {
+      sim_phase_timer timer(gpu->profiler(), PHASE_TRACE_PARSE);
+      bool found = true;
+      if (m_tconfig->get_warp_window()) {
+        if (m_tconfig->load_ctas_by_id())
+          found = get_threadblock_cursors(cursors, ctaid);
+        else
+          get_next_threadblock_cursors(cursors);
+      } else if (m_tconfig->load_ctas_by_id()) {
+        found = get_threadblock_traces(threadblock_traces, ctaid, memaddrs);
+      } else {
+        get_next_threadblock_traces(threadblock_traces, memaddrs);
+      }
+      assert(found && "CTA missing from the kernel trace");
+    }
+    if (!prefetched)
+      for (auto mem : memaddrs) gpu->perf_memcpy_to_gpu(mem, 32, true);
+    for (unsigned w = 0; w < warps; w++) {
+      if (!m_tconfig->get_warp_window()) {
+        warm_warp(gpu, sid, w, traces[w]);
+        continue;
+      }
+      while (warp_cursors[w].remaining) {
+        read_warp_window(warp_cursors[w], traces[w], memaddrs);
+        if (!prefetched)
+          for (auto mem : memaddrs) gpu->perf_memcpy_to_gpu(mem, 32, true);
+        warm_warp(gpu, sid, w, traces[w]);
+      }
+    }
+    if (is_graphic_kernel) gpu->vertex_buffers().cta_retired(*this, ctaid);
+    increment_cta_id();
+    if (is_sampled()) skip_unsampled_ctas();
+  }
+  return warmed;
+}
+
+void trace_kernel_info_t::warm_warp(
+    gpgpu_sim *gpu, unsigned sid, unsigned warp_id,
+    const std::vector<inst_trace_t> &warp_traces) {
+  for (const inst_trace_t &trace : warp_traces)
+    warm_inst(gpu, sid, warp_id, trace);
+}
+
+unsigned trace_kernel_info_t::warm_inst(gpgpu_sim *gpu, unsigned sid,
+                                        unsigned warp_id,
+                                        const inst_trace_t &trace) {
+  if (!trace.memadd_info) return 0;
+  const shader_core_config *config = gpu->getShaderCoreConfig();
+  trace_warp_inst_t inst = *get_decoded_inst(trace, config);
+  if (!inst.fill_dynamic(trace, m_kernel_trace_info)) return 0;
+  // local addresses depend on the hardware thread the CTA would get, so
+  // only global memory is warmed
+  if (!inst.space.is_global() || inst.mem_op == TEX ||
+      !(inst.is_load() || inst.is_store()))
+    return 0;
+  inst.issue(inst.get_active_mask(), warp_id, 0, warp_id, 0);
+  inst.generate_mem_accesses();
+  // the same L1D bypass as ldst_unit::memory_cycle, stores and atomics are
+  // written through to L2
+  bool use_l1 = inst.is_load() && !inst.isatomic() &&
+                inst.cache_op != CACHE_GLOBAL &&
+                !(config->gmem_skip_L1D && inst.cache_op != CACHE_L1);
+  unsigned accesses = 0;
+  while (!inst.accessq_empty()) {
+    gpu->warm_access(sid, inst.accessq_back(), use_l1, is_graphic_kernel);
+    inst.accessq_pop_back();
+    accesses++;
+  }
+  return accesses;
+}
+
+bool trace_kernel_info_t::in_roi(address_type pc) const {
+  for (unsigned i = 0; i < m_roi.size(); i++)
+    if (pc >= m_roi[i].first && pc <= m_roi[i].second) return true;
+  return false;
+}
+
+void trace_kernel_info_t::skip_inst(gpgpu_sim *gpu, unsigned sid,
+                                    unsigned warp_id,
+                                    const inst_trace_t &trace) {
+  m_roi_warmed_accesses += warm_inst(gpu, sid, warp_id, trace);
+  m_roi_skipped_insts++;
+}
+
 void trace_kernel_info_t::get_next_threadblock_traces(
-    std::vector<std::vector<inst_trace_t> *> threadblock_traces, std::set<uint64_t> &memaddrs) {
-  if (!m_kernel_trace_info->ifs) {
-    m_kernel_trace_info->ifs = new std::ifstream;
-    m_kernel_trace_info->ifs->open(m_kernel_trace_info->trace_file.c_str());
-    assert(m_kernel_trace_info->ifs->is_open());
-    for (unsigned i = 0; i < m_kernel_trace_info->read_lines; ++i) {
-      std::string line;
-      std::getline(*(m_kernel_trace_info->ifs), line);
+    std::vector<std::vector<inst_trace_t> *> threadblock_traces, std::vector<uint64_t> &memaddrs) {
+  trace_tb_entry tb;
+  if (m_parser->get_next_threadblock_traces(
+          threadblock_traces, m_kernel_trace_info, memaddrs, &tb))
+    LOADER_DPRINTF("%s_%u thread block = %u,%u,%u\n",
+                   m_kernel_trace_info->kernel_name.c_str(),
+                   m_kernel_trace_info->kernel_id, tb.x, tb.y, tb.z);
+}
+
+bool trace_kernel_info_t::get_threadblock_traces(
+    std::vector<std::vector<inst_trace_t> *> threadblock_traces,
+    unsigned ctaid, std::vector<uint64_t> &memaddrs) {
+  dim3 grid = get_grid_dim();
+  unsigned x = ctaid % grid.x;
+  unsigned y = (ctaid / grid.x) % grid.y;
+  unsigned z = ctaid / (grid.x * grid.y);
+  bool found = m_parser->get_threadblock_traces(
+      threadblock_traces, m_kernel_trace_info, x, y, z, memaddrs);
+  if (found)
+    LOADER_DPRINTF("%s_%u thread block = %u,%u,%u\n",
+                   m_kernel_trace_info->kernel_name.c_str(),
+                   m_kernel_trace_info->kernel_id, x, y, z);
+  return found;
+}
+
+void trace_kernel_info_t::get_next_threadblock_cursors(
+    std::vector<trace_warp_cursor *> cursors) {
+  trace_tb_entry tb;
+  if (m_parser->get_next_threadblock_cursors(cursors, m_kernel_trace_info,
+                                             &tb))
+    LOADER_DPRINTF("%s_%u thread block = %u,%u,%u\n",
+                   m_kernel_trace_info->kernel_name.c_str(),
+                   m_kernel_trace_info->kernel_id, tb.x, tb.y, tb.z);
+}
+
+bool trace_kernel_info_t::get_threadblock_cursors(
+    std::vector<trace_warp_cursor *> cursors, unsigned ctaid) {
+  dim3 grid = get_grid_dim();
+  unsigned x = ctaid % grid.x;
+  unsigned y = (ctaid / grid.x) % grid.y;
+  unsigned z = ctaid / (grid.x * grid.y);
+  bool found =
+      m_parser->get_threadblock_cursors(cursors, m_kernel_trace_info, x, y, z);
+  if (found)
+    LOADER_DPRINTF("%s_%u thread block = %u,%u,%u\n",
+                   m_kernel_trace_info->kernel_name.c_str(),
+                   m_kernel_trace_info->kernel_id, x, y, z);
+  return found;
+}
+
+void trace_kernel_info_t::read_warp_window(
+    trace_warp_cursor &cursor, std::vector<inst_trace_t> &warp_traces,
+    std::vector<uint64_t> &memaddrs) {
+  m_parser->read_warp_window(m_kernel_trace_info, cursor,
+                             m_tconfig->get_warp_window(), warp_traces,
+                             memaddrs);
+}
+
+void kernel_dependency_graph::add_kernel(trace_kernel_info_t *kernel) {
+  node &n = m_nodes[kernel->get_uid()];
+  n.pending = 0;
+  trace_kernel_info_t *&tail = m_stream_tail[kernel->get_cuda_stream_id()];
+  if (tail) {
+    m_nodes[tail->get_uid()].successors.push_back(kernel);
+    n.pending++;
+  }
+  tail = kernel;
+  if (kernel->is_graphic_kernel) {
+    for (unsigned i = 0; i < m_barrier_kernels.size(); ++i) {
+      m_nodes[m_barrier_kernels[i]->get_uid()].successors.push_back(kernel);
+      n.pending++;
+    }
+    m_pass_kernels.push_back(kernel);
+    if (starts_draw(kernel)) {
+      m_last_vertex = kernel->get_uid();
+      m_draw_pending[m_last_vertex] = 1;
+    } else if (m_draw_pending.count(m_last_vertex)) {
+      m_draw_pending[m_last_vertex]++;
+      m_draw_of[kernel->get_uid()] = m_last_vertex;
+    }
+  }
+  if (!n.pending) m_ready[kernel->get_uid()] = kernel;
+}
+
+void kernel_dependency_graph::add_barrier() {
+  // the kernels of the current pass already wait on the earlier ones
+  if (m_pass_kernels.empty()) return;
+  m_barrier_kernels.swap(m_pass_kernels);
+  m_pass_kernels.clear();
+}
+
+void kernel_dependency_graph::kernel_launched(trace_kernel_info_t *kernel) {
+  if (starts_draw(kernel)) m_launched_draws.insert(kernel->get_uid());
+}
+
+void kernel_dependency_graph::kernel_done(trace_kernel_info_t *kernel) {
+  std::unordered_map<unsigned, node>::iterator it =
+      m_nodes.find(kernel->get_uid());
+  assert(it != m_nodes.end());
+  for (unsigned i = 0; i < it->second.successors.size(); ++i) {
+    trace_kernel_info_t *succ = it->second.successors[i];
+    std::unordered_map<unsigned, node>::iterator dep =
+        m_nodes.find(succ->get_uid());
+    // successors can already be gone when the whole window is dropped
+    if (dep != m_nodes.end() && --dep->second.pending == 0)
+      m_ready[succ->get_uid()] = succ;
+  }
+  m_nodes.erase(it);
+  m_ready.erase(kernel->get_uid());
+
+  if (kernel->is_graphic_kernel) {
+    m_pass_kernels.erase(
+        std::remove(m_pass_kernels.begin(), m_pass_kernels.end(), kernel),
+        m_pass_kernels.end());
+    m_barrier_kernels.erase(std::remove(m_barrier_kernels.begin(),
+                                        m_barrier_kernels.end(), kernel),
+                            m_barrier_kernels.end());
+    unsigned draw = kernel->get_uid();
+    std::unordered_map<unsigned, unsigned>::iterator of =
+        m_draw_of.find(draw);
+    if (of != m_draw_of.end()) {
+      draw = of->second;
+      m_draw_of.erase(of);
+    }
+    std::unordered_map<unsigned, unsigned>::iterator pending =
+        m_draw_pending.find(draw);
+    if (pending != m_draw_pending.end() && --pending->second == 0) {
+      m_draw_pending.erase(pending);
+      m_launched_draws.erase(draw);
+    }
+  }
+
+  std::unordered_map<unsigned long, trace_kernel_info_t *>::iterator tail =
+      m_stream_tail.find(kernel->get_cuda_stream_id());
+  if (tail != m_stream_tail.end() && tail->second == kernel)
+    m_stream_tail.erase(tail);
+}
+
+std::string kernel_cycle_model::key(const std::string &trace_file) {
+  // by file name, so a model measured on one copy of the traces applies to
+  // another
+  size_t slash = trace_file.rfind('/');
+  return slash == std::string::npos ? trace_file : trace_file.substr(slash + 1);
+}
+
+bool kernel_cycle_model::load(const char *filepath) {
+  std::ifstream ifs(filepath);
+  if (!ifs.is_open()) return false;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::stringstream ss(line);
+    std::string trace_file;
+    unsigned long long cycles = 0;
+    if (ss >> trace_file >> cycles) m_cycles[trace_file] = cycles;
+  }
+  return true;
+}
+
+bool kernel_cycle_model::save(const char *filepath) const {
+  std::ofstream ofs(filepath);
+  if (!ofs.is_open()) return false;
+  ofs << "# <kernel trace> <cycles>\n";
+  for (std::map<std::string, unsigned long long>::const_iterator it =
+           m_cycles.begin();
+       it != m_cycles.end(); ++it)
+    ofs << it->first << " " << it->second << "\n";
+  return true;
+}
+
+unsigned long long kernel_cycle_model::get_cycles(
+    const std::string &trace_file) const {
+  std::map<std::string, unsigned long long>::const_iterator it =
+      m_cycles.find(key(trace_file));
+  return it == m_cycles.end() ? 0 : it->second;
+}
+
+void kernel_cycle_model::record(const std::string &trace_file,
+                                unsigned long long cycles) {
+  m_cycles[key(trace_file)] = cycles;
+}
+
+namespace {
+
+inline uint64_t fnv1a(uint64_t h, const void *data, size_t size) {
+  const unsigned char *p = (const unsigned char *)data;
+  for (size_t i = 0; i < size; i++) {
+    h ^= p[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+const uint64_t FNV1A_BASIS = 0xcbf29ce484222325ULL;
+
+// options that do not change the timing of a kernel run alone: the
+// concurrent-kernel policy and what the driver reads, writes or forks.
+// Entries ending in '_' match every option they prefix
+const char *const unkeyed_options[] = {
+    "-gpgpu_concurrent_",      "-gpgpu_graphics_sm_count",
+    "-gpgpu_dynamic_sm_count", "-gpgpu_mps_sm_count",
+    "-gpgpu_slicer",           "-gpgpu_slicer_",
+    "-gpgpu_sm_repartition",   "-gpgpu_sm_repartition_",
+    "-gpgpu_tenant_sms",       "-gpgpu_l2_tenant_ways",
+    "-gpgpu_l2_partition_policy",
+    "-trace",                  "-trace_tb_index",
+    "-trace_prefetch_",        "-trace_warp_window",
+    "-trace_frame_replay",     "-trace_replay_frames",
+    "-kernel_cycle_model",     "-kernel_cycle_model_out",
+    "-trace_fast_forward_tail", "-trace_steady_state_",
+    "-trace_fork_",            "-trace_sweep_variants",
+    "-trace_tenants",          "-trace_result_cache",
+    "-trace_regress",          "-trace_regress_tolerance"};
+
+bool is_unkeyed_option(const std::string &name) {
+  for (unsigned i = 0; i < sizeof(unkeyed_options) / sizeof(char *); i++) {
+    std::string u = unkeyed_options[i];
+    if (u[u.size() - 1] == '_' ? !name.compare(0, u.size(), u) : name == u)
+      return true;
+  }
+  return false;
+}
+
+std::string trace_file_name(const std::string &trace_file) {
+  size_t slash = trace_file.rfind('/');
+  return slash == std::string::npos ? trace_file : trace_file.substr(slash + 1);
+}
+
+}  // namespace
+
+uint64_t kernel_result_cache::hash_options(option_parser_t opp) {
+  // the printed "<name> <value> # <description>" lines, without descriptions
+  char *buf = NULL;
+  size_t size = 0;
+  FILE *f = open_memstream(&buf, &size);
+  option_parser_print(opp, f);
+  fclose(f);
+  uint64_t h = FNV1A_BASIS;
+  std::stringstream ss(std::string(buf, size));
+  free(buf);
+  std::string line;
+  while (std::getline(ss, line)) {
+    std::string name = line.substr(0, line.find(' '));
+    if (name.empty() || is_unkeyed_option(name)) continue;
+    line = line.substr(0, line.find(" # "));
+    h = fnv1a(h, line.data(), line.size());
+    h = fnv1a(h, "\n", 1);
+  }
+  return h;
+}
+
+void kernel_result_cache::open(const std::string &dir, uint64_t options_hash) {
+  m_dir = dir;
+  m_options_hash = options_hash;
+  mkdir(m_dir.c_str(), 0755);
+}
+
+std::string kernel_result_cache::entry_path(
+    const std::string &trace_file) const {
+  // the file name and size so that copies of the traces share entries
+  std::string name = trace_file_name(trace_file);
+  struct stat st;
+  uint64_t trace_size = stat(trace_file.c_str(), &st) == 0 ? st.st_size : 0;
+  uint64_t h = fnv1a(FNV1A_BASIS, &m_options_hash, sizeof(m_options_hash));
+  h = fnv1a(h, name.data(), name.size());
+  h = fnv1a(h, &trace_size, sizeof(trace_size));
+  char key[32];
+  snprintf(key, sizeof(key), "%016llx", (unsigned long long)h);
+  return m_dir + "/" + key + ".result";
+}
+
+bool kernel_result_cache::lookup(const std::string &trace_file,
+                                 kernel_result &result) const {
+  std::ifstream ifs(entry_path(trace_file).c_str());
+  if (!ifs.is_open()) return false;
+  std::string line;
+  if (!std::getline(ifs, line) || line != "# " + trace_file_name(trace_file))
+    return false;
+  result.cycles = result.insts = 0;
+  while (std::getline(ifs, line)) {
+    std::stringstream ss(line);
+    std::string stat;
+    unsigned long long value = 0;
+    if (!(ss >> stat >> value)) continue;
+    if (stat == "cycles") result.cycles = value;
+    if (stat == "insts") result.insts = value;
+  }
+  return result.cycles > 0;
+}
+
+void kernel_result_cache::store(const std::string &trace_file,
+                                const kernel_result &result) const {
+  // write to a temporary and rename, the points of a sweep share the cache
+  std::string path = entry_path(trace_file);
+  std::string tmp = path + ".tmp" + std::to_string(getpid());
+  std::ofstream ofs(tmp.c_str());
+  if (!ofs.is_open()) return;
+  ofs << "# " << trace_file_name(trace_file) << "\n"
+      << "cycles " << result.cycles << "\n"
+      << "insts " << result.insts << "\n";
+  ofs.close();
+  if (!ofs || rename(tmp.c_str(), path.c_str()) != 0) remove(tmp.c_str());
+}
+
+static const double REGRESS_NOISE_SECONDS = 0.05;
+
+bool regression_baseline::configure(const char *option, const char *tolerance,
+                                    const char *version) {
+  if (!option[0]) return true;
+  std::string o = option;
+  if (!o.compare(0, 7, "record:"))
+    m_path = o.substr(7);
+  else if (!o.compare(0, 6, "check:"))
+    m_path = o.substr(6), m_check = true;
+  m_version = version;
+  return !m_path.empty() &&
+         sscanf(tolerance, "%lf:%lf", &m_sim_tolerance, &m_wall_tolerance) ==
+             2;
+}
+
+void regression_baseline::kernel_launched(unsigned uid) {
+  m_launched[uid] = std::chrono::steady_clock::now();
+}
+
+void regression_baseline::kernel_done(unsigned uid,
+                                      const std::string &trace_file,
+                                      unsigned long long cycles,
+                                      unsigned long long insts) {
+  entry &e = m_kernels[kernel_cycle_model::key(trace_file)];
+  e.cycles += cycles;
+  e.insts += insts;
+  auto launched = m_launched.find(uid);
+  if (launched == m_launched.end()) return;
+  e.seconds += std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - launched->second)
+                   .count();
+  m_launched.erase(launched);
+}
+
+bool regression_baseline::load(const std::string &path, std::string &version,
+                               std::map<std::string, entry> &kernels) {
+  std::ifstream ifs(path.c_str());
+  if (!ifs.is_open()) return false;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (!line.compare(0, 12, "# accel-sim ")) version = line.substr(12);
+    if (line.empty() || line[0] == '#') continue;
+    std::stringstream ss(line);
+    std::string name;
+    entry e;
+    if (!(ss >> name >> e.cycles >> e.insts >> e.seconds)) return false;
+    kernels[name] = e;
+  }
+  return true;
+}
+
+bool regression_baseline::finish() const {
+  if (!m_check) {
+    std::ofstream ofs(m_path.c_str());
+    ofs << "# accel-sim " << m_version << "\n"
+        << "# <kernel trace> <cycles> <instructions> <wall seconds>\n";
+    for (const auto &k : m_kernels)
+      ofs << k.first << " " << k.second.cycles << " " << k.second.insts << " "
+          << k.second.seconds << "\n";
+    ofs.close();
+    if (!ofs)
+      printf("Unable to write regression baseline %s\n", m_path.c_str());
+    return (bool)ofs;
+  }
+
+  std::string version = "unknown";
+  std::map<std::string, entry> baseline;
+  if (!load(m_path, version, baseline)) {
+    printf("Unable to read regression baseline %s\n", m_path.c_str());
+    return false;
+  }
+  // percent off the baseline
+  auto off = [](double value, double base) {
+    return base ? 100.0 * (value - base) / base : value ? 100.0 : 0.0;
+  };
+  unsigned failed = 0;
+  double seconds = 0, baseline_seconds = 0;
+  for (const auto &b : baseline)
+    if (!m_kernels.count(b.first)) {
+      printf("regress: %s only in the baseline FAIL\n", b.first.c_str());
+      failed++;
+    }
+  for (const auto &k : m_kernels) {
+    auto b = baseline.find(k.first);
+    if (b == baseline.end()) {
+      printf("regress: %s not in the baseline FAIL\n", k.first.c_str());
+      failed++;
+      continue;
     }
+    const entry &e = k.second, &base = b->second;
+    double cycles_off = off(e.cycles, base.cycles);
+    double insts_off = off(e.insts, base.insts);
+    double wall_off = off(e.seconds, base.seconds);
+    // a growth under the timer noise of a short kernel is no slowdown
+    bool fail = fabs(cycles_off) > m_sim_tolerance ||
+                fabs(insts_off) > m_sim_tolerance ||
+                (wall_off > m_wall_tolerance &&
+                 e.seconds - base.seconds > REGRESS_NOISE_SECONDS);
+    printf("regress: %s cycles %llu (%+.2f%%), insts %llu (%+.2f%%), wall "
+           "%.3fs (%+.1f%%)%s\n",
+           k.first.c_str(), e.cycles, cycles_off, e.insts, insts_off,
+           e.seconds, wall_off, fail ? " FAIL" : "");
+    failed += fail;
+    seconds += e.seconds;
+    baseline_seconds += base.seconds;
   }
-  m_parser->get_next_threadblock_traces(threadblock_traces,
-                                        m_kernel_trace_info->trace_verion,
-                                        m_kernel_trace_info->enable_lineinfo,
-                                        m_kernel_trace_info->ifs,
-                                        m_kernel_trace_info->kernel_name + "_" + std::to_string(m_kernel_trace_info->kernel_id),
-                                        memaddrs);
+  printf("regress: %zu kernels, %u failed against the baseline of build %s, "
+         "wall %.3fs (%+.1f%%)\n",
+         m_kernels.size(), failed, version.c_str(), seconds,
+         off(seconds, baseline_seconds));
+  return !failed;
+}
+
+bool steady_state_detector::add(unsigned long long cycles) {
+  m_cycles.push_back(cycles);
+  if (m_cycles.size() > m_window) m_cycles.pop_front();
+  if (!m_window || m_cycles.size() < m_window) return false;
+  unsigned long long lo = m_cycles[0], hi = m_cycles[0];
+  for (unsigned i = 1; i < m_cycles.size(); i++) {
+    lo = std::min(lo, m_cycles[i]);
+    hi = std::max(hi, m_cycles[i]);
+  }
+  return (hi - lo) * 100 <= mean() * m_tolerance;
+}
+
+unsigned long long steady_state_detector::mean() const {
+  if (m_cycles.empty()) return 0;
+  unsigned long long sum = 0;
+  for (unsigned i = 0; i < m_cycles.size(); i++) sum += m_cycles[i];
+  return sum / m_cycles.size();
 }
 
 types_of_operands get_oprnd_type(op_type op, special_ops sp_op){
@@ -175,11 +895,16 @@ bool trace_warp_inst_t::parse_from_trace_struct(
     const std::unordered_map<std::string, OpcodeChar> *OpcodeMap,
     const class trace_config *tconfig,
     const class kernel_trace_t *kernel_trace_info, unsigned kernel_id) {
-  // fill the inst_t and warp_inst_t params
+  decode_static(trace, OpcodeMap, tconfig, kernel_trace_info, kernel_id);
+  return fill_dynamic(trace, kernel_trace_info);
+}
 
-  // fill active mask
-  active_mask_t active_mask = trace.mask;
-  set_active(active_mask);
+void trace_warp_inst_t::decode_static(
+    const inst_trace_t &trace,
+    const std::unordered_map<std::string, OpcodeChar> *OpcodeMap,
+    const class trace_config *tconfig,
+    const class kernel_trace_t *kernel_trace_info, unsigned kernel_id) {
+  // fill the inst_t and warp_inst_t params
 
   // fill and initialize common params
   m_decoded = true;
@@ -215,8 +940,9 @@ bool trace_warp_inst_t::parse_from_trace_struct(
   oprnd_type = UN_OP;
 
   // get the opcode
-  std::vector<std::string> opcode_tokens = trace.get_opcode_tokens();
-  std::string opcode1 = opcode_tokens[0];
+  const trace_opcode_t &opcode_info =
+      kernel_trace_info->opcodes->get(trace.opcode_id);
+  const std::string &opcode1 = opcode_info.tokens[0];
 
   std::unordered_map<std::string, OpcodeChar>::const_iterator it =
       OpcodeMap->find(opcode1);
@@ -230,11 +956,11 @@ bool trace_warp_inst_t::parse_from_trace_struct(
       sp_op = (special_ops) (it2->second);
       oprnd_type = get_oprnd_type(op, sp_op);
   } else {
-    std::cout << "ERROR:  undefined instruction : " << trace.opcode
+    std::cout << "ERROR:  undefined instruction : " << opcode_info.opcode
               << " Opcode: " << opcode1 << std::endl;
     assert(0 && "undefined instruction");
   }
-  std::string opcode = trace.opcode;
+  const std::string &opcode = opcode_info.opcode;
   if(opcode1 == "MUFU"){ // Differentiate between different MUFU operations for power model
     if ((opcode == "MUFU.SIN") || (opcode == "MUFU.COS"))
       sp_op = FP_SIN_OP;
@@ -272,14 +998,6 @@ bool trace_warp_inst_t::parse_from_trace_struct(
   // fill latency and initl
   tconfig->set_latency(op, latency, initiation_interval);
 
-  // fill addresses
-  if (trace.memadd_info != NULL) {
-    data_size = trace.memadd_info->width;
-    for (unsigned i = 0; i < warp_size(); ++i)
-      set_addr(i, trace.memadd_info->addrs[i]);
-  }
-
-
   // handle special cases and fill memory space
   switch (m_opcode) {
     case OP_LDC: //handle Load from Constant
@@ -291,7 +1009,6 @@ bool trace_warp_inst_t::parse_from_trace_struct(
       break;
     case OP_LDG:
     case OP_LDL:
-      assert(data_size > 0);
       memory_op = memory_load;
       cache_op = CACHE_ALL;
       if (m_opcode == OP_LDL)
@@ -299,14 +1016,12 @@ bool trace_warp_inst_t::parse_from_trace_struct(
       else
         space.set_type(global_space);
       // check the cache scope, if its strong GPU, then bypass L1
-      if (trace.check_opcode_contain(opcode_tokens, "STRONG") &&
-          trace.check_opcode_contain(opcode_tokens, "GPU")) {
+      if (opcode_info.has_token("STRONG") && opcode_info.has_token("GPU")) {
         cache_op = CACHE_GLOBAL;
       }
       break;
     case OP_STG:
     case OP_STL:
-      assert(data_size > 0);
       memory_op = memory_store;
       cache_op = CACHE_ALL;
       if (m_opcode == OP_STL)
@@ -317,7 +1032,6 @@ bool trace_warp_inst_t::parse_from_trace_struct(
     case OP_ATOMG:
     case OP_RED:
     case OP_ATOM:
-      assert(data_size > 0);
       memory_op = memory_load;
       op = LOAD_OP;
       space.set_type(global_space);
@@ -325,62 +1039,28 @@ bool trace_warp_inst_t::parse_from_trace_struct(
       cache_op = CACHE_GLOBAL;  // all the atomics should be done at L2
       break;
     case OP_LDS:
-      assert(data_size > 0);
       memory_op = memory_load;
       space.set_type(shared_space);
       break;
     case OP_STS:
-      assert(data_size > 0);
       memory_op = memory_store;
       space.set_type(shared_space);
       break;
     case OP_ATOMS:
-      assert(data_size > 0);
       m_isatomic = true;
       memory_op = memory_load;
       space.set_type(shared_space);
       break;
     case OP_LDSM:
-      assert(data_size > 0);
       space.set_type(shared_space);
       break;
     case OP_ST:
     case OP_LD:
-      assert(data_size > 0);
       if (m_opcode == OP_LD)
         memory_op = memory_load;
       else
         memory_op = memory_store;
-      // resolve generic loads
-      if (kernel_trace_info->shmem_base_addr == 0 ||
-          kernel_trace_info->local_base_addr == 0) {
-        // shmem and local addresses are not set
-        // assume all the mem reqs are shared by default
-        space.set_type(shared_space);
-      } else {
-        // check the first active address
-        for (unsigned i = 0; i < warp_size(); ++i)
-          if (active_mask.test(i)) {
-            if (trace.memadd_info->addrs[i] >=
-                    kernel_trace_info->shmem_base_addr &&
-                trace.memadd_info->addrs[i] <
-                    kernel_trace_info->local_base_addr)
-              space.set_type(shared_space);
-            else if (trace.memadd_info->addrs[i] >=
-                         kernel_trace_info->local_base_addr &&
-                     trace.memadd_info->addrs[i] <
-                         kernel_trace_info->local_base_addr +
-                             LOCAL_MEM_SIZE_MAX) {
-              space.set_type(local_space);
-              cache_op = CACHE_ALL;
-            } else {
-              space.set_type(global_space);
-              cache_op = CACHE_ALL;
-            }
-            break;
-          }
-      }
-
+      // the space of generic loads is resolved per instance
       break;
     case OP_BAR:
       // TO DO: fill this correctly
@@ -417,10 +1097,85 @@ bool trace_warp_inst_t::parse_from_trace_struct(
       cache_op = CACHE_ALL;
       mem_op = TEX;
       space.set_type(global_space);
+      break;
+    default:
+      break;
+  }
+}
+
+bool trace_warp_inst_t::fill_dynamic(
+    const inst_trace_t &trace, const class kernel_trace_t *kernel_trace_info) {
+  // fill active mask
+  active_mask_t active_mask = trace.mask;
+  set_active(active_mask);
+
+  // fill addresses
+  if (trace.memadd_info != NULL) {
+    if (m_opcode != OP_LDC) data_size = trace.memadd_info->width;
+    for (unsigned i = 0; i < warp_size(); ++i)
+      set_addr(i, trace.memadd_info->addrs[i]);
+  }
+
+  switch (m_opcode) {
+    case OP_LDG:
+    case OP_LDL:
+    case OP_STG:
+    case OP_STL:
+    case OP_ATOMG:
+    case OP_RED:
+    case OP_ATOM:
+    case OP_LDS:
+    case OP_STS:
+    case OP_ATOMS:
+    case OP_LDSM:
+      assert(data_size > 0);
+      break;
+    case OP_ST:
+    case OP_LD:
+      assert(data_size > 0);
+      // resolve generic loads
+      if (kernel_trace_info->shmem_base_addr == 0 ||
+          kernel_trace_info->local_base_addr == 0) {
+        // shmem and local addresses are not set
+        // assume all the mem reqs are shared by default
+        space.set_type(shared_space);
+      } else {
+        // check the first active address
+        for (unsigned i = 0; i < warp_size(); ++i)
+          if (active_mask.test(i)) {
+            if (trace.memadd_info->addrs[i] >=
+                    kernel_trace_info->shmem_base_addr &&
+                trace.memadd_info->addrs[i] <
+                    kernel_trace_info->local_base_addr)
+              space.set_type(shared_space);
+            else if (trace.memadd_info->addrs[i] >=
+                         kernel_trace_info->local_base_addr &&
+                     trace.memadd_info->addrs[i] <
+                         kernel_trace_info->local_base_addr +
+                             LOCAL_MEM_SIZE_MAX) {
+              space.set_type(local_space);
+              cache_op = CACHE_ALL;
+            } else {
+              space.set_type(global_space);
+              cache_op = CACHE_ALL;
+            }
+            break;
+          }
+      }
+      break;
+    case OP_TLD4:
+    case OP_TEX:
+    case OP_TLD:
+    case OP_TMML:
+    case OP_TXD:
+    case OP_TXQ:
       if (data_size == 0) {
         return false;
       }
       break;
+    case OP_TRACE_RAY:
+      if (trace.memadd_info != NULL) fill_rt_accesses(trace.memadd_info);
+      break;
     default:
       break;
   }
@@ -428,14 +1183,217 @@ bool trace_warp_inst_t::parse_from_trace_struct(
   return true;
 }
 
+void trace_warp_inst_t::fill_rt_accesses(
+    const inst_memadd_info_t *memadd_info) {
+  // step k fetches the k-th transaction of every active ray; rays of a warp
+  // touching the same 32B chunk in the same step share one fetch. The RT
+  // unit consumes the queue from the back, so steps are pushed to the front
+  m_accessq.clear();
+  mem_access_byte_mask_t byte_mask;
+  byte_mask.set();
+  mem_access_sector_mask_t sector_mask;
+  std::vector<new_addr_type> step_addrs;
+  for (unsigned step = 0;; step++) {
+    step_addrs.clear();
+    for (unsigned t = 0; t < warp_size(); ++t) {
+      unsigned idx = memadd_info->bvh_offsets[t] + step;
+      if (!active(t) || idx >= memadd_info->bvh_offsets[t + 1]) continue;
+      uint64_t addr = memadd_info->bvh_addrs[idx];
+      new_addr_type chunk = (addr & ~(uint64_t)(SECTOR_SIZE - 1)) |
+                            ((addr & BVH_PRIMITIVE_FLAG) ? RT_ACCESS_PRIMITIVE
+                                                         : 0);
+      if (std::find(step_addrs.begin(), step_addrs.end(), chunk) ==
+          step_addrs.end())
+        step_addrs.push_back(chunk);
+    }
+    if (step_addrs.empty()) break;
+    for (unsigned i = 0; i < step_addrs.size(); ++i) {
+      new_addr_type addr = step_addrs[i] | (i == 0 ? RT_ACCESS_STEP : 0);
+      sector_mask.reset();
+      sector_mask.set((addr % MAX_MEMORY_ACCESS_SIZE) / SECTOR_SIZE);
+      m_accessq.push_front(mem_access_t(GLOBAL_ACC_R, addr, SECTOR_SIZE, false,
+                                        get_active_mask(), byte_mask,
+                                        sector_mask, m_config->gpgpu_ctx));
+    }
+  }
+}
+
 trace_config::trace_config() {}
 
 void trace_config::reg_options(option_parser_t opp) {
+  m_opp = opp;
   option_parser_register(opp, "-trace", OPT_CSTR, &g_traces_filename,
                          "traces kernel file"
                          "traces kernel file directory",
                          "./traces/kernelslist.g");
 
+  option_parser_register(opp, "-trace_tb_index", OPT_BOOL, &trace_tb_index,
+                         "load each CTA trace by its CTA id through the "
+                         "thread block index instead of in file order",
+                         "0");
+  option_parser_register(opp, "-trace_prefetch_threads", OPT_UINT32,
+                         &trace_prefetch_threads,
+                         "number of threads parsing upcoming CTA traces in "
+                         "the background (0 = parse on demand)",
+                         "0");
+  option_parser_register(opp, "-trace_prefetch_depth", OPT_UINT32,
+                         &trace_prefetch_depth,
+                         "number of CTAs prefetched ahead per running kernel",
+                         "4");
+
+  option_parser_register(opp, "-trace_warp_window", OPT_UINT32,
+                         &trace_warp_window,
+                         "decode warp traces in windows of this many "
+                         "instructions instead of whole CTAs up front, "
+                         "bounds memory for long kernels (0 = off)",
+                         "0");
+
+  option_parser_register(opp, "-trace_frame_replay", OPT_BOOL,
+                         &trace_frame_replay,
+                         "keep kernel headers and thread block indexes "
+                         "loaded when graphics or compute kernels are "
+                         "relaunched, instead of parsing them again",
+                         "0");
+
+  option_parser_register(opp, "-trace_replay_frames", OPT_UINT32,
+                         &trace_replay_frames,
+                         "number of graphics frames to simulate while "
+                         "compute is still running (0 = until compute is "
+                         "done)",
+                         "0");
+
+  option_parser_register(opp, "-kernel_cycle_model", OPT_CSTR,
+                         &kernel_cycle_model_file,
+                         "per kernel cycles of isolated runs, as written by "
+                         "-kernel_cycle_model_out",
+                         "");
+
+  option_parser_register(opp, "-kernel_cycle_model_out", OPT_CSTR,
+                         &kernel_cycle_model_out,
+                         "write the measured cycles of every finished "
+                         "kernel to this file at the end of the run",
+                         "");
+
+  option_parser_register(opp, "-trace_result_cache", OPT_CSTR,
+                         &trace_result_cache,
+                         "directory caching the cycles of kernels run "
+                         "isolated; concurrent runs take the cycles of "
+                         "kernels missing from -kernel_cycle_model from it",
+                         "");
+
+  option_parser_register(opp, "-trace_regress", OPT_CSTR, &trace_regress,
+                         "record:<file> writes the cycles, instructions and "
+                         "wall time of every kernel as a baseline, "
+                         "check:<file> fails the run when it is off one",
+                         "");
+
+  option_parser_register(opp, "-trace_regress_tolerance", OPT_CSTR,
+                         &trace_regress_tolerance,
+                         "percent the cycles and instructions of a kernel "
+                         "may be off and its wall time may grow, <cycles>:"
+                         "<wall>",
+                         "0:50");
+
+  option_parser_register(opp, "-trace_fast_forward_tail", OPT_BOOL,
+                         &trace_fast_forward_tail,
+                         "once graphics (or compute) is done for good, "
+                         "skip the remaining kernels of the other side "
+                         "using -kernel_cycle_model",
+                         "0");
+
+  option_parser_register(opp, "-trace_steady_state_frames", OPT_UINT32,
+                         &trace_steady_state_frames,
+                         "end a concurrent run once this many iterations of "
+                         "the relaunched side took the same cycles and "
+                         "extrapolate the other side using "
+                         "-kernel_cycle_model (0 = off)",
+                         "0");
+  option_parser_register(opp, "-trace_steady_state_tolerance", OPT_UINT32,
+                         &trace_steady_state_tolerance,
+                         "percent of the mean the iterations of "
+                         "-trace_steady_state_frames may spread",
+                         "2");
+
+  option_parser_register(opp, "-trace_sample_intervals", OPT_UINT32,
+                         &trace_sample_intervals,
+                         "simulate only a warm-up and this many CTA "
+                         "intervals of large kernels and extrapolate the "
+                         "rest, needs -trace_tb_index (0 = off)",
+                         "0");
+  option_parser_register(opp, "-trace_sample_interval_ctas", OPT_UINT32,
+                         &trace_sample_interval_ctas,
+                         "CTAs per sampled interval", "256");
+  option_parser_register(opp, "-trace_sample_warmup_ctas", OPT_UINT32,
+                         &trace_sample_warmup_ctas,
+                         "CTAs simulated before the first sampled interval",
+                         "1024");
+  option_parser_register(opp, "-trace_sample_min_ctas", OPT_UINT32,
+                         &trace_sample_min_ctas,
+                         "only sample kernels with at least this many CTAs",
+                         "16384");
+  option_parser_register(opp, "-trace_sample_policy", OPT_CSTR,
+                         &trace_sample_policy,
+                         "placement of the intervals, one per equal stratum "
+                         "of the CTAs after the warm-up: periodic (middle "
+                         "of the stratum) or random",
+                         "periodic");
+
+  option_parser_register(opp, "-trace_warmup_kernels", OPT_UINT32,
+                         &trace_warmup_kernels,
+                         "do not simulate the first this many kernels, only "
+                         "stream their global memory accesses through the "
+                         "L1D and L2 tag arrays to warm the caches up",
+                         "0");
+  option_parser_register(opp, "-trace_warmup_ctas", OPT_UINT32,
+                         &trace_warmup_ctas,
+                         "warm the caches up functionally with the first "
+                         "this many CTAs of every simulated kernel and "
+                         "simulate the rest (0 = off)",
+                         "0");
+  option_parser_register(opp, "-trace_draw_depth", OPT_UINT32,
+                         &trace_draw_depth,
+                         "draws in flight at once, a vertex kernel only "
+                         "launches below it (0 = up to 3/4 of "
+                         "-gpgpu_max_concurrent_kernel graphics kernels)",
+                         "0");
+
+  option_parser_register(opp, "-trace_fork_cycle", OPT_UINT64,
+                         &trace_fork_cycle,
+                         "fork one process per -trace_fork_variants entry "
+                         "at this cycle, so the variants share the warmed "
+                         "up state (0 = off)",
+                         "0");
+  option_parser_register(opp, "-trace_fork_variants", OPT_CSTR,
+                         &trace_fork_variants,
+                         "';' separated option lists applied by each forked "
+                         "process, e.g. \"-gpgpu_dynamic_sm_count 8;"
+                         "-gpgpu_l2_graphics_ratio 25\"",
+                         "");
+  option_parser_register(opp, "-trace_fork_log", OPT_CSTR, &trace_fork_log,
+                         "forked process i writes its output to "
+                         "<prefix>_<i>.log",
+                         "fork_variant");
+  option_parser_register(opp, "-trace_sweep_variants", OPT_CSTR,
+                         &trace_sweep_variants,
+                         "';' separated option lists like "
+                         "-trace_fork_variants, forked before the first "
+                         "cycle once the command list and every kernel "
+                         "header are parsed, so the processes share them",
+                         "");
+  option_parser_register(opp, "-trace_tenants", OPT_CSTR, &trace_tenants,
+                         "';' separated groups of ',' separated compute "
+                         "workloads, group i is tenant i + 1, e.g. "
+                         "\"vpi_sample_03_harris_corners,klt_tracker;"
+                         "ritnet\" (empty = all compute is tenant 1)",
+                         "");
+  option_parser_register(opp, "-trace_roi_pc", OPT_CSTR, &trace_roi_pc,
+                         "',' separated hex PC ranges lo-hi, both included, "
+                         "of the region of interest: the instructions "
+                         "outside it only warm the caches, e.g. "
+                         "\"0x1a0-0x3f0\". A \"-roi pc\" line in a kernel "
+                         "trace header overrides it (empty = all)",
+                         "");
+
   option_parser_register(opp, "-trace_opcode_latency_initiation_int", OPT_CSTR,
                          &trace_opcode_latency_initiation_int,
                          "Opcode latencies and initiation for integers in "
@@ -485,6 +1443,77 @@ void trace_config::parse_config() {
     sscanf(trace_opcode_latency_initiation_specialized_op[j], "%u,%u",
            &specialized_unit_latency[j], &specialized_unit_initiation[j]);
   }
+
+  if (!strcmp(trace_sample_policy, "random")) {
+    m_sample_random = true;
+  } else if (!strcmp(trace_sample_policy, "periodic")) {
+    m_sample_random = false;
+  } else {
+    printf("Unknown -trace_sample_policy %s\n", trace_sample_policy);
+    exit(1);
+  }
+  if (trace_sample_interval_ctas < 2) trace_sample_interval_ctas = 2;
+  m_roi.clear();
+  if (!parse_pc_ranges(trace_roi_pc, m_roi)) {
+    printf("Malformed -trace_roi_pc %s\n", trace_roi_pc);
+    exit(1);
+  }
+
+  m_tenant_workloads.clear();
+  if (trace_tenants[0]) {
+    std::stringstream groups(trace_tenants);
+    std::string group;
+    while (std::getline(groups, group, ';')) {
+      m_tenant_workloads.push_back(std::vector<std::string>());
+      std::stringstream names(group);
+      std::string name;
+      while (std::getline(names, name, ','))
+        if (!name.empty()) m_tenant_workloads.back().push_back(name + "-");
+    }
+    if (m_tenant_workloads.size() >= MAX_TENANTS) {
+      printf("-trace_tenants %s names more than %d compute tenants\n",
+             trace_tenants, MAX_TENANTS - 1);
+      exit(1);
+    }
+  }
+}
+
+bool trace_config::parse_pc_ranges(
+    const char *ranges,
+    std::vector<std::pair<address_type, address_type> > &roi) {
+  roi.clear();
+  std::stringstream ss(ranges);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    unsigned long long lo, hi;
+    char end;
+    if (range.find_first_not_of(" \t") == std::string::npos) continue;
+    if (sscanf(range.c_str(), " %llx - %llx %c", &lo, &hi, &end) != 2 ||
+        lo > hi)
+      return false;
+    roi.push_back(std::make_pair((address_type)lo, (address_type)hi));
+  }
+  return true;
+}
+
+unsigned trace_config::get_tenant(const std::string &trace_file) const {
+  // setup_concurrent.py links the traces of a workload as <workload>-<file>
+  size_t slash = trace_file.find_last_of('/');
+  std::string file =
+      slash == std::string::npos ? trace_file : trace_file.substr(slash + 1);
+  for (unsigned t = 0; t < m_tenant_workloads.size(); t++)
+    for (unsigned w = 0; w < m_tenant_workloads[t].size(); w++)
+      if (!file.compare(0, m_tenant_workloads[t][w].size(),
+                        m_tenant_workloads[t][w]))
+        return t + 1;
+  return 1;
+}
+
+void trace_config::apply_options(const std::string &options) {
+  // the parent keeps writing its own cycle model, a variant has to name one
+  static char no_file[] = "";
+  kernel_cycle_model_out = no_file;
+  option_parser_delimited_string(m_opp, options.c_str(), " ");
 }
 void trace_config::set_latency(unsigned category, unsigned &latency,
                                unsigned &initiation_interval) const {
@@ -552,6 +1581,17 @@ void trace_shader_core_ctx::create_shd_warp() {
   }
 }
 
+void trace_shader_core_ctx::kernel_released(const kernel_info_t *kernel) {
+  shader_core_ctx::kernel_released(kernel);
+  for (unsigned i = 0; i < m_warp.size(); ++i) {
+    trace_shd_warp_t *m_trace_warp = static_cast<trace_shd_warp_t *>(m_warp[i]);
+    if (m_trace_warp->get_kernel_info() != kernel) continue;
+    m_trace_warp->clear();
+    std::vector<inst_trace_t>().swap(m_trace_warp->warp_traces);
+    m_trace_warp->set_kernel(NULL);
+  }
+}
+
 void trace_shader_core_ctx::get_pdom_stack_top_info(unsigned warp_id,
                                                     const warp_inst_t *pI,
                                                     unsigned *pc,
@@ -580,7 +1620,12 @@ unsigned trace_shader_core_ctx::sim_init_thread(
     kernel.increment_thread_id();
   }
 
-  if (!kernel.more_threads_in_cta()) kernel.increment_cta_id();
+  if (!kernel.more_threads_in_cta()) {
+    kernel.increment_cta_id();
+    trace_kernel_info_t &trace_kernel =
+        static_cast<trace_kernel_info_t &>(kernel);
+    if (trace_kernel.is_sampled()) trace_kernel.skip_unsampled_ctas();
+  }
 
   return 1;
 }
@@ -597,7 +1642,7 @@ void trace_shader_core_ctx::init_warps(unsigned cta_id, unsigned start_thread,
   unsigned end_warp = end_thread / m_config->warp_size +
                       ((end_thread % m_config->warp_size) ? 1 : 0);
 
-  init_traces(start_warp, end_warp, kernel);
+  init_traces(start_warp, end_warp, ctaid, kernel);
 }
 
 const warp_inst_t *trace_shader_core_ctx::get_next_inst(unsigned warp_id,
@@ -614,29 +1659,62 @@ void trace_shader_core_ctx::updateSIMTStack(unsigned warpId,
 }
 
 void trace_shader_core_ctx::init_traces(unsigned start_warp, unsigned end_warp,
-                                        kernel_info_t &kernel) {
+                                        unsigned ctaid, kernel_info_t &kernel) {
   std::vector<std::vector<inst_trace_t> *> threadblock_traces;
+  std::vector<trace_warp_cursor *> cursors;
   for (unsigned i = start_warp; i < end_warp; ++i) {
     trace_shd_warp_t *m_trace_warp = static_cast<trace_shd_warp_t *>(m_warp[i]);
     m_trace_warp->clear();
     threadblock_traces.push_back(&(m_trace_warp->warp_traces));
+    cursors.push_back(&(m_trace_warp->trace_cursor));
   }
   trace_kernel_info_t &trace_kernel =
       static_cast<trace_kernel_info_t &>(kernel);
-  std::set<uint64_t> memaddrs;
-  trace_kernel.get_next_threadblock_traces(threadblock_traces, memaddrs);
-  // reduce memaddrs
-  if (trace_kernel.get_name().find("VERTEX") != std::string::npos) {
-    for (auto mem : memaddrs) {
-      m_gpu->perf_memcpy_to_gpu(mem, 32, true);
-    }
+  const trace_config *tconfig = trace_kernel.get_trace_config();
+  // the clusters cycling on the pool only read the traces and the decoded
+  // instructions, so the warps get all of theirs here
+  bool parallel = m_gpu->get_config().parallel_core_clusters();
+  if (parallel && (tconfig->get_warp_window() || trace_kernel.has_roi())) {
+    fprintf(stderr, "GPGPU-Sim: -gpgpu_core_cluster_threads does not support "
+                    "-trace_warp_window or trace ROIs\n");
+    exit(1);
+  }
+  if (trace_kernel.is_sampled())
+    trace_kernel.sample_cta_issued(
+        ctaid, m_gpu->gpu_sim_cycle + m_gpu->gpu_tot_sim_cycle);
+  std::vector<uint64_t> memaddrs;
+  {
+    sim_phase_timer timer(m_gpu->profiler(), PHASE_TRACE_PARSE);
+    if (tconfig->get_warp_window()) {
+      // streaming mode, the warps decode their first window below
+      bool found = true;
+      if (tconfig->load_ctas_by_id())
+        found = trace_kernel.get_threadblock_cursors(cursors, ctaid);
+      else
+        trace_kernel.get_next_threadblock_cursors(cursors);
+      assert(found && "CTA missing from the kernel trace");
+    } else if (tconfig->load_ctas_by_id()) {
+      bool found = trace_kernel.get_threadblock_traces(threadblock_traces,
+                                                       ctaid, memaddrs);
+      assert(found && "CTA missing from the kernel trace");
+    } else
+      trace_kernel.get_next_threadblock_traces(threadblock_traces, memaddrs);
+  }
+  // vertex buffer lines, the parser only collects them for vertex kernels.
+  // Kernels with MemcpyVulkan buffers had them prefetched whole at launch
+  if (!m_gpu->vertex_buffers().has_buffers(trace_kernel.get_uid())) {
+    for (auto mem : memaddrs) m_gpu->perf_memcpy_to_gpu(mem, 32, true);
   }
 
   // set the pc from the traces and ignore the functional model
   for (unsigned i = start_warp; i < end_warp; ++i) {
     trace_shd_warp_t *m_trace_warp = static_cast<trace_shd_warp_t *>(m_warp[i]);
-    m_trace_warp->set_next_pc(m_trace_warp->get_start_trace_pc());
     m_trace_warp->set_kernel(&trace_kernel);
+    m_trace_warp->refill_traces();
+    m_trace_warp->set_next_pc(m_trace_warp->get_start_trace_pc());
+    if (parallel)
+      for (unsigned t = 0; t < m_trace_warp->warp_traces.size(); ++t)
+        trace_kernel.get_decoded_inst(m_trace_warp->warp_traces[t], m_config);
   }
 }
 
@@ -688,9 +1766,7 @@ void trace_shader_core_ctx::issue_warp(register_set &warp,
                                        const warp_inst_t *pI,
                                        const active_mask_t &active_mask,
                                        unsigned warp_id, unsigned sch_id) {
+  // pI belongs to the warp's instruction pool, it is copied into the
+  // pipeline register and recycled once the ibuffer moves on
   shader_core_ctx::issue_warp(warp, pI, active_mask, warp_id, sch_id);
-
-  // delete warp_inst_t class here, it is not required anymore by gpgpu-sim
-  // after issue
-  delete pI;
 }
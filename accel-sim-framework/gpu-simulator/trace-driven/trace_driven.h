@@ -28,8 +28,13 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include <assert.h>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <set>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unordered_map>
 
 #ifndef TRACE_DRIVEN_H
 #define TRACE_DRIVEN_H
@@ -76,7 +81,23 @@ class trace_warp_inst_t : public warp_inst_t {
       const class trace_config *tconfig,
       const class kernel_trace_t *kernel_trace_info, unsigned kernel_id);
 
+  // decode the fields shared by every dynamic instance of the static
+  // instruction at trace.m_pc
+  void decode_static(
+      const inst_trace_t &trace,
+      const std::unordered_map<std::string, OpcodeChar> *OpcodeMap,
+      const class trace_config *tconfig,
+      const class kernel_trace_t *kernel_trace_info, unsigned kernel_id);
+  // fill the active mask and addresses of one dynamic instance, returns false
+  // for texture instructions with no data, which are skipped
+  bool fill_dynamic(const inst_trace_t &trace,
+                    const class kernel_trace_t *kernel_trace_info);
+
  private:
+  // turn the per-ray BVH transactions of a TRACE_RAY into the RT unit's
+  // access queue, one coherent traversal step at a time
+  void fill_rt_accesses(const inst_memadd_info_t *memadd_info);
+
   unsigned m_opcode;
 };
 
@@ -86,32 +107,280 @@ class trace_kernel_info_t : public kernel_info_t {
                       trace_function_info *m_function_info,
                       trace_parser *parser, class trace_config *config,
                       kernel_trace_t *kernel_trace_info);
+  ~trace_kernel_info_t();
 
   void get_next_threadblock_traces(
       std::vector<std::vector<inst_trace_t> *> threadblock_traces,
-      std::set<uint64_t> &memaddrs);
+      std::vector<uint64_t> &memaddrs);
+
+  // seek to the traces of CTA ctaid (linear x-then-y-then-z cta id) through
+  // the thread block index
+  bool get_threadblock_traces(
+      std::vector<std::vector<inst_trace_t> *> threadblock_traces,
+      unsigned ctaid, std::vector<uint64_t> &memaddrs);
+
+  // streaming mode counterparts: locate the warps of the next CTA (or of
+  // ctaid) and decode their traces window by window
+  void get_next_threadblock_cursors(std::vector<trace_warp_cursor *> cursors);
+  bool get_threadblock_cursors(std::vector<trace_warp_cursor *> cursors,
+                               unsigned ctaid);
+  void read_warp_window(trace_warp_cursor &cursor,
+                        std::vector<inst_trace_t> &warp_traces,
+                        std::vector<uint64_t> &memaddrs);
 
   unsigned long get_cuda_stream_id() {
     return m_kernel_trace_info->cuda_stream_id;
   }
 
   kernel_trace_t *get_trace_info() { return m_kernel_trace_info; }
+  const trace_config *get_trace_config() const { return m_tconfig; }
+
+  // static part of the instruction at trace.m_pc, decoded on first use.
+  // Dynamic instances copy it and only fill in the mask and addresses
+  const trace_warp_inst_t *get_decoded_inst(const inst_trace_t &trace,
+                                            const class core_config *config) {
+    address_type slot = trace.m_pc / DECODED_PC_ALIGN;
+    if (trace.m_pc % DECODED_PC_ALIGN == 0 && slot < m_decoded_table.size() &&
+        m_decoded_table[slot])
+      return m_decoded_table[slot];
+    return decode_inst(trace, config);
+  }
+  void clear_decoded_insts();
 
   bool was_launched() { return m_was_launched; }
 
   void set_launched() { m_was_launched = true; }
   void unset_launched() { m_was_launched = false; }
 
+  // -trace_sample_intervals: only the warm-up CTAs and the sampled intervals
+  // are simulated, the cycles of the skipped CTAs are extrapolated from the
+  // cycles per CTA measured in the intervals
+  bool is_sampled() const { return !m_sample_starts.empty(); }
+  unsigned num_sampled_ctas() const;
+  // advance the next CTA id past the CTAs outside the sample
+  void skip_unsampled_ctas();
+  void sample_cta_issued(unsigned ctaid, unsigned long long cycle);
+  // estimated end_cycle - start_cycle of the full kernel and the half width
+  // of its 95% confidence interval, false if no interval was measured
+  bool estimate_cycles(unsigned long long &cycles,
+                       unsigned long long &half_width) const;
+
+  // -trace_warmup_kernels, -trace_warmup_ctas: stream the global memory
+  // accesses of the next ctas CTAs through the L1D and L2 tag arrays without
+  // simulating them, and advance the next CTA id past them. CTA i warms the
+  // L1D of SM i modulo the SMs. Returns the CTAs warmed
+  unsigned functional_warmup(class gpgpu_sim *gpu, unsigned ctas);
+
+  // -trace_roi_pc, or the "-roi pc" line of the kernel trace header: only
+  // the instructions at PCs in the region of interest are simulated. The
+  // warps step over the others functionally, their global memory accesses
+  // only warm the L1D of the SM and the L2, so the kernel's stats cover the
+  // region of interest. EXIT always issues, the warps still finish
+  bool has_roi() const { return !m_roi.empty(); }
+  bool in_roi(address_type pc) const;
+  // step over the instruction at trace on warp warp_id of SM sid
+  void skip_inst(class gpgpu_sim *gpu, unsigned sid, unsigned warp_id,
+                 const inst_trace_t &trace);
+  unsigned long long m_roi_skipped_insts;
+  unsigned long long m_roi_warmed_accesses;
+
  private:
+  void plan_sample();
+  bool in_sample(unsigned ctaid) const;
+  void warm_warp(class gpgpu_sim *gpu, unsigned sid, unsigned warp_id,
+                 const std::vector<inst_trace_t> &warp_traces);
+  // returns the accesses the instruction warmed
+  unsigned warm_inst(class gpgpu_sim *gpu, unsigned sid, unsigned warp_id,
+                     const inst_trace_t &trace);
+  const trace_warp_inst_t *decode_inst(const inst_trace_t &trace,
+                                       const class core_config *config);
+
+  // SASS instructions are 8 (Kepler, Pascal) or 16 bytes, so the decoded
+  // instructions of a kernel are a table indexed by pc / 8. PCs off that
+  // grid or beyond DECODED_TABLE_MAX slots fall back to the map
+  static const unsigned DECODED_PC_ALIGN = 8;
+  static const unsigned DECODED_TABLE_MAX = 1 << 20;
+
   trace_config *m_tconfig;
   const std::unordered_map<std::string, OpcodeChar> *OpcodeMap;
   trace_parser *m_parser;
   kernel_trace_t *m_kernel_trace_info;
   bool m_was_launched;
+  std::vector<trace_warp_inst_t *> m_decoded_table;
+  std::unordered_map<address_type, trace_warp_inst_t *> m_decoded_insts;
+
+  // first CTA id of each sampled interval, ascending
+  std::vector<unsigned> m_sample_starts;
+  std::vector<unsigned long long> m_interval_first_issue;
+  std::vector<unsigned long long> m_interval_last_issue;
+  unsigned long long m_last_issue;
+  // the region of interest, inclusive PC ranges
+  std::vector<std::pair<address_type, address_type> > m_roi;
 
   friend class trace_shd_warp_t;
 };
 
+// launch dependencies between the kernels in the driver window. Kernels on
+// one stream run in command order (fragment shaders share the stream of
+// their vertex shader), and a kernel only becomes ready once everything it
+// waits on is done, so launching never rescans the whole window.
+//
+// The graphics kernels of one render pass only wait on their own stream, so
+// the draws of a pass overlap. A RenderPass line of the command list is a
+// barrier: the graphics kernels after it also wait on every graphics kernel
+// before it. A draw is a vertex kernel and the fragment kernels after it,
+// in flight from the launch of the vertex kernel until all of them finished
+class kernel_dependency_graph {
+ public:
+  kernel_dependency_graph() : m_last_vertex((unsigned)-1) {}
+
+  // kernels must be added in command order
+  void add_kernel(trace_kernel_info_t *kernel);
+  // the graphics kernels added from now on start a new render pass
+  void add_barrier();
+  void kernel_launched(trace_kernel_info_t *kernel);
+  // kernel finished (or was dropped), releases the kernels waiting on it
+  void kernel_done(trace_kernel_info_t *kernel);
+
+  // ready kernels not launched yet, by uid so in command order
+  std::map<unsigned, trace_kernel_info_t *> &ready() { return m_ready; }
+  unsigned draws_in_flight() const { return m_launched_draws.size(); }
+  static bool starts_draw(const trace_kernel_info_t *kernel) {
+    return kernel->is_graphic_kernel &&
+           kernel->get_name().find("VERTEX") != std::string::npos;
+  }
+
+ private:
+  struct node {
+    unsigned pending;  // unfinished predecessors
+    std::vector<trace_kernel_info_t *> successors;
+  };
+  std::unordered_map<unsigned, node> m_nodes;
+  // last kernel added on each stream that has not finished
+  std::unordered_map<unsigned long, trace_kernel_info_t *> m_stream_tail;
+  std::map<unsigned, trace_kernel_info_t *> m_ready;
+  // unfinished graphics kernels of the current render pass and of the
+  // passes before the last barrier
+  std::vector<trace_kernel_info_t *> m_pass_kernels;
+  std::vector<trace_kernel_info_t *> m_barrier_kernels;
+  // unfinished kernels of each draw by the uid of its vertex kernel, the
+  // draw of each fragment kernel and the draws whose vertex kernel launched
+  std::unordered_map<unsigned, unsigned> m_draw_pending;
+  std::unordered_map<unsigned, unsigned> m_draw_of;
+  std::set<unsigned> m_launched_draws;
+  unsigned m_last_vertex;
+};
+
+// isolated runtime of each kernel by trace file name, measured by an earlier
+// run that wrote -kernel_cycle_model_out. Lets the driver fast-forward the
+// tail of a run where only graphics or only compute is left
+class kernel_cycle_model {
+ public:
+  bool load(const char *filepath);
+  bool save(const char *filepath) const;
+  // modeled cycles of the kernel traced in trace_file, 0 if unknown
+  unsigned long long get_cycles(const std::string &trace_file) const;
+  void record(const std::string &trace_file, unsigned long long cycles);
+  // the name the kernel traced in trace_file goes by
+  static std::string key(const std::string &trace_file);
+
+ private:
+
+  std::map<std::string, unsigned long long> m_cycles;
+};
+
+// -trace_result_cache: cycles and instructions of the kernels of isolated
+// runs, those with only graphics or only compute kernels, one file per kernel
+// in the cache directory. An entry is keyed by the trace file name and size
+// and a hash of the options, leaving out the concurrent-kernel policy and
+// the driver's own bookkeeping options, so every policy point of a sweep
+// finds the baselines of one isolated run
+struct kernel_result {
+  unsigned long long cycles;
+  unsigned long long insts;
+};
+
+class kernel_result_cache {
+ public:
+  kernel_result_cache() : m_options_hash(0) {}
+
+  void open(const std::string &dir, uint64_t options_hash);
+  bool enabled() const { return !m_dir.empty(); }
+  bool lookup(const std::string &trace_file, kernel_result &result) const;
+  void store(const std::string &trace_file, const kernel_result &result) const;
+
+  static uint64_t hash_options(option_parser_t opp);
+
+ private:
+  std::string entry_path(const std::string &trace_file) const;
+
+  std::string m_dir;
+  uint64_t m_options_hash;
+};
+
+// -trace_regress record:<file> writes a baseline of the run: the cycles,
+// instructions and wall seconds from launch to end of every finished
+// kernel, by trace file name, summed over the kernels of one name when
+// frames replay. check:<file> compares the run against a baseline at its
+// end and fails it, exit status 1, when the cycles or instructions of a
+// kernel are off by more than the first percent of
+// -trace_regress_tolerance, its wall time grew by more than the second and
+// 50 ms, or a kernel is only in one of the two. The baseline names the build it
+// comes from; pinning the kernelslist of -trace to a few short kernels
+// keeps a check cheap enough for every build
+class regression_baseline {
+ public:
+  regression_baseline()
+      : m_check(false), m_sim_tolerance(0), m_wall_tolerance(0) {}
+
+  // false when option or tolerance cannot be parsed
+  bool configure(const char *option, const char *tolerance,
+                 const char *version);
+  bool enabled() const { return !m_path.empty(); }
+  void kernel_launched(unsigned uid);
+  void kernel_done(unsigned uid, const std::string &trace_file,
+                   unsigned long long cycles, unsigned long long insts);
+  // writes or checks the baseline, false when it cannot or the check fails
+  bool finish() const;
+
+ private:
+  struct entry {
+    unsigned long long cycles;
+    unsigned long long insts;
+    double seconds;
+  };
+  static bool load(const std::string &path, std::string &version,
+                   std::map<std::string, entry> &kernels);
+
+  std::string m_path;
+  bool m_check;
+  double m_sim_tolerance;   // percent
+  double m_wall_tolerance;  // percent
+  std::string m_version;
+  std::unordered_map<unsigned, std::chrono::steady_clock::time_point>
+      m_launched;
+  std::map<std::string, entry> m_kernels;  // by kernel_cycle_model::key
+};
+
+// -trace_steady_state_frames: while one side of a concurrent run is
+// relaunched, the run has reached a steady state once the last window
+// iterations of that side took the same cycles to within tolerance percent
+class steady_state_detector {
+ public:
+  steady_state_detector(unsigned window, unsigned tolerance)
+      : m_window(window), m_tolerance(tolerance) {}
+
+  // an iteration took cycles, returns whether the last window ones agree
+  bool add(unsigned long long cycles);
+  // of the last window iterations
+  unsigned long long mean() const;
+
+ private:
+  unsigned m_window;
+  unsigned m_tolerance;
+  std::deque<unsigned long long> m_cycles;
+};
+
 class trace_config {
  public:
   trace_config();
@@ -121,6 +390,56 @@ class trace_config {
   void parse_config();
   void reg_options(option_parser_t opp);
   char *get_traces_filename() { return g_traces_filename; }
+  bool load_ctas_by_id() const { return trace_tb_index; }
+  unsigned get_prefetch_threads() const { return trace_prefetch_threads; }
+  unsigned get_prefetch_depth() const { return trace_prefetch_depth; }
+  unsigned get_warp_window() const { return trace_warp_window; }
+  bool frame_replay() const { return trace_frame_replay; }
+  unsigned get_replay_frames() const { return trace_replay_frames; }
+  const char *get_cycle_model_file() const { return kernel_cycle_model_file; }
+  const char *get_cycle_model_out() const { return kernel_cycle_model_out; }
+  const char *get_result_cache() const { return trace_result_cache; }
+  const char *get_regress() const { return trace_regress; }
+  const char *get_regress_tolerance() const { return trace_regress_tolerance; }
+  // of the options as set now, variants of a fork included
+  uint64_t get_options_hash() const {
+    return kernel_result_cache::hash_options(m_opp);
+  }
+  bool fast_forward_tail() const { return trace_fast_forward_tail; }
+  unsigned get_sample_intervals() const { return trace_sample_intervals; }
+  unsigned get_steady_state_frames() const { return trace_steady_state_frames; }
+  unsigned get_steady_state_tolerance() const {
+    return trace_steady_state_tolerance;
+  }
+  unsigned get_sample_interval_ctas() const {
+    return trace_sample_interval_ctas;
+  }
+  unsigned get_sample_warmup_ctas() const { return trace_sample_warmup_ctas; }
+  unsigned get_sample_min_ctas() const { return trace_sample_min_ctas; }
+  unsigned get_warmup_kernels() const { return trace_warmup_kernels; }
+  unsigned get_warmup_ctas() const { return trace_warmup_ctas; }
+  unsigned get_draw_depth() const { return trace_draw_depth; }
+  bool sample_random() const { return m_sample_random; }
+  unsigned long long get_fork_cycle() const { return trace_fork_cycle; }
+  const char *get_fork_variants() const { return trace_fork_variants; }
+  const char *get_fork_log() const { return trace_fork_log; }
+  const char *get_sweep_variants() const { return trace_sweep_variants; }
+  // -trace_tenants: the tenant of the compute kernel traced to trace_file,
+  // 1 + the group naming the workload its file name starts with, 1 when no
+  // group does
+  unsigned get_tenant(const std::string &trace_file) const;
+  // parse options given as space separated command line arguments, in a
+  // process forked at -trace_fork_cycle or for -trace_sweep_variants. Only
+  // options read while simulating take effect, the structure of the modeled
+  // GPU is already built.
+  void apply_options(const std::string &options);
+  const std::vector<std::pair<address_type, address_type> > &get_roi() const {
+    return m_roi;
+  }
+  // parse "lo-hi,lo-hi,..." hex PC ranges, false if ranges is malformed
+  static bool parse_pc_ranges(
+      const char *ranges,
+      std::vector<std::pair<address_type, address_type> > &roi);
 
  private:
   unsigned int_latency, fp_latency, dp_latency, sfu_latency, tensor_latency;
@@ -129,6 +448,39 @@ class trace_config {
   unsigned specialized_unit_initiation[SPECIALIZED_UNIT_NUM];
 
   char *g_traces_filename;
+  bool trace_tb_index;
+  unsigned trace_prefetch_threads;
+  unsigned trace_prefetch_depth;
+  unsigned trace_warp_window;
+  bool trace_frame_replay;
+  unsigned trace_replay_frames;
+  char *kernel_cycle_model_file;
+  char *kernel_cycle_model_out;
+  char *trace_result_cache;
+  char *trace_regress;
+  char *trace_regress_tolerance;
+  bool trace_fast_forward_tail;
+  unsigned trace_sample_intervals;
+  unsigned trace_steady_state_frames;
+  unsigned trace_steady_state_tolerance;
+  unsigned trace_sample_interval_ctas;
+  unsigned trace_sample_warmup_ctas;
+  unsigned trace_sample_min_ctas;
+  unsigned trace_warmup_kernels;
+  unsigned trace_warmup_ctas;
+  unsigned trace_draw_depth;
+  char *trace_sample_policy;
+  bool m_sample_random;
+  unsigned long long trace_fork_cycle;
+  char *trace_fork_variants;
+  char *trace_fork_log;
+  char *trace_sweep_variants;
+  char *trace_tenants;
+  char *trace_roi_pc;
+  std::vector<std::pair<address_type, address_type> > m_roi;
+  // the workloads of each compute tenant, tenant 1 first
+  std::vector<std::vector<std::string> > m_tenant_workloads;
+  option_parser_t m_opp;
   char *trace_opcode_latency_initiation_int;
   char *trace_opcode_latency_initiation_sp;
   char *trace_opcode_latency_initiation_dp;
@@ -142,10 +494,25 @@ class trace_shd_warp_t : public shd_warp_t {
   trace_shd_warp_t(class shader_core_ctx *shader, unsigned warp_size)
       : shd_warp_t(shader, warp_size) {
     trace_pc = 0;
+    m_next_pool_inst = 0;
     m_kernel_info = NULL;
+    trace_cursor.offset = trace_cursor.end = 0;
+    trace_cursor.remaining = 0;
+    trace_cursor.stream = 0;
+    trace_cursor.addr_offset = trace_cursor.addr_end = 0;
+    trace_cursor.addr_shift = 0;
   }
 
+  // the whole warp trace, or in streaming mode the current window of it
   std::vector<inst_trace_t> warp_traces;
+  // streaming mode: the part of the warp trace not decoded yet
+  trace_warp_cursor trace_cursor;
+  // decode the next window once warp_traces is used up, returns false when
+  // the warp has no instructions left
+  bool refill_traces();
+  // step over the instructions before the next one in the kernel's region
+  // of interest
+  void skip_outside_roi();
   const trace_warp_inst_t *get_next_trace_inst();
   void clear();
   bool trace_done();
@@ -157,8 +524,15 @@ class trace_shd_warp_t : public shd_warp_t {
   }
 
  private:
+  // instructions handed to the ibuffer are recycled round robin instead of
+  // allocated per issue, the pool is larger than the ibuffer so a slot is
+  // never reused while it is still buffered
+  static const unsigned INST_POOL_SIZE = 4;
+
   unsigned trace_pc;
   trace_kernel_info_t *m_kernel_info;
+  trace_warp_inst_t m_inst_pool[INST_POOL_SIZE];
+  unsigned m_next_pool_inst;
 };
 
 class trace_gpgpu_sim : public gpgpu_sim {
@@ -222,9 +596,11 @@ class trace_shader_core_ctx : public shader_core_ctx {
   virtual void issue_warp(register_set &warp, const warp_inst_t *pI,
                           const active_mask_t &active_mask, unsigned warp_id,
                           unsigned sch_id);
+  // also frees the traces of the warps the kernel left
+  virtual void kernel_released(const kernel_info_t *kernel);
 
  private:
-  void init_traces(unsigned start_warp, unsigned end_warp,
+  void init_traces(unsigned start_warp, unsigned end_warp, unsigned ctaid,
                    kernel_info_t &kernel);
 };
 
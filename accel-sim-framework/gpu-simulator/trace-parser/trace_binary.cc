@@ -0,0 +1,1175 @@
+// Binary, block-indexed container for accel-sim kernel traces
+// see trace_binary.h for the file layout
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <bitset>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trace_binary.h"
+#include "trace_parser.h"
+
+namespace {
+
+inline void put_u8(std::string &buf, unsigned v) { buf.push_back((char)v); }
+
+inline void put_u16(std::string &buf, unsigned v) {
+  buf.push_back((char)(v & 0xff));
+  buf.push_back((char)((v >> 8) & 0xff));
+}
+
+inline void put_u32(std::string &buf, uint32_t v) {
+  for (unsigned i = 0; i < 4; ++i) buf.push_back((char)((v >> (8 * i)) & 0xff));
+}
+
+inline void put_u64(std::string &buf, uint64_t v) {
+  for (unsigned i = 0; i < 8; ++i) buf.push_back((char)((v >> (8 * i)) & 0xff));
+}
+
+inline void put_varint(std::string &buf, uint64_t v) {
+  while (v >= 0x80) {
+    buf.push_back((char)((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  buf.push_back((char)v);
+}
+
+inline void put_svarint(std::string &buf, int64_t v) {
+  put_varint(buf, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+inline unsigned get_u8(const unsigned char *&p) { return *p++; }
+
+inline unsigned get_u16(const unsigned char *&p) {
+  unsigned v = p[0] | (p[1] << 8);
+  p += 2;
+  return v;
+}
+
+inline uint32_t get_u32(const unsigned char *&p) {
+  uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+               ((uint32_t)p[3] << 24);
+  p += 4;
+  return v;
+}
+
+inline uint64_t get_u64(const unsigned char *&p) {
+  uint64_t v = 0;
+  for (unsigned i = 0; i < 8; ++i) v |= (uint64_t)p[i] << (8 * i);
+  p += 8;
+  return v;
+}
+
+inline uint64_t get_varint(const unsigned char *&p) {
+  uint64_t v = 0;
+  unsigned shift = 0;
+  while (*p & 0x80) {
+    v |= (uint64_t)(*p++ & 0x7f) << shift;
+    shift += 7;
+  }
+  v |= (uint64_t)(*p++) << shift;
+  return v;
+}
+
+inline int64_t get_svarint(const unsigned char *&p) {
+  uint64_t v = get_varint(p);
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// whitespace tokenizer over one text trace line
+class line_tokenizer {
+ public:
+  line_tokenizer(const std::string &line) : m_line(line), m_pos(0) {}
+
+  bool next(std::string &tok) {
+    while (m_pos < m_line.size() && isspace((unsigned char)m_line[m_pos]))
+      m_pos++;
+    if (m_pos >= m_line.size()) return false;
+    size_t start = m_pos;
+    while (m_pos < m_line.size() && !isspace((unsigned char)m_line[m_pos]))
+      m_pos++;
+    tok.assign(m_line, start, m_pos - start);
+    return true;
+  }
+
+  unsigned long long next_hex() {
+    std::string tok;
+    if (!next(tok)) return 0;
+    return strtoull(tok.c_str(), NULL, 16);
+  }
+
+  long long next_dec() {
+    std::string tok;
+    if (!next(tok)) return 0;
+    return strtoll(tok.c_str(), NULL, 10);
+  }
+
+  unsigned next_reg() {
+    std::string tok;
+    unsigned reg = 0;
+    if (next(tok)) sscanf(tok.c_str(), "R%u", &reg);
+    return reg;
+  }
+
+ private:
+  const std::string &m_line;
+  size_t m_pos;
+};
+
+}  // namespace
+
+binary_trace_reader::binary_trace_reader() {
+  m_version = BINARY_TRACE_FORMAT_VERSION;
+  m_next_tb = 0;
+}
+
+bool binary_trace_reader::is_binary_trace(const std::string &filepath) {
+  std::ifstream ifs(filepath.c_str(), std::ios::binary);
+  if (!ifs.is_open()) return false;
+  char magic[BINARY_TRACE_MAGIC_SIZE];
+  ifs.read(magic, BINARY_TRACE_MAGIC_SIZE);
+  return ifs.gcount() == BINARY_TRACE_MAGIC_SIZE &&
+         memcmp(magic, BINARY_TRACE_MAGIC, BINARY_TRACE_MAGIC_SIZE) == 0;
+}
+
+bool binary_trace_reader::load_index(const std::string &filepath,
+                                     trace_opcode_table *opcodes) {
+  m_filepath = filepath;
+  std::ifstream ifs(filepath.c_str(), std::ios::binary);
+  if (!ifs.is_open()) return false;
+
+  // magic, version and header
+  unsigned char fixed[BINARY_TRACE_MAGIC_SIZE + 8];
+  ifs.read((char *)fixed, sizeof(fixed));
+  if (ifs.gcount() != sizeof(fixed) ||
+      memcmp(fixed, BINARY_TRACE_MAGIC, BINARY_TRACE_MAGIC_SIZE) != 0)
+    return false;
+  const unsigned char *p = fixed + BINARY_TRACE_MAGIC_SIZE;
+  unsigned version = get_u32(p);
+  if (version != BINARY_TRACE_FORMAT_VERSION &&
+      version != BINARY_TRACE_DEDUP_VERSION) {
+    std::cout << "Unsupported binary trace version " << version << " in "
+              << filepath << std::endl;
+    return false;
+  }
+  m_version = version;
+  unsigned header_len = get_u32(p);
+  std::string header(header_len, '\0');
+  ifs.read(&header[0], header_len);
+  m_header_lines.clear();
+  size_t start = 0;
+  while (start < header.size()) {
+    size_t end = header.find('\n', start);
+    if (end == std::string::npos) end = header.size();
+    m_header_lines.push_back(header.substr(start, end - start));
+    start = end + 1;
+  }
+
+  // footer
+  unsigned char footer[16 + BINARY_TRACE_MAGIC_SIZE];
+  ifs.seekg(-(std::streamoff)sizeof(footer), std::ios::end);
+  uint64_t footer_offset = ifs.tellg();
+  ifs.read((char *)footer, sizeof(footer));
+  if (ifs.gcount() != sizeof(footer) ||
+      memcmp(footer + 16, BINARY_TRACE_MAGIC, BINARY_TRACE_MAGIC_SIZE) != 0) {
+    std::cout << "Truncated binary trace " << filepath << std::endl;
+    return false;
+  }
+  p = footer;
+  uint64_t opcode_offset = get_u64(p);
+  uint64_t tb_index_offset = get_u64(p);
+  assert(opcode_offset <= tb_index_offset && tb_index_offset <= footer_offset);
+
+  // opcode table and thread block index
+  std::vector<unsigned char> tail(footer_offset - opcode_offset);
+  ifs.seekg(opcode_offset);
+  ifs.read((char *)tail.data(), tail.size());
+  p = tail.data();
+  unsigned opcodes_num = get_u32(p);
+  m_opcode_ids.resize(opcodes_num);
+  m_opcode_width.resize(opcodes_num);
+  for (unsigned i = 0; i < opcodes_num; ++i) {
+    unsigned len = get_u16(p);
+    std::string opcode((const char *)p, len);
+    p += len;
+    m_opcode_ids[i] = opcodes->intern(opcode, &m_opcode_width[i]);
+  }
+  assert(p == tail.data() + (tb_index_offset - opcode_offset));
+  unsigned tbs_num = get_u32(p);
+  m_tbs.resize(tbs_num);
+  for (unsigned i = 0; i < tbs_num; ++i) {
+    m_tbs[i].x = get_u32(p);
+    m_tbs[i].y = get_u32(p);
+    m_tbs[i].z = get_u32(p);
+    m_tbs[i].offset = get_u64(p);
+    m_tbs[i].size = get_u64(p);
+  }
+  m_streams.clear();
+  if (m_version == BINARY_TRACE_DEDUP_VERSION) {
+    unsigned streams_num = get_u32(p);
+    m_streams.resize(streams_num);
+    for (unsigned i = 0; i < streams_num; ++i) {
+      m_streams[i].offset = get_u64(p);
+      m_streams[i].size = get_u64(p);
+      m_streams[i].insts = get_u32(p);
+    }
+  }
+  assert(p == tail.data() + tail.size());
+  m_next_tb = 0;
+  return true;
+}
+
+bool binary_trace_reader::get_next_threadblock_traces(
+    std::vector<std::vector<inst_trace_t> *> &threadblock_traces,
+    unsigned enable_lineinfo, std::vector<uint64_t> *memaddrs,
+    trace_tb_entry *tb_out) {
+  for (unsigned i = 0; i < threadblock_traces.size(); ++i) {
+    threadblock_traces[i]->clear();
+  }
+  if (m_next_tb >= m_tbs.size()) return false;
+
+  const trace_tb_entry &tb = m_tbs[m_next_tb++];
+  decode_threadblock(tb, threadblock_traces, enable_lineinfo, memaddrs);
+  if (tb_out) *tb_out = tb;
+  return true;
+}
+
+void binary_trace_reader::get_threadblock_traces(
+    unsigned tb, std::vector<std::vector<inst_trace_t> *> &threadblock_traces,
+    unsigned enable_lineinfo, std::vector<uint64_t> *memaddrs) {
+  for (unsigned i = 0; i < threadblock_traces.size(); ++i) {
+    threadblock_traces[i]->clear();
+  }
+  assert(tb < m_tbs.size());
+  decode_threadblock(m_tbs[tb], threadblock_traces, enable_lineinfo, memaddrs);
+  m_next_tb = tb + 1;
+}
+
+void binary_trace_reader::read_bytes(uint64_t offset, uint64_t size) {
+  if (!m_ifs.is_open()) {
+    m_ifs.open(m_filepath.c_str(), std::ios::binary);
+    assert(m_ifs.is_open());
+  }
+  m_buf.resize(size);
+  m_ifs.clear();
+  m_ifs.seekg(offset);
+  m_ifs.read((char *)m_buf.data(), size);
+  assert((uint64_t)m_ifs.gcount() == size);
+}
+
+const unsigned char *binary_trace_reader::load_stream(unsigned stream) {
+  assert(stream < m_streams.size());
+  stream_entry &s = m_streams[stream];
+  if (s.bytes.empty() && s.size) {
+    if (!m_ifs.is_open()) {
+      m_ifs.open(m_filepath.c_str(), std::ios::binary);
+      assert(m_ifs.is_open());
+    }
+    s.bytes.resize(s.size);
+    m_ifs.clear();
+    m_ifs.seekg(s.offset);
+    m_ifs.read((char *)s.bytes.data(), s.size);
+    assert((uint64_t)m_ifs.gcount() == s.size);
+  }
+  return s.bytes.data();
+}
+
+void binary_trace_reader::skip_inst(const unsigned char *&p,
+                                    unsigned enable_lineinfo) {
+  p += 4;  // pc
+  std::bitset<WARP_SIZE> mask_bits(get_u32(p));
+  p += 2;  // opcode id
+  unsigned regs = get_u8(p);
+  unsigned flags = get_u8(p);
+  p += 2 * ((regs >> 4) + (regs & 0xf));
+  if (enable_lineinfo) get_varint(p);
+  if (!(flags & BT_FLAG_MEM)) return;
+
+  // every address mode is a sequence of varints
+  unsigned address_mode = (flags >> BT_ADDR_MODE_SHIFT) & BT_ADDR_MODE_MASK;
+  unsigned varints = 0;
+  if (address_mode == address_format::list_all)
+    varints = mask_bits.count();
+  else if (address_mode == address_format::base_stride)
+    varints = 2;
+  else if (address_mode == address_format::base_delta)
+    varints = mask_bits.count() ? mask_bits.count() : 1;
+  for (unsigned v = 0; v < varints; ++v) get_varint(p);
+}
+
+unsigned binary_trace_reader::decode_inst(const unsigned char *&p,
+                                          inst_trace_t &inst,
+                                          unsigned enable_lineinfo,
+                                          std::vector<uint64_t> *memaddrs) {
+  inst.m_pc = get_u32(p);
+  inst.mask = get_u32(p);
+  unsigned opcode_id = get_u16(p);
+  assert(opcode_id < m_opcode_ids.size());
+  inst.opcode_id = m_opcode_ids[opcode_id];
+  unsigned regs = get_u8(p);
+  unsigned flags = get_u8(p);
+  inst.reg_dsts_num = regs >> 4;
+  inst.reg_srcs_num = regs & 0xf;
+  assert(inst.reg_dsts_num <= MAX_DST && inst.reg_srcs_num <= MAX_SRC);
+  for (unsigned r = 0; r < inst.reg_dsts_num; ++r)
+    inst.reg_dest[r] = get_u16(p);
+  for (unsigned r = 0; r < inst.reg_srcs_num; ++r)
+    inst.reg_src[r] = get_u16(p);
+  if (enable_lineinfo) inst.line_num = get_varint(p);
+
+  if (!(flags & BT_FLAG_MEM)) return flags;
+
+  inst.memadd_info = new inst_memadd_info_t();
+  inst.memadd_info->width = m_opcode_width[opcode_id];
+  unsigned address_mode = (flags >> BT_ADDR_MODE_SHIFT) & BT_ADDR_MODE_MASK;
+  decode_addrs(p, address_mode, inst.mask, inst.memadd_info, memaddrs);
+  return flags;
+}
+
+void binary_trace_reader::decode_addrs(const unsigned char *&p,
+                                       unsigned address_mode, unsigned mask,
+                                       inst_memadd_info_t *info,
+                                       std::vector<uint64_t> *memaddrs) {
+  std::bitset<WARP_SIZE> mask_bits(mask);
+  if (address_mode == address_format::list_all) {
+    uint64_t last = 0;
+    for (int s = 0; s < WARP_SIZE; s++) {
+      if (mask_bits.test(s)) {
+        last += get_svarint(p);
+        info->addrs[s] = last;
+        // align to 32 bytes
+        if (memaddrs) memaddrs->push_back(last & ~(uint64_t)(0x1F));
+      } else
+        info->addrs[s] = 0;
+    }
+  } else if (address_mode == address_format::base_stride) {
+    unsigned long long base_address = get_varint(p);
+    int stride = get_svarint(p);
+    info->base_stride_decompress(base_address, stride, mask_bits);
+  } else if (address_mode == address_format::base_delta) {
+    unsigned long long base_address = get_varint(p);
+    std::vector<long long> deltas;
+    unsigned deltas_num = mask_bits.count() ? mask_bits.count() - 1 : 0;
+    for (unsigned d = 0; d < deltas_num; ++d)
+      deltas.push_back(get_svarint(p));
+    info->base_delta_decompress(base_address, deltas, mask_bits);
+  }
+}
+
+void binary_trace_reader::decode_dedup_inst(const unsigned char *&p,
+                                            const unsigned char *&d,
+                                            int64_t &shift, inst_trace_t &inst,
+                                            unsigned enable_lineinfo,
+                                            std::vector<uint64_t> *memaddrs) {
+  unsigned flags = decode_inst(p, inst, enable_lineinfo, NULL);
+  if (!(flags & BT_FLAG_MEM)) return;
+
+  unsigned address_mode = (flags >> BT_ADDR_MODE_SHIFT) & BT_ADDR_MODE_MASK;
+  unsigned tag = get_u8(d);
+  if (tag == BT_DELTA_EXPLICIT) {
+    address_mode = get_u8(d);
+    decode_addrs(d, address_mode, inst.mask, inst.memadd_info, NULL);
+  } else {
+    if (tag == BT_DELTA_SHIFT) shift = get_svarint(d);
+    assert(tag == BT_DELTA_SAME || tag == BT_DELTA_SHIFT);
+    std::bitset<WARP_SIZE> mask_bits(inst.mask);
+    for (int s = 0; s < WARP_SIZE; s++)
+      if (mask_bits.test(s)) inst.memadd_info->addrs[s] += shift;
+  }
+  if (memaddrs && address_mode == address_format::list_all) {
+    std::bitset<WARP_SIZE> mask_bits(inst.mask);
+    for (int s = 0; s < WARP_SIZE; s++)
+      if (mask_bits.test(s))
+        memaddrs->push_back(inst.memadd_info->addrs[s] & ~(uint64_t)(0x1F));
+  }
+}
+
+void binary_trace_reader::decode_threadblock(
+    const trace_tb_entry &tb,
+    std::vector<std::vector<inst_trace_t> *> &threadblock_traces,
+    unsigned enable_lineinfo, std::vector<uint64_t> *memaddrs) {
+  read_bytes(tb.offset, tb.size);
+
+  const unsigned char *p = m_buf.data();
+  unsigned warps_num = get_varint(p);
+  for (unsigned w = 0; w < warps_num; ++w) {
+    unsigned warp_id = get_varint(p);
+    assert(warp_id < threadblock_traces.size());
+    std::vector<inst_trace_t> &warp = *threadblock_traces[warp_id];
+    if (m_version == BINARY_TRACE_DEDUP_VERSION) {
+      unsigned stream = get_varint(p);
+      uint64_t delta_size = get_varint(p);
+      const unsigned char *sp = load_stream(stream);
+      const unsigned char *d = p;
+      int64_t shift = 0;
+      warp.resize(m_streams[stream].insts);
+      for (unsigned i = 0; i < warp.size(); ++i)
+        decode_dedup_inst(sp, d, shift, warp[i], enable_lineinfo, memaddrs);
+      assert(d == p + delta_size);
+      p += delta_size;
+      continue;
+    }
+    unsigned insts_num = get_varint(p);
+    warp.resize(insts_num);  // allocate all the space at once
+    for (unsigned i = 0; i < insts_num; ++i)
+      decode_inst(p, warp[i], enable_lineinfo, memaddrs);
+  }
+  assert(p == m_buf.data() + tb.size);
+}
+
+void binary_trace_reader::scan_threadblock(
+    const trace_tb_entry &tb, std::vector<trace_warp_cursor *> &cursors,
+    unsigned enable_lineinfo) {
+  for (unsigned i = 0; i < cursors.size(); ++i) {
+    cursors[i]->offset = cursors[i]->end = 0;
+    cursors[i]->remaining = 0;
+    cursors[i]->stream = 0;
+    cursors[i]->addr_offset = cursors[i]->addr_end = 0;
+    cursors[i]->addr_shift = 0;
+  }
+  read_bytes(tb.offset, tb.size);
+
+  const unsigned char *p = m_buf.data();
+  unsigned warps_num = get_varint(p);
+  for (unsigned w = 0; w < warps_num; ++w) {
+    unsigned warp_id = get_varint(p);
+    assert(warp_id < cursors.size());
+    trace_warp_cursor &cursor = *cursors[warp_id];
+    if (m_version == BINARY_TRACE_DEDUP_VERSION) {
+      cursor.stream = get_varint(p);
+      assert(cursor.stream < m_streams.size());
+      uint64_t delta_size = get_varint(p);
+      cursor.end = m_streams[cursor.stream].size;
+      cursor.remaining = m_streams[cursor.stream].insts;
+      cursor.addr_offset = tb.offset + (p - m_buf.data());
+      cursor.addr_end = cursor.addr_offset + delta_size;
+      p += delta_size;
+      continue;
+    }
+    unsigned insts_num = get_varint(p);
+    cursor.offset = tb.offset + (p - m_buf.data());
+    cursor.remaining = insts_num;
+    for (unsigned i = 0; i < insts_num; ++i) skip_inst(p, enable_lineinfo);
+    cursor.end = tb.offset + (p - m_buf.data());
+  }
+  assert(p == m_buf.data() + tb.size);
+  // the block was only needed to find the warps
+  std::vector<unsigned char>().swap(m_buf);
+}
+
+bool binary_trace_reader::get_next_threadblock_cursors(
+    std::vector<trace_warp_cursor *> &cursors, unsigned enable_lineinfo,
+    trace_tb_entry *tb_out) {
+  if (m_next_tb >= m_tbs.size()) return false;
+
+  const trace_tb_entry &tb = m_tbs[m_next_tb++];
+  scan_threadblock(tb, cursors, enable_lineinfo);
+  if (tb_out) *tb_out = tb;
+  return true;
+}
+
+void binary_trace_reader::get_threadblock_cursors(
+    unsigned tb, std::vector<trace_warp_cursor *> &cursors,
+    unsigned enable_lineinfo) {
+  assert(tb < m_tbs.size());
+  scan_threadblock(m_tbs[tb], cursors, enable_lineinfo);
+  m_next_tb = tb + 1;
+}
+
+void binary_trace_reader::read_warp_window(
+    trace_warp_cursor &cursor, unsigned max_insts,
+    std::vector<inst_trace_t> &warp_traces, unsigned enable_lineinfo,
+    std::vector<uint64_t> *memaddrs) {
+  warp_traces.clear();
+  unsigned insts_num = std::min(max_insts, cursor.remaining);
+  if (insts_num == 0) return;
+  warp_traces.resize(insts_num);
+  if (m_version == BINARY_TRACE_DEDUP_VERSION) {
+    // the canonical stream stays in memory, only the deltas are read
+    const unsigned char *stream = load_stream(cursor.stream);
+    const unsigned char *sp = stream + cursor.offset;
+    uint64_t delta_size = std::min<uint64_t>(
+        cursor.addr_end - cursor.addr_offset,
+        (uint64_t)insts_num * BT_MAX_INST_SIZE);
+    read_bytes(cursor.addr_offset, delta_size);
+    const unsigned char *d = m_buf.data();
+    for (unsigned i = 0; i < insts_num; ++i)
+      decode_dedup_inst(sp, d, cursor.addr_shift, warp_traces[i],
+                        enable_lineinfo, memaddrs);
+    assert(sp <= stream + cursor.end && d <= m_buf.data() + delta_size);
+    cursor.offset = sp - stream;
+    cursor.addr_offset += d - m_buf.data();
+    cursor.remaining -= insts_num;
+    return;
+  }
+  uint64_t size = std::min<uint64_t>(cursor.end - cursor.offset,
+                                     (uint64_t)insts_num * BT_MAX_INST_SIZE);
+  read_bytes(cursor.offset, size);
+
+  const unsigned char *p = m_buf.data();
+  for (unsigned i = 0; i < insts_num; ++i)
+    decode_inst(p, warp_traces[i], enable_lineinfo, memaddrs);
+  assert(p <= m_buf.data() + size);
+  cursor.offset += p - m_buf.data();
+  cursor.remaining -= insts_num;
+}
+
+void binary_trace_reader::close() {
+  if (m_ifs.is_open()) m_ifs.close();
+  std::vector<unsigned char>().swap(m_buf);
+  for (unsigned i = 0; i < m_streams.size(); ++i)
+    std::vector<unsigned char>().swap(m_streams[i].bytes);
+}
+
+binary_trace_writer::binary_trace_writer() {
+  m_dedup = false;
+  m_in_warp = false;
+  m_bvh_list = false;
+  m_header_flushed = false;
+  m_tb_warps = 0;
+  m_offset = 0;
+}
+
+bool binary_trace_writer::open(const std::string &filepath, bool dedup) {
+  m_dedup = dedup;
+  m_ofs.open(filepath.c_str(), std::ios::binary | std::ios::trunc);
+  return m_ofs.is_open();
+}
+
+void binary_trace_writer::write_header_line(const std::string &line) {
+  assert(!m_header_flushed);
+  m_header += line;
+  m_header += '\n';
+}
+
+void binary_trace_writer::flush_header() {
+  if (m_header_flushed) return;
+  std::string buf(BINARY_TRACE_MAGIC, BINARY_TRACE_MAGIC_SIZE);
+  put_u32(buf, m_dedup ? BINARY_TRACE_DEDUP_VERSION
+                       : BINARY_TRACE_FORMAT_VERSION);
+  put_u32(buf, m_header.size());
+  buf += m_header;
+  m_ofs.write(buf.data(), buf.size());
+  m_offset += buf.size();
+  m_header_flushed = true;
+}
+
+unsigned binary_trace_writer::get_opcode_id(const std::string &opcode) {
+  std::unordered_map<std::string, unsigned>::const_iterator it =
+      m_opcode_ids.find(opcode);
+  if (it != m_opcode_ids.end()) return it->second;
+  unsigned id = m_opcodes.size();
+  assert(id < 0xffff && opcode.size() < 0xffff);
+  m_opcodes.push_back(opcode);
+  m_opcode_ids[opcode] = id;
+  return id;
+}
+
+void binary_trace_writer::begin_threadblock(unsigned x, unsigned y,
+                                            unsigned z) {
+  flush_header();
+  m_cur_tb.x = x;
+  m_cur_tb.y = y;
+  m_cur_tb.z = z;
+  m_tb_buf.clear();
+  m_tb_warps = 0;
+}
+
+void binary_trace_writer::begin_warp(unsigned warp_id, unsigned insts_num) {
+  m_tb_warps++;
+  if (!m_dedup) {
+    put_varint(m_tb_buf, warp_id);
+    put_varint(m_tb_buf, insts_num);
+    return;
+  }
+  finish_warp();
+  m_warp.warp_id = warp_id;
+  m_warp.insts = 0;
+  m_warp.signature.clear();
+  m_warp.records.clear();
+  m_warp.mem_modes.clear();
+  m_warp.mem_encoded.clear();
+  m_warp.mem_masks.clear();
+  m_warp.mem_addrs.clear();
+  m_in_warp = true;
+}
+
+void binary_trace_writer::finish_warp() {
+  if (!m_in_warp) return;
+  m_in_warp = false;
+
+  unsigned stream;
+  std::unordered_map<std::string, unsigned>::const_iterator it =
+      m_stream_ids.find(m_warp.signature);
+  if (it != m_stream_ids.end()) {
+    stream = it->second;
+  } else {
+    stream = m_streams.size();
+    m_stream_ids[m_warp.signature] = stream;
+    m_streams.push_back(canonical_stream());
+    canonical_stream &c = m_streams.back();
+    c.records.swap(m_warp.records);
+    c.insts = m_warp.insts;
+    c.mem_addrs = m_warp.mem_addrs;
+    c.offset = 0;
+  }
+  const canonical_stream &c = m_streams[stream];
+  assert(c.mem_addrs.size() == m_warp.mem_addrs.size());
+
+  std::string deltas;
+  int64_t shift = 0;
+  for (unsigned i = 0; i < m_warp.mem_masks.size(); ++i) {
+    std::bitset<WARP_SIZE> mask_bits(m_warp.mem_masks[i]);
+    const uint64_t *addrs = &m_warp.mem_addrs[i * WARP_SIZE];
+    const uint64_t *canonical = &c.mem_addrs[i * WARP_SIZE];
+    // the lanes have to move together for a shift to describe them
+    bool moved = true;
+    int64_t inst_shift = 0;
+    bool first = true;
+    for (int s = 0; s < WARP_SIZE && moved; s++) {
+      if (!mask_bits.test(s)) continue;
+      int64_t lane_shift = (int64_t)(addrs[s] - canonical[s]);
+      if (first) inst_shift = lane_shift;
+      moved = lane_shift == inst_shift;
+      first = false;
+    }
+    if (!moved) {
+      put_u8(deltas, BT_DELTA_EXPLICIT);
+      put_u8(deltas, m_warp.mem_modes[i]);
+      deltas += m_warp.mem_encoded[i];
+    } else if (first || inst_shift == shift) {
+      put_u8(deltas, BT_DELTA_SAME);
+    } else {
+      put_u8(deltas, BT_DELTA_SHIFT);
+      put_svarint(deltas, inst_shift);
+      shift = inst_shift;
+    }
+  }
+  put_varint(m_tb_buf, m_warp.warp_id);
+  put_varint(m_tb_buf, stream);
+  put_varint(m_tb_buf, deltas.size());
+  m_tb_buf += deltas;
+}
+
+// the fields of a text instruction the writer needs besides its record
+struct text_inst_info {
+  std::string opcode;
+  uint32_t mask;
+  bool mem;
+  unsigned address_mode;
+  size_t addrs_start;  // out offset of the encoded addresses
+};
+
+// appends the version 1 record of one text trace instruction line to out,
+// with the opcode id field at (record start + 8) left 0. The addresses are
+// decoded into info if it is not NULL. Returns false, with nothing appended,
+// for a TRACE_RAY BVH list
+static bool encode_text_inst(const std::string &line, unsigned trace_version,
+                             unsigned enable_lineinfo, std::string &out,
+                             text_inst_info &fields,
+                             inst_memadd_info_t *info) {
+  line_tokenizer tok(line);
+
+  if (trace_version < 3) {
+    // for older trace version, the tb ids are on every line, drop them
+    for (unsigned i = 0; i < 4; ++i) tok.next_dec();
+  }
+  unsigned line_num = 0;
+  if (enable_lineinfo) line_num = tok.next_dec();
+
+  uint32_t pc = tok.next_hex();
+  uint32_t mask = tok.next_hex();
+  std::bitset<WARP_SIZE> mask_bits(mask);
+
+  unsigned regs[MAX_DST + MAX_SRC];
+  unsigned dsts_num = tok.next_dec();
+  assert(dsts_num <= MAX_DST);
+  for (unsigned i = 0; i < dsts_num; ++i) regs[i] = tok.next_reg();
+  tok.next(fields.opcode);
+  unsigned srcs_num = tok.next_dec();
+  assert(srcs_num <= MAX_SRC);
+  for (unsigned i = 0; i < srcs_num; ++i) regs[dsts_num + i] = tok.next_reg();
+
+  unsigned mem_width = tok.next_dec();
+  unsigned address_mode = mem_width > 0 ? tok.next_dec() : 0;
+  assert(address_mode <= BT_ADDR_MODE_MASK);
+  // inst records are bounded by BT_MAX_INST_SIZE, BVH lists are not
+  if (address_mode == address_format::bvh_list) return false;
+  unsigned flags = 0;
+  if (mem_width > 0) flags = BT_FLAG_MEM | (address_mode << BT_ADDR_MODE_SHIFT);
+
+  put_u32(out, pc);
+  put_u32(out, mask);
+  put_u16(out, 0);
+  put_u8(out, (dsts_num << 4) | srcs_num);
+  put_u8(out, flags);
+  for (unsigned i = 0; i < dsts_num + srcs_num; ++i) {
+    assert(regs[i] <= 0xffff);
+    put_u16(out, regs[i]);
+  }
+  if (enable_lineinfo) put_varint(out, line_num);
+
+  fields.mask = mask;
+  fields.mem = mem_width > 0;
+  fields.address_mode = address_mode;
+  fields.addrs_start = out.size();
+  if (!mem_width) return true;
+
+  if (address_mode == address_format::list_all) {
+    uint64_t last = 0;
+    for (int s = 0; s < WARP_SIZE; s++) {
+      if (mask_bits.test(s)) {
+        uint64_t addr = tok.next_hex();
+        put_svarint(out, (int64_t)(addr - last));
+        last = addr;
+        if (info) info->addrs[s] = addr;
+      }
+    }
+  } else if (address_mode == address_format::base_stride) {
+    unsigned long long base_address = tok.next_hex();
+    int stride = tok.next_dec();
+    put_varint(out, base_address);
+    put_svarint(out, stride);
+    if (info) info->base_stride_decompress(base_address, stride, mask_bits);
+  } else if (address_mode == address_format::base_delta) {
+    unsigned long long base_address = tok.next_hex();
+    put_varint(out, base_address);
+    std::vector<long long> deltas;
+    unsigned deltas_num = mask_bits.count() ? mask_bits.count() - 1 : 0;
+    for (unsigned d = 0; d < deltas_num; ++d) {
+      deltas.push_back(tok.next_dec());
+      put_svarint(out, deltas.back());
+    }
+    if (info) info->base_delta_decompress(base_address, deltas, mask_bits);
+  }
+  return true;
+}
+
+static void set_u16(std::string &buf, size_t offset, unsigned v) {
+  buf[offset] = (char)(v & 0xff);
+  buf[offset + 1] = (char)((v >> 8) & 0xff);
+}
+
+void binary_trace_writer::write_inst(const std::string &line,
+                                     unsigned trace_version,
+                                     unsigned enable_lineinfo) {
+  std::string &out = m_dedup ? m_warp.records : m_tb_buf;
+  size_t record_start = out.size();
+  text_inst_info fields;
+  inst_memadd_info_t info = inst_memadd_info_t();
+  if (!encode_text_inst(line, trace_version, enable_lineinfo, out, fields,
+                        m_dedup ? &info : NULL)) {
+    m_bvh_list = true;
+    return;
+  }
+  set_u16(out, record_start + 8, get_opcode_id(fields.opcode));
+  if (!m_dedup) return;
+
+  assert(m_in_warp);
+  // warps of one stream may pick different address modes
+  std::string record =
+      out.substr(record_start, fields.addrs_start - record_start);
+  record[11] = (char)(record[11] & BT_FLAG_MEM);
+  m_warp.signature += record;
+  m_warp.insts++;
+  if (!fields.mem) return;
+
+  m_warp.mem_modes.push_back(fields.address_mode);
+  m_warp.mem_encoded.push_back(out.substr(fields.addrs_start));
+  m_warp.mem_masks.push_back(fields.mask);
+  m_warp.mem_addrs.insert(m_warp.mem_addrs.end(), info.addrs,
+                          info.addrs + WARP_SIZE);
+}
+
+void encode_text_threadblock(const std::string &text, unsigned trace_version,
+                             unsigned enable_lineinfo, binary_trace_tb &tb) {
+  tb.x = tb.y = tb.z = 0;
+  tb.warps = 0;
+  tb.bytes.clear();
+  tb.opcodes.clear();
+  tb.opcode_fields.clear();
+  tb.bvh_list = false;
+  std::unordered_map<std::string, unsigned> ids;
+  text_inst_info fields;
+
+  // the same line classification as convert_text_trace_to_binary
+  size_t pos = 0;
+  std::string line;
+  while (pos < text.size()) {
+    size_t eol = text.find('\n', pos);
+    if (eol == std::string::npos) eol = text.size();
+    line.assign(text, pos, eol - pos);
+    pos = eol + 1;
+    if (line.empty()) continue;
+    if (line.compare(0, 12, "thread block") == 0) {
+      sscanf(line.c_str(), "thread block = %u,%u,%u", &tb.x, &tb.y, &tb.z);
+    } else if (line.compare(0, 4, "warp") == 0) {
+      unsigned warp_id = 0, insts_num = 0;
+      sscanf(line.c_str(), "warp = %u", &warp_id);
+      // the "insts = N" line always follows the warp line
+      eol = text.find('\n', pos);
+      if (eol == std::string::npos) eol = text.size();
+      line.assign(text, pos, eol - pos);
+      pos = eol + 1;
+      sscanf(line.c_str(), "insts = %u", &insts_num);
+      put_varint(tb.bytes, warp_id);
+      put_varint(tb.bytes, insts_num);
+      tb.warps++;
+    } else if (line[0] == '#') {
+      continue;
+    } else {
+      size_t record_start = tb.bytes.size();
+      if (!encode_text_inst(line, trace_version, enable_lineinfo, tb.bytes,
+                            fields, NULL)) {
+        tb.bvh_list = true;
+        return;
+      }
+      std::unordered_map<std::string, unsigned>::const_iterator it =
+          ids.find(fields.opcode);
+      unsigned id;
+      if (it != ids.end()) {
+        id = it->second;
+      } else {
+        id = tb.opcodes.size();
+        ids[fields.opcode] = id;
+        tb.opcodes.push_back(fields.opcode);
+      }
+      set_u16(tb.bytes, record_start + 8, id);
+      tb.opcode_fields.push_back(record_start + 8);
+    }
+  }
+}
+
+void binary_trace_writer::write_threadblock(binary_trace_tb &tb) {
+  assert(!m_dedup && "version 2 thread blocks depend on the ones before");
+  if (tb.bvh_list) {
+    m_bvh_list = true;
+    return;
+  }
+  begin_threadblock(tb.x, tb.y, tb.z);
+  // the kernel ids in the order of first use, as the text is converted
+  std::vector<unsigned> ids(tb.opcodes.size(), ~0u);
+  const unsigned char *data = (const unsigned char *)tb.bytes.data();
+  for (unsigned i = 0; i < tb.opcode_fields.size(); ++i) {
+    const unsigned char *p = data + tb.opcode_fields[i];
+    unsigned local = get_u16(p);
+    if (ids[local] == ~0u) ids[local] = get_opcode_id(tb.opcodes[local]);
+    set_u16(tb.bytes, tb.opcode_fields[i], ids[local]);
+  }
+  m_tb_warps = tb.warps;
+  m_tb_buf.swap(tb.bytes);
+  end_threadblock();
+}
+
+void binary_trace_writer::end_threadblock() {
+  finish_warp();
+  std::string prefix;
+  put_varint(prefix, m_tb_warps);
+  m_cur_tb.offset = m_offset;
+  m_cur_tb.size = prefix.size() + m_tb_buf.size();
+  m_ofs.write(prefix.data(), prefix.size());
+  m_ofs.write(m_tb_buf.data(), m_tb_buf.size());
+  m_offset += m_cur_tb.size;
+  m_tbs.push_back(m_cur_tb);
+  m_tb_buf.clear();
+}
+
+void binary_trace_writer::close() {
+  flush_header();
+  for (unsigned i = 0; i < m_streams.size(); ++i) {
+    canonical_stream &c = m_streams[i];
+    c.offset = m_offset;
+    m_ofs.write(c.records.data(), c.records.size());
+    m_offset += c.records.size();
+    std::vector<uint64_t>().swap(c.mem_addrs);
+  }
+  std::string buf;
+  uint64_t opcode_offset = m_offset;
+  put_u32(buf, m_opcodes.size());
+  for (unsigned i = 0; i < m_opcodes.size(); ++i) {
+    put_u16(buf, m_opcodes[i].size());
+    buf += m_opcodes[i];
+  }
+  uint64_t tb_index_offset = m_offset + buf.size();
+  put_u32(buf, m_tbs.size());
+  for (unsigned i = 0; i < m_tbs.size(); ++i) {
+    put_u32(buf, m_tbs[i].x);
+    put_u32(buf, m_tbs[i].y);
+    put_u32(buf, m_tbs[i].z);
+    put_u64(buf, m_tbs[i].offset);
+    put_u64(buf, m_tbs[i].size);
+  }
+  if (m_dedup) {
+    put_u32(buf, m_streams.size());
+    for (unsigned i = 0; i < m_streams.size(); ++i) {
+      put_u64(buf, m_streams[i].offset);
+      put_u64(buf, m_streams[i].records.size());
+      put_u32(buf, m_streams[i].insts);
+    }
+  }
+  put_u64(buf, opcode_offset);
+  put_u64(buf, tb_index_offset);
+  buf.append(BINARY_TRACE_MAGIC, BINARY_TRACE_MAGIC_SIZE);
+  m_ofs.write(buf.data(), buf.size());
+  m_offset += buf.size();
+  m_ofs.close();
+}
+
+bool load_tb_index_cache(const std::string &filepath, uint64_t trace_size,
+                         uint64_t trace_mtime,
+                         std::vector<trace_tb_entry> &tbs) {
+  std::ifstream ifs(filepath.c_str(), std::ios::binary);
+  if (!ifs.is_open()) return false;
+  std::vector<unsigned char> buf((std::istreambuf_iterator<char>(ifs)),
+                                 std::istreambuf_iterator<char>());
+  const unsigned entry_size = 3 * 4 + 2 * 8;
+  if (buf.size() < BINARY_TRACE_MAGIC_SIZE + 20 ||
+      memcmp(buf.data(), TB_INDEX_MAGIC, BINARY_TRACE_MAGIC_SIZE) != 0)
+    return false;
+  const unsigned char *p = buf.data() + BINARY_TRACE_MAGIC_SIZE;
+  if (get_u64(p) != trace_size || get_u64(p) != trace_mtime) return false;
+  unsigned tbs_num = get_u32(p);
+  if (buf.size() != BINARY_TRACE_MAGIC_SIZE + 20 + tbs_num * entry_size)
+    return false;
+  tbs.resize(tbs_num);
+  for (unsigned i = 0; i < tbs_num; ++i) {
+    tbs[i].x = get_u32(p);
+    tbs[i].y = get_u32(p);
+    tbs[i].z = get_u32(p);
+    tbs[i].offset = get_u64(p);
+    tbs[i].size = get_u64(p);
+  }
+  return true;
+}
+
+bool save_tb_index_cache(const std::string &filepath, uint64_t trace_size,
+                         uint64_t trace_mtime,
+                         const std::vector<trace_tb_entry> &tbs) {
+  std::string buf(TB_INDEX_MAGIC, BINARY_TRACE_MAGIC_SIZE);
+  put_u64(buf, trace_size);
+  put_u64(buf, trace_mtime);
+  put_u32(buf, tbs.size());
+  for (unsigned i = 0; i < tbs.size(); ++i) {
+    put_u32(buf, tbs[i].x);
+    put_u32(buf, tbs[i].y);
+    put_u32(buf, tbs[i].z);
+    put_u64(buf, tbs[i].offset);
+    put_u64(buf, tbs[i].size);
+  }
+  // write to a temporary and rename, concurrent jobs may share the trace
+  std::string tmp = filepath + ".tmp" + std::to_string(getpid());
+  std::ofstream ofs(tmp.c_str(), std::ios::binary | std::ios::trunc);
+  if (!ofs.is_open()) return false;
+  ofs.write(buf.data(), buf.size());
+  ofs.close();
+  if (!ofs || rename(tmp.c_str(), filepath.c_str()) != 0) {
+    remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+namespace {
+
+// encodes the CTAs of one kernel on a pool of threads for the version 1
+// converter. Blocks are handed over in file order and written in it, with at
+// most window of them in flight so memory stays bounded
+class threadblock_encoder_pool {
+ public:
+  threadblock_encoder_pool(unsigned threads, unsigned trace_version,
+                           unsigned enable_lineinfo)
+      : m_trace_version(trace_version),
+        m_enable_lineinfo(enable_lineinfo),
+        m_window(4 * threads),
+        m_stop(false) {
+    for (unsigned i = 0; i < threads; ++i)
+      m_threads.push_back(std::thread(&threadblock_encoder_pool::run, this));
+  }
+
+  ~threadblock_encoder_pool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_work.notify_all();
+    for (unsigned i = 0; i < m_threads.size(); ++i) m_threads[i].join();
+    for (unsigned i = 0; i < m_pending.size(); ++i) delete m_pending[i];
+  }
+
+  // hand the text of one CTA over, writing the blocks encoded meanwhile
+  void submit(std::string &text, binary_trace_writer &writer) {
+    job *j = new job;
+    j->text.swap(text);
+    j->done = false;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_pending.push_back(j);
+      m_queue.push_back(j);
+    }
+    m_work.notify_one();
+    drain(writer, m_window);
+  }
+
+  // write the blocks still in flight
+  void finish(binary_trace_writer &writer) { drain(writer, 0); }
+
+ private:
+  struct job {
+    std::string text;
+    binary_trace_tb tb;
+    bool done;
+  };
+
+  // write the encoded blocks at the front, waiting for the front one while
+  // more than left are in flight
+  void drain(binary_trace_writer &writer, size_t left) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_pending.empty()) {
+      job *j = m_pending.front();
+      if (!j->done) {
+        if (m_pending.size() <= left) break;
+        m_done.wait(lock, [j] { return j->done; });
+      }
+      m_pending.pop_front();
+      lock.unlock();
+      writer.write_threadblock(j->tb);
+      delete j;
+      lock.lock();
+    }
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+      m_work.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+      if (m_queue.empty()) return;
+      job *j = m_queue.front();
+      m_queue.pop_front();
+      lock.unlock();
+      encode_text_threadblock(j->text, m_trace_version, m_enable_lineinfo,
+                              j->tb);
+      std::string().swap(j->text);
+      lock.lock();
+      j->done = true;
+      m_done.notify_all();
+    }
+  }
+
+  unsigned m_trace_version;
+  unsigned m_enable_lineinfo;
+  size_t m_window;
+  bool m_stop;
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_work;
+  std::condition_variable m_done;
+  std::deque<job *> m_pending;  // submitted, not written, in file order
+  std::deque<job *> m_queue;    // not taken by a thread yet
+};
+
+}  // namespace
+
+trace_conversion convert_text_trace_to_binary(
+    const std::string &text_filepath, const std::string &binary_filepath,
+    bool dedup, unsigned threads) {
+  trace_istream ifs(text_filepath);
+  if (!ifs.is_open()) {
+    std::cout << "Unable to open file: " << text_filepath << std::endl;
+    return TRACE_CONVERSION_FAILED;
+  }
+  binary_trace_writer writer;
+  if (!writer.open(binary_filepath, dedup)) {
+    std::cout << "Unable to open file: " << binary_filepath << std::endl;
+    return TRACE_CONVERSION_FAILED;
+  }
+
+  unsigned trace_version = 0, enable_lineinfo = 0;
+  bool in_header = true;
+  bool in_tb = false;
+  // version 2 streams depend on the blocks before, those stay sequential
+  threadblock_encoder_pool *pool = NULL;
+  std::string tb_text;
+  std::string line;
+  while (!writer.bvh_list() && std::getline(ifs, line)) {
+    if (line.empty()) continue;
+    if (in_header) {
+      if (line[0] == '-') {
+        writer.write_header_line(line);
+        sscanf(line.c_str(), "-accelsim tracer version = %u", &trace_version);
+        sscanf(line.c_str(), "-enable lineinfo = %u", &enable_lineinfo);
+        continue;
+      } else if (line[0] == '#') {
+        in_header = false;  // the begin of the instruction stream
+        if (line.compare(0, 9, "#BEGIN_TB") != 0) continue;
+      } else
+        continue;
+    }
+
+    if (threads > 1 && !dedup) {
+      if (!pool)
+        pool = new threadblock_encoder_pool(threads, trace_version,
+                                            enable_lineinfo);
+      if (line.compare(0, 9, "#BEGIN_TB") == 0) {
+        assert(!in_tb && "thread block start before the previous one finishes");
+        in_tb = true;
+        tb_text.clear();
+      } else if (line.compare(0, 7, "#END_TB") == 0) {
+        assert(in_tb);
+        pool->submit(tb_text, writer);
+        in_tb = false;
+      } else if (in_tb) {
+        tb_text += line;
+        tb_text += '\n';
+      }
+      continue;
+    }
+
+    if (line.compare(0, 9, "#BEGIN_TB") == 0) {
+      assert(!in_tb && "thread block start before the previous one finishes");
+      in_tb = true;
+    } else if (line.compare(0, 7, "#END_TB") == 0) {
+      assert(in_tb);
+      writer.end_threadblock();
+      in_tb = false;
+    } else if (line.compare(0, 12, "thread block") == 0) {
+      unsigned x = 0, y = 0, z = 0;
+      sscanf(line.c_str(), "thread block = %u,%u,%u", &x, &y, &z);
+      writer.begin_threadblock(x, y, z);
+    } else if (line.compare(0, 4, "warp") == 0) {
+      unsigned warp_id = 0, insts_num = 0;
+      sscanf(line.c_str(), "warp = %u", &warp_id);
+      // the "insts = N" line always follows the warp line
+      std::getline(ifs, line);
+      sscanf(line.c_str(), "insts = %u", &insts_num);
+      writer.begin_warp(warp_id, insts_num);
+    } else if (line[0] == '#') {
+      continue;
+    } else {
+      assert(in_tb);
+      writer.write_inst(line, trace_version, enable_lineinfo);
+    }
+  }
+  if (pool) {
+    if (!writer.bvh_list()) pool->finish(writer);
+    delete pool;
+  }
+  if (writer.bvh_list()) return TRACE_KEEP_TEXT;
+  writer.close();
+  if (writer.failed()) {
+    std::cout << "Unable to write file: " << binary_filepath << std::endl;
+    return TRACE_CONVERSION_FAILED;
+  }
+  return TRACE_CONVERTED;
+}
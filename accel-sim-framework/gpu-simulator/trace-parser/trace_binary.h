@@ -0,0 +1,298 @@
+// Binary, block-indexed container for accel-sim kernel traces
+//
+// File layout (all integers little endian):
+//   magic[8] "ACSIMBT1", u32 format version
+//   u32 header length, header text (the "-key = value" lines of the .traceg)
+//   thread block blocks, one per CTA, back to back
+//   opcode table: u32 count, { u16 length, bytes }
+//   thread block index: u32 count, { u32 x, u32 y, u32 z, u64 offset, u64 size }
+//   footer: u64 opcode table offset, u64 tb index offset, magic[8]
+//
+// A thread block block is: varint warp count, then per warp
+//   varint warp id, varint inst count, inst records.
+// An inst record is fixed width for pc/mask/opcode/regs:
+//   u32 pc, u32 mask, u16 opcode id, u8 (dsts << 4 | srcs), u8 flags,
+//   u16 regs[dsts + srcs], [varint line_num if lineinfo enabled]
+// followed, for memory instructions (flags & BT_FLAG_MEM), by the addresses
+// in the same address_format the text trace used (flags >> 1):
+//   list_all:    zigzag varint delta to the previous active address per lane
+//   base_stride: varint base, zigzag varint stride
+//   base_delta:  varint base, zigzag varint delta per active lane but first
+//
+// Format version 2 deduplicates warps across CTAs. Warps whose inst records
+// match but for the addresses (same pc, mask, opcode, regs and line per
+// instruction) share one canonical stream, the records and addresses of the
+// first warp seen with them. The streams are stored back to back after the
+// thread blocks, and their index follows the thread block index:
+//   stream index: u32 count, { u64 offset, u64 size, u32 inst count }
+// A warp of a version 2 thread block block is
+//   varint warp id, varint stream id, varint delta size, address deltas
+// with one address delta per memory instruction of the stream:
+//   BT_DELTA_SAME:     the canonical addresses moved by the warp's shift
+//   BT_DELTA_SHIFT:    zigzag varint new shift, then as BT_DELTA_SAME
+//   BT_DELTA_EXPLICIT: u8 address mode, addresses encoded as in version 1
+// The shift starts at 0 for every warp and only moves active lanes.
+
+#ifndef TRACE_BINARY_H
+#define TRACE_BINARY_H
+
+#include <stdint.h>
+#include <bitset>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define BINARY_TRACE_MAGIC "ACSIMBT1"
+#define BINARY_TRACE_MAGIC_SIZE 8
+#define BINARY_TRACE_FORMAT_VERSION 1
+#define BINARY_TRACE_DEDUP_VERSION 2
+#define TB_INDEX_MAGIC "ACSIMTBI"
+
+#define BT_FLAG_MEM 0x1
+#define BT_ADDR_MODE_SHIFT 1
+#define BT_ADDR_MODE_MASK 0x3
+// bound on one encoded inst record: fixed fields, 30 regs, line varint and
+// 32 address varints
+#define BT_MAX_INST_SIZE 512
+
+#define BT_DELTA_SAME 0
+#define BT_DELTA_SHIFT 1
+#define BT_DELTA_EXPLICIT 2
+
+struct inst_trace_t;
+struct inst_memadd_info_t;
+class trace_opcode_table;
+
+// location of one thread block inside a kernel trace file, shared by the
+// binary container and the text trace thread block index
+struct trace_tb_entry {
+  unsigned x, y, z;
+  uint64_t offset;
+  uint64_t size;
+};
+
+// the instructions of one warp of a CTA that are not decoded yet, so a warp
+// trace can be streamed in windows instead of held in memory as a whole
+struct trace_warp_cursor {
+  uint64_t offset;     // file offset of the next instruction
+  uint64_t end;        // file offset after the warp's last instruction
+  unsigned remaining;  // instructions left
+  // version 2: offset and end are into the canonical stream, the warp's
+  // own address deltas are at [addr_offset, addr_end) of the file
+  unsigned stream;
+  uint64_t addr_offset;
+  uint64_t addr_end;
+  int64_t addr_shift;
+};
+
+class binary_trace_reader {
+ public:
+  binary_trace_reader();
+
+  // checks the magic at the beginning of the file
+  static bool is_binary_trace(const std::string &filepath);
+
+  // read the header, opcode table and thread block index. The file is closed
+  // again afterwards and only reopened on the first threadblock read, so that
+  // a large kernel window does not hold one descriptor per kernel.
+  // The file's opcodes are interned into the kernel's opcode table.
+  bool load_index(const std::string &filepath, trace_opcode_table *opcodes);
+
+  const std::vector<std::string> &get_header_lines() const {
+    return m_header_lines;
+  }
+  unsigned num_threadblocks() const { return m_tbs.size(); }
+  const trace_tb_entry &get_threadblock(unsigned tb) const {
+    return m_tbs[tb];
+  }
+  const std::vector<trace_tb_entry> &get_threadblocks() const { return m_tbs; }
+
+  // decode the next thread block in file order, returns false at the end
+  bool get_next_threadblock_traces(
+      std::vector<std::vector<inst_trace_t> *> &threadblock_traces,
+      unsigned enable_lineinfo, std::vector<uint64_t> *memaddrs,
+      trace_tb_entry *tb_out);
+
+  // decode the thread block at position tb of the index; sequential reads
+  // continue after it
+  void get_threadblock_traces(
+      unsigned tb, std::vector<std::vector<inst_trace_t> *> &threadblock_traces,
+      unsigned enable_lineinfo, std::vector<uint64_t> *memaddrs);
+
+  // streaming mode: locate the warps of a thread block without decoding
+  // them, the cursors of warps missing from the block are left empty
+  bool get_next_threadblock_cursors(std::vector<trace_warp_cursor *> &cursors,
+                                    unsigned enable_lineinfo,
+                                    trace_tb_entry *tb_out);
+  void get_threadblock_cursors(unsigned tb,
+                               std::vector<trace_warp_cursor *> &cursors,
+                               unsigned enable_lineinfo);
+
+  // decode up to max_insts instructions at the cursor and advance it
+  void read_warp_window(trace_warp_cursor &cursor, unsigned max_insts,
+                        std::vector<inst_trace_t> &warp_traces,
+                        unsigned enable_lineinfo,
+                        std::vector<uint64_t> *memaddrs);
+
+  // back to the first thread block, the index stays loaded
+  void rewind() { m_next_tb = 0; }
+  // also drops the canonical streams read so far
+  void close();
+
+ private:
+  struct stream_entry {
+    uint64_t offset;
+    uint64_t size;
+    unsigned insts;
+    std::vector<unsigned char> bytes;  // read on first use
+  };
+
+  void read_bytes(uint64_t offset, uint64_t size);
+  const unsigned char *load_stream(unsigned stream);
+  // returns the flags of the record
+  unsigned decode_inst(const unsigned char *&p, inst_trace_t &inst,
+                       unsigned enable_lineinfo,
+                       std::vector<uint64_t> *memaddrs);
+  void decode_addrs(const unsigned char *&p, unsigned address_mode,
+                    unsigned mask, inst_memadd_info_t *info,
+                    std::vector<uint64_t> *memaddrs);
+  // decode one instruction of a canonical stream at p with the warp's
+  // address delta at d
+  void decode_dedup_inst(const unsigned char *&p, const unsigned char *&d,
+                         int64_t &shift, inst_trace_t &inst,
+                         unsigned enable_lineinfo,
+                         std::vector<uint64_t> *memaddrs);
+  void skip_inst(const unsigned char *&p, unsigned enable_lineinfo);
+  void scan_threadblock(const trace_tb_entry &tb,
+                        std::vector<trace_warp_cursor *> &cursors,
+                        unsigned enable_lineinfo);
+  void decode_threadblock(
+      const trace_tb_entry &tb,
+      std::vector<std::vector<inst_trace_t> *> &threadblock_traces,
+      unsigned enable_lineinfo, std::vector<uint64_t> *memaddrs);
+
+  std::string m_filepath;
+  std::ifstream m_ifs;
+  std::vector<std::string> m_header_lines;
+  std::vector<unsigned> m_opcode_ids;  // file opcode id to kernel table id
+  std::vector<unsigned> m_opcode_width;
+  std::vector<trace_tb_entry> m_tbs;
+  std::vector<stream_entry> m_streams;
+  std::vector<unsigned char> m_buf;
+  unsigned m_version;
+  unsigned m_next_tb;
+};
+
+// one version 1 thread block block encoded away from the writer, so the
+// CTAs of a kernel can be encoded on several threads. Its opcode ids are
+// local to the block until binary_trace_writer::write_threadblock
+struct binary_trace_tb {
+  unsigned x, y, z;
+  unsigned warps;
+  std::string bytes;                  // the warps, without the warp count
+  std::vector<std::string> opcodes;   // by local id
+  std::vector<size_t> opcode_fields;  // offsets of the opcode ids in bytes
+  // encoding stopped at a TRACE_RAY BVH list
+  bool bvh_list;
+};
+
+// encode the text of one CTA, #BEGIN_TB to #END_TB, with the line
+// classification of convert_text_trace_to_binary
+void encode_text_threadblock(const std::string &text, unsigned trace_version,
+                             unsigned enable_lineinfo, binary_trace_tb &tb);
+
+class binary_trace_writer {
+ public:
+  binary_trace_writer();
+
+  // dedup writes format version 2
+  bool open(const std::string &filepath, bool dedup = false);
+
+  // header lines have to be written before the first thread block
+  void write_header_line(const std::string &line);
+  void begin_threadblock(unsigned x, unsigned y, unsigned z);
+  void begin_warp(unsigned warp_id, unsigned insts_num);
+  // encode one text trace instruction line. A TRACE_RAY BVH list has no
+  // bound that fits an inst record, the line is dropped and bvh_list() set
+  void write_inst(const std::string &line, unsigned trace_version,
+                  unsigned enable_lineinfo);
+  void end_threadblock();
+  // append a block of encode_text_threadblock, version 1 only. The file
+  // is the same as that of writing its instructions one by one
+  void write_threadblock(binary_trace_tb &tb);
+  void close();
+
+  uint64_t bytes_written() const { return m_offset; }
+  // a write or the close failed
+  bool failed() const { return m_ofs.fail(); }
+  // an instruction written had a BVH list, the file is not usable
+  bool bvh_list() const { return m_bvh_list; }
+
+ private:
+  // version 2: the warp being written, held until it is complete since its
+  // stream is only known then
+  struct pending_warp {
+    unsigned warp_id;
+    unsigned insts;
+    std::string signature;  // inst records without address modes
+    std::string records;    // inst records with the warp's addresses
+    std::vector<unsigned> mem_modes;
+    std::vector<std::string> mem_encoded;  // version 1 address encodings
+    std::vector<uint32_t> mem_masks;
+    std::vector<uint64_t> mem_addrs;  // decoded, WARP_SIZE per memory inst
+  };
+  struct canonical_stream {
+    std::string records;
+    unsigned insts;
+    std::vector<uint64_t> mem_addrs;
+    uint64_t offset;
+  };
+
+  void flush_header();
+  void finish_warp();
+  unsigned get_opcode_id(const std::string &opcode);
+
+  bool m_dedup;
+  bool m_in_warp;
+  bool m_bvh_list;
+  pending_warp m_warp;
+  std::vector<canonical_stream> m_streams;
+  std::unordered_map<std::string, unsigned> m_stream_ids;
+  std::ofstream m_ofs;
+  std::string m_header;
+  bool m_header_flushed;
+  std::string m_tb_buf;
+  unsigned m_tb_warps;
+  trace_tb_entry m_cur_tb;
+  std::vector<trace_tb_entry> m_tbs;
+  std::vector<std::string> m_opcodes;
+  std::unordered_map<std::string, unsigned> m_opcode_ids;
+  uint64_t m_offset;
+};
+
+// thread block index cache of a text trace, stamped with the size and
+// modification time of the trace so a stale cache is ignored
+bool load_tb_index_cache(const std::string &filepath, uint64_t trace_size,
+                         uint64_t trace_mtime,
+                         std::vector<trace_tb_entry> &tbs);
+bool save_tb_index_cache(const std::string &filepath, uint64_t trace_size,
+                         uint64_t trace_mtime,
+                         const std::vector<trace_tb_entry> &tbs);
+
+enum trace_conversion {
+  TRACE_CONVERSION_FAILED,  // a file cannot be opened or written
+  TRACE_CONVERTED,
+  // the kernel has TRACE_RAY BVH lists and has to stay a text trace, the
+  // binary file is incomplete
+  TRACE_KEEP_TEXT
+};
+
+// convert one text kernel trace (.trace/.traceg) to the binary container,
+// with dedup to format version 2. With threads above 1 the CTAs of a version
+// 1 conversion are encoded on that many threads; the file is the same.
+trace_conversion convert_text_trace_to_binary(
+    const std::string &text_filepath, const std::string &binary_filepath,
+    bool dedup = false, unsigned threads = 1);
+
+#endif
@@ -0,0 +1,36 @@
+// TRACE_LOADER debug stream for the trace parser and the driver loop
+//
+// Kernel headers, CTA loads and launches are logged through the gpgpu-sim
+// trace streams (-trace_enabled 1 -trace_components TRACE_LOADER) when built
+// with TRACE=1. Otherwise the macros compile away, and the parser does not
+// depend on gpgpu-sim so the trace converter can still link it standalone.
+
+#ifndef TRACE_LOADER_TRACE_H
+#define TRACE_LOADER_TRACE_H
+
+#if TRACING_ON
+
+#include "trace.h"
+
+// loading happens outside the cycle loop, so there is no cycle to print
+#define LOADER_PRINT_STR "Accel-Sim: %s - "
+#define LOADER_DTRACE() DTRACE(TRACE_LOADER)
+#define LOADER_DPRINTF(...)                                     \
+  do {                                                          \
+    if (LOADER_DTRACE()) {                                      \
+      printf(LOADER_PRINT_STR,                                  \
+             Trace::trace_streams_str[Trace::TRACE_LOADER]);    \
+      printf(__VA_ARGS__);                                      \
+    }                                                           \
+  } while (0)
+
+#else
+
+#define LOADER_DTRACE() (false)
+#define LOADER_DPRINTF(...) \
+  do {                      \
+  } while (0)
+
+#endif
+
+#endif
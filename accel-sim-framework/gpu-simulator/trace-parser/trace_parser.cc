@@ -4,6 +4,7 @@
 #include <bits/stdc++.h>
 #include <math.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <fstream>
 #include <iostream>
@@ -11,7 +12,9 @@
 #include <string>
 #include <vector>
 
+#include "trace_loader_trace.h"
 #include "trace_parser.h"
+#include "trace_prefetch.h"
 
 bool is_number(const std::string &s) {
   std::string::const_iterator it = s.begin();
@@ -41,26 +44,15 @@ inst_trace_t::inst_trace_t(const inst_trace_t &b) {
   }
 }
 
-bool inst_trace_t::check_opcode_contain(const std::vector<std::string> &opcode,
-                                        std::string param) const {
-  for (unsigned i = 0; i < opcode.size(); ++i)
-    if (opcode[i] == param) return true;
+bool trace_opcode_t::has_token(const std::string &param) const {
+  for (unsigned i = 0; i < tokens.size(); ++i)
+    if (tokens[i] == param) return true;
 
   return false;
 }
 
-std::vector<std::string> inst_trace_t::get_opcode_tokens() const {
-  std::istringstream iss(opcode);
-  std::vector<std::string> opcode_tokens;
-  std::string token;
-  while (std::getline(iss, token, '.')) {
-    if (!token.empty()) opcode_tokens.push_back(token);
-  }
-  return opcode_tokens;
-}
-
-unsigned inst_trace_t::get_datawidth_from_opcode(
-    const std::vector<std::string> &opcode) const {
+static unsigned get_datawidth_from_opcode(
+    const std::vector<std::string> &opcode) {
   for (unsigned i = 0; i < opcode.size(); ++i) {
     if (is_number(opcode[i])) {
       return (std::stoi(opcode[i], NULL) / 8);
@@ -75,6 +67,65 @@ unsigned inst_trace_t::get_datawidth_from_opcode(
   return 4;  // default is 4 bytes
 }
 
+trace_opcode_table::~trace_opcode_table() {
+  for (unsigned i = 0; i < m_opcodes.size(); ++i) delete m_opcodes[i];
+}
+
+unsigned trace_opcode_table::intern(const std::string &opcode,
+                                    unsigned *data_width) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unordered_map<std::string, unsigned>::const_iterator it =
+      m_ids.find(opcode);
+  unsigned id;
+  if (it != m_ids.end()) {
+    id = it->second;
+  } else {
+    id = m_opcodes.size();
+    assert(id < 0xffff && "too many opcodes in one kernel");
+    trace_opcode_t *entry = new trace_opcode_t;
+    entry->opcode = opcode;
+    std::istringstream iss(opcode);
+    std::string token;
+    while (std::getline(iss, token, '.')) {
+      if (!token.empty()) entry->tokens.push_back(token);
+    }
+    // read the memory width from the opcode, as nvbit can report it
+    // incorrectly
+    entry->data_width = get_datawidth_from_opcode(entry->tokens);
+    m_opcodes.push_back(entry);
+    m_ids[opcode] = id;
+  }
+  if (data_width) *data_width = m_opcodes[id]->data_width;
+  return id;
+}
+
+unsigned trace_opcode_table::intern(const char *opcode, size_t len,
+                                    unsigned *data_width) {
+  // reused per thread so parsing a line does not allocate a key
+  static thread_local std::string key;
+  key.assign(opcode, len);
+  return intern(key, data_width);
+}
+
+const trace_opcode_t &trace_opcode_table::get(unsigned id) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  assert(id < m_opcodes.size());
+  return *m_opcodes[id];
+}
+
+unsigned trace_opcode_table::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_opcodes.size();
+}
+
+// dedup the collected cache lines once per thread block instead of keeping
+// a set ordered on every insert
+static void sort_unique(std::vector<uint64_t> &memaddrs) {
+  std::sort(memaddrs.begin(), memaddrs.end());
+  memaddrs.erase(std::unique(memaddrs.begin(), memaddrs.end()),
+                 memaddrs.end());
+}
+
 kernel_trace_t::kernel_trace_t() {
   kernel_name = "Empty";
   shmem_base_addr = 0;
@@ -83,6 +134,28 @@ kernel_trace_t::kernel_trace_t() {
   trace_verion = 0;
   read_lines = 0;
   ifs = NULL;
+  window_ifs = NULL;
+  binary_trace = NULL;
+  tb_index = NULL;
+  opcodes = new trace_opcode_table;
+  vertex_kernel = false;
+}
+
+void threadblock_index_t::build_lookup() {
+  lookup.clear();
+  lookup.reserve(tbs.size());
+  for (unsigned i = 0; i < tbs.size(); ++i) {
+    tb_id id = {tbs[i].x, tbs[i].y, tbs[i].z};
+    lookup[id] = i;
+  }
+}
+
+int threadblock_index_t::find(unsigned x, unsigned y, unsigned z) const {
+  tb_id id = {x, y, z};
+  std::unordered_map<tb_id, unsigned, tb_id_hash>::const_iterator it =
+      lookup.find(id);
+  if (it == lookup.end()) return -1;
+  return it->second;
 }
 
 void inst_memadd_info_t::base_stride_decompress(
@@ -126,96 +199,178 @@ void inst_memadd_info_t::base_delta_decompress(
   }
 }
 
+namespace {
+
+// cursor over one trace line. Mapped lines are not NUL terminated, so
+// nothing here reads past end
+struct line_reader {
+  const char *p;
+  const char *end;
+
+  line_reader(const char *begin, const char *line_end)
+      : p(begin), end(line_end) {}
+
+  void skip_space() {
+    while (p < end && isspace((unsigned char)*p)) ++p;
+  }
+
+  bool token(const char *&tok, const char *&tok_end) {
+    skip_space();
+    tok = p;
+    while (p < end && !isspace((unsigned char)*p)) ++p;
+    tok_end = p;
+    return tok != tok_end;
+  }
+
+  unsigned long long hex() {
+    skip_space();
+    if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) p += 2;
+    unsigned long long v = 0;
+    for (; p < end; ++p) {
+      unsigned d;
+      if (*p >= '0' && *p <= '9')
+        d = *p - '0';
+      else if (*p >= 'a' && *p <= 'f')
+        d = *p - 'a' + 10;
+      else if (*p >= 'A' && *p <= 'F')
+        d = *p - 'A' + 10;
+      else
+        break;
+      v = (v << 4) | d;
+    }
+    return v;
+  }
+
+  long long dec() {
+    skip_space();
+    bool neg = p < end && *p == '-';
+    if (neg || (p < end && *p == '+')) ++p;
+    long long v = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) v = v * 10 + (*p - '0');
+    return neg ? -v : v;
+  }
+
+  // register operand "R<n>", 0 if the token is not a register
+  unsigned reg() {
+    const char *tok, *tok_end;
+    if (!token(tok, tok_end) || *tok != 'R') return 0;
+    line_reader num(tok + 1, tok_end);
+    return num.dec();
+  }
+
+  // moves past the next c, for "key = a,b,c" lines
+  void skip_past(char c) {
+    while (p < end && *p != c) ++p;
+    if (p < end) ++p;
+  }
+};
+
+bool token_is(const char *tok, const char *tok_end, const char *s) {
+  size_t len = strlen(s);
+  return (size_t)(tok_end - tok) == len && memcmp(tok, s, len) == 0;
+}
+
+}  // namespace
+
 bool inst_trace_t::parse_from_string(std::string trace,
                                      unsigned trace_version,
                                      unsigned enable_lineinfo,
-                                     std::set<uint64_t> &memaddrs) {
-  std::stringstream ss;
-  ss.str(trace);
+                                     trace_opcode_table *opcodes,
+                                     std::vector<uint64_t> *memaddrs) {
+  return parse_from_line(trace.data(), trace.data() + trace.size(),
+                         trace_version, enable_lineinfo, opcodes, memaddrs);
+}
 
-  std::string temp;
+bool inst_trace_t::parse_from_line(const char *begin, const char *end,
+                                   unsigned trace_version,
+                                   unsigned enable_lineinfo,
+                                   trace_opcode_table *opcodes,
+                                   std::vector<uint64_t> *memaddrs) {
+  line_reader ss(begin, end);
 
   // Start Parsing
 
   if (trace_version < 3) {
     // for older trace version, read the tb ids and ignore
-    unsigned threadblock_x = 0, threadblock_y = 0, threadblock_z = 0,
-             warpid_tb = 0;
-
-    ss >> std::dec >> threadblock_x >> threadblock_y >> threadblock_z >>
-        warpid_tb;
+    for (unsigned i = 0; i < 4; ++i) ss.dec();
   }
   if (enable_lineinfo) {
-    ss >> std::dec >> line_num;
+    line_num = ss.dec();
   }
 
-  ss >> std::hex >> m_pc;
-  ss >> std::hex >> mask;
+  m_pc = ss.hex();
+  mask = ss.hex();
 
   std::bitset<WARP_SIZE> mask_bits(mask);
 
-  ss >> std::dec >> reg_dsts_num;
+  reg_dsts_num = ss.dec();
   assert(reg_dsts_num <= MAX_DST);
   for (unsigned i = 0; i < reg_dsts_num; ++i) {
-    ss >> temp;
-    sscanf(temp.c_str(), "R%d", &reg_dest[i]);
+    reg_dest[i] = ss.reg();
   }
 
-  ss >> opcode;
+  const char *opcode, *opcode_end;
+  ss.token(opcode, opcode_end);
+  unsigned opcode_width = 0;
+  opcode_id = opcodes->intern(opcode, opcode_end - opcode, &opcode_width);
 
-  ss >> reg_srcs_num;
+  reg_srcs_num = ss.dec();
   assert(reg_srcs_num <= MAX_SRC);
   for (unsigned i = 0; i < reg_srcs_num; ++i) {
-    ss >> temp;
-    sscanf(temp.c_str(), "R%d", &reg_src[i]);
+    reg_src[i] = ss.reg();
   }
 
   // parse mem info
-  unsigned address_mode = 0;
-  unsigned mem_width = 0;
-
-  ss >> mem_width;
+  unsigned mem_width = ss.dec();
 
   if (mem_width > 0)  // then it is a memory inst
   {
     memadd_info = new inst_memadd_info_t();
 
     // read the memory width from the opcode, as nvbit can report it incorrectly
-    std::vector<std::string> opcode_tokens = get_opcode_tokens();
-    memadd_info->width = get_datawidth_from_opcode(opcode_tokens);
+    memadd_info->width = opcode_width;
 
-    ss >> std::dec >> address_mode;
+    unsigned address_mode = ss.dec();
     if (address_mode == address_format::list_all) {
       // read addresses one by one from the file
       for (int s = 0; s < WARP_SIZE; s++) {
         if (mask_bits.test(s)) {
-          ss >> std::hex >> memadd_info->addrs[s];
+          memadd_info->addrs[s] = ss.hex();
           // align to 32 bytes
-          memaddrs.insert(memadd_info->addrs[s] & ~(uint64_t)(0x1F));
+          if (memaddrs)
+            memaddrs->push_back(memadd_info->addrs[s] & ~(uint64_t)(0x1F));
         }
         else
           memadd_info->addrs[s] = 0;
       }
     } else if (address_mode == address_format::base_stride) {
       // read addresses as base address and stride
-      unsigned long long base_address = 0;
-      int stride = 0;
-      ss >> std::hex >> base_address;
-      ss >> std::dec >> stride;
+      unsigned long long base_address = ss.hex();
+      int stride = ss.dec();
       memadd_info->base_stride_decompress(base_address, stride, mask_bits);
     } else if (address_mode == address_format::base_delta) {
-      unsigned long long base_address = 0;
       std::vector<long long> deltas;
       // read addresses as base address and deltas
-      ss >> std::hex >> base_address;
+      unsigned long long base_address = ss.hex();
       for (int s = 0; s < WARP_SIZE; s++) {
-        if (mask_bits.test(s)) {
-          long long delta = 0;
-          ss >> std::dec >> delta;
-          deltas.push_back(delta);
-        }
+        if (mask_bits.test(s)) deltas.push_back(ss.dec());
       }
       memadd_info->base_delta_decompress(base_address, deltas, mask_bits);
+    } else if (address_mode == address_format::bvh_list) {
+      // addrs[] keeps the first transaction of each ray
+      for (int s = 0; s < WARP_SIZE; s++) {
+        memadd_info->bvh_offsets[s] = memadd_info->bvh_addrs.size();
+        memadd_info->addrs[s] = 0;
+        if (!mask_bits.test(s)) continue;
+        unsigned count = ss.dec();
+        for (unsigned i = 0; i < count; i++)
+          memadd_info->bvh_addrs.push_back(ss.hex());
+        if (count)
+          memadd_info->addrs[s] =
+              memadd_info->bvh_addrs[memadd_info->bvh_offsets[s]] &
+              ~(uint64_t)BVH_PRIMITIVE_FLAG;
+      }
+      memadd_info->bvh_offsets[WARP_SIZE] = memadd_info->bvh_addrs.size();
     }
   }
   // Finish Parsing
@@ -227,6 +382,11 @@ trace_parser::trace_parser(const char *kernellist_filepath) {
   kernellist_filename = kernellist_filepath;
   compute_count = 0;
   graphics_count = 0;
+  m_prefetcher = NULL;
+}
+
+trace_parser::~trace_parser() {
+  if (m_prefetcher) delete m_prefetcher;
 }
 
 std::vector<trace_command> trace_parser::parse_commandlist_file() {
@@ -255,6 +415,21 @@ std::vector<trace_command> trace_parser::parse_commandlist_file() {
       command.command_string = line;
       command.m_type = command_type::cpu_gpu_mem_copy;
       commandlist.push_back(command);
+    } else if (line.substr(0, 10) == "RenderPass") {
+      trace_command command;
+      command.command_string = line;
+      command.m_type = command_type::render_pass_barrier;
+      commandlist.push_back(command);
+    } else if (line.substr(0, 13) == "FragmentTiles") {
+      trace_command command;
+      command.command_string = line;
+      command.m_type = command_type::fragment_tiles;
+      commandlist.push_back(command);
+    } else if (line.substr(0, 10) == "Attachment") {
+      trace_command command;
+      command.command_string = line;
+      command.m_type = command_type::attachment;
+      commandlist.push_back(command);
     } else if (line.find("kernel") != std::string::npos) {
     // } else if (line.substr(0, 6) == "kernel") {
       trace_command command;
@@ -303,14 +478,61 @@ void trace_parser::parse_memcpy_info(const std::string &memcpy_command,
   }
 }
 
+void trace_parser::parse_fragment_tiles(const std::string &tiles_command,
+                                        unsigned &columns,
+                                        std::vector<unsigned> &tiles) {
+  std::vector<std::string> params;
+  split(tiles_command, params, ',');
+  assert(params.size() >= 2);
+  columns = strtoul(params[1].c_str(), NULL, 10);
+  tiles.clear();
+  for (unsigned i = 2; i < params.size(); i++)
+    tiles.push_back(strtoul(params[i].c_str(), NULL, 10));
+}
+
+void trace_parser::parse_attachment(const std::string &attachment_command,
+                                    size_t &base, size_t &size, unsigned &tile,
+                                    std::vector<unsigned char> &sectors) {
+  std::vector<std::string> params;
+  split(attachment_command, params, ',');
+  assert(params.size() >= 5);
+  base = strtoull(params[2].c_str(), NULL, 16);
+  size = strtoull(params[3].c_str(), NULL, 10);
+  tile = strtoul(params[4].c_str(), NULL, 10);
+  sectors.clear();
+  for (unsigned i = 5; i < params.size(); i++) {
+    char *x;
+    unsigned count = strtoul(params[i].c_str(), &x, 10);
+    unsigned run = *x == 'x' ? strtoul(x + 1, NULL, 10) : 0;
+    sectors.insert(sectors.end(), count, run);
+  }
+}
+
 kernel_trace_t *trace_parser::parse_kernel_info(
     const std::string &kerneltraces_filepath) {
   kernel_trace_t *kernel_info = new kernel_trace_t;
   kernel_info->enable_lineinfo = 0; // default disabled
-  // kernel_info->ifs = new std::ifstream;
-  std::ifstream *ifs = new std::ifstream;
   kernel_info->trace_file = kerneltraces_filepath;
-  ifs->open(kerneltraces_filepath.c_str());
+
+  if (binary_trace_reader::is_binary_trace(kerneltraces_filepath)) {
+    LOADER_DPRINTF("Processing kernel %s\n", kerneltraces_filepath.c_str());
+    kernel_info->binary_trace = new binary_trace_reader();
+    if (!kernel_info->binary_trace->load_index(kerneltraces_filepath,
+                                               kernel_info->opcodes)) {
+      std::cout << "Unable to read binary trace: " << kerneltraces_filepath
+                << std::endl;
+      exit(1);
+    }
+    const std::vector<std::string> &header =
+        kernel_info->binary_trace->get_header_lines();
+    for (unsigned i = 0; i < header.size(); ++i)
+      parse_kernel_header_line(header[i], kernel_info);
+    return kernel_info;
+  }
+
+  // kernel_info->ifs = new trace_istream;
+  trace_istream *ifs = new trace_istream;
+  ifs->open(kerneltraces_filepath);
 
   if (!ifs->is_open()) {
     const std::system_error& e = std::system_error(errno, std::system_category());
@@ -321,7 +543,7 @@ kernel_trace_t *trace_parser::parse_kernel_info(
     exit(1);
   }
 
-  std::cout << "Processing kernel " << kerneltraces_filepath << std::endl;
+  LOADER_DPRINTF("Processing kernel %s\n", kerneltraces_filepath.c_str());
 
   std::string line;
 
@@ -335,56 +557,7 @@ kernel_trace_t *trace_parser::parse_kernel_info(
       // the trace format, ignore this and assume fixed format for now
       break;  // the begin of the instruction stream
     } else if (line[0] == '-') {
-      std::stringstream ss;
-      std::string string1, string2;
-
-      ss.str(line);
-      ss.ignore();
-      ss >> string1 >> string2;
-
-      if (string1 == "kernel" && string2 == "name") {
-        const size_t equal_idx = line.find('=');
-        kernel_info->kernel_name = line.substr(equal_idx + 2);
-      } else if (string1 == "kernel" && string2 == "id") {
-        sscanf(line.c_str(), "-kernel id = %d", &kernel_info->kernel_id);
-      } else if (string1 == "grid" && string2 == "dim") {
-        sscanf(line.c_str(), "-grid dim = (%d,%d,%d)", &kernel_info->grid_dim_x,
-               &kernel_info->grid_dim_y, &kernel_info->grid_dim_z);
-      } else if (string1 == "block" && string2 == "dim") {
-        sscanf(line.c_str(), "-block dim = (%d,%d,%d)", &kernel_info->tb_dim_x,
-               &kernel_info->tb_dim_y, &kernel_info->tb_dim_z);
-      } else if (string1 == "shmem" && string2 == "=") {
-        sscanf(line.c_str(), "-shmem = %d", &kernel_info->shmem);
-      } else if (string1 == "nregs") {
-        sscanf(line.c_str(), "-nregs = %d", &kernel_info->nregs);
-      } else if (string1 == "cuda" && string2 == "stream") {
-        sscanf(line.c_str(), "-cuda stream id = %lu",
-               &kernel_info->cuda_stream_id);
-      } else if (string1 == "binary" && string2 == "version") {
-        sscanf(line.c_str(), "-binary version = %d",
-               &kernel_info->binary_verion);
-      } else if (string1 == "enable" && string2 == "lineinfo") {
-        sscanf(line.c_str(), "-enable lineinfo = %d",
-               &kernel_info->enable_lineinfo);
-      } else if (string1 == "nvbit" && string2 == "version") {
-        const size_t equal_idx = line.find('=');
-        kernel_info->nvbit_verion = line.substr(equal_idx + 1);
-
-      } else if (string1 == "accelsim" && string2 == "tracer") {
-        sscanf(line.c_str(), "-accelsim tracer version = %d",
-               &kernel_info->trace_verion);
-
-      } else if (string1 == "shmem" && string2 == "base_addr") {
-        const size_t equal_idx = line.find('=');
-        ss.str(line.substr(equal_idx + 1));
-        ss >> std::hex >> kernel_info->shmem_base_addr;
-
-      } else if (string1 == "local" && string2 == "mem") {
-        const size_t equal_idx = line.find('=');
-        ss.str(line.substr(equal_idx + 1));
-        ss >> std::hex >> kernel_info->local_base_addr;
-      }
-      std::cout << line << std::endl;
+      parse_kernel_header_line(line, kernel_info);
       continue;
     }
   }
@@ -395,18 +568,217 @@ kernel_trace_t *trace_parser::parse_kernel_info(
   return kernel_info;
 }
 
+void trace_parser::parse_kernel_header_line(const std::string &line,
+                                            kernel_trace_t *kernel_info) {
+  std::stringstream ss;
+  std::string string1, string2;
+
+  ss.str(line);
+  ss.ignore();
+  ss >> string1 >> string2;
+
+  if (string1 == "kernel" && string2 == "name") {
+    const size_t equal_idx = line.find('=');
+    kernel_info->kernel_name = line.substr(equal_idx + 2);
+    kernel_info->vertex_kernel =
+        kernel_info->kernel_name.find("VERTEX") != std::string::npos;
+  } else if (string1 == "kernel" && string2 == "id") {
+    sscanf(line.c_str(), "-kernel id = %d", &kernel_info->kernel_id);
+  } else if (string1 == "grid" && string2 == "dim") {
+    sscanf(line.c_str(), "-grid dim = (%d,%d,%d)", &kernel_info->grid_dim_x,
+           &kernel_info->grid_dim_y, &kernel_info->grid_dim_z);
+  } else if (string1 == "block" && string2 == "dim") {
+    sscanf(line.c_str(), "-block dim = (%d,%d,%d)", &kernel_info->tb_dim_x,
+           &kernel_info->tb_dim_y, &kernel_info->tb_dim_z);
+  } else if (string1 == "shmem" && string2 == "=") {
+    sscanf(line.c_str(), "-shmem = %d", &kernel_info->shmem);
+  } else if (string1 == "nregs") {
+    sscanf(line.c_str(), "-nregs = %d", &kernel_info->nregs);
+  } else if (string1 == "cuda" && string2 == "stream") {
+    sscanf(line.c_str(), "-cuda stream id = %lu",
+           &kernel_info->cuda_stream_id);
+  } else if (string1 == "binary" && string2 == "version") {
+    sscanf(line.c_str(), "-binary version = %d",
+           &kernel_info->binary_verion);
+  } else if (string1 == "enable" && string2 == "lineinfo") {
+    sscanf(line.c_str(), "-enable lineinfo = %d",
+           &kernel_info->enable_lineinfo);
+  } else if (string1 == "nvbit" && string2 == "version") {
+    const size_t equal_idx = line.find('=');
+    kernel_info->nvbit_verion = line.substr(equal_idx + 1);
+
+  } else if (string1 == "accelsim" && string2 == "tracer") {
+    sscanf(line.c_str(), "-accelsim tracer version = %d",
+           &kernel_info->trace_verion);
+
+  } else if (string1 == "shmem" && string2 == "base_addr") {
+    const size_t equal_idx = line.find('=');
+    ss.str(line.substr(equal_idx + 1));
+    ss >> std::hex >> kernel_info->shmem_base_addr;
+
+  } else if (string1 == "roi" && string2 == "pc") {
+    const size_t equal_idx = line.find('=');
+    kernel_info->roi_pc = line.substr(equal_idx + 1);
+  } else if (string1 == "local" && string2 == "mem") {
+    const size_t equal_idx = line.find('=');
+    ss.str(line.substr(equal_idx + 1));
+    ss >> std::hex >> kernel_info->local_base_addr;
+  }
+  LOADER_DPRINTF("%s\n", line.c_str());
+}
+
+void trace_parser::open_kernel_trace(kernel_trace_t *trace_info) {
+  if (trace_info->ifs) return;
+  trace_info->ifs = new trace_istream;
+  trace_info->ifs->open(trace_info->trace_file);
+  assert(trace_info->ifs->is_open());
+  for (unsigned i = 0; i < trace_info->read_lines; ++i) {
+    std::string line;
+    std::getline(*(trace_info->ifs), line);
+  }
+}
+
+void trace_parser::build_text_threadblock_index(kernel_trace_t *trace_info,
+                                                threadblock_index_t *index) {
+  struct stat st;
+  uint64_t trace_size = 0, trace_mtime = 0;
+  if (stat(trace_info->trace_file.c_str(), &st) == 0) {
+    trace_size = st.st_size;
+    trace_mtime = st.st_mtime;
+  }
+  std::string cache_file = trace_info->trace_file + ".tbidx";
+  if (load_tb_index_cache(cache_file, trace_size, trace_mtime, index->tbs))
+    return;
+
+  trace_istream ifs(trace_info->trace_file);
+  assert(ifs.is_open());
+  std::string line;
+  uint64_t line_offset = 0;
+  trace_tb_entry tb;
+  tb.x = tb.y = tb.z = 0;
+  tb.offset = tb.size = 0;
+  while (std::getline(ifs, line)) {
+    uint64_t next_offset = line_offset + line.size() + 1;
+    if (line.compare(0, 9, "#BEGIN_TB") == 0) {
+      tb.offset = line_offset;
+    } else if (line.compare(0, 12, "thread block") == 0) {
+      sscanf(line.c_str(), "thread block = %u,%u,%u", &tb.x, &tb.y, &tb.z);
+    } else if (line.compare(0, 7, "#END_TB") == 0) {
+      tb.size = next_offset - tb.offset;
+      index->tbs.push_back(tb);
+    }
+    line_offset = next_offset;
+  }
+  save_tb_index_cache(cache_file, trace_size, trace_mtime, index->tbs);
+}
+
+const threadblock_index_t *trace_parser::load_threadblock_index(
+    kernel_trace_t *trace_info) {
+  if (trace_info->tb_index) return trace_info->tb_index;
+  threadblock_index_t *index = new threadblock_index_t;
+  if (trace_info->binary_trace)
+    index->tbs = trace_info->binary_trace->get_threadblocks();
+  else
+    build_text_threadblock_index(trace_info, index);
+  index->build_lookup();
+  trace_info->tb_index = index;
+  return index;
+}
+
+bool trace_parser::get_threadblock_traces(
+    std::vector<std::vector<inst_trace_t> *> threadblock_traces,
+    kernel_trace_t *trace_info, unsigned x, unsigned y, unsigned z,
+    std::vector<uint64_t> &memaddrs) {
+  memaddrs.clear();
+  const threadblock_index_t *index = load_threadblock_index(trace_info);
+  int tb = index->find(x, y, z);
+  if (tb < 0) {
+    for (unsigned i = 0; i < threadblock_traces.size(); ++i)
+      threadblock_traces[i]->clear();
+    return false;
+  }
+
+  std::vector<uint64_t> *addrs = trace_info->vertex_kernel ? &memaddrs : NULL;
+  if (trace_info->binary_trace) {
+    trace_info->binary_trace->get_threadblock_traces(
+        tb, threadblock_traces, trace_info->enable_lineinfo, addrs);
+  } else {
+    open_kernel_trace(trace_info);
+    trace_info->ifs->clear();
+    trace_info->ifs->seekg(index->tbs[tb].offset);
+    get_next_threadblock_traces(threadblock_traces, trace_info->trace_verion,
+                                trace_info->enable_lineinfo, trace_info->ifs,
+                                trace_info->opcodes, addrs, NULL);
+  }
+  sort_unique(memaddrs);
+  return true;
+}
+
+void trace_parser::rewind_kernel_trace(kernel_trace_t *trace_info) {
+  assert(trace_info);
+  if (m_prefetcher) m_prefetcher->remove_kernel(trace_info);
+  if (trace_info->window_ifs) {
+    delete trace_info->window_ifs;
+    trace_info->window_ifs = NULL;
+  }
+  if (trace_info->binary_trace) {
+    trace_info->binary_trace->rewind();
+    return;
+  }
+  // reopened past the header by open_kernel_trace on the next request
+  if (trace_info->ifs) {
+    delete trace_info->ifs;
+    trace_info->ifs = NULL;
+  }
+}
+
+static void reopen_trace_stream(trace_istream *ifs,
+                                const std::string &filepath) {
+  // mapped traces are not read through the file offset
+  if (!ifs || !ifs->is_open() || ifs->is_mapped()) return;
+  std::streampos pos = ifs->tellg();
+  ifs->open(filepath);
+  assert(ifs->is_open());
+  if (pos != std::streampos(-1))
+    ifs->seekg(pos);
+  else
+    ifs->setstate(std::ios::eofbit | std::ios::failbit);
+}
+
+void trace_parser::reopen_kernel_trace(kernel_trace_t *trace_info) {
+  assert(trace_info);
+  if (trace_info->binary_trace) {
+    // the reader reopens the file on its next read
+    trace_info->binary_trace->close();
+    return;
+  }
+  reopen_trace_stream(trace_info->ifs, trace_info->trace_file);
+  reopen_trace_stream(trace_info->window_ifs, trace_info->trace_file);
+}
+
 void trace_parser::kernel_finalizer(kernel_trace_t *trace_info) {
   assert(trace_info);
+  if (m_prefetcher) m_prefetcher->remove_kernel(trace_info);
+  if (trace_info->tb_index) delete trace_info->tb_index;
+  if (trace_info->window_ifs) delete trace_info->window_ifs;
+  delete trace_info->opcodes;
+  if (trace_info->binary_trace) {
+    trace_info->binary_trace->close();
+    delete trace_info->binary_trace;
+    delete trace_info;
+    return;
+  }
   assert(trace_info->ifs);
   if (trace_info->ifs->is_open()) trace_info->ifs->close();
   delete trace_info->ifs;
   delete trace_info;
 }
 
-void trace_parser::get_next_threadblock_traces(
+bool trace_parser::get_next_threadblock_traces(
     std::vector<std::vector<inst_trace_t> *> threadblock_traces,
-    unsigned trace_version, unsigned enable_lineinfo, std::ifstream *ifs,
-    std::string kernel_name, std::set<uint64_t> &memaddrs) {
+    unsigned trace_version, unsigned enable_lineinfo, trace_istream *ifs,
+    trace_opcode_table *opcodes, std::vector<uint64_t> *memaddrs,
+    trace_tb_entry *tb) {
   for (unsigned i = 0; i < threadblock_traces.size(); ++i) {
     threadblock_traces[i]->clear();
   }
@@ -418,40 +790,42 @@ void trace_parser::get_next_threadblock_traces(
   unsigned insts_num = 0;
   unsigned inst_count = 0;
 
-  while (!ifs->eof()) {
-    std::string line;
-    std::stringstream ss;
-    std::string string1, string2;
-
-    getline(*ifs, line);
+  const char *begin, *end;
+  while (ifs->next_line(begin, end)) {
+    line_reader line(begin, end);
+    const char *tok, *tok_end;
 
-    if (line.length() == 0) {
+    if (!line.token(tok, tok_end)) {
       continue;
     } else {
-      ss.str(line);
-      ss >> string1 >> string2;
-      if (string1 == "#BEGIN_TB") {
+      if (token_is(tok, tok_end, "#BEGIN_TB")) {
         if (!start_of_tb_stream_found) {
           start_of_tb_stream_found = true;
         } else
           assert(0 &&
                  "Parsing error: thread block start before the previous one "
                  "finishes");
-      } else if (string1 == "#END_TB") {
+      } else if (token_is(tok, tok_end, "#END_TB")) {
         assert(start_of_tb_stream_found);
         break;  // end of TB stream
-      } else if (string1 == "thread" && string2 == "block") {
+      } else if (token_is(tok, tok_end, "thread")) {
+        // thread block = x,y,z
         assert(start_of_tb_stream_found);
-        sscanf(line.c_str(), "thread block = %d,%d,%d", &block_id_x,
-               &block_id_y, &block_id_z);
-        std::cout << kernel_name << " " << line << std::endl;
-      } else if (string1 == "warp") {
+        line.skip_past('=');
+        block_id_x = line.dec();
+        line.skip_past(',');
+        block_id_y = line.dec();
+        line.skip_past(',');
+        block_id_z = line.dec();
+      } else if (token_is(tok, tok_end, "warp")) {
         // the start of new warp stream
         assert(start_of_tb_stream_found);
-        sscanf(line.c_str(), "warp = %d", &warp_id);
-      } else if (string1 == "insts") {
+        line.skip_past('=');
+        warp_id = line.dec();
+      } else if (token_is(tok, tok_end, "insts")) {
         assert(start_of_tb_stream_found);
-        sscanf(line.c_str(), "insts = %d", &insts_num);
+        line.skip_past('=');
+        insts_num = line.dec();
         threadblock_traces[warp_id]->resize(
             insts_num);  // allocate all the space at once
         inst_count = 0;
@@ -459,9 +833,186 @@ void trace_parser::get_next_threadblock_traces(
         assert(start_of_tb_stream_found);
         threadblock_traces[warp_id]
             ->at(inst_count)
-            .parse_from_string(line, trace_version, enable_lineinfo, memaddrs);
+            .parse_from_line(begin, end, trace_version, enable_lineinfo,
+                             opcodes, memaddrs);
         inst_count++;
       }
     }
   }
+
+  if (tb) {
+    tb->x = block_id_x;
+    tb->y = block_id_y;
+    tb->z = block_id_z;
+  }
+  return start_of_tb_stream_found;
+}
+
+bool trace_parser::get_next_threadblock_traces(
+    std::vector<std::vector<inst_trace_t> *> threadblock_traces,
+    kernel_trace_t *trace_info, std::vector<uint64_t> &memaddrs,
+    trace_tb_entry *tb) {
+  if (m_prefetcher)
+    return m_prefetcher->get_next_threadblock_traces(
+        trace_info, threadblock_traces, memaddrs, tb);
+  return read_next_threadblock_traces(threadblock_traces, trace_info,
+                                      memaddrs, tb);
+}
+
+bool trace_parser::read_next_threadblock_traces(
+    std::vector<std::vector<inst_trace_t> *> threadblock_traces,
+    kernel_trace_t *trace_info, std::vector<uint64_t> &memaddrs,
+    trace_tb_entry *tb) {
+  memaddrs.clear();
+  std::vector<uint64_t> *addrs = trace_info->vertex_kernel ? &memaddrs : NULL;
+  bool found;
+  if (trace_info->binary_trace) {
+    found = trace_info->binary_trace->get_next_threadblock_traces(
+        threadblock_traces, trace_info->enable_lineinfo, addrs, tb);
+  } else {
+    open_kernel_trace(trace_info);
+    found = get_next_threadblock_traces(
+        threadblock_traces, trace_info->trace_verion,
+        trace_info->enable_lineinfo, trace_info->ifs, trace_info->opcodes,
+        addrs, tb);
+  }
+  sort_unique(memaddrs);
+  return found;
+}
+
+bool trace_parser::scan_text_threadblock(
+    trace_istream *ifs, std::vector<trace_warp_cursor *> &cursors,
+    trace_tb_entry *tb) {
+  for (unsigned i = 0; i < cursors.size(); ++i) {
+    cursors[i]->offset = cursors[i]->end = 0;
+    cursors[i]->remaining = 0;
+  }
+  std::streamoff pos = ifs->tellg();
+  if (pos < 0) return false;
+
+  uint64_t offset = pos;
+  unsigned block_id_x = 0, block_id_y = 0, block_id_z = 0;
+  bool start_of_tb_stream_found = false;
+  unsigned warp_id = 0;
+  const char *begin, *end;
+  while (ifs->next_line(begin, end)) {
+    offset += end - begin + 1;
+    line_reader line(begin, end);
+    const char *tok, *tok_end;
+    if (!line.token(tok, tok_end)) continue;
+    if (token_is(tok, tok_end, "#BEGIN_TB")) {
+      assert(!start_of_tb_stream_found &&
+             "Parsing error: thread block start before the previous one "
+             "finishes");
+      start_of_tb_stream_found = true;
+    } else if (token_is(tok, tok_end, "#END_TB")) {
+      assert(start_of_tb_stream_found);
+      break;  // end of TB stream
+    } else if (token_is(tok, tok_end, "thread")) {
+      line.skip_past('=');
+      block_id_x = line.dec();
+      line.skip_past(',');
+      block_id_y = line.dec();
+      line.skip_past(',');
+      block_id_z = line.dec();
+    } else if (token_is(tok, tok_end, "warp")) {
+      line.skip_past('=');
+      warp_id = line.dec();
+    } else if (token_is(tok, tok_end, "insts")) {
+      line.skip_past('=');
+      unsigned insts_num = line.dec();
+      assert(warp_id < cursors.size());
+      trace_warp_cursor &cursor = *cursors[warp_id];
+      cursor.offset = offset;
+      cursor.remaining = insts_num;
+      // skip the instructions, they are parsed window by window
+      for (unsigned i = 0; i < insts_num && ifs->next_line(begin, end);) {
+        offset += end - begin + 1;
+        if (begin != end) i++;
+      }
+      cursor.end = offset;
+    }
+  }
+
+  if (tb) {
+    tb->x = block_id_x;
+    tb->y = block_id_y;
+    tb->z = block_id_z;
+  }
+  return start_of_tb_stream_found;
+}
+
+bool trace_parser::get_next_threadblock_cursors(
+    std::vector<trace_warp_cursor *> cursors, kernel_trace_t *trace_info,
+    trace_tb_entry *tb) {
+  if (trace_info->binary_trace)
+    return trace_info->binary_trace->get_next_threadblock_cursors(
+        cursors, trace_info->enable_lineinfo, tb);
+
+  open_kernel_trace(trace_info);
+  return scan_text_threadblock(trace_info->ifs, cursors, tb);
+}
+
+bool trace_parser::get_threadblock_cursors(
+    std::vector<trace_warp_cursor *> cursors, kernel_trace_t *trace_info,
+    unsigned x, unsigned y, unsigned z) {
+  const threadblock_index_t *index = load_threadblock_index(trace_info);
+  int tb = index->find(x, y, z);
+  if (tb < 0) return false;
+
+  if (trace_info->binary_trace) {
+    trace_info->binary_trace->get_threadblock_cursors(
+        tb, cursors, trace_info->enable_lineinfo);
+    return true;
+  }
+  open_kernel_trace(trace_info);
+  trace_info->ifs->clear();
+  trace_info->ifs->seekg(index->tbs[tb].offset);
+  return scan_text_threadblock(trace_info->ifs, cursors, NULL);
+}
+
+void trace_parser::read_warp_window(kernel_trace_t *trace_info,
+                                    trace_warp_cursor &cursor,
+                                    unsigned max_insts,
+                                    std::vector<inst_trace_t> &warp_traces,
+                                    std::vector<uint64_t> &memaddrs) {
+  memaddrs.clear();
+  std::vector<uint64_t> *addrs = trace_info->vertex_kernel ? &memaddrs : NULL;
+  if (trace_info->binary_trace) {
+    trace_info->binary_trace->read_warp_window(
+        cursor, max_insts, warp_traces, trace_info->enable_lineinfo, addrs);
+    sort_unique(memaddrs);
+    return;
+  }
+
+  warp_traces.clear();
+  unsigned insts_num = std::min(max_insts, cursor.remaining);
+  if (insts_num == 0) return;
+  if (!trace_info->window_ifs) {
+    trace_info->window_ifs = new trace_istream(trace_info->trace_file);
+    assert(trace_info->window_ifs->is_open());
+  }
+  trace_istream *ifs = trace_info->window_ifs;
+  ifs->clear();
+  ifs->seekg(cursor.offset);
+
+  warp_traces.resize(insts_num);
+  unsigned inst_count = 0;
+  const char *begin, *end;
+  while (inst_count < insts_num && ifs->next_line(begin, end)) {
+    cursor.offset += end - begin + 1;
+    if (begin == end) continue;
+    warp_traces[inst_count++].parse_from_line(
+        begin, end, trace_info->trace_verion, trace_info->enable_lineinfo,
+        trace_info->opcodes, addrs);
+  }
+  assert(inst_count == insts_num);
+  cursor.remaining -= insts_num;
+  sort_unique(memaddrs);
+}
+
+void trace_parser::enable_prefetch(unsigned threads, unsigned depth) {
+  assert(!m_prefetcher);
+  if (threads > 0)
+    m_prefetcher = new threadblock_prefetcher(this, threads, depth);
 }
@@ -3,12 +3,16 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #ifndef TRACE_PARSER_H
 #define TRACE_PARSER_H
 
+#include "trace_binary.h"
+#include "trace_stream.h"
+
 #define WARP_SIZE 32
 #define MAX_DST 1
 #define MAX_SRC 4
@@ -18,6 +22,15 @@ enum command_type {
   cpu_gpu_mem_copy,
   gpu_cpu_mem_copy,
   tex_mem_cpy,
+  // RenderPass,<n>: the graphics kernels after it wait on those before it
+  render_pass_barrier,
+  // FragmentTiles,<columns>,<tile>...: screen tiles of the CTAs of the next
+  // fragment kernel
+  fragment_tiles,
+  // Attachment,<color|depth>,<base>,<bytes>,<tile bytes>,<count>x<sectors>...:
+  // a render target the fragment kernel before it wrote, with the
+  // compressed size of its tiles in runs of equal ones
+  attachment,
 };
 
 enum address_space { GLOBAL_MEM = 1, SHARED_MEM, LOCAL_MEM, TEX_MEM };
@@ -28,7 +41,17 @@ enum address_scope {
   SYS_MEM,
 };
 
-enum address_format { list_all = 0, base_stride = 1, base_delta = 2 };
+// bvh_list (TRACE_RAY): per active thread, the number of BVH transactions of
+// its ray followed by their addresses in traversal order. Bit 0 of an address
+// is set on primitive (leaf/triangle) fetches, node fetches have it clear
+enum address_format {
+  list_all = 0,
+  base_stride = 1,
+  base_delta = 2,
+  bvh_list = 3
+};
+
+#define BVH_PRIMITIVE_FLAG 0x1
 
 struct trace_command {
   std::string command_string;
@@ -38,6 +61,10 @@ struct trace_command {
 struct inst_memadd_info_t {
   uint64_t addrs[WARP_SIZE];
   int32_t width;
+  // bvh_list only: the transactions of thread t are
+  // bvh_addrs[bvh_offsets[t] .. bvh_offsets[t + 1])
+  std::vector<uint64_t> bvh_addrs;
+  unsigned bvh_offsets[WARP_SIZE + 1];
 
   void base_stride_decompress(unsigned long long base_address, int stride,
                               const std::bitset<WARP_SIZE> &mask);
@@ -46,6 +73,34 @@ struct inst_memadd_info_t {
                              const std::bitset<WARP_SIZE> &mask);
 };
 
+// opcode string of the kernel's static instructions with everything derived
+// from it, so instructions only carry an id
+struct trace_opcode_t {
+  std::string opcode;
+  std::vector<std::string> tokens;  // opcode split on '.'
+  unsigned data_width;  // memory access width in bytes implied by the opcode
+
+  bool has_token(const std::string &param) const;
+};
+
+// per kernel opcode table. Ids are dense and stable; interning is locked as
+// prefetch threads parse CTAs while the simulator decodes instructions
+class trace_opcode_table {
+ public:
+  ~trace_opcode_table();
+
+  // id of opcode, added on first use. data_width receives its memory width
+  unsigned intern(const std::string &opcode, unsigned *data_width = NULL);
+  unsigned intern(const char *opcode, size_t len, unsigned *data_width = NULL);
+  const trace_opcode_t &get(unsigned id) const;
+  unsigned size() const;
+
+ private:
+  mutable std::mutex m_mutex;
+  std::vector<trace_opcode_t *> m_opcodes;
+  std::unordered_map<std::string, unsigned> m_ids;
+};
+
 struct inst_trace_t {
   inst_trace_t();
   inst_trace_t(const inst_trace_t &b);
@@ -53,25 +108,49 @@ struct inst_trace_t {
   unsigned line_num;
   unsigned m_pc;
   unsigned mask;
-  unsigned reg_dsts_num;
-  unsigned reg_dest[MAX_DST];
-  std::string opcode;
-  unsigned reg_srcs_num;
-  unsigned reg_src[MAX_SRC];
+  unsigned short opcode_id;  // into the kernel's trace_opcode_table
+  unsigned char reg_dsts_num;
+  unsigned char reg_srcs_num;
+  unsigned short reg_dest[MAX_DST];
+  unsigned short reg_src[MAX_SRC];
   inst_memadd_info_t *memadd_info;
 
   bool parse_from_string(std::string trace, unsigned tracer_version,
-                         unsigned enable_lineinfo, std::set<uint64_t> &memaddrs);
+                         unsigned enable_lineinfo, trace_opcode_table *opcodes,
+                         std::vector<uint64_t> *memaddrs);
+  // parses [begin, end) in place, the line needs no terminator
+  bool parse_from_line(const char *begin, const char *end,
+                       unsigned tracer_version, unsigned enable_lineinfo,
+                       trace_opcode_table *opcodes,
+                       std::vector<uint64_t> *memaddrs);
 
-  bool check_opcode_contain(const std::vector<std::string> &opcode,
-                            std::string param) const;
+  ~inst_trace_t();
+};
 
-  unsigned get_datawidth_from_opcode(
-      const std::vector<std::string> &opcode) const;
+// per kernel thread block offset index, lets a CTA be loaded without
+// scanning the trace from the start. Text traces cache it next to the trace
+// in <trace>.tbidx
+struct threadblock_index_t {
+  // all 32 bits of each of x, y and z, gridDim.x alone reaches 2^31 - 1
+  struct tb_id {
+    unsigned x, y, z;
+    bool operator==(const tb_id &b) const {
+      return x == b.x && y == b.y && z == b.z;
+    }
+  };
+  struct tb_id_hash {
+    size_t operator()(const tb_id &id) const {
+      return std::hash<uint64_t>()(((uint64_t)id.y << 32 | id.x) ^
+                                   (uint64_t)id.z * 0x9e3779b97f4a7c15ULL);
+    }
+  };
 
-  std::vector<std::string> get_opcode_tokens() const;
+  std::vector<trace_tb_entry> tbs;
+  std::unordered_map<tb_id, unsigned, tb_id_hash> lookup;
 
-  ~inst_trace_t();
+  void build_lookup();
+  // position of thread block (x,y,z) in tbs, or -1 if not in the trace
+  int find(unsigned x, unsigned y, unsigned z) const;
 };
 
 struct kernel_trace_t {
@@ -95,7 +174,20 @@ struct kernel_trace_t {
   unsigned long long shmem_base_addr;
   unsigned long long local_base_addr;
   // Reference to open filestream
-  std::ifstream *ifs;
+  trace_istream *ifs;
+  // second stream for the warp windows of streaming mode, so refills do not
+  // move ifs
+  trace_istream *window_ifs;
+  // set instead of ifs when the kernel trace is in the binary format
+  binary_trace_reader *binary_trace;
+  // built on first use by trace_parser::load_threadblock_index
+  threadblock_index_t *tb_index;
+  trace_opcode_table *opcodes;
+  // only vertex shaders report the footprint of their vertex buffers, the
+  // addresses are not collected for other kernels
+  bool vertex_kernel;
+  // "-roi pc = lo-hi,..." header line, the region of interest of the trace
+  std::string roi_pc;
   unsigned read_lines;
   std::string trace_file;
 };
@@ -103,6 +195,7 @@ struct kernel_trace_t {
 class trace_parser {
  public:
   trace_parser(const char *kernellist_filepath);
+  ~trace_parser();
 
   std::vector<trace_command> parse_commandlist_file();
 
@@ -110,18 +203,89 @@ class trace_parser {
 
   void parse_memcpy_info(const std::string &memcpy_command, size_t &add,
                          size_t &count, size_t &per_CTA);
+  void parse_fragment_tiles(const std::string &tiles_command,
+                            unsigned &columns, std::vector<unsigned> &tiles);
+  void parse_attachment(const std::string &attachment_command, size_t &base,
+                        size_t &size, unsigned &tile,
+                        std::vector<unsigned char> &sectors);
+
+  // parse the next thread block of a text trace stream, returns false at
+  // the end of the stream. The 32B aligned addresses of list_all memory
+  // instructions are appended to memaddrs unless it is NULL
+  bool get_next_threadblock_traces(
+      std::vector<std::vector<inst_trace_t> *> threadblock_traces,
+      unsigned trace_version, unsigned enable_lineinfo, trace_istream *ifs,
+      trace_opcode_table *opcodes, std::vector<uint64_t> *memaddrs,
+      trace_tb_entry *tb);
+
+  // next thread block of the kernel in file order, served by the prefetch
+  // threads when enabled. tb receives the CTA coordinates. For vertex
+  // kernels memaddrs receives the sorted, unique 32B lines the CTA touches.
+  bool get_next_threadblock_traces(
+      std::vector<std::vector<inst_trace_t> *> threadblock_traces,
+      kernel_trace_t *trace_info, std::vector<uint64_t> &memaddrs,
+      trace_tb_entry *tb);
+
+  // same as above but always parses on the calling thread
+  bool read_next_threadblock_traces(
+      std::vector<std::vector<inst_trace_t> *> threadblock_traces,
+      kernel_trace_t *trace_info, std::vector<uint64_t> &memaddrs,
+      trace_tb_entry *tb);
+
+  // parse upcoming CTAs on background threads, depth CTAs ahead per kernel
+  void enable_prefetch(unsigned threads, unsigned depth);
+
+  // (re)open the text trace stream positioned after the kernel header
+  void open_kernel_trace(kernel_trace_t *trace_info);
+
+  // build (or load the cached) thread block index of the kernel trace
+  const threadblock_index_t *load_threadblock_index(kernel_trace_t *trace_info);
 
-  void get_next_threadblock_traces(
+  // load the traces of thread block (x,y,z) directly, returns false if the
+  // trace does not contain it. Sequential reads continue after this block,
+  // so this does not mix with prefetching.
+  bool get_threadblock_traces(
       std::vector<std::vector<inst_trace_t> *> threadblock_traces,
-      unsigned trace_version, unsigned enable_lineinfo, std::ifstream *ifs,
-      std::string kernel_name, std::set<uint64_t> &memaddrs);
+      kernel_trace_t *trace_info, unsigned x, unsigned y, unsigned z,
+      std::vector<uint64_t> &memaddrs);
+
+  // streaming mode: locate the warps of the next CTA in file order, or of
+  // CTA (x,y,z), without decoding their instructions
+  bool get_next_threadblock_cursors(std::vector<trace_warp_cursor *> cursors,
+                                    kernel_trace_t *trace_info,
+                                    trace_tb_entry *tb);
+  bool get_threadblock_cursors(std::vector<trace_warp_cursor *> cursors,
+                               kernel_trace_t *trace_info, unsigned x,
+                               unsigned y, unsigned z);
+
+  // decode the next max_insts instructions of a warp and advance its cursor.
+  // memaddrs is filled as for get_next_threadblock_traces
+  void read_warp_window(kernel_trace_t *trace_info, trace_warp_cursor &cursor,
+                        unsigned max_insts,
+                        std::vector<inst_trace_t> &warp_traces,
+                        std::vector<uint64_t> &memaddrs);
 
   void kernel_finalizer(kernel_trace_t *trace_info);
+  // drops the streams of a finished kernel but keeps its header, opcode
+  // table and thread block index, so it can be launched again from the start
+  void rewind_kernel_trace(kernel_trace_t *trace_info);
+  // after fork() the streams share their file offsets with the parent, give
+  // the kernel private streams at the same positions
+  void reopen_kernel_trace(kernel_trace_t *trace_info);
   unsigned graphics_count;
   unsigned compute_count;
 
  private:
+  void parse_kernel_header_line(const std::string &line,
+                                kernel_trace_t *kernel_info);
+  void build_text_threadblock_index(kernel_trace_t *trace_info,
+                                    threadblock_index_t *index);
+  bool scan_text_threadblock(trace_istream *ifs,
+                             std::vector<trace_warp_cursor *> &cursors,
+                             trace_tb_entry *tb);
+
   std::string kernellist_filename;
+  class threadblock_prefetcher *m_prefetcher;
 };
 
 #endif
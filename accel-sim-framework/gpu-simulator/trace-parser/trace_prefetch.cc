@@ -0,0 +1,138 @@
+// Background thread block prefetching for the trace parser
+
+#include <assert.h>
+#include <bitset>
+#include <string>
+#include <vector>
+
+#include "trace_parser.h"
+#include "trace_prefetch.h"
+
+threadblock_prefetcher::threadblock_prefetcher(trace_parser *parser,
+                                               unsigned threads,
+                                               unsigned depth) {
+  m_parser = parser;
+  m_depth = depth > 0 ? depth : 1;
+  m_stop = false;
+  m_next_kernel = m_kernels.end();
+  for (unsigned i = 0; i < threads; ++i)
+    m_workers.push_back(std::thread(&threadblock_prefetcher::worker, this));
+}
+
+threadblock_prefetcher::~threadblock_prefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_work_cv.notify_all();
+  for (unsigned i = 0; i < m_workers.size(); ++i) m_workers[i].join();
+  while (!m_kernels.empty()) remove_kernel(m_kernels.begin()->first);
+}
+
+// round robin over the kernels that have room in their queue
+threadblock_prefetcher::kernel_state_t *threadblock_prefetcher::pick_work() {
+  if (m_kernels.empty()) return NULL;
+  if (m_next_kernel == m_kernels.end()) m_next_kernel = m_kernels.begin();
+  std::map<kernel_trace_t *, kernel_state_t *>::iterator start = m_next_kernel;
+  do {
+    kernel_state_t *state = m_next_kernel->second;
+    ++m_next_kernel;
+    if (m_next_kernel == m_kernels.end()) m_next_kernel = m_kernels.begin();
+    if (!state->busy && !state->eof && state->ready.size() < m_depth)
+      return state;
+  } while (m_next_kernel != start);
+  return NULL;
+}
+
+void threadblock_prefetcher::worker() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    kernel_state_t *state = NULL;
+    m_work_cv.wait(lock, [&] { return m_stop || (state = pick_work()); });
+    if (m_stop) return;
+
+    state->busy = true;
+    prefetched_threadblock_t *buf;
+    if (!state->free.empty()) {
+      buf = state->free.back();
+      state->free.pop_back();
+    } else {
+      buf = new prefetched_threadblock_t;
+      buf->warps.resize(state->warps_per_cta);
+    }
+    lock.unlock();
+
+    std::vector<std::vector<inst_trace_t> *> traces;
+    for (unsigned i = 0; i < buf->warps.size(); ++i)
+      traces.push_back(&buf->warps[i]);
+    bool found = m_parser->read_next_threadblock_traces(
+        traces, state->trace_info, buf->memaddrs, &buf->tb);
+
+    lock.lock();
+    if (found)
+      state->ready.push_back(buf);
+    else {
+      state->free.push_back(buf);
+      state->eof = true;
+    }
+    state->busy = false;
+    m_ready_cv.notify_all();
+  }
+}
+
+bool threadblock_prefetcher::get_next_threadblock_traces(
+    kernel_trace_t *trace_info,
+    std::vector<std::vector<inst_trace_t> *> &threadblock_traces,
+    std::vector<uint64_t> &memaddrs, trace_tb_entry *tb) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  kernel_state_t *&state = m_kernels[trace_info];
+  if (!state) {
+    state = new kernel_state_t;
+    state->trace_info = trace_info;
+    state->warps_per_cta = threadblock_traces.size();
+    state->busy = false;
+    state->eof = false;
+  }
+  assert(state->warps_per_cta == threadblock_traces.size());
+  kernel_state_t *s = state;
+  m_work_cv.notify_all();
+  m_ready_cv.wait(lock, [&] { return !s->ready.empty() || s->eof; });
+
+  if (s->ready.empty()) {
+    for (unsigned i = 0; i < threadblock_traces.size(); ++i)
+      threadblock_traces[i]->clear();
+    return false;
+  }
+  prefetched_threadblock_t *buf = s->ready.front();
+  s->ready.pop_front();
+  lock.unlock();
+
+  // hand over the parsed warps, the buffer keeps the consumer's old vectors
+  // and clears them when it is refilled
+  for (unsigned i = 0; i < threadblock_traces.size(); ++i)
+    threadblock_traces[i]->swap(buf->warps[i]);
+  memaddrs.swap(buf->memaddrs);
+  if (tb) *tb = buf->tb;
+
+  lock.lock();
+  s->free.push_back(buf);
+  m_work_cv.notify_all();
+  return true;
+}
+
+void threadblock_prefetcher::remove_kernel(kernel_trace_t *trace_info) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  std::map<kernel_trace_t *, kernel_state_t *>::iterator it =
+      m_kernels.find(trace_info);
+  if (it == m_kernels.end()) return;
+  kernel_state_t *state = it->second;
+  // let the worker finish its current CTA, it still uses the trace stream
+  m_ready_cv.wait(lock, [&] { return !state->busy; });
+  if (m_next_kernel == it) ++m_next_kernel;
+  m_kernels.erase(it);
+  lock.unlock();
+
+  for (unsigned i = 0; i < state->ready.size(); ++i) delete state->ready[i];
+  for (unsigned i = 0; i < state->free.size(); ++i) delete state->free[i];
+  delete state;
+}
@@ -0,0 +1,72 @@
+// Background thread block prefetching for the trace parser
+//
+// A small pool of worker threads parses upcoming CTAs of every kernel that
+// asked for traces into ready buffers, bounded per kernel by the queue depth.
+// Each kernel is parsed by at most one worker at a time and CTAs are queued
+// in file order, so a consumer sees exactly the sequence the serial parser
+// would produce; fetching a CTA only swaps the warp vectors.
+
+#ifndef TRACE_PREFETCH_H
+#define TRACE_PREFETCH_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace_binary.h"
+
+struct inst_trace_t;
+struct kernel_trace_t;
+class trace_parser;
+
+struct prefetched_threadblock_t {
+  std::vector<std::vector<inst_trace_t> > warps;
+  std::vector<uint64_t> memaddrs;
+  trace_tb_entry tb;
+};
+
+class threadblock_prefetcher {
+ public:
+  threadblock_prefetcher(trace_parser *parser, unsigned threads,
+                         unsigned depth);
+  ~threadblock_prefetcher();
+
+  // blocks until the next CTA of the kernel is parsed, then swaps it into
+  // threadblock_traces. Returns false when the kernel has no CTAs left.
+  bool get_next_threadblock_traces(
+      kernel_trace_t *trace_info,
+      std::vector<std::vector<inst_trace_t> *> &threadblock_traces,
+      std::vector<uint64_t> &memaddrs, trace_tb_entry *tb);
+
+  // stop prefetching for a kernel before its trace is finalized
+  void remove_kernel(kernel_trace_t *trace_info);
+
+ private:
+  struct kernel_state_t {
+    kernel_trace_t *trace_info;
+    unsigned warps_per_cta;
+    bool busy;  // a worker is parsing this kernel
+    bool eof;
+    std::deque<prefetched_threadblock_t *> ready;
+    std::vector<prefetched_threadblock_t *> free;
+  };
+
+  void worker();
+  kernel_state_t *pick_work();
+
+  trace_parser *m_parser;
+  unsigned m_depth;
+  bool m_stop;
+  std::mutex m_mutex;
+  std::condition_variable m_work_cv;
+  std::condition_variable m_ready_cv;
+  std::map<kernel_trace_t *, kernel_state_t *> m_kernels;
+  std::map<kernel_trace_t *, kernel_state_t *>::iterator m_next_kernel;
+  std::vector<std::thread> m_workers;
+};
+
+#endif
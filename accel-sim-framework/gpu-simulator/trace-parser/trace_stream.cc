@@ -0,0 +1,318 @@
+// Input stream for kernel trace files with transparent decompression
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef TRACE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "trace_stream.h"
+
+// the whole file as a read-only shared mapping, the get area is the file
+class mmap_streambuf : public std::streambuf {
+ public:
+  mmap_streambuf() : m_data(NULL), m_size(0) {}
+  ~mmap_streambuf() {
+    if (m_data) munmap(m_data, m_size);
+  }
+
+  bool open(const std::string &filepath) {
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      // nothing to map, the caller falls back to a filebuf
+      ::close(fd);
+      return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    m_data = (char *)data;
+    m_size = st.st_size;
+    setg(m_data, m_data, m_data + m_size);
+    return true;
+  }
+
+  bool next_line(const char *&begin, const char *&end) {
+    if (gptr() >= egptr()) return false;
+    begin = gptr();
+    const char *nl = (const char *)memchr(begin, '\n', egptr() - gptr());
+    end = nl ? nl : egptr();
+    setg(eback(), nl ? (char *)nl + 1 : egptr(), egptr());
+    return true;
+  }
+
+ protected:
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) {
+    if (dir == std::ios_base::cur)
+      off += gptr() - eback();
+    else if (dir == std::ios_base::end)
+      off += m_size;
+    return seekpos(pos_type(off), which);
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode) {
+    if (off_type(pos) < 0 || size_t(off_type(pos)) > m_size)
+      return pos_type(off_type(-1));
+    setg(eback(), eback() + off_type(pos), egptr());
+    return pos;
+  }
+
+ private:
+  char *m_data;
+  size_t m_size;
+};
+
+namespace {
+
+const unsigned TRACE_STREAM_BUF_SIZE = 1 << 16;
+
+// gzread into a local buffer, gzseek handles both directions
+class gz_streambuf : public std::streambuf {
+ public:
+  gz_streambuf() : m_file(NULL), m_buf(TRACE_STREAM_BUF_SIZE) {}
+  ~gz_streambuf() {
+    if (m_file) gzclose(m_file);
+  }
+
+  bool open(const std::string &filepath) {
+    m_file = gzopen(filepath.c_str(), "rb");
+    if (!m_file) return false;
+    gzbuffer(m_file, TRACE_STREAM_BUF_SIZE);
+    setg(&m_buf[0], &m_buf[0], &m_buf[0]);
+    return true;
+  }
+
+ protected:
+  int_type underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    int n = gzread(m_file, &m_buf[0], m_buf.size());
+    if (n <= 0) return traits_type::eof();
+    setg(&m_buf[0], &m_buf[0], &m_buf[0] + n);
+    return traits_type::to_int_type(*gptr());
+  }
+
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) {
+    if (dir == std::ios_base::end) return pos_type(off_type(-1));
+    off_type cur = gztell(m_file) - (egptr() - gptr());
+    if (dir == std::ios_base::cur) {
+      if (off == 0) return pos_type(cur);
+      off += cur;
+    }
+    return seekpos(pos_type(off), which);
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode) {
+    off_type end = gztell(m_file);
+    off_type start = end - (egptr() - eback());
+    if (pos >= start && pos <= end) {
+      setg(eback(), eback() + (off_type(pos) - start), egptr());
+      return pos;
+    }
+    if (gzseek(m_file, off_type(pos), SEEK_SET) < 0)
+      return pos_type(off_type(-1));
+    setg(&m_buf[0], &m_buf[0], &m_buf[0]);
+    return pos;
+  }
+
+ private:
+  gzFile m_file;
+  std::vector<char> m_buf;
+};
+
+#ifdef TRACE_ZSTD
+// streaming ZSTD_decompressStream, seeking back restarts the frame
+class zstd_streambuf : public std::streambuf {
+ public:
+  zstd_streambuf()
+      : m_file(NULL),
+        m_dctx(NULL),
+        m_in(ZSTD_DStreamInSize()),
+        m_out(ZSTD_DStreamOutSize()) {}
+  ~zstd_streambuf() {
+    if (m_dctx) ZSTD_freeDCtx(m_dctx);
+    if (m_file) fclose(m_file);
+  }
+
+  bool open(const std::string &filepath) {
+    m_file = fopen(filepath.c_str(), "rb");
+    if (!m_file) return false;
+    m_dctx = ZSTD_createDCtx();
+    rewind_stream();
+    return true;
+  }
+
+ protected:
+  int_type underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    m_pos += egptr() - eback();
+    size_t n = decode();
+    if (n == 0) {
+      setg(&m_out[0], &m_out[0], &m_out[0]);
+      return traits_type::eof();
+    }
+    setg(&m_out[0], &m_out[0], &m_out[0] + n);
+    return traits_type::to_int_type(*gptr());
+  }
+
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) {
+    if (dir == std::ios_base::end) return pos_type(off_type(-1));
+    off_type cur = m_pos + (gptr() - eback());
+    if (dir == std::ios_base::cur) {
+      if (off == 0) return pos_type(cur);
+      off += cur;
+    }
+    return seekpos(pos_type(off), which);
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode) {
+    off_type target = pos;
+    if (target < m_pos) rewind_stream();
+    while (target > m_pos + (egptr() - eback())) {
+      setg(eback(), egptr(), egptr());
+      if (underflow() == traits_type::eof()) return pos_type(off_type(-1));
+    }
+    setg(eback(), eback() + (target - m_pos), egptr());
+    return pos;
+  }
+
+ private:
+  void rewind_stream() {
+    fseek(m_file, 0, SEEK_SET);
+    ZSTD_DCtx_reset(m_dctx, ZSTD_reset_session_only);
+    m_input.src = &m_in[0];
+    m_input.size = 0;
+    m_input.pos = 0;
+    m_pos = 0;
+    setg(&m_out[0], &m_out[0], &m_out[0]);
+  }
+
+  // decompress into m_out, returns the number of bytes produced
+  size_t decode() {
+    ZSTD_outBuffer output = {&m_out[0], m_out.size(), 0};
+    while (output.pos == 0) {
+      if (m_input.pos == m_input.size) {
+        m_input.size = fread(&m_in[0], 1, m_in.size(), m_file);
+        m_input.pos = 0;
+        if (m_input.size == 0) break;
+      }
+      size_t ret = ZSTD_decompressStream(m_dctx, &output, &m_input);
+      if (ZSTD_isError(ret)) {
+        fprintf(stderr, "zstd trace decode error: %s\n",
+                ZSTD_getErrorName(ret));
+        break;
+      }
+    }
+    return output.pos;
+  }
+
+  FILE *m_file;
+  ZSTD_DCtx *m_dctx;
+  std::vector<char> m_in;
+  std::vector<char> m_out;
+  ZSTD_inBuffer m_input;
+  off_type m_pos;  // decompressed offset of eback()
+};
+#endif
+
+}  // namespace
+
+trace_istream::trace_istream()
+    : std::istream(NULL),
+      m_buf(NULL),
+      m_mapped(NULL),
+      m_compression(TRACE_UNCOMPRESSED) {}
+
+trace_istream::trace_istream(const std::string &filepath)
+    : std::istream(NULL),
+      m_buf(NULL),
+      m_mapped(NULL),
+      m_compression(TRACE_UNCOMPRESSED) {
+  open(filepath);
+}
+
+trace_istream::~trace_istream() { close(); }
+
+trace_compression trace_istream::detect_compression(
+    const std::string &filepath) {
+  unsigned char magic[4] = {0, 0, 0, 0};
+  FILE *f = fopen(filepath.c_str(), "rb");
+  if (!f) return TRACE_UNCOMPRESSED;
+  size_t n = fread(magic, 1, sizeof(magic), f);
+  fclose(f);
+  if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) return TRACE_GZIP;
+  if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f &&
+      magic[3] == 0xfd)
+    return TRACE_ZSTD_COMPRESSED;
+  return TRACE_UNCOMPRESSED;
+}
+
+bool trace_istream::open(const std::string &filepath) {
+  close();
+  m_compression = detect_compression(filepath);
+  if (m_compression == TRACE_GZIP) {
+    gz_streambuf *buf = new gz_streambuf;
+    if (buf->open(filepath))
+      m_buf = buf;
+    else
+      delete buf;
+  } else if (m_compression == TRACE_ZSTD_COMPRESSED) {
+#ifdef TRACE_ZSTD
+    zstd_streambuf *buf = new zstd_streambuf;
+    if (buf->open(filepath))
+      m_buf = buf;
+    else
+      delete buf;
+#else
+    fprintf(stderr,
+            "%s is zstd compressed, rebuild with zstd installed to read it\n",
+            filepath.c_str());
+#endif
+  } else {
+    mmap_streambuf *mapped = new mmap_streambuf;
+    if (mapped->open(filepath)) {
+      m_buf = m_mapped = mapped;
+    } else {
+      delete mapped;
+      std::filebuf *buf = new std::filebuf;
+      if (buf->open(filepath.c_str(), std::ios::in | std::ios::binary))
+        m_buf = buf;
+      else
+        delete buf;
+    }
+  }
+
+  rdbuf(m_buf);
+  clear(m_buf ? std::ios::goodbit : std::ios::failbit);
+  return m_buf != NULL;
+}
+
+void trace_istream::close() {
+  rdbuf(NULL);
+  delete m_buf;
+  m_buf = NULL;
+  m_mapped = NULL;
+}
+
+bool trace_istream::next_line(const char *&begin, const char *&end) {
+  if (!good()) return false;
+  if (m_mapped) {
+    if (m_mapped->next_line(begin, end)) return true;
+    setstate(std::ios::eofbit | std::ios::failbit);
+    return false;
+  }
+  if (!std::getline(*this, m_line)) return false;
+  begin = m_line.data();
+  end = begin + m_line.size();
+  return true;
+}
@@ -0,0 +1,54 @@
+// Input stream for kernel trace files with transparent decompression
+//
+// gzip (.traceg.gz) and zstd (.traceg.zst) traces are detected by their
+// magic and decompressed while streaming; plain files are read through a
+// read-only shared mapping, so jobs replaying the same trace share its page
+// cache and lines can be parsed in place. Positions are offsets in the
+// decompressed data. Seeking in a compressed trace is supported but costs a
+// re-decode from the start when going backwards (zstd) or from the last gzip
+// access point (zlib).
+// zstd support needs TRACE_ZSTD at build time.
+
+#ifndef TRACE_STREAM_H
+#define TRACE_STREAM_H
+
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+enum trace_compression {
+  TRACE_UNCOMPRESSED = 0,
+  TRACE_GZIP,
+  TRACE_ZSTD_COMPRESSED,
+};
+
+class trace_istream : public std::istream {
+ public:
+  trace_istream();
+  trace_istream(const std::string &filepath);
+  ~trace_istream();
+
+  static trace_compression detect_compression(const std::string &filepath);
+
+  bool open(const std::string &filepath);
+  bool is_open() const { return m_buf != NULL; }
+  void close();
+  trace_compression get_compression() const { return m_compression; }
+  bool is_mapped() const { return m_mapped != NULL; }
+
+  // next line without its newline, returns false at the end of the stream.
+  // For mapped traces the range points into the mapping, otherwise into a
+  // buffer reused across calls; either way it is only valid until the next
+  // read.
+  bool next_line(const char *&begin, const char *&end);
+
+ private:
+  std::streambuf *m_buf;
+  class mmap_streambuf *m_mapped;  // m_buf if the file is mapped
+  trace_compression m_compression;
+  std::string m_line;
+};
+
+#endif
@@ -10,6 +10,8 @@ import common
 import math
 import yaml
 import time
+import io
+import kernel_stats_to_text
 
 millnames = ['',' K',' M',' B',' T']
 def millify(n):
@@ -82,6 +84,10 @@ parser.add_option("-I", "--ignore_failures", dest="ignore_failures", action="sto
                   help="If an app crashed, still collect its data")
 parser.add_option("-A", "--do_averages", dest="do_averages", action="store_true",
                   help="Print the averages for each statistic")
+parser.add_option("-J", "--kernel_stats_file", dest="kernel_stats_file", default="",
+                  help="The -gpgpu_kernel_stats_file name the runs wrote in their output"+\
+                       " directories. Runs that have it are reduced from its records instead"+\
+                       " of scanning their whole log; the log is only checked for the exit.")
 (options, args) = parser.parse_args()
 options.logfile = options.logfile.strip()
 options.run_dir = options.run_dir.strip()
@@ -225,6 +231,18 @@ for idx, app_and_args in enumerate(apps_and_args):
         exit_success = False
         MAX_LINES = 10000
         BYTES_TO_READ = int(250 * 1024 * 1024)
+        # the records of the run, rendered as the text of its log
+        records = None
+        if options.kernel_stats_file != "":
+            records_file = os.path.join(output_dir, options.kernel_stats_file)
+            if os.path.isfile(records_file):
+                text = io.StringIO()
+                kernel_stats_to_text.render(records_file, text)
+                records = text.getvalue().splitlines(True)
+                files_parsed += 1
+                bytes_parsed += os.stat(records_file).st_size
+                # the exit is among the last lines the simulator prints
+                BYTES_TO_READ = 1024 * 1024
         count = 0
         f = open(outfile)
         fsize = int(os.stat(outfile).st_size)
@@ -257,15 +275,18 @@ for idx, app_and_args in enumerate(apps_and_args):
             BYTES_TO_READ = int(250 * 1024 * 1024)
             count = 0
             f = open(outfile)
-            fsize = int(os.stat(outfile).st_size)
-            files_parsed += 1
-            if fsize > BYTES_TO_READ:
-                f.seek(0, os.SEEK_END)
-                f.seek(f.tell() - BYTES_TO_READ, os.SEEK_SET)
-                bytes_parsed += BYTES_TO_READ
+            if records is not None:
+                lines = records
             else:
-                bytes_parsed += fsize
-            lines = f.readlines()
+                fsize = int(os.stat(outfile).st_size)
+                files_parsed += 1
+                if fsize > BYTES_TO_READ:
+                    f.seek(0, os.SEEK_END)
+                    f.seek(f.tell() - BYTES_TO_READ, os.SEEK_SET)
+                    bytes_parsed += BYTES_TO_READ
+                else:
+                    bytes_parsed += fsize
+                lines = f.readlines()
             for line in reversed(lines):
                 # pull out some stats
                 for stat_name, tup in stats_to_pull.items():
@@ -286,9 +307,12 @@ for idx, app_and_args in enumerate(apps_and_args):
             last_kernel = ""
             raw_last = {}
             running_kcount = {}
-            files_parsed += 1
-            bytes_parsed += os.stat(outfile).st_size
-            f = open(outfile)
+            if records is not None:
+                f = records
+            else:
+                files_parsed += 1
+                bytes_parsed += os.stat(outfile).st_size
+                f = open(outfile)
             #print("Parsing File {0}. Size: {1}".format(outfile, millify(os.stat(outfile).st_size)))
             for line in f:
                 # If we ended simulation due to too many insn - ignore the last kernel launch, as it is no complete.
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+
+# Renders the records of -gpgpu_kernel_stats_file in the per-kernel text
+# format of the full stats dump, so get_stats.py can parse runs that printed
+# only summaries. Counters the simulator did not record are zero and left
+# out, as are the sections the records do not carry. get_stats.py -J
+# imports render() to reduce the records of a run instead of its log.
+
+from optparse import OptionParser
+import json
+import sys
+
+# outcomes print_stats does not count in TOTAL_ACCESS
+NOT_ACCESSES = ("RESERVATION_FAIL", "MSHR_HIT")
+
+
+def print_cache(out, name, counters, totals):
+    for type, outcomes in counters.items():
+        for outcome, n in outcomes.items():
+            out.write("\t%s[%s][%s] = %d\n" % (name, type, outcome, n))
+    if not totals:
+        return
+    for type, outcomes in counters.items():
+        total = sum(n for o, n in outcomes.items() if o not in NOT_ACCESSES)
+        if total:
+            out.write("\t%s[%s][TOTAL_ACCESS] = %d\n" % (name, type, total))
+
+
+def print_kernel(out, k):
+    out.write("kernel_name = %s-%d\n" % (k["name"][:64], k["uid"]))
+    out.write("kernel_launch_uid = %d\n" % k["uid"])
+    out.write("gpu_sim_cycle = %d\n" % k["cycles"])
+    out.write("gpu_sim_insn = %d\n" % k["insn"])
+    out.write("gpu_ipc = %12.4f\n" % (float(k["insn"]) / max(k["cycles"], 1)))
+    out.write("gpu_tot_sim_cycle = %d\n" % k["tot_cycle"])
+    out.write("gpu_tot_sim_insn = %d\n" % k["tot_insn"])
+    out.write("gpu_tot_ipc = %12.4f\n" %
+              (float(k["tot_insn"]) / max(k["tot_cycle"], 1)))
+    out.write("gpu_tot_issued_cta = %d\n" % k["tot_issued_cta"])
+    # older records have no more than the above and the caches
+    if "occupancy" in k:
+        out.write("gpu_occupancy = %.4f%% \n" % k["occupancy"])
+        out.write("gpu_tot_occupancy = %.4f%% \n" % k["tot_occupancy"])
+        out.write("gpgpu_n_tot_w_icount = %d\n" % k["tot_w_icount"])
+        out.write("L2_BW  = %12.4f GB/Sec\n" % k["l2_bw"])
+        out.write("L2_BW_total  = %12.4f GB/Sec\n" % k["l2_bw_total"])
+    if "dram_reads" in k:
+        out.write("gpu_kernel_dram_reads = %d\n" % k["dram_reads"])
+        out.write("gpu_kernel_dram_writes = %d\n" % k["dram_writes"])
+        out.write("gpu_tot_dram_reads = %d\n" % k["tot_dram_reads"])
+        out.write("gpu_tot_dram_writes = %d\n" % k["tot_dram_writes"])
+    out.write("\nTotal_core_cache_stats:\n")
+    print_cache(out, "Total_core_cache_stats_breakdown", k["l1"], True)
+    out.write("\nTotal_core_cache_fail_stats:\n")
+    print_cache(out, "Total_core_cache_fail_stats_breakdown", k["l1_fail"],
+                False)
+    if "l2" in k:
+        out.write("L2_total_cache_breakdown:\n")
+        print_cache(out, "L2_cache_stats_breakdown", k["l2"], True)
+        out.write("L2_total_cache_reservation_fail_breakdown:\n")
+        print_cache(out, "L2_cache_stats_fail_breakdown", k["l2_fail"], False)
+    if "sim_seconds" in k:
+        t = k["sim_seconds"]
+        out.write("\n\ngpgpu_simulation_time = %d days, %d hrs, %d min, "
+                  "%d sec (%d sec)\n" % (t // 86400, t // 3600 % 24,
+                                         t // 60 % 60, t % 60, t))
+        out.write("gpgpu_simulation_rate = %d (inst/sec)\n" %
+                  k["sim_insn_rate"])
+        out.write("gpgpu_simulation_rate = %d (cycle/sec)\n" %
+                  k["sim_cycle_rate"])
+
+
+# the records of path as text, ending with the exit get_stats.py looks for
+def render(path, out):
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line:
+                print_kernel(out, json.loads(line))
+    # get_stats.py only takes runs that exited
+    out.write("GPGPU-Sim: *** exit detected ***\n")
+
+
+if __name__ == "__main__":
+    parser = OptionParser(usage="%prog [options] <kernel stats file>")
+    parser.add_option("-o", "--output", dest="output", default="",
+                      help="write the text here instead of to stdout")
+    (options, args) = parser.parse_args()
+    if len(args) != 1:
+        parser.error("exactly one -gpgpu_kernel_stats_file is needed")
+
+    out = open(options.output, "w") if options.output else sys.stdout
+    render(args[0], out)
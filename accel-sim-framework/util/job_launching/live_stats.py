@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+
+# Reads the -gpgpu_live_stats_file snapshots of running simulations without
+# stopping them. Every interval seconds it prints a line per file with the
+# cycle, the per-class IPC, L2 hit rates and DRAM bytes per cycle since the
+# previous snapshot, the SMs with a CTA and the progress of the running
+# kernels. With --max_cycle or --min_ipc it names the runs past the cycle,
+# or below the IPC over the last interval, so a sweep script can kill them.
+
+from optparse import OptionParser
+import struct
+import sys
+import time
+
+CLASSES = ["compute", "graphics"]
+KERNELS = 16
+TENANTS = 4
+HEADER = struct.Struct("<8s" + "Q" * 5)
+COUNTERS = struct.Struct("<" + "Q" * (14 + TENANTS + 2))
+KERNEL = struct.Struct("<" + "Q" * 7)
+SIZE = HEADER.size + COUNTERS.size + KERNEL.size * KERNELS
+
+
+def parse(data):
+    magic, version, sequence, period, finished, cycle = \
+        HEADER.unpack_from(data, 0)
+    if magic != b"GSLIVE\0\0":
+        return None
+    if version != 1:
+        raise ValueError("unknown live stats version %d" % version)
+    c = COUNTERS.unpack_from(data, HEADER.size)
+    s = {"sequence": sequence, "period": period, "finished": finished,
+         "cycle": cycle, "insn": c[0]}
+    for i, name in enumerate(["thread_insts", "l2_accesses", "l2_hits",
+                              "dram_accesses", "dram_bytes"]):
+        s[name] = c[1 + 2 * i:3 + 2 * i]
+    s["num_sms"], s["active_sms"], s["graphics_sms"] = c[11:14]
+    s["tenant_sms"] = c[14:14 + TENANTS]
+    s["num_mem_partitions"], s["running_kernels"] = c[14 + TENANTS:]
+    s["kernels"] = []
+    for k in range(min(s["running_kernels"], KERNELS)):
+        uid, graphics, tenant, start, issued, total, insn = KERNEL.unpack_from(
+            data, HEADER.size + COUNTERS.size + k * KERNEL.size)
+        s["kernels"].append({"uid": uid, "graphics": graphics,
+                             "tenant": tenant, "start_cycle": start,
+                             "issued_ctas": issued, "total_ctas": total,
+                             "insn": insn})
+    return s
+
+
+# a consistent snapshot, None when the file has none yet
+def read(path):
+    for attempt in range(100):
+        with open(path, "rb") as f:
+            before = f.read(SIZE)
+        if len(before) < SIZE:
+            return None
+        s = parse(before)
+        if s is None or s["sequence"] % 2:
+            time.sleep(0.001)
+            continue
+        with open(path, "rb") as f:
+            after = f.read(HEADER.size)
+        if HEADER.unpack_from(after, 0)[2] == s["sequence"]:
+            return s
+    return None
+
+
+def describe(s, prev):
+    cycles = max(s["cycle"] - (prev["cycle"] if prev else 0), 1)
+    delta = lambda name, c: s[name][c] - (prev[name][c] if prev else 0)
+    fields = ["cycle %d" % s["cycle"]]
+    for c, name in enumerate(CLASSES):
+        accesses = delta("l2_accesses", c)
+        fields.append("%s ipc %.2f l2 %.2f dram %.1f B/cyc" % (
+            name, delta("thread_insts", c) / float(cycles),
+            delta("l2_hits", c) / float(accesses) if accesses else 0,
+            delta("dram_bytes", c) / float(cycles)))
+    fields.append("sms %d/%d" % (s["active_sms"], s["num_sms"]))
+    for k in s["kernels"]:
+        fields.append("k%d %d/%d" % (k["uid"], k["issued_ctas"],
+                                     k["total_ctas"]))
+    if s["finished"]:
+        fields.append("finished")
+    return ", ".join(fields)
+
+
+def ipc(s, prev):
+    cycles = max(s["cycle"] - (prev["cycle"] if prev else 0), 1)
+    return (s["insn"] - (prev["insn"] if prev else 0)) / float(cycles)
+
+
+def main():
+    parser = OptionParser(usage="%prog [options] <live stats file>...")
+    parser.add_option("-i", "--interval", type="float", default=10,
+                      help="seconds between two reads")
+    parser.add_option("-n", "--count", type="int", default=0,
+                      help="reads before exiting, 0 until every run finished")
+    parser.add_option("--max_cycle", type="int", default=0,
+                      help="report the runs past this cycle")
+    parser.add_option("--min_ipc", type="float", default=0,
+                      help="report the runs below this IPC over an interval")
+    (options, paths) = parser.parse_args()
+    if not paths:
+        parser.error("no live stats file")
+    prev = dict((p, None) for p in paths)
+    reads = 0
+    while True:
+        done = True
+        for p in paths:
+            s = read(p)
+            if s is None:
+                done = False
+                print("%s: no snapshot" % p)
+                continue
+            print("%s: %s" % (p, describe(s, prev[p])))
+            if not s["finished"]:
+                done = False
+                if options.max_cycle and s["cycle"] > options.max_cycle:
+                    print("%s: past cycle %d" % (p, options.max_cycle))
+                if (options.min_ipc and prev[p] and
+                        s["cycle"] > prev[p]["cycle"] and
+                        ipc(s, prev[p]) < options.min_ipc):
+                    print("%s: below ipc %.2f" % (p, options.min_ipc))
+            prev[p] = s
+        sys.stdout.flush()
+        reads += 1
+        if done or (options.count and reads >= options.count):
+            break
+        time.sleep(options.interval)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+
+# Reads the time series of -gpgpu_counter_sample_file and of
+# -power_trace_binary. As a library, load() returns the sample period, the
+# counter names and the rows, cumulative counters as ints and gauges as
+# floats, and series() turns the counter samples into the per-period
+# graphics and compute IPC, L2 hit rates and DRAM bytes per cycle that the
+# notebooks in util/graphics plot. Run as a script it prints those series as
+# a csv, or the rows as they are for a file of gauges such as a power trace.
+
+from optparse import OptionParser
+import gzip
+import struct
+
+CLASSES = ["graphics", "compute"]
+
+
+# the period, names, kinds (0 for a cumulative counter, 1 for a gauge of
+# doubles) and rows of a file
+def read(path):
+    with gzip.open(path, "rb") as f:
+        data = f.read()
+    if data[0:4] != b"GSMP":
+        raise ValueError(path + " is not a counter sample file")
+    version, period, count = struct.unpack_from("<IQI", data, 4)
+    if version not in (1, 2):
+        raise ValueError("unknown counter sample version %d" % version)
+    pos = 20
+    names = []
+    kinds = []
+    for i in range(count):
+        (length,) = struct.unpack_from("<I", data, pos)
+        pos += 4
+        names.append(data[pos:pos + length].decode())
+        pos += length
+        kinds.append(data[pos] if version >= 2 else 0)
+        pos += 1 if version >= 2 else 0
+    row = struct.Struct("<Q" + "".join("d" if k else "Q" for k in kinds))
+    rows = [row.unpack_from(data, p)
+            for p in range(pos, len(data) - row.size + 1, row.size)]
+    return period, names, kinds, rows
+
+
+def load(path):
+    period, names, kinds, rows = read(path)
+    return period, names, rows
+
+
+# cycles and the per-row rates, the first row counts from cycle 0
+def series(names, rows):
+    col = dict((n, i + 1) for i, n in enumerate(names))
+    out = {"cycle": [r[0] for r in rows]}
+    for c in CLASSES:
+        out[c + "_ipc"] = []
+        out[c + "_l2_hit_rate"] = []
+        out[c + "_dram_bytes_per_cycle"] = []
+    prev = (0,) * (len(names) + 1)
+    for r in rows:
+        cycles = max(r[0] - prev[0], 1)
+        delta = lambda n: r[col[n]] - prev[col[n]]
+        for c in CLASSES:
+            accesses = delta(c + "_l2_accesses")
+            out[c + "_ipc"].append(float(delta(c + "_thread_insts")) / cycles)
+            out[c + "_l2_hit_rate"].append(
+                float(delta(c + "_l2_hits")) / accesses if accesses else 0.0)
+            out[c + "_dram_bytes_per_cycle"].append(
+                float(delta(c + "_dram_bytes")) / cycles)
+        prev = r
+    return out
+
+
+if __name__ == "__main__":
+    parser = OptionParser(usage="%prog [options] <sample file>")
+    (options, args) = parser.parse_args()
+    if len(args) != 1:
+        parser.error("expected one -gpgpu_counter_sample_file")
+    period, names, kinds, rows = read(args[0])
+    if any(kinds):
+        print(",".join(["cycle"] + names))
+        for r in rows:
+            print(",".join(str(v) for v in r))
+        raise SystemExit(0)
+    s = series(names, rows)
+    keys = ["cycle"] + [k for k in s if k != "cycle"]
+    print(",".join(keys))
+    for i in range(len(rows)):
+        print(",".join(str(s[k][i]) for k in keys))
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+
+# Evaluates every graphics/compute way split of the L2 in one pass over the
+# access stream recorded with -gpgpu_l2_access_log. Under a fixed way
+# partition each class only replaces lines in its own ways, so with LRU its
+# hits are the accesses whose stack distance among that class's lines of
+# the set is below its ways (Mattson et al.): one LRU stack per class and
+# set gives the hit rates of all splits, and a stack shared by both classes
+# gives those of the unpartitioned L2. Hits are counted per line, a hit on
+# a line whose sector was never filled counts as a hit, and only the LRU
+# replacement policy is modeled. The result points at the splits worth a
+# timing run; the utility and share based partitions of -gpgpu_utility
+# adapt at run time and have no single-pass equivalent.
+#
+# As a library, sweep() returns the ways, the per-class stack distance
+# histograms and the split table. Run as a script it prints the table as a
+# csv, the unpartitioned L2 first.
+
+from optparse import OptionParser
+import gzip
+import struct
+
+GRAPHICS = 1
+COPY = 8
+RECORD = struct.Struct("<QQIBBxx")
+
+
+def read_header(f, path):
+    header = f.read(24)
+    if header[0:4] != b"GL2A":
+        raise ValueError(path + " is not an L2 access log")
+    version, sub_partitions, sets, assoc, line_size = struct.unpack_from(
+        "<5I", header, 4)
+    if version != 1:
+        raise ValueError("unknown L2 access log version %d" % version)
+    return sub_partitions, sets, assoc, line_size
+
+
+# stack distances of the accesses in [start, end) cycles, per class
+# (0 compute, 1 graphics) in the class's own stack and in the shared one.
+# Index assoc counts the accesses that miss in any split. Copy engine fills
+# change the stacks but are only counted with copies
+def histograms(path, start=0, end=None, copies=False):
+    with gzip.open(path, "rb") as f:
+        sub_partitions, sets, assoc, line_size = read_header(f, path)
+        own = [[0] * (assoc + 1) for c in range(2)]
+        shared = [[0] * (assoc + 1) for c in range(2)]
+        stacks = {}
+
+        def touch(stack, addr):
+            try:
+                d = stack.index(addr)
+                del stack[d]
+            except ValueError:
+                d = assoc
+                if len(stack) == assoc:
+                    stack.pop()
+            stack.insert(0, addr)
+            return d
+
+        while True:
+            chunk = f.read(RECORD.size * 65536)
+            if len(chunk) < RECORD.size:
+                break
+            chunk = chunk[:len(chunk) // RECORD.size * RECORD.size]
+            for cycle, addr, s, sectors, flags in RECORD.iter_unpack(chunk):
+                c = flags & GRAPHICS
+                st = stacks.get(s)
+                if st is None:
+                    st = stacks[s] = ([], [], [])
+                d = touch(st[c], addr)
+                ds = touch(st[2], addr)
+                if cycle < start or (end is not None and cycle >= end):
+                    continue
+                if flags & COPY and not copies:
+                    continue
+                own[c][d] += 1
+                shared[c][ds] += 1
+    return assoc, own, shared
+
+
+def rate(hits, accesses):
+    return float(hits) / accesses if accesses else 0.0
+
+
+# rows of graphics ways (None for the unpartitioned L2), their percent of
+# the ways and the graphics, compute and overall hit rates
+def sweep(path, start=0, end=None, copies=False):
+    assoc, own, shared = histograms(path, start, end, copies)
+    gr, cp = sum(own[1]), sum(own[0])
+    rows = []
+    g_hits, c_hits = sum(shared[1][:assoc]), sum(shared[0][:assoc])
+    rows.append((None, None, rate(g_hits, gr), rate(c_hits, cp),
+                 rate(g_hits + c_hits, gr + cp)))
+    for ways in range(assoc + 1):
+        g_hits = sum(own[1][:ways])
+        c_hits = sum(own[0][:assoc - ways])
+        rows.append((ways, 100 * ways // assoc, rate(g_hits, gr),
+                     rate(c_hits, cp), rate(g_hits + c_hits, gr + cp)))
+    return assoc, own, shared, rows
+
+
+if __name__ == "__main__":
+    parser = OptionParser(usage="%prog [options] <L2 access log>")
+    parser.add_option("-s", "--start", type="int", default=0,
+                      help="first cycle counted, earlier accesses only warm "
+                      "the stacks up")
+    parser.add_option("-e", "--end", type="int", default=None,
+                      help="cycle the counting stops at")
+    parser.add_option("-c", "--copies", action="store_true", default=False,
+                      help="count the copy engine fills as accesses")
+    (options, args) = parser.parse_args()
+    if len(args) != 1:
+        parser.error("expected one -gpgpu_l2_access_log file")
+    assoc, own, shared, rows = sweep(args[0], options.start, options.end,
+                                     options.copies)
+    print("graphics_ways,graphics_percent,graphics_hit_rate,"
+          "compute_hit_rate,hit_rate")
+    for ways, ratio, g, c, t in rows:
+        print("%s,%s,%f,%f,%f" % ("shared" if ways is None else ways,
+                                  "" if ratio is None else ratio, g, c, t))
@@ -1,6 +1,7 @@
 /* Author1: Mahmoud Khairy, abdallm@purdue.com - 2019 */
 /* Author2: Jason Shen, shen203@purdue.edu - 2019 */
 
+#include <stddef.h>
 #include <stdint.h>
 
 static __managed__ uint64_t total_dynamic_instr_counter = 0;
@@ -11,23 +12,55 @@ static __managed__ bool stop_report = false;
  * on the channel from the GPU to the CPU */
 #define MAX_SRC 5
 
+/* what an instruction record carries of the addresses of the warp */
+enum record_addrs {
+  RECORD_NO_ADDRS = 0, /* not a memory instruction */
+  RECORD_AFFINE = 1,   /* addrs[0] of the first lane, addrs[1] per lane */
+  RECORD_ALL_ADDRS = 2 /* addrs[i] of lane i */
+};
+
+/* the fields of an instruction that do not change from one execution to
+ * the next, known when it is instrumented; a record names it by its index
+ * in the table of the host */
 typedef struct {
-  int cta_id_x;
-  int cta_id_y;
-  int cta_id_z;
-  int warpid_tb;
-  int warpid_sm;
-  int sm_id;
   int opcode_id;
-  uint64_t addrs[32];
   uint32_t line_num;
   uint32_t vpc;
   bool is_mem;
   int32_t GPRDst;
   int32_t GPRSrcs[MAX_SRC];
-  int32_t numSrcs;
-  int32_t width;
+} static_inst_t;
+
+/* a record is pushed up to the addresses it carries, see record_size */
+typedef struct {
+  int cta_id_x;
+  int cta_id_y;
+  int cta_id_z;
+  int warpid_tb;
+  int warpid_sm;
+  int sm_id;
+  uint32_t inst_id;
   uint32_t active_mask;
   uint32_t predicate_mask;
-
+  uint32_t addr_format;
+  uint64_t addrs[32];
 } inst_trace_t;
+
+#define RECORD_HEADER_SIZE offsetof(inst_trace_t, addrs)
+
+static __host__ __device__ inline uint32_t record_size(uint32_t addr_format) {
+  return RECORD_HEADER_SIZE +
+         (addr_format == RECORD_AFFINE
+              ? 2 * sizeof(uint64_t)
+              : addr_format == RECORD_ALL_ADDRS ? 32 * sizeof(uint64_t) : 0);
+}
+
+/* with TOOL_LOOP_ITERS, the iterations each hardware warp slot ran of the
+ * warp in it, an iteration ending whenever the PC goes back */
+#define LOOP_STATE_SLOTS (256 * 64)
+
+typedef struct {
+  uint64_t warp; /* the CTA and warp in the slot, 0 when none */
+  uint32_t last_vpc;
+  uint32_t iters;
+} loop_state_t;
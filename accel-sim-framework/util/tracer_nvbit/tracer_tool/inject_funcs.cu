@@ -16,13 +16,21 @@
 /* Instrumentation function that we want to inject, please note the use of
  *  extern "C" __device__ __noinline__
  *    To prevent "dead"-code elimination by the compiler.
+ *
+ * The record names the instruction by inst_id in the static instruction
+ * table of the host and carries only what changes per execution. The
+ * addresses of a warp whose active lanes step by one stride are sent as
+ * base and stride, the others lane by lane. Only every cta_sample-th CTA is
+ * traced. With skip_after > 0 a warp stops sending the instruction once it
+ * ran skip_after iterations, an iteration ending whenever its PC goes
+ * back; skip_after is 0 for the memory and control instructions.
  */
 extern "C" __device__ __noinline__ void instrument_inst(
-    int pred, int opcode_id, int32_t vpc, bool is_mem, uint64_t addr,
-    int32_t width, int32_t desReg, int32_t srcReg1, int32_t srcReg2,
-    int32_t srcReg3, int32_t srcReg4, int32_t srcReg5, int32_t srcNum,
-    uint64_t pchannel_dev, uint64_t ptotal_dynamic_instr_counter,
-    uint64_t preported_dynamic_instr_counter, uint64_t pstop_report, uint32_t line_num) {
+    int pred, uint32_t inst_id, uint32_t vpc, bool is_mem, uint64_t addr,
+    uint32_t skip_after, uint32_t cta_sample, uint64_t pchannel_dev,
+    uint64_t ptotal_dynamic_instr_counter,
+    uint64_t preported_dynamic_instr_counter, uint64_t pstop_report,
+    uint64_t ploop_state) {
 
   const int active_mask = __ballot_sync(__activemask(), 1);
   const int predicate_mask = __ballot_sync(__activemask(), pred);
@@ -36,38 +44,79 @@ extern "C" __device__ __noinline__ void instrument_inst(
     }
   }
 
+  int4 cta = get_ctaid();
+  if (cta_sample > 1 &&
+      (cta.x + gridDim.x * (cta.y + gridDim.y * cta.z)) % cta_sample) {
+    if (first_laneid == laneid)
+      atomicAdd((unsigned long long *)ptotal_dynamic_instr_counter, 1);
+    return;
+  }
+
+  int uniqe_threadId = threadIdx.z * blockDim.y * blockDim.x +
+                       threadIdx.y * blockDim.x + threadIdx.x;
+  const int warpid_tb = uniqe_threadId / 32;
+
+  if (ploop_state) {
+    bool skip = false;
+    if (first_laneid == laneid) {
+      loop_state_t &state =
+          ((loop_state_t *)ploop_state)[(get_smid() * 64 + get_warpid()) %
+                                        LOOP_STATE_SLOTS];
+      uint64_t warp = ((uint64_t)cta.x << 32 | (uint64_t)cta.y << 16 |
+                       (uint64_t)cta.z << 8 | warpid_tb) + 1;
+      if (state.warp != warp) {
+        state.warp = warp;
+        state.iters = 0;
+      } else if (vpc <= state.last_vpc) {
+        state.iters++;
+      }
+      state.last_vpc = vpc;
+      skip = skip_after && state.iters >= skip_after;
+    }
+    if (__shfl_sync(active_mask, skip, first_laneid)) {
+      if (first_laneid == laneid)
+        atomicAdd((unsigned long long *)ptotal_dynamic_instr_counter, 1);
+      return;
+    }
+  }
+
   inst_trace_t ma;
 
   if (is_mem) {
-    /* collect memory address information */
-    for (int i = 0; i < 32; i++) {
-      ma.addrs[i] = __shfl_sync(active_mask, addr, i);
+    /* one stride from the first lane of the mask to every other one */
+    const uint32_t mask = active_mask & predicate_mask;
+    const int first = __ffs(mask) - 1;
+    const int second = __ffs(mask & (mask - 1)) - 1;
+    const uint64_t base =
+        __shfl_sync(active_mask, addr, first >= 0 ? first : first_laneid);
+    const uint64_t next =
+        __shfl_sync(active_mask, addr, second >= 0 ? second : first_laneid);
+    const int64_t stride =
+        second >= 0 ? (int64_t)(next - base) / (second - first) : 0;
+    const bool on_stride = !((mask >> laneid) & 1) ||
+                           addr == base + (int64_t)(laneid - first) * stride;
+    if (__all_sync(active_mask, on_stride)) {
+      ma.addr_format = RECORD_AFFINE;
+      ma.addrs[0] = first >= 0 ? base : 0;
+      ma.addrs[1] = stride;
+    } else {
+      /* collect memory address information */
+      for (int i = 0; i < 32; i++) {
+        ma.addrs[i] = __shfl_sync(active_mask, addr, i);
+      }
+      ma.addr_format = RECORD_ALL_ADDRS;
     }
-    ma.width = width;
-    ma.is_mem = true;
   } else {
-    ma.is_mem = false;
+    ma.addr_format = RECORD_NO_ADDRS;
   }
 
-  int4 cta = get_ctaid();
-  int uniqe_threadId = threadIdx.z * blockDim.y * blockDim.x +
-                       threadIdx.y * blockDim.x + threadIdx.x;
-  ma.line_num = line_num;
-  ma.warpid_tb = uniqe_threadId / 32;
+  ma.warpid_tb = warpid_tb;
 
   ma.cta_id_x = cta.x;
   ma.cta_id_y = cta.y;
   ma.cta_id_z = cta.z;
   ma.warpid_sm = get_warpid();
-  ma.opcode_id = opcode_id;
-  ma.vpc = vpc;
-  ma.GPRDst = desReg;
-  ma.GPRSrcs[0] = srcReg1;
-  ma.GPRSrcs[1] = srcReg2;
-  ma.GPRSrcs[2] = srcReg3;
-  ma.GPRSrcs[3] = srcReg4;
-  ma.GPRSrcs[4] = srcReg5;
-  ma.numSrcs = srcNum;
+  ma.inst_id = inst_id;
   ma.active_mask = active_mask;
   ma.predicate_mask = predicate_mask;
   ma.sm_id = get_smid();
@@ -75,7 +124,7 @@ extern "C" __device__ __noinline__ void instrument_inst(
   /* first active lane pushes information on the channel */
   if (first_laneid == laneid) {
     ChannelDev *channel_dev = (ChannelDev *)pchannel_dev;
-    channel_dev->push(&ma, sizeof(inst_trace_t));
+    channel_dev->push(&ma, record_size(ma.addr_format));
     atomicAdd((unsigned long long *)ptotal_dynamic_instr_counter, 1);
     atomicAdd((unsigned long long *)preported_dynamic_instr_counter, 1);
   }
@@ -0,0 +1,306 @@
+/* One traced warp instruction as the tracer writes it, shared by the
+ * receiving thread of tracer_tool and post-traces-processing.
+ *
+ * The receiving thread turns every inst_trace_t of the channel into a
+ * trace_record (address compression included) and either formats it as the
+ * text trace line or, with TOOL_BINARY_TRACE=1, encodes it into
+ * kernel-<n>.trace.bin. Both go through large buffered writes.
+ * post-traces-processing decodes the binary records back into the same
+ * text lines, so the .traceg files do not depend on the mode.
+ *
+ * Binary file layout (little endian):
+ *   magic[8] "ACSIMNVR", u32 version, u32 flags (TRACE_RECORD_*)
+ *   records, each starting with a u8 type:
+ *   TRACE_RECORD_OPCODE: u16 opcode id, u16 length, name bytes; written the
+ *     first time an opcode id shows up in the file
+ *   TRACE_RECORD_INST: i32 cta x, y, z, i32 warpid_tb,
+ *     [i32 sm_id, i32 warpid_sm if TRACE_RECORD_CORE_ID],
+ *     [u32 line_num if TRACE_RECORD_LINEINFO], u32 vpc, u32 mask,
+ *     i16 dst (-1 for none), u16 opcode id, u8 src count, i16 srcs,
+ *     u8 is_mem, and for memory instructions u8 mem width, u8 address
+ *     format followed by
+ *       list_all:    u8 count, u64 addresses
+ *       base_stride: u64 base, i32 stride
+ *       base_delta:  u64 base, u8 count, i64 deltas
+ */
+
+#ifndef TRACE_RECORD_H
+#define TRACE_RECORD_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define TRACE_RECORD_MAGIC "ACSIMNVR"
+#define TRACE_RECORD_MAGIC_SIZE 8
+#define TRACE_RECORD_VERSION 1
+
+#define TRACE_RECORD_CORE_ID 0x1
+#define TRACE_RECORD_LINEINFO 0x2
+
+#define TRACE_RECORD_OPCODE 0
+#define TRACE_RECORD_INST 1
+
+#define TRACE_RECORD_MAX_SRCS 8
+/* bounds on one encoded record and one formatted text line */
+#define TRACE_RECORD_MAX_SIZE 512
+#define TRACE_RECORD_MAX_TEXT 1024
+
+/* the address_format values of the tracer, named apart from the trace
+ * parser's enum so post-traces-processing can include both */
+#define TRACE_ADDR_LIST_ALL 0
+#define TRACE_ADDR_BASE_STRIDE 1
+#define TRACE_ADDR_BASE_DELTA 2
+
+struct trace_record {
+  int cta_id_x, cta_id_y, cta_id_z;
+  int warpid_tb;
+  int sm_id, warpid_sm;
+  uint32_t line_num;
+  uint32_t vpc;
+  uint32_t mask;
+  int dst;
+  unsigned opcode_id;
+  unsigned num_srcs;
+  int srcs[TRACE_RECORD_MAX_SRCS];
+  bool is_mem;
+  unsigned mem_width;
+  unsigned addr_format;
+  uint64_t base_addr;
+  int stride;
+  /* list_all addresses or base_delta deltas */
+  unsigned num_addrs;
+  uint64_t addrs[32];
+};
+
+/* text formatting, the same characters the fprintf chain produced */
+
+static inline void trace_put_dec(char *&p, long long v) {
+  char tmp[24];
+  unsigned n = 0;
+  unsigned long long u = v < 0 ? 0ull - (unsigned long long)v : v;
+  do {
+    tmp[n++] = '0' + u % 10;
+    u /= 10;
+  } while (u);
+  if (v < 0)
+    *p++ = '-';
+  while (n)
+    *p++ = tmp[--n];
+}
+
+static inline void trace_put_hex(char *&p, uint64_t v, unsigned min_digits) {
+  static const char digits[] = "0123456789abcdef";
+  char tmp[16];
+  unsigned n = 0;
+  do {
+    tmp[n++] = digits[v & 0xf];
+    v >>= 4;
+  } while (v);
+  while (n < min_digits)
+    tmp[n++] = '0';
+  while (n)
+    *p++ = tmp[--n];
+}
+
+/* the trace line of r with its newline into out, at most
+ * TRACE_RECORD_MAX_TEXT characters; returns the length */
+static inline unsigned format_trace_record(const trace_record &r,
+                                           const char *opcode, unsigned flags,
+                                           char *out) {
+  char *p = out;
+  trace_put_dec(p, r.cta_id_x);
+  *p++ = ' ';
+  trace_put_dec(p, r.cta_id_y);
+  *p++ = ' ';
+  trace_put_dec(p, r.cta_id_z);
+  *p++ = ' ';
+  trace_put_dec(p, r.warpid_tb);
+  *p++ = ' ';
+  if (flags & TRACE_RECORD_CORE_ID) {
+    trace_put_dec(p, r.sm_id);
+    *p++ = ' ';
+    trace_put_dec(p, r.warpid_sm);
+    *p++ = ' ';
+  }
+  if (flags & TRACE_RECORD_LINEINFO) {
+    trace_put_dec(p, (int)r.line_num);
+    *p++ = ' ';
+  }
+  trace_put_hex(p, r.vpc, 4);
+  *p++ = ' ';
+  trace_put_hex(p, r.mask, 8);
+  *p++ = ' ';
+  if (r.dst >= 0) {
+    *p++ = '1';
+    *p++ = ' ';
+    *p++ = 'R';
+    trace_put_dec(p, r.dst);
+  } else {
+    *p++ = '0';
+  }
+  *p++ = ' ';
+  size_t len = strlen(opcode);
+  if (len > 256)
+    len = 256;
+  memcpy(p, opcode, len);
+  p += len;
+  *p++ = ' ';
+  trace_put_dec(p, r.num_srcs);
+  *p++ = ' ';
+  for (unsigned s = 0; s < r.num_srcs; s++) {
+    *p++ = 'R';
+    trace_put_dec(p, r.srcs[s]);
+    *p++ = ' ';
+  }
+  if (r.is_mem) {
+    trace_put_dec(p, r.mem_width);
+    *p++ = ' ';
+    trace_put_dec(p, r.addr_format);
+    *p++ = ' ';
+    if (r.addr_format == TRACE_ADDR_BASE_STRIDE) {
+      *p++ = '0';
+      *p++ = 'x';
+      trace_put_hex(p, r.base_addr, 1);
+      *p++ = ' ';
+      trace_put_dec(p, r.stride);
+      *p++ = ' ';
+    } else if (r.addr_format == TRACE_ADDR_BASE_DELTA) {
+      *p++ = '0';
+      *p++ = 'x';
+      trace_put_hex(p, r.base_addr, 1);
+      *p++ = ' ';
+      for (unsigned s = 0; s < r.num_addrs; s++) {
+        trace_put_dec(p, (long long)r.addrs[s]);
+        *p++ = ' ';
+      }
+    } else {
+      for (unsigned s = 0; s < r.num_addrs; s++) {
+        *p++ = '0';
+        *p++ = 'x';
+        trace_put_hex(p, r.addrs[s], 16);
+        *p++ = ' ';
+      }
+    }
+  } else {
+    *p++ = '0';
+    *p++ = ' ';
+  }
+  *p++ = '\n';
+  return p - out;
+}
+
+/* binary encoding */
+
+template <typename T> static inline void trace_put(char *&p, T v) {
+  memcpy(p, &v, sizeof(T));
+  p += sizeof(T);
+}
+
+template <typename T> static inline T trace_get(const char *&p) {
+  T v;
+  memcpy(&v, p, sizeof(T));
+  p += sizeof(T);
+  return v;
+}
+
+static inline unsigned encode_trace_opcode(unsigned opcode_id,
+                                           const char *opcode, char *out) {
+  char *p = out;
+  size_t len = strlen(opcode);
+  if (len > 256)
+    len = 256;
+  trace_put<uint8_t>(p, TRACE_RECORD_OPCODE);
+  trace_put<uint16_t>(p, opcode_id);
+  trace_put<uint16_t>(p, len);
+  memcpy(p, opcode, len);
+  p += len;
+  return p - out;
+}
+
+/* at most TRACE_RECORD_MAX_SIZE bytes */
+static inline unsigned encode_trace_record(const trace_record &r,
+                                           unsigned flags, char *out) {
+  char *p = out;
+  trace_put<uint8_t>(p, TRACE_RECORD_INST);
+  trace_put<int32_t>(p, r.cta_id_x);
+  trace_put<int32_t>(p, r.cta_id_y);
+  trace_put<int32_t>(p, r.cta_id_z);
+  trace_put<int32_t>(p, r.warpid_tb);
+  if (flags & TRACE_RECORD_CORE_ID) {
+    trace_put<int32_t>(p, r.sm_id);
+    trace_put<int32_t>(p, r.warpid_sm);
+  }
+  if (flags & TRACE_RECORD_LINEINFO)
+    trace_put<uint32_t>(p, r.line_num);
+  trace_put<uint32_t>(p, r.vpc);
+  trace_put<uint32_t>(p, r.mask);
+  trace_put<int16_t>(p, r.dst);
+  trace_put<uint16_t>(p, r.opcode_id);
+  trace_put<uint8_t>(p, r.num_srcs);
+  for (unsigned s = 0; s < r.num_srcs; s++)
+    trace_put<int16_t>(p, r.srcs[s]);
+  trace_put<uint8_t>(p, r.is_mem);
+  if (r.is_mem) {
+    trace_put<uint8_t>(p, r.mem_width);
+    trace_put<uint8_t>(p, r.addr_format);
+    if (r.addr_format == TRACE_ADDR_BASE_STRIDE) {
+      trace_put<uint64_t>(p, r.base_addr);
+      trace_put<int32_t>(p, r.stride);
+    } else {
+      if (r.addr_format == TRACE_ADDR_BASE_DELTA)
+        trace_put<uint64_t>(p, r.base_addr);
+      trace_put<uint8_t>(p, r.num_addrs);
+      for (unsigned s = 0; s < r.num_addrs; s++)
+        trace_put<uint64_t>(p, r.addrs[s]);
+    }
+  }
+  return p - out;
+}
+
+/* decode the instruction record after its type byte */
+static inline void decode_trace_record(const char *&p, unsigned flags,
+                                       trace_record &r) {
+  r.cta_id_x = trace_get<int32_t>(p);
+  r.cta_id_y = trace_get<int32_t>(p);
+  r.cta_id_z = trace_get<int32_t>(p);
+  r.warpid_tb = trace_get<int32_t>(p);
+  r.sm_id = r.warpid_sm = 0;
+  if (flags & TRACE_RECORD_CORE_ID) {
+    r.sm_id = trace_get<int32_t>(p);
+    r.warpid_sm = trace_get<int32_t>(p);
+  }
+  r.line_num = flags & TRACE_RECORD_LINEINFO ? trace_get<uint32_t>(p) : 0;
+  r.vpc = trace_get<uint32_t>(p);
+  r.mask = trace_get<uint32_t>(p);
+  r.dst = trace_get<int16_t>(p);
+  r.opcode_id = trace_get<uint16_t>(p);
+  r.num_srcs = trace_get<uint8_t>(p);
+  if (r.num_srcs > TRACE_RECORD_MAX_SRCS)
+    r.num_srcs = TRACE_RECORD_MAX_SRCS;
+  for (unsigned s = 0; s < r.num_srcs; s++)
+    r.srcs[s] = trace_get<int16_t>(p);
+  r.is_mem = trace_get<uint8_t>(p);
+  r.mem_width = 0;
+  r.addr_format = TRACE_ADDR_LIST_ALL;
+  r.base_addr = 0;
+  r.stride = 0;
+  r.num_addrs = 0;
+  if (r.is_mem) {
+    r.mem_width = trace_get<uint8_t>(p);
+    r.addr_format = trace_get<uint8_t>(p);
+    if (r.addr_format == TRACE_ADDR_BASE_STRIDE) {
+      r.base_addr = trace_get<uint64_t>(p);
+      r.stride = trace_get<int32_t>(p);
+    } else {
+      if (r.addr_format == TRACE_ADDR_BASE_DELTA)
+        r.base_addr = trace_get<uint64_t>(p);
+      r.num_addrs = trace_get<uint8_t>(p);
+      if (r.num_addrs > 32)
+        r.num_addrs = 32;
+      for (unsigned s = 0; s < r.num_addrs; s++)
+        r.addrs[s] = trace_get<uint64_t>(p);
+    }
+  }
+}
+
+#endif
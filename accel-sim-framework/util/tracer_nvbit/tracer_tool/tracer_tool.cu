@@ -28,6 +28,9 @@
 /* contains definition of the inst_trace_t structure */
 #include "common.h"
 
+/* trace_record, its text and binary encodings */
+#include "trace_record.h"
+
 #define TRACER_VERSION "4"
 
 /* Channel used to communicate from GPU to CPU receiving thread */
@@ -53,6 +56,9 @@ int print_core_id = 0;
 int exclude_pred_off = 1;
 int active_from_start = 1;
 int lineinfo = 0;
+int binary_trace = 0;
+int loop_iters = 0;
+int cta_sample = 1;
 /* used to select region of interest when active from start is 0 */
 bool active_region = true;
 
@@ -64,6 +70,13 @@ int user_defined_folders = 0;
 std::map<std::string, int> opcode_to_id_map;
 std::map<int, std::string> id_to_opcode_map;
 
+/* the static fields of the instrumented instructions, by the inst_id of
+ * their records; only grown at a launch, while the receiving thread waits */
+std::vector<static_inst_t> static_insts;
+
+/* the iterations of the warps with TOOL_LOOP_ITERS, cleared every launch */
+static __managed__ loop_state_t loop_state[LOOP_STATE_SLOTS];
+
 std::string cwd = getcwd(NULL,0);
 std::string traces_location = cwd + "/traces/";
 std::string kernelslist_location = cwd + "/traces/kernelslist";
@@ -99,6 +112,14 @@ void nvbit_at_init() {
          "and cuProfilerStop. If set to 0, DYNAMIC_KERNEL_LIMIT options have no effect");
   GET_VAR_INT(verbose, "TOOL_VERBOSE", 0, "Enable verbosity inside the tool");
   GET_VAR_INT(enable_compress, "TOOL_COMPRESS", 1, "Enable traces compression");
+  GET_VAR_INT(binary_trace, "TOOL_BINARY_TRACE", 0,
+              "Write the instructions as binary records to kernel-<n>.trace.bin, "
+              "post-traces-processing turns them into the usual .traceg");
+  GET_VAR_INT(loop_iters, "TOOL_LOOP_ITERS", 0,
+              "Stop tracing the non-memory, non-control instructions of a warp "
+              "after it ran this many loop iterations, 0 traces all");
+  GET_VAR_INT(cta_sample, "TOOL_CTA_SAMPLE", 1,
+              "Trace only every n-th thread block of a kernel");
   GET_VAR_INT(print_core_id, "TOOL_TRACE_CORE", 0,
               "write the core id in the traces");
   GET_VAR_INT(terminate_after_limit_number_of_kernels_reached, "TERMINATE_UPON_LIMIT", 0, 
@@ -111,6 +132,27 @@ void nvbit_at_init() {
   if (active_from_start == 0) {
     active_region = false;
   }
+  if (cta_sample < 1)
+    cta_sample = 1;
+}
+
+/* whether a warp may leave the instruction out of its trace after
+ * TOOL_LOOP_ITERS iterations: not the ones that move data, change the
+ * control flow or synchronize, which the simulator needs every time */
+static bool loop_skippable(Instr *instr, bool is_mem) {
+  static const char *kept[] = {
+      "EXIT", "BAR",  "BRA",   "BRX",   "JMP",      "JMX",   "CALL",
+      "RET",  "BSSY", "BSYNC", "BREAK", "WARPSYNC", "YIELD", "BPT",
+      "KILL", "SSY",  "SYNC",  "PBK",   "BRK",      "CONT",  "PCNT",
+      "PRET", "MEMBAR", "ERRBAR", "DEPBAR", "NANOSLEEP", "LDC", "ULDC",
+      "S2R",  "CS2R", "VOTE",  "READ"};
+  if (is_mem)
+    return false;
+  std::string opcode = instr->getOpcodeShort();
+  for (const char *k : kept)
+    if (opcode == k)
+      return false;
+  return true;
 }
 
 /* Set used to avoid re-instrumenting the same functions multiple times */
@@ -200,6 +242,21 @@ void instrument_function_if_needed(CUcontext ctx, CUfunction func) {
         }
       }
 
+      /* the opcode, pc, registers and line go to the static instruction
+       * table, the records only name it */
+      static_inst_t si;
+      si.opcode_id = opcode_id;
+      si.line_num = line_num;
+      si.vpc = instr->getOffset();
+      si.is_mem = mem_oper_idx >= 0;
+      si.GPRDst = dst_oprd;
+      for (int i = 0; i < MAX_SRC; i++)
+        si.GPRSrcs[i] = i < srcNum ? src_oprd[i] : -1;
+      const uint32_t inst_id = static_insts.size();
+      static_insts.push_back(si);
+      const uint32_t skip_after =
+          loop_skippable(instr, si.is_mem) ? loop_iters : 0;
+
       do{
         /* insert call to the instrumentation function with its
         * arguments */
@@ -208,8 +265,8 @@ void instrument_function_if_needed(CUcontext ctx, CUfunction func) {
         /* pass predicate value */
         nvbit_add_call_arg_guard_pred_val(instr);
 
-        /* send opcode and pc */
-        nvbit_add_call_arg_const_val32(instr, opcode_id);
+        /* send the static instruction and pc */
+        nvbit_add_call_arg_const_val32(instr, inst_id);
         nvbit_add_call_arg_const_val32(instr, (int)instr->getOffset());
 
         /* mem addresses info */
@@ -222,22 +279,14 @@ void instrument_function_if_needed(CUcontext ctx, CUfunction func) {
           else {
             nvbit_add_call_arg_mref_addr64(instr, mem_oper_idx);
           }
-          nvbit_add_call_arg_const_val32(instr, (int)instr->getSize());
         } else {
           nvbit_add_call_arg_const_val32(instr, 0);
           nvbit_add_call_arg_const_val64(instr, -1);
-          nvbit_add_call_arg_const_val32(instr, -1);
         }
 
-        /* reg info */
-        nvbit_add_call_arg_const_val32(instr, dst_oprd);
-        for (int i = 0; i < srcNum; i++) {
-          nvbit_add_call_arg_const_val32(instr, src_oprd[i]);
-        }
-        for (int i = srcNum; i < MAX_SRC; i++) {
-          nvbit_add_call_arg_const_val32(instr, -1);
-        }
-        nvbit_add_call_arg_const_val32(instr, srcNum);
+        /* device side filtering */
+        nvbit_add_call_arg_const_val32(instr, skip_after);
+        nvbit_add_call_arg_const_val32(instr, cta_sample);
         /* add pointer to channel_dev and other counters*/
         nvbit_add_call_arg_const_val64(instr, (uint64_t)&channel_dev);
         nvbit_add_call_arg_const_val64(instr,
@@ -245,8 +294,8 @@ void instrument_function_if_needed(CUcontext ctx, CUfunction func) {
         nvbit_add_call_arg_const_val64(instr,
                                       (uint64_t)&reported_dynamic_instr_counter);
         nvbit_add_call_arg_const_val64(instr, (uint64_t)&stop_report);
-        /* Add Source code line number for current instr */
-        nvbit_add_call_arg_const_val32(instr, (int)line_num);
+        nvbit_add_call_arg_const_val64(
+            instr, loop_iters ? (uint64_t)loop_state : 0);
 
         mem_oper_idx--;
       } while (mem_oper_idx >= 0);
@@ -261,13 +310,18 @@ __global__ void flush_channel() {
    * completed */
   inst_trace_t ma;
   ma.cta_id_x = -1;
-  channel_dev.push(&ma, sizeof(inst_trace_t));
+  ma.addr_format = RECORD_NO_ADDRS;
+  channel_dev.push(&ma, record_size(ma.addr_format));
 
   /* flush channel */
   channel_dev.flush();
 }
 
 static FILE *resultsFile = NULL;
+/* the instructions of the kernel, resultsFile itself or the binary records */
+static FILE *instsFile = NULL;
+/* bumped for every instsFile, tells the receiving thread a new file began */
+static volatile unsigned instsFileSerial = 0;
 static FILE *kernelsFile = NULL;
 static FILE *statsFile = NULL;
 static int kernelid = 1;
@@ -370,6 +424,8 @@ void nvbit_at_cuda_event(CUcontext ctx, int is_exit, nvbit_api_cuda_t cbid,
       if (active_region) {
         nvbit_enable_instrumented(ctx, p->f, true);
         stop_report = false;
+        if (loop_iters)
+          memset(loop_state, 0, sizeof(loop_state));
       } else {
         nvbit_enable_instrumented(ctx, p->f, false);
         stop_report = true;
@@ -402,6 +458,29 @@ void nvbit_at_cuda_event(CUcontext ctx, int is_exit, nvbit_api_cuda_t cbid,
         fprintf(resultsFile, "-nvbit version = %s\n", NVBIT_VERSION);
         fprintf(resultsFile, "-accelsim tracer version = %s\n", TRACER_VERSION);
         fprintf(resultsFile,  "-enable lineinfo = %d\n", lineinfo);
+        if (cta_sample > 1)
+          fprintf(resultsFile, "-cta sample = %d\n", cta_sample);
+        if (loop_iters)
+          fprintf(resultsFile, "-loop iterations = %d\n", loop_iters);
+
+        instsFile = resultsFile;
+        instsFileSerial++;
+        if (binary_trace) {
+          std::string records = std::string(buffer) + ".bin";
+          instsFile = fopen(records.c_str(), "w");
+          if (!instsFile) {
+            printf("cannot write %s\n", records.c_str());
+            exit(1);
+          }
+          uint32_t version = TRACE_RECORD_VERSION;
+          uint32_t flags = (print_core_id ? TRACE_RECORD_CORE_ID : 0) |
+                           (lineinfo ? TRACE_RECORD_LINEINFO : 0);
+          fwrite(TRACE_RECORD_MAGIC, 1, TRACE_RECORD_MAGIC_SIZE, instsFile);
+          fwrite(&version, sizeof(version), 1, instsFile);
+          fwrite(&flags, sizeof(flags), 1, instsFile);
+          fprintf(resultsFile, "-trace records = kernel-%d.trace.bin\n",
+                  kernelid);
+        }
         fprintf(resultsFile, "\n");
 
         fprintf(resultsFile,
@@ -471,8 +550,12 @@ void nvbit_at_cuda_event(CUcontext ctx, int is_exit, nvbit_api_cuda_t cbid,
       fprintf(statsFile, "\n");
       fclose(statsFile);
 
-      if (!stop_report)
+      if (!stop_report) {
+        if (instsFile != resultsFile)
+          fclose(instsFile);
         fclose(resultsFile);
+        instsFile = NULL;
+      }
 
       if (active_from_start && dynamic_kernel_limit_end && kernelid > dynamic_kernel_limit_end)
         active_region = false;
@@ -576,110 +659,168 @@ void base_delta_compress(const uint64_t *addrs, const std::bitset<32> &mask,
   }
 }
 
+/* output of the receiving thread, written with one fwrite per
+ * OUT_BUFFER_SIZE bytes instead of one fprintf per field */
+#define OUT_BUFFER_SIZE (16l << 20)
+
+static void flush_out_buffer(char *out_buffer, size_t &out_size) {
+  if (out_size && instsFile)
+    fwrite(out_buffer, 1, out_size, instsFile);
+  out_size = 0;
+}
+
+/* the name and memory data width of an opcode id, looked up and split
+ * once per opcode instead of once per traced instruction */
+struct opcode_info {
+  std::string name;
+  unsigned datawidth;
+  bool written; /* opcode record in the current binary file */
+};
+
+static opcode_info &get_opcode_info(std::vector<opcode_info> &infos,
+                                    int opcode_id) {
+  if (opcode_id >= (int)infos.size())
+    infos.resize(opcode_id + 1);
+  opcode_info &info = infos[opcode_id];
+  if (info.name.empty()) {
+    info.name = id_to_opcode_map[opcode_id];
+    std::istringstream iss(info.name);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (std::getline(iss, token, '.')) {
+      if (!token.empty())
+        tokens.push_back(token);
+    }
+    info.datawidth = get_datawidth_from_opcode(tokens);
+    info.written = false;
+  }
+  return info;
+}
+
 void *recv_thread_fun(void *) {
   char *recv_buffer = (char *)malloc(CHANNEL_SIZE);
+  char *out_buffer = (char *)malloc(OUT_BUFFER_SIZE);
+  size_t out_size = 0;
+  std::vector<opcode_info> opcodes;
+  unsigned opcodes_file = 0; /* the instsFile the written flags refer to */
+  const unsigned flags = (print_core_id ? TRACE_RECORD_CORE_ID : 0) |
+                         (lineinfo ? TRACE_RECORD_LINEINFO : 0);
+  trace_record r;
+  uint64_t affine_addrs[32];
   while (recv_thread_started) {
     uint32_t num_recv_bytes = 0;
     if (recv_thread_receiving &&
         (num_recv_bytes = channel_host.recv(recv_buffer, CHANNEL_SIZE)) > 0) {
       uint32_t num_processed_bytes = 0;
+      if (binary_trace && opcodes_file != instsFileSerial) {
+        for (unsigned i = 0; i < opcodes.size(); i++)
+          opcodes[i].written = false;
+        opcodes_file = instsFileSerial;
+      }
       while (num_processed_bytes < num_recv_bytes) {
         inst_trace_t *ma = (inst_trace_t *)&recv_buffer[num_processed_bytes];
+        const uint32_t ma_size = record_size(ma->addr_format);
 
         /* when we get this cta_id_x it means the kernel has completed
          */
         if (ma->cta_id_x == -1) {
+          flush_out_buffer(out_buffer, out_size);
           recv_thread_receiving = false;
           break;
         }
 
-        fprintf(resultsFile, "%d ", ma->cta_id_x);
-        fprintf(resultsFile, "%d ", ma->cta_id_y);
-        fprintf(resultsFile, "%d ", ma->cta_id_z);
-        fprintf(resultsFile, "%d ", ma->warpid_tb);
-        if (print_core_id) {
-          fprintf(resultsFile, "%d ", ma->sm_id);
-          fprintf(resultsFile, "%d ", ma->warpid_sm);
-        }
-        if(lineinfo){
-          fprintf(resultsFile, "%d ", ma->line_num);
-        }
-        fprintf(resultsFile, "%04x ", ma->vpc); // Print the virtual PC
-        fprintf(resultsFile, "%08x ", ma->active_mask & ma->predicate_mask);
-        if (ma->GPRDst >= 0) {
-          fprintf(resultsFile, "1 ");
-          fprintf(resultsFile, "R%d ", ma->GPRDst);
-        } else
-          fprintf(resultsFile, "0 ");
-
-        // Print the opcode.
-        fprintf(resultsFile, "%s ", id_to_opcode_map[ma->opcode_id].c_str());
-        unsigned src_count = 0;
-        for (int s = 0; s < MAX_SRC; s++) // GPR srcs count.
-          if (ma->GPRSrcs[s] >= 0)
-            src_count++;
-        fprintf(resultsFile, "%d ", src_count);
-
+        if (out_size + TRACE_RECORD_MAX_TEXT + TRACE_RECORD_MAX_SIZE >
+            OUT_BUFFER_SIZE)
+          flush_out_buffer(out_buffer, out_size);
+
+        const static_inst_t &si = static_insts[ma->inst_id];
+        opcode_info &opcode = get_opcode_info(opcodes, si.opcode_id);
+
+        r.cta_id_x = ma->cta_id_x;
+        r.cta_id_y = ma->cta_id_y;
+        r.cta_id_z = ma->cta_id_z;
+        r.warpid_tb = ma->warpid_tb;
+        r.sm_id = ma->sm_id;
+        r.warpid_sm = ma->warpid_sm;
+        r.line_num = si.line_num;
+        r.vpc = si.vpc;
+        r.mask = ma->active_mask & ma->predicate_mask;
+        r.dst = si.GPRDst;
+        r.opcode_id = si.opcode_id;
+        r.num_srcs = 0;
         for (int s = 0; s < MAX_SRC; s++) // GPR srcs.
-          if (ma->GPRSrcs[s] >= 0)
-            fprintf(resultsFile, "R%d ", ma->GPRSrcs[s]);
-
-        // print addresses
-        std::bitset<32> mask(ma->active_mask & ma->predicate_mask);
-        if (ma->is_mem) {
-          std::istringstream iss(id_to_opcode_map[ma->opcode_id]);
-          std::vector<std::string> tokens;
-          std::string token;
-          while (std::getline(iss, token, '.')) {
-            if (!token.empty())
-              tokens.push_back(token);
+          if (si.GPRSrcs[s] >= 0)
+            r.srcs[r.num_srcs++] = si.GPRSrcs[s];
+
+        // addresses
+        std::bitset<32> mask(r.mask);
+        r.is_mem = si.is_mem;
+        r.num_addrs = 0;
+        if (si.is_mem) {
+          const uint64_t *lane_addrs = ma->addrs;
+          if (ma->addr_format == RECORD_AFFINE) {
+            // the lanes of the mask from the base of the first on, the
+            // record itself ends after the stride
+            const uint64_t base = ma->addrs[0];
+            const int64_t stride = ma->addrs[1];
+            const int first = r.mask ? __builtin_ctz(r.mask) : 0;
+            for (int s = 0; s < 32; s++)
+              affine_addrs[s] = base + (int64_t)(s - first) * stride;
+            lane_addrs = affine_addrs;
           }
-          fprintf(resultsFile, "%d ", get_datawidth_from_opcode(tokens));
+          r.mem_width = opcode.datawidth;
 
           bool base_stride_success = false;
           uint64_t base_addr = 0;
           int stride = 0;
-          std::vector<long long> deltas;
 
           if (enable_compress) {
             // try base+stride format
             base_stride_success =
-                base_stride_compress(ma->addrs, mask, base_addr, stride);
-            if (!base_stride_success) {
-              // if base+stride fails, try base+delta format
-              base_delta_compress(ma->addrs, mask, base_addr, deltas);
-            }
+                base_stride_compress(lane_addrs, mask, base_addr, stride);
           }
 
           if (base_stride_success && enable_compress) {
             // base + stride format
-            fprintf(resultsFile, "%u 0x%llx %d ", address_format::base_stride,
-                    base_addr, stride);
+            r.addr_format = address_format::base_stride;
+            r.base_addr = base_addr;
+            r.stride = stride;
           } else if (!base_stride_success && enable_compress) {
-            // base + delta format
-            fprintf(resultsFile, "%u 0x%llx ", address_format::base_delta,
-                    base_addr);
-            for (int s = 0; s < deltas.size(); s++) {
-              fprintf(resultsFile, "%lld ", deltas[s]);
-            }
+            // if base+stride fails, base + delta format
+            std::vector<long long> deltas;
+            base_delta_compress(lane_addrs, mask, base_addr, deltas);
+            r.addr_format = address_format::base_delta;
+            r.base_addr = base_addr;
+            for (int s = 0; s < deltas.size(); s++)
+              r.addrs[r.num_addrs++] = deltas[s];
           } else {
             // list all the addresses
-            fprintf(resultsFile, "%u ", address_format::list_all);
+            r.addr_format = address_format::list_all;
             for (int s = 0; s < 32; s++) {
               if (mask.test(s))
-                fprintf(resultsFile, "0x%016lx ", ma->addrs[s]);
+                r.addrs[r.num_addrs++] = lane_addrs[s];
             }
           }
-        } else {
-          fprintf(resultsFile, "0 ");
         }
 
-        fprintf(resultsFile, "\n");
+        if (binary_trace) {
+          if (!opcode.written) {
+            out_size += encode_trace_opcode(si.opcode_id, opcode.name.c_str(),
+                                            out_buffer + out_size);
+            opcode.written = true;
+          }
+          out_size += encode_trace_record(r, flags, out_buffer + out_size);
+        } else {
+          out_size += format_trace_record(r, opcode.name.c_str(), flags,
+                                          out_buffer + out_size);
+        }
 
-        num_processed_bytes += sizeof(inst_trace_t);
+        num_processed_bytes += ma_size;
       }
     }
   }
+  flush_out_buffer(out_buffer, out_size);
+  free(out_buffer);
   free(recv_buffer);
   return NULL;
 }
@@ -1,200 +1,562 @@
-#include <fstream>
-#include <iostream>
-#include <math.h>
-#include <sstream>
-#include <stdio.h>
-#include <string>
-#include <vector>
-using namespace std;
-
-struct threadblock_info {
-  bool initialized;
-  unsigned tb_id_x, tb_id_y, tb_id_z;
-  vector<vector<string>> warp_insts_array;
-  threadblock_info() {
-    initialized = false;
-    tb_id_x = tb_id_y = tb_id_z = 0;
-  }
-};
-
-void group_per_block(const char *filepath);
-void group_per_core(const char *filepath);
-
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-int main(int argc, char **argv) {
-
-  string kernellist_filepath;
-  bool is_per_core;
-  if (argc == 1) {
-    cout << "File path is missing\n";
-    return 0;
-  } else if (argc == 2) {
-    kernellist_filepath = argv[1];
-    is_per_core = true;
-
-  } else if (argc == 3) {
-    kernellist_filepath = argv[1];
-    is_per_core = bool(argv[2]);
-  } else {
-    cout << "Too Many Arguemnts!\n";
-    return 0;
-  }
-
-  ifstream ifs;
-  ofstream ofs;
-
-  ifs.open(kernellist_filepath.c_str());
-  ofs.open((string(kernellist_filepath) + ".g").c_str());
-
-  if (!ifs.is_open()) {
-    cout << "Unable to open file: " << kernellist_filepath << endl;
-    return 0;
-  }
-
-  string directory(kernellist_filepath);
-  const size_t last_slash_idx = directory.rfind('/');
-  if (std::string::npos != last_slash_idx) {
-    directory = directory.substr(0, last_slash_idx);
-  }
-
-  string line;
-  string filepath;
-  while (!ifs.eof()) {
-    getline(ifs, line);
-    if (line.empty())
-      continue;
-    else if (line.substr(0, 6) == "Memcpy") {
-      ofs << line << endl;
-    } else if (line.substr(0, 6) == "kernel") {
-      filepath = directory + "/" + line;
-      group_per_block(filepath.c_str());
-      ofs << line + "g" << endl;
-    } else {
-      cout << "Undefined command: " << line << endl;
-      return 0;
-    }
-  }
-
-  ifs.close();
-  ofs.close();
-  return 0;
-}
-
-void group_per_block(const char *filepath) {
-
-  ofstream ofs;
-  ifstream ifs;
-
-  ifs.open(filepath);
-
-  if (!ifs.is_open()) {
-    cout << "Unable to open file: " << filepath << endl;
-    return;
-  }
-
-  cout << "Processing file " << filepath << endl;
-  ofs.open((string(filepath) + "g").c_str());
-
-  vector<threadblock_info> insts;
-  unsigned grid_dim_x, grid_dim_y, grid_dim_z, tb_dim_x, tb_dim_y, tb_dim_z;
-  unsigned tb_id_x, tb_id_y, tb_id_z, tb_id, warpid_tb;
-  unsigned lineinfo, linenum;
-  string line;
-  stringstream ss;
-  string string1, string2;
-  bool found_grid_dim = false, found_block_dim = false;
-
-  while (!ifs.eof()) {
-    getline(ifs, line);
-
-    if (line.length() == 0 || line[0] == '#') {
-      ofs << line << endl;
-      continue;
-    }
-
-    else if (line[0] == '-') {
-      ss.str(line);
-      ss.ignore();
-      ss >> string1 >> string2;
-      if (string1 == "grid" && string2 == "dim") {
-        sscanf(line.c_str(), "-grid dim = (%d,%d,%d)", &grid_dim_x, &grid_dim_y,
-               &grid_dim_z);
-        found_grid_dim = true;
-      } else if (string1 == "block" && string2 == "dim") {
-        sscanf(line.c_str(), "-block dim = (%d,%d,%d)", &tb_dim_x, &tb_dim_y,
-               &tb_dim_z);
-        found_block_dim = true;
-      } else if (string1 == "enable" && string2 == "lineinfo") {
-        sscanf(line.c_str(), "-enable lineinfo = %d", &lineinfo);
-      }
-
-      if (found_grid_dim && found_block_dim) {
-        insts.resize(grid_dim_x * grid_dim_y * grid_dim_z);
-        for (unsigned i = 0; i < insts.size(); ++i) {
-          insts[i].warp_insts_array.resize(
-              ceil(float(tb_dim_x * tb_dim_y * tb_dim_z) / 32));
-        }
-      }
-      ofs << line << endl;
-      continue;
-    } else {
-
-      ss.str(line);
-      ss >> tb_id_x >> tb_id_y >> tb_id_z >> warpid_tb;
-      tb_id =
-          tb_id_z * grid_dim_y * grid_dim_x + tb_id_y * grid_dim_x + tb_id_x;
-      if (!insts[tb_id].initialized) {
-        insts[tb_id].tb_id_x = tb_id_x;
-        insts[tb_id].tb_id_y = tb_id_y;
-        insts[tb_id].tb_id_z = tb_id_z;
-        insts[tb_id].initialized = true;
-      }
-	//ss.ignore(); //remove the space
-	//rest_of_line.clear();
-      // getline(ss, rest_of_line); //get rest of the string!
-	string rest_of_line(ss.str().substr(ss.tellg()+1));
-
-      insts[tb_id].warp_insts_array[warpid_tb].push_back(rest_of_line);
-    }
-  }
-
-  for (unsigned i = 0; i < insts.size(); ++i) {
-    // ofs<<string<<endl;
-    if (insts[i].initialized && insts[i].warp_insts_array.size() > 0) {
-      ofs << endl << "#BEGIN_TB" << endl;
-      ofs << endl
-          << "thread block = " << insts[i].tb_id_x << "," << insts[i].tb_id_y
-          << "," << insts[i].tb_id_z << endl;
-    } else {
-      cout << "Warning: Thread block " << insts[i].tb_id_x << ","
-           << insts[i].tb_id_y << "," << insts[i].tb_id_z << " is empty"
-           << endl;
-      continue;
-      // ofs.close();
-      // return;
-    }
-    for (unsigned j = 0; j < insts[i].warp_insts_array.size(); ++j) {
-      ofs << endl << "warp = " << j << endl;
-      ofs << "insts = " << insts[i].warp_insts_array[j].size() << endl;
-      if (insts[i].warp_insts_array[j].size() == 0) {
-        cout << "Warning: Warp " << j << " in thread block" << insts[i].tb_id_x
-             << "," << insts[i].tb_id_y << "," << insts[i].tb_id_z
-             << " is empty" << endl;
-        //	ofs.close();
-        //	return;
-      }
-      for (unsigned k = 0; k < insts[i].warp_insts_array[j].size(); ++k) {
-        ofs << insts[i].warp_insts_array[j][k] << endl;
-      }
-    }
-    ofs << endl << "#END_TB" << endl;
-  }
-
-  ofs.close();
-  ifs.close();
-}
-
-void group_per_core(const char *filepath) {
-
-  // TO DO
-}
+// Groups the instructions of the raw tracer output per thread block and warp
+//
+// usage: post-traces-processing <kernelslist> [-j jobs] [-m memory_mb]
+//                               [-binary]
+//
+// Every kernel-<n>.trace of the kernelslist becomes a kernel-<n>.traceg, and
+// kernelslist.g lists them. The kernels are processed by up to -j jobs in
+// parallel (default: one per core). A kernel is read in two passes so its
+// trace is never held in memory as a whole: the first pass counts the
+// instructions and text bytes of every thread block and warp, the second
+// collects the lines of as many consecutive thread blocks as fit into the
+// job's share of -m (default 4096 MB) and writes them out, reading the trace
+// again for every further range of thread blocks. The instructions are text
+// lines or, for TOOL_BINARY_TRACE, the binary records of kernel-<n>.trace.bin.
+// With -binary (built with make BINARY=1) the .traceg is written as the
+// accel-sim binary trace container instead of text.
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <math.h>
+#include <mutex>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../trace_record.h"
+#ifdef POST_TRACES_BINARY
+#include "trace_binary.h"
+#endif
+using namespace std;
+
+struct threadblock_info {
+  bool initialized;
+  unsigned tb_id_x, tb_id_y, tb_id_z;
+  uint64_t bytes; // text size of the instructions
+  vector<unsigned> warp_insts;
+  vector<string> warp_lines; // only while the thread block is collected
+  threadblock_info() {
+    initialized = false;
+    tb_id_x = tb_id_y = tb_id_z = 0;
+    bytes = 0;
+  }
+};
+
+struct options {
+  unsigned jobs;
+  uint64_t memory;
+  bool binary;
+};
+
+static mutex cout_lock;
+
+void group_per_block(const char *filepath, uint64_t memory, bool binary);
+void group_per_core(const char *filepath);
+
+// instructions of a kernel trace, front to back
+class trace_source {
+public:
+  enum item { END, INST, OTHER };
+  virtual ~trace_source() {}
+  virtual bool rewind() = 0;
+  // the next instruction, with the text after its thread block and warp id
+  // in rest; OTHER for a comment or header line in between, found in line
+  virtual item next(unsigned &tb_x, unsigned &tb_y, unsigned &tb_z,
+                    unsigned &warp, const char *&rest, size_t &rest_len) = 0;
+  string line;
+};
+
+// the text lines following the header of kernel-<n>.trace
+class text_trace_source : public trace_source {
+public:
+  text_trace_source(const string &filepath, streampos first_inst)
+      : m_filepath(filepath), m_first_inst(first_inst) {}
+
+  bool rewind() {
+    m_ifs.close();
+    m_ifs.clear();
+    m_ifs.open(m_filepath.c_str());
+    if (!m_ifs.is_open())
+      return false;
+    m_ifs.seekg(m_first_inst);
+    return true;
+  }
+
+  item next(unsigned &tb_x, unsigned &tb_y, unsigned &tb_z, unsigned &warp,
+            const char *&rest, size_t &rest_len) {
+    if (!getline(m_ifs, line))
+      return END;
+    if (line.empty() || line[0] == '#' || line[0] == '-')
+      return OTHER;
+    char *p = &line[0];
+    tb_x = strtoul(p, &p, 10);
+    tb_y = strtoul(p, &p, 10);
+    tb_z = strtoul(p, &p, 10);
+    warp = strtoul(p, &p, 10);
+    if (*p)
+      p++; // the space after the warp id
+    rest = p;
+    rest_len = line.c_str() + line.size() - p;
+    return INST;
+  }
+
+private:
+  string m_filepath;
+  streampos m_first_inst;
+  ifstream m_ifs;
+};
+
+// the binary records of kernel-<n>.trace.bin, formatted as the text lines
+// the tracer writes otherwise
+class record_trace_source : public trace_source {
+public:
+  record_trace_source(const string &filepath)
+      : m_filepath(filepath), m_file(NULL), m_buffer(16 << 20) {}
+  ~record_trace_source() {
+    if (m_file)
+      fclose(m_file);
+  }
+
+  bool rewind() {
+    if (m_file)
+      fclose(m_file);
+    m_file = fopen(m_filepath.c_str(), "rb");
+    if (!m_file) {
+      lock_guard<mutex> lock(cout_lock);
+      cout << "Unable to open file: " << m_filepath << endl;
+      return false;
+    }
+    char magic[TRACE_RECORD_MAGIC_SIZE];
+    uint32_t version = 0;
+    if (fread(magic, 1, TRACE_RECORD_MAGIC_SIZE, m_file) !=
+            TRACE_RECORD_MAGIC_SIZE ||
+        memcmp(magic, TRACE_RECORD_MAGIC, TRACE_RECORD_MAGIC_SIZE) ||
+        fread(&version, sizeof(version), 1, m_file) != 1 ||
+        version != TRACE_RECORD_VERSION ||
+        fread(&m_flags, sizeof(m_flags), 1, m_file) != 1) {
+      lock_guard<mutex> lock(cout_lock);
+      cout << "Not a binary trace record file: " << m_filepath << endl;
+      return false;
+    }
+    m_size = m_pos = 0;
+    m_eof = false;
+    return true;
+  }
+
+  item next(unsigned &tb_x, unsigned &tb_y, unsigned &tb_z, unsigned &warp,
+            const char *&rest, size_t &rest_len) {
+    while (true) {
+      if (!m_eof && m_size - m_pos < TRACE_RECORD_MAX_SIZE) {
+        memmove(&m_buffer[0], &m_buffer[m_pos], m_size - m_pos);
+        m_size -= m_pos;
+        m_pos = 0;
+        size_t n = fread(&m_buffer[m_size], 1, m_buffer.size() - m_size, m_file);
+        m_size += n;
+        m_eof = n == 0;
+      }
+      if (m_pos == m_size)
+        return END;
+
+      const char *p = &m_buffer[m_pos];
+      uint8_t type = trace_get<uint8_t>(p);
+      if (type == TRACE_RECORD_OPCODE) {
+        unsigned id = trace_get<uint16_t>(p);
+        unsigned len = trace_get<uint16_t>(p);
+        if (id >= m_opcodes.size())
+          m_opcodes.resize(id + 1);
+        m_opcodes[id].assign(p, len);
+        p += len;
+        if (!advance(p))
+          return END;
+        continue;
+      } else if (type != TRACE_RECORD_INST) {
+        lock_guard<mutex> lock(cout_lock);
+        cout << "Corrupted binary trace record in " << m_filepath << endl;
+        return END;
+      }
+
+      trace_record r;
+      decode_trace_record(p, m_flags, r);
+      if (!advance(p))
+        return END;
+      unsigned len = format_trace_record(
+          r,
+          r.opcode_id < m_opcodes.size() ? m_opcodes[r.opcode_id].c_str() : "",
+          m_flags, m_line);
+      tb_x = r.cta_id_x;
+      tb_y = r.cta_id_y;
+      tb_z = r.cta_id_z;
+      warp = r.warpid_tb;
+      // the line without the thread block, the warp id and the newline
+      rest = m_line;
+      for (unsigned spaces = 0; spaces < 4; rest++)
+        if (*rest == ' ')
+          spaces++;
+      rest_len = m_line + len - 1 - rest;
+      return INST;
+    }
+  }
+
+private:
+  bool advance(const char *p) {
+    if (p > &m_buffer[0] + m_size) {
+      lock_guard<mutex> lock(cout_lock);
+      cout << "Truncated binary trace record in " << m_filepath << endl;
+      return false;
+    }
+    m_pos = p - &m_buffer[0];
+    return true;
+  }
+
+  string m_filepath;
+  FILE *m_file;
+  uint32_t m_flags;
+  vector<char> m_buffer;
+  size_t m_size, m_pos;
+  bool m_eof;
+  vector<string> m_opcodes;
+  char m_line[TRACE_RECORD_MAX_TEXT];
+};
+
+// the .traceg of a kernel, as text or as the binary container
+class traceg_output {
+public:
+  traceg_output(bool binary) : m_binary(binary) {}
+
+  bool open(const string &filepath) {
+#ifdef POST_TRACES_BINARY
+    if (m_binary)
+      return m_writer.open(filepath);
+#endif
+    m_ofs.open(filepath.c_str());
+    return m_ofs.is_open();
+  }
+
+  void header_line(const string &line) {
+    unsigned value;
+    if (sscanf(line.c_str(), "-accelsim tracer version = %u", &value) == 1)
+      m_trace_version = value;
+    if (sscanf(line.c_str(), "-enable lineinfo = %u", &value) == 1)
+      m_lineinfo = value;
+#ifdef POST_TRACES_BINARY
+    if (m_binary) {
+      if (!line.empty() && line[0] == '-')
+        m_writer.write_header_line(line);
+      return;
+    }
+#endif
+    m_ofs << line << '\n';
+  }
+
+  void threadblock(const threadblock_info &tb) {
+#ifdef POST_TRACES_BINARY
+    if (m_binary) {
+      m_writer.begin_threadblock(tb.tb_id_x, tb.tb_id_y, tb.tb_id_z);
+      for (unsigned j = 0; j < tb.warp_lines.size(); ++j) {
+        m_writer.begin_warp(j, tb.warp_insts[j]);
+        const string &lines = tb.warp_lines[j];
+        for (size_t b = 0, e; b < lines.size(); b = e + 1) {
+          e = lines.find('\n', b);
+          m_writer.write_inst(lines.substr(b, e - b), m_trace_version,
+                              m_lineinfo);
+        }
+      }
+      m_writer.end_threadblock();
+      return;
+    }
+#endif
+    m_ofs << "\n#BEGIN_TB\n\nthread block = " << tb.tb_id_x << ","
+          << tb.tb_id_y << "," << tb.tb_id_z << '\n';
+    for (unsigned j = 0; j < tb.warp_lines.size(); ++j) {
+      m_ofs << "\nwarp = " << j << "\ninsts = " << tb.warp_insts[j] << '\n';
+      m_ofs << tb.warp_lines[j];
+    }
+    m_ofs << "\n#END_TB\n";
+  }
+
+  void close() {
+#ifdef POST_TRACES_BINARY
+    if (m_binary) {
+      m_writer.close();
+      return;
+    }
+#endif
+    m_ofs.close();
+  }
+
+private:
+  bool m_binary;
+  unsigned m_trace_version = 0;
+  unsigned m_lineinfo = 0;
+  ofstream m_ofs;
+#ifdef POST_TRACES_BINARY
+  binary_trace_writer m_writer;
+#endif
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char **argv) {
+
+  string kernellist_filepath;
+  options opts;
+  opts.jobs = thread::hardware_concurrency();
+  opts.memory = 4096;
+  opts.binary = false;
+  if (argc == 1) {
+    cout << "File path is missing\n";
+    return 0;
+  }
+  kernellist_filepath = argv[1];
+  for (int i = 2; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      opts.jobs = atoi(argv[++i]);
+    } else if (arg == "-m" && i + 1 < argc) {
+      opts.memory = strtoull(argv[++i], NULL, 10);
+    } else if (arg == "-binary") {
+#ifndef POST_TRACES_BINARY
+      cout << "-binary needs post-traces-processing built with make BINARY=1\n";
+      return 1;
+#endif
+      opts.binary = true;
+    } else if (i != 2) {
+      // the second argument used to select per core grouping, which was
+      // never implemented
+      cout << "Unknown argument: " << arg << "\n";
+      return 0;
+    }
+  }
+  if (opts.jobs == 0)
+    opts.jobs = 1;
+
+  ifstream ifs;
+  ofstream ofs;
+
+  ifs.open(kernellist_filepath.c_str());
+  ofs.open((string(kernellist_filepath) + ".g").c_str());
+
+  if (!ifs.is_open()) {
+    cout << "Unable to open file: " << kernellist_filepath << endl;
+    return 0;
+  }
+
+  string directory(kernellist_filepath);
+  const size_t last_slash_idx = directory.rfind('/');
+  if (std::string::npos != last_slash_idx) {
+    directory = directory.substr(0, last_slash_idx);
+  }
+
+  string line;
+  vector<string> kernels;
+  while (!ifs.eof()) {
+    getline(ifs, line);
+    if (line.empty())
+      continue;
+    else if (line.substr(0, 6) == "Memcpy") {
+      ofs << line << endl;
+    } else if (line.substr(0, 6) == "kernel") {
+      kernels.push_back(directory + "/" + line);
+      ofs << line + "g" << endl;
+    } else {
+      cout << "Undefined command: " << line << endl;
+      return 0;
+    }
+  }
+
+  ifs.close();
+  ofs.close();
+
+  if (opts.jobs > kernels.size())
+    opts.jobs = kernels.size() ? kernels.size() : 1;
+  uint64_t job_memory = (opts.memory << 20) / opts.jobs;
+  atomic<unsigned> next_kernel(0);
+  vector<thread> workers;
+  for (unsigned j = 0; j < opts.jobs; ++j) {
+    workers.push_back(thread([&]() {
+      for (unsigned k = next_kernel++; k < kernels.size(); k = next_kernel++)
+        group_per_block(kernels[k].c_str(), job_memory, opts.binary);
+    }));
+  }
+  for (unsigned j = 0; j < workers.size(); ++j)
+    workers[j].join();
+  return 0;
+}
+
+void group_per_block(const char *filepath, uint64_t memory, bool binary) {
+
+  ifstream ifs;
+  ifs.open(filepath);
+
+  if (!ifs.is_open()) {
+    lock_guard<mutex> lock(cout_lock);
+    cout << "Unable to open file: " << filepath << endl;
+    return;
+  }
+
+  {
+    lock_guard<mutex> lock(cout_lock);
+    cout << "Processing file " << filepath << endl;
+  }
+  traceg_output out(binary);
+  if (!out.open(string(filepath) + "g")) {
+    lock_guard<mutex> lock(cout_lock);
+    cout << "Unable to write file: " << filepath << "g" << endl;
+    return;
+  }
+
+  // the header, up to the first instruction
+  vector<threadblock_info> insts;
+  unsigned grid_dim_x = 0, grid_dim_y = 0, grid_dim_z = 0;
+  unsigned tb_dim_x = 0, tb_dim_y = 0, tb_dim_z = 0;
+  // TOOL_CTA_SAMPLE traced only every cta_sample-th thread block
+  unsigned cta_sample = 1;
+  string line;
+  string records_file;
+  streampos first_inst = ifs.tellg();
+  while (getline(ifs, line)) {
+    if (!line.empty() && line[0] != '#' && line[0] != '-')
+      break;
+    first_inst = ifs.tellg();
+    if (!line.empty() && line[0] == '-') {
+      sscanf(line.c_str(), "-grid dim = (%u,%u,%u)", &grid_dim_x, &grid_dim_y,
+             &grid_dim_z);
+      sscanf(line.c_str(), "-block dim = (%u,%u,%u)", &tb_dim_x, &tb_dim_y,
+             &tb_dim_z);
+      sscanf(line.c_str(), "-cta sample = %u", &cta_sample);
+      if (line.compare(0, 16, "-trace records =") == 0) {
+        // the instructions are binary records in a file of their own
+        records_file = line.substr(line.find('=') + 2);
+        continue;
+      }
+    }
+    out.header_line(line);
+  }
+  ifs.close();
+
+  insts.resize((size_t)grid_dim_x * grid_dim_y * grid_dim_z);
+  unsigned warps = ceil(float(tb_dim_x * tb_dim_y * tb_dim_z) / 32);
+  for (unsigned i = 0; i < insts.size(); ++i)
+    insts[i].warp_insts.resize(warps);
+
+  trace_source *src;
+  if (records_file.empty()) {
+    src = new text_trace_source(filepath, first_inst);
+  } else {
+    string records_path(filepath);
+    const size_t last_slash_idx = records_path.rfind('/');
+    records_path = last_slash_idx == string::npos
+                       ? records_file
+                       : records_path.substr(0, last_slash_idx + 1) +
+                             records_file;
+    src = new record_trace_source(records_path);
+  }
+
+  // first pass: instructions and bytes per thread block and warp
+  unsigned tb_id_x, tb_id_y, tb_id_z, warpid_tb;
+  const char *rest;
+  size_t rest_len;
+  trace_source::item item;
+  if (!src->rewind()) {
+    delete src;
+    out.close();
+    return;
+  }
+  while ((item = src->next(tb_id_x, tb_id_y, tb_id_z, warpid_tb, rest,
+                           rest_len)) != trace_source::END) {
+    if (item == trace_source::OTHER) {
+      out.header_line(src->line);
+      continue;
+    }
+    size_t tb_id = (size_t)tb_id_z * grid_dim_y * grid_dim_x +
+                   tb_id_y * grid_dim_x + tb_id_x;
+    if (tb_id >= insts.size() || warpid_tb >= warps) {
+      lock_guard<mutex> lock(cout_lock);
+      cout << "Instruction outside of the grid in " << filepath << ": "
+           << tb_id_x << "," << tb_id_y << "," << tb_id_z << " warp "
+           << warpid_tb << endl;
+      continue;
+    }
+    threadblock_info &tb = insts[tb_id];
+    if (!tb.initialized) {
+      tb.tb_id_x = tb_id_x;
+      tb.tb_id_y = tb_id_y;
+      tb.tb_id_z = tb_id_z;
+      tb.initialized = true;
+    }
+    tb.warp_insts[warpid_tb]++;
+    tb.bytes += rest_len + 1;
+  }
+  // the empty line the header always ended with when the trace was read
+  // line by line up to eof
+  out.header_line("");
+
+  // then the thread blocks in ranges that fit into memory
+  for (size_t begin = 0, end; begin < insts.size(); begin = end) {
+    uint64_t bytes = 0;
+    for (end = begin; end < insts.size(); ++end) {
+      if (end > begin && bytes + insts[end].bytes > memory)
+        break;
+      bytes += insts[end].bytes;
+    }
+
+    bool collect = false;
+    for (size_t i = begin; i < end; ++i) {
+      if (insts[i].initialized && insts[i].bytes) {
+        insts[i].warp_lines.resize(warps);
+        collect = true;
+      }
+    }
+    if (collect) {
+      if (!src->rewind())
+        break;
+      while ((item = src->next(tb_id_x, tb_id_y, tb_id_z, warpid_tb, rest,
+                               rest_len)) != trace_source::END) {
+        if (item == trace_source::OTHER)
+          continue;
+        size_t tb_id = (size_t)tb_id_z * grid_dim_y * grid_dim_x +
+                       tb_id_y * grid_dim_x + tb_id_x;
+        if (tb_id < begin || tb_id >= end || warpid_tb >= warps)
+          continue;
+        string &lines = insts[tb_id].warp_lines[warpid_tb];
+        lines.append(rest, rest_len);
+        lines += '\n';
+      }
+    }
+
+    for (size_t i = begin; i < end; ++i) {
+      threadblock_info &tb = insts[i];
+      if (!tb.initialized || warps == 0) {
+        if (cta_sample > 1 && i % cta_sample)
+          continue;
+        lock_guard<mutex> lock(cout_lock);
+        cout << "Warning: Thread block " << i % grid_dim_x << ","
+             << i / grid_dim_x % grid_dim_y << ","
+             << i / grid_dim_x / grid_dim_y << " is empty" << endl;
+        continue;
+      }
+      for (unsigned j = 0; j < warps; ++j) {
+        if (tb.warp_insts[j] == 0) {
+          lock_guard<mutex> lock(cout_lock);
+          cout << "Warning: Warp " << j << " in thread block" << tb.tb_id_x
+               << "," << tb.tb_id_y << "," << tb.tb_id_z << " is empty"
+               << endl;
+        }
+      }
+      tb.warp_lines.resize(warps);
+      out.threadblock(tb);
+      vector<string>().swap(tb.warp_lines);
+    }
+  }
+
+  delete src;
+  out.close();
+}
+
+void group_per_core(const char *filepath) {
+
+  // TO DO
+}
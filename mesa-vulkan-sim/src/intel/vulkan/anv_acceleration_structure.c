@@ -24,10 +24,16 @@
 #include "anv_acceleration_structure.h"
 #include "anv_private.h"
 
+#include <limits.h>
 #include <math.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "util/debug.h"
 #include "util/half_float.h"
+#include "util/mesa-sha1.h"
+#include "util/u_dynarray.h"
 #include "util/u_atomic.h"
 
 #include "genxml/gen_rt_pack.h"
@@ -80,6 +86,28 @@ struct anv_bvh_build_geometry_state {
    const VkAccelerationStructureGeometryKHR *pGeometry;
    struct anv_bvh_triangle *triangles;
    const void *instance_data;
+
+   /* active primitives of the geometry in primitive order */
+   const struct RTCBuildPrimitive *prims;
+   uint32_t prim_count;
+};
+
+/* ANV_BVH_LAYOUT=dfs|bfs|treelet orders the child blocks of the packed BVH.
+ * dfs (the default) packs them depth first in the order of the tree, bfs
+ * breadth first, and treelet keeps the treelets of
+ * ANV_BVH_TREELET_BYTES (1024) together, the size to give
+ * -gpgpu_rt_treelet_bytes.  See pack_tree_clustered.
+ */
+enum anv_bvh_layout {
+   ANV_BVH_LAYOUT_DFS,
+   ANV_BVH_LAYOUT_BFS,
+   ANV_BVH_LAYOUT_TREELET,
+};
+
+/* internal node placed in the block of its parent but not packed yet */
+struct anv_bvh_pending_node {
+   struct anv_bvh_node *node;
+   void *out;
 };
 
 struct anv_bvh_build_state {
@@ -90,8 +118,66 @@ struct anv_bvh_build_state {
 
    void *nodes_map;
    void *leaves_map;
+
+   enum anv_bvh_layout layout;
+   /* internal nodes of the treelet being packed and its size so far */
+   struct util_dynarray frontier;
+   uint64_t treelet_bytes;
 };
 
+static enum anv_bvh_layout
+anv_bvh_layout(void)
+{
+   static int layout = -1;
+   if (layout < 0) {
+      const char *env = getenv("ANV_BVH_LAYOUT");
+      layout = ANV_BVH_LAYOUT_DFS;
+      if (env && !strcmp(env, "bfs")) {
+         layout = ANV_BVH_LAYOUT_BFS;
+      } else if (env && !strcmp(env, "treelet")) {
+         layout = ANV_BVH_LAYOUT_TREELET;
+      } else if (env && strcmp(env, "dfs")) {
+         mesa_logw("ANV_BVH_LAYOUT=%s is not dfs, bfs or treelet, using dfs",
+                   env);
+      }
+   }
+   return layout;
+}
+
+/* ANV_BVH_BUILD_QUALITY=low|medium|high picks the Embree builder: low is the
+ * Morton builder, medium (the default) the binned SAH builder and high the
+ * SAH builder with spatial splits of the triangles of bottom level
+ * structures.  A split triangle is referenced from more than one leaf, so
+ * high reserves room for twice the primitives in the scratch and the BVH.
+ * Embree has no refit for rtcBuildBVH; the structures are always rebuilt.
+ */
+static enum RTCBuildQuality
+anv_bvh_build_quality(void)
+{
+   static int quality = -1;
+   if (quality < 0) {
+      const char *env = getenv("ANV_BVH_BUILD_QUALITY");
+      quality = RTC_BUILD_QUALITY_MEDIUM;
+      if (env && !strcmp(env, "low")) {
+         quality = RTC_BUILD_QUALITY_LOW;
+      } else if (env && !strcmp(env, "high")) {
+         quality = RTC_BUILD_QUALITY_HIGH;
+      } else if (env && strcmp(env, "medium")) {
+         mesa_logw("ANV_BVH_BUILD_QUALITY=%s is not low, medium or high, "
+                   "using medium", env);
+      }
+   }
+   return quality;
+}
+
+/* Primitive references reserved per primitive of a structure of type */
+static uint32_t
+anv_bvh_split_factor(VkAccelerationStructureTypeKHR type)
+{
+   return type == VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR &&
+          anv_bvh_build_quality() == RTC_BUILD_QUALITY_HIGH ? 2 : 1;
+}
+
 #ifndef NDEBUG
 static bool
 anv_force_cpu_bvh_build()
@@ -169,13 +255,16 @@ anv_GetAccelerationStructureBuildSizesKHR(
    for (uint32_t i = 0; i < pBuildInfo->geometryCount; i++)
       max_prim_count += pMaxPrimitiveCounts[i];
 
+   uint64_t max_ref_count =
+      max_prim_count * anv_bvh_split_factor(pBuildInfo->type);
+
    pSizeInfo->accelerationStructureSize =
-      anv_bvh_max_size(pBuildInfo->type, max_prim_count);
+      anv_bvh_max_size(pBuildInfo->type, max_ref_count);
 
    uint64_t cpu_build_scratch_size = 0;
    cpu_build_scratch_size += pBuildInfo->geometryCount *
                              sizeof(struct anv_bvh_build_geometry_state);
-   cpu_build_scratch_size += max_prim_count * sizeof(struct RTCBuildPrimitive);
+   cpu_build_scratch_size += max_ref_count * sizeof(struct RTCBuildPrimitive);
    cpu_build_scratch_size += max_prim_count * 9 * sizeof(float);
 
    uint64_t cpu_update_scratch_size = cpu_build_scratch_size; /* TODO */
@@ -899,6 +988,92 @@ rtc_create_leaf_cb(RTCThreadLocalAllocator alloc,
    return leaf;
 }
 
+/* Callback to split a triangle at position along dimension, for the spatial
+ * splits of high quality builds.  The triangle is clipped against the plane
+ * and the bounds of either side narrowed to those of the reference, which an
+ * earlier split may already have cut.
+ */
+static void
+rtc_split_primitive_cb(const struct RTCBuildPrimitive* primitive,
+                       unsigned int dimension, float position,
+                       struct RTCBounds* leftBounds,
+                       struct RTCBounds* rightBounds, void* userPtr)
+{
+   const struct anv_bvh_build_state *state = userPtr;
+   const struct anv_bvh_triangle *triangle =
+      &state->geometries[primitive->geomID].triangles[primitive->primID];
+   const float *prim_lower = &primitive->lower_x;
+   const float *prim_upper = &primitive->upper_x;
+   float *left_lower = &leftBounds->lower_x, *left_upper = &leftBounds->upper_x;
+   float *right_lower = &rightBounds->lower_x;
+   float *right_upper = &rightBounds->upper_x;
+
+   for (unsigned d = 0; d < 3; d++) {
+      left_lower[d] = right_lower[d] = INFINITY;
+      left_upper[d] = right_upper[d] = -INFINITY;
+   }
+
+   for (unsigned i = 0; i < 3; i++) {
+      const float *v0 = triangle->v[i].v;
+      const float *v1 = triangle->v[(i + 1) % 3].v;
+
+      if (v0[dimension] <= position) {
+         for (unsigned d = 0; d < 3; d++) {
+            left_lower[d] = MIN2(left_lower[d], v0[d]);
+            left_upper[d] = MAX2(left_upper[d], v0[d]);
+         }
+      }
+      if (v0[dimension] >= position) {
+         for (unsigned d = 0; d < 3; d++) {
+            right_lower[d] = MIN2(right_lower[d], v0[d]);
+            right_upper[d] = MAX2(right_upper[d], v0[d]);
+         }
+      }
+
+      /* the edge crosses the plane, its intersection is on both sides */
+      if ((v0[dimension] < position && position < v1[dimension]) ||
+          (v1[dimension] < position && position < v0[dimension])) {
+         float t = (position - v0[dimension]) /
+                   (v1[dimension] - v0[dimension]);
+         for (unsigned d = 0; d < 3; d++) {
+            float c = d == dimension ? position : v0[d] + t * (v1[d] - v0[d]);
+            left_lower[d] = MIN2(left_lower[d], c);
+            left_upper[d] = MAX2(left_upper[d], c);
+            right_lower[d] = MIN2(right_lower[d], c);
+            right_upper[d] = MAX2(right_upper[d], c);
+         }
+      }
+   }
+
+   for (unsigned d = 0; d < 3; d++) {
+      left_lower[d] = MAX2(left_lower[d], prim_lower[d]);
+      left_upper[d] = MIN2(left_upper[d], prim_upper[d]);
+      right_lower[d] = MAX2(right_lower[d], prim_lower[d]);
+      right_upper[d] = MIN2(right_upper[d], prim_upper[d]);
+   }
+   left_upper[dimension] = MIN2(left_upper[dimension], position);
+   right_lower[dimension] = MAX2(right_lower[dimension], position);
+}
+
+/* Whether the primitives of a build may be split.  A split triangle can be
+ * hit in more than one leaf, which geometries that ask for a single any hit
+ * invocation do not allow.
+ */
+static bool
+anv_bvh_splittable(const VkAccelerationStructureBuildGeometryInfoKHR *pInfo,
+                   const struct anv_bvh_build_state *state)
+{
+   for (unsigned g = 0; g < pInfo->geometryCount; g++) {
+      const VkAccelerationStructureGeometryKHR *pGeometry =
+         state->geometries[g].pGeometry;
+      if (pGeometry->geometryType != VK_GEOMETRY_TYPE_TRIANGLES_KHR ||
+          (pGeometry->flags &
+           VK_GEOMETRY_NO_DUPLICATE_ANY_HIT_INVOCATION_BIT_KHR))
+         return false;
+   }
+   return true;
+}
+
 static void
 node_type_size(struct anv_bvh_node *node, uint32_t *type, uint32_t *size,
                struct anv_bvh_build_state *state)
@@ -932,6 +1107,10 @@ node_type_size(struct anv_bvh_node *node, uint32_t *type, uint32_t *size,
    }
 }
 
+static void
+pack_children_deferred(struct anv_bvh_node *node, void *children_map,
+                       struct anv_bvh_build_state *state);
+
 static void
 pack_node(struct anv_bvh_node *node, bool is_root, void *out,
           struct anv_bvh_build_state *state)
@@ -1103,6 +1282,11 @@ pack_node(struct anv_bvh_node *node, bool is_root, void *out,
 
       GEN_RT_BVH_INTERNAL_NODE_pack(NULL, out, &bin);
 
+      if (state->layout != ANV_BVH_LAYOUT_DFS) {
+         pack_children_deferred(node, children_map, state);
+         return;
+      }
+
       for (unsigned i = 0; i < 6; i++) {
          if (node->children[i] == NULL)
             break;
@@ -1113,6 +1297,372 @@ pack_node(struct anv_bvh_node *node, bool is_root, void *out,
    }
 }
 
+/* Packs the leaves among the children of node at children_map and leaves
+ * its internal children to pack_tree_clustered
+ */
+static void
+pack_children_deferred(struct anv_bvh_node *node, void *children_map,
+                       struct anv_bvh_build_state *state)
+{
+   for (unsigned i = 0; i < 6; i++) {
+      if (node->children[i] == NULL)
+         break;
+
+      UNUSED uint32_t type;
+      uint32_t size;
+      node_type_size(node->children[i], &type, &size, state);
+      if (node->children[i]->is_leaf) {
+         pack_node(node->children[i], false, children_map, state);
+         state->treelet_bytes += size * 64;
+      } else {
+         struct anv_bvh_pending_node pending = {
+            .node = node->children[i],
+            .out = children_map,
+         };
+         util_dynarray_append(&state->frontier, struct anv_bvh_pending_node,
+                              pending);
+      }
+      children_map += size * 64;
+   }
+}
+
+/* Packs the tree at root for the bfs and treelet layouts.  The treelets are
+ * the ones build_treelets in vulkan-sim splits the BVH into: grown breadth
+ * first from their root, an internal node with the leaves among its
+ * children, until the next internal node would not fit in max_bytes.  What
+ * does not fit starts treelets of its own, packed after this one, so the
+ * child blocks of every treelet end up next to each other.  The bfs layout
+ * is a single treelet of any size.
+ */
+static void
+pack_tree_clustered(struct anv_bvh_node *root, void *root_map,
+                    uint64_t max_bytes, struct anv_bvh_build_state *state)
+{
+   struct util_dynarray roots;
+   util_dynarray_init(&roots, NULL);
+   util_dynarray_init(&state->frontier, NULL);
+
+   struct anv_bvh_pending_node pending = { .node = root, .out = root_map };
+   util_dynarray_append(&roots, struct anv_bvh_pending_node, pending);
+
+   unsigned next_root = 0;
+   while (next_root < util_dynarray_num_elements(&roots,
+                                                 struct anv_bvh_pending_node)) {
+      util_dynarray_clear(&state->frontier);
+      util_dynarray_append(&state->frontier, struct anv_bvh_pending_node,
+                           *util_dynarray_element(&roots,
+                                                  struct anv_bvh_pending_node,
+                                                  next_root++));
+      state->treelet_bytes = 0;
+
+      unsigned next = 0;
+      while (next < util_dynarray_num_elements(&state->frontier,
+                                               struct anv_bvh_pending_node)) {
+         struct anv_bvh_pending_node node =
+            *util_dynarray_element(&state->frontier,
+                                   struct anv_bvh_pending_node, next);
+         uint64_t node_bytes = GEN_RT_BVH_INTERNAL_NODE_length * 4;
+         if (state->treelet_bytes > 0 &&
+             state->treelet_bytes + node_bytes > max_bytes)
+            break;
+
+         next++;
+         state->treelet_bytes += node_bytes;
+         pack_node(node.node, node.out == root_map, node.out, state);
+      }
+
+      /* what does not fit starts treelets of its own */
+      unsigned count = util_dynarray_num_elements(&state->frontier,
+                                                  struct anv_bvh_pending_node);
+      for (unsigned i = next; i < count; i++) {
+         util_dynarray_append(&roots, struct anv_bvh_pending_node,
+                              *util_dynarray_element(&state->frontier,
+                                                     struct anv_bvh_pending_node,
+                                                     i));
+      }
+   }
+
+   util_dynarray_fini(&state->frontier);
+   util_dynarray_fini(&roots);
+}
+
+/* Packs the header of a BVH with the bounds of its root, returns the offset
+ * of the root node
+ */
+static uint64_t
+pack_bvh_header(const struct anv_bvh_node *root, void *out)
+{
+   struct GEN_RT_BVH bvh = { };
+   bvh.RootNodeOffset = GEN_RT_BVH_length * 4;
+   uint8_t max_child_x = 0, max_child_y = 0, max_child_z = 0;
+   for (unsigned i = 0; i < 6; i++) {
+      max_child_x = MAX2(max_child_x, root->upper_x[i]);
+      max_child_y = MAX2(max_child_y, root->upper_y[i]);
+      max_child_z = MAX2(max_child_z, root->upper_z[i]);
+   }
+   bvh.BoundsMin.X = root->origin_x;
+   bvh.BoundsMin.Y = root->origin_y;
+   bvh.BoundsMin.Z = root->origin_z;
+   bvh.BoundsMax.X = root->origin_x + ldexpf(max_child_x, root->exp_x - 8);
+   bvh.BoundsMax.Y = root->origin_y + ldexpf(max_child_y, root->exp_y - 8);
+   bvh.BoundsMax.Z = root->origin_z + ldexpf(max_child_z, root->exp_z - 8);
+   GEN_RT_BVH_pack(NULL, out, &bvh);
+   return bvh.RootNodeOffset;
+}
+
+/* VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR: the tree of the source
+ * structure is kept and only refit to the new primitives.  Walking the
+ * packed nodes bottom-up, every leaf is packed again from its geometry and
+ * every internal node gets the quantized bounds of its children, so the
+ * update costs one pass over the nodes and no Embree build.  The topology
+ * stays that of the original primitive positions, like the refit of a
+ * hardware driver.
+ */
+static const struct RTCBuildPrimitive *
+find_bvh_prim(const struct anv_bvh_build_geometry_state *geometry,
+              uint32_t primitive_id)
+{
+   uint32_t lo = 0, hi = geometry->prim_count;
+   while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (geometry->prims[mid].primID < primitive_id)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   if (lo == geometry->prim_count || geometry->prims[lo].primID != primitive_id)
+      return NULL;
+   return &geometry->prims[lo];
+}
+
+/* Refits the packed node at map of type, returns its bounds in bounds_out.
+ * Fails if it references a primitive that is no longer active, updates may
+ * not deactivate primitives.
+ */
+static bool
+refit_node(void *map, uint32_t type, struct RTCBounds *bounds_out,
+           struct anv_bvh_node *node_out, struct anv_bvh_build_state *state)
+{
+   /* TODO: Unpack with GenXML? */
+   const uint32_t *dw = map;
+
+   if (type != NODE_TYPE_INTERNAL) {
+      struct anv_bvh_leaf leaf = { .is_leaf = true };
+      switch (type) {
+      case NODE_TYPE_QUAD:
+         leaf.geometry_id = dw[1] & 0x1fffffff;
+         leaf.primitive_id = dw[2];
+         break;
+      case NODE_TYPE_PROCEDURAL:
+         leaf.geometry_id = dw[1] & 0x1fffffff;
+         leaf.primitive_id = dw[3];
+         break;
+      case NODE_TYPE_INSTANCE:
+         /* top level structures have a single geometry */
+         leaf.geometry_id = 0;
+         leaf.primitive_id = dw[19];
+         break;
+      default:
+         unreachable("Invalid node type");
+      }
+
+      const struct RTCBuildPrimitive *prim =
+         find_bvh_prim(&state->geometries[leaf.geometry_id],
+                       leaf.primitive_id);
+      if (prim == NULL)
+         return false;
+
+      pack_node((struct anv_bvh_node *)&leaf, false, map, state);
+      memcpy(bounds_out, prim, sizeof(*bounds_out));
+      return true;
+   }
+
+   const uint8_t *child_data = (const uint8_t *)map + 22;
+   void *child_map = map + (int32_t)dw[3] * 64;
+   struct RTCBounds child_bounds[6];
+   const struct RTCBounds *child_bounds_ptrs[6];
+   unsigned child_count = 0;
+   for (unsigned i = 0; i < 6 && (child_data[i] & 0x3); i++) {
+      struct anv_bvh_node child;
+      if (!refit_node(child_map, (child_data[i] >> 2) & 0xf,
+                      &child_bounds[i], &child, state))
+         return false;
+      child_bounds_ptrs[i] = &child_bounds[i];
+      child_map += (child_data[i] & 0x3) * 64;
+      child_count++;
+   }
+
+   struct anv_bvh_node node;
+   anv_bvh_node_init(&node);
+   anv_bvh_node_set_child_bounds(&node, child_bounds_ptrs, child_count);
+
+   struct GEN_RT_BVH_INTERNAL_NODE bin = {};
+   bin.Origin.X = node.origin_x;
+   bin.Origin.Y = node.origin_y;
+   bin.Origin.Z = node.origin_z;
+   bin.ChildOffset = (int32_t)dw[3];
+   bin.NodeType = NODE_TYPE_INTERNAL;
+   bin.ChildBoundsExponentX = node.exp_x;
+   bin.ChildBoundsExponentY = node.exp_y;
+   bin.ChildBoundsExponentZ = node.exp_z;
+   bin.NodeRayMask = 0xff;
+   for (unsigned i = 0; i < 6; i++) {
+      bin.ChildSize[i] = child_data[i] & 0x3;
+      bin.ChildType[i] = (child_data[i] >> 2) & 0xf;
+      if (i < child_count) {
+         bin.ChildLowerXBound[i] = node.lower_x[i];
+         bin.ChildUpperXBound[i] = node.upper_x[i];
+         bin.ChildLowerYBound[i] = node.lower_y[i];
+         bin.ChildUpperYBound[i] = node.upper_y[i];
+         bin.ChildLowerZBound[i] = node.lower_z[i];
+         bin.ChildUpperZBound[i] = node.upper_z[i];
+      } else {
+         bin.ChildLowerXBound[i] = 0x80;
+         bin.ChildLowerYBound[i] = 0x80;
+         bin.ChildLowerZBound[i] = 0x80;
+         bin.ChildUpperXBound[i] = 0x00;
+         bin.ChildUpperYBound[i] = 0x00;
+         bin.ChildUpperZBound[i] = 0x00;
+      }
+   }
+   GEN_RT_BVH_INTERNAL_NODE_pack(NULL, map, &bin);
+
+   if (child_count > 0) {
+      *bounds_out = child_bounds[0];
+      for (unsigned i = 1; i < child_count; i++) {
+         const struct RTCBounds *b = &child_bounds[i];
+         bounds_out->lower_x = MIN2(bounds_out->lower_x, b->lower_x);
+         bounds_out->lower_y = MIN2(bounds_out->lower_y, b->lower_y);
+         bounds_out->lower_z = MIN2(bounds_out->lower_z, b->lower_z);
+         bounds_out->upper_x = MAX2(bounds_out->upper_x, b->upper_x);
+         bounds_out->upper_y = MAX2(bounds_out->upper_y, b->upper_y);
+         bounds_out->upper_z = MAX2(bounds_out->upper_z, b->upper_z);
+      }
+   } else {
+      memset(bounds_out, 0, sizeof(*bounds_out));
+   }
+   *node_out = node;
+   return true;
+}
+
+/* Refits the BVH at map in place, false if it has to be rebuilt */
+static bool
+refit_bvh(void *map, struct anv_bvh_build_state *state)
+{
+   /* TODO: Unpack with GenXML? */
+   uint64_t root_offset = *(uint64_t *)map;
+   struct RTCBounds bounds;
+   struct anv_bvh_node root;
+   if (!refit_node(map + root_offset, NODE_TYPE_INTERNAL, &bounds, &root,
+                   state))
+      return false;
+
+   pack_bvh_header(&root, map);
+   return true;
+}
+
+/* ANV_BVH_CACHE_DIR: bottom level structures only hold offsets within
+ * themselves, so the packed BVH of one build can be copied into any
+ * destination. It is kept in the directory under the SHA-1 of the parsed
+ * primitives, their geometries and the build type and flags, and a later
+ * build of the same input copies it in instead of running Embree. Top level
+ * structures point at the addresses of their instances and are always
+ * built.
+ */
+#define ANV_BVH_CACHE_MAGIC 0x31485642 /* "BVH1" */
+
+struct anv_bvh_cache_header {
+   uint32_t magic;
+   uint32_t pad;
+   uint64_t size;
+};
+
+static bool
+anv_bvh_cache_path(const VkAccelerationStructureBuildGeometryInfoKHR *pInfo,
+                   const VkAccelerationStructureBuildRangeInfoKHR *pBuildRangeInfos,
+                   const struct anv_bvh_build_state *state,
+                   const struct RTCBuildPrimitive *prims, uint32_t prim_count,
+                   char *path, size_t path_size)
+{
+   const char *dir = getenv("ANV_BVH_CACHE_DIR");
+   if (!dir || !*dir ||
+       pInfo->type != VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR)
+      return false;
+
+   struct mesa_sha1 ctx;
+   _mesa_sha1_init(&ctx);
+   enum RTCBuildQuality quality = anv_bvh_build_quality();
+   enum anv_bvh_layout layout = state->layout;
+   unsigned treelet_bytes = layout == ANV_BVH_LAYOUT_TREELET ?
+      env_var_as_unsigned("ANV_BVH_TREELET_BYTES", 1024) : 0;
+   _mesa_sha1_update(&ctx, &quality, sizeof(quality));
+   _mesa_sha1_update(&ctx, &layout, sizeof(layout));
+   _mesa_sha1_update(&ctx, &treelet_bytes, sizeof(treelet_bytes));
+   _mesa_sha1_update(&ctx, &pInfo->type, sizeof(pInfo->type));
+   _mesa_sha1_update(&ctx, &pInfo->flags, sizeof(pInfo->flags));
+   _mesa_sha1_update(&ctx, &pInfo->geometryCount,
+                     sizeof(pInfo->geometryCount));
+   for (unsigned g = 0; g < pInfo->geometryCount; g++) {
+      const VkAccelerationStructureGeometryKHR *pGeometry =
+         state->geometries[g].pGeometry;
+      uint32_t primitive_count = pBuildRangeInfos[g].primitiveCount;
+      _mesa_sha1_update(&ctx, &pGeometry->geometryType,
+                        sizeof(pGeometry->geometryType));
+      _mesa_sha1_update(&ctx, &pGeometry->flags, sizeof(pGeometry->flags));
+      _mesa_sha1_update(&ctx, &primitive_count, sizeof(primitive_count));
+      if (pGeometry->geometryType == VK_GEOMETRY_TYPE_TRIANGLES_KHR) {
+         _mesa_sha1_update(&ctx, state->geometries[g].triangles,
+                           primitive_count * sizeof(struct anv_bvh_triangle));
+      }
+   }
+   _mesa_sha1_update(&ctx, &prim_count, sizeof(prim_count));
+   _mesa_sha1_update(&ctx, prims, prim_count * sizeof(*prims));
+
+   unsigned char sha1[20];
+   char sha1_str[41];
+   _mesa_sha1_final(&ctx, sha1);
+   _mesa_sha1_format(sha1_str, sha1);
+   mkdir(dir, 0755);
+   snprintf(path, path_size, "%s/%s.bvh", dir, sha1_str);
+   return true;
+}
+
+static bool
+anv_bvh_cache_load(const char *path, void *dst_map, uint64_t dst_size)
+{
+   FILE *fp = fopen(path, "rb");
+   if (!fp)
+      return false;
+
+   struct anv_bvh_cache_header header;
+   bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+             header.magic == ANV_BVH_CACHE_MAGIC && header.size <= dst_size &&
+             fread(dst_map, 1, header.size, fp) == header.size;
+   fclose(fp);
+   return ok;
+}
+
+static void
+anv_bvh_cache_store(const char *path, const void *dst_map, uint64_t size)
+{
+   /* written aside and renamed, a concurrent run never reads half a BVH */
+   char tmp[PATH_MAX];
+   snprintf(tmp, sizeof(tmp), "%s.tmp%d", path, (int)getpid());
+   FILE *fp = fopen(tmp, "wb");
+   if (!fp)
+      return;
+
+   struct anv_bvh_cache_header header = {
+      .magic = ANV_BVH_CACHE_MAGIC,
+      .size = size,
+   };
+   bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(dst_map, 1, size, fp) == size;
+   ok = fclose(fp) == 0 && ok;
+   if (!ok || rename(tmp, path) != 0)
+      unlink(tmp);
+}
+
 static VkResult
 anv_cpu_build_acceleration_structures(
    struct anv_device *device,
@@ -1121,7 +1671,13 @@ anv_cpu_build_acceleration_structures(
    const VkAccelerationStructureBuildRangeInfoKHR* const* ppBuildRangeInfos,
    bool is_host_build)
 {
-   RTCDevice rtc = rtcNewDevice("ignore_config_files=1");
+   /* ANV_BVH_BUILD_THREADS=n runs the builds on n threads of the Embree
+    * task scheduler, 0 (the default) on all hardware threads
+    */
+   char rtc_config[64];
+   snprintf(rtc_config, sizeof(rtc_config), "ignore_config_files=1,threads=%u",
+            env_var_as_unsigned("ANV_BVH_BUILD_THREADS", 0));
+   RTCDevice rtc = rtcNewDevice(rtc_config);
 
    for (uint32_t i = 0; i < infoCount; i++) {
       const VkAccelerationStructureBuildGeometryInfoKHR *pInfo = &pInfos[i];
@@ -1136,15 +1692,18 @@ anv_cpu_build_acceleration_structures(
       struct anv_bvh_build_state build_state = {
          .device = device,
          .is_host_build = is_host_build,
+         .layout = anv_bvh_layout(),
       };
 
       uint64_t total_prim_count = 0;
       for (unsigned g = 0; g < pInfo->geometryCount; g++)
-         total_prim_count += pBuildRangeInfos[i].primitiveCount;
+         total_prim_count += pBuildRangeInfos[g].primitiveCount;
 
       void *scratch = doha_to_host(pInfo->scratchData, &build_state);
+      uint64_t prim_capacity =
+         total_prim_count * anv_bvh_split_factor(pInfo->type);
       struct RTCBuildPrimitive *scratch_rtc_prims = scratch;
-      scratch += total_prim_count * sizeof(*scratch_rtc_prims);
+      scratch += prim_capacity * sizeof(*scratch_rtc_prims);
       struct anv_bvh_build_geometry_state *scratch_geometries = scratch;
       scratch += pInfo->geometryCount * sizeof(*scratch_geometries);
       struct anv_bvh_triangle *scratch_triangles = scratch;
@@ -1159,9 +1718,11 @@ anv_cpu_build_acceleration_structures(
             pInfo->pGeometries ? &pInfo->pGeometries[g] :
                                  pInfo->ppGeometries[g];
 
+         uint32_t first_prim = prim_count;
          build_state.geometries[g] = (struct anv_bvh_build_geometry_state) {
             .pGeometry = pGeometry,
             .triangles = &scratch_triangles[prim_count],
+            .prims = &scratch_rtc_prims[prim_count],
          };
 
          switch (pGeometry->geometryType) {
@@ -1227,8 +1788,29 @@ anv_cpu_build_acceleration_structures(
          default:
             unreachable("Unimplemented");
          }
+         build_state.geometries[g].prim_count = prim_count - first_prim;
+      }
+
+      void *dst_map = anv_address_map(dst_accel->address);
+
+      if (pInfo->mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR) {
+         const void *src_map = anv_address_map(src_accel->address);
+         if (src_map != dst_map)
+            memcpy(dst_map, src_map, MIN2(src_accel->size, dst_accel->size));
+         if (refit_bvh(dst_map, &build_state)) {
+            if (pInfo->type == VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR)
+               gpgpusim_addTreelets(dst_map);
+            continue;
+         }
       }
 
+      char cache_path[PATH_MAX];
+      bool cached = anv_bvh_cache_path(pInfo, pBuildRangeInfos, &build_state,
+                                       scratch_rtc_prims, prim_count,
+                                       cache_path, sizeof(cache_path));
+      if (cached && anv_bvh_cache_load(cache_path, dst_map, dst_accel->size))
+         continue;
+
       RTCBVH rtc_bvh = rtcNewBVH(rtc);
 
       struct anv_bvh_node tmp_root;
@@ -1270,6 +1852,12 @@ anv_cpu_build_acceleration_structures(
          args.setNodeBounds = rtc_set_node_bounds_cb;
          args.createLeaf = rtc_create_leaf_cb;
          args.userPtr = &build_state;
+         args.buildQuality = anv_bvh_build_quality();
+         if (anv_bvh_split_factor(pInfo->type) > 1 &&
+             anv_bvh_splittable(pInfo, &build_state)) {
+            args.primitiveArrayCapacity = prim_capacity;
+            args.splitPrimitive = rtc_split_primitive_cb;
+         }
          root = rtcBuildBVH(&args);
       }
       assert(!root->is_leaf);
@@ -1277,27 +1865,26 @@ anv_cpu_build_acceleration_structures(
       UNUSED uint32_t root_type, root_size;
       node_type_size(root, &root_type, &root_size, &build_state);
 
-      void *dst_map = anv_address_map(dst_accel->address);
-
-      struct GEN_RT_BVH bvh = { };
-      bvh.RootNodeOffset = GEN_RT_BVH_length * 4;
-      uint8_t max_child_x = 0, max_child_y = 0, max_child_z = 0;
-      for (unsigned i = 0; i < 6; i++) {
-         max_child_x = MAX2(max_child_x, root->upper_x[i]);
-         max_child_y = MAX2(max_child_y, root->upper_y[i]);
-         max_child_z = MAX2(max_child_z, root->upper_z[i]);
-      }
-      bvh.BoundsMin.X = root->origin_x;
-      bvh.BoundsMin.Y = root->origin_y;
-      bvh.BoundsMin.Z = root->origin_z;
-      bvh.BoundsMax.X = root->origin_x + ldexpf(max_child_x, root->exp_x - 8);
-      bvh.BoundsMax.Y = root->origin_y + ldexpf(max_child_y, root->exp_y - 8);
-      bvh.BoundsMax.Z = root->origin_z + ldexpf(max_child_z, root->exp_z - 8);
-      GEN_RT_BVH_pack(NULL, dst_map, &bvh);
-
-      void *root_map = dst_map + bvh.RootNodeOffset;
+      void *root_map = dst_map + pack_bvh_header(root, dst_map);
       build_state.nodes_map = root_map + root_size * 64;
-      pack_node(root, true, root_map, &build_state);
+      switch (build_state.layout) {
+      case ANV_BVH_LAYOUT_DFS:
+         pack_node(root, true, root_map, &build_state);
+         break;
+      case ANV_BVH_LAYOUT_BFS:
+         pack_tree_clustered(root, root_map, UINT64_MAX, &build_state);
+         break;
+      case ANV_BVH_LAYOUT_TREELET:
+         pack_tree_clustered(root, root_map,
+                             env_var_as_unsigned("ANV_BVH_TREELET_BYTES",
+                                                 1024),
+                             &build_state);
+         break;
+      }
+      if (cached) {
+         anv_bvh_cache_store(cache_path, dst_map,
+                             build_state.nodes_map - dst_map);
+      }
       if (pInfo->type == VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR)
          gpgpusim_addTreelets(dst_map);
 
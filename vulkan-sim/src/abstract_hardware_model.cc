@@ -36,6 +36,7 @@
 #include "cuda-sim/memory.h"
 #include "cuda-sim/ptx-stats.h"
 #include "cuda-sim/ptx_ir.h"
+#include "cuda-sim/tracer_profile.h"
 #include "gpgpu-sim/gpu-sim.h"
 #include "gpgpusim_entrypoint.h"
 #include "option_parser.h"
@@ -211,6 +212,23 @@ void gpgpu_functional_sim_config::reg_options(class OptionParser *opp) {
   option_parser_register(
       opp, "-gpgpu_ptx_convert_to_ptxplus", OPT_BOOL, &m_ptx_convert_to_ptxplus,
       "Convert SASS (native ISA) to ptxplus and run ptxplus", "0");
+  option_parser_register(
+      opp, "-gpgpu_ptx_warp_alu", OPT_BOOL, &m_ptx_warp_alu,
+      "Execute the common ALU instructions once per warp rather than per "
+      "thread",
+      "1");
+  option_parser_register(
+      opp, "-gpgpu_ptx_warp_quantum", OPT_UINT32, &m_ptx_warp_quantum,
+      "Functional simulation runs the ready warps of a CTA from a queue, each "
+      "for up to this many instructions or until it reaches a barrier (0 = "
+      "one instruction per warp in turn)",
+      "0");
+  option_parser_register(
+      opp, "-gpgpu_ser", OPT_CSTR, &m_ptx_ser,
+      "Shader execution reordering of the hit and miss shaders, none or "
+      "<key s (shader) or m (material)>:<window warps, 0 = those of an SM>:"
+      "<bytes spilled per moved thread>",
+      "none");
   option_parser_register(opp, "-gpgpu_ptx_force_max_capability", OPT_UINT32,
                          &m_ptx_force_max_capability,
                          "Force maximum compute capability", "0");
@@ -836,10 +854,70 @@ void warp_inst_t::completed(unsigned long long cycle) const {
 
 /* Start of RT unit functions */
 
+void rt_access_stream::push_back(new_addr_type address, uint32_t size,
+                                 TransactionType type) {
+  RTMemoryTransactionRecord record(address, size, type);
+  if (!m_count) {
+    // nothing left to decode, start over
+    m_bytes.clear();
+    m_next = 0;
+    m_front = record;
+    m_last_address = address;
+    m_count = 1;
+    return;
+  }
+
+  m_bytes.push_back((uint8_t)type);
+  for (uint32_t v = size;; v >>= 7) {
+    if (v < 0x80) {
+      m_bytes.push_back((uint8_t)v);
+      break;
+    }
+    m_bytes.push_back((uint8_t)(v | 0x80));
+  }
+  int64_t delta = (int64_t)(address - m_last_address);
+  for (uint64_t v = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);;
+       v >>= 7) {
+    if (v < 0x80) {
+      m_bytes.push_back((uint8_t)v);
+      break;
+    }
+    m_bytes.push_back((uint8_t)(v | 0x80));
+  }
+  m_last_address = address;
+  m_count++;
+}
+
+void rt_access_stream::pop_front() {
+  assert(m_count);
+  if (--m_count) m_next = decode(m_next, m_front);
+}
+
+size_t rt_access_stream::decode(size_t pos,
+                                RTMemoryTransactionRecord &record) const {
+  TransactionType type = (TransactionType)m_bytes[pos++];
+  uint32_t size = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    uint8_t b = m_bytes[pos++];
+    size |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) break;
+  }
+  uint64_t v = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    uint8_t b = m_bytes[pos++];
+    v |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) break;
+  }
+  int64_t delta = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+  record = RTMemoryTransactionRecord(record.address + (new_addr_type)delta,
+                                     size, type);
+  return pos;
+}
+
 void warp_inst_t::print_rt_accesses() {
   for (unsigned i=0; i<m_config->warp_size; i++) {
     RT_DPRINTF("Thread %d: ", i);
-    for (auto it=m_per_scalar_thread[i].RT_mem_accesses.begin(); it!=m_per_scalar_thread[i].RT_mem_accesses.end(); it++) {
+    for (auto it=m_per_scalar_thread[i].RT_mem_accesses.begin(); it!=m_per_scalar_thread[i].RT_mem_accesses.end(); ++it) {
       RT_DPRINTF("0x%x\t", it->address);
     }
     RT_DPRINTF("\n");
@@ -931,7 +1009,7 @@ unsigned * warp_inst_t::get_latency_dist(unsigned i) {
   return (unsigned *)m_per_scalar_thread[i].status_num_cycles;
 }
 
-void warp_inst_t::set_rt_mem_transactions(unsigned int tid, std::vector<MemoryTransactionRecord> transactions) {
+void warp_inst_t::set_rt_mem_transactions(unsigned int tid, const std::vector<MemoryTransactionRecord> &transactions) {
   // Initialize
   if (!m_per_scalar_thread_valid) {
     m_per_scalar_thread.resize(m_config->warp_size);
@@ -940,12 +1018,11 @@ void warp_inst_t::set_rt_mem_transactions(unsigned int tid, std::vector<MemoryTr
   
   for (auto it=transactions.begin(); it!=transactions.end(); it++) {
     // Convert transaction type and add to thread
-    RTMemoryTransactionRecord mem_record(
+    m_per_scalar_thread[tid].RT_mem_accesses.push_back(
       (new_addr_type)it->address,
       it->size,
       it->type
     );
-    m_per_scalar_thread[tid].RT_mem_accesses.push_back(mem_record);
   }
 }
 
@@ -1076,6 +1153,27 @@ RTMemoryTransactionRecord warp_inst_t::get_next_rt_mem_transaction() {
   return next_access;
 }
 
+bool warp_inst_t::peek_next_rt_address(new_addr_type &addr) const {
+  // Queued accesses not sent yet
+  for (auto it=m_next_rt_accesses.begin(); it!=m_next_rt_accesses.end(); it++) {
+    if (m_next_rt_accesses_set.find(std::pair<new_addr_type, unsigned>(it->address, it->size)) != m_next_rt_accesses_set.end()) {
+      addr = it->address;
+      return true;
+    }
+  }
+  // Otherwise the first access update_next_rt_accesses would queue
+  for (unsigned i=0; i<m_config->warp_size; i++) {
+    if (!m_per_scalar_thread[i].RT_mem_accesses.empty()) {
+      const RTMemoryTransactionRecord &next_access = m_per_scalar_thread[i].RT_mem_accesses.front();
+      if (next_access.status == RTMemStatus::RT_MEM_UNMARKED && m_per_scalar_thread[i].intersection_delay == 0) {
+        addr = next_access.address;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 void warp_inst_t::undo_rt_access(new_addr_type addr){ 
   std::pair<new_addr_type, unsigned> address_size_pair (addr, 32);
   assert (m_next_rt_accesses_set.find(address_size_pair) == m_next_rt_accesses_set.end());
@@ -1149,11 +1247,12 @@ bool warp_inst_t::process_returned_mem_access(bool &mem_record_done, unsigned ti
         
         RT_DPRINTF("Thread %d collected all chunks for address 0x%x (size %d)\n", tid, mem_record.address, mem_record.size);
         RT_DPRINTF("Processing data of transaction type %d for %d cycles.\n", mem_record.type, n_delay_cycles);
+        TransactionType type = mem_record.type;
         m_per_scalar_thread[tid].RT_mem_accesses.pop_front();
         mem_record_done = true;
 
         // Mark triangle hit to store to memory
-        if (mem_record.type == TransactionType::BVH_QUAD_LEAF_HIT) {
+        if (type == TransactionType::BVH_QUAD_LEAF_HIT) {
           m_per_scalar_thread[tid].ray_intersect = true;
           RT_DPRINTF("Buffer store detected for warp %d thread %d\n", m_uid, tid);
         }
@@ -3041,17 +3140,25 @@ void simt_stack::update(simt_mask_t &thread_done, addr_vector_t &next_pc,
 
 void core_t::execute_warp_inst_t(warp_inst_t &inst, unsigned warpId) {
   const ptx_instruction *pI;
-  std::stringstream addr_str;
-  addr_str << std::hex;
   int mem_count;
   bool has_valid_addr = false;
-  
+  // the threads do the bookkeeping and warp_alu_exec the instruction for
+  // the lanes still active after their predicates
+  bool warp_alu = false;
+  bool warp_alu_checked = false;
+  active_mask_t alu_lanes;
+
   for (unsigned t = 0; t < m_warp_size; t++) {
     if (inst.active(t)) {
       if (warpId == (unsigned(-1))) warpId = inst.warp_id();
       unsigned tid = m_warp_size * warpId + t;
       pI = m_thread[tid]->func_info()->get_instruction(inst.pc);
-      m_thread[tid]->ptx_exec_inst(inst, t);
+      if (!warp_alu_checked) {
+        warp_alu = warp_alu_enabled(pI, m_gpu->get_config());
+        warp_alu_checked = true;
+      }
+      m_thread[tid]->ptx_exec_inst(inst, t, warp_alu);
+      if (warp_alu && inst.active(t)) alu_lanes.set(t);
       mem_count = m_thread[tid]->m_last_effective_addresses.size();
       if (pI->get_opcode() == LOAD_FIRST_VERTEX_OP ||
           pI->get_opcode() == LOAD_VERTEX_ID_ZERO_BASE_OP ||
@@ -3067,254 +3174,55 @@ void core_t::execute_warp_inst_t(warp_inst_t &inst, unsigned warpId) {
       checkExecutionStatusAndUpdate(inst, t, tid);
     }
   }
+  if (alu_lanes.any())
+    warp_alu_exec(pI, &m_thread[m_warp_size * warpId], alu_lanes);
   // print out ptx traces
   assert(pI);
-  std::stringstream active_string, pc_string, sass,inreg,outreg;
-  active_string << std::setfill('0') << std::setw(8) << std::hex
-                << inst.get_warp_active_mask().to_ulong();
-  pc_string << std::hex << std::setfill('0') << std::setw(4) << inst.pc;
-  // m_gpu->gtrace << pI->get_source() << std::endl;
-  sass << inst.dynamic_warp_id() << ", ";
-  sass << pc_string.str() << " " << active_string.str() << " ";
-
-  // output reg
-  sass << inst.outcount << " ";
-  for (int i = 0; i < inst.outcount; i++) {
-    sass << "R" << inst.out[i] << " ";
-  }
-  // opcode
-  switch (pI->get_opcode()) {
-    // ignored
-    case LD_RAY_LAUNCH_ID_OP...RT_ALLOC_MEM_OP:
-    case WRAP_32_4_OP...CALL_ANY_HIT_SHADER_OP:
-      return;
-    default:
-      break;
+  tracer_timer timer(TRACER_TRACE_FORMAT);
+  if (pI->trace_kind() == ptx_instruction::TRACE_IGNORED) return;
+  if (pI->trace_kind() == ptx_instruction::TRACE_UNKNOWN) {
+    // implement this
+    printf("ERROR: opcode %u not implemented\n", pI->get_opcode());
+    fflush(stdout);
+    assert(0);
+    return;
   }
-  switch (pI->get_opcode()) {
-    case LOAD_FIRST_VERTEX_OP:
-    case LOAD_VERTEX_ID_ZERO_BASE_OP:
-    case LOAD_BASE_INSTANCE_OP:
-    case LOAD_INSTANCE_ID_OP:
-    case LOAD_FRAG_COORD_OP:
-    case LOAD_FRONT_FACE_OP: {
-      // constant space
-      sass << "LDC";
-      break;
-    }
-    case LD_OP: {
-      switch(pI->get_space().get_type()) {
-        case const_space:
-          sass << "LDC";
-          break;
-        case global_space:
-          sass << "LD.SYS";
-          break;
-        case local_space:
-          sass << "LDL";
-          break;
-        case shared_space:
-          sass << "LDS";
-          break;
-        default:
-          assert(0);
-      }
-      break;
-    }
-    case ST_OP: {
-      sass << "ST.SYS";
-      break;
-    }
-    case SETP_OP: {
-      unsigned cmpop = pI->get_cmpop();
-      unsigned i_type = pI->get_type();
-      if (i_type == S32_TYPE) {
-        sass << "ISETP";
-      } else if (i_type == U32_TYPE) {
-        sass << "ISETP";
-      }else if (i_type == F32_TYPE) {
-        sass << "FSETP";
-      }
-      switch (cmpop) {
-        case NE_OPTION:
-          // NE
-          // Not sure how to include the header here to use enum
-          sass << ".NE.AND";
-          break;
-        case LE_OPTION:
-          sass << ".LE.AND";
-          break;
-        case EQ_OPTION:
-          sass << ".EQ.AND";
-          break;
-        case LT_OPTION:
-          sass << ".LT.AND";
-          break;
-        case GE_OPTION:
-          sass << ".GE.AND";
-          break;
-        default:
-          assert(0);
-      }
-      break;
-    }
-    case RET_OP:
-    case DISCARD_IF_OP:
-    case EXIT_OP: {
-      sass << "EXIT";
-      break;
-    }
-    case MUL_OP:
-    {
-      unsigned i_type = pI->get_type();
-      if (i_type == F32_TYPE) {
-        sass << "FMUL";
-      } else if (i_type == U32_TYPE) {
-        sass << "IMUL";
-      } else if (i_type == S32_TYPE) {
-        sass << "IMUL";
-      } else {
-        assert(0);
-      }
-      break;
-    }
-    case MAD_OP: {
-      unsigned i_type = pI->get_type();
-      if (i_type == F32_TYPE) {
-        sass << "FFMA";
-      } else {
-        assert(0);
-      }
-      break;
-    }
-    case ADD_OP:
-    case SUB_OP: {
-      unsigned i_type = pI->get_type();
-      if (i_type == F32_TYPE) {
-        sass << "FADD";
-      } else if (i_type == U64_TYPE || i_type == U32_TYPE || i_type == S32_TYPE) {
-        sass << "IADD";
-      }
-      else {
-        assert(0);
-      }
-      break;
-    }
-    case MOV_OP: {
-      sass << "MOV";
-      break;
-    }
-    case TXL_OP:
-    case TEX_OP: {
-      sass << "TEX";
-      break;
-    }
-    
-    case RCP_OP: {
-      sass << "MUFU.RCP";
-      break;
-    }
-    case RSQRT_OP: {
-      sass << "MUFU.SQRT";
-      break;
-    }
-    case MAX_OP:
-    case MIN_OP: {
-      unsigned i_type = pI->get_type();
-      if (i_type == F32_TYPE) {
-        sass << "FMNMX";
-      } else {
-        assert(0);
-      }
-      break;
-    }
-    case SET_OP: {
-       if (pI->get_type() == F32_TYPE) {
-        sass << "FSET";
-       } else {
-        sass << "ISET";
-       }
-       break;
-    }
-    case SHR_OP: {
-      sass << "SHR";
-      break;
-    }
-    case CVT_OP: {
-      unsigned to_type = pI->get_type();
-      unsigned from_type = pI->get_type2();
-      unsigned rounding_mode = pI->rounding_mode();
-      if (to_type == F32_TYPE && from_type == F32_TYPE) {
-        sass << "F2F";
-      } else if (to_type == F32_TYPE && from_type == S32_TYPE) {
-        sass << "I2F";
-      } else if (to_type == F32_TYPE && from_type == U32_TYPE) {
-        sass << "I2F";
-      } else if (to_type == U32_TYPE && from_type == F32_TYPE) {
-        sass << "F2I";
-      } else if (to_type == U32_TYPE && from_type == S32_TYPE) {
-        sass << "I2I";
-      } else if (to_type == U32_TYPE && from_type == U32_TYPE) {
-        sass << "I2I";
-      } else {
-        assert(0);
+  char active_string[32];
+  snprintf(active_string, sizeof(active_string), "%08lx",
+           inst.get_warp_active_mask().to_ulong());
+  std::string sass = pI->trace_pc() + " " + active_string + " ";
+  char addr[32];
+
+  // traceRayEXT: per active thread the number of 32B BVH fetches, then the
+  // fetches in traversal order, bit 0 set on primitive fetches
+  if (pI->trace_kind() == ptx_instruction::TRACE_RAY_INST) {
+    sass += pI->trace_regs();
+    for (unsigned t = 0; t < m_warp_size; t++) {
+      if (!inst.active(t)) continue;
+      std::vector<new_addr_type> fetches;
+      const auto &info = inst.get_thread_info(t);
+      for (const auto &record : info.RT_mem_accesses) {
+        if (record.type == TransactionType::Intersection_Table_Load) continue;
+        bool primitive =
+            record.type == TransactionType::BVH_PRIMITIVE_LEAF_DESCRIPTOR ||
+            record.type == TransactionType::BVH_QUAD_LEAF ||
+            record.type == TransactionType::BVH_QUAD_LEAF_HIT ||
+            record.type == TransactionType::BVH_PROCEDURAL_LEAF;
+        for (unsigned c = 0; c < (record.size + 31) / 32; c++) {
+          fetches.push_back(((record.address + c * 32) & ~(new_addr_type)31) |
+                            (primitive ? 1 : 0));
+        }
       }
-      break;
-    }
-    case NEG_OP:
-    case SIN_OP:
-    case COS_OP:
-    case LG2_OP:
-    case EX2_OP:
-    case FDDX_OP:
-    case FDDY_OP:
-    case EXTRACT_U8_OP:
-    case SQRT_OP: {
-      sass << "MUFU";
-      break;
-    }
-    case BRA_OP: {
-      sass << "BRA";
-      break;
-    }
-    case ABS_OP: {
-      unsigned i_type = pI->get_type();
-      if (i_type == F32_TYPE) {
-        sass << "MUFU";
-      } else if (i_type == S32_TYPE) {
-        sass << "IABS";
-      } else {
-        assert(0);
+      sass += std::to_string(fetches.size()) + " ";
+      for (new_addr_type fetch : fetches) {
+        snprintf(addr, sizeof(addr), "0x%llx ", (unsigned long long)fetch);
+        sass += addr;
       }
-      break;
-    }
-    case AND_OP:
-    case SHL_OP: 
-    case OR_OP: 
-    case NOT_OP:
-    {
-      sass << "LOP";
-      break;
     }
-    case SELP_OP: {
-      sass << "R2P";
-      break;
-    }
-
-    default:
-      // implement this
-      printf("ERROR: opcode %u not implemented\n", pI->get_opcode());
-      fflush(stdout);
-      assert(0);
-      break;
+    m_gpu->trace_inst(inst.dynamic_warp_id(), sass);
+    return;
   }
-  sass << " ";
 
-  // input reg
-  sass << inst.incount << " ";
-  for (int i = 0; i < inst.incount; i++) {
-    sass << "R" << inst.in[i] << " ";
-  }
   // mem
   switch (pI->get_opcode()) {
     case LOAD_FIRST_VERTEX_OP:
@@ -3325,69 +3233,39 @@ void core_t::execute_warp_inst_t(warp_inst_t &inst, unsigned warpId) {
     case LOAD_FRONT_FACE_OP:
     case LD_OP:
     case ST_OP:
+      // 4 byte/thread, no compression
+      sass += pI->trace_regs();
+      sass += "4 0 ";
       for (unsigned t = 0; t < m_warp_size; t++) {
         if (inst.active(t)) {
           unsigned tid = m_warp_size * warpId + t;
-          addr_str << "0x" << m_thread[tid]->last_eaddr() << " ";
-          if(!has_valid_addr) {
-            for (const auto &start : m_gpu->valid_addr_start) {
-              uint64_t end = m_gpu->valid_addr_end.at(start.first);
-              if (start.second <= m_thread[tid]->last_eaddr() &&
-                  end >= m_thread[tid]->last_eaddr()) {
-                has_valid_addr = true;
-                break;
-              }
-            }
+          snprintf(addr, sizeof(addr), "0x%llx ",
+                   (unsigned long long)m_thread[tid]->last_eaddr());
+          sass += addr;
+          if (!has_valid_addr &&
+              m_gpu->valid_addr(m_thread[tid]->last_eaddr())) {
+            has_valid_addr = true;
           }
         }
       }
-      // 4 byte/thread, no compression
-      sass << "4 0 " << addr_str.str();
       break;
     case TEX_OP:
     case TXL_OP:
-      // tex has muptiple mem addr
+      // tex has muptiple mem addr, a line each
       for (int i = 0; i < mem_count; i++) {
-        std::stringstream tex_addr;
-        tex_addr << std::hex;
+        std::string tex = sass + "1 R" + std::to_string(inst.in[i]) + " TEX " +
+                          pI->trace_tex_regs() + "4 0 ";
         for (unsigned t = 0; t < m_warp_size; t++) {
           if (inst.active(t)) {
             unsigned tid = m_warp_size * warpId + t;
             // assert(mem_count ==
             //        m_thread[tid]->m_last_effective_address.getCount());
-            tex_addr << "0x" << m_thread[tid]->last_eaddrs()[i] << " ";
-          }
-        }
-        m_gpu->gtrace << inst.dynamic_warp_id() << ", ";
-        m_gpu->gtrace << pc_string.str() << " " << active_string.str() << " ";
-        m_gpu->gtrace << "1 " << "R" << inst.in[i] << " ";
-        m_gpu->gtrace << "TEX" << " ";
-        // can remove the else branch actually. But I'm lazy
-        if (inst.incount > 4) {
-          unsigned in = inst.incount;
-          std::unordered_map<unsigned, unsigned> map;
-          unsigned in_reg[4];
-          for (unsigned i = 0; i < in; i++) {
-            if (map.find(inst.in[i]) == map.end()) {
-              in_reg[map.size()] = inst.in[i];
-              map[inst.in[i]] = -1;
-            }
-          }
-          // print all in_reg
-          m_gpu->gtrace << map.size() << " ";
-          for (int i = 0; i < map.size(); i++) {
-            m_gpu->gtrace << "R" << in_reg[i] << " ";
-          }
-          m_gpu->gtrace << "4 0 " << tex_addr.str();
-          m_gpu->gtrace << std::endl;
-        } else {
-          m_gpu->gtrace << inst.incount << " ";
-          for (int i = 0; i < inst.incount; i++) {
-            m_gpu->gtrace << "R" << inst.in[i] << " ";
+            snprintf(addr, sizeof(addr), "0x%llx ",
+                     (unsigned long long)m_thread[tid]->last_eaddrs()[i]);
+            tex += addr;
           }
-          m_gpu->gtrace << "4 0 " << tex_addr.str();
-          m_gpu->gtrace << std::endl;
         }
+        m_gpu->trace_inst(inst.dynamic_warp_id(), tex);
       }
       break;
     default:
@@ -3395,21 +3273,20 @@ void core_t::execute_warp_inst_t(warp_inst_t &inst, unsigned warpId) {
       // can't be load or store, ld/st must have addr
       assert(!pI->is_load());
       assert(!pI->is_store());
-      sass << "0 ";
+      sass += pI->trace_regs();
+      sass += "0 ";
   }
   switch (pI->get_opcode()) {
     case LD_OP:
     case ST_OP:
       if (!has_valid_addr) {
         // no valid addr, don't print
-        // std::cout << sass.str() << std::endl;
         return;
       }
   }
   if (pI->get_opcode() != TEX_OP && pI->get_opcode() != TXL_OP) {
     // TEX has multiple addrs. handled seperately
-    m_gpu->gtrace << sass.str();
-    m_gpu->gtrace << std::endl;
+    m_gpu->trace_inst(inst.dynamic_warp_id(), sass);
   }
 }
 
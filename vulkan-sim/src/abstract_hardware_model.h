@@ -702,6 +702,9 @@ class gpgpu_functional_sim_config {
   bool convert_to_ptxplus() const { return m_ptx_convert_to_ptxplus; }
   bool use_cuobjdump() const { return m_ptx_use_cuobjdump; }
   bool experimental_lib_support() const { return m_experimental_lib_support; }
+  bool warp_alu() const { return m_ptx_warp_alu; }
+  unsigned warp_quantum() const { return m_ptx_warp_quantum; }
+  const char *ser() const { return m_ptx_ser; }
 
   int get_ptx_inst_debug_to_file() const { return g_ptx_inst_debug_to_file; }
   const char *get_ptx_inst_debug_file() const { return g_ptx_inst_debug_file; }
@@ -723,6 +726,9 @@ class gpgpu_functional_sim_config {
   int m_ptx_convert_to_ptxplus;
   int m_ptx_use_cuobjdump;
   int m_experimental_lib_support;
+  int m_ptx_warp_alu;
+  unsigned m_ptx_warp_quantum;
+  char *m_ptx_ser;
   unsigned m_ptx_force_max_capability;
   int checkpoint_option;
   int checkpoint_kernel;
@@ -779,6 +785,9 @@ class gpgpu_t {
   void *gpu_mallocarray(size_t count);
   void gpu_memset(size_t dst_start_addr, int c, size_t count);
   void memcpy_to_gpu(size_t dst_start_addr, const void *src, size_t count);
+  // memcpy_to_gpu without the copy: global memory reads src in place, so it
+  // must stay valid and unchanged until the range is written or remapped
+  void map_to_gpu(size_t dst_start_addr, const void *src, size_t count);
   void memcpy_from_gpu(void *dst, size_t src_start_addr, size_t count);
   void memcpy_gpu_to_gpu(size_t dst, size_t src, size_t count);
 
@@ -1261,6 +1270,88 @@ typedef struct RTMemoryTransactionRecord {
     }
 } RTMemoryTransactionRecord;
 
+// The BVH accesses of one ray in traversal order
+//
+// A traversal makes tens to hundreds of accesses mostly to nodes close to
+// the previous one, and the list travels with the warp_inst_t through every
+// pipeline register copy and into the ray coherence engine. Each access is
+// kept as a type tag, the size and the zigzag LEB128 delta of its address to
+// the previous one, a few bytes instead of a deque entry. Only the front
+// access is decoded, into a record whose status and outstanding chunks the
+// rt_unit updates in place; pop_front moves the cursor to the next one.
+class rt_access_stream {
+ public:
+  class const_iterator {
+   public:
+    const RTMemoryTransactionRecord &operator*() const { return m_record; }
+    const RTMemoryTransactionRecord *operator->() const { return &m_record; }
+    const_iterator &operator++() {
+      if (--m_left) m_pos = m_stream->decode(m_pos, m_record);
+      return *this;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return m_left != other.m_left;
+    }
+    bool operator==(const const_iterator &other) const {
+      return m_left == other.m_left;
+    }
+
+   private:
+    friend class rt_access_stream;
+    const rt_access_stream *m_stream;
+    size_t m_pos;
+    unsigned m_left;
+    RTMemoryTransactionRecord m_record;
+  };
+
+  rt_access_stream() : m_count(0), m_next(0), m_last_address(0) {}
+
+  void push_back(new_addr_type address, uint32_t size, TransactionType type);
+  void pop_front();
+  void clear() {
+    m_bytes.clear();
+    m_count = 0;
+    m_next = 0;
+    m_last_address = 0;
+  }
+  bool empty() const { return m_count == 0; }
+  unsigned size() const { return m_count; }
+  RTMemoryTransactionRecord &front() {
+    assert(m_count);
+    return m_front;
+  }
+  const RTMemoryTransactionRecord &front() const {
+    assert(m_count);
+    return m_front;
+  }
+  const_iterator begin() const {
+    const_iterator it;
+    it.m_stream = this;
+    it.m_pos = m_next;
+    it.m_left = m_count;
+    if (m_count) it.m_record = m_front;
+    return it;
+  }
+  const_iterator end() const {
+    const_iterator it;
+    it.m_stream = this;
+    it.m_pos = m_bytes.size();
+    it.m_left = 0;
+    return it;
+  }
+
+ private:
+  // decodes the access at pos that follows record into record, returns the
+  // position of the one after it
+  size_t decode(size_t pos, RTMemoryTransactionRecord &record) const;
+
+  std::vector<uint8_t> m_bytes;
+  unsigned m_count;  // accesses left, the front one included
+  size_t m_next;     // position of the access after the front one
+  new_addr_type m_last_address;  // of the last access pushed
+  RTMemoryTransactionRecord m_front;
+};
+
 class warp_inst_t : public inst_t {
  public:
   // constructors
@@ -1471,7 +1562,7 @@ class warp_inst_t : public inst_t {
                                                        // of 4B each)
                                                    
     // RT variables    
-    std::deque<RTMemoryTransactionRecord> RT_mem_accesses;
+    rt_access_stream RT_mem_accesses;
     std::vector<MemoryStoreTransactionRecord> RT_store_transactions;
     bool ray_intersect = false;
     Ray ray_properties;
@@ -1485,7 +1576,7 @@ class warp_inst_t : public inst_t {
   };
   
   // RT functions
-  void set_rt_mem_transactions(unsigned int tid, std::vector<MemoryTransactionRecord> transactions);
+  void set_rt_mem_transactions(unsigned int tid, const std::vector<MemoryTransactionRecord> &transactions);
   void set_rt_mem_store_transactions(unsigned int tid, std::vector<MemoryStoreTransactionRecord>& transactions);
   void set_rt_ray_properties(unsigned int tid, Ray ray);
   bool get_rt_ray_intersect(unsigned int tid) const { return m_per_scalar_thread[tid].ray_intersect; }
@@ -1493,7 +1584,7 @@ class warp_inst_t : public inst_t {
   bool rt_mem_accesses_empty();
   bool rt_intersection_delay_done();
   bool has_pending_writes() { return !m_pending_writes.empty(); }
-  bool rt_mem_accesses_empty(unsigned int tid) { return m_per_scalar_thread[tid].RT_mem_accesses.empty(); };
+  bool rt_mem_accesses_empty(unsigned int tid) const { return m_per_scalar_thread[tid].RT_mem_accesses.empty(); };
   bool is_stalled();
   void undo_rt_access(new_addr_type addr);
   void print_rt_accesses();
@@ -1505,12 +1596,15 @@ class warp_inst_t : public inst_t {
   
   void update_next_rt_accesses();
   RTMemoryTransactionRecord get_next_rt_mem_transaction();
+  // the address get_next_rt_mem_transaction would most likely return, without
+  // taking it; false when no access is ready
+  bool peek_next_rt_address(new_addr_type &addr) const;
   void num_unique_mem_access(std::map<new_addr_type, unsigned> &addr_set);
   unsigned process_returned_mem_access(const mem_fetch *mf);
   bool process_returned_mem_access(const mem_fetch *mf, unsigned tid);
   bool process_returned_mem_access(bool &mem_record_done, unsigned tid, new_addr_type addr, new_addr_type uncoalesced_base_addr);
   
-  struct per_thread_info get_thread_info(unsigned tid) { return m_per_scalar_thread[tid]; }
+  const struct per_thread_info &get_thread_info(unsigned tid) const { return m_per_scalar_thread[tid]; }
   void set_thread_info(unsigned tid, struct per_thread_info thread_info) { m_per_scalar_thread[tid] = thread_info; }
   void clear_thread_info(unsigned tid) { m_per_scalar_thread[tid].clear_mem_accesses(); }
   unsigned get_thread_latency(unsigned tid) const { return m_per_scalar_thread[tid].intersection_delay; }
@@ -0,0 +1,101 @@
+// Decoded ASTC blocks of the sampled textures
+//
+// load_image_pixel decodes the whole 8x8 block for every texel it fetches,
+// and a bilinear or trilinear sample fetches up to 8 texels mostly of the
+// same block. The cache keeps the last ASTC_CACHE_BLOCKS (environment,
+// default 4096, 0 disables it) decoded blocks in LRU order, keyed by the
+// address of the encoded block, which tells the image, the level and the
+// block apart. The encoded bytes are kept with the entry and compared on a
+// hit, so a texture rewritten in place is decoded again.
+
+#ifndef ASTC_BLOCK_CACHE_H
+#define ASTC_BLOCK_CACHE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <list>
+#include <unordered_map>
+
+#include "astc_decomp.h"
+
+class astc_block_cache {
+ public:
+  static const unsigned BLOCK_BYTES = 16;
+  static const unsigned DECODED_BYTES = 8 * 8 * 4;
+
+  astc_block_cache() {
+    char const *env = getenv("ASTC_CACHE_BLOCKS");
+    m_capacity = env ? strtoul(env, NULL, 0) : 4096;
+    m_hits = 0;
+    m_misses = 0;
+    pthread_mutex_init(&m_lock, NULL);
+  }
+
+  // the 8x8 RGBA8 texels of the sRGB 8x8 block at data into dst, false on
+  // a decoding error
+  bool decode(uint8_t *dst, const uint8_t *data) {
+    if (!m_capacity) return basisu::astc::decompress(dst, data, true, 8, 8);
+    pthread_mutex_lock(&m_lock);
+    auto i = m_index.find(data);
+    if (i != m_index.end() &&
+        !memcmp(i->second->encoded, data, BLOCK_BYTES)) {
+      m_lru.splice(m_lru.begin(), m_lru, i->second);
+      memcpy(dst, i->second->decoded, DECODED_BYTES);
+      m_hits++;
+      pthread_mutex_unlock(&m_lock);
+      return true;
+    }
+    m_misses++;
+    pthread_mutex_unlock(&m_lock);
+
+    if (!basisu::astc::decompress(dst, data, true, 8, 8)) return false;
+
+    pthread_mutex_lock(&m_lock);
+    i = m_index.find(data);
+    if (i == m_index.end()) {
+      if (m_index.size() >= m_capacity) {
+        m_index.erase(m_lru.back().address);
+        m_lru.pop_back();
+      }
+      m_lru.push_front(entry());
+      i = m_index.insert(std::make_pair(data, m_lru.begin())).first;
+    } else {
+      m_lru.splice(m_lru.begin(), m_lru, i->second);
+    }
+    entry &e = *i->second;
+    e.address = data;
+    memcpy(e.encoded, data, BLOCK_BYTES);
+    memcpy(e.decoded, dst, DECODED_BYTES);
+    pthread_mutex_unlock(&m_lock);
+    return true;
+  }
+
+  void print_stats(FILE *fout) {
+    pthread_mutex_lock(&m_lock);
+    unsigned long long lookups = m_hits + m_misses;
+    fprintf(fout, "astc_block_cache: %llu lookups, %llu hits (%.2f%%), %zu "
+            "of %zu blocks\n",
+            lookups, m_hits, lookups ? 100.0 * m_hits / lookups : 0.0,
+            m_index.size(), m_capacity);
+    pthread_mutex_unlock(&m_lock);
+  }
+
+ private:
+  struct entry {
+    const uint8_t *address;
+    uint8_t encoded[BLOCK_BYTES];
+    uint8_t decoded[DECODED_BYTES];
+  };
+
+  size_t m_capacity;
+  std::list<entry> m_lru;  // most recently used first
+  std::unordered_map<const uint8_t *, std::list<entry>::iterator> m_index;
+  unsigned long long m_hits;
+  unsigned long long m_misses;
+  pthread_mutex_t m_lock;
+};
+
+#endif
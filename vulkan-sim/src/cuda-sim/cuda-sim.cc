@@ -52,6 +52,7 @@ typedef void *yyscan_t;
 #include "ptx_loader.h"
 #include "ptx_parser.h"
 #include "ptx_sim.h"
+#include "tracer_profile.h"
 
 int g_debug_execution = 0;
 // Output debug information to file options
@@ -482,9 +483,7 @@ void gpgpu_t::memcpy_to_gpu(size_t dst_start_addr, const void *src,
         count, (unsigned long long)src, (unsigned long long)dst_start_addr);
     fflush(stdout);
   }
-  char *src_data = (char *)src;
-  for (unsigned n = 0; n < count; n++)
-    m_global_mem->write(dst_start_addr + n, 1, src_data + n, NULL, NULL);
+  m_global_mem->write(dst_start_addr, count, src, NULL, NULL);
 
   // Copy into the performance model.
   // extern gpgpu_sim* g_the_gpu;
@@ -495,6 +494,23 @@ void gpgpu_t::memcpy_to_gpu(size_t dst_start_addr, const void *src,
   }
 }
 
+void gpgpu_t::map_to_gpu(size_t dst_start_addr, const void *src,
+                         size_t count) {
+  if (g_debug_execution >= 3) {
+    printf(
+        "GPGPU-Sim PTX: mapping %zu bytes from CPU[0x%Lx] to GPU[0x%Lx] ... ",
+        count, (unsigned long long)src, (unsigned long long)dst_start_addr);
+    fflush(stdout);
+  }
+  m_global_mem->map_host(dst_start_addr, count, src);
+
+  gpgpu_ctx->the_gpgpusim->g_the_gpu->perf_memcpy_to_gpu(dst_start_addr, count);
+  if (g_debug_execution >= 3) {
+    printf(" done.\n");
+    fflush(stdout);
+  }
+}
+
 void gpgpu_t::memcpy_from_gpu(void *dst, size_t src_start_addr, size_t count) {
   if (g_debug_execution >= 3) {
     printf("GPGPU-Sim PTX: copying %zu bytes from GPU[0x%Lx] to CPU[0x%Lx] ...",
@@ -1322,9 +1338,224 @@ void ptx_instruction::pre_decode() {
   // get reconvergence pc
   reconvergence_pc = gpgpu_ctx->func_sim->get_converge_point(pc);
 
+  m_warp_alu_op = warp_alu_decode(this);
+  trace_decode();
+
   m_decoded = true;
 }
 
+// the SASS opcode the trace gives the instruction, false when it has none
+static bool trace_sass_opcode(const ptx_instruction *pI, std::string &sass) {
+  unsigned i_type = pI->get_type();
+  switch (pI->get_opcode()) {
+    case LOAD_FIRST_VERTEX_OP:
+    case LOAD_VERTEX_ID_ZERO_BASE_OP:
+    case LOAD_BASE_INSTANCE_OP:
+    case LOAD_INSTANCE_ID_OP:
+    case LOAD_FRAG_COORD_OP:
+    case LOAD_FRONT_FACE_OP:
+      // constant space
+      sass = "LDC";
+      break;
+    case LD_OP:
+      switch (pI->get_space().get_type()) {
+        case const_space:
+          sass = "LDC";
+          break;
+        case global_space:
+          sass = "LD.SYS";
+          break;
+        case local_space:
+          sass = "LDL";
+          break;
+        case shared_space:
+          sass = "LDS";
+          break;
+        default:
+          return false;
+      }
+      break;
+    case ST_OP:
+      sass = "ST.SYS";
+      break;
+    case SETP_OP:
+      if (i_type == S32_TYPE || i_type == U32_TYPE)
+        sass = "ISETP";
+      else if (i_type == F32_TYPE)
+        sass = "FSETP";
+      switch (pI->get_cmpop()) {
+        case NE_OPTION:
+          sass += ".NE.AND";
+          break;
+        case LE_OPTION:
+          sass += ".LE.AND";
+          break;
+        case EQ_OPTION:
+          sass += ".EQ.AND";
+          break;
+        case LT_OPTION:
+          sass += ".LT.AND";
+          break;
+        case GE_OPTION:
+          sass += ".GE.AND";
+          break;
+        default:
+          return false;
+      }
+      break;
+    case RET_OP:
+    case DISCARD_IF_OP:
+    case EXIT_OP:
+      sass = "EXIT";
+      break;
+    case MUL_OP:
+      if (i_type == F32_TYPE)
+        sass = "FMUL";
+      else if (i_type == U32_TYPE || i_type == S32_TYPE)
+        sass = "IMUL";
+      else
+        return false;
+      break;
+    case MAD_OP:
+      if (i_type != F32_TYPE) return false;
+      sass = "FFMA";
+      break;
+    case ADD_OP:
+    case SUB_OP:
+      if (i_type == F32_TYPE)
+        sass = "FADD";
+      else if (i_type == U64_TYPE || i_type == U32_TYPE || i_type == S32_TYPE)
+        sass = "IADD";
+      else
+        return false;
+      break;
+    case MOV_OP:
+      sass = "MOV";
+      break;
+    case TXL_OP:
+    case TEX_OP:
+      sass = "TEX";
+      break;
+    case RCP_OP:
+      sass = "MUFU.RCP";
+      break;
+    case RSQRT_OP:
+      sass = "MUFU.SQRT";
+      break;
+    case MAX_OP:
+    case MIN_OP:
+      if (i_type != F32_TYPE) return false;
+      sass = "FMNMX";
+      break;
+    case SET_OP:
+      sass = i_type == F32_TYPE ? "FSET" : "ISET";
+      break;
+    case SHR_OP:
+      sass = "SHR";
+      break;
+    case CVT_OP: {
+      unsigned from_type = pI->get_type2();
+      bool from_int = from_type == S32_TYPE || from_type == U32_TYPE;
+      if (i_type == F32_TYPE && from_type == F32_TYPE)
+        sass = "F2F";
+      else if (i_type == F32_TYPE && from_int)
+        sass = "I2F";
+      else if (i_type == U32_TYPE && from_type == F32_TYPE)
+        sass = "F2I";
+      else if (i_type == U32_TYPE && from_int)
+        sass = "I2I";
+      else
+        return false;
+      break;
+    }
+    case NEG_OP:
+    case SIN_OP:
+    case COS_OP:
+    case LG2_OP:
+    case EX2_OP:
+    case FDDX_OP:
+    case FDDY_OP:
+    case EXTRACT_U8_OP:
+    case SQRT_OP:
+      sass = "MUFU";
+      break;
+    case BRA_OP:
+      sass = "BRA";
+      break;
+    case ABS_OP:
+      if (i_type == F32_TYPE)
+        sass = "MUFU";
+      else if (i_type == S32_TYPE)
+        sass = "IABS";
+      else
+        return false;
+      break;
+    case AND_OP:
+    case SHL_OP:
+    case OR_OP:
+    case NOT_OP:
+      sass = "LOP";
+      break;
+    case SELP_OP:
+      sass = "R2P";
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+static void trace_append_regs(std::string &line, unsigned count,
+                              const unsigned *regs) {
+  line += std::to_string(count) + " ";
+  for (unsigned i = 0; i < count; i++)
+    line += "R" + std::to_string(regs[i]) + " ";
+}
+
+void ptx_instruction::trace_decode() {
+  char pc_string[32];
+  snprintf(pc_string, sizeof(pc_string), "%04x", (unsigned)pc);
+  m_trace_pc = pc_string;
+  m_trace_regs.clear();
+  m_trace_tex_regs.clear();
+
+  switch (get_opcode()) {
+    case LD_RAY_LAUNCH_ID_OP... RT_ALLOC_MEM_OP:
+    case WRAP_32_4_OP... CALL_ANY_HIT_SHADER_OP:
+      m_trace_kind = TRACE_IGNORED;
+      break;
+    default:
+      m_trace_kind = TRACE_INST;
+  }
+  std::string sass;
+  if (get_opcode() == TRACE_RAY_OP) {
+    m_trace_kind = TRACE_RAY_INST;
+    sass = "TRACE_RAY";
+  } else if (m_trace_kind == TRACE_INST && !trace_sass_opcode(this, sass)) {
+    m_trace_kind = TRACE_UNKNOWN;
+  }
+  if (m_trace_kind == TRACE_IGNORED || m_trace_kind == TRACE_UNKNOWN) return;
+
+  trace_append_regs(m_trace_regs, outcount, out);
+  m_trace_regs += sass;
+  m_trace_regs += " ";
+  trace_append_regs(m_trace_regs, incount, in);
+  if (m_trace_kind == TRACE_RAY_INST) m_trace_regs += "32 3 ";
+
+  if (get_opcode() == TEX_OP || get_opcode() == TXL_OP) {
+    if (incount > 4) {
+      // each register once
+      std::vector<unsigned> regs;
+      for (unsigned i = 0; i < incount; i++)
+        if (std::find(regs.begin(), regs.end(), in[i]) == regs.end())
+          regs.push_back(in[i]);
+      trace_append_regs(m_trace_tex_regs, regs.size(), regs.data());
+    } else {
+      trace_append_regs(m_trace_tex_regs, incount, in);
+    }
+  }
+}
+
 void ptx_instruction::set_input_output_registers() {
   unsigned num_operands = get_num_operands();
   std::list<unsigned> operand_classification;
@@ -1900,7 +2131,8 @@ int tensorcore_op(int inst_opcode) {
   else
     return 0;
 }
-void ptx_thread_info::ptx_exec_inst(warp_inst_t &inst, unsigned lane_id) {
+void ptx_thread_info::ptx_exec_inst(warp_inst_t &inst, unsigned lane_id,
+                                    bool warp_alu) {
   bool skip = false;
   int op_classification = 0;
   addr_t pc = next_instr();
@@ -1973,7 +2205,7 @@ void ptx_thread_info::ptx_exec_inst(warp_inst_t &inst, unsigned lane_id) {
         switch (inst_opcode) {
 #define OP_DEF(OP, FUNC, STR, DST, CLASSIFICATION) \
   case OP:                                         \
-    FUNC(pI, this);                                \
+    if (!warp_alu) FUNC(pI, this);                 \
     op_classification = CLASSIFICATION;            \
     break;
 #define OP_W_DEF(OP, FUNC, STR, DST, CLASSIFICATION) \
@@ -2656,9 +2888,6 @@ void cuda_sim::gpgpu_cuda_ptx_sim_main_func(kernel_info_t &kernel,
   function_info *kernel_func_info = kernel.entry();
   const struct gpgpu_ptx_sim_info *kernel_info =
       ptx_sim_kernel_info(kernel_func_info);
-  checkpoint *g_checkpoint;
-  g_checkpoint = new checkpoint();
-
   if (kernel_func_info->is_pdom_set()) {
     printf("GPGPU-Sim PTX: PDOM analysis already done for %s \n",
            kernel.name().c_str());
@@ -2687,6 +2916,7 @@ void cuda_sim::gpgpu_cuda_ptx_sim_main_func(kernel_info_t &kernel,
   cp_count = gpgpu_ctx->the_gpgpusim->g_the_gpu->checkpoint_insn_Y;
   cp_cta_resume = gpgpu_ctx->the_gpgpusim->g_the_gpu->checkpoint_CTA_t;
   int cta_launched = 0;
+  tracer_timer timer(TRACER_SHADER);
 
   // we excute the kernel one CTA (Block) at the time, as synchronization
   // functions work block wise
@@ -2711,8 +2941,15 @@ void cuda_sim::gpgpu_cuda_ptx_sim_main_func(kernel_info_t &kernel,
     }
     cta_launched++;
   }
+  unsigned warp_size =
+      gpgpu_ctx->the_gpgpusim->g_the_gpu->getShaderCoreConfig()->warp_size;
+  tracer_profile::get().count(TRACER_CTAS, cta_launched);
+  tracer_profile::get().count(
+      TRACER_WARPS, (unsigned long long)cta_launched *
+                        ((kernel.threads_per_cta() + warp_size - 1) / warp_size));
 
   if (cp_op == 1) {
+    checkpoint *g_checkpoint = new checkpoint();
     char f1name[2048];
     snprintf(f1name, 2048, "checkpoint_files/global_mem_%d.txt",
              kernel.get_uid());
@@ -2833,6 +3070,13 @@ void functionalCoreSim::execute(int inst_count, unsigned ctaid_cp) {
   m_gpu->gpgpu_ctx->func_sim->cp_cta_resume = m_gpu->checkpoint_CTA_t;
   initializeCTA(ctaid_cp);
 
+  // checkpoints count the round robin steps
+  unsigned quantum = m_gpu->get_config().warp_quantum();
+  if (quantum && m_gpu->checkpoint_option != 1) {
+    executeReady(quantum);
+    return;
+  }
+
   int count = 0;
   while (true) {
     bool someOneLive = false;
@@ -2855,17 +3099,14 @@ void functionalCoreSim::execute(int inst_count, unsigned ctaid_cp) {
     }
   }
 
-  checkpoint *g_checkpoint;
-  g_checkpoint = new checkpoint();
-
-  ptx_reg_t regval;
-  regval.u64 = 123;
-
-  unsigned ctaid = m_kernel->get_next_cta_id_single();
+  // the checkpoint (and its directory) only for the CTAs being checkpointed,
+  // not once per CTA of every kernel
   if (m_gpu->checkpoint_option == 1 &&
       (m_kernel->get_uid() == m_gpu->checkpoint_kernel) &&
       (ctaid_cp >= m_gpu->checkpoint_CTA) &&
       (ctaid_cp < m_gpu->checkpoint_CTA_t)) {
+    checkpoint *g_checkpoint = new checkpoint();
+    unsigned ctaid = m_kernel->get_next_cta_id_single();
     char fname[2048];
     snprintf(fname, 2048, "checkpoint_files/shared_mem_%d.txt", ctaid - 1);
     g_checkpoint->store_global_mem(m_thread[0]->m_shared_mem, fname,
@@ -2899,19 +3140,60 @@ void functionalCoreSim::execute(int inst_count, unsigned ctaid_cp) {
 
 void functionalCoreSim::executeWarp(unsigned i, bool &allAtBarrier,
                                     bool &someOneLive) {
-  if (!m_warpAtBarrier[i] && m_liveThreadCount[i] != 0) {
-    warp_inst_t inst = getExecuteWarp(i);
-    execute_warp_inst_t(inst, i);
-    if (inst.isatomic()) inst.do_atomic(true);
-    if (inst.op == BARRIER_OP || inst.op == MEMORY_BARRIER_OP)
-      m_warpAtBarrier[i] = true;
-    // updateSIMTStack(i, &inst);
-    updateSIMTDivergenceStructures(i, &inst);
-  }
+  if (!m_warpAtBarrier[i] && m_liveThreadCount[i] != 0) stepWarp(i);
   if (m_liveThreadCount[i] > 0) someOneLive = true;
   if (!m_warpAtBarrier[i] && m_liveThreadCount[i] > 0) allAtBarrier = false;
 }
 
+void functionalCoreSim::stepWarp(unsigned i) {
+  warp_inst_t inst = getExecuteWarp(i);
+  execute_warp_inst_t(inst, i);
+  if (inst.isatomic()) inst.do_atomic(true);
+  if (inst.op == BARRIER_OP || inst.op == MEMORY_BARRIER_OP)
+    m_warpAtBarrier[i] = true;
+  // updateSIMTStack(i, &inst);
+  updateSIMTDivergenceStructures(i, &inst);
+}
+
+// A warp is a continuation: its SIMT stack and threads hold all its state,
+// so it goes on from where it stopped. execute visits every warp for one
+// instruction each round and, with barriers, keeps revisiting the waiting
+// ones. Here only the ready warps are queued. A warp runs until it reaches
+// a barrier, exits or used its quantum, which bounds a warp spinning on
+// memory another warp writes; then it goes to the back of the queue if it
+// is still ready. The last live warp to reach a barrier queues all of them
+// again in warp order. Shader calls such as traceRay and the hit shaders
+// run within the instruction that makes them, so they never suspend a warp.
+void functionalCoreSim::executeReady(unsigned quantum) {
+  std::deque<unsigned> ready;
+  for (unsigned i = 0; i < m_warp_count; i++)
+    if (m_liveThreadCount[i]) ready.push_back(i);
+  unsigned live = ready.size();
+  unsigned waiting = 0;
+  while (!ready.empty()) {
+    unsigned i = ready.front();
+    ready.pop_front();
+    for (unsigned n = 0;
+         n < quantum && !m_warpAtBarrier[i] && m_liveThreadCount[i]; n++)
+      stepWarp(i);
+    if (!m_liveThreadCount[i]) {
+      live--;
+    } else if (m_warpAtBarrier[i]) {
+      waiting++;
+    } else {
+      ready.push_back(i);
+    }
+    // warps that exit count as arrived, as in warp_waiting_at_barrier
+    if (live && waiting == live) {
+      for (unsigned w = 0; w < m_warp_count; w++) {
+        if (m_warpAtBarrier[w] && m_liveThreadCount[w]) ready.push_back(w);
+        m_warpAtBarrier[w] = false;
+      }
+      waiting = 0;
+    }
+  }
+}
+
 unsigned gpgpu_context::translate_pc_to_ptxlineno(unsigned pc) {
   unsigned shader;
   return translate_pc_to_ptxlineno(pc, shader);
@@ -77,6 +77,8 @@ class functionalCoreSim : public core_t {
   }
   //! executes all warps till completion
   void execute(int inst_count, unsigned ctaid_cp);
+  //! the same from a queue of ready warps, see -gpgpu_ptx_warp_quantum
+  void executeReady(unsigned quantum);
   virtual void warp_exit(unsigned warp_id);
   virtual bool warp_waiting_at_barrier(unsigned warp_id) const {
     return (m_warpAtBarrier[warp_id] || !(m_liveThreadCount[warp_id] > 0));
@@ -84,6 +86,8 @@ class functionalCoreSim : public core_t {
 
  private:
   void executeWarp(unsigned, bool &, bool &);
+  // the next instruction of warp i
+  void stepWarp(unsigned i);
   // initializes threads in the CTA block which we are executing
   void initializeCTA(unsigned ctaid_cp);
   virtual void checkExecutionStatusAndUpdate(warp_inst_t &inst, unsigned t,
@@ -157,6 +161,7 @@ class cuda_sim {
   bool g_rt_world_set = false;
   float3 g_rt_world_min;
   float3 g_rt_world_max;
+  rt_treelets g_rt_treelets;
   unsigned g_n_anyhit_rays;
   unsigned g_n_closesthit_rays;
   unsigned g_max_nodes_per_ray;
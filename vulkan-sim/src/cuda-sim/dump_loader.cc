@@ -0,0 +1,173 @@
+// Loader of the dump files a replay reads back, see dump_loader.h
+
+#include "dump_loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "dump_store.h"
+
+dump_loader &dump_loader::get() {
+  static dump_loader loader;
+  return loader;
+}
+
+dump_loader::dump_loader() {
+  char const *env = getenv("DUMP_LOADER_MMAP");
+  m_mmap_bytes = env ? strtoull(env, NULL, 0) : 1 << 20;
+  m_stop = false;
+}
+
+dump_loader::~dump_loader() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_queued.notify_one();
+  if (m_worker.joinable()) m_worker.join();
+  std::vector<content *> contents;
+  for (auto &f : m_by_file)
+    if (!f.second->files.empty() && f.second->files[0] == f.first)
+      contents.push_back(f.second);
+  for (content *c : contents) free_content(c);
+}
+
+const void *dump_loader::load(const std::string &path, size_t *size) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  file &f = fetch(path, lock);
+  if (!f.data) {
+    // the next load tries again
+    m_files.erase(path);
+    return NULL;
+  }
+  *size = f.data->size;
+  return f.data->data;
+}
+
+void dump_loader::release(const std::string &path) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unordered_map<std::string, file>::iterator f = m_files.find(path);
+  if (f == m_files.end() || !f->second.ready) return;
+  content *c = f->second.data;
+  m_files.erase(f);
+  if (c && --c->paths == 0) free_content(c);
+}
+
+void dump_loader::prefetch(const std::vector<std::string> &paths) {
+  if (paths.empty()) return;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_worker.joinable())
+      m_worker = std::thread(&dump_loader::prefetch_loop, this);
+    m_prefetch.insert(m_prefetch.end(), paths.begin(), paths.end());
+  }
+  m_queued.notify_one();
+}
+
+dump_loader::file &dump_loader::fetch(const std::string &path,
+                                      std::unique_lock<std::mutex> &lock) {
+  for (;;) {
+    std::unordered_map<std::string, file>::iterator f = m_files.find(path);
+    if (f == m_files.end()) break;
+    if (f->second.ready) return f->second;
+    m_ready.wait(lock);
+  }
+  file loading = {false, NULL};
+  m_files[path] = loading;
+  content *c = read(path, lock);
+  // the elements of an unordered_map stay where they are on a rehash
+  file &f = m_files[path];
+  f.ready = true;
+  f.data = c;
+  if (c) c->paths++;
+  m_ready.notify_all();
+  return f;
+}
+
+dump_loader::content *dump_loader::read(const std::string &path,
+                                        std::unique_lock<std::mutex> &lock) {
+  struct stat st;
+  lock.unlock();
+  bool found = stat(path.c_str(), &st) == 0 && st.st_size > 0;
+  lock.lock();
+  if (!found) return NULL;
+  std::pair<uint64_t, uint64_t> id(st.st_dev, st.st_ino);
+  std::map<std::pair<uint64_t, uint64_t>, content *>::iterator same =
+      m_by_file.find(id);
+  if (same != m_by_file.end()) return same->second;
+
+  lock.unlock();
+  size_t size = st.st_size;
+  const void *data = NULL;
+  bool mapped = m_mmap_bytes && size >= m_mmap_bytes;
+  if (mapped) {
+    data = dump_store::map(path, &size);
+  } else if (FILE *fp = fopen(path.c_str(), "rb")) {
+    void *buffer = malloc(size);
+    if (buffer && fread(buffer, 1, size, fp) == size)
+      data = buffer;
+    else
+      free(buffer);
+    fclose(fp);
+  }
+  uint64_t hash = data ? dump_store::hash(data, size, 0) : 0;
+  lock.lock();
+  if (!data) return NULL;
+
+  // the file through another path, or the same bytes in another file
+  content *c = NULL;
+  same = m_by_file.find(id);
+  if (same != m_by_file.end()) c = same->second;
+  auto range = m_by_hash.equal_range(hash);
+  for (auto h = range.first; !c && h != range.second; ++h)
+    if (h->second->size == size && !memcmp(h->second->data, data, size)) {
+      c = h->second;
+      c->files.push_back(id);
+      m_by_file[id] = c;
+    }
+  if (c) {
+    if (mapped)
+      dump_store::unmap(data, size);
+    else
+      free((void *)data);
+    return c;
+  }
+  c = new content;
+  c->data = data;
+  c->size = size;
+  c->mapped = mapped;
+  c->hash = hash;
+  c->paths = 0;
+  c->files.push_back(id);
+  m_by_file[id] = c;
+  m_by_hash.insert(std::make_pair(hash, c));
+  return c;
+}
+
+void dump_loader::free_content(content *c) {
+  if (c->mapped)
+    dump_store::unmap(c->data, c->size);
+  else
+    free((void *)c->data);
+  for (const std::pair<uint64_t, uint64_t> &id : c->files) m_by_file.erase(id);
+  auto range = m_by_hash.equal_range(c->hash);
+  for (auto h = range.first; h != range.second; ++h)
+    if (h->second == c) {
+      m_by_hash.erase(h);
+      break;
+    }
+  delete c;
+}
+
+void dump_loader::prefetch_loop() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    while (!m_stop && m_prefetch.empty()) m_queued.wait(lock);
+    if (m_stop) return;
+    std::string path = m_prefetch.front();
+    m_prefetch.pop_front();
+    if (!m_files.count(path)) fetch(path, lock);
+  }
+}
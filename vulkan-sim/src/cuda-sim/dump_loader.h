@@ -0,0 +1,74 @@
+// Loader of the dump files a replay reads back
+//
+// The replay of a trace reads the same textures and buffers again for every
+// draw and launch. load() reads a dump file once and hands out the same
+// contents until the last path loaded from it is released. Paths to the
+// same file, as the symbolic links of DUMP_STORE=1 are, share it without a
+// second read, and files with the same bytes, by the 64-bit hash of
+// dump_store, share one copy. Files of at least DUMP_LOADER_MMAP bytes (1
+// MiB by default, 0 never) are mapped read only instead of read. prefetch()
+// hands paths to a background thread that loads them while the current
+// draw or launch runs; load() of a path it is still reading waits for it.
+// The loader is thread safe, a trace runner may load through it as well.
+
+#ifndef DUMP_LOADER_H
+#define DUMP_LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class dump_loader {
+ public:
+  static dump_loader &get();
+  ~dump_loader();
+
+  // the contents of the dump file path, NULL when it cannot be read; they
+  // stay valid until release(path)
+  const void *load(const std::string &path, size_t *size);
+  void release(const std::string &path);
+  // load paths in the background, ahead of the draw or launch using them
+  void prefetch(const std::vector<std::string> &paths);
+
+ private:
+  struct content {
+    const void *data;
+    size_t size;
+    bool mapped;
+    uint64_t hash;
+    unsigned paths;  // loaded and not released
+    std::vector<std::pair<uint64_t, uint64_t> > files;  // device and inode
+  };
+  struct file {
+    bool ready;
+    content *data;  // NULL when it could not be read
+  };
+
+  dump_loader();
+  // the entry of path, read with the lock released when it is not loaded
+  // or being loaded yet
+  file &fetch(const std::string &path, std::unique_lock<std::mutex> &lock);
+  content *read(const std::string &path, std::unique_lock<std::mutex> &lock);
+  void free_content(content *c);
+  void prefetch_loop();
+
+  size_t m_mmap_bytes;
+  std::mutex m_mutex;
+  std::condition_variable m_ready;   // a file was loaded
+  std::condition_variable m_queued;  // a path to prefetch or stop
+  std::unordered_map<std::string, file> m_files;  // by path
+  std::map<std::pair<uint64_t, uint64_t>, content *> m_by_file;
+  std::unordered_multimap<uint64_t, content *> m_by_hash;
+  std::deque<std::string> m_prefetch;
+  std::thread m_worker;
+  bool m_stop;
+};
+
+#endif
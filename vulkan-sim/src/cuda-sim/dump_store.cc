@@ -0,0 +1,148 @@
+// Content-addressed store for the texture and descriptor set dumps
+// see dump_store.h
+
+#include "dump_store.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+
+dump_store &dump_store::get(const std::string &dir) {
+  static std::map<std::string, dump_store *> stores;
+  dump_store *&store = stores[dir];
+  if (!store) store = new dump_store(dir);
+  return *store;
+}
+
+dump_store::dump_store(const std::string &dir) : m_dir(dir) {
+  char const *env = getenv("DUMP_STORE");
+  m_enabled = env && atoi(env);
+  if (!m_enabled) return;
+  mkdir((m_dir + "store").c_str(), 0755);
+  load_manifest();
+}
+
+void dump_store::load_manifest() {
+  std::ifstream ifs((m_dir + "store/manifest").c_str());
+  std::string line;
+  while (std::getline(ifs, line)) {
+    std::istringstream iss(line);
+    std::string kind, a, b;
+    iss >> kind >> a >> b;
+    if (kind == "link") {
+      struct stat st;
+      // only links that are still in place count
+      if (access((m_dir + "store/" + b).c_str(), R_OK) == 0 &&
+          stat((m_dir + a).c_str(), &st) == 0) {
+        m_links[a] = b;
+        object &obj = m_objects[b];
+        obj.size = st.st_size;
+        obj.links++;
+      }
+    }
+  }
+}
+
+void dump_store::save_manifest() {
+  std::string path = m_dir + "store/manifest";
+  std::string tmp = path + ".tmp" + std::to_string(getpid());
+  FILE *fp = fopen(tmp.c_str(), "w");
+  if (!fp) return;
+  fprintf(fp, "# object <hash> <size> <links>, link <dump file> <hash>\n");
+  for (auto &o : m_objects)
+    fprintf(fp, "object %s %llu %u\n", o.first.c_str(),
+            (unsigned long long)o.second.size, o.second.links);
+  for (auto &l : m_links)
+    fprintf(fp, "link %s %s\n", l.first.c_str(), l.second.c_str());
+  fclose(fp);
+  rename(tmp.c_str(), path.c_str());
+}
+
+void dump_store::unlink_object(const std::string &name) {
+  auto o = m_objects.find(name);
+  if (o == m_objects.end()) return;
+  if (--o->second.links == 0) {
+    remove((m_dir + "store/" + name).c_str());
+    m_objects.erase(o);
+  }
+}
+
+void dump_store::write(const std::string &path, const void *data,
+                       size_t size) {
+  if (!m_enabled) {
+    // do not write through a link left by an earlier run into its object
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISLNK(st.st_mode))
+      unlink(path.c_str());
+    FILE *fp = fopen(path.c_str(), "wb+");
+    if (!fp) return;
+    fwrite(data, 1, size, fp);
+    fclose(fp);
+    return;
+  }
+
+  char name[40];
+  snprintf(name, sizeof(name), "%016llx%016llx",
+           (unsigned long long)hash(data, size, 0),
+           (unsigned long long)hash(data, size, 0x5bd1e995));
+  std::string file = path.compare(0, m_dir.size(), m_dir) == 0
+                         ? path.substr(m_dir.size())
+                         : path;
+
+  auto link = m_links.find(file);
+  if (link != m_links.end() && link->second == name) return;
+
+  std::string object_path = m_dir + "store/" + name;
+  auto obj = m_objects.find(name);
+  if (obj == m_objects.end() && access(object_path.c_str(), R_OK) != 0) {
+    // write to a temporary and rename, a reader never sees half an object
+    std::string tmp = object_path + ".tmp" + std::to_string(getpid());
+    FILE *fp = fopen(tmp.c_str(), "wb");
+    if (!fp) return;
+    fwrite(data, 1, size, fp);
+    fclose(fp);
+    rename(tmp.c_str(), object_path.c_str());
+  }
+
+  if (link != m_links.end()) {
+    std::string old = link->second;
+    link->second = name;
+    unlink_object(old);
+  } else {
+    m_links[file] = name;
+  }
+  object &o = m_objects[name];
+  o.size = size;
+  o.links++;
+
+  unlink(path.c_str());
+  if (symlink((std::string("store/") + name).c_str(), path.c_str()) != 0) {
+    printf("GPGPU-Sim: can not link %s to the dump store\n", path.c_str());
+    exit(1);
+  }
+  save_manifest();
+}
+
+const void *dump_store::map(const std::string &path, size_t *size) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+  *size = st.st_size;
+  return data;
+}
+
+void dump_store::unmap(const void *data, size_t size) {
+  munmap((void *)data, size);
+}
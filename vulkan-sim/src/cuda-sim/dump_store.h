@@ -0,0 +1,69 @@
+// Content-addressed store for the texture and descriptor set dumps
+//
+// The trace dumps write the contents of every texture and buffer binding to
+// a file named after its set and binding, again for every draw and frame.
+// With DUMP_STORE=1 the contents go to <dir>/store/<hash> instead, named by
+// a 128-bit hash of the bytes and written only when no object with that
+// hash exists yet. The per-binding file name, which the trace runner opens,
+// becomes a symbolic link to the object. <dir>/store/manifest lists every
+// object with its size and the number of file names linking to it. It is
+// rewritten whenever a link changes, and an object is deleted when its last
+// link moves to different contents. Without DUMP_STORE the files are
+// written as before.
+//
+// map() hands a dump file back read only through mmap, following the link
+// into the store.
+
+#ifndef DUMP_STORE_H
+#define DUMP_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+class dump_store {
+ public:
+  // the store of the dump directory dir, which ends in a slash
+  static dump_store &get(const std::string &dir);
+
+  // write size bytes at data as the dump file path in the directory
+  void write(const std::string &path, const void *data, size_t size);
+
+  // the contents of a dump file, NULL when it cannot be mapped
+  static const void *map(const std::string &path, size_t *size);
+  static void unmap(const void *data, size_t size);
+
+  // 64-bit hash of size bytes at data
+  static uint64_t hash(const void *data, size_t size, uint64_t seed) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ull);
+    for (; size >= 8; size -= 8, p += 8) {
+      uint64_t w;
+      memcpy(&w, p, 8);
+      h = (h ^ w) * 0x100000001b3ull;
+      h ^= h >> 29;
+    }
+    for (; size; size--, p++) h = (h ^ *p) * 0x100000001b3ull;
+    return h;
+  }
+
+ private:
+  struct object {
+    uint64_t size;
+    unsigned links;
+  };
+
+  explicit dump_store(const std::string &dir);
+  void load_manifest();
+  void save_manifest();
+  void unlink_object(const std::string &name);
+
+  bool m_enabled;
+  std::string m_dir;
+  std::map<std::string, object> m_objects;     // by hash
+  std::map<std::string, std::string> m_links;  // dump file name to hash
+};
+
+#endif
@@ -48,6 +48,7 @@ class ptx_recognizer;
 #include "../gpgpu-sim/gpu-sim.h"
 #include "../gpgpu-sim/shader.h"
 #include "cuda-math.h"
+#include "cuda-sim.h"
 #include "cuda_device_printf.h"
 #include "ptx.tab.h"
 #include "ptx_loader.h"
@@ -178,11 +179,20 @@ void ptx_thread_info::set_reg(const symbol *reg, const ptx_reg_t &value) {
   if (reg->name() == "_") return;
   assert(!m_regs.empty());
   assert(reg->uid() > 0);
-  m_regs.back()[reg] = value;
+  m_regs.back().get(reg, reg->frame_slot()) = value;
   if (m_enable_debug_trace) m_debug_trace_regs_modified.back()[reg] = value;
   m_last_set_operand_value = value;
 }
 
+void ptx_thread_info::set_reg_u64(const symbol *reg,
+                                  unsigned long long value) {
+  ptx_reg_t data;
+  data.u64 = value;
+  m_regs.back().get(reg, reg->frame_slot()) = data;
+  if (m_enable_debug_trace) m_debug_trace_regs_modified.back()[reg] = data;
+  m_last_set_operand_value = data;
+}
+
 void ptx_thread_info::print_reg_thread(char *fname) {
   FILE *fp = fopen(fname, "w");
   assert(fp != NULL);
@@ -190,7 +200,7 @@ void ptx_thread_info::print_reg_thread(char *fname) {
   int size = m_regs.size();
 
   if (size > 0) {
-    reg_map_t reg = m_regs.back();
+    reg_map_t reg = m_regs.back().as_map();
 
     reg_map_t::const_iterator it;
     for (it = reg.begin(); it != reg.end(); ++it) {
@@ -221,7 +231,7 @@ void ptx_thread_info::resume_reg_thread(char *fname, symbol_table *symtab) {
     data = atoi(pch);
     pch = strtok(NULL, " ");
     pch = strtok(NULL, " ");
-    m_regs.back()[reg] = data;
+    m_regs.back().get(reg, reg->frame_slot()) = data;
   }
   fclose(fp2);
 }
@@ -230,8 +240,8 @@ ptx_reg_t ptx_thread_info::get_reg(const symbol *reg) {
   static bool unfound_register_warned = false;
   assert(reg != NULL);
   assert(!m_regs.empty());
-  reg_map_t::iterator regs_iter = m_regs.back().find(reg);
-  if (regs_iter == m_regs.back().end()) {
+  ptx_reg_t *value = m_regs.back().find(reg, reg->frame_slot());
+  if (!value) {
     assert(reg->type()->get_key().is_reg());
     const std::string &name = reg->name();
     unsigned call_uid = m_callstack.back().m_call_uid;
@@ -249,11 +259,10 @@ ptx_reg_t ptx_thread_info::get_reg(const symbol *reg) {
           file_loc.c_str(), name.c_str(), call_uid);
       unfound_register_warned = true;
     }
-    regs_iter = m_regs.back().find(reg);
+    value = m_regs.back().find(reg, reg->frame_slot());
   }
-  if (m_enable_debug_trace)
-    m_debug_trace_regs_read.back()[reg] = regs_iter->second;
-  return regs_iter->second;
+  if (m_enable_debug_trace) m_debug_trace_regs_read.back()[reg] = *value;
+  return *value;
 }
 
 ptx_reg_t ptx_thread_info::get_operand_value(const operand_info &op,
@@ -533,9 +542,9 @@ void ptx_thread_info::get_vector_operand_values(const operand_info &op,
     const symbol *sym = NULL;
     sym = op.vec_symbol(idx);
     if (strcmp(sym->name().c_str(), "_") != 0) {
-      reg_map_t::iterator reg_iter = m_regs.back().find(sym);
-      assert(reg_iter != m_regs.back().end());
-      ptx_regs[idx] = reg_iter->second;
+      ptx_reg_t *value = m_regs.back().find(sym, sym->frame_slot());
+      assert(value != NULL);
+      ptx_regs[idx] = *value;
     }
   }
 }
@@ -570,7 +579,7 @@ void ptx_thread_info::set_operand_value(const operand_info &dst,
     ptx_reg_t predValue;
 
     const symbol *sym = dst.vec_symbol(0);
-    predValue.u64 = (m_regs.back()[sym].u64) & ~(0x0C);
+    predValue.u64 = (m_regs.back().get(sym, sym->frame_slot()).u64) & ~(0x0C);
     predValue.u64 |= ((overflow & 0x01) << 3);
     predValue.u64 |= ((carry & 0x01) << 2);
 
@@ -683,10 +692,14 @@ void ptx_thread_info::set_operand_value(const operand_info &dst,
 
       if (dst.get_operand_lohi() == 1) {
         setValue.u64 =
-            ((m_regs.back()[regName].u64) & (~(0xFFFF))) + (data.u64 & 0xFFFF);
+            ((m_regs.back().get(regName, regName->frame_slot()).u64) &
+             (~(0xFFFF))) +
+            (data.u64 & 0xFFFF);
       } else if (dst.get_operand_lohi() == 2) {
-        setValue.u64 = ((m_regs.back()[regName].u64) & (~(0xFFFF0000))) +
-                       ((data.u64 << 16) & 0xFFFF0000);
+        setValue.u64 =
+            ((m_regs.back().get(regName, regName->frame_slot()).u64) &
+             (~(0xFFFF0000))) +
+            ((data.u64 << 16) & 0xFFFF0000);
       }
 
       set_reg(predName, predValue);
@@ -732,13 +745,15 @@ void ptx_thread_info::set_operand_value(const operand_info &dst,
       set_reg(name1, setValue);
       set_reg(name2, setValue2);
     } else {
+      const symbol *sym = dst.get_symbol();
       if (dst.get_operand_lohi() == 1) {
-        setValue.u64 = ((m_regs.back()[dst.get_symbol()].u64) & (~(0xFFFF))) +
-                       (data.u64 & 0xFFFF);
-      } else if (dst.get_operand_lohi() == 2) {
         setValue.u64 =
-            ((m_regs.back()[dst.get_symbol()].u64) & (~(0xFFFF0000))) +
-            ((data.u64 << 16) & 0xFFFF0000);
+            ((m_regs.back().get(sym, sym->frame_slot()).u64) & (~(0xFFFF))) +
+            (data.u64 & 0xFFFF);
+      } else if (dst.get_operand_lohi() == 2) {
+        setValue.u64 = ((m_regs.back().get(sym, sym->frame_slot()).u64) &
+                        (~(0xFFFF0000))) +
+                       ((data.u64 << 16) & 0xFFFF0000);
       }
       set_reg(dst.get_symbol(), setValue);
     }
@@ -6519,7 +6534,7 @@ void load_ray_instance_custom_index_impl(const ptx_instruction *pI, ptx_thread_i
     mem->read(&(traversal_data->closest_hit.instance_index), sizeof(traversal_data->closest_hit.instance_index), &instance_index);
   else {
 
-    warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
+    VulkanRayTracing::warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
     instance_index = table->get_instanceID(shader_counter, thread->get_tid().x, pI, thread);
   }
 
@@ -6542,7 +6557,7 @@ void load_primitive_id_impl(const ptx_instruction *pI, ptx_thread_info *thread)
   if(shader_counter == -1) // not in intersection shader
     mem->read(&(traversal_data->closest_hit.primitive_index), sizeof(traversal_data->closest_hit.primitive_index), &primitive_index);
   else {
-    warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
+    VulkanRayTracing::warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
     primitive_index = table->get_primitiveID(shader_counter, thread->get_tid().x, pI, thread);
   }
 
@@ -6778,7 +6793,7 @@ void report_ray_intersection_impl(const ptx_instruction *pI, ptx_thread_info *th
       mem->read(&(traversal_data->current_shader_counter), sizeof(traversal_data->current_shader_counter), &shader_counter);
 
       assert(shader_counter != -1);
-      warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
+      VulkanRayTracing::warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
 
       return_value = true;
 
@@ -7205,7 +7220,7 @@ void run_intersection_impl(const ptx_instruction *pI, ptx_thread_info *thread) {
   src_data = thread->get_operand_value(src, dst, U32_TYPE, thread, 0);
   uint32_t shader_counter = src_data.u32;
 
-  warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
+  VulkanRayTracing::warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
   bool intersection_exists = table->shader_exists(thread->get_tid().x, shader_counter, pI, thread);
 
   data.pred =
@@ -7223,7 +7238,7 @@ void intersection_exit_impl(const ptx_instruction *pI, ptx_thread_info *thread)
   src_data = thread->get_operand_value(src, dst, U32_TYPE, thread, 0);
   uint32_t shader_counter = src_data.u32;
 
-  warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
+  VulkanRayTracing::warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
   bool exit_intersection = table->exit_shaders(shader_counter, thread->get_tid().x);
 
   data.pred =
@@ -7241,7 +7256,7 @@ void get_intersection_shader_data_address_impl(const ptx_instruction *pI, ptx_th
   src_data = thread->get_operand_value(src, dst, U32_TYPE, thread, 0);
   uint32_t shader_counter = src_data.u32;
 
-  warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
+  VulkanRayTracing::warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
   void* address = table->get_shader_data_address(shader_counter, thread->get_tid().x);
 
   data.u64 = (uint64_t)address;
@@ -7347,7 +7362,7 @@ void get_intersection_shaderID_impl(const ptx_instruction *pI, ptx_thread_info *
   src_data = thread->get_operand_value(src, src, U32_TYPE, thread, 1);
   uint32_t shader_counter = src_data.u32;
 
-  warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
+  VulkanRayTracing::warp_intersection_table* table = VulkanRayTracing::intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
   uint32_t hitGroupIndex = table->get_hitGroupIndex(shader_counter, thread->get_tid().x, pI, thread);
 
   data.u32 = *((uint64_t *)(thread->get_kernel().vulkan_metadata.hit_sbt) + 8 * hitGroupIndex + 1);
@@ -7645,4 +7660,323 @@ void load_front_face_impl(const ptx_instruction *pI, ptx_thread_info *thread) {
 
 void txs_impl(const ptx_instruction *pI, ptx_thread_info *thread) {
   assert(0);
-}
\ No newline at end of file
+}
+
+// Warp-wide execution of the common ALU instructions
+//
+// ptx_exec_inst runs an instruction one thread at a time, and every *_impl
+// decodes the operands, the type and the modifiers again for each of them.
+// For add, mul, mad/fma, mov, selp, setp and cvt on 32-bit types (mov and
+// selp also on 64-bit ones, cvt on any) with register or literal operands,
+// core_t::execute_warp_inst_t lets the threads only do the bookkeeping of
+// the instruction and runs it here once for the warp: the operands are
+// decoded once, the sources are gathered from the registers of the lanes,
+// the result is computed over the whole warp in loops the compiler can
+// vectorise, and it is written back to the lanes that executed. The results
+// are bit for bit those of the *_impl functions; whatever they would treat
+// differently (.rz, .hi and .wide, operand modifiers, ptxplus operands,
+// the debug traces) stays with them.
+
+enum warp_alu_op_t {
+  WARP_ALU_NONE = 0,
+  WARP_ALU_ADD_F32,
+  WARP_ALU_ADD_I32,
+  WARP_ALU_MUL_F32,
+  WARP_ALU_MUL_LO_I32,
+  WARP_ALU_MAD_F32,
+  WARP_ALU_MAD_LO_I32,
+  WARP_ALU_MOV,
+  WARP_ALU_SELP,
+  WARP_ALU_SETP_F32,
+  WARP_ALU_SETP_S32,
+  WARP_ALU_SETP_U32,
+  WARP_ALU_CVT
+};
+
+// what get_operand_value reads as the register or the literal itself
+static bool warp_alu_src(const operand_info &op) {
+  if (op.is_vector() || op.get_double_operand_type() != 0 ||
+      op.get_operand_lohi() != 0 || op.get_operand_neg() ||
+      op.get_addr_space() != undefined_space)
+    return false;
+  return op.is_reg() || op.is_literal();
+}
+
+// what set_operand_value writes with a plain set_reg
+static bool warp_alu_dst(const operand_info &op) {
+  return op.is_reg() && !op.is_vector() && op.get_double_operand_type() == 0 &&
+         op.get_operand_lohi() == 0 && op.get_addr_space() == undefined_space;
+}
+
+static bool warp_alu_32bit(unsigned type) {
+  return type == S32_TYPE || type == U32_TYPE || type == B32_TYPE ||
+         type == F32_TYPE;
+}
+
+static bool warp_alu_setp_cmpop(unsigned type, unsigned cmpop) {
+  switch (cmpop) {
+    case EQ_OPTION:
+    case NE_OPTION:
+    case LT_OPTION:
+    case LE_OPTION:
+    case GT_OPTION:
+    case GE_OPTION:
+      return true;
+    case LO_OPTION:
+    case LS_OPTION:
+    case HI_OPTION:
+    case HS_OPTION:
+      return type == U32_TYPE;
+    default:
+      return false;
+  }
+}
+
+unsigned warp_alu_decode(const ptx_instruction *pI) {
+  if (pI->is_exit()) return WARP_ALU_NONE;
+  unsigned n = pI->get_num_operands();
+  if (n < 2 || n > 4) return WARP_ALU_NONE;
+  if (!warp_alu_dst(pI->dst())) return WARP_ALU_NONE;
+  for (unsigned i = 1; i < n; i++)
+    if (!warp_alu_src(pI->operand_lookup(i))) return WARP_ALU_NONE;
+
+  unsigned type = pI->get_type();
+  bool rn = pI->rounding_mode() == RN_OPTION;
+  bool i32 = type == S32_TYPE || type == U32_TYPE;
+  switch (pI->get_opcode()) {
+    case ADD_OP:
+      if (n != 3 || !rn) break;
+      if (type == F32_TYPE) return WARP_ALU_ADD_F32;
+      if (i32) return WARP_ALU_ADD_I32;
+      break;
+    case MUL_OP:
+      if (n != 3) break;
+      if (type == F32_TYPE && rn) return WARP_ALU_MUL_F32;
+      if (i32 && pI->is_lo()) return WARP_ALU_MUL_LO_I32;
+      break;
+    case MAD_OP:
+    case FMA_OP:
+      if (n != 4) break;
+      if (type == F32_TYPE && rn) return WARP_ALU_MAD_F32;
+      if (i32 && pI->is_lo()) return WARP_ALU_MAD_LO_I32;
+      break;
+    case MOV_OP:
+      if (n != 2) break;
+      if (warp_alu_32bit(type) || type == S64_TYPE || type == U64_TYPE ||
+          type == B64_TYPE)
+        return WARP_ALU_MOV;
+      break;
+    case SELP_OP:
+      if (n != 4 || !pI->src3().is_reg()) break;
+      if (warp_alu_32bit(type) || type == S64_TYPE || type == U64_TYPE ||
+          type == B64_TYPE || type == F64_TYPE)
+        return WARP_ALU_SELP;
+      break;
+    case SETP_OP:
+      if (n != 3 || !warp_alu_setp_cmpop(type, pI->get_cmpop())) break;
+      if (type == F32_TYPE) return WARP_ALU_SETP_F32;
+      if (type == S32_TYPE) return WARP_ALU_SETP_S32;
+      if (type == U32_TYPE) return WARP_ALU_SETP_U32;
+      break;
+    case CVT_OP:
+      if (n != 2 || pI->is_neg()) break;
+      if (type == BB64_TYPE || type == BB128_TYPE || type == FF64_TYPE ||
+          pI->get_type2() == BB64_TYPE || pI->get_type2() == BB128_TYPE ||
+          pI->get_type2() == FF64_TYPE)
+        break;
+      return WARP_ALU_CVT;
+    default:
+      break;
+  }
+  return WARP_ALU_NONE;
+}
+
+bool warp_alu_enabled(const ptx_instruction *pI,
+                      const gpgpu_functional_sim_config &config) {
+  // ptx_exec_inst traces registers and operand values from level 5 on
+  return pI->warp_alu_op() != WARP_ALU_NONE && config.warp_alu() &&
+         g_debug_execution < 5 && !config.get_ptx_inst_debug_to_file() &&
+         !print_debug_insts;
+}
+
+static inline float warp_alu_f32(unsigned long long bits) {
+  unsigned lo = bits;
+  float f;
+  memcpy(&f, &lo, sizeof(f));
+  return f;
+}
+
+static inline unsigned long long warp_alu_bits(float f) {
+  unsigned lo;
+  memcpy(&lo, &f, sizeof(lo));
+  return lo;
+}
+
+static inline float warp_alu_saturate(float d) {
+  if (d < 0)
+    d = 0;
+  else if (d > 1.0f)
+    d = 1.0f;
+  return d;
+}
+
+// the setp comparisons of CmpOp
+template <typename T>
+static void warp_alu_compare(unsigned cmpop, const T *a, const T *b,
+                             bool *t) {
+  switch (cmpop) {
+    case EQ_OPTION:
+      for (unsigned i = 0; i < MAX_WARP_SIZE; i++) t[i] = a[i] == b[i];
+      break;
+    case NE_OPTION:
+      for (unsigned i = 0; i < MAX_WARP_SIZE; i++) t[i] = a[i] != b[i];
+      break;
+    case LT_OPTION:
+    case LO_OPTION:
+      for (unsigned i = 0; i < MAX_WARP_SIZE; i++) t[i] = a[i] < b[i];
+      break;
+    case LE_OPTION:
+    case LS_OPTION:
+      for (unsigned i = 0; i < MAX_WARP_SIZE; i++) t[i] = a[i] <= b[i];
+      break;
+    case GT_OPTION:
+    case HI_OPTION:
+      for (unsigned i = 0; i < MAX_WARP_SIZE; i++) t[i] = a[i] > b[i];
+      break;
+    case GE_OPTION:
+    case HS_OPTION:
+      for (unsigned i = 0; i < MAX_WARP_SIZE; i++) t[i] = a[i] >= b[i];
+      break;
+    default:
+      assert(0);
+  }
+}
+
+void warp_alu_exec(const ptx_instruction *pI, ptx_thread_info **threads,
+                   const active_mask_t &lanes) {
+  const unsigned W = MAX_WARP_SIZE;
+  const symbol *dst = pI->dst().get_symbol();
+  unsigned n = pI->get_num_operands();
+  unsigned op = pI->warp_alu_op();
+
+  if (op == WARP_ALU_CVT) {
+    unsigned to_type = pI->get_type();
+    unsigned from_type = pI->get_type2();
+    int to_sign, from_sign;
+    size_t from_width, to_width;
+    unsigned src_fmt =
+        type_info_key::type_decode(from_type, from_width, from_sign);
+    unsigned dst_fmt = type_info_key::type_decode(to_type, to_width, to_sign);
+    ptx_reg_t (*cvt)(ptx_reg_t, unsigned, unsigned, int, int, int) =
+        g_cvt_fn[src_fmt][dst_fmt];
+    const operand_info &src = pI->src1();
+    for (unsigned t = 0; t < W; t++) {
+      if (!lanes.test(t)) continue;
+      ptx_reg_t data = src.is_literal() ? src.get_literal_value()
+                                        : threads[t]->get_reg(src.get_symbol());
+      if (cvt)
+        data = cvt(data, from_width, to_width, to_sign, pI->rounding_mode(),
+                   pI->saturation_mode());
+      if (dst->name() != "_") threads[t]->set_reg_u64(dst, data.u64);
+    }
+    return;
+  }
+
+  // the low 64 bits of the sources, zero on the lanes that do not execute
+  unsigned long long s[3][MAX_WARP_SIZE];
+  for (unsigned i = 1; i < n; i++) {
+    const operand_info &src = pI->operand_lookup(i);
+    if (src.is_literal()) {
+      unsigned long long v = src.get_literal_value().u64;
+      for (unsigned t = 0; t < W; t++) s[i - 1][t] = v;
+    } else {
+      const symbol *reg = src.get_symbol();
+      for (unsigned t = 0; t < W; t++)
+        s[i - 1][t] = lanes.test(t) ? threads[t]->get_reg(reg).u64 : 0;
+    }
+  }
+
+  unsigned long long d[MAX_WARP_SIZE];
+  bool sat = pI->saturation_mode();
+  switch (op) {
+    case WARP_ALU_ADD_F32:
+      for (unsigned t = 0; t < W; t++)
+        d[t] = warp_alu_bits(warp_alu_f32(s[0][t]) + warp_alu_f32(s[1][t]));
+      break;
+    case WARP_ALU_ADD_I32:
+      for (unsigned t = 0; t < W; t++)
+        d[t] = (s[0][t] & 0xFFFFFFFF) + (s[1][t] & 0xFFFFFFFF);
+      break;
+    case WARP_ALU_MUL_F32:
+      for (unsigned t = 0; t < W; t++) {
+        float f = warp_alu_f32(s[0][t]) * warp_alu_f32(s[1][t]);
+        d[t] = warp_alu_bits(sat ? warp_alu_saturate(f) : f);
+      }
+      break;
+    case WARP_ALU_MUL_LO_I32:
+      for (unsigned t = 0; t < W; t++)
+        d[t] = (unsigned)((unsigned)s[0][t] * (unsigned)s[1][t]);
+      break;
+    case WARP_ALU_MAD_F32:
+      for (unsigned t = 0; t < W; t++) {
+        float f = warp_alu_f32(s[0][t]) * warp_alu_f32(s[1][t]) +
+                  warp_alu_f32(s[2][t]);
+        d[t] = warp_alu_bits(sat ? warp_alu_saturate(f) : f);
+      }
+      break;
+    case WARP_ALU_MAD_LO_I32:
+      for (unsigned t = 0; t < W; t++)
+        d[t] = (unsigned)((unsigned)s[0][t] * (unsigned)s[1][t] +
+                          (unsigned)s[2][t]);
+      break;
+    case WARP_ALU_MOV:
+      for (unsigned t = 0; t < W; t++) d[t] = s[0][t];
+      break;
+    case WARP_ALU_SELP:
+      // bit 0 of the predicate is the zero flag
+      for (unsigned t = 0; t < W; t++) d[t] = (s[2][t] & 1) ? s[1][t] : s[0][t];
+      break;
+    case WARP_ALU_SETP_F32:
+    case WARP_ALU_SETP_S32:
+    case WARP_ALU_SETP_U32: {
+      bool r[MAX_WARP_SIZE];
+      unsigned cmpop = pI->get_cmpop();
+      if (op == WARP_ALU_SETP_F32) {
+        float a[MAX_WARP_SIZE], b[MAX_WARP_SIZE];
+        bool ordered[MAX_WARP_SIZE];
+        for (unsigned t = 0; t < W; t++) {
+          a[t] = warp_alu_f32(s[0][t]);
+          b[t] = warp_alu_f32(s[1][t]);
+          ordered[t] = !isNaN(a[t]) && !isNaN(b[t]);
+        }
+        warp_alu_compare(cmpop, a, b, r);
+        for (unsigned t = 0; t < W; t++) r[t] = r[t] && ordered[t];
+      } else if (op == WARP_ALU_SETP_S32) {
+        int a[MAX_WARP_SIZE], b[MAX_WARP_SIZE];
+        for (unsigned t = 0; t < W; t++) {
+          a[t] = (int)s[0][t];
+          b[t] = (int)s[1][t];
+        }
+        warp_alu_compare(cmpop, a, b, r);
+      } else {
+        unsigned a[MAX_WARP_SIZE], b[MAX_WARP_SIZE];
+        for (unsigned t = 0; t < W; t++) {
+          a[t] = s[0][t];
+          b[t] = s[1][t];
+        }
+        warp_alu_compare(cmpop, a, b, r);
+      }
+      // ptxplus sets the zero flag when the comparison is false
+      ptx_reg_t zero_flag;
+      zero_flag.pred = 1;
+      for (unsigned t = 0; t < W; t++) d[t] = r[t] ? 0 : zero_flag.u64;
+      break;
+    }
+    default:
+      assert(0);
+  }
+
+  if (dst->name() == "_") return;
+  for (unsigned t = 0; t < W; t++)
+    if (lanes.test(t)) threads[t]->set_reg_u64(dst, d[t]);
+}
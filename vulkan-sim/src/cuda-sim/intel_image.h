@@ -34,6 +34,7 @@
 #include <iostream>
 #include <assert.h>
 #include "astc_decomp.h"
+#include "astc_block_cache.h"
 #include "../abstract_hardware_model.h"
 
 #include "anv_include.h"
@@ -68,6 +69,8 @@ typedef struct Pixel{
     };
 } Pixel;
 
+static astc_block_cache g_astc_block_cache;
+
 float SRGB_to_linearRGB(float s)
 {
     assert(0 <= s && s <= 1);
@@ -102,11 +105,12 @@ Pixel load_image_pixel(const struct anv_image *image, uint32_t x, uint32_t y, ui
     VkImageTiling tiling;
     isl_tiling isl_tiling_mode;
     uint32_t row_pitch_B;
+    texture_metadata *texture = NULL;
     
     if (true)
     // if (use_external_launcher)
     {
-        texture_metadata *texture = (texture_metadata*) image;
+        texture = (texture_metadata*) image;
         setID = texture->setID;
         descID = texture->descID;
         size = texture->size;
@@ -149,27 +153,34 @@ Pixel load_image_pixel(const struct anv_image *image, uint32_t x, uint32_t y, ui
     unsigned original_x = x;
     unsigned original_y = y;
     y = 0;
-    unsigned max_lod = log2(width) - log2(16);
+    unsigned max_lod;
 
     // if (lod > max_lod) {
     //     lod = 0;
     // }
 
-    x = original_x / (pow(2, lod));
+    if (texture && lod < texture_metadata::LOD_ROWS) {
+        // the mip tail layout of the texture, set up once
+        max_lod = texture->max_lod;
+        x = original_x >> lod;
+        y = texture->lod_y_offset[lod] + (original_y >> lod);
+    } else {
+        max_lod = log2(width) - log2(16);
+        x = original_x / (pow(2, lod));
+        if (lod > 0) {
+            for (unsigned i = 0; i < lod; i++) {
+              if (i == 1) {
+                continue;
+              }
+              y += height / pow(2, i);
+            }
+        }
+        y = y + original_y / (pow(2, lod));
+    }
     if (lod > 1) {
         x += width / 2;
     }
 
-    if (lod > 0) {
-        for (unsigned i = 0; i < lod; i++) {
-          if (i == 1) {
-            continue;
-          }
-          y += height / pow(2, i);
-        }
-    }
-    y = y + original_y / (pow(2, lod));
-
     // if (lod > max_lod) {
     //     x += 64;
     //     y = y - 32 - 64;
@@ -213,7 +224,7 @@ Pixel load_image_pixel(const struct anv_image *image, uint32_t x, uint32_t y, ui
             if (lod > max_lod) {
                 return Pixel(0, 0, 255, 255);
             }
-            if(!basisu::astc::decompress(dst_colors, address + offset, true, 8, 8))
+            if(!g_astc_block_cache.decode(dst_colors, address + offset))
             {
                 printf("decoding error at pixel (%d, %d), lod is %u\n", x, y, lod);
                 exit(-2);
@@ -612,9 +623,7 @@ Pixel get_interpolated_pixel(struct anv_image_view *image_view, struct anv_sampl
                     ImageMemoryTransactionRecord transaction;
                     pixel[i][j] = load_image_pixel(image, xc, yc, 0, 1, transaction);
 
-                    for(int i = 0; i < transactions.size(); i++)
-                        if(transactions[i].address == transaction.address && transactions[i].size == transaction.size)
-                            continue;
+                    // duplicates are merged by set_txl_transactions
                     transactions.push_back(transaction);
                     TXL_DPRINTF("Adding (linear) txl transaction: 0x%x\n", transaction.address);
                 }
@@ -40,16 +40,14 @@ Coalescing_warp_intersection_table::Coalescing_warp_intersection_table()
     tableSize = 0;
 }
 
-std::pair<std::vector<MemoryTransactionRecord>, std::vector<MemoryStoreTransactionRecord> >
-Coalescing_warp_intersection_table::add_intersection(uint32_t hit_group_index, uint32_t tid, uint32_t primitiveID, uint32_t instanceID,
-                                                    const ptx_instruction *pI, ptx_thread_info *thread)
+void Coalescing_warp_intersection_table::add_intersection(uint32_t hit_group_index, uint32_t tid, uint32_t primitiveID, uint32_t instanceID,
+                                                    const ptx_instruction *pI, ptx_thread_info *thread,
+                                                    std::vector<MemoryTransactionRecord> &loads,
+                                                    std::vector<MemoryStoreTransactionRecord> &stores)
 {
     memory_space *mem = thread->get_global_memory();
 
     assert(tid < 32);
-    std::vector<MemoryTransactionRecord> loads;
-    std::vector<MemoryStoreTransactionRecord> stores;
-
     for (int i = 0; i < tableSize; i++) {
         loads.push_back(MemoryTransactionRecord(&table[i].hitGroupIndex, 4, TransactionType::Intersection_Table_Load));
         
@@ -70,7 +68,7 @@ Coalescing_warp_intersection_table::add_intersection(uint32_t hit_group_index, u
 
                 stores.push_back(MemoryStoreTransactionRecord(&table[i].thread_mask[tid], 1, StoreTransactionType::Intersection_Table_Store));
                 stores.push_back(MemoryStoreTransactionRecord(&table[i].shader_data[tid], 8, StoreTransactionType::Intersection_Table_Store));
-                return std::make_pair(loads, stores);
+                return;
             }
         }
     }
@@ -93,8 +91,6 @@ Coalescing_warp_intersection_table::add_intersection(uint32_t hit_group_index, u
     //     maxTableSize = tableSize;
     //     printf("max table size = %d\n", maxTableSize);
     // }
-
-    return std::make_pair(loads, stores);
 }
 
 
@@ -158,18 +154,16 @@ Baseline_warp_intersection_table::Baseline_warp_intersection_table()
 
 // static int maxTableSize = 0;
 
-std::pair<std::vector<MemoryTransactionRecord>, std::vector<MemoryStoreTransactionRecord> > 
-Baseline_warp_intersection_table::add_intersection(uint32_t hit_group_index, uint32_t tid, uint32_t primitiveID, uint32_t instanceID,
-                                                    const ptx_instruction *pI, ptx_thread_info *thread)
+void Baseline_warp_intersection_table::add_intersection(uint32_t hit_group_index, uint32_t tid, uint32_t primitiveID, uint32_t instanceID,
+                                                    const ptx_instruction *pI, ptx_thread_info *thread,
+                                                    std::vector<MemoryTransactionRecord> &loads,
+                                                    std::vector<MemoryStoreTransactionRecord> &stores)
 {
     assert(tid < 32);
     assert(index[tid] < INTERSECTION_TABLE_MAX_LENGTH);
 
     memory_space *mem = thread->get_global_memory();
 
-    std::vector<MemoryTransactionRecord> loads;
-    std::vector<MemoryStoreTransactionRecord> stores;
-
     mem->write(&(table[index[tid]].hitGroupIndex[tid]), sizeof(uint32_t), &hit_group_index, thread, pI);
     mem->write(&(table[index[tid]].shader_data[tid].primitiveID), sizeof(uint32_t), &primitiveID, thread, pI);
     mem->write(&(table[index[tid]].shader_data[tid].instanceID), sizeof(uint32_t), &instanceID, thread, pI);
@@ -178,8 +172,6 @@ Baseline_warp_intersection_table::add_intersection(uint32_t hit_group_index, uin
     stores.push_back(MemoryStoreTransactionRecord(&table[index[tid]].shader_data[tid], 8, StoreTransactionType::Intersection_Table_Store));
 
     index[tid]++;
-
-    return std::make_pair(loads, stores);
 }
 
 void Baseline_warp_intersection_table::clear() {
@@ -187,10 +179,6 @@ void Baseline_warp_intersection_table::clear() {
         index[i] = 0;
 }
 
-std::pair<std::vector<MemoryTransactionRecord>, std::vector<MemoryStoreTransactionRecord> >
-Baseline_warp_intersection_table::add_intersection(uint32_t hit_group_index, uint32_t tid, uint32_t primitiveID, uint32_t instanceID,
-                                                    const ptx_instruction *pI, ptx_thread_info *thread);
-
 bool Baseline_warp_intersection_table::shader_exists(uint32_t tid, uint32_t shader_counter, const ptx_instruction *pI, ptx_thread_info *thread) {
     return shader_counter < index[tid];
 }
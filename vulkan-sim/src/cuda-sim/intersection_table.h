@@ -49,24 +49,6 @@ enum class IntersectionTableType {
 struct MemoryTransactionRecord;
 struct MemoryStoreTransactionRecord;
 
-class warp_intersection_table {
-public:
-    // virtual warp_intersection_table() {}
-    // virtual ~warp_intersection_table() {}
-    virtual std::pair<std::vector<MemoryTransactionRecord>, std::vector<MemoryStoreTransactionRecord> >
-            add_intersection(uint32_t hit_group_index, uint32_t tid, uint32_t primitiveID, uint32_t instanceID,
-                            const ptx_instruction *pI, ptx_thread_info *thread) = 0;
-    
-    virtual void clear() = 0;
-    virtual bool shader_exists(uint32_t tid, uint32_t shader_counter, const ptx_instruction *pI, ptx_thread_info *thread) = 0;
-    virtual bool exit_shaders(uint32_t shader_counter, uint32_t tid) = 0;
-    virtual uint32_t get_primitiveID(uint32_t shader_counter, uint32_t tid, const ptx_instruction *pI, ptx_thread_info *thread) = 0;
-    virtual uint32_t get_instanceID(uint32_t shader_counter, uint32_t tid, const ptx_instruction *pI, ptx_thread_info *thread) = 0;
-    virtual uint32_t get_hitGroupIndex(uint32_t shader_counter, uint32_t tid, const ptx_instruction *pI, ptx_thread_info *thread) = 0;
-    virtual void* get_shader_data_address(uint32_t shader_counter, uint32_t tid) = 0;
-};
-
-
 typedef struct Coalescing_Entry {
     Coalescing_Entry() {
         for(int i = 0; i < 32; i++) {
@@ -83,7 +65,7 @@ typedef struct Coalescing_Entry {
     } shader_data[32];
 } Coalescing_Entry;
 
-class Coalescing_warp_intersection_table : public warp_intersection_table {
+class Coalescing_warp_intersection_table {
     Coalescing_Entry* table;
     uint32_t tableSize;
 
@@ -93,9 +75,11 @@ public:
         delete table;
     }
 
-    std::pair<std::vector<MemoryTransactionRecord>, std::vector<MemoryStoreTransactionRecord> >
-            add_intersection(uint32_t hit_group_index, uint32_t tid, uint32_t primitiveID, uint32_t instanceID,
-                            const ptx_instruction *pI, ptx_thread_info *thread);
+    // appends the table loads and stores of the new entry to loads and stores
+    void add_intersection(uint32_t hit_group_index, uint32_t tid, uint32_t primitiveID, uint32_t instanceID,
+                          const ptx_instruction *pI, ptx_thread_info *thread,
+                          std::vector<MemoryTransactionRecord> &loads,
+                          std::vector<MemoryStoreTransactionRecord> &stores);
     void clear();
     bool shader_exists(uint32_t tid, uint32_t shader_counter, const ptx_instruction *pI, ptx_thread_info *thread);
     bool exit_shaders(uint32_t shader_counter, uint32_t tid);
@@ -115,7 +99,7 @@ typedef struct Baseline_Entry {
     } shader_data[32];
 } Baseline_Entry;
 
-class Baseline_warp_intersection_table : public warp_intersection_table {
+class Baseline_warp_intersection_table {
     Baseline_Entry* table;
     uint32_t index[32];
 
@@ -127,9 +111,11 @@ public:
 
     void clear();
 
-    std::pair<std::vector<MemoryTransactionRecord>, std::vector<MemoryStoreTransactionRecord> >
-            add_intersection(uint32_t hit_group_index, uint32_t tid, uint32_t primitiveID, uint32_t instanceID,
-                            const ptx_instruction *pI, ptx_thread_info *thread);
+    // appends the table loads and stores of the new entry to loads and stores
+    void add_intersection(uint32_t hit_group_index, uint32_t tid, uint32_t primitiveID, uint32_t instanceID,
+                          const ptx_instruction *pI, ptx_thread_info *thread,
+                          std::vector<MemoryTransactionRecord> &loads,
+                          std::vector<MemoryStoreTransactionRecord> &stores);
     bool shader_exists(uint32_t tid, uint32_t shader_counter, const ptx_instruction *pI, ptx_thread_info *thread);
     bool exit_shaders(uint32_t shader_counter, uint32_t tid);
     uint32_t get_primitiveID(uint32_t shader_counter, uint32_t tid, const ptx_instruction *pI, ptx_thread_info *thread);
@@ -138,5 +124,17 @@ public:
     void* get_shader_data_address(uint32_t shader_counter, uint32_t tid);
 };
 
+// The table of a layout. VulkanRayTracing::intersectionTableType picks one at
+// compile time, so the calls traceRay and the intersection shaders make on
+// the per-warp tables are bound statically.
+template <IntersectionTableType type> struct intersection_table_of;
+
+template <> struct intersection_table_of<IntersectionTableType::Baseline> {
+    typedef Baseline_warp_intersection_table type;
+};
+
+template <> struct intersection_table_of<IntersectionTableType::Function_Call_Coalescing> {
+    typedef Coalescing_warp_intersection_table type;
+};
 
 #endif /* INTERSECTION_TABLE_H */
@@ -35,7 +35,8 @@ template <unsigned BSIZE>
 memory_space_impl<BSIZE>::memory_space_impl(std::string name,
                                             unsigned hash_size) {
   m_name = name;
-  MEM_MAP_RESIZE(hash_size);
+  m_last_index = 0;
+  m_last_block = NULL;
 
   m_log2_block_size = -1;
   for (unsigned n = 0, mask = 1; mask != 0; mask <<= 1, n++) {
@@ -47,10 +48,77 @@ memory_space_impl<BSIZE>::memory_space_impl(std::string name,
   assert(m_log2_block_size != (unsigned)-1);
 }
 
+template <unsigned BSIZE>
+memory_space_impl<BSIZE>::~memory_space_impl() {
+  for (unsigned l = 0; l < m_leaves.size(); l++) {
+    if (!m_leaves[l]) continue;
+    for (unsigned b = 0; b < LEAF_SIZE; b++) delete m_leaves[l]->blocks[b];
+    delete m_leaves[l];
+  }
+}
+
+template <unsigned BSIZE>
+mem_storage<BSIZE> *memory_space_impl<BSIZE>::find_block(
+    mem_addr_t blk_idx) const {
+  if (m_last_block && blk_idx == m_last_index) return m_last_block;
+  mem_addr_t leaf = blk_idx >> LEAF_BITS;
+  if (leaf >= m_leaves.size() || !m_leaves[leaf]) return NULL;
+  mem_storage<BSIZE> *b = m_leaves[leaf]->blocks[blk_idx & (LEAF_SIZE - 1)];
+  if (b) {
+    m_last_index = blk_idx;
+    m_last_block = b;
+  }
+  return b;
+}
+
+template <unsigned BSIZE>
+mem_storage<BSIZE> &memory_space_impl<BSIZE>::block(mem_addr_t blk_idx) {
+  mem_storage<BSIZE> *b = find_block(blk_idx);
+  if (b) return *b;
+  b = new mem_storage<BSIZE>();
+  slot(blk_idx) = b;
+  m_last_index = blk_idx;
+  m_last_block = b;
+  return *b;
+}
+
+template <unsigned BSIZE>
+mem_storage<BSIZE> *&memory_space_impl<BSIZE>::slot(mem_addr_t blk_idx) {
+  mem_addr_t leaf = blk_idx >> LEAF_BITS;
+  if (leaf >= m_leaves.size()) m_leaves.resize(leaf + 1, NULL);
+  if (!m_leaves[leaf]) m_leaves[leaf] = new leaf_t();
+  return m_leaves[leaf]->blocks[blk_idx & (LEAF_SIZE - 1)];
+}
+
+template <unsigned BSIZE>
+void memory_space_impl<BSIZE>::map_host(mem_addr_t addr, size_t length,
+                                        const void *host) {
+  const unsigned char *src = (const unsigned char *)host;
+  while (length > 0) {
+    unsigned offset = addr & (BSIZE - 1);
+    mem_addr_t index = addr >> m_log2_block_size;
+    size_t tx_bytes = BSIZE - offset;
+    if (tx_bytes > length) tx_bytes = length;
+    if (tx_bytes == BSIZE) {
+      mem_storage<BSIZE> *&b = slot(index);
+      delete b;
+      b = new mem_storage<BSIZE>(src);
+      m_last_index = index;
+      m_last_block = b;
+    } else {
+      // the rest of a partly covered block keeps its contents
+      block(index).write(offset, tx_bytes, src);
+    }
+    src += tx_bytes;
+    addr += tx_bytes;
+    length -= tx_bytes;
+  }
+}
+
 template <unsigned BSIZE>
 void memory_space_impl<BSIZE>::write_only(mem_addr_t offset, mem_addr_t index,
                                           size_t length, const void *data) {
-  m_data[index].write(offset, length, (const unsigned char *)data);
+  block(index).write(offset, length, (const unsigned char *)data);
 }
 
 template <unsigned BSIZE>
@@ -64,7 +132,7 @@ void memory_space_impl<BSIZE>::write(mem_addr_t addr, size_t length,
     // fast route for intra-block access
     unsigned offset = addr & (BSIZE - 1);
     unsigned nbytes = length;
-    m_data[index].write(offset, nbytes, (const unsigned char *)data);
+    block(index).write(offset, nbytes, (const unsigned char *)data);
   } else {
     // slow route for inter-block access
     unsigned nbytes_remain = length;
@@ -80,8 +148,8 @@ void memory_space_impl<BSIZE>::write(mem_addr_t addr, size_t length,
       }
 
       size_t tx_bytes = access_limit - offset;
-      m_data[page].write(offset, tx_bytes,
-                         &((const unsigned char *)data)[src_offset]);
+      block(page).write(offset, tx_bytes,
+                        &((const unsigned char *)data)[src_offset]);
 
       // advance pointers
       src_offset += tx_bytes;
@@ -117,8 +185,8 @@ void memory_space_impl<BSIZE>::read_single_block(mem_addr_t blk_idx,
         (addr + length), (blk_idx + 1) * BSIZE, blk_idx, BSIZE);
     throw 1;
   }
-  typename map_t::const_iterator i = m_data.find(blk_idx);
-  if (i == m_data.end()) {
+  const mem_storage<BSIZE> *b = find_block(blk_idx);
+  if (!b) {
     for (size_t n = 0; n < length; n++)
       ((unsigned char *)data)[n] = (unsigned char)0;
     // printf("GPGPU-Sim PTX:  WARNING reading %zu bytes from unititialized
@@ -126,7 +194,7 @@ void memory_space_impl<BSIZE>::read_single_block(mem_addr_t blk_idx,
   } else {
     unsigned offset = addr & (BSIZE - 1);
     unsigned nbytes = length;
-    i->second.read(offset, nbytes, (unsigned char *)data);
+    b->read(offset, nbytes, (unsigned char *)data);
   }
 }
 
@@ -166,11 +234,13 @@ void memory_space_impl<BSIZE>::read(mem_addr_t addr, size_t length,
 
 template <unsigned BSIZE>
 void memory_space_impl<BSIZE>::print(const char *format, FILE *fout) const {
-  typename map_t::const_iterator i_page;
-
-  for (i_page = m_data.begin(); i_page != m_data.end(); ++i_page) {
-    fprintf(fout, "%s %08x:", m_name.c_str(), i_page->first);
-    i_page->second.print(format, fout);
+  for (unsigned l = 0; l < m_leaves.size(); l++) {
+    if (!m_leaves[l]) continue;
+    for (unsigned b = 0; b < LEAF_SIZE; b++) {
+      if (!m_leaves[l]->blocks[b]) continue;
+      fprintf(fout, "%s %08x:", m_name.c_str(), (l << LEAF_BITS) + b);
+      m_leaves[l]->blocks[b]->print(format, fout);
+    }
   }
 }
 
@@ -32,12 +32,6 @@
 #include "../abstract_hardware_model.h"
 
 #include "../tr1_hash_map.h"
-#define mem_map tr1_hash_map
-#if tr1_hash_map_ismap == 1
-#define MEM_MAP_RESIZE(hash_size)
-#else
-#define MEM_MAP_RESIZE(hash_size) (m_data.rehash(hash_size))
-#endif
 
 #include <assert.h>
 #include <stdio.h>
@@ -45,6 +39,7 @@
 #include <string.h>
 #include <map>
 #include <string>
+#include <vector>
 
 typedef address_type mem_addr_t;
 
@@ -56,12 +51,29 @@ class mem_storage {
   mem_storage(const mem_storage &another) {
     m_data = (unsigned char *)calloc(1, BSIZE);
     memcpy(m_data, another.m_data, BSIZE);
+    m_host = false;
+  }
+  mem_storage() {
+    m_data = (unsigned char *)calloc(1, BSIZE);
+    m_host = false;
+  }
+  // reads the BSIZE bytes at host until the first write copies them
+  explicit mem_storage(const unsigned char *host) {
+    m_data = const_cast<unsigned char *>(host);
+    m_host = true;
+  }
+  ~mem_storage() {
+    if (!m_host) free(m_data);
   }
-  mem_storage() { m_data = (unsigned char *)calloc(1, BSIZE); }
-  ~mem_storage() { free(m_data); }
 
   void write(unsigned offset, size_t length, const unsigned char *data) {
     assert(offset + length <= BSIZE);
+    if (m_host) {
+      unsigned char *own = (unsigned char *)malloc(BSIZE);
+      memcpy(own, m_data, BSIZE);
+      m_data = own;
+      m_host = false;
+    }
     memcpy(m_data + offset, data, length);
   }
 
@@ -86,6 +98,7 @@ class mem_storage {
  private:
   unsigned m_nbytes;
   unsigned char *m_data;
+  bool m_host;  // m_data is mapped host memory, not owned
 };
 
 class ptx_thread_info;
@@ -99,31 +112,60 @@ class memory_space {
   virtual void write_only(mem_addr_t index, mem_addr_t offset, size_t length,
                           const void *data) = 0;
   virtual void read(mem_addr_t addr, size_t length, void *data) const = 0;
+  // the length bytes at addr read from host instead of a copy of it, which
+  // must stay valid and unchanged while they are mapped; writes go to a
+  // private copy of the block written
+  virtual void map_host(mem_addr_t addr, size_t length, const void *host) = 0;
   virtual void print(const char *format, FILE *fout) const = 0;
   virtual void set_watch(addr_t addr, unsigned watchpoint) = 0;
 };
 
+// Blocks are found through a two-level table: the high bits of the block
+// index pick a leaf in m_leaves, a flat array of LEAF_SIZE block pointers,
+// and the low bits the block in it. The block found last is remembered,
+// as consecutive accesses mostly stay in one block. Blocks are allocated on
+// their first write and read as zero before. Blocks fully covered by
+// map_host point into the host memory until they are written.
 template <unsigned BSIZE>
 class memory_space_impl : public memory_space {
  public:
   memory_space_impl(std::string name, unsigned hash_size);
+  virtual ~memory_space_impl();
 
   virtual void write(mem_addr_t addr, size_t length, const void *data,
                      ptx_thread_info *thd, const ptx_instruction *pI);
   virtual void write_only(mem_addr_t index, mem_addr_t offset, size_t length,
                           const void *data);
   virtual void read(mem_addr_t addr, size_t length, void *data) const;
+  virtual void map_host(mem_addr_t addr, size_t length, const void *host);
   virtual void print(const char *format, FILE *fout) const;
 
   virtual void set_watch(addr_t addr, unsigned watchpoint);
 
  private:
+  // small leaves for the small blocks of local memory, one per thread
+  static const unsigned LEAF_BITS = BSIZE >= 4096 ? 10 : 4;
+  static const unsigned LEAF_SIZE = 1 << LEAF_BITS;
+  struct leaf_t {
+    mem_storage<BSIZE> *blocks[LEAF_SIZE];
+  };
+
   void read_single_block(mem_addr_t blk_idx, mem_addr_t addr, size_t length,
                          void *data) const;
+  // NULL when the block was never written
+  mem_storage<BSIZE> *find_block(mem_addr_t blk_idx) const;
+  mem_storage<BSIZE> &block(mem_addr_t blk_idx);
+  // the table entry of the block, allocating its leaf
+  mem_storage<BSIZE> *&slot(mem_addr_t blk_idx);
+
+  memory_space_impl(const memory_space_impl &);
+  memory_space_impl &operator=(const memory_space_impl &);
+
   std::string m_name;
   unsigned m_log2_block_size;
-  typedef mem_map<mem_addr_t, mem_storage<BSIZE> > map_t;
-  map_t m_data;
+  std::vector<leaf_t *> m_leaves;
+  mutable mem_addr_t m_last_index;
+  mutable mem_storage<BSIZE> *m_last_block;
   std::map<unsigned, mem_addr_t> m_watchpoints;
 };
 
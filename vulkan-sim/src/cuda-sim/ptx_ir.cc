@@ -33,6 +33,7 @@ typedef void *yyscan_t;
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <algorithm>
 #include <list>
 #include "assert.h"
@@ -614,30 +615,37 @@ bool function_info::connect_break_targets()  // connecting break instructions
   return modified;
 }
 void function_info::do_pdom() {
-  create_basic_blocks();
-  connect_basic_blocks();
-  bool modified = false;
-  do {
-    find_dominators();
-    find_idominators();
-    modified = connect_break_targets();
-  } while (modified == true);
-
-  print_basic_blocks();
-
-  if (g_debug_execution >= 50) {
-    print_basic_block_links();
-    print_basic_block_dot();
-  }
-  if (g_debug_execution >= 2) {
-    print_dominators();
-  }
-  find_postdominators();
-  update_postdominators();
-  find_ipostdominators();
-  if (g_debug_execution >= 50) {
-    print_postdominators();
-    print_ipostdominators();
+  std::string cache = pdom_cache_path();
+  bool cached = !cache.empty() && load_pdom_cache(cache);
+  if (cached) {
+    printf("GPGPU-Sim PTX: reconvergence points for \'%s\' from %s\n",
+           m_name.c_str(), cache.c_str());
+  } else {
+    create_basic_blocks();
+    connect_basic_blocks();
+    bool modified = false;
+    do {
+      find_dominators();
+      find_idominators();
+      modified = connect_break_targets();
+    } while (modified == true);
+
+    print_basic_blocks();
+
+    if (g_debug_execution >= 50) {
+      print_basic_block_links();
+      print_basic_block_dot();
+    }
+    if (g_debug_execution >= 2) {
+      print_dominators();
+    }
+    find_postdominators();
+    update_postdominators();
+    find_ipostdominators();
+    if (g_debug_execution >= 50) {
+      print_postdominators();
+      print_ipostdominators();
+    }
   }
   printf("GPGPU-Sim PTX: pre-decoding instructions for \'%s\'...\n",
          m_name.c_str());
@@ -650,8 +658,101 @@ void function_info::do_pdom() {
   printf("GPGPU-Sim PTX: ... done pre-decoding instructions for \'%s\'.\n",
          m_name.c_str());
   fflush(stdout);
+  if (!cache.empty() && !cached) save_pdom_cache(cache);
   m_assembled = true;
 }
+
+const char *ptx_cache_dir() {
+  static const char *dir = NULL;
+  static bool checked = false;
+  if (!checked) {
+    dir = getenv("PTX_CACHE_DIR");
+    if (dir && !dir[0]) dir = NULL;
+    if (dir) system(("mkdir -p " + std::string(dir)).c_str());
+    checked = true;
+  }
+  return dir;
+}
+
+unsigned long long ptx_cache_hash(const std::string &data,
+                                  unsigned long long hash) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// The pairs are cached with their pcs made relative to the start of the
+// function, one "source target has_target_inst" line each, with target -2
+// when they reconverge at the return. The hash covers the name, the pcs
+// and the source of every instruction, all the pairs depend on.
+std::string function_info::pdom_cache_path() const {
+  const char *dir = ptx_cache_dir();
+  if (!dir) return "";
+  // bump the version when do_pdom changes
+  unsigned long long hash = ptx_cache_hash("pdom 1 " + m_name);
+  for (std::list<ptx_instruction *>::const_iterator i = m_instructions.begin();
+       i != m_instructions.end(); i++) {
+    hash = ptx_cache_hash(std::to_string((*i)->get_PC() - m_start_PC), hash);
+    hash = ptx_cache_hash((*i)->get_source(), hash);
+  }
+  char name[64];
+  snprintf(name, sizeof(name), "/%016llx.pdom", hash);
+  return dir + std::string(name);
+}
+
+bool function_info::load_pdom_cache(const std::string &path) {
+  FILE *fp = fopen(path.c_str(), "r");
+  if (!fp) return false;
+  std::vector<gpgpu_recon_t> pairs;
+  unsigned source;
+  int target;
+  int has_target_inst;
+  bool ok = true;
+  while (fscanf(fp, "%u %d %d", &source, &target, &has_target_inst) == 3) {
+    gpgpu_recon_t pair;
+    ok = source < m_instr_mem_size && m_instr_mem[source] &&
+         (!has_target_inst ||
+          (target >= 0 && (unsigned)target < m_instr_mem_size &&
+           m_instr_mem[target]));
+    if (!ok) break;
+    pair.source_pc = m_start_PC + source;
+    pair.source_inst = m_instr_mem[source];
+    pair.target_pc = target == -2 ? (address_type)-2 : m_start_PC + target;
+    pair.target_inst = has_target_inst ? m_instr_mem[target] : NULL;
+    pairs.push_back(pair);
+  }
+  ok = ok && feof(fp);
+  fclose(fp);
+  if (!ok) return false;
+
+  rec_pts pts;
+  pts.s_num_recon = pairs.size();
+  pts.s_kernel_recon_points =
+      (gpgpu_recon_t *)calloc(pairs.size() + 1, sizeof(gpgpu_recon_t));
+  std::copy(pairs.begin(), pairs.end(), pts.s_kernel_recon_points);
+  gpgpu_ctx->func_sim->g_rpts[this] = pts;
+  return true;
+}
+
+void function_info::save_pdom_cache(const std::string &path) {
+  rec_pts pts = gpgpu_ctx->func_sim->find_reconvergence_points(this);
+  std::string tmp = path + ".tmp" + std::to_string(getpid());
+  FILE *fp = fopen(tmp.c_str(), "w");
+  if (!fp) return;
+  for (int i = 0; i < pts.s_num_recon; i++) {
+    const gpgpu_recon_t &pair = pts.s_kernel_recon_points[i];
+    int target = pair.target_pc == (address_type)-2
+                     ? -2
+                     : (int)(pair.target_pc - m_start_PC);
+    fprintf(fp, "%u %d %d\n", (unsigned)(pair.source_pc - m_start_PC), target,
+            pair.target_inst != NULL);
+  }
+  fclose(fp);
+  // complete files only, also with other processes filling the cache
+  rename(tmp.c_str(), path.c_str());
+}
 void intersect(std::set<int> &A, const std::set<int> &B) {
   // return intersection of A and B in A
   for (std::set<int>::iterator a = A.begin(); a != A.end();) {
@@ -1343,6 +1444,8 @@ ptx_instruction::ptx_instruction(
   m_cache_option = 0;
   m_rounding_mode = RN_OPTION;
   m_compare_op = -1;
+  m_warp_alu_op = 0;
+  m_trace_kind = TRACE_UNKNOWN;
   m_saturation_mode = 0;
   m_geom_spec = 0;
   m_vector_spec = 0;
@@ -188,6 +188,7 @@ class symbol {
     m_is_tex = false;
     m_is_func_addr = false;
     m_reg_num_valid = false;
+    m_frame_slot = 0;
     m_function = NULL;
     m_reg_num = (unsigned)-1;
     m_arch_reg_num = (unsigned)-1;
@@ -218,6 +219,8 @@ class symbol {
     m_reg_num = regno;
     m_arch_reg_num = arch_regno;
   }
+  // a register of a function, kept in slot regno of its call frames
+  void set_frame_slot() { m_frame_slot = m_reg_num; }
 
   void set_address(addr_t addr) {
     m_address_valid = true;
@@ -269,6 +272,8 @@ class symbol {
   }
   void print_info(FILE *fp) const;
   unsigned uid() const { return m_uid; }
+  // 0 when the register is looked up by symbol in its frame
+  unsigned frame_slot() const { return m_frame_slot; }
 
  private:
   gpgpu_context *gpgpu_ctx;
@@ -296,6 +301,7 @@ class symbol {
   unsigned m_reg_num;
   unsigned m_arch_reg_num;
   bool m_reg_num_valid;
+  unsigned m_frame_slot;
 
   std::list<operand_info> m_initializer;
 };
@@ -1184,6 +1190,22 @@ class ptx_instruction : public warp_inst_t {
 
   unsigned get_m_instr_mem_index() { return m_instr_mem_index; }
   unsigned get_cmpop() const { return m_compare_op; }
+  // how warp_alu_exec runs the instruction, 0 when it does not
+  unsigned warp_alu_op() const { return m_warp_alu_op; }
+  // how execute_warp_inst_t traces the instruction, and the parts of its
+  // trace line that do not change between executions, set by trace_decode:
+  // the pc, then the outputs, the SASS opcode and the inputs
+  enum trace_kind_t {
+    TRACE_UNKNOWN,  // no SASS opcode for it
+    TRACE_IGNORED,
+    TRACE_INST,
+    TRACE_RAY_INST,
+  };
+  trace_kind_t trace_kind() const { return m_trace_kind; }
+  const std::string &trace_pc() const { return m_trace_pc; }
+  const std::string &trace_regs() const { return m_trace_regs; }
+  // the inputs of each line of a texture fetch
+  const std::string &trace_tex_regs() const { return m_trace_tex_regs; }
   const symbol *get_label() const { return m_label; }
   bool is_label() const {
     if (m_label) {
@@ -1290,8 +1312,14 @@ class ptx_instruction : public warp_inst_t {
   int m_membar_level;
   int m_instr_mem_index;  // index into m_instr_mem array
   unsigned m_inst_size;   // bytes
+  unsigned m_warp_alu_op;
+  trace_kind_t m_trace_kind;
+  std::string m_trace_pc;
+  std::string m_trace_regs;
+  std::string m_trace_tex_regs;
 
   virtual void pre_decode();
+  void trace_decode();
   void set_input_output_registers();
   friend class function_info;
   // backward pointer
@@ -1416,6 +1444,10 @@ class function_info {
   void find_ipostdominators();
   void print_ipostdominators();
   void do_pdom();  // function to call pdom analysis
+  // the do_pdom results kept in $PTX_CACHE_DIR, see ptx_cache_dir
+  std::string pdom_cache_path() const;
+  bool load_pdom_cache(const std::string &path);
+  void save_pdom_cache(const std::string &path);
 
   unsigned get_num_reconvergence_pairs();
 
@@ -1726,4 +1758,13 @@ void gpgpu_ptx_assemble(std::string kname, void *kinfo);
 unsigned ptx_kernel_shmem_size(void *kernel_impl);
 unsigned ptx_kernel_nregs(void *kernel_impl);
 
+// Directory of the caches that startup can skip work with, from
+// PTX_CACHE_DIR, NULL when it is not set: the reconvergence pairs of
+// do_pdom and the ptxinfo of the Vulkan shaders, in files named by a hash
+// of what they are derived from.
+const char *ptx_cache_dir();
+// FNV-1a, continuing from hash
+unsigned long long ptx_cache_hash(
+    const std::string &data, unsigned long long hash = 14695981039346656037ULL);
+
 #endif
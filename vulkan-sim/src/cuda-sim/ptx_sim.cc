@@ -35,6 +35,7 @@ typedef void *yyscan_t;
 #include "../gpgpu-sim/gpu-sim.h"
 #include "../gpgpu-sim/shader.h"
 #include "ptx.tab.h"
+#include "ser_model.h"
 #include "vulkan_ray_tracing.h"
 #include "vulkan_rt_thread_data.h"
 
@@ -176,7 +177,7 @@ ptx_thread_info::ptx_thread_info(kernel_info_t &kernel) : m_kernel(kernel) {
   m_hw_sid = -1;
   m_last_dram_callback.function = NULL;
   m_last_dram_callback.instruction = NULL;
-  m_regs.push_back(reg_map_t());
+  m_regs.push_back(ptx_reg_frame());
   m_debug_trace_regs_modified.push_back(reg_map_t());
   m_debug_trace_regs_read.push_back(reg_map_t());
   m_callstack.push_back(stack_entry());
@@ -418,7 +419,7 @@ void ptx_thread_info::callstack_push(unsigned pc, unsigned rpc,
   assert(m_func_info != NULL);
   m_callstack.push_back(stack_entry(m_symbol_table, m_func_info, pc, rpc,
                                     return_var_src, return_var_dst, call_uid));
-  m_regs.push_back(reg_map_t());
+  m_regs.push_back(ptx_reg_frame());
   m_debug_trace_regs_modified.push_back(reg_map_t());
   m_debug_trace_regs_read.push_back(reg_map_t());
   m_local_mem_stack_pointer += m_func_info->local_mem_framesize();
@@ -472,6 +473,7 @@ bool ptx_thread_info::callstack_pop() {
   // write return value into caller frame
   if (rv_dst != NULL) copy_buffer_to_frame(this, buffer);
 
+  if (ser_model::get().enabled()) ser_model::get().frame_popped(this);
   return m_callstack.empty();
 }
 
@@ -507,19 +509,20 @@ bool ptx_thread_info::callstack_pop_plus() {
   // write return value into caller frame
   if (rv_dst != NULL) copy_buffer_to_frame(this, buffer);
 
+  if (ser_model::get().enabled()) ser_model::get().frame_popped(this);
   return m_callstack.empty();
 }
 
 void ptx_thread_info::dump_callstack() const {
   std::list<stack_entry>::const_iterator c = m_callstack.begin();
-  std::list<reg_map_t>::const_iterator r = m_regs.begin();
+  std::list<ptx_reg_frame>::const_iterator r = m_regs.begin();
 
   printf("\n\n");
   printf("Call stack for thread uid = %u (sc=%u, hwtid=%u)\n", m_uid, m_hw_sid,
          m_hw_tid);
   while (c != m_callstack.end() && r != m_regs.end()) {
     const stack_entry &c_e = *c;
-    const reg_map_t &regs = *r;
+    const ptx_reg_frame &regs = *r;
     if (!c_e.m_valid) {
       printf("  <entry>                              #regs = %zu\n",
              regs.size());
@@ -558,8 +561,9 @@ void ptx_thread_info::dump_regs(FILE *fp) {
   if (m_regs.back().empty()) return;
   fprintf(fp, "Register File Contents:\n");
   fflush(fp);
+  reg_map_t regs = m_regs.back().as_map();
   reg_map_t::const_iterator r;
-  for (r = m_regs.back().begin(); r != m_regs.back().end(); ++r) {
+  for (r = regs.begin(); r != regs.end(); ++r) {
     const symbol *sym = r->first;
     ptx_reg_t value = r->second;
     std::string name = sym->name();
@@ -570,8 +574,9 @@ void ptx_thread_info::dump_regs(FILE *fp) {
 ptx_reg_t ptx_thread_info::get_reg(std::string regName) {
   assert(!m_regs.empty());
   assert(!m_regs.back().empty());
+  reg_map_t regs = m_regs.back().as_map();
   reg_map_t::const_iterator r;
-  for (r = m_regs.back().begin(); r != m_regs.back().end(); ++r) {
+  for (r = regs.begin(); r != regs.end(); ++r) {
     const symbol *sym = r->first;
     ptx_reg_t value = r->second;
     std::string name = sym->name();
@@ -629,7 +634,8 @@ void ptx_thread_info::set_npc(const function_info *f) {
   m_symbol_table = m_func_info->get_symtab();
 }
 
-void ptx_thread_info::set_txl_transactions(std::vector<ImageMemoryTransactionRecord> transactions) {
+void ptx_thread_info::set_txl_transactions(
+    const std::vector<ImageMemoryTransactionRecord> &transactions) {
   // Anything beyond bilinear is not implemented
   assert(transactions.size() <= 4);
 
@@ -637,7 +643,7 @@ void ptx_thread_info::set_txl_transactions(std::vector<ImageMemoryTransactionRec
   unsigned size = transactions[0].size;
   // Merge transactions
   for (auto it=transactions.begin(); it!=transactions.end(); it++) {
-    ImageMemoryTransactionRecord &record = *it;
+    const ImageMemoryTransactionRecord &record = *it;
     assert(record.size == size);
     addr_set.insert(addr_t(record.address));
   }
@@ -191,6 +191,58 @@ class ptx_warp_info {
 
 class symbol;
 
+// The registers of one call frame. Registers declared in a function are
+// numbered from 1 within it at PTX load (symbol::frame_slot), so they live
+// in a vector indexed by that number. Anything else (parameters, registers
+// at module scope, or a register whose slot another symbol of a different
+// function took in this frame) goes to a hash map, as all registers used to.
+class ptx_reg_frame {
+ public:
+  typedef tr1_hash_map<const symbol *, ptx_reg_t> reg_map_t;
+
+  ptx_reg_frame() : m_slots_used(0) {}
+
+  // NULL when reg was never set in this frame
+  ptx_reg_t *find(const symbol *reg, unsigned slot) {
+    if (slot) {
+      if (slot >= m_syms.size() || !m_syms[slot]) return NULL;
+      if (m_syms[slot] == reg) return &m_regs[slot];
+    }
+    reg_map_t::iterator i = m_others.find(reg);
+    return i == m_others.end() ? NULL : &i->second;
+  }
+  // the register, zero when it was never set
+  ptx_reg_t &get(const symbol *reg, unsigned slot) {
+    if (slot) {
+      if (slot >= m_syms.size()) {
+        m_syms.resize(slot + 1, NULL);
+        m_regs.resize(slot + 1);
+      }
+      if (!m_syms[slot]) {
+        m_syms[slot] = reg;
+        m_slots_used++;
+      }
+      if (m_syms[slot] == reg) return m_regs[slot];
+    }
+    return m_others[reg];
+  }
+  size_t size() const { return m_slots_used + m_others.size(); }
+  bool empty() const { return size() == 0; }
+  // every register set in this frame, for dumps and checkpoints
+  reg_map_t as_map() const {
+    reg_map_t regs = m_others;
+    for (unsigned i = 0; i < m_syms.size(); i++)
+      if (m_syms[i]) regs[m_syms[i]] = m_regs[i];
+    return regs;
+  }
+
+ private:
+  std::vector<ptx_reg_t> m_regs;
+  std::vector<const symbol *> m_syms;  // NULL for slots not set
+  unsigned m_slots_used;
+  reg_map_t m_others;
+};
+
 struct stack_entry {
   stack_entry() {
     m_symbol_table = NULL;
@@ -307,10 +359,14 @@ class ptx_thread_info {
   }
 
   void ptx_fetch_inst(inst_t &inst) const;
-  void ptx_exec_inst(warp_inst_t &inst, unsigned lane_id);
+  // with warp_alu the instruction itself is left to warp_alu_exec
+  void ptx_exec_inst(warp_inst_t &inst, unsigned lane_id,
+                     bool warp_alu = false);
 
   const ptx_version &get_ptx_version() const;
   void set_reg(const symbol *reg, const ptx_reg_t &value);
+  // set_reg for warp_alu_exec, which did its checks once for the warp
+  void set_reg_u64(const symbol *reg, unsigned long long value);
   void print_reg_thread(char *fname);
   void resume_reg_thread(char *fname, symbol_table *symtab);
   ptx_reg_t get_reg(const symbol *reg);
@@ -426,6 +482,7 @@ class ptx_thread_info {
     m_last_was_call = false;
   }
   unsigned get_return_PC() { return m_callstack.back().m_PC; }
+  unsigned callstack_depth() const { return m_callstack.size(); }
   void update_pc() { m_PC = m_NPC; }
   void dump_regs(FILE *fp);
   ptx_reg_t get_reg(std::string regName);
@@ -485,9 +542,12 @@ class ptx_thread_info {
   // Jin: get corresponding kernel grid for CDP purpose
   kernel_info_t &get_kernel() { return m_kernel; }
   
-  void set_rt_transactions(std::vector<MemoryTransactionRecord> transactions) { RT_transactions = transactions; }
-  void set_rt_store_transactions(std::vector<MemoryStoreTransactionRecord> store_transactions) { RT_store_transactions = store_transactions; }
-  void set_txl_transactions(std::vector<ImageMemoryTransactionRecord> transaction);
+  // hand over the records of the last trace ray, leaving the previous buffers
+  // in the arguments for reuse
+  void swap_rt_transactions(std::vector<MemoryTransactionRecord> &transactions) { RT_transactions.swap(transactions); }
+  void swap_rt_store_transactions(std::vector<MemoryStoreTransactionRecord> &store_transactions) { RT_store_transactions.swap(store_transactions); }
+  void set_txl_transactions(
+      const std::vector<ImageMemoryTransactionRecord> &transactions);
   void set_txl_transactions(ImageMemoryTransactionRecord transactions);
   void add_ray_intersect() { m_num_ray_intersections += 1; }
   void add_ray_properties(Ray ray) { m_ray = ray; }
@@ -544,8 +604,8 @@ class ptx_thread_info {
   std::list<stack_entry> m_callstack;
   unsigned m_local_mem_stack_pointer;
 
-  typedef tr1_hash_map<const symbol *, ptx_reg_t> reg_map_t;
-  std::list<reg_map_t> m_regs;
+  typedef ptx_reg_frame::reg_map_t reg_map_t;
+  std::list<ptx_reg_frame> m_regs;
   std::list<reg_map_t> m_debug_trace_regs_modified;
   std::list<reg_map_t> m_debug_trace_regs_read;
   bool m_enable_debug_trace;
@@ -567,6 +627,13 @@ bool isspace_shared(unsigned smid, addr_t addr);
 bool isspace_global(addr_t addr);
 memory_space_t whichspace(addr_t addr);
 
+// Warp-wide execution of the common ALU instructions, see instructions.cc
+unsigned warp_alu_decode(const ptx_instruction *pI);
+bool warp_alu_enabled(const ptx_instruction *pI,
+                      const gpgpu_functional_sim_config &config);
+void warp_alu_exec(const ptx_instruction *pI, ptx_thread_info **threads,
+                   const active_mask_t &lanes);
+
 extern unsigned g_ptx_thread_info_uid_next;
 
 #endif
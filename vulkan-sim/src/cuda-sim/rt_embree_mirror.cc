@@ -0,0 +1,171 @@
+// Embree copy of the traced acceleration structures, for resolving hits
+// see rt_embree_mirror.h
+
+#include "rt_embree_mirror.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+rt_embree_mirror::rt_embree_mirror() {
+  char const *env = getenv("VULKAN_SIM_EMBREE_TRACE");
+  m_enabled = env && atoi(env);
+  m_device = NULL;
+}
+
+rt_embree_mirror::~rt_embree_mirror() {
+  clear();
+  if (m_device) rtcReleaseDevice(m_device);
+}
+
+void rt_embree_mirror::clear() {
+  for (auto &t : m_tlas)
+    if (t.second.scene) rtcReleaseScene(t.second.scene);
+  for (auto &b : m_blas)
+    if (b.second.scene) rtcReleaseScene(b.second.scene);
+  m_tlas.clear();
+  m_blas.clear();
+}
+
+bool rt_embree_mirror::begin_blas(const void *blas) {
+  if (m_blas.count(blas)) return false;
+  blas_scene &b = m_blas[blas];
+  b.scene = NULL;
+  b.ok = true;
+  return true;
+}
+
+void rt_embree_mirror::add_triangle(const void *blas, const float v0[3],
+                                    const float v1[3], const float v2[3]) {
+  std::vector<float> &vertices = m_blas[blas].vertices;
+  vertices.insert(vertices.end(), v0, v0 + 3);
+  vertices.insert(vertices.end(), v1, v1 + 3);
+  vertices.insert(vertices.end(), v2, v2 + 3);
+}
+
+void rt_embree_mirror::reject_blas(const void *blas) {
+  blas_scene &b = m_blas[blas];
+  b.ok = false;
+  std::vector<float>().swap(b.vertices);
+}
+
+void rt_embree_mirror::commit_blas(blas_scene &blas) {
+  blas.scene = rtcNewScene(m_device);
+  unsigned triangles = blas.vertices.size() / 9;
+  if (triangles > 0) {
+    RTCGeometry geom = rtcNewGeometry(m_device, RTC_GEOMETRY_TYPE_TRIANGLE);
+    // Embree pads the buffers it allocates for its vector loads
+    float *vertices = (float *)rtcSetNewGeometryBuffer(
+        geom, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, 3 * sizeof(float),
+        triangles * 3);
+    memcpy(vertices, blas.vertices.data(),
+           blas.vertices.size() * sizeof(float));
+    unsigned *indices = (unsigned *)rtcSetNewGeometryBuffer(
+        geom, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, 3 * sizeof(unsigned),
+        triangles);
+    for (unsigned i = 0; i < triangles * 3; i++) indices[i] = i;
+    rtcCommitGeometry(geom);
+    rtcAttachGeometry(blas.scene, geom);
+    rtcReleaseGeometry(geom);
+  }
+  rtcCommitScene(blas.scene);
+  std::vector<float>().swap(blas.vertices);
+}
+
+void rt_embree_mirror::begin_tlas(const void *tlas) {
+  if (!m_device) m_device = rtcNewDevice(NULL);
+  tlas_scene &t = m_tlas[tlas];
+  t.scene = rtcNewScene(m_device);
+  t.ok = true;
+}
+
+void rt_embree_mirror::add_instance(const void *tlas, const void *blas,
+                                    const float world_to_object[4][4]) {
+  tlas_scene &t = m_tlas[tlas];
+  if (!t.ok) return;
+  blas_scene &b = m_blas[blas];
+  if (!b.ok) {
+    t.ok = false;
+    return;
+  }
+  if (!b.scene) commit_blas(b);
+
+  // Embree takes the object to world transform and moves the ray by its
+  // inverse, so hand it the inverse of the walk's, a 3x3 part m with the
+  // translation in the last column
+  float m[3][3];
+  for (unsigned r = 0; r < 3; r++)
+    for (unsigned c = 0; c < 3; c++) m[r][c] = world_to_object[c][r];
+  float det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+              m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+              m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+  if (det == 0 || !isfinite(det)) {
+    t.ok = false;
+    return;
+  }
+  float inv[3][3];
+  inv[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) / det;
+  inv[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) / det;
+  inv[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) / det;
+  inv[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) / det;
+  inv[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) / det;
+  inv[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) / det;
+  inv[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) / det;
+  inv[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) / det;
+  inv[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) / det;
+
+  float xfm[12];  // column major
+  for (unsigned r = 0; r < 3; r++) {
+    for (unsigned c = 0; c < 3; c++) xfm[c * 3 + r] = inv[r][c];
+    xfm[9 + r] = -(inv[r][0] * world_to_object[3][0] +
+                   inv[r][1] * world_to_object[3][1] +
+                   inv[r][2] * world_to_object[3][2]);
+  }
+
+  RTCGeometry inst = rtcNewGeometry(m_device, RTC_GEOMETRY_TYPE_INSTANCE);
+  rtcSetGeometryInstancedScene(inst, b.scene);
+  rtcSetGeometryTimeStepCount(inst, 1);
+  rtcSetGeometryTransform(inst, 0, RTC_FORMAT_FLOAT3X4_COLUMN_MAJOR, xfm);
+  rtcCommitGeometry(inst);
+  rtcAttachGeometry(t.scene, inst);
+  rtcReleaseGeometry(inst);
+}
+
+void rt_embree_mirror::commit_tlas(const void *tlas) {
+  tlas_scene &t = m_tlas[tlas];
+  if (t.ok) {
+    rtcCommitScene(t.scene);
+  } else {
+    rtcReleaseScene(t.scene);
+    t.scene = NULL;
+  }
+}
+
+bool rt_embree_mirror::closest_hit(const void *tlas, const float origin[3],
+                                   const float dir[3], float tmin, float tmax,
+                                   float *thit) const {
+  auto t = m_tlas.find(tlas);
+  if (t == m_tlas.end() || !t->second.ok) return false;
+
+  RTCIntersectContext context;
+  rtcInitIntersectContext(&context);
+  RTCRayHit rayhit;
+  rayhit.ray.org_x = origin[0];
+  rayhit.ray.org_y = origin[1];
+  rayhit.ray.org_z = origin[2];
+  rayhit.ray.tnear = tmin;
+  rayhit.ray.dir_x = dir[0];
+  rayhit.ray.dir_y = dir[1];
+  rayhit.ray.dir_z = dir[2];
+  rayhit.ray.time = 0;
+  rayhit.ray.tfar = tmax;
+  rayhit.ray.mask = -1;
+  rayhit.ray.id = 0;
+  rayhit.ray.flags = 0;
+  rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+  rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+  rtcIntersect1(t->second.scene, &context, &rayhit);
+
+  *thit = rayhit.hit.geomID == RTC_INVALID_GEOMETRY_ID ? tmax : rayhit.ray.tfar;
+  return true;
+}
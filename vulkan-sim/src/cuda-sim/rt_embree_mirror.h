@@ -0,0 +1,76 @@
+// Embree copy of the traced acceleration structures, for resolving hits
+//
+// With VULKAN_SIM_EMBREE_TRACE=1 traceRay first finds the distance of the
+// closest hit with rtcIntersect1 on an Embree scene mirroring the packed
+// TLAS and its BLASes, then walks the packed BVH as without it but with the
+// ray already cut just past that distance. The walk skips every subtree
+// behind the hit, so it visits the nodes a traversal ordered front to back
+// would, and it still tests the triangles itself: the hit and its
+// attributes are the ones of the packed BVH. The memory transactions are
+// those of that ideal order, not of the child order of the plain walk, so
+// they are a subset of the ones without the mirror. Should the walk find no
+// hit before the cut, it walks the whole ray again.
+//
+// A TLAS is mirrored the first time a launch traces it. TLASes with a
+// procedural leaf in one of their BLASes are not, and neither are rays that
+// stop at their first hit, since which hit their walk finds depends on the
+// order; those rays walk the whole BVH.
+
+#ifndef RT_EMBREE_MIRROR_H
+#define RT_EMBREE_MIRROR_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "embree3/rtcore.h"
+
+class rt_embree_mirror {
+ public:
+  rt_embree_mirror();
+  ~rt_embree_mirror();
+
+  bool enabled() const { return m_enabled; }
+  // forget every scene, for acceleration structures rebuilt between launches
+  void clear();
+
+  // BVHs are keyed by the host address of their header. false when the
+  // BLAS blas was mirrored before, otherwise starts its triangles
+  bool begin_blas(const void *blas);
+  void add_triangle(const void *blas, const float v0[3], const float v1[3],
+                    const float v2[3]);
+  // the BLAS has leaves Embree can not intersect for us
+  void reject_blas(const void *blas);
+
+  bool has_tlas(const void *tlas) const { return m_tlas.count(tlas) > 0; }
+  void begin_tlas(const void *tlas);
+  // instance of blas in the TLAS, world_to_object the columns of the
+  // transform the walk moves the ray into the BLAS with
+  void add_instance(const void *tlas, const void *blas,
+                    const float world_to_object[4][4]);
+  void commit_tlas(const void *tlas);
+
+  // distance along dir to the closest hit of the ray in the TLAS, tmax when
+  // it misses. false when the TLAS is not mirrored
+  bool closest_hit(const void *tlas, const float origin[3], const float dir[3],
+                   float tmin, float tmax, float *thit) const;
+
+ private:
+  struct blas_scene {
+    std::vector<float> vertices;  // three per triangle until committed
+    RTCScene scene;
+    bool ok;
+  };
+  struct tlas_scene {
+    RTCScene scene;
+    bool ok;
+  };
+
+  void commit_blas(blas_scene &blas);
+
+  bool m_enabled;
+  RTCDevice m_device;
+  std::unordered_map<const void *, blas_scene> m_blas;
+  std::unordered_map<const void *, tlas_scene> m_tlas;
+};
+
+#endif
@@ -0,0 +1,148 @@
+// Shader execution reordering of the hit and miss shaders, see ser_model.h
+
+#include "ser_model.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+
+#include "ptx_sim.h"
+
+static const unsigned SER_WARP_SIZE = 32;
+
+ser_model &ser_model::get() {
+  static ser_model model;
+  return model;
+}
+
+ser_model::ser_model() {
+  m_enabled = false;
+  m_material = false;
+  m_window = 0;
+  m_bytes = 0;
+}
+
+void ser_model::configure(const char *config, unsigned sm_warps) {
+  m_enabled = config && strcmp(config, "none") != 0;
+  if (!m_enabled) return;
+  char key;
+  if (sscanf(config, "%c:%u:%u", &key, &m_window, &m_bytes) != 3 ||
+      (key != 's' && key != 'm')) {
+    printf("GPGPU-Sim: -gpgpu_ser \'%s\' is not <key s or m>:<window warps, "
+           "0 = those of an SM>:<bytes per thread>\n",
+           config);
+    exit(1);
+  }
+  m_material = key == 'm';
+  if (!m_window) m_window = sm_warps ? sm_warps : 1;
+}
+
+void ser_model::shader_called(ptx_thread_info *thread, unsigned shader,
+                              unsigned material) {
+  dim3 cta = thread->get_ctaid(), ncta = thread->get_nctaid();
+  dim3 tid = thread->get_tid(), ntid = thread->get_ntid();
+  unsigned cta_threads = ntid.x * ntid.y * ntid.z;
+  unsigned cta_warps = (cta_threads + SER_WARP_SIZE - 1) / SER_WARP_SIZE;
+  unsigned linear_cta = cta.x + ncta.x * (cta.y + ncta.y * cta.z);
+  unsigned linear_tid = tid.x + ntid.x * (tid.y + ntid.y * tid.z);
+
+  call c;
+  c.warp = linear_cta * cta_warps + linear_tid / SER_WARP_SIZE;
+  c.lane = linear_tid % SER_WARP_SIZE;
+  c.phase = m_phase[(unsigned long long)c.warp * SER_WARP_SIZE + c.lane]++;
+  c.key = m_material ? (unsigned long long)shader << 32 | material : shader;
+  c.insts = 0;
+  running r = {m_calls.size(), thread->callstack_depth(),
+               thread->get_icount()};
+  m_running[thread].push_back(r);
+  m_calls.push_back(c);
+}
+
+void ser_model::frame_popped(ptx_thread_info *thread) {
+  std::unordered_map<ptx_thread_info *, std::vector<running> >::iterator it =
+      m_running.find(thread);
+  if (it == m_running.end()) return;
+  // shaders called from a shader return no later than it
+  std::vector<running> &stack = it->second;
+  while (!stack.empty() && thread->callstack_depth() <= stack.back().depth) {
+    m_calls[stack.back().call].insts =
+        thread->get_icount() - stack.back().icount;
+    stack.pop_back();
+  }
+  if (stack.empty()) m_running.erase(it);
+}
+
+void ser_model::print_dispatch(FILE *fp) {
+  if (!m_enabled) return;
+  // the calls of each warp and of each window, by phase
+  std::map<std::pair<unsigned, unsigned>, std::vector<const call *> > warps;
+  std::map<std::pair<unsigned, unsigned>, std::vector<const call *> > windows;
+  unsigned long long thread_insts = 0;
+  for (size_t i = 0; i < m_calls.size(); i++) {
+    const call &c = m_calls[i];
+    warps[std::make_pair(c.phase, c.warp)].push_back(&c);
+    windows[std::make_pair(c.phase, c.warp / m_window)].push_back(&c);
+    thread_insts += c.insts;
+  }
+
+  // a warp issues each key it holds for the longest thread of that key
+  unsigned long long launch_insts = 0;
+  for (auto &w : warps) {
+    std::unordered_map<unsigned long long, unsigned> longest;
+    for (const call *c : w.second)
+      longest[c->key] = std::max(longest[c->key], c->insts);
+    for (auto &l : longest) launch_insts += l.second;
+  }
+
+  unsigned long long reordered_insts = 0, moved = 0, reordered_warps = 0;
+  for (auto &w : windows) {
+    std::vector<const call *> &calls = w.second;
+    std::vector<unsigned> slots;
+    for (const call *c : calls) slots.push_back(c->warp);
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+    std::stable_sort(calls.begin(), calls.end(),
+                     [](const call *a, const call *b) {
+                       if (a->key != b->key) return a->key < b->key;
+                       if (a->warp != b->warp) return a->warp < b->warp;
+                       return a->lane < b->lane;
+                     });
+    for (size_t first = 0; first < calls.size(); first += SER_WARP_SIZE) {
+      size_t end = std::min(calls.size(), first + SER_WARP_SIZE);
+      unsigned warp = slots[first / SER_WARP_SIZE];
+      reordered_warps++;
+      std::unordered_map<unsigned long long, unsigned> longest;
+      for (size_t i = first; i < end; i++) {
+        const call *c = calls[i];
+        longest[c->key] = std::max(longest[c->key], c->insts);
+        moved += c->warp != warp || c->lane != i - first;
+      }
+      for (auto &l : longest) reordered_insts += l.second;
+    }
+  }
+
+  unsigned long long reorder_bytes = 2 * moved * m_bytes;
+  fprintf(fp, "ser: %zu shader calls in %zu warp phases, window = %u warps, "
+              "key = %s\n",
+          m_calls.size(), warps.size(), m_window,
+          m_material ? "material" : "shader");
+  fprintf(fp, "ser_launch_warp_insts = %llu, simt_efficiency = %.2f%%\n",
+          launch_insts,
+          launch_insts ? 100.0 * thread_insts / (launch_insts * SER_WARP_SIZE)
+                       : 0.0);
+  fprintf(fp,
+          "ser_reordered_warp_insts = %llu in %llu warps, simt_efficiency = "
+          "%.2f%%\n",
+          reordered_insts, reordered_warps,
+          reordered_insts
+              ? 100.0 * thread_insts / (reordered_insts * SER_WARP_SIZE)
+              : 0.0);
+  fprintf(fp,
+          "ser_moved_threads = %llu, reorder_bytes = %llu (%llu sectors)\n",
+          moved, reorder_bytes, (reorder_bytes + 31) / 32);
+  fflush(fp);
+  m_calls.clear();
+  m_running.clear();
+  m_phase.clear();
+}
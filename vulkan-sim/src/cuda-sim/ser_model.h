@@ -0,0 +1,74 @@
+// Shader execution reordering (SER) of the hit and miss shaders
+//
+// With -gpgpu_ser <key>:<window warps>:<bytes per thread> (none by default)
+// every closest hit and miss shader a thread calls after traversal is
+// recorded with its key, the shader ('s') or the shader and the instance
+// and geometry it hit ('m', a material key), and the instructions the
+// thread runs in it. At the end of a dispatch the calls are regrouped as a
+// reorder stage would: the n-th calls of the threads of a window of warps,
+// consecutive in launch order, are sorted by key and packed into the warps
+// of the window again, 32 threads each. A window of 0 is the warps an SM
+// holds at once, the rays a ray coherence engine can regroup. A warp
+// issues each of its keys for the most instructions a thread of that key
+// runs, so the warp instructions and SIMT efficiency of the hit shaders
+// are printed in the ray to thread mapping of the launch and after
+// reordering. A thread that changes lanes or warps spills and reloads its
+// bytes per thread of ray payload and hit state, the memory cost of the
+// reorder. The traces are those of the launch mapping; the warps of a CTA
+// are fixed in them, so the regrouped warps are modeled here rather than
+// written as warps of their own.
+
+#ifndef SER_MODEL_H
+#define SER_MODEL_H
+
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+
+class ptx_thread_info;
+
+class ser_model {
+ public:
+  static ser_model &get();
+
+  // -gpgpu_ser at the dispatch, sm_warps sets the window of 0
+  void configure(const char *config, unsigned sm_warps);
+  bool enabled() const { return m_enabled; }
+
+  // thread called the hit or miss shader of ID shader, material tells the
+  // instances and geometries apart
+  void shader_called(ptx_thread_info *thread, unsigned shader,
+                     unsigned material);
+  // thread returned from a call, the frame of a shader or any other
+  void frame_popped(ptx_thread_info *thread);
+  // the calls of the dispatch with and without reordering, then clears
+  // them
+  void print_dispatch(FILE *fp);
+
+ private:
+  ser_model();
+
+  struct call {
+    unsigned warp;  // in launch order
+    unsigned lane;
+    unsigned phase;  // the n-th call of the thread
+    unsigned long long key;
+    unsigned insts;
+  };
+  struct running {
+    size_t call;
+    size_t depth;  // of the call stack in the shader
+    unsigned icount;
+  };
+
+  bool m_enabled;
+  bool m_material;
+  unsigned m_window;
+  unsigned m_bytes;
+  std::vector<call> m_calls;
+  std::unordered_map<ptx_thread_info *, std::vector<running> > m_running;
+  // by warp * 32 + lane, the calls of the thread so far
+  std::unordered_map<unsigned long long, unsigned> m_phase;
+};
+
+#endif
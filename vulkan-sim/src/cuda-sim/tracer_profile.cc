@@ -0,0 +1,108 @@
+// Wall time and work of each traced draw and dispatch, see tracer_profile.h
+
+#include "tracer_profile.h"
+
+#include <stdlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static const char *phase_names[N_TRACER_PHASES] = {
+    "raster", "shader", "trace_ray", "texture", "trace_fmt"};
+static const char *count_names[N_TRACER_COUNTS] = {
+    "ctas", "warps", "rays", "texels", "trace_bytes"};
+
+tracer_profile &tracer_profile::get() {
+  static tracer_profile profile;
+  return profile;
+}
+
+tracer_profile::tracer_profile() {
+  char const *env = getenv("TRACER_PROFILE");
+  m_enabled = env && atoi(env);
+  m_frame = 0;
+  m_current.clear("");
+  m_begin = 0;
+  m_start_ticks = ticks();
+  m_start_time = std::chrono::steady_clock::now();
+}
+
+unsigned long long tracer_profile::ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+void tracer_profile::record::clear(const std::string &n) {
+  name = n;
+  wall = 0;
+  for (unsigned p = 0; p < N_TRACER_PHASES; p++) ticks[p] = 0;
+  for (unsigned c = 0; c < N_TRACER_COUNTS; c++) counts[c] = 0;
+}
+
+void tracer_profile::begin(const std::string &name) {
+  if (!m_enabled) return;
+  // what ran between two draws or dispatches keeps a row of its own
+  end();
+  m_current.clear(name);
+  m_begin = ticks();
+}
+
+void tracer_profile::end() {
+  if (!m_enabled) return;
+  bool empty = m_current.name.empty();
+  for (unsigned p = 0; p < N_TRACER_PHASES; p++)
+    empty = empty && !m_current.ticks[p];
+  for (unsigned c = 0; c < N_TRACER_COUNTS; c++)
+    empty = empty && !m_current.counts[c];
+  if (!empty) {
+    if (m_current.name.empty()) m_current.name = "other";
+    if (m_begin) m_current.wall = ticks() - m_begin;
+    m_records.push_back(m_current);
+  }
+  m_current.clear("");
+  m_begin = 0;
+}
+
+void tracer_profile::print_frame(FILE *fout) {
+  if (!m_enabled) return;
+  end();
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - m_start_time)
+                       .count();
+  unsigned long long elapsed = ticks() - m_start_ticks;
+  double per_sec = seconds > 0 && elapsed ? elapsed / seconds : 1;
+
+  record total;
+  total.clear("total");
+  fprintf(fout, "tracer_profile frame %u:\n", m_frame);
+  fprintf(fout, "%-16s %10s", "name", "wall_sec");
+  for (unsigned p = 0; p < N_TRACER_PHASES; p++)
+    fprintf(fout, " %10s", phase_names[p]);
+  for (unsigned c = 0; c < N_TRACER_COUNTS; c++)
+    fprintf(fout, " %12s", count_names[c]);
+  fprintf(fout, "\n");
+  for (unsigned i = 0; i <= m_records.size(); i++) {
+    const record &r = i < m_records.size() ? m_records[i] : total;
+    if (i < m_records.size()) {
+      total.wall += r.wall;
+      for (unsigned p = 0; p < N_TRACER_PHASES; p++)
+        total.ticks[p] += r.ticks[p];
+      for (unsigned c = 0; c < N_TRACER_COUNTS; c++)
+        total.counts[c] += r.counts[c];
+    }
+    fprintf(fout, "%-16s %10.3f", r.name.c_str(), r.wall / per_sec);
+    for (unsigned p = 0; p < N_TRACER_PHASES; p++)
+      fprintf(fout, " %10.3f", r.ticks[p] / per_sec);
+    for (unsigned c = 0; c < N_TRACER_COUNTS; c++)
+      fprintf(fout, " %12llu", r.counts[c]);
+    fprintf(fout, "\n");
+  }
+  fflush(fout);
+  m_records.clear();
+  m_frame++;
+}
@@ -0,0 +1,95 @@
+// Wall time and work of each traced draw and dispatch
+//
+// With TRACER_PROFILE=1 (environment) the tracer times the stages of every
+// vkCmdDraw draw and vkCmdTraceRaysKHR dispatch with the time stamp
+// counter, and counts what each of them did: CTAs and warps executed by
+// gpgpu_cuda_ptx_sim_main_func, rays traced, texels fetched and trace bytes
+// written. The stage times are inclusive: rays, texture sampling and trace
+// formatting run inside shader execution, rasterization does not. A table
+// of the draws and dispatches is printed when a frame ends, after the last
+// traced draw or after a dispatch, and the next frame starts from zero.
+// Without TRACER_PROFILE a timer costs the test of a flag.
+
+#ifndef TRACER_PROFILE_H
+#define TRACER_PROFILE_H
+
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+enum tracer_phase {
+  TRACER_RASTER = 0,    // primitive setup and rasterization of a draw
+  TRACER_SHADER,        // functional execution of a shader launch
+  TRACER_TRACE_RAY,     // traceRay, BVH traversal of a thread's ray
+  TRACER_TEXTURE,       // texture sampling and ASTC decode
+  TRACER_TRACE_FORMAT,  // the trace line of a warp instruction
+  N_TRACER_PHASES
+};
+
+enum tracer_count {
+  TRACER_CTAS = 0,
+  TRACER_WARPS,
+  TRACER_RAYS,
+  TRACER_TEXELS,
+  TRACER_TRACE_BYTES,
+  N_TRACER_COUNTS
+};
+
+class tracer_profile {
+ public:
+  static tracer_profile &get();
+  bool enabled() const { return m_enabled; }
+
+  // the draw or dispatch the following times and counts go to, until end
+  void begin(const std::string &name);
+  void end();
+  void add(tracer_phase phase, unsigned long long t) {
+    m_current.ticks[phase] += t;
+  }
+  void count(tracer_count c, unsigned long long n) {
+    if (m_enabled) m_current.counts[c] += n;
+  }
+  // the table of the frame's draws and dispatches, then a new frame
+  void print_frame(FILE *fout);
+
+  static unsigned long long ticks();
+
+ private:
+  tracer_profile();
+
+  struct record {
+    std::string name;
+    unsigned long long wall;
+    unsigned long long ticks[N_TRACER_PHASES];
+    unsigned long long counts[N_TRACER_COUNTS];
+    void clear(const std::string &n);
+  };
+
+  bool m_enabled;
+  unsigned m_frame;
+  record m_current;
+  unsigned long long m_begin;
+  std::vector<record> m_records;
+  // to convert ticks into seconds
+  unsigned long long m_start_ticks;
+  std::chrono::steady_clock::time_point m_start_time;
+};
+
+// adds the time of its scope to phase
+class tracer_timer {
+ public:
+  explicit tracer_timer(tracer_phase phase) : m_phase(phase) {
+    m_start = tracer_profile::get().enabled() ? tracer_profile::ticks() : 0;
+  }
+  ~tracer_timer() {
+    if (m_start)
+      tracer_profile::get().add(m_phase, tracer_profile::ticks() - m_start);
+  }
+
+ private:
+  tracer_phase m_phase;
+  unsigned long long m_start;
+};
+
+#endif
@@ -30,11 +30,26 @@
 #include "vulkan_rt_thread_data.h"
 
 #include <assert.h>
+#include <string.h>
+#include <unistd.h>
 #include <iostream>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
 #include <vector>
+#include <deque>
 #include <string>
 #include <fstream>
+#include <sstream>
 #include <cmath>
+#include <algorithm>
+#include <functional>
+#include <tuple>
+#include <thread>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #define BOOST_FILESYSTEM_VERSION 3
 #define BOOST_FILESYSTEM_NO_DEPRECATED 
 #include <boost/filesystem.hpp>
@@ -64,6 +79,11 @@ namespace fs = boost::filesystem;
 #include "../stream_manager.h"
 #include "../abstract_hardware_model.h"
 #include "vulkan_acceleration_structure_util.h"
+#include "dump_loader.h"
+#include "dump_store.h"
+#include "ser_model.h"
+#include "tracer_profile.h"
+#include "rt_embree_mirror.h"
 #include "../gpgpu-sim/vector-math.h"
 
 //#include "intel_image_util.h"
@@ -103,6 +123,12 @@ std::vector<shader_stage_info> VulkanRayTracing::shaders;
 struct anv_descriptor_set* VulkanRayTracing::descriptorSet[MAX_DESCRIPTOR_SETS] = {NULL};
 void* VulkanRayTracing::launcher_descriptorSets[MAX_DESCRIPTOR_SETS][MAX_DESCRIPTOR_SET_BINDINGS] = {NULL};
 void* VulkanRayTracing::launcher_deviceDescriptorSets[MAX_DESCRIPTOR_SETS][MAX_DESCRIPTOR_SET_BINDINGS] = {NULL};
+
+// Descriptor binding of the TLAS that traceRay translated last, -1 for none
+static int tlas_cache_set = -1;
+static int tlas_cache_binding = 0;
+static void *tlas_cache_device = NULL;
+static void *tlas_cache_host = NULL;
 std::vector<void*> VulkanRayTracing::child_addrs_from_driver;
 bool VulkanRayTracing::dumped = false;
 
@@ -117,7 +143,7 @@ unsigned VulkanRayTracing::texture_height = 0;
 VULKAN_APPS VulkanRayTracing::app_id = VULKAN_APPS_MAX;
 unsigned VulkanRayTracing::draw = 0;
 unsigned VulkanRayTracing::thread_count = 0;
-warp_intersection_table *** VulkanRayTracing::intersection_table;
+VulkanRayTracing::warp_intersection_table *** VulkanRayTracing::intersection_table;
 std::unordered_map<void *, unsigned> VulkanRayTracing::pipeline_shader_map;
 std::unordered_map<void *, struct VertexAttrib *>
     VulkanRayTracing::pipeline_vertex_map;
@@ -236,11 +262,271 @@ bool ray_box_test(float3 low, float3 high, float3 idirection, float3 origin, flo
     return (min <= max);
 }
 
+// The child boxes of a BVH6 internal node, one row of 8 lanes per axis with
+// the last two lanes empty, so all children are tested at once
+struct child_slabs {
+    alignas(16) float lo[3][8];
+    alignas(16) float hi[3][8];
+};
+
+void get_child_slabs(const struct GEN_RT_BVH_INTERNAL_NODE *node, child_slabs *slabs)
+{
+    const float origin[3] = {node->Origin.X, node->Origin.Y, node->Origin.Z};
+    const int32_t exponent[3] = {node->ChildBoundsExponentX, node->ChildBoundsExponentY, node->ChildBoundsExponentZ};
+    const uint32_t *lower[3] = {node->ChildLowerXBound, node->ChildLowerYBound, node->ChildLowerZBound};
+    const uint32_t *upper[3] = {node->ChildUpperXBound, node->ChildUpperYBound, node->ChildUpperZBound};
+    for (int a = 0; a < 3; a++)
+    {
+        // scaling by an exact power of two rounds like ldexpf, so the bounds
+        // match set_child_bounds
+        float scale = ldexpf(1.0f, exponent[a] - 8);
+        for (int i = 0; i < 6; i++)
+        {
+            slabs->lo[a][i] = origin[a] + (float)lower[a][i] * scale;
+            slabs->hi[a][i] = origin[a] + (float)upper[a][i] * scale;
+        }
+        slabs->lo[a][6] = slabs->lo[a][7] = 0;
+        slabs->hi[a][6] = slabs->hi[a][7] = 0;
+    }
+}
+
+// ray_box_test on every lane of slabs; bit i of the result is set when child i
+// is hit, at thit[i]
+unsigned ray_box_test6(const child_slabs &slabs, float3 idirection, float3 origin, float tmin, float tmax, float thit[8])
+{
+    unsigned hits = 0;
+#if defined(__SSE2__)
+    const float o[3] = {origin.x, origin.y, origin.z};
+    const float d[3] = {idirection.x, idirection.y, idirection.z};
+    for (int h = 0; h < 8; h += 4)
+    {
+        __m128 lo[3], hi[3];
+        for (int a = 0; a < 3; a++)
+        {
+            lo[a] = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&slabs.lo[a][h]), _mm_set1_ps(o[a])), _mm_set1_ps(d[a]));
+            hi[a] = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&slabs.hi[a][h]), _mm_set1_ps(o[a])), _mm_set1_ps(d[a]));
+        }
+        // magic_max7 and magic_min7 per lane; _mm_min_ps and _mm_max_ps pick
+        // their operands like MIN and MAX
+        __m128 min = _mm_max_ps(_mm_min_ps(lo[0], hi[0]), _mm_set1_ps(tmin));
+        min = _mm_max_ps(_mm_min_ps(lo[1], hi[1]), min);
+        min = _mm_max_ps(_mm_min_ps(lo[2], hi[2]), min);
+        __m128 max = _mm_min_ps(_mm_max_ps(lo[0], hi[0]), _mm_set1_ps(tmax));
+        max = _mm_min_ps(_mm_max_ps(lo[1], hi[1]), max);
+        max = _mm_min_ps(_mm_max_ps(lo[2], hi[2]), max);
+        _mm_storeu_ps(&thit[h], min);
+        hits |= (unsigned)_mm_movemask_ps(_mm_cmple_ps(min, max)) << h;
+    }
+#else
+    for (int i = 0; i < 8; i++)
+    {
+        float3 lo = {slabs.lo[0][i], slabs.lo[1][i], slabs.lo[2][i]};
+        float3 hi = {slabs.hi[0][i], slabs.hi[1][i], slabs.hi[2][i]};
+        if (ray_box_test(lo, hi, idirection, origin, tmin, tmax, thit[i]))
+            hits |= 1 << i;
+    }
+#endif
+    return hits;
+}
+
+// Internal nodes decoded by earlier rays. The threads of a warp trace one
+// after another and coherent rays walk the same nodes, so a node is mostly
+// decoded once per warp instead of once per ray. An entry keeps the raw node
+// and is compared on lookup, so a rebuilt BVH is decoded again.
+struct decoded_internal_node {
+    uint8_t *addr;
+    uint8_t raw[GEN_RT_BVH_INTERNAL_NODE_length * 4];
+    struct GEN_RT_BVH_INTERNAL_NODE node;
+    child_slabs slabs;
+};
+
+static const unsigned DECODED_NODE_ENTRIES = 1024;
+static decoded_internal_node decoded_nodes[DECODED_NODE_ENTRIES];
+
+const decoded_internal_node &decode_internal_node(uint8_t *addr)
+{
+    decoded_internal_node &entry = decoded_nodes[((uintptr_t)addr / sizeof(entry.raw)) % DECODED_NODE_ENTRIES];
+    if (entry.addr != addr || memcmp(entry.raw, addr, sizeof(entry.raw)))
+    {
+        entry.addr = addr;
+        memcpy(entry.raw, addr, sizeof(entry.raw));
+        GEN_RT_BVH_INTERNAL_NODE_unpack(&entry.node, addr);
+        get_child_slabs(&entry.node, &entry.slabs);
+    }
+    return entry;
+}
+
+// Quad leaves decoded the same way, with the triangle's first vertex and
+// edges ready for mt_ray_triangle_edges_test
+struct decoded_quad_leaf {
+    uint8_t *addr;
+    uint8_t raw[GEN_RT_BVH_QUAD_LEAF_length * 4];
+    struct GEN_RT_BVH_QUAD_LEAF leaf;
+    float3 p[3];
+    float3 v0v1;
+    float3 v0v2;
+};
+
+static decoded_quad_leaf decoded_quads[DECODED_NODE_ENTRIES];
+
+const decoded_quad_leaf &decode_quad_leaf(uint8_t *addr)
+{
+    decoded_quad_leaf &entry = decoded_quads[((uintptr_t)addr / sizeof(entry.raw)) % DECODED_NODE_ENTRIES];
+    if (entry.addr != addr || memcmp(entry.raw, addr, sizeof(entry.raw)))
+    {
+        entry.addr = addr;
+        memcpy(entry.raw, addr, sizeof(entry.raw));
+        GEN_RT_BVH_QUAD_LEAF_unpack(&entry.leaf, addr);
+        for(int i = 0; i < 3; i++)
+        {
+            entry.p[i].x = entry.leaf.QuadVertex[i].X;
+            entry.p[i].y = entry.leaf.QuadVertex[i].Y;
+            entry.p[i].z = entry.leaf.QuadVertex[i].Z;
+        }
+        entry.v0v1 = entry.p[1] - entry.p[0];
+        entry.v0v2 = entry.p[2] - entry.p[0];
+    }
+    return entry;
+}
+
+// Splits the BVH at root into the treelets of rt_treelets.h, keyed by the
+// addresses of the memory transactions
+void build_treelets(rt_treelets &treelets, uint8_t *root, int64_t device_offset)
+{
+    if (!treelets.enabled() || !treelets.begin_bvh((uint64_t)root + device_offset))
+        return;
+
+    std::deque<uint8_t *> roots(1, root);
+    while (!roots.empty())
+    {
+        unsigned treelet = treelets.add_treelet();
+        unsigned bytes = 0;
+        std::deque<uint8_t *> frontier(1, roots.front());
+        roots.pop_front();
+        while (!frontier.empty())
+        {
+            uint8_t *node_addr = frontier.front();
+            frontier.pop_front();
+
+            // What does not fit starts treelets of its own
+            unsigned node_bytes = GEN_RT_BVH_INTERNAL_NODE_length * 4;
+            if (bytes > 0 && bytes + node_bytes > treelets.max_bytes())
+            {
+                roots.push_back(node_addr);
+                roots.insert(roots.end(), frontier.begin(), frontier.end());
+                break;
+            }
+
+            struct GEN_RT_BVH_INTERNAL_NODE node;
+            GEN_RT_BVH_INTERNAL_NODE_unpack(&node, node_addr);
+            treelets.add_node(treelet, (uint64_t)node_addr + device_offset, node_bytes);
+            bytes += node_bytes;
+
+            // Leaves stay with their parent
+            uint8_t *child_addr = node_addr + (node.ChildOffset * 64);
+            for(int i = 0; i < 6; i++)
+            {
+                if (node.ChildSize[i] > 0)
+                {
+                    if (node.ChildType[i] == NODE_TYPE_INTERNAL)
+                        frontier.push_back(child_addr);
+                    else
+                    {
+                        treelets.add_node(treelet, (uint64_t)child_addr + device_offset, node.ChildSize[i] * 64);
+                        bytes += node.ChildSize[i] * 64;
+                    }
+                }
+                child_addr += node.ChildSize[i] * 64;
+            }
+        }
+    }
+}
+
+static rt_embree_mirror embree_mirror;
+
+// Adds the triangles of the BLAS at blas to the mirror, rejects it when it
+// has leaves that are not quads
+static void mirror_blas(rt_embree_mirror &mirror, uint8_t *blas)
+{
+    GEN_RT_BVH bvh;
+    GEN_RT_BVH_unpack(&bvh, blas);
+    std::vector<uint8_t *> nodes(1, blas + bvh.RootNodeOffset);
+    while (!nodes.empty())
+    {
+        uint8_t *node_addr = nodes.back();
+        nodes.pop_back();
+        struct GEN_RT_BVH_INTERNAL_NODE node;
+        GEN_RT_BVH_INTERNAL_NODE_unpack(&node, node_addr);
+
+        uint8_t *child_addr = node_addr + (node.ChildOffset * 64);
+        for(int i = 0; i < 6; i++)
+        {
+            if (node.ChildSize[i] > 0)
+            {
+                if (node.ChildType[i] == NODE_TYPE_INTERNAL)
+                    nodes.push_back(child_addr);
+                else
+                {
+                    struct GEN_RT_BVH_PRIMITIVE_LEAF_DESCRIPTOR leaf_descriptor;
+                    GEN_RT_BVH_PRIMITIVE_LEAF_DESCRIPTOR_unpack(&leaf_descriptor, child_addr);
+                    if (leaf_descriptor.LeafType != TYPE_QUAD)
+                    {
+                        mirror.reject_blas(blas);
+                        return;
+                    }
+                    struct GEN_RT_BVH_QUAD_LEAF leaf;
+                    GEN_RT_BVH_QUAD_LEAF_unpack(&leaf, child_addr);
+                    mirror.add_triangle(blas, &leaf.QuadVertex[0].X, &leaf.QuadVertex[1].X, &leaf.QuadVertex[2].X);
+                }
+            }
+            child_addr += node.ChildSize[i] * 64;
+        }
+    }
+}
+
+// Mirrors the TLAS at tlas, with its root node at root, and its BLASes in
+// mirror
+static void mirror_tlas(rt_embree_mirror &mirror, uint8_t *tlas, uint8_t *root)
+{
+    mirror.begin_tlas(tlas);
+    std::vector<uint8_t *> nodes(1, root);
+    while (!nodes.empty())
+    {
+        uint8_t *node_addr = nodes.back();
+        nodes.pop_back();
+        struct GEN_RT_BVH_INTERNAL_NODE node;
+        GEN_RT_BVH_INTERNAL_NODE_unpack(&node, node_addr);
+
+        uint8_t *child_addr = node_addr + (node.ChildOffset * 64);
+        for(int i = 0; i < 6; i++)
+        {
+            if (node.ChildSize[i] > 0)
+            {
+                if (node.ChildType[i] == NODE_TYPE_INTERNAL)
+                    nodes.push_back(child_addr);
+                else
+                {
+                    GEN_RT_BVH_INSTANCE_LEAF instanceLeaf;
+                    GEN_RT_BVH_INSTANCE_LEAF_unpack(&instanceLeaf, child_addr);
+                    uint8_t *blas = child_addr + instanceLeaf.BVHAddress;
+                    if (mirror.begin_blas(blas))
+                        mirror_blas(mirror, blas);
+                    float4x4 worldToObjectMatrix = instance_leaf_matrix_to_float4x4(&instanceLeaf.WorldToObjectm00);
+                    mirror.add_instance(tlas, blas, worldToObjectMatrix.m);
+                }
+            }
+            child_addr += node.ChildSize[i] * 64;
+        }
+    }
+    mirror.commit_tlas(tlas);
+}
+
 typedef struct StackEntry {
     uint8_t* addr;
     bool topLevel;
     bool leaf;
-    StackEntry(uint8_t* addr, bool topLevel, bool leaf): addr(addr), topLevel(topLevel), leaf(leaf) {}
+    unsigned level;
+    StackEntry(uint8_t* addr, bool topLevel, bool leaf, unsigned level): addr(addr), topLevel(topLevel), leaf(leaf), level(level) {}
 } StackEntry;
 
 bool find_primitive(uint8_t* address, int primitiveID, int instanceID, std::list<uint8_t *>& path, bool isTopLevel = true, bool isLeaf = false, bool isRoot = true)
@@ -342,26 +628,12 @@ void VulkanRayTracing::init(uint32_t launch_width, uint32_t launch_height)
     uint32_t width = (launch_width + 31) / 32;
     uint32_t height = launch_height;
 
-    if(intersectionTableType == IntersectionTableType::Baseline)
+    intersection_table = new warp_intersection_table**[width];
+    for(int i = 0; i < width; i++)
     {
-        intersection_table = new Baseline_warp_intersection_table**[width];
-        for(int i = 0; i < width; i++)
-        {
-            intersection_table[i] = new Baseline_warp_intersection_table*[height];
-            for(int j = 0; j < height; j++)
-                intersection_table[i][j] = new Baseline_warp_intersection_table();
-        }
-    }
-    else
-    {
-        intersection_table = new Coalescing_warp_intersection_table**[width];
-        for(int i = 0; i < width; i++)
-        {
-            intersection_table[i] = new Coalescing_warp_intersection_table*[height];
-            for(int j = 0; j < height; j++)
-                intersection_table[i][j] = new Coalescing_warp_intersection_table();
-        }
-
+        intersection_table[i] = new warp_intersection_table*[height];
+        for(int j = 0; j < height; j++)
+            intersection_table[i][j] = new warp_intersection_table();
     }
 }
 
@@ -382,6 +654,8 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
                    const ptx_instruction *pI,
                    ptx_thread_info *thread)
 {
+    tracer_timer timer(TRACER_TRACE_RAY);
+    tracer_profile::get().count(TRACER_RAYS, 1);
     // printf("## calling trceRay function. rayFlags = %d, cullMask = %d, sbtRecordOffset = %d, sbtRecordStride = %d, missIndex = %d, origin = (%f, %f, %f), Tmin = %f, direction = (%f, %f, %f), Tmax = %f, payload = %d\n",
     //         rayFlags, cullMask, sbtRecordOffset, sbtRecordStride, missIndex, origin.x, origin.y, origin.z, Tmin, direction.x, direction.y, direction.z, Tmax, payload);
     // std::list<uint8_t *> path;
@@ -401,23 +675,31 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
     if (use_external_launcher)
     {
         deviceAddress = (uint8_t*)_topLevelAS;
-        bool addressFound = false;
-        for (int i = 0; i < MAX_DESCRIPTOR_SETS; i++)
+        // Every ray of a launch traces the same TLAS, so remember the last translation
+        // and only scan the descriptor sets when the binding it came from changed
+        if (tlas_cache_set < 0 || tlas_cache_device != (void*)_topLevelAS ||
+            launcher_deviceDescriptorSets[tlas_cache_set][tlas_cache_binding] != (void*)_topLevelAS ||
+            launcher_descriptorSets[tlas_cache_set][tlas_cache_binding] != tlas_cache_host)
         {
-            for (int j = 0; j < MAX_DESCRIPTOR_SET_BINDINGS; j++)
+            tlas_cache_set = -1;
+            for (int i = 0; i < MAX_DESCRIPTOR_SETS && tlas_cache_set < 0; i++)
             {
-                if (launcher_deviceDescriptorSets[i][j] == (void*)_topLevelAS)
+                for (int j = 0; j < MAX_DESCRIPTOR_SET_BINDINGS; j++)
                 {
-                    _topLevelAS = launcher_descriptorSets[i][j];
-                    addressFound = true;
-                    break;
+                    if (launcher_deviceDescriptorSets[i][j] == (void*)_topLevelAS)
+                    {
+                        tlas_cache_set = i;
+                        tlas_cache_binding = j;
+                        tlas_cache_device = (void*)_topLevelAS;
+                        tlas_cache_host = launcher_descriptorSets[i][j];
+                        break;
+                    }
                 }
             }
-            if (addressFound)
-                break;
+            if (tlas_cache_set < 0)
+                abort();
         }
-        if (!addressFound)
-            abort();
+        _topLevelAS = tlas_cache_host;
     
         // Calculate offset between host and device for memory transactions
         device_offset = (uint64_t)deviceAddress - (uint64_t)_topLevelAS;
@@ -436,7 +718,8 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
     traversal_data.Tmin = Tmin;
     traversal_data.Tmax = Tmax;
 
-    std::ofstream traversalFile;
+    // Kept across rays so only debug runs pay for opening it
+    static std::ofstream traversalFile;
 
     if (debugTraversal)
     {
@@ -451,8 +734,12 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
     bool terminateOnFirstHit = rayFlags & SpvRayFlagsTerminateOnFirstHitKHRMask;
     bool skipClosestHitShader = rayFlags & SpvRayFlagsSkipClosestHitShaderKHRMask;
 
-    std::vector<MemoryTransactionRecord> transactions;
-    std::vector<MemoryStoreTransactionRecord> store_transactions;
+    // Reused across rays; the records are swapped into the thread at the end,
+    // so these get back the buffers of an earlier ray with their capacity
+    static std::vector<MemoryTransactionRecord> transactions;
+    static std::vector<MemoryStoreTransactionRecord> store_transactions;
+    transactions.clear();
+    store_transactions.clear();
 
     gpgpu_context *ctx = GPGPU_Context();
 
@@ -460,15 +747,17 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
     else ctx->func_sim->g_n_closesthit_rays++;
 
     unsigned total_nodes_accessed = 0;
-    std::map<uint8_t*, unsigned> tree_level_map;
+    unsigned max_level = 1;
     
 	// Create ray
 	Ray ray;
 	ray.make_ray(origin, direction, Tmin, Tmax);
+    float3 idir = calculate_idir(ray.get_direction()); //TODO: this works wierd if one of ray dimensions is 0
     thread->add_ray_properties(ray);
 
 	// Set thit to max
     float min_thit = ray.dir_tmax.w;
+    bool hit_found = false;
     struct GEN_RT_BVH_QUAD_LEAF closest_leaf;
     struct GEN_RT_BVH_INSTANCE_LEAF closest_instanceLeaf;    
     float4x4 closest_worldToObject, closest_objectToWorld;
@@ -483,6 +772,24 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
     ctx->func_sim->g_rt_mem_access_type[static_cast<int>(TransactionType::BVH_STRUCTURE)]++;
     
     uint8_t* topRootAddr = (uint8_t*)_topLevelAS + topBVH.RootNodeOffset;
+    build_treelets(ctx->func_sim->g_rt_treelets, topRootAddr, device_offset);
+
+    // Cut the ray just past the hit Embree finds, see rt_embree_mirror.h
+    bool seeded = false;
+    if (embree_mirror.enabled() && !terminateOnFirstHit)
+    {
+        if (!embree_mirror.has_tlas(_topLevelAS))
+            mirror_tlas(embree_mirror, (uint8_t*)_topLevelAS, topRootAddr);
+        float seed_thit;
+        if (embree_mirror.closest_hit(_topLevelAS, &origin.x, &direction.x, Tmin, Tmax, &seed_thit) && seed_thit < Tmax)
+        {
+            min_thit = std::min(Tmax, seed_thit + std::fabs(seed_thit) * 1e-4f + 1e-6f);
+            seeded = true;
+        }
+    }
+    size_t walk_first_transaction = transactions.size();
+    unsigned walk_mem_access_type[static_cast<int>(TransactionType::UNDEFINED)];
+    memcpy(walk_mem_access_type, ctx->func_sim->g_rt_mem_access_type, sizeof(walk_mem_access_type));
 
     // Get min/max
     if (!ctx->func_sim->g_rt_world_set) {
@@ -500,8 +807,11 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
         ctx->func_sim->g_rt_world_set = true;
     }
 
-    std::list<StackEntry> stack;
-    tree_level_map[topRootAddr] = 1;
+    // The stack keeps its storage across rays
+    static std::vector<StackEntry> stack;
+
+walk:
+    stack.clear();
     
     {
         float3 lo, hi;
@@ -513,14 +823,16 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
         hi.z = topBVH.BoundsMax.Z;
 
         float thit;
-        if(ray_box_test(lo, hi, calculate_idir(ray.get_direction()), ray.get_origin(), ray.get_tmin(), ray.get_tmax(), thit))
-            stack.push_back(StackEntry(topRootAddr, true, false));
+        if(ray_box_test(lo, hi, idir, ray.get_origin(), ray.get_tmin(), ray.get_tmax(), thit))
+            stack.push_back(StackEntry(topRootAddr, true, false, 1));
     }
 
     while (!stack.empty())
     {
         uint8_t *node_addr = NULL;
         uint8_t *next_node_addr = NULL;
+        unsigned node_level = 0;
+        unsigned next_node_level = 0;
 
         // traverse top level internal nodes
         assert(stack.back().topLevel);
@@ -528,15 +840,18 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
         if(!stack.back().leaf)
         {
             next_node_addr = stack.back().addr;
+            next_node_level = stack.back().level;
             stack.pop_back();
         }
 
         while (next_node_addr > 0)
         {
             node_addr = next_node_addr;
+            node_level = next_node_level;
             next_node_addr = NULL;
-            struct GEN_RT_BVH_INTERNAL_NODE node;
-            GEN_RT_BVH_INTERNAL_NODE_unpack(&node, node_addr);
+            const decoded_internal_node &decoded = decode_internal_node(node_addr);
+            const struct GEN_RT_BVH_INTERNAL_NODE &node = decoded.node;
+            const child_slabs &slabs = decoded.slabs;
             transactions.push_back(MemoryTransactionRecord((uint8_t*)((uint64_t)node_addr + device_offset), GEN_RT_BVH_INTERNAL_NODE_length * 4, TransactionType::BVH_INTERNAL_NODE));
             ctx->func_sim->g_rt_mem_access_type[static_cast<int>(TransactionType::BVH_INTERNAL_NODE)]++;
             total_nodes_accessed++;
@@ -546,17 +861,15 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
                 traversalFile << "traversing top level internal node " << (void *)node_addr << "\n";
             }
 
+            float thit[8];
+            unsigned hits = ray_box_test6(slabs, idir, ray.get_origin(), ray.get_tmin(), ray.get_tmax(), thit);
+
             bool child_hit[6];
-            float thit[6];
             for(int i = 0; i < 6; i++)
             {
                 if (node.ChildSize[i] > 0)
                 {
-                    float3 idir = calculate_idir(ray.get_direction()); //TODO: this works wierd if one of ray dimensions is 0
-                    float3 lo, hi;
-                    set_child_bounds(&node, i, &lo, &hi);
-
-                    child_hit[i] = ray_box_test(lo, hi, idir, ray.get_origin(), ray.get_tmin(), ray.get_tmax(), thit[i]);
+                    child_hit[i] = (hits >> i) & 1;
                     if(child_hit[i] && thit[i] >= min_thit)
                         child_hit[i] = false;
 
@@ -567,8 +880,8 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
                             traversalFile << "hit child number " << i << ", ";
                         else
                             traversalFile << "missed child number " << i << ", ";
-                        traversalFile << "lo = (" << lo.x << ", " << lo.y << ", " << lo.z << "), ";
-                        traversalFile << "hi = (" << hi.x << ", " << hi.y << ", " << hi.z << ")" << std::endl;
+                        traversalFile << "lo = (" << slabs.lo[0][i] << ", " << slabs.lo[1][i] << ", " << slabs.lo[2][i] << "), ";
+                        traversalFile << "hi = (" << slabs.hi[0][i] << ", " << slabs.hi[1][i] << ", " << slabs.hi[2][i] << ")" << std::endl;
                     }
                 }
                 else
@@ -587,21 +900,19 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
                     if(node.ChildType[i] != NODE_TYPE_INTERNAL)
                     {
                         assert(node.ChildType[i] == NODE_TYPE_INSTANCE);
-                        stack.push_back(StackEntry(child_addr, true, true));
-                        assert(tree_level_map.find(node_addr) != tree_level_map.end());
-                        tree_level_map[child_addr] = tree_level_map[node_addr] + 1;
+                        stack.push_back(StackEntry(child_addr, true, true, node_level + 1));
+                        max_level = std::max(max_level, node_level + 1);
                     }
                     else
                     {
                         if(next_node_addr == NULL) {
                             next_node_addr = child_addr; // TODO: sort by thit
-                            assert(tree_level_map.find(node_addr) != tree_level_map.end());
-                            tree_level_map[child_addr] = tree_level_map[node_addr] + 1;
+                            next_node_level = node_level + 1;
+                            max_level = std::max(max_level, node_level + 1);
                         }
                         else {
-                            stack.push_back(StackEntry(child_addr, true, false));
-                            assert(tree_level_map.find(node_addr) != tree_level_map.end());
-                            tree_level_map[child_addr] = tree_level_map[node_addr] + 1;
+                            stack.push_back(StackEntry(child_addr, true, false, node_level + 1));
+                            max_level = std::max(max_level, node_level + 1);
                         }
                     }
                 }
@@ -627,6 +938,7 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
             assert(stack.back().topLevel);
 
             uint8_t* leaf_addr = stack.back().addr;
+            unsigned leaf_level = stack.back().level;
             stack.pop_back();
 
             GEN_RT_BVH_INSTANCE_LEAF instanceLeaf;
@@ -654,11 +966,11 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
 
             float worldToObject_tMultiplier;
             Ray objectRay = make_transformed_ray(ray, worldToObjectMatrix, &worldToObject_tMultiplier);
+            float3 object_idir = calculate_idir(objectRay.get_direction());
 
             uint8_t * botLevelRootAddr = ((uint8_t *)((uint64_t)leaf_addr + instanceLeaf.BVHAddress)) + botLevelASAddr.RootNodeOffset;
-            stack.push_back(StackEntry(botLevelRootAddr, false, false));
-            assert(tree_level_map.find(leaf_addr) != tree_level_map.end());
-            tree_level_map[botLevelRootAddr] = tree_level_map[leaf_addr];
+            build_treelets(ctx->func_sim->g_rt_treelets, botLevelRootAddr, device_offset);
+            stack.push_back(StackEntry(botLevelRootAddr, false, false, leaf_level));
 
             if (debugTraversal)
             {
@@ -674,6 +986,8 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
             {
                 uint8_t* node_addr = NULL;
                 uint8_t* next_node_addr = stack.back().addr;
+                unsigned node_level = 0;
+                unsigned next_node_level = stack.back().level;
                 stack.pop_back();
                 
 
@@ -681,13 +995,15 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
                 while (next_node_addr > 0)
                 {
                     node_addr = next_node_addr;
+                    node_level = next_node_level;
                     next_node_addr = NULL;
 
                     // if(node_addr == *(++path.rbegin()))
                     //     printf("this is where things go wrong\n");
 
-                    struct GEN_RT_BVH_INTERNAL_NODE node;
-                    GEN_RT_BVH_INTERNAL_NODE_unpack(&node, node_addr);
+                    const decoded_internal_node &decoded = decode_internal_node(node_addr);
+                    const struct GEN_RT_BVH_INTERNAL_NODE &node = decoded.node;
+                    const child_slabs &slabs = decoded.slabs;
                     transactions.push_back(MemoryTransactionRecord((uint8_t*)((uint64_t)node_addr + device_offset), GEN_RT_BVH_INTERNAL_NODE_length * 4, TransactionType::BVH_INTERNAL_NODE));
                     ctx->func_sim->g_rt_mem_access_type[static_cast<int>(TransactionType::BVH_INTERNAL_NODE)]++;
                     total_nodes_accessed++;
@@ -697,17 +1013,15 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
                         traversalFile << "traversing bot level internal node " << (void *)node_addr << "\n";
                     }
 
+                    float thit[8];
+                    unsigned hits = ray_box_test6(slabs, object_idir, objectRay.get_origin(), objectRay.get_tmin(), objectRay.get_tmax(), thit);
+
                     bool child_hit[6];
-                    float thit[6];
                     for(int i = 0; i < 6; i++)
                     {
                         if (node.ChildSize[i] > 0)
                         {
-                            float3 idir = calculate_idir(objectRay.get_direction()); //TODO: this works wierd if one of ray dimensions is 0
-                            float3 lo, hi;
-                            set_child_bounds(&node, i, &lo, &hi);
-
-                            child_hit[i] = ray_box_test(lo, hi, idir, objectRay.get_origin(), objectRay.get_tmin(), objectRay.get_tmax(), thit[i]);
+                            child_hit[i] = (hits >> i) & 1;
                             if(child_hit[i] && thit[i] >= min_thit * worldToObject_tMultiplier)
                                 child_hit[i] = false;
 
@@ -717,8 +1031,8 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
                                     traversalFile << "hit child number " << i << ", ";
                                 else
                                     traversalFile << "missed child number " << i << ", ";
-                                traversalFile << "lo = (" << lo.x << ", " << lo.y << ", " << lo.z << "), ";
-                                traversalFile << "hi = (" << hi.x << ", " << hi.y << ", " << hi.z << ")" << std::endl;
+                                traversalFile << "lo = (" << slabs.lo[0][i] << ", " << slabs.lo[1][i] << ", " << slabs.lo[2][i] << "), ";
+                                traversalFile << "hi = (" << slabs.hi[0][i] << ", " << slabs.hi[1][i] << ", " << slabs.hi[2][i] << ")" << std::endl;
                             }
                         }
                         else
@@ -737,21 +1051,19 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
 
                             if(node.ChildType[i] != NODE_TYPE_INTERNAL)
                             {
-                                stack.push_back(StackEntry(child_addr, false, true));
-                                assert(tree_level_map.find(node_addr) != tree_level_map.end());
-                                tree_level_map[child_addr] = tree_level_map[node_addr] + 1;
+                                stack.push_back(StackEntry(child_addr, false, true, node_level + 1));
+                                max_level = std::max(max_level, node_level + 1);
                             }
                             else
                             {
                                 if(next_node_addr == 0) {
                                     next_node_addr = child_addr; // TODO: sort by thit
-                                    assert(tree_level_map.find(node_addr) != tree_level_map.end());
-                                    tree_level_map[child_addr] = tree_level_map[node_addr] + 1;
+                                    next_node_level = node_level + 1;
+                                    max_level = std::max(max_level, node_level + 1);
                                 }
                                 else {
-                                    stack.push_back(StackEntry(child_addr, false, false));
-                                    assert(tree_level_map.find(node_addr) != tree_level_map.end());
-                                    tree_level_map[child_addr] = tree_level_map[node_addr] + 1;
+                                    stack.push_back(StackEntry(child_addr, false, false, node_level + 1));
+                                    max_level = std::max(max_level, node_level + 1);
                                 }
                             }
                         }
@@ -783,25 +1095,18 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
 
                     if (leaf_descriptor.LeafType == TYPE_QUAD)
                     {
-                        struct GEN_RT_BVH_QUAD_LEAF leaf;
-                        GEN_RT_BVH_QUAD_LEAF_unpack(&leaf, leaf_addr);
+                        const decoded_quad_leaf &decoded = decode_quad_leaf(leaf_addr);
+                        const struct GEN_RT_BVH_QUAD_LEAF &leaf = decoded.leaf;
+                        const float3 *p = decoded.p;
 
                         // if(leaf.PrimitiveIndex0 == 9600)
                         // {
                         //     leaf.QuadVertex[2].Z = -0.001213;
                         // }
 
-                        float3 p[3];
-                        for(int i = 0; i < 3; i++)
-                        {
-                            p[i].x = leaf.QuadVertex[i].X;
-                            p[i].y = leaf.QuadVertex[i].Y;
-                            p[i].z = leaf.QuadVertex[i].Z;
-                        }
-
                         // Triangle intersection algorithm
                         float thit;
-                        bool hit = VulkanRayTracing::mt_ray_triangle_test(p[0], p[1], p[2], objectRay, &thit);
+                        bool hit = VulkanRayTracing::mt_ray_triangle_edges_test(p[0], decoded.v0v1, decoded.v0v2, objectRay, &thit);
 
                         assert(leaf.PrimitiveIndex1Delta == 0);
 
@@ -816,7 +1121,7 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
                             traversalFile << "p[0] = (" << p[0].x << ", " << p[0].y << ", " << p[0].z << ") ";
                             traversalFile << "p[1] = (" << p[1].x << ", " << p[1].y << ", " << p[1].z << ") ";
                             traversalFile << "p[2] = (" << p[2].x << ", " << p[2].y << ", " << p[2].z << ") ";
-                            traversalFile << "p[3] = (" << p[3].x << ", " << p[3].y << ", " << p[3].z << ")" << std::endl;
+                            traversalFile << "p[3] = (" << leaf.QuadVertex[3].X << ", " << leaf.QuadVertex[3].Y << ", " << leaf.QuadVertex[3].Z << ")" << std::endl;
                         }
 
                         float world_thit = thit / worldToObject_tMultiplier;
@@ -830,6 +1135,7 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
                             }
 
                             min_thit = thit / worldToObject_tMultiplier;
+                            hit_found = true;
                             min_thit_object = thit;
                             closest_leaf = leaf;
                             closest_instanceLeaf = instanceLeaf;
@@ -868,30 +1174,44 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
                         uint32_t hit_group_index = instanceLeaf.InstanceContributionToHitGroupIndex;
 
                         warp_intersection_table* table = intersection_table[thread->get_ctaid().x][thread->get_ctaid().y];
-                        auto intersectionTransactions = table->add_intersection(hit_group_index, thread->get_tid().x, leaf.PrimitiveIndex[0], instanceLeaf.InstanceID, pI, thread); // TODO: switch these to device addresses
+                        size_t first_table_load = transactions.size();
+                        table->add_intersection(hit_group_index, thread->get_tid().x, leaf.PrimitiveIndex[0], instanceLeaf.InstanceID, pI, thread, transactions, store_transactions); // TODO: switch these to device addresses
                         
-                        // transactions.insert(transactions.end(), intersectionTransactions.first.begin(), intersectionTransactions.first.end());
-                        for(auto & newTransaction : intersectionTransactions.first)
+                        // keep the table loads of addresses the ray has not loaded yet
+                        size_t kept = first_table_load;
+                        for(size_t i = first_table_load; i < transactions.size(); i++)
                         {
                             bool found = false;
-                            for(auto & transaction : transactions)
-                                if(transaction.address == newTransaction.address)
+                            for(size_t j = 0; j < kept; j++)
+                                if(transactions[j].address == transactions[i].address)
                                 {
                                     found = true;
                                     break;
                                 }
                             if(!found)
-                                transactions.push_back(newTransaction);
-
+                                transactions[kept++] = transactions[i];
                         }
-                        store_transactions.insert(store_transactions.end(), intersectionTransactions.second.begin(), intersectionTransactions.second.end());
+                        transactions.erase(transactions.begin() + kept, transactions.end());
                     }
                 }
             }
         }
     }
 
-    if (min_thit < ray.dir_tmax.w)
+    if (seeded && !hit_found)
+    {
+        // Embree and the walk disagree on a hit near the cut, walk the whole
+        // ray as if the cut never happened
+        seeded = false;
+        min_thit = ray.dir_tmax.w;
+        transactions.resize(walk_first_transaction);
+        memcpy(ctx->func_sim->g_rt_mem_access_type, walk_mem_access_type, sizeof(walk_mem_access_type));
+        total_nodes_accessed = 0;
+        max_level = 1;
+        goto walk;
+    }
+
+    if (hit_found)
     {
         traversal_data.hit_geometry = true;
         ctx->func_sim->g_rt_num_hits++;
@@ -932,8 +1252,8 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
     mem->write(device_traversal_data, sizeof(Traversal_data), &traversal_data, thread, pI);
     thread->RT_thread_data->traversal_data.push_back(device_traversal_data);
     
-    thread->set_rt_transactions(transactions);
-    thread->set_rt_store_transactions(store_transactions);
+    thread->swap_rt_transactions(transactions);
+    thread->swap_rt_store_transactions(store_transactions);
 
     if (debugTraversal)
     {
@@ -945,12 +1265,7 @@ void VulkanRayTracing::traceRay(VkAccelerationStructureKHR _topLevelAS,
     }
     ctx->func_sim->g_tot_nodes_per_ray += total_nodes_accessed;
 
-    unsigned level = 0;
-    for (auto it=tree_level_map.begin(); it!=tree_level_map.end(); it++) {
-        if (it->second > level) {
-            level = it->second;
-        }
-    }
+    unsigned level = max_level;
     if (level > ctx->func_sim->g_max_tree_depth) {
         ctx->func_sim->g_max_tree_depth = level;
     }
@@ -965,10 +1280,13 @@ void VulkanRayTracing::endTraceRay(const ptx_instruction *pI, ptx_thread_info *t
 }
 
 bool VulkanRayTracing::mt_ray_triangle_test(float3 p0, float3 p1, float3 p2, Ray ray_properties, float* thit)
+{
+    return mt_ray_triangle_edges_test(p0, p1 - p0, p2 - p0, ray_properties, thit);
+}
+
+bool VulkanRayTracing::mt_ray_triangle_edges_test(float3 p0, float3 v0v1, float3 v0v2, const Ray &ray_properties, float* thit)
 {
     // Moller Trumbore algorithm (from scratchapixel.com)
-    float3 v0v1 = p1 - p0;
-    float3 v0v2 = p2 - p0;
     float3 pvec = cross(ray_properties.get_direction(), v0v2);
     float det = dot(v0v1, pvec);
 
@@ -1206,19 +1524,39 @@ uint32_t VulkanRayTracing::registerShaders(char * shaderPath, gl_shader_stage sh
     // need to add all the magic registers to ptx.l to special_register, reference ayub ptx.l:225
 
     // PTX info
-    // Run the python script and get ptxinfo
-    std::cout << "GPGPUSIM: Generating PTXINFO for" << shaderPath << "info" << std::endl;
-    char command[400];
-    snprintf(command, sizeof(command), "python3 %s/scripts/generate_rt_ptxinfo.py %s", gpgpusim_root, shaderPath);
-    int result = system(command);
-    if (result != 0) {
-        printf("GPGPU-Sim PTX: ERROR ** while loading PTX (b) %d\n", result);
-        printf("               Ensure ptxas is in your path.\n");
-        exit(1);
+    // Run the python script and get ptxinfo, or take the one generated for
+    // the same PTX before from PTX_CACHE_DIR
+    std::string cached_ptxinfo;
+    if (ptx_cache_dir()) {
+        std::ifstream ptx(shaderPath, std::ios::binary);
+        std::stringstream text;
+        text << ptx.rdbuf();
+        char name[64];
+        snprintf(name, sizeof(name), "/%016llx.ptxinfo",
+                 ptx_cache_hash(text.str()));
+        cached_ptxinfo = ptx_cache_dir() + std::string(name);
     }
-
     char ptxinfo_filename[400];
     snprintf(ptxinfo_filename, sizeof(ptxinfo_filename), "%sinfo", shaderPath);
+    if (!cached_ptxinfo.empty() && std::ifstream(cached_ptxinfo).good()) {
+        std::cout << "GPGPUSIM: PTXINFO for " << shaderPath << " from " << cached_ptxinfo << std::endl;
+        snprintf(ptxinfo_filename, sizeof(ptxinfo_filename), "%s", cached_ptxinfo.c_str());
+    } else {
+        std::cout << "GPGPUSIM: Generating PTXINFO for" << shaderPath << "info" << std::endl;
+        char command[400];
+        snprintf(command, sizeof(command), "python3 %s/scripts/generate_rt_ptxinfo.py %s", gpgpusim_root, shaderPath);
+        int result = system(command);
+        if (result != 0) {
+            printf("GPGPU-Sim PTX: ERROR ** while loading PTX (b) %d\n", result);
+            printf("               Ensure ptxas is in your path.\n");
+            exit(1);
+        }
+        if (!cached_ptxinfo.empty()) {
+            // complete files only, also with other processes filling the cache
+            std::string tmp = cached_ptxinfo + ".tmp" + std::to_string(getpid());
+            system(("cp " + std::string(ptxinfo_filename) + " " + tmp + " && mv " + tmp + " " + cached_ptxinfo).c_str());
+        }
+    }
     ctx->gpgpu_ptx_info_load_from_external_file(ptxinfo_filename); // TODO: make a version where it just loads my ptxinfo instead of generating a new one
 
     context->register_function(fat_cubin_handle, shader.function_name, deviceFunction.c_str());
@@ -1246,7 +1584,8 @@ void VulkanRayTracing::invoke_gpgpusim()
 // int CmdTraceRaysKHRID = 0;
 
 unsigned block_size = 64;
-void VulkanRayTracing::run_shader(unsigned shader_id, unsigned thread_count) {
+void VulkanRayTracing::run_shader(unsigned shader_id, unsigned thread_count,
+                                  const std::vector<unsigned> &draw_ctas) {
   gpgpu_context *ctx = GPGPU_Context();
   CUctx_st *context = GPGPUSim_Context(ctx);
 
@@ -1269,7 +1608,8 @@ void VulkanRayTracing::run_shader(unsigned shader_id, unsigned thread_count) {
   }
   unsigned block_count = (thread_count + block_size - 1) / block_size;
 //   unsigned block_count = 16 * 16;
-  context->get_device()->get_gpgpu()->gtrace << "block_dim, " << block_size << std::endl;
+  context->get_device()->get_gpgpu()->trace_kernel_begin(
+      shader.function_name, block_count, block_size, draw_ctas);
   dim3 blockDim = dim3(block_size, 1, 1);
   dim3 gridDim = dim3(block_count, 1, 1);
   gpgpu_ptx_sim_arg_list_t args;
@@ -1279,25 +1619,85 @@ void VulkanRayTracing::run_shader(unsigned shader_id, unsigned thread_count) {
   struct CUstream_st *stream = 0;
 
   stream_operation op(grid, ctx->func_sim->g_ptx_sim_mode, stream);
+  unsigned grid_uid = grid->get_uid();
   ctx->the_gpgpusim->g_stream_manager->push(op);
 
   fflush(stdout);
 
-  while (!op.is_done() && !op.get_kernel()->done()) {
-    printf("waiting for op to finish\n");
-    sleep(1);
-    continue;
+  ctx->the_gpgpusim->g_stream_manager->wait_kernel_finished(grid_uid);
+}
+
+// runs body(chunk, begin, end) over at most threads consecutive chunks of
+// [0, n), the last one on the calling thread
+static void parallel_chunks(
+    unsigned n, unsigned threads,
+    const std::function<void(unsigned, unsigned, unsigned)> &body) {
+  unsigned chunks = std::max(1u, std::min(threads, n));
+  std::vector<std::thread> workers;
+  for (unsigned c = 0; c < chunks; c++) {
+    unsigned begin = (unsigned long long)n * c / chunks;
+    unsigned end = (unsigned long long)n * (c + 1) / chunks;
+    if (c + 1 < chunks)
+      workers.push_back(std::thread(body, c, begin, end));
+    else
+      body(c, begin, end);
   }
+  for (std::thread &worker : workers) worker.join();
 }
 
 void print_memcpy(std::string name, unsigned addr, unsigned size,
                   unsigned per_cta_size) {
   gpgpu_context *ctx = GPGPU_Context();
   CUctx_st *context = GPGPUSim_Context(ctx);
-  context->get_device()->get_gpgpu()->gtrace
-      << name << ",0x" << std::hex << addr << "," << std::dec << size
-      << "," << per_cta_size << std::endl;
+  std::stringstream line;
+  line << name << ",0x" << std::hex << addr << "," << std::dec << size << ","
+       << per_cta_size;
+  context->get_device()->get_gpgpu()->trace_command(line.str());
+
+}
+
+// an Attachment command for accel-sim's -gpgpu_compression, the compressed
+// size in sectors of every tile of the surface at base, estimated with a
+// delta coder: a tile keeps the first pixel and, per channel, the XOR of
+// each later pixel with it in as many bits as the widest one needs
+static void print_attachment(const char *kind, uint64_t base,
+                             const float *data, unsigned pixels,
+                             unsigned channels) {
+  const unsigned tile = 256, sector = 32;
+  unsigned tile_pixels = tile / sizeof(float) / channels;
+  std::vector<unsigned> sectors;
+  for (unsigned first = 0; first < pixels; first += tile_pixels) {
+    unsigned n = std::min(tile_pixels, pixels - first);
+    unsigned bits = channels * (32 + 5);
+    for (unsigned c = 0; c < channels; c++) {
+      uint32_t start, delta = 0;
+      memcpy(&start, &data[first * channels + c], sizeof(start));
+      for (unsigned p = 1; p < n; p++) {
+        uint32_t word;
+        memcpy(&word, &data[(first + p) * channels + c], sizeof(word));
+        delta |= word ^ start;
+      }
+      unsigned width = 0;
+      while (delta >> width) width++;
+      bits += (n - 1) * width;
+    }
+    unsigned s = (bits + sector * 8 - 1) / (sector * 8);
+    sectors.push_back(std::max(1u, std::min(s, tile / sector)));
+  }
 
+  std::stringstream line;
+  line << "Attachment," << kind << ",0x" << std::hex << base << std::dec << ","
+       << pixels * channels * sizeof(float) << "," << tile;
+  for (unsigned t = 0; t < sectors.size();) {
+    unsigned run = t;
+    while (run < sectors.size() && sectors[run] == sectors[t]) run++;
+    line << "," << run - t << "x" << sectors[t];
+    t = run;
+  }
+  GPGPUSim_Context(GPGPU_Context())
+      ->get_device()
+      ->get_gpgpu()
+      ->trace_command(line.str());
 }
 
 const bool writeImageBinary = true;
@@ -1308,6 +1708,454 @@ const bool writeImageBinary = true;
 unsigned DRAW_START = 1;
 unsigned DRAW_END = 2;
 
+// draws traced and render resolution, read from the environment on the
+// first vkCmdDraw:
+//   START_DRAW, END_DRAW  the first draw traced and one past the last
+//   SKIP_DRAWS            draws not traced, as from-to (to excluded) or
+//                         from- (to the end) ranges separated by commas;
+//                         per-app defaults when unset
+//   RENDER_WIDTH/HEIGHT   the framebuffer size, 0 for the app's viewport
+//   TRACE_EXIT            0 to return to the app after the last draw
+//                         instead of exiting
+//   VS_CACHE_DIR          vertex shader outputs of each draw are saved
+//                         there, and a draw with saved outputs skips its
+//                         vertex shader
+struct draw_config_t {
+  unsigned start;
+  unsigned end;
+  std::vector<std::pair<unsigned, unsigned>> skips;
+  unsigned width;
+  unsigned height;
+  bool exit_when_done;
+  std::string vs_cache_dir;
+  // how the fragments fill the warps, see order_fragments
+  std::string frag_order;
+  bool hiz;      // skip occluded tiles while rasterizing
+  bool early_z;  // shade only the fragments that stay visible
+  // post-transform vertex cache entries, 0 for the batches of
+  // assign_vertex_threads, and whether it replaces least recently used
+  unsigned vertex_cache;
+  bool vertex_cache_lru;
+  // consecutive draws whose vertex shaders run in one launch
+  unsigned batch;
+  // coarse shading, see parse_shading_rates: the rates of SHADING_RATE by
+  // draw range and those of SHADING_RATE_IMAGE by tile, width | height << 4
+  std::vector<std::pair<std::pair<unsigned, unsigned>, unsigned char>>
+      shading_rates;
+  std::vector<unsigned char> shading_rate_image;
+  bool done;  // the traced draws all ran
+};
+
+static unsigned env_unsigned(const char *name, unsigned default_value) {
+  char const *env = std::getenv(name);
+  if (env == NULL || !env[0]) return default_value;
+  return std::stoul(std::string(env));
+}
+
+// Buffers, vertex buffers and textures of the descriptor sets are copied
+// into global memory unless VULKAN_ZERO_COPY=1, which maps them in place:
+// faster for large scenes, but only right while the application keeps the
+// memory alive and unchanged for the rest of the simulation.
+static void upload_to_gpu(gpgpu_t *gpu, void *dev_ptr, const void *host,
+                          size_t size) {
+  static const bool zero_copy = env_unsigned("VULKAN_ZERO_COPY", 0);
+  if (zero_copy)
+    gpu->map_to_gpu((size_t)dev_ptr, host, size);
+  else
+    gpu->memcpy_to_gpu((size_t)dev_ptr, host, size);
+}
+
+// Every draw dumps the textures and buffers of its descriptor sets again,
+// though most are the same as for the previous draw. The last dump of each
+// set and binding is remembered with a hash of the data and its metadata; an
+// unchanged one does not rewrite the gpgpusimShaders files. With
+// DESCRIPTOR_REUSE=1 it also keeps its global memory copy instead of getting
+// a new allocation and upload, for textures and uniform buffers, which the
+// shaders do not write. That changes the traced addresses, so it is opt-in.
+struct descriptor_dump_t {
+  const void *host;
+  uint64_t size;
+  uint64_t hash;
+  void *dev_ptr;
+};
+
+static std::map<std::pair<unsigned, unsigned>, descriptor_dump_t>
+    texture_dumps, buffer_dumps;
+
+// true when the dump at key is the same as the last one; fills in the
+// device copy of that dump when it may be reused
+static bool same_dump(
+    std::map<std::pair<unsigned, unsigned>, descriptor_dump_t> &dumps,
+    unsigned set, unsigned binding, const void *host, uint64_t size,
+    uint64_t hash, bool reusable, void **dev_ptr) {
+  static const bool reuse = env_unsigned("DESCRIPTOR_REUSE", 0);
+  auto last = dumps.find(std::make_pair(set, binding));
+  if (last == dumps.end() || last->second.host != host ||
+      last->second.size != size || last->second.hash != hash)
+    return false;
+  if (reuse && reusable) *dev_ptr = last->second.dev_ptr;
+  return true;
+}
+
+// Variable rate shading. SHADING_RATE is a comma separated list of rates
+// WxH, one of 1x1, 1x2, 2x1, 2x2, 2x4, 4x2 and 4x4, for all draws or, as
+// draw:rate or from-to:rate (to excluded, from- to the end), for some; a
+// later entry overrides an earlier one. SHADING_RATE_IMAGE names a text file
+// of one rate per 8x8 screen tile, row by row, the shading rate image. A
+// tile shades at the coarser of the two in each direction, as with the max
+// combiner of VK_KHR_fragment_shading_rate. Depth and coverage stay per
+// pixel: only the first pixel a primitive covers in a coarse pixel gets a
+// fragment shader thread, and its colour is copied to the other pixels of
+// the coarse pixel the primitive covers and did not lose to a later one.
+static unsigned char parse_shading_rate(const std::string &rate) {
+  static const char *rates[] = {"1x1", "1x2", "2x1", "2x2",
+                                "2x4", "4x2", "4x4"};
+  for (const char *r : rates) {
+    if (rate == r) return (r[0] - '0') | (r[2] - '0') << 4;
+  }
+  printf("GPGPU-Sim: shading rate \'%s\' is not 1x1, 1x2, 2x1, 2x2, 2x4, "
+         "4x2 or 4x4\n",
+         rate.c_str());
+  exit(1);
+}
+
+static void parse_shading_rates(draw_config_t &config) {
+  std::stringstream ss(std::getenv("SHADING_RATE") ? std::getenv("SHADING_RATE")
+                                                   : "");
+  std::string entry;
+  while (std::getline(ss, entry, ',')) {
+    if (entry.empty()) continue;
+    unsigned from = 0, to = -1;
+    size_t colon = entry.find(':');
+    if (colon != std::string::npos) {
+      std::string draws = entry.substr(0, colon);
+      size_t dash = draws.find('-');
+      from = std::stoul(draws.substr(0, dash));
+      if (dash == std::string::npos)
+        to = from + 1;
+      else if (dash + 1 < draws.size())
+        to = std::stoul(draws.substr(dash + 1));
+      entry = entry.substr(colon + 1);
+    }
+    config.shading_rates.push_back(
+        std::make_pair(std::make_pair(from, to), parse_shading_rate(entry)));
+  }
+  if (std::getenv("SHADING_RATE_IMAGE") == NULL) return;
+  std::ifstream image(std::getenv("SHADING_RATE_IMAGE"));
+  if (!image) {
+    printf("GPGPU-Sim: cannot read SHADING_RATE_IMAGE \'%s\'\n",
+           std::getenv("SHADING_RATE_IMAGE"));
+    exit(1);
+  }
+  std::string rate;
+  while (image >> rate)
+    config.shading_rate_image.push_back(parse_shading_rate(rate));
+}
+
+static draw_config_t parse_draw_config(const std::string &vulkan_app) {
+  draw_config_t config;
+  config.start = env_unsigned("START_DRAW", 0);
+  config.end = env_unsigned("END_DRAW", -1);
+  config.width = env_unsigned("RENDER_WIDTH", 640);
+  config.height = env_unsigned("RENDER_HEIGHT", 480);
+  config.exit_when_done = env_unsigned("TRACE_EXIT", 1);
+  if (std::getenv("VS_CACHE_DIR") != NULL) {
+    config.vs_cache_dir = std::getenv("VS_CACHE_DIR");
+    system(("mkdir -p " + config.vs_cache_dir).c_str());
+  }
+  config.frag_order =
+      std::getenv("FRAG_ORDER") ? std::getenv("FRAG_ORDER") : "tile";
+  if (config.frag_order != "tile" && config.frag_order != "quad" &&
+      config.frag_order != "morton") {
+    printf("GPGPU-Sim: FRAG_ORDER \'%s\' is not tile, quad or morton\n",
+           config.frag_order.c_str());
+    exit(1);
+  }
+  config.hiz = env_unsigned("HIZ", 1);
+  config.early_z = env_unsigned("EARLY_Z", 0);
+  config.vertex_cache = env_unsigned("VERTEX_CACHE", 0);
+  std::string policy = std::getenv("VERTEX_CACHE_POLICY")
+                           ? std::getenv("VERTEX_CACHE_POLICY")
+                           : "fifo";
+  if (policy != "fifo" && policy != "lru") {
+    printf("GPGPU-Sim: VERTEX_CACHE_POLICY \'%s\' is not fifo or lru\n",
+           policy.c_str());
+    exit(1);
+  }
+  config.vertex_cache_lru = policy == "lru";
+  config.batch = std::max(env_unsigned("DRAW_BATCH", 1), 1u);
+  if (config.batch > 1 && !config.vs_cache_dir.empty()) {
+    printf("GPGPU-Sim: DRAW_BATCH is not used with VS_CACHE_DIR\n");
+    config.batch = 1;
+  }
+  parse_shading_rates(config);
+  config.done = false;
+
+  std::string skips;
+  if (std::getenv("SKIP_DRAWS") != NULL) {
+    skips = std::getenv("SKIP_DRAWS");
+  } else if (vulkan_app == "sponza") {
+    skips = "23-26";
+  } else if (vulkan_app == "materials") {
+    skips = "80-";
+  } else if (vulkan_app == "instancing") {
+    skips = "2-";
+  }
+  std::stringstream ss(skips);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty()) continue;
+    size_t dash = range.find('-');
+    if (dash == std::string::npos || dash == 0) {
+      printf("GPGPU-Sim: SKIP_DRAWS range \'%s\' is not from-to or from-\n",
+             range.c_str());
+      exit(1);
+    }
+    unsigned from = std::stoul(range.substr(0, dash));
+    unsigned to = dash + 1 < range.size() ? std::stoul(range.substr(dash + 1))
+                                          : (unsigned)-1;
+    config.skips.push_back(std::make_pair(from, to));
+  }
+  return config;
+}
+
+static draw_config_t draw_config;
+static bool draw_config_parsed = false;
+
+// the SHADING_RATE of a draw
+static unsigned char draw_shading_rate(unsigned draw) {
+  unsigned char rate = 0x11;
+  for (const auto &r : draw_config.shading_rates) {
+    if (draw >= r.first.first && draw < r.first.second) rate = r.second;
+  }
+  return rate;
+}
+
+// With DRAW_BATCH=n up to n consecutive draws of the same pipeline and
+// descriptors run their vertex shaders in one launch, each draw from a
+// thread that starts a CTA. The shader intrinsics find the draw of a thread
+// here, and its outputs are its slice of the buffers of the launch. The
+// trace of the launch is split back into one kernel per draw.
+struct vertex_batch_t {
+  std::vector<struct vertex_metadata *> meta;
+  std::vector<unsigned> first_thread;
+  std::vector<unsigned> threads;
+};
+static vertex_batch_t vertex_batch;
+// draws set up and shaded in the launch of an earlier draw
+static std::set<unsigned> vertex_batched_draws;
+
+// the render pass and subpass of the last draw traced. A draw in another
+// one is preceded by a RenderPass,<n> line in the command list, which the
+// trace runner takes as a barrier between the graphics kernels before and
+// after it
+static const struct anv_render_pass *traced_render_pass = NULL;
+static const struct anv_subpass *traced_subpass = NULL;
+static unsigned traced_render_passes = 0;
+
+// the draw of thread tid of the launch, tid becoming its thread in the
+// draw; NULL for the threads that pad a draw to whole CTAs
+static struct vertex_metadata *vertex_batch_draw(uint32_t &tid) {
+  unsigned i = std::upper_bound(vertex_batch.first_thread.begin(),
+                                vertex_batch.first_thread.end(), tid) -
+               vertex_batch.first_thread.begin() - 1;
+  tid -= vertex_batch.first_thread[i];
+  return tid < vertex_batch.threads[i] ? vertex_batch.meta[i] : NULL;
+}
+
+// One vertex shader thread per entry of vb, the vertex it shades, and the
+// entry each index is shaded by in index_vb. Without VERTEX_CACHE the
+// indices go in batches of batch_size with each vertex shaded once per
+// batch. With it a post-transform cache of that many vertices models the
+// reuse: a vertex still in the cache is not shaded again, any other gets a
+// new thread and enters the cache, evicting the oldest or, with
+// VERTEX_CACHE_POLICY=lru, the least recently used vertex.
+static void assign_vertex_threads(const std::vector<unsigned> &indices,
+                                  unsigned batch_size,
+                                  std::vector<unsigned> &vb,
+                                  std::vector<uint32_t> &index_vb) {
+  index_vb.resize(indices.size());
+  if (!draw_config.vertex_cache) {
+    std::unordered_map<unsigned, unsigned> batch;
+    for (unsigned i = 0; i < indices.size(); i++) {
+      if (i % batch_size == 0) batch.clear();
+      auto entry = batch.find(indices[i]);
+      if (entry == batch.end()) {
+        entry = batch.insert(std::make_pair(indices[i], vb.size())).first;
+        vb.push_back(indices[i]);
+      }
+      index_vb[i] = entry->second;
+    }
+    return;
+  }
+  // (vertex, vb entry), most recently entered or, for lru, used first
+  typedef std::list<std::pair<unsigned, unsigned>> cache_t;
+  cache_t cache;
+  std::unordered_map<unsigned, cache_t::iterator> cached;
+  unsigned hits = 0;
+  for (unsigned i = 0; i < indices.size(); i++) {
+    auto entry = cached.find(indices[i]);
+    if (entry != cached.end()) {
+      if (draw_config.vertex_cache_lru)
+        cache.splice(cache.begin(), cache, entry->second);
+      index_vb[i] = entry->second->second;
+      hits++;
+      continue;
+    }
+    if (cache.size() == draw_config.vertex_cache) {
+      cached.erase(cache.back().first);
+      cache.pop_back();
+    }
+    cache.push_front(std::make_pair(indices[i], (unsigned)vb.size()));
+    cached[indices[i]] = cache.begin();
+    index_vb[i] = vb.size();
+    vb.push_back(indices[i]);
+  }
+  printf("vertex cache: %u of %zu indices hit\n", hits, indices.size());
+}
+
+// the pixel coordinates with their bits interleaved, x in the even bits
+static unsigned morton_code(unsigned x, unsigned y) {
+  unsigned code = 0;
+  for (unsigned b = 0; b < 16; b++) {
+    code |= ((x >> b) & 1) << (2 * b);
+    code |= ((y >> b) & 1) << (2 * b + 1);
+  }
+  return code;
+}
+
+// The fragments of a draw, collected in primitive order, in the order they
+// are given to the fragment shader threads and so packed into warps:
+//   tile    the tiles in order, each with its fragments in primitive order
+//   quad    like tile, with the fragments of each primitive in 2x2 quads
+//           in screen order, the four of a quad next to each other
+//   morton  all fragments in Morton order of their pixels
+// Fragments of one pixel always keep their primitive order.
+static std::vector<unsigned> order_fragments(
+    const std::string &policy,
+    const std::vector<std::vector<unsigned>> &tile_map,
+    const std::vector<unsigned> &pixels, const std::vector<unsigned> &prims,
+    unsigned width) {
+  std::vector<unsigned> order;
+  order.reserve(pixels.size());
+  if (policy == "morton") {
+    for (unsigned i = 0; i < pixels.size(); i++) order.push_back(i);
+    std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+      return morton_code(pixels[a] % width, pixels[a] / width) <
+             morton_code(pixels[b] % width, pixels[b] / width);
+    });
+    return order;
+  }
+  for (const std::vector<unsigned> &tile : tile_map) {
+    size_t begin = order.size();
+    order.insert(order.end(), tile.begin(), tile.end());
+    if (policy != "quad") continue;
+    auto quad_key = [&](unsigned f) {
+      unsigned x = pixels[f] % width;
+      unsigned y = pixels[f] / width;
+      return std::make_tuple(prims[f], y / 2, x / 2, y % 2, x % 2);
+    };
+    std::stable_sort(order.begin() + begin, order.end(),
+                     [&](unsigned a, unsigned b) {
+                       return quad_key(a) < quad_key(b);
+                     });
+  }
+  return order;
+}
+
+// The vertex shader outputs of a draw in VS_CACHE_DIR: "VSO1", the vertex
+// count and the number of outputs (32 bit), then per output its
+// identifier and name (32 bit length and the characters), its stride in
+// bytes (32 bit) and its stride / 4 floats per vertex.
+static std::string vs_cache_path(const std::string &vulkan_app,
+                                 unsigned draw) {
+  return draw_config.vs_cache_dir + "/" + vulkan_app + "_draw" +
+         std::to_string(draw) + ".vsout";
+}
+
+static void vs_cache_write_string(FILE *fp, const std::string &str) {
+  uint32_t length = str.size();
+  fwrite(&length, sizeof(length), 1, fp);
+  fwrite(str.data(), 1, length, fp);
+}
+
+static bool vs_cache_read_string(FILE *fp, std::string &str) {
+  uint32_t length;
+  if (fread(&length, sizeof(length), 1, fp) != 1) return false;
+  str.resize(length);
+  return fread(&str[0], 1, length, fp) == length;
+}
+
+static void vs_cache_save(const std::string &path, unsigned vertex_count,
+                          struct vertex_metadata *meta) {
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    printf("GPGPU-Sim: can not write the vertex outputs to %s\n",
+           path.c_str());
+    return;
+  }
+  uint32_t header[2] = {vertex_count, (uint32_t)meta->vertex_id_map.size()};
+  fwrite("VSO1", 1, 4, fp);
+  fwrite(header, sizeof(header[0]), 2, fp);
+  for (auto out_attrib : meta->vertex_id_map) {
+    uint32_t stride = meta->vertex_out_stride.at(out_attrib.second);
+    vs_cache_write_string(fp, out_attrib.first);
+    vs_cache_write_string(fp, out_attrib.second);
+    fwrite(&stride, sizeof(stride), 1, fp);
+    fwrite(meta->vertex_out.at(out_attrib.second), 1, stride * vertex_count,
+           fp);
+  }
+  fclose(fp);
+}
+
+// on success the outputs are registered in meta like the vertex shader
+// does and their values are in data
+static bool vs_cache_load(
+    const std::string &path, unsigned vertex_count,
+    struct vertex_metadata *meta, gpgpu_sim *gpu,
+    std::unordered_map<std::string, std::vector<float>> &data) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp) return false;
+  char magic[4];
+  uint32_t header[2];
+  bool ok = fread(magic, 1, 4, fp) == 4 && !memcmp(magic, "VSO1", 4) &&
+            fread(header, sizeof(header[0]), 2, fp) == 2 &&
+            header[0] == vertex_count;
+  std::vector<std::pair<std::string, std::string>> ids;
+  std::vector<uint32_t> strides;
+  for (uint32_t i = 0; ok && i < header[1]; i++) {
+    std::string identifier, name;
+    uint32_t stride;
+    ok = vs_cache_read_string(fp, identifier) &&
+         vs_cache_read_string(fp, name) &&
+         fread(&stride, sizeof(stride), 1, fp) == 1 && stride % 4 == 0;
+    if (!ok) break;
+    std::vector<float> &values = data[name];
+    values.resize(stride / 4 * vertex_count);
+    ok = fread(values.data(), 1, stride * vertex_count, fp) ==
+         stride * vertex_count;
+    ids.push_back(std::make_pair(identifier, name));
+    strides.push_back(stride);
+  }
+  fclose(fp);
+  if (!ok) {
+    printf("GPGPU-Sim: ignoring %s, not the vertex outputs of this draw\n",
+           path.c_str());
+    data.clear();
+    return false;
+  }
+  for (unsigned i = 0; i < ids.size(); i++) {
+    const std::string &name = ids[i].second;
+    if (meta->vertex_out_devptr.find(name) == meta->vertex_out_devptr.end()) {
+      meta->vertex_out_devptr.insert(std::make_pair(
+          name, (uint32_t *)gpu->gpu_malloc(vertex_count * strides[i])));
+      meta->vertex_out_stride.insert(std::make_pair(name, strides[i]));
+    }
+    meta->vertex_id_map.insert(ids[i]);
+  }
+  return true;
+}
+
 
 // workloads: 
 // render_passes:       0 
@@ -1348,6 +2196,7 @@ void VulkanRayTracing::clearDraws() {
       delete draw;
   }
   draw_meta.clear();
+  vertex_batched_draws.clear();
 }
 
 void VulkanRayTracing::saveDumbDraw() {
@@ -1365,6 +2214,8 @@ void VulkanRayTracing::saveDraw(struct anv_cmd_buffer *cmd_buffer,
   // VertexMeta->vbuffer = cmd_buffer->state.vertex_bindings;
   struct anv_vertex_binding *vbuffer = cmd_buffer->state.vertex_bindings;
   VertexMeta->pipeline = cmd_buffer->state.gfx.pipeline;
+  VertexMeta->render_pass = cmd_buffer->state.pass;
+  VertexMeta->subpass = cmd_buffer->state.subpass;
   assert(cmd_buffer->state.gfx.dynamic.viewport.count == 1);
   VertexMeta->viewports = *(cmd_buffer->state.gfx.dynamic.viewport.viewports);
   char const *app_env = std::getenv("VULKAN_APP");
@@ -1441,39 +2292,222 @@ void VulkanRayTracing::saveDraw(struct anv_cmd_buffer *cmd_buffer,
   }
 }
 
+// Vertex threads, vertex buffers, descriptor sets and push constants of the
+// draw of VertexMeta; sets thread_count and returns the index size, 0 for a
+// draw that is not traced
+unsigned VulkanRayTracing::setup_vertex_stage() {
+  gpgpu_context *ctx = GPGPU_Context();
+  CUctx_st *context = GPGPUSim_Context(ctx);
+
+  unsigned group_size = 96;
+
+  unsigned index_size = -1;
+  char *index_buffer = anv_address_map(VertexMeta->index_buffer->address);
+  if (VertexMeta->index_type == VK_INDEX_TYPE_UINT16) {
+    index_size = sizeof(u_int16_t);
+    if (((u_int16_t*) index_buffer)[0] == ((u_int16_t*) index_buffer)[1] &&
+        ((u_int16_t*) index_buffer)[1] == ((u_int16_t*) index_buffer)[2] && 
+        ((u_int16_t*) index_buffer)[0] == 0) {
+      return 0;
+    }
+  } else if (VertexMeta->index_type == VK_INDEX_TYPE_UINT32) {
+    index_size = sizeof(u_int32_t);
+    if (((u_int32_t*) index_buffer)[0] == ((u_int32_t*) index_buffer)[1] &&
+        ((u_int32_t*) index_buffer)[1] == ((u_int32_t*) index_buffer)[2] && 
+        ((u_int32_t*) index_buffer)[0] == 0) {
+      return 0;
+    }
+  } else {
+    // add your type
+    printf("unsupported index type\n");
+    assert(0 && "unsupported index type");
+  }
+
+  // whole triangles, as the primitive assembly reads them
+  std::vector<unsigned> indices;
+  for (unsigned i = 0; i < VertexMeta->index_buffer->size / index_size;
+       i += 3) {
+    for (unsigned j = 0; j < 3; j++) {
+      unsigned vertex;
+      if (index_size == 4) {
+        vertex = ((u_int32_t*) index_buffer)[i + j];
+      } else if (index_size == 2) {
+        vertex = ((u_int16_t*) index_buffer)[i + j];
+      }
+      indices.push_back(vertex);
+    }
+  }
+  assign_vertex_threads(indices, group_size, VertexMeta->vb,
+                        VertexMeta->index_vb);
+  printf("vertex count: %u\n", VertexMeta->vb.size());
+
+  VulkanRayTracing::is_FS = false;
+  for (auto &i : VertexMeta->VertexAttrib->binding) {
+    if (VertexMeta->vertex_stride[i] != 0) {
+      assert(VertexMeta->vertex_buffers[i]->size %
+                 (VertexMeta->vertex_stride[i] / 4) ==
+             0);
+      // stride should be multilpe of 4 bytes -> vectors
+      assert(VertexMeta->vertex_stride[i] % 4 == 0);
+    }
+
+      dumpVertex(VertexMeta->vertex_buffers[i], VertexMeta->pipeline, i);
+  }
+  // Dump Descriptor Sets
+//   return;
+  for (unsigned i = 0; i < MAX_DESCRIPTOR_SETS; i++) {
+    for (unsigned j = 0; j < MAX_DESCRIPTOR_SET_BINDINGS; j++) {
+      dump_descriptor(i, j, VertexMeta->decoded_descriptors[i][j], VertexMeta->decoded_bview[i][j], false);
+    }
+  }
+
+  thread_count = VertexMeta->vb.size() * VertexMeta->InstanceCount;
+
+  VertexMeta->constants_dev_addr =
+      context->get_device()->get_gpgpu()->gpu_malloc(128);
+  context->get_device()->get_gpgpu()->memcpy_to_gpu(VertexMeta->constants_dev_addr, VertexMeta->push_constants, 128);
+  context->get_device()
+      ->get_gpgpu()
+      ->valid_addr_start["push_constant"] = (uint64_t) VertexMeta->constants_dev_addr;
+  context->get_device()
+      ->get_gpgpu()
+      ->valid_addr_end["push_constant"] = (uint64_t) VertexMeta->constants_dev_addr + 128;
+  print_memcpy("MemcpyVulkan",VertexMeta->constants_dev_addr, 128, 0);
+  return index_size;
+}
+
+// Runs the vertex shader of the draw of VertexMeta together with those of
+// the draws after it that can share the launch, see vertex_batch_t. The
+// later draws are set up here and skip their vertex shader when the draw
+// loop gets to them.
+void VulkanRayTracing::run_vertex_batch(unsigned vertex_id) {
+  gpgpu_context *ctx = GPGPU_Context();
+  CUctx_st *context = GPGPUSim_Context(ctx);
+  gpgpu_sim *gpu = context->get_device()->get_gpgpu();
+  struct vertex_metadata *first = VertexMeta;
+
+  vertex_batch = vertex_batch_t();
+  vertex_batch.meta.push_back(first);
+  vertex_batch.first_thread.push_back(0);
+  vertex_batch.threads.push_back(thread_count);
+  unsigned ctas = std::max(1u, (thread_count + block_size - 1) / block_size);
+  std::vector<unsigned> draw_ctas(1, ctas);
+  unsigned launch_threads = ctas * block_size;
+
+  unsigned end = std::min(draw_config.end, (unsigned)draw_meta.size());
+  for (unsigned next = draw + 1;
+       next < end && vertex_batch.meta.size() < draw_config.batch; next++) {
+    bool skipped = false;
+    for (auto &skip : draw_config.skips) {
+      if (next >= skip.first && next < skip.second) skipped = true;
+    }
+    struct vertex_metadata *meta = draw_meta[next];
+    if (skipped || !meta || meta->pipeline != first->pipeline ||
+        meta->render_pass != first->render_pass ||
+        meta->subpass != first->subpass ||
+        memcmp(meta->decoded_descriptors, first->decoded_descriptors,
+               sizeof(first->decoded_descriptors)) != 0) {
+      break;
+    }
+
+    std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> ranges;
+    for (auto &range : gpu->valid_addr_start) {
+      ranges[range.first] =
+          std::make_pair(range.second, gpu->valid_addr_end.at(range.first));
+    }
+    VertexMeta = meta;
+    if (!setup_vertex_stage()) break;
+    // the buffers of this draw get names of their own, those of the draws
+    // before keep theirs
+    std::vector<std::string> renamed;
+    for (auto &range : gpu->valid_addr_start) {
+      auto saved = ranges.find(range.first);
+      if (saved == ranges.end() || saved->second.first != range.second)
+        renamed.push_back(range.first);
+    }
+    for (auto &name : renamed) {
+      std::string draw_name = name + "@" + std::to_string(next);
+      gpu->valid_addr_start[draw_name] = gpu->valid_addr_start.at(name);
+      gpu->valid_addr_end[draw_name] = gpu->valid_addr_end.at(name);
+      auto saved = ranges.find(name);
+      if (saved != ranges.end()) {
+        gpu->valid_addr_start[name] = saved->second.first;
+        gpu->valid_addr_end[name] = saved->second.second;
+      }
+    }
+
+    vertex_batch.meta.push_back(meta);
+    vertex_batch.first_thread.push_back(launch_threads);
+    vertex_batch.threads.push_back(thread_count);
+    ctas = std::max(1u, (thread_count + block_size - 1) / block_size);
+    draw_ctas.push_back(ctas);
+    launch_threads += ctas * block_size;
+    vertex_batched_draws.insert(next);
+  }
+  VertexMeta = first;
+
+  if (vertex_batch.meta.size() > 1) {
+    printf("vertex shaders of draws %u to %u in one launch\n", draw,
+           draw + (unsigned)vertex_batch.meta.size() - 1);
+  }
+  thread_count = launch_threads;
+  run_shader(vertex_id, thread_count, draw_ctas);
+
+  // the outputs of the other draws are their slices of the buffers the
+  // first draw allocated for the launch
+  for (unsigned i = 1; i < vertex_batch.meta.size(); i++) {
+    struct vertex_metadata *meta = vertex_batch.meta[i];
+    for (auto &out : first->vertex_out_devptr) {
+      meta->vertex_out_devptr[out.first] =
+          out.second + vertex_batch.first_thread[i] *
+                           first->vertex_out_stride.at(out.first) / 4;
+    }
+    meta->vertex_out_stride = first->vertex_out_stride;
+    meta->vertex_id_map = first->vertex_id_map;
+  }
+  thread_count = vertex_batch.threads[0];
+  vertex_batch = vertex_batch_t();
+}
+
 void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned VertexCount, unsigned StartVertex, unsigned instanceCount, unsigned StartInstance, unsigned BaseVertex) {
   // assume only vertex and frag. No geometry or tessellation
   gpgpu_context *ctx = GPGPU_Context();
   CUctx_st *context = GPGPUSim_Context(ctx);
-  if (draw_meta.empty()) {
+  char const *app_env = std::getenv("VULKAN_APP");
+  std::string vulkan_app(app_env);
+  if (!draw_config_parsed) {
+    draw_config = parse_draw_config(vulkan_app);
+    if (draw_config.batch > 1 &&
+        !context->get_device()->get_gpgpu()->m_trace_writer.enabled()) {
+      printf("GPGPU-Sim: DRAW_BATCH needs -gpgpu_trace_dir to trace the "
+             "draws as kernels of their own\n");
+      draw_config.batch = 1;
+    }
+    draw_config_parsed = true;
+  }
+  if (draw_meta.empty() || draw_config.done) {
     return;
   }
   // define starting draw
-  draw = 0;
-  char const *start_env = std::getenv("START_DRAW");
-  if (start_env != NULL) {
-    draw = std::stoi(std::string(start_env));
-  }
-  char const *app_env = std::getenv("VULKAN_APP");
-  std::string vulkan_app(app_env);
+  draw = draw_config.start;
 
 
   while(true) {
-    if (draw == 23 && vulkan_app == "sponza") {
-      draw = 26;
-    }
-    if (draw == 80 && vulkan_app == "materials") {
-      draw = draw_meta.size();
-    }
-
-    if(draw == 2 && vulkan_app == "instancing") {
-      draw = draw_meta.size();
+    for (auto &skip : draw_config.skips) {
+      if (draw == skip.first) {
+        draw = std::min(skip.second, (unsigned)draw_meta.size());
+      }
     }
 
-    if (draw == draw_meta.size()) {
-      context->get_device()->get_gpgpu()->gtrace.close();
-      system("mv traces.traceg complete.traceg");
-      exit(0);
+    if (draw >= std::min(draw_config.end, (unsigned)draw_meta.size())) {
+      context->get_device()->get_gpgpu()->trace_close();
+      g_astc_block_cache.print_stats(stdout);
+      tracer_profile::get().print_frame(stdout);
+      if (draw_config.exit_when_done) {
+        exit(0);
+      }
+      draw_config.done = true;
+      return;
     }
 
   VertexMeta = draw_meta[draw];
@@ -1495,16 +2529,17 @@ void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned Ver
   FILE *fp;
   // create fbo
   printf("Starting Drawcall #%u\n", draw);
+  tracer_profile::get().begin("draw " + std::to_string(draw));
   if (!FBO->fbo) {
     printf("render resolution: %u x %u\n", (unsigned) VertexMeta->viewports.width,(unsigned) VertexMeta->viewports.height);
     FBO->width = VertexMeta->viewports.width;
     FBO->height = VertexMeta->viewports.height;
-    // FBO->width = 2560;
-    // FBO->height = 1440;
-    // FBO->width = 3840;
-    // FBO->height = 2160;
-    FBO->width = 640;
-    FBO->height = 480;
+    if (draw_config.width) {
+      FBO->width = draw_config.width;
+    }
+    if (draw_config.height) {
+      FBO->height = draw_config.height;
+    }
     FBO->x = VertexMeta->viewports.x;
     FBO->y = VertexMeta->viewports.y;
     FBO->fbo_size = 4 * FBO->width * FBO->height * sizeof(float);
@@ -1535,91 +2570,49 @@ void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned Ver
   assert(FBO->depthout);
   assert(FBO->fbo_dev);
   // could be different for different type of FBO
+  if (!traced_render_passes || VertexMeta->render_pass != traced_render_pass ||
+      VertexMeta->subpass != traced_subpass) {
+    if (traced_render_passes)
+      context->get_device()->get_gpgpu()->trace_command(
+          "RenderPass," + std::to_string(traced_render_passes));
+    traced_render_pass = VertexMeta->render_pass;
+    traced_subpass = VertexMeta->subpass;
+    traced_render_passes++;
+  }
   // dump vertex buffer
 
-  unsigned group_size = 96;
-
-  unsigned index_size = -1;
-  char *index_buffer = anv_address_map(VertexMeta->index_buffer->address);
-  if (VertexMeta->index_type == VK_INDEX_TYPE_UINT16) {
-    index_size = sizeof(u_int16_t);
-    if (((u_int16_t*) index_buffer)[0] == ((u_int16_t*) index_buffer)[1] &&
-        ((u_int16_t*) index_buffer)[1] == ((u_int16_t*) index_buffer)[2] && 
-        ((u_int16_t*) index_buffer)[0] == 0) {
-      VertexMeta = NULL;
-      return;
-    }
-  } else if (VertexMeta->index_type == VK_INDEX_TYPE_UINT32) {
-    index_size = sizeof(u_int32_t);
-    if (((u_int32_t*) index_buffer)[0] == ((u_int32_t*) index_buffer)[1] &&
-        ((u_int32_t*) index_buffer)[1] == ((u_int32_t*) index_buffer)[2] && 
-        ((u_int32_t*) index_buffer)[0] == 0) {
+  unsigned index_size;
+  const bool vs_batched = vertex_batched_draws.erase(draw);
+  if (vs_batched) {
+    index_size = VertexMeta->index_type == VK_INDEX_TYPE_UINT16
+                     ? sizeof(u_int16_t)
+                     : sizeof(u_int32_t);
+    thread_count = VertexMeta->vb.size() * VertexMeta->InstanceCount;
+  } else {
+    index_size = setup_vertex_stage();
+    if (!index_size) {
       VertexMeta = NULL;
       return;
     }
-  } else {
-    // add your type
-    printf("unsupported index type\n");
-    assert(0 && "unsupported index type");
-  }
-
-  unsigned num_group =
-      (VertexMeta->index_buffer->size / index_size) / group_size + 1;
-  VertexMeta->vertex_map.resize(num_group);
-  for (unsigned i = 0; i < VertexMeta->index_buffer->size / index_size;
-       i += 3) {
-    for (unsigned j = 0; j < 3; j++) {
-      unsigned vertex;
-      if (index_size == 4) {
-        vertex = ((u_int32_t*) index_buffer)[i + j];
-      } else if (index_size == 2) {
-        vertex = ((u_int16_t*) index_buffer)[i + j];
-      }
-      unsigned selected_vpc = i / group_size;
-      if (VertexMeta->vertex_map[selected_vpc].find(vertex) ==
-          VertexMeta->vertex_map[selected_vpc].end()) {
-        VertexMeta->vertex_map[selected_vpc][vertex] = VertexMeta->vb.size();
-        VertexMeta->vb.push_back(vertex);
-      }
-    }
-  }
-  printf("vertex count: %u\n", VertexMeta->vb.size());
-
-  VulkanRayTracing::is_FS = false;
-  for (auto &i : VertexMeta->VertexAttrib->binding) {
-    if (VertexMeta->vertex_stride[i] != 0) {
-      assert(VertexMeta->vertex_buffers[i]->size %
-                 (VertexMeta->vertex_stride[i] / 4) ==
-             0);
-      // stride should be multilpe of 4 bytes -> vectors
-      assert(VertexMeta->vertex_stride[i] % 4 == 0);
-    }
-
-      dumpVertex(VertexMeta->vertex_buffers[i], pipeline, i);
   }
-  // Dump Descriptor Sets
-//   return;
-  for (unsigned i = 0; i < MAX_DESCRIPTOR_SETS; i++) {
-    for (unsigned j = 0; j < MAX_DESCRIPTOR_SET_BINDINGS; j++) {
-      dump_descriptor(i, j, VertexMeta->decoded_descriptors[i][j], VertexMeta->decoded_bview[i][j], false);
+  // vertex outputs saved by an earlier run in VS_CACHE_DIR
+  bool skip_vs = SKIP_VS;
+  std::unordered_map<std::string, std::vector<float>> cached_vertex_out;
+  if (!skip_vs && !draw_config.vs_cache_dir.empty()) {
+    skip_vs = vs_cache_load(vs_cache_path(vulkan_app, draw), thread_count,
+                            VertexMeta, context->get_device()->get_gpgpu(),
+                            cached_vertex_out);
+    if (skip_vs) {
+      printf("vertex shader outputs of draw %u from %s\n", draw,
+             vs_cache_path(vulkan_app, draw).c_str());
     }
   }
-
-  thread_count = VertexMeta->vb.size() * VertexMeta->InstanceCount;
-
-  VertexMeta->constants_dev_addr =
-      context->get_device()->get_gpgpu()->gpu_malloc(128);
-  context->get_device()->get_gpgpu()->memcpy_to_gpu(VertexMeta->constants_dev_addr, VertexMeta->push_constants, 128);
-  context->get_device()
-      ->get_gpgpu()
-      ->valid_addr_start["push_constant"] = (uint64_t) VertexMeta->constants_dev_addr;
-  context->get_device()
-      ->get_gpgpu()
-      ->valid_addr_end["push_constant"] = (uint64_t) VertexMeta->constants_dev_addr + 128;
-  print_memcpy("MemcpyVulkan",VertexMeta->constants_dev_addr, 128, 0);
-  if (!SKIP_VS) {
+  if (!skip_vs && !vs_batched) {
     // run vertex shader
-    run_shader(vertex_id,thread_count);
+    if (draw_config.batch > 1)
+      run_vertex_batch(vertex_id);
+    else
+      run_shader(vertex_id,thread_count);
   }
 
   if (draw == 1 && vulkan_app == "materials") {
@@ -1660,7 +2653,14 @@ void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned Ver
     std::string vb = mesa_root + "../vb/" + "vb" + attrib_name + "_" +
                      std::to_string(draw) + ".bin";
 
-    if (!SKIP_VS) {
+    if (cached_vertex_out.count(attrib_name)) {
+      memcpy(VertexMeta->vertex_out.at(attrib_name),
+             cached_vertex_out.at(attrib_name).data(),
+             VertexMeta->vertex_out_size.at(attrib_name));
+      context->get_device()->get_gpgpu()->memcpy_to_gpu(
+          VertexMeta->vertex_out_devptr.at(attrib_name), VertexMeta->vertex_out.at(attrib_name),
+          VertexMeta->vertex_out_size.at(attrib_name));
+    } else if (!skip_vs) {
       context->get_device()->get_gpgpu()->memcpy_from_gpu(
           VertexMeta->vertex_out.at(attrib_name), VertexMeta->vertex_out_devptr.at(attrib_name),
           VertexMeta->vertex_out_size.at(attrib_name));
@@ -1676,6 +2676,14 @@ void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned Ver
           VertexMeta->vertex_out_size.at(attrib_name));
     }
   }
+  // the vertex outputs of the next draw load while this one rasterizes
+  if (skip_vs && cached_vertex_out.empty()) {
+    std::vector<std::string> next_vb;
+    for (auto out_attrib : VertexMeta->vertex_id_map)
+      next_vb.push_back(mesa_root + "../vb/" + "vb" + out_attrib.second + "_" +
+                        std::to_string(draw + 1) + ".bin");
+    dump_loader::get().prefetch(next_vb);
+  }
 
   if (vulkan_app == "instancing") {
     for (unsigned i = 0; i < VertexMeta->vertex_out_count["\%inColor"]; i++) {
@@ -1683,275 +2691,407 @@ void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned Ver
     }
   }
 
+  if (!skip_vs && !draw_config.vs_cache_dir.empty()) {
+    vs_cache_save(vs_cache_path(vulkan_app, draw), thread_count, VertexMeta);
+  }
+
 
-  // vertex-post processing
-  // tranform & clipping
-  std::vector<std::vector<float>> vertex_ndc;
-  std::vector<std::vector<float>> vertex_screen;
-  std::vector<std::vector<float>> vertex_raw;
+  // vertex-post processing, primitive setup and rasterization
+  unsigned long long raster_start =
+      tracer_profile::get().enabled() ? tracer_profile::ticks() : 0;
+  // tranform & clipping, 4 floats per vertex in vertex_screen as in the
+  // position output
   std::string pos_id = VertexMeta->vertex_id_map.at("VARYING_SLOT_POS_xyzw");
-  for (unsigned i = 0; i < VertexMeta->vertex_out_count.at(pos_id); i += 4) {
+  const float *vertex_raw = VertexMeta->vertex_out.at(pos_id);
+  unsigned pos_count = VertexMeta->vertex_out_count.at(pos_id);
+  assert(pos_count == 4 * thread_count);
+  std::vector<float> vertex_screen(pos_count);
+  for (unsigned i = 0; i < pos_count; i += 4) {
     // transform to NDC space
-    std::vector<float> ndc;
-    std::vector<float> view;
-    std::vector<float> raw;
-    float ndc_x = (VertexMeta->vertex_out.at(pos_id)[i] /
-                   VertexMeta->vertex_out.at(pos_id)[i + 3]);
-    ndc.push_back(ndc_x);
-    float ndc_y = (VertexMeta->vertex_out.at(pos_id)[i + 1] /
-                   VertexMeta->vertex_out.at(pos_id)[i + 3]);
-    ndc.push_back(ndc_y);
-    float ndc_z = (VertexMeta->vertex_out.at(pos_id)[i + 2] /
-                   VertexMeta->vertex_out.at(pos_id)[i + 3]);
-    ndc.push_back(ndc_z);
-    float ndc_w = (VertexMeta->vertex_out.at(pos_id)[i + 3] /
-                   VertexMeta->vertex_out.at(pos_id)[i + 3]);
-    ndc.push_back(ndc_w);
-    vertex_ndc.push_back(ndc);
+    float ndc_x = vertex_raw[i] / vertex_raw[i + 3];
+    float ndc_y = vertex_raw[i + 1] / vertex_raw[i + 3];
+    float ndc_z = vertex_raw[i + 2] / vertex_raw[i + 3];
+    float ndc_w = vertex_raw[i + 3] / vertex_raw[i + 3];
 
     // X = (X + 1) * Viewport.Width * 0.5 + Viewport.TopLeftX
     // Y = (1 - Y) * Viewport.Height * 0.5 + Viewport.TopLeftY (actually no)
     // Z = Viewport.MinDepth + Z * (Viewport.MaxDepth - Viewport.MinDepth)
-    float screen_x = (ndc_x + 1) * (FBO->width / 2) + FBO->x;
-    float screen_y = (ndc_y + 1) * (FBO->height / 2) + FBO->y;
-    float screen_z = 0.0f + ndc_z * (1.0f - 0.0f);
-    view.push_back(screen_x);
-    view.push_back(screen_y);
-    view.push_back(screen_z);
-    view.push_back(ndc_w);
-    vertex_screen.push_back(view);
-
-    assert(!isnan(VertexMeta->vertex_out.at(pos_id)[i]));
-    raw.push_back(VertexMeta->vertex_out.at(pos_id)[i]);
-    raw.push_back(VertexMeta->vertex_out.at(pos_id)[i+1]);
-    raw.push_back(VertexMeta->vertex_out.at(pos_id)[i+2]);
-    raw.push_back(VertexMeta->vertex_out.at(pos_id)[i+3]);
-    vertex_raw.push_back(raw);
-  }
-  assert(vertex_screen.size() == thread_count);
-  assert(vertex_ndc.size() == thread_count);
-
-
-  // Assemble into triangles using index buffer
-  std::vector<std::vector<unsigned>> primitives;
+    vertex_screen[i] = (ndc_x + 1) * (FBO->width / 2) + FBO->x;
+    vertex_screen[i + 1] = (ndc_y + 1) * (FBO->height / 2) + FBO->y;
+    vertex_screen[i + 2] = 0.0f + ndc_z * (1.0f - 0.0f);
+    vertex_screen[i + 3] = ndc_w;
+
+    assert(!isnan(vertex_raw[i]));
+  }
+
+
+  // Assemble into triangles using index buffer, 3 vertices per primitive
+  std::vector<unsigned> primitives;
 // #if WORKLOAD == 0 || WORKLOAD == 1
   // uint16_t *index_buffer = anv_address_map(VertexMeta->index_buffer->address);
   for (unsigned instance = 0; instance < VertexMeta->InstanceCount; instance++) {
     for (unsigned i = 0; i < VertexMeta->index_buffer->size / index_size;
          i += 3) {
-      unsigned selected_vpc = i / group_size;
       unsigned clipped = 0;
-      std::vector<unsigned> prim;
+      unsigned prim[3];
       // 3 because primitives are triangles
       for (unsigned j = 0; j < 3; j++) {
-        unsigned vertex;
-        if (index_size == 4) {
-          vertex = ((u_int32_t *)index_buffer)[i + j];
-        } else if (index_size == 2) {
-          vertex = ((u_int16_t *)index_buffer)[i + j];
-        }
-        unsigned batched_index = VertexMeta->vertex_map[selected_vpc][vertex] + instance * VertexMeta->vb.size();
-        prim.push_back(batched_index);
+        unsigned batched_index = VertexMeta->index_vb[i + j] + instance * VertexMeta->vb.size();
+        prim[j] = batched_index;
         // (-w <= x,y,z <= w) equal to (fabs(x,y,z) > fbas(w))
-        if (fabs(vertex_raw[batched_index][0]) >
-            fabs(vertex_raw[batched_index][3])) {
-          clipped++;
-          continue;
-        }
-        if (fabs(vertex_raw[batched_index][1]) >
-            fabs(vertex_raw[batched_index][3])) {
-          clipped++;
-          continue;
-        }
-        if (fabs(vertex_raw[batched_index][2]) >
-            fabs(vertex_raw[batched_index][3])) {
+        const float *raw = vertex_raw + 4 * batched_index;
+        if (fabs(raw[0]) > fabs(raw[3]) || fabs(raw[1]) > fabs(raw[3]) ||
+            fabs(raw[2]) > fabs(raw[3])) {
           clipped++;
-          continue;
         }
       }
       if (clipped < 3) {
-        primitives.push_back(prim);
+        primitives.insert(primitives.end(), prim, prim + 3);
       }
     }
   }
 
-  printf("total primitives after clipping: %u\n", primitives.size());
+  printf("total primitives after clipping: %u\n", primitives.size() / 3);
 
   unsigned tile_size = 8;
-  std::vector<unsigned> drawed_pixels;
-  std::unordered_map<std::string, std::vector<std::vector<float>>> attribs;
   std::vector<std::vector<unsigned>> tile_map;
   tile_map.resize(FBO->width * FBO->height / tile_size / tile_size);
 
+  // the vertex outputs interpolated per fragment, one flat buffer per
+  // attribute resolved once per draw instead of by name per pixel
+  struct frag_attrib {
+    const float *vertex;
+    unsigned comps;
+    std::vector<float> frag;
+  };
+  std::vector<std::string> attrib_names;
+  std::vector<frag_attrib> attribs;
   for (auto attrib : VertexMeta->vertex_id_map) {
     std::string attrib_name = attrib.second;
-    attribs.insert(std::make_pair(attrib_name, std::vector<std::vector<float>>()));
-  }
-
-  for (std::vector<std::vector<unsigned>>::iterator prim = primitives.begin();
-       prim < primitives.end(); prim++) {
-    double x1 = vertex_screen[(*prim)[0]][0];
-    double y1 = vertex_screen[(*prim)[0]][1];
-    double x2 = vertex_screen[(*prim)[1]][0];
-    double y2 = vertex_screen[(*prim)[1]][1];
-    double x3 = vertex_screen[(*prim)[2]][0];
-    double y3 = vertex_screen[(*prim)[2]][1];
-
-    double max_x = std::min(FBO->width - 1.0, std::max(x1, std::max(x2, x3)));
-    double min_x = std::max(0., std::min(x1, std::min(x2, x3)));
-    double max_y = std::min(FBO->height - 1.0, std::max(y1, std::max(y2, y3)));
-    double min_y = std::max(0., std::min(y1, std::min(y2, y3)));
-
-    double r = rand() % 255 / 255.f;
-    double g = rand() % 255 / 255.f;
-    double b = rand() % 255 / 255.f;
-
-    // assert(FBO->width % tile_size == 0);
-    // assert(FBO->height % tile_size == 0);
-    unsigned tile_id = (min_y * FBO->width + min_x) / tile_size / tile_size;
-    for (int x = (int)min_x; x <= (int)max_x; x++) {
-      for (int y = (int)min_y; y <= (int)max_y; y++) {
-        unsigned pixel = y * FBO->width + x;
-        double det = x1 * (y2 - y3) - y1 * (x2 - x3) + (x2 * y3 - y2 * x3);
-        // https://gamedev.stackexchange.com/questions/23743/whats-the-most-efficient-way-to-find-barycentric-coordinates
-        double d00 = (x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1);
-        double d01 = (x2 - x1) * (x3 - x1) + (y2 - y1) * (y3 - y1);
-        double d11 = (x3 - x1) * (x3 - x1) + (y3 - y1) * (y3 - y1);
-        double d20 = (x - x1) * (x2 - x1) + (y - y1) * (y2 - y1);
-        double d21 = (x - x1) * (x3 - x1) + (y - y1) * (y3 - y1);
-        double denom = d00 * d11 - d01 * d01;
-        double v = (d11 * d20 - d01 * d21) / denom;
-        double w = (d00 * d21 - d01 * d20) / denom;
-        double u = 1.0f - v - w;
-        if (det == 0.0) {
-          continue;
+    unsigned stride = VertexMeta->vertex_out_stride.at(attrib_name);
+    if (stride % 4 || stride < 4 || stride > 16) {
+      printf("unsupported vertex out attribute size\n");
+      assert(0);
+    }
+    frag_attrib a;
+    a.vertex = VertexMeta->vertex_out.at(attrib_name);
+    a.comps = stride / 4;
+    attrib_names.push_back(attrib_name);
+    attribs.push_back(a);
+  }
+  // host threads for primitive setup and rasterization, RASTER_THREADS or
+  // one per core. The fragments come out the same for any count.
+  unsigned raster_threads = std::thread::hardware_concurrency();
+  char const *raster_threads_env = std::getenv("RASTER_THREADS");
+  if (raster_threads_env != NULL) {
+    raster_threads = std::stoi(std::string(raster_threads_env));
+  }
+  raster_threads = std::max(raster_threads, 1u);
+
+  // primitive setup, in parallel over the primitives
+  struct prim_setup {
+    double x1, y1, x2, y2, x3, y3;
+    double min_x, max_x, min_y, max_y;
+    double d00, d01, d11, denom;
+    double r, g, b;
+    float min_z, max_z;  // of the vertices
+    unsigned tile_id;
+    bool degenerate;
+  };
+  unsigned prim_count = primitives.size() / 3;
+  std::vector<prim_setup> setup(prim_count);
+  for (unsigned prim = 0; prim < prim_count; prim++) {
+    // drawn in primitive order, as the colours of SKIP_FS always were
+    setup[prim].r = rand() % 255 / 255.f;
+    setup[prim].g = rand() % 255 / 255.f;
+    setup[prim].b = rand() % 255 / 255.f;
+  }
+  parallel_chunks(prim_count, raster_threads, [&](unsigned chunk,
+                                                  unsigned begin,
+                                                  unsigned end) {
+    for (unsigned prim = begin; prim < end; prim++) {
+      prim_setup &s = setup[prim];
+      const float *p0 = &vertex_screen[4 * primitives[3 * prim]];
+      const float *p1 = &vertex_screen[4 * primitives[3 * prim + 1]];
+      const float *p2 = &vertex_screen[4 * primitives[3 * prim + 2]];
+      double x1 = s.x1 = p0[0];
+      double y1 = s.y1 = p0[1];
+      double x2 = s.x2 = p1[0];
+      double y2 = s.y2 = p1[1];
+      double x3 = s.x3 = p2[0];
+      double y3 = s.y3 = p2[1];
+      s.min_z = std::min(p0[2], std::min(p1[2], p2[2]));
+      s.max_z = std::max(p0[2], std::max(p1[2], p2[2]));
+
+      s.max_x = std::min(FBO->width - 1.0, std::max(x1, std::max(x2, x3)));
+      s.min_x = std::max(0., std::min(x1, std::min(x2, x3)));
+      s.max_y = std::min(FBO->height - 1.0, std::max(y1, std::max(y2, y3)));
+      s.min_y = std::max(0., std::min(y1, std::min(y2, y3)));
+
+      // a degenerate triangle covers no pixel
+      double det = x1 * (y2 - y3) - y1 * (x2 - x3) + (x2 * y3 - y2 * x3);
+      s.degenerate = det == 0.0;
+      // https://gamedev.stackexchange.com/questions/23743/whats-the-most-efficient-way-to-find-barycentric-coordinates
+      s.d00 = (x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1);
+      s.d01 = (x2 - x1) * (x3 - x1) + (y2 - y1) * (y3 - y1);
+      s.d11 = (x3 - x1) * (x3 - x1) + (y3 - y1) * (y3 - y1);
+      s.denom = s.d00 * s.d11 - s.d01 * s.d01;
+
+      // assert(FBO->width % tile_size == 0);
+      // assert(FBO->height % tile_size == 0);
+      s.tile_id = (s.min_y * FBO->width + s.min_x) / tile_size / tile_size;
+    }
+  });
+
+  // rasterization, in parallel over bands of tile columns. A band owns its
+  // columns of depthout and fbo, so each pixel still sees the primitives in
+  // order, and a primitive's fragments of a band are the consecutive
+  // columns of its column-major walk.
+  //
+  // Hi-Z keeps per tile the farthest depth of its pixels (the nearest for
+  // VK_COMPARE_OP_GREATER) and skips the tiles a primitive is behind
+  // everywhere without testing their pixels; the bound is recomputed after
+  // writes made it stale, and rejects with a margin, so the fragments are
+  // the same with HIZ=0. With EARLY_Z=1 a depth-only pass first finds the
+  // primitive each pixel ends up with, and only those fragments are
+  // interpolated and shaded: the final image and depth are the same, only
+  // the overdrawn fragments are gone.
+  struct raster_slice {
+    std::vector<unsigned> prim_frags;  // fragments of each primitive
+    std::vector<unsigned> pixel;
+    std::vector<std::vector<float>> attrib;
+    // coarse shading: (fragment, pixel) of the pixels a fragment of the
+    // slice covers without being shaded there
+    std::vector<std::pair<unsigned, unsigned>> covered;
+  };
+  unsigned tile_columns = (FBO->width + tile_size - 1) / tile_size;
+  unsigned tile_rows = (FBO->height + tile_size - 1) / tile_size;
+  // the shading rate of each tile, width | height << 4, see
+  // parse_shading_rates
+  const unsigned char draw_rate = draw_shading_rate(draw);
+  const std::vector<unsigned char> &rate_image =
+      draw_config.shading_rate_image;
+  if (!rate_image.empty() && rate_image.size() != tile_columns * tile_rows) {
+    printf("GPGPU-Sim: SHADING_RATE_IMAGE has %zu rates, not one per 8x8 "
+           "tile of %ux%u\n",
+           rate_image.size(), tile_columns, tile_rows);
+    exit(1);
+  }
+  const bool coarse = draw_rate != 0x11 || !rate_image.empty();
+  auto tile_rate = [&](unsigned x, unsigned y) {
+    if (rate_image.empty()) return draw_rate;
+    unsigned char image_rate =
+        rate_image[y / tile_size * tile_columns + x / tile_size];
+    return (unsigned char)(std::max(draw_rate & 15, image_rate & 15) |
+                           std::max(draw_rate >> 4, image_rate >> 4) << 4);
+  };
+  // the first pixel of the coarse pixel of x, y
+  auto coarse_pixel = [&](unsigned x, unsigned y) {
+    unsigned char rate = tile_rate(x, y);
+    return y / (rate >> 4) * (rate >> 4) * FBO->width + x / (rate & 15) *
+                                                            (rate & 15);
+  };
+  // the fragment of its slice that last covered each pixel
+  std::vector<unsigned> pixel_owner;
+  if (coarse) pixel_owner.assign(FBO->width * FBO->height, (unsigned)-1);
+  std::vector<raster_slice> slices(
+      std::max(1u, std::min(raster_threads, tile_columns)));
+  const int depth_op = VertexMeta->DepthcmpOp;
+  // whether a fragment at depth passes the depth test against stored
+  auto depth_passes = [depth_op](float stored, float depth) {
+    switch (depth_op) {
+      case VK_COMPARE_OP_GREATER:
+        return !(stored > depth);
+      case VK_COMPARE_OP_LESS:
+        return !(stored < depth);
+      case VK_COMPARE_OP_LESS_OR_EQUAL:
+        return !(stored <= depth);
+      // case VK_COMPARE_OP_NEVER:
+        // break;
+      default:
+        printf("unsupported depth compare op\n");
+        assert(0 && "unsupported depth compare op");
+        return true;
+    }
+  };
+  const bool hiz = draw_config.hiz &&
+                   (depth_op == VK_COMPARE_OP_GREATER ||
+                    depth_op == VK_COMPARE_OP_LESS ||
+                    depth_op == VK_COMPARE_OP_LESS_OR_EQUAL);
+  // the primitive that last wrote each pixel, for EARLY_Z
+  std::vector<unsigned> pixel_prim;
+  if (draw_config.early_z)
+    pixel_prim.assign(FBO->width * FBO->height, (unsigned)-1);
+  parallel_chunks(tile_columns, raster_threads, [&](unsigned chunk,
+                                                    unsigned begin,
+                                                    unsigned end) {
+    raster_slice &slice = slices[chunk];
+    slice.prim_frags.assign(prim_count, 0);
+    slice.attrib.resize(attribs.size());
+    int band_min_x = begin * tile_size;
+    int band_max_x = std::min(end * tile_size, (unsigned)FBO->width) - 1;
+
+    std::vector<float> tile_bound((end - begin) * tile_rows);
+    std::vector<bool> tile_stale((end - begin) * tile_rows, true);
+    auto tile_index = [&](int x, int y) {
+      return (x / tile_size - begin) * tile_rows + y / tile_size;
+    };
+    // false when the primitive fails the depth test in all of the tile
+    auto tile_visible = [&](const prim_setup &s, int x, int y) {
+      unsigned t = tile_index(x, y);
+      if (tile_stale[t]) {
+        int x0 = x / tile_size * tile_size;
+        int y0 = y / tile_size * tile_size;
+        int x1 = std::min(x0 + (int)tile_size, (int)FBO->width);
+        int y1 = std::min(y0 + (int)tile_size, (int)FBO->height);
+        float bound = FBO->depthout[y0 * FBO->width + x0];
+        for (int tx = x0; tx < x1; tx++) {
+          for (int ty = y0; ty < y1; ty++) {
+            float d = FBO->depthout[ty * FBO->width + tx];
+            bound = depth_op == VK_COMPARE_OP_GREATER ? std::min(bound, d)
+                                                      : std::max(bound, d);
+          }
         }
-        if (u < 0 || v < 0 || w < 0) {
+        tile_bound[t] = bound;
+        tile_stale[t] = false;
+      }
+      // interpolated depths may round past the vertex depths
+      float margin = 1e-5f * (1.0f + std::abs(tile_bound[t]));
+      switch (depth_op) {
+        case VK_COMPARE_OP_GREATER:
+          return s.max_z + margin >= tile_bound[t];
+        case VK_COMPARE_OP_LESS:
+          return s.min_z - margin <= tile_bound[t];
+        default:
+          return s.min_z - margin < tile_bound[t];
+      }
+    };
+
+    // the fragment shading each coarse pixel of the primitive
+    std::unordered_map<unsigned, unsigned> coarse_frag;
+    // with shade false only the depth test, remembering the primitives in
+    // pixel_prim; with shade true and EARLY_Z only their fragments
+    auto raster = [&](bool shade) {
+      for (unsigned prim = 0; prim < prim_count; prim++) {
+        const prim_setup &s = setup[prim];
+        if (s.degenerate) {
           continue;
         }
-        float depth = u * vertex_screen[(*prim)[0]][2] +
-                      v * vertex_screen[(*prim)[1]][2] +
-                      w * vertex_screen[(*prim)[2]][2];
-        // printf("depth is %f\n",depth);
-        switch(VertexMeta->DepthcmpOp) {
-          case VK_COMPARE_OP_GREATER:
-            if (FBO->depthout[pixel] > depth) {
+        coarse_frag.clear();
+        const float *p0 = &vertex_screen[4 * primitives[3 * prim]];
+        const float *p1 = &vertex_screen[4 * primitives[3 * prim + 1]];
+        const float *p2 = &vertex_screen[4 * primitives[3 * prim + 2]];
+        int min_x = std::max((int)s.min_x, band_min_x);
+        int max_x = std::min((int)s.max_x, band_max_x);
+        bool prepassed = shade && draw_config.early_z;
+        for (int x = min_x; x <= max_x; x++) {
+          for (int y = (int)s.min_y; y <= (int)s.max_y; y++) {
+            unsigned pixel = y * FBO->width + x;
+            if (prepassed) {
+              if (pixel_prim[pixel] != prim) continue;
+            } else if (hiz && (y == (int)s.min_y || y % tile_size == 0) &&
+                       !tile_visible(s, x, y)) {
+              // on to the last row of the tile
+              int tile = tile_size;
+              y = std::min(y / tile * tile + tile - 1, (int)s.max_y);
               continue;
             }
-            break;
-          case VK_COMPARE_OP_LESS:
-            if (FBO->depthout[pixel] < depth) {
+            double d20 =
+                (x - s.x1) * (s.x2 - s.x1) + (y - s.y1) * (s.y2 - s.y1);
+            double d21 =
+                (x - s.x1) * (s.x3 - s.x1) + (y - s.y1) * (s.y3 - s.y1);
+            double v = (s.d11 * d20 - s.d01 * d21) / s.denom;
+            double w = (s.d00 * d21 - s.d01 * d20) / s.denom;
+            double u = 1.0f - v - w;
+            if (u < 0 || v < 0 || w < 0) {
               continue;
             }
-            break;
-          case VK_COMPARE_OP_LESS_OR_EQUAL:
-            if (FBO->depthout[pixel] <= depth) {
+            float depth = u * p0[2] + v * p1[2] + w * p2[2];
+            // printf("depth is %f\n",depth);
+            if (!prepassed && !depth_passes(FBO->depthout[pixel], depth)) {
               continue;
             }
-            break;
-          // case VK_COMPARE_OP_NEVER:
-            // break;
-          default:
-            printf("unsupported depth compare op\n");
-            assert(0 && "unsupported depth compare op");
-        }
-        if (SKIP_FS) {
-          FBO->fbo[(pixel) * 4] = r;
-          FBO->fbo[(pixel) * 4 + 1] = g;
-          FBO->fbo[(pixel) * 4 + 2] = b;
-          FBO->fbo[(pixel) * 4 + 3] = 1.0f;
-        }
-
-        for (auto attrib : VertexMeta->vertex_id_map) {
-          std::vector<float> vec;
-          std::string attrib_name = attrib.second;
-          switch (VertexMeta->vertex_out_stride.at(attrib_name)) {
-            case 4: {
-                float v0 = VertexMeta->vertex_out.at(
-                                attrib_name)[1 * (*prim)[0]] *
-                                u +
-                            VertexMeta->vertex_out.at(
-                                attrib_name)[1 * (*prim)[1]] *
-                                v +
-                            VertexMeta->vertex_out.at(
-                                attrib_name)[1 * (*prim)[2]] *
-                                w;
-                vec.push_back(v0);
-                break;
-            }
-            case 8: {
-              // vec2
-              float v0 = VertexMeta->vertex_out.at(attrib_name)[2 * (*prim)[0]] * u +
-                        VertexMeta->vertex_out.at(attrib_name)[2 * (*prim)[1]] * v +
-                        VertexMeta->vertex_out.at(attrib_name)[2 * (*prim)[2]] * w;
-              float v1 = VertexMeta->vertex_out.at(attrib_name)[2 * (*prim)[0] + 1] * u +
-                        VertexMeta->vertex_out.at(attrib_name)[2 * (*prim)[1] + 1] * v +
-                        VertexMeta->vertex_out.at(attrib_name)[2 * (*prim)[2] + 1] * w;
-              assert(!isnan(v0) && !isnan(v1));
-              vec.push_back(v0);
-              vec.push_back(v1);
-              break;
+            if (hiz) tile_stale[tile_index(x, y)] = true;
+            FBO->depthout[pixel] = depth;
+            if (!shade) {
+              pixel_prim[pixel] = prim;
+              continue;
             }
-            case 12: {
-              // vec3
-              float v0 = VertexMeta->vertex_out.at(attrib_name)[3 * (*prim)[0]] * u +
-                        VertexMeta->vertex_out.at(attrib_name)[3 * (*prim)[1]] * v +
-                        VertexMeta->vertex_out.at(attrib_name)[3 * (*prim)[2]] * w;
-              float v1 = VertexMeta->vertex_out.at(attrib_name)[3 * (*prim)[0] + 1] * u +
-                        VertexMeta->vertex_out.at(attrib_name)[3 * (*prim)[1] + 1] * v +
-                        VertexMeta->vertex_out.at(attrib_name)[3 * (*prim)[2] + 1] * w;
-              float v2 = VertexMeta->vertex_out.at(attrib_name)[3 * (*prim)[0] + 2] * u +
-                        VertexMeta->vertex_out.at(attrib_name)[3 * (*prim)[1] + 2] * v +
-                        VertexMeta->vertex_out.at(attrib_name)[3 * (*prim)[2] + 2] * w;
-              // TODO: change to the index of normal
-              // if (attrib == 0) {
-              //   float norm = sqrt(v0 * v0 + v1 * v1 + v2 * v2);
-              //   v0 /= norm;
-              //   v1 /= norm;
-              //   v2 /= norm;
-              // }
-              vec.push_back(v0);
-              vec.push_back(v1);
-              vec.push_back(v2);
-              break;
+            if (SKIP_FS) {
+              FBO->fbo[(pixel) * 4] = s.r;
+              FBO->fbo[(pixel) * 4 + 1] = s.g;
+              FBO->fbo[(pixel) * 4 + 2] = s.b;
+              FBO->fbo[(pixel) * 4 + 3] = 1.0f;
             }
-            case 16: {
-              // vec4
-              float v0 = VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[0]] * u +
-                        VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[1]] * v +
-                        VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[2]] * w;
-              float v1 = VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[0] + 1] * u +
-                        VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[1] + 1] * v +
-                        VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[2] + 1] * w;
-              float v2 = VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[0] + 2] * u +
-                        VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[1] + 2] * v +
-                        VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[2] + 2] * w;
-              float v3 = VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[0] + 3] * u +
-                        VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[1] + 3] * v +
-                        VertexMeta->vertex_out.at(attrib_name)[4 * (*prim)[2] + 3] * w;
-              vec.push_back(v0);
-              vec.push_back(v1);
-              vec.push_back(v2);
-              vec.push_back(v3);
-              break;
+            if (coarse) {
+              auto frag = coarse_frag.insert(std::make_pair(
+                  coarse_pixel(x, y), (unsigned)slice.pixel.size()));
+              pixel_owner[pixel] = frag.first->second;
+              if (!frag.second) {
+                slice.covered.push_back(
+                    std::make_pair(frag.first->second, pixel));
+                continue;
+              }
             }
-            default: {
-              printf("unsupported vertex out attribute size\n");
-              // just add it
-              assert(0);
+
+            for (unsigned a = 0; a < attribs.size(); a++) {
+              unsigned comps = attribs[a].comps;
+              const float *a0 =
+                  attribs[a].vertex + comps * primitives[3 * prim];
+              const float *a1 =
+                  attribs[a].vertex + comps * primitives[3 * prim + 1];
+              const float *a2 =
+                  attribs[a].vertex + comps * primitives[3 * prim + 2];
+              for (unsigned c = 0; c < comps; c++) {
+                float value = a0[c] * u + a1[c] * v + a2[c] * w;
+                assert(comps != 2 || !isnan(value));
+                slice.attrib[a].push_back(value);
+              }
             }
+            slice.prim_frags[prim]++;
+            slice.pixel.push_back(pixel);
           }
-          attribs.at(attrib_name).push_back(vec);
-          assert(vec.size() == attribs.at(attrib_name)[0].size());
         }
-        tile_map[tile_id].push_back(attribs.at(pos_id).size() - 1);
-        FBO->thread_info_pixel.push_back(pixel);
-        FBO->depthout[pixel] = depth;
       }
+    };
+    if (draw_config.early_z) raster(false);
+    raster(true);
+  });
+
+  // the fragments in primitive order, then band order
+  std::vector<unsigned> slice_frag(slices.size(), 0);
+  std::vector<unsigned> frag_prim;
+  unsigned frag_count = 0;
+  for (unsigned prim = 0; prim < prim_count; prim++) {
+    for (unsigned i = 0; i < slices.size(); i++) {
+      const raster_slice &slice = slices[i];
+      unsigned end = slice_frag[i] + slice.prim_frags[prim];
+      for (unsigned f = slice_frag[i]; f < end; f++) {
+        for (unsigned a = 0; a < attribs.size(); a++) {
+          unsigned comps = attribs[a].comps;
+          attribs[a].frag.insert(attribs[a].frag.end(),
+                                 slice.attrib[a].begin() + f * comps,
+                                 slice.attrib[a].begin() + (f + 1) * comps);
+        }
+        tile_map[setup[prim].tile_id].push_back(frag_count++);
+        FBO->thread_info_pixel.push_back(slice.pixel[f]);
+        frag_prim.push_back(prim);
+      }
+      slice_frag[i] = end;
     }
   }
 
+  if (raster_start)
+    tracer_profile::get().add(TRACER_RASTER,
+                              tracer_profile::ticks() - raster_start);
   printf("total frags collected - %u\n",FBO->thread_info_pixel.size());
+  if (coarse) {
+    size_t covered = 0;
+    for (const raster_slice &slice : slices) covered += slice.covered.size();
+    printf("shading rate: %zu fragments shade %zu covered pixels\n",
+           FBO->thread_info_pixel.size(),
+           FBO->thread_info_pixel.size() + covered);
+  }
   if (FBO->thread_info_pixel.size() == 0) {
     draw++;
     // delete (VertexMeta);
@@ -1968,43 +3108,43 @@ void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned Ver
   // copy vertex data to gpu
   VertexMeta->vertex_out_count.clear();
   VertexMeta->vertex_out_size.clear();
-  for (auto attrib : VertexMeta->vertex_id_map) {
-    std::string attrib_name = attrib.second;
+  std::vector<float *> frag_out;
+  for (unsigned a = 0; a < attribs.size(); a++) {
+    std::string attrib_name = attrib_names[a];
 
-    unsigned stride = VertexMeta->vertex_out_stride.at(attrib_name);
-    VertexMeta->vertex_out_count[attrib_name] =
-        attribs.at(attrib_name).size() * attribs.at(attrib_name)[0].size();
     assert(VertexMeta->vertex_out_stride.at(attrib_name) ==
-           attribs.at(attrib_name)[0].size() * sizeof(float));
-    VertexMeta->vertex_out_size[attrib_name] = attribs.at(attrib_name).size() *
-                                               attribs.at(attrib_name)[0].size() *
-                                               sizeof(float);
+           attribs[a].comps * sizeof(float));
+    VertexMeta->vertex_out_count[attrib_name] = attribs[a].frag.size();
+    VertexMeta->vertex_out_size[attrib_name] =
+        attribs[a].frag.size() * sizeof(float);
 
     delete VertexMeta->vertex_out.at(attrib_name);
     VertexMeta->vertex_out[attrib_name] = new float[VertexMeta->vertex_out_count.at(attrib_name)];
+    frag_out.push_back(VertexMeta->vertex_out.at(attrib_name));
   }
 
   std::vector<unsigned> pixel_index = FBO->thread_info_pixel;
   std::unordered_map<unsigned, unsigned> pixel_map;
   // use map to speedup neighbour pixel lookup
   FBO->thread_info_pixel.clear();
-  unsigned index = 0;
-  for (unsigned tile = 0; tile < tile_map.size(); tile++) {
-    for (unsigned frag = 0; frag < tile_map[tile].size(); frag++) {
-      unsigned i = tile_map[tile][frag];
-      for (auto attrib : VertexMeta->vertex_id_map) {
-        std::string attrib_name = attrib.second;
-        for (unsigned j = 0; j < attribs.at(attrib_name)[i].size(); j++) {
-            VertexMeta->vertex_out.at(attrib_name)
-                                  [index * attribs.at(attrib_name)[i].size() + j] =
-                attribs.at(attrib_name)[i][j];
-        }
-      }
-      // store where the pixel is in the vector
-      pixel_map[pixel_index[i]] = FBO->thread_info_pixel.size();
-      FBO->thread_info_pixel.push_back(pixel_index[i]);
-      index++;
+  std::vector<unsigned> frag_order =
+      order_fragments(draw_config.frag_order, tile_map, pixel_index,
+                      frag_prim, FBO->width);
+  for (unsigned index = 0; index < frag_order.size(); index++) {
+    unsigned i = frag_order[index];
+    for (unsigned a = 0; a < attribs.size(); a++) {
+      unsigned comps = attribs[a].comps;
+      std::copy(attribs[a].frag.begin() + i * comps,
+                attribs[a].frag.begin() + (i + 1) * comps,
+                frag_out[a] + index * comps);
     }
+    // store where the pixel is in the vector, by coarse pixel for the
+    // derivatives of coarse shading
+    unsigned key = coarse ? coarse_pixel(pixel_index[i] % FBO->width,
+                                         pixel_index[i] / FBO->width)
+                          : pixel_index[i];
+    pixel_map[key] = FBO->thread_info_pixel.size();
+    FBO->thread_info_pixel.push_back(pixel_index[i]);
   }
   assert(pixel_index.size() == FBO->thread_info_pixel.size());
 
@@ -2037,11 +3177,22 @@ void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned Ver
       unsigned pixel = FBO->thread_info_pixel[i];
       unsigned x = pixel % FBO->width;
       unsigned y = pixel / FBO->width;
+      // a coarse pixel takes its derivatives from the coarse pixels next
+      // to it
+      int rate_x = 1, rate_y = 1;
+      if (coarse) {
+        unsigned char rate = tile_rate(x, y);
+        rate_x = rate & 15;
+        rate_y = rate >> 4;
+        pixel = coarse_pixel(x, y);
+        x = pixel % FBO->width;
+        y = pixel / FBO->width;
+      }
       // determine which pixel to get within the 2x2 quad
       int x_offset = 0;
       int y_offset = 0;
-      x % 2 == 0 ? x_offset = 1 : x_offset = -1;
-      y % 2 == 0 ? y_offset = 1 : y_offset = -1;
+      x / rate_x % 2 == 0 ? x_offset = rate_x : x_offset = -rate_x;
+      y / rate_y % 2 == 0 ? y_offset = rate_y : y_offset = -rate_y;
       // make sure the offset is within the image
       if (x + x_offset > FBO->width - 1 || x + x_offset < 0) {
         x_offset = 0;
@@ -2113,6 +3264,19 @@ void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned Ver
   print_memcpy("MemcpyVulkan",VertexMeta->constants_dev_addr, 1024, 0);
   
 
+  // the screen tile of the first fragment of each CTA, accel-sim's
+  // -gpgpu_tile_binning_window keeps CTAs of neighbouring tiles on one SM
+  {
+    std::stringstream tiles;
+    tiles << "FragmentTiles," << tile_columns;
+    for (unsigned f = 0; f < FBO->thread_info_pixel.size(); f += block_size) {
+      unsigned pixel = FBO->thread_info_pixel[f];
+      tiles << "," << pixel / FBO->width / tile_size * tile_columns +
+                          pixel % FBO->width / tile_size;
+    }
+    context->get_device()->get_gpgpu()->trace_command(tiles.str());
+  }
+
   // pixel shaders
   VulkanRayTracing::is_FS = true;
   VulkanRayTracing::thread_count = FBO->thread_info_pixel.size();
@@ -2121,10 +3285,32 @@ void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned Ver
   // copy back framebuffer and dump
   context->get_device()->get_gpgpu()->memcpy_from_gpu(FBO->fbo, FBO->fbo_dev,
                                                       FBO->fbo_size);
+  // coarse shading: the colours of the shaded pixels go to the pixels they
+  // cover, when neither lost to a later primitive
+  for (const raster_slice &slice : slices) {
+    for (const auto &covered : slice.covered) {
+      unsigned shaded = slice.pixel[covered.first];
+      unsigned pixel = covered.second;
+      if (pixel_owner[pixel] != covered.first ||
+          pixel_owner[shaded] != covered.first)
+        continue;
+      std::copy(FBO->fbo + shaded * 4, FBO->fbo + shaded * 4 + 4,
+                FBO->fbo + pixel * 4);
+      context->get_device()->get_gpgpu()->memcpy_to_gpu(
+          (size_t)(FBO->fbo_dev + pixel * 4), FBO->fbo + pixel * 4,
+          4 * sizeof(float));
+    }
+  }
+  // the surfaces the fragment kernel left, the depth where accel-sim's ROP
+  // model puts it, after the color
+  print_attachment("color", FBO->fbo_dev, FBO->fbo, FBO->fbo_count / 4, 4);
+  print_attachment("depth", FBO->fbo_dev + FBO->fbo_size, FBO->depthout,
+                   FBO->fbo_count / 4, 1);
   }
 
   FBO->thread_info_pixel.clear();
   printf("Drawcall #%u Done\n", draw);
+  tracer_profile::get().end();
 
   draw++;
   
@@ -2136,13 +3322,14 @@ void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned Ver
 }
 
 void VulkanRayTracing::read_binary_file(std::string path, void* ptr, unsigned size) {
-    // read in before
-  std::ifstream dataStream(path, std::fstream::in | std::fstream::binary);
-  if (!dataStream.is_open()) {
+    // read in before, or prefetched by dump_loader
+  size_t loaded;
+  const void *data = dump_loader::get().load(path, &loaded);
+  if (!data) {
     abort();
   }
-  dataStream.read((char*) ptr, size);
-  dataStream.close();
+  memcpy(ptr, data, std::min((size_t)size, loaded));
+  dump_loader::get().release(path);
 }
 
 void VulkanRayTracing::saveIndexBuffer(struct anv_buffer *ptr, VkIndexType type) {
@@ -2153,35 +3340,40 @@ void VulkanRayTracing::saveIndexBuffer(struct anv_buffer *ptr, VkIndexType type)
 
 uint64_t VulkanRayTracing::getVertexAddr(uint32_t buffer_index,
                                          uint32_t tid) {
+  struct vertex_metadata *meta = VertexMeta;
+  if (!vertex_batch.meta.empty()) {
+    meta = vertex_batch_draw(tid);
+    if (!meta) return 0;
+  }
   // instancing (multiple vertex attributes in one vertex buffer)
   // assert(buffer_index < VertexMeta->VertexAttrib->binding.size());
   unsigned loc = -1;
-  for (unsigned i = 0; i < VertexMeta->VertexAttrib->location.size(); i++) {
-    if (buffer_index == VertexMeta->VertexAttrib->location[i]) {
+  for (unsigned i = 0; i < meta->VertexAttrib->location.size(); i++) {
+    if (buffer_index == meta->VertexAttrib->location[i]) {
       loc = i;
       break;
     }
   }
   assert(loc != -1);
-  assert(buffer_index == VertexMeta->VertexAttrib->location[loc]);
-  unsigned binding = VertexMeta->VertexAttrib->binding[loc];
-  unsigned attrib_stride = VertexMeta->VertexAttrib->offset[loc];
+  assert(buffer_index == meta->VertexAttrib->location[loc]);
+  unsigned binding = meta->VertexAttrib->binding[loc];
+  unsigned attrib_stride = meta->VertexAttrib->offset[loc];
 
-  unsigned instance = tid / VertexMeta->vb.size();
-  unsigned index = tid % VertexMeta->vb.size();
-  if (tid >= VulkanRayTracing::thread_count) {
+  unsigned instance = tid / meta->vb.size();
+  unsigned index = tid % meta->vb.size();
+  if (vertex_batch.meta.empty() && tid >= VulkanRayTracing::thread_count) {
     // out of range
     return 0;
   }
   unsigned offset = 0;
-  if (VertexMeta->VertexAttrib->rate[binding] == VK_VERTEX_INPUT_RATE_VERTEX) {
-    offset = VertexMeta->vb[index] * VertexMeta->vertex_stride[binding] / 4;
-    assert(offset < VertexMeta->vertex_count[binding] * VertexMeta->InstanceCount);
-  } else if (VertexMeta->VertexAttrib->rate[binding] == VK_VERTEX_INPUT_RATE_INSTANCE) {
-    offset = instance * VertexMeta->vertex_stride[binding] / 4;
-    assert(offset < VertexMeta->vertex_count[binding]);
-  }
-  return VertexMeta->vertex_addr[binding] + offset + attrib_stride / 4;
+  if (meta->VertexAttrib->rate[binding] == VK_VERTEX_INPUT_RATE_VERTEX) {
+    offset = meta->vb[index] * meta->vertex_stride[binding] / 4;
+    assert(offset < meta->vertex_count[binding] * meta->InstanceCount);
+  } else if (meta->VertexAttrib->rate[binding] == VK_VERTEX_INPUT_RATE_INSTANCE) {
+    offset = instance * meta->vertex_stride[binding] / 4;
+    assert(offset < meta->vertex_count[binding]);
+  }
+  return meta->vertex_addr[binding] + offset + attrib_stride / 4;
   //   if (app_id == INSTANCING && draw == 1) {
   //     float *base = 0x0;
   //     if (buffer_index < 3) {
@@ -2241,6 +3433,10 @@ uint64_t VulkanRayTracing::getVertexOutAddr(std::string identifier,
     // out of range
     return 0;
   }
+  uint32_t draw_tid = tid;
+  if (!vertex_batch.meta.empty() && !vertex_batch_draw(draw_tid)) {
+    return 0;
+  }
 //   assert(offset < VertexMeta->vertex_out_count[buffer_index]);
   return VertexMeta->vertex_out_devptr.at(identifier) + offset;
 }
@@ -2267,7 +3463,11 @@ void VulkanRayTracing::getFragCoord(uint32_t thread_id, uint32_t &x,
   y = FBO->thread_info_pixel[thread_id] / FBO->width;
 }
 
-uint64_t VulkanRayTracing::getConst() {
+uint64_t VulkanRayTracing::getConst(uint32_t tid) {
+    if (!vertex_batch.meta.empty()) {
+      struct vertex_metadata *meta = vertex_batch_draw(tid);
+      if (meta) return meta->constants_dev_addr;
+    }
     return VertexMeta->constants_dev_addr;
 }
 
@@ -2291,6 +3491,9 @@ void VulkanRayTracing::vkCmdTraceRaysKHR(
     // launch_width = 32;
     // launch_height = 32;
     init(launch_width, launch_height);
+    tlas_cache_set = -1;
+    GPGPU_Context()->func_sim->g_rt_treelets.clear();
+    embree_mirror.clear();
     
     // Dump Descriptor Sets
     if (!use_external_launcher) 
@@ -2346,6 +3549,8 @@ void VulkanRayTracing::vkCmdTraceRaysKHR(
     // }
 
     assert(launch_depth == 1);
+    static unsigned dispatches = 0;
+    tracer_profile::get().begin("dispatch " + std::to_string(dispatches++));
 
     struct anv_descriptor desc;
     desc.image_view = NULL;
@@ -2423,19 +3628,23 @@ void VulkanRayTracing::vkCmdTraceRaysKHR(
     grid->vulkan_metadata.launch_height = launch_height;
     grid->vulkan_metadata.launch_depth = launch_depth;
     
+    gpgpu_sim *gpu = context->get_device()->get_gpgpu();
+    ser_model::get().configure(gpu->get_config().ser(),
+                               gpu->getShaderCoreConfig()->max_warps_per_shader);
+
     struct CUstream_st *stream = 0;
     stream_operation op(grid, ctx->func_sim->g_ptx_sim_mode, stream);
+    unsigned grid_uid = grid->get_uid();
     ctx->the_gpgpusim->g_stream_manager->push(op);
 
     //printf("%d\n", descriptors[0][1].address);
 
     fflush(stdout);
 
-    while(!op.is_done() && !op.get_kernel()->done()) {
-        printf("waiting for op to finish\n");
-        sleep(1);
-        continue;
-    }
+    ctx->the_gpgpusim->g_stream_manager->wait_kernel_finished(grid_uid);
+    ser_model::get().print_dispatch(stdout);
+    // a dispatch renders a frame
+    tracer_profile::get().print_frame(stdout);
     // for (unsigned i = 0; i < entry->num_args(); i++) {
     //     std::pair<size_t, unsigned> p = entry->get_param_config(i);
     //     cudaSetupArgumentInternal(args[i], p.first, p.second);
@@ -2459,6 +3668,8 @@ void VulkanRayTracing::callMissShader(const ptx_instruction *pI, ptx_thread_info
     uint32_t shaderID = *((uint32_t *)(thread->get_kernel().vulkan_metadata.miss_sbt) + 8 * missIndex);
     
     shader_stage_info miss_shader = shaders[shaderID];
+    if (ser_model::get().enabled())
+        ser_model::get().shader_called(thread, miss_shader.ID, 0);
 
     function_info *entry = context->get_kernel(miss_shader.function_name);
     callShader(pI, thread, entry);
@@ -2490,6 +3701,13 @@ void VulkanRayTracing::callClosestHitShader(const ptx_instruction *pI, ptx_threa
         mem->read(&(traversal_data->closest_hit.hitGroupIndex), sizeof(traversal_data->closest_hit.hitGroupIndex), &hitGroupIndex);
         closesthit_shader = shaders[*((uint64_t *)(thread->get_kernel().vulkan_metadata.hit_sbt) + 8 * hitGroupIndex)];
     }
+    if (ser_model::get().enabled()) {
+        // the material key, the instance and geometry of the hit
+        uint32_t instance_index, geometry_index;
+        mem->read(&(traversal_data->closest_hit.instance_index), sizeof(instance_index), &instance_index);
+        mem->read(&(traversal_data->closest_hit.geometry_index), sizeof(geometry_index), &geometry_index);
+        ser_model::get().shader_called(thread, closesthit_shader.ID, instance_index << 12 ^ geometry_index);
+    }
 
     function_info *entry = context->get_kernel(closesthit_shader.function_name);
     callShader(pI, thread, entry);
@@ -2717,6 +3935,8 @@ void VulkanRayTracing::getTexture(struct anv_descriptor *desc,
                                     std::vector<ImageMemoryTransactionRecord>& transactions,
                                     uint64_t launcher_offset)
 {
+    tracer_timer timer(TRACER_TEXTURE);
+    size_t texels = transactions.size();
     Pixel pixel;
 
     if (true)
@@ -2744,6 +3964,7 @@ void VulkanRayTracing::getTexture(struct anv_descriptor *desc,
     TXL_DPRINTF("Setting transaction type to TEXTURE_LOAD\n");
     for(int i = 0; i < transactions.size(); i++)
         transactions[i].type = ImageTransactionType::TEXTURE_LOAD;
+    tracer_profile::get().count(TRACER_TEXELS, transactions.size() - texels);
     
     c0 = pixel.c0;
     c1 = pixel.c1;
@@ -2937,7 +4158,7 @@ void VulkanRayTracing::dumpVertex(struct anv_buffer *vbuffer, struct anv_graphic
     context->get_device()
         ->get_gpgpu()
         ->valid_addr_end["vb" + std::to_string(setID)] = ((uint64_t)devPtr) + size;
-    context->get_device()->get_gpgpu()->memcpy_to_gpu(devPtr, address, size);
+    upload_to_gpu(context->get_device()->get_gpgpu(), devPtr, address, size);
     VertexMeta->vertex_addr[setID] = devPtr;
     // VertexMeta->vertex_size[setID] = size;
     // VertexMeta->vertex_count[setID] = size / 4;
@@ -3031,14 +4252,27 @@ void VulkanRayTracing::dumpTextures(struct anv_descriptor *desc, uint32_t setID,
             abort(); // should not be here!
     }
 
+    uint64_t meta[] = {size, image_extent_width, image_extent_height,
+                       (uint64_t)format, (uint64_t)VkDescriptorTypeNum,
+                       image->n_planes, image->samples,
+                       (uint64_t)image->tiling,
+                       (uint64_t)image->planes[0].surface.isl.tiling,
+                       image->planes[0].surface.isl.row_pitch_B,
+                       (uint64_t)filter, image->levels};
+    uint64_t hash = dump_store::hash(address, size,
+                                     dump_store::hash(meta, sizeof(meta), 0));
+    u_int32_t *devPtr = NULL;
+    bool unchanged = same_dump(texture_dumps, setID, binding, address, size,
+                               hash, true, (void **)&devPtr);
+
     // Texture data
     char fullPath[200];
+    if (!unchanged) {
     snprintf(fullPath, sizeof(fullPath), "%s%s%d_%d.vktexturedata", mesa_root, filePath, setID, binding);
     // File name format: setID_descID.vktexturedata
 
-    fp = fopen(fullPath, "wb+");
-    fwrite(address, 1, size, fp);
-    fclose(fp);
+    dump_store::get(std::string(mesa_root ? mesa_root : "") + filePath)
+        .write(fullPath, address, size);
 
     // Texture metadata
     snprintf(fullPath, sizeof(fullPath), "%s%s%d_%d.vktexturemetadata", mesa_root, filePath, setID, binding);
@@ -3057,13 +4291,16 @@ void VulkanRayTracing::dumpTextures(struct anv_descriptor *desc, uint32_t setID,
                                                  image->planes[0].surface.isl.row_pitch_B,
                                                  filter);
     fclose(fp);
-    
+    }
 
-    u_int32_t *devPtr;
     gpgpu_context *ctx = GPGPU_Context();
     CUctx_st *context = GPGPUSim_Context(ctx);
-    devPtr = context->get_device()->get_gpgpu()->gpu_malloc(size);
-    context->get_device()->get_gpgpu()->memcpy_to_gpu(devPtr, address, size);
+    if (!devPtr) {
+      devPtr = context->get_device()->get_gpgpu()->gpu_malloc(size);
+      upload_to_gpu(context->get_device()->get_gpgpu(), devPtr, address, size);
+    }
+    descriptor_dump_t dump = {address, size, hash, devPtr};
+    texture_dumps[std::make_pair(setID, binding)] = dump;
     context->get_device()
         ->get_gpgpu()
         ->valid_addr_start["tex" + std::to_string(setID) +
@@ -3299,23 +4536,38 @@ void VulkanRayTracing::dump_descriptor_set(uint32_t setID, uint32_t descID, void
             abort(); // should not be here!
     }
 
+    // the device copy is size floats, see below
+    uint64_t hash = dump_store::hash(address, size * sizeof(float),
+                              VkDescriptorTypeNum);
+    u_int32_t *devPtr = NULL;
+    bool unchanged = same_dump(
+        buffer_dumps, setID, descID, address, size, hash,
+        type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ||
+            type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        (void **)&devPtr);
+
     char fullPath[200];
+    if (!unchanged) {
     snprintf(fullPath, sizeof(fullPath), "%s%s%d_%d_%d_%d%s", mesa_root, filePath, setID, descID, size, VkDescriptorTypeNum, extension);
     // File name format: setID_descID_SizeInBytes_VkDescriptorType.vkdescrptorsetdata
 
-    fp = fopen(fullPath, "wb+");
-    fwrite(address, 1, size, fp);
-    fclose(fp);
+    dump_store::get(std::string(mesa_root ? mesa_root : "") + filePath)
+        .write(fullPath, address, size);
+    }
     // VertexMeta->decoded_descriptors[setID][descID].addr = address;
     // VertexMeta->decoded_descriptors[setID][descID].size = size;
 
     
 
-    u_int32_t *devPtr;
     gpgpu_context *ctx = GPGPU_Context();
     CUctx_st *context = GPGPUSim_Context(ctx);
-    devPtr = context->get_device()->get_gpgpu()->gpu_malloc(size * sizeof(float));
-    context->get_device()->get_gpgpu()->memcpy_to_gpu(devPtr, address, size * sizeof(float));
+    if (!devPtr) {
+      devPtr = context->get_device()->get_gpgpu()->gpu_malloc(size * sizeof(float));
+      upload_to_gpu(context->get_device()->get_gpgpu(), devPtr, address,
+                    size * sizeof(float));
+    }
+    descriptor_dump_t dump = {address, size, hash, devPtr};
+    buffer_dumps[std::make_pair(setID, descID)] = dump;
     setDescriptorSetFromLauncher(address,devPtr,setID,descID);
     context->get_device()->get_gpgpu()->valid_addr_start["desc" + std::to_string(setID) + std::to_string(descID)] = (uint64_t)devPtr;
     context->get_device()->get_gpgpu()->valid_addr_end["desc" + std::to_string(setID) + std::to_string(descID)] =  ((uint64_t)devPtr) +  size * sizeof(float);
@@ -3774,6 +5026,17 @@ void VulkanRayTracing::setTextureFromLauncher(void *address,
     texture->filter = filter;
     texture->deviceAddress = deviceAddress;
     texture->mip_level = mip_level;
+    texture->max_lod = log2(width) - log2(16);
+    for (uint32_t lod = 0; lod < texture_metadata::LOD_ROWS; lod++) {
+        uint32_t y = 0;
+        for (unsigned i = 0; i < lod; i++) {
+          if (i == 1) {
+            continue;
+          }
+          y += height / pow(2, i);
+        }
+        texture->lod_y_offset[lod] = y;
+    }
 
     // VertexMeta->decoded_descriptors[setID][descID].is_texture = true;
     // VertexMeta->decoded_descriptors[setID][descID].addr = (void*) texture;
@@ -185,6 +185,12 @@ typedef struct texture_metadata
     uint32_t row_pitch_B;
     VkFilter filter;
     uint32_t mip_level;
+    // sampling state of load_image_pixel, set up once by
+    // setTextureFromLauncher: the last lod with texels and the row of the
+    // mip tail where each lod starts
+    uint32_t max_lod;
+    static const uint32_t LOD_ROWS = 32;
+    uint32_t lod_y_offset[LOD_ROWS];
 } texture_metadata;
 
 #define MAX_VERTEX 28
@@ -211,7 +217,8 @@ typedef struct vertex_metadata
 {
     // assuming all data are 4-Byte
     // *device* vertex buffer
-    std::vector<std::unordered_map<uint32_t, uint32_t>> vertex_map;
+    // the entry of vb, the vertex shader thread, each index is shaded by
+    std::vector<uint32_t> index_vb;
     std::vector<unsigned> vb;
     struct anv_buffer *vertex_buffers[MAX_VERTEX] = {NULL};
     uint32_t* vertex_addr[MAX_VERTEX] = {NULL};
@@ -245,6 +252,9 @@ typedef struct vertex_metadata
     VkViewport viewports;
     // struct anv_vertex_binding *vbuffer;
     struct anv_graphics_pipeline *pipeline;
+    // the render pass and subpass the draw was recorded in
+    const struct anv_render_pass *render_pass = NULL;
+    const struct anv_subpass *subpass = NULL;
     struct anv_descriptor_set *descriptor_set[8] = {NULL};
     // struct desc_ptr decoded_descriptors[MAX_DESCRIPTOR_SETS][MAX_DESCRIPTOR_SET_BINDINGS];
     struct anv_descriptor *decoded_descriptors[MAX_DESCRIPTOR_SETS][MAX_DESCRIPTOR_SET_BINDINGS];
@@ -317,11 +327,14 @@ private:
     static bool _init_;
 public:
     // static RayDebugGPUData rayDebugGPUData[2000][2000];
-    static warp_intersection_table*** intersection_table;
     static const IntersectionTableType intersectionTableType = IntersectionTableType::Baseline;
+    typedef intersection_table_of<intersectionTableType>::type warp_intersection_table;
+    static warp_intersection_table*** intersection_table;
 
 private:
     static bool mt_ray_triangle_test(float3 p0, float3 p1, float3 p2, Ray ray_properties, float* thit);
+    // with the edges p1 - p0 and p2 - p0 already computed
+    static bool mt_ray_triangle_edges_test(float3 p0, float3 v0v1, float3 v0v2, const Ray &ray_properties, float* thit);
     static float3 Barycentric(float3 p, float3 a, float3 b, float3 c);
     static std::vector<shader_stage_info> shaders;
     static std::unordered_map<void *, unsigned> pipeline_shader_map;
@@ -363,7 +376,12 @@ public:
     static void setDescriptorSet(struct anv_descriptor_set *set, unsigned set_index);
     static void invoke_gpgpusim();
     static uint32_t registerShaders(char * shaderPath, gl_shader_stage shaderType);
-    static void VulkanRayTracing::run_shader(unsigned shader_id, unsigned thread_count);
+    // draw_ctas, when not empty, split the trace of the launch into one
+    // kernel per draw of that many CTAs
+    static void VulkanRayTracing::run_shader(unsigned shader_id, unsigned thread_count,
+                                             const std::vector<unsigned> &draw_ctas = std::vector<unsigned>());
+    static unsigned setup_vertex_stage();
+    static void run_vertex_batch(unsigned vertex_id);
     static void VulkanRayTracing::vkCmdDraw(struct anv_cmd_buffer *cmd_buffer, unsigned VertexCount, unsigned StartVertex, unsigned instanceCount, unsigned StartInstance, unsigned BaseVertex);
     static void VulkanRayTracing::read_binary_file(std::string path, void* ptr, unsigned size);
     static void VulkanRayTracing::saveIndexBuffer(struct anv_buffer *ptr, VkIndexType type);
@@ -373,7 +391,7 @@ public:
     static uint64_t VulkanRayTracing::getFBOAddr(uint32_t offset);
     static void VulkanRayTracing::getFragCoord(uint32_t thread_id, uint32_t &x,
                                                uint32_t &y);
-    static uint64_t VulkanRayTracing::getConst();
+    static uint64_t VulkanRayTracing::getConst(uint32_t tid);
     static float VulkanRayTracing::getTexLOD(unsigned thread_id);
     static void VulkanRayTracing::clearDraws();
     static void VulkanRayTracing::saveDumbDraw();
@@ -93,7 +93,7 @@ typedef struct Vulkan_RT_thread_data {
 
     unsigned attrib_index = -1;
     if (name.find("\%draw_call") != std::string::npos) {
-      entry.address = VulkanRayTracing::getConst();
+      entry.address = VulkanRayTracing::getConst(offset);
     } else
     if (!VulkanRayTracing::is_FS) {
       if (identifier.find("VERT_ATTRIB_GENERIC") != std::string::npos) {
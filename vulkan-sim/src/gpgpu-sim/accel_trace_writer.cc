@@ -0,0 +1,169 @@
+// Per-kernel Accel-Sim traces written while tracing
+
+#include "accel_trace_writer.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+accel_trace_writer::accel_trace_writer() {
+  m_gzip = false;
+  m_kernels = 0;
+  m_in_kernel = false;
+  m_block_dim = 0;
+  m_nregs = 0;
+  m_part = 0;
+  m_part_begin = 0;
+  m_warps_per_cta = 1;
+  m_grid_dim = 0;
+  m_first_warp = 0;
+  m_end_warp = 0;
+  m_next_cta = 0;
+}
+
+bool accel_trace_writer::open(const std::string &dir, bool gzip) {
+  m_dir = dir;
+  m_gzip = gzip;
+  system(("mkdir -p " + dir).c_str());
+  return m_list.open(dir + "/kernelslist.g", gzip);
+}
+
+void accel_trace_writer::command(const std::string &line) {
+  m_list << line << "\n";
+}
+
+void accel_trace_writer::begin_kernel(const std::string &name,
+                                      unsigned grid_dim, unsigned block_dim,
+                                      const std::vector<unsigned> &part_ctas) {
+  if (m_in_kernel) end_kernel();
+  if (name.find("VERTEX") != std::string::npos) {
+    m_nregs = 48;
+  } else if (name.find("FRAGMENT") != std::string::npos) {
+    m_nregs = 52;
+  } else {
+    printf("GPGPU-Sim: can not trace kernel %s, neither VERTEX nor FRAGMENT\n",
+           name.c_str());
+    exit(1);
+  }
+  m_in_kernel = true;
+  m_kernel_name = name;
+  m_block_dim = block_dim;
+  m_warps_per_cta = (block_dim + 31) / 32;
+  m_grid_dim = grid_dim;
+  m_first_warp = m_end_warp;
+  m_next_cta = 0;
+  m_cta_exited_warps.assign(grid_dim, 0);
+
+  m_part_ends.clear();
+  unsigned end = 0;
+  for (unsigned ctas : part_ctas) {
+    assert(ctas);
+    end += ctas;
+    m_part_ends.push_back(end);
+  }
+  assert(part_ctas.empty() || end == grid_dim);
+  if (m_part_ends.empty()) m_part_ends.push_back(grid_dim);
+  m_part = 0;
+  open_part();
+}
+
+void accel_trace_writer::open_part() {
+  m_part_begin = m_part ? m_part_ends[m_part - 1] : 0;
+  m_kernel_file =
+      "kernel-" + m_kernel_name + "_" + std::to_string(m_kernels) + ".traceg";
+  if (!m_kernel.open(m_dir + "/" + m_kernel_file, m_gzip)) {
+    printf("GPGPU-Sim: can not write %s/%s\n", m_dir.c_str(),
+           m_kernel_file.c_str());
+    exit(1);
+  }
+
+  m_kernel << "-kernel name = " << m_kernel_name << "\n";
+  m_kernel << "-kernel id = " << m_kernels << "\n";
+  m_kernel << "-grid dim = (" << m_part_ends[m_part] - m_part_begin
+           << ",1,1)\n";
+  m_kernel << "-block dim = (" << m_block_dim << ",1,1)\n";
+  m_kernel << "-shmem = 0\n";
+  m_kernel << "-nregs = " << m_nregs << "\n";
+  m_kernel << "-binary version = 80\n";
+  m_kernel << "-cuda stream id = 0\n";
+  m_kernel << "-shmem base_addr = 0xffffffff\n";
+  m_kernel << "-local mem base_addr = 0xffffffff\n";
+  m_kernel << "-nvbit version = 1.5.3\n";
+  m_kernel << "-accelsim tracer version = 3\n";
+  m_kernel << "#traces format = threadblock_x threadblock_y threadblock_z "
+              "warpid_tb PC mask dest_num [reg_dests] opcode src_num "
+              "[reg_srcs] mem_width [adrrescompress?] [mem_addresses]\n";
+}
+
+void accel_trace_writer::close_part() {
+  m_kernel.close();
+  m_list << m_kernel_file << "\n";
+  m_list.flush();
+  m_kernels++;
+}
+
+void accel_trace_writer::instruction(unsigned dynamic_warp_id,
+                                     const std::string &inst) {
+  assert(m_in_kernel);
+  // warps of CTAs already written have exited
+  if (dynamic_warp_id < m_first_warp + m_next_cta * m_warps_per_cta) return;
+  std::string &insts = m_warp_insts[dynamic_warp_id];
+  insts += inst;
+  insts += '\n';
+  m_warp_inst_count[dynamic_warp_id]++;
+  if (dynamic_warp_id >= m_end_warp) m_end_warp = dynamic_warp_id + 1;
+}
+
+void accel_trace_writer::warps_exited(
+    const std::vector<unsigned> &dynamic_warp_ids) {
+  if (!m_in_kernel) return;
+  for (unsigned id : dynamic_warp_ids) {
+    if (id < m_first_warp) continue;
+    unsigned cta = (id - m_first_warp) / m_warps_per_cta;
+    if (cta < m_cta_exited_warps.size()) m_cta_exited_warps[cta]++;
+  }
+  write_ready_ctas();
+}
+
+void accel_trace_writer::write_ready_ctas() {
+  while (m_next_cta < m_grid_dim &&
+         m_cta_exited_warps[m_next_cta] >= m_warps_per_cta)
+    write_cta(m_next_cta++);
+}
+
+void accel_trace_writer::write_cta(unsigned cta) {
+  m_kernel << "\n#BEGIN_TB\n\n";
+  m_kernel << "thread block = " << cta - m_part_begin << ",0,0\n";
+  for (unsigned w = 0; w < m_warps_per_cta; w++) {
+    unsigned id = m_first_warp + cta * m_warps_per_cta + w;
+    m_kernel << "\nwarp = " << w << "\n";
+    m_kernel << "insts = " << m_warp_inst_count[id] << "\n";
+    m_kernel << m_warp_insts[id];
+    m_warp_insts.erase(id);
+    m_warp_inst_count.erase(id);
+  }
+  m_kernel << "\n#END_TB\n\n";
+  // the next part starts with the next CTA
+  if (cta + 1 == m_part_ends[m_part] && m_part + 1 < m_part_ends.size()) {
+    close_part();
+    m_part++;
+    open_part();
+  }
+}
+
+void accel_trace_writer::end_kernel() {
+  if (!m_in_kernel) return;
+  while (m_next_cta < m_grid_dim) write_cta(m_next_cta++);
+  // every CTA of the grid got its warp ids
+  unsigned end = m_first_warp + m_grid_dim * m_warps_per_cta;
+  if (end > m_end_warp) m_end_warp = end;
+  m_warp_insts.clear();
+  m_warp_inst_count.clear();
+  close_part();
+  m_in_kernel = false;
+}
+
+void accel_trace_writer::close() {
+  end_kernel();
+  if (m_list.is_open()) m_list.close();
+}
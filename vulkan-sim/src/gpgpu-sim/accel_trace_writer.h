@@ -0,0 +1,83 @@
+// Per-kernel Accel-Sim traces written while tracing
+//
+// With -gpgpu_trace_dir the traced instructions go straight into one
+// kernel-<name>_<n>.traceg per launch plus the kernelslist.g that lists
+// them with the memcpys in between, in the layout
+// util/graphics/process-vulkan-traces.py makes out of traces.traceg, so no
+// post-processing pass over a monolithic trace is needed. Instructions are
+// buffered per warp and a CTA is written as soon as it and every CTA before
+// it exited, so memory holds the CTAs in flight rather than the trace.
+// The files are trace_files, written by a background thread.
+// Warps are told apart by their dynamic warp id and CTAs are the groups of
+// block_dim / 32 consecutive ids from the first warp of the launch, as in
+// the script.
+// A launch that runs the vertex shaders of several draws (DRAW_BATCH) is
+// split into consecutive CTA ranges, one kernel file per draw with its CTAs
+// numbered from 0, as if each draw had been launched on its own.
+
+#ifndef ACCEL_TRACE_WRITER_H
+#define ACCEL_TRACE_WRITER_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "trace_file.h"
+
+class accel_trace_writer {
+ public:
+  accel_trace_writer();
+
+  // false when dir/kernelslist.g cannot be created
+  bool open(const std::string &dir, bool gzip);
+  bool enabled() const { return m_list.is_open(); }
+
+  // a memcpy or texture line of kernelslist.g
+  void command(const std::string &line);
+  // part_ctas, when not empty, are the CTA counts of the kernels the
+  // launch is split into, adding up to grid_dim
+  void begin_kernel(const std::string &name, unsigned grid_dim,
+                    unsigned block_dim,
+                    const std::vector<unsigned> &part_ctas =
+                        std::vector<unsigned>());
+  // one instruction, without the warp id prefix and the newline
+  void instruction(unsigned dynamic_warp_id, const std::string &inst);
+  void warps_exited(const std::vector<unsigned> &dynamic_warp_ids);
+  // writes what is left of the kernel and lists it in kernelslist.g
+  void end_kernel();
+  void close();
+
+ private:
+  void open_part();
+  void close_part();
+  void write_ready_ctas();
+  void write_cta(unsigned cta);
+
+  std::string m_dir;
+  bool m_gzip;
+  trace_file m_list;
+  trace_file m_kernel;
+  std::string m_kernel_file;
+  unsigned m_kernels;
+  bool m_in_kernel;
+  std::string m_kernel_name;
+  unsigned m_block_dim;
+  unsigned m_nregs;
+  // one past the last CTA of each part, the part being written and its
+  // first CTA
+  std::vector<unsigned> m_part_ends;
+  unsigned m_part;
+  unsigned m_part_begin;
+  unsigned m_warps_per_cta;
+  unsigned m_grid_dim;
+  // dynamic warp id of the first warp of the launch, and one past the
+  // largest id traced so far
+  unsigned m_first_warp;
+  unsigned m_end_warp;
+  unsigned m_next_cta;
+  std::unordered_map<unsigned, std::string> m_warp_insts;
+  std::unordered_map<unsigned, unsigned> m_warp_inst_count;
+  std::vector<unsigned> m_cta_exited_warps;
+};
+
+#endif
@@ -33,6 +33,8 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <limits>
 #include "zlib.h"
 
 #include "dram.h"
@@ -57,6 +59,7 @@
 #include "../cuda-sim/cuda_device_runtime.h"
 #include "../cuda-sim/ptx-stats.h"
 #include "../cuda-sim/ptx_ir.h"
+#include "../cuda-sim/tracer_profile.h"
 #include "../debug.h"
 #include "../gpgpusim_entrypoint.h"
 #include "../statwrapper.h"
@@ -269,6 +272,11 @@ void shader_core_config::reg_options(class OptionParser *opp) {
       opp, "-gpgpu_rt_coherence_engine_config", OPT_CSTR, &m_rt_coherence_engine_config_str,
       "max cycles, hash ",
       "100, d");
+  option_parser_register(
+      opp, "-gpgpu_rt_treelet_bytes", OPT_UINT32, &m_rt_treelet_bytes,
+      "split BVHs into treelets of this many bytes that the RT unit "
+      "prefetches and schedules rays by (0 = off) ",
+      "0");
   option_parser_register(
       opp, "-gpgpu_rt_disable_rt_cache", OPT_BOOL, &bypassL0Complet,
       "bypass RT cache and connect RT unit directly to interconnect ",
@@ -639,6 +647,13 @@ void gpgpu_sim_config::reg_options(option_parser_t opp) {
   option_parser_register(opp, "-gpgpu_flush_l1_cache", OPT_BOOL,
                          &gpgpu_flush_l1_cache,
                          "Flush L1 cache at the end of each kernel call", "0");
+  option_parser_register(opp, "-gpgpu_trace_dir", OPT_CSTR, &gpgpu_trace_dir,
+                         "write the traces per kernel with their kernelslist.g "
+                         "into this directory instead of traces.traceg",
+                         "");
+  option_parser_register(opp, "-gpgpu_trace_gzip", OPT_BOOL,
+                         &gpgpu_trace_gzip,
+                         "gzip the trace files, which get a .gz suffix", "0");
   option_parser_register(opp, "-gpgpu_flush_l2_cache", OPT_BOOL,
                          &gpgpu_flush_l2_cache,
                          "Flush L2 cache at the end of each kernel call", "0");
@@ -880,7 +895,11 @@ void exec_gpgpu_sim::createSIMTCluster() {
 }
 
 gpgpu_sim::gpgpu_sim(const gpgpu_sim_config &config, gpgpu_context *ctx)
-    : gpgpu_t(config, ctx), m_config(config) {
+    : gpgpu_t(config, ctx),
+      m_config(config),
+      valid_addr_start(&m_valid_addr_changed),
+      valid_addr_end(&m_valid_addr_changed) {
+  m_valid_addr_changed = false;
   gpgpu_ctx = ctx;
   m_shader_config = &m_config.m_shader_config;
   m_memory_config = &m_config.m_memory_config;
@@ -955,7 +974,97 @@ gpgpu_sim::gpgpu_sim(const gpgpu_sim_config &config, gpgpu_context *ctx)
   // Jin: functional simulation for CDP
   m_functional_sim = false;
   m_functional_sim_kernel = NULL;
-  gtrace.open("traces.traceg");
+  if (m_config.trace_dir()[0]) {
+    if (!m_trace_writer.open(m_config.trace_dir(),
+                             m_config.trace_gzip())) {
+      printf("GPGPU-Sim: can not write %s/kernelslist.g\n",
+             m_config.trace_dir());
+      exit(1);
+    }
+  } else if (!gtrace.open("traces.traceg", m_config.trace_gzip())) {
+    printf("GPGPU-Sim: can not write traces.traceg\n");
+    exit(1);
+  }
+}
+
+bool gpgpu_sim::valid_addr(uint64_t addr) {
+  if (m_valid_addr_changed) {
+    m_valid_addr_ranges.clear();
+    for (const auto &start : valid_addr_start) {
+      m_valid_addr_ranges.push_back(
+          std::make_pair(start.second, valid_addr_end.at(start.first)));
+    }
+    std::sort(m_valid_addr_ranges.begin(), m_valid_addr_ranges.end());
+    // merge overlapping ranges so the one before addr decides
+    unsigned merged = 0;
+    for (unsigned i = 0; i < m_valid_addr_ranges.size(); i++) {
+      std::pair<uint64_t, uint64_t> &range = m_valid_addr_ranges[i];
+      if (merged && range.first <= m_valid_addr_ranges[merged - 1].second) {
+        m_valid_addr_ranges[merged - 1].second =
+            std::max(m_valid_addr_ranges[merged - 1].second, range.second);
+      } else {
+        m_valid_addr_ranges[merged++] = range;
+      }
+    }
+    m_valid_addr_ranges.resize(merged);
+    m_valid_addr_changed = false;
+  }
+  auto next = std::upper_bound(
+      m_valid_addr_ranges.begin(), m_valid_addr_ranges.end(),
+      std::make_pair(addr, std::numeric_limits<uint64_t>::max()));
+  return next != m_valid_addr_ranges.begin() && addr <= (next - 1)->second;
+}
+
+void gpgpu_sim::trace_command(const std::string &line) {
+  if (m_trace_writer.enabled())
+    m_trace_writer.command(line);
+  else
+    gtrace << line << '\n';
+}
+
+void gpgpu_sim::trace_kernel_begin(const std::string &name, unsigned grid_dim,
+                                   unsigned block_dim,
+                                   const std::vector<unsigned> &part_ctas) {
+  if (m_trace_writer.enabled())
+    m_trace_writer.begin_kernel(name, grid_dim, block_dim, part_ctas);
+  else
+    gtrace << "block_dim, " << block_dim << '\n';
+}
+
+void gpgpu_sim::trace_inst(unsigned dynamic_warp_id, const std::string &inst) {
+  // the line as the text trace has it, the warp id, ", " and a newline
+  if (tracer_profile::get().enabled())
+    tracer_profile::get().count(
+        TRACER_TRACE_BYTES,
+        inst.size() + std::to_string(dynamic_warp_id).size() + 3);
+  if (m_trace_writer.enabled())
+    m_trace_writer.instruction(dynamic_warp_id, inst);
+  else
+    gtrace << dynamic_warp_id << ", " << inst << '\n';
+}
+
+void gpgpu_sim::trace_warps_exited(
+    const std::vector<unsigned> &dynamic_warp_ids) {
+  if (m_trace_writer.enabled()) m_trace_writer.warps_exited(dynamic_warp_ids);
+}
+
+void gpgpu_sim::trace_kernel_end(const std::string &name) {
+  if (m_trace_writer.enabled())
+    m_trace_writer.end_kernel();
+  else
+    gtrace << "graphics kernel end: " << name << '\n';
+}
+
+void gpgpu_sim::trace_close() {
+  if (m_trace_writer.enabled()) {
+    m_trace_writer.close();
+  } else {
+    gtrace.close();
+    if (m_config.trace_gzip())
+      system("mv traces.traceg.gz complete.traceg.gz");
+    else
+      system("mv traces.traceg complete.traceg");
+  }
 }
 
 int gpgpu_sim::shared_mem_size() const {
@@ -37,6 +37,7 @@
 #include "../option_parser.h"
 #include "../trace.h"
 #include "addrdec.h"
+#include "accel_trace_writer.h"
 #include "gpu-cache.h"
 #include "shader.h"
 
@@ -377,6 +378,8 @@ class gpgpu_sim_config : public power_config,
   }
 
   bool flush_l1() const { return gpgpu_flush_l1_cache; }
+  const char *trace_dir() const { return gpgpu_trace_dir; }
+  bool trace_gzip() const { return gpgpu_trace_gzip; }
 
  private:
   void init_clock_domains(void);
@@ -406,6 +409,8 @@ class gpgpu_sim_config : public power_config,
   char *gpgpu_runtime_stat;
   bool gpgpu_flush_l1_cache;
   bool gpgpu_flush_l2_cache;
+  char *gpgpu_trace_dir;
+  bool gpgpu_trace_gzip;
   bool gpu_deadlock_detect;
   int gpgpu_frfcfs_dram_sched_queue_size;
   int gpgpu_cflog_interval;
@@ -485,6 +490,31 @@ class watchpoint_event {
   const ptx_instruction *m_inst;
 };
 
+// start or end addresses of the named device buffers the tracer keeps
+// loads and stores of; writing one marks the range index of gpgpu_sim stale
+class valid_addr_bounds {
+ public:
+  typedef std::unordered_map<std::string, uint64_t>::const_iterator
+      const_iterator;
+
+  explicit valid_addr_bounds(bool *changed) : m_changed(changed) {}
+  uint64_t &operator[](const std::string &name) {
+    *m_changed = true;
+    return m_bounds[name];
+  }
+  uint64_t at(const std::string &name) const { return m_bounds.at(name); }
+  void clear() {
+    *m_changed = true;
+    m_bounds.clear();
+  }
+  const_iterator begin() const { return m_bounds.begin(); }
+  const_iterator end() const { return m_bounds.end(); }
+
+ private:
+  bool *m_changed;
+  std::unordered_map<std::string, uint64_t> m_bounds;
+};
+
 class gpgpu_sim : public gpgpu_t {
  public:
   gpgpu_sim(const gpgpu_sim_config &config, gpgpu_context *ctx);
@@ -545,7 +575,21 @@ class gpgpu_sim : public gpgpu_t {
   void dump_rt_pipeline(int sid) const;
 
   void perf_memcpy_to_gpu(size_t dst_start_addr, size_t count);
-  std::ofstream gtrace;
+  trace_file gtrace;
+  // the traced instructions go to gtrace (traces.traceg), or with
+  // -gpgpu_trace_dir to per-kernel trace files
+  accel_trace_writer m_trace_writer;
+  void trace_command(const std::string &line);
+  // with part_ctas the launch is traced as that many kernels of that many
+  // CTAs each, see accel_trace_writer
+  void trace_kernel_begin(const std::string &name, unsigned grid_dim,
+                          unsigned block_dim,
+                          const std::vector<unsigned> &part_ctas =
+                              std::vector<unsigned>());
+  void trace_inst(unsigned dynamic_warp_id, const std::string &inst);
+  void trace_warps_exited(const std::vector<unsigned> &dynamic_warp_ids);
+  void trace_kernel_end(const std::string &name);
+  void trace_close();
 
   // The next three functions added to be used by the functional simulation
   // function
@@ -700,8 +744,18 @@ class gpgpu_sim : public gpgpu_t {
     m_functional_sim_kernel = NULL;
   }
 
-  std::unordered_map<std::string, uint64_t> valid_addr_start;
-  std::unordered_map<std::string, uint64_t> valid_addr_end;
+  // whether addr is in one of the valid_addr ranges (bounds included)
+  bool valid_addr(uint64_t addr);
+
+ private:
+  // the valid_addr ranges sorted and merged, rebuilt on the first lookup
+  // after a change
+  bool m_valid_addr_changed;
+  std::vector<std::pair<uint64_t, uint64_t>> m_valid_addr_ranges;
+
+ public:
+  valid_addr_bounds valid_addr_start;
+  valid_addr_bounds valid_addr_end;
 };
 
 class exec_gpgpu_sim : public gpgpu_sim {
@@ -1,4 +1,5 @@
 #include "ray_coherency_engine.h"
+#include <algorithm>
 #include "../../libcuda/gpgpu_context.h"
 
 
@@ -12,6 +13,12 @@ ray_coherence_engine::ray_coherence_engine(unsigned sid, struct ray_coherence_co
   m_schedule_packet_id = 0;
 
   m_scheduled_packets.resize(m_config.max_packets);
+  // the MSHR keeps the waiting packets of an address as a 64-bit mask
+  if (m_config.max_packets > 64) {
+    printf("GPGPU-Sim: ray coherence engine supports at most 64 packets, %u configured\n", m_config.max_packets);
+    exit(1);
+  }
+  m_request_counts.reserve(m_config.warp_size);
 }
 
 void ray_coherence_engine::set_world(float3 min, float3 max) {
@@ -20,7 +27,7 @@ void ray_coherence_engine::set_world(float3 min, float3 max) {
   world_max = max;
 }
 
-void ray_coherence_engine::insert(warp_inst_t inst) {
+void ray_coherence_engine::insert(const warp_inst_t &inst) {
   assert(!inst.empty());
 
   m_last_insertion_cycle = GPGPU_Context()->the_gpgpusim->g_the_gpu->gpu_tot_sim_cycle + GPGPU_Context()->the_gpgpusim->g_the_gpu->gpu_sim_cycle;
@@ -44,14 +51,16 @@ void ray_coherence_engine::insert(warp_inst_t inst) {
     ray_hash hash = get_ray_hash(ray.ray_properties);
 
     // Add ray to pool
-    if (m_ray_pool.find(hash) == m_ray_pool.end()) {
+    auto index = m_ray_pool_index.find(hash);
+    if (index == m_ray_pool_index.end()) {
       COHERENCE_DPRINTF("Shader %d: New coherence packet created for hash 0x%x\n", m_sid, hash);
-      coherence_packet packet;
-      m_ray_pool[hash] = packet;
+      index = m_ray_pool_index.insert(std::make_pair(hash, (unsigned)m_ray_pool.size())).first;
+      m_ray_pool.push_back(pool_entry());
+      m_ray_pool.back().hash = hash;
       m_stats->total_packets++;
     }
 
-    m_ray_pool[hash].push_back(ray);
+    m_ray_pool[index->second].packet.push_back(std::move(ray));
     m_total_rays++;
     m_stats->total_rays++;
     num_rays++;
@@ -64,9 +73,9 @@ void ray_coherence_engine::insert(warp_inst_t inst) {
   }
 }
 
-bool ray_coherence_engine::is_empty(coherence_packet packet) {
+bool ray_coherence_engine::is_empty(const coherence_packet &packet) const {
   for (auto it=packet.cbegin(); it!=packet.cend(); it++) {
-    coherence_ray ray = *it;
+    const coherence_ray &ray = *it;
     if (!ray.empty()) {
       return false;
     }
@@ -74,20 +83,19 @@ bool ray_coherence_engine::is_empty(coherence_packet packet) {
   return true;
 }
 
-bool ray_coherence_engine::is_stalled() {
+bool ray_coherence_engine::is_stalled() const {
   // Check all the coherence packets
   for (auto i=m_scheduled_packets.cbegin(); i!=m_scheduled_packets.cend(); i++) {
-    coherence_packet packet = *i;
-    if (!is_stalled(packet)) return false;
+    if (!is_stalled(*i)) return false;
   }
   // Stalled
   return true;
 }
 
-bool ray_coherence_engine::is_stalled(const coherence_packet packet) {
+bool ray_coherence_engine::is_stalled(const coherence_packet &packet) const {
   // Check all the rays
   for (auto it=packet.cbegin(); it!=packet.cend(); it++) {
-    coherence_ray ray = *it;
+    const coherence_ray &ray = *it;
     if (!ray.empty()) {
       if (ray.next_status() == RT_MEM_UNMARKED && ray.latency_delay == 0) return false;
     }
@@ -144,8 +152,7 @@ void ray_coherence_engine::cycle() {
     // Check all the coherence packets
     unsigned active_packets = 0;
     for (auto i=m_ray_pool.cbegin(); i!=m_ray_pool.cend(); i++) {
-      ray_hash hash = i->first;
-      coherence_packet packet = i->second;
+      const coherence_packet &packet = i->packet;
       if (!is_stalled(packet) && !is_empty(packet)) {
         active_packets++;
       }
@@ -160,12 +167,13 @@ void ray_coherence_engine::cycle() {
           // Find largest packet
           ray_hash hash;
           coherence_packet *selected_packet = get_largest_packet(hash);
+          if (!selected_packet) break;
           COHERENCE_DPRINTF("Shader %d: Scheduling new packet [%d] with 0x%x\n", m_sid, i, hash);
 
           // Move rays (schedule)
           for (unsigned r=0; r<m_config.warp_size; r++) {
             if (selected_packet->empty()) break;
-            m_scheduled_packets[i].push_back(selected_packet->front());
+            m_scheduled_packets[i].push_back(std::move(selected_packet->front()));
             selected_packet->pop_front();
             m_num_scheduled_rays++;
             m_num_ray_pool_rays--;
@@ -180,16 +188,20 @@ void ray_coherence_engine::cycle() {
 }
 
 coherence_packet * ray_coherence_engine::get_largest_packet(ray_hash &hash) {
-  // Find the largest coherence packet
+  // Find the largest coherence packet, the lowest hash on a tie; NULL when
+  // the pool holds no rays
   unsigned largest_packet = 0;
-  for (auto it=m_ray_pool.cbegin(); it!=m_ray_pool.cend(); it++) {
-    if (it->second.size() > largest_packet) {
-      hash = it->first;
-      largest_packet = it->second.size();
+  coherence_packet *largest = NULL;
+  for (auto it=m_ray_pool.begin(); it!=m_ray_pool.end(); it++) {
+    if (it->packet.size() > largest_packet ||
+        (largest && it->packet.size() == largest_packet && it->hash < hash)) {
+      hash = it->hash;
+      largest_packet = it->packet.size();
+      largest = &it->packet;
     }
   }
 
-  return &m_ray_pool[hash];
+  return largest;
 }
 
 unsigned ray_coherence_engine::schedule_next_warp() {
@@ -203,31 +215,35 @@ unsigned ray_coherence_engine::schedule_next_warp() {
   coherence_packet &selected_packet = m_scheduled_packets[m_schedule_packet_id];
 
   // Choose the most common request
-  // map (addr, size)->occurrences
-  std::map<addr_size_pair, unsigned> requests;
+  // (addr, size)->occurrences
+  std::vector<std::pair<addr_size_pair, unsigned> > &requests = m_request_counts;
+  requests.clear();
   // Gather all the addresses
   for (auto it=selected_packet.cbegin(); it!=selected_packet.cend(); it++) {
-    coherence_ray ray = *it;
+    const coherence_ray &ray = *it;
 
     if (!ray.empty()) {
       // Check if address is already in progress or ray is not ready yet
       if (ray.next_status() != RT_MEM_AWAITING && ray.latency_delay == 0) {
         addr_size_pair request = addr_size_pair(ray.next_access().address, ray.next_access().size);
-        if (requests.find(request) == requests.end()) {
-          requests[request] = 0;
+        unsigned r = 0;
+        while (r < requests.size() && requests[r].first != request) r++;
+        if (r == requests.size()) {
+          requests.push_back(std::make_pair(request, 0u));
         }
-        requests[request]++;
+        requests[r].second++;
       }
     }
   }
 
   assert(!requests.empty());
 
-  // Find the most common
+  // Find the most common, the lowest (addr, size) on a tie
   unsigned occurrences = 0;
   addr_size_pair next_request;
   for (auto it=requests.cbegin(); it!=requests.cend(); it++) {
-    if (it->second > occurrences) {
+    if (it->second > occurrences ||
+        (it->second == occurrences && it->first < next_request)) {
       occurrences = it->second;
       next_request = it->first;
     }
@@ -240,7 +256,7 @@ unsigned ray_coherence_engine::schedule_next_warp() {
 
   // Find thread
   for (auto it=selected_packet.cbegin(); it!=selected_packet.cend(); it++) {
-    coherence_ray ray = *it;
+    const coherence_ray &ray = *it;
     if (!ray.empty() && ray.latency_delay == 0) {
       if (ray.next_access().address == next_request.first && ray.next_access().size == next_request.second) {
         m_active_thread = ray.origin_thread_id;
@@ -270,24 +286,16 @@ RTMemoryTransactionRecord ray_coherence_engine::get_next_access() {
   }
 
   // Mark request as sent
-  if (m_request_mshr.find(m_active_record.address) == m_request_mshr.end()) {
-    std::set<unsigned> outstanding_packets;
-    m_request_mshr[m_active_record.address] = outstanding_packets;
-  }
   COHERENCE_DPRINTF("Shader %d: Inserting MSHR entry for packet %d at addr 0x%x\n", m_sid, m_schedule_packet_id, m_active_record.address);
-  m_request_mshr[m_active_record.address].insert(m_schedule_packet_id);
+  m_request_mshr[m_active_record.address] |= 1ull << m_schedule_packet_id;
 
   // Create MSHR for chunks
   if (m_active_record.size > 32) {
     COHERENCE_DPRINTF("Shader %d: Memory request > 32B. Inserting MSHR entries\n", m_sid);
     // Create the memory chunks and push to mem_access_q
     for (unsigned i=1; i<((m_active_record.size+31)/32); i++) {
-      if (m_request_mshr.find(m_active_record.address + (i * 32)) == m_request_mshr.end()) {
-        std::set<unsigned> outstanding_packets;
-        m_request_mshr[m_active_record.address + (i * 32)] = outstanding_packets;
-      }
       COHERENCE_DPRINTF("Shader %d: Inserting MSHR entry for packet %d at addr 0x%x\n", m_sid, m_schedule_packet_id, m_active_record.address + (i * 32));
-      m_request_mshr[m_active_record.address + (i * 32)].insert(m_schedule_packet_id);
+      m_request_mshr[m_active_record.address + (i * 32)] |= 1ull << m_schedule_packet_id;
     }
   }
 
@@ -311,8 +319,10 @@ void ray_coherence_engine::undo_access(new_addr_type addr) {
   }
 
   // Remove the most recent hash from the MSHR
-  assert(m_request_mshr.find(addr) != m_request_mshr.end());
-  assert(m_request_mshr[addr].erase(m_schedule_packet_id) > 0);
+  auto entry = m_request_mshr.find(addr);
+  assert(entry != m_request_mshr.end());
+  assert(entry->second & (1ull << m_schedule_packet_id));
+  entry->second &= ~(1ull << m_schedule_packet_id);
   COHERENCE_DPRINTF("Shader %d: Undoing MSHR entry for packet %d at addr 0x%x\n", m_sid, m_schedule_packet_id, addr);
 }
 
@@ -323,12 +333,14 @@ void ray_coherence_engine::process_response(mem_fetch *mf, std::map<unsigned, wa
 
   unsigned found = 0;
   
-  if (m_request_mshr.find(uncoalesced_addr) != m_request_mshr.end()) {
-    std::set<unsigned> packets = m_request_mshr[uncoalesced_addr];
-    COHERENCE_DPRINTF("Shader %d: Found %d MSHR ray coherency packets for addr 0x%x\n", m_sid, packets.size(), uncoalesced_addr);
+  auto entry = m_request_mshr.find(uncoalesced_addr);
+  if (entry != m_request_mshr.end()) {
+    uint64_t packets = entry->second;
+    COHERENCE_DPRINTF("Shader %d: Found %d MSHR ray coherency packets for addr 0x%x\n", m_sid, __builtin_popcountll(packets), uncoalesced_addr);
 
     // Mark memory response for all hashes
-    for (unsigned p : packets) {
+    for (unsigned p=0; packets; p++, packets >>= 1) {
+      if (!(packets & 1)) continue;
       // Find the appropriate threads
       coherence_packet &packet = m_scheduled_packets[p];
       
@@ -338,19 +350,17 @@ void ray_coherence_engine::process_response(mem_fetch *mf, std::map<unsigned, wa
           unsigned thread_id = ray.origin_thread_id;
           unsigned warp_uid = ray.origin_warp_uid;
 
-          assert(pipe_reg->get_uid() == warp_uid || m_current_warps.find(warp_uid) != m_current_warps.end());
+          bool in_pipe_reg = pipe_reg && !pipe_reg->empty() && pipe_reg->get_uid() == warp_uid;
+          assert(in_pipe_reg || m_current_warps.find(warp_uid) != m_current_warps.end());
           if (uncoalesced_base_addr == ray.next_addr()) {
             COHERENCE_DPRINTF("Shader %d: Ray coherency packet includes warp %d thread %d\n", m_sid, warp_uid, thread_id);
-            bool mem_record_done = (!pipe_reg->empty() && pipe_reg->get_uid() == warp_uid) ?
-               pipe_reg->process_returned_mem_access(mf, thread_id) :
-               m_current_warps[warp_uid]->process_returned_mem_access(mf, thread_id);
+            warp_inst_t *warp = in_pipe_reg ? pipe_reg : m_current_warps[warp_uid];
+            bool mem_record_done = warp->process_returned_mem_access(mf, thread_id);
 
             if (mem_record_done) {
               assert(ray.next_addr() == mf->get_uncoalesced_base_addr());
               ray.RT_mem_accesses.pop_front();
-              ray.latency_delay = (!pipe_reg->empty() && pipe_reg->get_uid() == warp_uid) ?
-                 pipe_reg->get_thread_latency(thread_id):
-                 m_current_warps[warp_uid]->get_thread_latency(thread_id);
+              ray.latency_delay = warp->get_thread_latency(thread_id);
             }
           }
         }
@@ -358,35 +368,29 @@ void ray_coherence_engine::process_response(mem_fetch *mf, std::map<unsigned, wa
     }
 
     // Remove address from MSHR 
-    m_request_mshr.erase(uncoalesced_addr);
+    m_request_mshr.erase(entry);
   }
   if (is_stalled()) m_active = false;
 }
 
 void ray_coherence_engine::dec_thread_latency() {
   for (unsigned i=0; i<m_config.max_packets; i++) {
-    unsigned index = 0;
-    std::deque<unsigned> index_list;
     coherence_packet &packet = m_scheduled_packets[i];
-    for (coherence_ray &ray : packet) {
+    // Delete completed rays, keeping the order of the others
+    auto kept = packet.begin();
+    for (auto it=packet.begin(); it!=packet.end(); it++) {
+      coherence_ray &ray = *it;
       if (ray.latency_delay > 0) ray.latency_delay--;
       else if (ray.empty()) {
         COHERENCE_DPRINTF("Shader %d: Ray (w%d:t%d) complete!\n", m_sid, ray.origin_warp_uid, ray.origin_thread_id);
-        index_list.push_back(index);
+        m_num_scheduled_rays--;
+        m_total_rays--;
+        continue;
       }
-      index++;
-    }
-
-    // Delete completed rays
-    index = 0;
-    for (auto iter=index_list.begin(); iter!=index_list.end(); iter++) {
-      unsigned delete_index = *iter;
-      unsigned adjusted_index = delete_index - index;
-      packet.erase(packet.begin() + adjusted_index);
-      index++;
-      m_num_scheduled_rays--;
-      m_total_rays--;
+      if (kept != it) *kept = std::move(ray);
+      kept++;
     }
+    packet.erase(kept, packet.end());
   }
 }
 
@@ -515,9 +519,9 @@ void ray_coherence_engine::print(FILE *fout) {
 
   fprintf(fout, "Rays (%d/%d):\n", m_total_rays, m_num_ray_pool_rays);
   for (auto it=m_ray_pool.begin(); it!=m_ray_pool.end(); it++) {
-    ray_hash hash = it->first;
-    fprintf(fout, "[0x%x] (%d)\t", hash, is_stalled(it->second));
-    for (coherence_ray ray : it->second) {
+    ray_hash hash = it->hash;
+    fprintf(fout, "[0x%x] (%d)\t", hash, is_stalled(it->packet));
+    for (const coherence_ray &ray : it->packet) {
       if (!ray.empty())
         fprintf(fout, "w%d:t%d\t", ray.origin_warp_uid, ray.origin_thread_id);
     }
@@ -528,26 +532,34 @@ void ray_coherence_engine::print(FILE *fout) {
   for (unsigned i=0; i<m_config.max_packets; i++) {
     if (i == m_schedule_packet_id) fprintf(fout, "*");
     fprintf(fout, "[%d] (%d)\t", i, is_stalled(m_scheduled_packets[i]));
-    for (coherence_ray ray : m_scheduled_packets[i]) {
+    for (const coherence_ray &ray : m_scheduled_packets[i]) {
       if (!ray.empty())
         fprintf(fout, "w%d:t%d\t", ray.origin_warp_uid, ray.origin_thread_id);
     }
     fprintf(fout, "\n");
   }
 
+  print_mshr(fout);
+}
+
+void ray_coherence_engine::print_mshr(FILE *fout) const {
+  // in address order
+  std::vector<std::pair<new_addr_type, uint64_t> > requests(m_request_mshr.begin(), m_request_mshr.end());
+  std::sort(requests.begin(), requests.end());
   fprintf(fout, "Outstanding requests:\n");
-  for (auto it=m_request_mshr.begin(); it!=m_request_mshr.end(); it++) {
+  for (auto it=requests.begin(); it!=requests.end(); it++) {
     fprintf(fout, "[0x%x]\t", it->first);
-    for (unsigned i : it->second) {
-      fprintf(fout, "%d\t", i);
+    for (unsigned i=0; i<64; i++) {
+      if (it->second & (1ull << i)) fprintf(fout, "%d\t", i);
     }
     fprintf(fout, "\n");
   }
 }
 
 void ray_coherence_engine::print(ray_hash &hash, FILE *fout) {
-  if (m_ray_pool.find(hash)!=m_ray_pool.end()) {
-    print(m_ray_pool[hash], fout);
+  auto index = m_ray_pool_index.find(hash);
+  if (index != m_ray_pool_index.end()) {
+    print(m_ray_pool[index->second].packet, fout);
   }
   else {
     fprintf(fout, "0x%x not found!\n", hash);
@@ -555,7 +567,7 @@ void ray_coherence_engine::print(ray_hash &hash, FILE *fout) {
 }
 
 void ray_coherence_engine::print(coherence_packet &packet, FILE *fout) const {
-  for (coherence_ray ray : packet) {
+  for (const coherence_ray &ray : packet) {
     ray.print(fout);
   }
 }
@@ -565,9 +577,9 @@ void ray_coherence_engine::print_full(FILE *fout) {
 
   fprintf(fout, "Rays (%d):\n", m_total_rays);
   for (auto it=m_ray_pool.begin(); it!=m_ray_pool.end(); it++) {
-    ray_hash hash = it->first;
-    fprintf(fout, "Hash [0x%x] (%s)\n", hash, is_stalled(it->second) ? "s" : " ");
-    print(it->second, fout);
+    ray_hash hash = it->hash;
+    fprintf(fout, "Hash [0x%x] (%s)\n", hash, is_stalled(it->packet) ? "s" : " ");
+    print(it->packet, fout);
   }
 
   fprintf(fout, "Scheduled Packets:\n");
@@ -577,14 +589,7 @@ void ray_coherence_engine::print_full(FILE *fout) {
     print(m_scheduled_packets[i], fout);
   }
 
-  fprintf(fout, "Outstanding requests:\n");
-  for (auto it=m_request_mshr.begin(); it!=m_request_mshr.end(); it++) {
-    fprintf(fout, "[0x%x]\t", it->first);
-    for (unsigned i : it->second) {
-      fprintf(fout, "%d\t", i);
-    }
-    fprintf(fout, "\n");
-  }
+  print_mshr(fout);
 }
 
 void ray_coherence_engine::print_stats(FILE *fout) {
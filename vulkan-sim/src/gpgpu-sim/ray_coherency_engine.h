@@ -3,6 +3,7 @@
 
 #include "../abstract_hardware_model.h"
 #include <cmath>
+#include <unordered_map>
 #include "vector-math.h"
 
 typedef uint64_t(*HashFunc)(const Ray&, const float3&, const float3&);
@@ -10,30 +11,30 @@ typedef uint64_t(*HashFunc)(const Ray&, const float3&, const float3&);
 
 struct {
   Ray ray_properties;
-  std::deque<RTMemoryTransactionRecord> RT_mem_accesses;
+  rt_access_stream RT_mem_accesses;
   unsigned origin_warp_uid;
   unsigned origin_thread_id;
   unsigned latency_delay;
 
-  bool empty() {
+  bool empty() const {
     return RT_mem_accesses.empty();
   }
-  void print(FILE* fout) {
+  void print(FILE* fout) const {
     fprintf(fout, "\t[%d:%d] [%d]- ", origin_warp_uid, origin_thread_id, latency_delay);
-    for (RTMemoryTransactionRecord record : RT_mem_accesses) {
+    for (const RTMemoryTransactionRecord &record : RT_mem_accesses) {
       fprintf(fout, "0x%x (%d-%s-<%s>)\t", record.address, record.size, record.status == RT_MEM_AWAITING ? "A" : "U", record.mem_chunks.to_string().c_str()); 
     }
     fprintf(fout, "\n");
   }
-  RTMemoryTransactionRecord next_access() {
+  const RTMemoryTransactionRecord &next_access() const {
     assert(!RT_mem_accesses.empty());
     return RT_mem_accesses.front();
   }
-  new_addr_type next_addr() {
+  new_addr_type next_addr() const {
     assert(!RT_mem_accesses.empty());
     return RT_mem_accesses.front().address;
   }
-  RTMemStatus next_status() {
+  RTMemStatus next_status() const {
     assert(!RT_mem_accesses.empty());
     return RT_mem_accesses.front().status;
   }
@@ -88,7 +89,7 @@ class ray_coherence_engine {
     ~ray_coherence_engine();
     
     void cycle();
-    void insert(warp_inst_t new_warp);
+    void insert(const warp_inst_t &new_warp);
     unsigned schedule_next_warp();
     RTMemoryTransactionRecord get_next_access();
     void undo_access(new_addr_type addr);
@@ -116,13 +117,23 @@ class ray_coherence_engine {
     unsigned m_num_scheduled_rays;
     unsigned long long m_last_insertion_cycle;
 
-    // map [hash]->[group of rays]
-    std::map<ray_hash, coherence_packet> m_ray_pool;
+    // groups of rays in the order their hashes first appeared, and
+    // [hash]->[index of its group]
+    struct pool_entry {
+      ray_hash hash;
+      coherence_packet packet;
+    };
+    std::vector<pool_entry> m_ray_pool;
+    std::unordered_map<ray_hash, unsigned> m_ray_pool_index;
 
     std::vector<coherence_packet> m_scheduled_packets;
 
-    // map [addr]->[set of hashes (coherence_packets)]
-    std::map<new_addr_type, std::set<unsigned> > m_request_mshr;
+    // map [addr]->[mask of scheduled packets waiting for it]
+    std::unordered_map<new_addr_type, uint64_t> m_request_mshr;
+    void print_mshr(FILE *fout) const;
+
+    // (addr, size)->occurrences, reused by schedule_next_warp
+    std::vector<std::pair<addr_size_pair, unsigned> > m_request_counts;
 
     float3 world_min;
     float3 world_max;
@@ -137,9 +148,9 @@ class ray_coherence_engine {
     unsigned m_active_thread;
     RTMemoryTransactionRecord m_active_record;
 
-    bool is_empty(coherence_packet packet);
-    bool is_stalled();
-    bool is_stalled(coherence_packet packet);
+    bool is_empty(const coherence_packet &packet) const;
+    bool is_stalled() const;
+    bool is_stalled(const coherence_packet &packet) const;
     bool check_scheduled();
     bool scheduled_full();
 
@@ -0,0 +1,33 @@
+// Treelets of the traced BVHs, for the RT unit
+
+#include "rt_treelets.h"
+
+#include <assert.h>
+
+void rt_treelets::clear() {
+  m_bvh_roots.clear();
+  m_node_treelet.clear();
+  m_treelet_chunks.clear();
+}
+
+bool rt_treelets::begin_bvh(new_addr_type root) {
+  return m_bvh_roots.insert(root).second;
+}
+
+unsigned rt_treelets::add_treelet() {
+  m_treelet_chunks.push_back(std::vector<new_addr_type>());
+  return m_treelet_chunks.size() - 1;
+}
+
+void rt_treelets::add_node(unsigned treelet, new_addr_type addr,
+                           unsigned size) {
+  assert(treelet < m_treelet_chunks.size());
+  m_node_treelet[addr] = treelet;
+  for (unsigned offset = 0; offset < size; offset += 32)
+    m_treelet_chunks[treelet].push_back(addr + offset);
+}
+
+int rt_treelets::treelet_of(new_addr_type addr) const {
+  auto it = m_node_treelet.find(addr);
+  return it == m_node_treelet.end() ? -1 : (int)it->second;
+}
@@ -0,0 +1,50 @@
+// Treelets of the traced BVHs, for the RT unit
+//
+// A treelet is a connected piece of a BVH of about -gpgpu_rt_treelet_bytes,
+// grown breadth first from its root node, with the leaves of its internal
+// nodes kept alongside them. The functional traversal splits a BVH the first
+// time it traces one of its roots, since it is the side that decodes nodes,
+// and the RT unit prefetches the whole treelet when a ray enters it and
+// prefers warps whose next node is in a treelet it fetched recently.
+// Addresses are the ones of the ray tracing memory transaction records.
+
+#ifndef RT_TREELETS_H
+#define RT_TREELETS_H
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../abstract_hardware_model.h"
+
+class rt_treelets {
+ public:
+  rt_treelets() { m_max_bytes = 0; }
+
+  void set_max_bytes(unsigned bytes) { m_max_bytes = bytes; }
+  unsigned max_bytes() const { return m_max_bytes; }
+  bool enabled() const { return m_max_bytes > 0; }
+
+  // forget every BVH, for acceleration structures rebuilt between launches
+  void clear();
+  // false when the BVH at root was split before, otherwise marks it split
+  bool begin_bvh(new_addr_type root);
+  unsigned add_treelet();
+  void add_node(unsigned treelet, new_addr_type addr, unsigned size);
+
+  // -1 when addr is not the address of a node in a treelet
+  int treelet_of(new_addr_type addr) const;
+  // the 32B chunks of the nodes of treelet
+  const std::vector<new_addr_type> &chunks(unsigned treelet) const {
+    return m_treelet_chunks[treelet];
+  }
+  unsigned num_treelets() const { return m_treelet_chunks.size(); }
+
+ private:
+  unsigned m_max_bytes;
+  std::unordered_set<new_addr_type> m_bvh_roots;
+  std::unordered_map<new_addr_type, unsigned> m_node_treelet;
+  std::vector<std::vector<new_addr_type> > m_treelet_chunks;
+};
+
+#endif
@@ -778,6 +778,12 @@ void shader_core_stats::print(FILE *fout) const {
   fprintf(fout, "rt_avg_warp_occupancy = %f\n", (float)rt_total_warp_occupancy / rt_total_warps);
   print_roofline(fout);
   fprintf(fout, "rt_writes = %d\n", rt_writes);
+  if (m_config->m_rt_treelet_bytes) {
+    fprintf(fout, "rt_treelets = %u\n", GPGPU_Context()->func_sim->g_rt_treelets.num_treelets());
+    fprintf(fout, "rt_treelet_prefetches = %llu\n", rt_treelet_prefetches);
+    fprintf(fout, "rt_treelet_prefetch_hits = %llu\n", rt_treelet_prefetch_hits);
+    fprintf(fout, "rt_treelet_scheduled = %llu\n", rt_treelet_scheduled);
+  }
   fprintf(fout, "rt_max_mem_store_q = %d\n", rt_max_store_q);
   fprintf(fout, "rt_avg_mem_store_cycles = %f\n", average_mem_store_cycles);
   fprintf(fout, "rt_cycles = %f\n", (float)average_rt_total_cycles / gpgpusim_total_cycles);
@@ -2848,6 +2854,10 @@ rt_unit::rt_unit(mem_fetch_interface *icnt,
   coherence_config.warp_size = config->warp_size;
   m_ray_coherence_engine = new ray_coherence_engine(sid, coherence_config, m_stats->rt_coherence_stats[sid], core);
 
+  // the functional traversal splits the BVHs it traces
+  GPGPU_Context()->func_sim->g_rt_treelets.set_max_bytes(config->m_rt_treelet_bytes);
+  m_demand_issued = false;
+
   m_mem_rc = NO_RC_FAIL;
   m_name = "RT_CORE";
   
@@ -2875,12 +2885,30 @@ void rt_unit::issue(register_set &reg_set) {
 unsigned rt_unit::active_warps() {
   std::set<unsigned> warp_ids;
   for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); it++) {
-    unsigned warp_id = it->second.get_warp_id();
+    unsigned warp_id = it->second->get_warp_id();
     warp_ids.insert(warp_id);
   }
   return warp_ids.size();
 }
 
+warp_inst_t *rt_unit::alloc_warp_slot(const warp_inst_t &inst) {
+  warp_inst_t *slot;
+  if (m_free_warp_slots.empty()) {
+    m_warp_slots.push_back(inst);
+    slot = &m_warp_slots.back();
+  }
+  else {
+    slot = m_free_warp_slots.back();
+    m_free_warp_slots.pop_back();
+    *slot = inst;
+  }
+  return slot;
+}
+
+void rt_unit::free_warp_slot(warp_inst_t *slot) {
+  m_free_warp_slots.push_back(slot);
+}
+
 void rt_unit::cycle() {
   // Debugging roofline plot
   cacheline_count = 0;
@@ -2931,9 +2959,9 @@ void rt_unit::cycle() {
   unsigned active_threads = 0;
   std::map<new_addr_type, unsigned> addr_set;
   for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); ++it) {
-    n_threads += (it->second).dec_thread_latency(mem_store_q);
-    active_threads += (it->second).get_rt_active_threads();
-    (it->second).num_unique_mem_access(addr_set);
+    n_threads += it->second->dec_thread_latency(mem_store_q);
+    active_threads += it->second->get_rt_active_threads();
+    it->second->num_unique_mem_access(addr_set);
   }
   if (m_config->m_rt_coherence_engine) m_ray_coherence_engine->dec_thread_latency();
   // Number of threads currently completing intersection tests are the number of intersection operations this cycle
@@ -2989,7 +3017,7 @@ void rt_unit::cycle() {
       // Find warp (expect a unique warp)
       bool found = false;
       for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); it++) {
-        if (it->second.check_pending_writes(uncoalesced_base_addr)) {
+        if (it->second->check_pending_writes(uncoalesced_base_addr)) {
           // Found instruction that sent the pending write
           found = true;
           break;
@@ -3017,11 +3045,7 @@ void rt_unit::cycle() {
       }
       
       if (m_config->m_rt_coherence_engine) {
-        std::map<unsigned, warp_inst_t *> m_warp_pointers;
-        for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); it++) {
-          m_warp_pointers[it->first] = &it->second;
-        }
-        m_ray_coherence_engine->process_response(mf, m_warp_pointers, &pipe_reg);
+        m_ray_coherence_engine->process_response(mf, m_current_warps, &pipe_reg);
       }
       else {
         process_memory_response(mf, pipe_reg);
@@ -3035,16 +3059,17 @@ void rt_unit::cycle() {
   m_L0_complet->cycle();
   
   // Move new warp into collection of warps
-  if (!pipe_reg.empty()) m_current_warps[pipe_reg.get_uid()] = pipe_reg;
+  if (!pipe_reg.empty()) m_current_warps[pipe_reg.get_uid()] = alloc_warp_slot(pipe_reg);
   m_dispatch_reg->clear();
 
   // Choose next warp
-  warp_inst_t rt_inst;
+  warp_inst_t *rt_inst = NULL;
 
   // Check if there are outstanding chunks to request
   if (!mem_access_q.empty()) {
     // Check if warp still exists
-    if (m_current_warps.find(mem_access_q_warp_uid) == m_current_warps.end()) {
+    auto chunk_warp = m_current_warps.find(mem_access_q_warp_uid);
+    if (chunk_warp == m_current_warps.end()) {
       printf("Memory chunk original warp not found (w_uid: %d); erasing memory accesses starting with 0x%x.\n", mem_access_q_warp_uid, mem_access_q.front());
       mem_access_q.clear();
       if (mem_store_q.empty()) {
@@ -3053,8 +3078,8 @@ void rt_unit::cycle() {
     }
     else {
       // Find the appropriate warp
-      rt_inst = m_current_warps[mem_access_q_warp_uid];
-      m_current_warps.erase(mem_access_q_warp_uid);
+      rt_inst = chunk_warp->second;
+      m_current_warps.erase(chunk_warp);
     }
   }
   else if (mem_store_q.empty() && !m_config->m_rt_coherence_engine) {
@@ -3065,34 +3090,40 @@ void rt_unit::cycle() {
     // Check if active
     if (m_ray_coherence_engine->active()) {
       unsigned warp_uid = m_ray_coherence_engine->schedule_next_warp();
-      rt_inst = m_current_warps[warp_uid];
-      m_current_warps.erase(warp_uid);
+      auto it = m_current_warps.find(warp_uid);
+      if (it != m_current_warps.end()) {
+        rt_inst = it->second;
+        m_current_warps.erase(it);
+      }
     }
   }
   
   // Get cycle status
-  if (!rt_inst.empty()) rt_inst.track_rt_cycles(true);
+  if (rt_inst) rt_inst->track_rt_cycles(true);
   for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); it++) {
-    (it->second).track_rt_cycles(false);
+    it->second->track_rt_cycles(false);
   }
 
   // Schedule next memory request
   memory_cycle(rt_inst);
 
   // Place warp back
-  if (!rt_inst.empty()) m_current_warps[rt_inst.get_uid()] = rt_inst;
+  if (rt_inst) m_current_warps[rt_inst->get_uid()] = rt_inst;
+
+  // Prefetch treelets when no demand request went out
+  if (!m_demand_issued && !m_treelet_prefetch_q.empty()) issue_treelet_prefetch();
   
   // Check to see if any warps are complete
   int completed_warp_uid = -1;
   for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); it++) {
     
     // A completed warp has no more memory accesses and all the intersection delays are complete and has no pending writes
-    if (it->second.rt_mem_accesses_empty() && it->second.rt_intersection_delay_done() && !it->second.has_pending_writes()) {
-      RT_DPRINTF("Shader %d: Warp %d (uid: %d) completed!\n", m_sid, it->second.warp_id(), it->first);
-      if (m_operand_collector->writeback(it->second)) {
-        m_scoreboard->releaseRegisters(&it->second);
-        m_core->warp_inst_complete(it->second);
-        m_core->dec_inst_in_pipeline(it->second.warp_id());
+    if (it->second->rt_mem_accesses_empty() && it->second->rt_intersection_delay_done() && !it->second->has_pending_writes()) {
+      RT_DPRINTF("Shader %d: Warp %d (uid: %d) completed!\n", m_sid, it->second->warp_id(), it->first);
+      if (m_operand_collector->writeback(*it->second)) {
+        m_scoreboard->releaseRegisters(it->second);
+        m_core->warp_inst_complete(*it->second);
+        m_core->dec_inst_in_pipeline(it->second->warp_id());
         
         // Track number of warps in RT core
         n_warps--;
@@ -3102,7 +3133,7 @@ void rt_unit::cycle() {
         completed_warp_uid = it->first;
         
         // Track warp latency in RT unit
-        unsigned long long start_cycle = it->second.get_start_cycle();
+        unsigned long long start_cycle = it->second->get_start_cycle();
         unsigned long long total_cycles = current_cycle - start_cycle;
         m_stats->rt_total_warp_latency += total_cycles;
         m_stats->rt_total_warps++;
@@ -3110,19 +3141,19 @@ void rt_unit::cycle() {
         // #define PRINT_WARP_TIMING
         #ifdef PRINT_WARP_TIMING
         printf("sid: %2d wid: %2d uid: %5d start: %8d end: %8d total: %8d\n", 
-          m_sid, it->second.warp_id(), it->second.get_uid(), start_cycle, current_cycle, total_cycles);
+          m_sid, it->second->warp_id(), it->second->get_uid(), start_cycle, current_cycle, total_cycles);
         #endif
 
         // Track thread latency in RT unit
         unsigned long long total_thread_cycles = 0;
         for (unsigned i=0; i<m_config->warp_size; i++) {
-          if (it->second.thread_active(i)) {
-            unsigned long long end_cycle = it->second.get_thread_end_cycle(i);
+          if (it->second->thread_active(i)) {
+            unsigned long long end_cycle = it->second->get_thread_end_cycle(i);
             assert(end_cycle > 0);
             int n_total_cycles = end_cycle - start_cycle;
             assert(n_total_cycles >= 0);
             total_thread_cycles += n_total_cycles;
-            m_stats->add_rt_latency_dist(it->second.get_latency_dist(i));
+            m_stats->add_rt_latency_dist(it->second->get_latency_dist(i));
           }
         }
         float avg_thread_cycles = (float)total_thread_cycles / m_config->warp_size;
@@ -3139,7 +3170,9 @@ void rt_unit::cycle() {
   
   // Remove complete warp
   if (completed_warp_uid >= 0) {
-    m_current_warps.erase(completed_warp_uid);
+    auto it = m_current_warps.find(completed_warp_uid);
+    free_warp_slot(it->second);
+    m_current_warps.erase(it);
   }
   
   assert(n_warps == m_current_warps.size());
@@ -3156,7 +3189,7 @@ void rt_unit::process_memory_response(mem_fetch* mf, warp_inst_t &pipe_reg) {
       unsigned requester_thread_found = 0;
       requester_thread_found += pipe_reg.process_returned_mem_access(mf);
       for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); ++it) {
-        requester_thread_found += (it->second).process_returned_mem_access(mf);
+        requester_thread_found += it->second->process_returned_mem_access(mf);
       }
 
       // Make sure at least one thread accepted the response. (Other threads might still be completing intersection test)
@@ -3181,8 +3214,8 @@ void rt_unit::process_memory_response(mem_fetch* mf, warp_inst_t &pipe_reg) {
         mem_fetch* response = *it;
         // Check all the warps
         for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); it++) {
-          if (it->second.warp_id() == response->get_wid()) {
-            requester_thread_found += it->second.process_returned_mem_access(mf);
+          if (it->second->warp_id() == response->get_wid()) {
+            requester_thread_found += it->second->process_returned_mem_access(mf);
           }
         }
       }
@@ -3196,8 +3229,8 @@ void rt_unit::process_memory_response(mem_fetch* mf, warp_inst_t &pipe_reg) {
     // If not using the cache
     else {
       for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); it++) {
-        if (it->second.warp_id() == mf->get_wid()) {
-          it->second.process_returned_mem_access(mf);
+        if (it->second->warp_id() == mf->get_wid()) {
+          it->second->process_returned_mem_access(mf);
         }
       }
     }
@@ -3210,42 +3243,64 @@ void rt_unit::process_memory_response(mem_fetch* mf, warp_inst_t &pipe_reg) {
   }   
 }
 
-void rt_unit::schedule_next_warp(warp_inst_t &inst) {
+void rt_unit::schedule_next_warp(warp_inst_t *&inst) {
   // Return if there are no warps in the RT unit
   if (m_current_warps.empty()) return;
       
-  // Otherwise, find the first non-stalled warp
+  // Otherwise, find the first non-stalled warp, preferring one whose next
+  // node is in a treelet fetched recently
   else {
-    for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); ++it) {
-      if (!((it->second).is_stalled())) { 
-        inst = it->second;
-        break;
+    if (!m_recent_treelets.empty()) {
+      const rt_treelets &treelets = GPGPU_Context()->func_sim->g_rt_treelets;
+      for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); ++it) {
+        new_addr_type next_addr;
+        if (!it->second->is_stalled() &&
+            it->second->peek_next_rt_address(next_addr) &&
+            recent_treelet(treelets.treelet_of(next_addr))) {
+          inst = it->second;
+          m_stats->rt_treelet_scheduled++;
+          break;
+        }
       }
     }
-    if (!inst.empty()) m_current_warps.erase(inst.get_uid());
+    if (!inst) {
+      for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); ++it) {
+        if (!it->second->is_stalled()) { 
+          inst = it->second;
+          break;
+        }
+      }
+    }
+    if (inst) m_current_warps.erase(inst->get_uid());
   }
 }
 
-void rt_unit::memory_cycle(warp_inst_t &inst) {
+void rt_unit::memory_cycle(warp_inst_t *&inst) {
   mem_chunk = false;
+  m_demand_issued = false;
   mem_fetch *mf;
   
   // If there are still accesses waiting in mem_access_q, send those first
   if (!mem_access_q.empty()) {
     mem_chunk = true;
     RT_DPRINTF("Shader %d: Prioritizing mem_access_q entries (%d entries remaining)\n", m_sid, mem_access_q.size());
-    mf = process_memory_chunks(inst);
+    assert(inst);
+    mf = process_memory_chunks(*inst);
+    m_demand_issued = mf != NULL;
     if (mf) process_cache_access(m_config->m_rt_use_l1d ? (baseline_cache *)L1D : (baseline_cache *)m_L0_complet, inst, mf);
   }
 
   // Otherwise check for stores
   else if (!mem_store_q.empty()) {
-    assert(inst.empty());
+    assert(!inst);
     RT_DPRINTF("Shader %d: Prioritizing stores\n", m_sid);
     mf = process_memory_stores();
-    inst = mf->get_inst();
-    m_current_warps.erase(inst.get_uid());
+    auto it = m_current_warps.find(mf->get_inst().get_uid());
+    assert(it != m_current_warps.end());
+    inst = it->second;
+    m_current_warps.erase(it);
     mem_access_q_type = static_cast<int>(TransactionType::UNDEFINED);
+    m_demand_issued = mf != NULL;
     if (mf) process_cache_access(L1D, inst, mf);
   }
 
@@ -3254,13 +3309,13 @@ void rt_unit::memory_cycle(warp_inst_t &inst) {
     if (m_config->m_rt_max_warps > 0 && m_L0_complet->num_mshr_entries() > m_config->m_rt_max_mshr_entries) return;
     
     // Return if there are no active threads
-    if (!inst.active_count()) return;
+    if (!inst || !inst->active_count()) return;
     
     // If we make it here, there should be a valid warp to work with
-    assert(inst.space.get_type() == global_space);
+    assert(inst->space.get_type() == global_space);
     
     // If waiting for responses, don't send new requests
-    if (!m_config->m_rt_coherence_engine && inst.is_stalled()) return;
+    if (!m_config->m_rt_coherence_engine && inst->is_stalled()) return;
     
     // If coherence engine is stalled, don't send new request
     // TODO: Fix the thread intersection latencies so this doesn't happen
@@ -3268,12 +3323,69 @@ void rt_unit::memory_cycle(warp_inst_t &inst) {
 
     // Continue to next step
     RT_DPRINTF("Shader %d: Processing next memory access\n", m_sid);
-    mf = process_memory_access_queue(inst);
+    mf = process_memory_access_queue(*inst);
+    m_demand_issued = mf != NULL;
     if (mf) process_cache_access(m_config->m_rt_use_l1d ? (baseline_cache *)L1D : (baseline_cache *)m_L0_complet, inst, mf);
   }
 }
 
 
+bool rt_unit::recent_treelet(int treelet) const {
+  return treelet >= 0 &&
+         std::find(m_recent_treelets.begin(), m_recent_treelets.end(), treelet) != m_recent_treelets.end();
+}
+
+void rt_unit::queue_treelet_prefetch(new_addr_type addr, unsigned size) {
+  const rt_treelets &treelets = GPGPU_Context()->func_sim->g_rt_treelets;
+  if (!treelets.enabled() || m_config->bypassL0Complet || m_config->m_rt_perfect_mem) return;
+
+  // Entering a treelet not fetched recently
+  int treelet = treelets.treelet_of(addr);
+  if (treelet < 0 || recent_treelet(treelet)) return;
+  m_recent_treelets.push_back(treelet);
+  if (m_recent_treelets.size() > RECENT_TREELETS) m_recent_treelets.pop_front();
+
+  // Queue the rest of it, dropping the oldest prefetches if it runs long
+  for (new_addr_type chunk : treelets.chunks(treelet)) {
+    if (chunk >= addr && chunk < addr + size) continue;
+    m_treelet_prefetch_q.push_back(chunk);
+  }
+  unsigned max_queue = RECENT_TREELETS * treelets.max_bytes() / 32;
+  while (m_treelet_prefetch_q.size() > max_queue) m_treelet_prefetch_q.pop_front();
+  RT_DPRINTF("Shader %d: Entering treelet %d at 0x%x, %d prefetches queued\n", m_sid, treelet, addr, m_treelet_prefetch_q.size());
+}
+
+void rt_unit::issue_treelet_prefetch() {
+  // A prefetch goes out on behalf of a warp in the unit
+  if (m_current_warps.empty()) return;
+  baseline_cache *cache = m_config->m_rt_use_l1d ? (baseline_cache *)L1D : (baseline_cache *)m_L0_complet;
+  if (cache->num_mshr_entries() >= m_config->m_rt_max_mshr_entries) return;
+
+  new_addr_type addr = m_treelet_prefetch_q.front();
+  mem_access_t access = create_mem_access(addr);
+  access.set_uncoalesced_base_addr(addr);
+  unsigned long long cycle = m_core->get_gpu()->gpu_sim_cycle + m_core->get_gpu()->gpu_tot_sim_cycle;
+  mem_fetch *mf = m_mf_allocator->alloc(*m_current_warps.begin()->second, access, cycle);
+  mf->set_raytrace();
+
+  std::list<cache_event> events;
+  enum cache_request_status status = cache->access(mf->get_addr(), mf, cycle, events);
+  if (status == RESERVATION_FAIL) {
+    // retried next cycle
+    delete mf;
+    return;
+  }
+  m_treelet_prefetch_q.pop_front();
+  if (status == HIT) {
+    m_stats->rt_treelet_prefetch_hits++;
+    delete mf;
+  }
+  else {
+    RT_DPRINTF("Shader %d: Treelet prefetch for 0x%x\n", m_sid, addr);
+    m_stats->rt_treelet_prefetches++;
+  }
+}
+
 void rt_unit::writeback() {
   while (m_L0_complet->access_ready()) {
     mem_fetch *mf = m_L0_complet->next_access();
@@ -3353,8 +3465,10 @@ mem_fetch* rt_unit::process_memory_stores() {
   RT_DPRINTF("Shader %d: store mem_access_t created for 0x%x\n", m_sid, access.get_addr());
   
   // Create mf
+  auto warp = m_current_warps.find(warp_uid);
+  assert(warp != m_current_warps.end());
   mem_fetch *mf = m_mf_allocator->alloc(
-    m_current_warps[warp_uid], access, m_core->get_gpu()->gpu_sim_cycle + m_core->get_gpu()->gpu_tot_sim_cycle
+    *warp->second, access, m_core->get_gpu()->gpu_sim_cycle + m_core->get_gpu()->gpu_tot_sim_cycle
   ); 
   mf->set_raytrace();
 
@@ -3398,6 +3512,8 @@ mem_fetch* rt_unit::process_memory_access_queue(warp_inst_t &inst) {
   
   // Track memory access type stats
   mem_access_q_type = static_cast<int>(next_access.type);
+
+  queue_treelet_prefetch(next_access.address, next_access.size);
   
   // If the size is larger than 32B, then split into chunks and add remaining chunks into mem_access_q
   if (next_access.size > 32) {
@@ -3430,7 +3546,7 @@ mem_fetch* rt_unit::process_memory_access_queue(warp_inst_t &inst) {
   return mf;
 }
 
-void rt_unit::process_cache_access(baseline_cache *cache, warp_inst_t &inst, mem_fetch *mf) {
+void rt_unit::process_cache_access(baseline_cache *cache, warp_inst_t *&inst, mem_fetch *mf) {
   assert(mf != NULL);
 
   enum cache_request_status status;
@@ -3441,7 +3557,7 @@ void rt_unit::process_cache_access(baseline_cache *cache, warp_inst_t &inst, mem
     unsigned control_size = 8;
     unsigned size = mf->get_access_size() + control_size;
     // printf("Interconnect:Addr: %x, size=%d\n",access.get_addr(),size);
-    if (!m_icnt->full(size, inst.is_store() || inst.isatomic())) {
+    if (!m_icnt->full(size, inst->is_store() || inst->isatomic())) {
       m_icnt->push(mf);
       return;
     }
@@ -3458,28 +3574,24 @@ void rt_unit::process_cache_access(baseline_cache *cache, warp_inst_t &inst, mem
     // Handle write ACKs
     if (mf->get_is_write()) {
       m_stats->rt_writes++;
-      inst.check_pending_writes(uncoalesced_base_addr);
+      inst->check_pending_writes(uncoalesced_base_addr);
     }
     else if (m_config->m_rt_coherence_engine) {
-      std::map<unsigned, warp_inst_t *> m_warp_pointers;
-      for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); it++) {
-        m_warp_pointers[it->first] = &it->second;
-      }
-      m_ray_coherence_engine->process_response(mf, m_warp_pointers, &inst);
-      if (!inst.empty()) m_current_warps[inst.get_uid()] = inst;
-      inst.clear();
+      m_ray_coherence_engine->process_response(mf, m_current_warps, inst);
+      if (inst) m_current_warps[inst->get_uid()] = inst;
+      inst = NULL;
     }
     else {
       unsigned found = 0;
-      found += inst.process_returned_mem_access(mf);
+      found += inst->process_returned_mem_access(mf);
       
       if (m_config->m_rt_coalesce_warps) {
         for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); ++it) {
           if (found > 0) {
-            (it->second).process_returned_mem_access(mf);
+            it->second->process_returned_mem_access(mf);
           }
           else {
-            (it->second).process_returned_mem_access(mf);
+            it->second->process_returned_mem_access(mf);
           }
         }
       }
@@ -3531,7 +3643,7 @@ void rt_unit::process_cache_access(baseline_cache *cache, warp_inst_t &inst, mem
         }
         else {
           if (m_config->m_rt_coherence_engine) m_ray_coherence_engine->undo_access(mf->get_uncoalesced_addr());
-          else inst.undo_rt_access(mf->get_uncoalesced_addr());
+          else inst->undo_rt_access(mf->get_uncoalesced_addr());
         }
         m_stats->gpgpu_n_rt_mem[mem_access_q_type]--;
       }
@@ -3543,7 +3655,7 @@ void rt_unit::process_cache_access(baseline_cache *cache, warp_inst_t &inst, mem
       }
       else {
         if (m_config->m_rt_coherence_engine) m_ray_coherence_engine->undo_access(mf->get_uncoalesced_addr());
-        else inst.undo_rt_access(mf->get_uncoalesced_addr());
+        else inst->undo_rt_access(mf->get_uncoalesced_addr());
       }
       m_stats->gpgpu_n_rt_mem[mem_access_q_type]--;
     }
@@ -3558,25 +3670,21 @@ void rt_unit::process_cache_access(baseline_cache *cache, warp_inst_t &inst, mem
     cacheline_count++;
 
     if (m_config->m_rt_coherence_engine) {
-      std::map<unsigned, warp_inst_t *> m_warp_pointers;
-      for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); it++) {
-        m_warp_pointers[it->first] = &it->second;
-      }
-      m_ray_coherence_engine->process_response(mf, m_warp_pointers, &inst);
-      if (!inst.empty()) m_current_warps[inst.get_uid()] = inst;
-      inst.clear();
+      m_ray_coherence_engine->process_response(mf, m_current_warps, inst);
+      if (inst) m_current_warps[inst->get_uid()] = inst;
+      inst = NULL;
     }
     else {
       unsigned found = 0;
-      found += inst.process_returned_mem_access(mf);
+      found += inst->process_returned_mem_access(mf);
       
       if (m_config->m_rt_coalesce_warps) {
         for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); ++it) {
           if (found > 0) {
-            (it->second).process_returned_mem_access(mf);
+            it->second->process_returned_mem_access(mf);
           }
           else {
-            (it->second).process_returned_mem_access(mf);
+            it->second->process_returned_mem_access(mf);
           }
         }
       }
@@ -4019,6 +4127,15 @@ void shader_core_ctx::register_cta_thread_exit(unsigned cta_num,
     m_barriers.deallocate_barrier(cta_num);
     shader_CTA_count_unlog(m_sid, 1);
 
+    if (m_gpu->m_trace_writer.enabled()) {
+      std::vector<unsigned> exited;
+      for (unsigned i = 0; i < m_config->max_warps_per_shader; i++) {
+        if (m_warp[i]->get_cta_id() == cta_num)
+          exited.push_back(m_warp[i]->get_dynamic_warp_id());
+      }
+      m_gpu->trace_warps_exited(exited);
+    }
+
     SHADER_DPRINTF(
         LIVENESS,
         "GPGPU-Sim uArch: Finished CTA #%u (%lld,%lld), %u CTAs running\n",
@@ -4482,7 +4599,7 @@ void rt_unit::print(FILE *fout) const {
   // RT Core Warps
   fprintf(fout, "RT Core Warps: (%d warps)\n", m_current_warps.size());
   for (auto it=m_current_warps.begin(); it!=m_current_warps.end(); ++it) {
-    warp_inst_t inst = it->second;
+    warp_inst_t &inst = *it->second;
     fprintf(fout, "%d uid:%5d ", inst.is_stalled(), it->first);
     inst.print(fout);
     fprintf(fout, "Latency Delay: [");
@@ -4502,7 +4619,7 @@ void rt_unit::print(FILE *fout) const {
   
   // Response FIFO
   fprintf(fout, "RT response FIFO (occupancy = %zu):\n", m_response_fifo.size());
-  for (std::list<mem_fetch *>::const_iterator i = m_response_fifo.begin();
+  for (std::deque<mem_fetch *>::const_iterator i = m_response_fifo.begin();
        i != m_response_fifo.end(); i++) {
     const mem_fetch *mf = *i;
     mf->print(fout);
@@ -55,6 +55,7 @@
 #include "stats.h"
 #include "traffic_breakdown.h"
 #include "ray_coherency_engine.h"
+#include "rt_treelets.h"
 
 #define NO_OP_FLAG 0xFF
 
@@ -1311,11 +1312,21 @@ class rt_unit : public pipelined_simd_unit {
       mem_fetch* process_memory_stores();
       mem_fetch* process_memory_chunks(warp_inst_t &inst);
       mem_fetch* process_memory_access_queue(warp_inst_t &inst);
-      void schedule_next_warp(warp_inst_t &inst);
-      void memory_cycle(warp_inst_t &inst);
+      void schedule_next_warp(warp_inst_t *&inst);
+      void memory_cycle(warp_inst_t *&inst);
+
+      // treelets the RT unit fetched last, and the chunks of them still to
+      // prefetch in cycles without a demand request
+      static const unsigned RECENT_TREELETS = 8;
+      void queue_treelet_prefetch(new_addr_type addr, unsigned size);
+      bool recent_treelet(int treelet) const;
+      void issue_treelet_prefetch();
+      std::deque<int> m_recent_treelets;
+      std::deque<new_addr_type> m_treelet_prefetch_q;
+      bool m_demand_issued;
                           
       virtual void process_cache_access(
-            baseline_cache *cache, warp_inst_t &inst, mem_fetch *mf);
+            baseline_cache *cache, warp_inst_t *&inst, mem_fetch *mf);
             
       mem_access_t create_mem_access(new_addr_type addr);
       
@@ -1348,14 +1359,17 @@ class rt_unit : public pipelined_simd_unit {
       new_addr_type mem_access_q_base_addr;
       int mem_access_q_type;
       
-      std::map<unsigned /*warp_id*/,
-           std::map<unsigned /*regnum*/, unsigned /*count*/>>
-           m_pending_writes;
-      std::list<mem_fetch *> m_response_fifo;
+      std::deque<mem_fetch *> m_response_fifo;
       enum mem_stage_stall_type m_mem_rc;
       
-      // {warp id, warp instruction}
-      std::map<unsigned, warp_inst_t> m_current_warps;
+      // {warp uid, warp instruction}. The instructions live in slots of
+      // m_warp_slots, reused once their warp completes, so a warp is copied
+      // in when it arrives and scheduling only moves the pointer around.
+      warp_inst_t *alloc_warp_slot(const warp_inst_t &inst);
+      void free_warp_slot(warp_inst_t *slot);
+      std::map<unsigned, warp_inst_t *> m_current_warps;
+      std::deque<warp_inst_t> m_warp_slots;
+      std::vector<warp_inst_t *> m_free_warp_slots;
       unsigned n_warps;
 
       unsigned cacheline_count;
@@ -1782,6 +1796,7 @@ class shader_core_config : public core_config {
   bool m_rt_use_l1d;
   bool m_rt_perfect_mem;
   bool m_rt_coherence_engine;
+  unsigned m_rt_treelet_bytes;
   char * m_rt_coherence_engine_config_str;
   ray_coherence_config m_rt_coherence_engine_config;
   bool bypassL0Complet;
@@ -1913,6 +1928,9 @@ struct shader_core_stats_pod {
   unsigned long long *rt_total_cycles;
   unsigned long long rt_total_cycles_sum = 0;
   unsigned long long rt_writes;
+  unsigned long long rt_treelet_prefetches;
+  unsigned long long rt_treelet_prefetch_hits;
+  unsigned long long rt_treelet_scheduled;
   unsigned rt_max_store_q;
   unsigned *rt_mem_store_q_cycles;
   unsigned *rt_warp_dist;
@@ -0,0 +1,82 @@
+// Trace files written by a background thread
+
+#include "trace_file.h"
+
+trace_file::trace_file() {
+  m_open = false;
+  m_file = NULL;
+  m_gz = NULL;
+  m_pending = 0;
+  m_closing = false;
+}
+
+trace_file::~trace_file() { close(); }
+
+bool trace_file::open(const std::string &path, bool gzip) {
+  close();
+  if (gzip)
+    m_gz = gzopen((path + ".gz").c_str(), "wb");
+  else
+    m_file = fopen(path.c_str(), "w");
+  if (!m_gz && !m_file) return false;
+  m_open = true;
+  m_closing = false;
+  m_writer = std::thread(&trace_file::run, this);
+  return true;
+}
+
+void trace_file::hand_off() {
+  std::unique_lock<std::mutex> lock(m_lock);
+  while (m_queue.size() >= MAX_QUEUED) m_written.wait(lock);
+  m_queue.push_back(std::string());
+  m_queue.back().swap(m_buffer);
+  m_pending++;
+  m_queued.notify_one();
+  lock.unlock();
+  m_buffer.reserve(BUFFER_BYTES);
+}
+
+void trace_file::run() {
+  std::unique_lock<std::mutex> lock(m_lock);
+  while (true) {
+    while (m_queue.empty() && !m_closing) m_queued.wait(lock);
+    if (m_queue.empty()) break;
+    std::string buffer;
+    buffer.swap(m_queue.front());
+    m_queue.pop_front();
+    m_written.notify_all();
+    lock.unlock();
+    if (m_gz)
+      gzwrite(m_gz, buffer.data(), buffer.size());
+    else
+      fwrite(buffer.data(), 1, buffer.size(), m_file);
+    lock.lock();
+    m_pending--;
+    m_written.notify_all();
+  }
+}
+
+void trace_file::flush() {
+  if (!m_open) return;
+  if (!m_buffer.empty()) hand_off();
+  std::unique_lock<std::mutex> lock(m_lock);
+  while (m_pending) m_written.wait(lock);
+  if (m_file) fflush(m_file);
+}
+
+void trace_file::close() {
+  if (!m_open) return;
+  if (!m_buffer.empty()) hand_off();
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_closing = true;
+    m_queued.notify_one();
+  }
+  m_writer.join();
+  if (m_gz) gzclose(m_gz);
+  if (m_file) fclose(m_file);
+  m_gz = NULL;
+  m_file = NULL;
+  m_open = false;
+  std::string().swap(m_buffer);
+}
@@ -0,0 +1,71 @@
+// Trace files written by a background thread
+//
+// The simulation thread appends trace text to an in-memory buffer; full
+// buffers are handed to a writer thread that writes them in order, gzip
+// compressed with -gpgpu_trace_gzip, so tracing does not wait for the disk.
+// At most MAX_QUEUED buffers wait for the writer before the simulation
+// thread blocks on it.
+
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <stdio.h>
+#include <zlib.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class trace_file {
+ public:
+  trace_file();
+  ~trace_file();
+
+  // path gets a .gz suffix when gzip is set, false when it can not be
+  // created
+  bool open(const std::string &path, bool gzip);
+  bool is_open() const { return m_open; }
+
+  trace_file &operator<<(const std::string &s) {
+    m_buffer += s;
+    if (m_buffer.size() >= BUFFER_BYTES) hand_off();
+    return *this;
+  }
+  trace_file &operator<<(const char *s) { return *this << std::string(s); }
+  trace_file &operator<<(char c) { return *this << std::string(1, c); }
+  template <typename T>
+  trace_file &operator<<(T value) {
+    return *this << std::to_string(value);
+  }
+
+  // returns once everything appended so far is in the file
+  void flush();
+  void close();
+
+ private:
+  static const size_t BUFFER_BYTES = 4 << 20;
+  static const size_t MAX_QUEUED = 4;
+
+  void hand_off();
+  void run();
+
+  trace_file(const trace_file &);
+  trace_file &operator=(const trace_file &);
+
+  bool m_open;
+  FILE *m_file;
+  gzFile m_gz;
+  std::string m_buffer;
+
+  // buffers for the writer, pending counts the one it is writing too
+  std::mutex m_lock;
+  std::condition_variable m_queued;
+  std::condition_variable m_written;
+  std::deque<std::string> m_queue;
+  size_t m_pending;
+  bool m_closing;
+  std::thread m_writer;
+};
+
+#endif
@@ -40,74 +40,51 @@ CUstream_st::CUstream_st() {
   pthread_mutex_init(&m_lock, NULL);
 }
 
-bool CUstream_st::empty() {
-  pthread_mutex_lock(&m_lock);
-  bool empty = m_operations.empty();
-  pthread_mutex_unlock(&m_lock);
-  return empty;
-}
+bool CUstream_st::empty() { return m_operations.empty(); }
 
-bool CUstream_st::busy() {
-  pthread_mutex_lock(&m_lock);
-  bool pending = m_pending;
-  pthread_mutex_unlock(&m_lock);
-  return pending;
-}
+bool CUstream_st::busy() { return m_pending; }
 
 void CUstream_st::synchronize() {
   // called by host thread
-  bool done = false;
-  do {
-    pthread_mutex_lock(&m_lock);
-    done = m_operations.empty();
-    pthread_mutex_unlock(&m_lock);
-  } while (!done);
+  while (!empty())
+    ;
 }
 
 void CUstream_st::push(const stream_operation &op) {
-  // called by host thread
+  // called by host thread, or by the device runtime on the gpu thread
   pthread_mutex_lock(&m_lock);
-  m_operations.push_back(op);
+  m_operations.push(op);
   pthread_mutex_unlock(&m_lock);
 }
 
 void CUstream_st::record_next_done() {
   // called by gpu thread
-  pthread_mutex_lock(&m_lock);
   assert(m_pending);
-  m_operations.pop_front();
+  m_operations.pop();
   m_pending = false;
-  pthread_mutex_unlock(&m_lock);
 }
 
 stream_operation CUstream_st::next() {
   // called by gpu thread
-  pthread_mutex_lock(&m_lock);
   m_pending = true;
-  stream_operation result = m_operations.front();
-  pthread_mutex_unlock(&m_lock);
-  return result;
+  return m_operations.front();
 }
 
 void CUstream_st::cancel_front() {
-  pthread_mutex_lock(&m_lock);
   assert(m_pending);
   m_pending = false;
-  pthread_mutex_unlock(&m_lock);
 }
 
 void CUstream_st::print(FILE *fp) {
   pthread_mutex_lock(&m_lock);
   fprintf(fp, "GPGPU-Sim API:    stream %u has %zu operations\n", m_uid,
           m_operations.size());
-  std::list<stream_operation>::iterator i;
   unsigned n = 0;
-  for (i = m_operations.begin(); i != m_operations.end(); i++) {
-    stream_operation &op = *i;
+  m_operations.for_each([&](const stream_operation &op) {
     fprintf(fp, "GPGPU-Sim API:       %u : ", n++);
     op.print(fp);
     fprintf(fp, "\n");
-  }
+  });
   pthread_mutex_unlock(&m_lock);
 }
 
@@ -238,13 +215,17 @@ stream_manager::stream_manager(gpgpu_sim *gpu, bool cuda_launch_blocking) {
   m_gpu = gpu;
   m_service_stream_zero = false;
   m_cuda_launch_blocking = cuda_launch_blocking;
+  m_queued = 0;
+  m_queued_concurrent = 0;
   pthread_mutex_init(&m_lock, NULL);
+  pthread_mutex_init(&m_finished_lock, NULL);
+  pthread_cond_init(&m_finished_cond, NULL);
   m_last_stream = m_streams.begin();
 }
 
 bool stream_manager::operation(bool *sim) {
+  // called by gpu simulation thread, every cycle
   bool check = special_check_finished_kernel();
-  pthread_mutex_lock(&m_lock);
   //    if(check)m_gpu->print_stats();
   stream_operation op = front();
   if (!op.do_operation(m_gpu))  // not ready to execute
@@ -255,9 +236,10 @@ bool stream_manager::operation(bool *sim) {
       m_grid_id_to_stream.erase(grid_uid);
     }
     op.get_stream()->cancel_front();
+  } else if (!op.is_noop() && !op.is_kernel()) {
+    // a kernel retires in register_finished_kernel
+    retire(op.get_stream());
   }
-  pthread_mutex_unlock(&m_lock);
-  // pthread_mutex_lock(&m_lock);
   // simulate a clock cycle on the GPU
   return check;
 }
@@ -311,8 +293,12 @@ bool stream_manager::register_finished_kernel(unsigned grid_uid) {
       stream->record_next_done();
       m_grid_id_to_stream.erase(grid_uid);
       kernel->notify_parent_finished();
-      m_gpu->gtrace << "graphics kernel end: " << kernel->name() << std::endl;
+      m_gpu->trace_kernel_end(kernel->name());
       delete kernel;
+      pthread_mutex_lock(&m_finished_lock);
+      m_finished_kernels.insert(grid_uid);
+      pthread_mutex_unlock(&m_finished_lock);
+      retire(stream);
       return true;
     }
   }
@@ -320,8 +306,25 @@ bool stream_manager::register_finished_kernel(unsigned grid_uid) {
   return false;
 }
 
+void stream_manager::wait_kernel_finished(unsigned grid_uid) {
+  // called by host thread
+  pthread_mutex_lock(&m_finished_lock);
+  while (!m_finished_kernels.count(grid_uid))
+    pthread_cond_wait(&m_finished_cond, &m_finished_lock);
+  m_finished_kernels.erase(grid_uid);
+  pthread_mutex_unlock(&m_finished_lock);
+}
+
+void stream_manager::retire(CUstream_st *stream) {
+  if (stream != &m_stream_zero) m_queued_concurrent--;
+  m_queued--;
+  pthread_mutex_lock(&m_finished_lock);
+  pthread_cond_broadcast(&m_finished_cond);
+  pthread_mutex_unlock(&m_finished_lock);
+}
+
 void stream_manager::stop_all_running_kernels() {
-  pthread_mutex_lock(&m_lock);
+  // called by gpu simulation thread
 
   // Signal m_gpu to stop all running kernels
   m_gpu->stop_all_running_kernels();
@@ -334,12 +337,11 @@ void stream_manager::stop_all_running_kernels() {
 
   // If any kernels completed, print out the current stats
   if (count > 0) m_gpu->print_stats();
-
-  pthread_mutex_unlock(&m_lock);
 }
 
 stream_operation stream_manager::front() {
   // called by gpu simulation thread
+  apply_stream_changes();
   stream_operation result;
   //    if( concurrent_streams_empty() )
   m_service_stream_zero = true;
@@ -380,61 +382,53 @@ stream_operation stream_manager::front() {
   return result;
 }
 
+void stream_manager::apply_stream_changes() {
+  // called by gpu simulation thread
+  while (!m_stream_changes.empty()) {
+    std::pair<CUstream_st *, bool> change = m_stream_changes.front();
+    m_stream_changes.pop();
+    if (change.second)
+      m_streams.push_back(change.first);
+    else
+      m_destroyed.push_back(change.first);
+  }
+  std::list<CUstream_st *>::iterator d = m_destroyed.begin();
+  while (d != m_destroyed.end()) {
+    if (!(*d)->empty()) {
+      d++;
+      continue;
+    }
+    m_streams.remove(*d);
+    delete *d;
+    d = m_destroyed.erase(d);
+    m_last_stream = m_streams.begin();
+  }
+}
+
 void stream_manager::add_stream(struct CUstream_st *stream) {
-  // called by host thread
+  // called by host thread, or by the device runtime on the gpu thread
   pthread_mutex_lock(&m_lock);
-  m_streams.push_back(stream);
+  m_host_streams.push_back(stream);
+  m_stream_changes.push(std::make_pair(stream, true));
   pthread_mutex_unlock(&m_lock);
 }
 
 void stream_manager::destroy_stream(CUstream_st *stream) {
-  // called by host thread
+  // called by host thread, the gpu thread deletes the stream once its
+  // operations are done
   pthread_mutex_lock(&m_lock);
-  while (!stream->empty())
-    ;
-  std::list<CUstream_st *>::iterator s;
-  for (s = m_streams.begin(); s != m_streams.end(); s++) {
-    if (*s == stream) {
-      m_streams.erase(s);
-      break;
-    }
-  }
-  delete stream;
-  m_last_stream = m_streams.begin();
+  m_host_streams.remove(stream);
+  m_stream_changes.push(std::make_pair(stream, false));
   pthread_mutex_unlock(&m_lock);
 }
 
 bool stream_manager::concurrent_streams_empty() {
-  bool result = true;
-  if (m_streams.empty()) return true;
-  // called by gpu simulation thread
-  std::list<struct CUstream_st *>::iterator s;
-  for (s = m_streams.begin(); s != m_streams.end(); ++s) {
-    struct CUstream_st *stream = *s;
-    if (!stream->empty()) {
-      // stream->print(stdout);
-      result = false;
-      break;
-    }
-  }
-  return result;
+  return m_queued_concurrent == 0;
 }
 
-bool stream_manager::empty_protected() {
-  bool result = true;
-  pthread_mutex_lock(&m_lock);
-  if (!concurrent_streams_empty()) result = false;
-  if (!m_stream_zero.empty()) result = false;
-  pthread_mutex_unlock(&m_lock);
-  return result;
-}
+bool stream_manager::empty_protected() { return m_queued == 0; }
 
-bool stream_manager::empty() {
-  bool result = true;
-  if (!concurrent_streams_empty()) result = false;
-  if (!m_stream_zero.empty()) result = false;
-  return result;
-}
+bool stream_manager::empty() { return m_queued == 0; }
 
 void stream_manager::print(FILE *fp) {
   pthread_mutex_lock(&m_lock);
@@ -444,7 +438,7 @@ void stream_manager::print(FILE *fp) {
 void stream_manager::print_impl(FILE *fp) {
   fprintf(fp, "GPGPU-Sim API: Stream Manager State\n");
   std::list<struct CUstream_st *>::iterator s;
-  for (s = m_streams.begin(); s != m_streams.end(); ++s) {
+  for (s = m_host_streams.begin(); s != m_host_streams.end(); ++s) {
     struct CUstream_st *stream = *s;
     if (!stream->empty()) stream->print(fp);
   }
@@ -456,21 +450,25 @@ void stream_manager::push(stream_operation op) {
 
   // block if stream 0 (or concurrency disabled) and pending concurrent
   // operations exist
-  bool block = !stream || m_cuda_launch_blocking;
-  while (block) {
-    pthread_mutex_lock(&m_lock);
-    block = !concurrent_streams_empty();
-    pthread_mutex_unlock(&m_lock);
-  };
+  if (!stream || m_cuda_launch_blocking) {
+    pthread_mutex_lock(&m_finished_lock);
+    while (!concurrent_streams_empty())
+      pthread_cond_wait(&m_finished_cond, &m_finished_lock);
+    pthread_mutex_unlock(&m_finished_lock);
+  }
 
   pthread_mutex_lock(&m_lock);
   if (!m_gpu->cycle_insn_cta_max_hit()) {
     // Accept the stream operation if the maximum cycle/instruction/cta counts
     // are not triggered
+    // counted before the gpu thread can see the operation
     if (stream && !m_cuda_launch_blocking) {
+      m_queued++;
+      m_queued_concurrent++;
       stream->push(op);
     } else {
       op.set_stream(&m_stream_zero);
+      m_queued++;
       m_stream_zero.push(op);
     }
   } else {
@@ -484,22 +482,20 @@ void stream_manager::push(stream_operation op) {
   if (g_debug_execution >= 3) print_impl(stdout);
   pthread_mutex_unlock(&m_lock);
   if (m_cuda_launch_blocking || stream == NULL) {
-    unsigned int wait_amount = 100;
-    unsigned int wait_cap = 100000;  // 100ms
-    while (!empty()) {
-      // sleep to prevent CPU hog by empty spin
-      // sleep time increased exponentially ensure fast response when needed
-      usleep(wait_amount);
-      wait_amount *= 2;
-      if (wait_amount > wait_cap) wait_amount = wait_cap;
-    }
+    // woken by retire, so neither a spin nor a sleep
+    pthread_mutex_lock(&m_finished_lock);
+    while (!empty()) pthread_cond_wait(&m_finished_cond, &m_finished_lock);
+    pthread_mutex_unlock(&m_finished_lock);
   }
 }
 
 void stream_manager::pushCudaStreamWaitEventToAllStreams(CUevent_st *e,
                                                          unsigned int flags) {
+  pthread_mutex_lock(&m_lock);
+  std::list<CUstream_st *> streams = m_host_streams;
+  pthread_mutex_unlock(&m_lock);
   std::list<CUstream_st *>::iterator s;
-  for (s = m_streams.begin(); s != m_streams.end(); s++) {
+  for (s = streams.begin(); s != streams.end(); s++) {
     stream_operation op(*s, e, flags);
     push(op);
   }